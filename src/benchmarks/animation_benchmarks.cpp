@@ -0,0 +1,71 @@
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "animated_model.h"
+#include "filesystem.h"
+
+namespace
+{
+    /* The skinned model of the 20_mesh_skinning demo. */
+    bool LoadModel(RGL::AnimatedModel& model, benchmark::State& state)
+    {
+        if (!model.Load(RGL::FileSystem::getResourcesPath() / "models/fox.glb"))
+        {
+            state.SkipWithError("models/fox.glb couldn't be loaded");
+            return false;
+        }
+
+        return true;
+    }
+}
+
+/* Arg - the models animated per iteration, as the demos with crowds do one after another. */
+static void BM_BoneTransform(benchmark::State& state)
+{
+    RGL::AnimatedModel model;
+
+    if (!LoadModel(model, state))
+    {
+        return;
+    }
+
+    std::vector<glm::mat4> transforms;
+
+    for (auto _ : state)
+    {
+        for (int64_t i = 0; i < state.range(0); ++i)
+        {
+            model.BoneTransform(1.0f / 60.0f, transforms);
+            benchmark::DoNotOptimize(transforms.data());
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BoneTransform)->RangeMultiplier(8)->Range(1, 512)->Unit(benchmark::kMicrosecond);
+
+/* The dual quaternion palette, converted from the matrices. */
+static void BM_BoneTransformDualQuaternions(benchmark::State& state)
+{
+    RGL::AnimatedModel model;
+
+    if (!LoadModel(model, state))
+    {
+        return;
+    }
+
+    std::vector<glm::mat2x4> transforms;
+
+    for (auto _ : state)
+    {
+        for (int64_t i = 0; i < state.range(0); ++i)
+        {
+            model.BoneTransform(1.0f / 60.0f, transforms);
+            benchmark::DoNotOptimize(transforms.data());
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BoneTransformDualQuaternions)->RangeMultiplier(8)->Range(1, 512)->Unit(benchmark::kMicrosecond);
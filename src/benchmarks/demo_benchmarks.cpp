@@ -0,0 +1,114 @@
+#include <array>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "poisson_disk_sampling.h"
+#include "terrain_model.hpp"
+
+/* The hot paths of the demos, their sources are built into this executable. */
+namespace
+{
+    /* The heights only, no mesh - as the CDLOD mode of 04_terrain. */
+    const TerrainModel& GetTerrain()
+    {
+        static const TerrainModel terrain("textures/heightmap.png", 200.0f, 100.0f, false /* generate mesh */);
+        return terrain;
+    }
+
+    std::vector<glm::vec2> MakeQueries(size_t count)
+    {
+        std::mt19937                          generator(1234);
+        std::uniform_real_distribution<float> distribution(-100.0f, 100.0f);
+
+        std::vector<glm::vec2> queries(count);
+
+        for (auto& query : queries)
+        {
+            query = glm::vec2(distribution(generator), distribution(generator));
+        }
+
+        return queries;
+    }
+}
+
+/* Arg - the queries per iteration, random points of the terrain. */
+static void BM_GetHeightOfTerrain(benchmark::State& state)
+{
+    const auto& terrain = GetTerrain();
+    const auto  queries = MakeQueries(size_t(state.range(0)));
+
+    for (auto _ : state)
+    {
+        float sum = 0.0f;
+
+        for (const auto& query : queries)
+        {
+            sum += terrain.getHeightOfTerrain(query.x, query.y, -100.0f, -100.0f);
+        }
+
+        benchmark::DoNotOptimize(sum);
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GetHeightOfTerrain)->RangeMultiplier(16)->Range(16, 65536);
+
+static void BM_GetHeightsOfTerrain(benchmark::State& state)
+{
+    const auto&        terrain = GetTerrain();
+    const auto         queries = MakeQueries(size_t(state.range(0)));
+    std::vector<float> heights(queries.size());
+
+    for (auto _ : state)
+    {
+        terrain.getHeights(queries, -100.0f, -100.0f, heights);
+        benchmark::DoNotOptimize(heights.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GetHeightsOfTerrain)->RangeMultiplier(16)->Range(16, 65536);
+
+/* Arg - the inverse of the radius, the samples grow with its square. */
+static void BM_PoissonDiskSampling(benchmark::State& state)
+{
+    const float                radius = 1.0f / float(state.range(0));
+    const std::array<float, 2> x_min  = { 0.0f, 0.0f };
+    const std::array<float, 2> x_max  = { 1.0f, 1.0f };
+
+    size_t samples_count = 0;
+
+    for (auto _ : state)
+    {
+        auto samples  = thinks::PoissonDiskSampling(radius, x_min, x_max);
+        samples_count = samples.size();
+
+        benchmark::DoNotOptimize(samples.data());
+    }
+
+    state.counters["samples"] = double(samples_count);
+}
+BENCHMARK(BM_PoissonDiskSampling)->RangeMultiplier(4)->Range(8, 512)->Unit(benchmark::kMillisecond);
+
+static void BM_ParallelPoissonDiskSampling(benchmark::State& state)
+{
+    const float                radius = 1.0f / float(state.range(0));
+    const std::array<float, 2> x_min  = { 0.0f, 0.0f };
+    const std::array<float, 2> x_max  = { 1.0f, 1.0f };
+
+    size_t samples_count = 0;
+
+    for (auto _ : state)
+    {
+        auto samples  = thinks::ParallelPoissonDiskSampling(radius, x_min, x_max);
+        samples_count = samples.size();
+
+        benchmark::DoNotOptimize(samples.data());
+    }
+
+    state.counters["samples"] = double(samples_count);
+}
+BENCHMARK(BM_ParallelPoissonDiskSampling)->RangeMultiplier(4)->Range(8, 512)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,67 @@
+#include <cstdio>
+
+#include <benchmark/benchmark.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "common.h"
+#include "job_system.h"
+
+/*
+ * CPU microbenchmarks of the core routines and of the demos' hot paths, a Google Benchmark executable - the usual
+ * --benchmark_filter, --benchmark_repetitions and --benchmark_out options apply. The loaders and the generators
+ * upload their results, so a hidden window provides the GL context, the job system runs as in the demos.
+ *
+ * Built with RGL_BUILD_BENCHMARKS. Compare two runs with Google Benchmark's tools/compare.py.
+ */
+int main(int argc, char* argv[])
+{
+    benchmark::Initialize(&argc, argv);
+
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+
+    if (!glfwInit())
+    {
+        fprintf(stderr, "Could not initialize GLFW.\n");
+        return 1;
+    }
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, MIN_GL_VERSION_MAJOR);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, MIN_GL_VERSION_MINOR);
+    glfwWindowHint(GLFW_OPENGL_PROFILE,        GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_VISIBLE,               GLFW_FALSE);
+
+    GLFWwindow* window = glfwCreateWindow(64, 64, "core_benchmarks", nullptr, nullptr);
+
+    if (!window)
+    {
+        fprintf(stderr, "Could not create the GL context.\n");
+        glfwTerminate();
+        return 1;
+    }
+
+    glfwMakeContextCurrent(window);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        fprintf(stderr, "Could not load the GL functions.\n");
+        glfwTerminate();
+        return 1;
+    }
+
+    RGL::JobSystem::Init();
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    RGL::JobSystem::Shutdown();
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+
+    return 0;
+}
@@ -0,0 +1,159 @@
+#include <cmath>
+#include <memory>
+
+#include <assimp/mesh.h>
+#include <benchmark/benchmark.h>
+
+#include "static_model.h"
+
+namespace
+{
+    /* The CPU stages of the loading, protected in StaticModel. */
+    class BenchmarkModel : public RGL::StaticModel
+    {
+    public:
+        using StaticModel::CalcTangentSpace;
+        using StaticModel::LoadMeshPart;
+    };
+
+    /* A grid of (cells + 1)^2 vertices and 2 * cells^2 triangles. */
+    RGL::VertexData MakeGrid(uint32_t cells)
+    {
+        RGL::VertexData vertex_data;
+
+        for (uint32_t z = 0; z <= cells; ++z)
+        {
+            for (uint32_t x = 0; x <= cells; ++x)
+            {
+                const glm::vec2 uv = glm::vec2(x, z) / float(cells);
+
+                vertex_data.positions.emplace_back(uv.x, 0.1f * std::sin(10.0f * uv.x) * std::cos(10.0f * uv.y), uv.y);
+                vertex_data.texcoords.emplace_back(uv);
+                vertex_data.normals  .emplace_back(0.0f, 1.0f, 0.0f);
+            }
+        }
+
+        for (uint32_t z = 0; z < cells; ++z)
+        {
+            for (uint32_t x = 0; x < cells; ++x)
+            {
+                const uint32_t i = z * (cells + 1) + x;
+
+                vertex_data.indices.insert(vertex_data.indices.end(), { i, i + cells + 1, i + 1, i + 1, i + cells + 1, i + cells + 2 });
+            }
+        }
+
+        return vertex_data;
+    }
+
+    /* The grid as assimp imports it, with all the attributes LoadMeshPart() reads. */
+    std::unique_ptr<aiMesh> MakeMesh(const RGL::VertexData& vertex_data)
+    {
+        auto mesh = std::make_unique<aiMesh>();
+
+        mesh->mNumVertices        = uint32_t(vertex_data.positions.size());
+        mesh->mVertices           = new aiVector3D[mesh->mNumVertices];
+        mesh->mNormals            = new aiVector3D[mesh->mNumVertices];
+        mesh->mTangents           = new aiVector3D[mesh->mNumVertices];
+        mesh->mBitangents         = new aiVector3D[mesh->mNumVertices];
+        mesh->mTextureCoords[0]   = new aiVector3D[mesh->mNumVertices];
+        mesh->mNumUVComponents[0] = 2;
+
+        for (uint32_t i = 0; i < mesh->mNumVertices; ++i)
+        {
+            const auto& position = vertex_data.positions[i];
+            const auto& texcoord = vertex_data.texcoords[i];
+
+            mesh->mVertices[i]         = aiVector3D(position.x, position.y, position.z);
+            mesh->mNormals[i]          = aiVector3D(0.0f, 1.0f, 0.0f);
+            mesh->mTangents[i]         = aiVector3D(1.0f, 0.0f, 0.0f);
+            mesh->mBitangents[i]       = aiVector3D(0.0f, 0.0f, 1.0f);
+            mesh->mTextureCoords[0][i] = aiVector3D(texcoord.x, texcoord.y, 0.0f);
+        }
+
+        mesh->mNumFaces = uint32_t(vertex_data.indices.size() / 3);
+        mesh->mFaces    = new aiFace[mesh->mNumFaces];
+
+        for (uint32_t i = 0; i < mesh->mNumFaces; ++i)
+        {
+            mesh->mFaces[i].mNumIndices = 3;
+            mesh->mFaces[i].mIndices    = new unsigned int[3] { vertex_data.indices[3 * i], vertex_data.indices[3 * i + 1], vertex_data.indices[3 * i + 2] };
+        }
+
+        return mesh;
+    }
+}
+
+/* Arg - the grid's cells per side. */
+static void BM_CalcTangentSpace(benchmark::State& state)
+{
+    BenchmarkModel  model;
+    RGL::VertexData vertex_data = MakeGrid(uint32_t(state.range(0)));
+
+    for (auto _ : state)
+    {
+        model.CalcTangentSpace(vertex_data);
+        benchmark::DoNotOptimize(vertex_data.tangents.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * int64_t(vertex_data.positions.size()));
+}
+BENCHMARK(BM_CalcTangentSpace)->RangeMultiplier(4)->Range(16, 1024)->Unit(benchmark::kMicrosecond);
+
+static void BM_LoadMeshPart(benchmark::State& state)
+{
+    BenchmarkModel model;
+    const auto     mesh = MakeMesh(MakeGrid(uint32_t(state.range(0))));
+
+    for (auto _ : state)
+    {
+        RGL::VertexData vertex_data;
+        model.LoadMeshPart(mesh.get(), vertex_data);
+
+        benchmark::DoNotOptimize(vertex_data.indices.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * int64_t(mesh->mNumVertices));
+}
+BENCHMARK(BM_LoadMeshPart)->RangeMultiplier(4)->Range(16, 1024)->Unit(benchmark::kMicrosecond);
+
+/* The CPU generation with the upload, the GPU one is off by default. Arg - the slices. */
+static void BM_GenSphere(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        RGL::StaticModel model;
+        model.GenSphere(1.0f, uint32_t(state.range(0)));
+    }
+}
+BENCHMARK(BM_GenSphere)->RangeMultiplier(4)->Range(16, 1024)->Unit(benchmark::kMicrosecond);
+
+static void BM_GenTorus(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        RGL::StaticModel model;
+        model.GenTorus(1.0f, 2.0f, uint32_t(state.range(0)), uint32_t(state.range(0)));
+    }
+}
+BENCHMARK(BM_GenTorus)->RangeMultiplier(4)->Range(16, 1024)->Unit(benchmark::kMicrosecond);
+
+static void BM_GenPlaneGrid(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        RGL::StaticModel model;
+        model.GenPlaneGrid(10.0f, 10.0f, uint32_t(state.range(0)), uint32_t(state.range(0)));
+    }
+}
+BENCHMARK(BM_GenPlaneGrid)->RangeMultiplier(4)->Range(16, 1024)->Unit(benchmark::kMicrosecond);
+
+static void BM_GenPQTorusKnot(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        RGL::StaticModel model;
+        model.GenPQTorusKnot(uint32_t(state.range(0)), 16);
+    }
+}
+BENCHMARK(BM_GenPQTorusKnot)->RangeMultiplier(4)->Range(64, 4096)->Unit(benchmark::kMicrosecond);
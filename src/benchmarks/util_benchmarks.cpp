@@ -0,0 +1,38 @@
+#include <iterator>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "filesystem.h"
+#include "util.h"
+
+namespace
+{
+    /* From a few includes to the dozens of nested ones of the clustered shading. */
+    constexpr const char* SHADERS[] = { "src/core/shaders/gui.vert",
+                                        "src/core/shaders/depth_pyramid.comp",
+                                        "src/demos/27_clustered_shading/pbr_clustered.frag" };
+}
+
+/* Arg - the index of the shader in SHADERS. */
+static void BM_LoadShaderIncludes(benchmark::State& state)
+{
+    const std::filesystem::path filepath = SHADERS[state.range(0)];
+    const std::string           code     = RGL::Util::LoadFile(filepath);
+    const std::filesystem::path dir      = RGL::FileSystem::getRootPath() / filepath.parent_path();
+
+    state.SetLabel(filepath.filename().string());
+
+    size_t expanded_size = 0;
+
+    for (auto _ : state)
+    {
+        std::string expanded = RGL::Util::LoadShaderIncludes(code, dir);
+        expanded_size        = expanded.size();
+
+        benchmark::DoNotOptimize(expanded.data());
+    }
+
+    state.SetBytesProcessed(state.iterations() * int64_t(expanded_size));
+}
+BENCHMARK(BM_LoadShaderIncludes)->DenseRange(0, int(std::size(SHADERS)) - 1)->Unit(benchmark::kMicrosecond);
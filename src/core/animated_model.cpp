@@ -2,54 +2,187 @@
 
 #include <assimp/postprocess.h>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/dual_quaternion.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RGL_POSES_SSE 1
+#include <emmintrin.h>
+#endif
+
+#include "asset_io_system.h"
+#include "frame_allocator.h"
+#include "gl_state.h"
+#include "gpu_culling.h"
+#include "gpu_memory.h"
+#include "job_system.h"
+#include "trace.h"
+
 namespace RGL
 {
-    void AnimatedModel::BoneTransform(float dt, std::vector<glm::mat4>& transforms)
+    namespace
+    {
+        /* How far the cursor walks forward before falling back to the binary search. */
+        constexpr uint32_t MAX_CURSOR_STEPS = 4;
+
+        /* The key i of times[i] <= animation_time < times[i + 1], clamped to the last pair. */
+        uint32_t findKey(float animation_time, const std::vector<float>& times, uint32_t& cursor)
+        {
+            if (times.size() < 2)
+            {
+                return 0;
+            }
+
+            const uint32_t last_index = uint32_t(times.size()) - 2;
+                  uint32_t index      = std::min(cursor, last_index);
+
+            /* The playback moves forward by a key or two per frame - start from the last frame's key. */
+            if (times[index] <= animation_time)
+            {
+                for (uint32_t step = 0; step < MAX_CURSOR_STEPS && index < last_index && times[index + 1] <= animation_time; ++step)
+                {
+                    ++index;
+                }
+
+                if (index == last_index || animation_time < times[index + 1])
+                {
+                    cursor = index;
+                    return index;
+                }
+            }
+
+            /* Looped, scrubbed or a long jump. */
+            cursor = uint32_t(std::upper_bound(times.begin() + 1, times.end() - 1, animation_time) - times.begin()) - 1;
+            return cursor;
+        }
+
+        /* The interpolation factor between the key and the next one. */
+        float keyFactor(float animation_time, const std::vector<float>& times, uint32_t index)
+        {
+            float factor = (animation_time - times[index]) / (times[index + 1] - times[index]);
+
+            assert(factor >= 0.0f && factor <= 1.0f);
+
+            return factor;
+        }
+
+        glm::quat unpackRotation(uint64_t packed)
+        {
+            glm::vec4 q = glm::unpackSnorm4x16(packed);
+            return glm::normalize(glm::quat(q.w, q.x, q.y, q.z));
+        }
+
+        /* The crossfaded clip becomes the state's clip. */
+        void finishCrossFade(AnimatedModel::AnimationState& state)
+        {
+            state.m_clip         = state.m_blend_clip;
+            state.m_time         = state.m_blend_time;
+            state.m_blend_clip   = AnimatedModel::NO_INDEX;
+            state.m_blend_weight = 0.0f;
+            state.m_blend_speed  = 0.0f;
+
+            std::swap(state.m_cursors, state.m_blend_cursors);
+        }
+
+#ifdef RGL_POSES_SSE
+        /* o = a * b of 4 quaternions. */
+        void mulQuaternions(__m128 ax, __m128 ay, __m128 az, __m128 aw,
+                            __m128 bx, __m128 by, __m128 bz, __m128 bw,
+                            __m128& ox, __m128& oy, __m128& oz, __m128& ow)
+        {
+            ox = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(aw, bx), _mm_mul_ps(ax, bw)), _mm_mul_ps(ay, bz)), _mm_mul_ps(az, by));
+            oy = _mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(aw, by), _mm_mul_ps(ax, bz)), _mm_mul_ps(ay, bw)), _mm_mul_ps(az, bx));
+            oz = _mm_add_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(aw, bz), _mm_mul_ps(ax, by)), _mm_mul_ps(ay, bx)), _mm_mul_ps(az, bw));
+            ow = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_mul_ps(aw, bw), _mm_mul_ps(ax, bx)), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+        }
+
+        __m128 dot4(__m128 ax, __m128 ay, __m128 az, __m128 aw, __m128 bx, __m128 by, __m128 bz, __m128 bw)
+        {
+            return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+        }
+#endif
+    }
+
+    void AnimatedModel::PoseBuffer::Resize(uint32_t nodes_count)
+    {
+        const uint32_t stride = (nodes_count + POSE_LANES - 1) / POSE_LANES * POSE_LANES;
+
+        if (stride == m_stride)
+        {
+            return;
+        }
+
+        m_stride = stride;
+        m_data.assign(size_t(m_stride) * COMPONENTS_COUNT, 0.0f);
+
+        for (uint32_t component : { RW, SX, SY, SZ })
+        {
+            std::fill_n((*this)[component], m_stride, 1.0f);
+        }
+    }
+
+    void AnimatedModel::PoseScratch::Resize(uint32_t nodes_count)
     {
-        if (m_assimp_scene->mNumAnimations > 0)
+        for (PoseBuffer* buffer : { &m_pose, &m_blend_pose, &m_layer_pose, &m_from, &m_to })
         {
-            /* Calc animation duration */
-            float ticks_per_second = (float)(m_assimp_scene->mAnimations[m_current_animation]->mTicksPerSecond != 0 ? m_assimp_scene->mAnimations[m_current_animation]->mTicksPerSecond : 25.0f);
-            float animation_duration = (float)m_assimp_scene->mAnimations[m_current_animation]->mDuration;
+            buffer->Resize(nodes_count);
+        }
 
-            m_current_animation_time += ticks_per_second * dt * m_animation_speed;
-            m_current_animation_time = fmod(m_current_animation_time, animation_duration);
+        m_factors          .resize(size_t(m_pose.m_stride) * 4);
+        m_global_transforms.resize(nodes_count);
+        m_is_animated.assign(nodes_count, 0);
+    }
 
-            ReadNodeHierarchy(m_current_animation_time, m_assimp_scene->mRootNode, glm::mat4(1.0f));
+    void AnimatedModel::PoseBuffer::Set(uint32_t node, const NodePose& pose)
+    {
+        (*this)[TX][node] = pose.m_position.x;
+        (*this)[TY][node] = pose.m_position.y;
+        (*this)[TZ][node] = pose.m_position.z;
+        (*this)[RX][node] = pose.m_rotation.x;
+        (*this)[RY][node] = pose.m_rotation.y;
+        (*this)[RZ][node] = pose.m_rotation.z;
+        (*this)[RW][node] = pose.m_rotation.w;
+        (*this)[SX][node] = pose.m_scaling.x;
+        (*this)[SY][node] = pose.m_scaling.y;
+        (*this)[SZ][node] = pose.m_scaling.z;
+    }
 
+    void AnimatedModel::BoneTransform(float dt, std::vector<glm::mat4>& transforms)
+    {
+        if (!m_clips.empty())
+        {
             transforms.resize(m_bones_count);
 
-            for (uint32_t i = 0; i < m_bones_count; ++i)
-            {
-                transforms[i] = m_bone_infos[i].m_final_transform;
-            }
+            Evaluate(m_state, dt, transforms.data());
         }
     }
 
     void AnimatedModel::BoneTransform(float dt, std::vector<glm::mat2x4>& transforms)
     {
-        if (m_assimp_scene->mNumAnimations > 0)
+        if (!m_clips.empty())
         {
-            /* Calc animation duration */
-            float ticks_per_second = (float)(m_assimp_scene->mAnimations[m_current_animation]->mTicksPerSecond != 0 ? m_assimp_scene->mAnimations[m_current_animation]->mTicksPerSecond : 25.0f);
-            float animation_duration = (float)m_assimp_scene->mAnimations[m_current_animation]->mDuration;
-
-            m_current_animation_time += ticks_per_second * dt * m_animation_speed;
-            m_current_animation_time = fmod(m_current_animation_time, animation_duration);
+            std::pmr::vector<glm::mat4> palette(m_bones_count, FrameAllocator::GetResource());
 
-            ReadNodeHierarchy(m_current_animation_time, m_assimp_scene->mRootNode, glm::mat4(1.0f));
+            Evaluate(m_state, dt, palette.data());
 
             transforms.resize(m_bones_count);
 
             for (uint32_t i = 0; i < m_bones_count; ++i)
             {
-                 glm::quat rotation(m_bone_infos[i].m_final_transform);
-                 glm::fdualquat dq (rotation, m_bone_infos[i].m_final_transform[3]);
+                 glm::quat rotation(palette[i]);
+                 glm::fdualquat dq (rotation, palette[i][3]);
 
                  glm::mat2x4 dq_mat(glm::vec4(dq.real.w, dq.real.x, dq.real.y, dq.real.z), 
                                     glm::vec4(dq.dual.w, dq.dual.x, dq.dual.y, dq.dual.z));
@@ -59,187 +192,843 @@ namespace RGL
         }
     }
 
-    void AnimatedModel::CalcInterpolatedScaling(aiVector3D& out, float animation_time, const aiNodeAnim* node_anim)
+    void AnimatedModel::Evaluate(AnimationState& state, float dt, glm::mat4* palette) const
     {
-        if (node_anim->mNumScalingKeys == 1)
+        if (m_clips.empty())
         {
-            out = node_anim->mScalingKeys[0].mValue;
             return;
         }
 
-        uint32_t scaling_index      = FindScaling(animation_time, node_anim);
-        uint32_t next_scaling_index = (scaling_index + 1);
+        state.m_clip = std::min(state.m_clip, uint32_t(m_clips.size()) - 1);
 
-        assert(next_scaling_index < node_anim->mNumScalingKeys);
+        const AnimationClip& clip = m_clips[state.m_clip];
 
-        float delta_time = (float)(node_anim->mScalingKeys[next_scaling_index].mTime - node_anim->mScalingKeys[scaling_index].mTime);
-        float factor     = (animation_time - (float)node_anim->mScalingKeys[scaling_index].mTime) / delta_time;
+        state.m_time = fmod(state.m_time + clip.m_ticks_per_second * dt * state.m_speed, clip.m_duration);
 
-        assert(factor >= 0.0f && factor <= 1.0f);
+        state.m_cursors      .resize(m_nodes.size());
+        state.m_blend_cursors.resize(m_nodes.size());
 
-        const aiVector3D& start = node_anim->mScalingKeys[scaling_index].mValue;
-        const aiVector3D& end   = node_anim->mScalingKeys[next_scaling_index].mValue;
+        if (state.m_blend_clip < m_clips.size())
+        {
+            const AnimationClip& blend_clip = m_clips[state.m_blend_clip];
+
+            state.m_blend_time = fmod(state.m_blend_time + blend_clip.m_ticks_per_second * dt * state.m_speed, blend_clip.m_duration);
 
-        aiVector3D delta = end - start;
-        out = start + factor * delta;
+            if (state.m_blend_speed > 0.0f)
+            {
+                state.m_blend_weight = std::min(state.m_blend_weight + dt * state.m_blend_speed, 1.0f);
+
+                if (state.m_blend_weight >= 1.0f)
+                {
+                    finishCrossFade(state);
+                }
+            }
+        }
+
+        for (auto& layer : state.m_layers)
+        {
+            if (layer.m_clip < m_clips.size())
+            {
+                const AnimationClip& layer_clip = m_clips[layer.m_clip];
+
+                layer.m_time = fmod(layer.m_time + layer_clip.m_ticks_per_second * dt * state.m_speed, layer_clip.m_duration);
+                layer.m_cursors.resize(m_nodes.size());
+            }
+        }
+
+        EvaluateNodes(state, palette);
     }
 
-    void AnimatedModel::CalcInterpolatedRotation(aiQuaternion& out, float animation_time, const aiNodeAnim* node_anim)
+    void AnimatedModel::EvaluateInstances(std::span<AnimationState> states, float dt, glm::mat4* palettes) const
     {
-        // we need at least two values to interpolate...
-        if (node_anim->mNumRotationKeys == 1)
+        RGL_TRACE_ZONE("AnimatedModel::EvaluateInstances");
+
+        JobSystem::ParallelFor(0, uint32_t(states.size()), INSTANCES_PER_JOB, [&](uint32_t begin, uint32_t end)
         {
-            out = node_anim->mRotationKeys[0].mValue;
-            return;
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                glm::mat4* palette = palettes + size_t(i) * m_bones_count;
+
+                if (states[i].m_update_interval > 1)
+                {
+                    EvaluateLod(states[i], dt, palette, i);
+                }
+                else
+                {
+                    states[i].m_lod_steps = 0;
+                    Evaluate(states[i], dt, palette);
+                }
+            }
+        });
+    }
+
+    void AnimatedModel::EvaluateLod(AnimationState& state, float dt, glm::mat4* palette, uint32_t stagger) const
+    {
+        state.m_lod_palettes.resize(size_t(m_bones_count) * 2);
+
+        glm::mat4* from = state.m_lod_palettes.data();
+        glm::mat4* to   = from + m_bones_count;
+
+        if (state.m_lod_steps == 0)
+        {
+            /* Entering the LOD from the current pose. The instances don't all update in the same frames afterwards. */
+            Evaluate(state, dt, from);
+
+            state.m_lod_steps = 1 + stagger % state.m_update_interval;
+            state.m_lod_step  = 0;
+
+            Evaluate(state, dt * float(state.m_lod_steps), to);
         }
+        else
+        {
+            if (state.m_lod_step >= state.m_lod_steps)
+            {
+                std::copy(to, to + m_bones_count, from);
+
+                state.m_lod_steps = state.m_update_interval;
+                state.m_lod_step  = 0;
 
-        uint32_t rotation_index      = FindRotation(animation_time, node_anim);
-        uint32_t next_rotation_index = (rotation_index + 1);
+                Evaluate(state, dt * float(state.m_lod_steps), to);
+            }
 
-        assert(next_rotation_index < node_anim->mNumRotationKeys);
+            state.m_lod_step++;
+        }
 
-        float delta_time = (float)(node_anim->mRotationKeys[next_rotation_index].mTime - node_anim->mRotationKeys[rotation_index].mTime);
-        float factor     = (animation_time - (float)node_anim->mRotationKeys[rotation_index].mTime) / delta_time;
+        /* A lerp of the matrices, the frames in between are close enough for the distant instances. */
+        const float t = float(state.m_lod_step) / float(state.m_lod_steps);
 
-        assert(factor >= 0.0f && factor <= 1.0f);
+        for (uint32_t i = 0; i < m_bones_count; ++i)
+        {
+            palette[i] = from[i] * (1.0f - t) + to[i] * t;
+        }
+    }
 
-        const aiQuaternion& start_rotation_quat = node_anim->mRotationKeys[rotation_index].mValue;
-        const aiQuaternion& end_rotation_quat   = node_anim->mRotationKeys[next_rotation_index].mValue;
+    void AnimatedModel::SelectAnimationLods(std::span<AnimationState> states, std::span<const glm::mat4> models, const glm::mat4& view_projection,
+                                            const glm::vec3& camera_position, float projection_scale, const AnimationLodSettings& settings) const
+    {
+        glm::vec4 planes[6];
+        GpuCulling::ExtractFrustumPlanes(view_projection, planes);
 
-        aiQuaternion::Interpolate(out, start_rotation_quat, end_rotation_quat, factor);
-        out = out.Normalize();
+        const size_t count = std::min(states.size(), models.size());
 
+        for (size_t i = 0; i < count; ++i)
+        {
+            const glm::mat4& model    = models[i];
+            const float      scale    = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+            const glm::vec3  center   = glm::vec3(model * glm::vec4(m_bounds_center, 1.0f));
+            const float      radius   = m_bounds_radius * scale;
+            const float      distance = glm::distance(center, camera_position);
+
+            AnimationState& state = states[i];
+
+            state.m_update_interval     = 1;
+            state.m_skipped_leaf_levels = 0;
+
+            if (!std::all_of(planes, planes + 6, [&](const glm::vec4& plane) { return glm::dot(glm::vec3(plane), center) + plane.w >= -radius; }))
+            {
+                state.m_update_interval     = std::max(settings.m_offscreen_interval, 1u);
+                state.m_skipped_leaf_levels = 2;
+                continue;
+            }
+
+            /* Full rate when the camera is inside the bounding sphere. */
+            if (distance <= radius)
+            {
+                continue;
+            }
+
+            const float projected_radius = radius * projection_scale / distance;
+
+            if (projected_radius < settings.m_full_rate_radius)
+            {
+                const uint32_t lod = std::min(1 + uint32_t(std::log2(settings.m_full_rate_radius / std::max(projected_radius, 1e-6f))), 31u);
+
+                state.m_update_interval = std::clamp(1u << lod, 1u, std::max(settings.m_max_update_interval, 1u));
+            }
+
+            if (projected_radius < settings.m_leaf_bones_radius)
+            {
+                state.m_skipped_leaf_levels = projected_radius < 0.5f * settings.m_leaf_bones_radius ? 2 : 1;
+            }
+        }
+    }
+
+    void AnimatedModel::EvaluateBatch(std::span<const Evaluation> evaluations, float dt)
+    {
+        RGL_TRACE_ZONE("AnimatedModel::EvaluateBatch");
+
+        JobSystem::ParallelFor(0, uint32_t(evaluations.size()), INSTANCES_PER_JOB, [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                evaluations[i].m_model->Evaluate(*evaluations[i].m_state, dt, evaluations[i].m_palette);
+            }
+        });
     }
-    void AnimatedModel::CalcInterpolatedPosition(aiVector3D& out, float animation_time, const aiNodeAnim* node_anim)
+
+    void AnimatedModel::CrossFade(AnimationState& state, uint32_t clip, float duration) const
     {
-        if (node_anim->mNumPositionKeys == 1)
+        if (clip >= m_clips.size())
         {
-            out = node_anim->mPositionKeys[0].mValue;
             return;
         }
 
-        uint32_t position_index      = FindPosition(animation_time, node_anim);
-        uint32_t next_position_index = (position_index + 1);
+        /* Interrupted past the half, the fade goes on from the clip it was fading into. */
+        if (state.m_blend_clip < m_clips.size() && state.m_blend_weight >= 0.5f)
+        {
+            finishCrossFade(state);
+        }
 
-        assert(next_position_index < node_anim->mNumPositionKeys);
+        if (clip == state.m_clip || duration <= 0.0f)
+        {
+            if (clip != state.m_clip)
+            {
+                state.m_clip = clip;
+                state.m_time = 0.0f;
+            }
 
-        float delta_time = (float)(node_anim->mPositionKeys[next_position_index].mTime - node_anim->mPositionKeys[position_index].mTime);
-        float factor     = (animation_time - (float)node_anim->mPositionKeys[position_index].mTime) / delta_time;
+            state.m_blend_clip   = NO_INDEX;
+            state.m_blend_weight = 0.0f;
+            state.m_blend_speed  = 0.0f;
+            return;
+        }
 
-        assert(factor >= 0.0f && factor <= 1.0f);
+        state.m_blend_clip   = clip;
+        state.m_blend_time   = 0.0f;
+        state.m_blend_weight = 0.0f;
+        state.m_blend_speed  = 1.0f / duration;
+    }
 
-        const aiVector3D& start = node_anim->mPositionKeys[position_index].mValue;
-        const aiVector3D& end  = node_anim->mPositionKeys[next_position_index].mValue;
+    void AnimatedModel::BuildNodes(const aiNode* node, uint32_t parent_index, std::unordered_map<std::string, uint32_t>& node_indices)
+    {
+        const uint32_t node_index = uint32_t(m_nodes.size());
+        const auto     bone_it    = m_bones_mapping.find(node->mName.data);
+
+        aiVector3D   scaling, position;
+        aiQuaternion rotation;
+        node->mTransformation.Decompose(scaling, rotation, position);
+
+        const NodePose bind_pose = { vec3_cast(position), glm::normalize(quat_cast(rotation)), vec3_cast(scaling) };
 
-        aiVector3D delta = end - start;
-        out = start + factor * delta;
+        m_nodes.push_back({ mat4_cast(node->mTransformation), bind_pose, parent_index, bone_it != m_bones_mapping.end() ? bone_it->second : NO_INDEX, 0 });
+        node_indices[node->mName.data] = node_index;
+
+        for (uint32_t i = 0; i < node->mNumChildren; i++)
+        {
+            BuildNodes(node->mChildren[i], node_index, node_indices);
+        }
     }
 
-    uint32_t AnimatedModel::FindScaling(float animation_time, const aiNodeAnim* node_anim)
+    void AnimatedModel::LoadAnimations(const aiScene* scene, const std::unordered_map<std::string, uint32_t>& node_indices)
     {
-        assert(node_anim->mNumScalingKeys > 0);
+        m_clips.resize(scene->mNumAnimations);
 
-        for (uint32_t i = 0; i < node_anim->mNumScalingKeys - 1; i++)
+        for (uint32_t a = 0; a < scene->mNumAnimations; ++a)
         {
-            if (animation_time < (float)node_anim->mScalingKeys[i + 1].mTime)
+            const aiAnimation* animation = scene->mAnimations[a];
+            AnimationClip&     clip      = m_clips[a];
+
+            clip.m_name             = animation->mName.C_Str();
+            clip.m_duration         = float(animation->mDuration);
+            clip.m_ticks_per_second = float(animation->mTicksPerSecond != 0 ? animation->mTicksPerSecond : 25.0f);
+            clip.m_node_channels.assign(m_nodes.size(), NO_INDEX);
+            clip.m_channels.reserve(animation->mNumChannels);
+
+            for (uint32_t c = 0; c < animation->mNumChannels; ++c)
+            {
+                const aiNodeAnim* node_anim = animation->mChannels[c];
+                const auto        node_it   = node_indices.find(node_anim->mNodeName.data);
+
+                /* A channel of a node that isn't in the hierarchy animates nothing. */
+                if (node_it == node_indices.end() || node_anim->mNumPositionKeys == 0 || node_anim->mNumRotationKeys == 0 || node_anim->mNumScalingKeys == 0)
+                {
+                    continue;
+                }
+
+                AnimationChannel channel;
+
+                channel.m_position_times.reserve(node_anim->mNumPositionKeys);
+                channel.m_positions     .reserve(node_anim->mNumPositionKeys);
+
+                for (uint32_t k = 0; k < node_anim->mNumPositionKeys; ++k)
+                {
+                    channel.m_position_times.push_back(float(node_anim->mPositionKeys[k].mTime));
+                    channel.m_positions     .push_back(vec3_cast(node_anim->mPositionKeys[k].mValue));
+                }
+
+                channel.m_rotation_times.reserve(node_anim->mNumRotationKeys);
+                channel.m_rotations     .reserve(node_anim->mNumRotationKeys);
+
+                for (uint32_t k = 0; k < node_anim->mNumRotationKeys; ++k)
+                {
+                    glm::quat q = glm::normalize(quat_cast(node_anim->mRotationKeys[k].mValue));
+
+                    channel.m_rotation_times.push_back(float(node_anim->mRotationKeys[k].mTime));
+                    channel.m_rotations     .push_back(glm::packSnorm4x16(glm::vec4(q.x, q.y, q.z, q.w)));
+                }
+
+                channel.m_scaling_times.reserve(node_anim->mNumScalingKeys);
+                channel.m_scalings     .reserve(node_anim->mNumScalingKeys);
+
+                for (uint32_t k = 0; k < node_anim->mNumScalingKeys; ++k)
+                {
+                    channel.m_scaling_times.push_back(float(node_anim->mScalingKeys[k].mTime));
+                    channel.m_scalings     .push_back(vec3_cast(node_anim->mScalingKeys[k].mValue));
+                }
+
+                clip.m_node_channels[node_it->second] = uint32_t(clip.m_channels.size());
+                clip.m_channels.push_back(std::move(channel));
+            }
+
+            clip.m_additive_base.Resize(uint32_t(m_nodes.size()));
+
+            for (uint32_t n = 0; n < m_nodes.size(); ++n)
             {
-                return i;
+                NodePose base = m_nodes[n].m_bind_pose;
+
+                if (clip.m_node_channels[n] != NO_INDEX)
+                {
+                    const AnimationChannel& channel = clip.m_channels[clip.m_node_channels[n]];
+
+                    base = { channel.m_positions[0], unpackRotation(channel.m_rotations[0]), channel.m_scalings[0] };
+                }
+
+                const auto inverse = [](float scaling) { return scaling != 0.0f ? 1.0f / scaling : 1.0f; };
+
+                clip.m_additive_base.Set(n, { -base.m_position,
+                                              glm::conjugate(base.m_rotation),
+                                              glm::vec3(inverse(base.m_scaling.x), inverse(base.m_scaling.y), inverse(base.m_scaling.z)) });
             }
         }
 
-        assert(0);
+        m_animations_count = uint32_t(m_clips.size());
+    }
 
-        return 0;
+    void AnimatedModel::SampleClip(const AnimationClip& clip, float animation_time, std::vector<KeyCursors>& cursors, PoseScratch& scratch, PoseBuffer& pose,
+                                   uint32_t begin, uint32_t end, uint32_t min_height) const
+    {
+        PoseBuffer& from = scratch.m_from;
+        PoseBuffer& to   = scratch.m_to;
+
+        float* position_factors = scratch.m_factors.data();
+        float* rotation_factors = position_factors + pose.m_stride;
+        float* scaling_factors  = rotation_factors + pose.m_stride;
+
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            const uint32_t channel_index = clip.m_node_channels[i];
+
+            if (channel_index == NO_INDEX || m_nodes[i].m_height < min_height)
+            {
+                from.Set(i, m_nodes[i].m_bind_pose);
+                to  .Set(i, m_nodes[i].m_bind_pose);
+
+                position_factors[i] = rotation_factors[i] = scaling_factors[i] = 0.0f;
+                continue;
+            }
+
+            const AnimationChannel& channel      = clip.m_channels[channel_index];
+                  KeyCursors&       node_cursors = cursors[i];
+
+            /* A single key is both ends, with the factor of 0. */
+            const uint32_t position_index = findKey(animation_time, channel.m_position_times, node_cursors.m_position);
+            const uint32_t rotation_index = findKey(animation_time, channel.m_rotation_times, node_cursors.m_rotation);
+            const uint32_t scaling_index  = findKey(animation_time, channel.m_scaling_times,  node_cursors.m_scaling);
+            const uint32_t position_next  = std::min(position_index + 1, uint32_t(channel.m_positions.size()) - 1);
+            const uint32_t rotation_next  = std::min(rotation_index + 1, uint32_t(channel.m_rotations.size()) - 1);
+            const uint32_t scaling_next   = std::min(scaling_index  + 1, uint32_t(channel.m_scalings .size()) - 1);
+
+            from.Set(i, { channel.m_positions[position_index], unpackRotation(channel.m_rotations[rotation_index]), channel.m_scalings[scaling_index] });
+            to  .Set(i, { channel.m_positions[position_next],  unpackRotation(channel.m_rotations[rotation_next]),  channel.m_scalings[scaling_next]  });
+
+            position_factors[i] = position_next != position_index ? keyFactor(animation_time, channel.m_position_times, position_index) : 0.0f;
+            rotation_factors[i] = rotation_next != rotation_index ? keyFactor(animation_time, channel.m_rotation_times, rotation_index) : 0.0f;
+            scaling_factors [i] = scaling_next  != scaling_index  ? keyFactor(animation_time, channel.m_scaling_times,  scaling_index)  : 0.0f;
+
+            scratch.m_is_animated[i] = 1;
+        }
+
+        BlendPoses(from, to, position_factors, rotation_factors, scaling_factors, pose, begin, end);
     }
 
-    uint32_t AnimatedModel::FindRotation(float animation_time, const aiNodeAnim* node_anim)
+    void AnimatedModel::BlendPoses(const PoseBuffer& a, const PoseBuffer& b, const float* position_factors, const float* rotation_factors, const float* scaling_factors,
+                                   PoseBuffer& out, uint32_t begin, uint32_t end)
     {
-        assert(node_anim->mNumRotationKeys > 0);
+        using P = PoseBuffer;
 
-        for (uint32_t i = 0; i < node_anim->mNumRotationKeys - 1; i++)
+#ifdef RGL_POSES_SSE
+        const __m128 sign_mask = _mm_set1_ps(-0.0f);
+
+        /* The whole lanes, the results of the padding aren't used. */
+        end = std::min((end + POSE_LANES - 1) / POSE_LANES * POSE_LANES, a.m_stride);
+
+        for (uint32_t i = begin; i < end; i += POSE_LANES)
         {
-            if (animation_time < (float)node_anim->mRotationKeys[i + 1].mTime)
+            const auto lerp = [&](uint32_t component, __m128 factor)
+            {
+                __m128 va = _mm_loadu_ps(a[component] + i);
+                _mm_storeu_ps(out[component] + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b[component] + i), va), factor)));
+            };
+
+            const __m128 position_factor = _mm_loadu_ps(position_factors + i);
+            const __m128 rotation_factor = _mm_loadu_ps(rotation_factors + i);
+            const __m128 scaling_factor  = _mm_loadu_ps(scaling_factors  + i);
+
+            lerp(P::TX, position_factor);
+            lerp(P::TY, position_factor);
+            lerp(P::TZ, position_factor);
+            lerp(P::SX, scaling_factor);
+            lerp(P::SY, scaling_factor);
+            lerp(P::SZ, scaling_factor);
+
+            __m128 ax = _mm_loadu_ps(a[P::RX] + i), ay = _mm_loadu_ps(a[P::RY] + i), az = _mm_loadu_ps(a[P::RZ] + i), aw = _mm_loadu_ps(a[P::RW] + i);
+            __m128 bx = _mm_loadu_ps(b[P::RX] + i), by = _mm_loadu_ps(b[P::RY] + i), bz = _mm_loadu_ps(b[P::RZ] + i), bw = _mm_loadu_ps(b[P::RW] + i);
+
+            /* The shorter way, b is flipped into a's hemisphere. */
+            const __m128 sign = _mm_and_ps(dot4(ax, ay, az, aw, bx, by, bz, bw), sign_mask);
+
+            bx = _mm_xor_ps(bx, sign);
+            by = _mm_xor_ps(by, sign);
+            bz = _mm_xor_ps(bz, sign);
+            bw = _mm_xor_ps(bw, sign);
+
+            __m128 rx = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(bx, ax), rotation_factor));
+            __m128 ry = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(by, ay), rotation_factor));
+            __m128 rz = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(bz, az), rotation_factor));
+            __m128 rw = _mm_add_ps(aw, _mm_mul_ps(_mm_sub_ps(bw, aw), rotation_factor));
+
+            const __m128 inverse_length = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(dot4(rx, ry, rz, rw, rx, ry, rz, rw)));
+
+            _mm_storeu_ps(out[P::RX] + i, _mm_mul_ps(rx, inverse_length));
+            _mm_storeu_ps(out[P::RY] + i, _mm_mul_ps(ry, inverse_length));
+            _mm_storeu_ps(out[P::RZ] + i, _mm_mul_ps(rz, inverse_length));
+            _mm_storeu_ps(out[P::RW] + i, _mm_mul_ps(rw, inverse_length));
+        }
+#else
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            for (uint32_t component : { P::TX, P::TY, P::TZ })
+            {
+                out[component][i] = glm::mix(a[component][i], b[component][i], position_factors[i]);
+            }
+
+            for (uint32_t component : { P::SX, P::SY, P::SZ })
+            {
+                out[component][i] = glm::mix(a[component][i], b[component][i], scaling_factors[i]);
+            }
+
+            const glm::vec4 qa(a[P::RX][i], a[P::RY][i], a[P::RZ][i], a[P::RW][i]);
+            const glm::vec4 qb(b[P::RX][i], b[P::RY][i], b[P::RZ][i], b[P::RW][i]);
+            const glm::vec4 q = glm::normalize(glm::mix(qa, glm::dot(qa, qb) < 0.0f ? -qb : qb, rotation_factors[i]));
+
+            out[P::RX][i] = q.x;
+            out[P::RY][i] = q.y;
+            out[P::RZ][i] = q.z;
+            out[P::RW][i] = q.w;
+        }
+#endif
+    }
+
+    void AnimatedModel::AddPose(PoseBuffer& pose, const PoseBuffer& layer, const PoseBuffer& inverse_base, float weight, uint32_t begin, uint32_t end)
+    {
+        using P = PoseBuffer;
+
+#ifdef RGL_POSES_SSE
+        const __m128 w         = _mm_set1_ps(weight);
+        const __m128 one       = _mm_set1_ps(1.0f);
+        const __m128 sign_mask = _mm_set1_ps(-0.0f);
+
+        end = std::min((end + POSE_LANES - 1) / POSE_LANES * POSE_LANES, pose.m_stride);
+
+        for (uint32_t i = begin; i < end; i += POSE_LANES)
+        {
+            /* pose.t += w * (layer.t - base.t) */
+            for (uint32_t component : { P::TX, P::TY, P::TZ })
+            {
+                __m128 delta = _mm_add_ps(_mm_loadu_ps(layer[component] + i), _mm_loadu_ps(inverse_base[component] + i));
+                _mm_storeu_ps(pose[component] + i, _mm_add_ps(_mm_loadu_ps(pose[component] + i), _mm_mul_ps(delta, w)));
+            }
+
+            /* pose.s *= mix(1, layer.s / base.s, w) */
+            for (uint32_t component : { P::SX, P::SY, P::SZ })
+            {
+                __m128 ratio = _mm_mul_ps(_mm_loadu_ps(layer[component] + i), _mm_loadu_ps(inverse_base[component] + i));
+                _mm_storeu_ps(pose[component] + i, _mm_mul_ps(_mm_loadu_ps(pose[component] + i), _mm_add_ps(one, _mm_mul_ps(_mm_sub_ps(ratio, one), w))));
+            }
+
+            /* pose.r = nlerp(identity, layer.r * inverse(base.r), w) * pose.r */
+            __m128 dx, dy, dz, dw;
+            mulQuaternions(_mm_loadu_ps(layer[P::RX]        + i), _mm_loadu_ps(layer[P::RY]        + i), _mm_loadu_ps(layer[P::RZ]        + i), _mm_loadu_ps(layer[P::RW]        + i),
+                           _mm_loadu_ps(inverse_base[P::RX] + i), _mm_loadu_ps(inverse_base[P::RY] + i), _mm_loadu_ps(inverse_base[P::RZ] + i), _mm_loadu_ps(inverse_base[P::RW] + i),
+                           dx, dy, dz, dw);
+
+            const __m128 sign = _mm_and_ps(dw, sign_mask);
+
+            dx = _mm_mul_ps(_mm_xor_ps(dx, sign), w);
+            dy = _mm_mul_ps(_mm_xor_ps(dy, sign), w);
+            dz = _mm_mul_ps(_mm_xor_ps(dz, sign), w);
+            dw = _mm_add_ps(_mm_sub_ps(one, w), _mm_mul_ps(_mm_xor_ps(dw, sign), w));
+
+            const __m128 inverse_length = _mm_div_ps(one, _mm_sqrt_ps(dot4(dx, dy, dz, dw, dx, dy, dz, dw)));
+
+            __m128 rx, ry, rz, rw;
+            mulQuaternions(_mm_mul_ps(dx, inverse_length), _mm_mul_ps(dy, inverse_length), _mm_mul_ps(dz, inverse_length), _mm_mul_ps(dw, inverse_length),
+                           _mm_loadu_ps(pose[P::RX] + i), _mm_loadu_ps(pose[P::RY] + i), _mm_loadu_ps(pose[P::RZ] + i), _mm_loadu_ps(pose[P::RW] + i),
+                           rx, ry, rz, rw);
+
+            _mm_storeu_ps(pose[P::RX] + i, rx);
+            _mm_storeu_ps(pose[P::RY] + i, ry);
+            _mm_storeu_ps(pose[P::RZ] + i, rz);
+            _mm_storeu_ps(pose[P::RW] + i, rw);
+        }
+#else
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            for (uint32_t component : { P::TX, P::TY, P::TZ })
+            {
+                pose[component][i] += (layer[component][i] + inverse_base[component][i]) * weight;
+            }
+
+            for (uint32_t component : { P::SX, P::SY, P::SZ })
             {
-                return i;
+                pose[component][i] *= glm::mix(1.0f, layer[component][i] * inverse_base[component][i], weight);
             }
+
+            glm::quat delta = glm::quat(layer       [P::RW][i], layer       [P::RX][i], layer       [P::RY][i], layer       [P::RZ][i]) *
+                              glm::quat(inverse_base[P::RW][i], inverse_base[P::RX][i], inverse_base[P::RY][i], inverse_base[P::RZ][i]);
+
+            delta = delta.w < 0.0f ? -delta : delta;
+            delta = glm::normalize(glm::quat(1.0f - weight + delta.w * weight, delta.x * weight, delta.y * weight, delta.z * weight));
+
+            const glm::quat q = delta * glm::quat(pose[P::RW][i], pose[P::RX][i], pose[P::RY][i], pose[P::RZ][i]);
+
+            pose[P::RX][i] = q.x;
+            pose[P::RY][i] = q.y;
+            pose[P::RZ][i] = q.z;
+            pose[P::RW][i] = q.w;
+        }
+#endif
+    }
+
+    void AnimatedModel::SamplePose(AnimationState& state, PoseScratch& scratch, uint32_t begin, uint32_t end) const
+    {
+        PoseBuffer& pose = scratch.m_pose;
+
+        SampleClip(m_clips[state.m_clip], state.m_time, state.m_cursors, scratch, pose, begin, end, state.m_skipped_leaf_levels);
+
+        if (state.m_blend_clip < m_clips.size() && state.m_blend_weight > 0.0f)
+        {
+            SampleClip(m_clips[state.m_blend_clip], state.m_blend_time, state.m_blend_cursors, scratch, scratch.m_blend_pose, begin, end, state.m_skipped_leaf_levels);
+
+            float* blend_factors = scratch.m_factors.data() + size_t(pose.m_stride) * 3;
+            std::fill(blend_factors + begin, blend_factors + std::min((end + POSE_LANES - 1) / POSE_LANES * POSE_LANES, pose.m_stride), state.m_blend_weight);
+
+            BlendPoses(pose, scratch.m_blend_pose, blend_factors, blend_factors, blend_factors, pose, begin, end);
+        }
+
+        for (auto& layer : state.m_layers)
+        {
+            if (layer.m_clip < m_clips.size() && layer.m_weight > 0.0f)
+            {
+                SampleClip(m_clips[layer.m_clip], layer.m_time, layer.m_cursors, scratch, scratch.m_layer_pose, begin, end, state.m_skipped_leaf_levels);
+                AddPose(pose, scratch.m_layer_pose, m_clips[layer.m_clip].m_additive_base, layer.m_weight, begin, end);
+            }
+        }
+    }
+
+    void AnimatedModel::ConcatenatePose(PoseScratch& scratch, glm::mat4* palette) const
+    {
+        using P = PoseBuffer;
+
+        const PoseBuffer&             pose              = scratch.m_pose;
+              std::vector<glm::mat4>& global_transforms = scratch.m_global_transforms;
+
+        /* The parents come before their children, their global transforms are ready. */
+        for (uint32_t i = 0; i < m_nodes.size(); ++i)
+        {
+            const Node&     node           = m_nodes[i];
+                  glm::mat4 node_transform = node.m_transform;
+
+            if (scratch.m_is_animated[i])
+            {
+                const glm::vec3 position(pose[P::TX][i], pose[P::TY][i], pose[P::TZ][i]);
+                const glm::quat rotation(pose[P::RW][i], pose[P::RX][i], pose[P::RY][i], pose[P::RZ][i]);
+                const glm::vec3 scaling (pose[P::SX][i], pose[P::SY][i], pose[P::SZ][i]);
+
+                // Combine the above transformations
+                node_transform = glm::translate(glm::mat4(1.0), position) * glm::toMat4(rotation) * glm::scale(glm::mat4(1.0), scaling);
+            }
+
+            global_transforms[i] = node.m_parent_index == NO_INDEX ? node_transform : global_transforms[node.m_parent_index] * node_transform;
+
+            if (node.m_bone_index != NO_INDEX)
+            {
+                palette[node.m_bone_index] = m_global_inverse_transform * global_transforms[i] * m_bone_infos[node.m_bone_index].m_bone_offset;
+            }
+        }
+    }
+
+    void AnimatedModel::EvaluateNodes(AnimationState& state, glm::mat4* palette) const
+    {
+        /*
+         * Per thread, the instances are evaluated by the jobs. A scratch per nesting level - a thread waiting
+         * for the sampling jobs below runs the other queued jobs, another instance's evaluation among them.
+         */
+        thread_local std::vector<std::unique_ptr<PoseScratch>> scratches;
+        thread_local uint32_t                                  depth = 0;
+
+        if (depth == scratches.size())
+        {
+            scratches.push_back(std::make_unique<PoseScratch>());
+        }
+
+        PoseScratch&   scratch     = *scratches[depth++];
+        const uint32_t nodes_count = uint32_t(m_nodes.size());
+
+        scratch.Resize(nodes_count);
+
+        if (nodes_count >= PARALLEL_SAMPLING_MIN_NODES)
+        {
+            JobSystem::ParallelFor(0, nodes_count, NODES_PER_JOB, [&](uint32_t begin, uint32_t end)
+            {
+                SamplePose(state, scratch, begin, end);
+            });
+        }
+        else
+        {
+            SamplePose(state, scratch, 0, nodes_count);
         }
 
-        assert(0);
+        ConcatenatePose(scratch, palette);
 
-        return 0;
+        depth--;
     }
 
-    uint32_t AnimatedModel::FindPosition(float animation_time, const aiNodeAnim* node_anim)
+    bool AnimatedModel::CreateSkinnedBuffers(uint32_t instances_count)
     {
-        for (uint32_t i = 0; i < node_anim->mNumPositionKeys - 1; i++)
+        if (instances_count <= m_skinned_instances_count)
+        {
+            return true;
+        }
+
+        if (!m_skinning_shader)
         {
-            if (animation_time < (float)node_anim->mPositionKeys[i + 1].mTime)
+            m_skinning_shader = std::make_shared<Shader>("src/core/shaders/skinning.comp");
+
+            if (!m_skinning_shader->link())
             {
-                return i;
+                fprintf(stderr, "AnimatedModel: the skinning shader failed to link.\n");
+
+                m_skinning_shader.reset();
+                return false;
             }
         }
 
-        assert(0);
+        ReleaseSkinnedBuffers();
+
+        glCreateBuffers     (1, &m_skinned_vbo_name);
+        glNamedBufferStorage(m_skinned_vbo_name, GLsizeiptr(sizeof(SkinnedVertex)) * m_vertices_count * instances_count, nullptr, 0);
+        GpuMemory::TrackBuffer(m_skinned_vbo_name, "AnimatedModel");
+
+        /* The instance i is at the base vertex i * m_vertices_count, all the attributes come from the single buffer. */
+        glCreateVertexArrays      (1, &m_skinned_vao_name);
+        glVertexArrayVertexBuffer (m_skinned_vao_name, 0 /* bindingindex*/, m_skinned_vbo_name, 0, sizeof(SkinnedVertex) /*stride*/);
+        glVertexArrayElementBuffer(m_skinned_vao_name, m_ibo_name);
 
-        return 0;
+        const GLuint offsets[] = { offsetof(SkinnedVertex, position), offsetof(SkinnedVertex, texcoord), offsetof(SkinnedVertex, normal), offsetof(SkinnedVertex, tangent) };
+        const GLint  sizes  [] = { 3, 2, 3, 3 };
+
+        for (GLuint i = 0; i < std::size(offsets); ++i)
+        {
+            glEnableVertexArrayAttrib (m_skinned_vao_name, i /*attribindex*/);
+            glVertexArrayAttribFormat (m_skinned_vao_name, i /*attribindex */, sizes[i], GL_FLOAT, GL_FALSE, offsets[i] /*relativeoffset*/);
+            glVertexArrayAttribBinding(m_skinned_vao_name, i /*attribindex*/, 0 /*bindingindex*/);
+        }
+
+        m_skinned_instances_count = instances_count;
+
+        return true;
     }
 
-    const aiNodeAnim* AnimatedModel::FindNodeAnim(const aiAnimation* animation, std::string_view node_name)
+    void AnimatedModel::Skin(uint32_t instances_count)
     {
-        for (uint32_t i = 0; i < animation->mNumChannels; i++)
+        RGL_TRACE_ZONE("AnimatedModel::Skin");
+
+        instances_count = std::min(instances_count, m_skinned_instances_count);
+
+        if (instances_count == 0)
         {
-            const aiNodeAnim* node_anim = animation->mChannels[i];
+            return;
+        }
+
+        /* The vertex buffer is read as 32-bit words, the offsets are in words too. */
+        m_skinning_shader->bind();
+        m_skinning_shader->setUniform("u_vertices_count",   m_vertices_count);
+        m_skinning_shader->setUniform("u_bones_count",      m_bones_count);
+        m_skinning_shader->setUniform("u_positions_offset", GLuint(m_positions_offset    / sizeof(float)));
+        m_skinning_shader->setUniform("u_texcoords_offset", GLuint(m_texcoords_offset    / sizeof(float)));
+        m_skinning_shader->setUniform("u_normals_offset",   GLuint(m_normals_offset      / sizeof(float)));
+        m_skinning_shader->setUniform("u_tangents_offset",  m_tangents_offset < 0 ? NO_INDEX : GLuint(m_tangents_offset / sizeof(float)));
+        m_skinning_shader->setUniform("u_weights_offset",   GLuint(m_bone_weights_offset / sizeof(float)));
+        m_skinning_shader->setUniform("u_ids_offset",       GLuint(m_bone_ids_offset     / sizeof(float)));
+        m_skinning_shader->setUniform("u_id_size",          m_bone_id_size);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SKINNING_VERTICES_SSBO_BINDING_INDEX, m_vbo_name);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SKINNED_VERTICES_SSBO_BINDING_INDEX,  m_skinned_vbo_name);
+
+        glDispatchCompute((m_vertices_count + SKINNING_GROUP_SIZE - 1) / SKINNING_GROUP_SIZE, instances_count, 1);
+        glMemoryBarrier  (GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    }
+
+    void AnimatedModel::RenderSkinned(uint32_t instances_count)
+    {
+        instances_count = std::min(instances_count, m_skinned_instances_count);
 
-            if (std::string(node_anim->mNodeName.data) == node_name)
+        if (instances_count == 0)
+        {
+            return;
+        }
+
+        std::pmr::vector<GLsizei>     counts      (instances_count, FrameAllocator::GetResource());
+        std::pmr::vector<const void*> indices     (instances_count, FrameAllocator::GetResource());
+        std::pmr::vector<GLint>       base_vertices(instances_count, FrameAllocator::GetResource());
+
+        GLState::BindVertexArray(m_skinned_vao_name);
+
+        for (uint32_t i = 0; i < m_mesh_parts.size(); ++i)
+        {
+            if (!m_materials.empty())
+            {
+                const uint32_t material_index = m_mesh_parts[i].m_material_index;
+
+                assert(material_index < m_materials.size());
+
+                m_materials[material_index]->Bind();
+            }
+
+            for (uint32_t instance = 0; instance < instances_count; ++instance)
             {
-                return node_anim;
+                counts       [instance] = m_mesh_parts[i].GetLodIndicesCount();
+                indices      [instance] = (const void*)(GetIndexSize() * m_mesh_parts[i].GetLodBaseIndex());
+                base_vertices[instance] = m_mesh_parts[i].m_base_vertex + instance * m_vertices_count;
             }
+
+            glMultiDrawElementsBaseVertex(GLenum(m_draw_mode), counts.data(), m_index_type, indices.data(), instances_count, base_vertices.data());
         }
 
-        return nullptr;
+        GLState::BindTextureUnit(0, 0);
     }
 
-    void AnimatedModel::ReadNodeHierarchy(float animation_time, const aiNode* node, const glm::mat4& parent_transform)
+    void AnimatedModel::ReleaseSkinnedBuffers()
     {
-              std::string  node_name      = std::string(node->mName.data);
-        const aiAnimation* animation      = m_assimp_scene->mAnimations[m_current_animation];
-              glm::mat4    node_transform = mat4_cast(node->mTransformation);
-        const aiNodeAnim* node_anim       = FindNodeAnim(animation, node_name);
+        if (m_skinned_vao_name != 0)
+        {
+            glDeleteVertexArrays(1, &m_skinned_vao_name);
+            GLState::OnVertexArrayDeleted(m_skinned_vao_name);
+        }
 
-        if (node_anim)
+        if (m_skinned_vbo_name != 0)
         {
-            // Interpolate scaling and generate scaling transformation matrix
-            aiVector3D scaling;
-            CalcInterpolatedScaling(scaling, animation_time, node_anim);
-            glm::mat4 scaling_mat = glm::scale(glm::mat4(1.0), vec3_cast(scaling));
+            GpuMemory::UntrackBuffer(m_skinned_vbo_name);
+            glDeleteBuffers(1, &m_skinned_vbo_name);
+        }
+
+        m_skinned_vao_name        = 0;
+        m_skinned_vbo_name        = 0;
+        m_skinned_instances_count = 0;
+    }
+
+    bool AnimatedModel::BakeAnimations(float frames_per_second)
+    {
+        RGL_TRACE_ZONE("AnimatedModel::BakeAnimations");
+
+        GLint max_size = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
 
-            // Interpolate rotation and generate rotation transformation matrix
-            aiQuaternion rotation_quat;
-            CalcInterpolatedRotation(rotation_quat, animation_time, node_anim);
-            glm::quat rotation     = quat_cast(rotation_quat);
-            glm::mat4 rotation_mat = glm::toMat4(rotation);
+        ReleaseBakedAnimations();
 
-            // Interpolate translation and generate translation transformation matrix
-            aiVector3D translation;
-            CalcInterpolatedPosition(translation, animation_time, node_anim);
-            glm::mat4 translation_mat = glm::translate(glm::mat4(1.0), vec3_cast(translation));
+        uint32_t frames_count = 0;
 
-            // Combine the above transformations
-            node_transform = translation_mat * rotation_mat * scaling_mat;
+        for (const auto& clip : m_clips)
+        {
+            const float duration_seconds = clip.m_duration / clip.m_ticks_per_second;
+
+            m_baked_clips.push_back({ frames_count, std::max(1u, uint32_t(std::ceil(duration_seconds * frames_per_second))) });
+            frames_count += m_baked_clips.back().m_frames_count;
         }
 
-        glm::mat4 global_transform = parent_transform * node_transform;
+        const uint32_t width = m_bones_count * 3;
 
-        if (m_bones_mapping.find(node_name) != m_bones_mapping.end())
+        if (frames_count == 0 || width == 0 || width > uint32_t(max_size) || frames_count > uint32_t(max_size))
         {
-            uint32_t bone_index = m_bones_mapping[node_name];
-            m_bone_infos[bone_index].m_final_transform = m_global_inverse_transform * global_transform * m_bone_infos[bone_index].m_bone_offset;
+            fprintf(stderr, "AnimatedModel: can't bake %u frames of %u bones into a texture.\n", frames_count, m_bones_count);
+
+            m_baked_clips.clear();
+            return false;
         }
 
-        for (uint32_t i = 0; i < node->mNumChildren; i++)
+        std::vector<glm::vec4> texels(size_t(width) * frames_count);
+
+        for (uint32_t c = 0; c < m_clips.size(); ++c)
+        {
+            const BakedClip& baked_clip = m_baked_clips[c];
+
+            JobSystem::ParallelFor(0, baked_clip.m_frames_count, 8, [&](uint32_t begin, uint32_t end)
+            {
+                std::vector<glm::mat4> palette(m_bones_count);
+                AnimationState         state;
+
+                state.m_clip = c;
+
+                for (uint32_t f = begin; f < end; ++f)
+                {
+                    state.m_time = float(f) / frames_per_second * m_clips[c].m_ticks_per_second;
+
+                    Evaluate(state, 0.0f, palette.data());
+
+                    glm::vec4* row = texels.data() + size_t(baked_clip.m_first_frame + f) * width;
+
+                    for (uint32_t b = 0; b < m_bones_count; ++b)
+                    {
+                        const glm::mat4 m = glm::transpose(palette[b]);
+
+                        row[b * 3 + 0] = m[0];
+                        row[b * 3 + 1] = m[1];
+                        row[b * 3 + 2] = m[2];
+                    }
+                }
+            });
+        }
+
+        glCreateTextures   (GL_TEXTURE_2D, 1, &m_baked_texture_name);
+        glTextureStorage2D (m_baked_texture_name, 1, GL_RGBA32F, width, frames_count);
+        glTextureSubImage2D(m_baked_texture_name, 0, 0, 0, width, frames_count, GL_RGBA, GL_FLOAT, texels.data());
+        glTextureParameteri(m_baked_texture_name, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(m_baked_texture_name, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        GpuMemory::TrackTexture(m_baked_texture_name, "AnimatedModel");
+
+        m_baked_frames_per_second = frames_per_second;
+
+        return true;
+    }
+
+    void AnimatedModel::BindBakedAnimations(GLuint unit) const
+    {
+        GLState::BindTextureUnit(unit, m_baked_texture_name);
+    }
+
+    void AnimatedModel::ReleaseBakedAnimations()
+    {
+        if (m_baked_texture_name != 0)
         {
-            ReadNodeHierarchy(animation_time, node->mChildren[i], global_transform);
+            GpuMemory::UntrackTexture(m_baked_texture_name);
+            glDeleteTextures(1, &m_baked_texture_name);
+            GLState::OnTextureDeleted(m_baked_texture_name);
         }
+
+        m_baked_texture_name      = 0;
+        m_baked_frames_per_second = 0.0f;
+        m_baked_clips.clear();
     }
 
     void AnimatedModel::LoadBones(uint32_t mesh_index, const aiMesh* mesh, std::vector<VertexBoneData>& bones)
@@ -282,38 +1071,41 @@ namespace RGL
         if(m_vao_name)
         {
             Release();
+            ReleaseSkinnedBuffers();
+            ReleaseBakedAnimations();
         }
 
-        /* Load model */
-        m_assimp_scene = m_importer.ReadFile(filepath.generic_string(), aiProcess_Triangulate              |
-                                                                        aiProcess_GenSmoothNormals         | 
-                                                                        aiProcess_CalcTangentSpace         |
-                                                                        aiProcess_FlipUVs                  |
-                                                                        aiProcess_JoinIdenticalVertices    | 
-                                                                        aiProcess_RemoveRedundantMaterials | 
-                                                                        aiProcess_GenBoundingBoxes );
+        /* The importer, and the scene with it, is gone after the load - the animations are converted to clips. */
+        Assimp::Importer importer;
+        importer.SetIOHandler(new AssetIOSystem);
+
+        const aiScene*   scene = importer.ReadFile(filepath.generic_string(), aiProcess_Triangulate              |
+                                                                              aiProcess_GenSmoothNormals         | 
+                                                                              aiProcess_CalcTangentSpace         |
+                                                                              aiProcess_FlipUVs                  |
+                                                                              aiProcess_JoinIdenticalVertices    | 
+                                                                              aiProcess_RemoveRedundantMaterials | 
+                                                                              aiProcess_GenBoundingBoxes );
 
-        if (!m_assimp_scene || m_assimp_scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !m_assimp_scene->mRootNode)
+        if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
         {
-            fprintf(stderr, "Assimp error while loading mesh %s\n Error: %s\n", filepath.generic_string(), m_importer.GetErrorString());
+            fprintf(stderr, "Assimp error while loading mesh %s\n Error: %s\n", filepath.generic_string(), importer.GetErrorString());
             return false;
         }
 
-        m_global_inverse_transform = mat4_cast(m_assimp_scene->mRootNode->mTransformation);
+        m_global_inverse_transform = mat4_cast(scene->mRootNode->mTransformation);
         m_global_inverse_transform = glm::inverse(m_global_inverse_transform);
-        m_animations_count         = m_assimp_scene->mNumAnimations;
 
-        return ParseScene(m_assimp_scene, filepath);
+        return ParseScene(scene, filepath);
     }
 
     std::vector<std::string> AnimatedModel::GetAnimationsNames() const
     {
-        auto animations_count = m_assimp_scene->mNumAnimations;
-        std::vector<std::string> animations_names(animations_count);
+        std::vector<std::string> animations_names(m_clips.size());
 
-        for (uint32_t i = 0; i < animations_count; ++i)
+        for (uint32_t i = 0; i < m_clips.size(); ++i)
         {
-            animations_names[i] = m_assimp_scene->mAnimations[i]->mName.C_Str();
+            animations_names[i] = m_clips[i].m_name;
         }
 
         return animations_names;
@@ -368,7 +1160,9 @@ namespace RGL
             max = glm::max(max, vec3_cast(mesh->mAABB.mMax));
         }
 
-        m_unit_scale = 1.0f / glm::compMax(max - min);
+        m_unit_scale    = 1.0f / glm::compMax(max - min);
+        m_bounds_center = 0.5f * (max + min);
+        m_bounds_radius = 0.5f * glm::length(max - min);
 
         /* Load materials. */
         if (!LoadMaterials(scene, filepath))
@@ -377,8 +1171,26 @@ namespace RGL
             return false;
         }
 
+        /* The bones are known now, flatten the hierarchy and convert the animations for BoneTransform(). */
+        std::unordered_map<std::string, uint32_t> node_indices;
+
+        m_nodes.clear();
+        BuildNodes    (scene->mRootNode, NO_INDEX, node_indices);
+        LoadAnimations(scene, node_indices);
+
+        /* The children come after their parents, the heights go up from the leaves. */
+        for (uint32_t i = uint32_t(m_nodes.size()); i-- > 0;)
+        {
+            if (m_nodes[i].m_parent_index != NO_INDEX)
+            {
+                auto& parent = m_nodes[m_nodes[i].m_parent_index];
+                parent.m_height = std::max(parent.m_height, m_nodes[i].m_height + 1);
+            }
+        }
+
         /* Populate buffers on the GPU with the model's data. */
         CreateBuffers(vertex_data, bones_data);
+        CreateIndirectBuffers();
 
         return true;
     }
@@ -419,27 +1231,28 @@ namespace RGL
         bool has_tangents   = !vertex_data.tangents.empty();
         bool has_bones_data = !bones_data.empty();
 
-        std::vector<float> bone_weights; 
-        bone_weights.reserve(bones_data.size() * NUM_BONES_PER_VERTEX);
+        /* The packed influences, see VertexBoneData. */
+        m_bone_id_size = m_bones_count > 256 ? sizeof(uint16_t) : sizeof(uint8_t);
 
-        std::vector<int> bone_ids; 
-        bone_ids.reserve(bones_data.size() * NUM_BONES_PER_VERTEX);
+        std::vector<uint16_t> bone_weights(bones_data.size() * NUM_BONES_PER_VERTEX);
+        std::vector<uint8_t>  bone_ids    (bones_data.size() * NUM_BONES_PER_VERTEX * m_bone_id_size);
 
-        if (has_bones_data)
+        for (uint32_t i = 0; i < bones_data.size(); ++i)
         {
-            for (uint32_t i = 0; i < bones_data.size(); ++i)
+            bones_data[i].PackWeights(&bone_weights[i * NUM_BONES_PER_VERTEX]);
+
+            for (uint32_t j = 0; j < NUM_BONES_PER_VERTEX; ++j)
             {
-                for (auto& bone_weight : bones_data[i].m_weights)
+                const uint32_t id_index = i * NUM_BONES_PER_VERTEX + j;
+
+                if (m_bone_id_size == sizeof(uint8_t))
                 {
-                    bone_weights.push_back(bone_weight);
+                    bone_ids[id_index] = uint8_t(bones_data[i].m_ids[j]);
                 }
-            }
-
-            for (uint32_t i = 0; i < bones_data.size(); ++i)
-            {
-                for (auto& bone_id : bones_data[i].m_ids)
+                else
                 {
-                    bone_ids.push_back(bone_id);
+                    const uint16_t id = uint16_t(bones_data[i].m_ids[j]);
+                    memcpy(&bone_ids[id_index * sizeof(uint16_t)], &id, sizeof(id));
                 }
             }
         }
@@ -456,6 +1269,15 @@ namespace RGL
 
         glCreateBuffers(1, &m_vbo_name);
         glNamedBufferStorage(m_vbo_name, total_size_bytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+        GpuMemory::TrackBuffer(m_vbo_name, "AnimatedModel");
+
+        m_vertices_count      = uint32_t(vertex_data.positions.size());
+        m_positions_offset    = 0;
+        m_texcoords_offset    = m_positions_offset + positions_size_bytes;
+        m_normals_offset      = m_texcoords_offset + texcoords_size_bytes;
+        m_tangents_offset     = has_tangents ? m_normals_offset + normals_size_bytes : -1;
+        m_bone_weights_offset = m_normals_offset + normals_size_bytes + tangents_size_bytes;
+        m_bone_ids_offset     = m_bone_weights_offset + bone_weights_size_bytes;
 
         uint64_t offset = 0;
 
@@ -484,6 +1306,7 @@ namespace RGL
 
         glCreateBuffers     (1, &m_ibo_name);
         glNamedBufferStorage(m_ibo_name, sizeof(vertex_data.indices[0]) * vertex_data.indices.size(), vertex_data.indices.data(), GL_DYNAMIC_STORAGE_BIT);
+        GpuMemory::TrackBuffer(m_ibo_name, "AnimatedModel");
 
         glCreateVertexArrays(1, &m_vao_name);
 
@@ -506,10 +1329,10 @@ namespace RGL
 
         if (has_bones_data)
         {
-            glVertexArrayVertexBuffer(m_vao_name, 4 /* bindingindex*/, m_vbo_name, offset, sizeof(bone_weights[0]) * 4 /*stride*/);
+            glVertexArrayVertexBuffer(m_vao_name, 4 /* bindingindex*/, m_vbo_name, offset, sizeof(bone_weights[0]) * NUM_BONES_PER_VERTEX /*stride*/);
             offset += bone_weights_size_bytes;
 
-            glVertexArrayVertexBuffer(m_vao_name, 5 /* bindingindex*/, m_vbo_name, offset, sizeof(bone_ids[0]) * 4 /*stride*/);
+            glVertexArrayVertexBuffer(m_vao_name, 5 /* bindingindex*/, m_vbo_name, offset, m_bone_id_size * NUM_BONES_PER_VERTEX /*stride*/);
         }
 
         glVertexArrayElementBuffer(m_vao_name, m_ibo_name);
@@ -538,8 +1361,8 @@ namespace RGL
 
         if (has_bones_data)
         {
-            glVertexArrayAttribFormat (m_vao_name, 4 /*attribindex */, 4 /* size */, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/);
-            glVertexArrayAttribIFormat(m_vao_name, 5 /*attribindex */, 4 /* size */, GL_INT,             0 /*relativeoffset*/);
+            glVertexArrayAttribFormat (m_vao_name, 4 /*attribindex */, 4 /* size */, GL_UNSIGNED_SHORT, GL_TRUE, 0 /*relativeoffset*/);
+            glVertexArrayAttribIFormat(m_vao_name, 5 /*attribindex */, 4 /* size */, m_bone_id_size == sizeof(uint8_t) ? GL_UNSIGNED_BYTE : GL_UNSIGNED_SHORT, 0 /*relativeoffset*/);
         }
 
         glVertexArrayAttribBinding(m_vao_name, 0 /*attribindex*/, 0 /*bindingindex*/); // positions
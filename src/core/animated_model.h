@@ -4,22 +4,137 @@
 
 #include <glm/mat2x4.hpp>
 #include <glm/mat4x4.hpp>
+#include <algorithm>
 #include <map>
+#include <span>
+#include <string>
+#include <unordered_map>
 
 namespace RGL
 {
+    /*
+     * A skinned model: the mesh, the skeleton and the animation clips, shared by all its instances. The playback of an
+     * instance is an AnimationState - Evaluate() advances it and writes the instance's bone palette, EvaluateInstances()
+     * does it for many instances in parallel on the JobSystem, into one buffer (e.g. a RingBuffer allocation bound
+     * at BONE_PALETTES_SSBO_BINDING_INDEX), GetBonesCount() matrices per instance.
+     *
+     *     std::vector<AnimatedModel::AnimationState> crowd(500);
+     *     auto palettes = ring.Allocate(sizeof(glm::mat4) * model.GetBonesCount() * crowd.size());
+     *     model.EvaluateInstances(crowd, dt, (glm::mat4*)palettes.m_data);
+     *     ring.BindRange(GL_SHADER_STORAGE_BUFFER, BONE_PALETTES_SSBO_BINDING_INDEX, palettes);
+     *
+     * BoneTransform() plays the model's own state, for a single instance.
+     *
+     * A state crossfades into another clip with CrossFade(), and adds the AnimationLayers on top: an additive layer
+     * is the difference of its clip from the clip's first keys (e.g. a breathing or a head turn over a walk).
+     * The poses are sampled and mixed in the SoA form, 4 nodes at a time with SSE. The sampling of a node doesn't
+     * depend on the others, so the rigs of PARALLEL_SAMPLING_MIN_NODES nodes or more are sampled by the jobs in ranges
+     * of NODES_PER_JOB, and only the concatenation of the hierarchy stays serial. EvaluateBatch() evaluates the states
+     * of many models at once.
+     *
+     * Animation LOD: SelectAnimationLods() picks, by the instances' size on the screen, how often EvaluateInstances()
+     * updates a state (the frames in between interpolate its palettes) and how many levels of the leaf bones - fingers,
+     * face - keep the bind pose. The crowd's CPU cost follows what's actually visible.
+     *
+     * Skin() is the compute pre-skinning: the palettes are applied once per frame into a buffer of SkinnedVertex
+     * (world space, with the instance transforms of INSTANCE_DATA_SSBO_BINDING_INDEX), and RenderSkinned() draws it
+     * as a static mesh - the depth, shadow and lighting passes don't redo the skinning.
+     *
+     * For the crowds that don't need the CPU playback, BakeAnimations() samples every clip at a fixed rate into
+     * a texture of bone matrices, shaders/baked_animation.glh plays it back by an instance's own time.
+     */
     class AnimatedModel : public StaticModel
     {
     public:
+        static constexpr uint32_t NO_INDEX = 0xFFFFFFFF;
+
+        /* The keys of a node's channel found in the last evaluation, the lookup starts from there. */
+        struct KeyCursors
+        {
+            uint32_t m_position = 0;
+            uint32_t m_rotation = 0;
+            uint32_t m_scaling  = 0;
+        };
+
+        /* An additive clip over the state's pose, it plays at the state's speed. */
+        struct AnimationLayer
+        {
+            uint32_t m_clip   = NO_INDEX;
+            float    m_time   = 0.0f;           /* In ticks. */
+            float    m_weight = 1.0f;
+
+            std::vector<KeyCursors> m_cursors;
+        };
+
+        /* The playback of an instance. The clip is crossfaded with m_blend_clip (if any) by m_blend_weight. */
+        struct AnimationState
+        {
+            uint32_t m_clip         = 0;
+            float    m_time         = 0.0f;     /* In ticks. */
+            float    m_speed        = 1.0f;
+            uint32_t m_blend_clip   = NO_INDEX;
+            float    m_blend_time   = 0.0f;
+            float    m_blend_weight = 0.0f;     /* 0 - m_clip only, 1 - m_blend_clip only. */
+            float    m_blend_speed  = 0.0f;     /* Of CrossFade(), weight per second. 0 - m_blend_weight is set by hand. */
+
+            /* Of the nodes, sized by the first evaluation. Stale cursors are fine, the lookup falls back to a binary search. */
+            std::vector<KeyCursors> m_cursors;
+            std::vector<KeyCursors> m_blend_cursors;
+
+            std::vector<AnimationLayer> m_layers;
+
+            /* Animation LOD, see SelectAnimationLods(). */
+            uint32_t m_update_interval     = 1;     /* Evaluated every n-th EvaluateInstances(), interpolated in between. */
+            uint32_t m_skipped_leaf_levels = 0;     /* The nodes this close to the leaves keep the bind pose. */
+
+            /* The palettes the LOD interpolates between, and how far it is - m_lod_step of m_lod_steps frames. */
+            std::vector<glm::mat4> m_lod_palettes;
+            uint32_t               m_lod_step  = 0;
+            uint32_t               m_lod_steps = 0;  /* 0 - evaluated at the full rate. */
+        };
+
+        /* The thresholds of SelectAnimationLods(), on the projected radius of the model like StaticModel::SetLodThreshold(). */
+        struct AnimationLodSettings
+        {
+            float    m_full_rate_radius    = 64.0f; /* Pixels. Below it the update interval doubles for every halving of the radius. */
+            uint32_t m_max_update_interval = 4;
+            float    m_leaf_bones_radius   = 32.0f; /* Pixels. Below it the leaf bones keep the bind pose, below its half their parents too. */
+            uint32_t m_offscreen_interval  = 8;     /* Outside the frustum, the shadows may still need the pose. */
+        };
+
+        /* The frames of a clip in the baked animations texture. */
+        struct BakedClip
+        {
+            uint32_t m_first_frame;
+            uint32_t m_frames_count;
+        };
+
+        /* A state of a model to evaluate in EvaluateBatch(), GetBonesCount() matrices of the model are written to the palette. */
+        struct Evaluation
+        {
+            const AnimatedModel* m_model;
+            AnimationState*      m_state;
+            glm::mat4*           m_palette;
+        };
+
+        static constexpr uint32_t INSTANCES_PER_JOB           = 16;
+        static constexpr uint32_t PARALLEL_SAMPLING_MIN_NODES = 256;
+        static constexpr uint32_t NODES_PER_JOB               = 64;
+
         AnimatedModel() : m_bones_count             (0), 
                           m_global_inverse_transform(glm::mat4(1.0)), 
-                          m_assimp_scene            (nullptr), 
-                          m_animation_speed         (1.0),
-                          m_current_animation_time  (0.0), 
-                          m_current_animation       (0), 
-                          m_animations_count        (0) {}
+                          m_bounds_center           (0.0f),
+                          m_bounds_radius           (0.0f),
+                          m_animations_count        (0),
+                          m_vertices_count          (0),
+                          m_bone_id_size            (1),
+                          m_skinned_vbo_name        (0),
+                          m_skinned_vao_name        (0),
+                          m_skinned_instances_count (0),
+                          m_baked_texture_name      (0),
+                          m_baked_frames_per_second (0.0f) {}
 
-        virtual ~AnimatedModel() {}
+        virtual ~AnimatedModel() { ReleaseSkinnedBuffers(); ReleaseBakedAnimations(); }
 
         /* Used for Linear Blend Skinning */
         void BoneTransform(float dt, std::vector<glm::mat4>& transforms);
@@ -27,21 +142,79 @@ namespace RGL
         /* Used for Dual Quaternion Blend Skinning */
         void BoneTransform(float dt, std::vector<glm::mat2x4>& transforms);
 
+        /* Advances the state by dt seconds and writes GetBonesCount() matrices to the palette. Thread safe. */
+        void Evaluate(AnimationState& state, float dt, glm::mat4* palette) const;
+
+        /*
+         * Evaluate() of every state in parallel, the palette of the state i starts at palettes + i * GetBonesCount().
+         * The states with the update interval above 1 are evaluated ahead by the interval and interpolated towards it
+         * (their m_time runs ahead of the palette), the first interval is staggered by the index.
+         */
+        void EvaluateInstances(std::span<AnimationState> states, float dt, glm::mat4* palettes) const;
+
+        /*
+         * Sets the update interval and the skipped leaf levels of the states from the model's bounding sphere (of the bind pose)
+         * transformed by the instances' models. projection_scale = 0.5 * viewport_height * projection[1][1], as in SelectLods().
+         */
+        void SelectAnimationLods(std::span<AnimationState> states, std::span<const glm::mat4> models, const glm::mat4& view_projection,
+                                 const glm::vec3& camera_position, float projection_scale, const AnimationLodSettings& settings = {}) const;
+
+        /* Evaluate() of the states of different models, in parallel. */
+        static void EvaluateBatch(std::span<const Evaluation> evaluations, float dt);
+
+        /*
+         * Blends the state into the clip over duration seconds, from the clip's start. Evaluate() makes it the state's
+         * clip once the fade is done. A duration of 0 is a hard cut.
+         */
+        void CrossFade(AnimationState& state, uint32_t clip, float duration) const;
+
+        /* The output of Skin() for up to instances_count instances. Only grows, a smaller count keeps the buffers. */
+        bool CreateSkinnedBuffers(uint32_t instances_count);
+
+        /*
+         * Skins instances_count instances with the palettes bound at BONE_PALETTES_SSBO_BINDING_INDEX and the transforms
+         * at INSTANCE_DATA_SSBO_BINDING_INDEX. Issues the vertex attrib barrier for RenderSkinned().
+         */
+        void Skin(uint32_t instances_count);
+
+        /* Draws the skinned instances, a multi draw per mesh part. The vertex shader gets world space attributes. */
+        void RenderSkinned(uint32_t instances_count);
+
+        /*
+         * Bakes the bone matrices of every clip at frames_per_second into an RGBA32F texture: a row per frame,
+         * 3 texels per bone - the rows of its affine transform. The clips follow one another, see GetBakedClips().
+         */
+        bool BakeAnimations(float frames_per_second = 30.0f);
+
+        /* At BAKED_ANIMATIONS_UNIT by default, the unit baked_animation.glh samples. */
+        void BindBakedAnimations(GLuint unit = BAKED_ANIMATIONS_UNIT) const;
+
+        const std::vector<BakedClip>& GetBakedClips()          const { return m_baked_clips; }
+        float                         GetBakedFramesPerSecond() const { return m_baked_frames_per_second; }
+
         bool Load(const std::filesystem::path& filepath) override;
 
+        /* Bones and animations need the Assimp scene, so the animated models are loaded synchronously. */
+        bool LoadAsync(const std::filesystem::path& filepath) override { return Load(filepath); }
+
         std::vector<std::string> GetAnimationsNames() const;
         uint32_t                 GetAnimationsCount() const { return m_animations_count; }
         uint32_t                 GetBonesCount()      const { return m_bones_count; }
 
         void SetAnimation(uint32_t animation_index) 
         { 
-            m_current_animation      = std::max(0u, std::min(animation_index, m_animations_count - 1)); 
-            m_current_animation_time = 0.0f; 
+            m_state.m_clip = std::max(0u, std::min(animation_index, m_animations_count - 1)); 
+            m_state.m_time = 0.0f; 
+        }
+
+        void CrossFadeAnimation(uint32_t animation_index, float duration)
+        {
+            CrossFade(m_state, animation_index, duration);
         }
 
         void SetAnimationSpeed(float speed)
         {
-            m_animation_speed = std::max(speed, 0.0f);
+            m_state.m_speed = std::max(speed, 0.0f);
         }
 
     protected:
@@ -50,19 +223,21 @@ namespace RGL
         struct BoneInfo
         {
             glm::mat4 m_bone_offset;
-            glm::mat4 m_final_transform;
 
             BoneInfo()
             {
-                m_bone_offset     = glm::mat4(0.0);
-                m_final_transform = glm::mat4(0.0);
+                m_bone_offset = glm::mat4(0.0);
             }
         };
 
+        /*
+         * The influences of a vertex while loading. The GPU gets them packed: the weights in unorm16 and the ids
+         * in uint8 (uint16 for the rigs of more than 256 bones), 12 or 16 bytes per vertex instead of 32.
+         */
         struct VertexBoneData
         {
-            int   m_ids[NUM_BONES_PER_VERTEX];
-            float m_weights[NUM_BONES_PER_VERTEX];
+            uint32_t m_ids[NUM_BONES_PER_VERTEX];
+            float    m_weights[NUM_BONES_PER_VERTEX];
             
             VertexBoneData()
             {
@@ -75,23 +250,130 @@ namespace RGL
                 memset(m_weights, 0, sizeof(m_weights));
             }
 
-            void AddBoneData(int bone_id, float weight)
+            /* Keeps the NUM_BONES_PER_VERTEX largest influences, the smallest one is dropped for a larger one. */
+            void AddBoneData(uint32_t bone_id, float weight)
             {
-                for (uint32_t i = 0; i < NUM_BONES_PER_VERTEX; ++i)
+                uint32_t smallest = 0;
+
+                for (uint32_t i = 1; i < NUM_BONES_PER_VERTEX; ++i)
                 {
-                    if (m_weights[i] == 0.0)
+                    if (m_weights[i] < m_weights[smallest])
                     {
-                        m_ids    [i] = bone_id;
-                        m_weights[i] = weight;
-                        return;
+                        smallest = i;
                     }
                 }
 
-                // should never get here - more bones that we have space for
-                assert(0);
+                if (weight > m_weights[smallest])
+                {
+                    m_ids    [smallest] = bone_id;
+                    m_weights[smallest] = weight;
+                }
+            }
+
+            /* The weights renormalized to the sum of 1 in unorm16, the rounding error goes to the largest one. */
+            void PackWeights(uint16_t* packed) const
+            {
+                float    sum     = 0.0f;
+                uint32_t largest = 0;
+                uint32_t total   = 0;
+
+                for (uint32_t i = 0; i < NUM_BONES_PER_VERTEX; ++i)
+                {
+                    sum    += m_weights[i];
+                    largest = m_weights[i] > m_weights[largest] ? i : largest;
+                }
+
+                for (uint32_t i = 0; i < NUM_BONES_PER_VERTEX; ++i)
+                {
+                    packed[i] = sum > 0.0f ? uint16_t(m_weights[i] / sum * 65535.0f + 0.5f) : 0;
+                    total    += packed[i];
+                }
+
+                if (sum > 0.0f)
+                {
+                    packed[largest] = uint16_t(int32_t(packed[largest]) + 65535 - int32_t(total));
+                }
             }
         };
 
+        /* Local transform of a node, the blended clips are mixed in this form. */
+        struct NodePose
+        {
+            glm::vec3 m_position;
+            glm::quat m_rotation;
+            glm::vec3 m_scaling;
+        };
+
+        /*
+         * Local poses of the nodes in the SoA form, a component per array, so the blending works on POSE_LANES nodes
+         * at a time. The arrays are padded to a multiple of POSE_LANES with the identity.
+         */
+        struct PoseBuffer
+        {
+            enum Component { TX, TY, TZ, RX, RY, RZ, RW, SX, SY, SZ, COMPONENTS_COUNT };
+
+            std::vector<float> m_data;
+            uint32_t           m_stride = 0;
+
+            /* Keeps the content if the stride doesn't change - the padding may hold other nodes then, their results aren't used. */
+            void Resize(uint32_t nodes_count);
+            void Set   (uint32_t node, const NodePose& pose);
+
+                  float* operator[](uint32_t component)       { return m_data.data() + size_t(component) * m_stride; }
+            const float* operator[](uint32_t component) const { return m_data.data() + size_t(component) * m_stride; }
+        };
+
+        static constexpr uint32_t POSE_LANES = 4;
+
+        static_assert(NODES_PER_JOB % POSE_LANES == 0, "The sampling jobs have to start at a lane.");
+
+        /* The buffers of an evaluation, shared by its sampling jobs - each one writes the lanes of its own nodes. */
+        struct PoseScratch
+        {
+            PoseBuffer             m_pose;
+            PoseBuffer             m_blend_pose;
+            PoseBuffer             m_layer_pose;
+            PoseBuffer             m_from;           /* The keys before the time, */
+            PoseBuffer             m_to;             /* after the time, */
+            std::vector<float>     m_factors;        /* and the factors between them - position, rotation, scaling, then the blend weight. */
+            std::vector<uint8_t>   m_is_animated;
+            std::vector<glm::mat4> m_global_transforms;
+
+            void Resize(uint32_t nodes_count);
+        };
+
+        /* A node of the flattened hierarchy, in the depth-first order. */
+        struct Node
+        {
+            glm::mat4 m_transform;    /* The bind pose one, for the nodes without a channel. */
+            NodePose  m_bind_pose;    /* The same, for blending with a clip that has a channel. */
+            uint32_t  m_parent_index;
+            uint32_t  m_bone_index;
+            uint32_t  m_height;       /* Levels of the nodes below, 0 - a leaf. */
+        };
+
+        /* The keys of a node in a clip, the times and the values of each kind apart - the lookup only reads the times. */
+        struct AnimationChannel
+        {
+            std::vector<float>     m_position_times;
+            std::vector<glm::vec3> m_positions;
+            std::vector<float>     m_rotation_times;
+            std::vector<uint64_t>  m_rotations;      /* Unit quaternions (x, y, z, w), glm::packSnorm4x16. */
+            std::vector<float>     m_scaling_times;
+            std::vector<glm::vec3> m_scalings;
+        };
+
+        /* An animation converted from Assimp at load, the scene isn't kept. */
+        struct AnimationClip
+        {
+            std::string                   m_name;
+            float                         m_duration;         /* In ticks. */
+            float                         m_ticks_per_second;
+            std::vector<AnimationChannel> m_channels;
+            std::vector<uint32_t>         m_node_channels;    /* Of the nodes, NO_INDEX - no channel. */
+            PoseBuffer                    m_additive_base;    /* The inverse of the first keys' pose, the additive layers are relative to it. */
+        };
+
         glm::mat4 operator=(const aiMatrix4x4& from)
         {
             glm::mat4 to;
@@ -105,35 +387,76 @@ namespace RGL
             return to;
         }
 
-        virtual void CalcInterpolatedScaling (aiVector3D&   out, float animation_time, const aiNodeAnim* node_anim);
-        virtual void CalcInterpolatedRotation(aiQuaternion& out, float animation_time, const aiNodeAnim* node_anim);
-        virtual void CalcInterpolatedPosition(aiVector3D&   out, float animation_time, const aiNodeAnim* node_anim);
+        /*
+         * The local poses of the clip at the time into pose, for the nodes [begin, end). The keys around the time are
+         * gathered per node (the cursors are the keys found the last time, the search starts from there), then interpolated
+         * in the SoA form. Sets m_is_animated of the nodes that have a channel, the nodes below min_height keep the bind pose.
+         */
+        void SampleClip(const AnimationClip& clip, float animation_time, std::vector<KeyCursors>& cursors, PoseScratch& scratch, PoseBuffer& pose,
+                        uint32_t begin, uint32_t end, uint32_t min_height) const;
+
+        /* The clip, the crossfade and the layers of the state mixed into scratch.m_pose, for the nodes [begin, end). */
+        void SamplePose(AnimationState& state, PoseScratch& scratch, uint32_t begin, uint32_t end) const;
+
+        /* An interval of the animation LOD, see EvaluateInstances(). */
+        void EvaluateLod(AnimationState& state, float dt, glm::mat4* palette, uint32_t stagger) const;
+
+        /* The local poses concatenated down the hierarchy into the palette. */
+        void ConcatenatePose(PoseScratch& scratch, glm::mat4* palette) const;
+
+        /* out = nlerp(a, b) by the factors of the nodes, per kind, for the lanes of [begin, end). out can be a. */
+        static void BlendPoses(const PoseBuffer& a, const PoseBuffer& b, const float* position_factors, const float* rotation_factors, const float* scaling_factors,
+                               PoseBuffer& out, uint32_t begin, uint32_t end);
 
-        virtual uint32_t FindScaling (float animation_time, const aiNodeAnim* node_anim);
-        virtual uint32_t FindRotation(float animation_time, const aiNodeAnim* node_anim);
-        virtual uint32_t FindPosition(float animation_time, const aiNodeAnim* node_anim);
+        /* Adds the difference of the layer from its base (inverted, see AnimationClip::m_additive_base) to the pose. */
+        static void AddPose(PoseBuffer& pose, const PoseBuffer& layer, const PoseBuffer& inverse_base, float weight, uint32_t begin, uint32_t end);
 
-        virtual const aiNodeAnim* FindNodeAnim(const aiAnimation* animation, std::string_view node_name);
-        virtual void ReadNodeHierarchy(float animation_time, const aiNode* node, const glm::mat4& parent_transform);
+        /* Flattens the hierarchy below the node, node_indices maps the names to the nodes for LoadAnimations(). */
+        virtual void BuildNodes    (const aiNode* node, uint32_t parent_index, std::unordered_map<std::string, uint32_t>& node_indices);
+        virtual void LoadAnimations(const aiScene* scene, const std::unordered_map<std::string, uint32_t>& node_indices);
+        virtual void EvaluateNodes(AnimationState& state, glm::mat4* palette) const;
 
         virtual void LoadBones(uint32_t mesh_index, const aiMesh* mesh, std::vector<VertexBoneData>& bones);
         virtual bool ParseScene(const aiScene* scene, const std::filesystem::path& filepath) override;
 
         virtual void LoadMeshPart(uint32_t mesh_index, const aiMesh* mesh, VertexData& vertex_data, std::vector<VertexBoneData>& bones_data);
         virtual void CreateBuffers(VertexData& vertex_data, std::vector<VertexBoneData>& bones_data);
+
+        void ReleaseSkinnedBuffers();
+        void ReleaseBakedAnimations();
         
         std::map<std::string, uint32_t> m_bones_mapping;
         std::vector<BoneInfo>           m_bone_infos;
 
+        std::vector<Node>          m_nodes;
+        std::vector<AnimationClip> m_clips;
+
         uint32_t  m_bones_count;
         glm::mat4 m_global_inverse_transform;
+        glm::vec3 m_bounds_center;         /* Of the bind pose, for SelectAnimationLods(). */
+        float     m_bounds_radius;
+
+        AnimationState m_state;             /* Of BoneTransform(). */
+        uint32_t       m_animations_count;
+
+        /* Compute pre-skinning: the attributes' offsets in m_vbo_name, in bytes. */
+        uint32_t m_vertices_count;
+        GLintptr m_positions_offset;
+        GLintptr m_texcoords_offset;
+        GLintptr m_normals_offset;
+        GLintptr m_tangents_offset;         /* -1 without the tangents. */
+        GLintptr m_bone_weights_offset;
+        GLintptr m_bone_ids_offset;
+        uint32_t m_bone_id_size;            /* In bytes, 1 or 2. */
+
+        GLuint   m_skinned_vbo_name;
+        GLuint   m_skinned_vao_name;
+        uint32_t m_skinned_instances_count;
 
-        const aiScene*   m_assimp_scene;
-        Assimp::Importer m_importer;
+        std::shared_ptr<Shader> m_skinning_shader;
 
-        float    m_animation_speed;
-        float    m_current_animation_time;
-        uint32_t m_current_animation;
-        uint32_t m_animations_count;
+        std::vector<BakedClip> m_baked_clips;
+        GLuint                 m_baked_texture_name;
+        float                  m_baked_frames_per_second;
     };
 }
\ No newline at end of file
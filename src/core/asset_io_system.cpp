@@ -0,0 +1,99 @@
+#include "asset_io_system.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include <assimp/IOStream.hpp>
+
+#include "filesystem.h"
+#include "mapped_file.h"
+
+namespace RGL
+{
+    namespace
+    {
+        class MappedFileIOStream final : public Assimp::IOStream
+        {
+        public:
+            explicit MappedFileIOStream(MappedFile&& file)
+                : m_file(std::move(file))
+            {
+            }
+
+            size_t Read(void* buffer, size_t size, size_t count) override
+            {
+                if (size == 0)
+                {
+                    return 0;
+                }
+
+                /* Whole elements only, as fread(). */
+                count = std::min(count, (m_file.GetSize() - m_position) / size);
+                std::memcpy(buffer, m_file.GetData() + m_position, size * count);
+                m_position += size * count;
+
+                return count;
+            }
+
+            size_t Write(const void*, size_t, size_t) override { return 0; }
+
+            aiReturn Seek(size_t offset, aiOrigin origin) override
+            {
+                size_t position;
+
+                switch (origin)
+                {
+                    case aiOrigin_SET: position = offset;                     break;
+                    case aiOrigin_CUR: position = m_position + offset;        break;
+                    case aiOrigin_END: position = m_file.GetSize() - offset;  break;
+                    default:           return aiReturn_FAILURE;
+                }
+
+                if (position > m_file.GetSize())
+                {
+                    return aiReturn_FAILURE;
+                }
+
+                m_position = position;
+                return aiReturn_SUCCESS;
+            }
+
+            size_t Tell()     const override { return m_position; }
+            size_t FileSize() const override { return m_file.GetSize(); }
+            void   Flush()          override {}
+
+        private:
+            MappedFile m_file;
+            size_t     m_position = 0;
+        };
+    }
+
+    bool AssetIOSystem::Exists(const char* filepath) const
+    {
+        return FileSystem::exists(filepath);
+    }
+
+    Assimp::IOStream* AssetIOSystem::Open(const char* filepath, const char* mode)
+    {
+        if (std::strchr(mode, 'w') || std::strchr(mode, 'a'))
+        {
+            return DefaultIOSystem::Open(filepath, mode);
+        }
+
+        /* Assimp probes for the files it might need, the missing ones are no errors. */
+        if (!FileSystem::exists(filepath))
+        {
+            return nullptr;
+        }
+
+        MappedFile file;
+
+        if (!file.Open(filepath))
+        {
+            return nullptr;
+        }
+
+        return new MappedFileIOStream(std::move(file));
+    }
+}
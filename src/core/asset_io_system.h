@@ -0,0 +1,20 @@
+#pragma once
+
+#include <assimp/DefaultIOSystem.h>
+
+namespace RGL
+{
+    /*
+     * The models' files (the .gltf's buffers and the like too) are read through MappedFile, so from the mounted paks
+     * (see FileSystem::mountPak()) or mapped from the disk. Files opened for writing go to the disk.
+     *
+     *     Assimp::Importer importer;
+     *     importer.SetIOHandler(new AssetIOSystem); // Owned by the importer.
+     */
+    class AssetIOSystem : public Assimp::DefaultIOSystem
+    {
+    public:
+        bool              Exists(const char* filepath) const override;
+        Assimp::IOStream* Open  (const char* filepath, const char* mode = "rb") override;
+    };
+}
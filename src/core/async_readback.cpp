@@ -0,0 +1,218 @@
+#include "async_readback.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+
+#include "gpu_memory.h"
+
+namespace RGL
+{
+    namespace
+    {
+        /* Keeps every slot aligned for any pixel type and for the copies. */
+        constexpr GLsizeiptr SLOT_ALIGNMENT = 256;
+    }
+
+    AsyncReadback::AsyncReadback()
+        : m_data         (nullptr),
+          m_buffer_name  (0),
+          m_slot_size    (0),
+          m_next_slot    (0),
+          m_pending_count(0),
+          m_dropped_count(0)
+    {
+    }
+
+    AsyncReadback::~AsyncReadback()
+    {
+        Release();
+    }
+
+    bool AsyncReadback::Create(GLsizeiptr slot_size, uint32_t slots_count)
+    {
+        Release();
+
+        m_slot_size = (slot_size + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+        m_slots.resize(std::max(slots_count, 1u));
+
+        const GLsizeiptr size  = m_slot_size * GLsizeiptr(m_slots.size());
+        const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        glCreateBuffers     (1, &m_buffer_name);
+        glNamedBufferStorage(m_buffer_name, size, nullptr, flags);
+        GpuMemory::TrackBuffer(m_buffer_name, "AsyncReadback");
+
+        m_data = static_cast<uint8_t*>(glMapNamedBufferRange(m_buffer_name, 0, size, flags));
+
+        if (!m_data)
+        {
+            fprintf(stderr, "AsyncReadback::Create: could not map the buffer.\n");
+            Release();
+
+            return false;
+        }
+
+        return true;
+    }
+
+    bool AsyncReadback::ReadBuffer(GLuint buffer, GLintptr offset, GLsizeiptr size, Callback callback)
+    {
+        Slot* slot = AcquireSlot(size);
+
+        if (!slot)
+        {
+            return false;
+        }
+
+        glCopyNamedBufferSubData(buffer, m_buffer_name, offset, m_slot_size * (slot - m_slots.data()), size);
+        SubmitSlot(*slot, size, std::move(callback));
+
+        return true;
+    }
+
+    std::future<std::vector<uint8_t>> AsyncReadback::ReadBuffer(GLuint buffer, GLintptr offset, GLsizeiptr size)
+    {
+        /* std::function has to be copyable, the promise isn't. */
+        auto promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+        auto future  = promise->get_future();
+
+        bool is_issued = ReadBuffer(buffer, offset, size, [promise](const void* data, GLsizeiptr data_size)
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            promise->set_value(std::vector<uint8_t>(bytes, bytes + data_size));
+        });
+
+        return is_issued ? std::move(future) : std::future<std::vector<uint8_t>>();
+    }
+
+    bool AsyncReadback::ReadTexture(GLuint texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, GLsizeiptr size, Callback callback)
+    {
+        Slot* slot = AcquireSlot(size);
+
+        if (!slot)
+        {
+            return false;
+        }
+
+        const GLintptr slot_offset = m_slot_size * (slot - m_slots.data());
+
+        glBindBuffer        (GL_PIXEL_PACK_BUFFER, m_buffer_name);
+        glPixelStorei       (GL_PACK_ALIGNMENT, 1);
+        glGetTextureSubImage(texture, level, x, y, 0, width, height, 1, format, type, GLsizei(size), reinterpret_cast<void*>(slot_offset));
+        glPixelStorei       (GL_PACK_ALIGNMENT, 4);
+        glBindBuffer        (GL_PIXEL_PACK_BUFFER, 0);
+
+        SubmitSlot(*slot, size, std::move(callback));
+
+        return true;
+    }
+
+    void AsyncReadback::Update()
+    {
+        ResolveSlots(false);
+    }
+
+    void AsyncReadback::Flush()
+    {
+        ResolveSlots(true);
+    }
+
+    AsyncReadback::Slot* AsyncReadback::AcquireSlot(GLsizeiptr size)
+    {
+        if (!m_data || size > m_slot_size)
+        {
+            fprintf(stderr, "AsyncReadback: the read of %lld bytes doesn't fit a slot.\n", (long long)size);
+            return nullptr;
+        }
+
+        Slot& slot = m_slots[m_next_slot];
+
+        if (slot.m_fence)
+        {
+            m_dropped_count++;
+            return nullptr;
+        }
+
+        m_next_slot = (m_next_slot + 1) % uint32_t(m_slots.size());
+
+        return &slot;
+    }
+
+    void AsyncReadback::SubmitSlot(Slot& slot, GLsizeiptr size, Callback&& callback)
+    {
+        slot.m_fence    = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.m_size     = size;
+        slot.m_callback = std::move(callback);
+
+        m_pending_count++;
+    }
+
+    bool AsyncReadback::ResolveSlot(Slot& slot, bool wait)
+    {
+        GLenum status = glClientWaitSync(slot.m_fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GL_TIMEOUT_IGNORED : 0);
+
+        if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+        {
+            return false;
+        }
+
+        glDeleteSync(slot.m_fence);
+        slot.m_fence = nullptr;
+        m_pending_count--;
+
+        /* The callback may issue the next read. */
+        Callback callback = std::move(slot.m_callback);
+
+        if (callback)
+        {
+            callback(m_data + m_slot_size * (&slot - m_slots.data()), slot.m_size);
+        }
+
+        return true;
+    }
+
+    void AsyncReadback::ResolveSlots(bool wait)
+    {
+        /* The fences signal in order, the oldest read still in flight ends the polling. */
+        while (m_pending_count > 0)
+        {
+            const uint32_t oldest = (m_next_slot + uint32_t(m_slots.size()) - m_pending_count) % uint32_t(m_slots.size());
+
+            if (!ResolveSlot(m_slots[oldest], wait))
+            {
+                break;
+            }
+        }
+    }
+
+    void AsyncReadback::Release()
+    {
+        for (auto& slot : m_slots)
+        {
+            if (slot.m_fence)
+            {
+                glDeleteSync(slot.m_fence);
+            }
+        }
+
+        m_slots.clear();
+
+        if (m_data)
+        {
+            glUnmapNamedBuffer(m_buffer_name);
+            m_data = nullptr;
+        }
+
+        if (m_buffer_name)
+        {
+            GpuMemory::UntrackBuffer(m_buffer_name);
+            glDeleteBuffers(1, &m_buffer_name);
+            m_buffer_name = 0;
+        }
+
+        m_slot_size     = 0;
+        m_next_slot     = 0;
+        m_pending_count = 0;
+    }
+}
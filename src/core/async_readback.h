@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <vector>
+
+#include <glad/glad.h>
+
+namespace RGL
+{
+    /*
+     * GPU to CPU copies that never stall - counters, reduced values, picking IDs, query results. The data is copied
+     * into a ring of slots of one persistently mapped buffer and fenced, Update() polls the fences and hands
+     * the signaled slots' data to their callbacks, in the order the reads were issued. A read is dropped (returns false)
+     * instead of waiting when all the slots are still in flight. Shader writes to the source need the matching
+     * glMemoryBarrier (GL_BUFFER_UPDATE_BARRIER_BIT, GL_PIXEL_BUFFER_BARRIER_BIT) before the read.
+     *
+     *     readback.Create(sizeof(uint32_t));
+     *
+     *     readback.ReadBuffer(counter_buffer, 0, sizeof(uint32_t), [&](const void* data, GLsizeiptr)
+     *     {
+     *         m_count = *static_cast<const uint32_t*>(data);
+     *     });
+     *
+     *     readback.Update(); // Once per frame.
+     */
+    class AsyncReadback final
+    {
+    public:
+        static constexpr uint32_t DEFAULT_SLOTS_COUNT = 3;
+
+        /* The data is valid only during the call. */
+        using Callback = std::function<void(const void* data, GLsizeiptr size)>;
+
+        AsyncReadback();
+        ~AsyncReadback();
+
+        AsyncReadback           (const AsyncReadback&) = delete;
+        AsyncReadback& operator=(const AsyncReadback&) = delete;
+
+        /* slot_size is the largest read. */
+        bool Create(GLsizeiptr slot_size, uint32_t slots_count = DEFAULT_SLOTS_COUNT);
+
+        bool ReadBuffer(GLuint buffer, GLintptr offset, GLsizeiptr size, Callback callback);
+
+        /* The future is ready after the Update() that finds the read signaled, invalid if the read was dropped. */
+        std::future<std::vector<uint8_t>> ReadBuffer(GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+        /* A 2D region of a texture level, the rows are tightly packed. size is the bytes of the region. */
+        bool ReadTexture(GLuint texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, GLsizeiptr size, Callback callback);
+
+        /* Has to be called once per frame. */
+        void Update();
+
+        /* Waits for all the reads in flight and calls their callbacks. */
+        void Flush();
+
+        uint32_t GetPendingCount() const { return m_pending_count; }
+        uint32_t GetDroppedCount() const { return m_dropped_count; }
+
+    private:
+        struct Slot
+        {
+            GLsync     m_fence = nullptr; /* nullptr if the slot is free. */
+            GLsizeiptr m_size  = 0;
+            Callback   m_callback;
+        };
+
+        /* The next slot if it's free and large enough, nullptr otherwise. */
+        Slot* AcquireSlot(GLsizeiptr size);
+        void  SubmitSlot (Slot& slot, GLsizeiptr size, Callback&& callback);
+        bool  ResolveSlot(Slot& slot, bool wait);
+        void  ResolveSlots(bool wait);
+        void  Release();
+
+        std::vector<Slot> m_slots;
+        uint8_t*          m_data;
+        GLuint            m_buffer_name;
+        GLsizeiptr        m_slot_size;
+        uint32_t          m_next_slot;
+        uint32_t          m_pending_count;
+        uint32_t          m_dropped_count;
+    };
+}
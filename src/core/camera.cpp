@@ -5,6 +5,8 @@ namespace RGL
 {
     void Camera::update(double dt)
     {
+        m_previous_view_projection = m_unjittered_view_projection;
+
         /* Camera Movement */
         auto movement_amount = m_move_speed * dt;
 
@@ -67,17 +69,52 @@ namespace RGL
             }
         }
 
+        const bool is_projection_changed = m_projection != m_cached_projection;
+
         if (m_is_dirty)
         {
             glm::mat4 R = glm::mat4_cast(m_orientation);
             glm::mat4 T = glm::translate(glm::mat4(1.0f), -m_position);
 
-            m_view = R * T;
+            m_view         = R * T;
+            m_inverse_view = glm::inverse(m_view);
+        }
+
+        if (is_projection_changed)
+        {
+            m_cached_projection  = m_projection;
+            m_inverse_projection = glm::inverse(m_projection);
+        }
+
+        if (m_is_dirty || is_projection_changed)
+        {
+            m_unjittered_view_projection = m_projection * m_view;
+            m_frustum.Update(m_unjittered_view_projection);
+            updateJitteredMatrices();
 
             m_is_dirty = false;
         }
     }
 
+    void Camera::setJitter(const glm::vec2& ndc_offset)
+    {
+        if (ndc_offset != m_jitter)
+        {
+            m_jitter = ndc_offset;
+            updateJitteredMatrices();
+        }
+    }
+
+    void Camera::updateJitteredMatrices()
+    {
+        /* A translation of the clip space x and y by the offset times w, the offset in NDC after the divide. */
+        const glm::mat4 jitter = glm::translate(glm::mat4(1.0f), glm::vec3(m_jitter, 0.0f));
+
+        m_jittered_projection     = jitter * m_projection;
+        m_view_projection         = jitter * m_unjittered_view_projection;
+        m_inverse_view_projection = m_inverse_view * m_inverse_projection * glm::translate(glm::mat4(1.0f), glm::vec3(-m_jitter, 0.0f));
+    }
+
     void Camera::move(const glm::vec3& position, const glm::vec3& dir, float amount)
     {
         setPosition(position + (dir * amount));
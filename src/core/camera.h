@@ -5,6 +5,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include "frustum.h"
 #include "input.h"
 
 namespace RGL
@@ -106,6 +107,29 @@ namespace RGL
         float FarPlane()        const { return m_far; }
         float FOV()             const { return m_fov; }
 
+        /*
+         * Cached in update(), recomputed only when the camera has moved or m_projection has changed.
+         * viewProjection(), inverseViewProjection() and jitteredProjection() include the jitter of setJitter(),
+         * the frustum and unjitteredViewProjection() don't.
+         */
+        const glm::mat4& viewProjection()           const { return m_view_projection; }
+        const glm::mat4& inverseView()              const { return m_inverse_view; }
+        const glm::mat4& inverseProjection()        const { return m_inverse_projection; }
+        const glm::mat4& inverseViewProjection()    const { return m_inverse_view_projection; }
+        const glm::mat4& jitteredProjection()       const { return m_jittered_projection; }
+        const glm::mat4& unjitteredViewProjection() const { return m_unjittered_view_projection; }
+        const Frustum&   frustum()                  const { return m_frustum; }
+
+        /* The unjittered view projection of the previous update(), for the motion vectors. */
+        const glm::mat4& previousViewProjection() const { return m_previous_view_projection; }
+
+        /*
+         * Sub-pixel offset of the projection in NDC units (2 / the render target's size is a pixel), for the temporal
+         * anti-aliasing. Applied to the cached matrices right away, it stays until the next call.
+         */
+        void setJitter(const glm::vec2& ndc_offset);
+        glm::vec2 jitter() const { return m_jitter; }
+
         void update(double dt);
 
         glm::mat4 m_view;
@@ -161,6 +185,19 @@ namespace RGL
         bool      m_is_dirty;
         bool      m_is_mouse_move;
 
+        glm::mat4 m_view_projection         = glm::mat4(1.0f);
+        glm::mat4 m_inverse_view            = glm::mat4(1.0f);
+        glm::mat4 m_inverse_projection      = glm::mat4(1.0f);
+        glm::mat4 m_inverse_view_projection = glm::mat4(1.0f);
+        glm::mat4 m_cached_projection       = glm::mat4(0.0f);
+        Frustum   m_frustum;
+
+        glm::vec2 m_jitter                     = glm::vec2(0.0f);
+        glm::mat4 m_jittered_projection        = glm::mat4(1.0f);
+        glm::mat4 m_unjittered_view_projection = glm::mat4(1.0f);
+        glm::mat4 m_previous_view_projection   = glm::mat4(1.0f);
+
         void move(const glm::vec3 & position, const glm::vec3& dir, float amount);
+        void updateJitteredMatrices();
     };
 }
@@ -0,0 +1,94 @@
+#include "camera_path.h"
+#include "camera.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/spline.hpp>
+
+namespace RGL
+{
+    bool CameraPath::Load(const std::filesystem::path& filepath)
+    {
+        std::ifstream file(filepath);
+
+        if (!file)
+        {
+            fprintf(stderr, "Could not open camera path file %s\n", filepath.string().c_str());
+            return false;
+        }
+
+        m_keys.clear();
+
+        std::string line;
+        uint32_t    line_number = 0;
+
+        while (std::getline(file, line))
+        {
+            line_number++;
+
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+
+            std::istringstream stream(line);
+            Key                key;
+
+            stream >> key.m_position.x    >> key.m_position.y    >> key.m_position.z
+                   >> key.m_orientation.w >> key.m_orientation.x >> key.m_orientation.y >> key.m_orientation.z;
+
+            if (stream.fail())
+            {
+                fprintf(stderr, "Camera path %s: invalid key at line %u\n", filepath.string().c_str(), line_number);
+                continue;
+            }
+
+            AddKey(key.m_position, key.m_orientation);
+        }
+
+        return !m_keys.empty();
+    }
+
+    void CameraPath::AddKey(const glm::vec3& position, const glm::quat& orientation)
+    {
+        m_keys.push_back({ position, glm::normalize(orientation) });
+    }
+
+    CameraPath::Key CameraPath::Evaluate(float t) const
+    {
+        if (m_keys.size() < 2)
+        {
+            return m_keys.empty() ? Key{ glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f) } : m_keys[0];
+        }
+
+        const float    segment_t = glm::clamp(t, 0.0f, 1.0f) * float(m_keys.size() - 1);
+        const uint32_t last      = uint32_t(m_keys.size() - 1);
+        const uint32_t i1        = glm::min(uint32_t(segment_t), last - 1);
+        const uint32_t i0        = i1 > 0 ? i1 - 1 : 0;
+        const uint32_t i2        = i1 + 1;
+        const uint32_t i3        = glm::min(i2 + 1, last);
+        const float    s         = segment_t - float(i1);
+
+        Key key;
+        key.m_position    = glm::catmullRom(m_keys[i0].m_position, m_keys[i1].m_position, m_keys[i2].m_position, m_keys[i3].m_position, s);
+        key.m_orientation = glm::slerp(m_keys[i1].m_orientation, m_keys[i2].m_orientation, s);
+
+        return key;
+    }
+
+    void CameraPath::Apply(Camera& camera, float t) const
+    {
+        if (m_keys.empty())
+        {
+            return;
+        }
+
+        Key key = Evaluate(t);
+
+        camera.setPosition   (key.m_position);
+        camera.setOrientation(key.m_orientation);
+    }
+}
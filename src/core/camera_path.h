@@ -0,0 +1,43 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+#include <glm/vec3.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace RGL
+{
+    class Camera;
+
+    /*
+     * Camera spline played back by the benchmark mode. The keys are evenly spaced in time - the positions are
+     * interpolated with a Catmull-Rom spline, the orientations with slerp.
+     *
+     * The text file has one key per line, "px py pz qw qx qy qz" (the same order as the camera info printed by the demos),
+     * the lines starting with # are comments.
+     */
+    class CameraPath final
+    {
+    public:
+        struct Key
+        {
+            glm::vec3 m_position;
+            glm::quat m_orientation;
+        };
+
+        bool Load(const std::filesystem::path& filepath);
+        void AddKey(const glm::vec3& position, const glm::quat& orientation);
+        void Clear() { m_keys.clear(); }
+
+        /* t in range [0, 1]. */
+        Key  Evaluate(float t) const;
+        void Apply   (Camera& camera, float t) const;
+
+        bool     IsEmpty()      const { return m_keys.empty(); }
+        uint32_t GetKeysCount() const { return uint32_t(m_keys.size()); }
+
+    private:
+        std::vector<Key> m_keys;
+    };
+}
@@ -1,40 +1,328 @@
 #include "core_app.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <thread>
 #include <vector>
 
-#include "stb_image_write.h"
-#include "stb_image_resize.h"
-
+#include "camera.h"
+#include "debug_output_gl.h"
+#include "debug_view.h"
 #include "filesystem.h"
+#include "frame_allocator.h"
+#include "frame_capture.h"
+#include "geometry_pool.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+#include "image_based_lighting.h"
 #include "input.h"
+#include "job_system.h"
+#include "lazy_resource.h"
+#include "mipmap_generator.h"
+#include "profiler.h"
+#include "render_thread.h"
+#include "render_target_pool.h"
+#include "sampler_cache.h"
+#include "shader.h"
+#include "shader_watcher.h"
+#include "texture_cache.h"
+#include "texture_streamer.h"
 #include "timer.h"
+#include "trace.h"
+#include "video_capture.h"
 #include "window.h"
 
 #include "gui/gui.h"
+#include "gui/gui_renderer.h"
 
 namespace RGL
 {
+    namespace
+    {
+        /* The window title without the characters that aren't allowed in the file names. */
+        std::string GetFileName(const std::string& title)
+        {
+            std::string filename = title;
+            std::replace_if(filename.begin(), filename.end(), [](char c) { return !std::isalnum((unsigned char)c); }, '_');
+
+            return filename;
+        }
+
+        VSyncMode GetVSyncMode(FramePacing pacing)
+        {
+            switch (pacing)
+            {
+                case FramePacing::VSync:         return VSyncMode::On;
+                case FramePacing::AdaptiveVSync: return VSyncMode::Adaptive;
+                default:                         return VSyncMode::Off;
+            }
+        }
+
+        /* Sleeps while the OS timer granularity allows it, yields for the rest. */
+        void WaitUntil(double time)
+        {
+            constexpr double SPIN_TIME = 0.002;
+
+            for (double now = Timer::getTime(); now < time; now = Timer::getTime())
+            {
+                if (time - now > SPIN_TIME)
+                {
+                    std::this_thread::sleep_for(std::chrono::duration<double>(time - now - SPIN_TIME));
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+
     CoreApp::CoreApp()
-        : m_frame_time(0.0),
-          m_fps       (0),
-          m_is_running(false)
+        : m_frame_time             (0.0),
+          m_interpolation_alpha    (0.0),
+          m_fps                    (0),
+          m_rendered_rate          (0.0f),
+          m_is_running             (false),
+          m_frame_pacing           (FramePacing::Fixed),
+          m_max_updates_per_frame  (5),
+          m_max_frames_in_flight   (0),
+          m_use_render_thread      (false),
+          m_render_packet_slot     (0),
+          m_is_gui_drawn           (false),
+          m_capture_every_nth_frame(0),
+          m_is_benchmark           (false),
+          m_benchmark_warmup_frames(100),
+          m_benchmark_frames       (1000),
+          m_window_width           (0),
+          m_window_height          (0)
     {
     }
 
     CoreApp::~CoreApp()
     {
+        /* Writes the pending captures. */
+        m_frame_capture.reset();
+        m_video_capture.reset();
+
+        /* The loads still in flight own GL objects. */
+        ResourcePreloader::Release();
+        JobSystem::Shutdown();
+        TextureStreamer::Release();
+        TextureCache::Release();
+        SamplerCache::Release();
+        MipmapGenerator::Release();
+        GUIRenderer::Release();
+        GUI::release();
+        RenderTargetPool::Release();
+        DebugView::Release();
+
+        /* The derived app's models are already released, so the pools are empty. */
+        GeometryPool::ReleaseAll();
+        Profiler::Release();
+
+        /* Last, the views of the pak files' entries are gone by now. */
+        FileSystem::unmountPaks();
+    }
+
+    void CoreApp::parse_command_line(int argc, char* argv[])
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const bool has_value = i + 1 < argc && std::strncmp(argv[i + 1], "--", 2) != 0;
+
+            if (std::strcmp(argv[i], "--benchmark") == 0)
+            {
+                m_is_benchmark = true;
+
+                if (has_value)
+                {
+                    fs::path camera_path = argv[++i];
+
+                    if (!fs::exists(camera_path) && camera_path.is_relative())
+                    {
+                        camera_path = FileSystem::getRootPath() / camera_path;
+                    }
+
+                    if (!m_benchmark_camera_path.Load(camera_path))
+                    {
+                        fprintf(stderr, "Benchmark: the camera path couldn't be loaded, using the demo's static view.\n");
+                    }
+                }
+            }
+            else if (std::strcmp(argv[i], "--warmup") == 0 && has_value)
+            {
+                m_benchmark_warmup_frames = uint32_t(std::max(0, std::atoi(argv[++i])));
+            }
+            else if (std::strcmp(argv[i], "--frames") == 0 && has_value)
+            {
+                m_benchmark_frames = uint32_t(std::max(1, std::atoi(argv[++i])));
+            }
+            else if (std::strcmp(argv[i], "--output") == 0 && has_value)
+            {
+                m_benchmark_output = argv[++i];
+            }
+            else if (std::strcmp(argv[i], "--resolution") == 0 && has_value)
+            {
+                unsigned int width = 0, height = 0;
+
+                if (std::sscanf(argv[++i], "%ux%u", &width, &height) == 2 && width > 0 && height > 0)
+                {
+                    m_window_width  = width;
+                    m_window_height = height;
+                }
+                else
+                {
+                    fprintf(stderr, "Invalid resolution %s, expected <width>x<height>\n", argv[i]);
+                }
+            }
+            else if (std::strcmp(argv[i], "--pacing") == 0 && has_value)
+            {
+                const char* pacing = argv[++i];
+
+                if      (std::strcmp(pacing, "fixed")    == 0) m_frame_pacing = FramePacing::Fixed;
+                else if (std::strcmp(pacing, "uncapped") == 0) m_frame_pacing = FramePacing::Uncapped;
+                else if (std::strcmp(pacing, "vsync")    == 0) m_frame_pacing = FramePacing::VSync;
+                else if (std::strcmp(pacing, "adaptive") == 0) m_frame_pacing = FramePacing::AdaptiveVSync;
+                else    fprintf(stderr, "Unknown frame pacing %s\n", pacing);
+            }
+            else if (std::strcmp(argv[i], "--frames-in-flight") == 0 && has_value)
+            {
+                m_max_frames_in_flight = uint32_t(std::max(0, std::atoi(argv[++i])));
+            }
+            else if (std::strcmp(argv[i], "--trace") == 0 && has_value)
+            {
+                m_trace_output = argv[++i];
+                Trace::SetEnabled(true);
+            }
+            else if (std::strcmp(argv[i], "--capture") == 0 && has_value)
+            {
+                m_capture_every_nth_frame = uint32_t(std::max(1, std::atoi(argv[++i])));
+            }
+            else if (std::strcmp(argv[i], "--record") == 0)
+            {
+                m_record_encoder = has_value ? argv[++i] : "h264_nvenc";
+            }
+            else if (std::strcmp(argv[i], "--hot-reload") == 0)
+            {
+                ShaderWatcher::SetEnabled(true);
+            }
+            else if (std::strcmp(argv[i], "--stream-textures") == 0)
+            {
+                TextureStreamer::SetEnabled(true);
+
+                if (has_value)
+                {
+                    TextureStreamer::SetBudget(GLsizeiptr(std::max(1, std::atoi(argv[++i]))) << 20);
+                }
+            }
+            else if (std::strcmp(argv[i], "--compute-mipmaps") == 0)
+            {
+                MipmapGenerator::SetEnabled(true);
+            }
+            else if (std::strcmp(argv[i], "--render-thread") == 0)
+            {
+                m_use_render_thread = true;
+            }
+            else if (std::strcmp(argv[i], "--no-gui") == 0)
+            {
+                GUI::setEnabled(false);
+            }
+            else if (std::strcmp(argv[i], "--gui-rate") == 0 && has_value)
+            {
+                GUI::setUpdateRate(float(std::max(0.0, std::atof(argv[++i]))));
+            }
+            else if (std::strcmp(argv[i], "--batched-gui") == 0)
+            {
+                GUIRenderer::SetEnabled(true);
+            }
+            else if (std::strcmp(argv[i], "--texture-cache") == 0 && has_value)
+            {
+                /* MB of the unused textures kept loaded, 0 keeps none of them. */
+                TextureCache::SetBudget(size_t(std::max(0, std::atoi(argv[++i]))) << 20);
+            }
+            else if (std::strcmp(argv[i], "--pak") == 0 && has_value)
+            {
+                fs::path pak_path = argv[++i];
+
+                if (!fs::exists(pak_path) && pak_path.is_relative())
+                {
+                    pak_path = FileSystem::getRootPath() / pak_path;
+                }
+
+                FileSystem::mountPak(pak_path);
+            }
+            else if (std::strcmp(argv[i], "--spirv") == 0)
+            {
+                Shader::setSpirvEnabled(true);
+            }
+            else if (std::strcmp(argv[i], "--bandwidth-saving") == 0)
+            {
+                RenderTargetPool::SetProfile(RenderTargetProfile::BANDWIDTH_SAVING);
+            }
+            else if (std::strcmp(argv[i], "--no-ibl-cache") == 0)
+            {
+                /* The IBL maps are convolved on every load and ibl_cache/ is left as it is. */
+                ImageBasedLighting::SetCacheEnabled(false);
+            }
+            else
+            {
+                fprintf(stderr, "Unknown command line option %s\n", argv[i]);
+            }
+        }
     }
 
     void CoreApp::init(unsigned int width, unsigned int height, const std::string & title, double framerate)
     {
-        m_frame_time = 1.0 / framerate;
+        m_frame_time     = 1.0 / framerate;
+        m_benchmark_name = title;
+
+        if (m_window_width > 0)
+        {
+            width  = m_window_width;
+            height = m_window_height;
+        }
 
         /* Init window */
         Window::createWindow(width, height, title);
 
+        if (m_is_benchmark)
+        {
+            Window::setVSync(false);
+        }
+
+        Window::setMaxFramesInFlight(m_max_frames_in_flight);
+
+        JobSystem::Init();
+
+        m_frame_capture = std::make_unique<FrameCapture>();
+
+        if (m_capture_every_nth_frame > 0)
+        {
+            start_frame_capture(FileSystem::getRootPath() / "captures" / GetFileName(title), "frame", m_capture_every_nth_frame);
+        }
+
+        m_video_capture = std::make_unique<VideoCapture>();
+
+        if (!m_record_encoder.empty())
+        {
+            start_video_capture(FileSystem::getRootPath() / "captures" / (GetFileName(title) + ".mp4"), m_record_encoder);
+        }
+
         init_app();
     }
 
+    void CoreApp::set_benchmark_camera(const std::shared_ptr<Camera>& camera)
+    {
+        m_benchmark_camera = camera;
+    }
+
     void CoreApp::render_gui()
     {
         /* Overlay start */
@@ -45,7 +333,7 @@ namespace RGL
         if (corner != -1)
         {
             ImGui::SetNextWindowPos(window_pos, ImGuiCond_Always, window_pos_pivot);
-            ImGui::SetNextWindowSize({ 250, 0 });
+            ImGui::SetNextWindowSize({ 300, 0 });
         }
 
         ImGui::SetNextWindowBgAlpha(0.3f); // Transparent background
@@ -53,7 +341,49 @@ namespace RGL
         {
             ImGui::Text("Performance info\n");
             ImGui::Separator();
-            ImGui::Text("%.1f FPS (%.3f ms/frame)", ImGui::GetIO().Framerate, 1000.0f / ImGui::GetIO().Framerate);
+            /* ImGui's framerate counts the GUI's rebuilds, in the retained mode they're fewer than the frames. */
+            const float framerate = GUI::getUpdateRate() > 0.0f ? m_rendered_rate : ImGui::GetIO().Framerate;
+            ImGui::Text("%.1f FPS (%.3f ms/frame)", framerate, 1000.0f / std::max(framerate, 1e-3f));
+
+            const auto& gl_stats = GLState::GetFrameStats();
+            ImGui::Text("GL state calls: %u (%u redundant%s)", gl_stats.m_calls, gl_stats.m_redundant_calls, GLState::IsEnabled() ? ", skipped" : "");
+            const auto& present_stats = Window::getPresentStats();
+            ImGui::Text("Present: %.2f ms (%.2f - %.2f), latency wait %.2f ms", present_stats.m_average_ms, present_stats.m_min_ms, present_stats.m_max_ms, present_stats.m_latency_wait_ms);
+            ImGui::Text("Render targets: %u (%.1f MB, %u created)", RenderTargetPool::GetCount(), RenderTargetPool::GetMemorySize() / (1024.0 * 1024.0), RenderTargetPool::GetCreatedCount());
+
+            if (FrameAllocator::IsHeapCountingEnabled())
+            {
+                ImGui::Text("Heap allocations: %llu per frame (arena %.1f KB)", (unsigned long long)FrameAllocator::GetFrameHeapAllocations(), FrameAllocator::GetArena().GetPeakSize() / 1024.0);
+            }
+
+            if (ImGui::CollapsingHeader("GPU memory"))
+            {
+                GpuMemory::RenderGui();
+            }
+
+            if (Profiler::IsEnabled() && ImGui::CollapsingHeader("Passes"))
+            {
+                Profiler::RenderGui();
+            }
+
+            /* Debug contexts only, the driver's performance warnings and the passes they came from. */
+            if (DebugOutputGL::IsEnabled() && ImGui::CollapsingHeader("Driver warnings"))
+            {
+                DebugOutputGL::RenderGui();
+            }
+
+            if (ImGui::CollapsingHeader("Debug view"))
+            {
+                /* The programs are rebuilt with the mode, by the thread of the GL context. */
+                int mode = int(DebugView::GetMode());
+
+                if (ImGui::Combo("Mode", &mode, "None\0Overdraw\0Quad overshading\0"))
+                {
+                    run_on_render_thread([mode] { DebugView::SetMode(DebugViewMode(mode)); });
+                }
+
+                DebugView::RenderGui();
+            }
         }
         ImGui::End();
         /* Overlay end */
@@ -64,6 +394,17 @@ namespace RGL
         return m_fps;
     }
 
+    void CoreApp::set_frame_pacing(FramePacing pacing)
+    {
+        m_frame_pacing = pacing;
+
+        /* Applied by run() otherwise, the window may not exist yet. */
+        if (m_is_running)
+        {
+            run_on_render_thread([pacing] { Window::setVSyncMode(GetVSyncMode(pacing)); });
+        }
+    }
+
     void CoreApp::start()
     {
         if (m_is_running)
@@ -71,7 +412,24 @@ namespace RGL
             return;
         }
 
-        run();
+        if (m_is_benchmark)
+        {
+            run_benchmark();
+        }
+        else
+        {
+            run();
+        }
+
+        if (!m_trace_output.empty())
+        {
+            Trace::SetEnabled(false);
+
+            if (Trace::Export(m_trace_output))
+            {
+                printf("Trace written to %s\n", m_trace_output.string().c_str());
+            }
+        }
     }
 
     void CoreApp::stop()
@@ -86,75 +444,148 @@ namespace RGL
 
     bool CoreApp::take_screenshot_png(const std::string & filename, size_t dst_width, size_t dst_height)
     {
-        size_t width  = Window::getWidth();
-        size_t height = Window::getHeight();
-        bool   resize = true;
+        if (!m_frame_capture)
+        {
+            return false;
+        }
 
-        if (dst_width == 0 || dst_height == 0)
+        auto screenshots_dir = FileSystem::getRootPath() / "screenshots";
+        if (!FileSystem::directoryExists(screenshots_dir))
         {
-            resize = false;
+            FileSystem::createDirectory(screenshots_dir);
         }
 
-        std::vector<uint8_t> image;
-        image.resize(width * height * 3);
+        auto filepath = screenshots_dir / filename;
+        filepath += ".png";
+
+        run_on_render_thread([this, filepath, dst_width, dst_height] { m_frame_capture->RequestScreenshot(filepath, dst_width, dst_height); });
 
-        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, image.data());
+        return true;
+    }
 
-        if (resize)
+    void CoreApp::start_frame_capture(const std::filesystem::path& directory, const std::string& prefix, uint32_t every_nth_frame, size_t dst_width, size_t dst_height)
+    {
+        if (!m_frame_capture)
         {
-            auto resized_image = image;
-            stbir_resize_uint8(image.data(), width, height, 0, resized_image.data(), dst_width, dst_height, 0, 3);
+            return;
+        }
 
-            width  = dst_width;
-            height = dst_height;
-            image  = resized_image;
+        run_on_render_thread([this, directory, prefix, every_nth_frame, dst_width, dst_height]
+        {
+            m_frame_capture->StartContinuous(directory, prefix, every_nth_frame, dst_width, dst_height);
+        });
+    }
+
+    void CoreApp::stop_frame_capture()
+    {
+        if (m_frame_capture)
+        {
+            run_on_render_thread([this] { m_frame_capture->StopContinuous(); });
         }
+    }
 
-        auto screenshots_dir = FileSystem::getRootPath() / "screenshots";
-        if (!FileSystem::directoryExists(screenshots_dir))
+    void CoreApp::start_video_capture(const std::filesystem::path& filepath, const std::string& encoder, size_t dst_width, size_t dst_height)
+    {
+        if (!m_video_capture)
         {
-            FileSystem::createDirectory(screenshots_dir);
+            return;
         }
 
-        auto filepath = screenshots_dir / filename;
-        filepath += ".png";
+        VideoCapture::Encoder video_encoder;
+
+        if (!VideoCapture::ParseEncoder(encoder, video_encoder))
+        {
+            fprintf(stderr, "Unknown video encoder %s\n", encoder.c_str());
+            return;
+        }
+
+        /* The video plays at the fixed step's rate. */
+        const uint32_t fps = uint32_t(std::lround(1.0 / m_frame_time));
 
-        stbi_flip_vertically_on_write(true);
-        auto ret = stbi_write_png(filepath.string().c_str(), width, height, 3, image.data(), 0);
+        run_on_render_thread([this, filepath, video_encoder, fps, dst_width, dst_height]
+        {
+            m_video_capture->Start(filepath, video_encoder, fps, uint32_t(dst_width), uint32_t(dst_height));
+        });
+    }
+
+    void CoreApp::stop_video_capture()
+    {
+        if (m_video_capture)
+        {
+            run_on_render_thread([this] { m_video_capture->Stop(); });
+        }
+    }
 
-        return ret;
+    void CoreApp::run_on_render_thread(std::function<void()> request)
+    {
+        if (m_render_thread)
+        {
+            m_pending_requests.push_back(std::move(request));
+        }
+        else
+        {
+            request();
+        }
     }
 
     void CoreApp::run()
     {
         m_is_running = true;
 
+        Window::setVSyncMode(GetVSyncMode(m_frame_pacing));
+
+        const bool use_render_thread = m_use_render_thread && has_render_packets();
+
+        if (m_use_render_thread && !use_render_thread)
+        {
+            fprintf(stderr, "The demo has no render packets, the render thread mode is off.\n");
+        }
+
+        if (use_render_thread)
+        {
+            /* The main thread makes no GL calls from now on. */
+            GUI::createDeviceObjects();
+
+            m_render_thread = std::make_unique<RenderThread>();
+            m_render_thread->Start([this](uint32_t slot) { render_frame(slot); });
+        }
+
+        uint32_t submitted_frames = 0;
+
         int frames = 0;
         double frame_counter = 0.0;
 
         double last_time = Timer::getTime();
         double unprocessed_time = 0.0;
 
-        double start_time = 0.0;
-        double passed_time = 0.0;
-
-        bool should_render = false;
-
         while (m_is_running)
         {
-            should_render = false;
-
-            start_time = Timer::getTime();
-            passed_time = start_time - last_time;
+            double start_time  = Timer::getTime();
+            double passed_time = start_time - last_time;
 
             last_time = start_time;
 
             unprocessed_time += passed_time;
-            frame_counter += passed_time;
+            frame_counter    += passed_time;
 
-            while (unprocessed_time > m_frame_time)
+            /* The render thread does these at the beginning of its frames. */
+            if (!use_render_thread)
             {
-                should_render = true;
+                /* Rebuilds the shaders whose files changed, before any of them is used this frame. */
+                ShaderWatcher::Update();
+
+                /* The next levels of the streamed textures, within the per-frame budget. */
+                TextureStreamer::Update();
+
+                /* The lazy resources the demo requested, then the preloads. */
+                ResourcePreloader::Update();
+            }
+
+            uint32_t updates_count = 0;
+
+            while (unprocessed_time >= m_frame_time && updates_count < m_max_updates_per_frame)
+            {
+                updates_count++;
 
                 unprocessed_time -= m_frame_time;
 
@@ -164,33 +595,414 @@ namespace RGL
                 }
 
                 /* Update input, game entities, etc. */
+                RGL_TRACE_ZONE("Update");
+
+                /* The events since the previous step, the catch-up steps of a frame get none of them twice. */
+                Input::update();
                 input();
                 update(m_frame_time);
-                Input::update();
 
                 if (frame_counter >= 1.0)
                 {
-                    m_fps = 1000.0 / (double)frames;
+                    m_fps           = 1000.0 / (double)frames;
+                    m_rendered_rate = float(frames / frame_counter);
 
                     frames = 0;
                     frame_counter = 0;
                 }
             }
 
-            if (should_render)
+            /* The updates are slower than the real time - drop the backlog instead of catching up forever. */
+            if (unprocessed_time >= m_frame_time)
+            {
+                unprocessed_time = std::fmod(unprocessed_time, m_frame_time);
+            }
+
+            /* In the fixed mode there's nothing new to render without an update. */
+            if (updates_count > 0 || m_frame_pacing != FramePacing::Fixed)
+            {
+                m_interpolation_alpha = unprocessed_time / m_frame_time;
+
+                if (use_render_thread)
+                {
+                    submit_frame(submitted_frames++ % RENDER_PACKETS_COUNT);
+                }
+                else
+                {
+                    if (has_render_packets())
+                    {
+                        RGL_TRACE_ZONE("Extract");
+                        extract_render_packet(0);
+                    }
+
+                    /* Render */
+                    Profiler::BeginFrame();
+                    {
+                        {
+                            RGL_TRACE_ZONE("Render");
+                            DebugView::BeginFrame(uint32_t(Window::getWidth()), uint32_t(Window::getHeight()));
+                            render();
+                            DebugView::Render();
+                        }
+
+                        if (GUI::isEnabled())
+                        {
+                            RGL_TRACE_ZONE("GUI");
+                            ProfilerScope scope("GUI");
+
+                            if (GUI::prepare())
+                            {
+                                render_gui();
+                            }
+                            GUI::render();
+                        }
+
+                        {
+                            RGL_TRACE_ZONE("Frame capture");
+                            ProfilerScope scope("Frame capture");
+
+                            m_frame_capture->Update();
+                        }
+
+                        if (m_video_capture->IsRecording())
+                        {
+                            RGL_TRACE_ZONE("Video capture");
+                            ProfilerScope scope("Video capture");
+
+                            m_video_capture->Update();
+                        }
+                    }
+                    Profiler::EndFrame();
+
+                    {
+                        RGL_TRACE_ZONE("Swap");
+
+                        Window::endFrame();
+                        GLState::EndFrame();
+                        RenderTargetPool::EndFrame();
+                        GpuMemory::EndFrame();
+                        FrameAllocator::EndFrame();
+                    }
+                }
+                frames++;
+            }
+
+            /* Sleep until the next update is due instead of spinning. */
+            if (m_frame_pacing == FramePacing::Fixed)
+            {
+                RGL_TRACE_ZONE("Wait");
+                WaitUntil(start_time + m_frame_time - unprocessed_time);
+            }
+        }
+
+        if (m_render_thread)
+        {
+            m_render_thread->Stop();
+            m_render_thread.reset();
+
+            /* Left by the last frames, the context is the main thread's again. */
+            for (auto& request : m_pending_requests)
+            {
+                request();
+            }
+
+            m_pending_requests.clear();
+        }
+    }
+
+    void CoreApp::submit_frame(uint32_t slot)
+    {
+        /* The simulation state of this frame, while the render thread still renders the previous one. */
+        {
+            RGL_TRACE_ZONE("Extract");
+            extract_render_packet(slot);
+        }
+
+        /* The GUI, the stats of the overlay and the requests are the render thread's while it renders. */
+        m_render_thread->WaitIdle();
+
+        m_is_gui_drawn = GUI::isEnabled();
+
+        if (m_is_gui_drawn)
+        {
+            RGL_TRACE_ZONE("GUI");
+
+            if (GUI::prepare())
+            {
+                render_gui();
+            }
+            GUI::endFrame();
+        }
+
+        m_render_requests.insert(m_render_requests.end(), std::make_move_iterator(m_pending_requests.begin()), std::make_move_iterator(m_pending_requests.end()));
+        m_pending_requests.clear();
+
+        m_render_thread->Submit(slot);
+
+        /* The render thread resets its own arena, this one holds the main thread's scratch of the frame. */
+        FrameAllocator::ResetArena();
+
+        /* The callbacks of the events run here, on the main thread. */
+        Window::pollEvents();
+    }
+
+    void CoreApp::render_frame(uint32_t slot)
+    {
+        for (auto& request : m_render_requests)
+        {
+            request();
+        }
+
+        m_render_requests.clear();
+
+        ShaderWatcher::Update();
+        TextureStreamer::Update();
+        ResourcePreloader::Update();
+
+        m_render_packet_slot = slot;
+
+        Profiler::BeginFrame();
+        {
+            {
+                RGL_TRACE_ZONE("Render");
+                DebugView::BeginFrame(uint32_t(Window::getWidth()), uint32_t(Window::getHeight()));
+                render();
+                DebugView::Render();
+            }
+
+            if (m_is_gui_drawn)
+            {
+                RGL_TRACE_ZONE("GUI");
+                ProfilerScope scope("GUI");
+
+                GUI::draw();
+            }
+
+            {
+                RGL_TRACE_ZONE("Frame capture");
+                ProfilerScope scope("Frame capture");
+
+                m_frame_capture->Update();
+            }
+
+            if (m_video_capture->IsRecording())
             {
-                /* Render */
+                RGL_TRACE_ZONE("Video capture");
+                ProfilerScope scope("Video capture");
+
+                m_video_capture->Update();
+            }
+        }
+        Profiler::EndFrame();
+
+        {
+            RGL_TRACE_ZONE("Swap");
+
+            Window::swapBuffers();
+            GLState::EndFrame();
+            RenderTargetPool::EndFrame();
+            GpuMemory::EndFrame();
+            FrameAllocator::EndFrame();
+        }
+    }
+
+    void CoreApp::run_benchmark()
+    {
+        m_is_running = true;
+
+        const uint32_t total_frames = m_benchmark_warmup_frames + m_benchmark_frames;
+
+        std::vector<float> frame_ms(m_benchmark_frames, 0.0f);
+        std::vector<float> cpu_ms  (m_benchmark_frames, 0.0f);
+        std::vector<float> gpu_ms  (m_benchmark_frames, 0.0f);
+
+        /* By the Profiler's scope index, the indices are stable. */
+        std::vector<BenchmarkPass> passes;
+
+        /* The exact GPU times are worth the waits for the frame before the previous one. */
+        Profiler::SetEnabled       (true);
+        Profiler::SetWaitForResults(true);
+
+        uint64_t first_measured_frame = 0;
+        double   last_time            = Timer::getTime();
+
+        /* The extra frames resolve the GPU times of the last measured ones. */
+        for (uint32_t frame = 0; frame < total_frames + Profiler::FRAMES_COUNT; ++frame)
+        {
+            if (Window::isCloseRequested() || !m_is_running)
+            {
+                fprintf(stderr, "Benchmark aborted, no results written.\n");
+                m_is_running = false;
+                return;
+            }
+
+            /* Both the warmup and the measurement play back the whole path, with a fixed time step. */
+            if (m_benchmark_camera && frame < total_frames)
+            {
+                const bool  is_warmup = frame < m_benchmark_warmup_frames;
+                const float t         = is_warmup ? float(frame) / float(std::max(m_benchmark_warmup_frames, 1u))
+                                                  : float(frame - m_benchmark_warmup_frames) / float(std::max(m_benchmark_frames - 1, 1u));
+
+                m_benchmark_camera_path.Apply(*m_benchmark_camera, t);
+            }
+
+            Input::update();
+            input();
+            update(m_frame_time);
+
+            Profiler::BeginFrame();
+            {
+                if (frame == m_benchmark_warmup_frames)
+                {
+                    first_measured_frame = Profiler::GetFrame();
+                }
+
+                /* The root scope of the resolved frame. */
+                const auto& resolved_scopes = Profiler::GetResolvedScopes();
+
+                if (first_measured_frame > 0 && Profiler::GetResolvedFrame() >= first_measured_frame && !resolved_scopes.empty())
+                {
+                    const uint64_t measured_frame = Profiler::GetResolvedFrame() - first_measured_frame;
+
+                    if (measured_frame < m_benchmark_frames)
+                    {
+                        cpu_ms[measured_frame] = Profiler::GetScope(resolved_scopes[0]).m_cpu_ms;
+                        gpu_ms[measured_frame] = Profiler::GetScope(resolved_scopes[0]).m_gpu_ms;
+
+                        for (uint32_t index : resolved_scopes)
+                        {
+                            const auto& scope = Profiler::GetScope(index);
+
+                            if (index >= passes.size())
+                            {
+                                passes.resize(index + 1);
+                            }
+
+                            if (passes[index].m_name.empty())
+                            {
+                                passes[index].m_name = scope.m_name;
+
+                                for (auto* parent = &scope; parent->m_depth > 0;)
+                                {
+                                    parent = &Profiler::GetScope(parent->m_parent);
+                                    passes[index].m_name = parent->m_name + "/" + passes[index].m_name;
+                                }
+                            }
+
+                            passes[index].m_cpu_ms.push_back(scope.m_cpu_ms);
+                            passes[index].m_gpu_ms.push_back(scope.m_gpu_ms);
+                        }
+                    }
+                }
+
+                /* Single-threaded, the benchmark measures the frame as a whole. */
+                if (has_render_packets())
+                {
+                    extract_render_packet(0);
+                }
+
                 render();
 
-                GUI::prepare();
+                /* A recorded run, the pass's times are in the results. */
+                if (m_video_capture->IsRecording())
                 {
-                    render_gui();
+                    RGL_TRACE_ZONE("Video capture");
+                    ProfilerScope scope("Video capture");
+
+                    m_video_capture->Update();
                 }
-                GUI::render();
+            }
+            Profiler::EndFrame();
 
-                Window::endFrame();
-                frames++;
+            Window::endFrame();
+            GLState::EndFrame();
+            RenderTargetPool::EndFrame();
+            FrameAllocator::EndFrame();
+
+            const double current_time = Timer::getTime();
+
+            if (frame >= m_benchmark_warmup_frames && frame < total_frames)
+            {
+                frame_ms[frame - m_benchmark_warmup_frames] = float((current_time - last_time) * 1000.0);
+            }
+
+            last_time = current_time;
+        }
+
+        Profiler::SetWaitForResults(false);
+
+        write_benchmark_results(frame_ms, cpu_ms, gpu_ms, passes);
+
+        m_is_running = false;
+    }
+
+    bool CoreApp::write_benchmark_results(const std::vector<float>& frame_ms, const std::vector<float>& cpu_ms, const std::vector<float>& gpu_ms,
+                                          const std::vector<BenchmarkPass>& passes) const
+    {
+        auto filepath = m_benchmark_output;
+
+        if (filepath.empty())
+        {
+            auto benchmarks_dir = FileSystem::getRootPath() / "benchmarks";
+            if (!FileSystem::directoryExists(benchmarks_dir))
+            {
+                FileSystem::createDirectory(benchmarks_dir);
+            }
+
+            filepath = benchmarks_dir / (GetFileName(m_benchmark_name) + ".csv");
+        }
+
+        std::ofstream file(filepath);
+
+        if (!file)
+        {
+            fprintf(stderr, "Could not open benchmark output file %s\n", filepath.string().c_str());
+            return false;
+        }
+
+        /* Nearest rank percentile. */
+        auto percentile = [](std::vector<float> values, float p)
+        {
+            std::sort(values.begin(), values.end());
+
+            size_t rank = size_t(std::ceil(p * values.size()));
+            return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+        };
+
+        file << "frame,frame_ms,cpu_ms,gpu_ms\n";
+
+        for (size_t i = 0; i < frame_ms.size(); ++i)
+        {
+            file << i << "," << frame_ms[i] << "," << cpu_ms[i] << "," << gpu_ms[i] << "\n";
+        }
+
+        file << "\npercentile,frame_ms,cpu_ms,gpu_ms\n";
+
+        for (float p : { 0.5f, 0.95f, 0.99f })
+        {
+            file << "p" << int(p * 100.0f + 0.5f) << "," << percentile(frame_ms, p) << "," << percentile(cpu_ms, p) << "," << percentile(gpu_ms, p) << "\n";
+
+            printf("Benchmark p%d: frame %.3f ms, cpu %.3f ms, gpu %.3f ms\n", int(p * 100.0f + 0.5f), percentile(frame_ms, p), percentile(cpu_ms, p), percentile(gpu_ms, p));
+        }
+
+        /* The medians of the frames the scope ran in, the names can't have commas. */
+        file << "\npass,cpu_ms,gpu_ms\n";
+
+        for (const auto& pass : passes)
+        {
+            if (pass.m_name.empty())
+            {
+                continue;
             }
+
+            std::string name = pass.m_name;
+            std::replace(name.begin(), name.end(), ',', ';');
+
+            file << name << "," << percentile(pass.m_cpu_ms, 0.5f) << "," << percentile(pass.m_gpu_ms, 0.5f) << "\n";
         }
+
+        printf("Benchmark results written to %s\n", filepath.string().c_str());
+
+        return true;
     }
 }
@@ -1,9 +1,27 @@
 #pragma once
 #include "common.h"
+#include "camera_path.h"
+
+#include <filesystem>
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace RGL
 {
+    class FrameCapture;
+    class VideoCapture;
+    class RenderThread;
+
+    /*
+     * Fixed         - update() at the fixed framerate, render() after the updates, the waits between the frames sleep.
+     * Uncapped      - update() at the fixed framerate, render() as often as possible with VSync off.
+     * VSync         - as Uncapped, but the swap waits for the vertical blank.
+     * AdaptiveVSync - as VSync, but the late frames are presented right away (see VSyncMode::Adaptive).
+     */
+    enum class FramePacing { Fixed, Uncapped, VSync, AdaptiveVSync };
+
     class CoreApp
     {
     public:
@@ -13,6 +31,29 @@ namespace RGL
         CoreApp(const CoreApp&)            = delete;
         CoreApp& operator=(const CoreApp&) = delete;
 
+        /*
+         * Parses the options shared by all the demos. Has to be called before init().
+         *
+         * --benchmark [camera path file] - uncapped, GUI-less run along the camera path (see CameraPath), writes the per
+         *                                  frame times, their percentiles and the profiler scopes' medians to a CSV file and exits.
+         * --warmup <frames>              - frames rendered before the measurement, 100 by default.
+         * --frames <frames>              - measured frames, 1000 by default.
+         * --output <csv file>            - benchmarks/<window title>.csv by default.
+         * --resolution <width>x<height>  - the window's size instead of the demo's, for the comparable benchmark runs.
+         * --capture <N>                  - saves every Nth frame to captures/<window title>/, see start_frame_capture().
+         * --record [encoder]             - records the run to captures/<window title>.mp4, h264_nvenc by default, see start_video_capture().
+         * --pacing <fixed|uncapped|vsync|adaptive> - see FramePacing, fixed by default.
+         * --frames-in-flight <N>         - the frames queued ahead of the GPU, see Window::setMaxFramesInFlight().
+         * --trace <json file>            - records the CPU zones (see Trace) and exports them when the app stops.
+         * --no-gui                       - neither builds nor renders the GUI, see GUI::setEnabled().
+         * --gui-rate <rebuilds per second> - the GUI's retained mode, see GUI::setUpdateRate().
+         * --render-thread                - the render thread mode of the demos with the render packets, see has_render_packets().
+         * --pak <pak file>               - reads the files in the pak from it instead of the disk, see FileSystem::mountPak().
+         * --bandwidth-saving             - the packed formats of the HDR render targets, see RenderTargetProfile.
+         * --spirv                        - loads the shaders from the SPIR-V modules of the rgl_spirv target, see Shader::setSpirvEnabled().
+         */
+        void parse_command_line(int argc, char* argv[]);
+
         virtual void init(unsigned int width, unsigned int height, const std::string & title, double framerate = 60.0) final;
 
         virtual void init_app()                = 0;
@@ -23,16 +64,105 @@ namespace RGL
 
         unsigned int get_fps() const;
 
+        void        set_frame_pacing(FramePacing pacing);
+        FramePacing get_frame_pacing() const { return m_frame_pacing; }
+
+        /* Limits the fixed updates per frame, the time past the limit is dropped instead of caught up. */
+        void set_max_updates_per_frame(uint32_t max_updates) { m_max_updates_per_frame = max_updates > 0 ? max_updates : 1; }
+
+        /*
+         * Fraction of the fixed time step accumulated since the last update(), in range [0, 1).
+         * render() can interpolate between the previous and the current simulation state with it.
+         */
+        double get_interpolation_alpha() const { return m_interpolation_alpha; }
+
         virtual void start() final;
         virtual void stop()  final;
 
+        /* Asynchronous - the screenshot of the current frame is written to screenshots/<filename>.png a few frames later. */
         virtual bool take_screenshot_png(const std::string & filename, size_t dst_width = 0, size_t dst_height = 0);
 
+        /* Saves every Nth frame to directory/<prefix>_<number>.png, without stalling - frames are dropped instead. */
+        void start_frame_capture(const std::filesystem::path& directory, const std::string& prefix, uint32_t every_nth_frame, size_t dst_width = 0, size_t dst_height = 0);
+        void stop_frame_capture();
+
+        /*
+         * Records the frames to an H.264 or HEVC video with a hardware encoder - h264_nvenc, hevc_nvenc, h264_vaapi or
+         * hevc_vaapi through ffmpeg, see VideoCapture. The frames are converted on the GPU and never read back on the render thread.
+         */
+        void start_video_capture(const std::filesystem::path& filepath, const std::string& encoder = "h264_nvenc", size_t dst_width = 0, size_t dst_height = 0);
+        void stop_video_capture();
+
+    protected:
+        static constexpr uint32_t RENDER_PACKETS_COUNT = 2;
+
+        /* The camera moved along the benchmark camera path. Demos without a camera are benchmarked with a static view. */
+        void set_benchmark_camera(const std::shared_ptr<Camera>& camera);
+
+        /*
+         * The render packets - a demo that has them copies everything its render() reads to the slot's packet in
+         * extract_render_packet(), and render() reads only the packet of get_render_packet_slot(). Then CoreApp can run
+         * render() on a render thread that owns the GL context (--render-thread): the main thread simulates the next
+         * frame and extracts it to the other slot meanwhile, the render thread stays at most a frame behind.
+         * In that mode input(), update(), extract_render_packet() and render_gui() make no GL calls, render_gui() runs
+         * while the render thread is idle. Without the render thread the slot is always 0, extracted before render().
+         */
+        virtual bool has_render_packets() const          { return false; }
+        virtual void extract_render_packet(uint32_t slot) {}
+        uint32_t     get_render_packet_slot() const       { return m_render_packet_slot; }
+
     private:
         void run();
+        void run_benchmark();
+
+        /* The main thread's and the render thread's part of a frame in the render thread mode. */
+        void submit_frame(uint32_t slot);
+        void render_frame(uint32_t slot);
+
+        /* The GL work of the calls from the main thread, deferred to the render thread's next frame if there's one. */
+        void run_on_render_thread(std::function<void()> request);
+
+        /* The times of a Profiler scope over the measured frames, named by its path - as "Frame/Shadows". */
+        struct BenchmarkPass
+        {
+            std::string        m_name;
+            std::vector<float> m_cpu_ms;
+            std::vector<float> m_gpu_ms;
+        };
+
+        bool write_benchmark_results(const std::vector<float>& frame_ms, const std::vector<float>& cpu_ms, const std::vector<float>& gpu_ms,
+                                     const std::vector<BenchmarkPass>& passes) const;
 
         double       m_frame_time;
+        double       m_interpolation_alpha;
         unsigned int m_fps;
+        float        m_rendered_rate; /* Frames per second, over the last second. */
         bool         m_is_running;
+        FramePacing  m_frame_pacing;
+        uint32_t     m_max_updates_per_frame;
+        uint32_t     m_max_frames_in_flight;
+
+        bool                               m_use_render_thread;
+        std::unique_ptr<RenderThread>      m_render_thread;
+        uint32_t                           m_render_packet_slot;
+        bool                               m_is_gui_drawn;
+        std::vector<std::function<void()>> m_pending_requests; /* Main thread. */
+        std::vector<std::function<void()>> m_render_requests;  /* Render thread, handed over while it's idle. */
+
+        std::filesystem::path         m_trace_output;
+        std::unique_ptr<FrameCapture> m_frame_capture;
+        uint32_t                      m_capture_every_nth_frame;
+        std::unique_ptr<VideoCapture> m_video_capture;
+        std::string                   m_record_encoder; /* --record, empty - not recording. */
+
+        bool                    m_is_benchmark;
+        uint32_t                m_benchmark_warmup_frames;
+        uint32_t                m_benchmark_frames;
+        std::filesystem::path   m_benchmark_output;
+        std::string             m_benchmark_name;
+        uint32_t                m_window_width;         /* --resolution, 0 - the demo's. */
+        uint32_t                m_window_height;
+        CameraPath              m_benchmark_camera_path;
+        std::shared_ptr<Camera> m_benchmark_camera;
     };
 }
@@ -0,0 +1,331 @@
+#ifdef __cplusplus
+#pragma once
+#define vec3  alignas(16) glm::vec3
+#define vec4  alignas(16) glm::vec4
+#define mat4  alignas(16) glm::mat4
+#define uint  alignas(4)  uint32_t
+#define uvec2 alignas(8)  uint64_t
+#endif
+
+/*
+ * Data shared between the core library and the GLSL shaders.
+ * GLSL shaders can include this file directly, e.g. #include "../../core/core_shared.h"
+ */
+
+#define MESH_DRAW_DATA_SSBO_BINDING_INDEX            16
+#define CULLING_OBJECTS_SSBO_BINDING_INDEX           17
+#define CULLING_COMMANDS_SSBO_BINDING_INDEX          18
+#define CULLING_VISIBLE_INSTANCES_SSBO_BINDING_INDEX 19
+#define MESHLETS_SSBO_BINDING_INDEX                  20
+#define MESHLET_BATCHES_SSBO_BINDING_INDEX           21
+#define MESHLET_COMMANDS_SSBO_BINDING_INDEX          22
+#define INSTANCE_DATA_SSBO_BINDING_INDEX             23
+#define GEN_PRIMITIVE_VERTICES_SSBO_BINDING_INDEX    24
+#define GEN_PRIMITIVE_INDICES_SSBO_BINDING_INDEX     25
+#define VIRTUAL_TEXTURE_FEEDBACK_SSBO_BINDING_INDEX  26
+#define MIPMAP_COUNTERS_SSBO_BINDING_INDEX           27
+#define MIPMAP_TILES_SSBO_BINDING_INDEX              28
+#define IBL_SH_SSBO_BINDING_INDEX                    29
+#define BONE_PALETTES_SSBO_BINDING_INDEX             30
+#define SKINNING_VERTICES_SSBO_BINDING_INDEX         31
+#define SKINNED_VERTICES_SSBO_BINDING_INDEX          32
+#define MATERIALS_SSBO_BINDING_INDEX                 33
+#define DEPTH_PYRAMID_SSBO_BINDING_INDEX             34
+#define GUI_CLIP_RECTS_SSBO_BINDING_INDEX            35
+#define DEBUG_VIEW_SSBO_BINDING_INDEX                36
+#define CURVES_SSBO_BINDING_INDEX                    37
+#define VIDEO_CAPTURE_SSBO_BINDING_INDEX             38
+
+/* The core uniform buffer bindings start at 16 as well, the lower ones are left to the demos. */
+#define IBL_SH_UBO_BINDING_INDEX            16
+#define REFLECTION_PROBES_UBO_BINDING_INDEX 17
+#define IRRADIANCE_VOLUME_UBO_BINDING_INDEX 18
+
+/* Texture units of VirtualTexture::Bind(), see shaders/virtual_texture.glh. */
+#define VIRTUAL_TEXTURE_UNIT            14
+#define VIRTUAL_TEXTURE_PAGE_TABLE_UNIT 15
+#define VIRTUAL_TEXTURE_MAX_LEVELS      16
+
+/* Cubemap array of ReflectionProbes::Bind(), see shaders/reflection_probes.glh. */
+#define REFLECTION_PROBES_UNIT      13
+#define REFLECTION_PROBES_MAX_COUNT 16
+
+/* Bone matrices of AnimatedModel::BindBakedAnimations(), see shaders/baked_animation.glh. */
+#define BAKED_ANIMATIONS_UNIT 12
+
+/* The harmonics of IrradianceVolume::Bind(), see shaders/irradiance_volume.glh. */
+#define IRRADIANCE_VOLUME_UNIT 11
+
+#define CULLING_GROUP_SIZE   64
+#define HIZ_GROUP_SIZE       8
+#define PRIMITIVE_GROUP_SIZE 64
+
+/* MipmapGenerator: a group reduces a 64x64 tile to 1x1, the image units limit a dispatch to 8 output levels. */
+#define MIPMAP_GROUP_SIZE      16
+#define MIPMAP_TILE_SIZE       64
+#define MIPMAP_TILE_LEVELS     6
+#define MIPMAP_DISPATCH_LEVELS 8
+
+/* ImageBasedLighting: a single group projects the environment cubemap's level of at most IBL_SH_SOURCE_SIZE^2 faces. */
+#define IBL_SH_GROUP_SIZE  256
+#define IBL_SH_SOURCE_SIZE 64
+#define IBL_PREFILTER_GROUP_SIZE 8
+
+#define SKINNING_GROUP_SIZE 64
+
+/* DynamicResolution: EASU and RCAS, a thread per output pixel. */
+#define UPSCALE_GROUP_SIZE 8
+
+/* TemporalAA: the history resolve, a thread per output pixel. */
+#define TAA_GROUP_SIZE 8
+
+/* MsaaResolve: a thread per pixel. */
+#define MSAA_RESOLVE_GROUP_SIZE 8
+
+/* VideoCapture: a thread per 4x2 block of the NV12 frame. */
+#define VIDEO_CAPTURE_GROUP_SIZE 8
+
+/* VariableRateShading: a group per shading rate image texel, the rate levels are the entries of its palette. */
+#define SHADING_RATE_GROUP_SIZE 16
+#define SHADING_RATE_LEVEL_1X1  0
+#define SHADING_RATE_LEVEL_2X2  1
+#define SHADING_RATE_LEVEL_4X4  2
+
+/* ScreenSpaceReflections: the trace and the temporal resolve, a thread per half resolution pixel. */
+#define SSR_GROUP_SIZE 8
+
+/*
+ * DepthPyramid: a group reduces a 64x64 tile of the depth to the 32x32 texels of the level 0 and on to 1x1,
+ * the image units limit the pyramid to 8 levels.
+ */
+#define DEPTH_PYRAMID_GROUP_SIZE  16
+#define DEPTH_PYRAMID_TILE_SIZE   64
+#define DEPTH_PYRAMID_TILE_LEVELS 6
+#define DEPTH_PYRAMID_MAX_LEVELS  8
+
+/* CurveBatch: the most segments the tessellation splits a curve into, the hardware limit is 64. */
+#define CURVE_MAX_SEGMENTS 64
+
+/* DebugView: a shaded fragment adds 12 to its pixel's counter, so the quad overshading's 4 / live pixels stays whole. */
+#define DEBUG_VIEW_COUNTER_SCALE 12
+
+/* Bit (1 << texture type) of MaterialData::flags. */
+#define MATERIAL_HAS_ALBEDO_MAP    (1 << 0)
+#define MATERIAL_HAS_NORMAL_MAP    (1 << 1)
+#define MATERIAL_HAS_METALLIC_MAP  (1 << 2)
+#define MATERIAL_HAS_ROUGHNESS_MAP (1 << 3)
+#define MATERIAL_HAS_AO_MAP        (1 << 4)
+#define MATERIAL_HAS_EMISSIVE_MAP  (1 << 5)
+
+/* The albedo's alpha is a coverage mask, the depth only passes have to alpha test the material. */
+#define MATERIAL_ALPHA_MASKED      (1 << 8)
+
+/* Must match the order of Material::TextureType. */
+#define MATERIAL_TEXTURE_ALBEDO    0
+#define MATERIAL_TEXTURE_NORMAL    1
+#define MATERIAL_TEXTURE_METALLIC  2
+#define MATERIAL_TEXTURE_ROUGHNESS 3
+#define MATERIAL_TEXTURE_AO        4
+#define MATERIAL_TEXTURE_EMISSIVE  5
+#define MATERIAL_TEXTURES_COUNT    6
+
+/* A compiled Material, entry Material::GetIndex() of the global materials SSBO (Material::BindMaterials()). */
+struct MaterialData
+{
+    vec3  albedo;
+    float ao;
+    vec3  emission;
+    float roughness;
+    float metallic;
+    uint  flags;
+
+    /* ARB_bindless_texture handles, 0 if the texture is not present or bindless textures are disabled. */
+    uvec2 texture_handles[MATERIAL_TEXTURES_COUNT];
+};
+
+/*
+ * Per mesh part data used by StaticModel::RenderIndirect().
+ * Entry index = gl_DrawID + u_draw_id_offset.
+ */
+struct MeshDrawData
+{
+    uint material_index;
+};
+
+/*
+ * Object tested by GpuCulling. Bounds are a world space sphere (xyz - center, w - radius).
+ * The visible objects' instance ids are written to the range of the command they are drawn with.
+ */
+struct CullingObject
+{
+    vec4 bounds;
+    uint command_index;
+    uint instance_id;
+};
+
+/*
+ * Meshlet of a StaticModel mesh part (object space). The meshlet's triangles are a separate range of the model's index buffer.
+ * Backfacing when dot(normalize(cone_apex.xyz - camera_position), cone_axis.xyz) >= cone_apex.w.
+ */
+struct MeshletData
+{
+    vec4 bounds;
+    vec4 cone_apex;
+    vec4 cone_axis;
+    uint first_index;
+    uint indices_count;
+    uint base_vertex;
+    uint batch_index;
+};
+
+/* Range of the output commands for the meshlets of one material batch and the number of the visible ones. */
+struct MeshletBatch
+{
+    uint first_meshlet;
+    uint visible_count;
+};
+
+/* Per instance data of an InstanceBatch, entry index = gl_InstanceID. */
+struct InstanceData
+{
+    mat4 model_matrix;
+    uint material_index;
+    uint padding0;
+    uint padding1;
+    uint padding2;
+};
+
+/*
+ * A cubic Bezier curve of a CurveBatch, entry index = the patch's instance. control_points: xyz - the world space
+ * position, w - the ribbon's width there, interpolated along the curve with the same weights.
+ */
+struct CurveData
+{
+    vec4 control_points[4];
+    vec4 color;
+};
+
+/* A vertex skinned by AnimatedModel::Skin(), world space. Texcoord - xy. */
+struct SkinnedVertex
+{
+    vec4 position;
+    vec4 normal;
+    vec4 tangent;
+    vec4 texcoord;
+};
+
+/*
+ * Header of the VirtualTexture feedback buffer, followed by one uint per page of the paged levels - the last frame
+ * the page was sampled in. Page index = level_offsets[level] + y * (pages_x >> level) + x.
+ */
+struct VirtualTextureInfo
+{
+    uint pages_x;       /* Pages of the level 0, also the size of the page table. */
+    uint pages_y;
+    uint paged_levels;  /* The levels from this one on are the mip tail, always resident. */
+    uint frame;
+    uint level_offsets[VIRTUAL_TEXTURE_MAX_LEVELS];
+};
+
+/*
+ * L2 spherical harmonics of the environment's diffuse irradiance divided by PI, the cosine lobe is already
+ * convolved in - evaluated with shIrradiance() (shaders/ibl/sh_irradiance.glh). rgb - coefficient, w - unused.
+ */
+struct IrradianceSH
+{
+    vec4 coefficients[9];
+};
+
+/* A captured ReflectionProbe: xyz - position, w - radius of its influence. layer - the cube of the probe in the array. */
+struct ReflectionProbeData
+{
+    vec4 position_radius;
+    uint layer;
+    uint padding0;
+    uint padding1;
+    uint padding2;
+};
+
+struct ReflectionProbesData
+{
+    uint                probes_count;
+    uint                padding0;
+    uint                padding1;
+    uint                padding2;
+    ReflectionProbeData probes[REFLECTION_PROBES_MAX_COUNT];
+};
+
+/*
+ * The grid of an IrradianceVolume: the probe (i, j, k) is at origin + (i, j, k) / inv_spacing. origin.w - the offset
+ * of the sampled point along the normal, in the world units. resolution.xyz - the probes per axis.
+ */
+struct IrradianceVolumeData
+{
+    vec4 origin;
+    vec4 inv_spacing;
+    vec4 resolution;
+};
+
+#ifndef __cplusplus
+layout(std430, binding = MESH_DRAW_DATA_SSBO_BINDING_INDEX) readonly buffer MeshDrawDataSSBO
+{
+    MeshDrawData mesh_draw_data[];
+};
+
+uniform uint u_draw_id_offset;
+
+layout(std430, binding = MATERIALS_SSBO_BINDING_INDEX) readonly buffer MaterialsSSBO
+{
+    MaterialData materials[];
+};
+
+/* The material of a draw of StaticModel::RenderIndirect() and the one set by Material::SetUniforms(). */
+#define MESH_DRAW_MATERIAL(draw_index) materials[mesh_draw_data[draw_index].material_index]
+
+uniform uint u_material_index;
+
+#define MATERIAL materials[u_material_index]
+
+/* The shader has to enable GL_ARB_bindless_texture before including this file. */
+#ifdef GL_ARB_bindless_texture
+#define MESH_DRAW_TEXTURE(draw_index, texture_type) sampler2D(MESH_DRAW_MATERIAL(draw_index).texture_handles[texture_type])
+#endif
+
+/* Instance id of the object that survived GpuCulling - use it in the vertex shader instead of gl_InstanceID. */
+#ifndef CULLING_PASS
+layout(std430, binding = CULLING_VISIBLE_INSTANCES_SSBO_BINDING_INDEX) readonly buffer CullingVisibleInstancesSSBO
+{
+    uint culling_visible_instances[];
+};
+
+#define CULLED_INSTANCE_ID culling_visible_instances[gl_BaseInstance + gl_InstanceID]
+#endif
+
+layout(std430, binding = INSTANCE_DATA_SSBO_BINDING_INDEX) readonly buffer InstanceDataSSBO
+{
+    InstanceData instance_data[];
+};
+
+#define INSTANCE_DATA instance_data[gl_InstanceID]
+
+/* The bone palettes of AnimatedModel::EvaluateInstances(), bones_count matrices per instance. */
+layout(std430, binding = BONE_PALETTES_SSBO_BINDING_INDEX) readonly buffer BonePalettesSSBO
+{
+    mat4 bone_palettes[];
+};
+
+#define BONE_MATRIX(instance, bone, bones_count) bone_palettes[(instance) * (bones_count) + (bone)]
+
+layout(std430, binding = CURVES_SSBO_BINDING_INDEX) readonly buffer CurvesSSBO
+{
+    CurveData curves[];
+};
+#endif
+
+#ifdef __cplusplus
+#undef vec3
+#undef vec4
+#undef mat4
+#undef uint
+#undef uvec2
+#endif
@@ -0,0 +1,145 @@
+#include "curve_batch.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "gl_state.h"
+#include "gpu_memory.h"
+
+namespace RGL
+{
+    CurveBatch::CurveBatch()
+        : m_vao_name   (0),
+          m_buffer_name(0),
+          m_capacity   (0),
+          m_dirty_first(UINT32_MAX),
+          m_dirty_last (0)
+    {
+    }
+
+    CurveBatch::~CurveBatch()
+    {
+        Release();
+    }
+
+    uint32_t CurveBatch::Add(const glm::vec4 (&control_points)[4], const glm::vec4& color)
+    {
+        m_curves.emplace_back();
+
+        uint32_t index = uint32_t(m_curves.size() - 1);
+        Set(index, control_points, color);
+
+        return index;
+    }
+
+    void CurveBatch::Set(uint32_t index, const glm::vec4 (&control_points)[4], const glm::vec4& color)
+    {
+        CurveData& curve = m_curves[index];
+
+        std::copy(std::begin(control_points), std::end(control_points), std::begin(curve.control_points));
+        curve.color = color;
+
+        MarkDirty(index);
+    }
+
+    void CurveBatch::Reserve(uint32_t count)
+    {
+        m_curves.reserve(count);
+    }
+
+    void CurveBatch::Clear()
+    {
+        m_curves.clear();
+
+        m_dirty_first = UINT32_MAX;
+        m_dirty_last  = 0;
+    }
+
+    void CurveBatch::MarkDirty(uint32_t index)
+    {
+        m_dirty_first = std::min(m_dirty_first, index);
+        m_dirty_last  = std::max(m_dirty_last,  index + 1);
+    }
+
+    void CurveBatch::Update()
+    {
+        if (m_dirty_first >= m_dirty_last || m_curves.empty())
+        {
+            return;
+        }
+
+        /* The storage is immutable - grow by recreating the buffer and uploading everything. */
+        if (m_curves.size() > m_capacity)
+        {
+            GpuMemory::UntrackBuffer(m_buffer_name);
+            glDeleteBuffers(1, &m_buffer_name);
+
+            m_capacity = std::max<uint32_t>(uint32_t(m_curves.size()), m_capacity * 2);
+
+            glCreateBuffers     (1, &m_buffer_name);
+            glNamedBufferStorage(m_buffer_name, sizeof(CurveData) * m_capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+            GpuMemory::TrackBuffer(m_buffer_name, "CurveBatch");
+
+            m_dirty_first = 0;
+        }
+
+        /* The range may outlive a Clear() and the curves added after it. */
+        uint32_t last = std::min<uint32_t>(m_dirty_last, uint32_t(m_curves.size()));
+
+        if (m_dirty_first < last)
+        {
+            glNamedBufferSubData(m_buffer_name, sizeof(CurveData) * m_dirty_first, sizeof(CurveData) * (last - m_dirty_first), &m_curves[m_dirty_first]);
+        }
+
+        m_dirty_first = UINT32_MAX;
+        m_dirty_last  = 0;
+    }
+
+    void CurveBatch::Bind() const
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CURVES_SSBO_BINDING_INDEX, m_buffer_name);
+    }
+
+    void CurveBatch::Render()
+    {
+        if (m_curves.empty())
+        {
+            return;
+        }
+
+        Update();
+        Bind();
+
+        if (m_vao_name == 0)
+        {
+            glCreateVertexArrays(1, &m_vao_name);
+        }
+
+        GLint patch_vertices;
+        glGetIntegerv(GL_PATCH_VERTICES, &patch_vertices);
+
+        /* The control points come from the buffer, a patch is just the curve's instance. */
+        glPatchParameteri(GL_PATCH_VERTICES, 1);
+
+        GLState::BindVertexArray(m_vao_name);
+        glDrawArraysInstanced(GL_PATCHES, 0, 1, GLsizei(m_curves.size()));
+
+        glPatchParameteri(GL_PATCH_VERTICES, patch_vertices);
+    }
+
+    void CurveBatch::Release()
+    {
+        GpuMemory::UntrackBuffer(m_buffer_name);
+        glDeleteBuffers(1, &m_buffer_name);
+
+        if (m_vao_name)
+        {
+            glDeleteVertexArrays(1, &m_vao_name);
+            GLState::OnVertexArrayDeleted(m_vao_name);
+        }
+
+        m_vao_name    = 0;
+        m_buffer_name = 0;
+        m_capacity    = 0;
+    }
+}
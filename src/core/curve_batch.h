@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/vec4.hpp>
+
+#include "core_shared.h"
+
+namespace RGL
+{
+    /*
+     * Cubic Bezier curves - cables, hair strands, grass blades - drawn all at once. The control points are kept in
+     * an SSBO (CurveData, see core_shared.h), Render() is a single instanced draw of one-vertex patches, a patch per
+     * curve, so the CPU cost doesn't grow with the count. The shaders/curves.vert, curves.tcs and curves.tes stages
+     * read the curve of their patch, cull the ones outside the frustum and tessellate the rest by their projected
+     * length - one segment per u_pixels_per_segment pixels, up to CURVE_MAX_SEGMENTS. With RIBBONS defined the curves
+     * are expanded to camera facing strips of their width, lines of a pixel otherwise. The fragment shader is the
+     * caller's, the TES passes it the position, the tangent, the color and the coordinate across the ribbon.
+     *
+     *     auto shader = std::make_shared<Shader>("src/core/shaders/curves.vert", "hair.frag", "src/core/shaders/curves.tcs", "src/core/shaders/curves.tes");
+     *     shader->setDefine("RIBBONS");
+     *     shader->link();
+     *
+     *     curves.Add({ p0, p1, p2, p3 }, color);
+     *     shader->bind();  // u_view_projection, u_camera_position, u_viewport_size, u_pixels_per_segment.
+     *     curves.Render();
+     */
+    class CurveBatch final
+    {
+    public:
+        CurveBatch();
+        ~CurveBatch();
+
+        CurveBatch           (const CurveBatch&) = delete;
+        CurveBatch& operator=(const CurveBatch&) = delete;
+
+        /* xyz - the control point, w - the width at it. Returns the index of the new curve. */
+        uint32_t Add(const glm::vec4 (&control_points)[4], const glm::vec4& color);
+
+        void Set    (uint32_t index, const glm::vec4 (&control_points)[4], const glm::vec4& color);
+        void Reserve(uint32_t count);
+        void Clear();
+
+        const CurveData& Get(uint32_t index) const { return m_curves[index]; }
+        uint32_t         GetCount()          const { return uint32_t(m_curves.size()); }
+        GLuint           GetBuffer()         const { return m_buffer_name; }
+
+        /* Uploads the changed range. Called by Render(), only needed when the buffer is used directly. */
+        void Update();
+
+        /* Binds the curves buffer at CURVES_SSBO_BINDING_INDEX. */
+        void Bind() const;
+
+        /* Draws every curve with the bound shader, the patch size is restored afterwards. */
+        void Render();
+
+    private:
+        void MarkDirty(uint32_t index);
+        void Release();
+
+        std::vector<CurveData> m_curves;
+
+        /* Empty, the vertex shader has no inputs. */
+        GLuint   m_vao_name;
+        GLuint   m_buffer_name;
+        uint32_t m_capacity;
+        uint32_t m_dirty_first;
+        uint32_t m_dirty_last;
+    };
+}
@@ -0,0 +1,240 @@
+#include "debug_output_gl.h"
+
+#include <cassert>
+#include <cstdio>
+
+#include "profiler.h"
+#include "timer.h"
+
+#include "gui/gui.h"
+
+namespace RGL
+{
+    bool                                                        DebugOutputGL::s_is_enabled = false;
+    std::mutex                                                  DebugOutputGL::s_mutex;
+    std::deque<DebugOutputGL::PerformanceWarning>               DebugOutputGL::s_warnings;
+    std::unordered_map<uint64_t, DebugOutputGL::PrintedMessage> DebugOutputGL::s_printed_messages;
+
+    void DebugOutputGL::Enable()
+    {
+        glEnable(GL_DEBUG_OUTPUT);
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+
+        glDebugMessageCallback(GLerrorCallback, nullptr /*userParam*/);
+        glDebugMessageControl(GL_DONT_CARE /*source*/, GL_DONT_CARE /*type*/, GL_DEBUG_SEVERITY_MEDIUM /*severity*/, 0 /*count*/, nullptr /*ids*/, GL_TRUE /*enabled*/);
+
+        /* The drivers report most of the performance warnings with the low severities, disabled by default. */
+        glDebugMessageControl(GL_DONT_CARE /*source*/, GL_DEBUG_TYPE_PERFORMANCE /*type*/, GL_DONT_CARE /*severity*/, 0 /*count*/, nullptr /*ids*/, GL_TRUE /*enabled*/);
+
+        s_is_enabled = true;
+    }
+
+    void STDCALL DebugOutputGL::GLerrorCallback(GLenum source,
+                                                GLenum type,
+                                                GLuint id,
+                                                GLenum severity,
+                                                GLsizei length,
+                                                const GLchar * msg,
+                                                const void   * data)
+    {
+        if (type == GL_DEBUG_TYPE_PERFORMANCE)
+        {
+            RecordPerformanceWarning(source, id, severity, msg);
+            return;
+        }
+
+        if (severity == GL_DEBUG_SEVERITY_NOTIFICATION)
+        {
+            return;
+        }
+
+        PrintMessage(source, type, id, severity, msg);
+    }
+
+    void DebugOutputGL::RecordPerformanceWarning(GLenum source, GLuint id, GLenum severity, const GLchar* msg)
+    {
+        const double time  = Timer::getTime();
+        const auto   scope = Profiler::GetCurrentScopePath();
+
+        std::lock_guard lock(s_mutex);
+
+        for (auto it = s_warnings.rbegin(); it != s_warnings.rend(); ++it)
+        {
+            if (it->m_id == id && it->m_source == source && it->m_scope == scope && time - it->m_time < RATE_LIMIT_SECONDS)
+            {
+                it->m_frame = Profiler::GetFrame();
+                it->m_time  = time;
+                it->m_count++;
+                return;
+            }
+        }
+
+        if (s_warnings.size() == MAX_WARNINGS)
+        {
+            s_warnings.pop_front();
+        }
+
+        s_warnings.push_back({ Profiler::GetFrame(), time, id, source, severity, 1, scope, msg });
+    }
+
+    void DebugOutputGL::PrintMessage(GLenum source, GLenum type, GLuint id, GLenum severity, const GLchar* msg)
+    {
+        const double   time = Timer::getTime();
+        const uint64_t key  = uint64_t(source & 0xFFFF) << 48 | uint64_t(type & 0xFFFF) << 32 | id;
+
+        uint32_t skipped_count = 0;
+
+        {
+            std::lock_guard lock(s_mutex);
+
+            auto [it, is_new] = s_printed_messages.try_emplace(key, PrintedMessage{ time, 0 });
+
+            if (!is_new)
+            {
+                if (time - it->second.m_time < RATE_LIMIT_SECONDS)
+                {
+                    it->second.m_skipped_count++;
+                    return;
+                }
+
+                skipped_count = it->second.m_skipped_count;
+                it->second    = { time, 0 };
+            }
+        }
+
+        char repeated[64] = "";
+
+        if (skipped_count > 0)
+        {
+            snprintf(repeated, sizeof(repeated), " Repeated:   %u times since the last print\n", skipped_count);
+        }
+
+        fprintf(stderr,
+            "********** GL Debug Output **********\n"
+            " Source:     %s\n"
+            " Type:       %s\n"
+            " Severity:   %s\n"
+            " Debug call: %s\n"
+            "%s"
+            "*************************************\n\n",
+            getStringForSource(source).c_str(),
+            getStringForType(type).c_str(),
+            getStringForSeverity(severity).c_str(),
+            msg,
+            repeated
+        );
+    }
+
+    std::deque<DebugOutputGL::PerformanceWarning> DebugOutputGL::GetPerformanceWarnings()
+    {
+        std::lock_guard lock(s_mutex);
+        return s_warnings;
+    }
+
+    void DebugOutputGL::ClearPerformanceWarnings()
+    {
+        std::lock_guard lock(s_mutex);
+        s_warnings.clear();
+    }
+
+    void DebugOutputGL::RenderGui()
+    {
+        const auto warnings = GetPerformanceWarnings();
+
+        if (warnings.empty())
+        {
+            ImGui::Text("No performance warnings.");
+            return;
+        }
+
+        if (ImGui::Button("Clear"))
+        {
+            ClearPerformanceWarnings();
+        }
+
+        if (ImGui::BeginTable("##DriverWarnings", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+        {
+            ImGui::TableSetupColumn("Frame");
+            ImGui::TableSetupColumn("Pass");
+            ImGui::TableSetupColumn("Count");
+            ImGui::TableSetupColumn("Message", ImGuiTableColumnFlags_WidthStretch);
+            ImGui::TableHeadersRow();
+
+            /* The newest first. */
+            for (auto it = warnings.rbegin(); it != warnings.rend(); ++it)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)it->m_frame);
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(it->m_scope.empty() ? "-" : it->m_scope.c_str());
+                ImGui::TableNextColumn(); ImGui::Text("%u", it->m_count);
+                ImGui::TableNextColumn(); ImGui::TextWrapped("%s", it->m_message.c_str());
+            }
+
+            ImGui::EndTable();
+        }
+    }
+
+    std::string DebugOutputGL::getStringForSource(GLenum source)
+    {
+        switch (source)
+        {
+        case GL_DEBUG_SOURCE_API:
+            return "API";
+        case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
+            return "Window system";
+        case GL_DEBUG_SOURCE_SHADER_COMPILER:
+            return "Shader compiler";
+        case GL_DEBUG_SOURCE_THIRD_PARTY:
+            return "Third party";
+        case GL_DEBUG_SOURCE_APPLICATION:
+            return "Application";
+        case GL_DEBUG_SOURCE_OTHER:
+            return "Other";
+        default:
+            assert(false);
+            return "";
+        }
+    }
+
+    std::string DebugOutputGL::getStringForType(GLenum type)
+    {
+        switch (type)
+        {
+        case GL_DEBUG_TYPE_ERROR:
+            return "Error";
+        case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+            return "Deprecated behavior";
+        case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
+            return "Undefined behavior";
+        case GL_DEBUG_TYPE_PORTABILITY:
+            return "Portability issue";
+        case GL_DEBUG_TYPE_PERFORMANCE:
+            return "Performance issue";
+        case GL_DEBUG_TYPE_MARKER:
+            return "Stream annotation";
+        case GL_DEBUG_TYPE_OTHER:
+            return "Other";
+        default:
+            assert(false);
+            return "";
+        }
+    }
+
+    std::string DebugOutputGL::getStringForSeverity(GLenum severity)
+    {
+        switch (severity)
+        {
+        case GL_DEBUG_SEVERITY_HIGH:
+            return "High";
+        case GL_DEBUG_SEVERITY_MEDIUM:
+            return "Medium";
+        case GL_DEBUG_SEVERITY_LOW:
+            return "Low";
+        case GL_DEBUG_SEVERITY_NOTIFICATION:
+            return "Notification";
+        default:
+            assert(false);
+            return("");
+        }
+    }
+}
@@ -1,8 +1,10 @@
 #pragma once
 
-#include <cassert>
-#include <cstdio>
+#include <cstdint>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
 #include <glad/glad.h>
 
@@ -14,102 +16,71 @@
 
 namespace RGL
 {
+    /*
+     * The GL debug output of the debug contexts. Enable() registers the callback with the synchronous output, so
+     * a message comes from within the call that caused it. The errors and the other messages are printed, but
+     * the same message at most once every RATE_LIMIT_SECONDS - with the count of the repeats skipped since.
+     *
+     * The driver's performance warnings (GL_DEBUG_TYPE_PERFORMANCE - buffer stalls, shader recompiles, implicit
+     * syncs) aren't printed. They are kept with the frame and the Profiler scope that were current when the driver
+     * reported them, the last MAX_WARNINGS of them, and the Perf info overlay lists them through RenderGui().
+     * A warning repeated in the same scope within RATE_LIMIT_SECONDS of its last occurrence only counts up its entry,
+     * so a stall of every frame is one entry with the frame of the latest one.
+     */
     class DebugOutputGL final
     {
     public:
-        DebugOutputGL() {}
-        ~DebugOutputGL() {}
+        static constexpr double   RATE_LIMIT_SECONDS = 1.0;
+        static constexpr uint32_t MAX_WARNINGS       = 64;
 
-        static void STDCALL GLerrorCallback(GLenum source,
-                                              GLenum type,
-                                              GLuint id,
-                                              GLenum severity,
-                                              GLsizei length,
-                                              const GLchar * msg,
-                                              const void   * data)
+        struct PerformanceWarning
         {
-            if (severity == GL_DEBUG_SEVERITY_NOTIFICATION)
-            {
-                return;
-            }
+            uint64_t    m_frame;     /* Profiler::GetFrame() of the last occurrence, 0 if the profiler is disabled. */
+            double      m_time;      /* Timer::getTime() of the last occurrence. */
+            GLuint      m_id;
+            GLenum      m_source;
+            GLenum      m_severity;
+            uint32_t    m_count;     /* Of the occurrences, the rate limited ones included. */
+            std::string m_scope;     /* The path of the Profiler scopes, "" outside of any. */
+            std::string m_message;
+        };
+
+        /* Registers the callback, the context has to be a debug one. */
+        static void Enable();
+        static bool IsEnabled() { return s_is_enabled; }
+
+        static void STDCALL GLerrorCallback(GLenum source,
+                                            GLenum type,
+                                            GLuint id,
+                                            GLenum severity,
+                                            GLsizei length,
+                                            const GLchar * msg,
+                                            const void   * data);
 
-            printf(
-                "********** GL Debug Output **********\n"
-                " Source:     %s\n"
-                " Type:       %s\n"
-                " Severity:   %s\n"
-                " Debug call: %s\n"
-                "*************************************\n\n",
-                getStringForSource(source).c_str(),
-                getStringForType(type).c_str(),
-                getStringForSeverity(severity).c_str(),
-                msg
-            );
-        }
+        /* Copies of the recorded warnings, the newest last. */
+        static std::deque<PerformanceWarning> GetPerformanceWarnings();
+        static void                           ClearPerformanceWarnings();
+
+        /* The table of the warnings with the scopes they were reported in. */
+        static void RenderGui();
 
     private:
-        static std::string getStringForSource(GLenum source)
+        struct PrintedMessage
         {
-            switch (source)
-            {
-            case GL_DEBUG_SOURCE_API:
-                return "API";
-            case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
-                return "Window system";
-            case GL_DEBUG_SOURCE_SHADER_COMPILER:
-                return "Shader compiler";
-            case GL_DEBUG_SOURCE_THIRD_PARTY:
-                return "Third party";
-            case GL_DEBUG_SOURCE_APPLICATION:
-                return "Application";
-            case GL_DEBUG_SOURCE_OTHER:
-                return "Other";
-            default:
-                assert(false);
-                return "";
-            }
-        }
+            double   m_time;
+            uint32_t m_skipped_count;
+        };
 
-        static std::string getStringForType(GLenum type)
-        {
-            switch (type)
-            {
-            case GL_DEBUG_TYPE_ERROR:
-                return "Error";
-            case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
-                return "Deprecated behavior";
-            case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
-                return "Undefined behavior";
-            case GL_DEBUG_TYPE_PORTABILITY:
-                return "Portability issue";
-            case GL_DEBUG_TYPE_PERFORMANCE:
-                return "Performance issue";
-            case GL_DEBUG_TYPE_MARKER:
-                return "Stream annotation";
-            case GL_DEBUG_TYPE_OTHER:
-                return "Other";
-            default:
-                assert(false);
-                return "";
-            }
-        }
+        static void RecordPerformanceWarning(GLenum source, GLuint id, GLenum severity, const GLchar* msg);
+        static void PrintMessage(GLenum source, GLenum type, GLuint id, GLenum severity, const GLchar* msg);
 
-        static std::string getStringForSeverity(GLenum severity)
-        {
-            switch (severity)
-            {
-            case GL_DEBUG_SEVERITY_HIGH:
-                return "High";
-            case GL_DEBUG_SEVERITY_MEDIUM:
-                return "Medium";
-            case GL_DEBUG_SEVERITY_LOW:
-                return "Low";
-            case GL_DEBUG_SEVERITY_NOTIFICATION:
-                return "Notification";
-            default:
-                assert(false);
-                return("");
-            }
-        }
+        static std::string getStringForSource  (GLenum source);
+        static std::string getStringForType    (GLenum type);
+        static std::string getStringForSeverity(GLenum severity);
+
+        static bool                                          s_is_enabled;
+        static std::mutex                                    s_mutex;
+        static std::deque<PerformanceWarning>                s_warnings;
+        static std::unordered_map<uint64_t, PrintedMessage>  s_printed_messages;
     };
 }
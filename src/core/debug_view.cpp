@@ -0,0 +1,221 @@
+#include "debug_view.h"
+
+#include <cstdio>
+#include <string>
+
+#include "core_shared.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+#include "shader.h"
+#include "shader_watcher.h"
+
+#include "gui/gui.h"
+
+namespace RGL
+{
+    namespace
+    {
+        /* uvec2 size, uint counters[] - as in shaders/debug_view.frag. */
+        constexpr GLsizeiptr BUFFER_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+        /* Appended to the shaders that don't include core_shared.h too, so the names are spelled out. */
+        std::string getCountersBlock()
+        {
+            return "layout(std430, binding = " + std::to_string(DEBUG_VIEW_SSBO_BINDING_INDEX) + ") buffer RglDebugViewSSBO\n"
+                   "{\n"
+                   "    uvec2 rgl_debug_view_size;\n"
+                   "    uint  rgl_debug_view_counters[];\n"
+                   "};\n"
+                   "\n"
+                   "void rgl_debug_view_add(uint count)\n"
+                   "{\n"
+                   "    uvec2 pixel = uvec2(gl_FragCoord.xy);\n"
+                   "\n"
+                   "    if (!gl_HelperInvocation && all(lessThan(pixel, rgl_debug_view_size)))\n"
+                   "    {\n"
+                   "        atomicAdd(rgl_debug_view_counters[pixel.y * rgl_debug_view_size.x + pixel.x], count);\n"
+                   "    }\n"
+                   "}\n";
+        }
+
+        std::string getInstrumentation(DebugViewMode mode)
+        {
+            const std::string scale = std::to_string(DEBUG_VIEW_COUNTER_SCALE);
+
+            switch (mode)
+            {
+                case DebugViewMode::OVERDRAW:
+                    return getCountersBlock() +
+                           "\n"
+                           "void main()\n"
+                           "{\n"
+                           "    rgl_instrumented_main();\n"
+                           "    rgl_debug_view_add(" + scale + "u);\n"
+                           "}\n";
+
+                case DebugViewMode::QUAD_OVERSHADING:
+                    /* The neighbours' values from the fine derivatives, before the shader can discard any of the quad. */
+                    return getCountersBlock() +
+                           "\n"
+                           "void main()\n"
+                           "{\n"
+                           "    float live  = gl_HelperInvocation ? 0.0 : 1.0;\n"
+                           "    vec2  side  = 1.0 - 2.0 * vec2(ivec2(gl_FragCoord.xy) & 1);\n"
+                           "    float row   = live + (live + side.x * dFdxFine(live));\n"
+                           "    float quad  = row + (row + side.y * dFdyFine(row));\n"
+                           "    uint  count = uint(round(4.0 * " + scale + ".0 / max(quad, 1.0)));\n"
+                           "\n"
+                           "    rgl_instrumented_main();\n"
+                           "    rgl_debug_view_add(count);\n"
+                           "}\n";
+
+                default:
+                    return {};
+            }
+        }
+    }
+
+    DebugViewMode           DebugView::s_mode        = DebugViewMode::NONE;
+    float                   DebugView::s_max_count   = 8.0f;
+    std::shared_ptr<Shader> DebugView::s_shader;
+    GLuint                  DebugView::s_buffer_name = 0;
+    GLuint                  DebugView::s_vao_name    = 0;
+    uint32_t                DebugView::s_width       = 0;
+    uint32_t                DebugView::s_height      = 0;
+
+    void DebugView::SetMode(DebugViewMode mode)
+    {
+        if (mode == s_mode)
+        {
+            return;
+        }
+
+        if (mode != DebugViewMode::NONE && !s_shader && !Create())
+        {
+            return;
+        }
+
+        s_mode = mode;
+
+        Shader::setFragmentInstrumentation(getInstrumentation(mode));
+        ShaderWatcher::ReloadAll();
+    }
+
+    bool DebugView::Create()
+    {
+        s_shader = std::make_shared<Shader>("src/core/shaders/debug_view.vert", "src/core/shaders/debug_view.frag");
+        s_shader->setInstrumented(false);
+
+        if (!s_shader->link())
+        {
+            fprintf(stderr, "DebugView: the shader failed to link.\n");
+            s_shader.reset();
+
+            return false;
+        }
+
+        /* The fullscreen triangle is generated from gl_VertexID, GL needs a vertex array bound anyway. */
+        glCreateVertexArrays(1, &s_vao_name);
+
+        return true;
+    }
+
+    void DebugView::BeginFrame(uint32_t width, uint32_t height)
+    {
+        if (s_mode == DebugViewMode::NONE || width == 0 || height == 0)
+        {
+            return;
+        }
+
+        const GLsizeiptr counters_size = GLsizeiptr(width) * height * sizeof(uint32_t);
+
+        if (width != s_width || height != s_height)
+        {
+            GpuMemory::UntrackBuffer(s_buffer_name);
+            glDeleteBuffers     (1, &s_buffer_name);
+            glCreateBuffers     (1, &s_buffer_name);
+            glNamedBufferStorage(s_buffer_name, BUFFER_HEADER_SIZE + counters_size, nullptr, 0);
+            GpuMemory::TrackBuffer(s_buffer_name, "DebugView");
+
+            const uint32_t size[] = { width, height };
+            glClearNamedBufferSubData(s_buffer_name, GL_RG32UI, 0, BUFFER_HEADER_SIZE, GL_RG_INTEGER, GL_UNSIGNED_INT, size);
+
+            s_width  = width;
+            s_height = height;
+        }
+
+        glClearNamedBufferSubData(s_buffer_name, GL_R32UI, BUFFER_HEADER_SIZE, counters_size, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DEBUG_VIEW_SSBO_BINDING_INDEX, s_buffer_name);
+    }
+
+    void DebugView::Render()
+    {
+        if (s_mode == DebugViewMode::NONE || s_buffer_name == 0)
+        {
+            return;
+        }
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        GLboolean blend      = glIsEnabled(GL_BLEND);
+        GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+        GLboolean cull_face  = glIsEnabled(GL_CULL_FACE);
+
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, GLsizei(s_width), GLsizei(s_height));
+        glDisable(GL_BLEND);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_CULL_FACE);
+
+        s_shader->bind();
+        s_shader->setUniform("u_max_count", s_max_count);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DEBUG_VIEW_SSBO_BINDING_INDEX, s_buffer_name);
+        GLState::BindVertexArray(s_vao_name);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        blend      ? glEnable(GL_BLEND)      : glDisable(GL_BLEND);
+        depth_test ? glEnable(GL_DEPTH_TEST) : glDisable(GL_DEPTH_TEST);
+        cull_face  ? glEnable(GL_CULL_FACE)  : glDisable(GL_CULL_FACE);
+
+        /* The viewport and the capabilities went past the cache. */
+        GLState::Invalidate();
+    }
+
+    void DebugView::Release()
+    {
+        if (s_vao_name != 0)
+        {
+            glDeleteVertexArrays(1, &s_vao_name);
+            GLState::OnVertexArrayDeleted(s_vao_name);
+        }
+
+        GpuMemory::UntrackBuffer(s_buffer_name);
+        glDeleteBuffers(1, &s_buffer_name);
+
+        Shader::setFragmentInstrumentation({});
+
+        s_shader.reset();
+        s_mode        = DebugViewMode::NONE;
+        s_buffer_name = 0;
+        s_vao_name    = 0;
+        s_width       = 0;
+        s_height      = 0;
+    }
+
+    void DebugView::RenderGui()
+    {
+        ImGui::SliderFloat("Max count", &s_max_count, 1.0f, 32.0f, "%.0f");
+
+        const ImVec4 colors[] = { { 0.0f, 0.0f, 1.0f, 1.0f }, { 0.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 1.0f, 0.0f, 1.0f },
+                                  { 1.0f, 1.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f } };
+
+        for (const ImVec4& color : colors)
+        {
+            ImGui::ColorButton("##Legend", color, ImGuiColorEditFlags_NoTooltip, { 12.0f, 12.0f });
+            ImGui::SameLine(0.0f, 0.0f);
+        }
+
+        ImGui::Text(" 1 .. %.0f, over", s_max_count);
+    }
+}
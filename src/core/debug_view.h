@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <glad/glad.h>
+
+namespace RGL
+{
+    class Shader;
+
+    enum class DebugViewMode { NONE, OVERDRAW, QUAD_OVERSHADING };
+
+    /*
+     * Heatmaps of the fragment shading cost over the frame. Every fragment shader of a Shader is instrumented
+     * (Shader::setFragmentInstrumentation()) to add to its pixel's counter in an SSBO: OVERDRAW counts the shaded
+     * fragments, QUAD_OVERSHADING the invocations of their 2x2 quads - helpers included - shared by the quad's
+     * live pixels. Render() draws the counters as a heatmap over the default framebuffer, from blue at 1 to red
+     * at the max count, white above it.
+     *
+     * The counts are by the pixel position in any target, the shadow maps and the fullscreen passes included,
+     * fragments outside the window are left out. The discarded fragments don't count, and the instrumented shaders
+     * have side effects, so the driver shades the fragments before their depth test - as if there was no early Z.
+     * A mode change rebuilds every program, their uniform locations with them.
+     *
+     * Off by default, toggled from the Perf info overlay. Render thread only.
+     */
+    class DebugView
+    {
+    public:
+        /* Rebuilds all the programs with the mode's instrumentation. */
+        static void          SetMode(DebugViewMode mode);
+        static DebugViewMode GetMode() { return s_mode; }
+
+        static void  SetMaxCount(float count) { s_max_count = count; }
+        static float GetMaxCount()            { return s_max_count; }
+
+        /* Clears and binds the counters of the window's size, before the frame's rendering. */
+        static void BeginFrame(uint32_t width, uint32_t height);
+
+        /* The heatmap over the rendered frame, before the GUI. */
+        static void Render();
+
+        static void Release();
+
+        /* The max count and the legend, the mode is changed by the caller on the render thread. */
+        static void RenderGui();
+
+    private:
+        static bool Create();
+
+        static DebugViewMode           s_mode;
+        static float                   s_max_count;
+        static std::shared_ptr<Shader> s_shader;
+        static GLuint                  s_buffer_name;
+        static GLuint                  s_vao_name;
+        static uint32_t                s_width;
+        static uint32_t                s_height;
+    };
+}
@@ -0,0 +1,165 @@
+#include "depth_pyramid.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include <glm/glm.hpp>
+
+#include "core_shared.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+#include "shader.h"
+#include "texture.h"
+
+namespace RGL
+{
+    namespace
+    {
+        /* The group reduction of the tiles' results holds 32x32 of them after its first level. */
+        constexpr uint32_t MAX_TILES_PER_SIDE = 64;
+        constexpr uint32_t MAX_DEPTH_SIZE     = MAX_TILES_PER_SIDE * DEPTH_PYRAMID_TILE_SIZE;
+
+        /* uint counter, uint padding, vec2 bounds, vec2 tiles[] - as in shaders/depth_pyramid.comp. */
+        constexpr GLsizeiptr BUFFER_HEADER_SIZE = 4 * sizeof(uint32_t);
+        constexpr GLsizeiptr BUFFER_SIZE        = BUFFER_HEADER_SIZE + MAX_TILES_PER_SIDE * MAX_TILES_PER_SIDE * sizeof(glm::vec2);
+    }
+
+    DepthPyramid::~DepthPyramid()
+    {
+        Release();
+    }
+
+    bool DepthPyramid::Create()
+    {
+        m_shader = std::make_shared<Shader>("src/core/shaders/depth_pyramid.comp");
+
+        if (!m_shader->link())
+        {
+            fprintf(stderr, "DepthPyramid: the shader failed to link.\n");
+            return false;
+        }
+
+        glCreateBuffers     (1, &m_buffer_name);
+        glNamedBufferStorage(m_buffer_name, BUFFER_SIZE, nullptr, 0);
+        GpuMemory::TrackBuffer(m_buffer_name, "DepthPyramid");
+
+        /* The last group resets the counter, it stays zero from now on. */
+        glClearNamedBufferData(m_buffer_name, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+        return true;
+    }
+
+    void DepthPyramid::Release()
+    {
+        if (m_texture_name != 0)
+        {
+            GpuMemory::UntrackTexture(m_texture_name);
+            glDeleteTextures(1, &m_texture_name);
+            GLState::OnTextureDeleted(m_texture_name);
+        }
+
+        GpuMemory::UntrackBuffer(m_buffer_name);
+        glDeleteBuffers(1, &m_buffer_name);
+
+        m_buffer_name  = 0;
+        m_texture_name = 0;
+        m_depth_width  = 0;
+        m_depth_height = 0;
+        m_width        = 0;
+        m_height       = 0;
+        m_levels_count = 0;
+    }
+
+    bool DepthPyramid::UpdateTexture(GLuint depth_texture)
+    {
+        GLint depth_width = 0, depth_height = 0;
+        glGetTextureLevelParameteriv(depth_texture, 0, GL_TEXTURE_WIDTH,  &depth_width);
+        glGetTextureLevelParameteriv(depth_texture, 0, GL_TEXTURE_HEIGHT, &depth_height);
+
+        if (depth_width <= 0 || depth_height <= 0 || uint32_t(depth_width) > MAX_DEPTH_SIZE || uint32_t(depth_height) > MAX_DEPTH_SIZE)
+        {
+            return false;
+        }
+
+        if (uint32_t(depth_width) == m_depth_width && uint32_t(depth_height) == m_depth_height)
+        {
+            return true;
+        }
+
+        if (m_texture_name != 0)
+        {
+            GpuMemory::UntrackTexture(m_texture_name);
+            glDeleteTextures(1, &m_texture_name);
+            GLState::OnTextureDeleted(m_texture_name);
+        }
+
+        m_depth_width  = depth_width;
+        m_depth_height = depth_height;
+
+        /* Padded to whole tiles, so the levels 0..5 halve exactly and the tiles' results are the level 5. */
+        m_width        = (m_depth_width  + DEPTH_PYRAMID_TILE_SIZE - 1) / DEPTH_PYRAMID_TILE_SIZE * (DEPTH_PYRAMID_TILE_SIZE / 2);
+        m_height       = (m_depth_height + DEPTH_PYRAMID_TILE_SIZE - 1) / DEPTH_PYRAMID_TILE_SIZE * (DEPTH_PYRAMID_TILE_SIZE / 2);
+        m_levels_count = std::min(uint32_t(Texture::GetMaxMipMapsLevels(m_width, m_height, 0)), uint32_t(DEPTH_PYRAMID_MAX_LEVELS));
+
+        glCreateTextures   (GL_TEXTURE_2D, 1, &m_texture_name);
+        glTextureStorage2D (m_texture_name, m_levels_count, GL_RG32F, m_width, m_height);
+        glTextureParameteri(m_texture_name, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTextureParameteri(m_texture_name, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTextureParameteri(m_texture_name, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+        glTextureParameteri(m_texture_name, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+        GpuMemory::TrackTexture(m_texture_name, "DepthPyramid");
+
+        return true;
+    }
+
+    bool DepthPyramid::Build(GLuint depth_texture)
+    {
+        if (!m_shader || !UpdateTexture(depth_texture))
+        {
+            return false;
+        }
+
+        m_shader->bind();
+        m_shader->setUniform("u_depth_size",   glm::uvec2(m_depth_width, m_depth_height));
+        m_shader->setUniform("u_levels_count", int(m_levels_count));
+
+        GLState::BindTextureUnit(0, depth_texture);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DEPTH_PYRAMID_SSBO_BINDING_INDEX, m_buffer_name);
+
+        /* The units past the levels count are left as they are, the shader doesn't touch them. */
+        for (uint32_t level = 0; level < m_levels_count; ++level)
+        {
+            glBindImageTexture(level, m_texture_name, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+        }
+
+        glDispatchCompute((m_depth_width  + DEPTH_PYRAMID_TILE_SIZE - 1) / DEPTH_PYRAMID_TILE_SIZE,
+                          (m_depth_height + DEPTH_PYRAMID_TILE_SIZE - 1) / DEPTH_PYRAMID_TILE_SIZE, 1);
+
+        return true;
+    }
+
+    DepthPyramid::GraphResources DepthPyramid::AddPass(RenderGraph& graph, RenderGraph::Resource depth, GLuint depth_texture)
+    {
+        /* Before the import, the pyramid's name changes with the size. */
+        UpdateTexture(depth_texture);
+
+        GraphResources resources = { graph.ImportTexture(m_texture_name), graph.ImportBuffer(m_buffer_name) };
+
+        graph.AddPass("Depth pyramid", [this, depth_texture](RenderGraph&)
+        {
+            Build(depth_texture);
+        })
+        .Read (depth,               RenderGraph::Access::TEXTURE)
+        .Read (resources.m_bounds,  RenderGraph::Access::STORAGE)
+        .Write(resources.m_pyramid, RenderGraph::Access::IMAGE)
+        .Write(resources.m_bounds,  RenderGraph::Access::STORAGE);
+
+        return resources;
+    }
+
+    void DepthPyramid::Bind(GLuint unit) const
+    {
+        GLState::BindTextureUnit(unit, m_texture_name);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DEPTH_PYRAMID_SSBO_BINDING_INDEX, m_buffer_name);
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <glad/glad.h>
+
+#include "render_graph.h"
+
+namespace RGL
+{
+    class Shader;
+
+    /*
+     * The min and max hierarchical-Z pyramid of a depth texture (RG32F, x - the nearest, y - the farthest depth), for
+     * the occlusion culling, the shadow cascade fitting, the blocker search early-outs and the screen space tracing.
+     * The level 0 is half the depth's size, its texel t covers the depth texels 2t and 2t + 1, and every next level
+     * halves the previous one. The levels are the GL mip levels - at the odd sizes the last texel of a level also
+     * covers the extra row or column, so a depth texel p is in the level's texel min(p >> (level + 1), size - 1).
+     * shaders/depth_pyramid.glh has the lookups.
+     *
+     * Build() is a single dispatch (shaders/depth_pyramid.comp): every group reduces a 64x64 tile of the depth to the
+     * levels 0..5 in the shared memory, the last group to finish reduces the tiles' results to the remaining
+     * levels and to the whole depth's bounds, which go to a buffer for the passes that need just them.
+     * The pyramid has DEPTH_PYRAMID_MAX_LEVELS levels at most, of a depth of up to 4096x4096. Render thread only.
+     *
+     *     auto pyramid = depth_pyramid.AddPass(graph, depth, depth_texture_name);
+     *     graph.AddPass("Cull", [&](RenderGraph&) { depth_pyramid.Bind(1); ... })
+     *          .Read(pyramid.m_pyramid, RenderGraph::Access::TEXTURE);
+     */
+    class DepthPyramid final
+    {
+    public:
+        /* The pyramid and its bounds buffer in the graph, the passes that use them declare reading them. */
+        struct GraphResources
+        {
+            RenderGraph::Resource m_pyramid;
+            RenderGraph::Resource m_bounds;
+        };
+
+        DepthPyramid() = default;
+        ~DepthPyramid();
+
+        DepthPyramid           (const DepthPyramid&) = delete;
+        DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+        bool Create();
+
+        /*
+         * Rebuilds the pyramid from the depth texture, (re)creates it when the depth's size has changed. The readers
+         * issue their glMemoryBarrier() - the texture fetch or the storage bit - the graph's passes get it from AddPass().
+         */
+        bool Build(GLuint depth_texture);
+
+        /* Adds the "Depth pyramid" pass, which reads the depth and calls Build(), once for every pass that uses it. */
+        GraphResources AddPass(RenderGraph& graph, RenderGraph::Resource depth, GLuint depth_texture);
+
+        /* The pyramid to the texture unit, the bounds to DEPTH_PYRAMID_SSBO_BINDING_INDEX. */
+        void Bind(GLuint unit) const;
+
+        GLuint   GetTexture()      const { return m_texture_name; }
+        GLuint   GetBoundsBuffer() const { return m_buffer_name; }
+        uint32_t GetWidth()        const { return m_width; }
+        uint32_t GetHeight()       const { return m_height; }
+        uint32_t GetLevelsCount()  const { return m_levels_count; }
+
+    private:
+        /* Matches the pyramid's size to the depth's, false if the depth is not usable. */
+        bool UpdateTexture(GLuint depth_texture);
+        void Release();
+
+        std::shared_ptr<Shader> m_shader;
+
+        /* The counter of the finished groups, the depth bounds and the tiles' results, see the shader. */
+        GLuint   m_buffer_name  = 0;
+        GLuint   m_texture_name = 0;
+        uint32_t m_depth_width  = 0;
+        uint32_t m_depth_height = 0;
+        uint32_t m_width        = 0;
+        uint32_t m_height       = 0;
+        uint32_t m_levels_count = 0;
+    };
+}
@@ -0,0 +1,128 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include <glm/glm.hpp>
+
+#include "core_shared.h"
+#include "gl_state.h"
+#include "profiler.h"
+#include "render_target_pool.h"
+#include "shader.h"
+
+#include "gui/gui.h"
+
+namespace RGL
+{
+    bool DynamicResolution::Create()
+    {
+        m_easu_shader = std::make_shared<Shader>("src/core/shaders/upscale_easu.comp");
+        m_rcas_shader = std::make_shared<Shader>("src/core/shaders/upscale_rcas.comp");
+
+        m_easu_shader->linkAsync();
+        m_rcas_shader->linkAsync();
+
+        if (!m_easu_shader->link() || !m_rcas_shader->link())
+        {
+            fprintf(stderr, "DynamicResolution: the upscaling shaders failed to link.\n");
+            return false;
+        }
+
+        return true;
+    }
+
+    void DynamicResolution::Update(uint32_t output_width, uint32_t output_height)
+    {
+        m_output_width  = output_width;
+        m_output_height = output_height;
+
+        if (!m_is_enabled)
+        {
+            m_scale = 1.0f;
+        }
+        else if (Profiler::IsEnabled() && Profiler::GetResolvedFrame() != m_resolved_frame && !Profiler::GetResolvedScopes().empty())
+        {
+            m_resolved_frame = Profiler::GetResolvedFrame();
+            m_gpu_ms         = Profiler::GetScope(Profiler::GetResolvedScopes()[0]).m_gpu_ms;
+
+            if (m_gpu_ms > 0.0f)
+            {
+                /* The GPU time is about proportional to the pixels, the scale to their square root. */
+                const float desired_scale = m_scale * std::sqrt(m_settings.m_target_ms / m_gpu_ms);
+
+                /*
+                 * A step per measurement - the measured frame is two frames old, larger jumps would overshoot.
+                 * Going up needs a whole step of headroom, so the scale doesn't flip between two steps at the target.
+                 */
+                if (desired_scale < m_scale - SCALE_STEP * 0.5f)
+                {
+                    m_scale -= SCALE_STEP;
+                }
+                else if (desired_scale > m_scale + SCALE_STEP)
+                {
+                    m_scale += SCALE_STEP;
+                }
+            }
+        }
+
+        m_scale = std::clamp(m_scale, m_settings.m_min_scale, m_is_enabled ? m_settings.m_max_scale : 1.0f);
+
+        m_render_width  = std::max(uint32_t(float(output_width)  * m_scale + 0.5f), 1u);
+        m_render_height = std::max(uint32_t(float(output_height) * m_scale + 0.5f), 1u);
+    }
+
+    void DynamicResolution::Upscale(const RenderTarget& source)
+    {
+        ProfilerScope scope("Upscale");
+
+        auto easu_rt = RenderTargetPool::Acquire({ m_output_width, m_output_height, GL_RGBA8, 0 });
+        auto rcas_rt = RenderTargetPool::Acquire({ m_output_width, m_output_height, GL_RGBA8, 0 });
+
+        const GLuint groups_x = (m_output_width  + UPSCALE_GROUP_SIZE - 1) / UPSCALE_GROUP_SIZE;
+        const GLuint groups_y = (m_output_height + UPSCALE_GROUP_SIZE - 1) / UPSCALE_GROUP_SIZE;
+
+        m_easu_shader->bind();
+        m_easu_shader->setUniform("u_input_size",  glm::uvec2(source.GetWidth(), source.GetHeight()));
+        m_easu_shader->setUniform("u_output_size", glm::uvec2(m_output_width, m_output_height));
+
+        source.BindColor(0);
+        easu_rt->BindColorImage(0, 0, GL_WRITE_ONLY);
+
+        glDispatchCompute(groups_x, groups_y, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        m_rcas_shader->bind();
+        m_rcas_shader->setUniform("u_output_size", glm::uvec2(m_output_width, m_output_height));
+        m_rcas_shader->setUniform("u_sharpness",   std::exp2(-m_settings.m_sharpness));
+
+        easu_rt->BindColor(0);
+        rcas_rt->BindColorImage(0, 0, GL_WRITE_ONLY);
+
+        glDispatchCompute(groups_x, groups_y, 1);
+        glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+
+        glBlitNamedFramebuffer(rcas_rt->GetFramebuffer(), 0,
+                               0, 0, m_output_width, m_output_height,
+                               0, 0, m_output_width, m_output_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+        GLState::Viewport       (0, 0, m_output_width, m_output_height);
+    }
+
+    void DynamicResolution::RenderGui()
+    {
+        ImGui::Checkbox("Dynamic resolution", &m_is_enabled);
+
+        if (m_is_enabled)
+        {
+            ImGui::SliderFloat("Target GPU time", &m_settings.m_target_ms, 4.0f, 50.0f, "%.1f ms");
+            ImGui::SliderFloat("Min scale",       &m_settings.m_min_scale, 0.25f, 1.0f, "%.2f");
+            ImGui::SliderFloat("Max scale",       &m_settings.m_max_scale, m_settings.m_min_scale, 1.0f, "%.2f");
+            ImGui::SliderFloat("Sharpness stops", &m_settings.m_sharpness, 0.0f, 2.0f, "%.2f");
+        }
+
+        ImGui::Text("Render scale: %.2f (%u x %u), GPU %.2f ms", m_scale, m_render_width, m_render_height, m_gpu_ms);
+    }
+}
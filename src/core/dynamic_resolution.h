@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <glad/glad.h>
+
+namespace RGL
+{
+    class RenderTarget;
+    class Shader;
+
+    /*
+     * Keeps a GPU frame time instead of a fixed resolution. Update() picks the render scale from the GPU time of the profiler's
+     * "Frame" scope - the time of the frame before last, the profiler doesn't stall for the queries - so the pixel
+     * count follows the ratio of the target and the measured time. The scale moves in SCALE_STEP steps, a steady
+     * frame time keeps the pool's render targets of the same size.
+     *
+     * The scene is rendered at GetRenderWidth() x GetRenderHeight() and tone mapped to an LDR target of that size,
+     * then Upscale() reconstructs the output with the edge adaptive Lanczos of FSR1 EASU (shaders/upscale_easu.comp),
+     * sharpens it with RCAS (shaders/upscale_rcas.comp) and blits it to the default framebuffer, before GUI::render().
+     * TemporalAA's resolve can take Upscale()'s place, it reconstructs the output size from the jittered frames.
+     *
+     *     dynamic_resolution.Update(Window::getWidth(), Window::getHeight());
+     *     auto hdr = RenderTargetPool::Acquire({ dynamic_resolution.GetRenderWidth(), dynamic_resolution.GetRenderHeight(), ... });
+     *     ... the scene, tone mapping to ldr ...
+     *     dynamic_resolution.Upscale(*ldr);
+     */
+    class DynamicResolution final
+    {
+    public:
+        static constexpr float SCALE_STEP = 0.05f;
+
+        struct Settings
+        {
+            float m_target_ms = 16.6f;
+            float m_min_scale = 0.5f;
+            float m_max_scale = 1.0f;
+            float m_sharpness = 0.2f;  /* RCAS stops, 0 - the sharpest. */
+        };
+
+        DynamicResolution() = default;
+
+        DynamicResolution           (const DynamicResolution&) = delete;
+        DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+        bool Create();
+
+        /* Once per frame, before the scene is rendered. Disabled or without the profiler the scale stays as it is. */
+        void Update(uint32_t output_width, uint32_t output_height);
+
+        /* Reads the source's color texture, which has to be tone mapped (EASU expects perceptual values). */
+        void Upscale(const RenderTarget& source);
+
+        /* Sliders of the settings and the current scale. */
+        void RenderGui();
+
+        void SetEnabled(bool enable) { m_is_enabled = enable; }
+        bool IsEnabled() const       { return m_is_enabled; }
+
+        /* The output is rendered directly when the scale is 1. */
+        bool IsScaled() const { return m_render_width != m_output_width || m_render_height != m_output_height; }
+
+        float    GetScale()        const { return m_scale; }
+        uint32_t GetRenderWidth()  const { return m_render_width; }
+        uint32_t GetRenderHeight() const { return m_render_height; }
+
+        Settings m_settings;
+
+    private:
+        std::shared_ptr<Shader> m_easu_shader;
+        std::shared_ptr<Shader> m_rcas_shader;
+
+        bool     m_is_enabled     = true;
+        float    m_scale          = 1.0f;
+        float    m_gpu_ms         = 0.0f;
+        uint64_t m_resolved_frame = 0;
+        uint32_t m_output_width   = 0;
+        uint32_t m_output_height  = 0;
+        uint32_t m_render_width   = 0;
+        uint32_t m_render_height  = 0;
+    };
+}
@@ -1,8 +1,33 @@
 #include "filesystem.h"
+#include "pak_file.h"
 #include "root_directory.h"
 
+#include <cstdio>
+#include <memory>
+#include <vector>
+
 namespace RGL
 {
+    namespace
+    {
+        std::vector<std::unique_ptr<PakFile>> s_paks;
+
+        /* "resources/models/fox.glb" - the name of the file in the paks, empty if it's outside the root directory. */
+        std::string getPakName(const fs::path& filepath)
+        {
+            static const fs::path root_path = fs::path(RAPIDGL_ROOT).lexically_normal();
+
+            const fs::path relative_path = filepath.is_absolute() ? filepath.lexically_normal().lexically_relative(root_path) : filepath.lexically_normal();
+
+            if (relative_path.empty() || *relative_path.begin() == "..")
+            {
+                return {};
+            }
+
+            return relative_path.generic_string();
+        }
+    }
+
     fs::path FileSystem::getRootPath()
     {
         return fs::path(RAPIDGL_ROOT);
@@ -27,4 +52,83 @@ namespace RGL
     {
         fs::create_directories(directory_name);
     }
-}
\ No newline at end of file
+
+    bool FileSystem::mountPak(const fs::path& filepath)
+    {
+        auto pak = std::make_unique<PakFile>();
+
+        if (!pak->Open(filepath))
+        {
+            return false;
+        }
+
+        fprintf(stderr, "Mounted %s, %zu files.\n", filepath.string().c_str(), pak->GetEntries().size());
+        s_paks.push_back(std::move(pak));
+
+        return true;
+    }
+
+    void FileSystem::unmountPaks()
+    {
+        s_paks.clear();
+    }
+
+    bool FileSystem::exists(const fs::path& filepath)
+    {
+        const PakFile*  pak;
+        const PakEntry* entry;
+
+        std::error_code ec;
+        return findInPaks(filepath, pak, entry) || fs::exists(filepath, ec);
+    }
+
+    bool FileSystem::getFileInfo(const fs::path& filepath, uintmax_t& size, fs::file_time_type& write_time)
+    {
+        const PakFile*  pak;
+        const PakEntry* entry;
+
+        if (findInPaks(filepath, pak, entry))
+        {
+            size       = entry->m_size;
+            write_time = fs::file_time_type(fs::file_time_type::duration(entry->m_write_time));
+
+            return true;
+        }
+
+        std::error_code size_ec, time_ec;
+
+        size       = fs::file_size      (filepath, size_ec);
+        write_time = fs::last_write_time(filepath, time_ec);
+
+        return !size_ec && !time_ec;
+    }
+
+    bool FileSystem::findInPaks(const fs::path& filepath, const PakFile*& pak, const PakEntry*& entry)
+    {
+        /* No cost for the loose files. */
+        if (s_paks.empty())
+        {
+            return false;
+        }
+
+        const std::string name = getPakName(filepath);
+
+        if (name.empty())
+        {
+            return false;
+        }
+
+        for (const auto& mounted_pak : s_paks)
+        {
+            if (auto found_entry = mounted_pak->Find(name))
+            {
+                pak   = mounted_pak.get();
+                entry = found_entry;
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
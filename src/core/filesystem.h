@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
 #include <string>
 
@@ -7,6 +8,9 @@ namespace RGL
 {
     namespace fs = std::filesystem;
 
+    class PakFile;
+    struct PakEntry;
+
     class FileSystem
     {
     public:
@@ -14,5 +18,23 @@ namespace RGL
         static fs::path getResourcesPath();
         static bool directoryExists(const fs::path & path, fs::file_status status = fs::file_status{});
         static void createDirectory(const fs::path & directory_name);
+
+        /*
+         * Mounts the pak file (see the pak_builder tool), its files are read from it instead of the disk - by MappedFile,
+         * so by Util::LoadFile(), the textures and the models (see AssetIOSystem) too. The files are looked up by their
+         * paths relative to the root directory, the paks mounted first take precedence. Not thread safe, the paks are
+         * mounted before anything is loaded and stay mounted until unmountPaks().
+         */
+        static bool mountPak(const fs::path & filepath);
+        static void unmountPaks();
+
+        /* Whether the file is in a mounted pak, or on the disk. */
+        static bool exists(const fs::path & filepath);
+
+        /* The size and the last write time of the file, from the mounted paks or the disk. */
+        static bool getFileInfo(const fs::path & filepath, uintmax_t & size, fs::file_time_type & write_time);
+
+        /* The file's entry in the mounted paks. */
+        static bool findInPaks(const fs::path & filepath, const PakFile *& pak, const PakEntry *& entry);
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,160 @@
+#include "frame_allocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace RGL
+{
+    LinearArena::LinearArena(size_t block_size)
+        : m_block_size(block_size)
+    {
+    }
+
+    LinearArena::~LinearArena()
+    {
+        FreeBlocks();
+    }
+
+    void LinearArena::Reset()
+    {
+        /* The frame overflowed, the next one gets a single block big enough for it. */
+        if (m_blocks.size() > 1)
+        {
+            FreeBlocks();
+            m_block_size = std::max(m_block_size, m_peak_size);
+        }
+
+        m_offset    = 0;
+        m_used_size = 0;
+    }
+
+    void* LinearArena::do_allocate(size_t bytes, size_t alignment)
+    {
+        if (m_blocks.empty())
+        {
+            AddBlock(std::max(m_block_size, bytes + alignment));
+        }
+
+        Block& block   = m_blocks.back();
+        size_t aligned = (size_t(block.m_data) + m_offset + alignment - 1) / alignment * alignment - size_t(block.m_data);
+
+        if (aligned + bytes > block.m_size)
+        {
+            AddBlock(std::max(m_block_size, bytes + alignment));
+            return do_allocate(bytes, alignment);
+        }
+
+        m_used_size += aligned - m_offset + bytes;
+        m_peak_size  = std::max(m_peak_size, m_used_size);
+        m_offset     = aligned + bytes;
+
+        return m_blocks.back().m_data + aligned;
+    }
+
+    void LinearArena::AddBlock(size_t size)
+    {
+        m_blocks.push_back({ static_cast<std::byte*>(::operator new(size)), size });
+        m_offset = 0;
+    }
+
+    void LinearArena::FreeBlocks()
+    {
+        for (auto& block : m_blocks)
+        {
+            ::operator delete(block.m_data);
+        }
+
+        m_blocks.clear();
+    }
+
+    std::atomic<uint64_t> FrameAllocator::s_heap_allocations       = 0;
+    uint64_t              FrameAllocator::s_last_heap_allocations  = 0;
+    uint64_t              FrameAllocator::s_frame_heap_allocations = 0;
+
+    LinearArena& FrameAllocator::GetArena()
+    {
+        thread_local LinearArena arena(ARENA_BLOCK_SIZE);
+        return arena;
+    }
+
+    void FrameAllocator::ResetArena()
+    {
+        GetArena().Reset();
+    }
+
+    void FrameAllocator::EndFrame()
+    {
+        ResetArena();
+
+        const uint64_t heap_allocations = GetHeapAllocations();
+
+        s_frame_heap_allocations = heap_allocations - s_last_heap_allocations;
+        s_last_heap_allocations  = heap_allocations;
+    }
+}
+
+#ifdef RGL_COUNT_HEAP_ALLOCATIONS
+/*
+ * The replaced global allocation functions, the nothrow ones and the sized deletes forward to these by default.
+ * The aligned ones use the platform's aligned allocation, their deletes have to match it.
+ */
+void* operator new(size_t size)
+{
+    RGL::FrameAllocator::OnHeapAllocation();
+
+    if (void* ptr = std::malloc(size == 0 ? 1 : size))
+    {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    RGL::FrameAllocator::OnHeapAllocation();
+
+    /* aligned_alloc() wants a multiple of the alignment. */
+    const size_t align   = std::max(size_t(alignment), sizeof(void*));
+    const size_t rounded = (std::max(size, size_t(1)) + align - 1) / align * align;
+
+#ifdef _MSC_VER
+    if (void* ptr = _aligned_malloc(rounded, align))
+#else
+    if (void* ptr = std::aligned_alloc(align, rounded))
+#endif
+    {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void operator delete  (void* ptr) noexcept         { std::free(ptr); }
+void operator delete[](void* ptr) noexcept         { std::free(ptr); }
+void operator delete  (void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+
+#ifdef _MSC_VER
+void operator delete  (void* ptr, std::align_val_t) noexcept         { _aligned_free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept         { _aligned_free(ptr); }
+void operator delete  (void* ptr, size_t, std::align_val_t) noexcept { _aligned_free(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { _aligned_free(ptr); }
+#else
+void operator delete  (void* ptr, std::align_val_t) noexcept         { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept         { std::free(ptr); }
+void operator delete  (void* ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+#endif
+#endif
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace RGL
+{
+    /*
+     * Bump allocator for the scratch memory of a frame, deallocate() is a no-op - Reset() frees everything at once.
+     * An allocation that doesn't fit the block takes an overflow block from the heap, Reset() then replaces
+     * the blocks with one as big as the frame needed, so the steady state frames take nothing from the heap.
+     * Not thread safe.
+     */
+    class LinearArena final : public std::pmr::memory_resource
+    {
+    public:
+        explicit LinearArena(size_t block_size);
+        ~LinearArena() override;
+
+        LinearArena           (const LinearArena&) = delete;
+        LinearArena& operator=(const LinearArena&) = delete;
+
+        void Reset();
+
+        /* Bytes handed out since the last Reset(), the alignment padding included. */
+        size_t GetUsedSize()  const { return m_used_size; }
+        size_t GetPeakSize()  const { return m_peak_size; }
+        size_t GetBlockSize() const { return m_block_size; }
+
+    private:
+        struct Block
+        {
+            std::byte* m_data;
+            size_t     m_size;
+        };
+
+        void* do_allocate  (size_t bytes, size_t alignment) override;
+        void  do_deallocate(void*, size_t, size_t) override {}
+        bool  do_is_equal  (const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+        void AddBlock(size_t size);
+        void FreeBlocks();
+
+        std::vector<Block> m_blocks;
+        size_t             m_block_size;
+        size_t             m_offset    = 0;
+        size_t             m_used_size = 0;
+        size_t             m_peak_size = 0;
+    };
+
+    /*
+     * The per frame scratch of the core's hot paths - the std::pmr containers of a frame take GetResource(), as
+     * std::pmr::vector<GLint> counts(count, FrameAllocator::GetResource()). Every thread has its own arena: the render
+     * thread's is reset by EndFrame(), the main thread's by ResetArena() once it hands the frame over. Nothing allocated
+     * from it may outlive the frame. The job workers keep their own scratch, their arenas would never be reset.
+     *
+     * The builds with RGL_COUNT_HEAP_ALLOCATIONS (the Debug ones) count the global operator new calls of all threads,
+     * GetFrameHeapAllocations() are the last frame's - 0 in the steady state is the goal, the Perf info overlay shows it.
+     */
+    class FrameAllocator
+    {
+    public:
+        static constexpr size_t ARENA_BLOCK_SIZE = 1 << 20;
+
+        static LinearArena&                GetArena();
+        static std::pmr::memory_resource*  GetResource() { return &GetArena(); }
+
+        /* Resets the calling thread's arena. */
+        static void ResetArena();
+
+        /* The render thread's ResetArena() and the heap allocations count of the frame. */
+        static void EndFrame();
+
+        static constexpr bool IsHeapCountingEnabled()
+        {
+#ifdef RGL_COUNT_HEAP_ALLOCATIONS
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        static uint64_t GetHeapAllocations()      { return s_heap_allocations.load(std::memory_order_relaxed); }
+        static uint64_t GetFrameHeapAllocations() { return s_frame_heap_allocations; }
+
+        /* Called by the replaced global operator new. */
+        static void OnHeapAllocation() { s_heap_allocations.fetch_add(1, std::memory_order_relaxed); }
+
+    private:
+        static std::atomic<uint64_t> s_heap_allocations;
+        static uint64_t              s_last_heap_allocations;
+        static uint64_t              s_frame_heap_allocations;
+    };
+}
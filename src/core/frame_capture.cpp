@@ -0,0 +1,281 @@
+#include "frame_capture.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "stb_image_write.h"
+#include "stb_image_resize.h"
+
+#include "filesystem.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+#include "window.h"
+
+namespace RGL
+{
+    namespace
+    {
+        constexpr uint32_t CHANNELS_COUNT = 3;
+    }
+
+    FrameCapture::FrameCapture()
+        : m_pack_buffers              {},
+          m_next_pack_buffer          (0),
+          m_continuous_every_nth_frame(0),
+          m_continuous_dst_width      (0),
+          m_continuous_dst_height     (0),
+          m_continuous_frame          (0),
+          m_dropped_frames_count      (0),
+          m_is_worker_busy            (false),
+          m_is_stopping               (false)
+    {
+        m_worker = std::thread(&FrameCapture::WorkerLoop, this);
+    }
+
+    FrameCapture::~FrameCapture()
+    {
+        Flush();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_is_stopping = true;
+        }
+        m_jobs_condition.notify_one();
+        m_worker.join();
+
+        for (auto& pack_buffer : m_pack_buffers)
+        {
+            if (pack_buffer.m_buffer_name != 0)
+            {
+                GpuMemory::UntrackBuffer(pack_buffer.m_buffer_name);
+                glDeleteBuffers(1, &pack_buffer.m_buffer_name);
+            }
+        }
+    }
+
+    void FrameCapture::RequestScreenshot(const std::filesystem::path& filepath, uint32_t dst_width, uint32_t dst_height)
+    {
+        m_requests.push_back({ filepath, dst_width, dst_height });
+    }
+
+    void FrameCapture::StartContinuous(const std::filesystem::path& directory, const std::string& prefix, uint32_t every_nth_frame, uint32_t dst_width, uint32_t dst_height)
+    {
+        if (!FileSystem::directoryExists(directory))
+        {
+            FileSystem::createDirectory(directory);
+        }
+
+        m_continuous_directory       = directory;
+        m_continuous_prefix          = prefix;
+        m_continuous_every_nth_frame = std::max(every_nth_frame, 1u);
+        m_continuous_dst_width       = dst_width;
+        m_continuous_dst_height      = dst_height;
+        m_continuous_frame           = 0;
+        m_dropped_frames_count       = 0;
+    }
+
+    void FrameCapture::StopContinuous()
+    {
+        m_continuous_every_nth_frame = 0;
+    }
+
+    void FrameCapture::Update()
+    {
+        ResolveReads(false);
+
+        for (const auto& request : m_requests)
+        {
+            IssueRead(request.m_filepath, request.m_dst_width, request.m_dst_height, false);
+        }
+        m_requests.clear();
+
+        if (IsContinuous())
+        {
+            if (m_continuous_frame % m_continuous_every_nth_frame == 0)
+            {
+                char filename[64];
+                snprintf(filename, sizeof(filename), "_%06llu.png", (unsigned long long)(m_continuous_frame / m_continuous_every_nth_frame));
+
+                if (!IssueRead(m_continuous_directory / (m_continuous_prefix + filename), m_continuous_dst_width, m_continuous_dst_height, true))
+                {
+                    m_dropped_frames_count++;
+                }
+            }
+
+            m_continuous_frame++;
+        }
+    }
+
+    bool FrameCapture::IssueRead(const std::filesystem::path& filepath, uint32_t dst_width, uint32_t dst_height, bool can_drop)
+    {
+        PackBuffer& pack_buffer = m_pack_buffers[m_next_pack_buffer];
+
+        /* The ring is full - a continuous capture skips the frame, a screenshot waits for the oldest read. */
+        if (pack_buffer.m_fence)
+        {
+            if (can_drop)
+            {
+                return false;
+            }
+
+            ResolveRead(pack_buffer, true);
+        }
+
+        const uint32_t   width  = Window::getWidth();
+        const uint32_t   height = Window::getHeight();
+        const GLsizeiptr size   = GLsizeiptr(width) * height * CHANNELS_COUNT;
+
+        if (pack_buffer.m_capacity < size)
+        {
+            if (pack_buffer.m_buffer_name != 0)
+            {
+                GpuMemory::UntrackBuffer(pack_buffer.m_buffer_name);
+                glDeleteBuffers(1, &pack_buffer.m_buffer_name);
+            }
+
+            glCreateBuffers     (1, &pack_buffer.m_buffer_name);
+            glNamedBufferStorage(pack_buffer.m_buffer_name, size, nullptr, GL_MAP_READ_BIT);
+            GpuMemory::TrackBuffer(pack_buffer.m_buffer_name, "FrameCapture");
+
+            pack_buffer.m_capacity = size;
+        }
+
+        GLState::BindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+        glBindBuffer (GL_PIXEL_PACK_BUFFER, pack_buffer.m_buffer_name);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels (0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glBindBuffer (GL_PIXEL_PACK_BUFFER, 0);
+
+        pack_buffer.m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        pack_buffer.m_job   = { filepath, width, height, dst_width, dst_height, can_drop, {} };
+
+        m_next_pack_buffer = (m_next_pack_buffer + 1) % PACK_BUFFERS_COUNT;
+
+        return true;
+    }
+
+    void FrameCapture::ResolveRead(PackBuffer& pack_buffer, bool wait)
+    {
+        if (!pack_buffer.m_fence)
+        {
+            return;
+        }
+
+        GLenum status = glClientWaitSync(pack_buffer.m_fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GL_TIMEOUT_IGNORED : 0);
+
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+            return;
+        }
+
+        glDeleteSync(pack_buffer.m_fence);
+        pack_buffer.m_fence = nullptr;
+
+        Job& job = pack_buffer.m_job;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (job.m_can_drop && m_jobs.size() >= MAX_QUEUED_JOBS)
+            {
+                m_dropped_frames_count++;
+                return;
+            }
+        }
+
+        const GLsizeiptr size = GLsizeiptr(job.m_width) * job.m_height * CHANNELS_COUNT;
+
+        job.m_pixels.resize(size);
+
+        if (void* data = glMapNamedBufferRange(pack_buffer.m_buffer_name, 0, size, GL_MAP_READ_BIT))
+        {
+            std::memcpy(job.m_pixels.data(), data, size);
+            glUnmapNamedBuffer(pack_buffer.m_buffer_name);
+        }
+        else
+        {
+            fprintf(stderr, "Frame capture: could not map the pack buffer for %s\n", job.m_filepath.string().c_str());
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.push_back(std::move(job));
+        }
+        m_jobs_condition.notify_one();
+    }
+
+    void FrameCapture::ResolveReads(bool wait)
+    {
+        /* Oldest first, the reads complete in order. */
+        for (uint32_t i = 0; i < PACK_BUFFERS_COUNT; ++i)
+        {
+            ResolveRead(m_pack_buffers[(m_next_pack_buffer + i) % PACK_BUFFERS_COUNT], wait);
+        }
+    }
+
+    void FrameCapture::Flush()
+    {
+        for (const auto& request : m_requests)
+        {
+            IssueRead(request.m_filepath, request.m_dst_width, request.m_dst_height, false);
+        }
+        m_requests.clear();
+
+        ResolveReads(true);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle_condition.wait(lock, [this] { return m_jobs.empty() && !m_is_worker_busy; });
+    }
+
+    void FrameCapture::WorkerLoop()
+    {
+        while (true)
+        {
+            Job job;
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                m_is_worker_busy = false;
+                m_idle_condition.notify_all();
+
+                m_jobs_condition.wait(lock, [this] { return !m_jobs.empty() || m_is_stopping; });
+
+                if (m_jobs.empty())
+                {
+                    return;
+                }
+
+                job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+
+                m_is_worker_busy = true;
+            }
+
+            uint32_t width  = job.m_width;
+            uint32_t height = job.m_height;
+
+            if (job.m_dst_width > 0 && job.m_dst_height > 0 && (job.m_dst_width != width || job.m_dst_height != height))
+            {
+                std::vector<uint8_t> resized_pixels(size_t(job.m_dst_width) * job.m_dst_height * CHANNELS_COUNT);
+                stbir_resize_uint8(job.m_pixels.data(), width, height, 0, resized_pixels.data(), job.m_dst_width, job.m_dst_height, 0, CHANNELS_COUNT);
+
+                width        = job.m_dst_width;
+                height       = job.m_dst_height;
+                job.m_pixels = std::move(resized_pixels);
+            }
+
+            /* Only the worker writes the images, so the global flip flag is safe to use. */
+            stbi_flip_vertically_on_write(true);
+
+            if (!stbi_write_png(job.m_filepath.string().c_str(), width, height, CHANNELS_COUNT, job.m_pixels.data(), 0))
+            {
+                fprintf(stderr, "Frame capture: could not write %s\n", job.m_filepath.string().c_str());
+            }
+        }
+    }
+}
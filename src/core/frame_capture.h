@@ -0,0 +1,105 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+
+namespace RGL
+{
+    /*
+     * Asynchronous capture of the default framebuffer. glReadPixels writes into a ring of pixel pack buffers,
+     * the buffers are mapped a frame or two later behind a fence, and the resize and the PNG encoding is done
+     * on a worker thread - a capture costs the main thread only a memcpy of the pixels.
+     *
+     * Screenshots are never dropped. The continuous mode (every Nth frame, e.g. for video capture) drops a frame
+     * instead of stalling when all the pack buffers are still in flight or the worker falls behind.
+     */
+    class FrameCapture final
+    {
+    public:
+        static constexpr uint32_t PACK_BUFFERS_COUNT = 3;
+        static constexpr uint32_t MAX_QUEUED_JOBS    = 8;
+
+        FrameCapture();
+        ~FrameCapture();
+
+        FrameCapture           (const FrameCapture&) = delete;
+        FrameCapture& operator=(const FrameCapture&) = delete;
+
+        /* The size of 0 keeps the framebuffer size. The file is written a few frames later. */
+        void RequestScreenshot(const std::filesystem::path& filepath, uint32_t dst_width = 0, uint32_t dst_height = 0);
+
+        /* Writes <directory>/<prefix>_<frame number>.png every Nth frame. */
+        void StartContinuous(const std::filesystem::path& directory, const std::string& prefix, uint32_t every_nth_frame, uint32_t dst_width = 0, uint32_t dst_height = 0);
+        void StopContinuous();
+        bool IsContinuous() const { return m_continuous_every_nth_frame > 0; }
+
+        /* Has to be called once per frame, after the frame is rendered to the default framebuffer and before the swap. */
+        void Update();
+
+        /* Waits until all the captures are written. */
+        void Flush();
+
+        uint32_t GetDroppedFramesCount() const { return m_dropped_frames_count; }
+
+    private:
+        struct Job
+        {
+            std::filesystem::path m_filepath;
+            uint32_t              m_width;
+            uint32_t              m_height;
+            uint32_t              m_dst_width;
+            uint32_t              m_dst_height;
+            bool                  m_can_drop;
+            std::vector<uint8_t>  m_pixels;
+        };
+
+        struct Request
+        {
+            std::filesystem::path m_filepath;
+            uint32_t              m_dst_width;
+            uint32_t              m_dst_height;
+        };
+
+        struct PackBuffer
+        {
+            GLuint     m_buffer_name;
+            GLsizeiptr m_capacity;
+            GLsync     m_fence;     /* nullptr if the buffer is free. */
+            Job        m_job;       /* Everything but the pixels until the read is resolved. */
+        };
+
+        bool IssueRead   (const std::filesystem::path& filepath, uint32_t dst_width, uint32_t dst_height, bool can_drop);
+        void ResolveRead (PackBuffer& pack_buffer, bool wait);
+        void ResolveReads(bool wait);
+        void WorkerLoop  ();
+
+        PackBuffer m_pack_buffers[PACK_BUFFERS_COUNT];
+        uint32_t   m_next_pack_buffer;
+
+        std::vector<Request> m_requests;
+
+        std::filesystem::path m_continuous_directory;
+        std::string           m_continuous_prefix;
+        uint32_t              m_continuous_every_nth_frame;
+        uint32_t              m_continuous_dst_width;
+        uint32_t              m_continuous_dst_height;
+        uint64_t              m_continuous_frame;
+        uint32_t              m_dropped_frames_count;
+
+        std::thread             m_worker;
+        std::mutex              m_mutex;
+        std::condition_variable m_jobs_condition;
+        std::condition_variable m_idle_condition;
+        std::deque<Job>         m_jobs;
+        bool                    m_is_worker_busy;
+        bool                    m_is_stopping;
+    };
+}
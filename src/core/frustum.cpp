@@ -0,0 +1,171 @@
+#include "frustum.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_access.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RGL_FRUSTUM_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace RGL
+{
+    void Frustum::Update(const glm::mat4& view_projection)
+    {
+        const glm::vec4 row0 = glm::row(view_projection, 0);
+        const glm::vec4 row1 = glm::row(view_projection, 1);
+        const glm::vec4 row2 = glm::row(view_projection, 2);
+        const glm::vec4 row3 = glm::row(view_projection, 3);
+
+        m_planes[0] = row3 + row0; // left
+        m_planes[1] = row3 - row0; // right
+        m_planes[2] = row3 + row1; // bottom
+        m_planes[3] = row3 - row1; // top
+        m_planes[4] = row3 + row2; // near
+        m_planes[5] = row3 - row2; // far
+
+        for (auto& plane : m_planes)
+        {
+            plane /= glm::length(glm::vec3(plane));
+        }
+    }
+
+    bool Frustum::IsSphereVisible(const glm::vec3& center, float radius) const
+    {
+        for (const auto& plane : m_planes)
+        {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool Frustum::IsAabbVisible(const glm::vec3& min, const glm::vec3& max) const
+    {
+        const glm::vec3 center  = (min + max) * 0.5f;
+        const glm::vec3 extents = (max - min) * 0.5f;
+
+        for (const auto& plane : m_planes)
+        {
+            /* The box's projected radius on the plane normal. */
+            const float radius = glm::dot(glm::abs(glm::vec3(plane)), extents);
+
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    uint32_t Frustum::CullSpheres(const glm::vec4* spheres, uint32_t count, uint32_t* visible_indices) const
+    {
+        uint32_t visible_count = 0;
+        uint32_t i             = 0;
+
+#ifdef RGL_FRUSTUM_SSE
+        /* 4 spheres per iteration, transposed to x, y, z, radius lanes. */
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 x = _mm_loadu_ps(&spheres[i + 0].x);
+            __m128 y = _mm_loadu_ps(&spheres[i + 1].x);
+            __m128 z = _mm_loadu_ps(&spheres[i + 2].x);
+            __m128 r = _mm_loadu_ps(&spheres[i + 3].x);
+            _MM_TRANSPOSE4_PS(x, y, z, r);
+
+            const __m128 negative_radius = _mm_sub_ps(_mm_setzero_ps(), r);
+            int          outside_mask    = 0;
+
+            for (const auto& plane : m_planes)
+            {
+                const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+                                                   _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+
+                outside_mask |= _mm_movemask_ps(_mm_cmplt_ps(distance, negative_radius));
+            }
+
+            for (uint32_t lane = 0; lane < 4; ++lane)
+            {
+                if ((outside_mask & (1 << lane)) == 0)
+                {
+                    visible_indices[visible_count++] = i + lane;
+                }
+            }
+        }
+#endif
+
+        for (; i < count; ++i)
+        {
+            if (IsSphereVisible(glm::vec3(spheres[i]), spheres[i].w))
+            {
+                visible_indices[visible_count++] = i;
+            }
+        }
+
+        return visible_count;
+    }
+
+    uint32_t Frustum::CullAabbs(const glm::vec3* mins, const glm::vec3* maxs, uint32_t count, uint32_t* visible_indices) const
+    {
+        uint32_t visible_count = 0;
+        uint32_t i             = 0;
+
+#ifdef RGL_FRUSTUM_SSE
+        const __m128 half = _mm_set1_ps(0.5f);
+
+        /* 4 boxes per iteration as centers and extents in x, y, z lanes. */
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128 min_x = _mm_setr_ps(mins[i].x, mins[i + 1].x, mins[i + 2].x, mins[i + 3].x);
+            const __m128 min_y = _mm_setr_ps(mins[i].y, mins[i + 1].y, mins[i + 2].y, mins[i + 3].y);
+            const __m128 min_z = _mm_setr_ps(mins[i].z, mins[i + 1].z, mins[i + 2].z, mins[i + 3].z);
+            const __m128 max_x = _mm_setr_ps(maxs[i].x, maxs[i + 1].x, maxs[i + 2].x, maxs[i + 3].x);
+            const __m128 max_y = _mm_setr_ps(maxs[i].y, maxs[i + 1].y, maxs[i + 2].y, maxs[i + 3].y);
+            const __m128 max_z = _mm_setr_ps(maxs[i].z, maxs[i + 1].z, maxs[i + 2].z, maxs[i + 3].z);
+
+            const __m128 center_x  = _mm_mul_ps(_mm_add_ps(min_x, max_x), half);
+            const __m128 center_y  = _mm_mul_ps(_mm_add_ps(min_y, max_y), half);
+            const __m128 center_z  = _mm_mul_ps(_mm_add_ps(min_z, max_z), half);
+            const __m128 extents_x = _mm_mul_ps(_mm_sub_ps(max_x, min_x), half);
+            const __m128 extents_y = _mm_mul_ps(_mm_sub_ps(max_y, min_y), half);
+            const __m128 extents_z = _mm_mul_ps(_mm_sub_ps(max_z, min_z), half);
+
+            int outside_mask = 0;
+
+            for (const auto& plane : m_planes)
+            {
+                const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(center_x, _mm_set1_ps(plane.x)), _mm_mul_ps(center_y, _mm_set1_ps(plane.y))),
+                                                   _mm_add_ps(_mm_mul_ps(center_z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+
+                const __m128 radius   = _mm_add_ps(_mm_add_ps(_mm_mul_ps(extents_x, _mm_set1_ps(glm::abs(plane.x))), _mm_mul_ps(extents_y, _mm_set1_ps(glm::abs(plane.y)))),
+                                                   _mm_mul_ps(extents_z, _mm_set1_ps(glm::abs(plane.z))));
+
+                outside_mask |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+            }
+
+            for (uint32_t lane = 0; lane < 4; ++lane)
+            {
+                if ((outside_mask & (1 << lane)) == 0)
+                {
+                    visible_indices[visible_count++] = i + lane;
+                }
+            }
+        }
+#endif
+
+        for (; i < count; ++i)
+        {
+            if (IsAabbVisible(mins[i], maxs[i]))
+            {
+                visible_indices[visible_count++] = i;
+            }
+        }
+
+        return visible_count;
+    }
+}
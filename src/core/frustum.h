@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+namespace RGL
+{
+    /*
+     * View frustum for the CPU side culling. The planes (xyz - normal, w - distance) are extracted from a view projection
+     * matrix with the Gribb-Hartmann method, normalized and pointing inside, in the order left, right, bottom, top, near, far.
+     * The batch tests process 4 bounding volumes at a time with SSE.
+     */
+    class Frustum
+    {
+    public:
+        Frustum() = default;
+        explicit Frustum(const glm::mat4& view_projection) { Update(view_projection); }
+
+        void Update(const glm::mat4& view_projection);
+
+        bool IsSphereVisible(const glm::vec3& center, float radius)      const;
+        bool IsAabbVisible  (const glm::vec3& min,    const glm::vec3& max) const;
+
+        /*
+         * Batch tests. The spheres are xyz - center, w - radius. The indices of the visible volumes are written
+         * to visible_indices (at least count entries), returns the number of the visible ones.
+         */
+        uint32_t CullSpheres(const glm::vec4* spheres, uint32_t count, uint32_t* visible_indices) const;
+        uint32_t CullAabbs  (const glm::vec3* mins, const glm::vec3* maxs, uint32_t count, uint32_t* visible_indices) const;
+
+        const glm::vec4* GetPlanes() const { return m_planes; }
+
+    private:
+        glm::vec4 m_planes[6] = {};
+    };
+}
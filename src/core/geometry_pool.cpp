@@ -0,0 +1,285 @@
+#include "geometry_pool.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "gpu_memory.h"
+
+namespace RGL
+{
+    OffsetAllocator::OffsetAllocator(uint32_t size)
+    {
+        Reset(size);
+    }
+
+    void OffsetAllocator::Reset(uint32_t size)
+    {
+        m_size      = size;
+        m_free_size = size;
+
+        m_free_blocks.clear();
+
+        if (size > 0)
+        {
+            m_free_blocks.push_back({ 0, size });
+        }
+    }
+
+    uint32_t OffsetAllocator::Allocate(uint32_t size)
+    {
+        if (size == 0)
+        {
+            return INVALID_OFFSET;
+        }
+
+        for (size_t i = 0; i < m_free_blocks.size(); ++i)
+        {
+            Block& block = m_free_blocks[i];
+
+            if (block.m_size >= size)
+            {
+                uint32_t offset = block.m_offset;
+
+                block.m_offset += size;
+                block.m_size   -= size;
+
+                if (block.m_size == 0)
+                {
+                    m_free_blocks.erase(m_free_blocks.begin() + i);
+                }
+
+                m_free_size -= size;
+                return offset;
+            }
+        }
+
+        return INVALID_OFFSET;
+    }
+
+    void OffsetAllocator::Free(uint32_t offset, uint32_t size)
+    {
+        if (size == 0 || offset == INVALID_OFFSET)
+        {
+            return;
+        }
+
+        auto next = std::lower_bound(m_free_blocks.begin(), m_free_blocks.end(), offset, [](const Block& block, uint32_t value) { return block.m_offset < value; });
+        auto it   = m_free_blocks.insert(next, { offset, size });
+
+        m_free_size += size;
+
+        /* Merge with the following block. */
+        if (it + 1 != m_free_blocks.end() && it->m_offset + it->m_size == (it + 1)->m_offset)
+        {
+            it->m_size += (it + 1)->m_size;
+            m_free_blocks.erase(it + 1);
+        }
+
+        /* Merge with the preceding block. */
+        if (it != m_free_blocks.begin() && (it - 1)->m_offset + (it - 1)->m_size == it->m_offset)
+        {
+            (it - 1)->m_size += it->m_size;
+            m_free_blocks.erase(it);
+        }
+    }
+
+    bool OffsetAllocator::IsCompact() const
+    {
+        return m_free_blocks.empty() || (m_free_blocks.size() == 1 && m_free_blocks[0].m_offset + m_free_blocks[0].m_size == m_size);
+    }
+
+    uint32_t OffsetAllocator::GetLargestFreeBlock() const
+    {
+        uint32_t largest = 0;
+
+        for (const auto& block : m_free_blocks)
+        {
+            largest = std::max(largest, block.m_size);
+        }
+
+        return largest;
+    }
+
+    std::unique_ptr<GeometryPool> GeometryPool::s_pools[4];
+    uint32_t                      GeometryPool::s_vertices_capacity = 1 << 20;
+    uint32_t                      GeometryPool::s_indices_capacity  = 1 << 22;
+
+    GeometryPool::GeometryPool(VertexFormat format, bool has_tangents, uint32_t vertices_capacity, uint32_t indices_capacity)
+        : m_vertex_allocator (vertices_capacity),
+          m_index_allocator  (indices_capacity),
+          m_vao_name         (0),
+          m_depth_vao_name   (0),
+          m_vbo_name         (0),
+          m_ibo_name         (0),
+          m_vertex_stride    (StaticModel::GetVertexStride(format, has_tangents)),
+          m_vertices_capacity(vertices_capacity),
+          m_indices_capacity (indices_capacity),
+          m_generation       (0)
+    {
+        CreateBuffers(m_vbo_name, m_ibo_name);
+
+        glCreateVertexArrays     (1, &m_vao_name);
+        glVertexArrayElementBuffer(m_vao_name, m_ibo_name);
+        glVertexArrayVertexBuffer (m_vao_name, 0 /* bindingindex*/, m_vbo_name, 0 /* offset */, m_vertex_stride);
+
+        StaticModel::SetVertexAttribFormats(m_vao_name, format, has_tangents);
+
+        glCreateVertexArrays     (1, &m_depth_vao_name);
+        glVertexArrayElementBuffer(m_depth_vao_name, m_ibo_name);
+        glVertexArrayVertexBuffer (m_depth_vao_name, 0 /* bindingindex*/, m_vbo_name, 0 /* offset */, m_vertex_stride);
+
+        StaticModel::SetDepthAttribFormat(m_depth_vao_name);
+    }
+
+    GeometryPool::~GeometryPool()
+    {
+        glDeleteVertexArrays(1, &m_vao_name);
+        glDeleteVertexArrays(1, &m_depth_vao_name);
+        GpuMemory::UntrackBuffer(m_vbo_name);
+        GpuMemory::UntrackBuffer(m_ibo_name);
+        glDeleteBuffers     (1, &m_vbo_name);
+        glDeleteBuffers     (1, &m_ibo_name);
+    }
+
+    void GeometryPool::SetCapacity(uint32_t vertices_capacity, uint32_t indices_capacity)
+    {
+        s_vertices_capacity = vertices_capacity;
+        s_indices_capacity  = indices_capacity;
+    }
+
+    GeometryPool* GeometryPool::Get(VertexFormat format, bool has_tangents)
+    {
+        if (format == VertexFormat::PLANAR)
+        {
+            return nullptr;
+        }
+
+        auto& pool = s_pools[(uint32_t(format) - 1) * 2 + uint32_t(has_tangents)];
+
+        if (!pool)
+        {
+            pool = std::make_unique<GeometryPool>(format, has_tangents, s_vertices_capacity, s_indices_capacity);
+        }
+
+        return pool.get();
+    }
+
+    void GeometryPool::ReleaseAll()
+    {
+        for (auto& pool : s_pools)
+        {
+            pool.reset();
+        }
+    }
+
+    void GeometryPool::CreateBuffers(GLuint& vbo_name, GLuint& ibo_name) const
+    {
+        glCreateBuffers     (1, &vbo_name);
+        glNamedBufferStorage(vbo_name, GLsizeiptr(m_vertices_capacity) * m_vertex_stride, nullptr, GL_DYNAMIC_STORAGE_BIT);
+        GpuMemory::TrackBuffer(vbo_name, "GeometryPool");
+
+        glCreateBuffers     (1, &ibo_name);
+        glNamedBufferStorage(ibo_name, GLsizeiptr(m_indices_capacity) * sizeof(uint32_t), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        GpuMemory::TrackBuffer(ibo_name, "GeometryPool");
+    }
+
+    GeometryPool::Handle GeometryPool::Allocate(const void* vertices, uint32_t vertices_count, const uint32_t* indices, uint32_t indices_count)
+    {
+        uint32_t vertex_offset = m_vertex_allocator.Allocate(vertices_count);
+        uint32_t index_offset  = m_index_allocator .Allocate(indices_count);
+
+        if (vertex_offset == OffsetAllocator::INVALID_OFFSET || index_offset == OffsetAllocator::INVALID_OFFSET)
+        {
+            m_vertex_allocator.Free(vertex_offset, vertices_count);
+            m_index_allocator .Free(index_offset,  indices_count);
+
+            return INVALID_HANDLE;
+        }
+
+        glNamedBufferSubData(m_vbo_name, GLintptr(vertex_offset) * m_vertex_stride,  GLsizeiptr(vertices_count) * m_vertex_stride,  vertices);
+        glNamedBufferSubData(m_ibo_name, GLintptr(index_offset)  * sizeof(uint32_t), GLsizeiptr(indices_count)  * sizeof(uint32_t), indices);
+
+        Handle handle;
+
+        if (!m_free_handles.empty())
+        {
+            handle = m_free_handles.back();
+            m_free_handles.pop_back();
+        }
+        else
+        {
+            handle = Handle(m_allocations.size());
+            m_allocations.emplace_back();
+        }
+
+        m_allocations[handle] = { vertex_offset, vertices_count, index_offset, indices_count, true };
+
+        return handle;
+    }
+
+    void GeometryPool::Free(Handle handle)
+    {
+        if (handle >= m_allocations.size() || !m_allocations[handle].m_is_used)
+        {
+            return;
+        }
+
+        Allocation& allocation = m_allocations[handle];
+
+        m_vertex_allocator.Free(allocation.m_vertex_offset, allocation.m_vertices_count);
+        m_index_allocator .Free(allocation.m_index_offset,  allocation.m_indices_count);
+
+        allocation.m_is_used = false;
+        m_free_handles.push_back(handle);
+    }
+
+    void GeometryPool::Compact()
+    {
+        if (m_vertex_allocator.IsCompact() && m_index_allocator.IsCompact())
+        {
+            return;
+        }
+
+        /* Copies between overlapping ranges of the same buffer are not allowed, so the data goes to the new buffers. */
+        GLuint vbo_name, ibo_name;
+        CreateBuffers(vbo_name, ibo_name);
+
+        m_vertex_allocator.Reset(m_vertices_capacity);
+        m_index_allocator .Reset(m_indices_capacity);
+
+        for (auto& allocation : m_allocations)
+        {
+            if (!allocation.m_is_used)
+            {
+                continue;
+            }
+
+            uint32_t vertex_offset = m_vertex_allocator.Allocate(allocation.m_vertices_count);
+            uint32_t index_offset  = m_index_allocator .Allocate(allocation.m_indices_count);
+
+            glCopyNamedBufferSubData(m_vbo_name, vbo_name, GLintptr(allocation.m_vertex_offset) * m_vertex_stride,  GLintptr(vertex_offset) * m_vertex_stride,  GLsizeiptr(allocation.m_vertices_count) * m_vertex_stride);
+            glCopyNamedBufferSubData(m_ibo_name, ibo_name, GLintptr(allocation.m_index_offset)  * sizeof(uint32_t), GLintptr(index_offset)  * sizeof(uint32_t), GLsizeiptr(allocation.m_indices_count)  * sizeof(uint32_t));
+
+            allocation.m_vertex_offset = vertex_offset;
+            allocation.m_index_offset  = index_offset;
+        }
+
+        GpuMemory::UntrackBuffer(m_vbo_name);
+        GpuMemory::UntrackBuffer(m_ibo_name);
+        glDeleteBuffers(1, &m_vbo_name);
+        glDeleteBuffers(1, &m_ibo_name);
+
+        m_vbo_name = vbo_name;
+        m_ibo_name = ibo_name;
+
+        for (GLuint vao_name : { m_vao_name, m_depth_vao_name })
+        {
+            glVertexArrayElementBuffer(vao_name, m_ibo_name);
+            glVertexArrayVertexBuffer (vao_name, 0 /* bindingindex*/, m_vbo_name, 0 /* offset */, m_vertex_stride);
+        }
+
+        m_generation++;
+
+        printf("GeometryPool compacted: %u vertices and %u indices free\n", m_vertex_allocator.GetFreeSize(), m_index_allocator.GetFreeSize());
+    }
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "static_model.h"
+
+namespace RGL
+{
+    /* First-fit allocator of ranges in [0, size), the free blocks are kept sorted by offset and merged with their neighbours. */
+    class OffsetAllocator
+    {
+    public:
+        static constexpr uint32_t INVALID_OFFSET = 0xFFFFFFFF;
+
+        explicit OffsetAllocator(uint32_t size = 0);
+
+        void     Reset   (uint32_t size);
+        uint32_t Allocate(uint32_t size);
+        void     Free    (uint32_t offset, uint32_t size);
+
+        uint32_t GetSize()             const { return m_size; }
+        uint32_t GetFreeSize()         const { return m_free_size; }
+        uint32_t GetLargestFreeBlock() const;
+
+        /* True if all the free space is a single block at the end. */
+        bool IsCompact() const;
+
+    private:
+        struct Block
+        {
+            uint32_t m_offset;
+            uint32_t m_size;
+        };
+
+        std::vector<Block> m_free_blocks;
+        uint32_t           m_size;
+        uint32_t           m_free_size;
+    };
+
+    /*
+     * Shared vertex and index buffers for the StaticModels with the same interleaved vertex format.
+     * All the models in a pool are drawn with the same VAO, so the draws of different models can be merged
+     * into a single glMultiDrawElementsIndirect (GetIndirectCommands() of a pooled model already points into the pool).
+     *
+     * The buffers are immutable and never grow - SetCapacity() has to be called before the first Get() if the defaults
+     * (1M vertices and 4M indices per pool) aren't enough. When a pool is full, the model falls back to its own buffers.
+     * Indices are always 32-bit. PLANAR models can't be pooled.
+     */
+    class GeometryPool final
+    {
+    public:
+        using Handle = uint32_t;
+
+        static constexpr Handle INVALID_HANDLE = 0xFFFFFFFF;
+
+        struct Allocation
+        {
+            uint32_t m_vertex_offset;
+            uint32_t m_vertices_count;
+            uint32_t m_index_offset;
+            uint32_t m_indices_count;
+            bool     m_is_used;
+        };
+
+        GeometryPool(VertexFormat format, bool has_tangents, uint32_t vertices_capacity, uint32_t indices_capacity);
+        ~GeometryPool();
+
+        GeometryPool           (const GeometryPool&) = delete;
+        GeometryPool& operator=(const GeometryPool&) = delete;
+
+        static void          SetCapacity(uint32_t vertices_capacity, uint32_t indices_capacity);
+        static GeometryPool* Get(VertexFormat format, bool has_tangents);
+
+        /* Has to be called while the GL context is still alive. CoreApp does it in its destructor. */
+        static void ReleaseAll();
+
+        /* vertices have to be packed in the pool's vertex format. Returns INVALID_HANDLE if there's no room left. */
+        Handle Allocate(const void* vertices, uint32_t vertices_count, const uint32_t* indices, uint32_t indices_count);
+        void   Free    (Handle handle);
+
+        /*
+         * Moves all the allocations to the beginning of new buffers, removing the holes left by the freed ones.
+         * Bumps the generation, so the models rebase their draws before the next render.
+         */
+        void Compact();
+
+        const Allocation& GetAllocation(Handle handle) const { return m_allocations[handle]; }
+
+        uint32_t GetGeneration()   const { return m_generation; }
+        GLuint   GetVao()          const { return m_vao_name; }
+        GLuint   GetDepthVao()     const { return m_depth_vao_name; } /* The positions only, see StaticModel::GetDepthVertexArray(). */
+        GLuint   GetVbo()          const { return m_vbo_name; }
+        GLuint   GetIbo()          const { return m_ibo_name; }
+        uint32_t GetVertexStride() const { return m_vertex_stride; }
+        uint32_t GetFreeVertices() const { return m_vertex_allocator.GetFreeSize(); }
+        uint32_t GetFreeIndices()  const { return m_index_allocator.GetFreeSize(); }
+
+    private:
+        void CreateBuffers(GLuint& vbo_name, GLuint& ibo_name) const;
+
+        static std::unique_ptr<GeometryPool> s_pools[4];
+        static uint32_t                      s_vertices_capacity;
+        static uint32_t                      s_indices_capacity;
+
+        std::vector<Allocation> m_allocations;
+        std::vector<Handle>     m_free_handles;
+        OffsetAllocator         m_vertex_allocator;
+        OffsetAllocator         m_index_allocator;
+
+        GLuint   m_vao_name;
+        GLuint   m_depth_vao_name;
+        GLuint   m_vbo_name;
+        GLuint   m_ibo_name;
+        uint32_t m_vertex_stride;
+        uint32_t m_vertices_capacity;
+        uint32_t m_indices_capacity;
+        uint32_t m_generation;
+    };
+}
@@ -0,0 +1,229 @@
+#include "gl_state.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace RGL
+{
+    namespace
+    {
+        /* Never a valid GL name or enum, so the first call is never skipped. */
+        constexpr GLuint UNKNOWN = 0xFFFFFFFF;
+    }
+
+    bool             GLState::s_is_enabled = false;
+    GLState::Stats   GLState::s_stats       = {};
+    GLState::Stats   GLState::s_frame_stats = {};
+
+    GLuint GLState::s_program;
+    GLuint GLState::s_vao;
+    GLuint GLState::s_textures[MAX_TEXTURE_UNITS];
+    GLuint GLState::s_samplers[MAX_TEXTURE_UNITS];
+    GLuint GLState::s_draw_framebuffer;
+    GLuint GLState::s_read_framebuffer;
+    GLuint GLState::s_viewport[4];
+    GLuint GLState::s_blend;
+    GLuint GLState::s_depth_test;
+    GLuint GLState::s_cull_face;
+    GLuint GLState::s_blend_factors[2];
+    GLuint GLState::s_depth_func;
+    GLuint GLState::s_depth_mask;
+    GLuint GLState::s_cull_face_mode;
+
+    void GLState::Invalidate()
+    {
+        s_program          = UNKNOWN;
+        s_vao              = UNKNOWN;
+        s_draw_framebuffer = UNKNOWN;
+        s_read_framebuffer = UNKNOWN;
+        s_blend            = UNKNOWN;
+        s_depth_test       = UNKNOWN;
+        s_cull_face        = UNKNOWN;
+        s_depth_func       = UNKNOWN;
+        s_depth_mask       = UNKNOWN;
+        s_cull_face_mode   = UNKNOWN;
+
+        std::fill(std::begin(s_textures),      std::end(s_textures),      UNKNOWN);
+        std::fill(std::begin(s_samplers),      std::end(s_samplers),      UNKNOWN);
+        std::fill(std::begin(s_viewport),      std::end(s_viewport),      UNKNOWN);
+        std::fill(std::begin(s_blend_factors), std::end(s_blend_factors), UNKNOWN);
+    }
+
+    void GLState::EndFrame()
+    {
+        s_frame_stats = s_stats;
+        s_stats       = {};
+
+        Invalidate();
+    }
+
+    bool GLState::IsRedundant(GLuint& cached_value, GLuint value)
+    {
+        s_stats.m_calls++;
+
+        if (cached_value == value)
+        {
+            s_stats.m_redundant_calls++;
+            return s_is_enabled;
+        }
+
+        cached_value = value;
+        return false;
+    }
+
+    void GLState::UseProgram(GLuint program)
+    {
+        if (!IsRedundant(s_program, program))
+        {
+            glUseProgram(program);
+        }
+    }
+
+    void GLState::BindVertexArray(GLuint vao)
+    {
+        if (!IsRedundant(s_vao, vao))
+        {
+            glBindVertexArray(vao);
+        }
+    }
+
+    void GLState::BindTextureUnit(GLuint unit, GLuint texture)
+    {
+        if (unit >= MAX_TEXTURE_UNITS)
+        {
+            glBindTextureUnit(unit, texture);
+            return;
+        }
+
+        if (!IsRedundant(s_textures[unit], texture))
+        {
+            glBindTextureUnit(unit, texture);
+        }
+    }
+
+    void GLState::BindSampler(GLuint unit, GLuint sampler)
+    {
+        if (unit >= MAX_TEXTURE_UNITS)
+        {
+            glBindSampler(unit, sampler);
+            return;
+        }
+
+        if (!IsRedundant(s_samplers[unit], sampler))
+        {
+            glBindSampler(unit, sampler);
+        }
+    }
+
+    void GLState::BindFramebuffer(GLenum target, GLuint framebuffer)
+    {
+        bool is_redundant;
+
+        if (target == GL_FRAMEBUFFER)
+        {
+            GLuint cached = s_draw_framebuffer == framebuffer && s_read_framebuffer == framebuffer ? framebuffer : UNKNOWN;
+            is_redundant  = IsRedundant(cached, framebuffer);
+
+            s_draw_framebuffer = s_read_framebuffer = framebuffer;
+        }
+        else
+        {
+            is_redundant = IsRedundant(target == GL_DRAW_FRAMEBUFFER ? s_draw_framebuffer : s_read_framebuffer, framebuffer);
+        }
+
+        if (!is_redundant)
+        {
+            glBindFramebuffer(target, framebuffer);
+        }
+    }
+
+    void GLState::Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        const GLuint viewport[] = { GLuint(x), GLuint(y), GLuint(width), GLuint(height) };
+
+        GLuint cached = std::equal(std::begin(viewport), std::end(viewport), std::begin(s_viewport)) ? 0 : UNKNOWN;
+
+        if (!IsRedundant(cached, 0))
+        {
+            std::copy(std::begin(viewport), std::end(viewport), std::begin(s_viewport));
+            glViewport(x, y, width, height);
+        }
+    }
+
+    void GLState::SetCapability(GLenum capability, bool enable)
+    {
+        GLuint* cached = capability == GL_BLEND      ? &s_blend      :
+                         capability == GL_DEPTH_TEST ? &s_depth_test :
+                         capability == GL_CULL_FACE  ? &s_cull_face  : nullptr;
+
+        if (cached && IsRedundant(*cached, enable))
+        {
+            return;
+        }
+
+        enable ? glEnable(capability) : glDisable(capability);
+    }
+
+    void GLState::BlendFunc(GLenum src_factor, GLenum dst_factor)
+    {
+        GLuint cached = s_blend_factors[0] == src_factor && s_blend_factors[1] == dst_factor ? 0 : UNKNOWN;
+
+        if (!IsRedundant(cached, 0))
+        {
+            s_blend_factors[0] = src_factor;
+            s_blend_factors[1] = dst_factor;
+
+            glBlendFunc(src_factor, dst_factor);
+        }
+    }
+
+    void GLState::DepthFunc(GLenum func)
+    {
+        if (!IsRedundant(s_depth_func, func))
+        {
+            glDepthFunc(func);
+        }
+    }
+
+    void GLState::DepthMask(bool enable)
+    {
+        if (!IsRedundant(s_depth_mask, enable))
+        {
+            glDepthMask(enable ? GL_TRUE : GL_FALSE);
+        }
+    }
+
+    void GLState::CullFace(GLenum mode)
+    {
+        if (!IsRedundant(s_cull_face_mode, mode))
+        {
+            glCullFace(mode);
+        }
+    }
+
+    void GLState::OnProgramDeleted(GLuint program)
+    {
+        if (s_program == program) s_program = UNKNOWN;
+    }
+
+    void GLState::OnVertexArrayDeleted(GLuint vao)
+    {
+        if (s_vao == vao) s_vao = UNKNOWN;
+    }
+
+    void GLState::OnTextureDeleted(GLuint texture)
+    {
+        std::replace(std::begin(s_textures), std::end(s_textures), texture, UNKNOWN);
+    }
+
+    void GLState::OnSamplerDeleted(GLuint sampler)
+    {
+        std::replace(std::begin(s_samplers), std::end(s_samplers), sampler, UNKNOWN);
+    }
+
+    void GLState::OnFramebufferDeleted(GLuint framebuffer)
+    {
+        if (s_draw_framebuffer == framebuffer) s_draw_framebuffer = UNKNOWN;
+        if (s_read_framebuffer == framebuffer) s_read_framebuffer = UNKNOWN;
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glad/glad.h>
+
+namespace RGL
+{
+    /*
+     * Shadow copy of the GL binding and pipeline state, used by the core classes (Shader::bind, Texture::Bind, StaticModel draws)
+     * instead of the direct GL calls. When enabled, a call that sets the already current value is skipped.
+     * Redundant calls are counted even when disabled, so the savings can be measured before turning it on.
+     *
+     * Disabled by default - raw GL calls made by the demos aren't seen by the cache. Code that mixes both has to call
+     * Invalidate() after the raw calls. CoreApp invalidates the cache at the beginning of every frame.
+     */
+    class GLState
+    {
+    public:
+        struct Stats
+        {
+            uint32_t m_calls;
+            uint32_t m_redundant_calls;
+        };
+
+        static void SetEnabled(bool enable) { s_is_enabled = enable; Invalidate(); }
+        static bool IsEnabled()             { return s_is_enabled; }
+
+        /* Forgets all the cached values, the next call of every kind goes to GL. */
+        static void Invalidate();
+
+        /* Stores the counters of the finished frame (see GetFrameStats()) and invalidates the cache. */
+        static void EndFrame();
+
+        /* Counters of the last finished frame. */
+        static const Stats& GetFrameStats() { return s_frame_stats; }
+
+        static void UseProgram     (GLuint program);
+        static void BindVertexArray(GLuint vao);
+        static void BindTextureUnit(GLuint unit, GLuint texture);
+        static void BindSampler    (GLuint unit, GLuint sampler);
+
+        /* GL_FRAMEBUFFER sets both the draw and the read framebuffer. */
+        static void BindFramebuffer(GLenum target, GLuint framebuffer);
+        static void Viewport       (GLint x, GLint y, GLsizei width, GLsizei height);
+
+        /* GL_BLEND, GL_DEPTH_TEST and GL_CULL_FACE are cached, other capabilities go straight to GL. */
+        static void SetCapability(GLenum capability, bool enable);
+        static void BlendFunc    (GLenum src_factor, GLenum dst_factor);
+        static void DepthFunc    (GLenum func);
+        static void DepthMask    (bool enable);
+        static void CullFace     (GLenum mode);
+
+        /* Have to be called when the objects are deleted - GL unbinds them, a new object can reuse the name. */
+        static void OnProgramDeleted    (GLuint program);
+        static void OnVertexArrayDeleted(GLuint vao);
+        static void OnTextureDeleted    (GLuint texture);
+        static void OnSamplerDeleted    (GLuint sampler);
+        static void OnFramebufferDeleted(GLuint framebuffer);
+
+    private:
+        static constexpr uint32_t MAX_TEXTURE_UNITS = 32;
+
+        static bool IsRedundant(GLuint& cached_value, GLuint value);
+
+        static bool  s_is_enabled;
+        static Stats s_stats;
+        static Stats s_frame_stats;
+
+        static GLuint s_program;
+        static GLuint s_vao;
+        static GLuint s_textures[MAX_TEXTURE_UNITS];
+        static GLuint s_samplers[MAX_TEXTURE_UNITS];
+        static GLuint s_draw_framebuffer;
+        static GLuint s_read_framebuffer;
+        static GLuint s_viewport[4];
+        static GLuint s_blend;
+        static GLuint s_depth_test;
+        static GLuint s_cull_face;
+        static GLuint s_blend_factors[2];
+        static GLuint s_depth_func;
+        static GLuint s_depth_mask;
+        static GLuint s_cull_face_mode;
+    };
+}
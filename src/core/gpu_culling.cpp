@@ -0,0 +1,267 @@
+#include "gpu_culling.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "frustum.h"
+#include "gpu_memory.h"
+
+namespace RGL
+{
+    GpuCulling::GpuCulling()
+        : m_hiz_view_projection          (1.0f),
+          m_objects_buffer_name          (0),
+          m_commands_template_buffer_name(0),
+          m_commands_buffer_name         (0),
+          m_visible_instances_buffer_name(0),
+          m_hiz_texture_name             (0),
+          m_hiz_width                    (0),
+          m_hiz_height                   (0),
+          m_hiz_levels_count             (0),
+          m_objects_count                (0),
+          m_objects_capacity             (0),
+          m_is_hiz_valid                 (false),
+          m_is_occlusion_culling_enabled (true)
+    {
+    }
+
+    GpuCulling::~GpuCulling()
+    {
+        Release();
+    }
+
+    bool GpuCulling::Create()
+    {
+        m_cull_shader = std::make_shared<Shader>("src/core/shaders/cull_objects.comp");
+        m_hiz_shader  = std::make_shared<Shader>("src/core/shaders/hiz_build.comp");
+
+        if (!m_cull_shader->link() || !m_hiz_shader->link())
+        {
+            fprintf(stderr, "GpuCulling: could not link the culling shaders.\n");
+            return false;
+        }
+
+        return true;
+    }
+
+    void GpuCulling::SetObjects(const std::vector<CullingObject>& objects, const std::vector<DrawElementsIndirectCommand>& commands)
+    {
+        /* Every command gets a range of the visible instances buffer big enough for all of its objects. */
+        std::vector<uint32_t> objects_per_command(commands.size(), 0);
+
+        for (const auto& object : objects)
+        {
+            if (object.command_index < commands.size())
+            {
+                objects_per_command[object.command_index]++;
+            }
+        }
+
+        const bool is_resized = commands.size() != m_commands.size();
+
+        m_commands = commands;
+
+        uint32_t base_instance = 0;
+
+        for (size_t i = 0; i < m_commands.size(); ++i)
+        {
+            m_commands[i].m_instance_count = 0;
+            m_commands[i].m_base_instance  = base_instance;
+
+            base_instance += objects_per_command[i];
+        }
+
+        if (is_resized)
+        {
+            GpuMemory::UntrackBuffer(m_commands_template_buffer_name);
+            GpuMemory::UntrackBuffer(m_commands_buffer_name);
+            glDeleteBuffers(1, &m_commands_template_buffer_name);
+            glDeleteBuffers(1, &m_commands_buffer_name);
+            m_commands_template_buffer_name = m_commands_buffer_name = 0;
+
+            if (!m_commands.empty())
+            {
+                const GLsizeiptr size = sizeof(m_commands[0]) * m_commands.size();
+
+                glCreateBuffers     (1, &m_commands_template_buffer_name);
+                glNamedBufferStorage(m_commands_template_buffer_name, size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+                GpuMemory::TrackBuffer(m_commands_template_buffer_name, "GpuCulling");
+
+                glCreateBuffers     (1, &m_commands_buffer_name);
+                glNamedBufferStorage(m_commands_buffer_name, size, nullptr, 0);
+                GpuMemory::TrackBuffer(m_commands_buffer_name, "GpuCulling");
+            }
+        }
+
+        if (!m_commands.empty())
+        {
+            glNamedBufferSubData(m_commands_template_buffer_name, 0, sizeof(m_commands[0]) * m_commands.size(), m_commands.data());
+        }
+
+        m_objects_count = uint32_t(objects.size());
+
+        if (m_objects_count > m_objects_capacity)
+        {
+            GpuMemory::UntrackBuffer(m_objects_buffer_name);
+            GpuMemory::UntrackBuffer(m_visible_instances_buffer_name);
+            glDeleteBuffers(1, &m_objects_buffer_name);
+            glDeleteBuffers(1, &m_visible_instances_buffer_name);
+
+            m_objects_capacity = m_objects_count;
+
+            glCreateBuffers     (1, &m_objects_buffer_name);
+            glNamedBufferStorage(m_objects_buffer_name, sizeof(CullingObject) * m_objects_capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+            GpuMemory::TrackBuffer(m_objects_buffer_name, "GpuCulling");
+
+            glCreateBuffers     (1, &m_visible_instances_buffer_name);
+            glNamedBufferStorage(m_visible_instances_buffer_name, sizeof(uint32_t) * m_objects_capacity, nullptr, 0);
+            GpuMemory::TrackBuffer(m_visible_instances_buffer_name, "GpuCulling");
+        }
+
+        if (m_objects_count > 0)
+        {
+            glNamedBufferSubData(m_objects_buffer_name, 0, sizeof(CullingObject) * m_objects_count, objects.data());
+        }
+    }
+
+    void GpuCulling::CreateHiZTexture(GLsizei width, GLsizei height)
+    {
+        GpuMemory::UntrackTexture(m_hiz_texture_name);
+        glDeleteTextures(1, &m_hiz_texture_name);
+        GLState::OnTextureDeleted(m_hiz_texture_name);
+
+        m_hiz_width        = width;
+        m_hiz_height       = height;
+        m_hiz_levels_count = Texture::GetMaxMipMapsLevels(width, height, 0);
+
+        glCreateTextures   (GL_TEXTURE_2D, 1, &m_hiz_texture_name);
+        glTextureStorage2D (m_hiz_texture_name, m_hiz_levels_count, GL_R32F, width, height);
+        glTextureParameteri(m_hiz_texture_name, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTextureParameteri(m_hiz_texture_name, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTextureParameteri(m_hiz_texture_name, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+        glTextureParameteri(m_hiz_texture_name, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+        GpuMemory::TrackTexture(m_hiz_texture_name, "GpuCulling");
+    }
+
+    void GpuCulling::BuildHiZ(GLuint depth_texture, const glm::mat4& view_projection)
+    {
+        GLint width, height;
+        glGetTextureLevelParameteriv(depth_texture, 0, GL_TEXTURE_WIDTH,  &width);
+        glGetTextureLevelParameteriv(depth_texture, 0, GL_TEXTURE_HEIGHT, &height);
+
+        if (width <= 0 || height <= 0)
+        {
+            return;
+        }
+
+        if (width != m_hiz_width || height != m_hiz_height)
+        {
+            CreateHiZTexture(width, height);
+        }
+
+        m_hiz_shader->bind();
+
+        /* Level 0 - copy of the depth. */
+        GLState::BindTextureUnit(0, depth_texture);
+        glBindImageTexture(1, m_hiz_texture_name, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+        m_hiz_shader->setUniform("u_is_copy_pass", true);
+        m_hiz_shader->setUniform("u_output_size",  glm::uvec2(width, height));
+
+        glDispatchCompute((width + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, (height + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        m_hiz_shader->setUniform("u_is_copy_pass", false);
+
+        for (GLsizei level = 1; level < m_hiz_levels_count; ++level)
+        {
+            GLint level_width  = std::max(width  >> level, 1);
+            GLint level_height = std::max(height >> level, 1);
+
+            glBindImageTexture(0, m_hiz_texture_name, level - 1, GL_FALSE, 0, GL_READ_ONLY,  GL_R32F);
+            glBindImageTexture(1, m_hiz_texture_name, level,     GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+            m_hiz_shader->setUniform("u_output_size", glm::uvec2(level_width, level_height));
+
+            glDispatchCompute((level_width + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, (level_height + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, 1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        }
+
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        m_hiz_view_projection = view_projection;
+        m_is_hiz_valid        = true;
+    }
+
+    void GpuCulling::Cull(const Camera& camera)
+    {
+        Cull(camera.viewProjection());
+    }
+
+    void GpuCulling::Cull(const glm::mat4& view_projection)
+    {
+        if (m_objects_count == 0 || m_commands.empty())
+        {
+            return;
+        }
+
+        /* Reset the instance counts. */
+        glCopyNamedBufferSubData(m_commands_template_buffer_name, m_commands_buffer_name, 0, 0, sizeof(m_commands[0]) * m_commands.size());
+
+        glm::vec4 planes[6];
+        ExtractFrustumPlanes(view_projection, planes);
+
+        const bool is_occlusion_culling_enabled = m_is_occlusion_culling_enabled && m_is_hiz_valid;
+
+        m_cull_shader->bind();
+        m_cull_shader->setUniform("u_objects_count",                 m_objects_count);
+        m_cull_shader->setUniform("u_frustum_planes",                planes, 6);
+        m_cull_shader->setUniform("u_hiz_view_projection",           m_hiz_view_projection);
+        m_cull_shader->setUniform("u_hiz_size",                      glm::vec2(m_hiz_width, m_hiz_height));
+        m_cull_shader->setUniform("u_hiz_levels_count",              int(m_hiz_levels_count));
+        m_cull_shader->setUniform("u_is_occlusion_culling_enabled",  is_occlusion_culling_enabled);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULLING_OBJECTS_SSBO_BINDING_INDEX,           m_objects_buffer_name);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULLING_COMMANDS_SSBO_BINDING_INDEX,          m_commands_buffer_name);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULLING_VISIBLE_INSTANCES_SSBO_BINDING_INDEX, m_visible_instances_buffer_name);
+        GLState::BindTextureUnit(0, is_occlusion_culling_enabled ? m_hiz_texture_name : 0);
+
+        glDispatchCompute((m_objects_count + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    void GpuCulling::ExtractFrustumPlanes(const glm::mat4& view_projection, glm::vec4 planes[6])
+    {
+        const Frustum frustum(view_projection);
+        std::copy_n(frustum.GetPlanes(), 6, planes);
+    }
+
+    void GpuCulling::Bind() const
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULLING_VISIBLE_INSTANCES_SSBO_BINDING_INDEX, m_visible_instances_buffer_name);
+    }
+
+    void GpuCulling::Release()
+    {
+        GpuMemory::UntrackBuffer(m_objects_buffer_name);
+        GpuMemory::UntrackBuffer(m_commands_template_buffer_name);
+        GpuMemory::UntrackBuffer(m_commands_buffer_name);
+        GpuMemory::UntrackBuffer(m_visible_instances_buffer_name);
+        GpuMemory::UntrackTexture(m_hiz_texture_name);
+        glDeleteBuffers(1, &m_objects_buffer_name);
+        glDeleteBuffers(1, &m_commands_template_buffer_name);
+        glDeleteBuffers(1, &m_commands_buffer_name);
+        glDeleteBuffers(1, &m_visible_instances_buffer_name);
+        glDeleteTextures(1, &m_hiz_texture_name);
+        GLState::OnTextureDeleted(m_hiz_texture_name);
+
+        m_objects_buffer_name           = 0;
+        m_commands_template_buffer_name = 0;
+        m_commands_buffer_name          = 0;
+        m_visible_instances_buffer_name = 0;
+        m_hiz_texture_name              = 0;
+        m_objects_count                 = 0;
+        m_objects_capacity              = 0;
+        m_is_hiz_valid                  = false;
+    }
+}
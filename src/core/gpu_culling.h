@@ -0,0 +1,88 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/mat4x4.hpp>
+
+#include "camera.h"
+#include "core_shared.h"
+#include "shader.h"
+#include "static_model.h"
+#include "texture.h"
+
+namespace RGL
+{
+    /*
+     * Compute shader culling of the objects drawn with indirect commands.
+     * Every object is a world space bounding sphere, the index of the command it's drawn with and its instance id.
+     * Cull() tests the objects against the camera frustum and the hierarchical-Z pyramid built from the previous
+     * frame's depth, then compacts the visible instance ids with atomics into the range of each command
+     * and writes the instance counts of the indirect draw arguments.
+     *
+     * Vertex shaders read the instance id with CULLED_INSTANCE_ID (see core_shared.h) instead of gl_InstanceID.
+     * StaticModel::GetCullingObjects() and StaticModel::RenderIndirect(culling) connect it to the models.
+     */
+    class GpuCulling final
+    {
+    public:
+        GpuCulling();
+        ~GpuCulling();
+
+        GpuCulling           (const GpuCulling&) = delete;
+        GpuCulling& operator=(const GpuCulling&) = delete;
+
+        bool Create();
+
+        /*
+         * Sets the commands template and the objects. The commands' instance counts and base instances are overwritten.
+         * Can be called every frame for moving objects - the buffers are reallocated only when they grow.
+         */
+        void SetObjects(const std::vector<CullingObject>& objects, const std::vector<DrawElementsIndirectCommand>& commands);
+
+        /* Builds the HiZ pyramid from the depth texture rendered with the view_projection matrix. Used by the next Cull(). */
+        void BuildHiZ(GLuint depth_texture, const glm::mat4& view_projection);
+
+        void Cull(const Camera& camera);
+        void Cull(const glm::mat4& view_projection);
+
+        /* Occlusion culling needs a HiZ pyramid, without one only the frustum test is done. */
+        void SetOcclusionCulling(bool enable)  { m_is_occlusion_culling_enabled = enable; }
+        bool IsOcclusionCullingEnabled() const { return m_is_occlusion_culling_enabled; }
+
+        /* Binds the visible instances buffer for the vertex shaders. */
+        void Bind() const;
+
+        /* Gribb-Hartmann plane extraction, the planes point inside the frustum. */
+        static void ExtractFrustumPlanes(const glm::mat4& view_projection, glm::vec4 planes[6]);
+
+        GLuint   GetIndirectBuffer()         const { return m_commands_buffer_name; }
+        GLuint   GetVisibleInstancesBuffer() const { return m_visible_instances_buffer_name; }
+        GLuint   GetHiZTexture()             const { return m_hiz_texture_name; }
+        uint32_t GetCommandsCount()          const { return uint32_t(m_commands.size()); }
+        uint32_t GetObjectsCount()           const { return m_objects_count; }
+
+    private:
+        void CreateHiZTexture(GLsizei width, GLsizei height);
+        void Release();
+
+        std::shared_ptr<Shader>                  m_cull_shader;
+        std::shared_ptr<Shader>                  m_hiz_shader;
+        std::vector<DrawElementsIndirectCommand> m_commands;
+
+        glm::mat4 m_hiz_view_projection;
+        GLuint    m_objects_buffer_name;
+        GLuint    m_commands_template_buffer_name;
+        GLuint    m_commands_buffer_name;
+        GLuint    m_visible_instances_buffer_name;
+        GLuint    m_hiz_texture_name;
+        GLsizei   m_hiz_width;
+        GLsizei   m_hiz_height;
+        GLsizei   m_hiz_levels_count;
+        uint32_t  m_objects_count;
+        uint32_t  m_objects_capacity;
+        bool      m_is_hiz_valid;
+        bool      m_is_occlusion_culling_enabled;
+    };
+}
@@ -0,0 +1,273 @@
+#include "gpu_memory.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "gui/gui.h"
+
+namespace RGL
+{
+    namespace
+    {
+        constexpr double MB = 1024.0 * 1024.0;
+
+        /* The bits of a texel of an uncompressed level, as the driver stores it. */
+        size_t getTexelBits(GLuint name, GLint level)
+        {
+            static constexpr GLenum SIZES[] = { GL_TEXTURE_RED_SIZE,   GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE,
+                                                GL_TEXTURE_DEPTH_SIZE, GL_TEXTURE_STENCIL_SIZE, GL_TEXTURE_SHARED_SIZE };
+            size_t bits = 0;
+
+            for (GLenum size : SIZES)
+            {
+                GLint value = 0;
+                glGetTextureLevelParameteriv(name, level, size, &value);
+
+                bits += size_t(value);
+            }
+
+            return bits;
+        }
+    }
+
+    std::mutex                                     GpuMemory::s_mutex;
+    std::unordered_map<uint64_t, GpuMemory::Entry> GpuMemory::s_entries;
+    std::vector<GpuMemory::OwnerStats>             GpuMemory::s_owners;
+    size_t                                         GpuMemory::s_sizes[2]    = {};
+    GpuMemory::DriverInfo                          GpuMemory::s_driver_info = {};
+    uint32_t                                       GpuMemory::s_frame       = 0;
+
+    void GpuMemory::TrackBuffer(GLuint name, const char* owner)
+    {
+        GLint64 size = 0;
+        glGetNamedBufferParameteri64v(name, GL_BUFFER_SIZE, &size);
+
+        Track(Kind::Buffer, name, size_t(size), owner);
+    }
+
+    void GpuMemory::TrackTexture(GLuint name, const char* owner)
+    {
+        Track(Kind::Texture, name, GetTextureSize(name), owner);
+    }
+
+    void GpuMemory::UntrackBuffer(GLuint name)
+    {
+        Untrack(Kind::Buffer, name);
+    }
+
+    void GpuMemory::UntrackTexture(GLuint name)
+    {
+        Untrack(Kind::Texture, name);
+    }
+
+    size_t GpuMemory::GetTotalSize()
+    {
+        std::lock_guard lock(s_mutex);
+        return s_sizes[0] + s_sizes[1];
+    }
+
+    size_t GpuMemory::GetBuffersSize()
+    {
+        std::lock_guard lock(s_mutex);
+        return s_sizes[size_t(Kind::Buffer)];
+    }
+
+    size_t GpuMemory::GetTexturesSize()
+    {
+        std::lock_guard lock(s_mutex);
+        return s_sizes[size_t(Kind::Texture)];
+    }
+
+    std::vector<GpuMemory::OwnerStats> GpuMemory::GetOwners()
+    {
+        std::vector<OwnerStats> owners;
+        {
+            std::lock_guard lock(s_mutex);
+            owners = s_owners;
+        }
+
+        std::sort(owners.begin(), owners.end(), [](const OwnerStats& a, const OwnerStats& b) { return a.m_size > b.m_size; });
+        return owners;
+    }
+
+    void GpuMemory::EndFrame()
+    {
+        if (s_frame++ % DRIVER_INFO_INTERVAL == 0)
+        {
+            QueryDriverInfo();
+        }
+    }
+
+    void GpuMemory::RenderGui()
+    {
+        ImGui::Text("Tracked: %.1f MB (buffers %.1f MB, textures %.1f MB)", GetTotalSize() / MB, GetBuffersSize() / MB, GetTexturesSize() / MB);
+
+        const DriverInfo& info = s_driver_info;
+
+        if (info.m_source != nullptr)
+        {
+            if (info.m_dedicated > 0)
+            {
+                ImGui::Text("Driver: %.0f / %.0f MB free, %u evictions (%.1f MB)", info.m_current_available / MB, info.m_dedicated / MB,
+                            info.m_evictions_count, info.m_evicted / MB);
+            }
+            else
+            {
+                ImGui::Text("Driver: %.0f MB free for textures", info.m_current_available / MB);
+            }
+        }
+
+        const auto owners = GetOwners();
+
+        if (owners.empty())
+        {
+            return;
+        }
+
+        if (ImGui::BeginTable("##GpuMemory", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+        {
+            ImGui::TableSetupColumn("Owner", ImGuiTableColumnFlags_WidthStretch);
+            ImGui::TableSetupColumn("MB");
+            ImGui::TableSetupColumn("Count");
+            ImGui::TableHeadersRow();
+
+            for (size_t i = 0; i < std::min(owners.size(), size_t(TOP_OWNERS_COUNT)); ++i)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(owners[i].m_owner);
+                ImGui::TableNextColumn(); ImGui::Text("%.2f", owners[i].m_size / MB);
+                ImGui::TableNextColumn(); ImGui::Text("%u", owners[i].m_count);
+            }
+
+            ImGui::EndTable();
+        }
+    }
+
+    size_t GpuMemory::GetTextureSize(GLuint name)
+    {
+        GLint target = 0, levels_count = 0;
+        glGetTextureParameteriv(name, GL_TEXTURE_TARGET,           &target);
+        glGetTextureParameteriv(name, GL_TEXTURE_IMMUTABLE_LEVELS, &levels_count);
+
+        /* The buffer textures' storage is their buffer's. */
+        if (target == GL_TEXTURE_BUFFER)
+        {
+            return 0;
+        }
+
+        levels_count = std::max(levels_count, 1);
+
+        GLint samples = 0;
+        glGetTextureLevelParameteriv(name, 0, GL_TEXTURE_SAMPLES, &samples);
+
+        /* The level queries of a cube map are of a single face. */
+        const size_t faces = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+        size_t       size  = 0;
+
+        for (GLint level = 0; level < levels_count; ++level)
+        {
+            GLint width = 0, height = 0, depth = 0, is_compressed = GL_FALSE;
+            glGetTextureLevelParameteriv(name, level, GL_TEXTURE_WIDTH,      &width);
+            glGetTextureLevelParameteriv(name, level, GL_TEXTURE_HEIGHT,     &height);
+            glGetTextureLevelParameteriv(name, level, GL_TEXTURE_DEPTH,      &depth);
+            glGetTextureLevelParameteriv(name, level, GL_TEXTURE_COMPRESSED, &is_compressed);
+
+            if (is_compressed)
+            {
+                GLint level_size = 0;
+                glGetTextureLevelParameteriv(name, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &level_size);
+
+                size += size_t(level_size) * faces;
+            }
+            else
+            {
+                const size_t texels = size_t(width) * std::max(height, 1) * std::max(depth, 1) * std::max(samples, 1);
+                size += (texels * getTexelBits(name, level) + 7) / 8 * faces;
+            }
+        }
+
+        return size;
+    }
+
+    void GpuMemory::Track(Kind kind, GLuint name, size_t size, const char* owner)
+    {
+        if (name == 0)
+        {
+            return;
+        }
+
+        std::lock_guard lock(s_mutex);
+
+        auto [it, is_inserted] = s_entries.try_emplace(MakeKey(kind, name), Entry{ owner, size });
+
+        if (!is_inserted)
+        {
+            s_sizes[size_t(kind)] -= it->second.m_size;
+            UpdateOwner(it->second.m_owner, -int64_t(it->second.m_size), -1);
+
+            it->second = { owner, size };
+        }
+
+        s_sizes[size_t(kind)] += size;
+        UpdateOwner(owner, int64_t(size), 1);
+    }
+
+    void GpuMemory::Untrack(Kind kind, GLuint name)
+    {
+        std::lock_guard lock(s_mutex);
+
+        auto it = s_entries.find(MakeKey(kind, name));
+
+        if (it == s_entries.end())
+        {
+            return;
+        }
+
+        s_sizes[size_t(kind)] -= it->second.m_size;
+        UpdateOwner(it->second.m_owner, -int64_t(it->second.m_size), -1);
+
+        s_entries.erase(it);
+    }
+
+    void GpuMemory::UpdateOwner(const char* owner, int64_t size, int32_t count)
+    {
+        /* The same tag may be a different literal in every translation unit. */
+        auto it = std::find_if(s_owners.begin(), s_owners.end(), [owner](const OwnerStats& stats) { return std::strcmp(stats.m_owner, owner) == 0; });
+
+        if (it == s_owners.end())
+        {
+            s_owners.push_back({ owner, 0, 0 });
+            it = s_owners.end() - 1;
+        }
+
+        it->m_size  = size_t(int64_t(it->m_size) + size);
+        it->m_count = uint32_t(int32_t(it->m_count) + count);
+    }
+
+    void GpuMemory::QueryDriverInfo()
+    {
+        /* Both extensions report kilobytes. */
+        constexpr size_t KB = 1024;
+
+        if (GLAD_GL_NVX_gpu_memory_info)
+        {
+            GLint dedicated = 0, total_available = 0, current_available = 0, evictions_count = 0, evicted = 0;
+            glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX,         &dedicated);
+            glGetIntegerv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX,   &total_available);
+            glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &current_available);
+            glGetIntegerv(GL_GPU_MEMORY_INFO_EVICTION_COUNT_NVX,           &evictions_count);
+            glGetIntegerv(GL_GPU_MEMORY_INFO_EVICTED_MEMORY_NVX,           &evicted);
+
+            s_driver_info = { "GL_NVX_gpu_memory_info", size_t(dedicated) * KB, size_t(total_available) * KB, size_t(current_available) * KB,
+                              size_t(evicted) * KB, uint32_t(evictions_count) };
+        }
+        else if (GLAD_GL_ATI_meminfo)
+        {
+            /* The total and the largest free block of the pool, then of the auxiliary memory. */
+            GLint texture_free[4] = {};
+            glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, texture_free);
+
+            s_driver_info = { "GL_ATI_meminfo", 0, 0, size_t(texture_free[0]) * KB, 0, 0 };
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+namespace RGL
+{
+    /*
+     * Accounting of the GPU memory the core classes allocate. Every glNamedBufferStorage() and glTextureStorage*()
+     * is followed by TrackBuffer() or TrackTexture() with the owner's tag - a string literal, as "StaticModel" - and
+     * every delete of a tracked name is preceded by Untrack*(). Tracking a name again replaces its entry. The sizes are
+     * queried from GL - for the textures of all their levels, as the driver reports them - so the calls take the name alone.
+     *
+     * The driver's view - GL_NVX_gpu_memory_info or GL_ATI_meminfo, when either is there - is queried by EndFrame()
+     * every DRIVER_INFO_INTERVAL frames. The Perf info overlay shows the totals and the top owners through RenderGui().
+     * The tracking is thread safe, but as the queries it needs the GL context current.
+     */
+    class GpuMemory
+    {
+    public:
+        static constexpr uint32_t DRIVER_INFO_INTERVAL = 60;
+        static constexpr uint32_t TOP_OWNERS_COUNT     = 8;
+
+        struct OwnerStats
+        {
+            const char* m_owner;
+            size_t      m_size;
+            uint32_t    m_count;
+        };
+
+        /* In bytes, 0 where the extension doesn't report the value. */
+        struct DriverInfo
+        {
+            const char* m_source;            /* The extension, nullptr if none. */
+            size_t      m_dedicated;
+            size_t      m_total_available;
+            size_t      m_current_available;
+            size_t      m_evicted;
+            uint32_t    m_evictions_count;
+        };
+
+        static void TrackBuffer   (GLuint name, const char* owner);
+        static void TrackTexture  (GLuint name, const char* owner);
+        static void UntrackBuffer (GLuint name);
+        static void UntrackTexture(GLuint name);
+
+        static size_t                  GetTotalSize();
+        static size_t                  GetBuffersSize();
+        static size_t                  GetTexturesSize();
+
+        /* The owners by their size, the biggest first. */
+        static std::vector<OwnerStats> GetOwners();
+
+        static const DriverInfo&       GetDriverInfo() { return s_driver_info; }
+
+        /* Refreshes the driver's view every DRIVER_INFO_INTERVAL frames. */
+        static void EndFrame();
+
+        /* The totals, the driver's view and the table of the top owners. */
+        static void RenderGui();
+
+        /* Bytes of the texture's storage, of all its levels, layers, faces and samples. */
+        static size_t GetTextureSize(GLuint name);
+
+    private:
+        enum class Kind : uint8_t { Buffer, Texture };
+
+        struct Entry
+        {
+            const char* m_owner;
+            size_t      m_size;
+        };
+
+        static uint64_t MakeKey(Kind kind, GLuint name) { return uint64_t(kind) << 32 | name; }
+
+        static void Track  (Kind kind, GLuint name, size_t size, const char* owner);
+        static void Untrack(Kind kind, GLuint name);
+        static void UpdateOwner(const char* owner, int64_t size, int32_t count);
+        static void QueryDriverInfo();
+
+        static std::mutex                          s_mutex;
+        static std::unordered_map<uint64_t, Entry> s_entries;
+        static std::vector<OwnerStats>             s_owners;
+        static size_t                              s_sizes[2];
+        static DriverInfo                          s_driver_info;
+        static uint32_t                            s_frame;
+    };
+}
@@ -1,14 +1,32 @@
 ﻿#include "gui.h"
 #include "gui/imgui_impl_opengl3.h"
+#include "gui/gui_renderer.h"
+
+#include "gl_state.h"
+#include "render_target_pool.h"
+#include "shader.h"
+#include "timer.h"
 
 #include <glm/vec2.hpp>
 #include <glm/common.hpp>
 #include <imgui_internal.h>
+#include <algorithm>
+#include <cstdio>
 #include <sstream>
 
 namespace RGL
 {
-    glm::vec2 GUI::m_window_size = glm::vec2(0.0f);
+    glm::vec2 GUI::m_window_size         = glm::vec2(0.0f);
+    bool      GUI::m_is_enabled          = true;
+    bool      GUI::m_is_rebuilt          = false;
+    glm::vec2 GUI::m_rebuilt_window_size = glm::vec2(0.0f);
+    float     GUI::m_update_rate         = 0.0f;
+    double    GUI::m_last_rebuild_time   = 0.0;
+
+    std::shared_ptr<RenderTarget> GUI::m_cache;
+    std::shared_ptr<Shader>       GUI::m_composite_shader;
+    GLuint                        GUI::m_composite_vao = 0;
+    GUI::Frame                    GUI::m_frame;
 
     GUI::~GUI()
     {
@@ -30,18 +48,194 @@ namespace RGL
         ImGui::GetIO().Fonts->AddFontDefault();
     }
 
-    void GUI::prepare()
+    void GUI::createDeviceObjects()
     {
+        /* Only the first call creates them. */
+        ImGui_ImplOpenGL3_NewFrame();
+    }
+
+    bool GUI::prepare()
+    {
+        const double time = Timer::getTime();
+
+        /* A zero time - nothing built yet, or the mode has changed. */
+        if (m_update_rate > 0.0f && m_last_rebuild_time > 0.0)
+        {
+            const bool is_resized   = m_rebuilt_window_size != m_window_size;
+            const bool has_input    = GImGui->InputEventsQueue.Size > 0;
+            const bool is_scheduled = time - m_last_rebuild_time >= 1.0 / m_update_rate;
+
+            /* The input is rebuilt right away, the GUI responds at the frame rate while it's used. */
+            if (!is_resized && !has_input && !is_scheduled)
+            {
+                m_is_rebuilt = false;
+                return false;
+            }
+        }
+
+        m_last_rebuild_time   = time;
+        m_rebuilt_window_size = m_window_size;
+        m_is_rebuilt          = true;
+
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
+
+        return true;
     }
 
     void GUI::render()
     {
-        glViewport(0, 0, GLsizei(m_window_size.x), GLsizei(m_window_size.y));
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        endFrame();
+        draw();
+    }
+
+    void GUI::endFrame()
+    {
+        m_frame.m_is_rebuilt  = m_is_rebuilt;
+        m_frame.m_is_retained = m_update_rate > 0.0f;
+        m_frame.m_window_size = m_window_size;
+
+        if (m_is_rebuilt)
+        {
+            ImGui::Render();
+            m_frame.m_draw_data = ImGui::GetDrawData();
+        }
+    }
+
+    void GUI::draw()
+    {
+        if (m_frame.m_is_retained)
+        {
+            renderRetained(m_frame);
+            return;
+        }
+
+        /* Left by the retained mode. */
+        m_cache.reset();
+
+        if (m_frame.m_is_rebuilt)
+        {
+            renderDrawData(m_frame);
+        }
+    }
+
+    void GUI::renderDrawData(const Frame& frame)
+    {
+        glViewport(0, 0, GLsizei(frame.m_window_size.x), GLsizei(frame.m_window_size.y));
+
+        if (!GUIRenderer::IsEnabled() || !GUIRenderer::Render(frame.m_draw_data))
+        {
+            ImGui_ImplOpenGL3_RenderDrawData(frame.m_draw_data);
+        }
+    }
+
+    void GUI::renderRetained(const Frame& frame)
+    {
+        if (!m_composite_shader)
+        {
+            m_composite_shader = std::make_shared<Shader>("src/core/shaders/gui_composite.vert", "src/core/shaders/gui_composite.frag");
+
+            if (!m_composite_shader->link())
+            {
+                fprintf(stderr, "GUI: the composite shader failed to link, the retained mode is off.\n");
+                m_composite_shader.reset();
+                m_update_rate = 0.0f;
+
+                if (frame.m_is_rebuilt)
+                {
+                    renderDrawData(frame);
+                }
+
+                return;
+            }
+
+            /* The fullscreen triangle is generated from gl_VertexID, GL needs a vertex array bound anyway. */
+            glCreateVertexArrays(1, &m_composite_vao);
+        }
+
+        GLint framebuffer = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+
+        if (frame.m_is_rebuilt)
+        {
+            const uint32_t width  = uint32_t(frame.m_window_size.x);
+            const uint32_t height = uint32_t(frame.m_window_size.y);
+
+            if (!m_cache || m_cache->GetDesc().m_width != width || m_cache->GetDesc().m_height != height)
+            {
+                m_cache.reset();
+                m_cache = RenderTargetPool::Acquire({ width, height, GL_RGBA8, GL_NONE });
+            }
+
+            /* ImGui's blending over the transparent black leaves the premultiplied colors and the coverage in the alpha. */
+            const float clear_color[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+            m_cache->Bind(0);
+            glClearNamedFramebufferfv(m_cache->GetFramebuffer(), GL_COLOR, 0, clear_color);
+
+            renderDrawData(frame);
+
+            GLState::BindFramebuffer(GL_FRAMEBUFFER, GLuint(framebuffer));
+        }
+
+        if (!m_cache)
+        {
+            return;
+        }
+
+        /* The premultiplied composite is the same as the direct rendering of the GUI. */
+        GLboolean blend      = glIsEnabled(GL_BLEND);
+        GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+        GLboolean cull_face  = glIsEnabled(GL_CULL_FACE);
+        GLint     blend_factors[4];
+
+        glGetIntegerv(GL_BLEND_SRC_RGB,   &blend_factors[0]);
+        glGetIntegerv(GL_BLEND_DST_RGB,   &blend_factors[1]);
+        glGetIntegerv(GL_BLEND_SRC_ALPHA, &blend_factors[2]);
+        glGetIntegerv(GL_BLEND_DST_ALPHA, &blend_factors[3]);
+
+        glViewport(0, 0, GLsizei(frame.m_window_size.x), GLsizei(frame.m_window_size.y));
+        glEnable   (GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        glDisable  (GL_DEPTH_TEST);
+        glDisable  (GL_CULL_FACE);
+
+        m_composite_shader->bind();
+        m_cache->BindColor(0);
+        GLState::BindVertexArray(m_composite_vao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glBlendFuncSeparate(blend_factors[0], blend_factors[1], blend_factors[2], blend_factors[3]);
+        blend      ? glEnable(GL_BLEND)      : glDisable(GL_BLEND);
+        depth_test ? glEnable(GL_DEPTH_TEST) : glDisable(GL_DEPTH_TEST);
+        cull_face  ? glEnable(GL_CULL_FACE)  : glDisable(GL_CULL_FACE);
+
+        /* The capabilities and the blend factors went past the cache. */
+        GLState::Invalidate();
+    }
+
+    void GUI::setUpdateRate(float rate)
+    {
+        m_update_rate = std::max(rate, 0.0f);
+
+        /* Rebuilt on the next frame, the cache may be stale or gone. The draws drop the cache when it's off. */
+        m_last_rebuild_time = 0.0;
+    }
+
+    void GUI::release()
+    {
+        m_frame = {};
+
+        m_cache.reset();
+        m_composite_shader.reset();
+
+        if (m_composite_vao != 0)
+        {
+            glDeleteVertexArrays(1, &m_composite_vao);
+            GLState::OnVertexArrayDeleted(m_composite_vao);
+            m_composite_vao = 0;
+        }
     }
 
     void GUI::updateWindowSize(float width, float height)
@@ -13,6 +13,9 @@
 
 namespace RGL
 {
+    class RenderTarget;
+    class Shader;
+
     class GUI
     {
     public:
@@ -20,10 +23,42 @@ namespace RGL
 
         ~GUI();
         static void init(GLFWwindow * window);
-        static void prepare();
+
+        /* The GL objects and the font atlas now rather than in the first prepare(), which then makes no GL calls. After the fonts are added. */
+        static void createDeviceObjects();
+
+        /* Starts the ImGui frame. False in the retained mode when the last GUI is reused - nothing is to be built then. */
+        static bool prepare();
+
+        /* endFrame() and draw(). */
         static void render();
+
+        /* Ends the ImGui frame. ImGui's draw data stays as it is until the next prepare(). */
+        static void endFrame();
+
+        /*
+         * Renders the GUI of the last endFrame() to the bound framebuffer. On the thread with the GL context, which
+         * may be a different one (CoreApp's render thread mode) - it reads nothing prepare() and endFrame() change.
+         */
+        static void draw();
+
         static void updateWindowSize(float width, float height);
 
+        /* Disabled, CoreApp neither builds nor renders the GUI. */
+        static void setEnabled(bool enable) { m_is_enabled = enable; }
+        static bool isEnabled()             { return m_is_enabled; }
+
+        /*
+         * Retained mode - the GUI is rebuilt at most 'rate' times per second or when there's new input, to a cached
+         * texture, the frames in between composite the texture. 0 (the default) rebuilds it every frame.
+         * ImGui's Framerate counts the rebuilds then, not the frames.
+         */
+        static void  setUpdateRate(float rate);
+        static float getUpdateRate() { return m_update_rate; }
+
+        /* Releases the cached GUI texture and the composite shader. */
+        static void release();
+
         /* HUD rendering */
         static void beginHUD();
         static void endHUD();
@@ -36,6 +71,28 @@ namespace RGL
         static void rectFilled(const glm::vec2 & from, const glm::vec2 & to, const glm::vec4 & color = glm::vec4(1.0f), float rounding = 0.0f, uint32_t roundingCornersFlags = ImDrawCornerFlags_All);
 
     private:
+        /* What draw() needs of the built frame. */
+        struct Frame
+        {
+            ImDrawData* m_draw_data   = nullptr;
+            glm::vec2   m_window_size = glm::vec2(0.0f);
+            bool        m_is_rebuilt  = false;
+            bool        m_is_retained = false;
+        };
+
+        static void renderDrawData(const Frame& frame);
+        static void renderRetained(const Frame& frame);
+
         static glm::vec2 m_window_size;
+        static bool      m_is_enabled;
+        static bool      m_is_rebuilt;
+        static glm::vec2 m_rebuilt_window_size;
+        static float     m_update_rate;
+        static double    m_last_rebuild_time;
+
+        static std::shared_ptr<RenderTarget> m_cache;
+        static std::shared_ptr<Shader>       m_composite_shader;
+        static GLuint                        m_composite_vao;
+        static Frame                         m_frame;
     };
 }
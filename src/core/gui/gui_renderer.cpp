@@ -0,0 +1,345 @@
+#include "gui_renderer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "core_shared.h"
+#include "gl_state.h"
+#include "shader.h"
+
+namespace RGL
+{
+    namespace
+    {
+        /* As in glMultiDrawElementsIndirect. */
+        struct DrawElementsCommand
+        {
+            GLuint m_count;
+            GLuint m_instance_count;
+            GLuint m_first_index;
+            GLint  m_base_vertex;
+            GLuint m_base_instance; /* The command's index, for its clip rectangle. */
+        };
+
+        constexpr GLsizeiptr INITIAL_REGION_SIZE = 1 << 20;
+        constexpr GLsizeiptr ALIGNMENT           = 256;
+        constexpr GLenum     INDEX_TYPE          = sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+        /* The state the GUI changes, restored after it as the stock backend does - the demos set some of it just once. */
+        struct SavedState
+        {
+            GLint     m_program;
+            GLint     m_vao;
+            GLint     m_texture;
+            GLint     m_sampler;
+            GLint     m_active_texture;
+            GLint     m_polygon_mode[2];
+            GLint     m_blend_src_rgb, m_blend_dst_rgb, m_blend_src_alpha, m_blend_dst_alpha;
+            GLint     m_blend_equation_rgb, m_blend_equation_alpha;
+            GLboolean m_blend, m_cull_face, m_depth_test, m_stencil_test, m_scissor_test, m_primitive_restart;
+
+            void Save()
+            {
+                glGetIntegerv(GL_ACTIVE_TEXTURE, &m_active_texture);
+                glActiveTexture(GL_TEXTURE0);
+
+                glGetIntegerv(GL_CURRENT_PROGRAM,         &m_program);
+                glGetIntegerv(GL_VERTEX_ARRAY_BINDING,    &m_vao);
+                glGetIntegerv(GL_TEXTURE_BINDING_2D,      &m_texture);
+                glGetIntegerv(GL_SAMPLER_BINDING,         &m_sampler);
+                glGetIntegerv(GL_POLYGON_MODE,            m_polygon_mode);
+                glGetIntegerv(GL_BLEND_SRC_RGB,           &m_blend_src_rgb);
+                glGetIntegerv(GL_BLEND_DST_RGB,           &m_blend_dst_rgb);
+                glGetIntegerv(GL_BLEND_SRC_ALPHA,         &m_blend_src_alpha);
+                glGetIntegerv(GL_BLEND_DST_ALPHA,         &m_blend_dst_alpha);
+                glGetIntegerv(GL_BLEND_EQUATION_RGB,      &m_blend_equation_rgb);
+                glGetIntegerv(GL_BLEND_EQUATION_ALPHA,    &m_blend_equation_alpha);
+
+                m_blend             = glIsEnabled(GL_BLEND);
+                m_cull_face         = glIsEnabled(GL_CULL_FACE);
+                m_depth_test        = glIsEnabled(GL_DEPTH_TEST);
+                m_stencil_test      = glIsEnabled(GL_STENCIL_TEST);
+                m_scissor_test      = glIsEnabled(GL_SCISSOR_TEST);
+                m_primitive_restart = glIsEnabled(GL_PRIMITIVE_RESTART);
+            }
+
+            void Restore() const
+            {
+                auto set_capability = [](GLenum capability, GLboolean enable) { enable ? glEnable(capability) : glDisable(capability); };
+
+                glUseProgram           (m_program);
+                glBindVertexArray      (m_vao);
+                glBindTexture          (GL_TEXTURE_2D, m_texture);
+                glBindSampler          (0, m_sampler);
+                glActiveTexture        (m_active_texture);
+                glPolygonMode          (GL_FRONT_AND_BACK, GLenum(m_polygon_mode[0]));
+                glBlendEquationSeparate(m_blend_equation_rgb, m_blend_equation_alpha);
+                glBlendFuncSeparate    (m_blend_src_rgb, m_blend_dst_rgb, m_blend_src_alpha, m_blend_dst_alpha);
+
+                set_capability(GL_BLEND,             m_blend);
+                set_capability(GL_CULL_FACE,         m_cull_face);
+                set_capability(GL_DEPTH_TEST,        m_depth_test);
+                set_capability(GL_STENCIL_TEST,      m_stencil_test);
+                set_capability(GL_SCISSOR_TEST,      m_scissor_test);
+                set_capability(GL_PRIMITIVE_RESTART, m_primitive_restart);
+
+                for (GLenum i = 0; i < 4; ++i)
+                {
+                    glDisable(GL_CLIP_DISTANCE0 + i);
+                }
+
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            }
+        };
+    }
+
+    bool                        GUIRenderer::s_is_enabled = false;
+    std::shared_ptr<Shader>     GUIRenderer::s_shader;
+    std::unique_ptr<RingBuffer> GUIRenderer::s_ring_buffer;
+    GLuint                      GUIRenderer::s_vao        = 0;
+
+    bool GUIRenderer::Create()
+    {
+        s_shader = std::make_shared<Shader>("src/core/shaders/gui.vert", "src/core/shaders/gui.frag");
+
+        if (!s_shader->link())
+        {
+            fprintf(stderr, "GUIRenderer: the shader failed to link.\n");
+            s_shader.reset();
+
+            return false;
+        }
+
+        s_ring_buffer = std::make_unique<RingBuffer>();
+
+        if (!s_ring_buffer->Create(INITIAL_REGION_SIZE))
+        {
+            s_ring_buffer.reset();
+            s_shader.reset();
+
+            return false;
+        }
+
+        /* The vertex buffer's offset changes every frame, the format stays. */
+        glCreateVertexArrays(1, &s_vao);
+
+        glEnableVertexArrayAttrib (s_vao, 0);
+        glVertexArrayAttribFormat (s_vao, 0, 2, GL_FLOAT,         GL_FALSE, offsetof(ImDrawVert, pos));
+        glVertexArrayAttribBinding(s_vao, 0, 0);
+
+        glEnableVertexArrayAttrib (s_vao, 1);
+        glVertexArrayAttribFormat (s_vao, 1, 2, GL_FLOAT,         GL_FALSE, offsetof(ImDrawVert, uv));
+        glVertexArrayAttribBinding(s_vao, 1, 0);
+
+        glEnableVertexArrayAttrib (s_vao, 2);
+        glVertexArrayAttribFormat (s_vao, 2, 4, GL_UNSIGNED_BYTE, GL_TRUE,  offsetof(ImDrawVert, col));
+        glVertexArrayAttribBinding(s_vao, 2, 0);
+
+        glVertexArrayElementBuffer(s_vao, s_ring_buffer->GetBuffer());
+
+        return true;
+    }
+
+    void GUIRenderer::Release()
+    {
+        if (s_vao != 0)
+        {
+            glDeleteVertexArrays(1, &s_vao);
+            GLState::OnVertexArrayDeleted(s_vao);
+            s_vao = 0;
+        }
+
+        s_ring_buffer.reset();
+        s_shader.reset();
+    }
+
+    void GUIRenderer::SetupRenderState(ImDrawData* draw_data)
+    {
+        glEnable             (GL_BLEND);
+        glBlendEquation      (GL_FUNC_ADD);
+        glBlendFuncSeparate  (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        glDisable            (GL_CULL_FACE);
+        glDisable            (GL_DEPTH_TEST);
+        glDisable            (GL_STENCIL_TEST);
+        glDisable            (GL_SCISSOR_TEST);
+        glDisable            (GL_PRIMITIVE_RESTART);
+        glPolygonMode        (GL_FRONT_AND_BACK, GL_FILL);
+
+        for (GLenum i = 0; i < 4; ++i)
+        {
+            glEnable(GL_CLIP_DISTANCE0 + i);
+        }
+
+        const float left   = draw_data->DisplayPos.x;
+        const float top    = draw_data->DisplayPos.y;
+        const float right  = left + draw_data->DisplaySize.x;
+        const float bottom = top  + draw_data->DisplaySize.y;
+
+        s_shader->bind();
+        s_shader->setUniform("u_projection", glm::ortho(left, right, bottom, top));
+
+        glBindVertexArray(s_vao);
+        glBindSampler    (0, 0);
+        glBindBuffer     (GL_DRAW_INDIRECT_BUFFER, s_ring_buffer->GetBuffer());
+    }
+
+    bool GUIRenderer::Render(ImDrawData* draw_data)
+    {
+        if (!draw_data)
+        {
+            return false;
+        }
+
+        /* Minimized. */
+        if (draw_data->DisplaySize.x * draw_data->FramebufferScale.x <= 0.0f || draw_data->DisplaySize.y * draw_data->FramebufferScale.y <= 0.0f)
+        {
+            return true;
+        }
+
+        if (!s_shader && !Create())
+        {
+            /* Not retried every frame, the stock backend takes over. */
+            s_is_enabled = false;
+            return false;
+        }
+
+        int commands_count = 0;
+
+        for (int n = 0; n < draw_data->CmdListsCount; ++n)
+        {
+            commands_count += draw_data->CmdLists[n]->CmdBuffer.Size;
+        }
+
+        if (draw_data->TotalVtxCount == 0 || commands_count == 0)
+        {
+            return true;
+        }
+
+        const GLsizeiptr vertices_size   = GLsizeiptr(draw_data->TotalVtxCount) * sizeof(ImDrawVert);
+        const GLsizeiptr indices_size    = GLsizeiptr(draw_data->TotalIdxCount) * sizeof(ImDrawIdx);
+        const GLsizeiptr commands_size   = GLsizeiptr(commands_count) * sizeof(DrawElementsCommand);
+        const GLsizeiptr clip_rects_size = GLsizeiptr(commands_count) * sizeof(glm::vec4);
+        const GLsizeiptr frame_size      = vertices_size + indices_size + commands_size + clip_rects_size + 4 * ALIGNMENT;
+
+        if (frame_size > s_ring_buffer->GetRegionSize())
+        {
+            /* Still in use by the GPU is fine, GL deletes the old storage when it's done with it. */
+            if (!s_ring_buffer->Create(frame_size * 2))
+            {
+                Release();
+                s_is_enabled = false;
+
+                return false;
+            }
+
+            glVertexArrayElementBuffer(s_vao, s_ring_buffer->GetBuffer());
+        }
+
+        s_ring_buffer->BeginFrame();
+
+        const RingBuffer::Allocation vertices   = s_ring_buffer->Allocate(vertices_size,   ALIGNMENT);
+        const RingBuffer::Allocation indices    = s_ring_buffer->Allocate(indices_size,    ALIGNMENT);
+        const RingBuffer::Allocation commands   = s_ring_buffer->Allocate(commands_size,   ALIGNMENT);
+        const RingBuffer::Allocation clip_rects = s_ring_buffer->Allocate(clip_rects_size);
+
+        /* The buffer is write-only mapped, the commands and the rectangles are written once and never read back. */
+        auto*        vertex_data    = static_cast<uint8_t*>(vertices.m_data);
+        auto*        index_data     = static_cast<uint8_t*>(indices.m_data);
+        auto*        command_data   = static_cast<DrawElementsCommand*>(commands.m_data);
+        auto*        clip_rect_data = static_cast<glm::vec4*>(clip_rects.m_data);
+        const GLuint first_index    = GLuint(indices.m_offset / GLintptr(sizeof(ImDrawIdx)));
+
+        SavedState saved_state;
+        saved_state.Save();
+
+        SetupRenderState(draw_data);
+
+        glVertexArrayVertexBuffer(s_vao, 0, s_ring_buffer->GetBuffer(), vertices.m_offset, sizeof(ImDrawVert));
+        s_ring_buffer->BindRange(GL_SHADER_STORAGE_BUFFER, GUI_CLIP_RECTS_SSBO_BINDING_INDEX, clip_rects);
+
+        /* The pending run of the commands [run_begin, draws_count) with the same texture. */
+        GLuint run_texture = 0;
+        int    run_begin   = 0;
+        int    draws_count = 0;
+
+        auto flush = [&]()
+        {
+            if (draws_count > run_begin)
+            {
+                glBindTexture(GL_TEXTURE_2D, run_texture);
+                glMultiDrawElementsIndirect(GL_TRIANGLES, INDEX_TYPE, (const void*)(commands.m_offset + run_begin * GLintptr(sizeof(DrawElementsCommand))),
+                                            draws_count - run_begin, 0);
+            }
+
+            run_begin = draws_count;
+        };
+
+        GLint  vertex_offset = 0;
+        GLuint index_offset  = 0;
+
+        for (int n = 0; n < draw_data->CmdListsCount; ++n)
+        {
+            const ImDrawList* cmd_list = draw_data->CmdLists[n];
+
+            std::memcpy(vertex_data + vertex_offset * sizeof(ImDrawVert), cmd_list->VtxBuffer.Data, cmd_list->VtxBuffer.Size * sizeof(ImDrawVert));
+            std::memcpy(index_data  + index_offset  * sizeof(ImDrawIdx),  cmd_list->IdxBuffer.Data, cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx));
+
+            for (const ImDrawCmd& cmd : cmd_list->CmdBuffer)
+            {
+                if (cmd.UserCallback != nullptr)
+                {
+                    /* The callbacks see the commands before them drawn. */
+                    flush();
+
+                    if (cmd.UserCallback == ImDrawCallback_ResetRenderState)
+                    {
+                        SetupRenderState(draw_data);
+                    }
+                    else
+                    {
+                        cmd.UserCallback(cmd_list, &cmd);
+                    }
+
+                    continue;
+                }
+
+                if (cmd.ClipRect.z <= cmd.ClipRect.x || cmd.ClipRect.w <= cmd.ClipRect.y || cmd.ElemCount == 0)
+                {
+                    continue;
+                }
+
+                const GLuint texture = GLuint(intptr_t(cmd.GetTexID()));
+
+                if (texture != run_texture)
+                {
+                    flush();
+                    run_texture = texture;
+                }
+
+                command_data[draws_count]   = { cmd.ElemCount, 1, first_index + index_offset + cmd.IdxOffset, vertex_offset + GLint(cmd.VtxOffset), GLuint(draws_count) };
+                clip_rect_data[draws_count] = glm::vec4(cmd.ClipRect.x, cmd.ClipRect.y, cmd.ClipRect.z, cmd.ClipRect.w);
+
+                draws_count++;
+            }
+
+            vertex_offset += cmd_list->VtxBuffer.Size;
+            index_offset  += cmd_list->IdxBuffer.Size;
+        }
+
+        flush();
+
+        s_ring_buffer->EndFrame();
+
+        saved_state.Restore();
+
+        /* Everything above went past the cache. */
+        GLState::Invalidate();
+
+        return true;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <memory>
+
+#include <glad/glad.h>
+#include <imgui.h>
+
+#include "ring_buffer.h"
+
+namespace RGL
+{
+    class Shader;
+
+    /*
+     * Batched replacement of ImGui_ImplOpenGL3_RenderDrawData. The vertices, the indices, the clip rectangles and the
+     * indirect commands of all the draw lists are copied into a persistently mapped RingBuffer at once, and the commands
+     * go to glMultiDrawElementsIndirect - one call per run of the commands with the same texture, usually one per frame
+     * as most of them sample the font atlas. The clip rectangles are the clip distances of shaders/gui.vert instead of
+     * the scissor, so they don't split the runs; the user callbacks do.
+     *
+     * Disabled by default, CoreApp enables it with --batched-gui. GUI::render() falls back to the stock backend when
+     * it's disabled or Render() fails. Render thread only.
+     */
+    class GUIRenderer
+    {
+    public:
+        static void SetEnabled(bool enable) { s_is_enabled = enable; }
+        static bool IsEnabled()             { return s_is_enabled; }
+
+        /* Renders to the bound framebuffer, the viewport has to be set. False if nothing was rendered. */
+        static bool Render(ImDrawData* draw_data);
+
+        /* Releases the shader and the buffers. */
+        static void Release();
+
+    private:
+        static bool Create();
+        static void SetupRenderState(ImDrawData* draw_data);
+
+        static bool                        s_is_enabled;
+        static std::shared_ptr<Shader>     s_shader;
+        static std::unique_ptr<RingBuffer> s_ring_buffer;
+        static GLuint                      s_vao;
+    };
+}
@@ -0,0 +1,623 @@
+#include "image_based_lighting.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "core_shared.h"
+#include "filesystem.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+#include "mapped_file.h"
+#include "shader.h"
+#include "texture.h"
+#include "texture_cache.h"
+#include "trace.h"
+#include "window.h"
+
+namespace RGL
+{
+    namespace
+    {
+        /* DDS with the DX10 extension header, the only kind the cache writes. */
+        constexpr uint32_t DDS_MAGIC             = 0x20534444; /* "DDS " */
+        constexpr uint32_t DDS_FOURCC_DX10       = 0x30315844; /* "DX10" */
+        constexpr uint32_t DDS_FLAGS             = 0x00021007; /* CAPS | HEIGHT | WIDTH | PIXELFORMAT | MIPMAPCOUNT */
+        constexpr uint32_t DDS_PIXEL_FORMAT_CC   = 0x00000004; /* DDPF_FOURCC */
+        constexpr uint32_t DDS_CAPS              = 0x00401008; /* TEXTURE | COMPLEX | MIPMAP */
+        constexpr uint32_t DDS_CAPS2_CUBEMAP     = 0x0000FE00; /* CUBEMAP | all the faces */
+        constexpr uint32_t DXGI_RGBA16_FLOAT     = 10;
+        constexpr uint32_t DXGI_RG16_FLOAT       = 34;
+        constexpr uint32_t DX10_TEXTURE2D        = 3;
+        constexpr uint32_t DX10_MISC_TEXTURECUBE = 0x4;
+
+        struct DdsHeader
+        {
+            uint32_t m_magic;
+            uint32_t m_size;
+            uint32_t m_flags;
+            uint32_t m_height;
+            uint32_t m_width;
+            uint32_t m_pitch_or_linear_size;
+            uint32_t m_depth;
+            uint32_t m_mip_map_count;
+            uint32_t m_reserved1[11];
+            uint32_t m_pixel_format_size;
+            uint32_t m_pixel_format_flags;
+            uint32_t m_pixel_format_four_cc;
+            uint32_t m_pixel_format_bits[5];
+            uint32_t m_caps;
+            uint32_t m_caps2;
+            uint32_t m_caps3;
+            uint32_t m_caps4;
+            uint32_t m_reserved2;
+
+            /* DDS_HEADER_DXT10 */
+            uint32_t m_dxgi_format;
+            uint32_t m_resource_dimension;
+            uint32_t m_misc_flag;
+            uint32_t m_array_size;
+            uint32_t m_misc_flags2;
+        };
+
+        static_assert(sizeof(DdsHeader) == 4 + 124 + 20);
+
+        /* A texture as it's stored in the cache: half floats, 'faces' layers of 'levels' levels. */
+        struct CachedTexture
+        {
+            GLuint   m_name;
+            uint32_t m_size;
+            uint32_t m_levels;
+            uint32_t m_faces;
+            uint32_t m_dxgi_format;
+            GLenum   m_format;
+            uint32_t m_texel_size;
+        };
+
+        size_t getLevelSize(const CachedTexture& texture, uint32_t level)
+        {
+            const size_t size = std::max(texture.m_size >> level, 1u);
+            return size * size * texture.m_texel_size;
+        }
+
+        DdsHeader makeDdsHeader(const CachedTexture& texture)
+        {
+            DdsHeader header = {};
+
+            header.m_magic                 = DDS_MAGIC;
+            header.m_size                  = 124;
+            header.m_flags                 = DDS_FLAGS;
+            header.m_height                = texture.m_size;
+            header.m_width                 = texture.m_size;
+            header.m_depth                 = 1;
+            header.m_mip_map_count         = texture.m_levels;
+            header.m_pixel_format_size     = 32;
+            header.m_pixel_format_flags    = DDS_PIXEL_FORMAT_CC;
+            header.m_pixel_format_four_cc  = DDS_FOURCC_DX10;
+            header.m_caps                  = DDS_CAPS;
+            header.m_caps2                 = texture.m_faces == 6 ? DDS_CAPS2_CUBEMAP : 0;
+            header.m_dxgi_format           = texture.m_dxgi_format;
+            header.m_resource_dimension    = DX10_TEXTURE2D;
+            header.m_misc_flag             = texture.m_faces == 6 ? DX10_MISC_TEXTURECUBE : 0;
+            header.m_array_size            = 1;
+
+            return header;
+        }
+
+        /* Returns false if the file is missing or doesn't match the texture exactly. */
+        bool readDds(const std::filesystem::path& filepath, const CachedTexture& texture)
+        {
+            MappedFile file(filepath);
+
+            if (!file.IsOpen() || file.GetSize() < sizeof(DdsHeader))
+            {
+                return false;
+            }
+
+            const auto expected_header = makeDdsHeader(texture);
+            const auto header          = reinterpret_cast<const DdsHeader*>(file.GetData());
+
+            size_t data_size = 0;
+
+            for (uint32_t level = 0; level < texture.m_levels; ++level)
+            {
+                data_size += getLevelSize(texture, level) * texture.m_faces;
+            }
+
+            /* The cache only reads back what it wrote, anything else is a stale or a corrupted file. */
+            if (memcmp(header, &expected_header, sizeof(DdsHeader)) != 0 || file.GetSize() != sizeof(DdsHeader) + data_size)
+            {
+                fprintf(stderr, "ImageBasedLighting: ignoring the invalid cache file %s\n", filepath.string().c_str());
+                return false;
+            }
+
+            /* The faces follow each other, each with all its levels. */
+            const uint8_t* data = file.GetData() + sizeof(DdsHeader);
+
+            for (uint32_t face = 0; face < texture.m_faces; ++face)
+            {
+                for (uint32_t level = 0; level < texture.m_levels; ++level)
+                {
+                    const uint32_t size = std::max(texture.m_size >> level, 1u);
+
+                    if (texture.m_faces == 6)
+                    {
+                        glTextureSubImage3D(texture.m_name, level, 0, 0, face, size, size, 1, texture.m_format, GL_HALF_FLOAT, data);
+                    }
+                    else
+                    {
+                        glTextureSubImage2D(texture.m_name, level, 0, 0, size, size, texture.m_format, GL_HALF_FLOAT, data);
+                    }
+
+                    data += getLevelSize(texture, level);
+                }
+            }
+
+            return true;
+        }
+
+        void writeDds(const std::filesystem::path& filepath, const CachedTexture& texture)
+        {
+            /* glGetTextureImage() returns all the faces of a cubemap level at once. */
+            std::vector<std::vector<uint8_t>> levels(texture.m_levels);
+
+            for (uint32_t level = 0; level < texture.m_levels; ++level)
+            {
+                levels[level].resize(getLevelSize(texture, level) * texture.m_faces);
+                glGetTextureImage(texture.m_name, level, texture.m_format, GL_HALF_FLOAT, GLsizei(levels[level].size()), levels[level].data());
+            }
+
+            std::error_code ec;
+            std::filesystem::create_directories(filepath.parent_path(), ec);
+
+            /* Written next to the final file and renamed, an interrupted write never leaves a truncated cache file behind. */
+            auto tmp_filepath = filepath;
+            tmp_filepath += ".tmp";
+
+            {
+                std::ofstream file(tmp_filepath, std::ios::binary);
+
+                if (!file)
+                {
+                    fprintf(stderr, "ImageBasedLighting: could not write the cache file %s\n", filepath.string().c_str());
+                    return;
+                }
+
+                const auto header = makeDdsHeader(texture);
+                file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+                for (uint32_t face = 0; face < texture.m_faces; ++face)
+                {
+                    for (uint32_t level = 0; level < texture.m_levels; ++level)
+                    {
+                        const size_t face_size = getLevelSize(texture, level);
+                        file.write(reinterpret_cast<const char*>(levels[level].data() + face * face_size), face_size);
+                    }
+                }
+
+                if (!file)
+                {
+                    fprintf(stderr, "ImageBasedLighting: could not write the cache file %s\n", filepath.string().c_str());
+                    file.close();
+                    std::filesystem::remove(tmp_filepath, ec);
+
+                    return;
+                }
+            }
+
+            std::filesystem::rename(tmp_filepath, filepath, ec);
+        }
+
+        /* FNV-1a, the same as the shader binary cache. */
+        void hashBytes(uint64_t& hash, const void* data, size_t size)
+        {
+            auto bytes = static_cast<const uint8_t*>(data);
+
+            for (size_t i = 0; i < size; ++i)
+            {
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            }
+        }
+
+        std::filesystem::path getCachePath(uint64_t hash, const char* name)
+        {
+            char filename[64];
+            snprintf(filename, sizeof(filename), "%016llx_%s.dds", (unsigned long long)hash, name);
+
+            return FileSystem::getRootPath() / "ibl_cache" / filename;
+        }
+
+        GLuint createCubemap(GLenum internal_format, uint32_t size, uint32_t levels)
+        {
+            GLuint name = 0;
+            glCreateTextures  (GL_TEXTURE_CUBE_MAP, 1, &name);
+            glTextureStorage2D(name, levels, internal_format, size, size);
+            GpuMemory::TrackTexture(name, "ImageBasedLighting");
+
+            glTextureParameteri(name, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTextureParameteri(name, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+            glTextureParameteri(name, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+            glTextureParameteri(name, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+            glTextureParameteri(name, GL_TEXTURE_WRAP_R,     GL_CLAMP_TO_EDGE);
+
+            return name;
+        }
+
+        uint32_t getLevelsCount(uint32_t size)
+        {
+            return uint32_t(std::floor(std::log2(float(size)))) + 1;
+        }
+    }
+
+    bool ImageBasedLighting::s_is_cache_enabled = true;
+
+    ImageBasedLighting::~ImageBasedLighting()
+    {
+        Release();
+    }
+
+    bool ImageBasedLighting::Create(const Settings& settings)
+    {
+        RGL_TRACE_ZONE("ImageBasedLighting::Create");
+
+        Release();
+
+        m_settings = settings;
+
+        const std::string dir = "src/core/shaders/ibl/";
+
+        /* The layered vertex shader writes gl_Layer, the faces are instances of a single draw. */
+        m_is_layered_rendering_supported = GLAD_GL_ARB_shader_viewport_layer_array;
+
+        const std::string cubemap_vertex_shader = m_is_layered_rendering_supported ? "cubemap_layered.vert" : "cubemap.vert";
+
+        m_equirectangular_to_cubemap_shader = std::make_shared<Shader>(dir + cubemap_vertex_shader, dir + "equirectangular_to_cubemap.frag");
+        m_prefilter_cubemap_shader          = std::make_shared<Shader>(dir + "prefilter_cubemap.comp");
+        m_precompute_brdf_shader            = std::make_shared<Shader>(dir + "fullscreen.vert", dir + "precompute_brdf.frag");
+        m_sh_projection_shader              = std::make_shared<Shader>(dir + "sh_projection.comp");
+
+        /* Compiled in parallel, if the driver supports it. */
+        for (auto& shader : { m_equirectangular_to_cubemap_shader, m_prefilter_cubemap_shader, m_precompute_brdf_shader, m_sh_projection_shader })
+        {
+            shader->linkAsync();
+        }
+
+        for (auto& shader : { m_equirectangular_to_cubemap_shader, m_prefilter_cubemap_shader, m_precompute_brdf_shader, m_sh_projection_shader })
+        {
+            if (!shader->link())
+            {
+                fprintf(stderr, "ImageBasedLighting: the shaders failed to link.\n");
+                return false;
+            }
+        }
+
+        /* The prefiltered map stops at 2x2, as the demos always did - its LODs are roughness * (levels - 1). */
+        m_environment_levels_count = getLevelsCount(m_settings.m_environment_map_size);
+        m_prefiltered_levels_count = std::max(getLevelsCount(m_settings.m_prefiltered_map_size) - 1, 1u);
+
+        m_environment_map_name = createCubemap(GL_RGB16F, m_settings.m_environment_map_size, m_environment_levels_count);
+        m_prefiltered_map_name = createCubemap(GL_RGBA16F, m_settings.m_prefiltered_map_size, m_prefiltered_levels_count); /* RGB can't be an image. */
+
+        glCreateBuffers     (1, &m_irradiance_sh_buffer_name);
+        glNamedBufferStorage(m_irradiance_sh_buffer_name, sizeof(IrradianceSH), nullptr, 0 /*flags*/);
+        GpuMemory::TrackBuffer(m_irradiance_sh_buffer_name, "ImageBasedLighting");
+
+        glCreateTextures   (GL_TEXTURE_2D, 1, &m_brdf_lut_name);
+        glTextureStorage2D (m_brdf_lut_name, 1, GL_RG16F, m_settings.m_brdf_lut_size, m_settings.m_brdf_lut_size);
+        glTextureParameteri(m_brdf_lut_name, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(m_brdf_lut_name, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(m_brdf_lut_name, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+        glTextureParameteri(m_brdf_lut_name, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+        GpuMemory::TrackTexture(m_brdf_lut_name, "ImageBasedLighting");
+
+        /* No depth attachment - the cube is seen from the inside, nothing overlaps. */
+        glCreateFramebuffers(1, &m_fbo_name);
+
+        static constexpr float cube_positions[] = {
+            -1.0f, -1.0f, -1.0f,   1.0f,  1.0f, -1.0f,   1.0f, -1.0f, -1.0f,
+             1.0f,  1.0f, -1.0f,  -1.0f, -1.0f, -1.0f,  -1.0f,  1.0f, -1.0f,
+            -1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f,   1.0f,  1.0f,  1.0f,
+             1.0f,  1.0f,  1.0f,  -1.0f,  1.0f,  1.0f,  -1.0f, -1.0f,  1.0f,
+            -1.0f,  1.0f,  1.0f,  -1.0f,  1.0f, -1.0f,  -1.0f, -1.0f, -1.0f,
+            -1.0f, -1.0f, -1.0f,  -1.0f, -1.0f,  1.0f,  -1.0f,  1.0f,  1.0f,
+             1.0f,  1.0f,  1.0f,   1.0f, -1.0f, -1.0f,   1.0f,  1.0f, -1.0f,
+             1.0f, -1.0f, -1.0f,   1.0f,  1.0f,  1.0f,   1.0f, -1.0f,  1.0f,
+            -1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,   1.0f, -1.0f,  1.0f,
+             1.0f, -1.0f,  1.0f,  -1.0f, -1.0f,  1.0f,  -1.0f, -1.0f, -1.0f,
+            -1.0f,  1.0f, -1.0f,   1.0f,  1.0f,  1.0f,   1.0f,  1.0f, -1.0f,
+             1.0f,  1.0f,  1.0f,  -1.0f,  1.0f, -1.0f,  -1.0f,  1.0f,  1.0f,
+        };
+
+        glCreateBuffers     (1, &m_cube_vbo);
+        glNamedBufferStorage(m_cube_vbo, sizeof(cube_positions), cube_positions, 0 /*flags*/);
+        GpuMemory::TrackBuffer(m_cube_vbo, "ImageBasedLighting");
+
+        glCreateVertexArrays      (1, &m_cube_vao);
+        glEnableVertexArrayAttrib (m_cube_vao, 0 /*index*/);
+        glVertexArrayAttribFormat (m_cube_vao, 0 /*index*/, 3 /*size*/, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/);
+        glVertexArrayAttribBinding(m_cube_vao, 0 /*index*/, 0 /*bindingindex*/);
+        glVertexArrayVertexBuffer (m_cube_vao, 0 /*bindingindex*/, m_cube_vbo, 0 /*offset*/, 3 * sizeof(float) /*stride*/);
+
+        glCreateVertexArrays(1, &m_empty_vao);
+
+        /* The LUT depends on nothing but its size. */
+        uint64_t hash = 14695981039346656037ull;
+        hashBytes(hash, &CACHE_VERSION,             sizeof(CACHE_VERSION));
+        hashBytes(hash, &m_settings.m_brdf_lut_size, sizeof(m_settings.m_brdf_lut_size));
+
+        const CachedTexture brdf_lut     = { m_brdf_lut_name, m_settings.m_brdf_lut_size, 1, 1, DXGI_RG16_FLOAT, GL_RG, 4 };
+        const auto          lut_filepath = getCachePath(hash, "brdf_lut");
+
+        if (!s_is_cache_enabled || !readDds(lut_filepath, brdf_lut))
+        {
+            RenderBrdfLut();
+
+            if (s_is_cache_enabled)
+            {
+                writeDds(lut_filepath, brdf_lut);
+            }
+        }
+
+        return true;
+    }
+
+    bool ImageBasedLighting::Load(const std::filesystem::path& hdr_filepath, PrefilterMode mode)
+    {
+        RGL_TRACE_ZONE("ImageBasedLighting::Load");
+
+        if (m_environment_map_name == 0)
+        {
+            return false;
+        }
+
+        /*
+         * Shared with the other users of the same HDR, switching back to it doesn't decode it again. A single level,
+         * the cubemap faces don't minify the equirectangular map enough to need the mips.
+         */
+        auto equirectangular_map = TextureCache::LoadHdr(hdr_filepath, 1);
+
+        if (!equirectangular_map)
+        {
+            return false;
+        }
+
+        RenderEnvironmentMap(*equirectangular_map);
+        ProjectIrradianceSH();
+
+        const CachedTexture prefiltered_map = { m_prefiltered_map_name, m_settings.m_prefiltered_map_size, m_prefiltered_levels_count, 6, DXGI_RGBA16_FLOAT, GL_RGBA, 8 };
+
+        std::filesystem::path prefiltered_filepath;
+
+        if (s_is_cache_enabled)
+        {
+            MappedFile hdr_file(hdr_filepath);
+
+            if (hdr_file.IsOpen())
+            {
+                uint64_t hash = 14695981039346656037ull;
+                hashBytes(hash, &CACHE_VERSION, sizeof(CACHE_VERSION));
+                hashBytes(hash, &m_settings,    sizeof(m_settings));
+                hashBytes(hash, hdr_file.GetData(), hdr_file.GetSize());
+
+                prefiltered_filepath = getCachePath(hash, "prefiltered");
+
+                if (readDds(prefiltered_filepath, prefiltered_map))
+                {
+                    printf("ImageBasedLighting: loaded %s from the cache\n", hdr_filepath.filename().string().c_str());
+                    return true;
+                }
+            }
+        }
+
+        if (mode == PrefilterMode::FAST)
+        {
+            /* Good enough for a preview, the QUALITY load computes and caches the real one. */
+            ComputePrefilteredMap(m_settings.m_prefilter_fast_samples);
+            return true;
+        }
+
+        ComputePrefilteredMap(m_settings.m_prefilter_samples);
+
+        if (!prefiltered_filepath.empty())
+        {
+            writeDds(prefiltered_filepath, prefiltered_map);
+        }
+
+        return true;
+    }
+
+    void ImageBasedLighting::BindEnvironmentMap(GLuint unit) const
+    {
+        GLState::BindTextureUnit(unit, m_environment_map_name);
+    }
+
+    void ImageBasedLighting::BindPrefilteredMap(GLuint unit) const
+    {
+        GLState::BindTextureUnit(unit, m_prefiltered_map_name);
+    }
+
+    void ImageBasedLighting::BindBrdfLut(GLuint unit) const
+    {
+        GLState::BindTextureUnit(unit, m_brdf_lut_name);
+    }
+
+    void ImageBasedLighting::BindIrradianceSH() const
+    {
+        glBindBufferBase(GL_UNIFORM_BUFFER, IBL_SH_UBO_BINDING_INDEX, m_irradiance_sh_buffer_name);
+    }
+
+    void ImageBasedLighting::Release()
+    {
+        for (GLuint* name : { &m_environment_map_name, &m_prefiltered_map_name, &m_brdf_lut_name })
+        {
+            if (*name != 0)
+            {
+                GpuMemory::UntrackTexture(*name);
+                glDeleteTextures(1, name);
+                GLState::OnTextureDeleted(*name);
+                *name = 0;
+            }
+        }
+
+        if (m_fbo_name != 0)
+        {
+            glDeleteFramebuffers(1, &m_fbo_name);
+            GLState::OnFramebufferDeleted(m_fbo_name);
+            m_fbo_name = 0;
+        }
+
+        for (GLuint* vao : { &m_cube_vao, &m_empty_vao })
+        {
+            if (*vao != 0)
+            {
+                glDeleteVertexArrays(1, vao);
+                GLState::OnVertexArrayDeleted(*vao);
+                *vao = 0;
+            }
+        }
+
+        for (GLuint* buffer : { &m_cube_vbo, &m_irradiance_sh_buffer_name })
+        {
+            if (*buffer != 0)
+            {
+                GpuMemory::UntrackBuffer(*buffer);
+                glDeleteBuffers(1, buffer);
+                *buffer = 0;
+            }
+        }
+
+        m_equirectangular_to_cubemap_shader.reset();
+        m_prefilter_cubemap_shader         .reset();
+        m_precompute_brdf_shader           .reset();
+        m_sh_projection_shader             .reset();
+    }
+
+    void ImageBasedLighting::RenderEnvironmentMap(Texture2D& equirectangular_map)
+    {
+        RGL_TRACE_ZONE("IBL environment map");
+
+        m_equirectangular_to_cubemap_shader->bind();
+        equirectangular_map.Bind(1);
+
+        RenderCubemapFaces(*m_equirectangular_to_cubemap_shader, m_environment_map_name, 0, m_settings.m_environment_map_size);
+
+        /* Sampled by the prefiltering at the LODs matching the samples' solid angle. */
+        glGenerateTextureMipmap(m_environment_map_name);
+    }
+
+    void ImageBasedLighting::ProjectIrradianceSH()
+    {
+        RGL_TRACE_ZONE("IBL irradiance SH");
+
+        /* A 64x64 level has plenty of texels for the 9 coefficients, the mips are already filtered down to it. */
+        const uint32_t level = uint32_t(std::max(int(std::log2(float(m_settings.m_environment_map_size) / float(IBL_SH_SOURCE_SIZE))), 0));
+        const uint32_t size  = std::max(m_settings.m_environment_map_size >> level, 1u);
+
+        m_sh_projection_shader->bind();
+        m_sh_projection_shader->setUniform("u_level", int(level));
+        m_sh_projection_shader->setUniform("u_size",  int(size));
+
+        BindEnvironmentMap(0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, IBL_SH_SSBO_BINDING_INDEX, m_irradiance_sh_buffer_name);
+
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier  (GL_UNIFORM_BARRIER_BIT);
+    }
+
+    void ImageBasedLighting::ComputePrefilteredMap(uint32_t max_samples)
+    {
+        RGL_TRACE_ZONE("IBL prefiltered map");
+
+        m_prefilter_cubemap_shader->bind();
+        BindEnvironmentMap(0);
+
+        for (uint32_t level = 0; level < m_prefiltered_levels_count; ++level)
+        {
+            const float    roughness = m_prefiltered_levels_count > 1 ? float(level) / float(m_prefiltered_levels_count - 1) : 0.0f;
+            const uint32_t size      = std::max(m_settings.m_prefiltered_map_size >> level, 1u);
+
+            /* The wider the lobe the more samples, the mirror-like level 0 is a single sample of the right mip. */
+            const uint32_t samples = level == 0 ? 1 : std::max(uint32_t(float(max_samples) * roughness), std::min(max_samples, 16u));
+
+            m_prefilter_cubemap_shader->setUniform("u_roughness",    roughness);
+            m_prefilter_cubemap_shader->setUniform("u_size",         int(size));
+            m_prefilter_cubemap_shader->setUniform("u_sample_count", int(samples));
+
+            glBindImageTexture(0, m_prefiltered_map_name, level, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+            glDispatchCompute ((size + IBL_PREFILTER_GROUP_SIZE - 1) / IBL_PREFILTER_GROUP_SIZE, (size + IBL_PREFILTER_GROUP_SIZE - 1) / IBL_PREFILTER_GROUP_SIZE, 6);
+        }
+
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+    }
+
+    void ImageBasedLighting::RenderBrdfLut()
+    {
+        RGL_TRACE_ZONE("IBL BRDF LUT");
+
+        glNamedFramebufferTexture(m_fbo_name, GL_COLOR_ATTACHMENT0, m_brdf_lut_name, 0);
+
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, m_fbo_name);
+        GLState::Viewport       (0, 0, m_settings.m_brdf_lut_size, m_settings.m_brdf_lut_size);
+
+        m_precompute_brdf_shader->bind();
+
+        GLState::BindVertexArray(m_empty_vao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+        GLState::Viewport       (0, 0, Window::getWidth(), Window::getHeight());
+    }
+
+    void ImageBasedLighting::RenderCubemapFaces(Shader& shader, GLuint cubemap_name, uint32_t level, uint32_t size)
+    {
+        static const glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+        static const glm::mat4 views[6]   = {
+            glm::lookAt(glm::vec3(0.0f), glm::vec3( 1,  0,  0), glm::vec3(0, -1,  0)),
+            glm::lookAt(glm::vec3(0.0f), glm::vec3(-1,  0,  0), glm::vec3(0, -1,  0)),
+            glm::lookAt(glm::vec3(0.0f), glm::vec3( 0,  1,  0), glm::vec3(0,  0,  1)),
+            glm::lookAt(glm::vec3(0.0f), glm::vec3( 0, -1,  0), glm::vec3(0,  0, -1)),
+            glm::lookAt(glm::vec3(0.0f), glm::vec3( 0,  0,  1), glm::vec3(0, -1,  0)),
+            glm::lookAt(glm::vec3(0.0f), glm::vec3( 0,  0, -1), glm::vec3(0, -1,  0)),
+        };
+
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, m_fbo_name);
+        GLState::Viewport       (0, 0, size, size);
+        GLState::BindVertexArray(m_cube_vao);
+
+        if (m_is_layered_rendering_supported)
+        {
+            glm::mat4 view_projections[6];
+
+            for (uint32_t face = 0; face < 6; ++face)
+            {
+                view_projections[face] = projection * views[face];
+            }
+
+            shader.setUniform("u_view_projections", view_projections, 6);
+
+            /* The whole level is attached, the instances pick the layers. */
+            glNamedFramebufferTexture(m_fbo_name, GL_COLOR_ATTACHMENT0, cubemap_name, level);
+            glDrawArraysInstanced    (GL_TRIANGLES, 0, 36, 6);
+        }
+        else
+        {
+            shader.setUniform("u_projection", projection);
+
+            for (uint32_t face = 0; face < 6; ++face)
+            {
+                shader.setUniform("u_view", views[face]);
+                glNamedFramebufferTextureLayer(m_fbo_name, GL_COLOR_ATTACHMENT0, cubemap_name, level, face);
+
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            }
+        }
+
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+        GLState::Viewport       (0, 0, Window::getWidth(), Window::getHeight());
+    }
+}
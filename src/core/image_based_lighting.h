@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+#include <glad/glad.h>
+
+namespace RGL
+{
+    class Shader;
+    class Texture2D;
+
+    /*
+     * Image based lighting of an equirectangular HDR: the environment cubemap, the diffuse irradiance as L2 spherical
+     * harmonics (IrradianceSH in a uniform buffer, see shaders/ibl/sh_irradiance.glh), the GGX prefiltered environment
+     * cubemap and the split-sum BRDF LUT (shaders/ibl/). The prefiltering is a compute pass per level with filtered
+     * importance sampling, the sample counts grow with the roughness up to Settings::m_prefilter_samples.
+     *
+     * The prefiltered map and the LUT are cached in ibl_cache/ as DDS files (RGBA16F cubemap, RG16F LUT), keyed by a hash
+     * of the HDR file's content, the settings and CACHE_VERSION - so the convolution only runs the first time an HDR is used.
+     * PrefilterMode::FAST is meant for switching the HDRs at runtime: on a cache miss it prefilters with
+     * m_prefilter_fast_samples and doesn't store the result, the next QUALITY load of the HDR does.
+     * The environment cubemap is rendered from the HDR and projected onto the harmonics on every Load(), both take
+     * a few draws and a single dispatch, and the cubemap is too big to be worth keeping on the disk. CoreApp disables the cache with --no-ibl-cache. Render thread only.
+     *
+     *     ImageBasedLighting ibl;
+     *     ibl.Create();
+     *     ibl.Load(hdr_filepath);
+     *     ibl.BindIrradianceSH(); ibl.BindPrefilteredMap(7); ibl.BindBrdfLut(8);
+     */
+    class ImageBasedLighting final
+    {
+    public:
+        /* Bump it when the shaders or the layout of the maps change, the old cache files are ignored then. */
+        static constexpr uint32_t CACHE_VERSION = 4;
+
+        enum class PrefilterMode { QUALITY, FAST };
+
+        struct Settings
+        {
+            uint32_t m_environment_map_size   = 2048;
+            uint32_t m_prefiltered_map_size   = 512;
+            uint32_t m_brdf_lut_size          = 512;
+            uint32_t m_prefilter_samples      = 256; /* At the roughness 1, the mirror-like level takes a single one. */
+            uint32_t m_prefilter_fast_samples = 32;
+        };
+
+        ImageBasedLighting() = default;
+        ~ImageBasedLighting();
+
+        ImageBasedLighting           (const ImageBasedLighting&) = delete;
+        ImageBasedLighting& operator=(const ImageBasedLighting&) = delete;
+
+        /* Creates the textures and the shaders, loads or computes the BRDF LUT. */
+        bool Create(const Settings& settings = Settings());
+
+        /* (Re)builds the maps for the HDR, the convolutions are read from the cache when it has them. */
+        bool Load(const std::filesystem::path& hdr_filepath, PrefilterMode mode = PrefilterMode::QUALITY);
+
+        static void SetCacheEnabled(bool enable) { s_is_cache_enabled = enable; }
+        static bool IsCacheEnabled()             { return s_is_cache_enabled; }
+
+        void BindEnvironmentMap(GLuint unit) const;
+        void BindPrefilteredMap(GLuint unit) const;
+        void BindBrdfLut       (GLuint unit) const;
+
+        /* Binds the harmonics to IBL_SH_UBO_BINDING_INDEX. */
+        void BindIrradianceSH() const;
+
+        GLuint GetEnvironmentMap()  const { return m_environment_map_name; }
+        GLuint GetIrradianceSH()    const { return m_irradiance_sh_buffer_name; }
+        GLuint GetPrefilteredMap()  const { return m_prefiltered_map_name; }
+        GLuint GetBrdfLut()         const { return m_brdf_lut_name; }
+
+        const Settings& GetSettings() const { return m_settings; }
+
+        /* The mip levels of the prefiltered map - roughness 0..1 maps to the LODs 0..count - 1. */
+        uint32_t GetPrefilteredLevelsCount() const { return m_prefiltered_levels_count; }
+
+    private:
+        void Release();
+
+        void RenderEnvironmentMap(Texture2D& equirectangular_map);
+        void ProjectIrradianceSH();
+        void ComputePrefilteredMap(uint32_t max_samples);
+        void RenderBrdfLut();
+
+        /*
+         * Draws the unit cube into the faces of the cubemap's level, the shader is bound by the caller. A single instanced
+         * draw into the layered level with ARB_shader_viewport_layer_array, a draw per face otherwise.
+         */
+        void RenderCubemapFaces(Shader& shader, GLuint cubemap_name, uint32_t level, uint32_t size);
+
+        static bool s_is_cache_enabled;
+
+        Settings m_settings;
+
+        std::shared_ptr<Shader> m_equirectangular_to_cubemap_shader;
+        std::shared_ptr<Shader> m_sh_projection_shader;
+        std::shared_ptr<Shader> m_prefilter_cubemap_shader;
+        std::shared_ptr<Shader> m_precompute_brdf_shader;
+
+        GLuint   m_environment_map_name      = 0;
+        GLuint   m_irradiance_sh_buffer_name = 0;
+        GLuint   m_prefiltered_map_name      = 0;
+        GLuint   m_brdf_lut_name             = 0;
+        uint32_t m_environment_levels_count  = 0;
+        uint32_t m_prefiltered_levels_count  = 0;
+
+        GLuint m_fbo_name  = 0;
+        GLuint m_cube_vao  = 0;
+        GLuint m_cube_vbo  = 0;
+        GLuint m_empty_vao = 0;
+
+        bool m_is_layered_rendering_supported = false;
+    };
+}
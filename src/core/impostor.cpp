@@ -0,0 +1,188 @@
+#include "impostor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "gl_state.h"
+#include "gpu_memory.h"
+#include "shader.h"
+#include "static_model.h"
+#include "trace.h"
+
+namespace RGL
+{
+    Impostor::~Impostor()
+    {
+        Release();
+    }
+
+    bool Impostor::Bake(StaticModel& model, const Settings& settings)
+    {
+        RGL_TRACE_ZONE("Impostor::Bake");
+
+        Release();
+
+        if (model.GetMeshPartsCount() == 0)
+        {
+            fprintf(stderr, "Impostor: the model has no mesh parts.\n");
+            return false;
+        }
+
+        /* A sphere around the bounds of all the mesh parts, centered at the first one. */
+        m_bounds = model.GetMeshPartBounds(0);
+
+        for (uint32_t i = 1; i < model.GetMeshPartsCount(); ++i)
+        {
+            const glm::vec4 bounds = model.GetMeshPartBounds(i);
+            m_bounds.w = std::max(m_bounds.w, glm::distance(glm::vec3(bounds), glm::vec3(m_bounds)) + bounds.w);
+        }
+
+        m_settings = settings;
+        m_settings.m_frames     = std::max(m_settings.m_frames,     1u);
+        m_settings.m_frame_size = std::max(m_settings.m_frame_size, 4u);
+
+        m_bake_shader = std::make_shared<Shader>("src/core/shaders/impostor_bake.vert", "src/core/shaders/impostor_bake.frag");
+
+        if (!m_bake_shader->link())
+        {
+            fprintf(stderr, "Impostor: the bake shader failed to link.\n");
+            return false;
+        }
+
+        /* The mips stop at 4x4 texels per frame, the coarser ones would filter across the frames. */
+        const GLsizei atlas_size   = GLsizei(m_settings.m_frames * m_settings.m_frame_size);
+        const GLsizei levels_count = std::max(GLsizei(std::log2(float(m_settings.m_frame_size))) - 1, 1);
+
+        glCreateTextures  (GL_TEXTURE_2D, 1, &m_albedo_texture_name);
+        glTextureStorage2D(m_albedo_texture_name, levels_count, GL_SRGB8_ALPHA8, atlas_size, atlas_size);
+        GpuMemory::TrackTexture(m_albedo_texture_name, "Impostor");
+
+        glCreateTextures  (GL_TEXTURE_2D, 1, &m_normal_texture_name);
+        glTextureStorage2D(m_normal_texture_name, levels_count, GL_RGBA8, atlas_size, atlas_size);
+        GpuMemory::TrackTexture(m_normal_texture_name, "Impostor");
+
+        for (GLuint name : { m_albedo_texture_name, m_normal_texture_name })
+        {
+            glTextureParameteri(name, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTextureParameteri(name, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTextureParameteri(name, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+            glTextureParameteri(name, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+        }
+
+        GLuint depth_buffer_name = 0;
+        glCreateRenderbuffers     (1, &depth_buffer_name);
+        glNamedRenderbufferStorage(depth_buffer_name, GL_DEPTH_COMPONENT32F, atlas_size, atlas_size);
+
+        const GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+
+        GLuint fbo_name = 0;
+        glCreateFramebuffers          (1, &fbo_name);
+        glNamedFramebufferTexture     (fbo_name, GL_COLOR_ATTACHMENT0, m_albedo_texture_name, 0);
+        glNamedFramebufferTexture     (fbo_name, GL_COLOR_ATTACHMENT1, m_normal_texture_name, 0);
+        glNamedFramebufferRenderbuffer(fbo_name, GL_DEPTH_ATTACHMENT,  GL_RENDERBUFFER, depth_buffer_name);
+        glNamedFramebufferDrawBuffers (fbo_name, 2, draw_buffers);
+
+        const float clear_color[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        const float clear_depth    = 1.0f;
+
+        glClearNamedFramebufferfv(fbo_name, GL_COLOR, 0, clear_color);
+        glClearNamedFramebufferfv(fbo_name, GL_COLOR, 1, clear_color);
+        glClearNamedFramebufferfv(fbo_name, GL_DEPTH, 0, &clear_depth);
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+
+        const bool is_depth_test_enabled = glIsEnabled(GL_DEPTH_TEST);
+        const bool is_cull_face_enabled  = glIsEnabled(GL_CULL_FACE);
+        const bool is_srgb_enabled       = glIsEnabled(GL_FRAMEBUFFER_SRGB);
+
+        /* The foliage is two sided, the shader flips the normals of the back faces. */
+        GLState::SetCapability(GL_DEPTH_TEST, true);
+        GLState::SetCapability(GL_CULL_FACE,  false);
+        glEnable(GL_FRAMEBUFFER_SRGB);
+
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, fbo_name);
+
+        m_bake_shader->bind();
+
+        const glm::vec3 center = glm::vec3(m_bounds);
+        const float     radius = m_bounds.w;
+
+        for (uint32_t y = 0; y < m_settings.m_frames; ++y)
+        {
+            for (uint32_t x = 0; x < m_settings.m_frames; ++x)
+            {
+                /* The frame is captured from the direction at its center, the up axis of impostorFrameBasis(). */
+                const glm::vec2 uv        = (glm::vec2(x, y) + 0.5f) / float(m_settings.m_frames) * 2.0f - 1.0f;
+                const glm::vec3 direction = OctahedronToDirection(uv);
+                const glm::vec3 up        = std::abs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+                const glm::mat4 view       = glm::lookAt(center + direction * 2.0f * radius, center, up);
+                const glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, radius, 3.0f * radius);
+
+                GLState::Viewport(GLint(x * m_settings.m_frame_size), GLint(y * m_settings.m_frame_size), m_settings.m_frame_size, m_settings.m_frame_size);
+
+                m_bake_shader->setUniform("view_projection", projection * view);
+                model.Render(m_bake_shader);
+            }
+        }
+
+        glGenerateTextureMipmap(m_albedo_texture_name);
+        glGenerateTextureMipmap(m_normal_texture_name);
+
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+        GLState::Viewport       (viewport[0], viewport[1], viewport[2], viewport[3]);
+        GLState::SetCapability  (GL_DEPTH_TEST, is_depth_test_enabled);
+        GLState::SetCapability  (GL_CULL_FACE,  is_cull_face_enabled);
+
+        if (!is_srgb_enabled)
+        {
+            glDisable(GL_FRAMEBUFFER_SRGB);
+        }
+
+        glDeleteFramebuffers (1, &fbo_name);
+        glDeleteRenderbuffers(1, &depth_buffer_name);
+        GLState::OnFramebufferDeleted(fbo_name);
+
+        return true;
+    }
+
+    void Impostor::Bind(GLuint albedo_unit, GLuint normal_unit) const
+    {
+        GLState::BindTextureUnit(albedo_unit, m_albedo_texture_name);
+        GLState::BindTextureUnit(normal_unit, m_normal_texture_name);
+    }
+
+    glm::vec3 Impostor::OctahedronToDirection(const glm::vec2& uv)
+    {
+        /* y is the up axis, the lower hemisphere is folded over the diagonals. */
+        glm::vec3 direction = glm::vec3(uv.x, 1.0f - std::abs(uv.x) - std::abs(uv.y), uv.y);
+
+        if (direction.y < 0.0f)
+        {
+            const float x = (1.0f - std::abs(direction.z)) * (direction.x >= 0.0f ? 1.0f : -1.0f);
+            const float z = (1.0f - std::abs(direction.x)) * (direction.z >= 0.0f ? 1.0f : -1.0f);
+
+            direction.x = x;
+            direction.z = z;
+        }
+
+        return glm::normalize(direction);
+    }
+
+    void Impostor::Release()
+    {
+        GpuMemory::UntrackTexture(m_albedo_texture_name);
+        GpuMemory::UntrackTexture(m_normal_texture_name);
+        glDeleteTextures(1, &m_albedo_texture_name);
+        glDeleteTextures(1, &m_normal_texture_name);
+        GLState::OnTextureDeleted(m_albedo_texture_name);
+        GLState::OnTextureDeleted(m_normal_texture_name);
+
+        m_albedo_texture_name = 0;
+        m_normal_texture_name = 0;
+    }
+}
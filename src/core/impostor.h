@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+namespace RGL
+{
+    class Shader;
+    class StaticModel;
+
+    /*
+     * Octahedral impostor of a StaticModel for its distant instances. Bake() renders the model with orthographic
+     * projections from frames x frames directions spread over the sphere by the octahedral mapping into the frames of
+     * an atlas: the albedo with its alpha, and the object space normals. At runtime a camera facing quad shows the
+     * frame captured from the direction nearest to the viewer, see shaders/impostor.glh.
+     *
+     * The frames are captured around the model's bounding sphere, the quad of the frame spans its diameter.
+     * Render thread only.
+     *
+     *     impostor.Bake(model);
+     *     impostor.Bind(albedo_unit, normal_unit);
+     *     ... draw the quads, impostorFrame() and impostorQuadCorner() place them ...
+     */
+    class Impostor final
+    {
+    public:
+        struct Settings
+        {
+            uint32_t m_frames     = 8;      /* Per side of the atlas. */
+            uint32_t m_frame_size = 128;
+        };
+
+        Impostor() = default;
+        ~Impostor();
+
+        Impostor           (const Impostor&) = delete;
+        Impostor& operator=(const Impostor&) = delete;
+
+        /* The model's textures are bound as in StaticModel::Render(). Restores the viewport, leaves the framebuffer 0 bound. */
+        bool Bake(StaticModel& model, const Settings& settings = Settings());
+
+        void Bind(GLuint albedo_unit, GLuint normal_unit) const;
+
+        /* The octahedral mapping of shaders/impostor.glh, uv in [-1, 1]. */
+        static glm::vec3 OctahedronToDirection(const glm::vec2& uv);
+
+        /* Object space bounding sphere of the whole model - xyz center, w radius. */
+        glm::vec4       GetBounds()         const { return m_bounds; }
+        GLuint          GetAlbedoTexture()  const { return m_albedo_texture_name; }
+        GLuint          GetNormalTexture()  const { return m_normal_texture_name; }
+        const Settings& GetSettings()       const { return m_settings; }
+        bool            IsBaked()           const { return m_albedo_texture_name != 0; }
+
+    private:
+        void Release();
+
+        Settings                m_settings;
+        std::shared_ptr<Shader> m_bake_shader;
+
+        glm::vec4 m_bounds              = glm::vec4(0.0f);
+        GLuint    m_albedo_texture_name = 0;
+        GLuint    m_normal_texture_name = 0;
+    };
+}
@@ -1,176 +1,166 @@
 #include "input.h"
+#include "timer.h"
 
 namespace RGL
 {
     GLFWwindow * Input::m_window = nullptr;
 
-    std::unordered_map<KeyCode, bool> Input::m_last_keys_states = {
-        { KeyCode::Backspace,      false },
-        { KeyCode::Delete,         false },
-        { KeyCode::Tab,            false },
-        { KeyCode::Return,         false },
-        { KeyCode::Pause,          false },
-        { KeyCode::Escape,         false },
-        { KeyCode::Space,          false },
-        { KeyCode::Keypad0,        false },
-        { KeyCode::Keypad1,        false },
-        { KeyCode::Keypad2,        false },
-        { KeyCode::Keypad3,        false },
-        { KeyCode::Keypad4,        false },
-        { KeyCode::Keypad5,        false },
-        { KeyCode::Keypad6,        false },
-        { KeyCode::Keypad7,        false },
-        { KeyCode::Keypad8,        false },
-        { KeyCode::Keypad9,        false },
-        { KeyCode::KeypadPeriod,   false },
-        { KeyCode::KeypadDivide,   false },
-        { KeyCode::KeypadMultiply, false },
-        { KeyCode::KeypadMinus,    false },
-        { KeyCode::KeypadPlus,     false },
-        { KeyCode::KeypadEnter,    false },
-        { KeyCode::KeypadEquals,   false },
-        { KeyCode::UpArrow,        false },
-        { KeyCode::DownArrow,      false },
-        { KeyCode::RightArrow,     false },
-        { KeyCode::LeftArrow,      false },
-        { KeyCode::Insert,         false },
-        { KeyCode::Home,           false },
-        { KeyCode::End,            false },
-        { KeyCode::PageUp,         false },
-        { KeyCode::PageDown,       false },
-        { KeyCode::F1,             false },
-        { KeyCode::F2,             false },
-        { KeyCode::F3,             false },
-        { KeyCode::F4,             false },
-        { KeyCode::F5,             false },
-        { KeyCode::F6,             false },
-        { KeyCode::F7,             false },
-        { KeyCode::F8,             false },
-        { KeyCode::F9,             false },
-        { KeyCode::F10,            false },
-        { KeyCode::F11,            false },
-        { KeyCode::F12,            false },
-        { KeyCode::F13,            false },
-        { KeyCode::F14,            false },
-        { KeyCode::F15,            false },
-        { KeyCode::Alpha0,         false },
-        { KeyCode::Alpha1,         false },
-        { KeyCode::Alpha2,         false },
-        { KeyCode::Alpha3,         false },
-        { KeyCode::Alpha4,         false },
-        { KeyCode::Alpha5,         false },
-        { KeyCode::Alpha6,         false },
-        { KeyCode::Alpha7,         false },
-        { KeyCode::Alpha8,         false },
-        { KeyCode::Alpha9,         false },
-        { KeyCode::Comma,          false },
-        { KeyCode::Minus,          false },
-        { KeyCode::Period,         false },
-        { KeyCode::Slash,          false },
-        { KeyCode::Semicolon,      false },
-        { KeyCode::Equals,         false },
-        { KeyCode::LeftBracket,    false },
-        { KeyCode::RightBracket,   false },
-        { KeyCode::Backslash,      false },
-        { KeyCode::A,              false },
-        { KeyCode::B,              false },
-        { KeyCode::C,              false },
-        { KeyCode::D,              false },
-        { KeyCode::E,              false },
-        { KeyCode::F,              false },
-        { KeyCode::G,              false },
-        { KeyCode::H,              false },
-        { KeyCode::I,              false },
-        { KeyCode::J,              false },
-        { KeyCode::K,              false },
-        { KeyCode::L,              false },
-        { KeyCode::M,              false },
-        { KeyCode::N,              false },
-        { KeyCode::O,              false },
-        { KeyCode::P,              false },
-        { KeyCode::Q,              false },
-        { KeyCode::R,              false },
-        { KeyCode::S,              false },
-        { KeyCode::T,              false },
-        { KeyCode::U,              false },
-        { KeyCode::V,              false },
-        { KeyCode::W,              false },
-        { KeyCode::X,              false },
-        { KeyCode::Y,              false },
-        { KeyCode::Z,              false },
-        { KeyCode::Numlock,        false },
-        { KeyCode::CapsLock,       false },
-        { KeyCode::ScrollLock,     false },
-        { KeyCode::RightShift,     false },
-        { KeyCode::LeftShift,      false },
-        { KeyCode::RightControl,   false },
-        { KeyCode::LeftControl,    false },
-        { KeyCode::RightAlt,       false },
-        { KeyCode::LeftAlt,        false },
-        { KeyCode::PrintScreen,    false },
-        { KeyCode::Menu,           false }
-    };
-
-    std::unordered_map<KeyCode, bool> Input::m_last_mouse_states = {
-        { KeyCode::Mouse1,      false},
-        { KeyCode::Mouse2,      false},
-        { KeyCode::Mouse3,      false}
-    };
+    SpscQueue<InputEvent, Input::EVENTS_CAPACITY> Input::m_queue;
+    std::atomic<uint32_t>                         Input::m_dropped_events_count { 0 };
+    std::vector<InputEvent>                       Input::m_events;
+
+    Input::KeyState Input::m_keys_states [KEYS_COUNT];
+    Input::KeyState Input::m_mouse_states[MOUSE_BUTTONS_COUNT];
+    glm::vec2       Input::m_mouse_position = glm::vec2(0.0f);
+    glm::vec2       Input::m_mouse_scroll   = glm::vec2(0.0f);
 
     void Input::init(GLFWwindow* window)
     {
         m_window = window;
+
+        double x_pos, y_pos;
+        glfwGetCursorPos(m_window, &x_pos, &y_pos);
+        m_mouse_position = glm::vec2(x_pos, y_pos);
+
+        m_events.reserve(EVENTS_CAPACITY);
+
+        /* Before the GUI's, ImGui chains them. */
+        glfwSetKeyCallback        (m_window, keyCallback);
+        glfwSetMouseButtonCallback(m_window, mouseButtonCallback);
+        glfwSetCursorPosCallback  (m_window, cursorPosCallback);
+        glfwSetScrollCallback     (m_window, scrollCallback);
+    }
+
+    void Input::pushEvent(const InputEvent & event)
+    {
+        if (!m_queue.Push(event))
+        {
+            m_dropped_events_count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void Input::keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+    {
+        /* The repeats don't change the state. */
+        if (action != GLFW_REPEAT)
+        {
+            pushEvent({ InputEvent::Type::Key, action == GLFW_PRESS, KeyCode(key), glm::vec2(0.0f), Timer::getTime() });
+        }
+    }
+
+    void Input::mouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+    {
+        pushEvent({ InputEvent::Type::MouseButton, action == GLFW_PRESS, KeyCode(button), glm::vec2(0.0f), Timer::getTime() });
+    }
+
+    void Input::cursorPosCallback(GLFWwindow* window, double x_pos, double y_pos)
+    {
+        pushEvent({ InputEvent::Type::MouseMove, false, KeyCode::None, glm::vec2(x_pos, y_pos), Timer::getTime() });
+    }
+
+    void Input::scrollCallback(GLFWwindow* window, double x_offset, double y_offset)
+    {
+        pushEvent({ InputEvent::Type::Scroll, false, KeyCode::None, glm::vec2(x_offset, y_offset), Timer::getTime() });
+    }
+
+    void Input::applyKey(KeyState* states, int count, KeyCode key_code, bool is_pressed)
+    {
+        const int index = static_cast<int>(key_code);
+
+        if (index < 0 || index >= count)
+        {
+            return;
+        }
+
+        states[index].m_is_down = is_pressed;
+
+        if (is_pressed)
+        {
+            states[index].m_was_pressed = true;
+        }
+        else
+        {
+            states[index].m_was_released = true;
+        }
     }
 
     void Input::update()
     {
-        for (auto & kv : m_last_keys_states)
+        for (KeyState& state : m_keys_states)
+        {
+            state.m_was_pressed  = false;
+            state.m_was_released = false;
+        }
+
+        for (KeyState& state : m_mouse_states)
         {
-            kv.second = getKey(kv.first);
+            state.m_was_pressed  = false;
+            state.m_was_released = false;
         }
 
-        for (auto & kv : m_last_mouse_states)
+        m_events.clear();
+        m_mouse_scroll = glm::vec2(0.0f);
+
+        InputEvent event;
+
+        while (m_queue.Pop(event))
         {
-            kv.second = getMouse(kv.first);
+            switch (event.m_type)
+            {
+                case InputEvent::Type::Key:         applyKey(m_keys_states,  KEYS_COUNT,          event.m_key, event.m_is_pressed); break;
+                case InputEvent::Type::MouseButton: applyKey(m_mouse_states, MOUSE_BUTTONS_COUNT, event.m_key, event.m_is_pressed); break;
+                case InputEvent::Type::MouseMove:   m_mouse_position = event.m_value;                                                break;
+                case InputEvent::Type::Scroll:      m_mouse_scroll  += event.m_value;                                                break;
+            }
+
+            m_events.push_back(event);
         }
     }
 
     bool Input::getKey(KeyCode keyCode)
     {
-        return glfwGetKey(m_window, static_cast<int>(keyCode)) == GLFW_PRESS;
+        const int index = static_cast<int>(keyCode);
+        return index >= 0 && index < KEYS_COUNT && m_keys_states[index].m_is_down;
     }
 
     bool Input::getKeyDown(KeyCode keyCode)
     {
-        return getKey(keyCode) && !m_last_keys_states[keyCode];
+        const int index = static_cast<int>(keyCode);
+        return index >= 0 && index < KEYS_COUNT && m_keys_states[index].m_was_pressed;
     }
 
     bool Input::getKeyUp(KeyCode keyCode)
     {
-        return !getKey(keyCode) && m_last_keys_states[keyCode];
+        const int index = static_cast<int>(keyCode);
+        return index >= 0 && index < KEYS_COUNT && m_keys_states[index].m_was_released;
     }
 
     bool Input::getMouse(KeyCode keyCode)
     {
-        return glfwGetMouseButton(m_window, static_cast<int>(keyCode)) == GLFW_PRESS;
+        const int index = static_cast<int>(keyCode);
+        return index >= 0 && index < MOUSE_BUTTONS_COUNT && m_mouse_states[index].m_is_down;
     }
 
     bool Input::getMouseDown(KeyCode keyCode)
     {
-        return getMouse(keyCode) && !m_last_mouse_states[keyCode];
+        const int index = static_cast<int>(keyCode);
+        return index >= 0 && index < MOUSE_BUTTONS_COUNT && m_mouse_states[index].m_was_pressed;
     }
 
     bool Input::getMouseUp(KeyCode keyCode)
     {
-        return !getMouse(keyCode) && m_last_mouse_states[keyCode];
+        const int index = static_cast<int>(keyCode);
+        return index >= 0 && index < MOUSE_BUTTONS_COUNT && m_mouse_states[index].m_was_released;
     }
 
     glm::vec2 Input::getMousePosition()
     {
-        double x_pos, y_pos;
-        glfwGetCursorPos(m_window, &x_pos, &y_pos);
+        return m_mouse_position;
+    }
 
-        return glm::vec2(x_pos, y_pos);
+    glm::vec2 Input::getMouseScroll()
+    {
+        return m_mouse_scroll;
     }
 
     void Input::setMouseCursorVisibility(bool is_visible)
@@ -188,5 +178,8 @@ namespace RGL
     void Input::setMouseCursorPosition(const glm::vec2 & cursor_position)
     {
         glfwSetCursorPos(m_window, cursor_position.x, cursor_position.y);
+
+        /* Not every platform reports the move, the next getMousePosition() is the new position either way. */
+        m_mouse_position = cursor_position;
     }
 }
\ No newline at end of file
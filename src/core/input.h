@@ -1,9 +1,13 @@
 #pragma once
 
-#include <unordered_map>
+#include <atomic>
+#include <cstdint>
+#include <vector>
 #include <GLFW/glfw3.h>
 #include <glm/vec2.hpp>
 
+#include "spsc_queue.h"
+
 namespace RGL
 {
     enum class KeyCode
@@ -121,17 +125,46 @@ namespace RGL
         MouseRight = GLFW_MOUSE_BUTTON_RIGHT
     };
 
+    /* An input change, as the GLFW callbacks report it. */
+    struct InputEvent
+    {
+        enum class Type : uint8_t { Key, MouseButton, MouseMove, Scroll };
+
+        Type      m_type;
+        bool      m_is_pressed; /* Key and MouseButton. */
+        KeyCode   m_key;        /* Key and MouseButton. */
+        glm::vec2 m_value;      /* The cursor position of MouseMove, the offset of Scroll. */
+        double    m_time;       /* Timer::getTime() of the callback. */
+    };
+
+    /*
+     * The GLFW callbacks push the events to a lock-free single producer, single consumer queue, update() drains it once
+     * per simulation step - the state the getters return changes only there, so all the events between two steps count
+     * once and a catch-up step without new events sees no presses or releases again. The key pressed and released
+     * between two steps is still reported by getKeyDown() and getKeyUp(). The callbacks run on the thread that polls the
+     * GLFW events, update() and the getters on the simulation thread, which can be a different one.
+     */
     class Input final
     {
     public:
+        static constexpr uint32_t EVENTS_CAPACITY = 1024;
+
         Input() = delete;
         ~Input() = delete;
         Input(const Input &) = delete;
         Input & operator=(const Input &) = delete;
 
         static void init(GLFWwindow * window);
+
+        /* Applies the queued events to the state, once per simulation step before the step's input(). */
         static void update();
 
+        /* The events applied by the last update(), in the order they happened. */
+        static const std::vector<InputEvent> & getEvents() { return m_events; }
+
+        /* The events lost to the full queue so far - the steps are too rare for the rate of the events. */
+        static uint32_t getDroppedEventsCount() { return m_dropped_events_count.load(std::memory_order_relaxed); }
+
         /**
          * @brief Check if key is pressed
          * @param KeyCode keycode
@@ -176,6 +209,11 @@ namespace RGL
          */
         static glm::vec2 getMousePosition();
 
+        /**
+         * @brief Get the scroll offset of the last step
+         */
+        static glm::vec2 getMouseScroll();
+
         /**
          * @brief Enable or disable visibility of the cursor
          * @param bool TRUE: to show the cursor
@@ -186,14 +224,34 @@ namespace RGL
         static void setMouseCursorPosition(const glm::vec2 & cursor_position);
 
     private:
+        static constexpr int KEYS_COUNT          = GLFW_KEY_LAST + 1;
+        static constexpr int MOUSE_BUTTONS_COUNT = GLFW_MOUSE_BUTTON_LAST + 1;
+
+        /* Per key: the state after the last step and whether it was pressed or released during the step. */
+        struct KeyState
+        {
+            bool m_is_down      = false;
+            bool m_was_pressed  = false;
+            bool m_was_released = false;
+        };
+
+        static void pushEvent(const InputEvent & event);
+        static void applyKey(KeyState * states, int count, KeyCode key_code, bool is_pressed);
+
+        static void keyCallback        (GLFWwindow * window, int key, int scancode, int action, int mods);
+        static void mouseButtonCallback(GLFWwindow * window, int button, int action, int mods);
+        static void cursorPosCallback  (GLFWwindow * window, double x_pos, double y_pos);
+        static void scrollCallback     (GLFWwindow * window, double x_offset, double y_offset);
+
         static GLFWwindow * m_window;
 
-        /**
-         * States:
-         * false -> key was not pressed
-         * true  -> key was pressed
-         */
-        static std::unordered_map<KeyCode, bool> m_last_keys_states;
-        static std::unordered_map<KeyCode, bool> m_last_mouse_states;
+        static SpscQueue<InputEvent, EVENTS_CAPACITY> m_queue;
+        static std::atomic<uint32_t>                  m_dropped_events_count;
+        static std::vector<InputEvent>                m_events;
+
+        static KeyState  m_keys_states[KEYS_COUNT];
+        static KeyState  m_mouse_states[MOUSE_BUTTONS_COUNT];
+        static glm::vec2 m_mouse_position;
+        static glm::vec2 m_mouse_scroll;
     };
 }
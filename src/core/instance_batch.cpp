@@ -0,0 +1,166 @@
+#include "instance_batch.h"
+
+#include <algorithm>
+
+#include "gpu_memory.h"
+
+namespace RGL
+{
+    InstanceBatch::InstanceBatch()
+        : m_buffer_name(0),
+          m_capacity   (0),
+          m_is_dirty   (false)
+    {
+    }
+
+    InstanceBatch::~InstanceBatch()
+    {
+        Release();
+    }
+
+    uint32_t InstanceBatch::Add(const glm::mat4& model_matrix, uint32_t material_index)
+    {
+        InstanceData instance = {};
+        instance.model_matrix   = model_matrix;
+        instance.material_index = material_index;
+
+        m_instances.push_back(instance);
+
+        uint32_t index = uint32_t(m_instances.size() - 1);
+        MarkDirty(index);
+
+        return index;
+    }
+
+    void InstanceBatch::SetTransform(uint32_t index, const glm::mat4& model_matrix)
+    {
+        m_instances[index].model_matrix = model_matrix;
+        MarkDirty(index);
+    }
+
+    void InstanceBatch::SetMaterialIndex(uint32_t index, uint32_t material_index)
+    {
+        m_instances[index].material_index = material_index;
+        MarkDirty(index);
+    }
+
+    void InstanceBatch::Reserve(uint32_t count)
+    {
+        m_instances.reserve(count);
+    }
+
+    void InstanceBatch::Clear()
+    {
+        m_instances.clear();
+        m_dirty_blocks.clear();
+        m_is_dirty = false;
+    }
+
+    void InstanceBatch::MarkDirty(uint32_t index)
+    {
+        uint32_t block = index / INSTANCES_PER_BLOCK;
+
+        if (block >= m_dirty_blocks.size())
+        {
+            m_dirty_blocks.resize(block + 1, false);
+        }
+
+        m_dirty_blocks[block] = true;
+        m_is_dirty            = true;
+    }
+
+    void InstanceBatch::Update()
+    {
+        if (!m_is_dirty || m_instances.empty())
+        {
+            return;
+        }
+
+        /* The storage is immutable - grow by recreating the buffer and uploading everything. */
+        if (m_instances.size() > m_capacity)
+        {
+            GpuMemory::UntrackBuffer(m_buffer_name);
+            glDeleteBuffers(1, &m_buffer_name);
+
+            m_capacity = std::max<uint32_t>(uint32_t(m_instances.size()), m_capacity * 2);
+
+            glCreateBuffers     (1, &m_buffer_name);
+            glNamedBufferStorage(m_buffer_name, sizeof(InstanceData) * m_capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+            GpuMemory::TrackBuffer(m_buffer_name, "InstanceBatch");
+
+            std::fill(m_dirty_blocks.begin(), m_dirty_blocks.end(), true);
+        }
+
+        const uint32_t blocks_count = uint32_t(m_dirty_blocks.size());
+
+        /* Consecutive dirty blocks are merged into one upload. */
+        for (uint32_t block = 0; block < blocks_count; ++block)
+        {
+            if (!m_dirty_blocks[block])
+            {
+                continue;
+            }
+
+            uint32_t last_block = block;
+
+            while (last_block + 1 < blocks_count && m_dirty_blocks[last_block + 1])
+            {
+                m_dirty_blocks[++last_block] = false;
+            }
+
+            m_dirty_blocks[block] = false;
+
+            uint32_t first = block * INSTANCES_PER_BLOCK;
+            uint32_t last  = std::min<uint32_t>((last_block + 1) * INSTANCES_PER_BLOCK, uint32_t(m_instances.size()));
+
+            if (first < last)
+            {
+                glNamedBufferSubData(m_buffer_name, sizeof(InstanceData) * first, sizeof(InstanceData) * (last - first), &m_instances[first]);
+            }
+
+            block = last_block;
+        }
+
+        m_is_dirty = false;
+    }
+
+    void InstanceBatch::Bind() const
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_DATA_SSBO_BINDING_INDEX, m_buffer_name);
+    }
+
+    void InstanceBatch::Render(StaticModel& model)
+    {
+        if (m_instances.empty())
+        {
+            return;
+        }
+
+        Update();
+        Bind();
+
+        model.Render(GetCount());
+    }
+
+    void InstanceBatch::Render(StaticModel& model, std::shared_ptr<Shader>& shader)
+    {
+        if (m_instances.empty())
+        {
+            return;
+        }
+
+        Update();
+        Bind();
+
+        model.Render(shader, GetCount());
+    }
+
+    void InstanceBatch::Release()
+    {
+        GpuMemory::UntrackBuffer(m_buffer_name);
+        glDeleteBuffers(1, &m_buffer_name);
+
+        m_buffer_name = 0;
+        m_capacity    = 0;
+    }
+}
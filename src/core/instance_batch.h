@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/mat4x4.hpp>
+
+#include "core_shared.h"
+#include "shader.h"
+#include "static_model.h"
+
+namespace RGL
+{
+    /*
+     * Transforms and material indices of many instances of a model, kept in an SSBO (InstanceData, see core_shared.h).
+     * Changed instances are tracked in blocks of INSTANCES_PER_BLOCK and only the dirty block ranges are uploaded by Update().
+     * Render() draws all the instances with a single instanced draw per mesh part, so the vertex shaders have to read
+     * the transform with INSTANCE_DATA.model_matrix instead of a per object uniform.
+     */
+    class InstanceBatch final
+    {
+    public:
+        static constexpr uint32_t INSTANCES_PER_BLOCK = 64;
+
+        InstanceBatch();
+        ~InstanceBatch();
+
+        InstanceBatch           (const InstanceBatch&) = delete;
+        InstanceBatch& operator=(const InstanceBatch&) = delete;
+
+        /* Returns the index of the new instance. */
+        uint32_t Add(const glm::mat4& model_matrix, uint32_t material_index = 0);
+
+        void SetTransform    (uint32_t index, const glm::mat4& model_matrix);
+        void SetMaterialIndex(uint32_t index, uint32_t material_index);
+        void Reserve         (uint32_t count);
+        void Clear();
+
+        const InstanceData& Get(uint32_t index) const { return m_instances[index]; }
+        uint32_t            GetCount()          const { return uint32_t(m_instances.size()); }
+        GLuint              GetBuffer()         const { return m_buffer_name; }
+
+        /* Uploads the dirty ranges. Called by Render(), only needed when the buffer is used directly. */
+        void Update();
+
+        /* Binds the instances buffer at INSTANCE_DATA_SSBO_BINDING_INDEX. */
+        void Bind() const;
+
+        void Render(StaticModel& model);
+        void Render(StaticModel& model, std::shared_ptr<Shader>& shader);
+
+    private:
+        void MarkDirty(uint32_t index);
+        void Release();
+
+        std::vector<InstanceData> m_instances;
+        std::vector<bool>         m_dirty_blocks;
+
+        GLuint   m_buffer_name;
+        uint32_t m_capacity;
+        bool     m_is_dirty;
+    };
+}
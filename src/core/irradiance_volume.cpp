@@ -0,0 +1,268 @@
+#include "irradiance_volume.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "core_shared.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+#include "shader.h"
+#include "trace.h"
+#include "window.h"
+
+namespace RGL
+{
+    IrradianceVolume::~IrradianceVolume()
+    {
+        Release();
+    }
+
+    bool IrradianceVolume::Create(const glm::vec3& bounds_min, const glm::vec3& bounds_max, const glm::uvec3& resolution, const Settings& settings)
+    {
+        RGL_TRACE_ZONE("IrradianceVolume::Create");
+
+        Release();
+
+        m_settings                    = settings;
+        m_settings.m_capture_size     = std::clamp(m_settings.m_capture_size, 4u, uint32_t(IBL_SH_SOURCE_SIZE));
+        m_settings.m_probes_per_frame = std::max(m_settings.m_probes_per_frame, 1u);
+
+        m_resolution = glm::max(resolution, glm::uvec3(1));
+        m_bounds_min = bounds_min;
+        m_spacing    = (bounds_max - bounds_min) / glm::max(glm::vec3(m_resolution) - 1.0f, glm::vec3(1.0f));
+
+        m_projection_shader = std::make_shared<Shader>("src/core/shaders/ibl/sh_probe_projection.comp");
+
+        if (!m_projection_shader->link())
+        {
+            fprintf(stderr, "IrradianceVolume: the projection shader failed to link.\n");
+            return false;
+        }
+
+        /* The layered vertex shader writes gl_Layer, the faces are instances of a single draw. */
+        m_is_layered_rendering_supported = GLAD_GL_ARB_shader_viewport_layer_array;
+
+        glCreateTextures  (GL_TEXTURE_3D, 1, &m_volume_name);
+        glTextureStorage3D(m_volume_name, 1, GL_RGBA16F, m_resolution.x, m_resolution.y, m_resolution.z * 9);
+        GpuMemory::TrackTexture(m_volume_name, "IrradianceVolume");
+
+        /* Zero - no probe is captured yet. */
+        glClearTexImage(m_volume_name, 0, GL_RGBA, GL_FLOAT, nullptr);
+
+        glCreateTextures  (GL_TEXTURE_CUBE_MAP, 1, &m_capture_map_name);
+        glTextureStorage2D(m_capture_map_name, 1, GL_RGBA16F, m_settings.m_capture_size, m_settings.m_capture_size);
+        GpuMemory::TrackTexture(m_capture_map_name, "IrradianceVolume");
+
+        /* A layered framebuffer needs all of its attachments layered, so the depth is a cubemap as well. */
+        glCreateTextures  (GL_TEXTURE_CUBE_MAP, 1, &m_capture_depth_name);
+        glTextureStorage2D(m_capture_depth_name, 1, GL_DEPTH_COMPONENT32F, m_settings.m_capture_size, m_settings.m_capture_size);
+        GpuMemory::TrackTexture(m_capture_depth_name, "IrradianceVolume");
+
+        for (GLuint name : { m_volume_name, m_capture_map_name })
+        {
+            glTextureParameteri(name, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTextureParameteri(name, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTextureParameteri(name, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+            glTextureParameteri(name, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+            glTextureParameteri(name, GL_TEXTURE_WRAP_R,     GL_CLAMP_TO_EDGE);
+        }
+
+        glCreateFramebuffers(1, &m_fbo_name);
+
+        if (m_is_layered_rendering_supported)
+        {
+            glNamedFramebufferTexture(m_fbo_name, GL_COLOR_ATTACHMENT0, m_capture_map_name,   0);
+            glNamedFramebufferTexture(m_fbo_name, GL_DEPTH_ATTACHMENT,  m_capture_depth_name, 0);
+        }
+
+        /* The normal bias is a fraction of the smallest spacing of the axes that have more than one probe. */
+        float min_spacing = 0.0f;
+
+        for (uint32_t axis = 0; axis < 3; ++axis)
+        {
+            if (m_resolution[axis] > 1)
+            {
+                min_spacing = min_spacing > 0.0f ? std::min(min_spacing, m_spacing[axis]) : m_spacing[axis];
+            }
+        }
+
+        IrradianceVolumeData data = {};
+        data.origin      = glm::vec4(m_bounds_min, m_settings.m_normal_bias * min_spacing);
+        data.inv_spacing = glm::vec4(glm::vec3(m_spacing.x > 0.0f ? 1.0f / m_spacing.x : 0.0f,
+                                               m_spacing.y > 0.0f ? 1.0f / m_spacing.y : 0.0f,
+                                               m_spacing.z > 0.0f ? 1.0f / m_spacing.z : 0.0f), 0.0f);
+        data.resolution  = glm::vec4(glm::vec3(m_resolution), 0.0f);
+
+        glCreateBuffers     (1, &m_volume_buffer_name);
+        glNamedBufferStorage(m_volume_buffer_name, sizeof(data), &data, 0);
+        GpuMemory::TrackBuffer(m_volume_buffer_name, "IrradianceVolume");
+
+        m_next_probe     = 0;
+        m_captured_count = 0;
+
+        return true;
+    }
+
+    void IrradianceVolume::SetEnvironmentMap(GLuint cubemap_name)
+    {
+        m_environment_map_name = cubemap_name;
+        m_environment_lod      = 0.0f;
+
+        if (cubemap_name != 0)
+        {
+            GLint size = 0;
+            glGetTextureLevelParameteriv(cubemap_name, 0, GL_TEXTURE_WIDTH, &size);
+
+            m_environment_lod = std::max(std::log2(float(size) / float(m_settings.m_capture_size)), 0.0f);
+        }
+    }
+
+    void IrradianceVolume::Update(const CaptureCallback& capture)
+    {
+        RGL_TRACE_ZONE("IrradianceVolume::Update");
+
+        if (m_volume_name == 0)
+        {
+            return;
+        }
+
+        const uint32_t probes_count = GetProbesCount();
+        const uint32_t count        = std::min(m_settings.m_probes_per_frame, probes_count);
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const glm::uvec3 probe = { m_next_probe % m_resolution.x,
+                                      (m_next_probe / m_resolution.x) % m_resolution.y,
+                                       m_next_probe / (m_resolution.x * m_resolution.y) };
+
+            CaptureProbe(capture, probe);
+            ProjectProbe(probe);
+
+            m_next_probe     = (m_next_probe + 1) % probes_count;
+            m_captured_count = std::min(m_captured_count + 1, probes_count);
+        }
+
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+        GLState::Viewport       (0, 0, Window::getWidth(), Window::getHeight());
+    }
+
+    void IrradianceVolume::Bind() const
+    {
+        GLState::BindTextureUnit(IRRADIANCE_VOLUME_UNIT, m_volume_name);
+        glBindBufferBase(GL_UNIFORM_BUFFER, IRRADIANCE_VOLUME_UBO_BINDING_INDEX, m_volume_buffer_name);
+    }
+
+    void IrradianceVolume::Release()
+    {
+        for (GLuint* name : { &m_volume_name, &m_capture_map_name, &m_capture_depth_name })
+        {
+            if (*name != 0)
+            {
+                GpuMemory::UntrackTexture(*name);
+                glDeleteTextures(1, name);
+                GLState::OnTextureDeleted(*name);
+                *name = 0;
+            }
+        }
+
+        if (m_fbo_name != 0)
+        {
+            glDeleteFramebuffers(1, &m_fbo_name);
+            GLState::OnFramebufferDeleted(m_fbo_name);
+            m_fbo_name = 0;
+        }
+
+        if (m_volume_buffer_name != 0)
+        {
+            GpuMemory::UntrackBuffer(m_volume_buffer_name);
+            glDeleteBuffers(1, &m_volume_buffer_name);
+            m_volume_buffer_name = 0;
+        }
+
+        m_projection_shader.reset();
+
+        m_resolution     = glm::uvec3(0);
+        m_next_probe     = 0;
+        m_captured_count = 0;
+    }
+
+    void IrradianceVolume::CaptureProbe(const CaptureCallback& capture, const glm::uvec3& probe)
+    {
+        RGL_TRACE_ZONE("Irradiance probe capture");
+
+        static const glm::vec3 directions[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1,  0 }, { 0, 0, 1 }, { 0,  0, -1 } };
+        static const glm::vec3 ups       [6] = { { 0, -1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0,  0, -1 }, { 0, -1, 0 }, { 0, -1,  0 } };
+
+        const glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, m_settings.m_near, m_settings.m_far);
+
+        CaptureView view;
+        view.m_position = m_bounds_min + glm::vec3(probe) * m_spacing;
+        view.m_probe    = probe;
+
+        for (uint32_t face = 0; face < 6; ++face)
+        {
+            view.m_view_projections[face] = projection * glm::lookAt(view.m_position, view.m_position + directions[face], ups[face]);
+        }
+
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, m_fbo_name);
+        GLState::Viewport       (0, 0, m_settings.m_capture_size, m_settings.m_capture_size);
+
+        /* Alpha 0 marks the texels the scene doesn't cover. */
+        const float clear_color[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        const float clear_depth    = 1.0f;
+
+        if (m_is_layered_rendering_supported)
+        {
+            view.m_face            = -1;
+            view.m_instances_count = 6;
+
+            glClearNamedFramebufferfv(m_fbo_name, GL_COLOR, 0, clear_color);
+            glClearNamedFramebufferfv(m_fbo_name, GL_DEPTH, 0, &clear_depth);
+
+            capture(view);
+            return;
+        }
+
+        view.m_instances_count = 1;
+
+        for (uint32_t face = 0; face < 6; ++face)
+        {
+            glNamedFramebufferTextureLayer(m_fbo_name, GL_COLOR_ATTACHMENT0, m_capture_map_name,   0, face);
+            glNamedFramebufferTextureLayer(m_fbo_name, GL_DEPTH_ATTACHMENT,  m_capture_depth_name, 0, face);
+
+            glClearNamedFramebufferfv(m_fbo_name, GL_COLOR, 0, clear_color);
+            glClearNamedFramebufferfv(m_fbo_name, GL_DEPTH, 0, &clear_depth);
+
+            view.m_face = int(face);
+            capture(view);
+        }
+    }
+
+    void IrradianceVolume::ProjectProbe(const glm::uvec3& probe)
+    {
+        RGL_TRACE_ZONE("Irradiance probe projection");
+
+        m_projection_shader->bind();
+        m_projection_shader->setUniform("u_size",                int(m_settings.m_capture_size));
+        m_projection_shader->setUniform("u_probe",               probe);
+        m_projection_shader->setUniform("u_resolution_z",        int(m_resolution.z));
+        m_projection_shader->setUniform("u_has_environment_map", int(m_environment_map_name != 0));
+        m_projection_shader->setUniform("u_environment_lod",     m_environment_lod);
+
+        GLState::BindTextureUnit(0, m_capture_map_name);
+
+        if (m_environment_map_name != 0)
+        {
+            GLState::BindTextureUnit(1, m_environment_map_name);
+        }
+
+        glBindImageTexture(0, m_volume_name, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+        /* A single group per probe, the capture is a few thousand texels. */
+        glDispatchCompute(1, 1, 1);
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+namespace RGL
+{
+    class Shader;
+
+    /*
+     * A grid of irradiance probes over the scene's bounds for the local diffuse indirect lighting. Every probe is
+     * the L2 spherical harmonics of a low resolution cubemap captured from the scene at its position, projected
+     * in a compute pass (shaders/ibl/sh_probe_projection.comp). The update cost is fixed: Update() captures
+     * m_probes_per_frame probes, cycling through the grid, so a probe is refreshed every probes / m_probes_per_frame frames.
+     *
+     * A probe is captured with a single draw of the scene into all six faces where ARB_shader_viewport_layer_array
+     * is supported - the callback draws 6 instances and its vertex shader writes gl_Layer = gl_InstanceID -
+     * and with a draw per face otherwise. The texels the scene doesn't cover take the environment of SetEnvironmentMap().
+     *
+     * The coefficients are slices of a 3D texture, the coefficient i of the probe (x, y, z) is the texel
+     * (x, y, i * resolution.z + z), so the lighting shaders filter the probes trilinearly with sampleIrradianceVolume()
+     * (shaders/irradiance_volume.glh). The probes not captured yet are zero, the shaders fall back to the global
+     * harmonics for them. Render thread only.
+     *
+     *     volume.Create(bounds_min, bounds_max, glm::uvec3(8, 4, 8));
+     *     volume.SetEnvironmentMap(ibl.GetEnvironmentMap());
+     *     ...
+     *     volume.Update([&](const IrradianceVolume::CaptureView& view) { ... render the scene ... });
+     *     volume.Bind();
+     */
+    class IrradianceVolume final
+    {
+    public:
+        struct Settings
+        {
+            uint32_t m_capture_size     = 16;    /* The faces of a capture, at most IBL_SH_SOURCE_SIZE. */
+            uint32_t m_probes_per_frame = 4;
+            float    m_normal_bias      = 0.25f; /* Of the probe spacing, the sampled point moves along the normal. */
+            float    m_near             = 0.05f;
+            float    m_far              = 200.0f;
+        };
+
+        /*
+         * What the capture callback renders: the framebuffer and the viewport are already set. A layered capture draws
+         * m_instances_count = 6 instances with m_view_projections[gl_InstanceID], a capture of one face draws
+         * a single one with m_view_projections[m_face]. The texels left at alpha 0 see the environment.
+         */
+        struct CaptureView
+        {
+            glm::mat4  m_view_projections[6];
+            glm::vec3  m_position;
+            glm::uvec3 m_probe;
+            int        m_face;             /* -1 in the layered captures. */
+            uint32_t   m_instances_count;
+        };
+
+        using CaptureCallback = std::function<void(const CaptureView& view)>;
+
+        IrradianceVolume() = default;
+        ~IrradianceVolume();
+
+        IrradianceVolume           (const IrradianceVolume&) = delete;
+        IrradianceVolume& operator=(const IrradianceVolume&) = delete;
+
+        /* The probes are spread over the bounds, resolution is their count along each axis - the corners have probes. */
+        bool Create(const glm::vec3& bounds_min, const glm::vec3& bounds_max, const glm::uvec3& resolution, const Settings& settings = Settings());
+
+        /* After Create(). The cubemap the texels of the captures not covered by the scene sample, 0 - black. */
+        void SetEnvironmentMap(GLuint cubemap_name);
+
+        /* Captures and projects the next m_probes_per_frame probes. Call it before the passes that sample the volume. */
+        void Update(const CaptureCallback& capture);
+
+        /* Marks all the probes to be captured again, the old ones are sampled until then. */
+        void Invalidate() { m_captured_count = 0; }
+
+        /* Binds the harmonics to IRRADIANCE_VOLUME_UNIT and the grid to IRRADIANCE_VOLUME_UBO_BINDING_INDEX. */
+        void Bind() const;
+
+        void     SetProbesPerFrame(uint32_t count) { m_settings.m_probes_per_frame = std::max(count, 1u); }
+        uint32_t GetProbesPerFrame() const         { return m_settings.m_probes_per_frame; }
+
+        uint32_t        GetProbesCount()  const { return m_resolution.x * m_resolution.y * m_resolution.z; }
+        bool            IsComplete()      const { return m_captured_count >= GetProbesCount(); } /* Every probe captured since Create() or Invalidate(). */
+        bool            IsLayered()       const { return m_is_layered_rendering_supported; }
+        const Settings& GetSettings()     const { return m_settings; }
+
+    private:
+        void Release();
+
+        void CaptureProbe(const CaptureCallback& capture, const glm::uvec3& probe);
+        void ProjectProbe(const glm::uvec3& probe);
+
+        Settings m_settings;
+
+        std::shared_ptr<Shader> m_projection_shader;
+
+        glm::vec3  m_bounds_min = glm::vec3(0.0f);
+        glm::vec3  m_spacing    = glm::vec3(0.0f);
+        glm::uvec3 m_resolution = glm::uvec3(0);
+
+        GLuint m_volume_name          = 0;
+        GLuint m_capture_map_name     = 0;
+        GLuint m_capture_depth_name   = 0;
+        GLuint m_fbo_name             = 0;
+        GLuint m_volume_buffer_name   = 0;
+        GLuint m_environment_map_name = 0;
+        float  m_environment_lod      = 0.0f; /* The level of the environment map of the capture's texel size. */
+
+        /* The next probe to capture, in the order of x, y, z. */
+        uint32_t m_next_probe     = 0;
+        uint32_t m_captured_count = 0;
+
+        bool m_is_layered_rendering_supported = false;
+    };
+}
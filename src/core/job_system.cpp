@@ -0,0 +1,260 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <thread>
+
+namespace RGL
+{
+    namespace
+    {
+        constexpr uint32_t EXTERNAL_THREAD = 0xFFFFFFFF;
+
+        std::vector<std::thread> g_workers;
+
+        std::mutex              g_sleep_mutex;
+        std::condition_variable g_sleep_condition;
+        std::atomic<int32_t>    g_queued_tasks_count { 0 };
+        std::atomic<uint32_t>   g_next_queue         { 0 };
+        bool                    g_is_stopping        = false;
+
+        thread_local uint32_t t_worker_index = EXTERNAL_THREAD;
+    }
+
+    std::vector<std::unique_ptr<JobSystem::Queue>> JobSystem::s_queues;
+
+    void JobSystem::Init(uint32_t workers_count)
+    {
+        if (!g_workers.empty())
+        {
+            return;
+        }
+
+        if (workers_count == 0)
+        {
+            workers_count = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+        }
+
+        g_is_stopping = false;
+
+        for (uint32_t i = 0; i < workers_count; ++i)
+        {
+            s_queues.push_back(std::make_unique<Queue>());
+        }
+
+        for (uint32_t i = 0; i < workers_count; ++i)
+        {
+            g_workers.emplace_back(&JobSystem::WorkerLoop, i);
+        }
+    }
+
+    void JobSystem::Shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lock(g_sleep_mutex);
+            g_is_stopping = true;
+        }
+        g_sleep_condition.notify_all();
+
+        for (auto& worker : g_workers)
+        {
+            worker.join();
+        }
+
+        g_workers.clear();
+        s_queues.clear();
+    }
+
+    uint32_t JobSystem::GetWorkersCount()
+    {
+        return uint32_t(g_workers.size());
+    }
+
+    void JobSystem::Run(Job job, Counter* counter, Counter* dependency)
+    {
+        if (counter)
+        {
+            counter->m_value.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        Task task { std::move(job), counter };
+
+        if (dependency)
+        {
+            std::lock_guard<std::mutex> lock(dependency->m_mutex);
+
+            if (dependency->m_value.load(std::memory_order_acquire) != 0)
+            {
+                dependency->m_continuations.push_back(std::move(task));
+                return;
+            }
+        }
+
+        Enqueue(std::move(task));
+    }
+
+    void JobSystem::Enqueue(Task&& task)
+    {
+        if (s_queues.empty())
+        {
+            Execute(task);
+            return;
+        }
+
+        /* A worker pushes to its own queue, the other threads spread the tasks over all the queues. */
+        const uint32_t queue_index = t_worker_index != EXTERNAL_THREAD ? t_worker_index : g_next_queue.fetch_add(1, std::memory_order_relaxed) % uint32_t(s_queues.size());
+
+        /* Counted before the push, so the count never drops below zero when the task is taken right away. */
+        {
+            std::lock_guard<std::mutex> lock(g_sleep_mutex);
+            g_queued_tasks_count.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(s_queues[queue_index]->m_mutex);
+            s_queues[queue_index]->m_tasks.push_back(std::move(task));
+        }
+
+        g_sleep_condition.notify_one();
+    }
+
+    bool JobSystem::TryRunOne()
+    {
+        const uint32_t queues_count = uint32_t(s_queues.size());
+
+        Task task;
+        bool has_task = false;
+
+        /* The own queue first, newest task - its data is the most likely to be in the cache. */
+        if (t_worker_index != EXTERNAL_THREAD)
+        {
+            Queue& queue = *s_queues[t_worker_index];
+            std::lock_guard<std::mutex> lock(queue.m_mutex);
+
+            if (!queue.m_tasks.empty())
+            {
+                task = std::move(queue.m_tasks.back());
+                queue.m_tasks.pop_back();
+                has_task = true;
+            }
+        }
+
+        /* Steal the oldest task of another queue. */
+        const uint32_t first = t_worker_index != EXTERNAL_THREAD ? t_worker_index + 1 : 0;
+
+        for (uint32_t i = 0; i < queues_count && !has_task; ++i)
+        {
+            Queue& queue = *s_queues[(first + i) % queues_count];
+            std::lock_guard<std::mutex> lock(queue.m_mutex);
+
+            if (!queue.m_tasks.empty())
+            {
+                task = std::move(queue.m_tasks.front());
+                queue.m_tasks.pop_front();
+                has_task = true;
+            }
+        }
+
+        if (!has_task)
+        {
+            return false;
+        }
+
+        g_queued_tasks_count.fetch_sub(1, std::memory_order_relaxed);
+        Execute(task);
+
+        return true;
+    }
+
+    void JobSystem::Execute(Task& task)
+    {
+        task.m_job();
+
+        if (task.m_counter)
+        {
+            Complete(*task.m_counter);
+        }
+    }
+
+    void JobSystem::Complete(Counter& counter)
+    {
+        std::vector<Task> continuations;
+
+        {
+            std::lock_guard<std::mutex> lock(counter.m_mutex);
+
+            if (counter.m_value.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                continuations.swap(counter.m_continuations);
+            }
+        }
+
+        /* The counter may be gone at this point, a waiter can return as soon as the mutex is released. */
+        for (auto& continuation : continuations)
+        {
+            Enqueue(std::move(continuation));
+        }
+    }
+
+    void JobSystem::Wait(Counter& counter)
+    {
+        while (!counter.IsDone())
+        {
+            if (!TryRunOne())
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        /* Completion holds the mutex while the counter drops to zero - wait until it lets go. */
+        std::lock_guard<std::mutex> lock(counter.m_mutex);
+    }
+
+    void JobSystem::ParallelFor(uint32_t begin, uint32_t end, uint32_t grain_size, const std::function<void(uint32_t, uint32_t)>& function)
+    {
+        if (begin >= end)
+        {
+            return;
+        }
+
+        grain_size = std::max(grain_size, 1u);
+
+        if (GetWorkersCount() == 0 || end - begin <= grain_size)
+        {
+            function(begin, end);
+            return;
+        }
+
+        Counter counter;
+
+        for (uint32_t chunk_begin = begin; chunk_begin < end; chunk_begin += grain_size)
+        {
+            const uint32_t chunk_end = std::min(chunk_begin + grain_size, end);
+
+            Run([&function, chunk_begin, chunk_end] { function(chunk_begin, chunk_end); }, &counter);
+        }
+
+        Wait(counter);
+    }
+
+    void JobSystem::WorkerLoop(uint32_t worker_index)
+    {
+        t_worker_index = worker_index;
+
+        while (true)
+        {
+            if (TryRunOne())
+            {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(g_sleep_mutex);
+            g_sleep_condition.wait(lock, [] { return g_is_stopping || g_queued_tasks_count.load(std::memory_order_relaxed) > 0; });
+
+            if (g_is_stopping)
+            {
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace RGL
+{
+    /*
+     * Work-stealing thread pool. Every worker owns a queue - it runs the newest of its jobs first, an idle worker
+     * steals the oldest job of another queue. The jobs submitted from the other threads are spread over the queues.
+     *
+     *     JobSystem::Counter parsed;
+     *     JobSystem::Run([&] { ParseMeshes(); }, &parsed);
+     *     JobSystem::Run([&] { CalcTangents(); }, nullptr, &parsed); // Runs when the parsing is done.
+     *     JobSystem::ParallelFor(0, count, 256, [&](uint32_t begin, uint32_t end) { ... });
+     *     JobSystem::Wait(parsed);
+     *
+     * Wait() runs the queued jobs until the counter reaches zero, so the jobs can wait for other jobs too.
+     * Without the workers (not initialized, or a single core machine) the jobs run on the submitting thread.
+     */
+    class JobSystem
+    {
+    public:
+        using Job = std::function<void()>;
+
+        class Counter;
+
+    private:
+        struct Task
+        {
+            Job      m_job;
+            Counter* m_counter;
+        };
+
+        struct Queue
+        {
+            std::mutex       m_mutex;
+            std::deque<Task> m_tasks;
+        };
+
+    public:
+        /* Unfinished jobs of a group. Has to outlive its jobs - Wait() for it before it goes out of scope. */
+        class Counter
+        {
+        public:
+            Counter() : m_value(0) {}
+
+            Counter           (const Counter&) = delete;
+            Counter& operator=(const Counter&) = delete;
+
+            bool IsDone() const { return m_value.load(std::memory_order_acquire) == 0; }
+
+        private:
+            friend class JobSystem;
+
+            std::atomic<uint32_t> m_value;
+            std::mutex            m_mutex;         /* Guards the continuations and the drop to zero. */
+            std::vector<Task>     m_continuations; /* Jobs that depend on this counter. */
+        };
+
+        /* 0 workers means one less than the hardware threads, the submitting thread helps in Wait(). */
+        static void     Init(uint32_t workers_count = 0);
+
+        /* The jobs still queued are dropped - wait for them first. */
+        static void     Shutdown();
+        static uint32_t GetWorkersCount();
+
+        /* The counter is incremented immediately, the job is queued when the dependency (if any) reaches zero. */
+        static void Run(Job job, Counter* counter = nullptr, Counter* dependency = nullptr);
+
+        static void Wait(Counter& counter);
+
+        /* Calls function(chunk_begin, chunk_end) for the chunks of [begin, end) in parallel and waits for all of them. */
+        static void ParallelFor(uint32_t begin, uint32_t end, uint32_t grain_size, const std::function<void(uint32_t, uint32_t)>& function);
+
+    private:
+        static void Enqueue  (Task&& task);
+        static bool TryRunOne();
+        static void Execute  (Task& task);
+        static void Complete (Counter& counter);
+        static void WorkerLoop(uint32_t worker_index);
+
+        static std::vector<std::unique_ptr<Queue>> s_queues;
+    };
+}
@@ -0,0 +1,295 @@
+#include "lazy_resource.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+#include "job_system.h"
+#include "static_model.h"
+#include "texture.h"
+#include "texture_cache.h"
+#include "timer.h"
+#include "trace.h"
+#include "util.h"
+
+namespace RGL
+{
+    bool LazyResource::Request()
+    {
+        if (m_state != State::READY && (m_state != State::LOADING || !m_is_requested))
+        {
+            ResourcePreloader::Request(shared_from_this());
+        }
+
+        return IsReady();
+    }
+
+    LazyModel::LazyModel(const std::filesystem::path& filepath, std::function<void(StaticModel&)> setup)
+        : LazyResource(filepath.filename().string()),
+          m_filepath  (filepath),
+          m_setup     (std::move(setup)),
+          m_model     (std::make_unique<StaticModel>())
+    {
+    }
+
+    LazyModel::~LazyModel() = default;
+
+    bool LazyModel::Start()
+    {
+        if (m_setup)
+        {
+            m_setup(*m_model);
+        }
+
+        return m_model->LoadAsync(m_filepath);
+    }
+
+    LazyResource::State LazyModel::Advance(uint32_t& /*budget*/)
+    {
+        if (m_model->UpdateAsyncLoad(ResourcePreloader::GetBudget()))
+        {
+            return State::READY;
+        }
+
+        return m_model->IsLoadFailed() ? State::FAILED : State::LOADING;
+    }
+
+    struct LazyTexture::DecodedImage
+    {
+        ~DecodedImage() { Util::ReleaseTextureData(m_data); }
+
+        /* Written by the decoding job until m_is_decoded is set. */
+        ImageData        m_metadata;
+        unsigned char*   m_data = nullptr;
+        std::atomic_bool m_is_decoded { false };
+    };
+
+    LazyTexture::LazyTexture(const std::filesystem::path& filepath, bool is_srgb, uint32_t num_mipmaps, MipmapFilter mipmap_filter)
+        : LazyResource   (filepath.filename().string()),
+          m_filepath     (filepath),
+          m_is_srgb      (is_srgb),
+          m_num_mipmaps  (num_mipmaps),
+          m_mipmap_filter(mipmap_filter)
+    {
+    }
+
+    bool LazyTexture::Start()
+    {
+        m_texture = TextureCache::Find(m_filepath, m_is_srgb, m_num_mipmaps, m_mipmap_filter);
+
+        if (m_texture || !Texture2D::IsDecodedOnLoad(m_filepath))
+        {
+            return true;
+        }
+
+        m_decoded = std::make_shared<DecodedImage>();
+
+        JobSystem::Run([decoded = m_decoded, filepath = m_filepath]
+        {
+            decoded->m_data = Util::LoadTextureData(filepath, decoded->m_metadata);
+            decoded->m_is_decoded.store(true, std::memory_order_release);
+        });
+
+        return true;
+    }
+
+    LazyResource::State LazyTexture::Advance(uint32_t& budget)
+    {
+        if (m_texture)
+        {
+            return State::READY;
+        }
+
+        /* The .ktx2 files and the streamed textures - both are cheap to start. */
+        if (!m_decoded)
+        {
+            m_texture = TextureCache::Load(m_filepath, m_is_srgb, m_num_mipmaps, m_mipmap_filter);
+            return m_texture ? State::READY : State::FAILED;
+        }
+
+        if (!m_decoded->m_is_decoded.load(std::memory_order_acquire) || budget == 0)
+        {
+            return State::LOADING;
+        }
+
+        auto decoded = std::move(m_decoded);
+
+        if (!decoded->m_data)
+        {
+            fprintf(stderr, "LazyTexture: texture failed to load at path: %s\n", m_filepath.string().c_str());
+            return State::FAILED;
+        }
+
+        auto texture = std::make_shared<Texture2D>();
+
+        if (!texture->Create(decoded->m_metadata, decoded->m_data, m_is_srgb, m_num_mipmaps, m_mipmap_filter))
+        {
+            return State::FAILED;
+        }
+
+        /* The mip chain adds a third. */
+        const uint64_t size = uint64_t(decoded->m_metadata.width) * decoded->m_metadata.height * decoded->m_metadata.channels * 4 / 3;
+
+        budget    = uint32_t(std::max<int64_t>(int64_t(budget) - int64_t(size), 0));
+        m_texture = TextureCache::Add(m_filepath, m_is_srgb, m_num_mipmaps, m_mipmap_filter, texture);
+
+        return State::READY;
+    }
+
+    uint32_t                                   ResourcePreloader::s_budget = ResourcePreloader::DEFAULT_BUDGET;
+    std::vector<std::shared_ptr<LazyResource>> ResourcePreloader::s_loading;
+    std::deque<std::weak_ptr<LazyResource>>    ResourcePreloader::s_preloads;
+
+    void ResourcePreloader::Request(const std::shared_ptr<LazyResource>& resource)
+    {
+        Start(resource, true /* is_requested */);
+    }
+
+    void ResourcePreloader::Preload(const std::shared_ptr<LazyResource>& resource)
+    {
+        if (resource->m_state == LazyResource::State::UNLOADED)
+        {
+            s_preloads.push_back(resource);
+        }
+    }
+
+    void ResourcePreloader::Start(const std::shared_ptr<LazyResource>& resource, bool is_requested)
+    {
+        using State = LazyResource::State;
+
+        if (resource->m_state == State::LOADING && is_requested && !resource->m_is_requested)
+        {
+            resource->m_is_requested = true;
+
+            for (auto& dependency : resource->m_dependencies)
+            {
+                Start(dependency, true);
+            }
+
+            return;
+        }
+
+        if (resource->m_state != State::UNLOADED)
+        {
+            return;
+        }
+
+        resource->m_state        = State::LOADING;
+        resource->m_is_requested = is_requested;
+        resource->m_start_time   = Timer::getTime();
+
+        /* The dependencies go before the resource, so they are advanced first. */
+        for (auto& dependency : resource->m_dependencies)
+        {
+            Start(dependency, is_requested);
+        }
+
+        if (!resource->Start())
+        {
+            fprintf(stderr, "ResourcePreloader: could not start loading %s.\n", resource->m_name.c_str());
+
+            resource->m_state = State::FAILED;
+            return;
+        }
+
+        s_loading.push_back(resource);
+    }
+
+    void ResourcePreloader::Update()
+    {
+        using State = LazyResource::State;
+
+        if (s_loading.empty() && s_preloads.empty())
+        {
+            return;
+        }
+
+        RGL_TRACE_ZONE("Resource preloading");
+
+        const bool is_request_loading = std::any_of(s_loading.begin(), s_loading.end(), [](const auto& resource) { return resource->m_is_requested; });
+        uint32_t   preloads_count     = uint32_t(std::count_if(s_loading.begin(), s_loading.end(), [](const auto& resource) { return !resource->m_is_requested; }));
+
+        while (!is_request_loading && preloads_count < MAX_PRELOADS_IN_FLIGHT && !s_preloads.empty())
+        {
+            auto resource = s_preloads.front().lock();
+            s_preloads.pop_front();
+
+            if (resource && resource->m_state == State::UNLOADED)
+            {
+                Start(resource, false /* is_requested */);
+                preloads_count++;
+            }
+        }
+
+        /* Stable, the dependencies stay in front of the resources that need them. */
+        std::stable_partition(s_loading.begin(), s_loading.end(), [](const auto& resource) { return resource->m_is_requested; });
+
+        uint32_t budget = s_budget;
+
+        for (auto& resource : s_loading)
+        {
+            if (resource->m_is_loaded)
+            {
+                continue;
+            }
+
+            const State state = resource->Advance(budget);
+
+            if (state == State::FAILED)
+            {
+                fprintf(stderr, "ResourcePreloader: could not load %s.\n", resource->m_name.c_str());
+                resource->m_state = State::FAILED;
+            }
+
+            resource->m_is_loaded = state == State::READY;
+        }
+
+        std::vector<std::shared_ptr<LazyResource>> ready_resources;
+
+        for (auto& resource : s_loading)
+        {
+            if (resource->m_state != State::LOADING || !resource->m_is_loaded)
+            {
+                continue;
+            }
+
+            bool is_ready = true;
+
+            for (auto& dependency : resource->m_dependencies)
+            {
+                if (dependency->m_state == State::FAILED)
+                {
+                    fprintf(stderr, "ResourcePreloader: could not load %s, its dependency %s failed.\n", resource->m_name.c_str(), dependency->m_name.c_str());
+                    resource->m_state = State::FAILED;
+                }
+
+                is_ready = is_ready && dependency->m_state == State::READY;
+            }
+
+            if (is_ready && resource->m_state == State::LOADING)
+            {
+                resource->m_state        = State::READY;
+                resource->m_load_seconds = Timer::getTime() - resource->m_start_time;
+
+                ready_resources.push_back(resource);
+            }
+        }
+
+        std::erase_if(s_loading, [](const auto& resource) { return resource->m_state != State::LOADING; });
+
+        /* After the erase, a callback may request other resources. */
+        for (auto& resource : ready_resources)
+        {
+            if (resource->m_on_ready)
+            {
+                resource->m_on_ready();
+            }
+        }
+    }
+
+    void ResourcePreloader::Release()
+    {
+        s_loading.clear();
+        s_preloads.clear();
+    }
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mipmap_generator.h"
+
+namespace RGL
+{
+    class StaticModel;
+    class Texture2D;
+
+    /*
+     * A demo resource loaded on its first use instead of in init_app(), so the first frame doesn't wait for the scenes
+     * that aren't shown yet. Request() starts the load and returns whether the resource is ready - until then
+     * the caller skips its draws or draws a placeholder. The loads go through the asynchronous loaders: the models
+     * through StaticModel::LoadAsync(), the images are decoded by the JobSystem's workers and created on the render thread.
+     *
+     * A resource is ready once its own data and all its dependencies are, then its SetOnReady() callback runs on the render
+     * thread - e.g. a model's AddTexture() calls with its textures as the dependencies. A plain LazyResource has no data
+     * of its own, it's a group of the resources of a scene. The resources have to be owned by a std::shared_ptr.
+     *
+     *     m_pistol = std::make_shared<RGL::LazyModel>(path);
+     *     m_pistol->AddDependency(albedo_map);
+     *     m_pistol->SetOnReady([=] { m_pistol->GetModel()->AddTexture(albedo_map->Get()); });
+     *     RGL::ResourcePreloader::Preload(m_pistol);    // Likely needed next, loaded in the background.
+     *     ...
+     *     if (auto model = m_pistol->Get()) model->Render();
+     */
+    class LazyResource : public std::enable_shared_from_this<LazyResource>
+    {
+    public:
+        enum class State { UNLOADED, LOADING, READY, FAILED };
+
+        explicit LazyResource(std::string name = "group") : m_name(std::move(name)) {}
+        virtual ~LazyResource() = default;
+
+        LazyResource           (const LazyResource&) = delete;
+        LazyResource& operator=(const LazyResource&) = delete;
+
+        /* Before the load starts. Requesting or preloading the resource does the same to its dependencies. */
+        void AddDependency(std::shared_ptr<LazyResource> dependency) { m_dependencies.push_back(std::move(dependency)); }
+        void SetOnReady   (std::function<void()> callback)          { m_on_ready = std::move(callback); }
+
+        /* Starts the load ahead of the preloads, or moves a preloading resource ahead of them. Returns IsReady(). */
+        bool Request();
+
+        State              GetState()       const { return m_state; }
+        bool               IsReady()        const { return m_state == State::READY; }
+        const std::string& GetName()        const { return m_name; }
+        double             GetLoadSeconds() const { return m_load_seconds; } /* From the start of the load to ready. */
+
+    protected:
+        friend class ResourcePreloader;
+
+        /*
+         * Render thread. Start() kicks off the asynchronous work and returns false if it can't, Advance() continues it -
+         * the uploads take their bytes from budget - and returns READY once the resource's own data is loaded.
+         */
+        virtual bool  Start()                  { return true; }
+        virtual State Advance(uint32_t& budget) { return State::READY; }
+
+    private:
+        std::string                                m_name;
+        std::vector<std::shared_ptr<LazyResource>> m_dependencies;
+        std::function<void()>                      m_on_ready;
+
+        State  m_state        = State::UNLOADED;
+        bool   m_is_loaded    = false; /* The own data, the dependencies may still be loading. */
+        bool   m_is_requested = false;
+        double m_start_time   = 0.0;
+        double m_load_seconds = 0.0;
+    };
+
+    /* Through StaticModel::LoadAsync(). The options of the model (SetVertexFormat(), SetMeshOptimization()...) are set by setup before the load. */
+    class LazyModel : public LazyResource
+    {
+    public:
+        explicit LazyModel(const std::filesystem::path& filepath, std::function<void(StaticModel&)> setup = {});
+        ~LazyModel() override;
+
+        /* Request()s the model, nullptr until it's ready. */
+        StaticModel* Get() { return Request() ? m_model.get() : nullptr; }
+
+        /* The model whether it's ready or not, for the SetOnReady() callback. */
+        StaticModel* GetModel() const { return m_model.get(); }
+
+    protected:
+        bool  Start()                   override;
+        State Advance(uint32_t& budget) override;
+
+    private:
+        std::filesystem::path             m_filepath;
+        std::function<void(StaticModel&)> m_setup;
+        std::unique_ptr<StaticModel>      m_model; /* Not movable while it's loading. */
+    };
+
+    /*
+     * Through TextureCache - a cached texture is ready at once. The images Texture2D::Load() would decode itself are decoded
+     * by a job and created within the budget, the .ktx2 files and the streamed textures are loaded as Load() does.
+     */
+    class LazyTexture : public LazyResource
+    {
+    public:
+        explicit LazyTexture(const std::filesystem::path& filepath, bool is_srgb = false, uint32_t num_mipmaps = 0, MipmapFilter mipmap_filter = MipmapFilter::COLOR);
+
+        /* Request()s the texture, nullptr until it's ready. */
+        std::shared_ptr<Texture2D> Get() { return Request() ? m_texture : nullptr; }
+
+    protected:
+        bool  Start()                   override;
+        State Advance(uint32_t& budget) override;
+
+    private:
+        struct DecodedImage;
+
+        std::filesystem::path         m_filepath;
+        bool                          m_is_srgb;
+        uint32_t                      m_num_mipmaps;
+        MipmapFilter                  m_mipmap_filter;
+        std::shared_ptr<DecodedImage> m_decoded; /* Shared with the decoding job, the texture may be released before it's done. */
+        std::shared_ptr<Texture2D>    m_texture;
+    };
+
+    /*
+     * Advances the loads of the LazyResources once per frame - CoreApp calls Update() on the render thread. The requested
+     * resources go first. The preloads - the resources the demo expects to need next, e.g. the other scenes of its combo -
+     * start in the order of Preload() calls, at most MAX_PRELOADS_IN_FLIGHT at a time and only while nothing requested
+     * is loading, so they use the frames the demo doesn't wait in.
+     *
+     * The textures created in a frame take at most GetBudget() bytes together, a texture bigger than that gets a frame
+     * of its own. A model uploads at most GetBudget() bytes per frame through its own staging buffer.
+     */
+    class ResourcePreloader
+    {
+    public:
+        static constexpr uint32_t DEFAULT_BUDGET         = 16 << 20;
+        static constexpr uint32_t MAX_PRELOADS_IN_FLIGHT = 2;
+
+        static void     SetBudget(uint32_t bytes) { s_budget = bytes; }
+        static uint32_t GetBudget()               { return s_budget; }
+
+        static void Request(const std::shared_ptr<LazyResource>& resource);
+        static void Preload(const std::shared_ptr<LazyResource>& resource);
+
+        static uint32_t GetLoadingCount()  { return uint32_t(s_loading.size()); }
+        static uint32_t GetPreloadsCount() { return uint32_t(s_preloads.size()); }
+
+        static void Update();
+
+        /* Drops the loads in flight and the queued preloads. Called before the context is destroyed. */
+        static void Release();
+
+    private:
+        static void Start(const std::shared_ptr<LazyResource>& resource, bool is_requested);
+
+        static uint32_t                                   s_budget;
+        static std::vector<std::shared_ptr<LazyResource>> s_loading;
+        static std::deque<std::weak_ptr<LazyResource>>    s_preloads;
+    };
+}
@@ -0,0 +1,194 @@
+#include "mapped_file.h"
+
+#include <cstdio>
+#include <utility>
+
+#include "filesystem.h"
+#include "pak_file.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace RGL
+{
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Close();
+
+            std::swap(m_data,      other.m_data);
+            std::swap(m_size,      other.m_size);
+            std::swap(m_is_open,   other.m_is_open);
+            std::swap(m_is_mapped, other.m_is_mapped);
+            std::swap(m_buffer,    other.m_buffer);
+#ifdef _WIN32
+            std::swap(m_file,    other.m_file);
+            std::swap(m_mapping, other.m_mapping);
+#endif
+        }
+
+        return *this;
+    }
+
+    bool MappedFile::Open(const std::filesystem::path& filepath)
+    {
+        const PakFile*  pak;
+        const PakEntry* entry;
+
+        if (!FileSystem::findInPaks(filepath, pak, entry))
+        {
+            return OpenFromDisk(filepath);
+        }
+
+        Close();
+
+        if (entry->m_compression == PakCompression::NONE)
+        {
+            m_data = pak->GetStoredData(*entry).data();
+        }
+        else
+        {
+            m_buffer.reset(new uint8_t[size_t(entry->m_size)]);
+
+            if (!pak->Read(*entry, m_buffer.get()))
+            {
+                m_buffer.reset();
+                return false;
+            }
+
+            m_data = m_buffer.get();
+        }
+
+        m_size    = size_t(entry->m_size);
+        m_is_open = true;
+
+        return true;
+    }
+
+    bool MappedFile::OpenFromDisk(const std::filesystem::path& filepath)
+    {
+        Close();
+
+#ifdef _WIN32
+        HANDLE file = CreateFileW(filepath.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            fprintf(stderr, "Could not open file %s\n", filepath.string().c_str());
+            return false;
+        }
+
+        LARGE_INTEGER size;
+
+        if (!GetFileSizeEx(file, &size))
+        {
+            fprintf(stderr, "Could not get the size of file %s\n", filepath.string().c_str());
+            CloseHandle(file);
+            return false;
+        }
+
+        m_file    = file;
+        m_size    = size_t(size.QuadPart);
+        m_is_open = true;
+
+        /* Empty files can't be mapped. */
+        if (m_size == 0)
+        {
+            return true;
+        }
+
+        m_mapping   = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        m_data      = m_mapping ? static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+        m_is_mapped = m_data != nullptr;
+#else
+        int file = open(filepath.c_str(), O_RDONLY);
+
+        if (file < 0)
+        {
+            fprintf(stderr, "Could not open file %s\n", filepath.string().c_str());
+            return false;
+        }
+
+        struct stat info;
+
+        if (fstat(file, &info) != 0)
+        {
+            fprintf(stderr, "Could not get the size of file %s\n", filepath.string().c_str());
+            close(file);
+            return false;
+        }
+
+        m_size    = size_t(info.st_size);
+        m_is_open = true;
+
+        /* Empty files can't be mapped. */
+        if (m_size == 0)
+        {
+            close(file);
+            return true;
+        }
+
+        void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+        /* The mapping keeps its own reference to the file. */
+        close(file);
+
+        if (data != MAP_FAILED)
+        {
+            /* The assets are mostly read front to back. */
+            madvise(data, m_size, MADV_SEQUENTIAL);
+            m_data      = static_cast<const uint8_t*>(data);
+            m_is_mapped = true;
+        }
+#endif
+
+        if (!m_data)
+        {
+            fprintf(stderr, "Could not map file %s\n", filepath.string().c_str());
+            Close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+#ifdef _WIN32
+        if (m_is_mapped) UnmapViewOfFile(m_data);
+        if (m_mapping)   CloseHandle(m_mapping);
+        if (m_file)      CloseHandle(m_file);
+
+        m_file    = nullptr;
+        m_mapping = nullptr;
+#else
+        if (m_is_mapped)
+        {
+            munmap(const_cast<uint8_t*>(m_data), m_size);
+        }
+#endif
+
+        m_buffer.reset();
+
+        m_data      = nullptr;
+        m_size      = 0;
+        m_is_open   = false;
+        m_is_mapped = false;
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string_view>
+
+namespace RGL
+{
+    /*
+     * Read-only memory mapping of a whole file (mmap / CreateFileMapping). The view is valid until the file
+     * is closed, the pages are read in by the OS on the first access, so nothing is copied up front.
+     * The files of the mounted paks (see FileSystem::mountPak()) are views of the pak's mapping, the compressed
+     * ones are decompressed into a buffer of the MappedFile.
+     *
+     *     MappedFile file(filepath);
+     *     if (file.IsOpen()) stbi_load_from_memory(file.GetData(), int(file.GetSize()), ...);
+     */
+    class MappedFile final
+    {
+    public:
+        MappedFile() = default;
+        explicit MappedFile(const std::filesystem::path& filepath) { Open(filepath); }
+        ~MappedFile() { Close(); }
+
+        MappedFile           (const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        /* The path is used as is. An empty file opens successfully, with an empty view. */
+        bool Open(const std::filesystem::path& filepath);
+
+        /* Open() bypassing the mounted paks. */
+        bool OpenFromDisk(const std::filesystem::path& filepath);
+        void Close();
+
+        bool                     IsOpen()  const { return m_is_open; }
+        const uint8_t*           GetData() const { return m_data; }
+        size_t                   GetSize() const { return m_size; }
+        std::span<const uint8_t> GetView() const { return { m_data, m_size }; }
+        std::string_view         GetText() const { return { reinterpret_cast<const char*>(m_data), m_size }; }
+
+    private:
+        const uint8_t*             m_data      = nullptr;
+        size_t                     m_size      = 0;
+        bool                       m_is_open   = false;
+        bool                       m_is_mapped = false; /* Unmapped by Close(), not the paks' views. */
+        std::unique_ptr<uint8_t[]> m_buffer;            /* Of the compressed pak entries. */
+
+#ifdef _WIN32
+        void*          m_file    = nullptr; /* HANDLE */
+        void*          m_mapping = nullptr; /* HANDLE */
+#endif
+    };
+}
@@ -1,85 +1,213 @@
 #include "material.h"
+#include "gpu_memory.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
 
 namespace RGL
 {
+    namespace
+    {
+        /* The global materials SSBO. The entries of the destroyed materials are reused. */
+        struct MaterialsBuffer
+        {
+            std::vector<MaterialData> m_materials;
+            std::vector<uint32_t>     m_free_indices;
+            GLuint                    m_buffer_name = 0;
+            uint32_t                  m_capacity    = 0;
+            uint32_t                  m_dirty_first = UINT32_MAX;
+            uint32_t                  m_dirty_last  = 0;
+        };
+
+        MaterialsBuffer& GetMaterialsBuffer()
+        {
+            static MaterialsBuffer buffer;
+            return buffer;
+        }
+
+        const char* const HAS_MAP_UNIFORMS[MATERIAL_TEXTURES_COUNT] =
+        {
+            "u_has_albedo_map", "u_has_normal_map", "u_has_metallic_map", "u_has_roughness_map", "u_has_ao_map", "u_has_emissive_map"
+        };
+    }
+
     Material::Material()
+        : m_data {}
     {
-        AddVector3("u_albedo",            glm::vec3(1.0f));
-        AddVector3("u_emission",          glm::vec3(0.0f));
-        AddFloat  ("u_ao",                1.0f);
-        AddFloat  ("u_roughness",         0.0f);
-        AddFloat  ("u_metallic",          0.0f);
-        AddBool   ("u_has_albedo_map",    false);
-        AddBool   ("u_has_normal_map",    false);
-        AddBool   ("u_has_emissive_map",  false);
-        AddBool   ("u_has_ao_map",        false);
-        AddBool   ("u_has_metallic_map",  false);
-        AddBool   ("u_has_roughness_map", false);
+        m_data.albedo = glm::vec3(1.0f);
+        m_data.ao     = 1.0f;
+
+        auto& buffer = GetMaterialsBuffer();
+
+        if (!buffer.m_free_indices.empty())
+        {
+            m_index = buffer.m_free_indices.back();
+            buffer.m_free_indices.pop_back();
+        }
+        else
+        {
+            m_index = uint32_t(buffer.m_materials.size());
+            buffer.m_materials.emplace_back();
+        }
+
+        Update();
     }
 
     Material::~Material()
     {
+        GetMaterialsBuffer().m_free_indices.push_back(m_index);
     }
 
     void Material::AddTexture(TextureType texture_type, const std::shared_ptr<Texture2D>& texture)
     {
-        m_texture_map[texture_type] = texture;
+        m_textures[uint32_t(texture_type)] = texture;
     }
 
-    void Material::AddVector3(const std::string& uniform_name, const glm::vec3& vector3)
+    void Material::SetAlbedo(const glm::vec3& albedo)
     {
-        m_vec3_map[uniform_name] = vector3;
+        m_data.albedo = albedo;
+        Update();
     }
 
-    void Material::AddFloat(const std::string& uniform_name, float value)
+    void Material::SetEmission(const glm::vec3& emission)
     {
-        m_float_map[uniform_name] = value;
+        m_data.emission = emission;
+        Update();
     }
 
-    void Material::AddBool(const std::string& uniform_name, bool value)
+    void Material::SetAo(float ao)
     {
-        m_bool_map[uniform_name] = value;
+        m_data.ao = ao;
+        Update();
     }
 
-    std::shared_ptr<Texture2D> Material::GetTexture(TextureType texture_type)
+    void Material::SetRoughness(float roughness)
     {
-        if (m_texture_map.contains(texture_type))
-        {
-            return m_texture_map[texture_type];
-        }
+        m_data.roughness = roughness;
+        Update();
+    }
+
+    void Material::SetMetallic(float metallic)
+    {
+        m_data.metallic = metallic;
+        Update();
+    }
+
+    void Material::SetHasMap(TextureType texture_type, bool has_map)
+    {
+        const uint32_t flag = 1u << uint32_t(texture_type);
+
+        m_data.flags = has_map ? (m_data.flags | flag) : (m_data.flags & ~flag);
+        Update();
+    }
+
+    void Material::SetAlphaMasked(bool is_alpha_masked)
+    {
+        m_data.flags = is_alpha_masked ? (m_data.flags | MATERIAL_ALPHA_MASKED) : (m_data.flags & ~MATERIAL_ALPHA_MASKED);
+        Update();
+    }
 
-        assert(false && "Couldn't find texture with the specified texture type!");
+    std::shared_ptr<Texture2D> Material::GetTexture(TextureType texture_type) const
+    {
+        return m_textures[uint32_t(texture_type)];
+    }
 
-        return nullptr;
+    bool Material::HasMap(TextureType texture_type) const
+    {
+        return (m_data.flags & (1u << uint32_t(texture_type))) != 0;
     }
-    
-    glm::vec3 Material::GetVector3(const std::string& uniform_name)
+
+    void Material::MakeTexturesResident()
     {
-        if (m_vec3_map.contains(uniform_name))
+        for (uint32_t i = 0; i < MATERIAL_TEXTURES_COUNT; ++i)
         {
-            return m_vec3_map[uniform_name];
+            if (m_textures[i])
+            {
+                m_textures[i]->MakeResident();
+                m_data.texture_handles[i] = m_textures[i]->GetBindlessHandle();
+            }
         }
 
-        return glm::vec3(0.0f);
+        Update();
+    }
+
+    void Material::Bind() const
+    {
+        for (uint32_t i = 0; i < MATERIAL_TEXTURES_COUNT; ++i)
+        {
+            if (m_textures[i])
+            {
+                m_textures[i]->Bind(i);
+            }
+        }
     }
 
-    float Material::GetFloat(const std::string& uniform_name)
+    void Material::SetUniforms(Shader& shader) const
     {
-        if (m_float_map.contains(uniform_name))
+        if (const UniformLocation location = shader.getUniformLocation("u_material_index"); location.isValid())
+        {
+            shader.setUniform(location, m_index);
+            return;
+        }
+
+        shader.setUniform("u_albedo",    m_data.albedo);
+        shader.setUniform("u_emission",  m_data.emission);
+        shader.setUniform("u_ao",        m_data.ao);
+        shader.setUniform("u_roughness", m_data.roughness);
+        shader.setUniform("u_metallic",  m_data.metallic);
+
+        for (uint32_t i = 0; i < MATERIAL_TEXTURES_COUNT; ++i)
         {
-            return m_float_map[uniform_name];
+            shader.setUniform(HAS_MAP_UNIFORMS[i], int((m_data.flags >> i) & 1u));
         }
+    }
+
+    void Material::Update()
+    {
+        auto& buffer = GetMaterialsBuffer();
 
-        return 0.0f;
+        buffer.m_materials[m_index] = m_data;
+        buffer.m_dirty_first        = std::min(buffer.m_dirty_first, m_index);
+        buffer.m_dirty_last         = std::max(buffer.m_dirty_last,  m_index);
     }
 
-    bool Material::GetBool(const std::string& uniform_name)
+    void Material::BindMaterials()
     {
-        if (m_bool_map.contains(uniform_name))
+        auto& buffer = GetMaterialsBuffer();
+
+        if (buffer.m_materials.empty())
+        {
+            return;
+        }
+
+        /* The storage is immutable - grow by recreating the buffer and uploading everything. */
+        if (buffer.m_materials.size() > buffer.m_capacity)
         {
-            return m_bool_map[uniform_name];
+            GpuMemory::UntrackBuffer(buffer.m_buffer_name);
+            glDeleteBuffers(1, &buffer.m_buffer_name);
+
+            buffer.m_capacity    = std::max<uint32_t>(uint32_t(buffer.m_materials.size()), buffer.m_capacity * 2);
+            buffer.m_dirty_first = 0;
+            buffer.m_dirty_last  = uint32_t(buffer.m_materials.size() - 1);
+
+            glCreateBuffers     (1, &buffer.m_buffer_name);
+            glNamedBufferStorage(buffer.m_buffer_name, sizeof(MaterialData) * buffer.m_capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+            GpuMemory::TrackBuffer(buffer.m_buffer_name, "Material");
+        }
+
+        if (buffer.m_dirty_first <= buffer.m_dirty_last)
+        {
+            glNamedBufferSubData(buffer.m_buffer_name,
+                                 sizeof(MaterialData) * buffer.m_dirty_first,
+                                 sizeof(MaterialData) * (buffer.m_dirty_last - buffer.m_dirty_first + 1),
+                                 &buffer.m_materials[buffer.m_dirty_first]);
+
+            buffer.m_dirty_first = UINT32_MAX;
+            buffer.m_dirty_last  = 0;
         }
 
-        return false;
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIALS_SSBO_BINDING_INDEX, buffer.m_buffer_name);
     }
-}
\ No newline at end of file
+}
@@ -1,9 +1,17 @@
 #pragma once
-#include <map>
+#include <glm/glm.hpp>
+#include "core_shared.h"
 #include "texture.h"
 
 namespace RGL
 {
+    class Shader;
+
+    /*
+     * Flat material: the parameters are a MaterialData POD (see core_shared.h) and the textures a fixed array.
+     * Every material owns an entry in a global SSBO, bound with BindMaterials() at MATERIALS_SSBO_BINDING_INDEX,
+     * so a shader can fetch the whole material with a single index - materials[u_material_index].
+     */
     class Material
     {
     public:
@@ -14,22 +22,46 @@ namespace RGL
         Material();
         ~Material();
 
+        Material(const Material&)            = delete;
+        Material& operator=(const Material&) = delete;
+
         void AddTexture(TextureType texture_type, const std::shared_ptr<Texture2D>& texture);
-        void AddVector3(const std::string& uniform_name, const glm::vec3& vector3);
-        void AddFloat  (const std::string& uniform_name, float value);
-        void AddBool   (const std::string& uniform_name, bool value);
 
-        std::shared_ptr<Texture2D> GetTexture(TextureType texture_type);
-        glm::vec3                  GetVector3(const std::string& uniform_name);
-        float                      GetFloat  (const std::string& uniform_name);
-        bool                       GetBool   (const std::string& uniform_name);
+        void SetAlbedo   (const glm::vec3& albedo);
+        void SetEmission (const glm::vec3& emission);
+        void SetAo       (float ao);
+        void SetRoughness(float roughness);
+        void SetMetallic (float metallic);
+        void SetHasMap   (TextureType texture_type, bool has_map);
+        void SetAlphaMasked(bool is_alpha_masked);
+
+        std::shared_ptr<Texture2D> GetTexture(TextureType texture_type) const;
+        bool                       HasMap    (TextureType texture_type) const;
+        bool                       IsAlphaMasked()                      const { return (m_data.flags & MATERIAL_ALPHA_MASKED) != 0; }
+
+        const MaterialData& GetData()  const { return m_data; }
+        uint32_t            GetIndex() const { return m_index; }
+
+        /* Makes the textures resident and stores their ARB_bindless_texture handles in the material's data. */
+        void MakeTexturesResident();
+
+        /* Binds the textures to the units of their TextureType. */
+        void Bind() const;
+
+        /*
+         * Per draw material setup of the uniform based shaders. If the shader declares u_material_index
+         * only the index is set, otherwise the u_albedo, u_has_albedo_map, ... uniforms.
+         */
+        void SetUniforms(Shader& shader) const;
+
+        /* Uploads the modified materials and binds the SSBO at MATERIALS_SSBO_BINDING_INDEX. */
+        static void BindMaterials();
 
     private:
-        std::map<TextureType, std::shared_ptr<Texture2D>> m_texture_map;
-        std::map<std::string, glm::vec3>                  m_vec3_map;
-        std::map<std::string, float>                      m_float_map;
-        std::map<std::string, bool>                       m_bool_map;
+        void Update();
 
-        friend class StaticModel;
+        MaterialData               m_data;
+        std::shared_ptr<Texture2D> m_textures[MATERIAL_TEXTURES_COUNT];
+        uint32_t                   m_index;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,851 @@
+#include "mesh_bvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RGL_BVH_SSE 1
+#include <emmintrin.h>
+#endif
+
+#include "job_system.h"
+#include "trace.h"
+
+namespace RGL
+{
+    namespace
+    {
+        constexpr uint32_t SAH_BINS                = 12;
+        constexpr uint32_t MAX_DEPTH               = 64;   /* Also the traversal stack size, the deeper nodes become leaves. */
+        constexpr uint32_t PARALLEL_MIN_PRIMITIVES = 4096; /* Smaller subtrees are built by the job that split their parent. */
+        constexpr float    TRAVERSAL_COST          = 1.0f; /* Of a node, relative to a primitive test. */
+        constexpr float    DETERMINANT_EPSILON     = 1e-12f;
+
+        struct Bounds
+        {
+            glm::vec3 m_min = glm::vec3( FLT_MAX);
+            glm::vec3 m_max = glm::vec3(-FLT_MAX);
+
+            void Grow(const glm::vec3& point)  { m_min = glm::min(m_min, point);        m_max = glm::max(m_max, point); }
+            void Grow(const Bounds&    bounds) { m_min = glm::min(m_min, bounds.m_min); m_max = glm::max(m_max, bounds.m_max); }
+
+            float GetArea() const
+            {
+                const glm::vec3 extents = m_max - m_min;
+                return 2.0f * (extents.x * extents.y + extents.y * extents.z + extents.z * extents.x);
+            }
+        };
+
+        /* Binned SAH build over the primitives' bounds. Writes the nodes and the primitive indices in the leaves' order. */
+        class BvhBuilder
+        {
+        public:
+            BvhBuilder(const std::vector<Bounds>& bounds, uint32_t max_leaf_size)
+                : m_bounds       (bounds),
+                  m_max_leaf_size(max_leaf_size),
+                  m_nodes_count  (1)
+            {
+            }
+
+            void Build(std::vector<BvhNode>& nodes, std::vector<uint32_t>& order)
+            {
+                const uint32_t count = uint32_t(m_bounds.size());
+
+                nodes.clear();
+                order.clear();
+
+                if (count == 0)
+                {
+                    return;
+                }
+
+                m_centroids.resize(count);
+                m_order.resize(count);
+                m_nodes.resize(2 * count - 1);
+
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    m_centroids[i] = 0.5f * (m_bounds[i].m_min + m_bounds[i].m_max);
+                    m_order[i]     = i;
+                }
+
+                Subdivide(0, 0, count, 0);
+
+                m_nodes.resize(m_nodes_count.load());
+                nodes = std::move(m_nodes);
+                order = std::move(m_order);
+            }
+
+        private:
+            struct Bin
+            {
+                Bounds   m_bounds;
+                uint32_t m_count = 0;
+            };
+
+            uint32_t GetBin(uint32_t primitive, uint32_t axis, float min, float scale) const
+            {
+                return std::min(SAH_BINS - 1, uint32_t((m_centroids[primitive][axis] - min) * scale));
+            }
+
+            void MakeLeaf(BvhNode& node, uint32_t begin, uint32_t end)
+            {
+                node.m_first = begin;
+                node.m_count = end - begin;
+            }
+
+            void Subdivide(uint32_t node_index, uint32_t begin, uint32_t end, uint32_t depth)
+            {
+                BvhNode& node = m_nodes[node_index];
+
+                Bounds bounds, centroid_bounds;
+
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    bounds.Grow(m_bounds[m_order[i]]);
+                    centroid_bounds.Grow(m_centroids[m_order[i]]);
+                }
+
+                node.m_min = bounds.m_min;
+                node.m_max = bounds.m_max;
+
+                const uint32_t count = end - begin;
+
+                if (count == 1 || depth + 1 >= MAX_DEPTH)
+                {
+                    MakeLeaf(node, begin, end);
+                    return;
+                }
+
+                float    best_cost  = FLT_MAX;
+                uint32_t best_axis  = 3;
+                uint32_t best_split = 0;
+
+                for (uint32_t axis = 0; axis < 3; ++axis)
+                {
+                    const float extent = centroid_bounds.m_max[axis] - centroid_bounds.m_min[axis];
+
+                    if (extent <= 0.0f)
+                    {
+                        continue;
+                    }
+
+                    const float scale = SAH_BINS / extent;
+                    Bin         bins[SAH_BINS];
+
+                    for (uint32_t i = begin; i < end; ++i)
+                    {
+                        Bin& bin = bins[GetBin(m_order[i], axis, centroid_bounds.m_min[axis], scale)];
+                        bin.m_bounds.Grow(m_bounds[m_order[i]]);
+                        bin.m_count++;
+                    }
+
+                    /* Left to right sweep of the areas and counts, then right to left with the costs. */
+                    float    left_areas [SAH_BINS - 1];
+                    uint32_t left_counts[SAH_BINS - 1];
+                    Bounds   left_bounds;
+                    uint32_t left_count = 0;
+
+                    for (uint32_t b = 0; b < SAH_BINS - 1; ++b)
+                    {
+                        left_bounds.Grow(bins[b].m_bounds);
+                        left_count    += bins[b].m_count;
+                        left_counts[b] = left_count;
+                        left_areas [b] = left_count > 0 ? left_bounds.GetArea() : 0.0f;
+                    }
+
+                    Bounds   right_bounds;
+                    uint32_t right_count = 0;
+
+                    for (uint32_t b = SAH_BINS - 1; b > 0; --b)
+                    {
+                        right_bounds.Grow(bins[b].m_bounds);
+                        right_count += bins[b].m_count;
+
+                        if (left_counts[b - 1] == 0 || right_count == 0)
+                        {
+                            continue;
+                        }
+
+                        const float cost = left_counts[b - 1] * left_areas[b - 1] + right_count * right_bounds.GetArea();
+
+                        if (cost < best_cost)
+                        {
+                            best_cost  = cost;
+                            best_axis  = axis;
+                            best_split = b;
+                        }
+                    }
+                }
+
+                const float area = bounds.GetArea();
+
+                uint32_t middle;
+
+                if (best_axis < 3 && (count > m_max_leaf_size || TRAVERSAL_COST * area + best_cost < count * area))
+                {
+                    const float scale = SAH_BINS / (centroid_bounds.m_max[best_axis] - centroid_bounds.m_min[best_axis]);
+
+                    auto it = std::partition(m_order.begin() + begin, m_order.begin() + end, [&](uint32_t primitive)
+                    {
+                        return GetBin(primitive, best_axis, centroid_bounds.m_min[best_axis], scale) < best_split;
+                    });
+
+                    middle = uint32_t(it - m_order.begin());
+                }
+                else if (count > m_max_leaf_size)
+                {
+                    /* All the centroids are at the same point, any split is as good as the other. */
+                    middle = begin + count / 2;
+                }
+                else
+                {
+                    MakeLeaf(node, begin, end);
+                    return;
+                }
+
+                const uint32_t first_child = m_nodes_count.fetch_add(2);
+
+                node.m_first = first_child;
+                node.m_count = 0;
+
+                if (count >= PARALLEL_MIN_PRIMITIVES)
+                {
+                    JobSystem::Counter counter;
+                    JobSystem::Run([this, first_child, begin, middle, depth] { Subdivide(first_child, begin, middle, depth + 1); }, &counter);
+
+                    Subdivide(first_child + 1, middle, end, depth + 1);
+                    JobSystem::Wait(counter);
+                }
+                else
+                {
+                    Subdivide(first_child,     begin,  middle, depth + 1);
+                    Subdivide(first_child + 1, middle, end,    depth + 1);
+                }
+            }
+
+            const std::vector<Bounds>& m_bounds;
+            const uint32_t             m_max_leaf_size;
+            std::vector<glm::vec3>     m_centroids;
+            std::vector<uint32_t>      m_order;
+            std::vector<BvhNode>       m_nodes; /* Preallocated for the worst case, the jobs only take indices. */
+            std::atomic<uint32_t>      m_nodes_count;
+        };
+
+        /* Entry distance of the ray, or FLT_MAX if it misses the box or enters it beyond max_distance. */
+        float IntersectAabb(const BvhNode& node, const glm::vec3& origin, const glm::vec3& inv_direction, float max_distance)
+        {
+            const glm::vec3 t0 = (node.m_min - origin) * inv_direction;
+            const glm::vec3 t1 = (node.m_max - origin) * inv_direction;
+
+            const glm::vec3 t_near = glm::min(t0, t1);
+            const glm::vec3 t_far  = glm::max(t0, t1);
+
+            const float entry = std::max(std::max(t_near.x, t_near.y), std::max(t_near.z, 0.0f));
+            const float exit  = std::min(std::min(t_far.x,  t_far.y),  std::min(t_far.z,  max_distance));
+
+            return entry <= exit ? entry : FLT_MAX;
+        }
+
+        /* Front to back traversal. leaf_function(first, count) tests the primitives and returns true to stop. */
+        template<typename LeafFunction>
+        void Traverse(const std::vector<BvhNode>& nodes, const Ray& ray, const float& max_distance, LeafFunction&& leaf_function)
+        {
+            if (nodes.empty())
+            {
+                return;
+            }
+
+            const glm::vec3 inv_direction = 1.0f / ray.m_direction;
+
+            if (IntersectAabb(nodes[0], ray.m_origin, inv_direction, max_distance) == FLT_MAX)
+            {
+                return;
+            }
+
+            uint32_t stack[MAX_DEPTH];
+            uint32_t stack_size = 0;
+            uint32_t node_index = 0;
+
+            for (;;)
+            {
+                const BvhNode& node = nodes[node_index];
+
+                if (node.IsLeaf())
+                {
+                    if (leaf_function(node.m_first, node.m_count))
+                    {
+                        return;
+                    }
+                }
+                else
+                {
+                    uint32_t near_index = node.m_first;
+                    uint32_t far_index  = node.m_first + 1;
+                    float    near_entry = IntersectAabb(nodes[near_index], ray.m_origin, inv_direction, max_distance);
+                    float    far_entry  = IntersectAabb(nodes[far_index],  ray.m_origin, inv_direction, max_distance);
+
+                    if (far_entry < near_entry)
+                    {
+                        std::swap(near_index, far_index);
+                        std::swap(near_entry, far_entry);
+                    }
+
+                    if (near_entry != FLT_MAX)
+                    {
+                        if (far_entry != FLT_MAX)
+                        {
+                            stack[stack_size++] = far_index;
+                        }
+
+                        node_index = near_index;
+                        continue;
+                    }
+                }
+
+                if (stack_size == 0)
+                {
+                    return;
+                }
+
+                node_index = stack[--stack_size];
+            }
+        }
+
+#ifdef RGL_BVH_SSE
+        /* PACKET_SIZE rays in SSE lanes, the lanes past the rays count are inactive. */
+        struct Packet
+        {
+            __m128 m_origin[3];
+            __m128 m_direction[3];
+            __m128 m_inv_direction[3];
+            __m128 m_distance;
+            int    m_active_mask;
+        };
+
+        Packet MakePacket(const Ray* rays, uint32_t count, const RayHit* hits)
+        {
+            float lanes[10][4] = {};
+
+            for (uint32_t lane = 0; lane < count; ++lane)
+            {
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    lanes[axis]    [lane] = rays[lane].m_origin[axis];
+                    lanes[3 + axis][lane] = rays[lane].m_direction[axis];
+                    lanes[6 + axis][lane] = 1.0f / rays[lane].m_direction[axis];
+                }
+
+                lanes[9][lane] = hits[lane].m_distance;
+            }
+
+            Packet packet;
+
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                packet.m_origin       [axis] = _mm_loadu_ps(lanes[axis]);
+                packet.m_direction    [axis] = _mm_loadu_ps(lanes[3 + axis]);
+                packet.m_inv_direction[axis] = _mm_loadu_ps(lanes[6 + axis]);
+            }
+
+            packet.m_distance    = _mm_loadu_ps(lanes[9]);
+            packet.m_active_mask = (1 << count) - 1;
+
+            return packet;
+        }
+
+        /* The mask of the active lanes that hit the box before their distance, and their entry distances. */
+        int IntersectAabb(const BvhNode& node, const Packet& packet, __m128& entry)
+        {
+            __m128 t_near = _mm_setzero_ps();
+            __m128 t_far  = packet.m_distance;
+
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.m_min[axis]), packet.m_origin[axis]), packet.m_inv_direction[axis]);
+                const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.m_max[axis]), packet.m_origin[axis]), packet.m_inv_direction[axis]);
+
+                t_near = _mm_max_ps(t_near, _mm_min_ps(t0, t1));
+                t_far  = _mm_min_ps(t_far,  _mm_max_ps(t0, t1));
+            }
+
+            entry = t_near;
+
+            return _mm_movemask_ps(_mm_cmple_ps(t_near, t_far)) & packet.m_active_mask;
+        }
+
+        float GetMinEntry(const __m128& entry, int mask)
+        {
+            float entries[4];
+            _mm_storeu_ps(entries, entry);
+
+            float min_entry = FLT_MAX;
+
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                if (mask & (1 << lane))
+                {
+                    min_entry = std::min(min_entry, entries[lane]);
+                }
+            }
+
+            return min_entry;
+        }
+
+        /*
+         * A node is visited if any ray of the packet hits it. leaf_function(first, count, mask) tests the primitives
+         * with the lanes in the mask and updates the packet's distances.
+         */
+        template<typename LeafFunction>
+        void TraversePacket(const std::vector<BvhNode>& nodes, Packet& packet, LeafFunction&& leaf_function)
+        {
+            __m128 entry;
+
+            if (nodes.empty() || IntersectAabb(nodes[0], packet, entry) == 0)
+            {
+                return;
+            }
+
+            uint32_t stack[MAX_DEPTH];
+            uint32_t stack_size = 0;
+            uint32_t node_index = 0;
+
+            for (;;)
+            {
+                const BvhNode& node = nodes[node_index];
+
+                if (node.IsLeaf())
+                {
+                    /* The distances might have shrunk since the node was pushed. */
+                    const int mask = IntersectAabb(node, packet, entry);
+
+                    if (mask)
+                    {
+                        leaf_function(node.m_first, node.m_count, mask);
+                    }
+                }
+                else
+                {
+                    __m128 near_entry, far_entry;
+
+                    uint32_t near_index = node.m_first;
+                    uint32_t far_index  = node.m_first + 1;
+                    int      near_mask  = IntersectAabb(nodes[near_index], packet, near_entry);
+                    int      far_mask   = IntersectAabb(nodes[far_index],  packet, far_entry);
+
+                    if (near_mask && far_mask && GetMinEntry(far_entry, far_mask) < GetMinEntry(near_entry, near_mask))
+                    {
+                        std::swap(near_index, far_index);
+                        std::swap(near_mask,  far_mask);
+                    }
+
+                    if (!near_mask)
+                    {
+                        std::swap(near_index, far_index);
+                        std::swap(near_mask,  far_mask);
+                    }
+
+                    if (near_mask)
+                    {
+                        if (far_mask)
+                        {
+                            stack[stack_size++] = far_index;
+                        }
+
+                        node_index = near_index;
+                        continue;
+                    }
+                }
+
+                if (stack_size == 0)
+                {
+                    return;
+                }
+
+                node_index = stack[--stack_size];
+            }
+        }
+#endif
+    }
+
+    void MeshBvh::Build(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const std::vector<Range>& ranges)
+    {
+        RGL_TRACE_ZONE("MeshBvh::Build");
+
+        std::vector<Triangle> triangles;
+        std::vector<uint32_t> triangle_ids;
+        std::vector<uint32_t> mesh_parts;
+        std::vector<Bounds>   bounds;
+
+        for (uint32_t range_index = 0; range_index < ranges.size(); ++range_index)
+        {
+            const Range& range = ranges[range_index];
+
+            for (uint32_t i = 0; i + 2 < range.m_indices_count; i += 3)
+            {
+                const uint32_t* triangle_indices = &indices[range.m_base_index + i];
+
+                const glm::vec3& p0 = positions[range.m_base_vertex + triangle_indices[0]];
+                const glm::vec3& p1 = positions[range.m_base_vertex + triangle_indices[1]];
+                const glm::vec3& p2 = positions[range.m_base_vertex + triangle_indices[2]];
+
+                Bounds triangle_bounds;
+                triangle_bounds.Grow(p0);
+                triangle_bounds.Grow(p1);
+                triangle_bounds.Grow(p2);
+
+                triangles   .push_back({ p0, p1 - p0, p2 - p0 });
+                triangle_ids.push_back(i / 3);
+                mesh_parts  .push_back(range_index);
+                bounds      .push_back(triangle_bounds);
+            }
+        }
+
+        std::vector<uint32_t> order;
+        BvhBuilder(bounds, MAX_LEAF_TRIANGLES).Build(m_nodes, order);
+
+        m_triangles   .resize(order.size());
+        m_triangle_ids.resize(order.size());
+        m_mesh_parts  .resize(order.size());
+
+        for (uint32_t i = 0; i < order.size(); ++i)
+        {
+            m_triangles   [i] = triangles   [order[i]];
+            m_triangle_ids[i] = triangle_ids[order[i]];
+            m_mesh_parts  [i] = mesh_parts  [order[i]];
+        }
+    }
+
+    bool MeshBvh::IntersectTriangle(const Ray& ray, uint32_t triangle_index, RayHit& hit) const
+    {
+        const Triangle& triangle = m_triangles[triangle_index];
+
+        const glm::vec3 p           = glm::cross(ray.m_direction, triangle.m_edge2);
+        const float     determinant = glm::dot(triangle.m_edge1, p);
+
+        if (std::abs(determinant) < DETERMINANT_EPSILON)
+        {
+            return false;
+        }
+
+        const float     inv_determinant = 1.0f / determinant;
+        const glm::vec3 s               = ray.m_origin - triangle.m_v0;
+        const float     u               = glm::dot(s, p) * inv_determinant;
+
+        if (u < 0.0f || u > 1.0f)
+        {
+            return false;
+        }
+
+        const glm::vec3 q = glm::cross(s, triangle.m_edge1);
+        const float     v = glm::dot(ray.m_direction, q) * inv_determinant;
+
+        if (v < 0.0f || u + v > 1.0f)
+        {
+            return false;
+        }
+
+        const float distance = glm::dot(triangle.m_edge2, q) * inv_determinant;
+
+        if (distance <= 0.0f || distance >= hit.m_distance)
+        {
+            return false;
+        }
+
+        hit.m_distance     = distance;
+        hit.m_barycentrics = glm::vec2(u, v);
+        hit.m_triangle     = m_triangle_ids[triangle_index];
+        hit.m_mesh_part    = m_mesh_parts[triangle_index];
+
+        return true;
+    }
+
+    bool MeshBvh::Raycast(const Ray& ray, RayHit& hit) const
+    {
+        bool is_hit = false;
+
+        Traverse(m_nodes, ray, hit.m_distance, [&](uint32_t first, uint32_t count)
+        {
+            for (uint32_t i = first; i < first + count; ++i)
+            {
+                is_hit |= IntersectTriangle(ray, i, hit);
+            }
+
+            return false;
+        });
+
+        return is_hit;
+    }
+
+    bool MeshBvh::RaycastAny(const Ray& ray, float max_distance) const
+    {
+        RayHit hit;
+        hit.m_distance = max_distance;
+
+        bool is_hit = false;
+
+        Traverse(m_nodes, ray, hit.m_distance, [&](uint32_t first, uint32_t count)
+        {
+            for (uint32_t i = first; i < first + count && !is_hit; ++i)
+            {
+                is_hit = IntersectTriangle(ray, i, hit);
+            }
+
+            return is_hit;
+        });
+
+        return is_hit;
+    }
+
+    void MeshBvh::Raycast(const Ray* rays, uint32_t count, RayHit* hits) const
+    {
+        for (uint32_t i = 0; i < count; i += PACKET_SIZE)
+        {
+            RaycastPacket(rays + i, std::min(PACKET_SIZE, count - i), hits + i);
+        }
+    }
+
+    void MeshBvh::RaycastPacket(const Ray* rays, uint32_t count, RayHit* hits) const
+    {
+#ifdef RGL_BVH_SSE
+        Packet packet = MakePacket(rays, count, hits);
+
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one  = _mm_set1_ps(1.0f);
+        const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+        const __m128* o = packet.m_origin;
+        const __m128* d = packet.m_direction;
+
+        TraversePacket(m_nodes, packet, [&](uint32_t first, uint32_t triangles_count, int mask)
+        {
+            for (uint32_t i = first; i < first + triangles_count; ++i)
+            {
+                const Triangle& triangle = m_triangles[i];
+
+                const __m128 e1[3] = { _mm_set1_ps(triangle.m_edge1.x), _mm_set1_ps(triangle.m_edge1.y), _mm_set1_ps(triangle.m_edge1.z) };
+                const __m128 e2[3] = { _mm_set1_ps(triangle.m_edge2.x), _mm_set1_ps(triangle.m_edge2.y), _mm_set1_ps(triangle.m_edge2.z) };
+
+                /* The Moller-Trumbore test of IntersectTriangle(), for the 4 rays. */
+                const __m128 p[3] = { _mm_sub_ps(_mm_mul_ps(d[1], e2[2]), _mm_mul_ps(d[2], e2[1])),
+                                      _mm_sub_ps(_mm_mul_ps(d[2], e2[0]), _mm_mul_ps(d[0], e2[2])),
+                                      _mm_sub_ps(_mm_mul_ps(d[0], e2[1]), _mm_mul_ps(d[1], e2[0])) };
+
+                const __m128 determinant     = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1[0], p[0]), _mm_mul_ps(e1[1], p[1])), _mm_mul_ps(e1[2], p[2]));
+                const __m128 inv_determinant = _mm_div_ps(one, determinant);
+
+                const __m128 s[3] = { _mm_sub_ps(o[0], _mm_set1_ps(triangle.m_v0.x)),
+                                      _mm_sub_ps(o[1], _mm_set1_ps(triangle.m_v0.y)),
+                                      _mm_sub_ps(o[2], _mm_set1_ps(triangle.m_v0.z)) };
+
+                const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(s[0], p[0]), _mm_mul_ps(s[1], p[1])), _mm_mul_ps(s[2], p[2])), inv_determinant);
+
+                const __m128 q[3] = { _mm_sub_ps(_mm_mul_ps(s[1], e1[2]), _mm_mul_ps(s[2], e1[1])),
+                                      _mm_sub_ps(_mm_mul_ps(s[2], e1[0]), _mm_mul_ps(s[0], e1[2])),
+                                      _mm_sub_ps(_mm_mul_ps(s[0], e1[1]), _mm_mul_ps(s[1], e1[0])) };
+
+                const __m128 v        = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0],  q[0]), _mm_mul_ps(d[1],  q[1])), _mm_mul_ps(d[2],  q[2])), inv_determinant);
+                const __m128 distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2[0], q[0]), _mm_mul_ps(e2[1], q[1])), _mm_mul_ps(e2[2], q[2])), inv_determinant);
+
+                __m128 is_hit = _mm_cmpgt_ps(_mm_and_ps(determinant, abs_mask), _mm_set1_ps(DETERMINANT_EPSILON));
+                is_hit = _mm_and_ps(is_hit, _mm_cmpge_ps(u, zero));
+                is_hit = _mm_and_ps(is_hit, _mm_cmpge_ps(v, zero));
+                is_hit = _mm_and_ps(is_hit, _mm_cmple_ps(_mm_add_ps(u, v), one));
+                is_hit = _mm_and_ps(is_hit, _mm_cmpgt_ps(distance, zero));
+                is_hit = _mm_and_ps(is_hit, _mm_cmplt_ps(distance, packet.m_distance));
+
+                const int hit_mask = _mm_movemask_ps(is_hit) & mask;
+
+                if (hit_mask == 0)
+                {
+                    continue;
+                }
+
+                packet.m_distance = _mm_or_ps(_mm_and_ps(is_hit, distance), _mm_andnot_ps(is_hit, packet.m_distance));
+
+                float distances[4], us[4], vs[4];
+                _mm_storeu_ps(distances, distance);
+                _mm_storeu_ps(us, u);
+                _mm_storeu_ps(vs, v);
+
+                for (int lane = 0; lane < 4; ++lane)
+                {
+                    if (hit_mask & (1 << lane))
+                    {
+                        hits[lane].m_distance     = distances[lane];
+                        hits[lane].m_barycentrics = glm::vec2(us[lane], vs[lane]);
+                        hits[lane].m_triangle     = m_triangle_ids[i];
+                        hits[lane].m_mesh_part    = m_mesh_parts[i];
+                    }
+                }
+            }
+        });
+#else
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            Raycast(rays[i], hits[i]);
+        }
+#endif
+    }
+
+    uint32_t SceneBvh::AddInstance(const MeshBvh* bvh, const glm::mat4& model_matrix)
+    {
+        m_instances.push_back({ bvh, model_matrix, glm::inverse(model_matrix) });
+
+        return uint32_t(m_instances.size()) - 1;
+    }
+
+    void SceneBvh::SetTransform(uint32_t instance, const glm::mat4& model_matrix)
+    {
+        m_instances[instance].m_model_matrix         = model_matrix;
+        m_instances[instance].m_inverse_model_matrix = glm::inverse(model_matrix);
+    }
+
+    void SceneBvh::Clear()
+    {
+        m_instances.clear();
+        m_nodes.clear();
+        m_instance_order.clear();
+    }
+
+    void SceneBvh::Build()
+    {
+        RGL_TRACE_ZONE("SceneBvh::Build");
+
+        std::vector<Bounds> bounds(m_instances.size());
+
+        for (uint32_t i = 0; i < m_instances.size(); ++i)
+        {
+            const Instance& instance = m_instances[i];
+
+            if (!instance.m_bvh || instance.m_bvh->IsEmpty())
+            {
+                continue;
+            }
+
+            /* The world space box of the object space box's corners. */
+            for (uint32_t corner = 0; corner < 8; ++corner)
+            {
+                const glm::vec3 point((corner & 1) ? instance.m_bvh->GetMax().x : instance.m_bvh->GetMin().x,
+                                      (corner & 2) ? instance.m_bvh->GetMax().y : instance.m_bvh->GetMin().y,
+                                      (corner & 4) ? instance.m_bvh->GetMax().z : instance.m_bvh->GetMin().z);
+
+                bounds[i].Grow(glm::vec3(instance.m_model_matrix * glm::vec4(point, 1.0f)));
+            }
+        }
+
+        BvhBuilder(bounds, 1).Build(m_nodes, m_instance_order);
+    }
+
+    Ray SceneBvh::ToObjectSpace(const Ray& ray, const Instance& instance)
+    {
+        return { glm::vec3(instance.m_inverse_model_matrix * glm::vec4(ray.m_origin,    1.0f)),
+                 glm::vec3(instance.m_inverse_model_matrix * glm::vec4(ray.m_direction, 0.0f)) };
+    }
+
+    bool SceneBvh::Raycast(const Ray& ray, RayHit& hit) const
+    {
+        bool is_hit = false;
+
+        Traverse(m_nodes, ray, hit.m_distance, [&](uint32_t first, uint32_t count)
+        {
+            for (uint32_t i = first; i < first + count; ++i)
+            {
+                const uint32_t  instance_index = m_instance_order[i];
+                const Instance& instance       = m_instances[instance_index];
+
+                if (instance.m_bvh && instance.m_bvh->Raycast(ToObjectSpace(ray, instance), hit))
+                {
+                    hit.m_instance = instance_index;
+                    is_hit         = true;
+                }
+            }
+
+            return false;
+        });
+
+        return is_hit;
+    }
+
+    bool SceneBvh::RaycastAny(const Ray& ray, float max_distance) const
+    {
+        bool is_hit = false;
+
+        Traverse(m_nodes, ray, max_distance, [&](uint32_t first, uint32_t count)
+        {
+            for (uint32_t i = first; i < first + count && !is_hit; ++i)
+            {
+                const Instance& instance = m_instances[m_instance_order[i]];
+
+                is_hit = instance.m_bvh && instance.m_bvh->RaycastAny(ToObjectSpace(ray, instance), max_distance);
+            }
+
+            return is_hit;
+        });
+
+        return is_hit;
+    }
+
+    void SceneBvh::Raycast(const Ray* rays, uint32_t count, RayHit* hits) const
+    {
+        for (uint32_t first_ray = 0; first_ray < count; first_ray += MeshBvh::PACKET_SIZE)
+        {
+            const uint32_t packet_size = std::min(MeshBvh::PACKET_SIZE, count - first_ray);
+            const Ray*     packet_rays = rays + first_ray;
+            RayHit*        packet_hits = hits + first_ray;
+
+#ifdef RGL_BVH_SSE
+            Packet packet = MakePacket(packet_rays, packet_size, packet_hits);
+
+            TraversePacket(m_nodes, packet, [&](uint32_t first, uint32_t instances_count, int)
+            {
+                for (uint32_t i = first; i < first + instances_count; ++i)
+                {
+                    const uint32_t  instance_index = m_instance_order[i];
+                    const Instance& instance       = m_instances[instance_index];
+
+                    if (!instance.m_bvh)
+                    {
+                        continue;
+                    }
+
+                    Ray   object_rays[MeshBvh::PACKET_SIZE];
+                    float distances  [MeshBvh::PACKET_SIZE];
+
+                    for (uint32_t lane = 0; lane < packet_size; ++lane)
+                    {
+                        object_rays[lane] = ToObjectSpace(packet_rays[lane], instance);
+                        distances  [lane] = packet_hits[lane].m_distance;
+                    }
+
+                    instance.m_bvh->RaycastPacket(object_rays, packet_size, packet_hits);
+
+                    float lanes[4] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+
+                    for (uint32_t lane = 0; lane < packet_size; ++lane)
+                    {
+                        if (packet_hits[lane].m_distance < distances[lane])
+                        {
+                            packet_hits[lane].m_instance = instance_index;
+                        }
+
+                        lanes[lane] = packet_hits[lane].m_distance;
+                    }
+
+                    packet.m_distance = _mm_loadu_ps(lanes);
+                }
+            });
+#else
+            for (uint32_t lane = 0; lane < packet_size; ++lane)
+            {
+                Raycast(packet_rays[lane], packet_hits[lane]);
+            }
+#endif
+        }
+    }
+}
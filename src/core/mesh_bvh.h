@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+namespace RGL
+{
+    /* The hit point is m_origin + distance * m_direction, the direction doesn't have to be normalized. */
+    struct Ray
+    {
+        glm::vec3 m_origin;
+        glm::vec3 m_direction;
+    };
+
+    struct RayHit
+    {
+        static constexpr uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+        float     m_distance     = FLT_MAX;       /* In the units of the ray's direction length. */
+        glm::vec2 m_barycentrics = glm::vec2(0.0f); /* Of the triangle's second and third vertex. */
+        uint32_t  m_triangle     = INVALID_INDEX; /* Index of the triangle in its mesh part, at the full detail. */
+        uint32_t  m_mesh_part    = INVALID_INDEX;
+        uint32_t  m_instance     = INVALID_INDEX; /* SceneBvh instance, INVALID_INDEX for the MeshBvh queries. */
+
+        bool IsHit() const { return m_triangle != INVALID_INDEX; }
+    };
+
+    /* Node of MeshBvh and SceneBvh. The children of an interior node are the consecutive nodes m_first and m_first + 1. */
+    struct BvhNode
+    {
+        glm::vec3 m_min;
+        uint32_t  m_first; /* The first child, or the first primitive of a leaf. */
+        glm::vec3 m_max;
+        uint32_t  m_count; /* Primitives of a leaf, 0 for an interior node. */
+
+        bool IsLeaf() const { return m_count > 0; }
+    };
+
+    /*
+     * Bounding volume hierarchy over the triangles of a mesh, for the CPU ray queries - picking, ground snapping,
+     * camera collisions. Built with the binned surface area heuristic, the subtrees of the big nodes on the job system.
+     * The triangles are copied (as a vertex and two edges) in the leaves' order, so the mesh data can be freed after Build().
+     *
+     * A hit closer than the hit passed in replaces it, so its m_distance limits the ray - FLT_MAX by default.
+     * The packet queries test PACKET_SIZE rays against every node at once (SSE), the rays of a packet should be coherent,
+     * e.g. of neighbouring pixels. StaticModel::SetBvhGeneration() builds one for the model's mesh parts at load.
+     */
+    class MeshBvh final
+    {
+    public:
+        static constexpr uint32_t PACKET_SIZE        = 4;
+        static constexpr uint32_t MAX_LEAF_TRIANGLES = 4;
+
+        /* Index range of a mesh part, its indices are relative to base_vertex. */
+        struct Range
+        {
+            uint32_t m_base_index;
+            uint32_t m_indices_count;
+            uint32_t m_base_vertex;
+        };
+
+        void Build(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const std::vector<Range>& ranges);
+
+        bool Raycast   (const Ray& ray, RayHit& hit) const; /* Closest hit, returns true if the hit was updated. */
+        bool RaycastAny(const Ray& ray, float max_distance = FLT_MAX) const;
+
+        /* Closest hits of count rays, in packets of PACKET_SIZE. */
+        void Raycast(const Ray* rays, uint32_t count, RayHit* hits) const;
+
+        const glm::vec3& GetMin()            const { return m_nodes.front().m_min; }
+        const glm::vec3& GetMax()            const { return m_nodes.front().m_max; }
+        uint32_t         GetTrianglesCount() const { return uint32_t(m_triangles.size()); }
+        uint32_t         GetNodesCount()     const { return uint32_t(m_nodes.size()); }
+        bool             IsEmpty()           const { return m_triangles.empty(); }
+
+    private:
+        /* Prepared for the Moller-Trumbore test. */
+        struct Triangle
+        {
+            glm::vec3 m_v0;
+            glm::vec3 m_edge1;
+            glm::vec3 m_edge2;
+        };
+
+        bool IntersectTriangle(const Ray& ray, uint32_t triangle_index, RayHit& hit) const;
+        void RaycastPacket    (const Ray* rays, uint32_t count, RayHit* hits) const;
+
+        std::vector<BvhNode>  m_nodes;
+        std::vector<Triangle> m_triangles;
+        std::vector<uint32_t> m_triangle_ids; /* Index of the triangle in its mesh part. */
+        std::vector<uint32_t> m_mesh_parts;
+
+        friend class SceneBvh;
+    };
+
+    /*
+     * Two level hierarchy over the instances of meshes - a BVH over the instances' world space bounds, whose leaves
+     * transform the ray into the object space of their MeshBvh. The distances stay the same in both spaces,
+     * the object space direction isn't normalized. Build() has to be called after the instances were added or moved,
+     * it only rebuilds the top level. The MeshBvhs must outlive the scene.
+     *
+     *     SceneBvh scene;
+     *     scene.AddInstance(model.GetBvh(), transform);
+     *     scene.Build();
+     *
+     *     RayHit hit;
+     *     if (scene.Raycast({ camera_position, ray_direction }, hit)) { ... hit.m_instance ... }
+     */
+    class SceneBvh final
+    {
+    public:
+        /* Returns the index of the new instance. */
+        uint32_t AddInstance(const MeshBvh* bvh, const glm::mat4& model_matrix);
+
+        void SetTransform(uint32_t instance, const glm::mat4& model_matrix);
+        void Clear();
+        void Build();
+
+        bool Raycast   (const Ray& ray, RayHit& hit) const;
+        bool RaycastAny(const Ray& ray, float max_distance = FLT_MAX) const;
+        void Raycast   (const Ray* rays, uint32_t count, RayHit* hits) const;
+
+        uint32_t GetInstancesCount() const { return uint32_t(m_instances.size()); }
+
+    private:
+        struct Instance
+        {
+            const MeshBvh* m_bvh;
+            glm::mat4      m_model_matrix;
+            glm::mat4      m_inverse_model_matrix;
+        };
+
+        static Ray ToObjectSpace(const Ray& ray, const Instance& instance);
+
+        std::vector<Instance> m_instances;
+        std::vector<BvhNode>  m_nodes;
+        std::vector<uint32_t> m_instance_order; /* Instance indices in the leaves' order. */
+    };
+}
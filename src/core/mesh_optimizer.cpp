@@ -0,0 +1,813 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+#include <glm/geometric.hpp>
+
+namespace RGL
+{
+    namespace
+    {
+        constexpr int   FORSYTH_CACHE_SIZE         = 32;
+        constexpr float FORSYTH_LAST_TRI_SCORE     = 0.75f;
+        constexpr float FORSYTH_CACHE_DECAY_POWER  = 1.5f;
+        constexpr float FORSYTH_VALENCE_BOOST      = 2.0f;
+        constexpr float FORSYTH_VALENCE_BOOST_POW  = -0.5f;
+
+        float VertexScore(int cache_position, uint32_t remaining_valence)
+        {
+            if (remaining_valence == 0)
+            {
+                /* No triangles left, the vertex is not needed anymore. */
+                return -1.0f;
+            }
+
+            float score = 0.0f;
+
+            if (cache_position >= 0)
+            {
+                if (cache_position < 3)
+                {
+                    /* Used by the last triangle - fixed score, so the strips are not favored too much. */
+                    score = FORSYTH_LAST_TRI_SCORE;
+                }
+                else
+                {
+                    const float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+                    score = std::pow(1.0f - (cache_position - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+                }
+            }
+
+            /* Boost the vertices with only a few triangles left, so they don't stay behind. */
+            score += FORSYTH_VALENCE_BOOST * std::pow(float(remaining_valence), FORSYTH_VALENCE_BOOST_POW);
+
+            return score;
+        }
+
+        /* Symmetric 4x4 matrix of the plane equations' squared distance sum, with the area weight. */
+        struct Quadric
+        {
+            double a2 = 0, ab = 0, ac = 0, ad = 0;
+            double b2 = 0, bc = 0, bd = 0;
+            double c2 = 0, cd = 0;
+            double d2 = 0;
+            double w  = 0;
+
+            Quadric& operator+=(const Quadric& q)
+            {
+                a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+                b2 += q.b2; bc += q.bc; bd += q.bd;
+                c2 += q.c2; cd += q.cd;
+                d2 += q.d2;
+                w  += q.w;
+
+                return *this;
+            }
+
+            static Quadric FromPlane(const glm::dvec3& n, double d, double weight)
+            {
+                Quadric q;
+                q.a2 = n.x * n.x * weight; q.ab = n.x * n.y * weight; q.ac = n.x * n.z * weight; q.ad = n.x * d * weight;
+                q.b2 = n.y * n.y * weight; q.bc = n.y * n.z * weight; q.bd = n.y * d * weight;
+                q.c2 = n.z * n.z * weight; q.cd = n.z * d * weight;
+                q.d2 = d   * d   * weight;
+                q.w  = weight;
+
+                return q;
+            }
+
+            /* Weighted mean of the squared distances to the planes. */
+            double Error(const glm::vec3& p) const
+            {
+                const double x = p.x, y = p.y, z = p.z;
+
+                double error = a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x +
+                                            b2 * y * y       + 2.0 * bc * y * z + 2.0 * bd * y +
+                                                               c2 * z * z       + 2.0 * cd * z + d2;
+
+                return w > 0.0 ? std::abs(error) / w : 0.0;
+            }
+        };
+
+        struct Collapse
+        {
+            uint32_t m_from;
+            uint32_t m_to;
+            double   m_error;
+        };
+
+        glm::vec3 TriangleNormal(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2)
+        {
+            return glm::cross(p1 - p0, p2 - p0);
+        }
+    }
+
+    float MeshOptimizer::ComputeACMR(const uint32_t* indices, size_t index_count, uint32_t vertex_count, uint32_t cache_size)
+    {
+        if (index_count < 3)
+        {
+            return 0.0f;
+        }
+
+        /* FIFO cache simulated with the timestamps of the vertices' insertion. */
+        std::vector<uint32_t> timestamps(vertex_count, 0);
+        uint32_t              time   = cache_size + 1;
+        uint32_t              misses = 0;
+
+        for (size_t i = 0; i < index_count; ++i)
+        {
+            uint32_t index = indices[i];
+
+            if (time - timestamps[index] > cache_size)
+            {
+                timestamps[index] = time++;
+                misses++;
+            }
+        }
+
+        return float(misses) / float(index_count / 3);
+    }
+
+    void MeshOptimizer::OptimizeVertexCache(uint32_t* indices, size_t index_count, uint32_t vertex_count)
+    {
+        const size_t triangles_count = index_count / 3;
+
+        if (triangles_count == 0)
+        {
+            return;
+        }
+
+        /* Vertex -> triangles adjacency. */
+        std::vector<uint32_t> valence(vertex_count, 0);
+
+        for (size_t i = 0; i < index_count; ++i)
+        {
+            valence[indices[i]]++;
+        }
+
+        std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+        std::partial_sum(valence.begin(), valence.end(), adjacency_offsets.begin() + 1);
+
+        std::vector<uint32_t> adjacency(index_count);
+        std::vector<uint32_t> fill_offsets(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+
+        for (size_t i = 0; i < index_count; ++i)
+        {
+            adjacency[fill_offsets[indices[i]]++] = uint32_t(i / 3);
+        }
+
+        /* Initial scores. */
+        std::vector<int>   cache_position (vertex_count, -1);
+        std::vector<float> vertex_score   (vertex_count);
+        std::vector<float> triangle_score (triangles_count, 0.0f);
+        std::vector<bool>  is_emitted     (triangles_count, false);
+
+        for (uint32_t v = 0; v < vertex_count; ++v)
+        {
+            vertex_score[v] = VertexScore(-1, valence[v]);
+        }
+
+        for (size_t t = 0; t < triangles_count; ++t)
+        {
+            triangle_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+        }
+
+        std::vector<uint32_t> output;
+        output.reserve(index_count);
+
+        std::vector<uint32_t> cache, new_cache;
+        cache.reserve(FORSYTH_CACHE_SIZE + 3);
+        new_cache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+        int64_t best_triangle = -1;
+
+        for (size_t emitted = 0; emitted < triangles_count; ++emitted)
+        {
+            /* No candidate in the cache - take the best remaining triangle. */
+            if (best_triangle < 0)
+            {
+                float best_score = -1.0f;
+
+                for (size_t t = 0; t < triangles_count; ++t)
+                {
+                    if (!is_emitted[t] && triangle_score[t] > best_score)
+                    {
+                        best_score    = triangle_score[t];
+                        best_triangle = t;
+                    }
+                }
+            }
+
+            const uint32_t* tri = &indices[best_triangle * 3];
+
+            output.insert(output.end(), tri, tri + 3);
+            is_emitted[best_triangle] = true;
+
+            /* Remove the triangle from the vertices' adjacency lists. */
+            for (int k = 0; k < 3; ++k)
+            {
+                uint32_t  v     = tri[k];
+                uint32_t* begin = &adjacency[adjacency_offsets[v]];
+                uint32_t* end   = begin + valence[v];
+
+                std::remove(begin, end, uint32_t(best_triangle));
+                valence[v]--;
+            }
+
+            /* LRU cache update - the triangle's vertices go to the front. */
+            new_cache.assign(tri, tri + 3);
+
+            for (uint32_t v : cache)
+            {
+                if (v != tri[0] && v != tri[1] && v != tri[2])
+                {
+                    new_cache.push_back(v);
+                }
+            }
+
+            /* Vertices pushed out of the cache lose their position score. */
+            for (size_t i = FORSYTH_CACHE_SIZE; i < new_cache.size(); ++i)
+            {
+                cache_position[new_cache[i]] = -1;
+                vertex_score  [new_cache[i]] = VertexScore(-1, valence[new_cache[i]]);
+            }
+
+            new_cache.resize(std::min<size_t>(new_cache.size(), FORSYTH_CACHE_SIZE));
+            std::swap(cache, new_cache);
+
+            for (size_t i = 0; i < cache.size(); ++i)
+            {
+                cache_position[cache[i]] = int(i);
+                vertex_score  [cache[i]] = VertexScore(int(i), valence[cache[i]]);
+            }
+
+            /* Rescore the triangles touching the cached vertices and pick the best one. */
+            best_triangle    = -1;
+            float best_score = -1.0f;
+
+            for (uint32_t v : cache)
+            {
+                for (uint32_t j = 0; j < valence[v]; ++j)
+                {
+                    const uint32_t  t  = adjacency[adjacency_offsets[v] + j];
+                    const uint32_t* ti = &indices[t * 3];
+
+                    triangle_score[t] = vertex_score[ti[0]] + vertex_score[ti[1]] + vertex_score[ti[2]];
+
+                    if (triangle_score[t] > best_score)
+                    {
+                        best_score    = triangle_score[t];
+                        best_triangle = t;
+                    }
+                }
+            }
+        }
+
+        std::copy(output.begin(), output.end(), indices);
+    }
+
+    void MeshOptimizer::OptimizeOverdraw(uint32_t* indices, size_t index_count, const glm::vec3* positions, uint32_t vertex_count, float threshold)
+    {
+        const size_t triangles_count = index_count / 3;
+
+        if (triangles_count < 2)
+        {
+            return;
+        }
+
+        const float input_acmr = ComputeACMR(indices, index_count, vertex_count);
+
+        /* Cluster boundaries - the triangles that miss the cache with all three vertices start a new cluster. */
+        std::vector<size_t>   cluster_starts;
+        std::vector<uint32_t> timestamps(vertex_count, 0);
+        const uint32_t        cache_size = 16;
+        uint32_t              time       = cache_size + 1;
+
+        for (size_t t = 0; t < triangles_count; ++t)
+        {
+            int misses = 0;
+
+            for (int k = 0; k < 3; ++k)
+            {
+                uint32_t index = indices[t * 3 + k];
+
+                if (time - timestamps[index] > cache_size)
+                {
+                    timestamps[index] = time++;
+                    misses++;
+                }
+            }
+
+            if (t == 0 || misses == 3)
+            {
+                cluster_starts.push_back(t);
+            }
+        }
+
+        cluster_starts.push_back(triangles_count);
+
+        if (cluster_starts.size() <= 2)
+        {
+            return;
+        }
+
+        /* Mesh centroid. */
+        glm::vec3 mesh_centroid(0.0f);
+
+        for (size_t i = 0; i < index_count; ++i)
+        {
+            mesh_centroid += positions[indices[i]];
+        }
+
+        mesh_centroid /= float(index_count);
+
+        /* Sort key - the clusters that face away from the mesh center are likely to occlude the others. */
+        const size_t       clusters_count = cluster_starts.size() - 1;
+        std::vector<float> sort_keys(clusters_count);
+
+        for (size_t c = 0; c < clusters_count; ++c)
+        {
+            glm::vec3 centroid(0.0f);
+            glm::vec3 normal  (0.0f);
+            float     area = 0.0f;
+
+            for (size_t t = cluster_starts[c]; t < cluster_starts[c + 1]; ++t)
+            {
+                const glm::vec3& p0 = positions[indices[t * 3 + 0]];
+                const glm::vec3& p1 = positions[indices[t * 3 + 1]];
+                const glm::vec3& p2 = positions[indices[t * 3 + 2]];
+
+                glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+                float     a = glm::length(n);
+
+                centroid += (p0 + p1 + p2) * (a / 3.0f);
+                normal   += n;
+                area     += a;
+            }
+
+            centroid = area > 0.0f ? centroid / area : centroid;
+            normal   = glm::length(normal) > 0.0f ? glm::normalize(normal) : normal;
+
+            sort_keys[c] = glm::dot(centroid - mesh_centroid, normal);
+        }
+
+        std::vector<size_t> order(clusters_count);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&sort_keys](size_t a, size_t b) { return sort_keys[a] > sort_keys[b]; });
+
+        std::vector<uint32_t> output;
+        output.reserve(index_count);
+
+        for (size_t c : order)
+        {
+            output.insert(output.end(), indices + cluster_starts[c] * 3, indices + cluster_starts[c + 1] * 3);
+        }
+
+        /* Keep the new order only if it doesn't hurt the vertex cache too much. */
+        if (ComputeACMR(output.data(), output.size(), vertex_count) <= input_acmr * threshold)
+        {
+            std::copy(output.begin(), output.end(), indices);
+        }
+    }
+
+    std::vector<uint32_t> MeshOptimizer::OptimizeVertexFetch(uint32_t* indices, size_t index_count, uint32_t vertex_count)
+    {
+        constexpr uint32_t UNUSED = 0xFFFFFFFF;
+
+        std::vector<uint32_t> remap(vertex_count, UNUSED);
+        uint32_t              next_vertex = 0;
+
+        for (size_t i = 0; i < index_count; ++i)
+        {
+            uint32_t& new_index = remap[indices[i]];
+
+            if (new_index == UNUSED)
+            {
+                new_index = next_vertex++;
+            }
+
+            indices[i] = new_index;
+        }
+
+        /* Unreferenced vertices go to the end, so the table stays a permutation. */
+        for (auto& new_index : remap)
+        {
+            if (new_index == UNUSED)
+            {
+                new_index = next_vertex++;
+            }
+        }
+
+        return remap;
+    }
+
+    std::vector<uint32_t> MeshOptimizer::Simplify(const uint32_t* indices, size_t index_count, const glm::vec3* positions, uint32_t vertex_count,
+                                                  size_t target_index_count, float target_error, float* result_error)
+    {
+        std::vector<uint32_t> result(indices, indices + index_count);
+        double                max_error = 0.0;
+
+        /* Vertices that share the position (UV and normal seams) are welded for the topology checks. */
+        struct PositionHash
+        {
+            size_t operator()(const glm::vec3& p) const
+            {
+                uint32_t bits[3];
+                std::memcpy(bits, &p, sizeof(bits));
+
+                return (size_t(bits[0]) * 73856093) ^ (size_t(bits[1]) * 19349663) ^ (size_t(bits[2]) * 83492791);
+            }
+        };
+
+        std::vector<uint32_t>                                     position_ids  (vertex_count);
+        std::vector<uint32_t>                                     wedges_count  (vertex_count, 0);
+        std::unordered_map<glm::vec3, uint32_t, PositionHash>     position_map;
+
+        for (uint32_t v = 0; v < vertex_count; ++v)
+        {
+            auto [it, is_inserted] = position_map.try_emplace(positions[v], v);
+            position_ids[v]        = it->second;
+            wedges_count[it->second]++;
+        }
+
+        /* Lock the seams and the open borders - the edges used by a single triangle in the welded mesh. */
+        std::vector<bool> is_locked(vertex_count, false);
+
+        {
+            std::unordered_map<uint64_t, uint32_t> edges;
+            edges.reserve(index_count);
+
+            for (size_t i = 0; i < index_count; i += 3)
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    uint32_t a = position_ids[result[i + k]];
+                    uint32_t b = position_ids[result[i + (k + 1) % 3]];
+
+                    edges[(uint64_t(std::min(a, b)) << 32) | std::max(a, b)]++;
+                }
+            }
+
+            for (const auto& [edge, count] : edges)
+            {
+                if (count == 1)
+                {
+                    is_locked[uint32_t(edge >> 32)]        = true;
+                    is_locked[uint32_t(edge & 0xFFFFFFFF)] = true;
+                }
+            }
+
+            for (uint32_t v = 0; v < vertex_count; ++v)
+            {
+                is_locked[v] = is_locked[position_ids[v]] || wedges_count[position_ids[v]] > 1;
+            }
+        }
+
+        /* Quadrics of the triangles' planes, weighted by the area. */
+        std::vector<Quadric> quadrics(vertex_count);
+
+        for (size_t i = 0; i < index_count; i += 3)
+        {
+            const glm::dvec3 p0 = positions[result[i + 0]];
+            const glm::dvec3 p1 = positions[result[i + 1]];
+            const glm::dvec3 p2 = positions[result[i + 2]];
+
+            glm::dvec3 n    = glm::cross(p1 - p0, p2 - p0);
+            double     area = glm::length(n);
+
+            if (area == 0.0)
+            {
+                continue;
+            }
+
+            n /= area;
+
+            Quadric q = Quadric::FromPlane(n, -glm::dot(n, p0), area);
+
+            for (int k = 0; k < 3; ++k)
+            {
+                quadrics[result[i + k]] += q;
+            }
+        }
+
+        const double max_collapse_error = double(target_error) * double(target_error);
+
+        std::vector<uint32_t> adjacency_offsets(vertex_count + 1);
+        std::vector<uint32_t> adjacency;
+        std::vector<Collapse> collapses;
+        std::vector<uint32_t> remap(vertex_count);
+        std::vector<bool>     is_touched(vertex_count);
+
+        while (result.size() > target_index_count)
+        {
+            /* Vertex -> triangles adjacency of the current mesh. */
+            std::fill(adjacency_offsets.begin(), adjacency_offsets.end(), 0);
+
+            for (uint32_t index : result)
+            {
+                adjacency_offsets[index + 1]++;
+            }
+
+            std::partial_sum(adjacency_offsets.begin(), adjacency_offsets.end(), adjacency_offsets.begin());
+            adjacency.resize(result.size());
+
+            {
+                std::vector<uint32_t> fill_offsets(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+
+                for (size_t i = 0; i < result.size(); ++i)
+                {
+                    adjacency[fill_offsets[result[i]]++] = uint32_t(i / 3);
+                }
+            }
+
+            /* Candidate half-edge collapses, cheapest first. */
+            collapses.clear();
+
+            for (size_t i = 0; i < result.size(); i += 3)
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    uint32_t a = result[i + k];
+                    uint32_t b = result[i + (k + 1) % 3];
+
+                    for (auto [from, to] : { std::pair{ a, b }, std::pair{ b, a } })
+                    {
+                        if (is_locked[from])
+                        {
+                            continue;
+                        }
+
+                        Quadric q = quadrics[from];
+                        q += quadrics[to];
+
+                        double error = q.Error(positions[to]);
+
+                        if (error <= max_collapse_error)
+                        {
+                            collapses.push_back({ from, to, error });
+                        }
+                    }
+                }
+            }
+
+            if (collapses.empty())
+            {
+                break;
+            }
+
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.m_error < b.m_error; });
+
+            /* Greedy collapses of the independent edges - the one-ring of the collapsed vertex is frozen until the next pass. */
+            std::iota(remap.begin(), remap.end(), 0);
+            std::fill(is_touched.begin(), is_touched.end(), false);
+
+            size_t triangles_count        = result.size() / 3;
+            size_t target_triangles_count = target_index_count / 3;
+            size_t applied_collapses      = 0;
+
+            for (const Collapse& collapse : collapses)
+            {
+                if (triangles_count <= target_triangles_count)
+                {
+                    break;
+                }
+
+                if (is_touched[collapse.m_from] || is_touched[collapse.m_to])
+                {
+                    continue;
+                }
+
+                /* Reject the collapses that would flip a triangle around the removed vertex. */
+                bool     is_flipped        = false;
+                uint32_t removed_triangles = 0;
+
+                for (uint32_t j = adjacency_offsets[collapse.m_from]; j < adjacency_offsets[collapse.m_from + 1]; ++j)
+                {
+                    const uint32_t* tri = &result[adjacency[j] * 3];
+
+                    if (tri[0] == collapse.m_to || tri[1] == collapse.m_to || tri[2] == collapse.m_to)
+                    {
+                        removed_triangles++;
+                        continue;
+                    }
+
+                    glm::vec3 p[3]     = { positions[tri[0]], positions[tri[1]], positions[tri[2]] };
+                    glm::vec3 normal   = TriangleNormal(p[0], p[1], p[2]);
+
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        p[k] = tri[k] == collapse.m_from ? positions[collapse.m_to] : p[k];
+                    }
+
+                    if (glm::dot(normal, TriangleNormal(p[0], p[1], p[2])) <= 0.0f)
+                    {
+                        is_flipped = true;
+                        break;
+                    }
+                }
+
+                if (is_flipped)
+                {
+                    continue;
+                }
+
+                for (uint32_t j = adjacency_offsets[collapse.m_from]; j < adjacency_offsets[collapse.m_from + 1]; ++j)
+                {
+                    const uint32_t* tri = &result[adjacency[j] * 3];
+
+                    is_touched[tri[0]] = is_touched[tri[1]] = is_touched[tri[2]] = true;
+                }
+
+                remap[collapse.m_from]     = collapse.m_to;
+                quadrics[collapse.m_to]   += quadrics[collapse.m_from];
+                triangles_count           -= removed_triangles;
+                max_error                  = std::max(max_error, collapse.m_error);
+                applied_collapses++;
+            }
+
+            if (applied_collapses == 0)
+            {
+                break;
+            }
+
+            /* Remove the degenerate triangles. */
+            size_t write = 0;
+
+            for (size_t i = 0; i < result.size(); i += 3)
+            {
+                uint32_t a = remap[result[i + 0]];
+                uint32_t b = remap[result[i + 1]];
+                uint32_t c = remap[result[i + 2]];
+
+                if (a != b && b != c && a != c)
+                {
+                    result[write++] = a;
+                    result[write++] = b;
+                    result[write++] = c;
+                }
+            }
+
+            result.resize(write);
+        }
+
+        if (result_error)
+        {
+            *result_error = float(std::sqrt(max_error));
+        }
+
+        return result;
+    }
+
+    void MeshOptimizer::BuildMeshlets(std::vector<Meshlet>& meshlets, std::vector<uint32_t>& meshlet_vertices, std::vector<uint8_t>& meshlet_triangles,
+                                      const uint32_t* indices, size_t index_count, uint32_t vertex_count,
+                                      uint32_t max_vertices, uint32_t max_triangles)
+    {
+        constexpr uint8_t NOT_IN_MESHLET = 0xFF;
+
+        /* Local index of the vertex in the current meshlet. */
+        std::vector<uint8_t> local_indices(vertex_count, NOT_IN_MESHLET);
+
+        Meshlet meshlet = { uint32_t(meshlet_vertices.size()), uint32_t(meshlet_triangles.size() / 3), 0, 0 };
+
+        auto flush = [&]()
+        {
+            for (uint32_t i = 0; i < meshlet.m_vertex_count; ++i)
+            {
+                local_indices[meshlet_vertices[meshlet.m_vertex_offset + i]] = NOT_IN_MESHLET;
+            }
+
+            meshlets.push_back(meshlet);
+            meshlet = { uint32_t(meshlet_vertices.size()), uint32_t(meshlet_triangles.size() / 3), 0, 0 };
+        };
+
+        for (size_t i = 0; i + 2 < index_count; i += 3)
+        {
+            const uint32_t* tri = &indices[i];
+
+            uint32_t new_vertices = (local_indices[tri[0]] == NOT_IN_MESHLET) + 
+                                    (local_indices[tri[1]] == NOT_IN_MESHLET) + 
+                                    (local_indices[tri[2]] == NOT_IN_MESHLET);
+
+            if (meshlet.m_vertex_count + new_vertices > max_vertices || meshlet.m_triangle_count + 1 > max_triangles)
+            {
+                flush();
+            }
+
+            for (int k = 0; k < 3; ++k)
+            {
+                if (local_indices[tri[k]] == NOT_IN_MESHLET)
+                {
+                    local_indices[tri[k]] = uint8_t(meshlet.m_vertex_count++);
+                    meshlet_vertices.push_back(tri[k]);
+                }
+
+                meshlet_triangles.push_back(local_indices[tri[k]]);
+            }
+
+            meshlet.m_triangle_count++;
+        }
+
+        if (meshlet.m_triangle_count > 0)
+        {
+            flush();
+        }
+    }
+
+    MeshletBounds MeshOptimizer::ComputeMeshletBounds(const Meshlet& meshlet, const std::vector<uint32_t>& meshlet_vertices, 
+                                                      const std::vector<uint8_t>& meshlet_triangles, const glm::vec3* positions)
+    {
+        MeshletBounds bounds = {};
+
+        if (meshlet.m_triangle_count == 0)
+        {
+            return bounds;
+        }
+
+        /* Sphere around the AABB of the meshlet's vertices. */
+        glm::vec3 min = positions[meshlet_vertices[meshlet.m_vertex_offset]];
+        glm::vec3 max = min;
+
+        for (uint32_t i = 0; i < meshlet.m_vertex_count; ++i)
+        {
+            min = glm::min(min, positions[meshlet_vertices[meshlet.m_vertex_offset + i]]);
+            max = glm::max(max, positions[meshlet_vertices[meshlet.m_vertex_offset + i]]);
+        }
+
+        bounds.m_center = 0.5f * (min + max);
+
+        for (uint32_t i = 0; i < meshlet.m_vertex_count; ++i)
+        {
+            bounds.m_radius = std::max(bounds.m_radius, glm::distance(bounds.m_center, positions[meshlet_vertices[meshlet.m_vertex_offset + i]]));
+        }
+
+        /* Normal cone - the axis is the average of the triangles' normals, the spread is the largest angle to the axis. */
+        std::vector<glm::vec3> normals    (meshlet.m_triangle_count);
+        std::vector<glm::vec3> first_points(meshlet.m_triangle_count);
+        glm::vec3              axis(0.0f);
+
+        for (uint32_t t = 0; t < meshlet.m_triangle_count; ++t)
+        {
+            const uint8_t* tri = &meshlet_triangles[(meshlet.m_triangle_offset + t) * 3];
+
+            const glm::vec3& p0 = positions[meshlet_vertices[meshlet.m_vertex_offset + tri[0]]];
+            const glm::vec3& p1 = positions[meshlet_vertices[meshlet.m_vertex_offset + tri[1]]];
+            const glm::vec3& p2 = positions[meshlet_vertices[meshlet.m_vertex_offset + tri[2]]];
+
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float     length = glm::length(normal);
+
+            normals     [t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+            first_points[t] = p0;
+            axis           += normals[t];
+        }
+
+        /* No backface culling for the meshlets with the normals spread over a hemisphere or more. */
+        bounds.m_cone_apex   = bounds.m_center;
+        bounds.m_cone_axis   = glm::vec3(0.0f);
+        bounds.m_cone_cutoff = 1.0f;
+
+        float axis_length = glm::length(axis);
+
+        if (axis_length == 0.0f)
+        {
+            return bounds;
+        }
+
+        axis /= axis_length;
+
+        float min_dot = 1.0f;
+
+        for (const auto& normal : normals)
+        {
+            min_dot = std::min(min_dot, glm::dot(axis, normal));
+        }
+
+        if (min_dot <= 0.0f)
+        {
+            return bounds;
+        }
+
+        /* Apex, so that every triangle's plane is in front of it - the cone test is then exact for any camera position. */
+        float max_t = 0.0f;
+
+        for (uint32_t t = 0; t < meshlet.m_triangle_count; ++t)
+        {
+            float dn = glm::dot(axis, normals[t]);
+
+            if (dn > 0.0f)
+            {
+                max_t = std::max(max_t, glm::dot(bounds.m_center - first_points[t], normals[t]) / dn);
+            }
+        }
+
+        bounds.m_cone_apex   = bounds.m_center - axis * max_t;
+        bounds.m_cone_axis   = axis;
+        bounds.m_cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+
+        return bounds;
+    }
+}
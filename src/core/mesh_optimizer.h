@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+namespace RGL
+{
+    /* Cluster of a mesh - offsets into the meshlet vertices and triangles arrays from MeshOptimizer::BuildMeshlets(). */
+    struct Meshlet
+    {
+        uint32_t m_vertex_offset;
+        uint32_t m_triangle_offset;
+        uint32_t m_vertex_count;
+        uint32_t m_triangle_count;
+    };
+
+    /*
+     * Bounding sphere and normal cone of a meshlet. The meshlet is backfacing when
+     * dot(normalize(m_cone_apex - camera_position), m_cone_axis) >= m_cone_cutoff.
+     */
+    struct MeshletBounds
+    {
+        glm::vec3 m_center;
+        float     m_radius;
+        glm::vec3 m_cone_apex;
+        glm::vec3 m_cone_axis;
+        float     m_cone_cutoff;
+    };
+
+    /*
+     * Load time index and vertex reordering for better GPU efficiency.
+     * All the functions work on a single indexed triangle list, with indices in the [0, vertex_count) range.
+     */
+    class MeshOptimizer
+    {
+    public:
+        /**
+        * @brief   Simulates a FIFO post-transform vertex cache.
+        * @returns Average cache miss ratio - transformed vertices per triangle (0.5 is ideal, 3.0 is the worst).
+        */
+        static float ComputeACMR(const uint32_t* indices, size_t index_count, uint32_t vertex_count, uint32_t cache_size = 16);
+
+        /* Reorders the triangles for post-transform cache locality (Forsyth's linear-speed algorithm). */
+        static void OptimizeVertexCache(uint32_t* indices, size_t index_count, uint32_t vertex_count);
+
+        /*
+         * Reorders the clusters of the cache optimized triangles, so the outer facing ones are drawn first (Sander et al.).
+         * The order is kept only if ACMR doesn't get worse than threshold times the input ACMR.
+         */
+        static void OptimizeOverdraw(uint32_t* indices, size_t index_count, const glm::vec3* positions, uint32_t vertex_count, float threshold = 1.05f);
+
+        /*
+         * Returns the vertex remap table (old index -> new index) that orders the vertices by their first use
+         * and rewrites the indices accordingly. Unreferenced vertices are moved to the end.
+         */
+        static std::vector<uint32_t> OptimizeVertexFetch(uint32_t* indices, size_t index_count, uint32_t vertex_count);
+
+        /*
+         * Quadric error metric simplification with half-edge collapses (Garland and Heckbert).
+         * Collapses edges until the index count drops to target_index_count or the next collapse would move
+         * the surface by more than target_error (object space distance). Border and attribute seam vertices are locked.
+         * Returns the simplified indices, which reference the original vertices. result_error is the distance reached.
+         */
+        static std::vector<uint32_t> Simplify(const uint32_t* indices, size_t index_count, const glm::vec3* positions, uint32_t vertex_count,
+                                              size_t target_index_count, float target_error, float* result_error = nullptr);
+
+        /*
+         * Splits the triangle list into meshlets of at most max_vertices unique vertices and max_triangles triangles,
+         * in the order of the triangles (run OptimizeVertexCache first for tighter meshlets).
+         * meshlet_vertices maps the local vertex indices to the mesh vertices, meshlet_triangles stores 3 local indices per triangle.
+         */
+        static void BuildMeshlets(std::vector<Meshlet>& meshlets, std::vector<uint32_t>& meshlet_vertices, std::vector<uint8_t>& meshlet_triangles,
+                                  const uint32_t* indices, size_t index_count, uint32_t vertex_count,
+                                  uint32_t max_vertices = 64, uint32_t max_triangles = 124);
+
+        static MeshletBounds ComputeMeshletBounds(const Meshlet& meshlet, const std::vector<uint32_t>& meshlet_vertices, 
+                                                  const std::vector<uint8_t>& meshlet_triangles, const glm::vec3* positions);
+
+        /* Applies the remap table from OptimizeVertexFetch to the vertex attribute. */
+        template<typename T>
+        static void RemapVertices(T* vertices, const std::vector<uint32_t>& remap)
+        {
+            std::vector<T> copy(vertices, vertices + remap.size());
+
+            for (size_t i = 0; i < remap.size(); ++i)
+            {
+                vertices[remap[i]] = copy[i];
+            }
+        }
+    };
+}
@@ -6,6 +6,15 @@
 namespace RGL
 {
     constexpr static uint32_t INVALID_MATERIAL = 0xffffffff;
+    constexpr static uint32_t MAX_LODS_COUNT   = 5;
+
+    /* Index range of a simplified version of the mesh part, stored in the same index buffer. */
+    struct MeshLod
+    {
+        uint32_t m_base_index    = 0;
+        uint32_t m_indices_count = 0;
+        float    m_error         = 0.0f;
+    };
 
     struct Vertex
     {
@@ -24,14 +33,35 @@ namespace RGL
             : m_base_vertex   (0),
               m_base_index    (0),
               m_material_index(INVALID_MATERIAL),
-              m_indices_count (0) { }
+              m_indices_count (0),
+              m_lods_count    (0),
+              m_current_lod   (0),
+              m_bounds_center (0.0f),
+              m_bounds_radius (0.0f),
+              m_first_meshlet (0),
+              m_meshlets_count(0) { }
 
     private:
+        /* Index range of the selected LOD. */
+        uint32_t GetLodBaseIndex()    const { return m_current_lod > 0 ? m_lods[m_current_lod].m_base_index    : m_base_index;    }
+        uint32_t GetLodIndicesCount() const { return m_current_lod > 0 ? m_lods[m_current_lod].m_indices_count : m_indices_count; }
+
         uint32_t m_base_vertex;
         uint32_t m_base_index;
         uint32_t m_material_index;
         uint32_t m_indices_count;
 
+        /* m_lods[0] is the full detail range, 0 means there are no LODs. */
+        MeshLod   m_lods[MAX_LODS_COUNT];
+        uint32_t  m_lods_count;
+        uint32_t  m_current_lod;
+        glm::vec3 m_bounds_center;
+        float     m_bounds_radius;
+
+        /* Range of StaticModel's meshlets, built from the full detail indices. */
+        uint32_t  m_first_meshlet;
+        uint32_t  m_meshlets_count;
+
         friend class StaticModel;
         friend class AnimatedModel;
     };
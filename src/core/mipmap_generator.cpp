@@ -0,0 +1,154 @@
+#include "mipmap_generator.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "core_shared.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+#include "shader.h"
+#include "trace.h"
+
+namespace RGL
+{
+    bool                    MipmapGenerator::s_is_enabled           = false;
+    std::shared_ptr<Shader> MipmapGenerator::s_shader;
+    GLuint                  MipmapGenerator::s_counters_buffer_name = 0;
+    GLuint                  MipmapGenerator::s_tiles_buffer_name    = 0;
+    GLsizeiptr              MipmapGenerator::s_counters_buffer_size = 0;
+    GLsizeiptr              MipmapGenerator::s_tiles_buffer_size    = 0;
+
+    bool MipmapGenerator::IsSupported(GLenum internal_format)
+    {
+        switch (internal_format)
+        {
+            case GL_R8:
+            case GL_RG8:
+            case GL_RGBA8:
+            case GL_SRGB8_ALPHA8:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool MipmapGenerator::Generate(GLuint texture_name, GLenum internal_format, uint32_t width, uint32_t height, uint32_t layers_count,
+                                   uint32_t levels_count, MipmapFilter filter)
+    {
+        if (levels_count < 2 || !IsSupported(internal_format))
+        {
+            return false;
+        }
+
+        if (!s_shader && !Create())
+        {
+            return false;
+        }
+
+        RGL_TRACE_ZONE("Generate mipmaps");
+
+        /* The image units can't write sRGB, the view reinterprets the storage as linear and the shader does the conversion. */
+        const GLenum view_format = internal_format == GL_SRGB8_ALPHA8 ? GL_RGBA8 : internal_format;
+
+        GLuint view_name = 0;
+        glGenTextures(1, &view_name);
+        glTextureView(view_name, GL_TEXTURE_2D_ARRAY, texture_name, view_format, 0, levels_count, 0, layers_count);
+
+        const GLsizeiptr counters_size = GLsizeiptr(layers_count) * sizeof(uint32_t);
+        const GLsizeiptr tiles_size    = GLsizeiptr((width + MIPMAP_TILE_SIZE - 1) / MIPMAP_TILE_SIZE) * ((height + MIPMAP_TILE_SIZE - 1) / MIPMAP_TILE_SIZE) *
+                                         layers_count * 4 * sizeof(float);
+
+        if (counters_size > s_counters_buffer_size)
+        {
+            GpuMemory::UntrackBuffer(s_counters_buffer_name);
+            glDeleteBuffers     (1, &s_counters_buffer_name);
+            glCreateBuffers     (1, &s_counters_buffer_name);
+            glNamedBufferStorage(s_counters_buffer_name, counters_size, nullptr, 0);
+            GpuMemory::TrackBuffer(s_counters_buffer_name, "MipmapGenerator");
+
+            /* The last group of a dispatch resets its counter, they stay zero from now on. */
+            glClearNamedBufferData(s_counters_buffer_name, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+            s_counters_buffer_size = counters_size;
+        }
+
+        if (tiles_size > s_tiles_buffer_size)
+        {
+            GpuMemory::UntrackBuffer(s_tiles_buffer_name);
+            glDeleteBuffers     (1, &s_tiles_buffer_name);
+            glCreateBuffers     (1, &s_tiles_buffer_name);
+            glNamedBufferStorage(s_tiles_buffer_name, tiles_size, nullptr, 0);
+            GpuMemory::TrackBuffer(s_tiles_buffer_name, "MipmapGenerator");
+
+            s_tiles_buffer_size = tiles_size;
+        }
+
+        s_shader->bind();
+        s_shader->setUniform("u_is_srgb",       internal_format == GL_SRGB8_ALPHA8);
+        s_shader->setUniform("u_is_normal_map", filter == MipmapFilter::NORMAL);
+
+        GLState::BindTextureUnit(0, view_name);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MIPMAP_COUNTERS_SSBO_BINDING_INDEX, s_counters_buffer_name);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MIPMAP_TILES_SSBO_BINDING_INDEX,    s_tiles_buffer_name);
+
+        for (uint32_t base_level = 0; base_level + 1 < levels_count;)
+        {
+            const uint32_t base_width  = std::max(width  >> base_level, 1u);
+            const uint32_t base_height = std::max(height >> base_level, 1u);
+
+            /* The last group builds the levels past the tile from at most 32x32 tiles' results, see the shader. */
+            const uint32_t max_levels = std::max(base_width, base_height) > MIPMAP_TILE_SIZE * 64 ? MIPMAP_TILE_LEVELS : MIPMAP_DISPATCH_LEVELS;
+            const uint32_t levels     = std::min(levels_count - 1 - base_level, max_levels);
+
+            for (uint32_t i = 0; i < levels; ++i)
+            {
+                glBindImageTexture(i, view_name, base_level + 1 + i, GL_TRUE, 0, GL_WRITE_ONLY, view_format);
+            }
+
+            s_shader->setUniform("u_base_size",    glm::uvec2(base_width, base_height));
+            s_shader->setUniform("u_base_level",   int(base_level));
+            s_shader->setUniform("u_levels_count", int(levels));
+
+            glDispatchCompute((base_width + MIPMAP_TILE_SIZE - 1) / MIPMAP_TILE_SIZE, (base_height + MIPMAP_TILE_SIZE - 1) / MIPMAP_TILE_SIZE, layers_count);
+            glMemoryBarrier  (GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+            base_level += levels;
+        }
+
+        glDeleteTextures(1, &view_name);
+        GLState::OnTextureDeleted(view_name);
+
+        return true;
+    }
+
+    void MipmapGenerator::Release()
+    {
+        s_shader.reset();
+
+        GpuMemory::UntrackBuffer(s_counters_buffer_name);
+        GpuMemory::UntrackBuffer(s_tiles_buffer_name);
+        glDeleteBuffers(1, &s_counters_buffer_name);
+        glDeleteBuffers(1, &s_tiles_buffer_name);
+
+        s_counters_buffer_name = 0;
+        s_tiles_buffer_name    = 0;
+        s_counters_buffer_size = 0;
+        s_tiles_buffer_size    = 0;
+    }
+
+    bool MipmapGenerator::Create()
+    {
+        s_shader = std::make_shared<Shader>("src/core/shaders/generate_mipmaps.comp");
+
+        if (!s_shader->link())
+        {
+            fprintf(stderr, "MipmapGenerator: the shader failed to link, falling back to glGenerateTextureMipmap.\n");
+
+            s_shader.reset();
+            s_is_enabled = false;
+
+            return false;
+        }
+
+        return true;
+    }
+}
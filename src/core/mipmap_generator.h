@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <glad/glad.h>
+
+namespace RGL
+{
+    class Shader;
+
+    enum class MipmapFilter { COLOR, NORMAL };
+
+    /*
+     * Compute shader replacement of glGenerateTextureMipmap (shaders/generate_mipmaps.comp). A single dispatch
+     * builds up to MIPMAP_DISPATCH_LEVELS levels of every layer, the bigger textures take two. The color textures
+     * are filtered in the linear space also when the storage isn't sRGB-capable through the image units,
+     * MipmapFilter::NORMAL averages the unpacked normals and renormalizes them.
+     *
+     * Disabled by default, CoreApp enables it with --compute-mipmaps. Handles the 8-bit R, RG and RGBA formats
+     * (sRGB too) of immutable 2D and 2D array textures, Generate() returns false for the rest.
+     * Render thread only.
+     */
+    class MipmapGenerator
+    {
+    public:
+        static void SetEnabled(bool enable) { s_is_enabled = enable; }
+        static bool IsEnabled()             { return s_is_enabled; }
+
+        static bool IsSupported(GLenum internal_format);
+
+        /* Generates the levels 1..levels_count - 1 from the level 0. */
+        static bool Generate(GLuint texture_name, GLenum internal_format, uint32_t width, uint32_t height, uint32_t layers_count,
+                             uint32_t levels_count, MipmapFilter filter = MipmapFilter::COLOR);
+
+        /* Releases the shader and the buffers. */
+        static void Release();
+
+    private:
+        static bool Create();
+
+        static bool                    s_is_enabled;
+        static std::shared_ptr<Shader> s_shader;
+        static GLuint                  s_counters_buffer_name;
+        static GLuint                  s_tiles_buffer_name;
+        static GLsizeiptr              s_counters_buffer_size;
+        static GLsizeiptr              s_tiles_buffer_size;
+    };
+}
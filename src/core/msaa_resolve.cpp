@@ -0,0 +1,99 @@
+#include "msaa_resolve.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+
+#include "core_shared.h"
+#include "gl_state.h"
+#include "profiler.h"
+#include "render_target_pool.h"
+#include "shader.h"
+
+#include "gui/gui.h"
+
+namespace RGL
+{
+    bool MsaaResolve::Create()
+    {
+        GLint max_samples = 1;
+        glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+
+        m_max_samples = std::clamp(uint32_t(max_samples), 1u, MAX_SAMPLES);
+
+        m_resolve_shader = std::make_shared<Shader>("src/core/shaders/msaa_resolve.comp");
+        m_resolve_shader->setDefine("HDR_IMAGE_FORMAT", RenderTargetPool::GetImageFormatQualifier(RenderTargetPool::GetColorFormat(RenderTargetUsage::HDR_COLOR)));
+
+        if (!m_resolve_shader->link())
+        {
+            fprintf(stderr, "MsaaResolve: the resolve shader failed to link.\n");
+            return false;
+        }
+
+        return true;
+    }
+
+    uint32_t MsaaResolve::GetSamples() const
+    {
+        return std::clamp(m_settings.m_samples, 1u, m_max_samples);
+    }
+
+    void MsaaResolve::BeginShading() const
+    {
+        if (GetSamples() > 1 && m_settings.m_min_sample_shading > 0.0f)
+        {
+            GLState::SetCapability(GL_SAMPLE_SHADING, true);
+            glMinSampleShading(m_settings.m_min_sample_shading);
+        }
+    }
+
+    void MsaaResolve::EndShading() const
+    {
+        GLState::SetCapability(GL_SAMPLE_SHADING, false);
+    }
+
+    const RenderTarget& MsaaResolve::Resolve(const RenderTarget& scene, float exposure)
+    {
+        if (scene.GetDesc().m_samples <= 1)
+        {
+            return scene;
+        }
+
+        ProfilerScope scope("MSAA resolve");
+
+        /* Held until the next Resolve(), the pool hands the same target back every frame. */
+        m_output = RenderTargetPool::Acquire({ scene.GetWidth(), scene.GetHeight(), RenderTargetPool::GetColorFormat(RenderTargetUsage::HDR_COLOR), 0 });
+
+        m_resolve_shader->bind();
+        m_resolve_shader->setUniform("u_samples",  int(scene.GetDesc().m_samples));
+        m_resolve_shader->setUniform("u_exposure", m_settings.m_is_tone_mapped ? exposure : 0.0f);
+
+        scene.BindColor(0);
+        m_output->BindColorImage(0, 0, GL_WRITE_ONLY);
+
+        glDispatchCompute((scene.GetWidth()  + MSAA_RESOLVE_GROUP_SIZE - 1) / MSAA_RESOLVE_GROUP_SIZE,
+                          (scene.GetHeight() + MSAA_RESOLVE_GROUP_SIZE - 1) / MSAA_RESOLVE_GROUP_SIZE, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        return *m_output;
+    }
+
+    void MsaaResolve::RenderGui()
+    {
+        static constexpr const char* SAMPLES_NAMES[] = { "Off", "2x", "4x", "8x" };
+
+        int samples_index = int(std::countr_zero(GetSamples()));
+        int max_index     = int(std::countr_zero(m_max_samples));
+
+        if (ImGui::SliderInt("MSAA", &samples_index, 0, max_index, SAMPLES_NAMES[samples_index]))
+        {
+            m_settings.m_samples = 1u << samples_index;
+        }
+
+        if (GetSamples() > 1)
+        {
+            ImGui::SliderFloat("Sample shading", &m_settings.m_min_sample_shading, 0.0f, 1.0f, "%.2f");
+            ImGui::Checkbox   ("Tone mapped resolve", &m_settings.m_is_tone_mapped);
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <glad/glad.h>
+
+namespace RGL
+{
+    class RenderTarget;
+    class Shader;
+
+    /*
+     * Multisampled HDR rendering with a resolve in compute. A blit averages the HDR samples as they are, so an edge
+     * sample many times brighter than the display range outweighs the rest of the pixel and the edge aliases again
+     * after the tone mapping, or leaves a firefly. Resolve() (shaders/msaa_resolve.comp) weights every sample by
+     * 1 / (1 + exposed luminance) - the tone mapped contribution of the sample - before averaging them.
+     *
+     * The fragment shader runs once per pixel by default, the coverage is still per sample. m_min_sample_shading
+     * raises it towards a run per sample (glMinSampleShading()), which anti-aliases the specular highlights and
+     * the alpha tested edges inside the triangles too, at the cost of that many more fragment shader invocations.
+     *
+     *     auto hdr = RenderTargetPool::Acquire({ width, height, color format, depth format, 1, msaa.GetSamples() });
+     *     msaa.BeginShading();
+     *     ... the scene to hdr ...
+     *     msaa.EndShading();
+     *     const RenderTarget& resolved = msaa.Resolve(*hdr, exposure);
+     */
+    class MsaaResolve final
+    {
+    public:
+        static constexpr uint32_t MAX_SAMPLES = 8;
+
+        struct Settings
+        {
+            uint32_t m_samples            = 4;     /* 1 - no MSAA, Resolve() returns the scene. */
+            float    m_min_sample_shading = 0.0f;  /* The fraction of the samples shaded separately, 0 - per pixel, 1 - per sample. */
+            bool     m_is_tone_mapped     = true;  /* The samples weighted by their tone mapped luminance, a plain average otherwise. */
+        };
+
+        MsaaResolve() = default;
+
+        MsaaResolve           (const MsaaResolve&) = delete;
+        MsaaResolve& operator=(const MsaaResolve&) = delete;
+
+        bool Create();
+
+        /* The samples of the scene targets, clamped to GL_MAX_SAMPLES. */
+        uint32_t GetSamples() const;
+
+        /* The sample shading of the settings, around the scene's draws. */
+        void BeginShading() const;
+        void EndShading() const;
+
+        /*
+         * The averaged scene, of the HDR color's format (RenderTargetUsage::HDR_COLOR) - valid until the next Resolve().
+         * The exposure of the tone mapping that follows, for the weights. A single sampled scene is returned as it is.
+         */
+        const RenderTarget& Resolve(const RenderTarget& scene, float exposure = 1.0f);
+
+        void RenderGui();
+
+        Settings m_settings;
+
+    private:
+        std::shared_ptr<Shader>       m_resolve_shader;
+        std::shared_ptr<RenderTarget> m_output;
+        uint32_t                      m_max_samples = 1;
+    };
+}
@@ -0,0 +1,116 @@
+#include "object_picking.h"
+
+#include <algorithm>
+
+#include "gl_state.h"
+#include "gpu_memory.h"
+
+namespace RGL
+{
+    ObjectPicking::ObjectPicking()
+        : m_texture_name     (0),
+          m_size             (0),
+          m_pick_pixel       (0),
+          m_picked_id        (NO_OBJECT),
+          m_is_pick_requested(false)
+    {
+    }
+
+    ObjectPicking::~ObjectPicking()
+    {
+        Release();
+    }
+
+    bool ObjectPicking::Create()
+    {
+        return m_readback.Create(sizeof(uint32_t));
+    }
+
+    void ObjectPicking::Resize(uint32_t width, uint32_t height)
+    {
+        Release();
+
+        m_size = glm::uvec2(width, height);
+
+        glCreateTextures  (GL_TEXTURE_2D, 1, &m_texture_name);
+        glTextureStorage2D(m_texture_name, 1, GL_R32UI, width, height);
+        GpuMemory::TrackTexture(m_texture_name, "ObjectPicking");
+
+        glTextureParameteri(m_texture_name, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(m_texture_name, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    void ObjectPicking::Attach(GLuint framebuffer, uint32_t color_attachment) const
+    {
+        const GLenum draw_buffer = GL_COLOR_ATTACHMENT0 + color_attachment;
+
+        glNamedFramebufferTexture    (framebuffer, draw_buffer, m_texture_name, 0);
+        glNamedFramebufferDrawBuffers(framebuffer, 1, &draw_buffer);
+    }
+
+    void ObjectPicking::Detach(GLuint framebuffer, uint32_t color_attachment) const
+    {
+        const GLenum draw_buffer = GL_NONE;
+
+        glNamedFramebufferTexture    (framebuffer, GL_COLOR_ATTACHMENT0 + color_attachment, 0, 0);
+        glNamedFramebufferDrawBuffers(framebuffer, 1, &draw_buffer);
+    }
+
+    void ObjectPicking::Clear() const
+    {
+        const GLuint clear_value = NO_OBJECT;
+
+        glClearTexImage(m_texture_name, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &clear_value);
+    }
+
+    void ObjectPicking::RequestPick(const glm::vec2& position)
+    {
+        if (m_size.x == 0 || m_size.y == 0)
+        {
+            return;
+        }
+
+        /* The textures' rows go from the bottom. */
+        m_pick_pixel.x = std::min(uint32_t(std::max(position.x, 0.0f)), m_size.x - 1);
+        m_pick_pixel.y = m_size.y - 1 - std::min(uint32_t(std::max(position.y, 0.0f)), m_size.y - 1);
+
+        m_is_pick_requested = true;
+    }
+
+    void ObjectPicking::ReadPick(GLuint texture)
+    {
+        if (!m_is_pick_requested)
+        {
+            return;
+        }
+
+        /* Only the first channel of a two channel texture is returned. */
+        bool is_issued = m_readback.ReadTexture(texture ? texture : m_texture_name, 0, m_pick_pixel.x, m_pick_pixel.y, 1, 1,
+                                                GL_RED_INTEGER, GL_UNSIGNED_INT, sizeof(uint32_t), [this](const void* data, GLsizeiptr)
+        {
+            m_picked_id = *static_cast<const uint32_t*>(data);
+        });
+
+        /* All the slots are in flight, the request stays for the next frame. */
+        if (is_issued)
+        {
+            m_is_pick_requested = false;
+        }
+    }
+
+    void ObjectPicking::Update()
+    {
+        m_readback.Update();
+    }
+
+    void ObjectPicking::Release()
+    {
+        if (m_texture_name)
+        {
+            GpuMemory::UntrackTexture(m_texture_name);
+            GLState::OnTextureDeleted(m_texture_name);
+            glDeleteTextures(1, &m_texture_name);
+            m_texture_name = 0;
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glad/glad.h>
+#include <glm/vec2.hpp>
+
+#include "async_readback.h"
+
+namespace RGL
+{
+    /*
+     * The object under the cursor from the GPU - an R32UI id target the depth pre-pass writes to (0 - nothing),
+     * of which only the requested pixel is copied through AsyncReadback. The id comes one or two frames after
+     * the request and the pipeline never waits for it, so it works for whatever the vertex shaders do - skinning,
+     * displacement, GPU culling. What the id means is up to the shaders, e.g. the mesh draw index + 1.
+     *
+     *     picking.Create();
+     *     picking.Resize(width, height);
+     *     picking.Attach(depth_pass_fbo);                // The pass clears it with Clear() and writes the ids.
+     *
+     *     picking.Update();                              // Once per frame, GetPickedId() is the last finished pick.
+     *     picking.RequestPick(Input::getMousePosition());
+     *     ... depth pre-pass ...
+     *     picking.ReadPick();                            // After the pass, if a pick was requested.
+     */
+    class ObjectPicking final
+    {
+    public:
+        static constexpr uint32_t NO_OBJECT = 0;
+
+        ObjectPicking();
+        ~ObjectPicking();
+
+        ObjectPicking           (const ObjectPicking&) = delete;
+        ObjectPicking& operator=(const ObjectPicking&) = delete;
+
+        bool Create();
+
+        /* The ids texture, of the size of the pass' framebuffer. Attach() has to be called again after a resize. */
+        void Resize(uint32_t width, uint32_t height);
+
+        /* Attaches the ids texture as the color attachment and makes it the only draw buffer of the framebuffer. */
+        void Attach(GLuint framebuffer, uint32_t color_attachment = 0) const;
+
+        /* Back to a depth only framebuffer. */
+        void Detach(GLuint framebuffer, uint32_t color_attachment = 0) const;
+
+        /* Clears the ids to NO_OBJECT, before the pass. */
+        void Clear() const;
+
+        /* A pixel in the window coordinates of Input::getMousePosition() - the origin at the top left. */
+        void RequestPick(const glm::vec2& position);
+
+        /*
+         * Copies the id of the requested pixel, after the pass that wrote it. By default from the ids texture,
+         * any R32UI or RG32UI texture of the same size can be read instead - the first channel, e.g. of a visibility buffer.
+         */
+        void ReadPick(GLuint texture = 0);
+
+        /* Has to be called once per frame. */
+        void Update();
+
+        bool     IsPickRequested() const { return m_is_pick_requested; }
+        bool     IsPickPending()   const { return m_readback.GetPendingCount() > 0; }
+        uint32_t GetPickedId()     const { return m_picked_id; }
+        GLuint   GetTexture()      const { return m_texture_name; }
+
+    private:
+        void Release();
+
+        AsyncReadback m_readback;
+        GLuint        m_texture_name;
+        glm::uvec2    m_size;
+        glm::uvec2    m_pick_pixel;
+        uint32_t      m_picked_id;
+        bool          m_is_pick_requested;
+    };
+}
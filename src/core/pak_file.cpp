@@ -0,0 +1,128 @@
+#include "pak_file.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <zstd.h>
+
+namespace RGL
+{
+    uint64_t PakFile::HashName(std::string_view name)
+    {
+        uint64_t hash = 0xcbf29ce484222325ull;
+
+        for (char c : name)
+        {
+            hash ^= uint8_t(c);
+            hash *= 0x100000001b3ull;
+        }
+
+        return hash;
+    }
+
+    bool PakFile::Open(const std::filesystem::path& filepath)
+    {
+        Close();
+
+        if (!m_file.OpenFromDisk(filepath))
+        {
+            return false;
+        }
+
+        PakHeader header = {};
+        const size_t file_size = m_file.GetSize();
+
+        if (file_size >= sizeof(header))
+        {
+            std::memcpy(&header, m_file.GetData(), sizeof(header));
+        }
+
+        const uint64_t toc_size = uint64_t(header.m_entries_count) * sizeof(PakEntry);
+
+        if (header.m_magic != MAGIC || header.m_version != VERSION ||
+            header.m_toc_offset % alignof(PakEntry) != 0            ||
+            header.m_toc_offset   + toc_size            > file_size ||
+            header.m_names_offset + header.m_names_size > file_size)
+        {
+            fprintf(stderr, "PakFile: %s is not a valid pak file (version %u expected).\n", filepath.string().c_str(), VERSION);
+            Close();
+
+            return false;
+        }
+
+        m_filepath = filepath;
+        m_entries  = { reinterpret_cast<const PakEntry*>(m_file.GetData() + header.m_toc_offset), header.m_entries_count };
+        m_names    = reinterpret_cast<const char*>(m_file.GetData() + header.m_names_offset);
+
+        /* The entries are trusted from here on. */
+        for (const auto& entry : m_entries)
+        {
+            if (entry.m_offset + entry.m_stored_size > file_size || uint64_t(entry.m_name_offset) + entry.m_name_size > header.m_names_size ||
+                (entry.m_compression == PakCompression::NONE && entry.m_stored_size != entry.m_size))
+            {
+                fprintf(stderr, "PakFile: %s is corrupted.\n", filepath.string().c_str());
+                Close();
+
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void PakFile::Close()
+    {
+        m_file.Close();
+        m_filepath.clear();
+
+        m_entries = {};
+        m_names   = nullptr;
+    }
+
+    const PakEntry* PakFile::Find(std::string_view name) const
+    {
+        const uint64_t hash = HashName(name);
+
+        auto it = std::lower_bound(m_entries.begin(), m_entries.end(), hash, [](const PakEntry& entry, uint64_t hash) { return entry.m_hash < hash; });
+
+        /* The colliding names are next to each other. */
+        for (; it != m_entries.end() && it->m_hash == hash; ++it)
+        {
+            if (GetName(*it) == name)
+            {
+                return &*it;
+            }
+        }
+
+        return nullptr;
+    }
+
+    bool PakFile::Read(const PakEntry& entry, uint8_t* data) const
+    {
+        const auto stored_data = GetStoredData(entry);
+
+        switch (entry.m_compression)
+        {
+            case PakCompression::NONE:
+                std::memcpy(data, stored_data.data(), stored_data.size());
+                return true;
+
+            case PakCompression::ZSTD:
+            {
+                const size_t size = ZSTD_decompress(data, size_t(entry.m_size), stored_data.data(), stored_data.size());
+
+                if (ZSTD_isError(size) || size != entry.m_size)
+                {
+                    fprintf(stderr, "PakFile: %.*s couldn't be decompressed from %s.\n", int(entry.m_name_size), m_names + entry.m_name_offset, m_filepath.string().c_str());
+                    return false;
+                }
+
+                return true;
+            }
+
+            default:
+                return false;
+        }
+    }
+}
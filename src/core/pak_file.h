@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+
+#include "mapped_file.h"
+
+namespace RGL
+{
+    enum class PakCompression : uint8_t { NONE, ZSTD };
+
+    /*
+     * The pak file layout, written by the pak_builder tool:
+     *
+     *     PakHeader | entries' data, each aligned to PAK_DATA_ALIGNMENT | PakEntry[entries count] | names
+     *
+     * The entries are sorted by the hashes of their names, the names are the files' paths relative to the root
+     * directory with '/' separators, e.g. "resources/models/fox.glb".
+     */
+    struct PakHeader
+    {
+        uint32_t m_magic;
+        uint32_t m_version;
+        uint32_t m_entries_count;
+        uint32_t m_names_size;
+        uint64_t m_toc_offset;
+        uint64_t m_names_offset;
+    };
+
+    struct PakEntry
+    {
+        uint64_t       m_hash;
+        uint64_t       m_offset;
+        uint64_t       m_stored_size; /* In the pak, compressed or not. */
+        uint64_t       m_size;        /* Of the file. */
+        int64_t        m_write_time;  /* The source file's, std::filesystem::file_time_type's ticks. */
+        uint32_t       m_name_offset;
+        uint16_t       m_name_size;
+        PakCompression m_compression;
+        uint8_t        m_reserved;
+    };
+
+    static_assert(sizeof(PakHeader) == 32 && sizeof(PakEntry) == 48, "The pak file layout changed, bump PakFile::VERSION.");
+
+    /*
+     * Read-only archive of the resources, mapped as a whole. The uncompressed entries are read in place, the views of
+     * GetStoredData() are valid as long as the pak is open. See FileSystem::mountPak() for the file system's use of it.
+     */
+    class PakFile final
+    {
+    public:
+        static constexpr uint32_t MAGIC              = 0x4B415052; /* "RPAK" */
+        static constexpr uint32_t VERSION            = 1;
+        static constexpr uint64_t PAK_DATA_ALIGNMENT = 16;
+
+        /* FNV-1a of the name. */
+        static uint64_t HashName(std::string_view name);
+
+        bool Open(const std::filesystem::path& filepath);
+        void Close();
+
+        bool IsOpen() const { return m_file.IsOpen(); }
+
+        /* nullptr if the pak has no such file. */
+        const PakEntry* Find(std::string_view name) const;
+
+        std::string_view         GetName      (const PakEntry& entry) const { return { m_names + entry.m_name_offset, entry.m_name_size }; }
+        std::span<const uint8_t> GetStoredData(const PakEntry& entry) const { return { m_file.GetData() + entry.m_offset, size_t(entry.m_stored_size) }; }
+
+        /* Decompresses the entry into data, entry.m_size bytes long. The uncompressed entries are copied. */
+        bool Read(const PakEntry& entry, uint8_t* data) const;
+
+        std::span<const PakEntry>    GetEntries()  const { return m_entries; }
+        const std::filesystem::path& GetFilepath() const { return m_filepath; }
+
+    private:
+        MappedFile                m_file;
+        std::filesystem::path     m_filepath;
+        std::span<const PakEntry> m_entries;
+        const char*               m_names = nullptr;
+    };
+}
@@ -0,0 +1,418 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <iterator>
+
+#include "timer.h"
+
+#include "gui/gui.h"
+
+namespace RGL
+{
+    bool                         Profiler::s_is_enabled             = true;
+    bool                         Profiler::s_is_frame_active        = false;
+    bool                         Profiler::s_is_waiting_for_results = false;
+    bool                         Profiler::s_is_pipeline_stats_enabled = false;
+    bool                         Profiler::s_is_pipeline_stats_active  = false;
+    bool                         Profiler::s_is_stats_segment_open     = false;
+    uint64_t                     Profiler::s_frame                  = 0;
+    uint64_t                     Profiler::s_resolved_frame         = 0;
+    uint32_t                     Profiler::s_selected_scope         = 0;
+    std::vector<Profiler::Scope> Profiler::s_scopes;
+    std::vector<uint32_t>        Profiler::s_stack;
+    std::vector<uint32_t>        Profiler::s_frame_scopes[FRAMES_COUNT];
+    std::vector<uint32_t>        Profiler::s_resolved_scopes;
+
+    std::vector<Profiler::StatsSegment> Profiler::s_stats_segments[FRAMES_COUNT];
+    uint32_t                            Profiler::s_stats_segments_count[FRAMES_COUNT] = {};
+
+    namespace
+    {
+        constexpr GLenum PIPELINE_STATS_TARGETS[Profiler::PIPELINE_STATS_COUNT] = { GL_VERTICES_SUBMITTED, GL_PRIMITIVES_SUBMITTED, GL_FRAGMENT_SHADER_INVOCATIONS };
+
+        /* 1234567 as 1.23M. */
+        void formatCount(char* buffer, size_t size, uint64_t count)
+        {
+            if      (count >= 10000000) snprintf(buffer, size, "%.1fM", double(count) / 1000000.0);
+            else if (count >= 1000000)  snprintf(buffer, size, "%.2fM", double(count) / 1000000.0);
+            else if (count >= 10000)    snprintf(buffer, size, "%.1fK", double(count) / 1000.0);
+            else                        snprintf(buffer, size, "%llu",  (unsigned long long)count);
+        }
+    }
+
+    void Profiler::BeginFrame()
+    {
+        if (!s_is_enabled)
+        {
+            return;
+        }
+
+        s_frame++;
+
+        /* The buffer was used FRAMES_COUNT frames ago, its results are ready by now in most cases. */
+        const uint32_t buffer = s_frame % FRAMES_COUNT;
+
+        ResolveQueries(buffer);
+        ResolvePipelineStats(buffer);
+
+        s_frame_scopes[buffer].clear();
+        s_stack.clear();
+
+        s_stats_segments_count[buffer] = 0;
+        s_is_pipeline_stats_active     = s_is_pipeline_stats_enabled && IsPipelineStatsSupported();
+
+        s_is_frame_active = true;
+        BeginScope("Frame");
+    }
+
+    void Profiler::EndFrame()
+    {
+        if (!s_is_frame_active)
+        {
+            return;
+        }
+
+        /* Closes the scopes left open by mistake too. */
+        while (!s_stack.empty())
+        {
+            EndScope();
+        }
+
+        s_is_frame_active = false;
+    }
+
+    uint32_t Profiler::FindOrAddScope(const char* name, uint32_t parent)
+    {
+        for (uint32_t i = 0; i < s_scopes.size(); ++i)
+        {
+            if (s_scopes[i].m_parent == parent && s_scopes[i].m_name == name)
+            {
+                return i;
+            }
+        }
+
+        Scope scope {};
+        scope.m_name   = name;
+        scope.m_parent = parent;
+        scope.m_depth  = parent == NO_PARENT ? 0 : s_scopes[parent].m_depth + 1;
+
+        glCreateQueries(GL_TIMESTAMP, FRAMES_COUNT * 2, &scope.m_queries[0][0]);
+
+        s_scopes.push_back(scope);
+
+        return uint32_t(s_scopes.size() - 1);
+    }
+
+    void Profiler::BeginScope(const char* name)
+    {
+        if (!s_is_frame_active)
+        {
+            return;
+        }
+
+        const uint32_t buffer = s_frame % FRAMES_COUNT;
+        const uint32_t index  = FindOrAddScope(name, s_stack.empty() ? NO_PARENT : s_stack.back());
+        Scope&         scope  = s_scopes[index];
+
+        /* A repeated scope keeps its first begin timestamp, so the GPU time spans all its occurrences. */
+        if (scope.m_query_frame[buffer] != s_frame)
+        {
+            glQueryCounter(scope.m_queries[buffer][0], GL_TIMESTAMP);
+
+            scope.m_query_frame [buffer] = s_frame;
+            scope.m_cpu_frame_ms[buffer] = 0.0f;
+
+            s_frame_scopes[buffer].push_back(index);
+        }
+
+        scope.m_cpu_begin = Timer::getTime();
+        s_stack.push_back(index);
+
+        if (s_is_pipeline_stats_active)
+        {
+            EndStatsSegment();
+            BeginStatsSegment(index);
+        }
+    }
+
+    void Profiler::EndScope()
+    {
+        if (!s_is_frame_active || s_stack.empty())
+        {
+            return;
+        }
+
+        const uint32_t buffer = s_frame % FRAMES_COUNT;
+        Scope&         scope  = s_scopes[s_stack.back()];
+
+        glQueryCounter(scope.m_queries[buffer][1], GL_TIMESTAMP);
+
+        scope.m_cpu_frame_ms[buffer] += float((Timer::getTime() - scope.m_cpu_begin) * 1000.0);
+        s_stack.pop_back();
+
+        /* The parent goes on counting. */
+        if (s_is_pipeline_stats_active)
+        {
+            EndStatsSegment();
+
+            if (!s_stack.empty())
+            {
+                BeginStatsSegment(s_stack.back());
+            }
+        }
+    }
+
+    std::string Profiler::GetCurrentScopePath()
+    {
+        std::string path;
+
+        if (!s_is_frame_active)
+        {
+            return path;
+        }
+
+        for (uint32_t index : s_stack)
+        {
+            if (!path.empty())
+            {
+                path += " / ";
+            }
+
+            path += s_scopes[index].m_name;
+        }
+
+        return path;
+    }
+
+    void Profiler::BeginStatsSegment(uint32_t scope)
+    {
+        const uint32_t buffer   = s_frame % FRAMES_COUNT;
+        auto&          segments = s_stats_segments[buffer];
+
+        if (s_stats_segments_count[buffer] == segments.size())
+        {
+            StatsSegment segment {};
+
+            for (uint32_t stat = 0; stat < PIPELINE_STATS_COUNT; ++stat)
+            {
+                glCreateQueries(PIPELINE_STATS_TARGETS[stat], 1, &segment.m_queries[stat]);
+            }
+
+            segments.push_back(segment);
+        }
+
+        StatsSegment& segment = segments[s_stats_segments_count[buffer]++];
+        segment.m_scope = scope;
+
+        for (uint32_t stat = 0; stat < PIPELINE_STATS_COUNT; ++stat)
+        {
+            glBeginQuery(PIPELINE_STATS_TARGETS[stat], segment.m_queries[stat]);
+        }
+
+        s_is_stats_segment_open = true;
+    }
+
+    void Profiler::EndStatsSegment()
+    {
+        /* Nothing is open before the first scope begins and after the last one ends. */
+        if (!s_is_stats_segment_open)
+        {
+            return;
+        }
+
+        for (uint32_t stat = 0; stat < PIPELINE_STATS_COUNT; ++stat)
+        {
+            glEndQuery(PIPELINE_STATS_TARGETS[stat]);
+        }
+
+        s_is_stats_segment_open = false;
+    }
+
+    void Profiler::ResolveQueries(uint32_t buffer)
+    {
+        if (s_frame_scopes[buffer].empty())
+        {
+            return;
+        }
+
+        for (uint32_t index : s_frame_scopes[buffer])
+        {
+            Scope& scope = s_scopes[index];
+
+            GLint is_available = s_is_waiting_for_results;
+
+            if (!is_available)
+            {
+                glGetQueryObjectiv(scope.m_queries[buffer][1], GL_QUERY_RESULT_AVAILABLE, &is_available);
+            }
+
+            /* By default, never wait for the results - the last value is kept instead. */
+            if (is_available)
+            {
+                GLuint64 begin = 0, end = 0;
+                glGetQueryObjectui64v(scope.m_queries[buffer][0], GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(scope.m_queries[buffer][1], GL_QUERY_RESULT, &end);
+
+                scope.m_gpu_ms = float(double(end - begin) / 1000000.0);
+            }
+
+            scope.m_cpu_ms = scope.m_cpu_frame_ms[buffer];
+
+            scope.m_cpu_history[scope.m_history_offset] = scope.m_cpu_ms;
+            scope.m_gpu_history[scope.m_history_offset] = scope.m_gpu_ms;
+            scope.m_history_offset = (scope.m_history_offset + 1) % HISTORY_SIZE;
+        }
+
+        s_resolved_scopes = s_frame_scopes[buffer];
+        s_resolved_frame  = s_frame - FRAMES_COUNT;
+    }
+
+    void Profiler::ResolvePipelineStats(uint32_t buffer)
+    {
+        const uint32_t count    = s_stats_segments_count[buffer];
+        const auto&    segments = s_stats_segments[buffer];
+
+        if (count == 0)
+        {
+            return;
+        }
+
+        /* The whole frame or nothing, the queries finish in order. */
+        if (!s_is_waiting_for_results)
+        {
+            GLint is_available = GL_FALSE;
+            glGetQueryObjectiv(segments[count - 1].m_queries[FRAGMENTS], GL_QUERY_RESULT_AVAILABLE, &is_available);
+
+            if (!is_available)
+            {
+                return;
+            }
+        }
+
+        for (uint32_t index : s_frame_scopes[buffer])
+        {
+            std::fill(std::begin(s_scopes[index].m_pipeline_stats), std::end(s_scopes[index].m_pipeline_stats), 0);
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            for (uint32_t stat = 0; stat < PIPELINE_STATS_COUNT; ++stat)
+            {
+                GLuint64 value = 0;
+                glGetQueryObjectui64v(segments[i].m_queries[stat], GL_QUERY_RESULT, &value);
+
+                for (uint32_t scope = segments[i].m_scope; scope != NO_PARENT; scope = s_scopes[scope].m_parent)
+                {
+                    s_scopes[scope].m_pipeline_stats[stat] += value;
+                }
+            }
+        }
+    }
+
+    void Profiler::Release()
+    {
+        for (auto& scope : s_scopes)
+        {
+            glDeleteQueries(FRAMES_COUNT * 2, &scope.m_queries[0][0]);
+        }
+
+        for (uint32_t buffer = 0; buffer < FRAMES_COUNT; ++buffer)
+        {
+            for (auto& segment : s_stats_segments[buffer])
+            {
+                glDeleteQueries(PIPELINE_STATS_COUNT, segment.m_queries);
+            }
+
+            s_stats_segments[buffer].clear();
+            s_stats_segments_count[buffer] = 0;
+        }
+
+        s_scopes.clear();
+        s_stack.clear();
+        s_resolved_scopes.clear();
+
+        for (auto& frame_scopes : s_frame_scopes)
+        {
+            frame_scopes.clear();
+        }
+
+        s_selected_scope        = 0;
+        s_is_frame_active       = false;
+        s_is_stats_segment_open = false;
+    }
+
+    void Profiler::RenderGui()
+    {
+        if (IsPipelineStatsSupported())
+        {
+            ImGui::Checkbox("Pipeline statistics", &s_is_pipeline_stats_enabled);
+        }
+
+        if (s_resolved_scopes.empty())
+        {
+            return;
+        }
+
+        const bool has_stats = s_is_pipeline_stats_enabled && IsPipelineStatsSupported();
+
+        if (ImGui::BeginTable("##Profiler", has_stats ? 6 : 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+        {
+            ImGui::TableSetupColumn("Pass", ImGuiTableColumnFlags_WidthStretch);
+            ImGui::TableSetupColumn("GPU ms");
+            ImGui::TableSetupColumn("CPU ms");
+
+            if (has_stats)
+            {
+                ImGui::TableSetupColumn("Verts");
+                ImGui::TableSetupColumn("Prims");
+                ImGui::TableSetupColumn("Frags");
+            }
+
+            ImGui::TableHeadersRow();
+
+            for (uint32_t index : s_resolved_scopes)
+            {
+                const Scope& scope = s_scopes[index];
+
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::SetCursorPosX(ImGui::GetCursorPosX() + scope.m_depth * 8.0f);
+
+                ImGui::PushID(index);
+                if (ImGui::Selectable(scope.m_name.c_str(), s_selected_scope == index, ImGuiSelectableFlags_SpanAllColumns))
+                {
+                    s_selected_scope = index;
+                }
+                ImGui::PopID();
+
+                ImGui::TableNextColumn(); ImGui::Text("%.3f", scope.m_gpu_ms);
+                ImGui::TableNextColumn(); ImGui::Text("%.3f", scope.m_cpu_ms);
+
+                if (has_stats)
+                {
+                    for (uint64_t count : scope.m_pipeline_stats)
+                    {
+                        char text[16];
+                        formatCount(text, sizeof(text), count);
+
+                        ImGui::TableNextColumn(); ImGui::TextUnformatted(text);
+                    }
+                }
+            }
+
+            ImGui::EndTable();
+        }
+
+        if (s_selected_scope < s_scopes.size())
+        {
+            const Scope& scope = s_scopes[s_selected_scope];
+
+            /* The graphs start at zero and scale to the maximum of the history. */
+            ImGui::Text("%s", scope.m_name.c_str());
+            ImGui::PlotLines("GPU", scope.m_gpu_history, HISTORY_SIZE, scope.m_history_offset, nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+            ImGui::PlotLines("CPU", scope.m_cpu_history, HISTORY_SIZE, scope.m_history_offset, nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+        }
+    }
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+namespace RGL
+{
+    /*
+     * Hierarchical CPU and GPU frame profiler. Every scope records the CPU time between its begin and end, and two
+     * GL_TIMESTAMP queries (glQueryCounter) - unlike GL_TIME_ELAPSED, the timestamps can be nested.
+     * The queries are double-buffered: the results of a frame are read at the beginning of the frame after next,
+     * and only if they are already available, so reading them never stalls the pipeline.
+     *
+     *     {
+     *         RGL::ProfilerScope scope("Shadow map");
+     *         ... draws ...
+     *     }
+     *
+     * CoreApp calls BeginFrame()/EndFrame() around render() and render_gui() and shows the table in the Perf info overlay.
+     * A scope is identified by its name and its parent, a scope entered again in the same frame accumulates its times.
+     *
+     * With SetPipelineStatsEnabled() the scopes also count the submitted vertices and primitives and the fragment
+     * shader invocations (ARB_pipeline_statistics_query, core in 4.6). Only one query of a kind can be active, so
+     * a scope's queries are paused while its children run - every run between the begins and the ends is a segment
+     * with its own queries, the resolve adds the segments up to their scopes and the scopes to their parents.
+     */
+    class Profiler
+    {
+    public:
+        static constexpr uint32_t FRAMES_COUNT = 2;
+        static constexpr uint32_t HISTORY_SIZE = 128;
+
+        enum PipelineStat : uint32_t { VERTICES, PRIMITIVES, FRAGMENTS, PIPELINE_STATS_COUNT };
+
+        struct Scope
+        {
+            std::string m_name;
+            uint32_t    m_parent;
+            uint32_t    m_depth;
+
+            GLuint      m_queries    [FRAMES_COUNT][2];
+            uint64_t    m_query_frame[FRAMES_COUNT];    /* Frame that used the queries, 0 if none. */
+
+            double      m_cpu_begin;
+            float       m_cpu_frame_ms[FRAMES_COUNT];   /* Accumulated in the frame that used the buffer. */
+            float       m_cpu_ms;                       /* Last resolved frame. */
+            float       m_gpu_ms;                       /* Last resolved frame, kept if the queries weren't ready. */
+
+            float       m_cpu_history[HISTORY_SIZE];
+            float       m_gpu_history[HISTORY_SIZE];
+            uint32_t    m_history_offset;
+
+            /* Last resolved frame with the pipeline statistics, the children included. */
+            uint64_t    m_pipeline_stats[PIPELINE_STATS_COUNT];
+        };
+
+        static void SetEnabled(bool enable) { s_is_enabled = enable; }
+        static bool IsEnabled()             { return s_is_enabled; }
+
+        /* Applied from the next BeginFrame(). */
+        static void SetPipelineStatsEnabled(bool enable) { s_is_pipeline_stats_enabled = enable; }
+        static bool IsPipelineStatsEnabled()             { return s_is_pipeline_stats_enabled; }
+        static bool IsPipelineStatsSupported()           { return GLAD_GL_VERSION_4_6 || GLAD_GL_ARB_pipeline_statistics_query; }
+
+        /* Makes the resolve wait for the query results instead of keeping the last value, used by the benchmark mode. */
+        static void SetWaitForResults(bool enable) { s_is_waiting_for_results = enable; }
+
+        static void BeginFrame();
+        static void EndFrame();
+
+        static void BeginScope(const char* name);
+        static void EndScope();
+
+        /* Deletes the queries, has to be called before the GL context is destroyed. */
+        static void Release();
+
+        /* Scopes of the last resolved frame, in the order of their first begin - the parents precede their children. */
+        static const std::vector<uint32_t>& GetResolvedScopes()       { return s_resolved_scopes; }
+        static const Scope&                 GetScope(uint32_t index)  { return s_scopes[index]; }
+
+        /* Number of the current frame and of the frame that GetResolvedScopes() belong to, both starting at 1. */
+        static uint64_t GetFrame()         { return s_frame; }
+        static uint64_t GetResolvedFrame() { return s_resolved_frame; }
+
+        /* The names of the open scopes from the outermost one joined by " / ", "" outside of a frame. */
+        static std::string GetCurrentScopePath();
+
+        /* Hierarchical table with the times and the history graphs of the selected scope. */
+        static void RenderGui();
+
+    private:
+        static constexpr uint32_t NO_PARENT = 0xFFFFFFFF;
+
+        /* The run of a scope between its children, see above. */
+        struct StatsSegment
+        {
+            uint32_t m_scope;
+            GLuint   m_queries[PIPELINE_STATS_COUNT];
+        };
+
+        static uint32_t FindOrAddScope(const char* name, uint32_t parent);
+        static void     ResolveQueries(uint32_t buffer);
+        static void     ResolvePipelineStats(uint32_t buffer);
+
+        static void     BeginStatsSegment(uint32_t scope);
+        static void     EndStatsSegment();
+
+        static bool                  s_is_enabled;
+        static bool                  s_is_frame_active;
+        static bool                  s_is_waiting_for_results;
+        static bool                  s_is_pipeline_stats_enabled;
+        static bool                  s_is_pipeline_stats_active;
+        static bool                  s_is_stats_segment_open;
+        static uint64_t              s_frame;
+        static uint64_t              s_resolved_frame;
+        static uint32_t              s_selected_scope;
+        static std::vector<Scope>    s_scopes;
+        static std::vector<uint32_t> s_stack;
+        static std::vector<uint32_t> s_frame_scopes[FRAMES_COUNT];
+        static std::vector<uint32_t> s_resolved_scopes;
+
+        /* The segments of the frames, the first s_stats_segments_count[buffer] are used - the rest keep their queries. */
+        static std::vector<StatsSegment> s_stats_segments[FRAMES_COUNT];
+        static uint32_t                  s_stats_segments_count[FRAMES_COUNT];
+    };
+
+    /* Profiles the enclosing block. */
+    class ProfilerScope final
+    {
+    public:
+        explicit ProfilerScope(const char* name) { Profiler::BeginScope(name); }
+        ~ProfilerScope()                         { Profiler::EndScope(); }
+
+        ProfilerScope           (const ProfilerScope&) = delete;
+        ProfilerScope& operator=(const ProfilerScope&) = delete;
+    };
+}
@@ -0,0 +1,369 @@
+#include "reflection_probes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "core_shared.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+#include "shader.h"
+#include "trace.h"
+#include "window.h"
+
+namespace RGL
+{
+    ReflectionProbes::~ReflectionProbes()
+    {
+        Release();
+    }
+
+    bool ReflectionProbes::Create(const Settings& settings)
+    {
+        RGL_TRACE_ZONE("ReflectionProbes::Create");
+
+        Release();
+
+        m_settings             = settings;
+        m_settings.m_max_count = std::clamp(m_settings.m_max_count, 1u, uint32_t(REFLECTION_PROBES_MAX_COUNT));
+
+        m_prefilter_shader = std::make_shared<Shader>("src/core/shaders/ibl/prefilter_cubemap.comp");
+
+        if (!m_prefilter_shader->link())
+        {
+            fprintf(stderr, "ReflectionProbes: the prefilter shader failed to link.\n");
+            return false;
+        }
+
+        /* The capture has all the levels for the filtered importance sampling, the probes stop at 2x2 like the IBL. */
+        const uint32_t capture_levels_count = uint32_t(std::floor(std::log2(float(m_settings.m_size)))) + 1;
+        m_levels_count                      = std::max(capture_levels_count - 1, 1u);
+
+        glCreateTextures  (GL_TEXTURE_CUBE_MAP, 1, &m_capture_map_name);
+        glTextureStorage2D(m_capture_map_name, capture_levels_count, GL_RGBA16F, m_settings.m_size, m_settings.m_size);
+        GpuMemory::TrackTexture(m_capture_map_name, "ReflectionProbes");
+
+        glCreateTextures  (GL_TEXTURE_CUBE_MAP_ARRAY, 1, &m_probes_array_name);
+        glTextureStorage3D(m_probes_array_name, m_levels_count, GL_RGBA16F, m_settings.m_size, m_settings.m_size, 6 * m_settings.m_max_count);
+        GpuMemory::TrackTexture(m_probes_array_name, "ReflectionProbes");
+
+        for (GLuint name : { m_capture_map_name, m_probes_array_name })
+        {
+            glTextureParameteri(name, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTextureParameteri(name, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTextureParameteri(name, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+            glTextureParameteri(name, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+            glTextureParameteri(name, GL_TEXTURE_WRAP_R,     GL_CLAMP_TO_EDGE);
+        }
+
+        glCreateRenderbuffers    (1, &m_depth_buffer_name);
+        glNamedRenderbufferStorage(m_depth_buffer_name, GL_DEPTH_COMPONENT32F, m_settings.m_size, m_settings.m_size);
+
+        glCreateFramebuffers          (1, &m_fbo_name);
+        glNamedFramebufferRenderbuffer(m_fbo_name, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depth_buffer_name);
+
+        glCreateBuffers     (1, &m_probes_buffer_name);
+        glNamedBufferStorage(m_probes_buffer_name, sizeof(ReflectionProbesData), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        GpuMemory::TrackBuffer(m_probes_buffer_name, "ReflectionProbes");
+
+        m_free_queries.resize(QUERIES_COUNT);
+        glCreateQueries(GL_TIME_ELAPSED, QUERIES_COUNT, m_free_queries.data());
+
+        /* Until the first costs are measured, every step is assumed to take the whole budget - one step per frame. */
+        m_step_ms[0]      = m_settings.m_gpu_budget_ms;
+        m_step_ms[1]      = m_settings.m_gpu_budget_ms;
+        m_is_buffer_dirty = true;
+
+        return true;
+    }
+
+    int ReflectionProbes::Add(const glm::vec3& position, float radius)
+    {
+        if (m_probes_array_name == 0 || m_probes.size() >= m_settings.m_max_count)
+        {
+            return -1;
+        }
+
+        const uint32_t index = uint32_t(m_probes.size());
+
+        Probe probe = {};
+        probe.m_position = position;
+        probe.m_radius   = radius;
+
+        glGenTextures(1, &probe.m_view_name);
+        glTextureView(probe.m_view_name, GL_TEXTURE_CUBE_MAP, m_probes_array_name, GL_RGBA16F, 0, m_levels_count, index * 6, 6);
+
+        m_probes.push_back(probe);
+
+        return int(index);
+    }
+
+    void ReflectionProbes::Move(uint32_t index, const glm::vec3& position)
+    {
+        m_probes[index].m_position = position;
+        m_is_buffer_dirty          = true;
+
+        /* The faces already captured are seen from the old position. */
+        if (index == m_current_probe)
+        {
+            m_current_step = 0;
+        }
+    }
+
+    void ReflectionProbes::SetRadius(uint32_t index, float radius)
+    {
+        m_probes[index].m_radius = radius;
+        m_is_buffer_dirty        = true;
+    }
+
+    void ReflectionProbes::Update(const CaptureCallback& capture)
+    {
+        RGL_TRACE_ZONE("ReflectionProbes::Update");
+
+        ResolveQueries();
+
+        m_stats.m_steps = 0;
+
+        if (!m_probes.empty())
+        {
+            /* A full cycle of all the probes at the most, the budget of an empty scene could be infinite otherwise. */
+            const uint32_t max_steps = (6 + m_levels_count) * uint32_t(m_probes.size());
+            float          spent_ms  = 0.0f;
+
+            while (m_stats.m_steps < max_steps)
+            {
+                const float step_ms = m_step_ms[uint32_t(m_current_step < 6 ? StepType::FACE : StepType::PREFILTER_LEVEL)];
+
+                /* At least one step, so the probes keep updating however small the budget is. */
+                if (m_stats.m_steps > 0 && spent_ms + step_ms > m_settings.m_gpu_budget_ms)
+                {
+                    break;
+                }
+
+                RunStep(capture);
+
+                spent_ms += step_ms;
+                m_stats.m_steps++;
+            }
+
+            GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+            GLState::Viewport       (0, 0, Window::getWidth(), Window::getHeight());
+        }
+
+        if (m_is_buffer_dirty)
+        {
+            UpdateBuffer();
+        }
+    }
+
+    void ReflectionProbes::Bind() const
+    {
+        GLState::BindTextureUnit(REFLECTION_PROBES_UNIT, m_probes_array_name);
+        glBindBufferBase(GL_UNIFORM_BUFFER, REFLECTION_PROBES_UBO_BINDING_INDEX, m_probes_buffer_name);
+    }
+
+    void ReflectionProbes::Release()
+    {
+        for (auto& probe : m_probes)
+        {
+            glDeleteTextures(1, &probe.m_view_name);
+            GLState::OnTextureDeleted(probe.m_view_name);
+        }
+
+        m_probes.clear();
+
+        for (GLuint* name : { &m_probes_array_name, &m_capture_map_name })
+        {
+            if (*name != 0)
+            {
+                GpuMemory::UntrackTexture(*name);
+                glDeleteTextures(1, name);
+                GLState::OnTextureDeleted(*name);
+                *name = 0;
+            }
+        }
+
+        if (m_fbo_name != 0)
+        {
+            glDeleteFramebuffers(1, &m_fbo_name);
+            GLState::OnFramebufferDeleted(m_fbo_name);
+            m_fbo_name = 0;
+        }
+
+        if (m_depth_buffer_name != 0)
+        {
+            glDeleteRenderbuffers(1, &m_depth_buffer_name);
+            m_depth_buffer_name = 0;
+        }
+
+        if (m_probes_buffer_name != 0)
+        {
+            GpuMemory::UntrackBuffer(m_probes_buffer_name);
+            glDeleteBuffers(1, &m_probes_buffer_name);
+            m_probes_buffer_name = 0;
+        }
+
+        for (const auto& pending : m_pending_queries)
+        {
+            m_free_queries.push_back(pending.m_query_name);
+        }
+
+        if (!m_free_queries.empty())
+        {
+            glDeleteQueries(GLsizei(m_free_queries.size()), m_free_queries.data());
+        }
+
+        m_free_queries   .clear();
+        m_pending_queries.clear();
+        m_prefilter_shader.reset();
+
+        m_current_probe = 0;
+        m_current_step  = 0;
+        m_stats         = {};
+    }
+
+    void ReflectionProbes::RunStep(const CaptureCallback& capture)
+    {
+        const StepType type  = m_current_step < 6 ? StepType::FACE : StepType::PREFILTER_LEVEL;
+        GLuint         query = 0;
+
+        /* All the queries are in flight when the results are late, the step just isn't measured then. */
+        if (!m_free_queries.empty())
+        {
+            query = m_free_queries.back();
+            m_free_queries.pop_back();
+
+            glBeginQuery(GL_TIME_ELAPSED, query);
+        }
+
+        if (type == StepType::FACE)
+        {
+            RenderFace(capture, m_current_step);
+        }
+        else
+        {
+            PrefilterLevel(m_current_step - 6);
+        }
+
+        if (query != 0)
+        {
+            glEndQuery(GL_TIME_ELAPSED);
+            m_pending_queries.push_back({ query, type });
+        }
+
+        if (++m_current_step == 6 + m_levels_count)
+        {
+            m_probes[m_current_probe].m_is_ready = true;
+            m_is_buffer_dirty                    = true;
+
+            m_current_step  = 0;
+            m_current_probe = (m_current_probe + 1) % uint32_t(m_probes.size());
+        }
+    }
+
+    void ReflectionProbes::RenderFace(const CaptureCallback& capture, uint32_t face)
+    {
+        RGL_TRACE_ZONE("Reflection probe face");
+
+        static const glm::vec3 directions[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1,  0 }, { 0, 0, 1 }, { 0,  0, -1 } };
+        static const glm::vec3 ups       [6] = { { 0, -1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0,  0, -1 }, { 0, -1, 0 }, { 0, -1,  0 } };
+
+        const Probe& probe = m_probes[m_current_probe];
+
+        CaptureView view;
+        view.m_view        = glm::lookAt(probe.m_position, probe.m_position + directions[face], ups[face]);
+        view.m_projection  = glm::perspective(glm::radians(90.0f), 1.0f, m_settings.m_near, m_settings.m_far);
+        view.m_position    = probe.m_position;
+        view.m_probe_index = m_current_probe;
+        view.m_face        = face;
+
+        glNamedFramebufferTextureLayer(m_fbo_name, GL_COLOR_ATTACHMENT0, m_capture_map_name, 0, face);
+
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, m_fbo_name);
+        GLState::Viewport       (0, 0, m_settings.m_size, m_settings.m_size);
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        capture(view);
+
+        /* The prefiltering reads the mips matching the samples' solid angles. */
+        if (face == 5)
+        {
+            glGenerateTextureMipmap(m_capture_map_name);
+        }
+    }
+
+    void ReflectionProbes::PrefilterLevel(uint32_t level)
+    {
+        RGL_TRACE_ZONE("Reflection probe prefilter");
+
+        const float    roughness = m_levels_count > 1 ? float(level) / float(m_levels_count - 1) : 0.0f;
+        const uint32_t size      = std::max(m_settings.m_size >> level, 1u);
+        const uint32_t samples   = level == 0 ? 1 : std::max(uint32_t(float(m_settings.m_sample_count) * roughness), std::min(m_settings.m_sample_count, 16u));
+
+        m_prefilter_shader->bind();
+        m_prefilter_shader->setUniform("u_roughness",    roughness);
+        m_prefilter_shader->setUniform("u_size",         int(size));
+        m_prefilter_shader->setUniform("u_sample_count", int(samples));
+
+        GLState::BindTextureUnit(0, m_capture_map_name);
+        glBindImageTexture(0, m_probes[m_current_probe].m_view_name, level, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+        glDispatchCompute((size + IBL_PREFILTER_GROUP_SIZE - 1) / IBL_PREFILTER_GROUP_SIZE, (size + IBL_PREFILTER_GROUP_SIZE - 1) / IBL_PREFILTER_GROUP_SIZE, 6);
+        glMemoryBarrier  (GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+
+    void ReflectionProbes::ResolveQueries()
+    {
+        /* The queries finish in order, the first one that isn't ready ends the resolve - it never waits. */
+        size_t resolved = 0;
+
+        for (; resolved < m_pending_queries.size(); ++resolved)
+        {
+            const auto& pending = m_pending_queries[resolved];
+
+            GLint is_available = 0;
+            glGetQueryObjectiv(pending.m_query_name, GL_QUERY_RESULT_AVAILABLE, &is_available);
+
+            if (!is_available)
+            {
+                break;
+            }
+
+            GLuint64 elapsed_ns = 0;
+            glGetQueryObjectui64v(pending.m_query_name, GL_QUERY_RESULT, &elapsed_ns);
+
+            float& step_ms = m_step_ms[uint32_t(pending.m_type)];
+            step_ms = glm::mix(step_ms, float(double(elapsed_ns) / 1000000.0), 0.2f);
+
+            m_free_queries.push_back(pending.m_query_name);
+        }
+
+        m_pending_queries.erase(m_pending_queries.begin(), m_pending_queries.begin() + resolved);
+
+        m_stats.m_face_ms            = m_step_ms[uint32_t(StepType::FACE)];
+        m_stats.m_prefilter_level_ms = m_step_ms[uint32_t(StepType::PREFILTER_LEVEL)];
+    }
+
+    void ReflectionProbes::UpdateBuffer()
+    {
+        /* Only the probes captured at least once, the blank layers would darken the blend. */
+        ReflectionProbesData data = {};
+
+        for (uint32_t i = 0; i < m_probes.size(); ++i)
+        {
+            if (m_probes[i].m_is_ready)
+            {
+                auto& probe_data = data.probes[data.probes_count++];
+
+                probe_data.position_radius = glm::vec4(m_probes[i].m_position, m_probes[i].m_radius);
+                probe_data.layer           = i;
+            }
+        }
+
+        glNamedBufferSubData(m_probes_buffer_name, 0, sizeof(data), &data);
+        m_is_buffer_dirty = false;
+    }
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+namespace RGL
+{
+    class Shader;
+
+    /*
+     * Reflection probes captured from the scene at runtime. The capture is time-sliced: an update step renders one face
+     * of a probe or prefilters one of its levels, and Update() runs as many steps per frame as fit in the GPU budget -
+     * all the probes are cycled through round-robin, so a probe is refreshed every (6 + levels) * probes steps at the most.
+     * The step costs are measured with GL_TIME_ELAPSED queries, read back a few frames later without stalling.
+     *
+     * The faces are rendered into a capture cubemap shared by all the probes, the last face step generates its mipmaps
+     * and the levels are prefiltered (shaders/ibl/prefilter_cubemap.comp) into the probe's layer of a cubemap array.
+     * The lighting shaders blend the probes around the shaded point with sampleReflectionProbes()
+     * (shaders/reflection_probes.glh), a probe takes part once it's been captured the first time. Render thread only.
+     *
+     *     probes.Create();
+     *     probes.Add(position, radius);
+     *     ...
+     *     probes.Update([&](const ReflectionProbes::CaptureView& view) { ... render the scene ... });
+     *     probes.Bind();
+     */
+    class ReflectionProbes final
+    {
+    public:
+        struct Settings
+        {
+            uint32_t m_size           = 256;
+            uint32_t m_max_count      = 8;    /* At most REFLECTION_PROBES_MAX_COUNT. */
+            uint32_t m_sample_count   = 64;   /* Prefilter samples at the roughness 1. */
+            float    m_gpu_budget_ms  = 1.0f;
+            float    m_near           = 0.05f;
+            float    m_far            = 200.0f;
+        };
+
+        /* What the capture callback renders: one face of the probe, the framebuffer and the viewport are already set. */
+        struct CaptureView
+        {
+            glm::mat4 m_view;
+            glm::mat4 m_projection;
+            glm::vec3 m_position;
+            uint32_t  m_probe_index;
+            uint32_t  m_face;
+        };
+
+        using CaptureCallback = std::function<void(const CaptureView& view)>;
+
+        struct Stats
+        {
+            uint32_t m_steps;               /* Steps run in the last Update(). */
+            float    m_face_ms;             /* Measured average GPU costs of the steps. */
+            float    m_prefilter_level_ms;
+        };
+
+        ReflectionProbes() = default;
+        ~ReflectionProbes();
+
+        ReflectionProbes           (const ReflectionProbes&) = delete;
+        ReflectionProbes& operator=(const ReflectionProbes&) = delete;
+
+        bool Create(const Settings& settings = Settings());
+
+        /* Returns the index of the probe, or -1 if there are m_max_count probes already. The radius bounds its influence. */
+        int  Add     (const glm::vec3& position, float radius);
+        void Move    (uint32_t index, const glm::vec3& position);
+        void SetRadius(uint32_t index, float radius);
+
+        /* Runs the capture steps that fit in the budget, at least one. Call it before the passes that sample the probes. */
+        void Update(const CaptureCallback& capture);
+
+        /* Binds the probes' cubemap array to REFLECTION_PROBES_UNIT and their data to REFLECTION_PROBES_UBO_BINDING_INDEX. */
+        void Bind() const;
+
+        void  SetGpuBudget(float ms) { m_settings.m_gpu_budget_ms = ms; }
+        float GetGpuBudget() const   { return m_settings.m_gpu_budget_ms; }
+
+        uint32_t        GetCount()    const { return uint32_t(m_probes.size()); }
+        const Settings& GetSettings() const { return m_settings; }
+        const Stats&    GetStats()    const { return m_stats; }
+
+    private:
+        static constexpr uint32_t QUERIES_COUNT = 32;
+
+        enum class StepType { FACE, PREFILTER_LEVEL };
+
+        struct Probe
+        {
+            glm::vec3 m_position;
+            float     m_radius;
+            GLuint    m_view_name;  /* The probe's layer of the array, as an image cube for the prefiltering. */
+            bool      m_is_ready;
+        };
+
+        struct PendingQuery
+        {
+            GLuint   m_query_name;
+            StepType m_type;
+        };
+
+        void Release();
+
+        void RunStep(const CaptureCallback& capture);
+        void RenderFace(const CaptureCallback& capture, uint32_t face);
+        void PrefilterLevel(uint32_t level);
+
+        void ResolveQueries();
+        void UpdateBuffer();
+
+        Settings m_settings;
+        Stats    m_stats = {};
+
+        std::shared_ptr<Shader> m_prefilter_shader;
+        std::vector<Probe>      m_probes;
+
+        GLuint   m_probes_array_name   = 0;
+        GLuint   m_capture_map_name    = 0;
+        GLuint   m_depth_buffer_name   = 0;
+        GLuint   m_fbo_name            = 0;
+        GLuint   m_probes_buffer_name  = 0;
+        uint32_t m_levels_count        = 0;
+        bool     m_is_buffer_dirty     = true;
+
+        /* The probe being captured and its next step: the faces 0..5, then the levels. */
+        uint32_t m_current_probe = 0;
+        uint32_t m_current_step  = 0;
+
+        /* The measured step costs, an exponential moving average. */
+        float m_step_ms[2] = {};
+
+        std::vector<GLuint>       m_free_queries;
+        std::vector<PendingQuery> m_pending_queries;
+    };
+}
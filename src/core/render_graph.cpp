@@ -0,0 +1,335 @@
+#include "render_graph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <string>
+
+#include "frame_allocator.h"
+#include "profiler.h"
+#include "trace.h"
+
+#include "gui/gui.h"
+
+namespace RGL
+{
+    namespace
+    {
+        constexpr uint64_t BUFFER_KEY  = uint64_t(1) << 32;
+        constexpr uint64_t TEXTURE_KEY = uint64_t(2) << 32;
+
+        std::string getBarrierBitsString(GLbitfield bits)
+        {
+            static const std::pair<GLbitfield, const char*> names[] = {
+                { GL_SHADER_STORAGE_BARRIER_BIT,      "storage"  },
+                { GL_UNIFORM_BARRIER_BIT,             "uniform"  },
+                { GL_COMMAND_BARRIER_BIT,             "command"  },
+                { GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT, "vertex"   },
+                { GL_ELEMENT_ARRAY_BARRIER_BIT,       "index"    },
+                { GL_ATOMIC_COUNTER_BARRIER_BIT,      "atomic"   },
+                { GL_SHADER_IMAGE_ACCESS_BARRIER_BIT, "image"    },
+                { GL_TEXTURE_FETCH_BARRIER_BIT,       "texture"  },
+                { GL_FRAMEBUFFER_BARRIER_BIT,         "fbo"      },
+                { GL_BUFFER_UPDATE_BARRIER_BIT,       "buffer"   },
+                { GL_TEXTURE_UPDATE_BARRIER_BIT,      "tex upd"  },
+            };
+
+            std::string result;
+
+            for (const auto& [bit, name] : names)
+            {
+                if (bits & bit)
+                {
+                    result += result.empty() ? name : std::string(" | ") + name;
+                }
+            }
+
+            return result.empty() ? "-" : result;
+        }
+    }
+
+    RenderGraph::PassBuilder& RenderGraph::PassBuilder::Read(Resource resource, Access access)
+    {
+        m_graph.m_passes[m_pass].m_uses.push_back({ resource, access, false });
+        return *this;
+    }
+
+    RenderGraph::PassBuilder& RenderGraph::PassBuilder::Write(Resource resource, Access access)
+    {
+        m_graph.m_passes[m_pass].m_uses.push_back({ resource, access, true });
+        return *this;
+    }
+
+    RenderGraph::PassBuilder& RenderGraph::PassBuilder::SetSideEffects()
+    {
+        m_graph.m_passes[m_pass].m_has_side_effects = true;
+        return *this;
+    }
+
+    RenderGraph::Resource RenderGraph::ImportBuffer(GLuint buffer_name)
+    {
+        return Import(BUFFER_KEY | buffer_name);
+    }
+
+    RenderGraph::Resource RenderGraph::ImportTexture(GLuint texture_name)
+    {
+        return Import(TEXTURE_KEY | texture_name);
+    }
+
+    RenderGraph::Resource RenderGraph::Import(uint64_t key)
+    {
+        /* Imported twice in a frame, it's still the same resource. */
+        for (uint32_t i = 0; i < m_resources.size(); ++i)
+        {
+            if (m_resources[i].m_key == key)
+            {
+                return i;
+            }
+        }
+
+        ResourceNode node = {};
+        node.m_key   = key;
+        node.m_state = m_imported_states[key];
+
+        m_resources.push_back(node);
+
+        return Resource(m_resources.size() - 1);
+    }
+
+    RenderGraph::Resource RenderGraph::CreateTarget(const RenderTargetDesc& desc)
+    {
+        ResourceNode node = {};
+        node.m_desc = desc;
+
+        m_resources.push_back(node);
+
+        return Resource(m_resources.size() - 1);
+    }
+
+    RenderGraph::PassBuilder RenderGraph::AddPass(const char* name, Callback execute)
+    {
+        m_passes.push_back({ name, std::move(execute), std::pmr::vector<Use>(FrameAllocator::GetResource()), false, false });
+
+        return PassBuilder(*this, uint32_t(m_passes.size() - 1));
+    }
+
+    void RenderGraph::Execute()
+    {
+        RGL_TRACE_ZONE("RenderGraph::Execute");
+
+        CullPasses();
+        ComputeLifetimes();
+
+        m_passes_info.clear();
+
+        for (uint32_t pass_index = 0; pass_index < m_passes.size(); ++pass_index)
+        {
+            Pass& pass = m_passes[pass_index];
+
+            m_passes_info.push_back({ pass.m_name, pass.m_is_culled, 0 });
+
+            if (pass.m_is_culled)
+            {
+                continue;
+            }
+
+            for (auto& resource : m_resources)
+            {
+                if (resource.m_key == 0 && resource.m_first_pass == pass_index)
+                {
+                    resource.m_target = RenderTargetPool::Acquire(resource.m_desc);
+                }
+            }
+
+            /* Only the accesses that haven't been made visible since the last incoherent write. */
+            GLbitfield barrier_bits = 0;
+
+            for (const auto& use : pass.m_uses)
+            {
+                const auto& state = m_resources[use.m_resource].m_state;
+
+                if (state.m_is_pending && !(state.m_visible_bits & GetBarrierBit(use.m_access)))
+                {
+                    barrier_bits |= GetBarrierBit(use.m_access);
+                }
+            }
+
+            if (barrier_bits != 0)
+            {
+                glMemoryBarrier(barrier_bits);
+
+                /* The barrier is global, it covers the writes of all the resources. */
+                for (auto& resource : m_resources)
+                {
+                    resource.m_state.m_visible_bits |= barrier_bits;
+                }
+
+                m_passes_info.back().m_barrier_bits = barrier_bits;
+            }
+
+            {
+                RGL_TRACE_ZONE(pass.m_name);
+                ProfilerScope scope(pass.m_name);
+
+                pass.m_execute(*this);
+            }
+
+            /* An incoherent write of the pass is the last one, whatever coherent writes (clears) precede it. */
+            for (const auto& use : pass.m_uses)
+            {
+                if (!use.m_is_write)
+                {
+                    continue;
+                }
+
+                auto& state = m_resources[use.m_resource].m_state;
+
+                if (IsIncoherent(use.m_access))
+                {
+                    state = { true, 0 };
+                }
+                else if (!std::any_of(pass.m_uses.begin(), pass.m_uses.end(), [&](const Use& other) { return other.m_resource == use.m_resource && other.m_is_write && IsIncoherent(other.m_access); }))
+                {
+                    state = {};
+                }
+            }
+
+            for (auto& resource : m_resources)
+            {
+                if (resource.m_key == 0 && resource.m_last_pass == pass_index)
+                {
+                    resource.m_target.reset();
+                }
+            }
+        }
+
+        for (const auto& resource : m_resources)
+        {
+            if (resource.m_key != 0)
+            {
+                m_imported_states[resource.m_key] = resource.m_state;
+            }
+        }
+
+        m_resources.clear();
+        m_passes   .clear();
+    }
+
+    RenderTarget& RenderGraph::GetTarget(Resource resource) const
+    {
+        assert(m_resources[resource].m_target && "The target is only available in the passes that declare it.");
+        return *m_resources[resource].m_target;
+    }
+
+    void RenderGraph::CullPasses()
+    {
+        std::pmr::vector<bool> is_read(m_resources.size(), false, FrameAllocator::GetResource());
+
+        /* Backwards, the readers of a resource decide whether its writers are needed. */
+        for (uint32_t i = uint32_t(m_passes.size()); i-- > 0;)
+        {
+            Pass& pass    = m_passes[i];
+            bool  is_kept = pass.m_has_side_effects;
+
+            for (const auto& use : pass.m_uses)
+            {
+                if (use.m_is_write && (m_resources[use.m_resource].m_key != 0 || is_read[use.m_resource]))
+                {
+                    is_kept = true;
+                }
+            }
+
+            pass.m_is_culled = !is_kept;
+
+            if (is_kept)
+            {
+                for (const auto& use : pass.m_uses)
+                {
+                    if (!use.m_is_write)
+                    {
+                        is_read[use.m_resource] = true;
+                    }
+                }
+            }
+        }
+    }
+
+    void RenderGraph::ComputeLifetimes()
+    {
+        for (auto& resource : m_resources)
+        {
+            resource.m_first_pass = NO_PASS;
+            resource.m_last_pass  = NO_PASS;
+        }
+
+        for (uint32_t i = 0; i < m_passes.size(); ++i)
+        {
+            if (m_passes[i].m_is_culled)
+            {
+                continue;
+            }
+
+            for (const auto& use : m_passes[i].m_uses)
+            {
+                auto& resource = m_resources[use.m_resource];
+
+                resource.m_first_pass = resource.m_first_pass == NO_PASS ? i : resource.m_first_pass;
+                resource.m_last_pass  = i;
+            }
+        }
+    }
+
+    GLbitfield RenderGraph::GetBarrierBit(Access access)
+    {
+        switch (access)
+        {
+            case Access::STORAGE:        return GL_SHADER_STORAGE_BARRIER_BIT;
+            case Access::UNIFORM:        return GL_UNIFORM_BARRIER_BIT;
+            case Access::INDIRECT:       return GL_COMMAND_BARRIER_BIT;
+            case Access::VERTEX:         return GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT;
+            case Access::INDEX:          return GL_ELEMENT_ARRAY_BARRIER_BIT;
+            case Access::ATOMIC_COUNTER: return GL_ATOMIC_COUNTER_BARRIER_BIT;
+            case Access::IMAGE:          return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+            case Access::TEXTURE:        return GL_TEXTURE_FETCH_BARRIER_BIT;
+            case Access::FRAMEBUFFER:    return GL_FRAMEBUFFER_BARRIER_BIT;
+            case Access::TRANSFER:       return GL_BUFFER_UPDATE_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT;
+        }
+
+        return GL_ALL_BARRIER_BITS;
+    }
+
+    bool RenderGraph::IsIncoherent(Access access)
+    {
+        /* The rest of the writes are ordered by GL itself. */
+        return access == Access::STORAGE || access == Access::IMAGE || access == Access::ATOMIC_COUNTER;
+    }
+
+    void RenderGraph::RenderGui() const
+    {
+        if (ImGui::BeginTable("##RenderGraph", 2, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+        {
+            ImGui::TableSetupColumn("Pass", ImGuiTableColumnFlags_WidthStretch);
+            ImGui::TableSetupColumn("Barrier");
+            ImGui::TableHeadersRow();
+
+            for (const auto& info : m_passes_info)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+
+                if (info.m_is_culled)
+                {
+                    ImGui::TextDisabled("%s (culled)", info.m_name);
+                }
+                else
+                {
+                    ImGui::Text("%s", info.m_name);
+                }
+
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", getBarrierBitsString(info.m_barrier_bits).c_str());
+            }
+
+            ImGui::EndTable();
+        }
+    }
+}
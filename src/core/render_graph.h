@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "render_target_pool.h"
+
+namespace RGL
+{
+    /*
+     * Frame graph of the passes and the buffers and textures they use. The passes are added every frame, each with
+     * the resources it reads and writes and how (Access), then Execute() runs them in the order they were added:
+     *
+     *   - culls the passes whose writes nobody reads - a pass is kept if it writes an imported resource, read by a later kept pass,
+     *     or has side effects,
+     *   - issues a single glMemoryBarrier() before a pass, with the bits of the accesses that would see an incoherent
+     *     write (shader storage, image, atomic counter) otherwise - the bits already issued since the write are left out,
+     *   - acquires the transient targets from RenderTargetPool right before their first pass and gives them back after
+     *     the last one, so the transients whose passes don't overlap alias the same textures.
+     *
+     * The writes of the imported resources are remembered between the frames (by the GL name), so the next frame's readers
+     * get their barriers too. Every pass is a Profiler scope and a trace zone. Render thread only.
+     *
+     *     auto flags = graph.ImportBuffer(m_flags_buffer);
+     *     graph.AddPass("Find visible clusters", [&](RenderGraph&) { ... glDispatchCompute(...); })
+     *          .Read (depth, RenderGraph::Access::TEXTURE)
+     *          .Write(flags, RenderGraph::Access::STORAGE);
+     *     graph.Execute();
+     */
+    class RenderGraph final
+    {
+    public:
+        /* How a pass uses a resource - each maps to the glMemoryBarrier() bit that makes the incoherent writes visible to it. */
+        enum class Access
+        {
+            STORAGE,        /* Shader storage buffer. */
+            UNIFORM,
+            INDIRECT,       /* Draw or dispatch indirect commands. */
+            VERTEX,
+            INDEX,
+            ATOMIC_COUNTER,
+            IMAGE,          /* Image load / store. */
+            TEXTURE,        /* Sampled. */
+            FRAMEBUFFER,    /* Attachment, blit. */
+            TRANSFER        /* Clear, sub data, copy or read back. */
+        };
+
+        using Resource = uint32_t;
+        using Callback = std::function<void(RenderGraph& graph)>;
+
+        class PassBuilder
+        {
+        public:
+            PassBuilder& Read (Resource resource, Access access);
+            PassBuilder& Write(Resource resource, Access access);
+
+            /* The pass is kept even if nothing reads what it writes (e.g. it reads back to the CPU). */
+            PassBuilder& SetSideEffects();
+
+        private:
+            friend class RenderGraph;
+
+            PassBuilder(RenderGraph& graph, uint32_t pass) : m_graph(graph), m_pass(pass) {}
+
+            RenderGraph& m_graph;
+            uint32_t     m_pass;
+        };
+
+        /* The last frame's passes as they were executed. */
+        struct PassInfo
+        {
+            const char* m_name;
+            bool        m_is_culled;
+            GLbitfield  m_barrier_bits;
+        };
+
+        RenderGraph() = default;
+
+        RenderGraph           (const RenderGraph&) = delete;
+        RenderGraph& operator=(const RenderGraph&) = delete;
+
+        Resource ImportBuffer (GLuint buffer_name);
+        Resource ImportTexture(GLuint texture_name);
+
+        /* A render target of this frame only, taken from RenderTargetPool. Its textures are available with GetTarget(). */
+        Resource CreateTarget(const RenderTargetDesc& desc);
+
+        /* The name has to be a string literal, it's used by the trace. */
+        PassBuilder AddPass(const char* name, Callback execute);
+
+        /* Runs the passes and clears the graph for the next frame. */
+        void Execute();
+
+        /* The transient target, only in the passes that use it. */
+        RenderTarget& GetTarget(Resource resource) const;
+
+        const std::vector<PassInfo>& GetPassesInfo() const { return m_passes_info; }
+
+        /* The table of the last frame's passes and their barriers. */
+        void RenderGui() const;
+
+        static GLbitfield GetBarrierBit(Access access);
+
+    private:
+        static constexpr uint32_t NO_PASS = 0xFFFFFFFF;
+
+        /* The state of the incoherent writes, kept in m_imported_states between the frames. */
+        struct WriteState
+        {
+            bool       m_is_pending   = false; /* Written incoherently, some accesses may not see it yet. */
+            GLbitfield m_visible_bits = 0;     /* The barriers issued since the write. */
+        };
+
+        struct ResourceNode
+        {
+            uint64_t                      m_key;          /* Of m_imported_states, 0 for the transients. */
+            RenderTargetDesc              m_desc;
+            std::shared_ptr<RenderTarget> m_target;
+            WriteState                    m_state;
+            uint32_t                      m_first_pass;
+            uint32_t                      m_last_pass;
+        };
+
+        struct Use
+        {
+            Resource m_resource;
+            Access   m_access;
+            bool     m_is_write;
+        };
+
+        struct Pass
+        {
+            const char*           m_name;
+            Callback              m_execute;
+            std::pmr::vector<Use> m_uses;   /* From the frame's arena, the passes last until Execute(). */
+            bool                  m_has_side_effects;
+            bool                  m_is_culled;
+        };
+
+        Resource Import(uint64_t key);
+
+        void CullPasses();
+        void ComputeLifetimes();
+
+        static bool IsIncoherent(Access access);
+
+        std::vector<ResourceNode> m_resources;
+        std::vector<Pass>         m_passes;
+        std::vector<PassInfo>     m_passes_info;
+
+        std::unordered_map<uint64_t, WriteState> m_imported_states;
+    };
+}
@@ -0,0 +1,183 @@
+#include "render_queue.h"
+
+#include <algorithm>
+
+namespace RGL
+{
+    namespace
+    {
+        constexpr uint32_t SHADER_BITS       = 15;
+        constexpr uint32_t VERTEX_ARRAY_BITS = 8;
+        constexpr uint32_t MATERIAL_BITS     = 16;
+        constexpr uint32_t DEPTH_BITS        = 24;
+
+        constexpr uint64_t BLENDED_BIT = uint64_t(1) << 63;
+    }
+
+    RenderQueue::RenderQueue()
+        : m_stats    {},
+          m_max_depth(0.0f),
+          m_is_sorted(true)
+    {
+    }
+
+    void RenderQueue::Submit(const std::shared_ptr<Shader>& shader, StaticModel& model, const glm::mat4& transform, const glm::vec3& camera_position, bool is_blended)
+    {
+        for (uint32_t i = 0; i < model.GetMeshPartsCount(); ++i)
+        {
+            glm::vec4 bounds = model.GetMeshPartBounds(i);
+            glm::vec3 center = glm::vec3(transform * glm::vec4(glm::vec3(bounds), 1.0f));
+
+            Submit({ shader.get(), &model, i, transform, glm::distance(center, camera_position), is_blended });
+        }
+    }
+
+    void RenderQueue::Submit(const RenderItem& item)
+    {
+        m_items.push_back(item);
+
+        m_max_depth = std::max(m_max_depth, item.m_depth);
+        m_is_sorted = false;
+    }
+
+    uint32_t RenderQueue::GetId(std::unordered_map<uint64_t, uint32_t>& ids, uint64_t object, uint32_t max_id)
+    {
+        auto [it, is_inserted] = ids.try_emplace(object, uint32_t(ids.size()));
+
+        /* The ids past the key bits share the last one - the items are still drawn, only sorted less precisely. */
+        return std::min(it->second, max_id);
+    }
+
+    void RenderQueue::Sort()
+    {
+        if (m_is_sorted)
+        {
+            return;
+        }
+
+        m_sorted.resize(m_items.size());
+
+        const float    depth_scale = m_max_depth > 0.0f ? float((1 << DEPTH_BITS) - 1) / m_max_depth : 0.0f;
+        const uint64_t max_depth   = (uint64_t(1) << DEPTH_BITS) - 1;
+
+        for (uint32_t i = 0; i < m_items.size(); ++i)
+        {
+            const RenderItem& item = m_items[i];
+
+            const Material* item_material = item.m_model->GetMeshPartMaterial(item.m_mesh_part);
+
+            uint64_t shader   = GetId(m_shader_ids,       uint64_t(uintptr_t(item.m_shader)),  (1 << SHADER_BITS)       - 1);
+            uint64_t vao      = GetId(m_vertex_array_ids, item.m_model->GetVertexArray(),      (1 << VERTEX_ARRAY_BITS) - 1);
+            uint64_t material = GetId(m_material_ids,     uint64_t(uintptr_t(item_material)),  (1 << MATERIAL_BITS)     - 1);
+            uint64_t depth    = std::min(uint64_t(std::max(item.m_depth, 0.0f) * depth_scale), max_depth);
+            uint64_t key;
+
+            if (item.m_is_blended)
+            {
+                key = BLENDED_BIT | ((max_depth - depth) << (SHADER_BITS + VERTEX_ARRAY_BITS + MATERIAL_BITS)) |
+                      (shader << (VERTEX_ARRAY_BITS + MATERIAL_BITS)) | (vao << MATERIAL_BITS) | material;
+            }
+            else
+            {
+                key = (shader << (VERTEX_ARRAY_BITS + MATERIAL_BITS + DEPTH_BITS)) | (vao << (MATERIAL_BITS + DEPTH_BITS)) | (material << DEPTH_BITS) | depth;
+            }
+
+            m_sorted[i] = { key, i };
+        }
+
+        /* LSD radix sort, 8 bits per pass. The passes where all the keys have the same byte are skipped. */
+        m_sort_scratch.resize(m_sorted.size());
+
+        for (uint32_t shift = 0; shift < 64; shift += 8)
+        {
+            uint32_t counts[256] = {};
+
+            for (const auto& entry : m_sorted)
+            {
+                counts[(entry.m_key >> shift) & 0xFF]++;
+            }
+
+            if (m_sorted.empty() || counts[(m_sorted[0].m_key >> shift) & 0xFF] == m_sorted.size())
+            {
+                continue;
+            }
+
+            uint32_t offset = 0;
+
+            for (auto& count : counts)
+            {
+                uint32_t bucket_size = count;
+
+                count   = offset;
+                offset += bucket_size;
+            }
+
+            for (const auto& entry : m_sorted)
+            {
+                m_sort_scratch[counts[(entry.m_key >> shift) & 0xFF]++] = entry;
+            }
+
+            m_sorted.swap(m_sort_scratch);
+        }
+
+        m_is_sorted = true;
+    }
+
+    void RenderQueue::Execute(const ItemCallback& callback)
+    {
+        Sort();
+
+        m_stats = {};
+
+        const Shader*   current_shader   = nullptr;
+        const Material* current_material = nullptr;
+        GLuint          current_vao      = 0;
+        bool            is_first         = true;
+
+        for (const auto& entry : m_sorted)
+        {
+            const RenderItem& item     = m_items[entry.m_item];
+            const Material*   material = item.m_model->GetMeshPartMaterial(item.m_mesh_part);
+            const GLuint      vao      = item.m_model->GetVertexArray();
+
+            /* The material uniforms are set on the program, so they have to be set again after a program change. */
+            const bool is_shader_changed   = is_first || item.m_shader != current_shader;
+            const bool is_vao_changed      = is_first || vao != current_vao;
+            const bool is_material_changed = is_shader_changed || material != current_material;
+
+            if (is_shader_changed)
+            {
+                item.m_shader->bind();
+                m_stats.m_program_changes++;
+            }
+
+            if (callback)
+            {
+                callback(*item.m_shader, item);
+            }
+
+            m_stats.m_vertex_array_changes += is_vao_changed      ? 1 : 0;
+            m_stats.m_material_changes     += is_material_changed ? 1 : 0;
+            m_stats.m_draws++;
+
+            item.m_model->RenderMeshPart(item.m_mesh_part, item.m_shader, is_vao_changed, is_material_changed);
+
+            current_shader   = item.m_shader;
+            current_material = material;
+            current_vao      = vao;
+            is_first         = false;
+        }
+    }
+
+    void RenderQueue::Clear()
+    {
+        m_items.clear();
+        m_sorted.clear();
+        m_shader_ids.clear();
+        m_vertex_array_ids.clear();
+        m_material_ids.clear();
+
+        m_max_depth = 0.0f;
+        m_is_sorted = true;
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include "material.h"
+#include "shader.h"
+#include "static_model.h"
+
+namespace RGL
+{
+    /* Single mesh part draw submitted to the RenderQueue. */
+    struct RenderItem
+    {
+        Shader*      m_shader;
+        StaticModel* m_model;
+        uint32_t     m_mesh_part;
+        glm::mat4    m_transform;
+        float        m_depth;      /* View distance of the mesh part's bounds center. */
+        bool         m_is_blended;
+    };
+
+    /*
+     * Collects the mesh part draws of a frame and executes them sorted by 64-bit keys (LSD radix sort):
+     *
+     * opaque  - 0 | shader (15 bits) | vertex array (8 bits) | material (16 bits) | depth (24 bits), front to back
+     * blended - 1 | depth (24 bits, inverted) | shader (15 bits) | vertex array (8 bits) | material (16 bits), back to front
+     *
+     * so the opaque draws change the program, the VAO and the material as rarely as possible.
+     * The ids of the shaders, vertex arrays and materials are assigned in the submission order of every frame.
+     */
+    class RenderQueue final
+    {
+    public:
+        /* Called before every draw, e.g. to set the transform uniforms of the item. The item's shader is already bound. */
+        using ItemCallback = std::function<void(Shader& shader, const RenderItem& item)>;
+
+        struct Stats
+        {
+            uint32_t m_draws;
+            uint32_t m_program_changes;
+            uint32_t m_vertex_array_changes;
+            uint32_t m_material_changes;
+        };
+
+        RenderQueue();
+
+        /* Submits all the mesh parts of the model. */
+        void Submit(const std::shared_ptr<Shader>& shader, StaticModel& model, const glm::mat4& transform, const glm::vec3& camera_position, bool is_blended = false);
+        void Submit(const RenderItem& item);
+
+        /* Builds the keys and sorts the items. Called by Execute() if needed. */
+        void Sort();
+
+        void Execute(const ItemCallback& callback = nullptr);
+
+        /* Has to be called at the end of every frame - the items keep raw pointers to the shaders and the models. */
+        void Clear();
+
+        uint32_t     GetItemsCount() const { return uint32_t(m_items.size()); }
+        const Stats& GetStats()      const { return m_stats; }
+
+    private:
+        struct SortEntry
+        {
+            uint64_t m_key;
+            uint32_t m_item;
+        };
+
+        static uint32_t GetId(std::unordered_map<uint64_t, uint32_t>& ids, uint64_t object, uint32_t max_id);
+
+        std::vector<RenderItem> m_items;
+        std::vector<SortEntry>  m_sorted;
+        std::vector<SortEntry>  m_sort_scratch;
+
+        std::unordered_map<uint64_t, uint32_t> m_shader_ids;
+        std::unordered_map<uint64_t, uint32_t> m_vertex_array_ids;
+        std::unordered_map<uint64_t, uint32_t> m_material_ids;
+
+        Stats m_stats;
+        float m_max_depth;
+        bool  m_is_sorted;
+    };
+}
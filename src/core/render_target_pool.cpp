@@ -0,0 +1,250 @@
+#include "render_target_pool.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "gl_state.h"
+#include "gpu_memory.h"
+#include "trace.h"
+
+namespace RGL
+{
+    namespace
+    {
+        /* Bytes per texel of the formats the render targets use, 4 for the rest. */
+        size_t getTexelSize(GLenum format)
+        {
+            switch (format)
+            {
+                case GL_RGBA32F:              return 16;
+                case GL_RGB32F:               return 12;
+                case GL_RGBA16F:              return 8;
+                case GL_RG32F:                return 8;
+                case GL_DEPTH32F_STENCIL8:    return 8;
+                case GL_RGB16F:               return 6;
+                case GL_RG16F:                return 4;
+                case GL_R32F:                 return 4;
+                case GL_R11F_G11F_B10F:       return 4;
+                case GL_RGBA8:                return 4;
+                case GL_SRGB8_ALPHA8:         return 4;
+                case GL_DEPTH24_STENCIL8:     return 4;
+                case GL_DEPTH_COMPONENT32F:   return 4;
+                case GL_DEPTH_COMPONENT24:    return 4;
+                case GL_R16F:                 return 2;
+                case GL_R16:                  return 2;
+                case GL_RG8:                  return 2;
+                case GL_DEPTH_COMPONENT16:    return 2;
+                case GL_R8:                   return 1;
+                default:                      return 4;
+            }
+        }
+
+        bool hasStencil(GLenum format)
+        {
+            return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+        }
+    }
+
+    std::vector<RenderTargetPool::Entry> RenderTargetPool::s_entries;
+    RenderTargetProfile                  RenderTargetPool::s_profile             = RenderTargetProfile::QUALITY;
+    uint64_t                             RenderTargetPool::s_frame               = 0;
+    uint32_t                             RenderTargetPool::s_created_count       = 0;
+    uint32_t                             RenderTargetPool::s_frame_created_count = 0;
+
+    RenderTarget::RenderTarget(const RenderTargetDesc& desc)
+        : m_desc(desc)
+    {
+        const bool   is_multisampled = desc.m_samples > 1;
+        const GLenum target          = is_multisampled ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+        const size_t texels          = size_t(desc.m_width) * desc.m_height * std::max(desc.m_samples, 1u);
+
+        m_levels_count = is_multisampled ? 1 : desc.m_levels == 0 ? uint32_t(std::floor(std::log2(float(std::max(desc.m_width, desc.m_height))))) + 1
+                                                                  : desc.m_levels;
+
+        glCreateFramebuffers(1, &m_fbo_name);
+
+        if (desc.m_color_format != 0)
+        {
+            glCreateTextures(target, 1, &m_color_texture_name);
+
+            if (is_multisampled)
+            {
+                glTextureStorage2DMultisample(m_color_texture_name, desc.m_samples, desc.m_color_format, desc.m_width, desc.m_height, GL_TRUE);
+                GpuMemory::TrackTexture(m_color_texture_name, "RenderTarget");
+            }
+            else
+            {
+                glTextureStorage2D (m_color_texture_name, m_levels_count, desc.m_color_format, desc.m_width, desc.m_height);
+                glTextureParameteri(m_color_texture_name, GL_TEXTURE_MIN_FILTER, m_levels_count > 1 ? GL_LINEAR_MIPMAP_NEAREST : GL_LINEAR);
+                glTextureParameteri(m_color_texture_name, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTextureParameteri(m_color_texture_name, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+                glTextureParameteri(m_color_texture_name, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+                GpuMemory::TrackTexture(m_color_texture_name, "RenderTarget");
+            }
+
+            glNamedFramebufferTexture(m_fbo_name, GL_COLOR_ATTACHMENT0, m_color_texture_name, 0);
+
+            /* The mip chain adds a third at most. */
+            m_memory_size += texels * getTexelSize(desc.m_color_format) * (m_levels_count > 1 ? 4 : 3) / 3;
+        }
+        else
+        {
+            glNamedFramebufferDrawBuffer(m_fbo_name, GL_NONE);
+            glNamedFramebufferReadBuffer(m_fbo_name, GL_NONE);
+        }
+
+        /* A texture rather than a renderbuffer, the passes can sample the depth then. */
+        if (desc.m_depth_format != 0)
+        {
+            glCreateTextures(target, 1, &m_depth_texture_name);
+
+            if (is_multisampled)
+            {
+                glTextureStorage2DMultisample(m_depth_texture_name, desc.m_samples, desc.m_depth_format, desc.m_width, desc.m_height, GL_TRUE);
+                GpuMemory::TrackTexture(m_depth_texture_name, "RenderTarget");
+            }
+            else
+            {
+                glTextureStorage2D (m_depth_texture_name, 1, desc.m_depth_format, desc.m_width, desc.m_height);
+                glTextureParameteri(m_depth_texture_name, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+                glTextureParameteri(m_depth_texture_name, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+                glTextureParameteri(m_depth_texture_name, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+                glTextureParameteri(m_depth_texture_name, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+                GpuMemory::TrackTexture(m_depth_texture_name, "RenderTarget");
+            }
+
+            glNamedFramebufferTexture(m_fbo_name, hasStencil(desc.m_depth_format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, m_depth_texture_name, 0);
+
+            m_memory_size += texels * getTexelSize(desc.m_depth_format);
+        }
+    }
+
+    RenderTarget::~RenderTarget()
+    {
+        for (GLuint* name : { &m_color_texture_name, &m_depth_texture_name })
+        {
+            if (*name != 0)
+            {
+                GpuMemory::UntrackTexture(*name);
+                glDeleteTextures(1, name);
+                GLState::OnTextureDeleted(*name);
+            }
+        }
+
+        if (m_fbo_name != 0)
+        {
+            glDeleteFramebuffers(1, &m_fbo_name);
+            GLState::OnFramebufferDeleted(m_fbo_name);
+        }
+    }
+
+    void RenderTarget::Bind(GLbitfield clear_mask) const
+    {
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, m_fbo_name);
+        GLState::Viewport       (0, 0, m_desc.m_width, m_desc.m_height);
+
+        if (clear_mask != 0)
+        {
+            glClear(clear_mask);
+        }
+    }
+
+    void RenderTarget::BindColor(GLuint unit) const
+    {
+        GLState::BindTextureUnit(unit, m_color_texture_name);
+    }
+
+    void RenderTarget::BindDepth(GLuint unit) const
+    {
+        GLState::BindTextureUnit(unit, m_depth_texture_name);
+    }
+
+    void RenderTarget::BindColorImage(GLuint image_unit, uint32_t level, GLenum access) const
+    {
+        glBindImageTexture(image_unit, m_color_texture_name, level, GL_FALSE, 0, access, m_desc.m_color_format);
+    }
+
+    std::shared_ptr<RenderTarget> RenderTargetPool::Acquire(const RenderTargetDesc& desc)
+    {
+        /* The pool holds the only reference of the free targets. */
+        for (auto& entry : s_entries)
+        {
+            if (entry.m_target.use_count() == 1 && entry.m_target->GetDesc() == desc)
+            {
+                entry.m_last_frame = s_frame;
+                return entry.m_target;
+            }
+        }
+
+        RGL_TRACE_ZONE("RenderTargetPool::Acquire");
+
+        s_entries.push_back({ std::shared_ptr<RenderTarget>(new RenderTarget(desc)), s_frame });
+        s_created_count++;
+
+        return s_entries.back().m_target;
+    }
+
+    GLenum RenderTargetPool::GetColorFormat(RenderTargetUsage usage)
+    {
+        const bool is_bandwidth_saving = s_profile == RenderTargetProfile::BANDWIDTH_SAVING;
+
+        switch (usage)
+        {
+            case RenderTargetUsage::HDR_COLOR:      return is_bandwidth_saving ? GL_R11F_G11F_B10F : GL_RGBA16F;
+            case RenderTargetUsage::BLOOM:          return is_bandwidth_saving ? GL_R11F_G11F_B10F : GL_RGBA16F;
+            case RenderTargetUsage::MOTION_VECTORS: return GL_RG16F;
+            case RenderTargetUsage::DEPTH_COPY:     return is_bandwidth_saving ? GL_R16 : GL_R32F;
+            case RenderTargetUsage::LDR_COLOR:      return GL_RGBA8;
+            default:                                return GL_RGBA16F;
+        }
+    }
+
+    const char* RenderTargetPool::GetImageFormatQualifier(GLenum format)
+    {
+        switch (format)
+        {
+            case GL_RGBA32F:        return "rgba32f";
+            case GL_RGBA16F:        return "rgba16f";
+            case GL_RG32F:          return "rg32f";
+            case GL_RG16F:          return "rg16f";
+            case GL_R32F:           return "r32f";
+            case GL_R16F:           return "r16f";
+            case GL_R11F_G11F_B10F: return "r11f_g11f_b10f";
+            case GL_RGBA8:          return "rgba8";
+            case GL_RG8:            return "rg8";
+            case GL_R16:            return "r16";
+            case GL_R8:             return "r8";
+            default:                return "rgba16f";
+        }
+    }
+
+    void RenderTargetPool::EndFrame()
+    {
+        /* The targets still held by their users are kept, however long ago they were acquired. */
+        std::erase_if(s_entries, [](const Entry& entry) { return entry.m_target.use_count() == 1 && s_frame - entry.m_last_frame >= MAX_UNUSED_FRAMES; });
+
+        s_frame_created_count = s_created_count;
+        s_created_count       = 0;
+        s_frame++;
+    }
+
+    void RenderTargetPool::Release()
+    {
+        s_entries.clear();
+
+        s_created_count       = 0;
+        s_frame_created_count = 0;
+    }
+
+    size_t RenderTargetPool::GetMemorySize()
+    {
+        size_t size = 0;
+
+        for (const auto& entry : s_entries)
+        {
+            size += entry.m_target->GetMemorySize();
+        }
+
+        return size;
+    }
+}
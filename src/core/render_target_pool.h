@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+
+namespace RGL
+{
+    /* What a render target is made of. A format of 0 leaves the attachment out. */
+    struct RenderTargetDesc
+    {
+        uint32_t m_width        = 0;
+        uint32_t m_height       = 0;
+        GLenum   m_color_format = GL_RGBA16F;
+        GLenum   m_depth_format = GL_DEPTH_COMPONENT32F;
+        uint32_t m_levels       = 1;    /* Of the color texture, 0 - the full chain. Multisampled targets have a single one. */
+        uint32_t m_samples      = 1;
+
+        bool operator==(const RenderTargetDesc& other) const = default;
+    };
+
+    /* What the passes render into their targets, RenderTargetPool::GetColorFormat() picks the format of each. */
+    enum class RenderTargetUsage
+    {
+        HDR_COLOR,      /* The lit scene, before the tone mapping. */
+        BLOOM,          /* The bloom's mip chain. */
+        MOTION_VECTORS,
+        DEPTH_COPY,     /* A copy of the depth sampled by the later passes, not a depth attachment. */
+        LDR_COLOR
+    };
+
+    enum class RenderTargetProfile
+    {
+        QUALITY,         /* Half floats with alpha, 32-bit depth copies. */
+        BANDWIDTH_SAVING /* Packed R11G11B10F colors without alpha, 16-bit depth copies - half the bytes of the HDR passes. */
+    };
+
+    /* A framebuffer with its color and depth textures, handed out by RenderTargetPool. */
+    class RenderTarget final
+    {
+    public:
+        RenderTarget           (const RenderTarget&) = delete;
+        RenderTarget& operator=(const RenderTarget&) = delete;
+
+        ~RenderTarget();
+
+        /* Binds the framebuffer, sets the viewport to the target's size and clears it (nothing if clear_mask is 0). */
+        void Bind(GLbitfield clear_mask = GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT) const;
+
+        void BindColor(GLuint unit) const;
+        void BindDepth(GLuint unit) const;
+
+        /* Binds a level of the color texture to the image unit, with the target's color format. */
+        void BindColorImage(GLuint image_unit, uint32_t level, GLenum access) const;
+
+        GLuint   GetFramebuffer()  const { return m_fbo_name; }
+        GLuint   GetColorTexture() const { return m_color_texture_name; }
+        GLuint   GetDepthTexture() const { return m_depth_texture_name; }
+        uint32_t GetWidth()        const { return m_desc.m_width; }
+        uint32_t GetHeight()       const { return m_desc.m_height; }
+        uint32_t GetLevelsCount()  const { return m_levels_count; }
+        size_t   GetMemorySize()   const { return m_memory_size; }
+
+        const RenderTargetDesc& GetDesc() const { return m_desc; }
+
+    private:
+        friend class RenderTargetPool;
+
+        explicit RenderTarget(const RenderTargetDesc& desc);
+
+        RenderTargetDesc m_desc;
+        GLuint           m_fbo_name           = 0;
+        GLuint           m_color_texture_name = 0;
+        GLuint           m_depth_texture_name = 0;
+        uint32_t         m_levels_count       = 1;
+        size_t           m_memory_size        = 0;
+    };
+
+    /*
+     * Transient render targets shared by the passes and the frames. Acquire() returns a free target of the descriptor,
+     * or creates one - the target is free again as soon as the last shared_ptr to it is gone, so the passes
+     * that don't overlap in the frame alias the same textures when their descriptors match, and the next frame
+     * reuses them. Keep a target only as long as the passes that use it, its content is undefined after that.
+     * GL has no memory heaps to place the textures in, the aliasing is of whole targets.
+     *
+     * A target that hasn't been acquired for MAX_UNUSED_FRAMES frames is deleted, so a resize only creates the targets
+     * of the new size, and the old ones are gone a few frames later.
+     * CoreApp calls EndFrame() after every frame and Release() before the context is destroyed. Render thread only.
+     *
+     *     auto hdr_target = RenderTargetPool::Acquire({ width, height, RenderTargetPool::GetColorFormat(RenderTargetUsage::HDR_COLOR), GL_DEPTH_COMPONENT32F });
+     *     hdr_target->Bind();
+     *
+     * The passes take their color formats from GetColorFormat() rather than hardcode them, so the profile switches all
+     * of them at once. It's set before the demo's init() (CoreApp's --bandwidth-saving option), the shaders that write
+     * the targets as images declare the format qualifier of GetImageFormatQualifier() with Shader::setDefine().
+     */
+    class RenderTargetPool
+    {
+    public:
+        static constexpr uint32_t MAX_UNUSED_FRAMES = 3;
+
+        static std::shared_ptr<RenderTarget> Acquire(const RenderTargetDesc& desc);
+
+        static void                SetProfile(RenderTargetProfile profile) { s_profile = profile; }
+        static RenderTargetProfile GetProfile()                            { return s_profile; }
+
+        /* The color format of the usage in the current profile. */
+        static GLenum GetColorFormat(RenderTargetUsage usage);
+
+        /* GLSL's image format qualifier of the color format, e.g. "r11f_g11f_b10f" - for layout(HDR_IMAGE_FORMAT, binding = 0). */
+        static const char* GetImageFormatQualifier(GLenum format);
+
+        /* Deletes the targets no one acquired for MAX_UNUSED_FRAMES frames. */
+        static void EndFrame();
+
+        /* Deletes the free targets, the acquired ones stay alive with their users. */
+        static void Release();
+
+        /* All the pooled targets, free or not, and their VRAM. */
+        static uint32_t GetCount()        { return uint32_t(s_entries.size()); }
+        static size_t   GetMemorySize();
+
+        /* Targets created in the last finished frame, a steady state creates none. */
+        static uint32_t GetCreatedCount() { return s_frame_created_count; }
+
+    private:
+        struct Entry
+        {
+            std::shared_ptr<RenderTarget> m_target;
+            uint64_t                      m_last_frame;
+        };
+
+        static std::vector<Entry>  s_entries;
+        static RenderTargetProfile s_profile;
+        static uint64_t            s_frame;
+        static uint32_t            s_created_count;
+        static uint32_t            s_frame_created_count;
+    };
+}
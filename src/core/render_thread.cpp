@@ -0,0 +1,106 @@
+#include "render_thread.h"
+
+#include "trace.h"
+#include "window.h"
+
+namespace RGL
+{
+    RenderThread::~RenderThread()
+    {
+        Stop();
+    }
+
+    void RenderThread::Start(FrameFunction frame_function)
+    {
+        if (IsRunning())
+        {
+            return;
+        }
+
+        m_frame_function = std::move(frame_function);
+        m_is_stopping    = false;
+
+        /* A context can be current on a single thread at a time. */
+        Window::makeContextCurrent(false);
+
+        m_thread = std::thread(&RenderThread::Loop, this);
+    }
+
+    void RenderThread::Stop()
+    {
+        if (!IsRunning())
+        {
+            return;
+        }
+
+        WaitIdle();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_is_stopping = true;
+        }
+
+        m_condition.notify_all();
+        m_thread.join();
+
+        Window::makeContextCurrent(true);
+    }
+
+    void RenderThread::Submit(uint32_t slot)
+    {
+        RGL_TRACE_ZONE("Wait for render thread");
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this] { return !m_has_frame && !m_is_busy; });
+
+        m_slot      = slot;
+        m_has_frame = true;
+
+        lock.unlock();
+        m_condition.notify_all();
+    }
+
+    void RenderThread::WaitIdle()
+    {
+        RGL_TRACE_ZONE("Wait for render thread");
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this] { return !m_has_frame && !m_is_busy; });
+    }
+
+    void RenderThread::Loop()
+    {
+        Window::makeContextCurrent(true);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        while (true)
+        {
+            m_condition.wait(lock, [this] { return m_has_frame || m_is_stopping; });
+
+            if (!m_has_frame)
+            {
+                break;
+            }
+
+            const uint32_t slot = m_slot;
+
+            m_has_frame = false;
+            m_is_busy   = true;
+
+            lock.unlock();
+            {
+                RGL_TRACE_ZONE("Render thread frame");
+                m_frame_function(slot);
+            }
+            lock.lock();
+
+            m_is_busy = false;
+            m_condition.notify_all();
+        }
+
+        lock.unlock();
+
+        Window::makeContextCurrent(false);
+    }
+}
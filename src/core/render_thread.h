@@ -0,0 +1,51 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace RGL
+{
+    /*
+     * The thread that owns the window's GL context in CoreApp's render thread mode. Submit() hands it a frame - the
+     * slot of the frame's render packet - and returns right away, the caller simulates the next frame meanwhile.
+     * There's at most one frame in flight, the next Submit() or WaitIdle() waits for it; while the thread is idle the
+     * caller can touch anything the frames use.
+     */
+    class RenderThread final
+    {
+    public:
+        using FrameFunction = std::function<void(uint32_t slot)>;
+
+        RenderThread() = default;
+        ~RenderThread();
+
+        RenderThread           (const RenderThread&) = delete;
+        RenderThread& operator=(const RenderThread&) = delete;
+
+        /* Moves the GL context from the calling thread to the render thread. */
+        void Start(FrameFunction frame_function);
+
+        /* Finishes the submitted frame and moves the GL context back to the calling thread. */
+        void Stop();
+
+        void Submit(uint32_t slot);
+        void WaitIdle();
+
+        bool IsRunning() const { return m_thread.joinable(); }
+
+    private:
+        void Loop();
+
+        FrameFunction           m_frame_function;
+        std::thread             m_thread;
+        std::mutex              m_mutex;
+        std::condition_variable m_condition;
+        uint32_t                m_slot        = 0;
+        bool                    m_has_frame   = false; /* Submitted, not started yet. */
+        bool                    m_is_busy     = false;
+        bool                    m_is_stopping = false;
+    };
+}
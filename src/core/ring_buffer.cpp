@@ -0,0 +1,142 @@
+#include "ring_buffer.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "gpu_memory.h"
+
+namespace RGL
+{
+    RingBuffer::RingBuffer()
+        : m_fences           {},
+          m_data             (nullptr),
+          m_buffer_name      (0),
+          m_region_size      (0),
+          m_region_offset    (0),
+          m_default_alignment(256),
+          m_region           (REGIONS_COUNT - 1)
+    {
+    }
+
+    RingBuffer::~RingBuffer()
+    {
+        Release();
+    }
+
+    bool RingBuffer::Create(GLsizeiptr region_size)
+    {
+        Release();
+
+        GLint ubo_alignment = 0, ssbo_alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT,        &ubo_alignment);
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssbo_alignment);
+
+        m_default_alignment = std::max<GLsizeiptr>({ ubo_alignment, ssbo_alignment, 16 });
+
+        /* Every region starts aligned. */
+        m_region_size = (region_size + m_default_alignment - 1) / m_default_alignment * m_default_alignment;
+
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        glCreateBuffers     (1, &m_buffer_name);
+        glNamedBufferStorage(m_buffer_name, m_region_size * REGIONS_COUNT, nullptr, flags);
+        GpuMemory::TrackBuffer(m_buffer_name, "RingBuffer");
+
+        m_data = static_cast<uint8_t*>(glMapNamedBufferRange(m_buffer_name, 0, m_region_size * REGIONS_COUNT, flags));
+
+        if (!m_data)
+        {
+            fprintf(stderr, "RingBuffer::Create: could not map the buffer.\n");
+            Release();
+
+            return false;
+        }
+
+        return true;
+    }
+
+    void RingBuffer::BeginFrame()
+    {
+        m_region        = (m_region + 1) % REGIONS_COUNT;
+        m_region_offset = 0;
+
+        GLsync& fence = m_fences[m_region];
+
+        if (fence)
+        {
+            /* Usually already signaled - the region was used REGIONS_COUNT frames ago. */
+            if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            {
+                glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(-1));
+            }
+
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+
+    void RingBuffer::EndFrame()
+    {
+        if (m_fences[m_region])
+        {
+            glDeleteSync(m_fences[m_region]);
+        }
+
+        m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    RingBuffer::Allocation RingBuffer::Allocate(GLsizeiptr size, GLsizeiptr alignment)
+    {
+        if (alignment == 0)
+        {
+            alignment = m_default_alignment;
+        }
+
+        GLsizeiptr offset = (m_region_offset + alignment - 1) / alignment * alignment;
+
+        if (!m_data || offset + size > m_region_size)
+        {
+            fprintf(stderr, "RingBuffer::Allocate: the region is full (%lld bytes requested).\n", (long long)size);
+            return { nullptr, 0, 0 };
+        }
+
+        m_region_offset = offset + size;
+
+        GLintptr buffer_offset = m_region_size * m_region + offset;
+
+        return { m_data + buffer_offset, buffer_offset, size };
+    }
+
+    void RingBuffer::BindRange(GLenum target, GLuint index, const Allocation& allocation) const
+    {
+        if (allocation.m_data)
+        {
+            glBindBufferRange(target, index, m_buffer_name, allocation.m_offset, allocation.m_size);
+        }
+    }
+
+    void RingBuffer::Release()
+    {
+        for (auto& fence : m_fences)
+        {
+            if (fence)
+            {
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+
+        if (m_data)
+        {
+            glUnmapNamedBuffer(m_buffer_name);
+            m_data = nullptr;
+        }
+
+        GpuMemory::UntrackBuffer(m_buffer_name);
+        glDeleteBuffers(1, &m_buffer_name);
+
+        m_buffer_name   = 0;
+        m_region_size   = 0;
+        m_region_offset = 0;
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include <glad/glad.h>
+
+namespace RGL
+{
+    /*
+     * Persistently and coherently mapped buffer for the per frame dynamic data (constants, light lists, instance data).
+     * The buffer is split into REGIONS_COUNT regions - the CPU writes one of them while the GPU still reads the previous ones.
+     * BeginFrame() waits for the fence of the region it's going to reuse, so the writes never need an implicit sync.
+     *
+     *     ring.BeginFrame();
+     *     auto lights = ring.Write(lights_data.data(), lights_data.size());
+     *     ring.BindRange(GL_SHADER_STORAGE_BUFFER, 2, lights);
+     *     ... draws ...
+     *     ring.EndFrame();
+     */
+    class RingBuffer final
+    {
+    public:
+        static constexpr uint32_t REGIONS_COUNT = 3;
+
+        struct Allocation
+        {
+            void*      m_data;   /* nullptr if the region is full. */
+            GLintptr   m_offset; /* From the beginning of the buffer. */
+            GLsizeiptr m_size;
+        };
+
+        RingBuffer();
+        ~RingBuffer();
+
+        RingBuffer           (const RingBuffer&) = delete;
+        RingBuffer& operator=(const RingBuffer&) = delete;
+
+        bool Create(GLsizeiptr region_size);
+
+        /* Makes the next region current. Has to be called once per frame, before the first Allocate(). */
+        void BeginFrame();
+
+        /* Fences the current region. Has to be called after the last command that reads the frame's data. */
+        void EndFrame();
+
+        /* The default alignment satisfies both the uniform and the shader storage buffer offset alignments. */
+        Allocation Allocate(GLsizeiptr size, GLsizeiptr alignment = 0);
+
+        template<typename T>
+        Allocation Write(const T* data, size_t count, GLsizeiptr alignment = 0)
+        {
+            Allocation allocation = Allocate(sizeof(T) * count, alignment);
+
+            if (allocation.m_data)
+            {
+                std::memcpy(allocation.m_data, data, sizeof(T) * count);
+            }
+
+            return allocation;
+        }
+
+        void BindRange(GLenum target, GLuint index, const Allocation& allocation) const;
+
+        GLuint     GetBuffer()     const { return m_buffer_name; }
+        GLsizeiptr GetRegionSize() const { return m_region_size; }
+
+    private:
+        void Release();
+
+        GLsync     m_fences[REGIONS_COUNT];
+        uint8_t*   m_data;
+        GLuint     m_buffer_name;
+        GLsizeiptr m_region_size;
+        GLsizeiptr m_region_offset; /* Allocated bytes of the current region. */
+        GLsizeiptr m_default_alignment;
+        uint32_t   m_region;
+    };
+}
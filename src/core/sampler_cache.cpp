@@ -0,0 +1,112 @@
+#include "sampler_cache.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "gl_state.h"
+
+namespace RGL
+{
+    std::unordered_map<SamplerDesc, GLuint, SamplerDesc::Hash> SamplerCache::s_samplers;
+    float                                                      SamplerCache::s_max_anisotropy = 0.0f;
+
+    bool SamplerDesc::operator==(const SamplerDesc& other) const
+    {
+        return m_min_filter     == other.m_min_filter     &&
+               m_mag_filter     == other.m_mag_filter     &&
+               m_wrap_s         == other.m_wrap_s         &&
+               m_wrap_t         == other.m_wrap_t         &&
+               m_wrap_r         == other.m_wrap_r         &&
+               m_compare_mode   == other.m_compare_mode   &&
+               m_compare_func   == other.m_compare_func   &&
+               m_border_color   == other.m_border_color   &&
+               m_max_anisotropy == other.m_max_anisotropy &&
+               m_min_lod        == other.m_min_lod        &&
+               m_max_lod        == other.m_max_lod;
+    }
+
+    size_t SamplerDesc::Hash::operator()(const SamplerDesc& desc) const
+    {
+        /* The GL enums fit 16 bits, the enums and the anisotropy level are packed into two words. */
+        const uint64_t filters = uint64_t(uint16_t(desc.m_min_filter))         | uint64_t(uint16_t(desc.m_mag_filter)) << 16 |
+                                 uint64_t(uint16_t(desc.m_wrap_s))       << 32 | uint64_t(uint16_t(desc.m_wrap_t))     << 48;
+        const uint64_t rest    = uint64_t(uint16_t(desc.m_wrap_r))             | uint64_t(uint16_t(desc.m_compare_mode)) << 16 |
+                                 uint64_t(uint16_t(desc.m_compare_func)) << 32 | uint64_t(desc.m_border_color) << 48 |
+                                 uint64_t(uint8_t(desc.m_max_anisotropy)) << 56;
+
+        size_t seed = std::hash<uint64_t>()(filters);
+        seed ^= std::hash<uint64_t>()(rest)              + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        seed ^= std::hash<float>()   (desc.m_min_lod)    + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        seed ^= std::hash<float>()   (desc.m_max_lod)    + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+
+        return seed;
+    }
+
+    GLuint SamplerCache::Get(const SamplerDesc& desc)
+    {
+        auto it = s_samplers.find(desc);
+
+        if (it != s_samplers.end())
+        {
+            return it->second;
+        }
+
+        GLuint sampler = Create(desc);
+        s_samplers.emplace(desc, sampler);
+
+        return sampler;
+    }
+
+    void SamplerCache::Bind(uint32_t unit, const SamplerDesc& desc)
+    {
+        GLState::BindSampler(unit, Get(desc));
+    }
+
+    void SamplerCache::Unbind(uint32_t unit)
+    {
+        GLState::BindSampler(unit, 0);
+    }
+
+    void SamplerCache::Release()
+    {
+        for (auto& [desc, sampler] : s_samplers)
+        {
+            glDeleteSamplers(1, &sampler);
+            GLState::OnSamplerDeleted(sampler);
+        }
+
+        s_samplers.clear();
+    }
+
+    GLuint SamplerCache::Create(const SamplerDesc& desc)
+    {
+        static constexpr float BORDER_COLORS[][4] = { { 0.0f, 0.0f, 0.0f, 0.0f },
+                                                      { 0.0f, 0.0f, 0.0f, 1.0f },
+                                                      { 1.0f, 1.0f, 1.0f, 1.0f } };
+
+        if (s_max_anisotropy == 0.0f)
+        {
+            glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &s_max_anisotropy);
+        }
+
+        /* The magnification has no mip levels, LINEAR_MIP_LINEAR would be an error. */
+        const TextureFilteringParam mag_filter = desc.m_mag_filter > TextureFilteringParam::LINEAR ? TextureFilteringParam::LINEAR : desc.m_mag_filter;
+
+        GLuint sampler;
+        glCreateSamplers(1, &sampler);
+
+        glSamplerParameteri (sampler, GL_TEXTURE_MIN_FILTER,         GLint(desc.m_min_filter));
+        glSamplerParameteri (sampler, GL_TEXTURE_MAG_FILTER,         GLint(mag_filter));
+        glSamplerParameteri (sampler, GL_TEXTURE_WRAP_S,             GLint(desc.m_wrap_s));
+        glSamplerParameteri (sampler, GL_TEXTURE_WRAP_T,             GLint(desc.m_wrap_t));
+        glSamplerParameteri (sampler, GL_TEXTURE_WRAP_R,             GLint(desc.m_wrap_r));
+        glSamplerParameteri (sampler, GL_TEXTURE_COMPARE_MODE,       GLint(desc.m_compare_mode));
+        glSamplerParameteri (sampler, GL_TEXTURE_COMPARE_FUNC,       GLint(desc.m_compare_func));
+        glSamplerParameterfv(sampler, GL_TEXTURE_BORDER_COLOR,       BORDER_COLORS[int(desc.m_border_color)]);
+        glSamplerParameterf (sampler, GL_TEXTURE_MAX_ANISOTROPY,     std::clamp(desc.m_max_anisotropy, 1.0f, std::max(s_max_anisotropy, 1.0f)));
+        glSamplerParameterf (sampler, GL_TEXTURE_MIN_LOD,            desc.m_min_lod);
+        glSamplerParameterf (sampler, GL_TEXTURE_MAX_LOD,            desc.m_max_lod);
+
+        return sampler;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+#include "texture.h"
+
+namespace RGL
+{
+    /* Border colors of the sampler descriptors, the depth compare samplers only use the red channel. */
+    enum class SamplerBorderColor : uint8_t { TRANSPARENT_BLACK, OPAQUE_BLACK, OPAQUE_WHITE };
+
+    /* Whole state of a sampler object. The defaults match TextureSampler::Create(). */
+    struct SamplerDesc
+    {
+        TextureFilteringParam m_min_filter     = TextureFilteringParam::LINEAR_MIP_LINEAR;
+        TextureFilteringParam m_mag_filter     = TextureFilteringParam::LINEAR;
+        TextureWrapingParam   m_wrap_s         = TextureWrapingParam::CLAMP_TO_EDGE;
+        TextureWrapingParam   m_wrap_t         = TextureWrapingParam::CLAMP_TO_EDGE;
+        TextureWrapingParam   m_wrap_r         = TextureWrapingParam::CLAMP_TO_EDGE;
+        TextureCompareMode    m_compare_mode   = TextureCompareMode::NONE;
+        TextureCompareFunc    m_compare_func   = TextureCompareFunc::LEQUAL;
+        SamplerBorderColor    m_border_color   = SamplerBorderColor::TRANSPARENT_BLACK;
+        float                 m_max_anisotropy = 1.0f;
+        float                 m_min_lod        = -1000.0f;
+        float                 m_max_lod        = 1000.0f;
+
+        bool operator==(const SamplerDesc& other) const;
+
+        struct Hash
+        {
+            size_t operator()(const SamplerDesc& desc) const;
+        };
+    };
+
+    /*
+     * Shared sampler objects, one per distinct SamplerDesc - the textures that are sampled the same way share it
+     * instead of each one carrying its own copy of the state. A pass binds the samplers of its units once, the sampler
+     * overrides the texture's own parameters. The bindless texture + sampler handles
+     * (glGetTextureSamplerHandleARB(texture, SamplerCache::Get(desc))) need one sampler per state this way, not one per texture.
+     *
+     *     SamplerDesc pcf;
+     *     pcf.m_min_filter   = TextureFilteringParam::LINEAR;
+     *     pcf.m_compare_mode = TextureCompareMode::REF;
+     *
+     *     SamplerCache::Bind(10, pcf);
+     *
+     * The anisotropy is clamped to the GPU's maximum. Needs the GL context, CoreApp calls Release() before it's destroyed.
+     */
+    class SamplerCache
+    {
+    public:
+        /* The sampler is owned by the cache, it must not be deleted. */
+        static GLuint Get (const SamplerDesc& desc);
+        static void   Bind(uint32_t unit, const SamplerDesc& desc);
+
+        /* Unbinds the sampler, the unit samples with the texture's own parameters again. */
+        static void Unbind(uint32_t unit);
+
+        static uint32_t GetCount() { return uint32_t(s_samplers.size()); }
+
+        static void Release();
+
+    private:
+        static GLuint Create(const SamplerDesc& desc);
+
+        static std::unordered_map<SamplerDesc, GLuint, SamplerDesc::Hash> s_samplers;
+        static float                                                      s_max_anisotropy;
+    };
+}
@@ -0,0 +1,201 @@
+#include "screen_space_reflections.h"
+
+#include <cstdio>
+
+#include "camera.h"
+#include "core_shared.h"
+#include "gl_state.h"
+#include "profiler.h"
+#include "render_target_pool.h"
+#include "shader.h"
+
+#include "gui/gui.h"
+
+namespace RGL
+{
+    namespace
+    {
+        /* The depth texel of a half resolution pixel that's traced in each frame, every one of the 2x2 in 4 frames. */
+        const glm::uvec2 TRACE_OFFSETS[4] = { { 0, 0 }, { 1, 1 }, { 1, 0 }, { 0, 1 } };
+    }
+
+    ScreenSpaceReflections::~ScreenSpaceReflections()
+    {
+        if (m_vao_name)
+        {
+            glDeleteVertexArrays(1, &m_vao_name);
+            GLState::OnVertexArrayDeleted(m_vao_name);
+        }
+    }
+
+    bool ScreenSpaceReflections::Create()
+    {
+        m_trace_shader     = std::make_shared<Shader>("src/core/shaders/ssr_trace.comp");
+        m_resolve_shader   = std::make_shared<Shader>("src/core/shaders/ssr_resolve.comp");
+        m_composite_shader = std::make_shared<Shader>("src/core/shaders/ssr_composite.vert", "src/core/shaders/ssr_composite.frag");
+
+        m_trace_shader->linkAsync();
+        m_resolve_shader->linkAsync();
+        m_composite_shader->linkAsync();
+
+        if (!m_trace_shader->link() || !m_resolve_shader->link() || !m_composite_shader->link())
+        {
+            fprintf(stderr, "ScreenSpaceReflections: the shaders failed to link.\n");
+            return false;
+        }
+
+        glCreateVertexArrays(1, &m_vao_name);
+
+        return m_depth_pyramid.Create();
+    }
+
+    void ScreenSpaceReflections::SetEnvironmentMap(GLuint cubemap, uint32_t levels_count)
+    {
+        m_environment_map_name     = cubemap;
+        m_environment_levels_count = levels_count > 0 ? levels_count : 1;
+    }
+
+    void ScreenSpaceReflections::Render(const Camera& camera, GLuint color_texture, GLuint depth_texture, GLuint normals_texture)
+    {
+        ProfilerScope scope("Screen space reflections");
+
+        if (!m_depth_pyramid.Build(depth_texture))
+        {
+            return;
+        }
+
+        GLint width, height;
+        glGetTextureLevelParameteriv(depth_texture, 0, GL_TEXTURE_WIDTH,  &width);
+        glGetTextureLevelParameteriv(depth_texture, 0, GL_TEXTURE_HEIGHT, &height);
+
+        /* Rounded up, the last column or row traces the scene's last one. */
+        const uint32_t half_width  = (uint32_t(width)  + 1) / 2;
+        const uint32_t half_height = (uint32_t(height) + 1) / 2;
+
+        if (half_width != m_width || half_height != m_height)
+        {
+            m_width  = half_width;
+            m_height = half_height;
+
+            /* The coverage needs the alpha, the HDR color's format may have none. */
+            m_trace = RenderTargetPool::Acquire({ m_width, m_height, GL_RGBA16F, 0 });
+
+            for (auto& history : m_history)
+            {
+                history = RenderTargetPool::Acquire({ m_width, m_height, GL_RGBA16F, 0 });
+            }
+
+            m_is_history_valid = false;
+        }
+
+        const glm::mat4 view_projection = camera.m_projection * camera.m_view;
+        const glm::uvec2 trace_offset   = TRACE_OFFSETS[m_frame_index++ % 4];
+        const bool has_environment      = m_environment_map_name != 0;
+
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        m_trace_shader->bind();
+        m_trace_shader->setUniform("u_view",               camera.m_view);
+        m_trace_shader->setUniform("u_projection",         camera.m_projection);
+        m_trace_shader->setUniform("u_inverse_projection", glm::inverse(camera.m_projection));
+        m_trace_shader->setUniform("u_trace_offset",       trace_offset);
+        m_trace_shader->setUniform("u_max_steps",          m_settings.m_max_steps);
+        m_trace_shader->setUniform("u_max_distance",       m_settings.m_max_distance);
+        m_trace_shader->setUniform("u_thickness",          m_settings.m_thickness);
+        m_trace_shader->setUniform("u_edge_fade",          m_settings.m_edge_fade);
+        m_trace_shader->setUniform("u_has_environment",    has_environment);
+        m_trace_shader->setUniform("u_environment_lod",    m_settings.m_roughness * float(m_environment_levels_count - 1));
+
+        glBindTextureUnit(0, color_texture);
+        glBindTextureUnit(1, depth_texture);
+        glBindTextureUnit(2, normals_texture);
+        m_depth_pyramid.Bind(3);
+
+        if (has_environment)
+        {
+            glBindTextureUnit(4, m_environment_map_name);
+        }
+
+        m_trace->BindColorImage(0, 0, GL_WRITE_ONLY);
+
+        glDispatchCompute((m_width  + SSR_GROUP_SIZE - 1) / SSR_GROUP_SIZE,
+                          (m_height + SSR_GROUP_SIZE - 1) / SSR_GROUP_SIZE, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        const RenderTarget& history = *m_history[m_history_index];
+        const RenderTarget& output  = *m_history[m_history_index ^ 1];
+
+        /* The reflections move with the reflecting surface - it's reprojected from the current clip space to the previous one. */
+        m_resolve_shader->bind();
+        m_resolve_shader->setUniform("u_reprojection", camera.previousViewProjection() * glm::inverse(view_projection));
+        m_resolve_shader->setUniform("u_trace_offset", trace_offset);
+        m_resolve_shader->setUniform("u_blend",        m_is_history_valid ? m_settings.m_blend : 1.0f);
+
+        m_trace->BindColor(0);
+        history.BindColor(1);
+        glBindTextureUnit(2, depth_texture);
+        output.BindColorImage(0, 0, GL_WRITE_ONLY);
+
+        glDispatchCompute((m_width  + SSR_GROUP_SIZE - 1) / SSR_GROUP_SIZE,
+                          (m_height + SSR_GROUP_SIZE - 1) / SSR_GROUP_SIZE, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        m_history_index   ^= 1;
+        m_is_history_valid = true;
+    }
+
+    void ScreenSpaceReflections::Composite(GLuint color_texture, GLuint normals_texture) const
+    {
+        if (!m_history[m_history_index])
+        {
+            return;
+        }
+
+        GLboolean blend      = glIsEnabled(GL_BLEND);
+        GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+        GLboolean cull_face  = glIsEnabled(GL_CULL_FACE);
+
+        glDisable(GL_BLEND);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_CULL_FACE);
+
+        m_composite_shader->bind();
+        glBindTextureUnit(0, color_texture);
+        glBindTextureUnit(1, normals_texture);
+        m_history[m_history_index]->BindColor(2);
+
+        GLState::BindVertexArray(m_vao_name);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        blend      ? glEnable(GL_BLEND)      : glDisable(GL_BLEND);
+        depth_test ? glEnable(GL_DEPTH_TEST) : glDisable(GL_DEPTH_TEST);
+        cull_face  ? glEnable(GL_CULL_FACE)  : glDisable(GL_CULL_FACE);
+
+        /* The capabilities went past the cache. */
+        GLState::Invalidate();
+    }
+
+    GLuint ScreenSpaceReflections::GetTexture() const
+    {
+        return m_history[m_history_index] ? m_history[m_history_index]->GetColorTexture() : 0;
+    }
+
+    void ScreenSpaceReflections::RenderGui()
+    {
+        int max_steps = int(m_settings.m_max_steps);
+        if (ImGui::SliderInt("Max steps", &max_steps, 8, 128))
+        {
+            m_settings.m_max_steps = uint32_t(max_steps);
+        }
+
+        ImGui::SliderFloat("Max distance",  &m_settings.m_max_distance, 1.0f,  100.0f, "%.1f");
+        ImGui::SliderFloat("Thickness",     &m_settings.m_thickness,    0.01f, 2.0f,   "%.2f");
+        ImGui::SliderFloat("Edge fade",     &m_settings.m_edge_fade,    0.0f,  0.5f,   "%.2f");
+        ImGui::SliderFloat("History blend", &m_settings.m_blend,        0.02f, 1.0f,   "%.2f");
+
+        if (m_environment_map_name)
+        {
+            ImGui::SliderFloat("Fallback roughness", &m_settings.m_roughness, 0.0f, 1.0f, "%.2f");
+        }
+    }
+}
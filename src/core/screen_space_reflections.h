@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "depth_pyramid.h"
+
+namespace RGL
+{
+    class Camera;
+    class RenderTarget;
+    class Shader;
+
+    /*
+     * Screen space reflections traced through the min depth pyramid, at half resolution. Every half resolution pixel
+     * traces one of its 2x2 depth texels - a different one each frame - from the reflective surfaces of the normals
+     * texture (xyz - the world space normal, w - the reflectivity, 0 - no reflections), and takes the scene color
+     * where the ray hits the depth. A ray in front of a pyramid texel's nearest depth skips the whole texel and goes
+     * a level up, behind it it goes a level down, so an empty stretch of the screen costs a few steps instead of
+     * a step per pixel (shaders/ssr_trace.comp).
+     *
+     * The rays that leave the screen, go behind the geometry or run out of steps fall back to the environment cubemap
+     * of SetEnvironmentMap(), e.g. ImageBasedLighting's prefiltered map. Without one the result's alpha is the hit's
+     * confidence and whatever the surface was shaded with shows through. The result is accumulated over the frames,
+     * reprojected by the surface's motion and clamped to the neighbourhood of the current trace
+     * (shaders/ssr_resolve.comp). Composite() draws the scene with the result blended over its reflective pixels.
+     *
+     *     ssr.Create();
+     *     ssr.SetEnvironmentMap(ibl.GetPrefilteredMap(), ibl.GetPrefilteredLevelsCount());
+     *     ... the scene to color, depth and normals ...
+     *     ssr.Render(*camera, color_texture, depth_texture, normals_texture);
+     *     ssr.Composite(color_texture, normals_texture);    // To the bound framebuffer, e.g. the window's.
+     */
+    class ScreenSpaceReflections final
+    {
+    public:
+        struct Settings
+        {
+            uint32_t m_max_steps    = 48;     /* Of the trace, the levels up and down included. */
+            float    m_max_distance = 20.0f;  /* Of a ray, in the world units. */
+            float    m_thickness    = 0.2f;   /* Of the depth buffer's surfaces, a ray further behind one passes it. */
+            float    m_edge_fade    = 0.1f;   /* The screen border the hits fade out in, in its fractions. */
+            float    m_blend        = 0.15f;  /* The weight of the current trace in the history. */
+            float    m_roughness    = 0.0f;   /* Of the environment's fallback, picks its prefiltered level. */
+        };
+
+        ScreenSpaceReflections() = default;
+        ~ScreenSpaceReflections();
+
+        ScreenSpaceReflections           (const ScreenSpaceReflections&) = delete;
+        ScreenSpaceReflections& operator=(const ScreenSpaceReflections&) = delete;
+
+        bool Create();
+
+        /* The fallback of the missed rays, 0 - none. levels_count maps the roughness to the cubemap's LODs. */
+        void SetEnvironmentMap(GLuint cubemap, uint32_t levels_count = 1);
+
+        /*
+         * Builds the depth pyramid, traces and resolves the reflections. The camera's matrices are the ones the scene
+         * was rendered with, its previous view projection reprojects the history. The textures are of the same size.
+         */
+        void Render(const Camera& camera, GLuint color_texture, GLuint depth_texture, GLuint normals_texture);
+
+        /*
+         * A fullscreen triangle of the scene color to the bound framebuffer, of the same size, with the upsampled
+         * reflections mixed in by their alpha and the normals' reflectivity.
+         */
+        void Composite(GLuint color_texture, GLuint normals_texture) const;
+
+        /* Drops the history, for the camera cuts and the scene changes. */
+        void Reset() { m_is_history_valid = false; }
+
+        void RenderGui();
+
+        /* The resolved reflections of the last Render(), half the scene's size, rgb - the color, a - the coverage. */
+        GLuint GetTexture() const;
+
+        Settings m_settings;
+
+    private:
+        std::shared_ptr<Shader> m_trace_shader;
+        std::shared_ptr<Shader> m_resolve_shader;
+        std::shared_ptr<Shader> m_composite_shader;
+
+        DepthPyramid m_depth_pyramid;
+
+        /* The current trace and the ping-ponged history, the one of m_history_index is the latest. */
+        std::shared_ptr<RenderTarget> m_trace;
+        std::shared_ptr<RenderTarget> m_history[2];
+
+        /* Empty, the composite's triangle has no vertex buffer. */
+        GLuint   m_vao_name                 = 0;
+        GLuint   m_environment_map_name     = 0;
+        uint32_t m_environment_levels_count = 1;
+        uint32_t m_width                    = 0;
+        uint32_t m_height                   = 0;
+        uint32_t m_frame_index              = 0;
+        uint32_t m_history_index            = 0;
+        bool     m_is_history_valid         = false;
+    };
+}
@@ -1,15 +1,27 @@
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <memory>
 
 #include "filesystem.h"
+#include "gl_state.h"
 #include "shader.h"
+#include "shader_watcher.h"
 #include "util.h"
 
 namespace RGL
 {
+    std::string Shader::s_fragment_instrumentation;
+    bool        Shader::s_is_spirv_enabled = false;
+
     Shader::Shader()
-        : m_program_id(0),
-          m_is_linked(false)
+        : m_feedback_buffer_mode(GL_INTERLEAVED_ATTRIBS),
+          m_program_id(0),
+          m_is_linked(false),
+          m_is_link_pending(false),
+          m_is_instrumented(true),
+          m_is_spirv(false)
     {
         m_program_id = glCreateProgram();
 
@@ -17,6 +29,8 @@ namespace RGL
         {
             fprintf(stderr, "Error while creating program object.\n");
         }
+
+        ShaderWatcher::Register(this);
     }
 
     Shader::Shader(const std::filesystem::path& compute_shader_filepath)
@@ -66,14 +80,17 @@ namespace RGL
 
     Shader::~Shader()
     {
+        ShaderWatcher::Unregister(this);
+
         if (m_program_id != 0)
         {
             glDeleteProgram(m_program_id);
+            GLState::OnProgramDeleted(m_program_id);
             m_program_id = 0;
         }
     }
 
-    void Shader::addShader(const std::filesystem::path & filepath, GLuint type) const
+    void Shader::addShader(const std::filesystem::path & filepath, GLuint type)
     {
         if (m_program_id == 0)
         {
@@ -87,367 +104,781 @@ namespace RGL
             return;
         }
 
-        GLuint shaderObject = glCreateShader(type);
-
-        if (shaderObject == 0)
-        {
-            fprintf(stderr, "Error while creating %s.\n", filepath.c_str());
-
-            return;
-        }
-
-
         std::string           code = Util::LoadFile(filepath);
         std::filesystem::path dir  = FileSystem::getRootPath() / filepath.parent_path();
 
-        code = Util::LoadShaderIncludes(code, dir);
+        auto full_filepath = (FileSystem::getRootPath() / filepath).lexically_normal();
 
-        const char * shader_code = code.c_str();
+        if (std::find(m_dependencies.begin(), m_dependencies.end(), full_filepath) == m_dependencies.end())
+        {
+            m_dependencies.push_back(full_filepath);
+        }
 
-        glShaderSource(shaderObject, 1, &shader_code, nullptr);
-        glCompileShader(shaderObject);
+        /* Compilation is deferred to link(), so the program binary cache can skip it entirely. */
+        m_sources.push_back({ type, filepath, Util::LoadShaderIncludes(code, dir, &m_dependencies) });
+    }
 
-        GLint result;
-        glGetShaderiv(shaderObject, GL_COMPILE_STATUS, &result);
+    void Shader::compileShaders(GLuint program_id, const std::vector<ShaderSource>& sources, bool use_spirv)
+    {
+        /* Detach the shaders from the previous link() call. */
+        GLint attached_count = 0;
+        glGetProgramiv(program_id, GL_ATTACHED_SHADERS, &attached_count);
 
-        if (result == GL_FALSE)
+        if (attached_count > 0)
         {
-            fprintf(stderr, "\n%s compilation failed!\n", filepath.string().c_str());
+            std::vector<GLuint> attached_shaders(attached_count);
+            glGetAttachedShaders(program_id, attached_count, nullptr, attached_shaders.data());
+
+            for (auto shader_object : attached_shaders)
+            {
+                glDetachShader(program_id, shader_object);
+            }
+        }
 
-            GLint logLen;
-            glGetShaderiv(shaderObject, GL_INFO_LOG_LENGTH, &logLen);
+        /* Issue all the compilations up front, the status is checked after linking. */
+        for (auto& source : sources)
+        {
+            GLuint shaderObject = glCreateShader(source.m_type);
 
-            if (logLen > 0)
+            if (shaderObject == 0)
             {
-                char * log = static_cast<char *>(malloc(logLen));
+                fprintf(stderr, "Error while creating %s.\n", source.m_filepath.string().c_str());
+                continue;
+            }
+
+            const std::string code = getCompiledCode(source);
 
-                GLsizei written;
-                glGetShaderInfoLog(shaderObject, logLen, &written, log);
+            if (!use_spirv || !loadSpirv(shaderObject, source.m_type, code))
+            {
+                const char* shader_code = code.c_str();
 
-                fprintf(stderr, "Shader log: \n%s", log);
-                free(log);
+                glShaderSource(shaderObject, 1, &shader_code, nullptr);
+                glCompileShader(shaderObject);
             }
-            getchar();
-            return;
+
+            glAttachShader(program_id, shaderObject);
+
+            m_pending_shader_objects.push_back({ shaderObject, source.m_filepath });
         }
+    }
 
-        glAttachShader(m_program_id, shaderObject);
-        glDeleteShader(shaderObject);
+    void Shader::setDefine(std::string_view name, std::string_view value)
+    {
+        m_defines.append("#define ").append(name).append(" ").append(value).append("\n");
     }
 
-    bool Shader::link()
+    bool Shader::loadSpirv(GLuint shader_object, GLenum type, const std::string& code)
     {
-        glLinkProgram(m_program_id);
+        const auto spirv_filepath = getSpirvFilepath(type, code);
 
-        GLint status;
-        glGetProgramiv(m_program_id, GL_LINK_STATUS, &status);
+        std::ifstream file(spirv_filepath, std::ios::binary | std::ios::ate);
 
-        if (status == GL_FALSE)
+        if (!file)
         {
-            fprintf(stderr, "Failed to link shader program!\n");
-
-            GLint logLen;
-            glGetProgramiv(m_program_id, GL_INFO_LOG_LENGTH, &logLen);
+            return false;
+        }
 
-            if (logLen > 0)
-            {
-                char* log = (char*)malloc(logLen);
-                GLsizei written;
-                glGetProgramInfoLog(m_program_id, logLen, &written, log);
+        std::vector<char> binary(size_t(file.tellg()));
+        file.seekg(0);
 
-                fprintf(stderr, "Program log: \n%s", log);
-                free(log);
-            }
-        }
-        else
+        if (binary.empty() || !file.read(binary.data(), std::streamsize(binary.size())))
         {
-            m_is_linked = true;
-
-            addAllSubroutines();
+            return false;
         }
 
-        return m_is_linked;
-    }
+        glShaderBinary(1, &shader_object, GL_SHADER_BINARY_FORMAT_SPIR_V, binary.data(), GLsizei(binary.size()));
+        glSpecializeShader(shader_object, "main", 0, nullptr, nullptr);
 
-    void Shader::setTransformFeedbackVaryings(const std::vector<const char*>& output_names, GLenum buffer_mode) const
-    {
-        glTransformFeedbackVaryings(m_program_id, output_names.size(), output_names.data(), buffer_mode);
-    }
+        /* The specialization is done by now, a module the driver rejects is compiled from the GLSL instead. */
+        GLint status = GL_FALSE;
+        glGetShaderiv(shader_object, GL_COMPILE_STATUS, &status);
 
-    void Shader::bind() const
-    {
-        if (m_program_id != 0 && m_is_linked)
+        if (status == GL_FALSE)
         {
-            glUseProgram(m_program_id);
+            fprintf(stderr, "Shader: %s was rejected by the driver, compiling the GLSL source.\n", spirv_filepath.string().c_str());
+            return false;
         }
+
+        m_is_spirv = true;
+
+        return true;
     }
 
-    bool Shader::getUniformLocation(const std::string & uniform_name)
+    std::filesystem::path Shader::getSpirvFilepath(GLenum type, std::string_view code)
     {
-        GLint uniform_location = glGetUniformLocation(m_program_id, uniform_name.c_str());
+        /* FNV-1a of the stage and the code, the same code has the same module whichever file it comes from. */
+        uint64_t hash = 14695981039346656037ull;
 
-        if (uniform_location != -1)
+        auto hash_bytes = [&hash](const void* data, size_t size)
         {
-            m_uniforms_locations[uniform_name] = uniform_location;
-            return true;
-        }
+            auto bytes = static_cast<const uint8_t*>(data);
 
-        return false;
+            for (size_t i = 0; i < size; ++i)
+            {
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            }
+        };
+
+        hash_bytes(&type, sizeof(type));
+        hash_bytes(code.data(), code.size());
+
+        char filename[32];
+        snprintf(filename, sizeof(filename), "%016llx.spv", (unsigned long long)hash);
+
+        return FileSystem::getRootPath() / "shader_cache" / "spirv" / filename;
     }
 
-    void Shader::setUniform(const std::string & uniformName, float value)
+    std::string Shader::getCompiledCode(const ShaderSource& source) const
     {
-        if (m_uniforms_locations.count(uniformName))
+        const bool is_instrumented = source.m_type == GL_FRAGMENT_SHADER && m_is_instrumented && !s_fragment_instrumentation.empty();
+
+        if (!is_instrumented && m_defines.empty())
         {
-            glProgramUniform1f(m_program_id, m_uniforms_locations[uniformName], value);
+            return source.m_code;
         }
-        else
+
+        /* The defines have to follow #version, the #line keeps the numbers of the errors. */
+        const size_t version = source.m_code.find("#version");
+        size_t       body    = 0;
+
+        if (version != std::string::npos)
         {
-            if (getUniformLocation(uniformName))
-            {
-                glProgramUniform1f(m_program_id, m_uniforms_locations[uniformName], value);
-            }
+            const size_t line_end = source.m_code.find('\n', version);
+            body = line_end == std::string::npos ? source.m_code.size() : line_end + 1;
         }
-    }
 
-    void Shader::setUniform(const std::string & uniformName, int value)
-    {
-        if (m_uniforms_locations.count(uniformName))
+        const auto body_line = std::count(source.m_code.begin(), source.m_code.begin() + body, '\n') + 1;
+
+        std::string code;
+        code.reserve(source.m_code.size() + m_defines.size() + s_fragment_instrumentation.size() + 128);
+
+        code.append(source.m_code, 0, body);
+        code.append(m_defines);
+
+        if (is_instrumented)
         {
-            glProgramUniform1i(m_program_id, m_uniforms_locations[uniformName], value);
+            code.append("#define main rgl_instrumented_main\n");
         }
-        else
+
+        code.append("#line ").append(std::to_string(body_line)).append("\n");
+        code.append(source.m_code, body, std::string::npos);
+
+        if (is_instrumented)
         {
-            if (getUniformLocation(uniformName))
-            {
-                glProgramUniform1i(m_program_id, m_uniforms_locations[uniformName], value);
-            }
+            code.append("\n#undef main\n");
+            code.append(s_fragment_instrumentation);
         }
+
+        return code;
     }
 
-    void Shader::setUniform(const std::string & uniformName, GLuint value)
+    bool Shader::checkCompileStatus(bool wait_on_error)
     {
-        if (m_uniforms_locations.count(uniformName))
-        {
-            glProgramUniform1ui(m_program_id, m_uniforms_locations.at(uniformName), value);
-        }
-        else
+        bool is_compiled = true;
+
+        for (auto& [shaderObject, filepath] : m_pending_shader_objects)
         {
-            if (getUniformLocation(uniformName))
+            GLint result;
+            glGetShaderiv(shaderObject, GL_COMPILE_STATUS, &result);
+
+            if (result == GL_FALSE)
             {
-                glProgramUniform1ui(m_program_id, m_uniforms_locations[uniformName], value);
+                fprintf(stderr, "\n%s compilation failed!\n", filepath.string().c_str());
+
+                GLint logLen;
+                glGetShaderiv(shaderObject, GL_INFO_LOG_LENGTH, &logLen);
+
+                if (logLen > 0)
+                {
+                    char * log = static_cast<char *>(malloc(logLen));
+
+                    GLsizei written;
+                    glGetShaderInfoLog(shaderObject, logLen, &written, log);
+
+                    fprintf(stderr, "Shader log: \n%s", log);
+                    free(log);
+                }
+                if (wait_on_error)
+                {
+                    getchar();
+                }
+                is_compiled = false;
             }
+
+            /* Attached shaders are deleted along with the program. */
+            glDeleteShader(shaderObject);
         }
+
+        m_pending_shader_objects.clear();
+
+        return is_compiled;
     }
 
-    void Shader::setUniform(const std::string & uniformName, GLsizei count, float * value)
+    bool Shader::link()
     {
-        if (m_uniforms_locations.count(uniformName))
+        if (!m_is_link_pending)
         {
-            glProgramUniform1fv(m_program_id, m_uniforms_locations[uniformName], count, value);
+            linkAsync();
         }
-        else
+
+        if (m_is_link_pending)
         {
-            if (getUniformLocation(uniformName))
-            {
-                glProgramUniform1fv(m_program_id, m_uniforms_locations[uniformName], count, value);
-            }
+            finishLink();
         }
+
+        return m_is_linked;
     }
 
-    void Shader::setUniform(const std::string & uniformName, GLsizei count, int * value)
+    void Shader::linkAsync()
     {
-        if (m_uniforms_locations.count(uniformName))
-        {
-            glProgramUniform1iv(m_program_id, m_uniforms_locations[uniformName], count, value);
-        }
-        else
+        static const bool is_parallel_compile_supported = []
         {
-            if (getUniformLocation(uniformName))
+            if (GLAD_GL_KHR_parallel_shader_compile)
             {
-                glProgramUniform1iv(m_program_id, m_uniforms_locations[uniformName], count, value);
+                /* Let the driver pick the number of the compiler threads. */
+                glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
             }
-        }
-    }
 
-    void Shader::setUniform(const std::string & uniformName, GLsizei count, glm::vec3 * vectors)
-    {
-        if (m_uniforms_locations.count(uniformName))
+            return bool(GLAD_GL_KHR_parallel_shader_compile);
+        }();
+
+        m_is_linked       = false;
+        m_is_link_pending = false;
+        m_cache_filepath  = getProgramBinaryCachePath();
+
+        if (loadProgramBinary(m_cache_filepath))
         {
-            glProgramUniform3fv(m_program_id, m_uniforms_locations[uniformName], count, glm::value_ptr(vectors[0]));
+            onLinked();
+            return;
         }
-        else
+
+        m_is_spirv = false;
+        compileShaders(m_program_id, m_sources, s_is_spirv_enabled);
+
+        glProgramParameteri(m_program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(m_program_id);
+
+        m_is_link_pending = true;
+
+        /* Without the extension the driver would block on the first status query anyway. */
+        if (!is_parallel_compile_supported)
         {
-            if (getUniformLocation(uniformName))
-            {
-                glProgramUniform3fv(m_program_id, m_uniforms_locations[uniformName], count, glm::value_ptr(vectors[0]));
-            }
+            finishLink();
         }
     }
 
-    void Shader::setUniform(const std::string & uniformName, const glm::vec2 & vector)
+    bool Shader::isReady()
     {
-        if (m_uniforms_locations.count(uniformName))
+        if (m_is_link_pending)
         {
-            glProgramUniform2fv(m_program_id, m_uniforms_locations[uniformName], 1, glm::value_ptr(vector));
-        }
-        else
-        {
-            if (getUniformLocation(uniformName))
+            if (GLAD_GL_KHR_parallel_shader_compile)
             {
-                glProgramUniform2fv(m_program_id, m_uniforms_locations[uniformName], 1, glm::value_ptr(vector));
+                GLint is_completed = GL_FALSE;
+                glGetProgramiv(m_program_id, GL_COMPLETION_STATUS_KHR, &is_completed);
+
+                if (is_completed == GL_FALSE)
+                {
+                    return false;
+                }
             }
+
+            finishLink();
         }
+
+        return m_is_linked;
     }
 
-    void Shader::setUniform(const std::string & uniformName, const glm::vec3 & vector)
+    bool Shader::finishLink()
     {
-        if (m_uniforms_locations.count(uniformName))
+        m_is_link_pending = false;
+
+        bool is_compiled = checkCompileStatus(!m_is_spirv /* wait_on_error */);
+
+        GLint status;
+        glGetProgramiv(m_program_id, GL_LINK_STATUS, &status);
+
+        /* The SPIR-V modules of the stages may not match each other's interfaces the way the GLSL does, the sources are the fallback. */
+        if ((!is_compiled || status == GL_FALSE) && m_is_spirv)
         {
-            glProgramUniform3fv(m_program_id, m_uniforms_locations[uniformName], 1, glm::value_ptr(vector));
+            fprintf(stderr, "The SPIR-V program of %s failed to link, compiling the GLSL sources.\n", m_sources[0].m_filepath.string().c_str());
+            printProgramLog(m_program_id);
+
+            m_is_spirv = false;
+            compileShaders(m_program_id, m_sources, false);
+            glLinkProgram(m_program_id);
+
+            return finishLink();
         }
-        else
+
+        if (!is_compiled || status == GL_FALSE)
         {
-            if (getUniformLocation(uniformName))
-            {
-                glProgramUniform3fv(m_program_id, m_uniforms_locations[uniformName], 1, glm::value_ptr(vector));
-            }
+            fprintf(stderr, "Failed to link shader program!\n");
+            printProgramLog(m_program_id);
+
+            return false;
         }
+
+        saveProgramBinary(m_cache_filepath);
+        onLinked();
+
+        return true;
     }
 
-    void Shader::setUniform(const std::string & uniformName, const glm::vec4 & vector)
+    void Shader::printProgramLog(GLuint program_id)
     {
-        if (m_uniforms_locations.count(uniformName))
-        {
-            glProgramUniform4fv(m_program_id, m_uniforms_locations[uniformName], 1, glm::value_ptr(vector));
-        }
-        else
+        GLint logLen;
+        glGetProgramiv(program_id, GL_INFO_LOG_LENGTH, &logLen);
+
+        if (logLen > 0)
         {
-            if (getUniformLocation(uniformName))
-            {
-                glProgramUniform4fv(m_program_id, m_uniforms_locations[uniformName], 1, glm::value_ptr(vector));
-            }
+            char* log = (char*)malloc(logLen);
+            GLsizei written;
+            glGetProgramInfoLog(program_id, logLen, &written, log);
+
+            fprintf(stderr, "Program log: \n%s", log);
+            free(log);
         }
     }
 
-    void Shader::setUniform(const std::string& uniformName, const glm::uvec2& vector)
+    bool Shader::reload()
     {
-        if (m_uniforms_locations.count(uniformName))
+        if (m_program_id == 0 || m_sources.empty())
         {
-            glProgramUniform2uiv(m_program_id, m_uniforms_locations[uniformName], 1, glm::value_ptr(vector));
+            return false;
         }
-        else
+
+        std::vector<ShaderSource>          sources;
+        std::vector<std::filesystem::path> dependencies;
+
+        for (auto& source : m_sources)
         {
-            if (getUniformLocation(uniformName))
+            std::string           code = Util::LoadFile(source.m_filepath);
+            std::filesystem::path dir  = FileSystem::getRootPath() / source.m_filepath.parent_path();
+
+            auto full_filepath = (FileSystem::getRootPath() / source.m_filepath).lexically_normal();
+
+            if (std::find(dependencies.begin(), dependencies.end(), full_filepath) == dependencies.end())
             {
-                glProgramUniform2uiv(m_program_id, m_uniforms_locations[uniformName], 1, glm::value_ptr(vector));
+                dependencies.push_back(full_filepath);
             }
+
+            sources.push_back({ source.m_type, source.m_filepath, Util::LoadShaderIncludes(code, dir, &dependencies) });
         }
-    }
 
-    void Shader::setUniform(const std::string& uniformName, const glm::uvec3& vector)
-    {
-        if (m_uniforms_locations.count(uniformName))
+        /* The new program is built next to the current one, which stays in use if anything fails. */
+        GLuint program_id = glCreateProgram();
+
+        if (program_id == 0)
         {
-            glProgramUniform3uiv(m_program_id, m_uniforms_locations[uniformName], 1, glm::value_ptr(vector));
+            fprintf(stderr, "Error while creating program object.\n");
+            return false;
         }
-        else
+
+        compileShaders(program_id, sources, false);
+
+        if (!m_feedback_varyings.empty())
         {
-            if (getUniformLocation(uniformName))
+            std::vector<const char*> names;
+
+            for (auto& name : m_feedback_varyings)
             {
-                glProgramUniform3uiv(m_program_id, m_uniforms_locations[uniformName], 1, glm::value_ptr(vector));
+                names.push_back(name.c_str());
             }
+
+            glTransformFeedbackVaryings(program_id, GLsizei(names.size()), names.data(), m_feedback_buffer_mode);
         }
-    }
 
-    void Shader::setUniform(const std::string & uniformName, const glm::mat3 & matrix)
-    {
-        if (m_uniforms_locations.count(uniformName))
+        glProgramParameteri(program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(program_id);
+
+        bool is_compiled = checkCompileStatus(false /* wait_on_error */);
+
+        GLint status;
+        glGetProgramiv(program_id, GL_LINK_STATUS, &status);
+
+        if (!is_compiled || status == GL_FALSE)
         {
-            glProgramUniformMatrix3fv(m_program_id, m_uniforms_locations[uniformName], 1, GL_FALSE, glm::value_ptr(matrix));
+            fprintf(stderr, "Failed to reload shader program, keeping the previous one!\n");
+            printProgramLog(program_id);
+
+            glDeleteProgram(program_id);
+            return false;
         }
-        else
+
+        /* The block bindings set at runtime are part of the program state, carry them over. */
+        auto uniform_blocks = std::move(m_uniform_blocks);
+        auto storage_blocks = std::move(m_storage_blocks);
+
+        glDeleteProgram(m_program_id);
+        GLState::OnProgramDeleted(m_program_id);
+
+        m_program_id   = program_id;
+        m_sources      = std::move(sources);
+        m_dependencies = std::move(dependencies);
+
+        m_cache_filepath = getProgramBinaryCachePath();
+        saveProgramBinary(m_cache_filepath);
+        onLinked();
+
+        for (auto& [name, block] : uniform_blocks) setUniformBlockBinding(name, block.m_binding);
+        for (auto& [name, block] : storage_blocks) setStorageBlockBinding(name, block.m_binding);
+
+        printf("Reloaded shader program %s\n", m_sources[0].m_filepath.string().c_str());
+
+        return true;
+    }
+
+    void Shader::onLinked()
+    {
+        m_is_linked = true;
+
+        /* Locations may change after relinking. */
+        m_uniforms_locations.clear();
+
+        addAllSubroutines();
+        addAllBlocks();
+    }
+
+    void Shader::setTransformFeedbackVaryings(const std::vector<const char*>& output_names, GLenum buffer_mode)
+    {
+        glTransformFeedbackVaryings(m_program_id, output_names.size(), output_names.data(), buffer_mode);
+
+        /* Kept for reload(). */
+        m_feedback_varyings.assign(output_names.begin(), output_names.end());
+        m_feedback_buffer_mode = buffer_mode;
+
+        /* Varyings are part of the linked program, so they have to be part of the cache key too. */
+        for (auto name : output_names)
         {
-            if (getUniformLocation(uniformName))
-            {
-                glProgramUniformMatrix3fv(m_program_id, m_uniforms_locations[uniformName], 1, GL_FALSE, glm::value_ptr(matrix));
-            }
+            m_binary_key_extra.append(name).append("\n");
         }
+        m_binary_key_extra.append(std::to_string(buffer_mode)).append("\n");
     }
 
-    void Shader::setUniform(const std::string & uniformName, const glm::mat4 & matrix)
+    std::filesystem::path Shader::getProgramBinaryCachePath() const
     {
-        if (m_uniforms_locations.count(uniformName))
+        static const bool is_supported = []
+        {
+            GLint num_formats = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+
+            return num_formats > 0;
+        }();
+
+        if (!is_supported || m_sources.empty())
         {
-            glProgramUniformMatrix4fv(m_program_id, m_uniforms_locations[uniformName], 1, GL_FALSE, glm::value_ptr(matrix));
+            return {};
         }
-        else
+
+        /* FNV-1a hash of the driver strings and the include-expanded sources. */
+        uint64_t hash = 14695981039346656037ull;
+
+        auto hash_bytes = [&hash](const void* data, size_t size)
         {
-            if (getUniformLocation(uniformName))
+            auto bytes = static_cast<const uint8_t*>(data);
+
+            for (size_t i = 0; i < size; ++i)
             {
-                glProgramUniformMatrix4fv(m_program_id, m_uniforms_locations[uniformName], 1, GL_FALSE, glm::value_ptr(matrix));
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
             }
-        }
-    }
+        };
 
-    void Shader::setUniform(const std::string& uniformName, float* values, unsigned count)
-    {
-        if (m_uniforms_locations.count(uniformName))
+        for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
         {
-            glProgramUniform1fv(m_program_id, m_uniforms_locations[uniformName], count, &values[0]);
-        }
-        else
-        {
-            if (getUniformLocation(uniformName))
+            auto str = reinterpret_cast<const char*>(glGetString(name));
+
+            if (str)
             {
-                glProgramUniform1fv(m_program_id, m_uniforms_locations[uniformName], count, &values[0]);
+                hash_bytes(str, strlen(str));
             }
         }
+
+        for (auto& source : m_sources)
+        {
+            hash_bytes(&source.m_type, sizeof(source.m_type));
+            const std::string code = getCompiledCode(source);
+            hash_bytes(code.data(), code.size());
+        }
+
+        hash_bytes(m_binary_key_extra.data(), m_binary_key_extra.size());
+
+        char filename[32];
+        snprintf(filename, sizeof(filename), "%016llx.bin", (unsigned long long)hash);
+
+        return FileSystem::getRootPath() / "shader_cache" / filename;
     }
 
-    void Shader::setUniform(const std::string& uniformName, glm::vec2* values, unsigned count)
+    bool Shader::loadProgramBinary(const std::filesystem::path& cache_filepath)
     {
-        if (m_uniforms_locations.count(uniformName))
+        if (cache_filepath.empty() || !std::filesystem::exists(cache_filepath))
         {
-            glProgramUniform2fv(m_program_id, m_uniforms_locations[uniformName], count, &values[0][0]);
+            return false;
         }
-        else
+
+        std::ifstream file(cache_filepath, std::ios::binary | std::ios::ate);
+        size_t        file_size = file.tellg();
+
+        if (!file || file_size <= sizeof(GLenum))
         {
-            if (getUniformLocation(uniformName))
-            {
-                glProgramUniform2fv(m_program_id, m_uniforms_locations[uniformName], count, &values[0][0]);
-            }
+            return false;
+        }
+
+        GLenum            binary_format;
+        std::vector<char> binary(file_size - sizeof(GLenum));
+
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(&binary_format), sizeof(GLenum));
+        file.read(binary.data(), binary.size());
+
+        if (!file)
+        {
+            return false;
         }
+
+        glProgramBinary(m_program_id, binary_format, binary.data(), GLsizei(binary.size()));
+
+        GLint status;
+        glGetProgramiv(m_program_id, GL_LINK_STATUS, &status);
+
+        /* Driver update or a corrupted file - the binary is rejected and the program has to be compiled again. */
+        return status == GL_TRUE;
     }
 
-    void Shader::setUniform(const std::string & uniformName, glm::mat4 * matrices, unsigned count)
+    void Shader::saveProgramBinary(const std::filesystem::path& cache_filepath) const
     {
-        if (m_uniforms_locations.count(uniformName))
+        if (cache_filepath.empty())
         {
-            glProgramUniformMatrix4fv(m_program_id, m_uniforms_locations[uniformName], count, GL_FALSE, &matrices[0][0][0]);
+            return;
         }
-        else
+
+        GLint binary_length = 0;
+        glGetProgramiv(m_program_id, GL_PROGRAM_BINARY_LENGTH, &binary_length);
+
+        if (binary_length <= 0)
         {
-            if (getUniformLocation(uniformName))
-            {
-                glProgramUniformMatrix4fv(m_program_id, m_uniforms_locations[uniformName], count, GL_FALSE, &matrices[0][0][0]);
-            }
+            return;
         }
+
+        GLenum            binary_format;
+        std::vector<char> binary(binary_length);
+        glGetProgramBinary(m_program_id, binary_length, nullptr, &binary_format, binary.data());
+
+        std::error_code ec;
+        std::filesystem::create_directories(cache_filepath.parent_path(), ec);
+
+        std::ofstream file(cache_filepath, std::ios::binary);
+
+        if (!file)
+        {
+            fprintf(stderr, "Could not write the program binary %s\n", cache_filepath.string().c_str());
+            return;
+        }
+
+        file.write(reinterpret_cast<const char*>(&binary_format), sizeof(GLenum));
+        file.write(binary.data(), binary.size());
     }
 
-    void Shader::setUniform(const std::string& uniformName, glm::mat2x4* matrices, unsigned count)
+    void Shader::bind() const
     {
-        if (m_uniforms_locations.count(uniformName))
+        if (m_program_id != 0 && m_is_linked)
         {
-            glProgramUniformMatrix2x4fv(m_program_id, m_uniforms_locations[uniformName], count, GL_FALSE, &matrices[0][0][0]);
+            GLState::UseProgram(m_program_id);
         }
-        else
+    }
+
+    UniformLocation Shader::getUniformLocation(std::string_view uniform_name)
+    {
+        if (auto it = m_uniforms_locations.find(uniform_name); it != m_uniforms_locations.end())
         {
-            if (getUniformLocation(uniformName))
-            {
-                glProgramUniformMatrix2x4fv(m_program_id, m_uniforms_locations[uniformName], count, GL_FALSE, &matrices[0][0][0]);
-            }
+            return it->second;
         }
+
+        std::string     name(uniform_name);
+        UniformLocation location { glGetUniformLocation(m_program_id, name.c_str()) };
+
+        m_uniforms_locations.emplace(std::move(name), location);
+
+        return location;
+    }
+
+    void Shader::setUniform(std::string_view uniform_name, float value)
+    {
+        setUniform(getUniformLocation(uniform_name), value);
+    }
+
+    void Shader::setUniform(std::string_view uniform_name, int value)
+    {
+        setUniform(getUniformLocation(uniform_name), value);
+    }
+
+    void Shader::setUniform(std::string_view uniform_name, GLuint value)
+    {
+        setUniform(getUniformLocation(uniform_name), value);
+    }
+
+    void Shader::setUniform(std::string_view uniform_name, GLsizei count, float * value)
+    {
+        setUniform(getUniformLocation(uniform_name), count, value);
+    }
+
+    void Shader::setUniform(std::string_view uniform_name, GLsizei count, int * value)
+    {
+        setUniform(getUniformLocation(uniform_name), count, value);
+    }
+
+    void Shader::setUniform(std::string_view uniform_name, GLsizei count, glm::vec3 * vectors)
+    {
+        setUniform(getUniformLocation(uniform_name), count, vectors);
+    }
+
+    void Shader::setUniform(std::string_view uniform_name, const glm::vec2 & vector)
+    {
+        setUniform(getUniformLocation(uniform_name), vector);
+    }
+
+    void Shader::setUniform(std::string_view uniform_name, const glm::vec3 & vector)
+    {
+        setUniform(getUniformLocation(uniform_name), vector);
+    }
+
+    void Shader::setUniform(std::string_view uniform_name, const glm::vec4 & vector)
+    {
+        setUniform(getUniformLocation(uniform_name), vector);
+    }
+
+    void Shader::setUniform(std::string_view uniform_name, const glm::uvec2& vector)
+    {
+        setUniform(getUniformLocation(uniform_name), vector);
+    }
+
+    void Shader::setUniform(std::string_view uniform_name, const glm::uvec3& vector)
+    {
+        setUniform(getUniformLocation(uniform_name), vector);
+    }
+
+    void Shader::setUniform(std::string_view uniform_name, const glm::mat3 & matrix)
+    {
+        setUniform(getUniformLocation(uniform_name), matrix);
+    }
+
+    void Shader::setUniform(std::string_view uniform_name, const glm::mat4 & matrix)
+    {
+        setUniform(getUniformLocation(uniform_name), matrix);
+    }
+
+    void Shader::setUniform(std::string_view uniform_name, float* values, unsigned count)
+    {
+        setUniform(getUniformLocation(uniform_name), values, count);
+    }
+
+    void Shader::setUniform(std::string_view uniform_name, glm::vec2* values, unsigned count)
+    {
+        setUniform(getUniformLocation(uniform_name), values, count);
+    }
+
+    void Shader::setUniform(std::string_view uniform_name, glm::vec4* values, unsigned count)
+    {
+        setUniform(getUniformLocation(uniform_name), values, count);
+    }
+
+    void Shader::setUniform(std::string_view uniform_name, glm::mat4 * matrices, unsigned count)
+    {
+        setUniform(getUniformLocation(uniform_name), matrices, count);
+    }
+
+    void Shader::setUniform(std::string_view uniform_name, glm::mat2x4* matrices, unsigned count)
+    {
+        setUniform(getUniformLocation(uniform_name), matrices, count);
+    }
+
+    void Shader::setUniform(UniformLocation location, float value)
+    {
+        glProgramUniform1f(m_program_id, location.m_location, value);
+    }
+
+    void Shader::setUniform(UniformLocation location, int value)
+    {
+        glProgramUniform1i(m_program_id, location.m_location, value);
+    }
+
+    void Shader::setUniform(UniformLocation location, GLuint value)
+    {
+        glProgramUniform1ui(m_program_id, location.m_location, value);
+    }
+
+    void Shader::setUniform(UniformLocation location, GLsizei count, float * value)
+    {
+        glProgramUniform1fv(m_program_id, location.m_location, count, value);
+    }
+
+    void Shader::setUniform(UniformLocation location, GLsizei count, int * value)
+    {
+        glProgramUniform1iv(m_program_id, location.m_location, count, value);
+    }
+
+    void Shader::setUniform(UniformLocation location, GLsizei count, glm::vec3 * vectors)
+    {
+        glProgramUniform3fv(m_program_id, location.m_location, count, glm::value_ptr(vectors[0]));
+    }
+
+    void Shader::setUniform(UniformLocation location, const glm::vec2 & vector)
+    {
+        glProgramUniform2fv(m_program_id, location.m_location, 1, glm::value_ptr(vector));
+    }
+
+    void Shader::setUniform(UniformLocation location, const glm::vec3 & vector)
+    {
+        glProgramUniform3fv(m_program_id, location.m_location, 1, glm::value_ptr(vector));
+    }
+
+    void Shader::setUniform(UniformLocation location, const glm::vec4 & vector)
+    {
+        glProgramUniform4fv(m_program_id, location.m_location, 1, glm::value_ptr(vector));
+    }
+
+    void Shader::setUniform(UniformLocation location, const glm::uvec2& vector)
+    {
+        glProgramUniform2uiv(m_program_id, location.m_location, 1, glm::value_ptr(vector));
+    }
+
+    void Shader::setUniform(UniformLocation location, const glm::uvec3& vector)
+    {
+        glProgramUniform3uiv(m_program_id, location.m_location, 1, glm::value_ptr(vector));
+    }
+
+    void Shader::setUniform(UniformLocation location, const glm::mat3 & matrix)
+    {
+        glProgramUniformMatrix3fv(m_program_id, location.m_location, 1, GL_FALSE, glm::value_ptr(matrix));
+    }
+
+    void Shader::setUniform(UniformLocation location, const glm::mat4 & matrix)
+    {
+        glProgramUniformMatrix4fv(m_program_id, location.m_location, 1, GL_FALSE, glm::value_ptr(matrix));
+    }
+
+    void Shader::setUniform(UniformLocation location, float* values, unsigned count)
+    {
+        glProgramUniform1fv(m_program_id, location.m_location, count, &values[0]);
+    }
+
+    void Shader::setUniform(UniformLocation location, glm::vec2* values, unsigned count)
+    {
+        glProgramUniform2fv(m_program_id, location.m_location, count, &values[0][0]);
+    }
+
+    void Shader::setUniform(UniformLocation location, glm::vec4* values, unsigned count)
+    {
+        glProgramUniform4fv(m_program_id, location.m_location, count, &values[0][0]);
+    }
+
+    void Shader::setUniform(UniformLocation location, glm::mat4 * matrices, unsigned count)
+    {
+        glProgramUniformMatrix4fv(m_program_id, location.m_location, count, GL_FALSE, &matrices[0][0][0]);
+    }
+
+    void Shader::setUniform(UniformLocation location, glm::mat2x4* matrices, unsigned count)
+    {
+        glProgramUniformMatrix2x4fv(m_program_id, location.m_location, count, GL_FALSE, &matrices[0][0][0]);
     }
 
     void Shader::setSubroutine(ShaderType shader_type, const std::string & subroutine_name)
@@ -493,4 +924,103 @@ namespace RGL
             }
         }
     }
+
+    const ShaderBlockInfo* Shader::getUniformBlock(std::string_view block_name) const
+    {
+        if (auto it = m_uniform_blocks.find(block_name); it != m_uniform_blocks.end())
+        {
+            return &it->second;
+        }
+
+        return nullptr;
+    }
+
+    const ShaderBlockInfo* Shader::getStorageBlock(std::string_view block_name) const
+    {
+        if (auto it = m_storage_blocks.find(block_name); it != m_storage_blocks.end())
+        {
+            return &it->second;
+        }
+
+        return nullptr;
+    }
+
+    GLint Shader::getUniformBlockMemberOffset(std::string_view block_name, std::string_view member_name) const
+    {
+        auto block = getUniformBlock(block_name);
+
+        if (!block)
+        {
+            return -1;
+        }
+
+        const GLuint index = glGetProgramResourceIndex(m_program_id, GL_UNIFORM, std::string(member_name).c_str());
+
+        if (index == GL_INVALID_INDEX)
+        {
+            return -1;
+        }
+
+        const GLenum properties[] = { GL_BLOCK_INDEX, GL_OFFSET };
+        GLint        values[std::size(properties)];
+        glGetProgramResourceiv(m_program_id, GL_UNIFORM, index, std::size(properties), properties, std::size(properties), nullptr, values);
+
+        return values[0] == GLint(block->m_index) ? values[1] : -1;
+    }
+
+    bool Shader::setUniformBlockBinding(std::string_view block_name, GLuint binding)
+    {
+        if (auto it = m_uniform_blocks.find(block_name); it != m_uniform_blocks.end())
+        {
+            glUniformBlockBinding(m_program_id, it->second.m_index, binding);
+            it->second.m_binding = binding;
+
+            return true;
+        }
+
+        return false;
+    }
+
+    bool Shader::setStorageBlockBinding(std::string_view block_name, GLuint binding)
+    {
+        if (auto it = m_storage_blocks.find(block_name); it != m_storage_blocks.end())
+        {
+            glShaderStorageBlockBinding(m_program_id, it->second.m_index, binding);
+            it->second.m_binding = binding;
+
+            return true;
+        }
+
+        return false;
+    }
+
+    void Shader::addAllBlocks()
+    {
+        m_uniform_blocks.clear();
+        m_storage_blocks.clear();
+
+        GLenum                       interfaces[] = { GL_UNIFORM_BLOCK,  GL_SHADER_STORAGE_BLOCK };
+        decltype(m_uniform_blocks) * blocks[]     = { &m_uniform_blocks, &m_storage_blocks };
+
+        for (GLint i = 0; i < GLint(std::size(interfaces)); ++i)
+        {
+            GLint num_blocks = 0;
+            glGetProgramInterfaceiv(m_program_id, interfaces[i], GL_ACTIVE_RESOURCES, &num_blocks);
+
+            const GLenum properties[]    = { GL_NAME_LENGTH, GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+            const GLint  properties_size = std::size(properties);
+
+            for (GLint j = 0; j < num_blocks; ++j)
+            {
+                GLint values[properties_size];
+                glGetProgramResourceiv(m_program_id, interfaces[i], j, properties_size, properties, properties_size, nullptr, values);
+
+                std::vector<char> name_data(values[0]);
+                glGetProgramResourceName(m_program_id, interfaces[i], j, name_data.size(), nullptr, &name_data[0]);
+                std::string block_name(name_data.begin(), name_data.end() - 1);
+
+                blocks[i]->emplace(std::move(block_name), ShaderBlockInfo{ GLuint(j), GLuint(values[1]), values[2] });
+            }
+        }
+    }
 }
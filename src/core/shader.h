@@ -1,8 +1,11 @@
 #pragma once
 
 #include <filesystem>
+#include <functional>
 #include <map>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include <glad/glad.h>
@@ -13,6 +16,22 @@
 
 namespace RGL
 {
+    /* Uniform location token. Query it once with Shader::getUniformLocation() and reuse it every frame. */
+    struct UniformLocation
+    {
+        GLint m_location = -1;
+
+        bool isValid() const { return m_location != -1; }
+    };
+
+    /* Reflected uniform block or shader storage block of a linked program. */
+    struct ShaderBlockInfo
+    {
+        GLuint m_index;
+        GLuint m_binding;
+        GLint  m_data_size;
+    };
+
     class Shader final
     {
     public:
@@ -50,41 +69,170 @@ namespace RGL
         ~Shader();
 
         bool link();
-        void setTransformFeedbackVaryings(const std::vector<const char*>& output_names, GLenum buffer_mode) const;
+
+        /*
+         * Starts compiling and linking without waiting for the driver. With KHR_parallel_shader_compile
+         * all the programs of a demo can be built concurrently - call linkAsync() for every shader first,
+         * then poll isReady() or call link(), which blocks until the pending link is finished.
+         */
+        void linkAsync();
+        bool isReady();
+
+        /*
+         * Reads the sources and their includes again and builds them into a new program. On success the new program
+         * replaces the current one - the uniforms have to be set again, the block bindings are kept. On failure
+         * the errors are printed and the current program stays in use. Used by ShaderWatcher.
+         */
+        bool reload();
+        void setTransformFeedbackVaryings(const std::vector<const char*>& output_names, GLenum buffer_mode);
         void bind() const;
 
-        void setUniform(const std::string & uniform_name, float value);
-        void setUniform(const std::string & uniform_name, int value);
-        void setUniform(const std::string & uniform_name, GLuint value);
-        void setUniform(const std::string & uniform_name, GLsizei count, float * value);
-        void setUniform(const std::string & uniform_name, GLsizei count, int * value);
-        void setUniform(const std::string & uniform_name, GLsizei count, glm::vec3 * vectors);
-        void setUniform(const std::string & uniform_name, const glm::vec2 & vector);
-        void setUniform(const std::string & uniform_name, const glm::vec3 & vector);
-        void setUniform(const std::string & uniform_name, const glm::vec4 & vector);
-        void setUniform(const std::string & uniform_name, const glm::uvec2 & vector);
-        void setUniform(const std::string & uniform_name, const glm::uvec3 & vector);
-        void setUniform(const std::string & uniform_name, const glm::mat3 & matrix);
-        void setUniform(const std::string & uniform_name, const glm::mat4 & matrix);
-        void setUniform(const std::string & uniform_name, float* values, unsigned count);
-        void setUniform(const std::string & uniform_name, glm::vec2* values, unsigned count);
-        void setUniform(const std::string & uniform_name, glm::mat4 * matrices, unsigned count);
-        void setUniform(const std::string & uniform_name, glm::mat2x4 * matrices, unsigned count);
+        /* Returns the cached location of the uniform. Invalid location (-1) is cached as well. */
+        UniformLocation getUniformLocation(std::string_view uniform_name);
+
+        void setUniform(std::string_view uniform_name, float value);
+        void setUniform(std::string_view uniform_name, int value);
+        void setUniform(std::string_view uniform_name, GLuint value);
+        void setUniform(std::string_view uniform_name, GLsizei count, float * value);
+        void setUniform(std::string_view uniform_name, GLsizei count, int * value);
+        void setUniform(std::string_view uniform_name, GLsizei count, glm::vec3 * vectors);
+        void setUniform(std::string_view uniform_name, const glm::vec2 & vector);
+        void setUniform(std::string_view uniform_name, const glm::vec3 & vector);
+        void setUniform(std::string_view uniform_name, const glm::vec4 & vector);
+        void setUniform(std::string_view uniform_name, const glm::uvec2 & vector);
+        void setUniform(std::string_view uniform_name, const glm::uvec3 & vector);
+        void setUniform(std::string_view uniform_name, const glm::mat3 & matrix);
+        void setUniform(std::string_view uniform_name, const glm::mat4 & matrix);
+        void setUniform(std::string_view uniform_name, float* values, unsigned count);
+        void setUniform(std::string_view uniform_name, glm::vec2* values, unsigned count);
+        void setUniform(std::string_view uniform_name, glm::vec4* values, unsigned count);
+        void setUniform(std::string_view uniform_name, glm::mat4 * matrices, unsigned count);
+        void setUniform(std::string_view uniform_name, glm::mat2x4 * matrices, unsigned count);
+
+        void setUniform(UniformLocation location, float value);
+        void setUniform(UniformLocation location, int value);
+        void setUniform(UniformLocation location, GLuint value);
+        void setUniform(UniformLocation location, GLsizei count, float * value);
+        void setUniform(UniformLocation location, GLsizei count, int * value);
+        void setUniform(UniformLocation location, GLsizei count, glm::vec3 * vectors);
+        void setUniform(UniformLocation location, const glm::vec2 & vector);
+        void setUniform(UniformLocation location, const glm::vec3 & vector);
+        void setUniform(UniformLocation location, const glm::vec4 & vector);
+        void setUniform(UniformLocation location, const glm::uvec2 & vector);
+        void setUniform(UniformLocation location, const glm::uvec3 & vector);
+        void setUniform(UniformLocation location, const glm::mat3 & matrix);
+        void setUniform(UniformLocation location, const glm::mat4 & matrix);
+        void setUniform(UniformLocation location, float* values, unsigned count);
+        void setUniform(UniformLocation location, glm::vec2* values, unsigned count);
+        void setUniform(UniformLocation location, glm::vec4* values, unsigned count);
+        void setUniform(UniformLocation location, glm::mat4 * matrices, unsigned count);
+        void setUniform(UniformLocation location, glm::mat2x4 * matrices, unsigned count);
 
         void setSubroutine(ShaderType shader_type, const std::string& subroutine_name);
 
+        /* Program interface reflection, filled in link(). Returns nullptr if the block is not active. */
+        const ShaderBlockInfo* getUniformBlock(std::string_view block_name) const;
+        const ShaderBlockInfo* getStorageBlock(std::string_view block_name) const;
+
+        /* GL_OFFSET of the uniform member_name in the block, -1 if it's not an active member of the block. */
+        GLint getUniformBlockMemberOffset(std::string_view block_name, std::string_view member_name) const;
+
+        const auto& getUniformBlocks() const { return m_uniform_blocks; }
+        const auto& getStorageBlocks() const { return m_storage_blocks; }
+
+        bool setUniformBlockBinding(std::string_view block_name, GLuint binding);
+        bool setStorageBlockBinding(std::string_view block_name, GLuint binding);
+
+        /* Full paths of the program's source files and all of their (nested) includes - the files the program depends on. */
+        const std::vector<std::filesystem::path>& getDependencies() const { return m_dependencies; }
+
+        /*
+         * GLSL code appended to every fragment shader, their own main() is renamed to rgl_instrumented_main() - the code
+         * declares the new main(), which calls it first. Empty by default. The programs built before a change keep
+         * the previous code until they are reloaded, DebugView reloads all of them with ShaderWatcher::ReloadAll().
+         */
+        static void               setFragmentInstrumentation(std::string code) { s_fragment_instrumentation = std::move(code); }
+        static const std::string& getFragmentInstrumentation()                 { return s_fragment_instrumentation; }
+
+        /* The tools that read the instrumentation's results opt their own shaders out, before link(). */
+        void setInstrumented(bool enable) { m_is_instrumented = enable; }
+
+        /*
+         * Loads the stages from the SPIR-V modules of the spirv_builder tool (ARB_gl_spirv) instead of compiling
+         * their GLSL, the front end of the driver is skipped - CoreApp's --spirv option. A stage without a module,
+         * a module the driver rejects and a program that fails to link fall back to the GLSL sources. The modules are
+         * found by getSpirvFilepath() of the code as it's compiled, a changed source or define misses them.
+         * The names of the uniforms are kept in the modules, the drivers that drop them leave setUniform() at -1.
+         */
+        static void setSpirvEnabled(bool enable) { s_is_spirv_enabled = enable; }
+        static bool isSpirvEnabled()             { return s_is_spirv_enabled; }
+
+        /* <root>/shader_cache/spirv/<hash of the stage and the code>.spv */
+        static std::filesystem::path getSpirvFilepath(GLenum type, std::string_view code);
+
+        /* Adds "#define name value" after the #version of all the stages, before link(). The defines are a part of the program binary cache's key. */
+        void setDefine(std::string_view name, std::string_view value = "");
+
     private:
-        void addAllSubroutines();
+        struct ShaderSource
+        {
+            GLenum                m_type;
+            std::filesystem::path m_filepath;
+            std::string           m_code;
+        };
 
-        void addShader(const std::filesystem::path & filepath, GLuint type) const;
-        bool getUniformLocation(const std::string & uniform_name);
+        void addAllSubroutines();
+        void addAllBlocks();
+
+        /* The source as it's compiled, with the defines and the fragment instrumentation if there are any. */
+        std::string getCompiledCode(const ShaderSource& source) const;
+
+        void addShader(const std::filesystem::path & filepath, GLuint type);
+        /* With use_spirv the stages that have a module in shader_cache/spirv are loaded from it, the rest is compiled from GLSL. */
+        void compileShaders(GLuint program_id, const std::vector<ShaderSource>& sources, bool use_spirv);
+        bool loadSpirv(GLuint shader_object, GLenum type, const std::string& code);
+        bool checkCompileStatus(bool wait_on_error = true);
+        bool finishLink();
+        void onLinked();
+
+        static void printProgramLog(GLuint program_id);
+
+        /* Program binary cache, stored in <root>/shader_cache and keyed by the hash of the sources and the driver. */
+        std::filesystem::path getProgramBinaryCachePath() const;
+        bool                  loadProgramBinary(const std::filesystem::path & cache_filepath);
+        void                  saveProgramBinary(const std::filesystem::path & cache_filepath) const;
+
+        std::vector<ShaderSource>                            m_sources;
+        std::vector<std::filesystem::path>                   m_dependencies;
+        std::vector<std::pair<GLuint, std::filesystem::path>> m_pending_shader_objects;
+        std::string                                          m_binary_key_extra;
+        std::string                                          m_defines;
+        std::vector<std::string>                             m_feedback_varyings;
+        GLenum                                               m_feedback_buffer_mode;
+        std::filesystem::path                                m_cache_filepath;
 
         std::map<std::string, GLuint> m_subroutine_indices;
         std::map<GLenum, GLuint> m_active_subroutine_uniform_locations;
 
-        std::map<std::string, GLint> m_uniforms_locations;
+        /* Transparent hash, so the lookups with std::string_view don't construct std::string. */
+        struct StringHash
+        {
+            using is_transparent = void;
+
+            size_t operator()(std::string_view str) const { return std::hash<std::string_view>{}(str); }
+        };
+
+        std::unordered_map<std::string, UniformLocation, StringHash, std::equal_to<>> m_uniforms_locations;
+        std::unordered_map<std::string, ShaderBlockInfo, StringHash, std::equal_to<>> m_uniform_blocks;
+        std::unordered_map<std::string, ShaderBlockInfo, StringHash, std::equal_to<>> m_storage_blocks;
 
         GLuint m_program_id;
         bool m_is_linked;
+        bool m_is_link_pending;
+        bool m_is_instrumented;
+        bool m_is_spirv;        /* Some of the stages of the pending link are SPIR-V. */
+
+        static std::string s_fragment_instrumentation;
+        static bool        s_is_spirv_enabled;
     };
 }
@@ -0,0 +1,98 @@
+#include "shader_permutations.h"
+
+#include <cstdio>
+
+#include "shader.h"
+#include "trace.h"
+
+namespace RGL
+{
+    ShaderPermutations::ShaderPermutations(Factory factory, std::vector<std::string> features)
+        : m_factory (std::move(factory)),
+          m_features(std::move(features))
+    {
+        if (m_features.size() > MAX_FEATURES)
+        {
+            fprintf(stderr, "ShaderPermutations: %zu features, only the first %u have a bit.\n", m_features.size(), MAX_FEATURES);
+            m_features.resize(MAX_FEATURES);
+        }
+    }
+
+    void ShaderPermutations::SetDefine(std::string_view name, std::string_view value)
+    {
+        m_defines.emplace_back(name, value);
+    }
+
+    uint64_t ShaderPermutations::GetBit(std::string_view feature) const
+    {
+        for (size_t i = 0; i < m_features.size(); ++i)
+        {
+            if (m_features[i] == feature)
+            {
+                return uint64_t(1) << i;
+            }
+        }
+
+        return 0;
+    }
+
+    uint64_t ShaderPermutations::GetMask(std::initializer_list<std::string_view> features) const
+    {
+        uint64_t mask = 0;
+
+        for (auto feature : features)
+        {
+            mask |= GetBit(feature);
+        }
+
+        return mask;
+    }
+
+    void ShaderPermutations::Prepare(std::initializer_list<uint64_t> masks)
+    {
+        for (uint64_t mask : masks)
+        {
+            if (m_variants.find(mask) == m_variants.end())
+            {
+                Create(mask).m_shader->linkAsync();
+            }
+        }
+    }
+
+    Shader& ShaderPermutations::Get(uint64_t mask)
+    {
+        auto it = m_variants.find(mask);
+
+        Variant& variant = it != m_variants.end() ? it->second : Create(mask);
+
+        if (variant.m_is_link_pending)
+        {
+            variant.m_is_link_pending = false;
+            variant.m_shader->link();
+        }
+
+        return *variant.m_shader;
+    }
+
+    ShaderPermutations::Variant& ShaderPermutations::Create(uint64_t mask)
+    {
+        RGL_TRACE_ZONE("ShaderPermutations::Create");
+
+        auto shader = m_factory();
+
+        for (const auto& [name, value] : m_defines)
+        {
+            shader->setDefine(name, value);
+        }
+
+        for (size_t i = 0; i < m_features.size(); ++i)
+        {
+            if (mask & (uint64_t(1) << i))
+            {
+                shader->setDefine(m_features[i]);
+            }
+        }
+
+        return m_variants[mask] = { std::move(shader), true };
+    }
+}
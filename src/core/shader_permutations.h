@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace RGL
+{
+    class Shader;
+
+    /*
+     * The compile time variants of a program, in place of the subroutines and the uniform branches. Every feature
+     * is a define of the sources - "#define HAS_NORMAL_MAP" - and a bit of the mask, at the feature's index.
+     * Get() builds the variant of a mask on its first use and keeps it in a map keyed by the mask. The defines are
+     * a part of the sources' hash, so every variant has its own entry in the program binary cache and the next
+     * run loads it instead of compiling it again. The variants register with ShaderWatcher as any Shader does.
+     *
+     *     ShaderPermutations pbr_shader([] { return std::make_shared<Shader>("pbr.vert", "pbr.frag"); },
+     *                                   { "HAS_ALBEDO_MAP", "HAS_NORMAL_MAP" });
+     *     pbr_shader.Prepare({ 0, pbr_shader.GetMask({ "HAS_ALBEDO_MAP" }) }); // Optional, at load.
+     *
+     *     Shader& shader = pbr_shader.Get(material_mask);
+     */
+    class ShaderPermutations final
+    {
+    public:
+        static constexpr uint32_t MAX_FEATURES = 64;
+
+        /* Creates the unlinked shader of a variant, with its sources. */
+        using Factory = std::function<std::shared_ptr<Shader>()>;
+
+        ShaderPermutations(Factory factory, std::vector<std::string> features);
+
+        ShaderPermutations           (const ShaderPermutations&) = delete;
+        ShaderPermutations& operator=(const ShaderPermutations&) = delete;
+
+        /* A define of all the variants, before the first Get(). */
+        void SetDefine(std::string_view name, std::string_view value = "");
+
+        /* The bit of the feature, 0 if there's no such feature. */
+        uint64_t GetBit (std::string_view feature) const;
+        uint64_t GetMask(std::initializer_list<std::string_view> features) const;
+
+        /* Starts linking the variants that don't exist yet with Shader::linkAsync(), Get() waits for them. */
+        void Prepare(std::initializer_list<uint64_t> masks);
+
+        /* The linked variant of the features in the mask. A variant that failed to build prints its errors once and is returned anyway, a hot reload can fix it. */
+        Shader& Get(uint64_t mask);
+
+        /* The variants built so far. */
+        uint32_t GetCount() const { return uint32_t(m_variants.size()); }
+
+    private:
+        struct Variant
+        {
+            std::shared_ptr<Shader> m_shader;
+            bool                    m_is_link_pending;
+        };
+
+        Variant& Create(uint64_t mask);
+
+        Factory                                          m_factory;
+        std::vector<std::string>                         m_features;
+        std::vector<std::pair<std::string, std::string>> m_defines;
+        std::unordered_map<uint64_t, Variant>            m_variants;
+    };
+}
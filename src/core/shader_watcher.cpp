@@ -0,0 +1,120 @@
+#include "shader_watcher.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "shader.h"
+#include "timer.h"
+
+namespace RGL
+{
+    bool                                                             ShaderWatcher::s_is_enabled     = false;
+    double                                                           ShaderWatcher::s_last_poll_time = 0.0;
+    std::vector<Shader*>                                             ShaderWatcher::s_shaders;
+    std::unordered_map<std::string, std::filesystem::file_time_type> ShaderWatcher::s_write_times;
+
+    void ShaderWatcher::SetEnabled(bool enable)
+    {
+        s_is_enabled = enable;
+        s_write_times.clear();
+
+        /* The files are compared against their state at the time the watching starts. */
+        if (s_is_enabled)
+        {
+            for (auto shader : s_shaders)
+            {
+                WatchDependencies(shader);
+            }
+
+            s_last_poll_time = Timer::getTime();
+        }
+    }
+
+    void ShaderWatcher::Register(Shader* shader)
+    {
+        s_shaders.push_back(shader);
+    }
+
+    void ShaderWatcher::Unregister(Shader* shader)
+    {
+        s_shaders.erase(std::remove(s_shaders.begin(), s_shaders.end(), shader), s_shaders.end());
+    }
+
+    void ShaderWatcher::WatchDependencies(const Shader* shader)
+    {
+        for (auto& filepath : shader->getDependencies())
+        {
+            if (s_write_times.find(filepath.string()) == s_write_times.end())
+            {
+                std::error_code ec;
+                s_write_times[filepath.string()] = std::filesystem::last_write_time(filepath, ec);
+            }
+        }
+    }
+
+    void ShaderWatcher::Update()
+    {
+        if (!s_is_enabled)
+        {
+            return;
+        }
+
+        const double time = Timer::getTime();
+
+        if (time - s_last_poll_time < POLL_INTERVAL)
+        {
+            return;
+        }
+
+        s_last_poll_time = time;
+
+        /* The shaders created since the last check. */
+        for (auto shader : s_shaders)
+        {
+            WatchDependencies(shader);
+        }
+
+        std::unordered_set<std::string> changed_files;
+
+        for (auto& [filepath, write_time] : s_write_times)
+        {
+            std::error_code ec;
+            auto            current_write_time = std::filesystem::last_write_time(filepath, ec);
+
+            /* An editor may replace the file in several steps - a missing file is checked again next time. */
+            if (!ec && current_write_time != write_time)
+            {
+                write_time = current_write_time;
+                changed_files.insert(filepath);
+            }
+        }
+
+        if (changed_files.empty())
+        {
+            return;
+        }
+
+        for (auto shader : s_shaders)
+        {
+            const auto& dependencies = shader->getDependencies();
+
+            bool is_affected = std::any_of(dependencies.begin(), dependencies.end(), [&](const std::filesystem::path& filepath)
+            {
+                return changed_files.count(filepath.string()) > 0;
+            });
+
+            if (is_affected)
+            {
+                shader->reload();
+            }
+        }
+    }
+
+    void ShaderWatcher::ReloadAll()
+    {
+        for (auto shader : s_shaders)
+        {
+            shader->reload();
+        }
+    }
+}
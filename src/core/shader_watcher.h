@@ -0,0 +1,47 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace RGL
+{
+    class Shader;
+
+    /*
+     * Hot reload of the shaders. Every Shader registers itself, Update() polls the write times of all the files
+     * the registered programs depend on (Shader::getDependencies(), the sources and the nested includes) and
+     * calls Shader::reload() only for the programs that use a changed file. A program that fails to build keeps
+     * running with its previous version, the next save of the file tries again.
+     *
+     * Disabled by default, CoreApp enables it with --hot-reload and calls Update() once per frame.
+     * Render thread only.
+     */
+    class ShaderWatcher
+    {
+    public:
+        /* Seconds between the checks of the write times. */
+        static constexpr double POLL_INTERVAL = 0.25;
+
+        static void SetEnabled(bool enable);
+        static bool IsEnabled() { return s_is_enabled; }
+
+        static void Update();
+
+        /* Reloads every registered program, also when the watching is disabled - for the changes of the generated code. */
+        static void ReloadAll();
+
+        static void Register  (Shader* shader);
+        static void Unregister(Shader* shader);
+
+    private:
+        /* Adds the files of the shader that aren't watched yet, with their current write times. */
+        static void WatchDependencies(const Shader* shader);
+
+        static bool                                                             s_is_enabled;
+        static double                                                           s_last_poll_time;
+        static std::vector<Shader*>                                             s_shaders;
+        static std::unordered_map<std::string, std::filesystem::file_time_type> s_write_times;
+    };
+}
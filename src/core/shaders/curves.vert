@@ -0,0 +1,10 @@
+#version 460 core
+
+// CurveBatch: a patch of one vertex per curve, the control points are read from the curves SSBO by the TCS.
+
+out uint vs_curve_index;
+
+void main()
+{
+    vs_curve_index = gl_BaseInstance + gl_InstanceID;
+}
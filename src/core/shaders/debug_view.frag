@@ -0,0 +1,40 @@
+#version 460 core
+#include "../core_shared.h"
+
+// DebugView's counters as a heatmap - black where nothing was shaded, blue at 1 through cyan, green and yellow
+// to red at u_max_count, white above it. The counts are in DEBUG_VIEW_COUNTER_SCALE units.
+
+layout(std430, binding = DEBUG_VIEW_SSBO_BINDING_INDEX) readonly buffer DebugViewSSBO
+{
+    uvec2 size;
+    uint  counters[];
+};
+
+uniform float u_max_count;
+
+out vec4 frag_color;
+
+const vec3 RAMP[5] = vec3[](vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 1.0), vec3(0.0, 1.0, 0.0), vec3(1.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0));
+
+void main()
+{
+    uvec2 pixel = min(uvec2(gl_FragCoord.xy), size - 1u);
+    float count = float(counters[pixel.y * size.x + pixel.x]) / float(DEBUG_VIEW_COUNTER_SCALE);
+
+    if (count <= 0.0)
+    {
+        frag_color = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    if (count > u_max_count)
+    {
+        frag_color = vec4(1.0);
+        return;
+    }
+
+    float t     = clamp((count - 1.0) / max(u_max_count - 1.0, 1e-3), 0.0, 1.0) * 4.0;
+    int   index = min(int(t), 3);
+
+    frag_color = vec4(mix(RAMP[index], RAMP[index + 1], t - float(index)), 1.0);
+}
@@ -0,0 +1,13 @@
+#version 460 core
+
+layout (location = 0) in vec2 in_uv;
+layout (location = 1) in vec4 in_color;
+
+layout (binding = 0) uniform sampler2D u_texture;
+
+layout (location = 0) out vec4 frag_color;
+
+void main()
+{
+    frag_color = in_color * texture(u_texture, in_uv);
+}
@@ -0,0 +1,33 @@
+#version 460 core
+#include "../core_shared.h"
+
+// The ImGui vertices of GUIRenderer. The base instance of a draw is its command's index, the clip rectangle is
+// applied with the clip distances, so the commands of one texture need no scissor change between them.
+
+layout (location = 0) in vec2 in_pos;
+layout (location = 1) in vec2 in_uv;
+layout (location = 2) in vec4 in_color;
+
+layout(std430, binding = GUI_CLIP_RECTS_SSBO_BINDING_INDEX) readonly buffer GUIClipRectsSSBO
+{
+    vec4 clip_rects[];  // min x, min y, max x, max y - in the ImGui's display coordinates, as the vertices.
+};
+
+uniform mat4 u_projection;
+
+layout (location = 0) out vec2 out_uv;
+layout (location = 1) out vec4 out_color;
+
+void main()
+{
+    vec4 clip_rect = clip_rects[gl_BaseInstance];
+
+    gl_ClipDistance[0] = in_pos.x - clip_rect.x;
+    gl_ClipDistance[1] = in_pos.y - clip_rect.y;
+    gl_ClipDistance[2] = clip_rect.z - in_pos.x;
+    gl_ClipDistance[3] = clip_rect.w - in_pos.y;
+
+    out_uv      = in_uv;
+    out_color   = in_color;
+    gl_Position = u_projection * vec4(in_pos, 0.0, 1.0);
+}
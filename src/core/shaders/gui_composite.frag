@@ -0,0 +1,12 @@
+#version 460 core
+
+// The cached GUI over the frame, its colors are premultiplied by the alpha.
+
+layout (binding = 0) uniform sampler2D u_gui;
+
+out vec4 frag_color;
+
+void main()
+{
+    frag_color = texelFetch(u_gui, ivec2(gl_FragCoord.xy), 0);
+}
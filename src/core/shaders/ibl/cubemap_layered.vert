@@ -0,0 +1,16 @@
+#version 460 core
+#extension GL_ARB_shader_viewport_layer_array : require
+
+layout (location = 0) in vec3 in_pos;
+
+layout (location = 0) out vec3 out_world_pos;
+
+// An instance per face, all six faces of the layered framebuffer in one draw.
+uniform mat4 u_view_projections[6];
+
+void main()
+{
+	out_world_pos = in_pos;
+	gl_Position   = u_view_projections[gl_InstanceID] * vec4(in_pos, 1.0);
+	gl_Layer      = gl_InstanceID;
+}
@@ -0,0 +1,19 @@
+#version 460 core
+layout (location = 0) out vec4 out_albedo;
+layout (location = 1) out vec4 out_normal;
+
+in vec2 texcoord;
+in vec3 normal;
+
+/* The albedo of StaticModel's material, MATERIAL_TEXTURE_ALBEDO. */
+layout(binding = 0) uniform sampler2D texture_diffuse1;
+
+void main()
+{
+    vec4 albedo = texture(texture_diffuse1, texcoord);
+    vec3 n      = normalize(gl_FrontFacing ? normal : -normal);
+
+    /* The alpha goes to both, so the normals' mips fade out with the coverage. */
+    out_albedo = albedo;
+    out_normal = vec4(n * 0.5 + 0.5, albedo.a);
+}
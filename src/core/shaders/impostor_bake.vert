@@ -0,0 +1,17 @@
+#version 460 core
+layout (location = 0) in vec3 in_pos;
+layout (location = 1) in vec2 in_texcoord;
+layout (location = 2) in vec3 in_normal;
+
+uniform mat4 view_projection;
+
+out vec2 texcoord;
+out vec3 normal;
+
+void main()
+{
+    texcoord = in_texcoord;
+    normal   = in_normal;
+
+    gl_Position = view_projection * vec4(in_pos, 1.0);
+}
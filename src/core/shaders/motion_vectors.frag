@@ -0,0 +1,16 @@
+#version 460 core
+
+// The screen space motion of the surface since the previous frame, in UV units - the history is at uv - motion.
+
+layout (location = 0) in vec4 in_current_clip_pos;
+layout (location = 1) in vec4 in_previous_clip_pos;
+
+layout (location = 0) out vec2 out_motion;
+
+void main()
+{
+    vec2 current_ndc  = in_current_clip_pos.xy  / in_current_clip_pos.w;
+    vec2 previous_ndc = in_previous_clip_pos.xy / in_previous_clip_pos.w;
+
+    out_motion = (current_ndc - previous_ndc) * 0.5;
+}
@@ -0,0 +1,20 @@
+#version 460 core
+
+// The depth pre-pass of TemporalAA, with the clip positions of the vertex in this frame and in the previous one.
+
+layout (location = 0) in vec3 in_pos;
+
+uniform mat4 u_mvp;           // Jittered, the same as the scene's draws.
+uniform mat4 u_current_mvp;
+uniform mat4 u_previous_mvp;
+
+layout (location = 0) out vec4 out_current_clip_pos;
+layout (location = 1) out vec4 out_previous_clip_pos;
+
+void main()
+{
+    out_current_clip_pos  = u_current_mvp  * vec4(in_pos, 1.0);
+    out_previous_clip_pos = u_previous_mvp * vec4(in_pos, 1.0);
+
+    gl_Position = u_mvp * vec4(in_pos, 1.0);
+}
@@ -0,0 +1,7 @@
+#version 460 core
+
+// Only the samples that pass the depth test are counted, nothing is written.
+
+void main()
+{
+}
@@ -0,0 +1,14 @@
+#version 460 core
+
+// The bounding box of StaticModel::RenderOcclusionQuery() - a 14 vertex triangle strip cube, no vertex buffer.
+
+uniform mat4 u_mvp;
+uniform vec3 u_bounds_min;
+uniform vec3 u_bounds_max;
+
+void main()
+{
+    uvec3 corner = (uvec3(0x287a, 0x02af, 0x31e3) >> gl_VertexID) & 1u;
+
+    gl_Position = u_mvp * vec4(mix(u_bounds_min, u_bounds_max, vec3(corner)), 1.0);
+}
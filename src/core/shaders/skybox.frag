@@ -0,0 +1,13 @@
+#version 460 core
+
+layout (location = 0) in vec3 in_direction;
+
+layout (binding = 0) uniform samplerCube u_cubemap;
+uniform float u_lod_level;
+
+out vec4 frag_color;
+
+void main()
+{
+    frag_color = vec4(textureLod(u_cubemap, in_direction, u_lod_level).rgb, 1.0);
+}
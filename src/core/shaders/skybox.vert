@@ -0,0 +1,18 @@
+#version 460 core
+
+// A triangle covering the screen at the far plane, see Skybox.
+
+uniform mat4 u_inverse_view_projection;
+
+layout (location = 0) out vec3 out_direction;
+
+void main()
+{
+    vec2 ndc = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+
+    // The view has no translation, so the point on the far plane is the direction.
+    vec4 world_pos = u_inverse_view_projection * vec4(ndc, 1.0, 1.0);
+    out_direction  = world_pos.xyz / world_pos.w;
+
+    gl_Position = vec4(ndc, 1.0, 1.0);
+}
@@ -0,0 +1,21 @@
+#version 460 core
+
+// The scene with the half resolution reflections upsampled bilinearly over its reflective pixels - the normals' w.
+
+layout(binding = 0) uniform sampler2D u_color;
+layout(binding = 1) uniform sampler2D u_normals;
+layout(binding = 2) uniform sampler2D u_reflections;
+
+in vec2 uv;
+
+out vec4 frag_color;
+
+void main()
+{
+    ivec2 texel        = ivec2(gl_FragCoord.xy);
+    vec4  color        = texelFetch(u_color, texel, 0);
+    vec4  reflection   = texture(u_reflections, uv);
+    float reflectivity = texelFetch(u_normals, texel, 0).a;
+
+    frag_color = vec4(mix(color.rgb, reflection.rgb, reflection.a * reflectivity), color.a);
+}
@@ -0,0 +1,82 @@
+#include "skybox.h"
+
+#include <cstdio>
+
+#include "gl_state.h"
+#include "image_based_lighting.h"
+#include "shader.h"
+
+namespace RGL
+{
+    Skybox::~Skybox()
+    {
+        if (m_dummy_vao_name != 0)
+        {
+            glDeleteVertexArrays(1, &m_dummy_vao_name);
+            GLState::OnVertexArrayDeleted(m_dummy_vao_name);
+        }
+    }
+
+    bool Skybox::Create()
+    {
+        m_shader = std::make_shared<Shader>("src/core/shaders/skybox.vert", "src/core/shaders/skybox.frag");
+
+        if (!m_shader->link())
+        {
+            fprintf(stderr, "Skybox: the shader failed to link.\n");
+            return false;
+        }
+
+        if (m_dummy_vao_name == 0)
+        {
+            glCreateVertexArrays(1, &m_dummy_vao_name);
+        }
+
+        return true;
+    }
+
+    void Skybox::Render(GLuint cubemap_name, const glm::mat4& projection, const glm::mat4& view, float lod_level)
+    {
+        GLint depth_func = GL_LESS;
+        glGetIntegerv(GL_DEPTH_FUNC, &depth_func);
+
+        GLboolean is_depth_mask_enabled = GL_TRUE;
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &is_depth_mask_enabled);
+
+        const bool is_depth_test_enabled = glIsEnabled(GL_DEPTH_TEST);
+
+        /* Straight to GL, the demos change these without GLState too. */
+        glEnable   (GL_DEPTH_TEST);
+        glDepthFunc(GL_LEQUAL);
+        glDepthMask(GL_FALSE);
+
+        /* The rotation alone, the sky is infinitely far away. */
+        m_shader->bind();
+        m_shader->setUniform("u_inverse_view_projection", glm::inverse(projection * glm::mat4(glm::mat3(view))));
+        m_shader->setUniform("u_lod_level",               lod_level);
+
+        GLState::BindTextureUnit(0, cubemap_name);
+        GLState::BindVertexArray(m_dummy_vao_name);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        if (!is_depth_test_enabled)
+        {
+            glDisable(GL_DEPTH_TEST);
+        }
+
+        glDepthFunc(GLenum(depth_func));
+        glDepthMask(is_depth_mask_enabled);
+    }
+
+    void Skybox::Render(const ImageBasedLighting& ibl, const glm::mat4& projection, const glm::mat4& view, float blur)
+    {
+        if (blur <= 0.0f)
+        {
+            Render(ibl.GetEnvironmentMap(), projection, view);
+            return;
+        }
+
+        /* The levels of the prefiltered map are spaced linearly in the roughness. */
+        Render(ibl.GetPrefilteredMap(), projection, view, glm::min(blur, 1.0f) * float(ibl.GetPrefilteredLevelsCount() - 1));
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+namespace RGL
+{
+    class ImageBasedLighting;
+    class Shader;
+
+    /*
+     * The background: a triangle covering the screen at the far plane (shaders/skybox.vert) samples a cubemap in the
+     * directions of its pixels. It's meant to be drawn after the opaque geometry - the depth test against the far plane
+     * leaves only the pixels nothing was drawn to, so the sky isn't shaded under the scene. Render thread only.
+     *
+     *     skybox.Create();
+     *     ... the opaque geometry ...
+     *     skybox.Render(ibl, projection, view, blur);
+     */
+    class Skybox final
+    {
+    public:
+        Skybox() = default;
+        ~Skybox();
+
+        Skybox           (const Skybox&) = delete;
+        Skybox& operator=(const Skybox&) = delete;
+
+        bool Create();
+
+        /*
+         * Binds the cubemap to the unit 0. The depth test is enabled with GL_LEQUAL and the depth writes are disabled
+         * for the draw, the previous state is restored after it.
+         */
+        void Render(GLuint cubemap_name, const glm::mat4& projection, const glm::mat4& view, float lod_level = 0.0f);
+
+        /*
+         * The environment map of the IBL when blur is 0, otherwise the prefiltered map at the level of the roughness
+         * blur (0, 1] - it's already convolved and a fraction of the environment map's resolution.
+         */
+        void Render(const ImageBasedLighting& ibl, const glm::mat4& projection, const glm::mat4& view, float blur = 0.0f);
+
+    private:
+        std::shared_ptr<Shader> m_shader;
+        GLuint                  m_dummy_vao_name = 0;
+    };
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace RGL
+{
+    /*
+     * Bounded lock-free queue of a single producer and a single consumer thread. CAPACITY has to be a power of two.
+     * Push() fails when the queue is full, Pop() when it's empty - neither of them waits.
+     */
+    template<typename T, uint32_t CAPACITY>
+    class SpscQueue final
+    {
+        static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "SpscQueue: the capacity has to be a power of two.");
+
+    public:
+        SpscQueue() = default;
+
+        SpscQueue           (const SpscQueue&) = delete;
+        SpscQueue& operator=(const SpscQueue&) = delete;
+
+        /* Producer only. */
+        bool Push(const T& item)
+        {
+            const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+
+            if (tail - m_head.load(std::memory_order_acquire) == CAPACITY)
+            {
+                return false;
+            }
+
+            m_items[tail & (CAPACITY - 1)] = item;
+            m_tail.store(tail + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        /* Consumer only. */
+        bool Pop(T& item)
+        {
+            const uint32_t head = m_head.load(std::memory_order_relaxed);
+
+            if (head == m_tail.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+
+            item = m_items[head & (CAPACITY - 1)];
+            m_head.store(head + 1, std::memory_order_release);
+
+            return true;
+        }
+
+    private:
+        /* On separate cache lines, the producer and the consumer don't invalidate each other's index. */
+        alignas(64) std::atomic<uint32_t> m_head { 0 };
+        alignas(64) std::atomic<uint32_t> m_tail { 0 };
+        T m_items[CAPACITY];
+    };
+}
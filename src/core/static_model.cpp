@@ -1,19 +1,276 @@
 #include "static_model.h"
 
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/component_wise.hpp>
 
+#include <assimp/GltfMaterial.h>
 #include <assimp/postprocess.h>
 
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <numeric>
+#include <span>
+#include <unordered_map>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RGL_TANGENTS_SSE 1
+#include <emmintrin.h>
+#endif
+
+#include "asset_io_system.h"
+#include "filesystem.h"
+#include "geometry_pool.h"
+#include "gpu_culling.h"
+#include "gpu_memory.h"
+#include "job_system.h"
+#include "mapped_file.h"
+#include "mesh_optimizer.h"
+#include "texture_cache.h"
 #include "util.h"
 
 namespace RGL
 {
+    namespace
+    {
+        constexpr unsigned int IMPORT_FLAGS = aiProcess_Triangulate              | 
+                                              aiProcess_GenSmoothNormals         | 
+                                              aiProcess_GenUVCoords              |
+                                              aiProcess_CalcTangentSpace         |
+                                              aiProcess_FlipUVs                  |
+                                              aiProcess_JoinIdenticalVertices    | 
+                                              aiProcess_RemoveRedundantMaterials | 
+                                              aiProcess_GenBoundingBoxes;
+
+        /* Texture types loaded for every material. */
+        constexpr std::pair<aiTextureType, Material::TextureType> MATERIAL_TEXTURE_TYPES[] = 
+        {
+            { aiTextureType_BASE_COLOR,        Material::TextureType::ALBEDO    },
+            { aiTextureType_NORMALS,           Material::TextureType::NORMAL    },
+            { aiTextureType_EMISSIVE,          Material::TextureType::EMISSIVE  },
+            { aiTextureType_AMBIENT_OCCLUSION, Material::TextureType::AO        },
+            { aiTextureType_DIFFUSE_ROUGHNESS, Material::TextureType::ROUGHNESS },
+            { aiTextureType_METALNESS,         Material::TextureType::METALLIC  }
+        };
+
+        /* Normal maps are averaged as vectors, see MipmapGenerator. */
+        MipmapFilter GetMipmapFilter(Material::TextureType texture_type)
+        {
+            return texture_type == Material::TextureType::NORMAL ? MipmapFilter::NORMAL : MipmapFilter::COLOR;
+        }
+
+        /* The encoded image of an embedded texture (png, jpg, KTX2...) - or the raw texels, if mHeight > 0. */
+        std::span<const uint8_t> GetEmbeddedData(const aiTexture* ai_texture)
+        {
+            uint32_t data_size = ai_texture->mHeight > 0 ? ai_texture->mWidth * ai_texture->mHeight : ai_texture->mWidth;
+            return { reinterpret_cast<const uint8_t*>(ai_texture->pcData), data_size };
+        }
+
+        bool IsEmbeddedKtx2(const aiTexture* ai_texture)
+        {
+            const auto data = GetEmbeddedData(ai_texture);
+            return ai_texture->mHeight == 0 && Texture2D::IsKtx2(data.data(), data.size());
+        }
+
+        /*
+         * The importer's copy of the image isn't needed once the texture is created, a GLB's images would otherwise stay
+         * in the memory until the whole model is loaded. The scene stays valid, with an empty texture.
+         */
+        void ReleaseEmbeddedData(const aiTexture* ai_texture)
+        {
+            auto texture = const_cast<aiTexture*>(ai_texture);
+
+            delete[] texture->pcData;
+            texture->pcData  = nullptr;
+            texture->mWidth  = 0;
+            texture->mHeight = 0;
+        }
+
+        /* Referenced by the MeshDrawData of the mesh parts without a material. */
+        const Material& GetDefaultMaterial()
+        {
+            static Material material;
+            return material;
+        }
+
+        /* Mesh cache file format. Bump the version whenever the layout or IMPORT_FLAGS change. */
+        constexpr uint32_t MESH_CACHE_MAGIC   = 0x4D4C4752; // "RGLM"
+        constexpr uint32_t MESH_CACHE_VERSION = 5;
+
+        /* Simplification target for the next LOD and the maximum surface deviation relative to the mesh part's bounding radius. */
+        constexpr float LOD_REDUCTION_RATIO = 0.5f;
+        constexpr float LOD_MAX_ERROR       = 0.05f;
+
+        /* Meshlet limits - 124 triangles keep the local indices of a meshlet within 372 bytes, as in the NV_mesh_shader guidelines. */
+        constexpr uint32_t MESHLET_MAX_VERTICES  = 64;
+        constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+        /* Never equal to a pool generation, forces the rebase before the first draw. */
+        constexpr uint32_t INVALID_POOL_GENERATION = 0xFFFFFFFF;
+
+        /*
+         * Smaller meshes compute the tangents serially, the larger ones accumulate them in per-job buffers, reduced afterwards.
+         * The number of the buffers is limited - every one of them has a tangent per vertex.
+         */
+        constexpr uint32_t PARALLEL_TANGENTS_MIN_VERTICES = 1 << 16;
+        constexpr uint32_t MAX_TANGENT_BUFFERS            = 8;
+
+        /* Accumulates the tangents of the triangles [first_triangle, last_triangle) into xyz of the vec4 tangents. */
+        void AccumulateTangents(const VertexData& vertex_data, size_t first_triangle, size_t last_triangle, glm::vec4* tangents)
+        {
+            for (size_t t = first_triangle; t < last_triangle; ++t)
+            {
+                auto i0 = vertex_data.indices[t * 3];
+                auto i1 = vertex_data.indices[t * 3 + 1];
+                auto i2 = vertex_data.indices[t * 3 + 2];
+
+                auto delta_uv1 = vertex_data.texcoords[i1] - vertex_data.texcoords[i0];
+                auto delta_uv2 = vertex_data.texcoords[i2] - vertex_data.texcoords[i0];
+
+                float dividend = (delta_uv1.x * delta_uv2.y - delta_uv2.x * delta_uv1.y);
+                float f = dividend == 0.0f ? 0.0f : 1.0f / dividend;
+
+#ifdef RGL_TANGENTS_SSE
+                const glm::vec3& p0 = vertex_data.positions[i0];
+                const glm::vec3& p1 = vertex_data.positions[i1];
+                const glm::vec3& p2 = vertex_data.positions[i2];
+
+                __m128 v0    = _mm_setr_ps(p0.x, p0.y, p0.z, 0.0f);
+                __m128 edge1 = _mm_sub_ps(_mm_setr_ps(p1.x, p1.y, p1.z, 0.0f), v0);
+                __m128 edge2 = _mm_sub_ps(_mm_setr_ps(p2.x, p2.y, p2.z, 0.0f), v0);
+
+                /* f * (delta_uv2.y * edge1 - delta_uv1.y * edge2), the w component stays 0. */
+                __m128 tangent = _mm_mul_ps(_mm_set1_ps(f), _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(delta_uv2.y), edge1),
+                                                                       _mm_mul_ps(_mm_set1_ps(delta_uv1.y), edge2)));
+
+                float* t0 = &tangents[i0].x;
+                float* t1 = &tangents[i1].x;
+                float* t2 = &tangents[i2].x;
+
+                _mm_storeu_ps(t0, _mm_add_ps(_mm_loadu_ps(t0), tangent));
+                _mm_storeu_ps(t1, _mm_add_ps(_mm_loadu_ps(t1), tangent));
+                _mm_storeu_ps(t2, _mm_add_ps(_mm_loadu_ps(t2), tangent));
+#else
+                auto edge1 = vertex_data.positions[i1] - vertex_data.positions[i0];
+                auto edge2 = vertex_data.positions[i2] - vertex_data.positions[i0];
+
+                glm::vec4 tangent(f * (delta_uv2.y * edge1 - delta_uv1.y * edge2), 0.0f);
+
+                tangents[i0] += tangent;
+                tangents[i1] += tangent;
+                tangents[i2] += tangent;
+#endif
+            }
+        }
+
+        struct MeshCacheHeader
+        {
+            uint32_t m_magic;
+            uint32_t m_version;
+            uint32_t m_import_flags;
+            uint32_t m_options;
+            uint64_t m_source_size;
+            int64_t  m_source_time;
+        };
+
+        template<typename T> void WritePod(std::ostream& out, const T& value)
+        {
+            out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        /* Sequential reads from the mapped cache file, a read past the end fails. */
+        struct CacheReader
+        {
+            const uint8_t* m_data;
+            size_t         m_size;
+            size_t         m_offset;
+
+            bool Read(void* value, size_t size)
+            {
+                if (size > m_size - m_offset)
+                {
+                    return false;
+                }
+
+                std::memcpy(value, m_data + m_offset, size);
+                m_offset += size;
+
+                return true;
+            }
+        };
+
+        template<typename T> bool ReadPod(CacheReader& in, T& value)
+        {
+            return in.Read(&value, sizeof(T));
+        }
+
+        template<typename T> void WriteVector(std::ostream& out, const std::vector<T>& values)
+        {
+            WritePod(out, uint64_t(values.size()));
+            out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+        }
+
+        template<typename T> bool ReadVector(CacheReader& in, std::vector<T>& values)
+        {
+            uint64_t count;
+            if (!ReadPod(in, count) || count > (in.m_size - in.m_offset) / sizeof(T)) return false;
+
+            values.resize(count);
+            return in.Read(values.data(), count * sizeof(T));
+        }
+
+        void WriteString(std::ostream& out, const std::string& str)
+        {
+            WritePod(out, uint32_t(str.size()));
+            out.write(str.data(), str.size());
+        }
+
+        bool ReadString(CacheReader& in, std::string& str)
+        {
+            uint32_t size;
+            if (!ReadPod(in, size)) return false;
+
+            str.resize(size);
+            return in.Read(str.data(), size);
+        }
+
+        /* Options are the load settings that change the cached data, so e.g. the optimized and the original meshes don't share the cache. */
+        bool GetSourceInfo(const std::filesystem::path& filepath, uint32_t options, MeshCacheHeader& header)
+        {
+            uintmax_t                       size;
+            std::filesystem::file_time_type write_time;
+
+            /* From the pak if the model is in one, its entry keeps the source file's time. */
+            if (!FileSystem::getFileInfo(filepath, size, write_time))
+            {
+                return false;
+            }
+
+            header.m_magic        = MESH_CACHE_MAGIC;
+            header.m_version      = MESH_CACHE_VERSION;
+            header.m_import_flags = IMPORT_FLAGS;
+            header.m_options      = options;
+            header.m_source_size  = size;
+            header.m_source_time  = write_time.time_since_epoch().count();
+
+            return true;
+        }
+    }
+
     void StaticModel::Render(uint32_t num_instances)
     {
-        glBindVertexArray(m_vao_name);
+        UpdatePooledGeometry();
+
+        GLState::BindVertexArray(m_vao_name);
+        BeginConditionalRender();
+        BeginPrimitiveRestart();
 
         for (unsigned int i = 0; i < m_mesh_parts.size(); i++)
         {
@@ -23,37 +280,45 @@ namespace RGL
 
                 assert(material_index < m_materials.size());
 
-                for (auto const& [texture_type, texture] : m_materials[material_index]->m_texture_map)
-                {
-                    texture->Bind(uint32_t(texture_type));
-                }
+                m_materials[material_index]->Bind();
             }
 
             if (num_instances == 0)
             {
                 glDrawElementsBaseVertex(GLenum(m_draw_mode),
-                                         m_mesh_parts[i].m_indices_count,
-                                         GL_UNSIGNED_INT,
-                                         (void*)(sizeof(unsigned int) * m_mesh_parts[i].m_base_index),
+                                         m_mesh_parts[i].GetLodIndicesCount(),
+                                         m_index_type,
+                                         (void*)(GetIndexSize() * m_mesh_parts[i].GetLodBaseIndex()),
                                          m_mesh_parts[i].m_base_vertex);
             }
             else
             {
                 glDrawElementsInstancedBaseVertex(GLenum(m_draw_mode),
-                                                  m_mesh_parts[i].m_indices_count,
-                                                  GL_UNSIGNED_INT,
-                                                  (void*)(sizeof(unsigned int) * m_mesh_parts[i].m_base_index),
+                                                  m_mesh_parts[i].GetLodIndicesCount(),
+                                                  m_index_type,
+                                                  (void*)(GetIndexSize() * m_mesh_parts[i].GetLodBaseIndex()),
                                                   num_instances,
                                                   m_mesh_parts[i].m_base_vertex);
             }
         }
 
-        glBindTextureUnit(0, 0);
+        EndPrimitiveRestart();
+        EndConditionalRender();
+        GLState::BindTextureUnit(0, 0);
     }
 
     void StaticModel::Render(std::shared_ptr<Shader>& shader, uint32_t num_instances)
     {
-        glBindVertexArray(m_vao_name);
+        UpdatePooledGeometry();
+
+        GLState::BindVertexArray(m_vao_name);
+        BeginConditionalRender();
+        BeginPrimitiveRestart();
+
+        if (!m_materials.empty())
+        {
+            Material::BindMaterials();
+        }
     
         for (unsigned int i = 0 ; i < m_mesh_parts.size() ; i++) 
         {
@@ -63,385 +328,2292 @@ namespace RGL
 
                 assert(material_index < m_materials.size());
 
-                for (auto const& [texture_type, texture] : m_materials[material_index]->m_texture_map)
-                {
-                    texture->Bind(uint32_t(texture_type));
-                }
-
-                // Set uniforms based on the data in the material
-                for (auto& [uniform_name, value] : m_materials[material_index]->m_bool_map)
-                {
-                    shader->setUniform(uniform_name, value);
-                }
-
-                for (auto& [uniform_name, value] : m_materials[material_index]->m_float_map)
-                {
-                    shader->setUniform(uniform_name, value);
-                }
-
-                for (auto& [uniform_name, value] : m_materials[material_index]->m_vec3_map)
-                {
-                    shader->setUniform(uniform_name, value);
-                }
+                m_materials[material_index]->Bind();
+                m_materials[material_index]->SetUniforms(*shader);
             }
 
             if(num_instances == 0 )
             {
                 glDrawElementsBaseVertex(GLenum(m_draw_mode), 
-                                         m_mesh_parts[i].m_indices_count,
-                                         GL_UNSIGNED_INT,
-                                         (void*)(sizeof(unsigned int) * m_mesh_parts[i].m_base_index),
+                                         m_mesh_parts[i].GetLodIndicesCount(),
+                                         m_index_type,
+                                         (void*)(GetIndexSize() * m_mesh_parts[i].GetLodBaseIndex()),
                                          m_mesh_parts[i].m_base_vertex);
             }
             else
             {
                 glDrawElementsInstancedBaseVertex(GLenum(m_draw_mode),
-                                                  m_mesh_parts[i].m_indices_count,
-                                                  GL_UNSIGNED_INT,
-                                                  (void*)(sizeof(unsigned int) * m_mesh_parts[i].m_base_index),
+                                                  m_mesh_parts[i].GetLodIndicesCount(),
+                                                  m_index_type,
+                                                  (void*)(GetIndexSize() * m_mesh_parts[i].GetLodBaseIndex()),
                                                   num_instances,
                                                   m_mesh_parts[i].m_base_vertex);
             }
         }
 
-        glBindTextureUnit(0, 0);
+        EndPrimitiveRestart();
+        EndConditionalRender();
+        GLState::BindTextureUnit(0, 0);
     }
 
-    bool StaticModel::Load(const std::filesystem::path& filepath)
+    void StaticModel::RenderMeshPart(uint32_t mesh_part_index, Shader* shader, bool bind_vertex_array, bool bind_material, uint32_t num_instances)
     {
-        /* Release the previously loaded mesh if it was loaded. */
-        if(m_vao_name)
+        UpdatePooledGeometry();
+
+        if (bind_vertex_array)
         {
-            Release();
+            GLState::BindVertexArray(m_vao_name);
         }
 
-        /* Load model */
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(filepath.generic_string(), aiProcess_Triangulate              | 
-                                                                            aiProcess_GenSmoothNormals         | 
-                                                                            aiProcess_GenUVCoords              |
-                                                                            aiProcess_CalcTangentSpace         |
-                                                                            aiProcess_FlipUVs                  |
-                                                                            aiProcess_JoinIdenticalVertices    | 
-                                                                            aiProcess_RemoveRedundantMaterials | 
-                                                                            aiProcess_GenBoundingBoxes );
+        const MeshPart& mesh_part = m_mesh_parts[mesh_part_index];
 
-        if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+        if (bind_material)
         {
-            fprintf(stderr, "Assimp error while loading mesh %s\n Error: %s\n", filepath.generic_string(), importer.GetErrorString());
-            return false;
+            BindMaterial(mesh_part.m_material_index, shader);
         }
 
-        return ParseScene(scene, filepath);
+        BeginPrimitiveRestart();
+
+        if (num_instances == 0)
+        {
+            glDrawElementsBaseVertex(GLenum(m_draw_mode),
+                                     mesh_part.GetLodIndicesCount(),
+                                     m_index_type,
+                                     (void*)(GetIndexSize() * mesh_part.GetLodBaseIndex()),
+                                     mesh_part.m_base_vertex);
+        }
+        else
+        {
+            glDrawElementsInstancedBaseVertex(GLenum(m_draw_mode),
+                                              mesh_part.GetLodIndicesCount(),
+                                              m_index_type,
+                                              (void*)(GetIndexSize() * mesh_part.GetLodBaseIndex()),
+                                              num_instances,
+                                              mesh_part.m_base_vertex);
+        }
+
+        EndPrimitiveRestart();
     }
 
-    bool StaticModel::ParseScene(const aiScene* scene, const std::filesystem::path& filepath)
+    void StaticModel::RenderDepth(uint32_t num_instances)
     {
-        m_mesh_parts.resize(scene->mNumMeshes);
-        m_materials.resize(scene->mNumMaterials);
+        UpdatePooledGeometry();
 
-        for (uint32_t i = 0; i < m_materials.size(); ++i)
+        GLState::BindVertexArray(GetDepthVertexArray());
+
+        for (uint32_t i = 0; i < m_mesh_parts.size(); ++i)
         {
-            m_materials[i] = std::make_shared<Material>();
+            RenderMeshPart(i, nullptr, false /* bind_vertex_array */, false /* bind_material */, num_instances);
         }
+    }
 
-        VertexData vertex_data;
+    void StaticModel::RenderDepthIndirect(std::shared_ptr<Shader>& depth_shader, std::shared_ptr<Shader>& alpha_masked_shader, uint32_t num_instances)
+    {
+        UpdatePooledGeometry();
 
-        uint32_t vertices_count = 0;
-        uint32_t indices_count  = 0;
+        if (m_is_indirect_dirty)
+        {
+            CreateIndirectBuffers();
+        }
 
-        /* Count the number of vertices and indices. */
-        for (uint32_t i = 0; i < m_mesh_parts.size(); ++i)
+        UpdateIndirectInstancesCount(num_instances);
+        UpdateIndirectLods();
+
+        glBindBuffer    (GL_DRAW_INDIRECT_BUFFER, m_indirect_buffer_name);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_DRAW_DATA_SSBO_BINDING_INDEX, m_draw_data_ssbo_name);
+
+        BeginPrimitiveRestart();
+
+        /* The opaque batches first, they don't switch the VAO nor the shader. */
+        for (bool is_alpha_masked : { false, true })
         {
-            m_mesh_parts[i].m_material_index = scene->mNumMaterials > 0 ? scene->mMeshes[i]->mMaterialIndex : INVALID_MATERIAL;
-            m_mesh_parts[i].m_indices_count  = scene->mMeshes[i]->mNumFaces * 3;
-            m_mesh_parts[i].m_base_vertex    = vertices_count;
-            m_mesh_parts[i].m_base_index     = indices_count;
+            Shader* shader = is_alpha_masked ? alpha_masked_shader.get() : depth_shader.get();
+            bool    is_first = true;
 
-            vertices_count += scene->mMeshes[i]->mNumVertices;
-            indices_count  += m_mesh_parts[i].m_indices_count;
+            for (auto& batch : m_indirect_batches)
+            {
+                const bool is_batch_alpha_masked = batch.m_material_index != INVALID_MATERIAL && m_materials[batch.m_material_index]->IsAlphaMasked();
+
+                if (is_batch_alpha_masked != is_alpha_masked)
+                {
+                    continue;
+                }
+
+                if (is_first)
+                {
+                    shader->bind();
+                    GLState::BindVertexArray(is_alpha_masked ? m_vao_name : GetDepthVertexArray());
+                    is_first = false;
+                }
+
+                if (is_alpha_masked)
+                {
+                    BindMaterial(batch.m_material_index, shader);
+                }
+
+                shader->setUniform("u_draw_id_offset", batch.m_first_command);
+
+                glMultiDrawElementsIndirect(GLenum(m_draw_mode),
+                                            m_index_type,
+                                            (void*)(sizeof(DrawElementsIndirectCommand) * batch.m_first_command),
+                                            batch.m_commands_count,
+                                            0 /* stride */);
+            }
         }
 
-        /* Reserve space in the vectors for the vertex attributes and indices. */
-        vertex_data.positions.reserve(vertices_count);
-        vertex_data.texcoords.reserve(vertices_count);
-        vertex_data.normals.reserve(vertices_count);
-        vertex_data.tangents.reserve(vertices_count);
-        vertex_data.indices.reserve(indices_count);
+        EndPrimitiveRestart();
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        GLState::BindTextureUnit(0, 0);
+    }
 
-        /* Load mesh parts one by one. */
-        glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
-        glm::vec3 max = -min;
+    const Material* StaticModel::GetMeshPartMaterial(uint32_t mesh_part_index) const
+    {
+        uint32_t material_index = m_mesh_parts[mesh_part_index].m_material_index;
 
-        for (uint32_t i = 0; i < m_mesh_parts.size(); ++i)
+        return material_index < m_materials.size() ? m_materials[material_index].get() : nullptr;
+    }
+
+    glm::vec4 StaticModel::GetMeshPartBounds(uint32_t mesh_part_index) const
+    {
+        const MeshPart& mesh_part = m_mesh_parts[mesh_part_index];
+
+        return glm::vec4(mesh_part.m_bounds_center, mesh_part.m_bounds_radius);
+    }
+
+    void StaticModel::RenderOcclusionQuery(const glm::mat4& model, const glm::mat4& view_projection, const glm::vec3& camera_position)
+    {
+        if (!m_is_conditional_rendering || m_mesh_parts.empty() || !IsReady())
         {
-            auto mesh = scene->mMeshes[i];
-            LoadMeshPart(mesh, vertex_data);
+            return;
+        }
+
+        /* The box of the mesh parts' bounding spheres, in the object space. */
+        glm::vec3 bounds_min(FLT_MAX);
+        glm::vec3 bounds_max(-FLT_MAX);
+
+        for (const auto& mesh_part : m_mesh_parts)
+        {
+            bounds_min = glm::min(bounds_min, mesh_part.m_bounds_center - mesh_part.m_bounds_radius);
+            bounds_max = glm::max(bounds_max, mesh_part.m_bounds_center + mesh_part.m_bounds_radius);
+        }
+
+        /* From the inside the box's faces can be behind the visible geometry, the model is drawn unconditionally then. */
+        const glm::vec3 camera_object_space = glm::vec3(glm::inverse(model) * glm::vec4(camera_position, 1.0f));
+
+        if (glm::all(glm::greaterThanEqual(camera_object_space, bounds_min)) && glm::all(glm::lessThanEqual(camera_object_space, bounds_max)))
+        {
+            m_is_occlusion_query_valid = false;
+            return;
+        }
+
+        if (!m_occlusion_box_shader)
+        {
+            m_occlusion_box_shader = std::make_shared<Shader>("src/core/shaders/occlusion_box.vert", "src/core/shaders/occlusion_box.frag");
+            m_occlusion_box_shader->link();
+        }
+
+        if (!m_occlusion_query_name)
+        {
+            glCreateQueries(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, 1, &m_occlusion_query_name);
+        }
+
+        GLboolean color_mask[4];
+        GLboolean depth_mask;
+        GLint     depth_func;
+
+        glGetBooleanv(GL_COLOR_WRITEMASK, color_mask);
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &depth_mask);
+        glGetIntegerv(GL_DEPTH_FUNC,      &depth_func);
+
+        const bool is_cull_face = glIsEnabled(GL_CULL_FACE);
+
+        /* Straight to GL, the demos change these without GLState too. Both sides of the box, the faces cut by the near plane are clamped to it. */
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        glDepthFunc(GL_LEQUAL);
+        glDisable  (GL_CULL_FACE);
+        glEnable   (GL_DEPTH_CLAMP);
+
+        m_occlusion_box_shader->bind();
+        m_occlusion_box_shader->setUniform("u_mvp",        view_projection * model);
+        m_occlusion_box_shader->setUniform("u_bounds_min", bounds_min);
+        m_occlusion_box_shader->setUniform("u_bounds_max", bounds_max);
+
+        /* The vertices come from gl_VertexID, any VAO will do. */
+        GLState::BindVertexArray(m_vao_name);
+
+        glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, m_occlusion_query_name);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 14);
+        glEndQuery  (GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+
+        glDisable(GL_DEPTH_CLAMP);
+
+        if (is_cull_face)
+        {
+            glEnable(GL_CULL_FACE);
+        }
+
+        glDepthFunc(GLenum(depth_func));
+        glDepthMask(depth_mask);
+        glColorMask(color_mask[0], color_mask[1], color_mask[2], color_mask[3]);
+
+        m_is_occlusion_query_valid = true;
+    }
+
+    void StaticModel::BeginConditionalRender() const
+    {
+        if (m_is_conditional_rendering && m_is_occlusion_query_valid)
+        {
+            glBeginConditionalRender(m_occlusion_query_name, GL_QUERY_NO_WAIT);
+        }
+    }
+
+    void StaticModel::EndConditionalRender() const
+    {
+        if (m_is_conditional_rendering && m_is_occlusion_query_valid)
+        {
+            glEndConditionalRender();
+        }
+    }
+
+    void StaticModel::BeginPrimitiveRestart() const
+    {
+        if (m_has_primitive_restart)
+        {
+            GLState::SetCapability(GL_PRIMITIVE_RESTART_FIXED_INDEX, true);
+        }
+    }
+
+    void StaticModel::EndPrimitiveRestart() const
+    {
+        if (m_has_primitive_restart)
+        {
+            GLState::SetCapability(GL_PRIMITIVE_RESTART_FIXED_INDEX, false);
+        }
+    }
+
+    void StaticModel::RenderIndirect(uint32_t num_instances)
+    {
+        UpdatePooledGeometry();
+
+        if (m_is_indirect_dirty)
+        {
+            CreateIndirectBuffers();
+        }
+
+        UpdateIndirectInstancesCount(num_instances);
+        UpdateIndirectLods();
+
+        BeginConditionalRender();
+        DrawIndirectBatches(m_indirect_buffer_name, nullptr);
+        EndConditionalRender();
+    }
+
+    void StaticModel::RenderIndirect(std::shared_ptr<Shader>& shader, uint32_t num_instances)
+    {
+        UpdatePooledGeometry();
+
+        if (m_is_indirect_dirty)
+        {
+            CreateIndirectBuffers();
+        }
+
+        UpdateIndirectInstancesCount(num_instances);
+        UpdateIndirectLods();
+
+        BeginConditionalRender();
+        DrawIndirectBatches(m_indirect_buffer_name, shader.get());
+        EndConditionalRender();
+    }
+
+    void StaticModel::RenderIndirect(const GpuCulling& culling)
+    {
+        culling.Bind();
+        BeginConditionalRender();
+        DrawIndirectBatches(culling.GetIndirectBuffer(), nullptr);
+        EndConditionalRender();
+    }
+
+    void StaticModel::RenderIndirect(std::shared_ptr<Shader>& shader, const GpuCulling& culling)
+    {
+        culling.Bind();
+        BeginConditionalRender();
+        DrawIndirectBatches(culling.GetIndirectBuffer(), shader.get());
+        EndConditionalRender();
+    }
+
+    void StaticModel::DrawIndirectBatches(GLuint indirect_buffer_name, Shader* shader)
+    {
+        GLState::BindVertexArray(m_vao_name);
+        glBindBuffer     (GL_DRAW_INDIRECT_BUFFER, indirect_buffer_name);
+        glBindBufferBase (GL_SHADER_STORAGE_BUFFER, MESH_DRAW_DATA_SSBO_BINDING_INDEX, m_draw_data_ssbo_name);
+        Material::BindMaterials();
+        BeginPrimitiveRestart();
+
+        /* Without a shader, the offset goes to the program the caller has bound. */
+        GLint program_id              = 0;
+        GLint draw_id_offset_location = -1;
+
+        if (!shader)
+        {
+            glGetIntegerv(GL_CURRENT_PROGRAM, &program_id);
+
+            if (program_id != 0)
+            {
+                draw_id_offset_location = glGetUniformLocation(GLuint(program_id), "u_draw_id_offset");
+            }
+        }
+
+        auto set_draw_id_offset = [&](uint32_t offset)
+        {
+            if (shader)
+            {
+                shader->setUniform("u_draw_id_offset", offset);
+            }
+            else if (draw_id_offset_location != -1)
+            {
+                glProgramUniform1ui(GLuint(program_id), draw_id_offset_location, offset);
+            }
+        };
+
+        if (m_is_bindless_enabled)
+        {
+            set_draw_id_offset(0);
+
+            glMultiDrawElementsIndirect(GLenum(m_draw_mode), m_index_type, nullptr, GLsizei(m_indirect_commands.size()), 0 /* stride */);
+            EndPrimitiveRestart();
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+            return;
+        }
+
+        for (auto& batch : m_indirect_batches)
+        {
+            BindMaterial(batch.m_material_index, shader);
+            set_draw_id_offset(batch.m_first_command);
+
+            glMultiDrawElementsIndirect(GLenum(m_draw_mode),
+                                        m_index_type,
+                                        (void*)(sizeof(DrawElementsIndirectCommand) * batch.m_first_command),
+                                        batch.m_commands_count,
+                                        0 /* stride */);
+        }
+
+        EndPrimitiveRestart();
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        GLState::BindTextureUnit(0, 0);
+    }
+
+    void StaticModel::BindMaterial(uint32_t material_index, Shader* shader)
+    {
+        if (material_index == INVALID_MATERIAL)
+        {
+            return;
+        }
+
+        const auto& material = m_materials[material_index];
+
+        material->Bind();
+
+        // Keep the uniform based shaders working - all the draws in a batch share the material
+        if (shader)
+        {
+            Material::BindMaterials();
+            material->SetUniforms(*shader);
+        }
+    }
+
+    const std::vector<DrawElementsIndirectCommand>& StaticModel::GetIndirectCommands()
+    {
+        UpdatePooledGeometry();
+
+        if (m_is_indirect_dirty)
+        {
+            CreateIndirectBuffers();
+        }
+
+        UpdateIndirectLods();
+
+        return m_indirect_commands;
+    }
+
+    void StaticModel::GetCullingObjects(const glm::mat4& model, uint32_t instance_id, std::vector<CullingObject>& objects)
+    {
+        if (m_is_indirect_dirty)
+        {
+            CreateIndirectBuffers();
+        }
+
+        const float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+        for (uint32_t i = 0; i < m_indirect_mesh_parts.size(); ++i)
+        {
+            const MeshPart& mesh_part = m_mesh_parts[m_indirect_mesh_parts[i]];
+
+            CullingObject object;
+            object.bounds        = glm::vec4(glm::vec3(model * glm::vec4(mesh_part.m_bounds_center, 1.0f)), mesh_part.m_bounds_radius * scale);
+            object.command_index = i;
+            object.instance_id   = instance_id;
+
+            objects.push_back(object);
+        }
+    }
+
+    void StaticModel::CreateIndirectBuffers()
+    {
+        UpdatePooledGeometry();
+
+        GpuMemory::UntrackBuffer(m_indirect_buffer_name);
+        glDeleteBuffers(1, &m_indirect_buffer_name);
+        m_indirect_buffer_name = 0;
+
+        GpuMemory::UntrackBuffer(m_draw_data_ssbo_name);
+        glDeleteBuffers(1, &m_draw_data_ssbo_name);
+        m_draw_data_ssbo_name = 0;
+
+        m_indirect_commands.clear();
+        m_indirect_batches.clear();
+        m_indirect_mesh_parts.clear();
+
+        m_is_indirect_dirty        = false;
+        m_is_indirect_lod_dirty    = false;
+        m_indirect_instances_count = 1;
+
+        if (m_mesh_parts.empty())
+        {
+            return;
+        }
+
+        /* Sort the mesh parts by the material, so the parts that share textures form a contiguous range of commands. */
+        std::vector<uint32_t> order(m_mesh_parts.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) 
+        { 
+            return m_mesh_parts[a].m_material_index < m_mesh_parts[b].m_material_index; 
+        });
+
+        std::vector<MeshDrawData> draw_data;
+        draw_data.reserve(m_mesh_parts.size());
+        m_indirect_commands.reserve(m_mesh_parts.size());
+
+        for (uint32_t i = 0; i < order.size(); ++i)
+        {
+            const MeshPart& mesh_part      = m_mesh_parts[order[i]];
+            uint32_t        material_index = mesh_part.m_material_index < m_materials.size() ? mesh_part.m_material_index : INVALID_MATERIAL;
+
+            DrawElementsIndirectCommand command;
+            command.m_count          = mesh_part.GetLodIndicesCount();
+            command.m_instance_count = 1;
+            command.m_first_index    = mesh_part.GetLodBaseIndex();
+            command.m_base_vertex    = int32_t(mesh_part.m_base_vertex);
+            command.m_base_instance  = 0;
+
+            m_indirect_commands.push_back(command);
+            m_indirect_mesh_parts.push_back(order[i]);
+
+            /* The mesh parts without a material use the default one. */
+            const Material& material = material_index != INVALID_MATERIAL ? *m_materials[material_index] : GetDefaultMaterial();
+
+            if (m_is_bindless_enabled && material_index != INVALID_MATERIAL)
+            {
+                m_materials[material_index]->MakeTexturesResident();
+            }
+
+            draw_data.push_back({ material.GetIndex() });
+
+            if (m_indirect_batches.empty() || m_indirect_batches.back().m_material_index != material_index)
+            {
+                m_indirect_batches.push_back({ material_index, i /* first command */, 0 /* commands count */ });
+            }
+
+            m_indirect_batches.back().m_commands_count++;
+        }
+
+        glCreateBuffers     (1, &m_indirect_buffer_name);
+        glNamedBufferStorage(m_indirect_buffer_name, sizeof(m_indirect_commands[0]) * m_indirect_commands.size(), m_indirect_commands.data(), GL_DYNAMIC_STORAGE_BIT);
+        GpuMemory::TrackBuffer(m_indirect_buffer_name, "StaticModel");
+
+        glCreateBuffers     (1, &m_draw_data_ssbo_name);
+        glNamedBufferStorage(m_draw_data_ssbo_name, sizeof(draw_data[0]) * draw_data.size(), draw_data.data(), GL_DYNAMIC_STORAGE_BIT);
+        GpuMemory::TrackBuffer(m_draw_data_ssbo_name, "StaticModel");
+
+        CreateMeshletBuffers();
+    }
+
+    void StaticModel::BuildBvh(const std::vector<MeshPart>& mesh_parts, const VertexData& vertex_data, std::unique_ptr<MeshBvh>& bvh) const
+    {
+        if (!m_is_bvh_enabled || m_draw_mode != DrawMode::TRIANGLES)
+        {
+            return;
+        }
+
+        BuildMeshBvh(mesh_parts, vertex_data, bvh);
+    }
+
+    void StaticModel::BuildMeshBvh(const std::vector<MeshPart>& mesh_parts, const VertexData& vertex_data, std::unique_ptr<MeshBvh>& bvh)
+    {
+        /* The full detail triangles, the LODs only change what is drawn. */
+        std::vector<MeshBvh::Range> ranges(mesh_parts.size());
+
+        for (uint32_t i = 0; i < mesh_parts.size(); ++i)
+        {
+            ranges[i] = { mesh_parts[i].m_base_index, mesh_parts[i].m_indices_count, mesh_parts[i].m_base_vertex };
+        }
+
+        bvh = std::make_unique<MeshBvh>();
+        bvh->Build(vertex_data.positions, vertex_data.indices, ranges);
+    }
+
+    void StaticModel::CreateMeshletBuffers()
+    {
+        GLuint* buffers[] = { &m_meshlets_ssbo_name, &m_meshlet_template_name, &m_meshlet_batches_name, &m_meshlet_commands_name };
+
+        for (GLuint* buffer : buffers)
+        {
+            GpuMemory::UntrackBuffer(*buffer);
+            glDeleteBuffers(1, buffer);
+            *buffer = 0;
+        }
+
+        m_meshlet_batches.clear();
+        m_culled_meshlets_count = 0;
+
+        if (m_meshlets.empty())
+        {
+            return;
+        }
+
+        /* Meshlets grouped by the indirect batches, so every material gets a contiguous range of the output commands. */
+        std::vector<MeshletData> meshlets;
+        meshlets.reserve(m_meshlets.size());
+
+        for (uint32_t b = 0; b < m_indirect_batches.size(); ++b)
+        {
+            const IndirectBatch& batch = m_indirect_batches[b];
+
+            m_meshlet_batches.push_back({ uint32_t(meshlets.size()), 0 /* visible count */ });
+
+            for (uint32_t c = batch.m_first_command; c < batch.m_first_command + batch.m_commands_count; ++c)
+            {
+                const MeshPart& mesh_part = m_mesh_parts[m_indirect_mesh_parts[c]];
+
+                for (uint32_t m = mesh_part.m_first_meshlet; m < mesh_part.m_first_meshlet + mesh_part.m_meshlets_count; ++m)
+                {
+                    meshlets.push_back(m_meshlets[m]);
+                    meshlets.back().batch_index = b;
+                }
+            }
+        }
+
+        if (meshlets.empty())
+        {
+            m_meshlet_batches.clear();
+            return;
+        }
+
+        const GLsizeiptr batches_size = sizeof(m_meshlet_batches[0]) * m_meshlet_batches.size();
+
+        m_culled_meshlets_count = uint32_t(meshlets.size());
+
+        glCreateBuffers     (1, &m_meshlets_ssbo_name);
+        glNamedBufferStorage(m_meshlets_ssbo_name, sizeof(meshlets[0]) * meshlets.size(), meshlets.data(), 0);
+        GpuMemory::TrackBuffer(m_meshlets_ssbo_name, "StaticModel");
+
+        glCreateBuffers     (1, &m_meshlet_template_name);
+        glNamedBufferStorage(m_meshlet_template_name, batches_size, m_meshlet_batches.data(), 0);
+        GpuMemory::TrackBuffer(m_meshlet_template_name, "StaticModel");
+
+        glCreateBuffers     (1, &m_meshlet_batches_name);
+        glNamedBufferStorage(m_meshlet_batches_name, batches_size, nullptr, 0);
+        GpuMemory::TrackBuffer(m_meshlet_batches_name, "StaticModel");
+
+        glCreateBuffers     (1, &m_meshlet_commands_name);
+        glNamedBufferStorage(m_meshlet_commands_name, sizeof(DrawElementsIndirectCommand) * meshlets.size(), nullptr, 0);
+        GpuMemory::TrackBuffer(m_meshlet_commands_name, "StaticModel");
+    }
+
+    void StaticModel::RenderMeshlets(std::shared_ptr<Shader>& shader, const glm::mat4& model, const glm::mat4& view_projection, const glm::vec3& camera_position)
+    {
+        UpdatePooledGeometry();
+
+        if (m_is_indirect_dirty)
+        {
+            CreateIndirectBuffers();
+        }
+
+        if (m_meshlet_batches.empty())
+        {
+            Render(shader);
+            return;
+        }
+
+        if (!m_meshlet_cull_shader)
+        {
+            m_meshlet_cull_shader = std::make_shared<Shader>("src/core/shaders/cull_meshlets.comp");
+            m_meshlet_cull_shader->link();
+        }
+
+        /* Reset the visible counts. */
+        glCopyNamedBufferSubData(m_meshlet_template_name, m_meshlet_batches_name, 0, 0, sizeof(m_meshlet_batches[0]) * m_meshlet_batches.size());
+
+        glm::vec4 planes[6];
+        GpuCulling::ExtractFrustumPlanes(view_projection, planes);
+
+        m_meshlet_cull_shader->bind();
+        m_meshlet_cull_shader->setUniform("u_meshlets_count",          m_culled_meshlets_count);
+        m_meshlet_cull_shader->setUniform("u_model",                   model);
+        m_meshlet_cull_shader->setUniform("u_frustum_planes",          planes, 6);
+        m_meshlet_cull_shader->setUniform("u_camera_position",         camera_position);
+        m_meshlet_cull_shader->setUniform("u_is_cone_culling_enabled", m_draw_mode == DrawMode::TRIANGLES);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESHLETS_SSBO_BINDING_INDEX,         m_meshlets_ssbo_name);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESHLET_BATCHES_SSBO_BINDING_INDEX,  m_meshlet_batches_name);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESHLET_COMMANDS_SSBO_BINDING_INDEX, m_meshlet_commands_name);
+
+        glDispatchCompute((m_culled_meshlets_count + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+        /* Draw the visible meshlets of every material batch. */
+        shader->bind();
+
+        GLState::BindVertexArray(m_vao_name);
+        glBindBuffer     (GL_DRAW_INDIRECT_BUFFER, m_meshlet_commands_name);
+        glBindBuffer     (GL_PARAMETER_BUFFER,     m_meshlet_batches_name);
+
+        for (uint32_t b = 0; b < m_meshlet_batches.size(); ++b)
+        {
+            const uint32_t first_meshlet  = m_meshlet_batches[b].first_meshlet;
+            const uint32_t meshlets_count = (b + 1 < m_meshlet_batches.size() ? m_meshlet_batches[b + 1].first_meshlet : m_culled_meshlets_count) - first_meshlet;
+
+            BindMaterial(m_indirect_batches[b].m_material_index, shader.get());
+
+            glMultiDrawElementsIndirectCount(GLenum(m_draw_mode),
+                                             m_index_type,
+                                             (void*)(sizeof(DrawElementsIndirectCommand) * first_meshlet),
+                                             GLintptr(sizeof(MeshletBatch) * b + offsetof(MeshletBatch, visible_count)),
+                                             meshlets_count,
+                                             0 /* stride */);
+        }
+
+        glBindBuffer(GL_PARAMETER_BUFFER,     0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        GLState::BindTextureUnit(0, 0);
+    }
+
+    bool StaticModel::EnableBindlessTextures(bool enable)
+    {
+        if (enable && !Texture::IsBindlessSupported())
+        {
+            fprintf(stderr, "StaticModel::EnableBindlessTextures: ARB_bindless_texture is not supported.\n");
+            return false;
+        }
+
+        if (enable != m_is_bindless_enabled)
+        {
+            m_is_bindless_enabled = enable;
+            m_is_indirect_dirty   = true;
+        }
+
+        return true;
+    }
+
+    void StaticModel::UpdateIndirectInstancesCount(uint32_t num_instances)
+    {
+        // 0 means non-instanced rendering, which is the same as drawing a single instance.
+        num_instances = std::max(num_instances, 1u);
+
+        if (num_instances == m_indirect_instances_count || m_indirect_commands.empty())
+        {
+            return;
+        }
+
+        for (auto& command : m_indirect_commands)
+        {
+            command.m_instance_count = num_instances;
+        }
+
+        glNamedBufferSubData(m_indirect_buffer_name, 0, sizeof(m_indirect_commands[0]) * m_indirect_commands.size(), m_indirect_commands.data());
+        m_indirect_instances_count = num_instances;
+    }
+
+    void StaticModel::UpdateIndirectLods()
+    {
+        if (!m_is_indirect_lod_dirty || m_indirect_commands.empty())
+        {
+            return;
+        }
+
+        for (uint32_t i = 0; i < m_indirect_commands.size(); ++i)
+        {
+            const MeshPart& mesh_part = m_mesh_parts[m_indirect_mesh_parts[i]];
+
+            m_indirect_commands[i].m_count       = mesh_part.GetLodIndicesCount();
+            m_indirect_commands[i].m_first_index = mesh_part.GetLodBaseIndex();
+        }
+
+        glNamedBufferSubData(m_indirect_buffer_name, 0, sizeof(m_indirect_commands[0]) * m_indirect_commands.size(), m_indirect_commands.data());
+        m_is_indirect_lod_dirty = false;
+    }
+
+    bool StaticModel::Load(const std::filesystem::path& filepath)
+    {
+        /* Release the previously loaded mesh if it was loaded. */
+        if(m_vao_name)
+        {
+            Release();
+        }
+
+        if (LoadMeshCache(filepath))
+        {
+            return true;
+        }
+
+        /* Load model */
+        Assimp::Importer importer;
+        importer.SetIOHandler(new AssetIOSystem);
+
+        const aiScene* scene = importer.ReadFile(filepath.generic_string(), IMPORT_FLAGS);
+
+        if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+        {
+            fprintf(stderr, "Assimp error while loading mesh %s\n Error: %s\n", filepath.generic_string(), importer.GetErrorString());
+            return false;
+        }
+
+        return ParseScene(scene, filepath);
+    }
+
+    bool StaticModel::LoadAsync(const std::filesystem::path& filepath)
+    {
+        Release();
+
+        m_async_load                        = std::make_unique<AsyncLoadState>();
+        m_async_load->m_filepath            = filepath;
+        m_async_load->m_lods_count          = m_lods_count;
+        m_async_load->m_is_mesh_optimized   = m_is_mesh_optimized;
+        m_async_load->m_is_meshlets_enabled = m_is_meshlets_enabled;
+        m_async_load->m_is_bvh_enabled      = m_is_bvh_enabled && m_draw_mode == DrawMode::TRIANGLES;
+
+        /* The state outlives the worker - its destructor waits for the result. The move of the model waits as well,
+           the worker calls the model's functions. */
+        AsyncLoadState* state = m_async_load.get();
+        state->m_result       = std::async(std::launch::async, [this, state] { return ImportAsync(*state); });
+
+        return true;
+    }
+
+    bool StaticModel::ImportAsync(AsyncLoadState& state)
+    {
+        /* Worker thread - no GL calls and no access to the model's members in here, the results go to the state. */
+        Assimp::Importer importer;
+        importer.SetIOHandler(new AssetIOSystem);
+
+        const aiScene* scene = importer.ReadFile(state.m_filepath.generic_string(), IMPORT_FLAGS);
+
+        if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+        {
+            fprintf(stderr, "Assimp error while loading mesh %s\n Error: %s\n", state.m_filepath.generic_string().c_str(), importer.GetErrorString());
+            return false;
+        }
+
+        state.m_unit_scale = ParseMeshParts(scene, state.m_mesh_parts, state.m_vertex_data);
+
+        if (state.m_is_mesh_optimized)
+        {
+            OptimizeMeshParts(state.m_mesh_parts, state.m_vertex_data);
+        }
+
+        if (state.m_lods_count > 1)
+        {
+            GenerateLods(state.m_mesh_parts, state.m_vertex_data, state.m_lods_count, state.m_is_mesh_optimized);
+        }
+
+        if (state.m_is_meshlets_enabled)
+        {
+            GenerateMeshlets(state.m_mesh_parts, state.m_vertex_data, state.m_meshlets);
+        }
+
+        if (state.m_is_bvh_enabled)
+        {
+            BuildMeshBvh(state.m_mesh_parts, state.m_vertex_data, state.m_bvh);
+        }
+
+        /* Materials' parameters and the list of textures to decode. */
+        std::string dir = GetModelDirectory(state.m_filepath);
+        std::vector<std::pair<const aiTexture*, std::string>> sources;
+
+        state.m_materials.resize(scene->mNumMaterials);
+
+        for (uint32_t i = 0; i < scene->mNumMaterials; ++i)
+        {
+            auto ai_material = scene->mMaterials[i];
+
+            state.m_materials[i] = std::make_shared<Material>();
+            LoadMaterialParams(ai_material, *state.m_materials[i]);
+
+            for (auto [ai_texture_type, texture_type] : MATERIAL_TEXTURE_TYPES)
+            {
+                aiString         path;
+                aiTextureMapMode texture_map_mode[3];
+
+                if (ai_material->GetTextureCount(ai_texture_type) == 0 ||
+                    ai_material->GetTexture(ai_texture_type, 0, &path, NULL, NULL, NULL, NULL, texture_map_mode) != AI_SUCCESS)
+                {
+                    continue;
+                }
+
+                DecodedTexture texture;
+                texture.m_material_index = i;
+                texture.m_texture_type   = texture_type;
+                texture.m_is_srgb        = (ai_texture_type == aiTextureType_EMISSIVE) || (ai_texture_type == aiTextureType_BASE_COLOR);
+                texture.m_is_repeat      = texture_map_mode[0] == aiTextureMapMode_Wrap;
+                texture.m_data           = nullptr;
+
+                const aiTexture* ai_texture = scene->GetEmbeddedTexture(path.C_Str());
+                texture.m_name              = ai_texture ? path.C_Str() : GetTextureFilepath(dir, path);
+                texture.m_is_embedded       = ai_texture != nullptr;
+
+                state.m_textures.push_back(texture);
+                sources.push_back({ ai_texture, texture.m_name });
+            }
+        }
+
+        /* Decode all the textures in parallel. */
+        std::vector<std::future<void>> decode_jobs;
+        decode_jobs.reserve(state.m_textures.size());
+
+        for (size_t i = 0; i < state.m_textures.size(); ++i)
+        {
+            decode_jobs.push_back(std::async(std::launch::async, [&state, &sources, i]
+            {
+                auto& texture    = state.m_textures[i];
+                auto  ai_texture = sources[i].first;
+
+                if (ai_texture && IsEmbeddedKtx2(ai_texture))
+                {
+                    /* Uploaded as it is, the scene is gone by then. */
+                    const auto data = GetEmbeddedData(ai_texture);
+                    texture.m_ktx2_data.assign(data.begin(), data.end());
+
+                    return;
+                }
+
+                if (ai_texture)
+                {
+                    const auto data = GetEmbeddedData(ai_texture);
+                    texture.m_data  = Util::LoadTextureData(const_cast<unsigned char*>(data.data()), uint32_t(data.size()), texture.m_metadata);
+                }
+                else
+                {
+                    /* Already loaded by another model - nothing to decode. */
+                    texture.m_cached = TextureCache::Find(texture.m_name, texture.m_is_srgb, 0, GetMipmapFilter(texture.m_texture_type));
+
+                    if (texture.m_cached)
+                    {
+                        return;
+                    }
+
+                    texture.m_data = Util::LoadTextureData(texture.m_name, texture.m_metadata);
+                }
+
+                if (!texture.m_data)
+                {
+                    fprintf(stderr, "Error loading texture %s.\n", texture.m_name.c_str());
+                }
+            }));
+        }
+
+        for (auto& job : decode_jobs)
+        {
+            job.wait();
+        }
+
+        return true;
+    }
+
+    void StaticModel::WaitForAsyncImport()
+    {
+        if (m_async_load && m_async_load->m_result.valid())
+        {
+            m_async_load->m_result.wait();
+        }
+    }
+
+    void StaticModel::BeginAsyncUpload(AsyncLoadState& state)
+    {
+        VertexData& vertex_data = state.m_vertex_data;
+
+        const GLsizei positions_size_bytes = vertex_data.positions.size() * sizeof(vertex_data.positions[0]);
+        const GLsizei texcoords_size_bytes = vertex_data.texcoords.size() * sizeof(vertex_data.texcoords[0]);
+        const GLsizei normals_size_bytes   = vertex_data.normals  .size() * sizeof(vertex_data.normals  [0]);
+        const GLsizei tangents_size_bytes  = vertex_data.tangents .size() * sizeof(vertex_data.tangents [0]);
+
+        /* The packed data has to outlive the upload, so it's kept in the state. */
+        state.m_packed_indices = PackIndices(vertex_data);
+
+        glCreateBuffers     (1, &m_ibo_name);
+        glNamedBufferStorage(m_ibo_name, state.m_packed_indices.size(), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        GpuMemory::TrackBuffer(m_ibo_name, "StaticModel");
+
+        /* Storage only, the data is copied from the staging buffer in UpdateAsyncLoad(). */
+        if (m_vertex_format == VertexFormat::PLANAR)
+        {
+            const GLsizei total_size_bytes = positions_size_bytes + texcoords_size_bytes + normals_size_bytes + tangents_size_bytes;
+
+            glCreateBuffers     (1, &m_vbo_name);
+            glNamedBufferStorage(m_vbo_name, total_size_bytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+            GpuMemory::TrackBuffer(m_vbo_name, "StaticModel");
+
+            GLintptr offset = 0;
+            state.m_uploads.push_back({ m_vbo_name, offset, reinterpret_cast<const uint8_t*>(vertex_data.positions.data()), positions_size_bytes });
+
+            offset += positions_size_bytes;
+            state.m_uploads.push_back({ m_vbo_name, offset, reinterpret_cast<const uint8_t*>(vertex_data.texcoords.data()), texcoords_size_bytes });
+
+            offset += texcoords_size_bytes;
+            state.m_uploads.push_back({ m_vbo_name, offset, reinterpret_cast<const uint8_t*>(vertex_data.normals.data()),   normals_size_bytes   });
+
+            offset += normals_size_bytes;
+            state.m_uploads.push_back({ m_vbo_name, offset, reinterpret_cast<const uint8_t*>(vertex_data.tangents.data()),  tangents_size_bytes  });
+        }
+        else
+        {
+            state.m_packed_vertices = PackVertices(vertex_data);
+
+            glCreateBuffers     (1, &m_vbo_name);
+            glNamedBufferStorage(m_vbo_name, state.m_packed_vertices.size(), nullptr, GL_DYNAMIC_STORAGE_BIT);
+            GpuMemory::TrackBuffer(m_vbo_name, "StaticModel");
+
+            state.m_uploads.push_back({ m_vbo_name, 0, state.m_packed_vertices.data(), GLsizeiptr(state.m_packed_vertices.size()) });
+        }
+
+        state.m_uploads.push_back({ m_ibo_name, 0, state.m_packed_indices.data(), GLsizeiptr(state.m_packed_indices.size()) });
+
+        /* Upload order is front to back, so reverse the list and pop from the back. */
+        std::reverse(state.m_uploads.begin(), state.m_uploads.end());
+
+        CreateVertexArray(positions_size_bytes, texcoords_size_bytes, normals_size_bytes, tangents_size_bytes > 0);
+    }
+
+    bool StaticModel::UpdateAsyncLoad(uint32_t max_upload_bytes)
+    {
+        if (!m_async_load)
+        {
+            return true;
+        }
+
+        AsyncLoadState& state = *m_async_load;
+
+        if (state.m_is_failed)
+        {
+            return false;
+        }
+
+        if (!state.m_is_gpu_stage_started)
+        {
+            if (state.m_result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                return false;
+            }
+
+            if (!state.m_result.get())
+            {
+                state.m_is_failed = true;
+                return false;
+            }
+
+            state.m_is_gpu_stage_started = true;
+            state.m_staging_slot_size    = std::max<GLsizeiptr>(max_upload_bytes, 1);
+
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+            glCreateBuffers     (1, &state.m_staging_buffer_name);
+            glNamedBufferStorage(state.m_staging_buffer_name, state.m_staging_slot_size * std::size(state.m_staging_fences), nullptr, flags);
+            GpuMemory::TrackBuffer(state.m_staging_buffer_name, "StaticModel");
+
+            state.m_staging_data = static_cast<uint8_t*>(glMapNamedBufferRange(state.m_staging_buffer_name, 0, state.m_staging_slot_size * std::size(state.m_staging_fences), flags));
+
+            BeginAsyncUpload(state);
+        }
+
+        GLsizeiptr budget = state.m_staging_slot_size;
+
+        /* Textures first - the decoded data is already in the memory, it only has to be handed to GL. */
+        while (!state.m_textures.empty() && budget > 0)
+        {
+            DecodedTexture& decoded = state.m_textures.back();
+
+            if (decoded.m_cached)
+            {
+                if (decoded.m_is_repeat)
+                {
+                    decoded.m_cached->SetWraping(RGL::TextureWrapingCoordinate::S, RGL::TextureWrapingParam::REPEAT);
+                    decoded.m_cached->SetWraping(RGL::TextureWrapingCoordinate::T, RGL::TextureWrapingParam::REPEAT);
+                }
+
+                state.m_materials[decoded.m_material_index]->AddTexture(decoded.m_texture_type, decoded.m_cached);
+                decoded.m_cached.reset();
+            }
+            else if (!decoded.m_ktx2_data.empty())
+            {
+                auto texture = std::make_shared<Texture2D>();
+
+                if (texture->LoadKtx2(decoded.m_ktx2_data.data(), decoded.m_ktx2_data.size(), decoded.m_is_srgb, decoded.m_name))
+                {
+                    if (decoded.m_is_repeat)
+                    {
+                        texture->SetWraping(RGL::TextureWrapingCoordinate::S, RGL::TextureWrapingParam::REPEAT);
+                        texture->SetWraping(RGL::TextureWrapingCoordinate::T, RGL::TextureWrapingParam::REPEAT);
+                    }
+
+                    state.m_materials[decoded.m_material_index]->AddTexture(decoded.m_texture_type, texture);
+                    printf("Loaded texture '%s'\n", decoded.m_name.c_str());
+                }
+
+                budget -= GLsizeiptr(decoded.m_ktx2_data.size());
+            }
+            else if (decoded.m_data)
+            {
+                auto texture = std::make_shared<Texture2D>();
+
+                if (texture->Create(decoded.m_metadata, decoded.m_data, decoded.m_is_srgb, 0, GetMipmapFilter(decoded.m_texture_type)))
+                {
+                    if (!decoded.m_is_embedded)
+                    {
+                        texture = TextureCache::Add(decoded.m_name, decoded.m_is_srgb, 0, GetMipmapFilter(decoded.m_texture_type), texture);
+                    }
+
+                    if (decoded.m_is_repeat)
+                    {
+                        texture->SetWraping(RGL::TextureWrapingCoordinate::S, RGL::TextureWrapingParam::REPEAT);
+                        texture->SetWraping(RGL::TextureWrapingCoordinate::T, RGL::TextureWrapingParam::REPEAT);
+                    }
+
+                    state.m_materials[decoded.m_material_index]->AddTexture(decoded.m_texture_type, texture);
+                    printf("Loaded texture '%s'\n", decoded.m_name.c_str());
+                }
+
+                budget -= GLsizeiptr(decoded.m_metadata.width) * decoded.m_metadata.height * decoded.m_metadata.channels;
+                Util::ReleaseTextureData(decoded.m_data);
+            }
+
+            /* Matches the synchronous path - the flag is set even if the texture failed to load. */
+            SetMaterialHasMap(decoded.m_texture_type, *state.m_materials[decoded.m_material_index]);
+            state.m_textures.pop_back();
+        }
+
+        /* Vertex and index data through the staging buffer, one slot per frame. */
+        if (!state.m_uploads.empty() && budget > 0)
+        {
+            uint32_t slot = state.m_staging_slot;
+            GLsync&  fence = state.m_staging_fences[slot];
+
+            if (fence)
+            {
+                glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(-1));
+                glDeleteSync    (fence);
+                fence = nullptr;
+            }
+
+            GLsizeiptr slot_offset = 0;
+
+            while (!state.m_uploads.empty() && slot_offset < state.m_staging_slot_size)
+            {
+                PendingUpload& upload = state.m_uploads.back();
+                GLsizeiptr     size   = std::min(upload.m_size, state.m_staging_slot_size - slot_offset);
+
+                if (size > 0)
+                {
+                    GLintptr staging_offset = state.m_staging_slot_size * slot + slot_offset;
+
+                    std::memcpy             (state.m_staging_data + staging_offset, upload.m_data, size);
+                    glCopyNamedBufferSubData(state.m_staging_buffer_name, upload.m_buffer_name, staging_offset, upload.m_offset, size);
+                }
+
+                upload.m_data   += size;
+                upload.m_offset += size;
+                upload.m_size   -= size;
+                slot_offset     += size;
+
+                if (upload.m_size == 0)
+                {
+                    state.m_uploads.pop_back();
+                }
+            }
+
+            fence                = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            state.m_staging_slot = (slot + 1) % std::size(state.m_staging_fences);
+        }
+
+        if (!state.m_textures.empty() || !state.m_uploads.empty())
+        {
+            return false;
+        }
+
+        /* Everything is on the GPU - the model can be rendered from now on. */
+        m_mesh_parts = std::move(state.m_mesh_parts);
+        m_materials  = std::move(state.m_materials);
+        m_meshlets   = std::move(state.m_meshlets);
+        m_bvh        = std::move(state.m_bvh);
+        m_unit_scale = state.m_unit_scale;
+
+        m_async_load.reset();
+        CreateIndirectBuffers();
+
+        return true;
+    }
+
+    bool StaticModel::ParseScene(const aiScene* scene, const std::filesystem::path& filepath)
+    {
+        m_materials.resize(scene->mNumMaterials);
+
+        for (uint32_t i = 0; i < m_materials.size(); ++i)
+        {
+            m_materials[i] = std::make_shared<Material>();
+        }
+
+        VertexData vertex_data;
+        m_unit_scale = ParseMeshParts(scene, m_mesh_parts, vertex_data);
+
+        if (m_is_mesh_optimized)
+        {
+            OptimizeMeshParts(m_mesh_parts, vertex_data);
+        }
+
+        if (m_lods_count > 1)
+        {
+            GenerateLods(m_mesh_parts, vertex_data, m_lods_count, m_is_mesh_optimized);
+        }
+
+        if (m_is_meshlets_enabled)
+        {
+            GenerateMeshlets(m_mesh_parts, vertex_data, m_meshlets);
+        }
+
+        BuildBvh(m_mesh_parts, vertex_data, m_bvh);
+
+        /* Load materials. */
+        if (!LoadMaterials(scene, filepath))
+        {
+            fprintf(stderr, "Assimp error while loading mesh %s\n Error: Could not load the materials.\n", filepath.generic_string());
+            return false;
+        }
+
+        /* Before the buffers are created - pooled models rebase their mesh parts. */
+        SaveMeshCache(scene, filepath, vertex_data);
+
+        /* Populate buffers on the GPU with the model's data. */
+        CreateBuffers(vertex_data);
+        CreateIndirectBuffers();
+
+        return true;
+    }
+
+    uint32_t StaticModel::GetMeshCacheOptions() const
+    {
+        return uint32_t(m_is_mesh_optimized) | (m_lods_count << 1) | (uint32_t(m_is_meshlets_enabled) << 4);
+    }
+
+    std::filesystem::path StaticModel::GetMeshCachePath(const std::filesystem::path& filepath)
+    {
+        auto cache_filepath = filepath;
+        return cache_filepath.concat(".rglcache");
+    }
+
+    void StaticModel::SaveMeshCache(const aiScene* scene, const std::filesystem::path& filepath, const VertexData& vertex_data) const
+    {
+        MeshCacheHeader header;
+
+        if (!GetSourceInfo(filepath, GetMeshCacheOptions(), header))
+        {
+            return;
+        }
+
+        /* Texture table, the embedded textures would need the Assimp scene, so such models are not cached. */
+        struct CachedTexture
+        {
+            uint32_t    m_material_index;
+            uint32_t    m_texture_type;
+            uint8_t     m_is_srgb;
+            uint8_t     m_is_repeat;
+            std::string m_filepath;
+        };
+
+        std::vector<CachedTexture> textures;
+        std::string                dir = GetModelDirectory(filepath);
+
+        for (uint32_t i = 0; i < scene->mNumMaterials; ++i)
+        {
+            for (auto [ai_texture_type, texture_type] : MATERIAL_TEXTURE_TYPES)
+            {
+                aiString         path;
+                aiTextureMapMode texture_map_mode[3];
+
+                if (scene->mMaterials[i]->GetTextureCount(ai_texture_type) == 0 ||
+                    scene->mMaterials[i]->GetTexture(ai_texture_type, 0, &path, NULL, NULL, NULL, NULL, texture_map_mode) != AI_SUCCESS)
+                {
+                    continue;
+                }
+
+                if (scene->GetEmbeddedTexture(path.C_Str()))
+                {
+                    return;
+                }
+
+                bool is_srgb = (ai_texture_type == aiTextureType_EMISSIVE) || (ai_texture_type == aiTextureType_BASE_COLOR);
+                textures.push_back({ i, uint32_t(texture_type), is_srgb, texture_map_mode[0] == aiTextureMapMode_Wrap, GetTextureFilepath(dir, path) });
+            }
+        }
+
+        std::ofstream out(GetMeshCachePath(filepath), std::ios::binary);
+
+        if (!out)
+        {
+            return;
+        }
+
+        WritePod   (out, header);
+        WritePod   (out, m_unit_scale);
+        WriteVector(out, m_mesh_parts);
+
+        /* Materials */
+        WritePod(out, uint32_t(m_materials.size()));
+
+        for (auto& material : m_materials)
+        {
+            /* The bindless handles are not stored, they are only valid for the current context. */
+            MaterialData data = material->GetData();
+            std::fill(std::begin(data.texture_handles), std::end(data.texture_handles), 0);
+
+            WritePod(out, data);
+        }
+
+        WritePod(out, uint32_t(textures.size()));
+
+        for (auto& texture : textures)
+        {
+            WritePod   (out, texture.m_material_index);
+            WritePod   (out, texture.m_texture_type);
+            WritePod   (out, texture.m_is_srgb);
+            WritePod   (out, texture.m_is_repeat);
+            WriteString(out, texture.m_filepath);
+        }
+
+        /* Vertex streams */
+        WriteVector(out, vertex_data.positions);
+        WriteVector(out, vertex_data.texcoords);
+        WriteVector(out, vertex_data.normals);
+        WriteVector(out, vertex_data.tangents);
+        WriteVector(out, vertex_data.indices);
+        WriteVector(out, m_meshlets);
+    }
+
+    bool StaticModel::LoadMeshCache(const std::filesystem::path& filepath)
+    {
+        MeshCacheHeader expected_header, header;
+        auto            cache_filepath = GetMeshCachePath(filepath);
+
+        if (!FileSystem::exists(cache_filepath) || !GetSourceInfo(filepath, GetMeshCacheOptions(), expected_header))
+        {
+            return false;
+        }
+
+        MappedFile  file(cache_filepath);
+        CacheReader in { file.GetData(), file.GetSize(), 0 };
+
+        /* Stale caches are ignored and overwritten after the import. */
+        if (!ReadPod(in, header)                                  ||
+            header.m_magic        != expected_header.m_magic        ||
+            header.m_version      != expected_header.m_version      ||
+            header.m_import_flags != expected_header.m_import_flags ||
+            header.m_options      != expected_header.m_options      ||
+            header.m_source_size  != expected_header.m_source_size  ||
+            header.m_source_time  != expected_header.m_source_time)
+        {
+            return false;
+        }
+
+        float                                  unit_scale;
+        std::vector<MeshPart>                  mesh_parts;
+        std::vector<MeshletData>               meshlets;
+        std::vector<std::shared_ptr<Material>> materials;
+        uint32_t                               count;
+
+        if (!ReadPod(in, unit_scale) || !ReadVector(in, mesh_parts) || !ReadPod(in, count))
+        {
+            return false;
+        }
+
+        materials.resize(count);
+
+        for (auto& material : materials)
+        {
+            material = std::make_shared<Material>();
+
+            MaterialData data;
+
+            if (!ReadPod(in, data))
+            {
+                return false;
+            }
+
+            material->SetAlbedo   (data.albedo);
+            material->SetEmission (data.emission);
+            material->SetAo       (data.ao);
+            material->SetRoughness(data.roughness);
+            material->SetMetallic (data.metallic);
+
+            for (uint32_t i = 0; i < MATERIAL_TEXTURES_COUNT; ++i)
+            {
+                material->SetHasMap(Material::TextureType(i), (data.flags & (1u << i)) != 0);
+            }
+
+            material->SetAlphaMasked((data.flags & MATERIAL_ALPHA_MASKED) != 0);
+        }
+
+        if (!ReadPod(in, count))
+        {
+            return false;
+        }
+
+        std::vector<TextureRequest> requests;
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            TextureRequest request;
+            uint32_t       material_index, texture_type;
+            uint8_t        is_srgb, is_repeat;
+
+            if (!ReadPod(in, material_index) || !ReadPod(in, texture_type) || !ReadPod(in, is_srgb) || !ReadPod(in, is_repeat) || 
+                !ReadString(in, request.m_name) || material_index >= materials.size() || texture_type >= MATERIAL_TEXTURES_COUNT)
+            {
+                return false;
+            }
+
+            request.m_material_index   = material_index;
+            request.m_texture_type     = Material::TextureType(texture_type);
+            request.m_is_srgb          = is_srgb != 0;
+            request.m_is_repeat        = is_repeat != 0;
+            request.m_embedded_texture = nullptr;
+
+            requests.push_back(std::move(request));
+        }
+
+        VertexData vertex_data;
+
+        if (!ReadVector(in, vertex_data.positions) || !ReadVector(in, vertex_data.texcoords) || !ReadVector(in, vertex_data.normals) ||
+            !ReadVector(in, vertex_data.tangents)  || !ReadVector(in, vertex_data.indices)   || !ReadVector(in, meshlets))
+        {
+            return false;
+        }
+
+        LoadTextures(requests, materials);
+
+        m_unit_scale = unit_scale;
+        m_mesh_parts = std::move(mesh_parts);
+        m_materials  = std::move(materials);
+        m_meshlets   = std::move(meshlets);
+
+        BuildBvh(m_mesh_parts, vertex_data, m_bvh);
+        CreateBuffers(vertex_data);
+        CreateIndirectBuffers();
+
+        printf("Loaded mesh cache '%s'\n", cache_filepath.string().c_str());
+
+        return true;
+    }
+
+    float StaticModel::ParseMeshParts(const aiScene* scene, std::vector<MeshPart>& mesh_parts, VertexData& vertex_data)
+    {
+        mesh_parts.resize(scene->mNumMeshes);
+
+        uint32_t vertices_count = 0;
+        uint32_t indices_count  = 0;
+
+        /* Count the number of vertices and indices. */
+        for (uint32_t i = 0; i < mesh_parts.size(); ++i)
+        {
+            mesh_parts[i].m_material_index = scene->mNumMaterials > 0 ? scene->mMeshes[i]->mMaterialIndex : INVALID_MATERIAL;
+            mesh_parts[i].m_indices_count  = scene->mMeshes[i]->mNumFaces * 3;
+            mesh_parts[i].m_base_vertex    = vertices_count;
+            mesh_parts[i].m_base_index     = indices_count;
+
+            vertices_count += scene->mMeshes[i]->mNumVertices;
+            indices_count  += mesh_parts[i].m_indices_count;
+        }
+
+        /* Reserve space in the vectors for the vertex attributes and indices. */
+        vertex_data.positions.reserve(vertices_count);
+        vertex_data.texcoords.reserve(vertices_count);
+        vertex_data.normals.reserve(vertices_count);
+        vertex_data.tangents.reserve(vertices_count);
+        vertex_data.indices.reserve(indices_count);
+
+        /* Load mesh parts one by one. */
+        glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 max = -min;
+
+        for (uint32_t i = 0; i < mesh_parts.size(); ++i)
+        {
+            auto mesh = scene->mMeshes[i];
+            LoadMeshPart(mesh, vertex_data);
+
+            mesh_parts[i].m_bounds_center = 0.5f * (vec3_cast(mesh->mAABB.mMax) + vec3_cast(mesh->mAABB.mMin));
+            mesh_parts[i].m_bounds_radius = 0.5f * glm::length(vec3_cast(mesh->mAABB.mMax) - vec3_cast(mesh->mAABB.mMin));
+
+            min = glm::min(min, vec3_cast(mesh->mAABB.mMin));
+            max = glm::max(max, vec3_cast(mesh->mAABB.mMax));
+        }
+
+        /* Unit scale factor. */
+        return 1.0f / glm::compMax(max - min);
+    }
+
+    void StaticModel::OptimizeMeshParts(const std::vector<MeshPart>& mesh_parts, VertexData& vertex_data)
+    {
+        const uint32_t total_vertices_count = uint32_t(vertex_data.positions.size());
+
+        size_t acmr_triangles_count = 0;
+        double acmr_before          = 0.0;
+        double acmr_after           = 0.0;
+
+        for (uint32_t i = 0; i < mesh_parts.size(); ++i)
+        {
+            const MeshPart& part = mesh_parts[i];
+
+            /* Indices are relative to the part's base vertex, the vertices of the part end where the next part begins. */
+            const uint32_t vertices_count  = (i + 1 < mesh_parts.size() ? mesh_parts[i + 1].m_base_vertex : total_vertices_count) - part.m_base_vertex;
+            const size_t   triangles_count = part.m_indices_count / 3;
+            uint32_t*      indices         = vertex_data.indices.data() + part.m_base_index;
+
+            if (triangles_count == 0 || vertices_count == 0)
+            {
+                continue;
+            }
+
+            acmr_before += MeshOptimizer::ComputeACMR(indices, part.m_indices_count, vertices_count) * triangles_count;
+
+            MeshOptimizer::OptimizeVertexCache(indices, part.m_indices_count, vertices_count);
+            MeshOptimizer::OptimizeOverdraw   (indices, part.m_indices_count, vertex_data.positions.data() + part.m_base_vertex, vertices_count);
+
+            auto remap = MeshOptimizer::OptimizeVertexFetch(indices, part.m_indices_count, vertices_count);
+
+            MeshOptimizer::RemapVertices(vertex_data.positions.data() + part.m_base_vertex, remap);
+            MeshOptimizer::RemapVertices(vertex_data.texcoords.data() + part.m_base_vertex, remap);
+            MeshOptimizer::RemapVertices(vertex_data.normals  .data() + part.m_base_vertex, remap);
+
+            if (!vertex_data.tangents.empty())
+            {
+                MeshOptimizer::RemapVertices(vertex_data.tangents.data() + part.m_base_vertex, remap);
+            }
+
+            acmr_after           += MeshOptimizer::ComputeACMR(indices, part.m_indices_count, vertices_count) * triangles_count;
+            acmr_triangles_count += triangles_count;
+        }
+
+        if (acmr_triangles_count > 0)
+        {
+            printf("Mesh optimization: ACMR %.3f -> %.3f (%zu triangles)\n", acmr_before / acmr_triangles_count, acmr_after / acmr_triangles_count, acmr_triangles_count);
+        }
+    }
+
+    void StaticModel::GenerateLods(std::vector<MeshPart>& mesh_parts, VertexData& vertex_data, uint32_t lods_count, bool optimize_vertex_cache)
+    {
+        const uint32_t total_vertices_count = uint32_t(vertex_data.positions.size());
+
+        size_t full_indices_count = 0;
+        size_t lods_indices_count = 0;
+
+        for (uint32_t i = 0; i < mesh_parts.size(); ++i)
+        {
+            MeshPart& part = mesh_parts[i];
+
+            const uint32_t   vertices_count = (i + 1 < mesh_parts.size() ? mesh_parts[i + 1].m_base_vertex : total_vertices_count) - part.m_base_vertex;
+            const glm::vec3* positions      = vertex_data.positions.data() + part.m_base_vertex;
+
+            part.m_lods[0]     = { part.m_base_index, part.m_indices_count, 0.0f };
+            part.m_lods_count  = 1;
+            part.m_current_lod = 0;
+
+            if (part.m_indices_count == 0 || part.m_bounds_radius <= 0.0f)
+            {
+                part.m_lods_count = 0;
+                continue;
+            }
+
+            /* Every LOD is simplified from the previous one - cheaper than starting from the full detail mesh each time. */
+            std::vector<uint32_t> lod_indices(vertex_data.indices.begin() + part.m_base_index, 
+                                              vertex_data.indices.begin() + part.m_base_index + part.m_indices_count);
+
+            while (part.m_lods_count < lods_count)
+            {
+                size_t target_indices_count = size_t(lod_indices.size() * LOD_REDUCTION_RATIO) / 3 * 3;
+                float  error                = 0.0f;
+
+                auto simplified = MeshOptimizer::Simplify(lod_indices.data(), lod_indices.size(), positions, vertices_count, 
+                                                          target_indices_count, part.m_bounds_radius * LOD_MAX_ERROR, &error);
+
+                /* Not worth another level - the mesh is locked by the borders or the error limit was reached. */
+                if (simplified.empty() || simplified.size() > lod_indices.size() * 0.9f)
+                {
+                    break;
+                }
+
+                if (optimize_vertex_cache)
+                {
+                    MeshOptimizer::OptimizeVertexCache(simplified.data(), simplified.size(), vertices_count);
+                }
+
+                part.m_lods[part.m_lods_count++] = { uint32_t(vertex_data.indices.size()), uint32_t(simplified.size()), error };
+                vertex_data.indices.insert(vertex_data.indices.end(), simplified.begin(), simplified.end());
+
+                lods_indices_count += simplified.size();
+                lod_indices         = std::move(simplified);
+            }
+
+            full_indices_count += part.m_indices_count;
+
+            /* A single level is the same as no LODs. */
+            if (part.m_lods_count == 1)
+            {
+                part.m_lods_count = 0;
+            }
+        }
+
+        printf("LOD generation: %zu triangles, %zu triangles in the simplified levels\n", full_indices_count / 3, lods_indices_count / 3);
+    }
+
+    void StaticModel::GenerateMeshlets(std::vector<MeshPart>& mesh_parts, VertexData& vertex_data, std::vector<MeshletData>& meshlets)
+    {
+        const uint32_t total_vertices_count = uint32_t(vertex_data.positions.size());
+
+        std::vector<Meshlet>  part_meshlets;
+        std::vector<uint32_t> meshlet_vertices;
+        std::vector<uint8_t>  meshlet_triangles;
+
+        for (uint32_t i = 0; i < mesh_parts.size(); ++i)
+        {
+            MeshPart& part = mesh_parts[i];
+
+            const uint32_t   vertices_count = (i + 1 < mesh_parts.size() ? mesh_parts[i + 1].m_base_vertex : total_vertices_count) - part.m_base_vertex;
+            const glm::vec3* positions      = vertex_data.positions.data() + part.m_base_vertex;
+
+            part_meshlets.clear();
+            meshlet_vertices.clear();
+            meshlet_triangles.clear();
+
+            MeshOptimizer::BuildMeshlets(part_meshlets, meshlet_vertices, meshlet_triangles, vertex_data.indices.data() + part.m_base_index, 
+                                         part.m_indices_count, vertices_count, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+
+            part.m_first_meshlet  = uint32_t(meshlets.size());
+            part.m_meshlets_count = uint32_t(part_meshlets.size());
+
+            /* Every meshlet's triangles as a separate range of part relative indices. */
+            for (const auto& meshlet : part_meshlets)
+            {
+                MeshletBounds bounds = MeshOptimizer::ComputeMeshletBounds(meshlet, meshlet_vertices, meshlet_triangles, positions);
+
+                MeshletData data;
+                data.bounds        = glm::vec4(bounds.m_center,    bounds.m_radius);
+                data.cone_apex     = glm::vec4(bounds.m_cone_apex, bounds.m_cone_cutoff);
+                data.cone_axis     = glm::vec4(bounds.m_cone_axis, 0.0f);
+                data.first_index   = uint32_t(vertex_data.indices.size());
+                data.indices_count = meshlet.m_triangle_count * 3;
+                data.base_vertex   = part.m_base_vertex;
+                data.batch_index   = 0;
+
+                for (uint32_t t = 0; t < meshlet.m_triangle_count * 3; ++t)
+                {
+                    vertex_data.indices.push_back(meshlet_vertices[meshlet.m_vertex_offset + meshlet_triangles[meshlet.m_triangle_offset * 3 + t]]);
+                }
+
+                meshlets.push_back(data);
+            }
+        }
+
+        printf("Meshlet generation: %zu meshlets\n", meshlets.size());
+    }
+
+    void StaticModel::SelectLods(const glm::mat4& model, const glm::vec3& camera_position, float projection_scale)
+    {
+        const float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+        for (auto& part : m_mesh_parts)
+        {
+            uint32_t lod = 0;
+
+            if (part.m_lods_count > 1)
+            {
+                glm::vec3 center   = glm::vec3(model * glm::vec4(part.m_bounds_center, 1.0f));
+                float     radius   = part.m_bounds_radius * scale;
+                float     distance = glm::distance(center, camera_position);
+
+                /* Full detail when the camera is inside the bounding sphere. */
+                if (distance > radius)
+                {
+                    float projected_radius = radius * projection_scale / distance;
+
+                    if (projected_radius < m_lod_threshold)
+                    {
+                        lod = 1 + uint32_t(std::log2(m_lod_threshold / std::max(projected_radius, 1e-6f)));
+                    }
+                }
+
+                lod = std::min(lod, part.m_lods_count - 1);
+            }
+
+            if (lod != part.m_current_lod)
+            {
+                part.m_current_lod      = lod;
+                m_is_indirect_lod_dirty = true;
+            }
+        }
+    }
+
+    void StaticModel::LoadMeshPart(const aiMesh* mesh, VertexData& vertex_data)
+    {
+        const glm::vec3 zero_vec3(0.0f, 0.0f, 0.0f);
+
+        for (uint32_t i = 0; i < mesh->mNumVertices; ++i)
+        {
+            auto pos      = vec3_cast(mesh->mVertices[i]);
+            auto texcoord = mesh->HasTextureCoords(0)        ? vec3_cast(mesh->mTextureCoords[0][i]) : zero_vec3;
+            auto normal   = mesh->HasNormals()               ? vec3_cast(mesh->mNormals[i])          : zero_vec3;
+            auto tangent  = mesh->HasTangentsAndBitangents() ? vec3_cast(mesh->mTangents[i])         : zero_vec3;
+
+            vertex_data.positions.push_back(pos);
+            vertex_data.texcoords.push_back(glm::vec2(texcoord.x, texcoord.y));
+            vertex_data.normals.push_back(normal);
+            vertex_data.tangents.push_back(tangent);
+        }
+
+        for (uint32_t i = 0; i < mesh->mNumFaces; ++i)
+        {
+            const aiFace& face = mesh->mFaces[i];
+            assert(face.mNumIndices == 3);
+
+            for (char i = 0; i < face.mNumIndices; ++i)
+            {
+                vertex_data.indices.push_back(face.mIndices[i]);
+            }
+        }
+    }
+
+    std::string StaticModel::GetModelDirectory(const std::filesystem::path& filepath)
+    {
+        // Extract the directory part from the file name
+        std::string::size_type last_slash_index = filepath.generic_string().rfind("/");
+
+        if (last_slash_index == std::string::npos)
+        {
+            return ".";
+        }
+        else if (last_slash_index == 0)
+        {
+            return "/";
+        }
+
+        return filepath.generic_string().substr(0, last_slash_index);
+    }
+
+    std::string StaticModel::GetTextureFilepath(const std::string& directory, const aiString& path)
+    {
+        std::string p(path.data);
+
+        if (p.substr(0, 2) == ".\\")
+        {
+            p = p.substr(2, p.size() - 2);
+        }
+
+        return directory + "/" + p;
+    }
+
+    void StaticModel::LoadMaterialParams(const aiMaterial* ai_material, Material& material)
+    {
+        aiColor3D color_rgb;
+        aiColor4D color_rgba;
+        float value;
+
+        if (AI_SUCCESS == ai_material->Get(AI_MATKEY_BASE_COLOR, color_rgba))
+        {
+            material.SetAlbedo(glm::vec3(color_rgba.r, color_rgba.g, color_rgba.b));
+        }
+        if (AI_SUCCESS == ai_material->Get(AI_MATKEY_COLOR_EMISSIVE, color_rgb))
+        {
+            material.SetEmission(glm::vec3(color_rgb.r, color_rgb.g, color_rgb.b));
+        }
+        if (AI_SUCCESS == ai_material->Get(AI_MATKEY_COLOR_AMBIENT, color_rgb))
+        {
+            material.SetAo((color_rgb.r + color_rgb.g + color_rgb.b) / 3.0f);
+        }
+        if (AI_SUCCESS == ai_material->Get(AI_MATKEY_ROUGHNESS_FACTOR, value))
+        {
+            material.SetRoughness(value);
+        }
+        if (AI_SUCCESS == ai_material->Get(AI_MATKEY_METALLIC_FACTOR, value))
+        {
+            material.SetMetallic(value);
+        }
+
+        /* The glTF alpha mode, or an opacity map of the other formats (OBJ map_d). */
+        aiString alpha_mode;
+
+        if ((AI_SUCCESS == ai_material->Get(AI_MATKEY_GLTF_ALPHAMODE, alpha_mode) && strcmp(alpha_mode.C_Str(), "MASK") == 0) ||
+            ai_material->GetTextureCount(aiTextureType_OPACITY) > 0)
+        {
+            material.SetAlphaMasked(true);
+        }
+    }
+
+    void StaticModel::SetMaterialHasMap(Material::TextureType texture_type, Material& material)
+    {
+        material.SetHasMap(texture_type, true);
+    }
+
+    bool StaticModel::LoadMaterials(const aiScene* scene, const std::filesystem::path& filepath)
+    {
+        std::string                 dir = GetModelDirectory(filepath);
+        std::vector<TextureRequest> requests;
+
+        for (uint32_t i = 0; i < scene->mNumMaterials; ++i)
+        {
+            auto ai_material = scene->mMaterials[i];
+
+            // Only one texture of a given type is being loaded
+            for (auto [ai_texture_type, texture_type] : MATERIAL_TEXTURE_TYPES)
+            {
+                aiString         path;
+                aiTextureMapMode texture_map_mode[3];
+
+                if (ai_material->GetTextureCount(ai_texture_type) == 0 ||
+                    ai_material->GetTexture(ai_texture_type, 0, &path, NULL, NULL, NULL, NULL, texture_map_mode) != AI_SUCCESS)
+                {
+                    continue;
+                }
+
+                const aiTexture* ai_texture = scene->GetEmbeddedTexture(path.C_Str());
+                const bool       is_srgb    = (ai_texture_type == aiTextureType_EMISSIVE) || (ai_texture_type == aiTextureType_BASE_COLOR);
+
+                requests.push_back({ i, texture_type, is_srgb, texture_map_mode[0] == aiTextureMapMode_Wrap, ai_texture ? path.C_Str() : GetTextureFilepath(dir, path), ai_texture });
+            }
+
+            /* Load material parameters */
+            LoadMaterialParams(ai_material, *m_materials[i]);
+        }
+
+        LoadTextures(requests, m_materials);
+
+        return true;
+    }
+
+    void StaticModel::LoadTextures(const std::vector<TextureRequest>& requests, const std::vector<std::shared_ptr<Material>>& materials)
+    {
+        struct Decode
+        {
+            const TextureRequest*      m_request;
+            ImageData                  m_metadata;
+            unsigned char*             m_data      = nullptr;
+            bool                       m_is_direct = false; /* Loaded by Texture2D::Load(). */
+            std::shared_ptr<Texture2D> m_texture;
+        };
+
+        /* The unique textures, requests[i] gets decodes[decode_indices[i]]. */
+        std::vector<Decode>                       decodes;
+        std::vector<uint32_t>                     decode_indices(requests.size());
+        std::unordered_map<std::string, uint32_t> unique_indices;
+
+        /* The decodes of the embedded textures, released when it drops to zero. */
+        std::unordered_map<const aiTexture*, uint32_t> embedded_users;
+
+        auto release_embedded = [&embedded_users](const TextureRequest& request)
+        {
+            if (request.m_embedded_texture && --embedded_users[request.m_embedded_texture] == 0)
+            {
+                ReleaseEmbeddedData(request.m_embedded_texture);
+            }
+        };
+
+        for (size_t i = 0; i < requests.size(); ++i)
+        {
+            const auto& request = requests[i];
+            const auto  key     = request.m_name + (request.m_is_srgb ? "|srgb|" : "|linear|") + std::to_string(uint32_t(GetMipmapFilter(request.m_texture_type)));
+
+            auto [it, is_new] = unique_indices.try_emplace(key, uint32_t(decodes.size()));
+            decode_indices[i] = it->second;
+
+            if (!is_new)
+            {
+                continue;
+            }
+
+            decodes.push_back({ &request });
+
+            if (request.m_embedded_texture)
+            {
+                /* The BCn blocks are uploaded as they are, Basis data is transcoded - neither is decoded to texels. */
+                decodes.back().m_is_direct = IsEmbeddedKtx2(request.m_embedded_texture);
+                embedded_users[request.m_embedded_texture]++;
+            }
+            else
+            {
+                /* Already loaded by another model - nothing to decode. */
+                decodes.back().m_texture = TextureCache::Find(request.m_name, request.m_is_srgb, 0, GetMipmapFilter(request.m_texture_type));
+
+                decodes.back().m_is_direct = !decodes.back().m_texture && !Texture2D::IsDecodedOnLoad(request.m_name);
+            }
+        }
+
+        /* The decodes report in the order they finish, the textures are created on this thread meanwhile. */
+        std::mutex              finished_mutex;
+        std::condition_variable finished_condition;
+        std::vector<uint32_t>   finished;
+        uint32_t                pending_count = 0;
+        JobSystem::Counter      counter;
+
+        for (uint32_t i = 0; i < decodes.size(); ++i)
+        {
+            if (decodes[i].m_texture || decodes[i].m_is_direct)
+            {
+                continue;
+            }
+
+            pending_count++;
+
+            JobSystem::Run([&decodes, &finished_mutex, &finished_condition, &finished, i]
+            {
+                auto& decode     = decodes[i];
+                auto  ai_texture = decode.m_request->m_embedded_texture;
+
+                if (ai_texture)
+                {
+                    const auto data = GetEmbeddedData(ai_texture);
+                    decode.m_data   = Util::LoadTextureData(const_cast<unsigned char*>(data.data()), uint32_t(data.size()), decode.m_metadata);
+                }
+                else
+                {
+                    decode.m_data = Util::LoadTextureData(decode.m_request->m_name, decode.m_metadata);
+                }
+
+                {
+                    std::lock_guard lock(finished_mutex);
+                    finished.push_back(i);
+                }
+
+                finished_condition.notify_one();
+            }, &counter);
+        }
+
+        for (auto& decode : decodes)
+        {
+            if (!decode.m_is_direct)
+            {
+                continue;
+            }
+
+            const auto& request = *decode.m_request;
+
+            if (request.m_embedded_texture)
+            {
+                const auto data    = GetEmbeddedData(request.m_embedded_texture);
+                auto       texture = std::make_shared<Texture2D>();
+
+                if (texture->LoadKtx2(data.data(), data.size(), request.m_is_srgb, request.m_name))
+                {
+                    decode.m_texture = texture;
+                    printf("Loaded texture '%s'\n", request.m_name.c_str());
+                }
+
+                release_embedded(request);
+            }
+            else
+            {
+                decode.m_texture = TextureCache::Load(request.m_name, request.m_is_srgb, 0, GetMipmapFilter(request.m_texture_type));
+            }
+        }
+
+        for (uint32_t created_count = 0; created_count < pending_count; ++created_count)
+        {
+            uint32_t index;
+
+            {
+                std::unique_lock lock(finished_mutex);
+                finished_condition.wait(lock, [&finished] { return !finished.empty(); });
+
+                index = finished.back();
+                finished.pop_back();
+            }
+
+            auto&       decode  = decodes[index];
+            const auto& request = *decode.m_request;
+
+            /* Decoded, the job doesn't read it anymore. */
+            release_embedded(request);
+
+            if (!decode.m_data)
+            {
+                continue;
+            }
+
+            auto texture = std::make_shared<Texture2D>();
+
+            if (texture->Create(decode.m_metadata, decode.m_data, request.m_is_srgb, 0, GetMipmapFilter(request.m_texture_type)))
+            {
+                /* The embedded ones belong to the model. */
+                decode.m_texture = request.m_embedded_texture ? texture : TextureCache::Add(request.m_name, request.m_is_srgb, 0, GetMipmapFilter(request.m_texture_type), texture);
+                printf("Loaded texture '%s'\n", request.m_name.c_str());
+            }
+
+            Util::ReleaseTextureData(decode.m_data);
+        }
+
+        JobSystem::Wait(counter);
+
+        for (size_t i = 0; i < requests.size(); ++i)
+        {
+            const auto& request = requests[i];
+            const auto& texture = decodes[decode_indices[i]].m_texture;
+
+            if (!texture)
+            {
+                fprintf(stderr, "Error loading texture %s.\n", request.m_name.c_str());
+            }
+            else
+            {
+                if (request.m_is_repeat)
+                {
+                    texture->SetWraping(RGL::TextureWrapingCoordinate::S, RGL::TextureWrapingParam::REPEAT);
+                    texture->SetWraping(RGL::TextureWrapingCoordinate::T, RGL::TextureWrapingParam::REPEAT);
+                }
+
+                materials[request.m_material_index]->AddTexture(request.m_texture_type, texture);
+            }
+
+            SetMaterialHasMap(request.m_texture_type, *materials[request.m_material_index]);
+        }
+    }
+
+    void StaticModel::CreateBuffers(VertexData& vertex_data)
+    {
+        if (m_is_pooling_enabled && CreatePooledBuffers(vertex_data))
+        {
+            return;
+        }
+
+        bool has_tangents = !vertex_data.tangents.empty();
+
+        const GLsizei positions_size_bytes = vertex_data.positions.size() * sizeof(vertex_data.positions[0]);
+        const GLsizei texcoords_size_bytes = vertex_data.texcoords.size() * sizeof(vertex_data.texcoords[0]);
+        const GLsizei normals_size_bytes   = vertex_data.normals  .size() * sizeof(vertex_data.normals  [0]);
+        const GLsizei tangents_size_bytes  = has_tangents ? vertex_data.tangents .size() * sizeof(vertex_data.tangents [0]) : 0;
+        const GLsizei total_size_bytes     = positions_size_bytes + texcoords_size_bytes + normals_size_bytes + tangents_size_bytes;
+
+        if (m_vertex_format == VertexFormat::PLANAR)
+        {
+            glCreateBuffers     (1, &m_vbo_name);
+            glNamedBufferStorage(m_vbo_name, total_size_bytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+            GpuMemory::TrackBuffer(m_vbo_name, "StaticModel");
+
+            uint64_t offset = 0;
+            glNamedBufferSubData(m_vbo_name, offset, positions_size_bytes, vertex_data.positions.data());
+
+            offset += positions_size_bytes;
+            glNamedBufferSubData(m_vbo_name, offset, texcoords_size_bytes, vertex_data.texcoords.data());
+
+            offset += texcoords_size_bytes;
+            glNamedBufferSubData(m_vbo_name, offset, normals_size_bytes, vertex_data.normals.data());
+
+            if(has_tangents)
+            {
+                offset += normals_size_bytes;
+                glNamedBufferSubData(m_vbo_name, offset, tangents_size_bytes, vertex_data.tangents.data());
+            }
+        }
+        else
+        {
+            auto vertices = PackVertices(vertex_data);
+
+            glCreateBuffers     (1, &m_vbo_name);
+            glNamedBufferStorage(m_vbo_name, vertices.size(), vertices.data(), GL_DYNAMIC_STORAGE_BIT);
+            GpuMemory::TrackBuffer(m_vbo_name, "StaticModel");
+        }
+
+        auto indices = PackIndices(vertex_data);
+
+        glCreateBuffers     (1, &m_ibo_name);
+        glNamedBufferStorage(m_ibo_name, indices.size(), indices.data(), GL_DYNAMIC_STORAGE_BIT);
+        GpuMemory::TrackBuffer(m_ibo_name, "StaticModel");
+
+        CreateVertexArray(positions_size_bytes, texcoords_size_bytes, normals_size_bytes, has_tangents);
+    }
+
+    void StaticModel::CreateVertexArray(GLsizei positions_size_bytes, GLsizei texcoords_size_bytes, GLsizei normals_size_bytes, bool has_tangents)
+    {
+        glCreateVertexArrays(1, &m_vao_name);
+        glVertexArrayElementBuffer(m_vao_name, m_ibo_name);
+
+                          glEnableVertexArrayAttrib(m_vao_name, 0 /*attribindex*/); // positions
+                          glEnableVertexArrayAttrib(m_vao_name, 1 /*attribindex*/); // texcoords
+                          glEnableVertexArrayAttrib(m_vao_name, 2 /*attribindex*/); // normals
+        if (has_tangents) glEnableVertexArrayAttrib(m_vao_name, 3 /*attribindex*/); // tangents
+
+        if (m_vertex_format == VertexFormat::PLANAR)
+        {
+            uint64_t offset = 0;
+            glVertexArrayVertexBuffer(m_vao_name, 0 /* bindingindex*/, m_vbo_name, offset, sizeof(glm::vec3) /*stride*/);
+                          
+            offset += positions_size_bytes;
+            glVertexArrayVertexBuffer(m_vao_name, 1 /* bindingindex*/, m_vbo_name, offset, sizeof(glm::vec2) /*stride*/);
+        
+            offset += texcoords_size_bytes;
+            glVertexArrayVertexBuffer(m_vao_name, 2 /* bindingindex*/, m_vbo_name,  offset, sizeof(glm::vec3) /*stride*/);
+
+            if (has_tangents)
+            {
+                offset += normals_size_bytes;
+                glVertexArrayVertexBuffer(m_vao_name, 3 /* bindingindex*/, m_vbo_name, offset, sizeof(glm::vec3) /*stride*/);
+            }
+
+                              glVertexArrayAttribFormat(m_vao_name, 0 /*attribindex */, 3 /* size */, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/); 
+                              glVertexArrayAttribFormat(m_vao_name, 1 /*attribindex */, 2 /* size */, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/); 
+                              glVertexArrayAttribFormat(m_vao_name, 2 /*attribindex */, 3 /* size */, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/); 
+            if (has_tangents) glVertexArrayAttribFormat(m_vao_name, 3 /*attribindex */, 3 /* size */, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/);
+
+                              glVertexArrayAttribBinding(m_vao_name, 0 /*attribindex*/, 0 /*bindingindex*/); // positions
+                              glVertexArrayAttribBinding(m_vao_name, 1 /*attribindex*/, 1 /*bindingindex*/); // texcoords
+                              glVertexArrayAttribBinding(m_vao_name, 2 /*attribindex*/, 2 /*bindingindex*/); // normals
+            if (has_tangents) glVertexArrayAttribBinding(m_vao_name, 3 /*attribindex*/, 3 /*bindingindex*/); // tangents
+        }
+        else
+        {
+            /* All the attributes come from the binding 0. */
+            glVertexArrayVertexBuffer(m_vao_name, 0 /* bindingindex*/, m_vbo_name, 0 /* offset */, GetVertexStride(has_tangents));
+
+            SetVertexAttribFormats(m_vao_name, m_vertex_format, has_tangents);
+        }
+
+        /* The positions are at the start of the buffer, and of every vertex, in all the formats. */
+        const GLsizei positions_stride = m_vertex_format == VertexFormat::PLANAR ? sizeof(glm::vec3) : GetVertexStride(has_tangents);
+
+        glCreateVertexArrays(1, &m_depth_vao_name);
+        glVertexArrayElementBuffer(m_depth_vao_name, m_ibo_name);
+        glVertexArrayVertexBuffer (m_depth_vao_name, 0 /* bindingindex*/, m_vbo_name, 0 /* offset */, positions_stride);
+        SetDepthAttribFormat(m_depth_vao_name);
+    }
+
+    void StaticModel::SetDepthAttribFormat(GLuint vao_name)
+    {
+        glEnableVertexArrayAttrib (vao_name, 0 /*attribindex*/); // positions
+        glVertexArrayAttribFormat (vao_name, 0 /*attribindex */, 3 /* size */, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/);
+        glVertexArrayAttribBinding(vao_name, 0 /*attribindex*/, 0 /*bindingindex*/);
+    }
+
+    void StaticModel::SetVertexAttribFormats(GLuint vao_name, VertexFormat format, bool has_tangents)
+    {
+                          glEnableVertexArrayAttrib(vao_name, 0 /*attribindex*/); // positions
+                          glEnableVertexArrayAttrib(vao_name, 1 /*attribindex*/); // texcoords
+                          glEnableVertexArrayAttrib(vao_name, 2 /*attribindex*/); // normals
+        if (has_tangents) glEnableVertexArrayAttrib(vao_name, 3 /*attribindex*/); // tangents
+
+        if (format == VertexFormat::INTERLEAVED)
+        {
+                              glVertexArrayAttribFormat(vao_name, 0 /*attribindex */, 3 /* size */, GL_FLOAT, GL_FALSE, 0  /*relativeoffset*/);
+                              glVertexArrayAttribFormat(vao_name, 1 /*attribindex */, 2 /* size */, GL_FLOAT, GL_FALSE, 12 /*relativeoffset*/);
+                              glVertexArrayAttribFormat(vao_name, 2 /*attribindex */, 3 /* size */, GL_FLOAT, GL_FALSE, 20 /*relativeoffset*/);
+            if (has_tangents) glVertexArrayAttribFormat(vao_name, 3 /*attribindex */, 3 /* size */, GL_FLOAT, GL_FALSE, 32 /*relativeoffset*/);
+        }
+        else
+        {
+                              glVertexArrayAttribFormat(vao_name, 0 /*attribindex */, 3 /* size */, GL_FLOAT,                GL_FALSE, 0  /*relativeoffset*/);
+                              glVertexArrayAttribFormat(vao_name, 1 /*attribindex */, 2 /* size */, GL_HALF_FLOAT,           GL_FALSE, 12 /*relativeoffset*/);
+                              glVertexArrayAttribFormat(vao_name, 2 /*attribindex */, 4 /* size */, GL_INT_2_10_10_10_REV,   GL_TRUE,  16 /*relativeoffset*/);
+            if (has_tangents) glVertexArrayAttribFormat(vao_name, 3 /*attribindex */, 4 /* size */, GL_INT_2_10_10_10_REV,   GL_TRUE,  20 /*relativeoffset*/);
+        }
+
+                          glVertexArrayAttribBinding(vao_name, 0 /*attribindex*/, 0 /*bindingindex*/); // positions
+                          glVertexArrayAttribBinding(vao_name, 1 /*attribindex*/, 0 /*bindingindex*/); // texcoords
+                          glVertexArrayAttribBinding(vao_name, 2 /*attribindex*/, 0 /*bindingindex*/); // normals
+        if (has_tangents) glVertexArrayAttribBinding(vao_name, 3 /*attribindex*/, 0 /*bindingindex*/); // tangents
+    }
+
+    uint32_t StaticModel::GetVertexStride(VertexFormat format, bool has_tangents)
+    {
+        switch (format)
+        {
+            case VertexFormat::INTERLEAVED:           return has_tangents ? 44 : 32;
+            case VertexFormat::INTERLEAVED_QUANTIZED: return has_tangents ? 24 : 20;
+            default:                                  return 0;
+        }
+    }
 
-            min = glm::min(min, vec3_cast(mesh->mAABB.mMin));
-            max = glm::max(max, vec3_cast(mesh->mAABB.mMax));
+    bool StaticModel::CreatePooledBuffers(const VertexData& vertex_data)
+    {
+        GeometryPool* pool = GeometryPool::Get(m_vertex_format, !vertex_data.tangents.empty());
+
+        if (!pool)
+        {
+            fprintf(stderr, "StaticModel::CreatePooledBuffers: the planar vertex format can't be pooled, using the model's own buffers.\n");
+            return false;
         }
 
-        m_unit_scale = 1.0f / glm::compMax(max - min);
+        auto vertices = PackVertices(vertex_data);
+        auto handle   = pool->Allocate(vertices.data(), uint32_t(vertex_data.positions.size()), vertex_data.indices.data(), uint32_t(vertex_data.indices.size()));
 
-        /* Load materials. */
-        if (!LoadMaterials(scene, filepath))
+        if (handle == GeometryPool::INVALID_HANDLE)
         {
-            fprintf(stderr, "Assimp error while loading mesh %s\n Error: Could not load the materials.\n", filepath.generic_string());
+            fprintf(stderr, "StaticModel::CreatePooledBuffers: the geometry pool is full, using the model's own buffers.\n");
             return false;
         }
 
-        /* Populate buffers on the GPU with the model's data. */
-        CreateBuffers(vertex_data);
+        m_geometry_pool      = pool;
+        m_pool_handle        = handle;
+        m_pool_generation    = INVALID_POOL_GENERATION;
+        m_pool_vertex_offset = 0;
+        m_pool_index_offset  = 0;
+        m_index_type         = GL_UNSIGNED_INT;
+        m_vao_name           = pool->GetVao();
+        m_depth_vao_name     = pool->GetDepthVao();
 
         return true;
     }
 
-    void StaticModel::LoadMeshPart(const aiMesh* mesh, VertexData& vertex_data)
+    void StaticModel::ReleasePooledGeometry()
     {
-        const glm::vec3 zero_vec3(0.0f, 0.0f, 0.0f);
-
-        for (uint32_t i = 0; i < mesh->mNumVertices; ++i)
+        if (m_geometry_pool)
         {
-            auto pos      = vec3_cast(mesh->mVertices[i]);
-            auto texcoord = mesh->HasTextureCoords(0)        ? vec3_cast(mesh->mTextureCoords[0][i]) : zero_vec3;
-            auto normal   = mesh->HasNormals()               ? vec3_cast(mesh->mNormals[i])          : zero_vec3;
-            auto tangent  = mesh->HasTangentsAndBitangents() ? vec3_cast(mesh->mTangents[i])         : zero_vec3;
-
-            vertex_data.positions.push_back(pos);
-            vertex_data.texcoords.push_back(glm::vec2(texcoord.x, texcoord.y));
-            vertex_data.normals.push_back(normal);
-            vertex_data.tangents.push_back(tangent);
+            m_geometry_pool->Free(m_pool_handle);
+            m_geometry_pool  = nullptr;
+            m_vao_name       = 0;
+            m_depth_vao_name = 0;
         }
+    }
 
-        for (uint32_t i = 0; i < mesh->mNumFaces; ++i)
+    void StaticModel::UpdatePooledGeometry()
+    {
+        if (m_geometry_pool && m_pool_generation != m_geometry_pool->GetGeneration())
         {
-            const aiFace& face = mesh->mFaces[i];
-            assert(face.mNumIndices == 3);
-
-            for (char i = 0; i < face.mNumIndices; ++i)
-            {
-                vertex_data.indices.push_back(face.mIndices[i]);
-            }
+            RebasePooledGeometry();
         }
     }
 
-    bool StaticModel::LoadMaterials(const aiScene* scene, const std::filesystem::path& filepath)
+    void StaticModel::RebasePooledGeometry()
     {
-        // Extract the directory part from the file name
-        std::string::size_type last_slash_index = filepath.generic_string().rfind("/");
-        std::string dir;
-
-        if (last_slash_index == std::string::npos)
-        {
-            dir = ".";
-        }
-        else if (last_slash_index == 0)
-        {
-            dir = "/";
-        }
-        else
-        {
-            dir = filepath.generic_string().substr(0, last_slash_index);
-        }
+        const auto& allocation = m_geometry_pool->GetAllocation(m_pool_handle);
 
-        bool ret = true;
+        /* Unsigned wrap around gives the right result for the moves to the lower offsets too. */
+        const uint32_t vertex_delta = allocation.m_vertex_offset - m_pool_vertex_offset;
+        const uint32_t index_delta  = allocation.m_index_offset  - m_pool_index_offset;
 
-        for (uint32_t i = 0; i < scene->mNumMaterials; ++i)
+        for (auto& mesh_part : m_mesh_parts)
         {
-            auto pMaterial = scene->mMaterials[i];
+            mesh_part.m_base_vertex += vertex_delta;
+            mesh_part.m_base_index  += index_delta;
 
-            ret |= LoadMaterialTextures(scene, pMaterial, i, aiTextureType_BASE_COLOR,        Material::TextureType::ALBEDO,    dir);
-            ret |= LoadMaterialTextures(scene, pMaterial, i, aiTextureType_NORMALS,           Material::TextureType::NORMAL,    dir);
-            ret |= LoadMaterialTextures(scene, pMaterial, i, aiTextureType_EMISSIVE,          Material::TextureType::EMISSIVE,  dir);
-            ret |= LoadMaterialTextures(scene, pMaterial, i, aiTextureType_AMBIENT_OCCLUSION, Material::TextureType::AO,        dir);
-            ret |= LoadMaterialTextures(scene, pMaterial, i, aiTextureType_DIFFUSE_ROUGHNESS, Material::TextureType::ROUGHNESS, dir);
-            ret |= LoadMaterialTextures(scene, pMaterial, i, aiTextureType_METALNESS,         Material::TextureType::METALLIC,  dir);
-
-            /* Load material parameters */
-            aiColor3D color_rgb;
-            aiColor4D color_rgba;
-            float value;
-
-            if (AI_SUCCESS == pMaterial->Get(AI_MATKEY_BASE_COLOR, color_rgba))
-            {
-                m_materials[i]->AddVector3("u_albedo", glm::vec3(color_rgba.r, color_rgba.g, color_rgba.b));
-            }
-            if (AI_SUCCESS == pMaterial->Get(AI_MATKEY_COLOR_EMISSIVE, color_rgb))
-            {
-                m_materials[i]->AddVector3("u_emission", glm::vec3(color_rgb.r, color_rgb.g, color_rgb.b));
-            }
-            if (AI_SUCCESS == pMaterial->Get(AI_MATKEY_COLOR_AMBIENT, color_rgb))
-            {
-                m_materials[i]->AddFloat("u_ao", (color_rgb.r + color_rgb.g + color_rgb.b) / 3.0f);
-            }
-            if (AI_SUCCESS == pMaterial->Get(AI_MATKEY_ROUGHNESS_FACTOR, value))
-            {
-                m_materials[i]->AddFloat("u_roughness", value);
-            }
-            if (AI_SUCCESS == pMaterial->Get(AI_MATKEY_METALLIC_FACTOR, value))
+            for (uint32_t i = 0; i < mesh_part.m_lods_count; ++i)
             {
-                m_materials[i]->AddFloat("u_metallic", value);
+                mesh_part.m_lods[i].m_base_index += index_delta;
             }
         }
 
-        return ret;
+        for (auto& meshlet : m_meshlets)
+        {
+            meshlet.first_index += index_delta;
+            meshlet.base_vertex += vertex_delta;
+        }
+
+        m_pool_vertex_offset = allocation.m_vertex_offset;
+        m_pool_index_offset  = allocation.m_index_offset;
+        m_pool_generation    = m_geometry_pool->GetGeneration();
+        m_is_indirect_dirty  = true;
     }
 
-    bool StaticModel::LoadMaterialTextures(const aiScene* scene, const aiMaterial* material, uint32_t material_index, aiTextureType type, Material::TextureType texture_type, const std::string& directory) const
+    std::vector<uint8_t> StaticModel::PackVertices(const VertexData& vertex_data) const
     {
-        if (material->GetTextureCount(type) > 0)
+        const bool     has_tangents = !vertex_data.tangents.empty();
+        const uint32_t stride       = GetVertexStride(has_tangents);
+
+        std::vector<uint8_t> vertices(vertex_data.positions.size() * stride);
+        uint8_t*             dst = vertices.data();
+
+        for (size_t i = 0; i < vertex_data.positions.size(); ++i, dst += stride)
         {
-            aiString path;
-            aiTextureMapMode texture_map_mode[3];
-            
-            // Only one texture of a given type is being loaded
-            if (material->GetTexture(type, 0, &path, NULL, NULL, NULL, NULL, texture_map_mode) == AI_SUCCESS)
+            std::memcpy(dst, &vertex_data.positions[i], sizeof(glm::vec3));
+
+            if (m_vertex_format == VertexFormat::INTERLEAVED)
+            {
+                                  std::memcpy(dst + 12, &vertex_data.texcoords[i], sizeof(glm::vec2));
+                                  std::memcpy(dst + 20, &vertex_data.normals  [i], sizeof(glm::vec3));
+                if (has_tangents) std::memcpy(dst + 32, &vertex_data.tangents [i], sizeof(glm::vec3));
+            }
+            else
             {
-                bool is_srgb = (type == aiTextureType_DIFFUSE) || (type == aiTextureType_EMISSIVE) || (type == aiTextureType_BASE_COLOR);
+                uint32_t texcoord = glm::packHalf2x16(vertex_data.texcoords[i]);
+                uint32_t normal   = glm::packSnorm3x10_1x2(glm::vec4(glm::clamp(vertex_data.normals[i], -1.0f, 1.0f), 0.0f));
 
-                std::shared_ptr<Texture2D> texture = std::make_shared<Texture2D>();
-                const aiTexture* paiTexture = scene->GetEmbeddedTexture(path.C_Str());
+                std::memcpy(dst + 12, &texcoord, sizeof(uint32_t));
+                std::memcpy(dst + 16, &normal,   sizeof(uint32_t));
 
-                if (paiTexture)
-                {
-                    // Load embedded
-                    uint32_t data_size = paiTexture->mHeight > 0 ? paiTexture->mWidth * paiTexture->mHeight : paiTexture->mWidth;
-                    
-                    if (texture->Load(reinterpret_cast<unsigned char*>(paiTexture->pcData), data_size, is_srgb))
-                    {
-                        printf("Loaded embedded texture for the model '%s'\n", path.C_Str());
-                        m_materials[material_index]->AddTexture(texture_type, texture);
-
-                        if (texture_map_mode[0] == aiTextureMapMode_Wrap)
-                        {
-                            texture->SetWraping(RGL::TextureWrapingCoordinate::S, RGL::TextureWrapingParam::REPEAT);
-                            texture->SetWraping(RGL::TextureWrapingCoordinate::T, RGL::TextureWrapingParam::REPEAT);
-                        }
-                    }
-                    else
-                    {
-                        fprintf(stderr, "Error loading embedded texture for the model %s.\n", path.C_Str());
-                        return false;
-                    }
-                }
-                else
+                if (has_tangents)
                 {
-                    // Load from file
-                    std::string p(path.data);
-
-                    if (p.substr(0, 2) == ".\\")
-                    {
-                        p = p.substr(2, p.size() - 2);
-                    }
-
-                    std::string full_path = directory + "/" + p;
-                    if (!texture->Load(full_path, is_srgb))
-                    {
-                        fprintf(stderr, "Error loading texture %s.\n", full_path.c_str());
-                        return false;
-                    }
-                    else
-                    {
-                        printf("Loaded texture '%s'\n", full_path.c_str());
-                        m_materials[material_index]->AddTexture(texture_type, texture);
-
-                        if (texture_map_mode[0] == aiTextureMapMode_Wrap)
-                        {
-                            texture->SetWraping(RGL::TextureWrapingCoordinate::S, RGL::TextureWrapingParam::REPEAT);
-                            texture->SetWraping(RGL::TextureWrapingCoordinate::T, RGL::TextureWrapingParam::REPEAT);
-                        }
-                    }
+                    uint32_t tangent = glm::packSnorm3x10_1x2(glm::vec4(glm::clamp(vertex_data.tangents[i], -1.0f, 1.0f), 0.0f));
+                    std::memcpy(dst + 20, &tangent, sizeof(uint32_t));
                 }
             }
-
-            if (texture_type == Material::TextureType::ALBEDO)    m_materials[material_index]->AddBool("u_has_albedo_map",    true);
-            if (texture_type == Material::TextureType::NORMAL)    m_materials[material_index]->AddBool("u_has_normal_map",    true);
-            if (texture_type == Material::TextureType::EMISSIVE)  m_materials[material_index]->AddBool("u_has_emissive_map",  true);
-            if (texture_type == Material::TextureType::AO)        m_materials[material_index]->AddBool("u_has_ao_map",        true);
-            if (texture_type == Material::TextureType::METALLIC)  m_materials[material_index]->AddBool("u_has_metallic_map",  true);
-            if (texture_type == Material::TextureType::ROUGHNESS) m_materials[material_index]->AddBool("u_has_roughness_map", true);
         }
 
-        return true;
+        return vertices;
     }
 
-    void StaticModel::CreateBuffers(VertexData& vertex_data)
+    std::vector<uint8_t> StaticModel::PackIndices(const VertexData& vertex_data)
     {
-        bool has_tangents = !vertex_data.tangents.empty();
-
-        const GLsizei positions_size_bytes = vertex_data.positions.size() * sizeof(vertex_data.positions[0]);
-        const GLsizei texcoords_size_bytes = vertex_data.texcoords.size() * sizeof(vertex_data.texcoords[0]);
-        const GLsizei normals_size_bytes   = vertex_data.normals  .size() * sizeof(vertex_data.normals  [0]);
-        const GLsizei tangents_size_bytes  = has_tangents ? vertex_data.tangents .size() * sizeof(vertex_data.tangents [0]) : 0;
-        const GLsizei total_size_bytes     = positions_size_bytes + texcoords_size_bytes + normals_size_bytes + tangents_size_bytes;
+        const auto& indices = vertex_data.indices;
 
-        glCreateBuffers     (1, &m_vbo_name);
-        glNamedBufferStorage(m_vbo_name, total_size_bytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+        /* Indices are relative to the mesh part's base vertex, so the largest index decides. With the strips 0xFFFF is the restart. */
+        const uint32_t max_index = m_has_primitive_restart ? 0xFFFE : 0xFFFF;
 
-        uint64_t offset = 0;
-        glNamedBufferSubData(m_vbo_name, offset, positions_size_bytes, vertex_data.positions.data());
+        bool fits_16bit = m_vertex_format == VertexFormat::INTERLEAVED_QUANTIZED && 
+                          std::all_of(indices.begin(), indices.end(), [&](uint32_t index) { return index <= max_index || (m_has_primitive_restart && index == PRIMITIVE_RESTART_INDEX); });
 
-        offset += positions_size_bytes;
-        glNamedBufferSubData(m_vbo_name, offset, texcoords_size_bytes, vertex_data.texcoords.data());
+        m_index_type = fits_16bit ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 
-        offset += texcoords_size_bytes;
-        glNamedBufferSubData(m_vbo_name, offset, normals_size_bytes, vertex_data.normals.data());
+        std::vector<uint8_t> data(indices.size() * GetIndexSize());
 
-        if(has_tangents)
+        if (fits_16bit)
         {
-            offset += normals_size_bytes;
-            glNamedBufferSubData(m_vbo_name, offset, tangents_size_bytes, vertex_data.tangents.data());
-        }
-
-        glCreateBuffers     (1, &m_ibo_name);
-        glNamedBufferStorage(m_ibo_name, sizeof(vertex_data.indices[0]) * vertex_data.indices.size(), vertex_data.indices.data(), GL_DYNAMIC_STORAGE_BIT);
-
-        glCreateVertexArrays(1, &m_vao_name);
+            uint16_t* dst = reinterpret_cast<uint16_t*>(data.data());
 
-        offset = 0;
-        glVertexArrayVertexBuffer(m_vao_name, 0 /* bindingindex*/, m_vbo_name, offset, sizeof(vertex_data.positions[0]) /*stride*/);
-                          
-        offset += positions_size_bytes;
-        glVertexArrayVertexBuffer(m_vao_name, 1 /* bindingindex*/, m_vbo_name, offset, sizeof(vertex_data.texcoords[0]) /*stride*/);
-        
-        offset += texcoords_size_bytes;
-        glVertexArrayVertexBuffer(m_vao_name, 2 /* bindingindex*/, m_vbo_name,  offset, sizeof(vertex_data.normals[0]) /*stride*/);
-
-        if (has_tangents)
+            for (size_t i = 0; i < indices.size(); ++i)
+            {
+                dst[i] = uint16_t(indices[i]);
+            }
+        }
+        else
         {
-            offset += normals_size_bytes;
-            glVertexArrayVertexBuffer(m_vao_name, 3 /* bindingindex*/, m_vbo_name, offset, sizeof(vertex_data.tangents[0]) /*stride*/);
+            std::memcpy(data.data(), indices.data(), data.size());
         }
 
-        glVertexArrayElementBuffer(m_vao_name, m_ibo_name);
-
-                          glEnableVertexArrayAttrib(m_vao_name, 0 /*attribindex*/); // positions
-                          glEnableVertexArrayAttrib(m_vao_name, 1 /*attribindex*/); // texcoords
-                          glEnableVertexArrayAttrib(m_vao_name, 2 /*attribindex*/); // normals
-        if (has_tangents) glEnableVertexArrayAttrib(m_vao_name, 3 /*attribindex*/); // tangents
-
-                          glVertexArrayAttribFormat(m_vao_name, 0 /*attribindex */, 3 /* size */, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/); 
-                          glVertexArrayAttribFormat(m_vao_name, 1 /*attribindex */, 2 /* size */, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/); 
-                          glVertexArrayAttribFormat(m_vao_name, 2 /*attribindex */, 3 /* size */, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/); 
-        if (has_tangents) glVertexArrayAttribFormat(m_vao_name, 3 /*attribindex */, 3 /* size */, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/);
-
-                          glVertexArrayAttribBinding(m_vao_name, 0 /*attribindex*/, 0 /*bindingindex*/); // positions
-                          glVertexArrayAttribBinding(m_vao_name, 1 /*attribindex*/, 1 /*bindingindex*/); // texcoords
-                          glVertexArrayAttribBinding(m_vao_name, 2 /*attribindex*/, 2 /*bindingindex*/); // normals
-        if (has_tangents) glVertexArrayAttribBinding(m_vao_name, 3 /*attribindex*/, 3 /*bindingindex*/); // tangents
+        return data;
     }
 
     /* The first available input attribute index is 4. */
     void StaticModel::AddAttributeBuffer(GLuint attrib_index, GLuint binding_index, GLint format_size, GLenum data_type, GLuint buffer_id, GLsizei stride, GLuint divisor)
     {
-        if(m_vao_name)
+        if (m_geometry_pool)
+        {
+            fprintf(stderr, "StaticModel::AddAttributeBuffer: the VAO is shared by all the models in the geometry pool.\n");
+            return;
+        }
+
+        /* The instance attributes are available to the depth only draws as well. */
+        for (GLuint vao_name : { m_vao_name, m_depth_vao_name })
         {
-            glVertexArrayVertexBuffer  (m_vao_name, binding_index, buffer_id, 0 /*offset*/, stride);
-            glEnableVertexArrayAttrib  (m_vao_name, attrib_index);
-            glVertexArrayAttribFormat  (m_vao_name, attrib_index, format_size, data_type, GL_FALSE, 0 /*relativeoffset*/);
-            glVertexArrayAttribBinding (m_vao_name, attrib_index, binding_index);
-            glVertexArrayBindingDivisor(m_vao_name, binding_index, divisor);
+            if (vao_name)
+            {
+                glVertexArrayVertexBuffer  (vao_name, binding_index, buffer_id, 0 /*offset*/, stride);
+                glEnableVertexArrayAttrib  (vao_name, attrib_index);
+                glVertexArrayAttribFormat  (vao_name, attrib_index, format_size, data_type, GL_FALSE, 0 /*relativeoffset*/);
+                glVertexArrayAttribBinding (vao_name, attrib_index, binding_index);
+                glVertexArrayBindingDivisor(vao_name, binding_index, divisor);
+            }
         }
     }
 
@@ -463,42 +2635,48 @@ namespace RGL
             auto material_index = m_mesh_parts[mesh_id].m_material_index;
             m_materials[material_index]->AddTexture(texture_type, texture);
         }
+
+        /* The indirect batches are grouped by materials. */
+        m_is_indirect_dirty = true;
     }
 
     void StaticModel::CalcTangentSpace(VertexData& vertex_data)
     {
-        vertex_data.tangents.resize(vertex_data.positions.size());
-        std::fill(std::begin(vertex_data.tangents), std::end(vertex_data.tangents), glm::vec3(0.0f));
-
-        for(unsigned i = 0; i < vertex_data.indices.size(); i += 3)
-        {
-            auto i0 = vertex_data.indices[i];
-            auto i1 = vertex_data.indices[i + 1];
-            auto i2 = vertex_data.indices[i + 2];
+        const uint32_t vertices_count  = uint32_t(vertex_data.positions.size());
+        const size_t   triangles_count = vertex_data.indices.size() / 3;
 
-            auto edge1 = vertex_data.positions[i1] - vertex_data.positions[i0];
-            auto edge2 = vertex_data.positions[i2] - vertex_data.positions[i0];
+        vertex_data.tangents.resize(vertices_count);
 
-            auto delta_uv1 = vertex_data.texcoords[i1] - vertex_data.texcoords[i0];
-            auto delta_uv2 = vertex_data.texcoords[i2] - vertex_data.texcoords[i0];
+        /* A buffer per job, so the scattered writes of the jobs never overlap. */
+        const uint32_t buffers_count = vertices_count < PARALLEL_TANGENTS_MIN_VERTICES ? 1 : std::min(JobSystem::GetWorkersCount() + 1, MAX_TANGENT_BUFFERS);
 
-            float dividend = (delta_uv1.x * delta_uv2.y - delta_uv2.x * delta_uv1.y);
-            float f = dividend == 0.0f ? 0.0f : 1.0f / dividend;
+        std::vector<std::vector<glm::vec4>> buffers(buffers_count);
 
-            glm::vec3 tangent(0.0f);
-            tangent.x = f * (delta_uv2.y * edge1.x - delta_uv1.y * edge2.x);
-            tangent.y = f * (delta_uv2.y * edge1.y - delta_uv1.y * edge2.y);
-            tangent.z = f * (delta_uv2.y * edge1.z - delta_uv1.y * edge2.z);
+        JobSystem::ParallelFor(0, buffers_count, 1, [&](uint32_t buffer_begin, uint32_t buffer_end)
+        {
+            for (uint32_t b = buffer_begin; b < buffer_end; ++b)
+            {
+                buffers[b].assign(vertices_count, glm::vec4(0.0f));
 
-            vertex_data.tangents[i0] += tangent;
-            vertex_data.tangents[i1] += tangent;
-            vertex_data.tangents[i2] += tangent;
-        }
+                AccumulateTangents(vertex_data, triangles_count * b / buffers_count, triangles_count * (b + 1) / buffers_count, buffers[b].data());
+            }
+        });
 
-        for (unsigned i = 0; i < vertex_data.positions.size(); ++i)
+        /* Reduction. */
+        JobSystem::ParallelFor(0, vertices_count, 4096, [&](uint32_t vertex_begin, uint32_t vertex_end)
         {
-            vertex_data.tangents[i] = glm::normalize(vertex_data.tangents[i]);
-        }
+            for (uint32_t i = vertex_begin; i < vertex_end; ++i)
+            {
+                glm::vec4 tangent = buffers[0][i];
+
+                for (uint32_t b = 1; b < buffers_count; ++b)
+                {
+                    tangent += buffers[b][i];
+                }
+
+                vertex_data.tangents[i] = glm::normalize(glm::vec3(tangent));
+            }
+        });
     }
 
     void StaticModel::GenPrimitive(VertexData& vertex_data, bool generate_tangents)
@@ -521,7 +2699,160 @@ namespace RGL
         mesh_part.m_base_vertex  = 0;
         mesh_part.m_indices_count = vertex_data.indices.size();
 
+        if (!vertex_data.positions.empty())
+        {
+            glm::vec3 min = vertex_data.positions[0];
+            glm::vec3 max = vertex_data.positions[0];
+
+            for (const auto& position : vertex_data.positions)
+            {
+                min = glm::min(min, position);
+                max = glm::max(max, position);
+            }
+
+            mesh_part.m_bounds_center = 0.5f * (max + min);
+            mesh_part.m_bounds_radius = 0.5f * glm::length(max - min);
+        }
+
+        m_mesh_parts.push_back(mesh_part);
+
+        BuildBvh(m_mesh_parts, vertex_data, m_bvh);
+        CreateIndirectBuffers();
+    }
+
+    void StaticModel::GenGridTriangleStrips(uint32_t columns, uint32_t rows, std::vector<uint32_t>& indices)
+    {
+        indices.reserve(indices.size() + rows * (2 * (columns + 1) + 1));
+
+        for (uint32_t r = 0; r < rows; ++r)
+        {
+            if (r > 0)
+            {
+                indices.push_back(PRIMITIVE_RESTART_INDEX);
+            }
+
+            for (uint32_t c = 0; c <= columns; ++c)
+            {
+                indices.push_back(r       * (columns + 1) + c);
+                indices.push_back((r + 1) * (columns + 1) + c);
+            }
+        }
+    }
+
+    void StaticModel::GenGridLineStrips(uint32_t columns, uint32_t rows, std::vector<uint32_t>& indices)
+    {
+        indices.reserve(indices.size() + 2 * (columns + 1) * (rows + 1) + columns + rows + 1);
+
+        for (uint32_t r = 0; r <= rows; ++r)
+        {
+            for (uint32_t c = 0; c <= columns; ++c)
+            {
+                indices.push_back(r * (columns + 1) + c);
+            }
+
+            indices.push_back(PRIMITIVE_RESTART_INDEX);
+        }
+
+        for (uint32_t c = 0; c <= columns; ++c)
+        {
+            if (c > 0)
+            {
+                indices.push_back(PRIMITIVE_RESTART_INDEX);
+            }
+
+            for (uint32_t r = 0; r <= rows; ++r)
+            {
+                indices.push_back(r * (columns + 1) + c);
+            }
+        }
+    }
+
+    void StaticModel::GenStripPrimitive(VertexData& vertex_data, DrawMode draw_mode)
+    {
+        /* Release() resets the draw mode, GenPrimitive() doesn't release the empty model. */
+        if (m_vao_name)
+        {
+            Release();
+        }
+
+        m_draw_mode             = draw_mode;
+        m_has_primitive_restart = true;
+
+        GenPrimitive(vertex_data, false);
+    }
+
+    bool StaticModel::GenPrimitiveGpu(GpuPrimitive primitive, uint32_t columns, uint32_t rows, const glm::vec2& params, const glm::vec3& bounds_min, const glm::vec3& bounds_max)
+    {
+        if (!m_is_gpu_generation || m_is_strip_generation || m_is_pooling_enabled || m_vertex_format != VertexFormat::PLANAR || columns == 0 || rows == 0)
+        {
+            return false;
+        }
+
+        /* Used once per primitive, so it's not kept. */
+        auto shader = std::make_shared<Shader>("src/core/shaders/gen_primitive.comp");
+
+        if (!shader->link())
+        {
+            fprintf(stderr, "StaticModel: could not link the primitive generation shader, generating on the CPU.\n");
+            return false;
+        }
+
+        /* Release the previously loaded mesh if it was loaded. */
+        if (m_vao_name)
+        {
+            Release();
+        }
+
+        const bool     has_tangents   = primitive != GpuPrimitive::PLANE_GRID;
+        const uint32_t vertices_count = (columns + 1) * (rows + 1);
+        const uint32_t indices_count  = columns * rows * (primitive == GpuPrimitive::PLANE_GRID ? 8 : 6);
+
+        const GLsizei positions_size_bytes = vertices_count * sizeof(glm::vec3);
+        const GLsizei texcoords_size_bytes = vertices_count * sizeof(glm::vec2);
+        const GLsizei normals_size_bytes   = vertices_count * sizeof(glm::vec3);
+        const GLsizei tangents_size_bytes  = has_tangents ? vertices_count * sizeof(glm::vec3) : 0;
+        const GLsizei total_size_bytes     = positions_size_bytes + texcoords_size_bytes + normals_size_bytes + tangents_size_bytes;
+
+        glCreateBuffers     (1, &m_vbo_name);
+        glNamedBufferStorage(m_vbo_name, total_size_bytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+        GpuMemory::TrackBuffer(m_vbo_name, "StaticModel");
+
+        glCreateBuffers     (1, &m_ibo_name);
+        glNamedBufferStorage(m_ibo_name, indices_count * sizeof(uint32_t), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        GpuMemory::TrackBuffer(m_ibo_name, "StaticModel");
+
+        m_index_type = GL_UNSIGNED_INT;
+
+        shader->bind();
+        shader->setUniform("u_primitive",        uint32_t(primitive));
+        shader->setUniform("u_columns",          columns);
+        shader->setUniform("u_rows",             rows);
+        shader->setUniform("u_params",           params);
+        shader->setUniform("u_texcoords_offset", GLuint(positions_size_bytes / sizeof(float)));
+        shader->setUniform("u_normals_offset",   GLuint((positions_size_bytes + texcoords_size_bytes) / sizeof(float)));
+        shader->setUniform("u_tangents_offset",  GLuint((positions_size_bytes + texcoords_size_bytes + normals_size_bytes) / sizeof(float)));
+        shader->setUniform("u_has_tangents",     has_tangents);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GEN_PRIMITIVE_VERTICES_SSBO_BINDING_INDEX, m_vbo_name);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GEN_PRIMITIVE_INDICES_SSBO_BINDING_INDEX,  m_ibo_name);
+
+        glDispatchCompute((columns + PRIMITIVE_GROUP_SIZE) / PRIMITIVE_GROUP_SIZE, rows + 1, 1);
+        glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT);
+
+        CreateVertexArray(positions_size_bytes, texcoords_size_bytes, normals_size_bytes, has_tangents);
+
+        MeshPart mesh_part;
+        mesh_part.m_base_index    = 0;
+        mesh_part.m_base_vertex   = 0;
+        mesh_part.m_indices_count = indices_count;
+        mesh_part.m_bounds_center = 0.5f * (bounds_max + bounds_min);
+        mesh_part.m_bounds_radius = 0.5f * glm::length(bounds_max - bounds_min);
+
         m_mesh_parts.push_back(mesh_part);
+
+        CreateIndirectBuffers();
+
+        return true;
     }
 
     void StaticModel::GenCone(float height, float radius, uint32_t slices, uint32_t stacks)
@@ -870,6 +3201,13 @@ namespace RGL
 
     void StaticModel::GenPlane(float width, float height, uint32_t slices, uint32_t stacks)
     {
+        const glm::vec3 half_extents(0.5f * width, 0.0f, 0.5f * height);
+
+        if (GenPrimitiveGpu(GpuPrimitive::PLANE, slices, stacks, glm::vec2(width, height), -half_extents, half_extents))
+        {
+            return;
+        }
+
         VertexData vertex_data;
 
         float widthInc  = width  / float(slices);
@@ -909,12 +3247,31 @@ namespace RGL
             ++idx;
         }
 
-        GenPrimitive(vertex_data);    }
+        if (m_is_strip_generation)
+        {
+            CalcTangentSpace(vertex_data);
+
+            vertex_data.indices.clear();
+            GenGridTriangleStrips(slices, stacks, vertex_data.indices);
+            GenStripPrimitive(vertex_data, DrawMode::TRIANGLE_STRIP);
+
+            return;
+        }
+
+        GenPrimitive(vertex_data);
+    }
 
     void StaticModel::GenPlaneGrid(float width, float height, uint32_t slices, uint32_t stacks)
     {
         m_draw_mode = DrawMode::LINES;
 
+        const glm::vec3 half_extents(0.5f * width, 0.0f, 0.5f * height);
+
+        if (GenPrimitiveGpu(GpuPrimitive::PLANE_GRID, slices, stacks, glm::vec2(width, height), -half_extents, half_extents))
+        {
+            return;
+        }
+
         VertexData vertex_data;
 
         float widthInc = width / float(slices);
@@ -934,6 +3291,14 @@ namespace RGL
             w = -width * 0.5f;
         }
 
+        if (m_is_strip_generation)
+        {
+            GenGridLineStrips(slices, stacks, vertex_data.indices);
+            GenStripPrimitive(vertex_data, DrawMode::LINE_STRIP);
+
+            return;
+        }
+
         uint32_t idx = 0;
 
         for (uint32_t j = 0; j < stacks; ++j)
@@ -962,6 +3327,11 @@ namespace RGL
 
     void StaticModel::GenSphere(float radius, uint32_t slices)
     {
+        if (GenPrimitiveGpu(GpuPrimitive::SPHERE, slices, uint32_t(slices * 0.5f), glm::vec2(radius, 0.0f), glm::vec3(-radius), glm::vec3(radius)))
+        {
+            return;
+        }
+
         VertexData vertex_data;
 
         float deltaPhi = glm::two_pi<float>() / static_cast<float>(slices);
@@ -997,11 +3367,31 @@ namespace RGL
             }
         }
 
+        if (m_is_strip_generation)
+        {
+            CalcTangentSpace(vertex_data);
+
+            vertex_data.indices.clear();
+            GenGridTriangleStrips(slices, parallels, vertex_data.indices);
+            GenStripPrimitive(vertex_data, DrawMode::TRIANGLE_STRIP);
+
+            return;
+        }
+
         GenPrimitive(vertex_data);
     }
 
     void StaticModel::GenTorus(float innerRadius, float outerRadius, uint32_t slices, uint32_t stacks)
     {
+        const float     tube_radius = (outerRadius - innerRadius) * 0.5f;
+        const glm::vec3 half_extents(outerRadius, outerRadius, tube_radius);
+
+        /* Rows go around the center (slices), columns around the tube (stacks). */
+        if (GenPrimitiveGpu(GpuPrimitive::TORUS, stacks, slices, glm::vec2(outerRadius - tube_radius, tube_radius), -half_extents, half_extents))
+        {
+            return;
+        }
+
         VertexData vertex_data;
 
         float phi   = 0.0f;
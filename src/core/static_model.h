@@ -1,6 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <filesystem>
+#include <future>
 #include <memory>
 
 #include <glm/gtc/quaternion.hpp>
@@ -10,12 +12,19 @@
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 
+#include "core_shared.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
 #include "mesh_part.h"
 #include "material.h"
+#include "mesh_bvh.h"
 #include "shader.h"
 
 namespace RGL
 {
+    class GeometryPool;
+    class GpuCulling;
+
     struct VertexData
     {
         std::vector<glm::vec3> positions;
@@ -25,8 +34,33 @@ namespace RGL
         std::vector<uint32_t>  indices;
     };
 
+    /* Layout defined by the OpenGL specification for glMultiDrawElementsIndirect. */
+    struct DrawElementsIndirectCommand
+    {
+        uint32_t m_count;
+        uint32_t m_instance_count;
+        uint32_t m_first_index;
+        int32_t  m_base_vertex;
+        uint32_t m_base_instance;
+    };
+
+    /*
+     * Vertex buffer layouts. Attribute locations are the same for all of them:
+     * 0 - position, 1 - texcoord, 2 - normal, 3 - tangent.
+     *
+     * PLANAR                - separate float streams (44 bytes per vertex)
+     * INTERLEAVED           - interleaved float attributes (44 bytes per vertex)
+     * INTERLEAVED_QUANTIZED - float positions, half-float texcoords, 10_10_10_2 snorm normals and tangents (24 bytes per vertex)
+     *                         and 16-bit indices when every mesh part has less than 65536 vertices.
+     */
+    enum class VertexFormat { PLANAR, INTERLEAVED, INTERLEAVED_QUANTIZED };
+
+    /* Ends a strip with GL_PRIMITIVE_RESTART_FIXED_INDEX, the 16-bit index buffers store it as 0xffff. */
+    constexpr static uint32_t PRIMITIVE_RESTART_INDEX = 0xffffffff;
+
     enum class DrawMode { POINTS         = GL_POINTS, 
                           LINES          = GL_LINES, 
+                          LINE_STRIP     = GL_LINE_STRIP,
                           TRIANGLES      = GL_TRIANGLES, 
                           TRIANGLE_STRIP = GL_TRIANGLE_STRIP,
                           PATCHES        = GL_PATCHES };
@@ -35,11 +69,42 @@ namespace RGL
     {
     public:
         StaticModel()
-            : m_unit_scale(1),
-              m_vao_name  (0),
-              m_vbo_name  (0),
-              m_ibo_name  (0),
-              m_draw_mode (DrawMode::TRIANGLES)
+            : m_unit_scale              (1),
+              m_vao_name                (0),
+              m_depth_vao_name          (0),
+              m_vbo_name                (0),
+              m_ibo_name                (0),
+              m_indirect_buffer_name    (0),
+              m_draw_data_ssbo_name     (0),
+              m_indirect_instances_count(1),
+              m_is_indirect_dirty       (true),
+              m_is_bindless_enabled     (false),
+              m_is_mesh_optimized       (false),
+              m_is_indirect_lod_dirty   (false),
+              m_lods_count              (1),
+              m_lod_threshold           (256.0f),
+              m_is_meshlets_enabled     (false),
+              m_meshlets_ssbo_name      (0),
+              m_meshlet_template_name   (0),
+              m_meshlet_batches_name    (0),
+              m_meshlet_commands_name   (0),
+              m_culled_meshlets_count   (0),
+              m_is_bvh_enabled          (false),
+              m_is_pooling_enabled      (false),
+              m_geometry_pool           (nullptr),
+              m_pool_handle             (0),
+              m_pool_generation         (0),
+              m_pool_vertex_offset      (0),
+              m_pool_index_offset       (0),
+              m_is_gpu_generation     (false),
+              m_is_strip_generation     (false),
+              m_has_primitive_restart   (false),
+              m_occlusion_query_name    (0),
+              m_is_conditional_rendering(false),
+              m_is_occlusion_query_valid(false),
+              m_vertex_format           (VertexFormat::PLANAR),
+              m_index_type              (GL_UNSIGNED_INT),
+              m_draw_mode               (DrawMode::TRIANGLES)
         {
         }
 
@@ -49,19 +114,89 @@ namespace RGL
         StaticModel& operator=(const StaticModel&) = delete;
 
         StaticModel(StaticModel&& other) noexcept
-            : m_mesh_parts(std::move(other.m_mesh_parts)),
-              m_materials  (std::move(other.m_materials)),
-              m_unit_scale(other.m_unit_scale),
-              m_vao_name  (other.m_vao_name),
-              m_vbo_name  (other.m_vbo_name),
-              m_ibo_name  (other.m_ibo_name),
-              m_draw_mode (other.m_draw_mode)
+            : m_mesh_parts              (std::move(other.m_mesh_parts)),
+              m_materials               (std::move(other.m_materials)),
+              m_indirect_commands       (std::move(other.m_indirect_commands)),
+              m_indirect_batches        (std::move(other.m_indirect_batches)),
+              m_indirect_mesh_parts     (std::move(other.m_indirect_mesh_parts)),
+              m_meshlets                (std::move(other.m_meshlets)),
+              m_meshlet_batches         (std::move(other.m_meshlet_batches)),
+              m_meshlet_cull_shader     (std::move(other.m_meshlet_cull_shader)),
+              m_occlusion_box_shader    (std::move(other.m_occlusion_box_shader)),
+              m_bvh                     (std::move(other.m_bvh)),
+              m_async_load              (std::move(other.m_async_load)),
+              m_unit_scale              (other.m_unit_scale),
+              m_vao_name                (other.m_vao_name),
+              m_depth_vao_name          (other.m_depth_vao_name),
+              m_vbo_name                (other.m_vbo_name),
+              m_ibo_name                (other.m_ibo_name),
+              m_indirect_buffer_name    (other.m_indirect_buffer_name),
+              m_draw_data_ssbo_name     (other.m_draw_data_ssbo_name),
+              m_indirect_instances_count(other.m_indirect_instances_count),
+              m_is_indirect_dirty       (other.m_is_indirect_dirty),
+              m_is_bindless_enabled     (other.m_is_bindless_enabled),
+              m_is_mesh_optimized       (other.m_is_mesh_optimized),
+              m_is_indirect_lod_dirty   (other.m_is_indirect_lod_dirty),
+              m_lods_count              (other.m_lods_count),
+              m_lod_threshold           (other.m_lod_threshold),
+              m_is_meshlets_enabled     (other.m_is_meshlets_enabled),
+              m_meshlets_ssbo_name      (other.m_meshlets_ssbo_name),
+              m_meshlet_template_name   (other.m_meshlet_template_name),
+              m_meshlet_batches_name    (other.m_meshlet_batches_name),
+              m_meshlet_commands_name   (other.m_meshlet_commands_name),
+              m_culled_meshlets_count   (other.m_culled_meshlets_count),
+              m_is_bvh_enabled          (other.m_is_bvh_enabled),
+              m_is_pooling_enabled      (other.m_is_pooling_enabled),
+              m_geometry_pool           (other.m_geometry_pool),
+              m_pool_handle             (other.m_pool_handle),
+              m_pool_generation         (other.m_pool_generation),
+              m_pool_vertex_offset      (other.m_pool_vertex_offset),
+              m_pool_index_offset       (other.m_pool_index_offset),
+              m_is_gpu_generation     (other.m_is_gpu_generation),
+              m_is_strip_generation     (other.m_is_strip_generation),
+              m_has_primitive_restart   (other.m_has_primitive_restart),
+              m_occlusion_query_name    (other.m_occlusion_query_name),
+              m_is_conditional_rendering(other.m_is_conditional_rendering),
+              m_is_occlusion_query_valid(other.m_is_occlusion_query_valid),
+              m_vertex_format           (other.m_vertex_format),
+              m_index_type              (other.m_index_type),
+              m_draw_mode               (other.m_draw_mode)
         {
-            other.m_unit_scale = 1;
-            other.m_vao_name   = 0;
-            other.m_vbo_name   = 0;
-            other.m_ibo_name   = 0;
-            other.m_draw_mode  = DrawMode::TRIANGLES;
+            other.m_unit_scale               = 1;
+            other.m_vao_name                 = 0;
+            other.m_depth_vao_name           = 0;
+            other.m_vbo_name                 = 0;
+            other.m_ibo_name                 = 0;
+            other.m_indirect_buffer_name     = 0;
+            other.m_draw_data_ssbo_name      = 0;
+            other.m_indirect_instances_count = 1;
+            other.m_is_indirect_dirty        = true;
+            other.m_is_bindless_enabled      = false;
+            other.m_is_mesh_optimized        = false;
+            other.m_is_indirect_lod_dirty    = false;
+            other.m_lods_count               = 1;
+            other.m_lod_threshold            = 256.0f;
+            other.m_is_meshlets_enabled      = false;
+            other.m_meshlets_ssbo_name       = 0;
+            other.m_meshlet_template_name    = 0;
+            other.m_meshlet_batches_name     = 0;
+            other.m_meshlet_commands_name    = 0;
+            other.m_culled_meshlets_count    = 0;
+            other.m_is_bvh_enabled           = false;
+            other.m_is_pooling_enabled       = false;
+            other.m_geometry_pool            = nullptr;
+            other.m_is_gpu_generation        = false;
+            other.m_is_strip_generation      = false;
+            other.m_has_primitive_restart    = false;
+            other.m_occlusion_query_name     = 0;
+            other.m_is_conditional_rendering = false;
+            other.m_is_occlusion_query_valid = false;
+            other.m_vertex_format            = VertexFormat::PLANAR;
+            other.m_index_type               = GL_UNSIGNED_INT;
+            other.m_draw_mode                = DrawMode::TRIANGLES;
+
+            /* The import worker calls the functions of other, it has to finish before other is destroyed. */
+            WaitForAsyncImport();
         }
 
         StaticModel& operator=(StaticModel&& other) noexcept
@@ -70,13 +205,55 @@ namespace RGL
             {
                 Release();
 
-                std::swap(m_mesh_parts, other.m_mesh_parts);
-                std::swap(m_materials,  other.m_materials);
-                std::swap(m_unit_scale, other.m_unit_scale);
-                std::swap(m_vao_name,   other.m_vao_name);
-                std::swap(m_vbo_name,   other.m_vbo_name);
-                std::swap(m_ibo_name,   other.m_ibo_name);
-                std::swap(m_draw_mode,  other.m_draw_mode);
+                std::swap(m_mesh_parts,               other.m_mesh_parts);
+                std::swap(m_materials,                other.m_materials);
+                std::swap(m_indirect_commands,        other.m_indirect_commands);
+                std::swap(m_indirect_batches,         other.m_indirect_batches);
+                std::swap(m_indirect_mesh_parts,      other.m_indirect_mesh_parts);
+                std::swap(m_meshlets,                 other.m_meshlets);
+                std::swap(m_meshlet_batches,          other.m_meshlet_batches);
+                std::swap(m_meshlet_cull_shader,      other.m_meshlet_cull_shader);
+                std::swap(m_occlusion_box_shader,     other.m_occlusion_box_shader);
+                std::swap(m_bvh,                      other.m_bvh);
+                std::swap(m_async_load,               other.m_async_load);
+                std::swap(m_unit_scale,               other.m_unit_scale);
+                std::swap(m_vao_name,                 other.m_vao_name);
+                std::swap(m_depth_vao_name,           other.m_depth_vao_name);
+                std::swap(m_vbo_name,                 other.m_vbo_name);
+                std::swap(m_ibo_name,                 other.m_ibo_name);
+                std::swap(m_indirect_buffer_name,     other.m_indirect_buffer_name);
+                std::swap(m_draw_data_ssbo_name,      other.m_draw_data_ssbo_name);
+                std::swap(m_indirect_instances_count, other.m_indirect_instances_count);
+                std::swap(m_is_indirect_dirty,        other.m_is_indirect_dirty);
+                std::swap(m_is_bindless_enabled,      other.m_is_bindless_enabled);
+                std::swap(m_is_mesh_optimized,        other.m_is_mesh_optimized);
+                std::swap(m_is_indirect_lod_dirty,    other.m_is_indirect_lod_dirty);
+                std::swap(m_lods_count,               other.m_lods_count);
+                std::swap(m_lod_threshold,            other.m_lod_threshold);
+                std::swap(m_is_meshlets_enabled,      other.m_is_meshlets_enabled);
+                std::swap(m_meshlets_ssbo_name,       other.m_meshlets_ssbo_name);
+                std::swap(m_meshlet_template_name,    other.m_meshlet_template_name);
+                std::swap(m_meshlet_batches_name,     other.m_meshlet_batches_name);
+                std::swap(m_meshlet_commands_name,    other.m_meshlet_commands_name);
+                std::swap(m_culled_meshlets_count,    other.m_culled_meshlets_count);
+                std::swap(m_is_bvh_enabled,           other.m_is_bvh_enabled);
+                std::swap(m_is_pooling_enabled,       other.m_is_pooling_enabled);
+                std::swap(m_geometry_pool,            other.m_geometry_pool);
+                std::swap(m_pool_handle,              other.m_pool_handle);
+                std::swap(m_pool_generation,          other.m_pool_generation);
+                std::swap(m_pool_vertex_offset,       other.m_pool_vertex_offset);
+                std::swap(m_pool_index_offset,        other.m_pool_index_offset);
+                std::swap(m_is_gpu_generation,        other.m_is_gpu_generation);
+                std::swap(m_is_strip_generation,      other.m_is_strip_generation);
+                std::swap(m_has_primitive_restart,    other.m_has_primitive_restart);
+                std::swap(m_occlusion_query_name,     other.m_occlusion_query_name);
+                std::swap(m_is_conditional_rendering, other.m_is_conditional_rendering);
+                std::swap(m_is_occlusion_query_valid, other.m_is_occlusion_query_valid);
+                std::swap(m_vertex_format,            other.m_vertex_format);
+                std::swap(m_index_type,               other.m_index_type);
+                std::swap(m_draw_mode,                other.m_draw_mode);
+
+                WaitForAsyncImport();
             }
 
             return *this;
@@ -86,12 +263,192 @@ namespace RGL
         virtual void AddTexture(const std::shared_ptr<Texture2D> & texture, Material::TextureType texture_type = Material::TextureType::ALBEDO, uint32_t mesh_id = 0);
         
         virtual void SetDrawMode(DrawMode mode) { m_draw_mode = mode; }
+
+        /* Has to be set before Load() or Gen*(). */
+        virtual void         SetVertexFormat(VertexFormat format) { m_vertex_format = format; }
+        virtual VertexFormat GetVertexFormat() const              { return m_vertex_format; }
+
+        /*
+         * Has to be set before Load(). Reorders the triangles of every mesh part for the post-transform vertex cache
+         * and overdraw, then the vertices for fetch locality. ACMR before and after is printed to stdout.
+         */
+        virtual void SetMeshOptimization(bool enable) { m_is_mesh_optimized = enable; }
+        virtual bool IsMeshOptimizationEnabled() const { return m_is_mesh_optimized; }
+
+        /*
+         * Has to be set before Load(). Generates up to lods_count - 1 simplified index ranges per mesh part in the same
+         * index buffer (quadric error metrics), each with about half of the previous level's triangles.
+         * Primitives and animated models have no LODs.
+         */
+        virtual void     SetLodsCount(uint32_t lods_count) { m_lods_count = std::clamp(lods_count, 1u, MAX_LODS_COUNT); }
+        virtual uint32_t GetLodsCount() const              { return m_lods_count; }
+
+        /* Projected bounding sphere radius (pixels) below which LOD 1 is used. Every next LOD starts at half of the previous radius. */
+        virtual void SetLodThreshold(float radius_pixels) { m_lod_threshold = radius_pixels; }
+
+        /*
+         * Selects the LOD of every mesh part from its bounding sphere transformed by the model matrix.
+         * projection_scale = 0.5 * viewport_height / tan(0.5 * fovy), i.e. 0.5 * viewport_height * projection[1][1].
+         * Used by the next Render() and RenderIndirect() calls.
+         */
+        virtual void SelectLods(const glm::mat4& model, const glm::vec3& camera_position, float projection_scale);
+
+        /*
+         * Has to be set before Load(). Splits every mesh part into meshlets of up to 64 vertices and 124 triangles,
+         * each with a bounding sphere and a normal cone. The meshlets' triangles are stored as separate ranges of the index buffer.
+         */
+        virtual void SetMeshletGeneration(bool enable) { m_is_meshlets_enabled = enable; }
+        virtual bool HasMeshlets() const               { return !m_meshlets.empty(); }
+
+        /*
+         * Culls the meshlets against the frustum and their normal cones in a compute shader and draws the visible ones
+         * with glMultiDrawElementsIndirectCount, one call per material. Falls back to Render() if the model has no meshlets.
+         */
+        virtual void RenderMeshlets(std::shared_ptr<Shader>& shader, const glm::mat4& model, const glm::mat4& view_projection, const glm::vec3& camera_position);
+
+        /*
+         * Has to be set before Load(). Builds a MeshBvh over the triangles of the mesh parts for the CPU raycasts,
+         * the hits' m_mesh_part indexes GetMeshPart(). Not built for the GPU generated primitives and the other draw modes.
+         */
+        virtual void SetBvhGeneration(bool enable) { m_is_bvh_enabled = enable; }
+        const MeshBvh* GetBvh() const              { return m_bvh.get(); }
+
+        /*
+         * Has to be set before Load() or Gen*(). Puts the vertices and indices into the GeometryPool of the vertex format
+         * instead of the model's own buffers, so all the pooled models of the format share one VAO.
+         * Asynchronously loaded, PLANAR and animated models always use their own buffers.
+         */
+        virtual void SetGeometryPooling(bool enable) { m_is_pooling_enabled = enable; }
+        virtual bool IsGeometryPooled() const        { return m_geometry_pool != nullptr; }
+
+        /*
+         * Has to be set before Gen*(). GenPlane(), GenPlaneGrid(), GenSphere() and GenTorus() write the vertices and indices
+         * straight into the model's buffers from a compute shader, nothing is staged in the CPU memory. The tangents are analytic.
+         * Only the PLANAR vertex format without the geometry pooling is supported - the other primitives and setups are generated on the CPU.
+         */
+        virtual void SetGpuPrimitiveGeneration(bool enable)  { m_is_gpu_generation = enable; }
+        virtual bool IsGpuPrimitiveGenerationEnabled() const { return m_is_gpu_generation; }
+
+        /*
+         * Has to be set before Gen*(). GenPlane() and GenSphere() emit a triangle strip per row of the grid and GenPlaneGrid()
+         * a line strip per row and per column, separated by PRIMITIVE_RESTART_INDEX - about a third of the indices of the lists,
+         * in the order the post-transform cache reuses best. The draws enable GL_PRIMITIVE_RESTART_FIXED_INDEX for the model.
+         * The strips are generated on the CPU, the tangents are computed from the triangles before the indices are replaced.
+         */
+        virtual void SetStripGeneration(bool enable)  { m_is_strip_generation = enable; }
+        virtual bool IsStripGenerationEnabled() const { return m_is_strip_generation; }
+
+        /*
+         * Occlusion culling of the whole model without a readback, for a few heavy objects - GpuCulling is for many.
+         * RenderOcclusionQuery() draws the model's bounding box against the depth of the pre-pass into
+         * a GL_ANY_SAMPLES_PASSED_CONSERVATIVE query, the next Render() and RenderIndirect() calls are then wrapped
+         * in glBeginConditionalRender(GL_QUERY_NO_WAIT): the GPU skips them if no sample passed, and draws them
+         * if the query isn't done yet. The model is drawn as usual until the first query, and when the camera is in its box.
+         */
+        virtual void SetConditionalRendering(bool enable)  { m_is_conditional_rendering = enable; m_is_occlusion_query_valid = false; }
+        virtual bool IsConditionalRenderingEnabled() const { return m_is_conditional_rendering; }
+
+        /* After the depth pre-pass, with its depth buffer bound. Nothing is written, the depth and color masks are restored. */
+        virtual void RenderOcclusionQuery(const glm::mat4& model, const glm::mat4& view_projection, const glm::vec3& camera_position);
+
+        /* Attribute formats of the interleaved vertex formats, all from the binding 0. */
+        static uint32_t GetVertexStride       (VertexFormat format, bool has_tangents);
+        static void     SetVertexAttribFormats(GLuint vao_name, VertexFormat format, bool has_tangents);
+
+        /* The attribute 0 alone, of the binding 0, see GetDepthVertexArray(). */
+        static void     SetDepthAttribFormat  (GLuint vao_name);
+
         virtual float GetUnitScaleFactor() const { return m_unit_scale; }
 
         virtual bool Load(const std::filesystem::path& filepath);
+
+        /*
+         * Asynchronous loading. Assimp import, vertex packing and texture decoding are done on worker threads.
+         * UpdateAsyncLoad() has to be called on the render thread every frame - it uploads at most max_upload_bytes
+         * of the data through a persistently mapped staging buffer and returns true once the model is ready.
+         * The model doesn't render anything until then, so the caller can draw a placeholder instead.
+         * Moving a loading model waits for its import to finish. If the import fails, the model never becomes ready, IsLoadFailed() returns true.
+         */
+        virtual bool LoadAsync(const std::filesystem::path& filepath);
+        virtual bool UpdateAsyncLoad(uint32_t max_upload_bytes = 8 * 1024 * 1024);
+        virtual bool IsReady() const { return !m_async_load; }
+        virtual bool IsLoadFailed() const { return m_async_load && m_async_load->m_is_failed; }
         virtual void Render(uint32_t num_instances = 0);
         virtual void Render(std::shared_ptr<Shader> & shader, uint32_t num_instances = 0);
 
+        /*
+         * Draws a single mesh part. The VAO and the material are bound only when requested,
+         * so the callers that sort the draws (RenderQueue) can skip the redundant binds.
+         */
+        virtual void RenderMeshPart(uint32_t mesh_part_index, Shader* shader, bool bind_vertex_array = true, bool bind_material = true, uint32_t num_instances = 0);
+
+        /*
+         * Depth only rendering through GetDepthVertexArray(), no materials are bound, so the bound shader can only read
+         * the positions (location 0) and the instance attributes. Every mesh part is drawn as opaque.
+         */
+        virtual void RenderDepth(uint32_t num_instances = 0);
+
+        /*
+         * Depth only RenderIndirect(). The batches of the opaque materials are drawn with depth_shader through
+         * GetDepthVertexArray(), the ones of the alpha masked materials (Material::IsAlphaMasked()) with
+         * alpha_masked_shader through the full VAO and their materials bound, so it can alpha test.
+         * The uniforms of both shaders have to be set by the caller.
+         */
+        virtual void RenderDepthIndirect(std::shared_ptr<Shader>& depth_shader, std::shared_ptr<Shader>& alpha_masked_shader, uint32_t num_instances = 0);
+
+        uint32_t        GetMeshPartsCount()                         const { return uint32_t(m_mesh_parts.size()); }
+        const Material* GetMeshPartMaterial(uint32_t mesh_part_index) const;
+        glm::vec4       GetMeshPartBounds  (uint32_t mesh_part_index) const; /* Object space sphere - xyz center, w radius. */
+        GLuint          GetVertexArray()                            const { return m_vao_name; }
+
+        /*
+         * The VAO with the attribute 0 (position) only, for the depth pre-passes and the shadow maps. With the PLANAR
+         * format it reads the positions stream alone, so the draws fetch 12 bytes per vertex instead of the whole vertex.
+         * The same as GetVertexArray() for the models that have no such VAO (animated).
+         */
+        GLuint          GetDepthVertexArray()                       const { return m_depth_vao_name ? m_depth_vao_name : m_vao_name; }
+
+        /* The buffers in the layout of GetVertexFormat() and GetIndexType(), for the shaders that fetch the vertices themselves. */
+        GLuint          GetVertexBuffer()                           const { return m_vbo_name; }
+        GLuint          GetIndexBuffer()                            const { return m_ibo_name; }
+        GLenum          GetIndexType()                              const { return m_index_type; }
+
+        /* The commands of GetIndirectCommands() and their MeshDrawData, valid after it's been called. */
+        GLuint          GetIndirectBuffer()                         const { return m_indirect_buffer_name; }
+        GLuint          GetDrawDataBuffer()                         const { return m_draw_data_ssbo_name; }
+
+        /*
+         * Multi-draw-indirect rendering. All mesh parts that share a material are submitted
+         * with a single glMultiDrawElementsIndirect call. The indirect buffer is built once
+         * at load time. Per mesh part data (MeshDrawData, see core_shared.h) is available
+         * in the shaders at index gl_DrawID + u_draw_id_offset, its material with MESH_DRAW_MATERIAL().
+         * The overloads without a shader set u_draw_id_offset on the program the caller has bound.
+         */
+        virtual void RenderIndirect(uint32_t num_instances = 0);
+        virtual void RenderIndirect(std::shared_ptr<Shader> & shader, uint32_t num_instances = 0);
+
+        /*
+         * Draws with the indirect commands written by GpuCulling::Cull(). The culling objects have to come from
+         * GetCullingObjects() and the commands from GetIndirectCommands() of this model.
+         */
+        virtual void RenderIndirect(const GpuCulling& culling);
+        virtual void RenderIndirect(std::shared_ptr<Shader> & shader, const GpuCulling& culling);
+
+        virtual const std::vector<DrawElementsIndirectCommand>& GetIndirectCommands();
+
+        /* Appends an object for every mesh part - the part's bounding sphere transformed by the model matrix and its command index. */
+        virtual void GetCullingObjects(const glm::mat4& model, uint32_t instance_id, std::vector<CullingObject>& objects);
+
+        /*
+         * Makes all the material textures resident and stores their ARB_bindless_texture handles
+         * in the materials SSBO. RenderIndirect() then submits the whole model with a single
+         * glMultiDrawElementsIndirect call, without binding textures or setting material uniforms,
+         * so the shaders have to fetch the material data with MESH_DRAW_TEXTURE() and MESH_DRAW_MATERIAL().
+         * Returns false if bindless textures are not supported.
+         */
+        virtual bool EnableBindlessTextures(bool enable);
+        virtual bool IsBindlessEnabled() const { return m_is_bindless_enabled; }
+
         /* Primitives */
         virtual void GenCone       (float    height      = 3.0f, float radius         = 1.5f, uint32_t slices = 10, uint32_t stacks = 10);
         virtual void GenCube       (float    radius      = 1.0f, float texcoord_scale = 1.0f);
@@ -114,40 +471,317 @@ namespace RGL
         static inline glm::mat4 mat4_cast(const aiMatrix3x3& m)  { return glm::transpose(glm::make_mat3(&m.a1)); }
 
         virtual bool ParseScene(const aiScene* scene, const std::filesystem::path& filepath);
+        virtual float ParseMeshParts(const aiScene* scene, std::vector<MeshPart>& mesh_parts, VertexData& vertex_data);
         virtual void LoadMeshPart(const aiMesh* mesh, VertexData& vertex_data);
         virtual bool LoadMaterials(const aiScene* scene, const std::filesystem::path& filepath);
-        virtual bool LoadMaterialTextures(const aiScene* scene, const aiMaterial* material, uint32_t material_index, aiTextureType type, Material::TextureType texture_type, const std::string& directory) const;
         virtual void CreateBuffers(VertexData& vertex_data);
+        static  void OptimizeMeshParts(const std::vector<MeshPart>& mesh_parts, VertexData& vertex_data);
+        static  void GenerateLods     (std::vector<MeshPart>& mesh_parts, VertexData& vertex_data, uint32_t lods_count, bool optimize_vertex_cache);
+        static  void GenerateMeshlets (std::vector<MeshPart>& mesh_parts, VertexData& vertex_data, std::vector<MeshletData>& meshlets);
+        virtual void CreateMeshletBuffers();
+        virtual void BuildBvh(const std::vector<MeshPart>& mesh_parts, const VertexData& vertex_data, std::unique_ptr<MeshBvh>& bvh) const;
+        static  void BuildMeshBvh(const std::vector<MeshPart>& mesh_parts, const VertexData& vertex_data, std::unique_ptr<MeshBvh>& bvh);
+        uint32_t     GetMeshCacheOptions() const;
+        virtual void CreateVertexArray(GLsizei positions_size_bytes, GLsizei texcoords_size_bytes, GLsizei normals_size_bytes, bool has_tangents);
+
+        /* Vertex and index data in the layout selected with SetVertexFormat(). PackIndices sets m_index_type. */
+        virtual std::vector<uint8_t> PackVertices(const VertexData& vertex_data) const;
+        virtual std::vector<uint8_t> PackIndices (const VertexData& vertex_data);
+        uint32_t                     GetVertexStride(bool has_tangents) const { return GetVertexStride(m_vertex_format, has_tangents); }
+        uint32_t                     GetIndexSize() const { return m_index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t); }
+
+        /*
+         * Binary cache of the preprocessed mesh (vertex streams, indices, mesh parts, materials and unit scale),
+         * written next to the model file after the first import. The next Load() skips Assimp entirely.
+         * Models with embedded textures are not cached.
+         */
+        virtual bool LoadMeshCache(const std::filesystem::path& filepath);
+        virtual void SaveMeshCache(const aiScene* scene, const std::filesystem::path& filepath, const VertexData& vertex_data) const;
+
+        static std::filesystem::path GetMeshCachePath(const std::filesystem::path& filepath);
+        static std::string GetModelDirectory   (const std::filesystem::path& filepath);
+        static std::string GetTextureFilepath  (const std::string& directory, const aiString& path);
+        static void        LoadMaterialParams  (const aiMaterial* ai_material, Material& material);
+        static void        SetMaterialHasMap   (Material::TextureType texture_type, Material& material);
+
+        /* A texture of a material, see LoadTextures(). */
+        struct TextureRequest
+        {
+            uint32_t              m_material_index;
+            Material::TextureType m_texture_type;
+            bool                  m_is_srgb;
+            bool                  m_is_repeat;
+            std::string           m_name;             /* Of the file, or of the embedded texture. */
+            const aiTexture*      m_embedded_texture; /* nullptr for the files. */
+        };
+
+        /*
+         * Decodes the textures on the job system and creates them on the calling (GL) thread as the decodes finish, in the
+         * order they finish. The textures requested repeatedly are decoded once, the ones in TextureCache aren't decoded.
+         * The baked and the streamed ones are loaded by Texture2D::Load() on the calling thread, while the others decode.
+         */
+        static void LoadTextures(const std::vector<TextureRequest>& requests, const std::vector<std::shared_ptr<Material>>& materials);
+
+        virtual void CreateIndirectBuffers();
+        virtual void UpdateIndirectInstancesCount(uint32_t num_instances);
+        virtual void UpdateIndirectLods();
+        virtual void DrawIndirectBatches(GLuint indirect_buffer_name, Shader* shader);
+
+        /* The conditional rendering of the last RenderOcclusionQuery(), if it's enabled. */
+        void BeginConditionalRender() const;
+        void EndConditionalRender()   const;
+
+        /* GL_PRIMITIVE_RESTART_FIXED_INDEX around the draws of the strips, the lists keep it disabled - 0xFFFF is a valid 16-bit index. */
+        void BeginPrimitiveRestart() const;
+        void EndPrimitiveRestart()   const;
+        virtual void BindMaterial(uint32_t material_index, Shader* shader);
+
+        virtual bool CreatePooledBuffers(const VertexData& vertex_data);
+        void         ReleasePooledGeometry();
+
+        /* Adds the offsets of the model's range in the pool to the mesh parts after the pool was compacted. */
+        void RebasePooledGeometry();
+        void UpdatePooledGeometry();
 
         virtual void CalcTangentSpace(VertexData& vertex_data);
         virtual void GenPrimitive(VertexData& vertex_data, bool generate_tangents = true);
 
+        /*
+         * Strips of the (columns + 1) x (rows + 1) grid of vertices, row by row, appended to indices. The triangle strip of a row
+         * alternates its two rows of vertices and keeps the winding of the (r, c), (r + 1, c), (r, c + 1) triangles.
+         */
+        static void GenGridTriangleStrips(uint32_t columns, uint32_t rows, std::vector<uint32_t>& indices);
+        static void GenGridLineStrips    (uint32_t columns, uint32_t rows, std::vector<uint32_t>& indices);
+
+        /* GenPrimitive() of the strips of PRIMITIVE_RESTART_INDEX separated indices, with the tangents already in vertex_data. */
+        void GenStripPrimitive(VertexData& vertex_data, DrawMode draw_mode);
+
+        /* Must match the PRIMITIVE_* values of gen_primitive.comp. */
+        enum class GpuPrimitive : uint32_t { PLANE = 0, PLANE_GRID = 1, SPHERE = 2, TORUS = 3 };
+
+        /*
+         * Grid of (columns + 1) x (rows + 1) vertices generated by gen_primitive.comp. The params are primitive specific
+         * (plane: width, height; sphere: radius; torus: center radius, tube radius). Returns false if the GPU generation
+         * is disabled or not supported for the model's setup, the caller generates the primitive on the CPU then.
+         */
+        virtual bool GenPrimitiveGpu(GpuPrimitive primitive, uint32_t columns, uint32_t rows, const glm::vec2& params, const glm::vec3& bounds_min, const glm::vec3& bounds_max);
+
         void Release()
         {
             m_unit_scale = 1.0;
 
+            /* The pool owns the buffers and the VAO. */
+            ReleasePooledGeometry();
+
+            GpuMemory::UntrackBuffer(m_vbo_name);
             glDeleteBuffers(1, &m_vbo_name);
             m_vbo_name = 0;
 
+            GpuMemory::UntrackBuffer(m_ibo_name);
             glDeleteBuffers(1, &m_ibo_name);
             m_ibo_name = 0;
 
             glDeleteVertexArrays(1, &m_vao_name);
+            GLState::OnVertexArrayDeleted(m_vao_name);
             m_vao_name = 0;
 
+            glDeleteVertexArrays(1, &m_depth_vao_name);
+            GLState::OnVertexArrayDeleted(m_depth_vao_name);
+            m_depth_vao_name = 0;
+
+            glDeleteQueries(1, &m_occlusion_query_name);
+            m_occlusion_query_name     = 0;
+            m_is_occlusion_query_valid = false;
+
+            GpuMemory::UntrackBuffer(m_indirect_buffer_name);
+            glDeleteBuffers(1, &m_indirect_buffer_name);
+            m_indirect_buffer_name = 0;
+
+            GpuMemory::UntrackBuffer(m_draw_data_ssbo_name);
+            glDeleteBuffers(1, &m_draw_data_ssbo_name);
+            m_draw_data_ssbo_name = 0;
+
+            GpuMemory::UntrackBuffer(m_meshlets_ssbo_name);
+            GpuMemory::UntrackBuffer(m_meshlet_template_name);
+            GpuMemory::UntrackBuffer(m_meshlet_batches_name);
+            GpuMemory::UntrackBuffer(m_meshlet_commands_name);
+            glDeleteBuffers(1, &m_meshlets_ssbo_name);
+            glDeleteBuffers(1, &m_meshlet_template_name);
+            glDeleteBuffers(1, &m_meshlet_batches_name);
+            glDeleteBuffers(1, &m_meshlet_commands_name);
+            m_meshlets_ssbo_name    = 0;
+            m_meshlet_template_name = 0;
+            m_meshlet_batches_name  = 0;
+            m_meshlet_commands_name = 0;
+            m_culled_meshlets_count = 0;
+
+            m_indirect_instances_count = 1;
+            m_is_indirect_dirty        = true;
+            m_is_bindless_enabled      = false;
+            m_index_type               = GL_UNSIGNED_INT;
+            m_has_primitive_restart    = false;
+
             m_draw_mode = DrawMode::TRIANGLES;
 
             m_mesh_parts.clear();
             m_materials.clear();
+            m_indirect_commands.clear();
+            m_indirect_batches.clear();
+            m_indirect_mesh_parts.clear();
+            m_meshlets.clear();
+            m_meshlet_batches.clear();
+            m_bvh.reset();
+
+            m_async_load.reset();
         }
 
+        /* Texture decoded on a worker thread, waiting for the upload on the render thread. */
+        struct DecodedTexture
+        {
+            uint32_t              m_material_index;
+            Material::TextureType m_texture_type;
+            bool                  m_is_srgb;
+            bool                  m_is_repeat;
+            bool                  m_is_embedded;
+            std::string           m_name;
+            ImageData             m_metadata;
+            unsigned char*        m_data;
+
+            /* Found in TextureCache, m_data isn't decoded then. */
+            std::shared_ptr<Texture2D> m_cached;
+
+            /* An embedded KTX2 image, uploaded without decoding instead of m_data. */
+            std::vector<uint8_t> m_ktx2_data;
+        };
+
+        /* Part of the GPU buffer that still has to be copied from the CPU memory. */
+        struct PendingUpload
+        {
+            GLuint         m_buffer_name;
+            GLintptr       m_offset;
+            const uint8_t* m_data;
+            GLsizeiptr     m_size;
+        };
+
+        struct AsyncLoadState
+        {
+            ~AsyncLoadState()
+            {
+                /* The worker writes to this state, so it has to finish first. */
+                if (m_result.valid())
+                {
+                    m_result.wait();
+                }
+
+                for (auto& texture : m_textures)
+                {
+                    Util::ReleaseTextureData(texture.m_data);
+                }
+
+                for (auto& fence : m_staging_fences)
+                {
+                    glDeleteSync(fence);
+                }
+
+                if (m_staging_buffer_name)
+                {
+                    glUnmapNamedBuffer(m_staging_buffer_name);
+                    GpuMemory::UntrackBuffer(m_staging_buffer_name);
+                    glDeleteBuffers(1, &m_staging_buffer_name);
+                }
+            }
+
+            /* The model's settings when the load started, the worker doesn't read the model's members. */
+            std::filesystem::path                  m_filepath;
+            uint32_t                               m_lods_count           = 1;
+            bool                                   m_is_mesh_optimized    = false;
+            bool                                   m_is_meshlets_enabled  = false;
+            bool                                   m_is_bvh_enabled       = false;
+
+            VertexData                             m_vertex_data;
+            std::vector<MeshPart>                  m_mesh_parts;
+            std::vector<std::shared_ptr<Material>> m_materials;
+            std::vector<DecodedTexture>            m_textures;
+            std::vector<PendingUpload>             m_uploads;
+            std::vector<uint8_t>                   m_packed_vertices;
+            std::vector<uint8_t>                   m_packed_indices;
+            std::vector<MeshletData>               m_meshlets;
+            std::unique_ptr<MeshBvh>               m_bvh;
+            float                                  m_unit_scale           = 1.0f;
+            bool                                   m_is_gpu_stage_started = false;
+            bool                                   m_is_failed            = false;
+
+            GLuint                                 m_staging_buffer_name  = 0;
+            uint8_t*                               m_staging_data         = nullptr;
+            GLsizeiptr                             m_staging_slot_size    = 0;
+            uint32_t                               m_staging_slot         = 0;
+            GLsync                                 m_staging_fences[2]    = {};
+
+            std::future<bool>                      m_result;
+        };
+
+        virtual bool ImportAsync(AsyncLoadState& state);
+        void         WaitForAsyncImport();
+        virtual void BeginAsyncUpload(AsyncLoadState& state);
+
+        /* Range of indirect commands that share the same material. */
+        struct IndirectBatch
+        {
+            uint32_t m_material_index;
+            uint32_t m_first_command;
+            uint32_t m_commands_count;
+        };
+
         std::vector<MeshPart> m_mesh_parts;
         std::vector<std::shared_ptr<Material>> m_materials;
 
+        std::vector<DrawElementsIndirectCommand> m_indirect_commands;
+        std::vector<IndirectBatch>               m_indirect_batches;
+        std::vector<uint32_t>                    m_indirect_mesh_parts; /* Mesh part index of every indirect command. */
+        std::vector<MeshletData>                 m_meshlets;            /* In the mesh parts order. */
+        std::vector<MeshletBatch>                m_meshlet_batches;     /* One per indirect batch. */
+        std::shared_ptr<Shader>                  m_meshlet_cull_shader;
+        std::shared_ptr<Shader>                  m_occlusion_box_shader;
+        std::unique_ptr<MeshBvh>                 m_bvh;
+
+        std::unique_ptr<AsyncLoadState> m_async_load;
+
         float    m_unit_scale;
         GLuint   m_vao_name;
+        GLuint   m_depth_vao_name;        /* Only the positions, see GetDepthVertexArray(). 0 for the animated models. */
         GLuint   m_vbo_name;
         GLuint   m_ibo_name;
-        DrawMode m_draw_mode;
+        GLuint   m_indirect_buffer_name;
+        GLuint   m_draw_data_ssbo_name;
+        uint32_t m_indirect_instances_count;
+        bool     m_is_indirect_dirty;
+        bool     m_is_bindless_enabled;
+        bool     m_is_mesh_optimized;
+        bool     m_is_indirect_lod_dirty;
+        uint32_t m_lods_count;
+        float    m_lod_threshold;
+        bool     m_is_meshlets_enabled;
+        GLuint   m_meshlets_ssbo_name;
+        GLuint   m_meshlet_template_name; /* Meshlet batches with zero visible counts, copied over the batches before the culling. */
+        GLuint   m_meshlet_batches_name;
+        GLuint   m_meshlet_commands_name;
+        uint32_t m_culled_meshlets_count; /* Meshlets of the indirect batches, the size of the meshlets SSBO. */
+        bool     m_is_bvh_enabled;
+        bool     m_is_pooling_enabled;
+        GeometryPool* m_geometry_pool;    /* Not null if the vertices and indices are in a shared pool, m_vao_name and m_depth_vao_name are the pool's VAOs then. */
+        uint32_t m_pool_handle;
+        uint32_t m_pool_generation;       /* Pool generation the mesh parts were rebased for. */
+        uint32_t m_pool_vertex_offset;    /* Pool offsets already added to the mesh parts and meshlets. */
+        uint32_t m_pool_index_offset;
+        bool     m_is_gpu_generation;      /* Gen*() uses the compute shader where supported. */
+        bool     m_is_strip_generation;    /* Gen*() emits strips where supported. */
+        bool     m_has_primitive_restart;  /* The indices are strips separated by PRIMITIVE_RESTART_INDEX. */
+        GLuint   m_occlusion_query_name;
+        bool     m_is_conditional_rendering;
+        bool     m_is_occlusion_query_valid; /* The query was issued and the camera was outside of the box. */
+
+        VertexFormat m_vertex_format;
+        GLenum       m_index_type;
+        DrawMode     m_draw_mode;
     };
 }
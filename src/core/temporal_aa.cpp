@@ -0,0 +1,183 @@
+#include "temporal_aa.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include "camera.h"
+#include "core_shared.h"
+#include "gl_state.h"
+#include "profiler.h"
+#include "render_target_pool.h"
+#include "shader.h"
+
+#include "gui/gui.h"
+
+namespace RGL
+{
+    namespace
+    {
+        /* The radical inverse of the index in the base, in [0, 1). */
+        float halton(uint32_t index, uint32_t base)
+        {
+            float fraction = 1.0f;
+            float result   = 0.0f;
+
+            while (index > 0)
+            {
+                fraction /= float(base);
+                result   += fraction * float(index % base);
+                index    /= base;
+            }
+
+            return result;
+        }
+    }
+
+    bool TemporalAA::Create()
+    {
+        m_motion_vectors_shader = std::make_shared<Shader>("src/core/shaders/motion_vectors.vert", "src/core/shaders/motion_vectors.frag");
+        m_resolve_shader        = std::make_shared<Shader>("src/core/shaders/taa_resolve.comp");
+
+        /* The resolve writes the history, of the HDR color's format. */
+        m_resolve_shader->setDefine("HDR_IMAGE_FORMAT", RenderTargetPool::GetImageFormatQualifier(RenderTargetPool::GetColorFormat(RenderTargetUsage::HDR_COLOR)));
+
+        m_motion_vectors_shader->linkAsync();
+        m_resolve_shader->linkAsync();
+
+        if (!m_motion_vectors_shader->link() || !m_resolve_shader->link())
+        {
+            fprintf(stderr, "TemporalAA: the shaders failed to link.\n");
+            return false;
+        }
+
+        return true;
+    }
+
+    void TemporalAA::Update(Camera& camera, uint32_t render_width, uint32_t render_height, uint32_t output_width, uint32_t output_height)
+    {
+        if (!m_is_enabled)
+        {
+            camera.setJitter(glm::vec2(0.0f));
+
+            m_jitter = glm::vec2(0.0f);
+            m_history[0].reset();
+            m_history[1].reset();
+            m_output_width     = 0;
+            m_output_height    = 0;
+            m_is_history_valid = false;
+
+            return;
+        }
+
+        /* A longer sequence when upsampling - the same number of samples per output pixel as the native resolution. */
+        const float    ratio       = float(output_width * output_height) / float(render_width * render_height);
+        const uint32_t phase_count = uint32_t(std::ceil(float(BASE_PHASE_COUNT) * ratio));
+
+        /* Halton's index 0 is (0, 0) in every base, the sequence starts at 1. */
+        m_jitter_index = m_jitter_index % phase_count + 1;
+        m_jitter       = glm::vec2(halton(m_jitter_index, 2), halton(m_jitter_index, 3)) - 0.5f;
+
+        camera.setJitter(2.0f * m_jitter / glm::vec2(render_width, render_height));
+
+        m_view_projection            = camera.viewProjection();
+        m_unjittered_view_projection = camera.unjitteredViewProjection();
+        m_previous_view_projection   = camera.previousViewProjection();
+        m_reprojection               = m_previous_view_projection * glm::inverse(m_unjittered_view_projection);
+
+        if (output_width != m_output_width || output_height != m_output_height)
+        {
+            m_output_width  = output_width;
+            m_output_height = output_height;
+
+            for (auto& history : m_history)
+            {
+                history = RenderTargetPool::Acquire({ output_width, output_height, RenderTargetPool::GetColorFormat(RenderTargetUsage::HDR_COLOR), 0 });
+            }
+
+            m_is_history_valid = false;
+        }
+    }
+
+    void TemporalAA::BeginMotionVectors(const RenderTarget& scene)
+    {
+        m_motion_vectors = RenderTargetPool::Acquire({ scene.GetWidth(), scene.GetHeight(), RenderTargetPool::GetColorFormat(RenderTargetUsage::MOTION_VECTORS),
+                                                     scene.GetDesc().m_depth_format });
+        m_motion_vectors->Bind(GL_DEPTH_BUFFER_BIT);
+
+        /* Not the app's clear color, a pixel without geometry has no motion of its own. */
+        const GLfloat no_motion[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glClearNamedFramebufferfv(m_motion_vectors->GetFramebuffer(), GL_COLOR, 0, no_motion);
+
+        m_motion_vectors_shader->bind();
+    }
+
+    void TemporalAA::SetObjectTransforms(const glm::mat4& model, const glm::mat4& previous_model)
+    {
+        /* u_mvp the same as the scene's draws compute it, the depth matches theirs exactly. */
+        m_motion_vectors_shader->setUniform("u_mvp",          m_view_projection * model);
+        m_motion_vectors_shader->setUniform("u_current_mvp",  m_unjittered_view_projection * model);
+        m_motion_vectors_shader->setUniform("u_previous_mvp", m_previous_view_projection * previous_model);
+    }
+
+    void TemporalAA::EndMotionVectors(const RenderTarget& scene)
+    {
+        glBlitNamedFramebuffer(m_motion_vectors->GetFramebuffer(), scene.GetFramebuffer(),
+                               0, 0, scene.GetWidth(), scene.GetHeight(),
+                               0, 0, scene.GetWidth(), scene.GetHeight(), GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+        scene.Bind(0);
+    }
+
+    const RenderTarget& TemporalAA::Resolve(const RenderTarget& scene)
+    {
+        ProfilerScope scope("Temporal AA");
+
+        const RenderTarget& history = *m_history[m_history_index];
+        const RenderTarget& output  = *m_history[m_history_index ^ 1];
+
+        m_resolve_shader->bind();
+        m_resolve_shader->setUniform("u_input_size",   glm::uvec2(scene.GetWidth(), scene.GetHeight()));
+        m_resolve_shader->setUniform("u_output_size",  glm::uvec2(m_output_width, m_output_height));
+        m_resolve_shader->setUniform("u_jitter",       m_jitter);
+        m_resolve_shader->setUniform("u_reprojection", m_reprojection);
+        m_resolve_shader->setUniform("u_blend",        m_is_history_valid ? m_settings.m_blend : 1.0f);
+        m_resolve_shader->setUniform("u_clip_size",    m_settings.m_clip_size);
+
+        scene.BindColor(0);
+        m_motion_vectors->BindColor(1);
+        m_motion_vectors->BindDepth(2);
+        history.BindColor(3);
+        output.BindColorImage(0, 0, GL_WRITE_ONLY);
+
+        glDispatchCompute((m_output_width  + TAA_GROUP_SIZE - 1) / TAA_GROUP_SIZE,
+                          (m_output_height + TAA_GROUP_SIZE - 1) / TAA_GROUP_SIZE, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        /* Back to the pool until the next frame's motion vector pass. */
+        m_motion_vectors.reset();
+
+        m_history_index   ^= 1;
+        m_is_history_valid = true;
+
+        return output;
+    }
+
+    GLuint TemporalAA::GetMotionVectors() const
+    {
+        return m_is_enabled && m_motion_vectors ? m_motion_vectors->GetColorTexture() : 0;
+    }
+
+    void TemporalAA::RenderGui()
+    {
+        if (ImGui::Checkbox("Temporal AA", &m_is_enabled))
+        {
+            Reset();
+        }
+
+        if (m_is_enabled)
+        {
+            ImGui::SliderFloat("History blend", &m_settings.m_blend,     0.02f, 0.5f, "%.2f");
+            ImGui::SliderFloat("Clip size",     &m_settings.m_clip_size, 0.5f,  2.0f, "%.2f");
+        }
+    }
+}
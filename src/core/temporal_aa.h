@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+namespace RGL
+{
+    class Camera;
+    class RenderTarget;
+    class Shader;
+
+    /*
+     * Temporal anti-aliasing and upsampling. Update() jitters the camera's projection by a sub-pixel offset of a Halton
+     * (2, 3) sequence, so the frames sample different points of each pixel. The motion vector pass - it doubles as
+     * the depth pre-pass of the scene target - writes the screen space motion of every object from its current and
+     * previous transforms, the background's motion is the camera's, from the depth. Resolve() reprojects the
+     * accumulated history with them (shaders/taa_resolve.comp), clips it to the neighbourhood of the current frame,
+     * so the disoccluded and the changed pixels don't ghost, and blends the current samples in.
+     *
+     * The history is of the output size, a smaller render size makes it the upscaler of DynamicResolution instead of
+     * Upscale() - the jitter sequence is longer then, so every output pixel gets a sample close to it. The resolve
+     * works on the HDR colors, tone mapping follows it.
+     *
+     *     temporal_aa.Update(*camera, render_width, render_height, output_width, output_height);
+     *     temporal_aa.BeginMotionVectors(*hdr);
+     *     for each object: temporal_aa.SetObjectTransforms(model, previous_model); object.Render();
+     *     temporal_aa.EndMotionVectors(*hdr);
+     *     ... the scene to hdr, the depth test with GL_LEQUAL ...
+     *     const RenderTarget& output = temporal_aa.Resolve(*hdr);
+     */
+    class TemporalAA final
+    {
+    public:
+        /* The jitter phases of the native resolution, scaled by the area ratio of the output and the render size. */
+        static constexpr uint32_t BASE_PHASE_COUNT = 8;
+
+        struct Settings
+        {
+            float m_blend     = 0.1f;  /* The weight of the current frame at a sample right on the output pixel. */
+            float m_clip_size = 1.0f;  /* Of the neighbourhood's color box, in its standard deviations. */
+        };
+
+        TemporalAA() = default;
+
+        TemporalAA           (const TemporalAA&) = delete;
+        TemporalAA& operator=(const TemporalAA&) = delete;
+
+        bool Create();
+
+        /* Once per frame, after the camera's update() and before the scene is rendered. Disabled it clears the jitter. */
+        void Update(Camera& camera, uint32_t render_width, uint32_t render_height, uint32_t output_width, uint32_t output_height);
+
+        /* Binds a motion vector target of the scene's size and depth format, and the motion vector shader. */
+        void BeginMotionVectors(const RenderTarget& scene);
+
+        /* Before each object's draw, the model matrix of this frame and of the previous one. */
+        void SetObjectTransforms(const glm::mat4& model, const glm::mat4& previous_model);
+
+        /* Copies the depth to the scene target and binds it, without clearing. */
+        void EndMotionVectors(const RenderTarget& scene);
+
+        /* The anti-aliased scene of the output size, valid until the next Resolve(). */
+        const RenderTarget& Resolve(const RenderTarget& scene);
+
+        /* Drops the history, for the camera cuts and the scene changes. */
+        void Reset() { m_is_history_valid = false; }
+
+        void RenderGui();
+
+        void SetEnabled(bool enable) { m_is_enabled = enable; }
+        bool IsEnabled() const       { return m_is_enabled; }
+
+        /* The last motion vector pass's target (RG, UV units), 0 when it's disabled. */
+        GLuint GetMotionVectors() const;
+
+        /* In the render target's pixels, the sample of a pixel is at its center plus the jitter. */
+        glm::vec2 GetJitter() const { return m_jitter; }
+
+        Settings m_settings;
+
+    private:
+        std::shared_ptr<Shader> m_motion_vectors_shader;
+        std::shared_ptr<Shader> m_resolve_shader;
+
+        /* Ping-ponged, the one of m_history_index is the latest. Held by the class, the pool doesn't hand them out. */
+        std::shared_ptr<RenderTarget> m_history[2];
+        std::shared_ptr<RenderTarget> m_motion_vectors;
+
+        glm::mat4 m_view_projection            = glm::mat4(1.0f);
+        glm::mat4 m_unjittered_view_projection = glm::mat4(1.0f);
+        glm::mat4 m_previous_view_projection   = glm::mat4(1.0f);
+
+        /* From the current unjittered clip space to the previous one, for the background's motion. */
+        glm::mat4 m_reprojection = glm::mat4(1.0f);
+
+        glm::vec2 m_jitter           = glm::vec2(0.0f);
+        uint32_t  m_jitter_index     = 0;
+        uint32_t  m_output_width     = 0;
+        uint32_t  m_output_height    = 0;
+        uint32_t  m_history_index    = 0;
+        bool      m_is_history_valid = false;
+        bool      m_is_enabled       = true;
+    };
+}
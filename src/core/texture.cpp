@@ -5,6 +5,18 @@
 #define TINYDDSLOADER_IMPLEMENTATION
 #include <tinyddsloader.h>
 
+#include <basisu_transcoder.h>
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "filesystem.h"
+#include "gpu_memory.h"
+#include "job_system.h"
+#include "mapped_file.h"
+
 using namespace tinyddsloader;
 
 namespace
@@ -67,6 +79,93 @@ namespace
         return false;
     }
 
+    /* KTX2 container, https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html */
+    constexpr uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    struct Ktx2Header
+    {
+        uint8_t  m_identifier[12];
+        uint32_t m_vk_format;
+        uint32_t m_type_size;
+        uint32_t m_pixel_width;
+        uint32_t m_pixel_height;
+        uint32_t m_pixel_depth;
+        uint32_t m_layer_count;
+        uint32_t m_face_count;
+        uint32_t m_level_count;
+        uint32_t m_supercompression_scheme;
+        uint32_t m_dfd_byte_offset;
+        uint32_t m_dfd_byte_length;
+        uint32_t m_kvd_byte_offset;
+        uint32_t m_kvd_byte_length;
+        uint64_t m_sgd_byte_offset;
+        uint64_t m_sgd_byte_length;
+    };
+
+    struct Ktx2Level
+    {
+        uint64_t m_byte_offset;
+        uint64_t m_byte_length;
+        uint64_t m_uncompressed_byte_length;
+    };
+
+    static_assert(sizeof(Ktx2Header) == 80 && sizeof(Ktx2Level) == 24, "KTX2 structures must match the file layout.");
+
+    /* VK_FORMAT_UNDEFINED - the data is Basis Universal (ETC1S or UASTC), transcoded at load time. */
+    constexpr uint32_t KTX2_VK_FORMAT_UNDEFINED = 0;
+
+    /* The block compressed VkFormats and their GL equivalents. */
+    GLenum translateKtx2Format(uint32_t vk_format)
+    {
+        switch (vk_format)
+        {
+            case 131: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;             /* VK_FORMAT_BC1_RGB_UNORM_BLOCK  */
+            case 132: return GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;            /* VK_FORMAT_BC1_RGB_SRGB_BLOCK   */
+            case 133: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;            /* VK_FORMAT_BC1_RGBA_UNORM_BLOCK */
+            case 134: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;      /* VK_FORMAT_BC1_RGBA_SRGB_BLOCK  */
+            case 137: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;            /* VK_FORMAT_BC3_UNORM_BLOCK      */
+            case 138: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;      /* VK_FORMAT_BC3_SRGB_BLOCK       */
+            case 139: return GL_COMPRESSED_RED_RGTC1;                     /* VK_FORMAT_BC4_UNORM_BLOCK      */
+            case 141: return GL_COMPRESSED_RG_RGTC2;                      /* VK_FORMAT_BC5_UNORM_BLOCK      */
+            case 143: return GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;       /* VK_FORMAT_BC6H_UFLOAT_BLOCK    */
+            case 145: return GL_COMPRESSED_RGBA_BPTC_UNORM;               /* VK_FORMAT_BC7_UNORM_BLOCK      */
+            case 146: return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;         /* VK_FORMAT_BC7_SRGB_BLOCK       */
+            default:  return 0;
+        }
+    }
+
+    bool translateChannels(uint32_t channels, bool is_srgb, GLenum* format, GLenum* internal_format)
+    {
+        switch (channels)
+        {
+            case 1:  *format = GL_RED;  *internal_format = GL_R8;                                return true;
+            case 3:  *format = GL_RGB;  *internal_format = is_srgb ? GL_SRGB8 : GL_RGB8;         return true;
+            case 4:  *format = GL_RGBA; *internal_format = is_srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8; return true;
+            default: return false;
+        }
+    }
+
+    bool startBasisTranscoding(basist::ktx2_transcoder& transcoder, const uint8_t* data, size_t size)
+    {
+        static std::once_flag init_flag;
+        std::call_once(init_flag, [] { basist::basisu_transcoder_init(); });
+
+        return transcoder.init(data, uint32_t(size)) && transcoder.start_transcoding();
+    }
+
+    /*
+     * BC7 keeps the UASTC quality and the alpha. ETC1S without alpha is transcoded to BC1 instead,
+     * ETC1S can't look better than that and BC1 is half the size.
+     */
+    void selectBasisFormat(const basist::ktx2_transcoder& transcoder, bool is_srgb, basist::transcoder_texture_format* target_format, GLenum* internal_format)
+    {
+        const bool is_bc1 = transcoder.is_etc1s() && !transcoder.get_has_alpha();
+
+        *target_format   = is_bc1 ? basist::transcoder_texture_format::cTFBC1_RGB : basist::transcoder_texture_format::cTFBC7_RGBA;
+        *internal_format = is_bc1 ? (is_srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT    : GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+                                  : (is_srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM);
+    }
+
     bool isDdsCompressed(GLenum fmt)
     {
         switch (fmt)
@@ -203,11 +302,149 @@ namespace RGL
         glTextureParameterf(m_obj_name, GL_TEXTURE_MAX_ANISOTROPY, anisotropy);
     }
 
+    void Texture::GenerateMipmaps(GLenum internal_format, uint32_t layers_count, uint32_t levels_count, MipmapFilter filter)
+    {
+        if (levels_count < 2)
+        {
+            return;
+        }
+
+        if (!MipmapGenerator::IsEnabled() || !MipmapGenerator::Generate(m_obj_name, internal_format, m_metadata.width, m_metadata.height, layers_count, levels_count, filter))
+        {
+            glGenerateTextureMipmap(m_obj_name);
+        }
+    }
+
+    size_t Texture::GetMemorySize() const
+    {
+        if (m_obj_name == 0)
+        {
+            return 0;
+        }
+
+        GLint levels_count = 0;
+        glGetTextureParameteriv(m_obj_name, GL_TEXTURE_IMMUTABLE_LEVELS, &levels_count);
+
+        size_t size = 0;
+
+        for (GLint level = 0; level < std::max(levels_count, 1); ++level)
+        {
+            GLint is_compressed = 0;
+            glGetTextureLevelParameteriv(m_obj_name, level, GL_TEXTURE_COMPRESSED, &is_compressed);
+
+            if (is_compressed)
+            {
+                GLint level_size = 0;
+                glGetTextureLevelParameteriv(m_obj_name, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &level_size);
+
+                size += size_t(level_size);
+                continue;
+            }
+
+            GLint width = 0, height = 0, depth = 0, bits = 0;
+            glGetTextureLevelParameteriv(m_obj_name, level, GL_TEXTURE_WIDTH,  &width);
+            glGetTextureLevelParameteriv(m_obj_name, level, GL_TEXTURE_HEIGHT, &height);
+            glGetTextureLevelParameteriv(m_obj_name, level, GL_TEXTURE_DEPTH,  &depth);
+
+            for (GLenum component : { GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE, GL_TEXTURE_DEPTH_SIZE, GL_TEXTURE_STENCIL_SIZE })
+            {
+                GLint component_bits = 0;
+                glGetTextureLevelParameteriv(m_obj_name, level, component, &component_bits);
+
+                bits += component_bits;
+            }
+
+            size += size_t(width) * height * std::max(depth, 1) * bits / 8;
+        }
+
+        /* The level parameters describe a single face. */
+        GLint target = 0;
+        glGetTextureParameteriv(m_obj_name, GL_TEXTURE_TARGET, &target);
+
+        return target == GL_TEXTURE_CUBE_MAP ? size * 6 : size;
+    }
+
+    GLuint64 Texture::GetBindlessHandle()
+    {
+        if (m_bindless_handle == 0 && m_obj_name != 0 && IsBindlessSupported())
+        {
+            m_bindless_handle = glGetTextureHandleARB(m_obj_name);
+        }
+
+        return m_bindless_handle;
+    }
+
+    void Texture::MakeResident()
+    {
+        if (m_is_resident)
+        {
+            return;
+        }
+
+        if (GetBindlessHandle() == 0)
+        {
+            fprintf(stderr, "Texture::MakeResident: ARB_bindless_texture is not supported or the texture is not created.\n");
+            return;
+        }
+
+        glMakeTextureHandleResidentARB(m_bindless_handle);
+        m_is_resident = true;
+    }
+
+    void Texture::MakeNonResident()
+    {
+        if (!m_is_resident)
+        {
+            return;
+        }
+
+        glMakeTextureHandleNonResidentARB(m_bindless_handle);
+        m_is_resident = false;
+    }
+
     // --------------------- Texture2D -------------------------
 
-    bool Texture2D::Load(const std::filesystem::path& filepath, bool is_srgb, uint32_t num_mipmaps)
+    std::filesystem::path Texture2D::GetBakedFilepath(const std::filesystem::path& filepath)
     {
-        auto data = Util::LoadTextureData(filepath, m_metadata);
+        auto                            baked_filepath = std::filesystem::path(filepath).replace_extension(".ktx2");
+        uintmax_t                       baked_size, source_size;
+        std::filesystem::file_time_type baked_time, source_time;
+
+        if (FileSystem::getFileInfo(baked_filepath, baked_size,  baked_time)  &&
+            FileSystem::getFileInfo(filepath,       source_size, source_time) &&
+            baked_time >= source_time)
+        {
+            return baked_filepath;
+        }
+
+        return {};
+    }
+
+    bool Texture2D::IsDecodedOnLoad(const std::filesystem::path& filepath)
+    {
+        return filepath.extension() != ".ktx2" && !TextureStreamer::IsEnabled() && GetBakedFilepath(filepath).empty();
+    }
+
+    bool Texture2D::Load(const std::filesystem::path& filepath, bool is_srgb, uint32_t num_mipmaps, MipmapFilter mipmap_filter)
+    {
+        if (filepath.extension() == ".ktx2")
+        {
+            return LoadKtx2(filepath, is_srgb);
+        }
+
+        /* A KTX2 file baked by texture_baker is used instead of the source image, unless the source is newer. */
+        if (auto baked_filepath = GetBakedFilepath(filepath); !baked_filepath.empty() && LoadKtx2(baked_filepath, is_srgb))
+        {
+            return true;
+        }
+
+        if (TextureStreamer::IsEnabled())
+        {
+            return LoadStreaming(filepath, is_srgb, num_mipmaps);
+        }
+
+        ImageData metadata;
+        auto data = Util::LoadTextureData(filepath, metadata);
 
         if (!data)
         {
@@ -215,87 +452,112 @@ namespace RGL
             return false;
         }
 
-        GLenum format          = 0;
-        GLenum internal_format = 0;
+        bool ret = Create(metadata, data, is_srgb, num_mipmaps, mipmap_filter);
+        Util::ReleaseTextureData(data);
 
-        if (m_metadata.channels == 1)
+        return ret;
+    }
+
+    bool Texture2D::Load(unsigned char* memory_data, uint32_t data_size, bool is_srgb, uint32_t num_mipmaps, MipmapFilter mipmap_filter)
+    {
+        if (IsKtx2(memory_data, data_size))
         {
-            format          = GL_RED;
-            internal_format = GL_R8;
+            return LoadKtx2(memory_data, data_size, is_srgb);
         }
-        else if (m_metadata.channels == 3)
+
+        ImageData metadata;
+        auto data = Util::LoadTextureData(memory_data, data_size, metadata);
+
+        if (!data)
         {
-            format          = GL_RGB;
-            internal_format = is_srgb ? GL_SRGB8 : GL_RGB8;
+            fprintf(stderr, "Texture failed to load from the memory.\n");
+            return false;
         }
-        else if (m_metadata.channels == 4)
+
+        bool ret = Create(metadata, data, is_srgb, num_mipmaps, mipmap_filter);
+        Util::ReleaseTextureData(data);
+
+        return ret;
+    }
+
+    bool Texture2D::Create(const ImageData& metadata, const unsigned char* data, bool is_srgb, uint32_t num_mipmaps, MipmapFilter mipmap_filter)
+    {
+        m_metadata = metadata;
+
+        GLenum format          = 0;
+        GLenum internal_format = 0;
+
+        if (!translateChannels(m_metadata.channels, is_srgb, &format, &internal_format))
         {
-            format          = GL_RGBA;
-            internal_format = is_srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+            fprintf(stderr, "Texture2D::Create: unsupported number of channels: %u.\n", m_metadata.channels);
+            return false;
         }
 
         const GLuint max_num_mipmaps = GetMaxMipMapsLevels(m_metadata.width, m_metadata.height, 0);
                      num_mipmaps     = num_mipmaps == 0 ? max_num_mipmaps : glm::clamp(num_mipmaps, 1u, max_num_mipmaps);
 
-        glCreateTextures       (GLenum(TextureType::Texture2D), 1, &m_obj_name);
-        glTextureStorage2D     (m_obj_name, num_mipmaps /* levels */, internal_format, m_metadata.width, m_metadata.height);
-        glTextureSubImage2D    (m_obj_name, 0 /* level */, 0 /* xoffset */, 0 /* yoffset */, m_metadata.width, m_metadata.height, format, GL_UNSIGNED_BYTE, data);
-        glGenerateTextureMipmap(m_obj_name);
+        /* The image units can't write RGB8. The drivers pad it to 32 bits anyway, so RGBA8 costs no memory. */
+        if (m_metadata.channels == 3 && num_mipmaps > 1 && MipmapGenerator::IsEnabled())
+        {
+            internal_format = is_srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        }
+
+        glCreateTextures   (GLenum(TextureType::Texture2D), 1, &m_obj_name);
+        glTextureStorage2D (m_obj_name, num_mipmaps /* levels */, internal_format, m_metadata.width, m_metadata.height);
+        glTextureSubImage2D(m_obj_name, 0 /* level */, 0 /* xoffset */, 0 /* yoffset */, m_metadata.width, m_metadata.height, format, GL_UNSIGNED_BYTE, data);
+        GpuMemory::TrackTexture(m_obj_name, "Texture");
+
+        GenerateMipmaps(internal_format, 1, num_mipmaps, mipmap_filter);
 
         SetFiltering(TextureFiltering::MIN,       TextureFilteringParam::LINEAR_MIP_LINEAR);
         SetFiltering(TextureFiltering::MAG,       TextureFilteringParam::LINEAR);
         SetWraping  (TextureWrapingCoordinate::S, TextureWrapingParam::CLAMP_TO_EDGE);
         SetWraping  (TextureWrapingCoordinate::T, TextureWrapingParam::CLAMP_TO_EDGE);
 
-        Util::ReleaseTextureData(data);
-
         return true;
     }
 
-    bool Texture2D::Load(unsigned char* memory_data, uint32_t data_size, bool is_srgb, uint32_t num_mipmaps)
+    bool Texture2D::LoadStreaming(const std::filesystem::path& filepath, bool is_srgb, uint32_t num_mipmaps)
     {
-        auto data = Util::LoadTextureData(memory_data, data_size, m_metadata);
+        ImageData metadata;
 
-        if (!data)
+        if (!Util::LoadTextureInfo(filepath, metadata))
         {
-            fprintf(stderr, "Texture failed to load from the memory.\n");
+            fprintf(stderr, "Texture failed to load at path: %s\n", filepath.string().c_str());
             return false;
         }
 
         GLenum format          = 0;
         GLenum internal_format = 0;
 
-        if (m_metadata.channels == 1)
-        {
-            format          = GL_RED;
-            internal_format = GL_R8;
-        }
-        else if (m_metadata.channels == 3)
+        if (!translateChannels(metadata.channels, is_srgb, &format, &internal_format))
         {
-            format          = GL_RGB;
-            internal_format = is_srgb ? GL_SRGB8 : GL_RGB8;
-        }
-        else if (m_metadata.channels == 4)
-        {
-            format          = GL_RGBA;
-            internal_format = is_srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+            fprintf(stderr, "Texture2D::LoadStreaming: unsupported number of channels: %u.\n", metadata.channels);
+            return false;
         }
 
+        m_type     = TextureType::Texture2D;
+        m_metadata = metadata;
+
         const GLuint max_num_mipmaps = GetMaxMipMapsLevels(m_metadata.width, m_metadata.height, 0);
                      num_mipmaps     = num_mipmaps == 0 ? max_num_mipmaps : glm::clamp(num_mipmaps, 1u, max_num_mipmaps);
 
+        glCreateTextures  (GLenum(m_type), 1, &m_obj_name);
+        glTextureStorage2D(m_obj_name, num_mipmaps /* levels */, internal_format, m_metadata.width, m_metadata.height);
+        GpuMemory::TrackTexture(m_obj_name, "Texture");
 
-        glCreateTextures       (GLenum(TextureType::Texture2D), 1, &m_obj_name);
-        glTextureStorage2D     (m_obj_name, num_mipmaps /* levels */, internal_format, m_metadata.width, m_metadata.height);
-        glTextureSubImage2D    (m_obj_name, 0 /* level */, 0 /* xoffset */, 0 /* yoffset */, m_metadata.width, m_metadata.height, format, GL_UNSIGNED_BYTE, data);
-        glGenerateTextureMipmap(m_obj_name);
+        /* Grey on the smallest level until the streamer uploads it, nothing but that level is sampled. */
+        const uint8_t placeholder[4] = { 128, 128, 128, 255 };
+
+        glClearTexImage    (m_obj_name, num_mipmaps - 1, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+        glTextureParameteri(m_obj_name, GL_TEXTURE_BASE_LEVEL, num_mipmaps - 1);
 
         SetFiltering(TextureFiltering::MIN,       TextureFilteringParam::LINEAR_MIP_LINEAR);
         SetFiltering(TextureFiltering::MAG,       TextureFilteringParam::LINEAR);
         SetWraping  (TextureWrapingCoordinate::S, TextureWrapingParam::CLAMP_TO_EDGE);
         SetWraping  (TextureWrapingCoordinate::T, TextureWrapingParam::CLAMP_TO_EDGE);
 
-        Util::ReleaseTextureData(data);
+        TextureStreamer::Add(m_obj_name, filepath, m_metadata, num_mipmaps, is_srgb);
 
         return true;
     }
@@ -308,39 +570,60 @@ namespace RGL
             return false;
         }
 
-        auto data = Util::LoadTextureDataHdr(filepath, m_metadata);
+        /* Decoded in parallel and stored as shared exponent texels - a third of the float upload, two thirds of RGB16F. */
+        auto texels = Util::LoadTextureDataHdrRgb9e5(filepath, m_metadata);
 
-        if (!data)
+        if (texels.empty())
         {
             fprintf(stderr, "Texture failed to load at path: %s\n", filepath.generic_string().c_str());
             return false;
         }
 
-        GLenum format          = GL_RGB;
-        GLenum internal_format = GL_RGB16F;
-
         const GLuint max_num_mipmaps = GetMaxMipMapsLevels(m_metadata.width, m_metadata.height, 0);
                      num_mipmaps     = num_mipmaps == 0 ? max_num_mipmaps : glm::clamp(num_mipmaps, 1u, max_num_mipmaps);
 
-        glCreateTextures       (GLenum(TextureType::Texture2D), 1, &m_obj_name);
-        glTextureStorage2D     (m_obj_name, 1 /* levels */, internal_format, m_metadata.width, m_metadata.height);
-        glTextureSubImage2D    (m_obj_name, 0 /* level */, 0 /* xoffset */, 0 /* yoffset */, m_metadata.width, m_metadata.height, format, GL_FLOAT, data);
-        glGenerateTextureMipmap(m_obj_name);
+        glCreateTextures   (GLenum(TextureType::Texture2D), 1, &m_obj_name);
+        glTextureStorage2D (m_obj_name, num_mipmaps, GL_RGB9_E5, m_metadata.width, m_metadata.height);
+        glTextureSubImage2D(m_obj_name, 0 /* level */, 0 /* xoffset */, 0 /* yoffset */, m_metadata.width, m_metadata.height, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, texels.data());
+        GpuMemory::TrackTexture(m_obj_name, "Texture");
+
+        /* RGB9_E5 isn't color-renderable, so glGenerateTextureMipmap can't build the levels. */
+        std::vector<uint32_t> level_texels;
+        uint32_t              width  = m_metadata.width;
+        uint32_t              height = m_metadata.height;
+
+        for (GLuint level = 1; level < num_mipmaps; ++level)
+        {
+            level_texels.resize(size_t(std::max(width / 2, 1u)) * std::max(height / 2, 1u));
+            Util::DownsampleImageRgb9e5(texels.data(), width, height, level_texels.data());
+
+            width  = std::max(width  / 2, 1u);
+            height = std::max(height / 2, 1u);
+
+            glTextureSubImage2D(m_obj_name, level, 0 /* xoffset */, 0 /* yoffset */, width, height, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, level_texels.data());
+            texels.swap(level_texels);
+        }
 
-        SetFiltering(TextureFiltering::MIN,       TextureFilteringParam::LINEAR);
+        SetFiltering(TextureFiltering::MIN,       num_mipmaps > 1 ? TextureFilteringParam::LINEAR_MIP_LINEAR : TextureFilteringParam::LINEAR);
         SetFiltering(TextureFiltering::MAG,       TextureFilteringParam::LINEAR);
         SetWraping  (TextureWrapingCoordinate::S, TextureWrapingParam::CLAMP_TO_EDGE);
         SetWraping  (TextureWrapingCoordinate::T, TextureWrapingParam::CLAMP_TO_EDGE);
 
-        Util::ReleaseTextureData(data);
-
         return true;
     }
 
     bool Texture2D::LoadDds(const std::filesystem::path& filepath)
     {
+        MappedFile file(filepath);
+
+        if (!file.IsOpen())
+        {
+            return false;
+        }
+
+        /* tinyddsloader keeps its own copy of the data (Flip() works in place), it's made straight from the mapping. */
         DDSFile dds;
-        auto ret = dds.Load(filepath.string().c_str());
+        auto ret = dds.Load(file.GetData(), file.GetSize());
 
         if (Result::Success != ret)
         {
@@ -375,6 +658,7 @@ namespace RGL
         m_metadata.height = dds.GetHeight();
 
         glTextureStorage2D(m_obj_name, dds.GetMipCount(), format.m_internal_format, m_metadata.width, m_metadata.height);
+        GpuMemory::TrackTexture(m_obj_name, "Texture");
         dds.Flip();
 
         for (uint32_t level = 0; level < dds.GetMipCount(); level++)
@@ -405,36 +689,389 @@ namespace RGL
         return true;
     }
 
-    // --------------------- Texture CubeMap -------------------------
+    bool Texture2D::IsKtx2(const uint8_t* data, size_t size)
+    {
+        return size >= sizeof(KTX2_IDENTIFIER) && std::memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+    }
 
-    bool TextureCubeMap::Load(const std::filesystem::path* filepaths, bool is_srgb, uint32_t num_mipmaps)
+    bool Texture2D::LoadKtx2(const std::filesystem::path& filepath, bool is_srgb)
     {
-        constexpr int NUM_FACES = 6;
+        MappedFile file(filepath);
 
-        unsigned char* images_data[NUM_FACES];
+        if (!file.IsOpen())
+        {
+            return false;
+        }
 
-        for (int i = 0; i < NUM_FACES; ++i)
+        return LoadKtx2(file.GetData(), file.GetSize(), is_srgb, filepath);
+    }
+
+    bool Texture2D::LoadKtx2(const uint8_t* data, size_t size, bool is_srgb, const std::filesystem::path& filepath)
+    {
+        Ktx2Header header = {};
+
+        if (size >= sizeof(header))
+        {
+            std::memcpy(&header, data, sizeof(header));
+        }
+
+        if (std::memcmp(header.m_identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+        {
+            fprintf(stderr, "Texture2D::LoadKtx2: %s is not a KTX2 file.\n", filepath.string().c_str());
+            return false;
+        }
+
+        if (header.m_pixel_depth > 1 || header.m_layer_count > 1 || header.m_face_count != 1)
+        {
+            fprintf(stderr, "Texture2D::LoadKtx2: %s is not a 2D texture.\n", filepath.string().c_str());
+            return false;
+        }
+
+        const uint32_t levels_count = std::max(header.m_level_count, 1u);
+
+        if (header.m_vk_format == KTX2_VK_FORMAT_UNDEFINED)
         {
-            images_data[i] = Util::LoadTextureData(filepaths[i], m_metadata);
+            return LoadBasisKtx2(filepath, data, size, is_srgb);
+        }
+
+        const GLenum internal_format = translateKtx2Format(header.m_vk_format);
 
-            if (!images_data[i])
+        if (internal_format == 0 || header.m_supercompression_scheme != 0)
+        {
+            fprintf(stderr, "Texture2D::LoadKtx2: %s - VkFormat %u / supercompression %u is not supported.\n", 
+                    filepath.string().c_str(), header.m_vk_format, header.m_supercompression_scheme);
+            return false;
+        }
+
+        if (size < sizeof(header) + levels_count * sizeof(Ktx2Level))
+        {
+            fprintf(stderr, "Texture2D::LoadKtx2: %s is truncated.\n", filepath.string().c_str());
+            return false;
+        }
+
+        std::vector<Ktx2Level> levels(levels_count);
+        std::memcpy(levels.data(), data + sizeof(header), levels_count * sizeof(Ktx2Level));
+
+        for (const auto& level : levels)
+        {
+            if (level.m_byte_offset + level.m_byte_length > size)
             {
-                fprintf(stderr, "Texture failed to load at path: %s\n", filepaths[i].string().c_str());
+                fprintf(stderr, "Texture2D::LoadKtx2: %s is truncated.\n", filepath.string().c_str());
+                return false;
+            }
+        }
+
+        m_type              = TextureType::Texture2D;
+        m_metadata.width    = header.m_pixel_width;
+        m_metadata.height   = header.m_pixel_height;
+        m_metadata.channels = 4;
+
+        glCreateTextures  (GLenum(m_type), 1, &m_obj_name);
+        glTextureStorage2D(m_obj_name, levels_count, internal_format, m_metadata.width, m_metadata.height);
+        GpuMemory::TrackTexture(m_obj_name, "Texture");
+
+        /* The blocks are uploaded straight from the mapped file, or the memory. */
+        for (uint32_t level = 0; level < levels_count; ++level)
+        {
+            const GLsizei width  = std::max(m_metadata.width  >> level, 1u);
+            const GLsizei height = std::max(m_metadata.height >> level, 1u);
+
+            glCompressedTextureSubImage2D(m_obj_name, level, 0, 0, width, height, internal_format, GLsizei(levels[level].m_byte_length), data + levels[level].m_byte_offset);
+        }
+
+        SetFiltering(TextureFiltering::MIN,       levels_count > 1 ? TextureFilteringParam::LINEAR_MIP_LINEAR : TextureFilteringParam::LINEAR);
+        SetFiltering(TextureFiltering::MAG,       TextureFilteringParam::LINEAR);
+        SetWraping  (TextureWrapingCoordinate::S, TextureWrapingParam::CLAMP_TO_EDGE);
+        SetWraping  (TextureWrapingCoordinate::T, TextureWrapingParam::CLAMP_TO_EDGE);
+
+        return true;
+    }
+
+    bool Texture2D::LoadBasisKtx2(const std::filesystem::path& filepath, const uint8_t* data, size_t size, bool is_srgb)
+    {
+        basist::ktx2_transcoder transcoder;
+
+        if (!startBasisTranscoding(transcoder, data, size))
+        {
+            fprintf(stderr, "Texture2D::LoadKtx2: could not start transcoding %s.\n", filepath.string().c_str());
+            return false;
+        }
+
+        basist::transcoder_texture_format target_format;
+        GLenum                            internal_format;
+
+        selectBasisFormat(transcoder, is_srgb, &target_format, &internal_format);
+
+        const uint32_t levels_count = std::max(transcoder.get_levels(), 1u);
+        const uint32_t block_size   = basist::basis_get_bytes_per_block_or_pixel(target_format);
+
+        m_type              = TextureType::Texture2D;
+        m_metadata.width    = transcoder.get_width();
+        m_metadata.height   = transcoder.get_height();
+        m_metadata.channels = 4;
+
+        glCreateTextures  (GLenum(m_type), 1, &m_obj_name);
+        glTextureStorage2D(m_obj_name, levels_count, internal_format, m_metadata.width, m_metadata.height);
+        GpuMemory::TrackTexture(m_obj_name, "Texture");
+
+        std::vector<uint8_t> blocks;
+
+        for (uint32_t level = 0; level < levels_count; ++level)
+        {
+            basist::ktx2_image_level_info level_info;
+
+            if (!transcoder.get_image_level_info(level_info, level, 0, 0))
+            {
+                fprintf(stderr, "Texture2D::LoadKtx2: %s - invalid level %u.\n", filepath.string().c_str(), level);
+                Release();
+                return false;
+            }
+
+            blocks.resize(size_t(level_info.m_total_blocks) * block_size);
+
+            if (!transcoder.transcode_image_level(level, 0, 0, blocks.data(), level_info.m_total_blocks, target_format))
+            {
+                fprintf(stderr, "Texture2D::LoadKtx2: could not transcode level %u of %s.\n", level, filepath.string().c_str());
+                Release();
+                return false;
+            }
+
+            glCompressedTextureSubImage2D(m_obj_name, level, 0, 0, level_info.m_orig_width, level_info.m_orig_height, internal_format, GLsizei(blocks.size()), blocks.data());
+        }
+
+        SetFiltering(TextureFiltering::MIN,       levels_count > 1 ? TextureFilteringParam::LINEAR_MIP_LINEAR : TextureFilteringParam::LINEAR);
+        SetFiltering(TextureFiltering::MAG,       TextureFilteringParam::LINEAR);
+        SetWraping  (TextureWrapingCoordinate::S, TextureWrapingParam::CLAMP_TO_EDGE);
+        SetWraping  (TextureWrapingCoordinate::T, TextureWrapingParam::CLAMP_TO_EDGE);
+
+        return true;
+    }
+
+    // --------------------- Texture 2D Array -------------------------
+
+    bool Texture2DArray::Load(const std::vector<std::filesystem::path>& filepaths, bool is_srgb, uint32_t num_mipmaps, MipmapFilter mipmap_filter)
+    {
+        if (filepaths.empty())
+        {
+            return false;
+        }
+
+        const GLenum internal_format = is_srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+
+        /* Decoded one by one - only a single layer is in the memory at a time. */
+        for (uint32_t layer = 0; layer < uint32_t(filepaths.size()); ++layer)
+        {
+            ImageData metadata;
+            auto data = Util::LoadTextureData(filepaths[layer], metadata, 4);
+
+            if (!data)
+            {
+                fprintf(stderr, "Texture failed to load at path: %s\n", filepaths[layer].string().c_str());
+                Release();
+                return false;
+            }
+
+            if (layer == 0)
+            {
+                m_metadata          = metadata;
+                m_metadata.channels = 4;
+                m_layers_count      = uint32_t(filepaths.size());
+
+                const GLuint max_num_mipmaps = GetMaxMipMapsLevels(m_metadata.width, m_metadata.height, 0);
+                             num_mipmaps     = num_mipmaps == 0 ? max_num_mipmaps : glm::clamp(num_mipmaps, 1u, max_num_mipmaps);
+
+                m_type = TextureType::Texture2DArray;
+
+                glCreateTextures  (GLenum(m_type), 1, &m_obj_name);
+                glTextureStorage3D(m_obj_name, num_mipmaps, internal_format, m_metadata.width, m_metadata.height, m_layers_count);
+                GpuMemory::TrackTexture(m_obj_name, "Texture");
+            }
+            else if (metadata.width != m_metadata.width || metadata.height != m_metadata.height)
+            {
+                fprintf(stderr, "Texture2DArray::Load: %s is %ux%u, the array is %ux%u.\n", 
+                        filepaths[layer].string().c_str(), metadata.width, metadata.height, m_metadata.width, m_metadata.height);
+
+                Util::ReleaseTextureData(data);
+                Release();
                 return false;
             }
+
+            glTextureSubImage3D(m_obj_name, 0 /* level */, 0, 0, layer, m_metadata.width, m_metadata.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+            Util::ReleaseTextureData(data);
+        }
+
+        GenerateMipmaps(internal_format, m_layers_count, num_mipmaps, mipmap_filter);
+
+        SetFiltering(TextureFiltering::MIN,       num_mipmaps > 1 ? TextureFilteringParam::LINEAR_MIP_LINEAR : TextureFilteringParam::LINEAR);
+        SetFiltering(TextureFiltering::MAG,       TextureFilteringParam::LINEAR);
+        SetWraping  (TextureWrapingCoordinate::S, TextureWrapingParam::CLAMP_TO_EDGE);
+        SetWraping  (TextureWrapingCoordinate::T, TextureWrapingParam::CLAMP_TO_EDGE);
+
+        return true;
+    }
+
+    bool Texture2DArray::LoadKtx2(const std::filesystem::path& filepath, bool is_srgb)
+    {
+        MappedFile file(filepath);
+
+        if (!file.IsOpen())
+        {
+            return false;
+        }
+
+        basist::ktx2_transcoder transcoder;
+
+        if (!startBasisTranscoding(transcoder, file.GetData(), file.GetSize()))
+        {
+            fprintf(stderr, "Texture2DArray::LoadKtx2: %s is not a Basis Universal KTX2 file.\n", filepath.string().c_str());
+            return false;
+        }
+
+        if (transcoder.get_faces() != 1)
+        {
+            fprintf(stderr, "Texture2DArray::LoadKtx2: %s is a cube map.\n", filepath.string().c_str());
+            return false;
         }
 
-        GLuint m_format          = m_metadata.channels == 4 ? GL_RGBA         : GL_RGB;
-        GLuint m_internal_format = is_srgb                  ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        basist::transcoder_texture_format target_format;
+        GLenum                            internal_format;
+
+        selectBasisFormat(transcoder, is_srgb, &target_format, &internal_format);
+
+        /* A plain 2D texture is an array of one layer. */
+        const uint32_t levels_count = std::max(transcoder.get_levels(), 1u);
+        const uint32_t block_size   = basist::basis_get_bytes_per_block_or_pixel(target_format);
+
+        m_type              = TextureType::Texture2DArray;
+        m_metadata.width    = transcoder.get_width();
+        m_metadata.height   = transcoder.get_height();
+        m_metadata.channels = 4;
+        m_layers_count      = std::max(transcoder.get_layers(), 1u);
+
+        glCreateTextures  (GLenum(m_type), 1, &m_obj_name);
+        glTextureStorage3D(m_obj_name, levels_count, internal_format, m_metadata.width, m_metadata.height, m_layers_count);
+        GpuMemory::TrackTexture(m_obj_name, "Texture");
+
+        std::vector<uint8_t> blocks;
+
+        for (uint32_t level = 0; level < levels_count; ++level)
+        {
+            for (uint32_t layer = 0; layer < m_layers_count; ++layer)
+            {
+                basist::ktx2_image_level_info level_info;
+
+                if (!transcoder.get_image_level_info(level_info, level, layer, 0))
+                {
+                    fprintf(stderr, "Texture2DArray::LoadKtx2: %s - invalid level %u of the layer %u.\n", filepath.string().c_str(), level, layer);
+                    Release();
+                    return false;
+                }
+
+                blocks.resize(size_t(level_info.m_total_blocks) * block_size);
+
+                if (!transcoder.transcode_image_level(level, layer, 0, blocks.data(), level_info.m_total_blocks, target_format))
+                {
+                    fprintf(stderr, "Texture2DArray::LoadKtx2: could not transcode level %u of the layer %u of %s.\n", level, layer, filepath.string().c_str());
+                    Release();
+                    return false;
+                }
+
+                glCompressedTextureSubImage3D(m_obj_name, level, 0, 0, layer, level_info.m_orig_width, level_info.m_orig_height, 1,
+                                              internal_format, GLsizei(blocks.size()), blocks.data());
+            }
+        }
+
+        SetFiltering(TextureFiltering::MIN,       levels_count > 1 ? TextureFilteringParam::LINEAR_MIP_LINEAR : TextureFilteringParam::LINEAR);
+        SetFiltering(TextureFiltering::MAG,       TextureFilteringParam::LINEAR);
+        SetWraping  (TextureWrapingCoordinate::S, TextureWrapingParam::CLAMP_TO_EDGE);
+        SetWraping  (TextureWrapingCoordinate::T, TextureWrapingParam::CLAMP_TO_EDGE);
+
+        return true;
+    }
+
+    // --------------------- Texture CubeMap -------------------------
+
+    bool TextureCubeMap::Load(const std::filesystem::path* filepaths, bool is_srgb, uint32_t num_mipmaps)
+    {
+        constexpr int NUM_FACES = 6;
+        constexpr int CHANNELS  = 4;
+
+        if (!Util::LoadTextureInfo(filepaths[0], m_metadata))
+        {
+            fprintf(stderr, "Texture failed to load at path: %s\n", filepaths[0].string().c_str());
+            return false;
+        }
+
+        m_metadata.channels = CHANNELS;
+
+        /* The faces are decoded on the job system into their regions of the staging buffer. */
+        const GLsizeiptr face_size = GLsizeiptr(m_metadata.width) * m_metadata.height * CHANNELS;
+        const GLbitfield flags     = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        GLuint staging_buffer_name = 0;
+        glCreateBuffers     (1, &staging_buffer_name);
+        glNamedBufferStorage(staging_buffer_name, face_size * NUM_FACES, nullptr, flags);
+
+        auto* staging_data = static_cast<uint8_t*>(glMapNamedBufferRange(staging_buffer_name, 0, face_size * NUM_FACES, flags));
+
+        if (!staging_data)
+        {
+            fprintf(stderr, "TextureCubeMap::Load: could not map the staging buffer.\n");
+            glDeleteBuffers(1, &staging_buffer_name);
+
+            return false;
+        }
+
+        JobSystem::Counter counters [NUM_FACES];
+        bool               is_loaded[NUM_FACES] = {};
+        const ImageData    metadata             = m_metadata;
+
+        for (int i = 0; i < NUM_FACES; ++i)
+        {
+            JobSystem::Run([i, filepaths, face_size, staging_data, &metadata, &is_loaded]
+            {
+                ImageData      face_metadata;
+                unsigned char* face_data = Util::LoadTextureData(filepaths[i], face_metadata, CHANNELS);
+
+                if (face_data && face_metadata.width == metadata.width && face_metadata.height == metadata.height)
+                {
+                    std::memcpy(staging_data + face_size * i, face_data, face_size);
+                    is_loaded[i] = true;
+                }
+
+                if (face_data)
+                {
+                    Util::ReleaseTextureData(face_data);
+                }
+            }, &counters[i]);
+        }
 
         const GLuint max_num_mipmaps = GetMaxMipMapsLevels(m_metadata.width, m_metadata.height, 0);
                      num_mipmaps     = num_mipmaps == 0 ? max_num_mipmaps : glm::clamp(num_mipmaps, 1u, max_num_mipmaps);
 
-        glCreateTextures  (GLenum(TextureType::TextureCubeMap), 1, &m_obj_name);
-        glTextureStorage2D(m_obj_name, num_mipmaps, m_internal_format, m_metadata.width, m_metadata.height);
+        m_type = TextureType::TextureCubeMap;
+
+        glCreateTextures  (GLenum(m_type), 1, &m_obj_name);
+        glTextureStorage2D(m_obj_name, num_mipmaps, is_srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, m_metadata.width, m_metadata.height);
+        GpuMemory::TrackTexture(m_obj_name, "Texture");
+
+        /* Every face is uploaded as soon as it's decoded, all the jobs are waited for even if one fails. */
+        bool is_complete = true;
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging_buffer_name);
 
         for (int i = 0; i < NUM_FACES; ++i)
         {
+            JobSystem::Wait(counters[i]);
+
+            if (!is_loaded[i])
+            {
+                fprintf(stderr, "Texture failed to load at path: %s\n", filepaths[i].string().c_str());
+                is_complete = false;
+
+                continue;
+            }
+
             glTextureSubImage3D(m_obj_name, 
                                 0 /*level*/, 
                                 0 /*xoffset*/, 
@@ -443,26 +1080,104 @@ namespace RGL
                                 m_metadata.width,
                                 m_metadata.height,
                                 1 /*depth*/,
-                                m_format,
+                                GL_RGBA,
                                 GL_UNSIGNED_BYTE,
-                                images_data[i]);
+                                reinterpret_cast<void*>(face_size * i));
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        /* The driver keeps the storage until the uploads are done. */
+        glUnmapNamedBuffer(staging_buffer_name);
+        glDeleteBuffers   (1, &staging_buffer_name);
+
+        if (!is_complete)
+        {
+            Release();
+            return false;
         }
 
         glGenerateTextureMipmap(m_obj_name);
+        SetDefaultParameters();
 
-        SetFiltering(TextureFiltering::MIN,       TextureFilteringParam::LINEAR_MIP_LINEAR);
-        SetFiltering(TextureFiltering::MAG,       TextureFilteringParam::LINEAR);
-        SetWraping  (TextureWrapingCoordinate::S, TextureWrapingParam::CLAMP_TO_EDGE);
-        SetWraping  (TextureWrapingCoordinate::T, TextureWrapingParam::CLAMP_TO_EDGE);
-        SetWraping  (TextureWrapingCoordinate::R, TextureWrapingParam::CLAMP_TO_EDGE);
+        return true;
+    }
 
-        for (int i = 0; i < NUM_FACES; ++i)
+    bool TextureCubeMap::LoadDds(const std::filesystem::path& filepath)
+    {
+        MappedFile file(filepath);
+
+        if (!file.IsOpen())
+        {
+            return false;
+        }
+
+        DDSFile dds;
+        auto ret = dds.Load(file.GetData(), file.GetSize());
+
+        if (Result::Success != ret)
+        {
+            fprintf(stderr, "TextureCubeMap::LoadDds: %s failed to load, result: %d.\n", filepath.string().c_str(), int(ret));
+            return false;
+        }
+
+        /* tinyddsloader counts the faces as the array layers of a cubemap. */
+        if (!dds.IsCubemap() || dds.GetArraySize() < 6)
+        {
+            fprintf(stderr, "TextureCubeMap::LoadDds: %s is not a cubemap.\n", filepath.string().c_str());
+            return false;
+        }
+
+        GLFormat format;
+        if (!translateDdsFormat(dds.GetFormat(), &format))
+        {
+            return false;
+        }
+
+        m_type            = TextureType::TextureCubeMap;
+        m_metadata.width  = dds.GetWidth();
+        m_metadata.height = dds.GetHeight();
+
+        glCreateTextures   (GLenum(m_type), 1, &m_obj_name);
+        glTextureParameteri(m_obj_name, GL_TEXTURE_BASE_LEVEL, 0);
+        glTextureParameteri(m_obj_name, GL_TEXTURE_MAX_LEVEL, dds.GetMipCount() - 1);
+        glTextureParameteri(m_obj_name, GL_TEXTURE_SWIZZLE_R, format.m_swizzle.m_r);
+        glTextureParameteri(m_obj_name, GL_TEXTURE_SWIZZLE_G, format.m_swizzle.m_g);
+        glTextureParameteri(m_obj_name, GL_TEXTURE_SWIZZLE_B, format.m_swizzle.m_b);
+        glTextureParameteri(m_obj_name, GL_TEXTURE_SWIZZLE_A, format.m_swizzle.m_a);
+        glTextureStorage2D (m_obj_name, dds.GetMipCount(), format.m_internal_format, m_metadata.width, m_metadata.height);
+        GpuMemory::TrackTexture(m_obj_name, "Texture");
+
+        /* The faces are stored top-down like the cubemap faces are sampled, so there's no Flip(). */
+        for (uint32_t face = 0; face < 6; ++face)
         {
-            /* Release images' data */
-            Util::ReleaseTextureData(images_data[i]);
+            for (uint32_t level = 0; level < dds.GetMipCount(); ++level)
+            {
+                auto image_data = dds.GetImageData(level, face);
+
+                if (isDdsCompressed(format.m_format))
+                {
+                    glCompressedTextureSubImage3D(m_obj_name, level, 0, 0, face, image_data->m_width, image_data->m_height, 1, format.m_format, image_data->m_memSlicePitch, image_data->m_mem);
+                }
+                else
+                {
+                    glTextureSubImage3D(m_obj_name, level, 0, 0, face, image_data->m_width, image_data->m_height, 1, format.m_format, format.m_type, image_data->m_mem);
+                }
+            }
         }
 
+        SetDefaultParameters();
+
         return true;
     }
 
+    void TextureCubeMap::SetDefaultParameters()
+    {
+        SetFiltering(TextureFiltering::MIN,       TextureFilteringParam::LINEAR_MIP_LINEAR);
+        SetFiltering(TextureFiltering::MAG,       TextureFilteringParam::LINEAR);
+        SetWraping  (TextureWrapingCoordinate::S, TextureWrapingParam::CLAMP_TO_EDGE);
+        SetWraping  (TextureWrapingCoordinate::T, TextureWrapingParam::CLAMP_TO_EDGE);
+        SetWraping  (TextureWrapingCoordinate::R, TextureWrapingParam::CLAMP_TO_EDGE);
+    }
+
 }
\ No newline at end of file
@@ -1,13 +1,18 @@
 #pragma once
+#include "gl_state.h"
+#include "gpu_memory.h"
+#include "mipmap_generator.h"
+#include "texture_streamer.h"
 #include "util.h"
 
 #include <glad/glad.h>
 #include <string_view>
 #include <filesystem>
+#include <vector>
 
 namespace RGL
 {
-    enum class TextureType              { NONE = 0, Texture2D = GL_TEXTURE_2D, TextureCubeMap = GL_TEXTURE_CUBE_MAP };
+    enum class TextureType              { NONE = 0, Texture2D = GL_TEXTURE_2D, Texture2DArray = GL_TEXTURE_2D_ARRAY, TextureCubeMap = GL_TEXTURE_CUBE_MAP };
     enum class TextureFiltering         { MAG                  = GL_TEXTURE_MAG_FILTER,
                                           MIN                  = GL_TEXTURE_MIN_FILTER };
     enum class TextureFilteringParam    { NEAREST              = GL_NEAREST,
@@ -71,12 +76,13 @@ namespace RGL
         void SetCompareFunc(TextureCompareFunc func);
         void SetAnisotropy(float anisotropy);
 
-        void Bind(uint32_t texture_unit) { glBindSampler(texture_unit, m_so_id); }
+        void Bind(uint32_t texture_unit) { GLState::BindSampler(texture_unit, m_so_id); }
 
     private:
         void Release()
         {
             glDeleteSamplers(1, &m_so_id);
+            GLState::OnSamplerDeleted(m_so_id);
             m_so_id = 0;
         }
 
@@ -92,9 +98,16 @@ namespace RGL
         Texture           (const Texture&) = delete;
         Texture& operator=(const Texture&) = delete;
 
-        Texture(Texture&& other) noexcept : m_metadata(other.m_metadata), m_type(other.m_type), m_obj_name(other.m_obj_name)
+        Texture(Texture&& other) noexcept 
+            : m_metadata       (other.m_metadata), 
+              m_type           (other.m_type), 
+              m_obj_name       (other.m_obj_name),
+              m_bindless_handle(other.m_bindless_handle),
+              m_is_resident    (other.m_is_resident)
         {
-            other.m_obj_name = 0;
+            other.m_obj_name        = 0;
+            other.m_bindless_handle = 0;
+            other.m_is_resident     = false;
         }
 
         Texture& operator=(Texture&& other) noexcept
@@ -103,15 +116,17 @@ namespace RGL
             {
                 Release();
 
-                std::swap(m_metadata, other.m_metadata);
-                std::swap(m_type,     other.m_type);
-                std::swap(m_obj_name, other.m_obj_name);
+                std::swap(m_metadata,        other.m_metadata);
+                std::swap(m_type,            other.m_type);
+                std::swap(m_obj_name,        other.m_obj_name);
+                std::swap(m_bindless_handle, other.m_bindless_handle);
+                std::swap(m_is_resident,     other.m_is_resident);
             }
 
             return *this;
         }
 
-        virtual void Bind(uint32_t unit) { glBindTextureUnit(unit, m_obj_name); }
+        virtual void Bind(uint32_t unit) { GLState::BindTextureUnit(unit, m_obj_name); }
         virtual void SetFiltering(TextureFiltering type, TextureFilteringParam param);
         virtual void SetMinLod(float min);
         virtual void SetMaxLod(float max);
@@ -122,6 +137,21 @@ namespace RGL
         virtual void SetAnisotropy(float anisotropy);
         
         virtual ImageData GetMetadata() const { return m_metadata; };
+        GLuint            GetName()     const { return m_obj_name; }
+
+        /* Bytes of the GPU storage of all the levels, queried from GL. */
+        virtual size_t GetMemorySize() const;
+
+        /*
+         * ARB_bindless_texture support. Creating the handle makes the texture's state immutable,
+         * so all the Set* calls have to be done before the first GetBindlessHandle() call.
+         */
+        static bool IsBindlessSupported() { return GLAD_GL_ARB_bindless_texture; }
+
+        virtual GLuint64 GetBindlessHandle();
+        virtual void     MakeResident();
+        virtual void     MakeNonResident();
+        virtual bool     IsResident() const { return m_is_resident; }
 
         static uint8_t GetMaxMipMapsLevels(uint32_t width, uint32_t height, uint32_t depth)
         {
@@ -130,33 +160,122 @@ namespace RGL
         }
 
     protected:
-        Texture() : m_type(TextureType::NONE), m_obj_name(0) {}
+        Texture() : m_type(TextureType::NONE), m_obj_name(0), m_bindless_handle(0), m_is_resident(false) {}
+
+        /* Builds the levels 1..levels_count - 1 with MipmapGenerator when it's enabled and supports the format, with GL otherwise. */
+        void GenerateMipmaps(GLenum internal_format, uint32_t layers_count, uint32_t levels_count, MipmapFilter filter);
 
         void Release()
         {
+            if (m_is_resident)
+            {
+                glMakeTextureHandleNonResidentARB(m_bindless_handle);
+                m_is_resident = false;
+            }
+
+            if (m_obj_name != 0)
+            {
+                TextureStreamer::Cancel(m_obj_name);
+            }
+
+            GpuMemory::UntrackTexture(m_obj_name);
             glDeleteTextures(1, &m_obj_name);
-            m_obj_name = 0;
+            GLState::OnTextureDeleted(m_obj_name);
+            m_obj_name        = 0;
+            m_bindless_handle = 0;
         }
 
         ImageData   m_metadata;
         TextureType m_type;
         GLuint      m_obj_name;
+        GLuint64    m_bindless_handle;
+        bool        m_is_resident;
     };
 
     class Texture2D : public Texture
     {
     public:
         Texture2D() = default;
-        bool Load(const std::filesystem::path & filepath, bool is_srgb = false, uint32_t num_mipmaps = 0);
-        bool Load(unsigned char* memory_data, uint32_t data_size, bool is_srgb = false, uint32_t num_mipmaps = 0);
+
+        /*
+         * Loads the .ktx2 file next to the image instead (see LoadKtx2()) if there's one at least as new as the image.
+         * Otherwise the image is streamed (see LoadStreaming()) when TextureStreamer is enabled.
+         */
+        bool Load(const std::filesystem::path & filepath, bool is_srgb = false, uint32_t num_mipmaps = 0, MipmapFilter mipmap_filter = MipmapFilter::COLOR);
+        bool Load(unsigned char* memory_data, uint32_t data_size, bool is_srgb = false, uint32_t num_mipmaps = 0, MipmapFilter mipmap_filter = MipmapFilter::COLOR);
+
+        /* Radiance .hdr as GL_RGB9_E5 (see Util::LoadTextureDataHdrRgb9e5()), the mip levels are filtered on the CPU. */
         bool LoadHdr(const std::filesystem::path& filepath, uint32_t num_mipmaps = 0);
         bool LoadDds(const std::filesystem::path& filepath);
+
+        /*
+         * KTX2 with BC1/BC3/BC4/BC5/BC6H/BC7 blocks is uploaded as is, with all the mip levels in the file.
+         * Basis Universal (ETC1S/UASTC) data is transcoded to BC7, or to BC1 for opaque ETC1S.
+         * is_srgb applies to the Basis data only, the BCn formats carry their own color space.
+         */
+        bool LoadKtx2(const std::filesystem::path& filepath, bool is_srgb = false);
+
+        /* KTX2 data in the memory, e.g. embedded in a GLB. The BCn blocks are uploaded from it as they are, filepath names it in the messages. */
+        bool LoadKtx2(const uint8_t* data, size_t size, bool is_srgb = false, const std::filesystem::path& filepath = "memory");
+
+        static bool IsKtx2(const uint8_t* data, size_t size);
+
+        /*
+         * Allocates the storage and returns without decoding the image, TextureStreamer uploads the levels
+         * over the next frames. Until then the texture samples the levels that are already resident.
+         */
+        bool LoadStreaming(const std::filesystem::path& filepath, bool is_srgb = false, uint32_t num_mipmaps = 0);
+
+        /* Creates the texture from already decoded 8-bit data, e.g. decoded by Util::LoadTextureData on a worker thread. */
+        bool Create(const ImageData& metadata, const unsigned char* data, bool is_srgb = false, uint32_t num_mipmaps = 0, MipmapFilter mipmap_filter = MipmapFilter::COLOR);
+
+        /* Whether Load() would decode the image itself - no baked .ktx2 and no streaming - so it can be decoded off the GL thread and Create()d. */
+        static bool IsDecodedOnLoad(const std::filesystem::path& filepath);
+
+    private:
+        bool LoadBasisKtx2(const std::filesystem::path& filepath, const uint8_t* data, size_t size, bool is_srgb);
+
+        /* The .ktx2 baked by texture_baker next to the image, empty if there's none or the image is newer. */
+        static std::filesystem::path GetBakedFilepath(const std::filesystem::path& filepath);
+    };
+
+    /*
+     * Same-size textures as the layers of one texture, e.g. the material textures of several meshes - a single bind
+     * for all of them, so their draws can be batched. Load() packs the images at runtime, LoadKtx2() loads the arrays
+     * baked by texture_baker --array.
+     */
+    class Texture2DArray : public Texture
+    {
+    public:
+        Texture2DArray() = default;
+
+        /* Every image is a layer, expanded to RGBA. All of them have to be of the same size. */
+        bool Load(const std::vector<std::filesystem::path>& filepaths, bool is_srgb = false, uint32_t num_mipmaps = 0, MipmapFilter mipmap_filter = MipmapFilter::COLOR);
+
+        /* Basis Universal data only, transcoded like in Texture2D::LoadKtx2(). */
+        bool LoadKtx2(const std::filesystem::path& filepath, bool is_srgb = false);
+
+        uint32_t GetLayersCount() const { return m_layers_count; }
+
+    private:
+        uint32_t m_layers_count = 0;
     };
 
     class TextureCubeMap : public Texture
     {
     public:
         TextureCubeMap() = default;
+
+        /*
+         * The faces in the +X, -X, +Y, -Y, +Z, -Z order, all of the same size. They're decoded in parallel on the job system
+         * into a staging buffer, each one uploaded as soon as it's decoded.
+         */
         bool Load(const std::filesystem::path * filepaths, bool is_srgb = false, uint32_t num_mipmaps = 0);
+
+        /* A single DDS cubemap with its mip levels, nothing is decoded. */
+        bool LoadDds(const std::filesystem::path& filepath);
+
+    private:
+        void SetDefaultParameters();
     };
 }
@@ -0,0 +1,185 @@
+#include "texture_cache.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "texture.h"
+
+namespace RGL
+{
+    std::mutex                                           TextureCache::s_mutex;
+    std::unordered_map<std::string, TextureCache::Entry> TextureCache::s_entries;
+    size_t                                               TextureCache::s_budget          = TextureCache::DEFAULT_BUDGET;
+    uint64_t                                             TextureCache::s_request_counter = 0;
+
+    std::shared_ptr<Texture2D> TextureCache::Load(const std::filesystem::path& filepath, bool is_srgb, uint32_t num_mipmaps, MipmapFilter mipmap_filter)
+    {
+        const std::string key = MakeKey(filepath, is_srgb, false, num_mipmaps, mipmap_filter);
+
+        if (auto texture = FindEntry(key))
+        {
+            return texture;
+        }
+
+        /* Loaded outside of the lock, a texture can take a while. */
+        auto texture = std::make_shared<Texture2D>();
+
+        if (!texture->Load(filepath, is_srgb, num_mipmaps, mipmap_filter))
+        {
+            return nullptr;
+        }
+
+        return AddEntry(key, texture);
+    }
+
+    std::shared_ptr<Texture2D> TextureCache::LoadHdr(const std::filesystem::path& filepath, uint32_t num_mipmaps)
+    {
+        const std::string key = MakeKey(filepath, false, true, num_mipmaps, MipmapFilter::COLOR);
+
+        if (auto texture = FindEntry(key))
+        {
+            return texture;
+        }
+
+        auto texture = std::make_shared<Texture2D>();
+
+        if (!texture->LoadHdr(filepath, num_mipmaps))
+        {
+            return nullptr;
+        }
+
+        return AddEntry(key, texture);
+    }
+
+    std::shared_ptr<Texture2D> TextureCache::Find(const std::filesystem::path& filepath, bool is_srgb, uint32_t num_mipmaps, MipmapFilter mipmap_filter)
+    {
+        return FindEntry(MakeKey(filepath, is_srgb, false, num_mipmaps, mipmap_filter));
+    }
+
+    std::shared_ptr<Texture2D> TextureCache::Add(const std::filesystem::path& filepath, bool is_srgb, uint32_t num_mipmaps, MipmapFilter mipmap_filter, std::shared_ptr<Texture2D> texture)
+    {
+        return AddEntry(MakeKey(filepath, is_srgb, false, num_mipmaps, mipmap_filter), std::move(texture));
+    }
+
+    void TextureCache::SetBudget(size_t bytes)
+    {
+        std::lock_guard lock(s_mutex);
+
+        s_budget = bytes;
+        TrimLocked();
+    }
+
+    size_t TextureCache::GetSize()
+    {
+        std::lock_guard lock(s_mutex);
+
+        size_t size = 0;
+
+        for (const auto& [key, entry] : s_entries)
+        {
+            size += entry.m_size;
+        }
+
+        return size;
+    }
+
+    uint32_t TextureCache::GetCount()
+    {
+        std::lock_guard lock(s_mutex);
+        return uint32_t(s_entries.size());
+    }
+
+    void TextureCache::Trim()
+    {
+        std::lock_guard lock(s_mutex);
+        TrimLocked();
+    }
+
+    void TextureCache::Release()
+    {
+        std::lock_guard lock(s_mutex);
+        s_entries.clear();
+    }
+
+    std::string TextureCache::MakeKey(const std::filesystem::path& filepath, bool is_srgb, bool is_hdr, uint32_t num_mipmaps, MipmapFilter mipmap_filter)
+    {
+        /* "./a/../b.png" and "b.png" are the same file. weakly_canonical() doesn't need the file to exist. */
+        std::error_code ec;
+        auto            canonical_filepath = std::filesystem::weakly_canonical(filepath, ec);
+
+        if (ec)
+        {
+            canonical_filepath = std::filesystem::absolute(filepath, ec).lexically_normal();
+        }
+
+        return canonical_filepath.generic_string() + (is_hdr ? "|hdr|" : is_srgb ? "|srgb|" : "|linear|") + std::to_string(num_mipmaps) +
+               (mipmap_filter == MipmapFilter::NORMAL ? "|normal" : "");
+    }
+
+    std::shared_ptr<Texture2D> TextureCache::FindEntry(const std::string& key)
+    {
+        std::lock_guard lock(s_mutex);
+
+        auto it = s_entries.find(key);
+
+        if (it == s_entries.end())
+        {
+            return nullptr;
+        }
+
+        it->second.m_last_request = ++s_request_counter;
+        return it->second.m_texture;
+    }
+
+    std::shared_ptr<Texture2D> TextureCache::AddEntry(const std::string& key, std::shared_ptr<Texture2D> texture)
+    {
+        /* Streamed textures have their whole storage allocated up front, so the size is known right away. */
+        const size_t size = texture->GetMemorySize();
+
+        std::lock_guard lock(s_mutex);
+
+        auto [it, is_inserted] = s_entries.try_emplace(key, Entry { texture, size, 0 });
+        it->second.m_last_request = ++s_request_counter;
+
+        if (is_inserted)
+        {
+            TrimLocked();
+        }
+
+        return it->second.m_texture;
+    }
+
+    void TextureCache::TrimLocked()
+    {
+        std::vector<decltype(s_entries)::iterator> unused;
+        size_t                                     unused_size = 0;
+
+        /* The cache holds the only reference of the unused textures. */
+        for (auto it = s_entries.begin(); it != s_entries.end(); ++it)
+        {
+            if (it->second.m_texture.use_count() == 1)
+            {
+                unused.push_back(it);
+                unused_size += it->second.m_size;
+            }
+        }
+
+        if (unused_size <= s_budget)
+        {
+            return;
+        }
+
+        std::sort(unused.begin(), unused.end(), [](const auto& a, const auto& b) { return a->second.m_last_request < b->second.m_last_request; });
+
+        for (auto it : unused)
+        {
+            if (unused_size <= s_budget)
+            {
+                break;
+            }
+
+            unused_size -= it->second.m_size;
+            s_entries.erase(it);
+        }
+    }
+}
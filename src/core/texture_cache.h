@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "mipmap_generator.h"
+
+namespace RGL
+{
+    class Texture2D;
+
+    /*
+     * Shared textures loaded from files. The textures are keyed by the canonical path, the color space, the number
+     * of mip levels and their filter, so the models and the demos that use the same file get the same Texture2D - decoded and uploaded once.
+     * The cache keeps the textures alive after their last user is gone, until the textures no one uses take more than
+     * GetBudget() bytes of the VRAM - then the least recently requested ones are released. The textures still in use
+     * are never released, the budget applies to the unused ones only.
+     *
+     * The state set on a shared texture (wrapping, filtering) applies to all its users.
+     * Find() can be called from any thread, the rest needs the GL context.
+     * CoreApp sets the budget with --texture-cache [MB] and calls Release() before the context is destroyed.
+     */
+    class TextureCache
+    {
+    public:
+        static constexpr size_t DEFAULT_BUDGET = size_t(512) << 20;
+
+        /* Returns nullptr if the texture failed to load. */
+        static std::shared_ptr<Texture2D> Load   (const std::filesystem::path& filepath, bool is_srgb = false, uint32_t num_mipmaps = 0, MipmapFilter mipmap_filter = MipmapFilter::COLOR);
+        static std::shared_ptr<Texture2D> LoadHdr(const std::filesystem::path& filepath, uint32_t num_mipmaps = 0);
+
+        /* Returns nullptr if the texture isn't cached, doesn't load anything. */
+        static std::shared_ptr<Texture2D> Find(const std::filesystem::path& filepath, bool is_srgb = false, uint32_t num_mipmaps = 0, MipmapFilter mipmap_filter = MipmapFilter::COLOR);
+
+        /* Adds a texture created by the caller. Returns the cached one instead if the file has been added in the meantime. */
+        static std::shared_ptr<Texture2D> Add(const std::filesystem::path& filepath, bool is_srgb, uint32_t num_mipmaps, MipmapFilter mipmap_filter, std::shared_ptr<Texture2D> texture);
+
+        static void   SetBudget(size_t bytes);
+        static size_t GetBudget() { return s_budget; }
+
+        /* Bytes of all the cached textures, used or not. */
+        static size_t   GetSize();
+        static uint32_t GetCount();
+
+        /* Releases the unused textures over the budget. Called by Load() and Add(). */
+        static void Trim();
+
+        /* Drops all the textures, the ones still in use stay alive with their users. */
+        static void Release();
+
+    private:
+        struct Entry
+        {
+            std::shared_ptr<Texture2D> m_texture;
+            size_t                     m_size;
+            uint64_t                   m_last_request;
+        };
+
+        static std::string MakeKey(const std::filesystem::path& filepath, bool is_srgb, bool is_hdr, uint32_t num_mipmaps, MipmapFilter mipmap_filter);
+
+        static std::shared_ptr<Texture2D> FindEntry(const std::string& key);
+        static std::shared_ptr<Texture2D> AddEntry (const std::string& key, std::shared_ptr<Texture2D> texture);
+        static void                       TrimLocked();
+
+        static std::mutex                             s_mutex;
+        static std::unordered_map<std::string, Entry> s_entries;
+        static size_t                                 s_budget;
+        static uint64_t                               s_request_counter;
+    };
+}
@@ -0,0 +1,270 @@
+#include "texture_streamer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#include "gpu_memory.h"
+#include "job_system.h"
+#include "trace.h"
+#include "util.h"
+
+namespace RGL
+{
+    namespace
+    {
+        GLuint     g_staging_buffer_name = 0;
+        uint8_t*   g_staging_data        = nullptr;
+        GLsizeiptr g_staging_slot_size   = 0;
+        GLsync     g_staging_fences[TextureStreamer::FRAMES_IN_FLIGHT] = {};
+        uint32_t   g_staging_slot        = 0;
+    }
+
+    struct TextureStreamer::PendingTexture
+    {
+        GLuint   m_texture_name;
+        uint32_t m_width;
+        uint32_t m_height;
+        uint32_t m_channels;
+        uint32_t m_levels_count;
+        bool     m_is_srgb;
+
+        /* The levels are written by the decoding job until m_is_decoded is set, then owned by the render thread. */
+        std::vector<std::vector<unsigned char>> m_levels;
+        std::atomic_bool                        m_is_decoded { false };
+        std::atomic_bool                        m_is_failed  { false };
+
+        uint32_t m_level = 0; /* Being uploaded, from the smallest one down to 0. */
+        uint32_t m_row   = 0; /* Rows of m_level already uploaded. */
+        bool     m_is_done = false;
+
+        uint32_t   GetLevelWidth (uint32_t level) const { return std::max(m_width  >> level, 1u); }
+        uint32_t   GetLevelHeight(uint32_t level) const { return std::max(m_height >> level, 1u); }
+        GLsizeiptr GetRowSize    (uint32_t level) const { return GLsizeiptr(GetLevelWidth(level)) * m_channels; }
+    };
+
+    bool                                                          TextureStreamer::s_is_enabled = false;
+    GLsizeiptr                                                    TextureStreamer::s_budget     = TextureStreamer::DEFAULT_BUDGET;
+    std::vector<std::shared_ptr<TextureStreamer::PendingTexture>> TextureStreamer::s_pending;
+
+    void TextureStreamer::SetBudget(GLsizeiptr bytes)
+    {
+        bytes = std::max(bytes, MIN_BUDGET);
+
+        if (bytes != s_budget)
+        {
+            /* Recreated with the new size by the next Update(). */
+            ReleaseStagingRing();
+            s_budget = bytes;
+        }
+    }
+
+    void TextureStreamer::Add(GLuint texture_name, const std::filesystem::path& filepath, const ImageData& metadata, uint32_t levels_count, bool is_srgb)
+    {
+        auto pending = std::make_shared<PendingTexture>();
+
+        pending->m_texture_name = texture_name;
+        pending->m_width        = metadata.width;
+        pending->m_height       = metadata.height;
+        pending->m_channels     = metadata.channels;
+        pending->m_levels_count = levels_count;
+        pending->m_is_srgb      = is_srgb;
+        pending->m_level        = levels_count - 1;
+
+        s_pending.push_back(pending);
+
+        /* The job keeps the entry alive, the texture may be released before the decoding is done. */
+        JobSystem::Run([pending, filepath]
+        {
+            ImageData      decoded_metadata;
+            unsigned char* data = Util::LoadTextureData(filepath, decoded_metadata, int(pending->m_channels));
+
+            if (!data || decoded_metadata.width != pending->m_width || decoded_metadata.height != pending->m_height)
+            {
+                fprintf(stderr, "TextureStreamer: texture failed to load at path: %s\n", filepath.string().c_str());
+                Util::ReleaseTextureData(data);
+
+                pending->m_is_failed.store(true, std::memory_order_release);
+                return;
+            }
+
+            pending->m_levels.resize(pending->m_levels_count);
+            pending->m_levels[0].assign(data, data + size_t(pending->GetRowSize(0)) * pending->m_height);
+
+            Util::ReleaseTextureData(data);
+
+            for (uint32_t level = 1; level < pending->m_levels_count; ++level)
+            {
+                pending->m_levels[level].resize(size_t(pending->GetRowSize(level)) * pending->GetLevelHeight(level));
+
+                Util::DownsampleImage(pending->m_levels[level - 1].data(), pending->GetLevelWidth(level - 1), pending->GetLevelHeight(level - 1),
+                                      pending->m_channels, pending->m_is_srgb, pending->m_levels[level].data());
+            }
+
+            pending->m_is_decoded.store(true, std::memory_order_release);
+        });
+    }
+
+    void TextureStreamer::Cancel(GLuint texture_name)
+    {
+        std::erase_if(s_pending, [texture_name](const auto& pending) { return pending->m_texture_name == texture_name; });
+    }
+
+    bool TextureStreamer::IsStreaming(GLuint texture_name)
+    {
+        return std::any_of(s_pending.begin(), s_pending.end(), [texture_name](const auto& pending) { return pending->m_texture_name == texture_name; });
+    }
+
+    void TextureStreamer::Update()
+    {
+        if (s_pending.empty())
+        {
+            return;
+        }
+
+        RGL_TRACE_ZONE("Texture streaming");
+
+        if (g_staging_buffer_name == 0)
+        {
+            CreateStagingRing();
+        }
+
+        GLsync& fence = g_staging_fences[g_staging_slot];
+
+        if (fence)
+        {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(-1));
+            glDeleteSync    (fence);
+            fence = nullptr;
+        }
+
+        const GLintptr slot_begin  = g_staging_slot_size * g_staging_slot;
+        GLsizeiptr     slot_offset = 0;
+
+        glBindBuffer (GL_PIXEL_UNPACK_BUFFER, g_staging_buffer_name);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        while (true)
+        {
+            /* The smallest pending level of all the textures - every texture gets its mip tail before any of them gets sharp. */
+            PendingTexture* next      = nullptr;
+            GLsizeiptr      next_size = 0;
+
+            for (const auto& pending : s_pending)
+            {
+                if (pending->m_is_done || !pending->m_is_decoded.load(std::memory_order_acquire))
+                {
+                    continue;
+                }
+
+                const GLsizeiptr size = pending->GetRowSize(pending->m_level) * pending->GetLevelHeight(pending->m_level);
+
+                if (!next || size < next_size)
+                {
+                    next      = pending.get();
+                    next_size = size;
+                }
+            }
+
+            if (!next)
+            {
+                break;
+            }
+
+            /* The big levels are split into row ranges over several frames. */
+            const uint32_t   level    = next->m_level;
+            const GLsizeiptr row_size = next->GetRowSize(level);
+            const uint32_t   rows     = uint32_t(std::min<GLsizeiptr>(next->GetLevelHeight(level) - next->m_row, (g_staging_slot_size - slot_offset) / row_size));
+
+            if (rows == 0)
+            {
+                break;
+            }
+
+            const GLenum format = next->m_channels == 1 ? GL_RED : next->m_channels == 3 ? GL_RGB : GL_RGBA;
+
+            std::memcpy        (g_staging_data + slot_begin + slot_offset, next->m_levels[level].data() + size_t(next->m_row) * row_size, size_t(rows) * row_size);
+            glTextureSubImage2D(next->m_texture_name, level, 0, next->m_row, next->GetLevelWidth(level), rows, format, GL_UNSIGNED_BYTE,
+                                reinterpret_cast<const void*>(slot_begin + slot_offset));
+
+            slot_offset  += GLsizeiptr(rows) * row_size;
+            next->m_row  += rows;
+
+            if (next->m_row == next->GetLevelHeight(level))
+            {
+                /* The level is complete - sample it from now on. */
+                glTextureParameteri(next->m_texture_name, GL_TEXTURE_BASE_LEVEL, level);
+                std::vector<unsigned char>().swap(next->m_levels[level]);
+
+                if (level == 0)
+                {
+                    next->m_is_done = true;
+                }
+                else
+                {
+                    next->m_level = level - 1;
+                    next->m_row   = 0;
+                }
+            }
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (slot_offset > 0)
+        {
+            fence          = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            g_staging_slot = (g_staging_slot + 1) % FRAMES_IN_FLIGHT;
+        }
+
+        /* The failed textures keep the placeholder color of their smallest level. */
+        std::erase_if(s_pending, [](const auto& pending) { return pending->m_is_done || pending->m_is_failed.load(std::memory_order_acquire); });
+    }
+
+    void TextureStreamer::Release()
+    {
+        s_pending.clear();
+        ReleaseStagingRing();
+    }
+
+    void TextureStreamer::CreateStagingRing()
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        g_staging_slot_size = s_budget;
+        g_staging_slot      = 0;
+
+        glCreateBuffers     (1, &g_staging_buffer_name);
+        glNamedBufferStorage(g_staging_buffer_name, g_staging_slot_size * FRAMES_IN_FLIGHT, nullptr, flags);
+        GpuMemory::TrackBuffer(g_staging_buffer_name, "TextureStreamer");
+
+        g_staging_data = static_cast<uint8_t*>(glMapNamedBufferRange(g_staging_buffer_name, 0, g_staging_slot_size * FRAMES_IN_FLIGHT, flags));
+    }
+
+    void TextureStreamer::ReleaseStagingRing()
+    {
+        if (g_staging_buffer_name == 0)
+        {
+            return;
+        }
+
+        /* The uploads still read from the ring. */
+        for (auto& fence : g_staging_fences)
+        {
+            if (fence)
+            {
+                glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(-1));
+                glDeleteSync    (fence);
+                fence = nullptr;
+            }
+        }
+
+        glUnmapNamedBuffer(g_staging_buffer_name);
+        GpuMemory::UntrackBuffer(g_staging_buffer_name);
+        glDeleteBuffers   (1, &g_staging_buffer_name);
+
+        g_staging_buffer_name = 0;
+        g_staging_data        = nullptr;
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace RGL
+{
+    struct ImageData;
+
+    /*
+     * Progressive texture uploads. A streamed Texture2D::Load() allocates the storage right away and queues the image:
+     * a job decodes it and builds the mip chain on the CPU, Update() uploads the levels smallest first through
+     * a persistently mapped pixel unpack ring, at most GetBudget() bytes per frame. GL_TEXTURE_BASE_LEVEL follows
+     * the resident levels, so the texture shows up blurry at once and sharpens as the bigger levels arrive.
+     *
+     * Disabled by default, CoreApp enables it with --stream-textures [MB per frame] and calls Update() once per frame.
+     * Render thread only. The bindless handle freezes the base level - create it once IsStreaming() returns false.
+     */
+    class TextureStreamer
+    {
+    public:
+        static constexpr uint32_t   FRAMES_IN_FLIGHT = 3;
+        static constexpr GLsizeiptr DEFAULT_BUDGET   = 8 << 20;
+        static constexpr GLsizeiptr MIN_BUDGET       = 1 << 20; /* Every row of the biggest textures has to fit. */
+
+        static void SetEnabled(bool enable) { s_is_enabled = enable; }
+        static bool IsEnabled()             { return s_is_enabled; }
+
+        /* Bytes uploaded per frame, the staging ring holds FRAMES_IN_FLIGHT times that. */
+        static void       SetBudget(GLsizeiptr bytes);
+        static GLsizeiptr GetBudget() { return s_budget; }
+
+        /* The texture's storage has to have levels_count levels of an 8-bit format with metadata.channels channels. */
+        static void Add(GLuint texture_name, const std::filesystem::path& filepath, const ImageData& metadata, uint32_t levels_count, bool is_srgb);
+
+        /* Drops the levels that aren't uploaded yet. Called when the texture is released. */
+        static void Cancel(GLuint texture_name);
+
+        static bool     IsStreaming(GLuint texture_name);
+        static uint32_t GetPendingCount() { return uint32_t(s_pending.size()); }
+
+        static void Update();
+
+        /* Releases the staging ring, the pending textures are dropped. */
+        static void Release();
+
+    private:
+        struct PendingTexture;
+
+        static void CreateStagingRing();
+        static void ReleaseStagingRing();
+
+        static bool                                         s_is_enabled;
+        static GLsizeiptr                                   s_budget;
+        static std::vector<std::shared_ptr<PendingTexture>> s_pending;
+    };
+}
@@ -1,24 +1,37 @@
 #pragma once
 #include <chrono>
+#include <cstdint>
+#include <type_traits>
 
 namespace RGL
 {
     class Timer final
     {
     public:
+        /* The highest resolution clock that is monotonic, so the timings aren't affected by the system clock changes. */
+        using Clock = std::conditional_t<std::chrono::high_resolution_clock::is_steady, std::chrono::high_resolution_clock, std::chrono::steady_clock>;
+
         /**
          * @brief Returns current time in seconds.
          * @return Time in seconds.
          */
         static double getTime()
         {
-            auto now = std::chrono::system_clock::now();
+            return getTimeNanoseconds() / double(SECOND);
+        }
 
-            return std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count() / double(SECOND);
+        /**
+         * @brief Returns current time in nanoseconds, since the first call of any Timer method.
+         * @return Time in nanoseconds.
+         */
+        static uint64_t getTimeNanoseconds()
+        {
+            static const Clock::time_point start = Clock::now();
+
+            return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
         }
 
     private:
         static const long long SECOND = 1000000000L;
     };
 }
-
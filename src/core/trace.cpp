@@ -0,0 +1,106 @@
+#include "trace.h"
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace RGL
+{
+    namespace
+    {
+        struct ThreadBuffer
+        {
+            Trace::Event          m_events[Trace::EVENTS_PER_THREAD];
+            std::atomic<uint64_t> m_write_index { 0 };
+            uint32_t              m_thread_index;
+        };
+
+        /* The buffers outlive their threads, so the zones of the finished worker threads are exported too. */
+        std::mutex                                 g_buffers_mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;
+
+        thread_local ThreadBuffer* t_buffer = nullptr;
+
+        ThreadBuffer* RegisterThread()
+        {
+            std::lock_guard<std::mutex> lock(g_buffers_mutex);
+
+            g_buffers.push_back(std::make_unique<ThreadBuffer>());
+            g_buffers.back()->m_thread_index = uint32_t(g_buffers.size() - 1);
+
+            return g_buffers.back().get();
+        }
+
+        /* The names are string literals, only the quotes and the backslashes have to be escaped. */
+        void WriteEscaped(FILE* file, const char* name)
+        {
+            for (const char* c = name; *c; ++c)
+            {
+                if (*c == '"' || *c == '\\')
+                {
+                    fputc('\\', file);
+                }
+
+                fputc(*c, file);
+            }
+        }
+    }
+
+    std::atomic_bool Trace::s_is_enabled = false;
+
+    void Trace::Record(const char* name, uint64_t begin_ns, uint64_t end_ns)
+    {
+        if (!t_buffer)
+        {
+            t_buffer = RegisterThread();
+        }
+
+        /* Single writer per buffer - the index is published after the event is written. */
+        const uint64_t index = t_buffer->m_write_index.load(std::memory_order_relaxed);
+
+        t_buffer->m_events[index % EVENTS_PER_THREAD] = { name, begin_ns, end_ns };
+        t_buffer->m_write_index.store(index + 1, std::memory_order_release);
+    }
+
+    bool Trace::Export(const std::filesystem::path& filepath)
+    {
+        FILE* file = fopen(filepath.string().c_str(), "w");
+
+        if (!file)
+        {
+            fprintf(stderr, "Could not open trace file %s\n", filepath.string().c_str());
+            return false;
+        }
+
+        fprintf(file, "{\"traceEvents\":[\n");
+
+        bool is_first = true;
+
+        std::lock_guard<std::mutex> lock(g_buffers_mutex);
+
+        for (const auto& buffer : g_buffers)
+        {
+            const uint64_t write_index = buffer->m_write_index.load(std::memory_order_acquire);
+            const uint64_t first_index = write_index > EVENTS_PER_THREAD ? write_index - EVENTS_PER_THREAD : 0;
+
+            for (uint64_t i = first_index; i < write_index; ++i)
+            {
+                const Event& event = buffer->m_events[i % EVENTS_PER_THREAD];
+
+                /* Complete events, the timestamps are in microseconds. */
+                fprintf(file, "%s{\"name\":\"", is_first ? "" : ",\n");
+                WriteEscaped(file, event.m_name);
+                fprintf(file, "\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                        buffer->m_thread_index, event.m_begin_ns / 1000.0, (event.m_end_ns - event.m_begin_ns) / 1000.0);
+
+                is_first = false;
+            }
+        }
+
+        fprintf(file, "\n]}\n");
+        fclose(file);
+
+        return true;
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+
+#include "timer.h"
+
+#define RGL_TRACE_CONCAT_IMPL(a, b) a##b
+#define RGL_TRACE_CONCAT(a, b)      RGL_TRACE_CONCAT_IMPL(a, b)
+
+/* Records the enclosing block as a zone. The name has to be a string literal (or outlive the export). */
+#define RGL_TRACE_ZONE(name) RGL::TraceZone RGL_TRACE_CONCAT(rgl_trace_zone_, __LINE__)(name)
+
+namespace RGL
+{
+    /*
+     * Lightweight CPU zones. Every thread records into its own ring buffer - the writes take no locks,
+     * only the first zone of a thread registers its buffer. The rings keep the last EVENTS_PER_THREAD zones,
+     * Export() writes them as a Chrome trace (chrome://tracing, Perfetto).
+     *
+     * Disabled by default, a disabled zone costs one relaxed atomic load.
+     */
+    class Trace
+    {
+    public:
+        static constexpr uint32_t EVENTS_PER_THREAD = 1 << 16;
+
+        struct Event
+        {
+            const char* m_name;
+            uint64_t    m_begin_ns;
+            uint64_t    m_end_ns;
+        };
+
+        static void SetEnabled(bool enable) { s_is_enabled.store(enable, std::memory_order_relaxed); }
+        static bool IsEnabled()             { return s_is_enabled.load(std::memory_order_relaxed); }
+
+        static void Record(const char* name, uint64_t begin_ns, uint64_t end_ns);
+
+        /* The zones recorded while exporting may be missing or torn - pause the tracing first for a clean capture. */
+        static bool Export(const std::filesystem::path& filepath);
+
+    private:
+        static std::atomic_bool s_is_enabled;
+    };
+
+    class TraceZone final
+    {
+    public:
+        explicit TraceZone(const char* name)
+            : m_name      (name),
+              m_is_enabled(Trace::IsEnabled()),
+              m_begin_ns  (m_is_enabled ? Timer::getTimeNanoseconds() : 0)
+        {
+        }
+
+        ~TraceZone()
+        {
+            if (m_is_enabled)
+            {
+                Trace::Record(m_name, m_begin_ns, Timer::getTimeNanoseconds());
+            }
+        }
+
+        TraceZone           (const TraceZone&) = delete;
+        TraceZone& operator=(const TraceZone&) = delete;
+
+    private:
+        const char* m_name;
+        bool        m_is_enabled; /* At the zone's beginning, so a zone is never half recorded. */
+        uint64_t    m_begin_ns;
+    };
+}
@@ -0,0 +1,123 @@
+#include "transform_store.h"
+
+#include <algorithm>
+
+#include <glm/matrix.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RGL_TRANSFORMS_SSE 1
+#include <emmintrin.h>
+#endif
+
+#include "shader.h"
+
+namespace RGL
+{
+    TransformStore::TransformStore()
+        : m_view_projection(0.0f),
+          m_is_any_dirty   (false)
+    {
+    }
+
+    uint32_t TransformStore::Add(const glm::mat4& model_matrix)
+    {
+        m_model_matrices .push_back(model_matrix);
+        m_normal_matrices.emplace_back(1.0f);
+        m_mvp_matrices   .emplace_back(1.0f);
+        m_is_dirty       .push_back(1);
+        m_is_any_dirty = true;
+
+        return GetCount() - 1;
+    }
+
+    void TransformStore::Set(uint32_t index, const glm::mat4& model_matrix)
+    {
+        m_model_matrices[index] = model_matrix;
+        m_is_dirty[index]       = 1;
+        m_is_any_dirty          = true;
+    }
+
+    void TransformStore::Reserve(uint32_t count)
+    {
+        m_model_matrices .reserve(count);
+        m_normal_matrices.reserve(count);
+        m_mvp_matrices   .reserve(count);
+        m_is_dirty       .reserve(count);
+    }
+
+    void TransformStore::Clear()
+    {
+        m_model_matrices .clear();
+        m_normal_matrices.clear();
+        m_mvp_matrices   .clear();
+        m_is_dirty       .clear();
+        m_is_any_dirty = false;
+    }
+
+    void TransformStore::Update(const glm::mat4& view_projection)
+    {
+        const bool is_view_projection_changed = view_projection != m_view_projection;
+
+        if (!is_view_projection_changed && !m_is_any_dirty)
+        {
+            return;
+        }
+
+        m_view_projection = view_projection;
+
+        const uint32_t count = GetCount();
+
+        if (m_is_any_dirty)
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                if (m_is_dirty[i])
+                {
+                    m_normal_matrices[i] = glm::mat3(glm::transpose(glm::inverse(m_model_matrices[i])));
+                }
+            }
+        }
+
+#ifdef RGL_TRANSFORMS_SSE
+        /* The view projection columns stay in the registers, every MVP column is their sum weighted by a model column. */
+        const __m128 vp0 = _mm_loadu_ps(&view_projection[0][0]);
+        const __m128 vp1 = _mm_loadu_ps(&view_projection[1][0]);
+        const __m128 vp2 = _mm_loadu_ps(&view_projection[2][0]);
+        const __m128 vp3 = _mm_loadu_ps(&view_projection[3][0]);
+#endif
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (!is_view_projection_changed && !m_is_dirty[i])
+            {
+                continue;
+            }
+
+#ifdef RGL_TRANSFORMS_SSE
+            const glm::mat4& model = m_model_matrices[i];
+
+            for (int column = 0; column < 4; ++column)
+            {
+                __m128 result = _mm_mul_ps(vp0, _mm_set1_ps(model[column][0]));
+                result = _mm_add_ps(result, _mm_mul_ps(vp1, _mm_set1_ps(model[column][1])));
+                result = _mm_add_ps(result, _mm_mul_ps(vp2, _mm_set1_ps(model[column][2])));
+                result = _mm_add_ps(result, _mm_mul_ps(vp3, _mm_set1_ps(model[column][3])));
+
+                _mm_storeu_ps(&m_mvp_matrices[i][column][0], result);
+            }
+#else
+            m_mvp_matrices[i] = view_projection * m_model_matrices[i];
+#endif
+        }
+
+        std::fill(m_is_dirty.begin(), m_is_dirty.end(), uint8_t(0));
+        m_is_any_dirty = false;
+    }
+
+    void TransformStore::SetUniforms(Shader& shader, uint32_t index) const
+    {
+        shader.setUniform("u_model",         m_model_matrices [index]);
+        shader.setUniform("u_normal_matrix", m_normal_matrices[index]);
+        shader.setUniform("u_mvp",           m_mvp_matrices   [index]);
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+
+namespace RGL
+{
+    class Shader;
+
+    /*
+     * Transforms of the scene objects in separate arrays - model, normal and model-view-projection matrices - instead
+     * of a matrix next to every object's model. Set() only marks the object dirty, Update() recomputes the normal
+     * matrices of the dirty objects and the MVPs in one batched (SSE) pass: all of them when the view projection changed,
+     * only the dirty ones otherwise. The per draw code then just reads the results.
+     *
+     *     uint32_t sphere = transforms.Add(glm::translate(glm::mat4(1.0f), position));
+     *
+     *     transforms.Update(camera.viewProjection()); // Once per frame, before the draws.
+     *     transforms.SetUniforms(shader, sphere);     // u_model, u_normal_matrix and u_mvp.
+     */
+    class TransformStore final
+    {
+    public:
+        TransformStore();
+
+        /* Returns the index of the new object. */
+        uint32_t Add(const glm::mat4& model_matrix);
+
+        void Set    (uint32_t index, const glm::mat4& model_matrix);
+        void Reserve(uint32_t count);
+        void Clear();
+
+        void Update(const glm::mat4& view_projection);
+
+        const glm::mat4& GetModel (uint32_t index) const { return m_model_matrices[index]; }
+        const glm::mat3& GetNormal(uint32_t index) const { return m_normal_matrices[index]; } /* Valid after Update(). */
+        const glm::mat4& GetMvp   (uint32_t index) const { return m_mvp_matrices[index]; }    /* Valid after Update(). */
+        uint32_t         GetCount()                const { return uint32_t(m_model_matrices.size()); }
+
+        /* Sets the u_model, u_normal_matrix and u_mvp uniforms of the object. */
+        void SetUniforms(Shader& shader, uint32_t index) const;
+
+    private:
+        std::vector<glm::mat4> m_model_matrices;
+        std::vector<glm::mat3> m_normal_matrices;
+        std::vector<glm::mat4> m_mvp_matrices;
+        std::vector<uint8_t>   m_is_dirty;
+
+        glm::mat4 m_view_projection;
+        bool      m_is_any_dirty;
+    };
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <string_view>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "gpu_memory.h"
+#include "shader.h"
+
+/* A member of T for UniformBlock::AttachTo(), name_prefix is the path of the member in the block, e.g. "collision.". */
+#define RGL_UNIFORM_BLOCK_MEMBER(type, name_prefix, member) RGL::UniformBlockMember{ name_prefix #member, offsetof(type, member) }
+
+namespace RGL
+{
+    /* The GLSL name of a member of a uniform block and the offset of its C++ counterpart. */
+    struct UniformBlockMember
+    {
+        std::string_view m_name;
+        size_t           m_offset;
+    };
+
+    /*
+     * Typed uniform buffer backed by a persistently mapped ring buffer.
+     * Every Update() writes the data to the next slot of the ring and binds it with glBindBufferRange,
+     * so the data uploaded once per frame is shared by all the shaders that use the binding index.
+     * T is copied as it is, it has to follow the std140 layout rules - use alignas(16) for vec3/vec4/mat4 members.
+     * AttachTo() checks the layout against the reflected block: the size, and the offset of every member listed.
+     */
+    template<typename T>
+    class UniformBlock final
+    {
+    public:
+        UniformBlock()
+            : m_buffer_name  (0),
+              m_binding_index(0),
+              m_slot_size    (0),
+              m_current_slot (0),
+              m_mapped_data  (nullptr)
+        {
+        }
+
+        ~UniformBlock() { Release(); }
+
+        UniformBlock           (const UniformBlock&) = delete;
+        UniformBlock& operator=(const UniformBlock&) = delete;
+
+        /* Allocates slots_count copies of T. Use at least the number of frames in flight. */
+        void Create(GLuint binding_index, uint32_t slots_count = 3)
+        {
+            Release();
+
+            GLint offset_alignment = 0;
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offset_alignment);
+
+            m_binding_index = binding_index;
+            m_slot_size     = (GLsizeiptr(sizeof(T)) + offset_alignment - 1) / offset_alignment * offset_alignment;
+            m_current_slot  = 0;
+            m_fences.assign(slots_count, nullptr);
+
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+            glCreateBuffers     (1, &m_buffer_name);
+            glNamedBufferStorage(m_buffer_name, m_slot_size * slots_count, nullptr, flags);
+            GpuMemory::TrackBuffer(m_buffer_name, "UniformBlock");
+
+            m_mapped_data = static_cast<uint8_t*>(glMapNamedBufferRange(m_buffer_name, 0, m_slot_size * slots_count, flags));
+        }
+
+        /* Copies the data to the next free slot and binds it to the binding index. */
+        void Update(const T& data)
+        {
+            if (!m_mapped_data)
+            {
+                return;
+            }
+
+            /* Slot used by the previous Update() is free once the GPU passes this point. */
+            m_fences[m_current_slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            m_current_slot           = (m_current_slot + 1) % m_fences.size();
+
+            if (m_fences[m_current_slot])
+            {
+                glClientWaitSync(m_fences[m_current_slot], GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(-1));
+                glDeleteSync    (m_fences[m_current_slot]);
+                m_fences[m_current_slot] = nullptr;
+            }
+
+            std::memcpy(m_mapped_data + m_slot_size * m_current_slot, &data, sizeof(T));
+            Bind();
+        }
+
+        void Bind() const
+        {
+            glBindBufferRange(GL_UNIFORM_BUFFER, m_binding_index, m_buffer_name, m_slot_size * m_current_slot, sizeof(T));
+        }
+
+        /*
+         * Checks the C++ struct against the reflected block and assigns the binding index to it. A struct of the right size
+         * can still have a wrong layout, so the members are compared with their GL_OFFSETs as well:
+         *
+         *     ubo.AttachTo(shader, "CollisionParamsUBO", { RGL_UNIFORM_BLOCK_MEMBER(CollisionParams, "collision.", sdf_min), ... });
+         */
+        bool AttachTo(Shader& shader, std::string_view block_name, std::initializer_list<UniformBlockMember> members = {}) const
+        {
+            auto block = shader.getUniformBlock(block_name);
+
+            if (!block)
+            {
+                fprintf(stderr, "UniformBlock: block %s is not active in the shader.\n", std::string(block_name).c_str());
+                return false;
+            }
+
+            if (block->m_data_size != GLint(sizeof(T)))
+            {
+                fprintf(stderr, "UniformBlock: size mismatch for block %s. Shader: %d bytes, C++: %d bytes.\n",
+                        std::string(block_name).c_str(), block->m_data_size, int(sizeof(T)));
+                return false;
+            }
+
+            bool is_layout_valid = true;
+
+            for (const auto& member : members)
+            {
+                const GLint offset = shader.getUniformBlockMemberOffset(block_name, member.m_name);
+
+                if (offset == -1)
+                {
+                    fprintf(stderr, "UniformBlock: member %s is not active in block %s.\n", std::string(member.m_name).c_str(), std::string(block_name).c_str());
+                    is_layout_valid = false;
+                }
+                else if (size_t(offset) != member.m_offset)
+                {
+                    fprintf(stderr, "UniformBlock: offset mismatch for %s in block %s. Shader: %d, C++: %d.\n",
+                            std::string(member.m_name).c_str(), std::string(block_name).c_str(), offset, int(member.m_offset));
+                    is_layout_valid = false;
+                }
+            }
+
+            if (!is_layout_valid)
+            {
+                return false;
+            }
+
+            return shader.setUniformBlockBinding(block_name, m_binding_index);
+        }
+
+        GLuint GetBindingIndex() const { return m_binding_index; }
+
+    private:
+        void Release()
+        {
+            for (auto& fence : m_fences)
+            {
+                glDeleteSync(fence);
+            }
+            m_fences.clear();
+
+            if (m_mapped_data)
+            {
+                glUnmapNamedBuffer(m_buffer_name);
+                m_mapped_data = nullptr;
+            }
+
+            GpuMemory::UntrackBuffer(m_buffer_name);
+            glDeleteBuffers(1, &m_buffer_name);
+            m_buffer_name = 0;
+        }
+
+        std::vector<GLsync> m_fences;
+
+        GLuint     m_buffer_name;
+        GLuint     m_binding_index;
+        GLsizeiptr m_slot_size;
+        uint32_t   m_current_slot;
+        uint8_t*   m_mapped_data;
+    };
+}
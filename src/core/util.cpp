@@ -1,15 +1,217 @@
 ﻿#include "util.h"
 
-#include <fstream>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
 #include <GLFW/glfw3.h>
 #include <glm/common.hpp>
 #include <glm/exponential.hpp>
 
 #include "filesystem.h"
+#include "job_system.h"
+#include "mapped_file.h"
 
 namespace RGL
 {
+    namespace
+    {
+        constexpr uint32_t LINEAR_TO_SRGB_TABLE_SIZE = 4096;
+
+        struct SrgbTables
+        {
+            SrgbTables()
+            {
+                for (uint32_t i = 0; i < m_to_linear.size(); ++i)
+                {
+                    const float c = i / 255.0f;
+                    m_to_linear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+                }
+
+                for (uint32_t i = 0; i < m_to_srgb.size(); ++i)
+                {
+                    const float c = i / float(LINEAR_TO_SRGB_TABLE_SIZE - 1);
+                    const float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+                    m_to_srgb[i] = uint8_t(std::clamp(s * 255.0f + 0.5f, 0.0f, 255.0f));
+                }
+            }
+
+            std::array<float,   256>                       m_to_linear;
+            std::array<uint8_t, LINEAR_TO_SRGB_TABLE_SIZE> m_to_srgb;
+        };
+
+        const SrgbTables& GetSrgbTables()
+        {
+            static const SrgbTables tables;
+            return tables;
+        }
+
+        /* Rows per job of the parallel HDR decoding and downsampling. */
+        constexpr uint32_t HDR_ROWS_PER_JOB = 16;
+
+        bool ReadHeaderLine(const uint8_t* data, size_t size, size_t& offset, std::string& line)
+        {
+            const size_t begin = offset;
+
+            while (offset < size && data[offset] != '\n')
+            {
+                ++offset;
+            }
+
+            if (offset >= size)
+            {
+                return false;
+            }
+
+            line.assign(reinterpret_cast<const char*>(data) + begin, offset - begin);
+            ++offset;
+
+            return true;
+        }
+
+        /* Returns the offset of the first scanline, 0 if the file isn't a top-down RGBE Radiance one. */
+        size_t ParseRadianceHeader(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height)
+        {
+            size_t      offset = 0;
+            std::string line;
+
+            if (!ReadHeaderLine(data, size, offset, line) || line.rfind("#?", 0) != 0)
+            {
+                return 0;
+            }
+
+            for (;;)
+            {
+                if (!ReadHeaderLine(data, size, offset, line))
+                {
+                    return 0;
+                }
+
+                if (line.empty())
+                {
+                    break;
+                }
+
+                if (line.rfind("FORMAT=", 0) == 0 && line != "FORMAT=32-bit_rle_rgbe")
+                {
+                    return 0;
+                }
+            }
+
+            int rows = 0, columns = 0;
+
+            if (!ReadHeaderLine(data, size, offset, line) || std::sscanf(line.c_str(), "-Y %d +X %d", &rows, &columns) != 2 || rows <= 0 || columns <= 0)
+            {
+                return 0;
+            }
+
+            width  = uint32_t(columns);
+            height = uint32_t(rows);
+
+            return offset;
+        }
+
+        /*
+         * Offsets of the scanlines, found by skipping over the runs. Only the new RLE scanlines can be located without
+         * decoding them, false for the flat and the old RLE ones.
+         */
+        bool FindRadianceScanlines(const uint8_t* data, size_t size, size_t offset, uint32_t width, uint32_t height, std::vector<size_t>& scanlines)
+        {
+            if (width < 8 || width > 0x7FFF)
+            {
+                return false;
+            }
+
+            scanlines.resize(height);
+
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                if (offset + 4 > size || data[offset] != 2 || data[offset + 1] != 2 || ((uint32_t(data[offset + 2]) << 8) | data[offset + 3]) != width)
+                {
+                    return false;
+                }
+
+                scanlines[y] = offset;
+                offset += 4;
+
+                for (uint32_t channel = 0; channel < 4; ++channel)
+                {
+                    for (uint32_t x = 0; x < width; )
+                    {
+                        if (offset >= size)
+                        {
+                            return false;
+                        }
+
+                        uint32_t count = data[offset++];
+
+                        if (count > 128)
+                        {
+                            count  -= 128;
+                            offset += 1;
+                        }
+                        else
+                        {
+                            offset += count;
+                        }
+
+                        x += count;
+
+                        if (count == 0 || x > width)
+                        {
+                            return false;
+                        }
+                    }
+                }
+
+                if (offset > size)
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        /* The scanline's channels are stored one after another, each as runs and literals. */
+        void DecodeRadianceScanline(const uint8_t* data, uint32_t width, uint8_t* rgbe)
+        {
+            data += 4;
+
+            for (uint32_t channel = 0; channel < 4; ++channel)
+            {
+                for (uint32_t x = 0; x < width; )
+                {
+                    uint32_t count = *data++;
+
+                    if (count > 128)
+                    {
+                        count -= 128;
+
+                        const uint8_t value = *data++;
+
+                        for (uint32_t i = 0; i < count; ++i)
+                        {
+                            rgbe[(x + i) * 4 + channel] = value;
+                        }
+                    }
+                    else
+                    {
+                        for (uint32_t i = 0; i < count; ++i)
+                        {
+                            rgbe[(x + i) * 4 + channel] = *data++;
+                        }
+                    }
+
+                    x += count;
+                }
+            }
+        }
+    }
+
     std::string Util::LoadFile(const std::filesystem::path & filename)
     {
         if (filename.empty())
@@ -17,93 +219,137 @@ namespace RGL
             return "";
         }
 
-        std::string filetext;
-        std::string line;
-
-        std::filesystem::path filepath = FileSystem::getRootPath() / filename;
-        std::ifstream inFile(filepath);
+        MappedFile file(FileSystem::getRootPath() / filename);
 
-        if (!inFile)
+        if (!file.IsOpen())
         {
-            fprintf(stderr, "Could not open file %s\n", filepath.string().c_str());
-            inFile.close();
-
             return "";
         }
 
-        while (getline(inFile, line))
+        auto text = file.GetText();
+
+        std::string filetext;
+        filetext.reserve(text.size() + 1);
+
+        /* Same as reading in the text mode - the line endings become '\n' and the text ends with one. */
+        for (char c : text)
         {
-            filetext.append(line + "\n");
+            if (c != '\r')
+            {
+                filetext.push_back(c);
+            }
         }
 
-        inFile.close();
+        if (!filetext.empty() && filetext.back() != '\n')
+        {
+            filetext.push_back('\n');
+        }
 
         return filetext;
     }
 
     std::vector<unsigned char> Util::LoadFileBinary(const std::filesystem::path& filename)
     {
-        std::filesystem::path filepath = FileSystem::getRootPath() / filename;
-        std::ifstream file(filepath, std::ios::binary);
+        MappedFile file(FileSystem::getRootPath() / filename);
 
-        if (!file)
+        if (!file.IsOpen())
         {
-            fprintf(stderr, "Could not open file %s\n", filepath.string().c_str());
-            file.close();
-
             return {};
         }
 
-        // Determine the file size.
-        file.seekg(0, std::ios_base::end);
-        size_t file_size = file.tellg();
-        file.seekg(0, std::ios_base::beg);
+        return std::vector<unsigned char>(file.GetData(), file.GetData() + file.GetSize());
+    }
 
-        // Allocate storage.
-        std::vector<unsigned char> data(file_size / sizeof(unsigned char));
+    std::string Util::LoadShaderIncludes(const std::string& shader_code, const std::filesystem::path& dir, std::vector<std::filesystem::path>* dependencies)
+    {
+        std::string new_shader_code;
+        new_shader_code.reserve(shader_code.size());
 
-        // Read the file contents into the allocated storage.
-        file.read((char*)&data[0], file_size);
+        ExpandShaderIncludes(shader_code, dir, dependencies, 0, new_shader_code);
 
-        return data;
+        return new_shader_code;
     }
 
-    std::string Util::LoadShaderIncludes(const std::string& shader_code, const std::filesystem::path& dir)
+    bool Util::ExpandShaderIncludes(const std::string& shader_code, const std::filesystem::path& dir, std::vector<std::filesystem::path>* dependencies, uint32_t depth, std::string& out)
     {
-        std::istringstream ss(shader_code);
+        static const std::string include_phrase = "#include";
 
-        std::string line, new_shader_code = "";
-        std::string include_phrase        = "#include";
+        if (depth > MAX_SHADER_INCLUDE_DEPTH)
+        {
+            fprintf(stderr, "Shader includes nested deeper than %u levels, is there a cycle?\n", MAX_SHADER_INCLUDE_DEPTH);
+            return false;
+        }
 
-        bool included = false;
+        std::istringstream ss(shader_code);
+        std::string        line;
 
         while (std::getline(ss, line))
         {
-            if (line.substr(0, include_phrase.size()) == include_phrase)
+            if (line.substr(0, include_phrase.size()) != include_phrase)
             {
-                std::string include_file_name = line.substr(include_phrase.size() + 2, line.size() - include_phrase .size() - 3);
-                
-                line     = LoadFile(dir / include_file_name);
-                included = true;
+                out.append(line + "\n");
+                continue;
             }
 
-            new_shader_code.append(line + "\n");
+            std::string           include_file_name = line.substr(include_phrase.size() + 2, line.size() - include_phrase.size() - 3);
+            std::filesystem::path include_filepath  = (FileSystem::getRootPath() / dir / include_file_name).lexically_normal();
+
+            if (dependencies && std::find(dependencies->begin(), dependencies->end(), include_filepath) == dependencies->end())
+            {
+                dependencies->push_back(include_filepath);
+            }
+
+            /* The nested includes are relative to the including shader's directory too. */
+            if (!ExpandShaderIncludes(LoadShaderIncludeFile(include_filepath), dir, dependencies, depth + 1, out))
+            {
+                return false;
+            }
         }
 
-        // Parse #include in the included files
-        if (included)
+        return true;
+    }
+
+    std::string Util::LoadShaderIncludeFile(const std::filesystem::path& filepath)
+    {
+        struct CachedFile
         {
-            new_shader_code = LoadShaderIncludes(new_shader_code, dir);
+            std::filesystem::file_time_type m_write_time;
+            std::string                     m_code;
+        };
+
+        /* Shared by all the shaders of the process. A changed file is reloaded on its next use. */
+        static std::mutex                                  cache_mutex;
+        static std::unordered_map<std::string, CachedFile> cache;
+
+        uintmax_t                       size;
+        std::filesystem::file_time_type write_time;
+
+        const bool has_info = FileSystem::getFileInfo(filepath, size, write_time);
+
+        std::lock_guard<std::mutex> lock(cache_mutex);
+
+        auto it = cache.find(filepath.string());
+
+        if (it == cache.end() || !has_info || it->second.m_write_time != write_time)
+        {
+            it = cache.insert_or_assign(filepath.string(), CachedFile{ write_time, LoadFile(filepath) }).first;
         }
 
-        return new_shader_code;
+        return it->second.m_code;
     }
 
-
     unsigned char* Util::LoadTextureData(const std::filesystem::path& filepath, ImageData & image_data, int desired_number_of_channels)
     {
+        /* Decoded straight from the mapped file, without reading it into a buffer first. */
+        MappedFile file(filepath);
+
+        if (!file.IsOpen())
+        {
+            return nullptr;
+        }
+
         int width, height, channels_in_file;
-        unsigned char* data = stbi_load(filepath.generic_string().c_str(), &width, &height, &channels_in_file, desired_number_of_channels);
+        unsigned char* data = stbi_load_from_memory(file.GetData(), int(file.GetSize()), &width, &height, &channels_in_file, desired_number_of_channels);
 
         if (data)
         {
@@ -115,6 +361,30 @@ namespace RGL
         return data;
     }
 
+    bool Util::LoadTextureInfo(const std::filesystem::path& filepath, ImageData& image_data)
+    {
+        MappedFile file(filepath);
+
+        if (!file.IsOpen())
+        {
+            return false;
+        }
+
+        /* Reads the header only. */
+        int width, height, channels_in_file;
+
+        if (!stbi_info_from_memory(file.GetData(), int(file.GetSize()), &width, &height, &channels_in_file))
+        {
+            return false;
+        }
+
+        image_data.width    = width;
+        image_data.height   = height;
+        image_data.channels = channels_in_file;
+
+        return true;
+    }
+
     unsigned char* Util::LoadTextureData(unsigned char* memory_data, uint32_t data_size, ImageData& image_data, int desired_number_of_channels)
     {
         int width, height, channels_in_file;
@@ -132,9 +402,16 @@ namespace RGL
 
     float* Util::LoadTextureDataHdr(const std::filesystem::path& filepath, ImageData& image_data, int desired_number_of_channels)
     {
+        MappedFile file(filepath);
+
+        if (!file.IsOpen())
+        {
+            return nullptr;
+        }
+
         stbi_set_flip_vertically_on_load(true);
             int width, height, channels_in_file;
-            float* data = stbi_loadf(filepath.generic_string().c_str(), &width, &height, &channels_in_file, desired_number_of_channels);
+            float* data = stbi_loadf_from_memory(file.GetData(), int(file.GetSize()), &width, &height, &channels_in_file, desired_number_of_channels);
         stbi_set_flip_vertically_on_load(false);
         if (data)
         {
@@ -146,6 +423,184 @@ namespace RGL
         return data;
     }
 
+    void Util::DownsampleImage(const unsigned char* src, uint32_t src_width, uint32_t src_height, uint32_t channels, bool is_srgb, unsigned char* dst)
+    {
+        const SrgbTables& tables = GetSrgbTables();
+
+        const uint32_t dst_width  = std::max(src_width  / 2, 1u);
+        const uint32_t dst_height = std::max(src_height / 2, 1u);
+
+        for (uint32_t y = 0; y < dst_height; ++y)
+        {
+            const unsigned char* row0 = src + size_t(std::min(2 * y,     src_height - 1)) * src_width * channels;
+            const unsigned char* row1 = src + size_t(std::min(2 * y + 1, src_height - 1)) * src_width * channels;
+
+            for (uint32_t x = 0; x < dst_width; ++x)
+            {
+                const uint32_t x0 = std::min(2 * x,     src_width - 1) * channels;
+                const uint32_t x1 = std::min(2 * x + 1, src_width - 1) * channels;
+
+                for (uint32_t c = 0; c < channels; ++c)
+                {
+                    /* Alpha stays linear. */
+                    if (is_srgb && c < 3)
+                    {
+                        const float linear = 0.25f * (tables.m_to_linear[row0[x0 + c]] + tables.m_to_linear[row0[x1 + c]] +
+                                                      tables.m_to_linear[row1[x0 + c]] + tables.m_to_linear[row1[x1 + c]]);
+
+                        *dst++ = tables.m_to_srgb[uint32_t(linear * (LINEAR_TO_SRGB_TABLE_SIZE - 1) + 0.5f)];
+                    }
+                    else
+                    {
+                        *dst++ = uint8_t((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<uint32_t> Util::LoadTextureDataHdrRgb9e5(const std::filesystem::path& filepath, ImageData& image_data)
+    {
+        std::vector<uint32_t> texels;
+
+        {
+            MappedFile file(filepath);
+
+            if (!file.IsOpen())
+            {
+                return texels;
+            }
+
+            const uint8_t* data = file.GetData();
+            const size_t   size = file.GetSize();
+
+            uint32_t            width = 0, height = 0;
+            std::vector<size_t> scanlines;
+
+            const size_t offset = ParseRadianceHeader(data, size, width, height);
+
+            if (offset > 0 && FindRadianceScanlines(data, size, offset, width, height, scanlines))
+            {
+                texels.resize(size_t(width) * height);
+
+                JobSystem::ParallelFor(0, height, HDR_ROWS_PER_JOB, [&](uint32_t begin, uint32_t end)
+                {
+                    std::vector<uint8_t> rgbe(size_t(width) * 4);
+
+                    for (uint32_t y = begin; y < end; ++y)
+                    {
+                        DecodeRadianceScanline(data + scanlines[y], width, rgbe.data());
+
+                        /* Bottom-up, as stb_image loads it flipped. */
+                        uint32_t* row = texels.data() + size_t(height - 1 - y) * width;
+
+                        for (uint32_t x = 0; x < width; ++x)
+                        {
+                            const uint8_t* texel = &rgbe[x * 4];
+                            const float    scale = texel[3] ? std::ldexp(1.0f, int(texel[3]) - 136) : 0.0f;
+
+                            row[x] = PackRgb9e5(glm::vec3(texel[0], texel[1], texel[2]) * scale);
+                        }
+                    }
+                });
+
+                image_data.width    = width;
+                image_data.height   = height;
+                image_data.channels = 3;
+
+                return texels;
+            }
+        }
+
+        /* The flat and the old RLE scanlines, rare enough to decode them serially. */
+        float* data = LoadTextureDataHdr(filepath, image_data, 3);
+
+        if (!data)
+        {
+            return texels;
+        }
+
+        texels.resize(size_t(image_data.width) * image_data.height);
+
+        JobSystem::ParallelFor(0, image_data.height, HDR_ROWS_PER_JOB, [&](uint32_t begin, uint32_t end)
+        {
+            for (size_t i = size_t(begin) * image_data.width; i < size_t(end) * image_data.width; ++i)
+            {
+                texels[i] = PackRgb9e5(glm::vec3(data[i * 3], data[i * 3 + 1], data[i * 3 + 2]));
+            }
+        });
+
+        ReleaseTextureData(data);
+
+        return texels;
+    }
+
+    uint32_t Util::PackRgb9e5(const glm::vec3& color)
+    {
+        /* EXT_texture_shared_exponent: 9 bit mantissas, a 5 bit exponent with the bias of 15. */
+        constexpr int   MANTISSA_BITS = 9;
+        constexpr int   EXPONENT_BIAS = 15;
+        constexpr float MAX_VALUE     = 511.0f / 512.0f * 65536.0f;
+
+        const glm::vec3 clamped = glm::clamp(color, glm::vec3(0.0f), glm::vec3(MAX_VALUE));
+        const float     max_c   = std::max(std::max(clamped.x, clamped.y), clamped.z);
+
+        if (!(max_c > 0.0f))
+        {
+            return 0;
+        }
+
+        /* frexp's exponent is floor(log2(max_c)) + 1. */
+        int exponent = 0;
+        std::frexp(max_c, &exponent);
+
+        int   shared_exponent = std::max(exponent - 1, -EXPONENT_BIAS - 1) + 1 + EXPONENT_BIAS;
+        float scale           = std::ldexp(1.0f, MANTISSA_BITS + EXPONENT_BIAS - shared_exponent);
+
+        if (uint32_t(max_c * scale + 0.5f) == (1u << MANTISSA_BITS))
+        {
+            shared_exponent += 1;
+            scale           *= 0.5f;
+        }
+
+        const uint32_t r = uint32_t(clamped.x * scale + 0.5f);
+        const uint32_t g = uint32_t(clamped.y * scale + 0.5f);
+        const uint32_t b = uint32_t(clamped.z * scale + 0.5f);
+
+        return r | (g << 9) | (b << 18) | (uint32_t(shared_exponent) << 27);
+    }
+
+    glm::vec3 Util::UnpackRgb9e5(uint32_t texel)
+    {
+        const float scale = std::ldexp(1.0f, int(texel >> 27) - 15 - 9);
+
+        return glm::vec3(float(texel & 0x1FF), float((texel >> 9) & 0x1FF), float((texel >> 18) & 0x1FF)) * scale;
+    }
+
+    void Util::DownsampleImageRgb9e5(const uint32_t* src, uint32_t src_width, uint32_t src_height, uint32_t* dst)
+    {
+        const uint32_t dst_width  = std::max(src_width  / 2, 1u);
+        const uint32_t dst_height = std::max(src_height / 2, 1u);
+
+        JobSystem::ParallelFor(0, dst_height, HDR_ROWS_PER_JOB, [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t y = begin; y < end; ++y)
+            {
+                const uint32_t* row0    = src + size_t(std::min(2 * y,     src_height - 1)) * src_width;
+                const uint32_t* row1    = src + size_t(std::min(2 * y + 1, src_height - 1)) * src_width;
+                uint32_t*       dst_row = dst + size_t(y) * dst_width;
+
+                for (uint32_t x = 0; x < dst_width; ++x)
+                {
+                    const uint32_t x0 = std::min(2 * x,     src_width - 1);
+                    const uint32_t x1 = std::min(2 * x + 1, src_width - 1);
+
+                    dst_row[x] = PackRgb9e5(0.25f * (UnpackRgb9e5(row0[x0]) + UnpackRgb9e5(row0[x1]) + UnpackRgb9e5(row1[x0]) + UnpackRgb9e5(row1[x1])));
+                }
+            }
+        });
+    }
+
     void Util::ReleaseTextureData(unsigned char* data)
     {
         stbi_image_free(data);
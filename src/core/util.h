@@ -7,6 +7,7 @@
 #include <filesystem>
 #include <random>
 #include <string>
+#include <vector>
 
 namespace RGL
 {
@@ -44,7 +45,15 @@ namespace RGL
         */
         static std::vector<unsigned char> LoadFileBinary(const std::filesystem::path& filename);
 
-        static std::string LoadShaderIncludes(const std::string & shader_code, const std::filesystem::path& dir = "shaders");
+        /**
+        * @brief   Replaces the #include "file" lines with the files' code, recursively.
+        *          The included files are cached process-wide and reloaded when their write time changes.
+        * @param   shader_code  Code of the shader.
+        * @param   dir          Directory the includes (nested ones too) are relative to.
+        * @param   dependencies If not null, the full paths of all the included files are appended to it, without duplicates.
+        * @returns Shader's code with the includes resolved.
+        */
+        static std::string LoadShaderIncludes(const std::string & shader_code, const std::filesystem::path& dir = "shaders", std::vector<std::filesystem::path>* dependencies = nullptr);
         /**
         * @brief   Loads a file that contains an image data.
         * @param   std::string Relative path, with file name
@@ -58,6 +67,28 @@ namespace RGL
         static unsigned char* LoadTextureData    (const std::filesystem::path& filepath,                        ImageData& image_data, int desired_number_of_channels = 0);
         static unsigned char* LoadTextureData    (unsigned char*               memory_data, uint32_t data_size, ImageData& image_data, int desired_number_of_channels = 0);
         static float        * LoadTextureDataHdr (const std::filesystem::path& filepath,                        ImageData& image_data, int desired_number_of_channels = 0);
+
+        /*
+         * Decodes a Radiance .hdr straight into GL_RGB9_E5 texels, flipped like LoadTextureDataHdr(). The RLE scanlines
+         * are located in a serial pass over the runs' headers and decoded in parallel on the job system, the other
+         * encodings go through stb_image. Returns an empty vector if the file couldn't be decoded.
+         */
+        static std::vector<uint32_t> LoadTextureDataHdrRgb9e5(const std::filesystem::path& filepath, ImageData& image_data);
+
+        static uint32_t  PackRgb9e5  (const glm::vec3& color);
+        static glm::vec3 UnpackRgb9e5(uint32_t texel);
+
+        /* Size and number of channels of the image, without decoding it. */
+        static bool LoadTextureInfo(const std::filesystem::path& filepath, ImageData& image_data);
+
+        /*
+         * 2x2 box filter of 8-bit data into a max(src_width / 2, 1) x max(src_height / 2, 1) image, the odd edge reuses the last texel.
+         * With is_srgb the first three channels are averaged in the linear space.
+         */
+        static void DownsampleImage(const unsigned char* src, uint32_t src_width, uint32_t src_height, uint32_t channels, bool is_srgb, unsigned char* dst);
+
+        /* The same box filter of GL_RGB9_E5 texels, averaged as floats, the rows in parallel on the job system. */
+        static void DownsampleImageRgb9e5(const uint32_t* src, uint32_t src_width, uint32_t src_height, uint32_t* dst);
         
         static void ReleaseTextureData (unsigned char* data);
         static void ReleaseTextureData (float*         data);
@@ -87,5 +118,11 @@ namespace RGL
             // Returns a random vec3 in [min, max).
             return glm::vec3(RandomDouble(min, max), RandomDouble(min, max), RandomDouble(min, max));
         }
+
+    private:
+        static constexpr uint32_t MAX_SHADER_INCLUDE_DEPTH = 32;
+
+        static bool        ExpandShaderIncludes (const std::string& shader_code, const std::filesystem::path& dir, std::vector<std::filesystem::path>* dependencies, uint32_t depth, std::string& out);
+        static std::string LoadShaderIncludeFile(const std::filesystem::path& filepath);
     };
 }
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "variable_rate_shading.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+
+#include "core_shared.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+#include "profiler.h"
+#include "render_target_pool.h"
+#include "shader.h"
+
+#include "gui/gui.h"
+
+namespace RGL
+{
+    VariableRateShading::~VariableRateShading()
+    {
+        Release();
+    }
+
+    bool VariableRateShading::Create()
+    {
+        m_is_supported = GLAD_GL_NV_shading_rate_image;
+
+        if (!m_is_supported)
+        {
+            fprintf(stderr, "VariableRateShading: NV_shading_rate_image is not supported, the shading stays per pixel.\n");
+            return true;
+        }
+
+        m_shader = std::make_shared<Shader>("src/core/shaders/shading_rate.comp");
+
+        if (!m_shader->link())
+        {
+            fprintf(stderr, "VariableRateShading: the shader failed to link.\n");
+            m_is_supported = false;
+
+            return false;
+        }
+
+        GLint tile_width = 0, tile_height = 0;
+        glGetIntegerv(GL_SHADING_RATE_IMAGE_TEXEL_WIDTH_NV,  &tile_width);
+        glGetIntegerv(GL_SHADING_RATE_IMAGE_TEXEL_HEIGHT_NV, &tile_height);
+
+        m_tile_width  = uint32_t(std::max(tile_width,  1));
+        m_tile_height = uint32_t(std::max(tile_height, 1));
+
+        /* The palette of the viewport 0, indexed by the rate levels of the image. */
+        const GLenum palette[] = { GL_SHADING_RATE_1_INVOCATION_PER_PIXEL_NV,
+                                   GL_SHADING_RATE_1_INVOCATION_PER_2X2_PIXELS_NV,
+                                   GL_SHADING_RATE_1_INVOCATION_PER_4X4_PIXELS_NV };
+
+        glShadingRateImagePaletteNV(0, 0, GLsizei(std::size(palette)), palette);
+
+        return true;
+    }
+
+    void VariableRateShading::Release()
+    {
+        if (m_texture_name != 0)
+        {
+            GpuMemory::UntrackTexture(m_texture_name);
+            glDeleteTextures(1, &m_texture_name);
+            GLState::OnTextureDeleted(m_texture_name);
+        }
+
+        m_texture_name = 0;
+        m_width        = 0;
+        m_height       = 0;
+    }
+
+    void VariableRateShading::Update(const RenderTarget& previous_scene, uint32_t render_width, uint32_t render_height, GLuint motion_vectors, const glm::vec2& near_far)
+    {
+        m_is_updated = false;
+
+        if (!m_is_supported || !m_is_enabled || render_width == 0 || render_height == 0)
+        {
+            return;
+        }
+
+        ProfilerScope scope("Shading rate image");
+
+        const uint32_t width  = (render_width  + m_tile_width  - 1) / m_tile_width;
+        const uint32_t height = (render_height + m_tile_height - 1) / m_tile_height;
+
+        if (width != m_width || height != m_height)
+        {
+            Release();
+
+            glCreateTextures  (GL_TEXTURE_2D, 1, &m_texture_name);
+            glTextureStorage2D(m_texture_name, 1, GL_R8UI, width, height);
+            GpuMemory::TrackTexture(m_texture_name, "VariableRateShading");
+
+            m_width  = width;
+            m_height = height;
+        }
+
+        const bool has_depth = near_far.y > near_far.x && m_settings.m_focus_range.y > m_settings.m_focus_range.x && previous_scene.GetDepthTexture() != 0;
+
+        m_shader->bind();
+        m_shader->setUniform("u_tile_size",            glm::uvec2(m_tile_width, m_tile_height));
+        m_shader->setUniform("u_render_size",          glm::uvec2(render_width, render_height));
+        m_shader->setUniform("u_max_level",            m_settings.m_is_4x4_allowed ? SHADING_RATE_LEVEL_4X4 : SHADING_RATE_LEVEL_2X2);
+        m_shader->setUniform("u_has_motion_vectors",   motion_vectors != 0);
+        m_shader->setUniform("u_has_depth",            has_depth);
+        m_shader->setUniform("u_contrast_threshold",   m_settings.m_contrast_threshold);
+        m_shader->setUniform("u_motion_threshold",     m_settings.m_motion_threshold);
+        m_shader->setUniform("u_periphery_radius",     m_settings.m_periphery_radius);
+        m_shader->setUniform("u_near_far",             near_far);
+        m_shader->setUniform("u_focus_range",          m_settings.m_focus_range);
+
+        previous_scene.BindColor(0);
+        GLState::BindTextureUnit(1, motion_vectors);
+        GLState::BindTextureUnit(2, has_depth ? previous_scene.GetDepthTexture() : 0);
+        glBindImageTexture(0, m_texture_name, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8UI);
+
+        glDispatchCompute(m_width, m_height, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        m_is_updated = true;
+    }
+
+    void VariableRateShading::BeginShading() const
+    {
+        if (m_is_updated && m_is_enabled)
+        {
+            glBindShadingRateImageNV(m_texture_name);
+            GLState::SetCapability(GL_SHADING_RATE_IMAGE_NV, true);
+        }
+    }
+
+    void VariableRateShading::EndShading() const
+    {
+        if (m_is_supported)
+        {
+            GLState::SetCapability(GL_SHADING_RATE_IMAGE_NV, false);
+        }
+    }
+
+    void VariableRateShading::RenderGui()
+    {
+        if (!m_is_supported)
+        {
+            ImGui::TextDisabled("Variable rate shading: not supported");
+            return;
+        }
+
+        ImGui::Checkbox("Variable rate shading", &m_is_enabled);
+
+        if (m_is_enabled)
+        {
+            ImGui::SliderFloat("VRS contrast threshold", &m_settings.m_contrast_threshold, 0.0f,  0.25f, "%.3f");
+            ImGui::SliderFloat("VRS motion threshold",   &m_settings.m_motion_threshold,   1.0f,  64.0f, "%.1f px");
+            ImGui::SliderFloat("VRS periphery radius",   &m_settings.m_periphery_radius,   0.25f, 1.0f,  "%.2f");
+            ImGui::Checkbox   ("VRS 4x4 rate",           &m_settings.m_is_4x4_allowed);
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+namespace RGL
+{
+    class RenderTarget;
+    class Shader;
+
+    /*
+     * Variable rate shading of the expensive forward passes (NV_shading_rate_image). Update() builds the shading rate
+     * image in compute (shaders/shading_rate.comp) from the previous frame - a texel per tile of the hardware's
+     * texel size, usually 16x16 pixels. A tile is shaded at 2x2 or 4x4 pixels per fragment shader invocation when
+     * it's flat (the luminance deviation relative to its mean is under m_contrast_threshold), when it moves fast
+     * (the motion vectors), when it's at the screen's periphery or fully out of the depth of field's focus range.
+     * The coverage and the depth stay per pixel, only the shading is coarser.
+     *
+     *     vrs.Update(*previous_hdr, render_width, render_height, temporal_aa.GetMotionVectors());
+     *     ... bind the scene target ...
+     *     vrs.BeginShading();
+     *     ... the lighting passes ...
+     *     vrs.EndShading();
+     *
+     * Without the extension Update() and BeginShading() do nothing. Render thread only.
+     */
+    class VariableRateShading final
+    {
+    public:
+        struct Settings
+        {
+            float     m_contrast_threshold = 0.05f;            /* Under it a tile is shaded at 2x2, under a quarter of it at 4x4. */
+            float     m_motion_threshold   = 8.0f;             /* Pixels per frame, over it 2x2, over 4 times it 4x4. */
+            float     m_periphery_radius   = 1.0f;             /* Of the screen's center to a corner, 2x2 and 4x4 out of it. 1 - off. */
+            glm::vec2 m_focus_range        = glm::vec2(0.0f);  /* View depth in focus, 2x2 out of it. An empty range - off. */
+            bool      m_is_4x4_allowed     = true;
+        };
+
+        VariableRateShading() = default;
+        ~VariableRateShading();
+
+        VariableRateShading           (const VariableRateShading&) = delete;
+        VariableRateShading& operator=(const VariableRateShading&) = delete;
+
+        bool Create();
+
+        /*
+         * Before the scene target is bound for the frame - the previous frame's HDR scene, the size that's about to be
+         * rendered. The motion vectors are in UV units (TemporalAA's), 0 skips the motion term. near_far enables
+         * the depth of field term with the previous scene's depth.
+         */
+        void Update(const RenderTarget& previous_scene, uint32_t render_width, uint32_t render_height, GLuint motion_vectors = 0, const glm::vec2& near_far = glm::vec2(0.0f));
+
+        /* The shading rate image of the last Update() around the draws. */
+        void BeginShading() const;
+        void EndShading() const;
+
+        void RenderGui();
+
+        void SetEnabled(bool enable) { m_is_enabled = enable; }
+        bool IsEnabled()   const     { return m_is_enabled; }
+        bool IsSupported() const     { return m_is_supported; }
+
+        Settings m_settings;
+
+    private:
+        void Release();
+
+        std::shared_ptr<Shader> m_shader;
+
+        GLuint   m_texture_name  = 0;  /* R8UI, a rate level per tile. */
+        uint32_t m_width         = 0;
+        uint32_t m_height        = 0;
+        uint32_t m_tile_width    = 16;
+        uint32_t m_tile_height   = 16;
+        bool     m_is_supported  = false;
+        bool     m_is_enabled    = true;
+        bool     m_is_updated    = false;  /* The image is of the current frame. */
+    };
+}
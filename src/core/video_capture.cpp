@@ -0,0 +1,369 @@
+#include "video_capture.h"
+
+#include <algorithm>
+#include <csignal>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+#include "core_shared.h"
+#include "filesystem.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+#include "shader.h"
+#include "window.h"
+
+#ifdef _WIN32
+    #define popen  _popen
+    #define pclose _pclose
+#endif
+
+namespace RGL
+{
+    namespace
+    {
+        const std::pair<const char*, VideoCapture::Encoder> ENCODERS[] = { { "h264_nvenc", VideoCapture::Encoder::H264_NVENC },
+                                                                           { "hevc_nvenc", VideoCapture::Encoder::HEVC_NVENC },
+                                                                           { "h264_vaapi", VideoCapture::Encoder::H264_VAAPI },
+                                                                           { "hevc_vaapi", VideoCapture::Encoder::HEVC_VAAPI } };
+
+        const char* GetEncoderName(VideoCapture::Encoder encoder)
+        {
+            for (const auto& [name, value] : ENCODERS)
+            {
+                if (value == encoder)
+                {
+                    return name;
+                }
+            }
+
+            return ENCODERS[0].first;
+        }
+    }
+
+    VideoCapture::~VideoCapture()
+    {
+        Stop();
+    }
+
+    bool VideoCapture::ParseEncoder(const std::string& name, Encoder& encoder)
+    {
+        for (const auto& [encoder_name, value] : ENCODERS)
+        {
+            if (name == encoder_name)
+            {
+                encoder = value;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool VideoCapture::Start(const std::filesystem::path& filepath, Encoder encoder, uint32_t fps, uint32_t dst_width, uint32_t dst_height)
+    {
+        Stop();
+
+        m_width  = (dst_width  > 0 ? dst_width  : uint32_t(Window::getWidth()))  & ~3u;
+        m_height = (dst_height > 0 ? dst_height : uint32_t(Window::getHeight())) & ~1u;
+
+        if (m_width == 0 || m_height == 0)
+        {
+            fprintf(stderr, "VideoCapture: the video of %ux%u is too small.\n", m_width, m_height);
+            return false;
+        }
+
+        m_convert_shader = std::make_shared<Shader>("src/core/shaders/video_capture_nv12.comp");
+
+        if (!m_convert_shader->link())
+        {
+            fprintf(stderr, "VideoCapture: the conversion shader failed to link.\n");
+            Release();
+            return false;
+        }
+
+        if (filepath.has_parent_path() && !FileSystem::directoryExists(filepath.parent_path()))
+        {
+            FileSystem::createDirectory(filepath.parent_path());
+        }
+
+        /* The VAAPI encoders take the frames from the GPU's memory, ffmpeg uploads them. */
+        const bool is_vaapi = encoder == Encoder::H264_VAAPI || encoder == Encoder::HEVC_VAAPI;
+
+        char command[1024];
+        snprintf(command, sizeof(command),
+                 "ffmpeg -hide_banner -loglevel error -y %s-f rawvideo -pix_fmt nv12 -s %ux%u -framerate %u -i - "
+                 "%s-c:v %s %s -colorspace bt709 -color_primaries bt709 -color_trc bt709 \"%s\"",
+                 is_vaapi ? "-vaapi_device /dev/dri/renderD128 " : "",
+                 m_width, m_height, std::max(fps, 1u),
+                 is_vaapi ? "-vf format=nv12,hwupload " : "",
+                 GetEncoderName(encoder),
+                 is_vaapi ? "-qp 20" : "-preset p4 -cq 20",
+                 filepath.string().c_str());
+
+#ifdef _WIN32
+        m_pipe = popen(command, "wb");
+#else
+        /* A write to the pipe of an encoder that has exited fails instead of killing the app. */
+        std::signal(SIGPIPE, SIG_IGN);
+        m_pipe = popen(command, "w");
+#endif
+
+        if (!m_pipe)
+        {
+            fprintf(stderr, "VideoCapture: could not start the encoder: %s\n", command);
+            Release();
+            return false;
+        }
+
+        m_frame_size = size_t(m_width) * m_height * 3 / 2;
+
+        for (auto& slot : m_slots)
+        {
+            glCreateBuffers     (1, &slot.m_buffer_name);
+            glNamedBufferStorage(slot.m_buffer_name, GLsizeiptr(m_frame_size), nullptr, GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT | GL_CLIENT_STORAGE_BIT);
+            GpuMemory::TrackBuffer(slot.m_buffer_name, "VideoCapture");
+
+            slot.m_data  = glMapNamedBufferRange(slot.m_buffer_name, 0, GLsizeiptr(m_frame_size), GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+            slot.m_state = SlotState::FREE;
+        }
+
+        m_filepath             = filepath;
+        m_next_slot            = 0;
+        m_frames_count         = 0;
+        m_dropped_frames_count = 0;
+        m_is_stopping          = false;
+        m_has_failed           = false;
+
+        m_worker = std::thread(&VideoCapture::WorkerLoop, this);
+
+        printf("VideoCapture: recording %ux%u to %s with %s\n", m_width, m_height, filepath.string().c_str(), GetEncoderName(encoder));
+
+        return true;
+    }
+
+    void VideoCapture::Stop()
+    {
+        if (!m_pipe)
+        {
+            return;
+        }
+
+        ResolveSlots(true);
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_idle_condition.wait(lock, [this] { return m_jobs.empty() && !m_is_worker_busy; });
+
+            m_is_stopping = true;
+        }
+        m_jobs_condition.notify_one();
+        m_worker.join();
+
+        /* Waits for the encoder to finish the file. */
+        pclose(m_pipe);
+        m_pipe = nullptr;
+
+        printf("VideoCapture: %llu frames written to %s, %u dropped\n", (unsigned long long)m_frames_count, m_filepath.string().c_str(), m_dropped_frames_count);
+
+        Release();
+    }
+
+    void VideoCapture::Update()
+    {
+        if (!m_pipe)
+        {
+            return;
+        }
+
+        ResolveSlots(false);
+
+        Slot& slot = m_slots[m_next_slot];
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            /* All the buffers are in flight or queued for the encoder - the frame is dropped, never waited for. */
+            if (slot.m_state != SlotState::FREE)
+            {
+                m_dropped_frames_count++;
+                return;
+            }
+        }
+
+        ConvertFrame(slot);
+
+        m_next_slot = (m_next_slot + 1) % SLOTS_COUNT;
+        m_frames_count++;
+    }
+
+    void VideoCapture::Release()
+    {
+        for (auto& slot : m_slots)
+        {
+            if (slot.m_fence)
+            {
+                glDeleteSync(slot.m_fence);
+            }
+
+            if (slot.m_buffer_name != 0)
+            {
+                glUnmapNamedBuffer(slot.m_buffer_name);
+
+                GpuMemory::UntrackBuffer(slot.m_buffer_name);
+                glDeleteBuffers(1, &slot.m_buffer_name);
+            }
+
+            slot = {};
+        }
+
+        if (m_source_texture_name != 0)
+        {
+            GpuMemory::UntrackTexture(m_source_texture_name);
+            glDeleteTextures(1, &m_source_texture_name);
+            GLState::OnTextureDeleted(m_source_texture_name);
+            m_source_texture_name = 0;
+        }
+
+        if (m_source_fbo_name != 0)
+        {
+            glDeleteFramebuffers(1, &m_source_fbo_name);
+            GLState::OnFramebufferDeleted(m_source_fbo_name);
+            m_source_fbo_name = 0;
+        }
+
+        m_convert_shader.reset();
+
+        m_jobs.clear();
+        m_source_width  = 0;
+        m_source_height = 0;
+        m_frame_size    = 0;
+    }
+
+    void VideoCapture::ResolveSlots(bool wait)
+    {
+        /* Oldest first, the conversions complete in order - the first one that isn't done ends the resolve. */
+        for (uint32_t i = 0; i < SLOTS_COUNT; ++i)
+        {
+            const uint32_t index = (m_next_slot + i) % SLOTS_COUNT;
+            Slot&          slot  = m_slots[index];
+
+            if (!slot.m_fence)
+            {
+                continue;
+            }
+
+            const GLenum status = glClientWaitSync(slot.m_fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GL_TIMEOUT_IGNORED : 0);
+
+            if (status == GL_TIMEOUT_EXPIRED)
+            {
+                break;
+            }
+
+            glDeleteSync(slot.m_fence);
+            slot.m_fence = nullptr;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                slot.m_state = SlotState::WRITING;
+                m_jobs.push_back(index);
+            }
+            m_jobs_condition.notify_one();
+        }
+    }
+
+    void VideoCapture::ConvertFrame(Slot& slot)
+    {
+        const uint32_t width  = uint32_t(Window::getWidth());
+        const uint32_t height = uint32_t(Window::getHeight());
+
+        /* The compute pass can't read the default framebuffer, a blit copies it on the GPU. */
+        if (width != m_source_width || height != m_source_height)
+        {
+            if (m_source_texture_name != 0)
+            {
+                GpuMemory::UntrackTexture(m_source_texture_name);
+                glDeleteTextures(1, &m_source_texture_name);
+                GLState::OnTextureDeleted(m_source_texture_name);
+            }
+
+            glCreateTextures   (GL_TEXTURE_2D, 1, &m_source_texture_name);
+            glTextureStorage2D (m_source_texture_name, 1, GL_RGBA8, width, height);
+            glTextureParameteri(m_source_texture_name, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTextureParameteri(m_source_texture_name, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTextureParameteri(m_source_texture_name, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+            glTextureParameteri(m_source_texture_name, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+            GpuMemory::TrackTexture(m_source_texture_name, "VideoCapture");
+
+            if (m_source_fbo_name == 0)
+            {
+                glCreateFramebuffers(1, &m_source_fbo_name);
+            }
+
+            glNamedFramebufferTexture(m_source_fbo_name, GL_COLOR_ATTACHMENT0, m_source_texture_name, 0);
+
+            m_source_width  = width;
+            m_source_height = height;
+        }
+
+        glBlitNamedFramebuffer(0, m_source_fbo_name, 0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+        m_convert_shader->bind();
+        m_convert_shader->setUniform("u_size", glm::uvec2(m_width, m_height));
+
+        GLState::BindTextureUnit(0, m_source_texture_name);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VIDEO_CAPTURE_SSBO_BINDING_INDEX, slot.m_buffer_name);
+
+        /* A thread per 4x2 block of the video - a word of luma in each of the rows, a word of chroma. */
+        const uint32_t blocks_x = m_width  / 4;
+        const uint32_t blocks_y = m_height / 2;
+
+        glDispatchCompute((blocks_x + VIDEO_CAPTURE_GROUP_SIZE - 1) / VIDEO_CAPTURE_GROUP_SIZE, (blocks_y + VIDEO_CAPTURE_GROUP_SIZE - 1) / VIDEO_CAPTURE_GROUP_SIZE, 1);
+        glMemoryBarrier  (GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+
+        slot.m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        slot.m_state = SlotState::CONVERTING;
+    }
+
+    void VideoCapture::WorkerLoop()
+    {
+        while (true)
+        {
+            uint32_t index;
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                m_is_worker_busy = false;
+                m_idle_condition.notify_all();
+
+                m_jobs_condition.wait(lock, [this] { return !m_jobs.empty() || m_is_stopping; });
+
+                if (m_jobs.empty())
+                {
+                    return;
+                }
+
+                index = m_jobs.front();
+                m_jobs.pop_front();
+
+                m_is_worker_busy = true;
+            }
+
+            Slot& slot = m_slots[index];
+
+            /* Straight from the mapped buffer, the fence has signaled. */
+            if (!m_has_failed && fwrite(slot.m_data, m_frame_size, 1, m_pipe) != 1)
+            {
+                fprintf(stderr, "VideoCapture: the encoder stopped taking the frames of %s\n", m_filepath.string().c_str());
+                m_has_failed = true;
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            slot.m_state = SlotState::FREE;
+        }
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <glad/glad.h>
+
+namespace RGL
+{
+    class Shader;
+
+    /*
+     * Records the default framebuffer to an H.264 or HEVC video with a hardware encoder, for the recorded benchmark
+     * runs. The frame is blitted to a texture and converted to NV12 (BT.709, the limited range) by a compute pass
+     * (shaders/video_capture_nv12.comp) that scales it to the video's size and writes a persistently mapped buffer.
+     * A worker thread streams the buffers, once their fences signal, to the stdin of an ffmpeg process running
+     * the NVENC or VAAPI encoder - the render thread neither reads back nor copies the pixels, its cost is
+     * the blit, the dispatch and the fence checks.
+     *
+     * The frames are dropped instead of stalling when all SLOTS_COUNT buffers are still in flight or being written,
+     * the count is printed by Stop(). The encoder runs at the fps given to Start() whatever the frame times are.
+     */
+    class VideoCapture final
+    {
+    public:
+        static constexpr uint32_t SLOTS_COUNT = 4;
+
+        enum class Encoder { H264_NVENC, HEVC_NVENC, H264_VAAPI, HEVC_VAAPI };
+
+        VideoCapture() = default;
+        ~VideoCapture();
+
+        VideoCapture           (const VideoCapture&) = delete;
+        VideoCapture& operator=(const VideoCapture&) = delete;
+
+        /* The ffmpeg names: h264_nvenc, hevc_nvenc, h264_vaapi, hevc_vaapi. Returns false for the others. */
+        static bool ParseEncoder(const std::string& name, Encoder& encoder);
+
+        /*
+         * Starts the encoder process writing filepath. The size of 0 keeps the framebuffer size, the width is rounded
+         * down to a multiple of 4 and the height to a multiple of 2 for the NV12 blocks.
+         */
+        bool Start(const std::filesystem::path& filepath, Encoder encoder, uint32_t fps, uint32_t dst_width = 0, uint32_t dst_height = 0);
+
+        /* Encodes the frames in flight and closes the video. */
+        void Stop();
+
+        bool IsRecording() const { return m_pipe != nullptr; }
+
+        /* Has to be called once per frame, after the frame is rendered to the default framebuffer and before the swap. */
+        void Update();
+
+        uint64_t GetFramesCount()        const { return m_frames_count; }
+        uint32_t GetDroppedFramesCount() const { return m_dropped_frames_count; }
+
+    private:
+        enum class SlotState { FREE, CONVERTING, WRITING };
+
+        struct Slot
+        {
+            GLuint    m_buffer_name = 0;
+            void*     m_data        = nullptr;  /* Persistently mapped. */
+            GLsync    m_fence       = nullptr;
+            SlotState m_state       = SlotState::FREE;  /* Under m_mutex, the worker frees the written slots. */
+        };
+
+        void Release();
+
+        void ResolveSlots(bool wait);
+        void ConvertFrame(Slot& slot);
+        void WorkerLoop  ();
+
+        std::shared_ptr<Shader> m_convert_shader;
+
+        Slot     m_slots[SLOTS_COUNT];
+        uint32_t m_next_slot  = 0;
+        size_t   m_frame_size = 0;   /* NV12: width * height luma bytes, then half as many interleaved chroma bytes. */
+        uint32_t m_width      = 0;
+        uint32_t m_height     = 0;
+
+        /* The default framebuffer's copy, recreated when the window is resized. */
+        GLuint   m_source_texture_name = 0;
+        GLuint   m_source_fbo_name     = 0;
+        uint32_t m_source_width        = 0;
+        uint32_t m_source_height       = 0;
+
+        std::filesystem::path m_filepath;
+        FILE*                 m_pipe                 = nullptr;
+        uint64_t              m_frames_count         = 0;
+        uint32_t              m_dropped_frames_count = 0;
+
+        std::thread             m_worker;
+        std::mutex              m_mutex;
+        std::condition_variable m_jobs_condition;
+        std::condition_variable m_idle_condition;
+        std::deque<uint32_t>    m_jobs;          /* The slots to write, in the order of the frames. */
+        bool                    m_is_worker_busy = false;
+        bool                    m_is_stopping    = false;
+        bool                    m_has_failed     = false; /* The encoder closed its stdin, the frames are skipped. */
+    };
+}
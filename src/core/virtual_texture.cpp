@@ -0,0 +1,643 @@
+#include "virtual_texture.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <glm/glm.hpp>
+
+#include "core_shared.h"
+#include "filesystem.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+#include "trace.h"
+#include "util.h"
+
+namespace RGL
+{
+    namespace
+    {
+        /* .vtex page file: the header, then the pages written by VirtualTexture::WritePages(). */
+        struct VtexHeader
+        {
+            char     m_magic[4];
+            uint32_t m_version;
+            uint32_t m_width;
+            uint32_t m_height;
+            uint32_t m_page_size;
+            uint32_t m_padding;
+        };
+
+        constexpr char     VTEX_MAGIC[4]   = { 'R', 'G', 'V', 'T' };
+        constexpr uint32_t VTEX_VERSION    = 1;
+        constexpr uint32_t BYTES_PER_TEXEL = 4;
+
+        /* The page stamps start far from 0, so the zeroed feedback doesn't look like a recent request. */
+        constexpr uint32_t FIRST_FRAME = 1000;
+
+        bool IsPowerOfTwo(uint32_t value)
+        {
+            return value != 0 && (value & (value - 1)) == 0;
+        }
+
+        uint32_t GetLevelsCount(uint32_t width, uint32_t height)
+        {
+            return 1 + uint32_t(std::floor(std::log2(std::max(width, height))));
+        }
+    }
+
+    VirtualTexture::VirtualTexture()
+        : m_pages_data          (nullptr),
+          m_texture_name        (0),
+          m_page_table_name     (0),
+          m_feedback_buffer_name(0),
+          m_readback_buffer_name(0),
+          m_readback_data       (nullptr),
+          m_readback_fences     {},
+          m_readback_slot       (0),
+          m_width               (0),
+          m_height              (0),
+          m_levels_count        (0),
+          m_paged_levels        (0),
+          m_page_size           (0),
+          m_pages_x             (0),
+          m_pages_y             (0),
+          m_frame               (FIRST_FRAME),
+          m_resident_pages_count(0),
+          m_max_resident_pages  (0),
+          m_is_page_table_dirty (false)
+    {
+    }
+
+    VirtualTexture::~VirtualTexture()
+    {
+        Release();
+    }
+
+    bool VirtualTexture::Load(const std::filesystem::path& filepath, bool is_srgb, uint32_t max_resident_pages)
+    {
+        if (!IsSupported())
+        {
+            fprintf(stderr, "VirtualTexture: ARB_sparse_texture is not supported.\n");
+            return false;
+        }
+
+        Release();
+
+        m_max_resident_pages = std::max(max_resident_pages, 1u);
+
+        const auto vtex_filepath = std::filesystem::path(filepath).replace_extension(".vtex");
+
+        if (FileSystem::exists(vtex_filepath) && m_file.Open(vtex_filepath))
+        {
+            VtexHeader header = {};
+
+            if (m_file.GetSize() >= sizeof(header))
+            {
+                std::memcpy(&header, m_file.GetData(), sizeof(header));
+            }
+
+            if (std::memcmp(header.m_magic, VTEX_MAGIC, sizeof(VTEX_MAGIC)) != 0 || header.m_version != VTEX_VERSION)
+            {
+                fprintf(stderr, "VirtualTexture: %s is not a page file of this version.\n", vtex_filepath.string().c_str());
+                m_file.Close();
+                return false;
+            }
+
+            return Create(m_file.GetData() + sizeof(header), m_file.GetSize() - sizeof(header), header.m_width, header.m_height, header.m_page_size, is_srgb);
+        }
+
+        ImageData      metadata;
+        unsigned char* data = Util::LoadTextureData(filepath, metadata, BYTES_PER_TEXEL);
+
+        if (!data)
+        {
+            fprintf(stderr, "Texture failed to load at path: %s\n", filepath.string().c_str());
+            return false;
+        }
+
+        bool is_written = IsPowerOfTwo(metadata.width) && IsPowerOfTwo(metadata.height) &&
+                          WritePages(data, metadata.width, metadata.height, PAGE_SIZE, is_srgb, [this](const uint8_t* page_data, size_t size)
+                          {
+                              m_memory_pages.insert(m_memory_pages.end(), page_data, page_data + size);
+                              return true;
+                          });
+
+        Util::ReleaseTextureData(data);
+
+        if (!is_written)
+        {
+            fprintf(stderr, "VirtualTexture: %s - the size has to be a power of two.\n", filepath.string().c_str());
+            return false;
+        }
+
+        return Create(m_memory_pages.data(), m_memory_pages.size(), metadata.width, metadata.height, PAGE_SIZE, is_srgb);
+    }
+
+    bool VirtualTexture::Bake(const std::filesystem::path& image_filepath, const std::filesystem::path& output_filepath, bool is_srgb, uint32_t page_size)
+    {
+        ImageData      metadata;
+        unsigned char* data = Util::LoadTextureData(image_filepath, metadata, BYTES_PER_TEXEL);
+
+        if (!data)
+        {
+            fprintf(stderr, "Texture failed to load at path: %s\n", image_filepath.string().c_str());
+            return false;
+        }
+
+        if (!IsPowerOfTwo(metadata.width) || !IsPowerOfTwo(metadata.height) || !IsPowerOfTwo(page_size))
+        {
+            fprintf(stderr, "VirtualTexture::Bake: %s - the image and the page sizes have to be powers of two.\n", image_filepath.string().c_str());
+            Util::ReleaseTextureData(data);
+            return false;
+        }
+
+        std::ofstream file(output_filepath, std::ios::binary);
+
+        VtexHeader header = {};
+        std::memcpy(header.m_magic, VTEX_MAGIC, sizeof(VTEX_MAGIC));
+        header.m_version   = VTEX_VERSION;
+        header.m_width     = metadata.width;
+        header.m_height    = metadata.height;
+        header.m_page_size = page_size;
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        const bool is_written = WritePages(data, metadata.width, metadata.height, page_size, is_srgb, [&file](const uint8_t* page_data, size_t size)
+        {
+            file.write(reinterpret_cast<const char*>(page_data), std::streamsize(size));
+            return bool(file);
+        });
+
+        Util::ReleaseTextureData(data);
+
+        if (!is_written || !file)
+        {
+            fprintf(stderr, "Could not write the file %s\n", output_filepath.string().c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    bool VirtualTexture::WritePages(const unsigned char* data, uint32_t width, uint32_t height, uint32_t page_size, bool is_srgb, const PageWriter& writer)
+    {
+        const uint32_t levels_count = GetLevelsCount(width, height);
+
+        std::vector<unsigned char> tile(size_t(page_size) * page_size * BYTES_PER_TEXEL);
+        std::vector<unsigned char> level_data, next_level_data;
+
+        const unsigned char* level_texels = data;
+
+        for (uint32_t level = 0; level < levels_count; ++level)
+        {
+            const uint32_t level_width  = std::max(width  >> level, 1u);
+            const uint32_t level_height = std::max(height >> level, 1u);
+            const uint32_t tile_width   = std::min(page_size, level_width);
+            const uint32_t tile_height  = std::min(page_size, level_height);
+
+            for (uint32_t tile_y = 0; tile_y < level_height / tile_height; ++tile_y)
+            {
+                for (uint32_t tile_x = 0; tile_x < level_width / tile_width; ++tile_x)
+                {
+                    for (uint32_t row = 0; row < tile_height; ++row)
+                    {
+                        const size_t texel = (size_t(tile_y) * tile_height + row) * level_width + size_t(tile_x) * tile_width;
+
+                        std::memcpy(tile.data() + size_t(row) * tile_width * BYTES_PER_TEXEL, level_texels + texel * BYTES_PER_TEXEL, size_t(tile_width) * BYTES_PER_TEXEL);
+                    }
+
+                    if (!writer(tile.data(), size_t(tile_width) * tile_height * BYTES_PER_TEXEL))
+                    {
+                        return false;
+                    }
+                }
+            }
+
+            if (level + 1 < levels_count)
+            {
+                next_level_data.resize(size_t(std::max(level_width / 2, 1u)) * std::max(level_height / 2, 1u) * BYTES_PER_TEXEL);
+                Util::DownsampleImage(level_texels, level_width, level_height, BYTES_PER_TEXEL, is_srgb, next_level_data.data());
+
+                level_data.swap(next_level_data);
+                level_texels = level_data.data();
+            }
+        }
+
+        return true;
+    }
+
+    bool VirtualTexture::Create(const uint8_t* pages_data, size_t pages_size, uint32_t width, uint32_t height, uint32_t page_size, bool is_srgb)
+    {
+        const GLenum internal_format = is_srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+
+        GLint sparse_page_width = 0, sparse_page_height = 0;
+        glGetInternalformativ(GL_TEXTURE_2D, internal_format, GL_VIRTUAL_PAGE_SIZE_X_ARB, 1, &sparse_page_width);
+        glGetInternalformativ(GL_TEXTURE_2D, internal_format, GL_VIRTUAL_PAGE_SIZE_Y_ARB, 1, &sparse_page_height);
+
+        if (!IsPowerOfTwo(width) || !IsPowerOfTwo(height) || sparse_page_width <= 0 || sparse_page_height <= 0 ||
+            page_size % sparse_page_width != 0 || page_size % sparse_page_height != 0)
+        {
+            fprintf(stderr, "VirtualTexture: %ux%u pages of %u texels don't match the sparse pages of %dx%d texels.\n",
+                    width, height, page_size, sparse_page_width, sparse_page_height);
+            return false;
+        }
+
+        m_width        = width;
+        m_height       = height;
+        m_page_size    = page_size;
+        m_levels_count = GetLevelsCount(width, height);
+
+        /* Level by level data offsets, the size has to match before any page is read. */
+        size_t data_size = 0;
+
+        for (uint32_t level = 0; level < m_levels_count; ++level)
+        {
+            m_level_data_offsets.push_back(data_size);
+            data_size += size_t(std::max(width >> level, 1u)) * std::max(height >> level, 1u) * BYTES_PER_TEXEL;
+        }
+
+        if (pages_size < data_size)
+        {
+            fprintf(stderr, "VirtualTexture: the page data is truncated.\n");
+            return false;
+        }
+
+        m_pages_data = pages_data;
+
+        /* Not in GpuMemory, the storage is virtual - GetResidentPagesCount() is the committed part. */
+        glCreateTextures   (GL_TEXTURE_2D, 1, &m_texture_name);
+        glTextureParameteri(m_texture_name, GL_TEXTURE_SPARSE_ARB,           GL_TRUE);
+        glTextureParameteri(m_texture_name, GL_VIRTUAL_PAGE_SIZE_INDEX_ARB,  0);
+        glTextureStorage2D (m_texture_name, m_levels_count, internal_format, m_width, m_height);
+
+        GLint sparse_levels = 0;
+        glGetTextureParameteriv(m_texture_name, GL_NUM_SPARSE_LEVELS_ARB, &sparse_levels);
+
+        /* The levels with whole pages are paged, the smaller ones are the mip tail. */
+        while (m_paged_levels < std::min<uint32_t>(sparse_levels, VIRTUAL_TEXTURE_MAX_LEVELS) &&
+               (m_width >> m_paged_levels) >= m_page_size && (m_height >> m_paged_levels) >= m_page_size)
+        {
+            ++m_paged_levels;
+        }
+
+        m_pages_x = std::max(m_width  / m_page_size, 1u);
+        m_pages_y = std::max(m_height / m_page_size, 1u);
+
+        for (uint32_t level = 0; level < m_paged_levels; ++level)
+        {
+            m_level_page_offsets.push_back(uint32_t(m_pages.size()));
+
+            for (uint32_t y = 0; y < (m_pages_y >> level); ++y)
+            {
+                for (uint32_t x = 0; x < (m_pages_x >> level); ++x)
+                {
+                    m_pages.push_back({ 0, uint16_t(x), uint16_t(y), uint8_t(level), false });
+                }
+            }
+        }
+
+        /* The commitment functions work on the bound texture. */
+        GLState::BindTextureUnit(VIRTUAL_TEXTURE_UNIT, m_texture_name);
+        glActiveTexture(GL_TEXTURE0 + VIRTUAL_TEXTURE_UNIT);
+
+        for (uint32_t level = m_paged_levels; level < m_levels_count; ++level)
+        {
+            const uint32_t level_width  = std::max(m_width  >> level, 1u);
+            const uint32_t level_height = std::max(m_height >> level, 1u);
+
+            glTexPageCommitmentARB(GL_TEXTURE_2D, level, 0, 0, 0, level_width, level_height, 1, GL_TRUE);
+
+            for (uint32_t y = 0; y < level_height / GetTileHeight(level); ++y)
+            {
+                for (uint32_t x = 0; x < level_width / GetTileWidth(level); ++x)
+                {
+                    glTextureSubImage2D(m_texture_name, level, x * GetTileWidth(level), y * GetTileHeight(level), GetTileWidth(level), GetTileHeight(level),
+                                        GL_RGBA, GL_UNSIGNED_BYTE, m_pages_data + GetTileOffset(level, x, y));
+                }
+            }
+        }
+
+        glActiveTexture(GL_TEXTURE0);
+
+        glTextureParameteri(m_texture_name, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTextureParameteri(m_texture_name, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(m_texture_name, GL_TEXTURE_WRAP_S,     GL_REPEAT);
+        glTextureParameteri(m_texture_name, GL_TEXTURE_WRAP_T,     GL_REPEAT);
+
+        /* Nothing but the mip tail is resident yet. */
+        m_page_table.assign(size_t(m_pages_x) * m_pages_y, uint8_t(m_paged_levels));
+        m_is_page_table_dirty = true;
+
+        glCreateTextures  (GL_TEXTURE_2D, 1, &m_page_table_name);
+        glTextureStorage2D(m_page_table_name, 1, GL_R8UI, m_pages_x, m_pages_y);
+        GpuMemory::TrackTexture(m_page_table_name, "VirtualTexture");
+
+        VirtualTextureInfo info = {};
+        info.pages_x      = m_pages_x;
+        info.pages_y      = m_pages_y;
+        info.paged_levels = m_paged_levels;
+        info.frame        = m_frame;
+
+        for (uint32_t level = 0; level < m_paged_levels; ++level)
+        {
+            info.level_offsets[level] = m_level_page_offsets[level];
+        }
+
+        const GLsizeiptr requests_size = GLsizeiptr(std::max<size_t>(m_pages.size(), 1)) * sizeof(uint32_t);
+        const uint32_t   zero          = 0;
+
+        glCreateBuffers         (1, &m_feedback_buffer_name);
+        glNamedBufferStorage    (m_feedback_buffer_name, sizeof(info) + requests_size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+        glClearNamedBufferData  (m_feedback_buffer_name, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        glNamedBufferSubData    (m_feedback_buffer_name, 0, sizeof(info), &info);
+        GpuMemory::TrackBuffer(m_feedback_buffer_name, "VirtualTexture");
+
+        const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        glCreateBuffers     (1, &m_readback_buffer_name);
+        glNamedBufferStorage(m_readback_buffer_name, requests_size * FEEDBACK_FRAMES, nullptr, flags);
+        GpuMemory::TrackBuffer(m_readback_buffer_name, "VirtualTexture");
+
+        m_readback_data = static_cast<uint32_t*>(glMapNamedBufferRange(m_readback_buffer_name, 0, requests_size * FEEDBACK_FRAMES, flags));
+
+        return true;
+    }
+
+    void VirtualTexture::Update(uint32_t max_uploads)
+    {
+        if (m_texture_name == 0 || m_pages.empty())
+        {
+            return;
+        }
+
+        RGL_TRACE_ZONE("Virtual texture");
+
+        const GLsizeiptr requests_size = GLsizeiptr(m_pages.size()) * sizeof(uint32_t);
+
+        /* The requests of FEEDBACK_FRAMES frames ago, the copy is long done by now. */
+        GLsync& fence = m_readback_fences[m_readback_slot];
+
+        if (fence)
+        {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(-1));
+            glDeleteSync    (fence);
+            fence = nullptr;
+
+            ReadFeedback(m_readback_slot);
+        }
+
+        /* The requests of the last frame. */
+        glMemoryBarrier         (GL_BUFFER_UPDATE_BARRIER_BIT);
+        glCopyNamedBufferSubData(m_feedback_buffer_name, m_readback_buffer_name, sizeof(VirtualTextureInfo), requests_size * m_readback_slot, requests_size);
+
+        fence           = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_readback_slot = (m_readback_slot + 1) % FEEDBACK_FRAMES;
+
+        ++m_frame;
+        glNamedBufferSubData(m_feedback_buffer_name, offsetof(VirtualTextureInfo, frame), sizeof(uint32_t), &m_frame);
+
+        /* The missing pages whose parents are resident, coarse to fine - a page is never sampled without its parents. */
+        std::vector<uint32_t> candidates;
+
+        for (uint32_t i = 0; i < m_pages.size(); ++i)
+        {
+            const Page& page = m_pages[i];
+
+            if (page.m_is_resident || m_frame - page.m_last_request >= REQUEST_FRAMES)
+            {
+                continue;
+            }
+
+            if (page.m_level + 1u == m_paged_levels || m_pages[GetPageIndex(page.m_level + 1, page.m_x / 2, page.m_y / 2)].m_is_resident)
+            {
+                candidates.push_back(i);
+            }
+        }
+
+        std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b)
+        {
+            const Page& page_a = m_pages[a];
+            const Page& page_b = m_pages[b];
+
+            return page_a.m_level != page_b.m_level ? page_a.m_level > page_b.m_level : int32_t(page_a.m_last_request - page_b.m_last_request) > 0;
+        });
+
+        if (candidates.size() > max_uploads)
+        {
+            candidates.resize(max_uploads);
+        }
+
+        if (!candidates.empty())
+        {
+            GLState::BindTextureUnit(VIRTUAL_TEXTURE_UNIT, m_texture_name);
+            glActiveTexture(GL_TEXTURE0 + VIRTUAL_TEXTURE_UNIT);
+
+            for (uint32_t index : candidates)
+            {
+                /* Out of the budget and every resident page is in use. */
+                if (m_resident_pages_count >= m_max_resident_pages && !EvictPage())
+                {
+                    break;
+                }
+
+                MakeResident(m_pages[index], true);
+            }
+
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+        if (m_is_page_table_dirty)
+        {
+            glPixelStorei      (GL_UNPACK_ALIGNMENT, 1);
+            glTextureSubImage2D(m_page_table_name, 0, 0, 0, m_pages_x, m_pages_y, GL_RED_INTEGER, GL_UNSIGNED_BYTE, m_page_table.data());
+            glPixelStorei      (GL_UNPACK_ALIGNMENT, 4);
+
+            m_is_page_table_dirty = false;
+        }
+    }
+
+    void VirtualTexture::Bind() const
+    {
+        GLState::BindTextureUnit(VIRTUAL_TEXTURE_UNIT,            m_texture_name);
+        GLState::BindTextureUnit(VIRTUAL_TEXTURE_PAGE_TABLE_UNIT, m_page_table_name);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VIRTUAL_TEXTURE_FEEDBACK_SSBO_BINDING_INDEX, m_feedback_buffer_name);
+    }
+
+    void VirtualTexture::SetWraping(GLenum coord, GLenum param)
+    {
+        glTextureParameteri(m_texture_name, coord, GLint(param));
+    }
+
+    size_t VirtualTexture::GetTileOffset(uint32_t level, uint32_t x, uint32_t y) const
+    {
+        const uint32_t tiles_x   = std::max(m_width >> level, 1u) / GetTileWidth(level);
+        const size_t   tile_size = size_t(GetTileWidth(level)) * GetTileHeight(level) * BYTES_PER_TEXEL;
+
+        return m_level_data_offsets[level] + (size_t(y) * tiles_x + x) * tile_size;
+    }
+
+    void VirtualTexture::ReadFeedback(uint32_t slot)
+    {
+        const uint32_t* requests = m_readback_data + size_t(slot) * m_pages.size();
+
+        for (uint32_t i = 0; i < m_pages.size(); ++i)
+        {
+            const uint32_t stamp = requests[i];
+
+            if (int32_t(stamp - m_pages[i].m_last_request) <= 0)
+            {
+                continue;
+            }
+
+            /* The parents are needed for the filtering between the levels and they have to be loaded first. */
+            const Page& page = m_pages[i];
+
+            for (uint32_t level = page.m_level; level < m_paged_levels; ++level)
+            {
+                const uint32_t shift  = level - page.m_level;
+                Page&          parent = m_pages[GetPageIndex(level, page.m_x >> shift, page.m_y >> shift)];
+
+                if (level > page.m_level && int32_t(stamp - parent.m_last_request) <= 0)
+                {
+                    break;
+                }
+
+                parent.m_last_request = stamp;
+            }
+        }
+    }
+
+    void VirtualTexture::MakeResident(Page& page, bool is_resident)
+    {
+        const uint32_t x = page.m_x * m_page_size;
+        const uint32_t y = page.m_y * m_page_size;
+
+        glTexPageCommitmentARB(GL_TEXTURE_2D, page.m_level, x, y, 0, m_page_size, m_page_size, 1, is_resident ? GL_TRUE : GL_FALSE);
+
+        if (is_resident)
+        {
+            glTextureSubImage2D(m_texture_name, page.m_level, x, y, m_page_size, m_page_size, GL_RGBA, GL_UNSIGNED_BYTE, m_pages_data + GetTileOffset(page.m_level, page.m_x, page.m_y));
+        }
+
+        page.m_is_resident      = is_resident;
+        m_resident_pages_count += is_resident ? 1 : -1;
+
+        UpdatePageTable(page);
+    }
+
+    bool VirtualTexture::EvictPage()
+    {
+        /* The least recently requested page that isn't in use and has no resident children. */
+        Page* victim = nullptr;
+
+        for (auto& page : m_pages)
+        {
+            if (!page.m_is_resident || m_frame - page.m_last_request < REQUEST_FRAMES)
+            {
+                continue;
+            }
+
+            if (page.m_level > 0)
+            {
+                const uint32_t x = page.m_x * 2u;
+                const uint32_t y = page.m_y * 2u;
+                const uint32_t l = page.m_level - 1u;
+
+                if (m_pages[GetPageIndex(l, x, y)].m_is_resident     || m_pages[GetPageIndex(l, x + 1, y)].m_is_resident ||
+                    m_pages[GetPageIndex(l, x, y + 1)].m_is_resident || m_pages[GetPageIndex(l, x + 1, y + 1)].m_is_resident)
+                {
+                    continue;
+                }
+            }
+
+            if (!victim || int32_t(page.m_last_request - victim->m_last_request) < 0)
+            {
+                victim = &page;
+            }
+        }
+
+        if (!victim)
+        {
+            return false;
+        }
+
+        MakeResident(*victim, false);
+        return true;
+    }
+
+    void VirtualTexture::UpdatePageTable(const Page& page)
+    {
+        /* Every level 0 page under the changed page gets its finest resident level again. */
+        const uint32_t size = 1u << page.m_level;
+
+        for (uint32_t y = page.m_y * size; y < (page.m_y + 1) * size; ++y)
+        {
+            for (uint32_t x = page.m_x * size; x < (page.m_x + 1) * size; ++x)
+            {
+                uint8_t finest_level = uint8_t(m_paged_levels);
+
+                for (uint32_t level = 0; level < m_paged_levels; ++level)
+                {
+                    if (m_pages[GetPageIndex(level, x >> level, y >> level)].m_is_resident)
+                    {
+                        finest_level = uint8_t(level);
+                        break;
+                    }
+                }
+
+                m_page_table[size_t(y) * m_pages_x + x] = finest_level;
+            }
+        }
+
+        m_is_page_table_dirty = true;
+    }
+
+    void VirtualTexture::Release()
+    {
+        for (auto& fence : m_readback_fences)
+        {
+            if (fence)
+            {
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+
+        if (m_readback_data)
+        {
+            glUnmapNamedBuffer(m_readback_buffer_name);
+            m_readback_data = nullptr;
+        }
+
+        GpuMemory::UntrackBuffer(m_feedback_buffer_name);
+        GpuMemory::UntrackBuffer(m_readback_buffer_name);
+        glDeleteBuffers(1, &m_feedback_buffer_name);
+        glDeleteBuffers(1, &m_readback_buffer_name);
+
+        /* Deleting the sparse texture releases its committed pages too. */
+        GpuMemory::UntrackTexture(m_page_table_name);
+        glDeleteTextures(1, &m_texture_name);
+        glDeleteTextures(1, &m_page_table_name);
+        GLState::OnTextureDeleted(m_texture_name);
+        GLState::OnTextureDeleted(m_page_table_name);
+
+        m_feedback_buffer_name = m_readback_buffer_name = 0;
+        m_texture_name         = m_page_table_name      = 0;
+
+        m_pages.clear();
+        m_level_page_offsets.clear();
+        m_level_data_offsets.clear();
+        m_page_table.clear();
+        m_memory_pages.clear();
+        m_file.Close();
+
+        m_pages_data           = nullptr;
+        m_paged_levels         = 0;
+        m_resident_pages_count = 0;
+        m_readback_slot        = 0;
+    }
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "mapped_file.h"
+
+namespace RGL
+{
+    /*
+     * Virtual texture on ARB_sparse_texture, for textures that don't fit the VRAM (e.g. 32k x 32k terrain splat maps).
+     * Only the pages the camera sees are committed and uploaded, at most GetMaxResidentPages() of them:
+     *   - the shaders sample with vtSample() (shaders/virtual_texture.glh), which records the page it needs
+     *     in a feedback buffer and clamps the LOD to the resident levels with the page table,
+     *   - Update() reads the feedback a few frames later, loads the missing pages coarse to fine and evicts
+     *     the pages that weren't requested for the longest time.
+     *
+     * The pages come from a .vtex page file (texture_baker --virtual), read through a memory mapping, so the texture
+     * data is never in the memory as a whole. Other images are paged in the memory - the same layout, built at load.
+     * The levels smaller than a page are the mip tail, resident all the time. RGBA8, power of two sizes only.
+     */
+    class VirtualTexture final
+    {
+    public:
+        /* Pages stay resident for at least that many frames after they were last sampled. */
+        static constexpr uint32_t REQUEST_FRAMES  = 8;
+        static constexpr uint32_t FEEDBACK_FRAMES = 3;
+        static constexpr uint32_t PAGE_SIZE       = 128;
+
+        VirtualTexture();
+        ~VirtualTexture();
+
+        VirtualTexture           (const VirtualTexture&) = delete;
+        VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+        static bool IsSupported() { return GLAD_GL_ARB_sparse_texture; }
+
+        /* Loads the .vtex file next to the image instead if there's one. */
+        bool Load(const std::filesystem::path& filepath, bool is_srgb = false, uint32_t max_resident_pages = 1024);
+
+        /* Writes the image as a .vtex page file, no GL context is needed. */
+        static bool Bake(const std::filesystem::path& image_filepath, const std::filesystem::path& output_filepath, bool is_srgb, uint32_t page_size = PAGE_SIZE);
+
+        /* Once per frame, before the rendering. Uploads at most max_uploads pages. */
+        void Update(uint32_t max_uploads = 16);
+
+        /* Binds the texture, the page table and the feedback buffer for vtSample(). */
+        void Bind() const;
+
+        void SetWraping(GLenum coord, GLenum param);
+
+        uint32_t GetResidentPagesCount() const { return m_resident_pages_count; }
+        uint32_t GetMaxResidentPages()   const { return m_max_resident_pages; }
+        uint32_t GetPagesCount()         const { return uint32_t(m_pages.size()); }
+        uint32_t GetWidth()              const { return m_width; }
+        uint32_t GetHeight()             const { return m_height; }
+
+    private:
+        struct Page
+        {
+            uint32_t m_last_request;
+            uint16_t m_x;
+            uint16_t m_y;
+            uint8_t  m_level;
+            bool     m_is_resident;
+        };
+
+        using PageWriter = std::function<bool(const uint8_t* data, size_t size)>;
+
+        /* Writes the mip chain of the RGBA8 image in the page order: level by level, page by page, row by row within a page. */
+        static bool WritePages(const unsigned char* data, uint32_t width, uint32_t height, uint32_t page_size, bool is_srgb, const PageWriter& writer);
+
+        bool Create(const uint8_t* pages_data, size_t pages_size, uint32_t width, uint32_t height, uint32_t page_size, bool is_srgb);
+        void Release();
+
+        uint32_t GetPageIndex  (uint32_t level, uint32_t x, uint32_t y) const { return m_level_page_offsets[level] + y * (m_pages_x >> level) + x; }
+        uint32_t GetTileWidth  (uint32_t level) const { return std::min(m_page_size, std::max(m_width  >> level, 1u)); }
+        uint32_t GetTileHeight (uint32_t level) const { return std::min(m_page_size, std::max(m_height >> level, 1u)); }
+        size_t   GetTileOffset (uint32_t level, uint32_t x, uint32_t y) const;
+
+        void ReadFeedback(uint32_t slot);
+        void MakeResident(Page& page, bool is_resident);
+        bool EvictPage();
+        void UpdatePageTable(const Page& page);
+
+        MappedFile           m_file;
+        std::vector<uint8_t> m_memory_pages;
+        const uint8_t*       m_pages_data;
+
+        std::vector<Page>     m_pages;
+        std::vector<uint32_t> m_level_page_offsets;
+        std::vector<size_t>   m_level_data_offsets;
+        std::vector<uint8_t>  m_page_table;
+
+        GLuint    m_texture_name;
+        GLuint    m_page_table_name;
+        GLuint    m_feedback_buffer_name;
+        GLuint    m_readback_buffer_name;
+        uint32_t* m_readback_data;
+        GLsync    m_readback_fences[FEEDBACK_FRAMES];
+        uint32_t  m_readback_slot;
+
+        uint32_t  m_width;
+        uint32_t  m_height;
+        uint32_t  m_levels_count;
+        uint32_t  m_paged_levels;
+        uint32_t  m_page_size;
+        uint32_t  m_pages_x;
+        uint32_t  m_pages_y;
+        uint32_t  m_frame;
+        uint32_t  m_resident_pages_count;
+        uint32_t  m_max_resident_pages;
+        bool      m_is_page_table_dirty;
+    };
+}
@@ -2,8 +2,11 @@
 #include "core_app.h"
 #include "debug_output_gl.h"
 #include "input.h"
+#include "timer.h"
 #include "gui/gui.h"
 
+#include <algorithm>
+
 namespace RGL
 {
     GLFWwindow * Window::m_window          = nullptr;
@@ -13,12 +16,22 @@ namespace RGL
     glm::ivec2   Window::m_window_size     = glm::ivec2(0);
     glm::ivec2   Window::m_viewport_size   = glm::ivec2(0);
 
+    VSyncMode             Window::m_vsync_mode           = VSyncMode::Off;
+    uint32_t              Window::m_max_frames_in_flight = 0;
+    std::deque<GLsync>    Window::m_frame_fences;
+    Window::PresentStats  Window::m_present_stats        = {};
+    float                 Window::m_present_intervals[PRESENT_STATS_FRAMES] = {};
+    uint32_t              Window::m_present_count        = 0;
+    double                Window::m_last_present_time    = 0.0;
+
     Window::Window()
     {
     }
 
     Window::~Window()
     {
+        setMaxFramesInFlight(0);
+
         glfwDestroyWindow(m_window);
         glfwTerminate();
     }
@@ -71,13 +84,8 @@ namespace RGL
 
         if (flags & GL_CONTEXT_FLAG_DEBUG_BIT)
         {
-            /* Create OpenGL debug context */
-            glEnable(GL_DEBUG_OUTPUT);
-            glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-
-            /* Register callback */
-            glDebugMessageCallback(DebugOutputGL::GLerrorCallback, nullptr /*userParam*/);
-            glDebugMessageControl(GL_DONT_CARE /*source*/, GL_DONT_CARE /*type*/, GL_DEBUG_SEVERITY_MEDIUM /*severity*/, 0 /*count*/, nullptr /*ids*/, GL_TRUE /*enabled*/);
+            /* Enable OpenGL debug output and register callback */
+            DebugOutputGL::Enable();
         }
         #endif
 
@@ -104,9 +112,82 @@ namespace RGL
     }
 
     void Window::endFrame()
+    {
+        pollEvents();
+        swapBuffers();
+    }
+
+    void Window::pollEvents()
     {
         glfwPollEvents();
+    }
+
+    void Window::swapBuffers()
+    {
         glfwSwapBuffers(m_window);
+
+        limitFramesInFlight();
+        updatePresentStats();
+    }
+
+    void Window::makeContextCurrent(bool is_current)
+    {
+        glfwMakeContextCurrent(is_current ? m_window : nullptr);
+    }
+
+    void Window::limitFramesInFlight()
+    {
+        if (m_max_frames_in_flight == 0)
+        {
+            m_present_stats.m_latency_wait_ms = 0.0f;
+            return;
+        }
+
+        const double start_time = Timer::getTime();
+
+        /* After the swap, so the fence also covers the work the driver does for the present. */
+        m_frame_fences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+
+        while (m_frame_fences.size() > m_max_frames_in_flight - 1)
+        {
+            GLsync fence = m_frame_fences.front();
+            m_frame_fences.pop_front();
+
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(-1));
+            glDeleteSync(fence);
+        }
+
+        m_present_stats.m_latency_wait_ms = float((Timer::getTime() - start_time) * 1000.0);
+    }
+
+    void Window::updatePresentStats()
+    {
+        const double time = Timer::getTime();
+
+        if (m_last_present_time > 0.0)
+        {
+            m_present_stats.m_last_ms = float((time - m_last_present_time) * 1000.0);
+
+            m_present_intervals[m_present_count % PRESENT_STATS_FRAMES] = m_present_stats.m_last_ms;
+            m_present_count++;
+
+            const uint32_t count = std::min(m_present_count, PRESENT_STATS_FRAMES);
+
+            float sum = 0.0f;
+            m_present_stats.m_min_ms = m_present_intervals[0];
+            m_present_stats.m_max_ms = m_present_intervals[0];
+
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                sum += m_present_intervals[i];
+                m_present_stats.m_min_ms = std::min(m_present_stats.m_min_ms, m_present_intervals[i]);
+                m_present_stats.m_max_ms = std::max(m_present_stats.m_max_ms, m_present_intervals[i]);
+            }
+
+            m_present_stats.m_average_ms = sum / float(count);
+        }
+
+        m_last_present_time = time;
     }
 
     int Window::isCloseRequested()
@@ -151,9 +232,42 @@ namespace RGL
 
     void Window::setVSync(bool enabled)
     {
-        auto value = enabled ? true : false;
+        setVSyncMode(enabled ? VSyncMode::On : VSyncMode::Off);
+    }
+
+    void Window::setVSyncMode(VSyncMode mode)
+    {
+        if (mode == VSyncMode::Adaptive && !glfwExtensionSupported("WGL_EXT_swap_control_tear") && !glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+        {
+            fprintf(stderr, "Window: adaptive VSync is not supported, using VSync.\n");
+            mode = VSyncMode::On;
+        }
+
+        m_vsync_mode = mode;
 
-        glfwSwapInterval(value);
+        switch (mode)
+        {
+            case VSyncMode::Off:      glfwSwapInterval(0);  break;
+            case VSyncMode::On:       glfwSwapInterval(1);  break;
+            case VSyncMode::Adaptive: glfwSwapInterval(-1); break;
+        }
+
+        /* The intervals of the previous mode would skew the stats. */
+        m_present_count     = 0;
+        m_last_present_time = 0.0;
+    }
+
+    void Window::setMaxFramesInFlight(uint32_t max_frames)
+    {
+        m_max_frames_in_flight = std::min(max_frames, MAX_FRAMES_IN_FLIGHT);
+
+        /* The old fences are of no use to a different limit. */
+        for (GLsync fence : m_frame_fences)
+        {
+            glDeleteSync(fence);
+        }
+
+        m_frame_fences.clear();
     }
 
     void Window::bindDefaultFramebuffer()
@@ -177,7 +291,12 @@ namespace RGL
     {
         m_viewport_size = { width, height };
 
-        glViewport(0, 0, m_viewport_size.x, m_viewport_size.y);
+        /* The events are polled on the main thread, the context may be the render thread's. */
+        if (glfwGetCurrentContext() == m_window)
+        {
+            glViewport(0, 0, m_viewport_size.x, m_viewport_size.y);
+        }
+
         setViewportMatrix(m_viewport_size.x, m_viewport_size.y);
 
         m_window_size.x = width;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+#include <deque>
 #include <iostream>
 #include <string>
 
@@ -10,15 +12,42 @@
 
 namespace RGL
 {
+    /* Adaptive - waits for the vertical blank unless the frame is late, then it tears instead of waiting for the next one. */
+    enum class VSyncMode { Off, On, Adaptive };
+
     class Window final
     {
     public:
+        /* Present-to-present intervals, over the last PRESENT_STATS_FRAMES frames. */
+        struct PresentStats
+        {
+            float m_last_ms;
+            float m_average_ms;
+            float m_min_ms;
+            float m_max_ms;
+            float m_latency_wait_ms; /* Of the last frame, spent waiting for the frames in flight limit. */
+        };
+
+        static constexpr uint32_t PRESENT_STATS_FRAMES = 120;
+        static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+
         Window();
         ~Window();
 
         static void createWindow(unsigned int width, unsigned int height, const std::string & title);
+
+        /* pollEvents() and swapBuffers(). */
         static void endFrame();
 
+        /* The main thread only. */
+        static void pollEvents();
+
+        /* The thread with the GL context. Waits for the frames in flight limit and updates the present stats. */
+        static void swapBuffers();
+
+        /* Makes the window's GL context current on the calling thread, or releases it from the thread. */
+        static void makeContextCurrent(bool is_current);
+
         static int isCloseRequested();
 
         static int       getWidth();
@@ -33,6 +62,20 @@ namespace RGL
         static void setVSync(bool enabled);
         static void bindDefaultFramebuffer();
 
+        /* VSyncMode::Adaptive falls back to On without the swap_control_tear extension. */
+        static void      setVSyncMode(VSyncMode mode);
+        static VSyncMode getVSyncMode() { return m_vsync_mode; }
+
+        /*
+         * Limits the frames queued ahead of the GPU - endFrame() waits for the fence of the frame max_frames - 1 before
+         * the presented one, so 1 waits for the frame itself. Lower values cut the input latency at the cost of the
+         * CPU and GPU overlap. 0 (the default) leaves the queue to the driver.
+         */
+        static void     setMaxFramesInFlight(uint32_t max_frames);
+        static uint32_t getMaxFramesInFlight() { return m_max_frames_in_flight; }
+
+        static const PresentStats& getPresentStats() { return m_present_stats; }
+
     private:
         static GLFWwindow * m_window;
         static std::string  m_title;
@@ -41,7 +84,17 @@ namespace RGL
         static glm::ivec2   m_window_size;
         static glm::ivec2   m_viewport_size;
 
+        static VSyncMode          m_vsync_mode;
+        static uint32_t           m_max_frames_in_flight;
+        static std::deque<GLsync> m_frame_fences;
+        static PresentStats       m_present_stats;
+        static float              m_present_intervals[PRESENT_STATS_FRAMES];
+        static uint32_t           m_present_count;
+        static double             m_last_present_time;
+
         static void setViewportMatrix(int width, int height);
+        static void limitFramesInFlight();
+        static void updatePresentStats();
 
         static void error_callback(int error, const char* description)
         {
@@ -5,7 +5,9 @@
 #include "gui/gui.h"
 
 Simple3d::Simple3d()
-    : m_mix_factor(1.0f)
+    : m_mix_factor  (1.0f),
+      m_is_wireframe(false),
+      m_render_packets()
 {
 }
 
@@ -24,6 +26,7 @@ void Simple3d::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(1.5, 0.0, 10.0);
 
     /* Create models. */
@@ -89,18 +92,8 @@ void Simple3d::input()
     /* Toggle between wireframe and solid rendering */
     if (RGL::Input::getKeyUp(RGL::KeyCode::F2))
     {
-        static bool toggle_wireframe = false;
-
-        toggle_wireframe = !toggle_wireframe;
-
-        if (toggle_wireframe)
-        {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        }
-        else
-        {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        }
+        /* Set by render(), input() makes no GL calls in the render thread mode. */
+        m_is_wireframe = !m_is_wireframe;
     }
 
     /* It's also possible to take a screenshot. */
@@ -126,20 +119,27 @@ void Simple3d::update(double delta_time)
     m_camera->update(delta_time);
 }
 
+void Simple3d::extract_render_packet(uint32_t slot)
+{
+    /* The objects' matrices and colors don't change after init_app(), render() can read them directly. */
+    m_render_packets[slot] = { m_camera->viewProjection(), m_mix_factor, m_is_wireframe };
+}
+
 void Simple3d::render()
 {
     /* Put render specific code here. Don't update variables here! */
+    const RenderPacket& packet = m_render_packets[get_render_packet_slot()];
+
+    glPolygonMode(GL_FRONT_AND_BACK, packet.m_is_wireframe ? GL_LINE : GL_FILL);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     m_simple_texturing_shader->bind();
-    m_simple_texturing_shader->setUniform("mix_factor", m_mix_factor);
+    m_simple_texturing_shader->setUniform("mix_factor", packet.m_mix_factor);
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
-    
     for (unsigned i = 0; i < m_objects.size(); ++i)
     {
         m_simple_texturing_shader->setUniform("color", m_objects_colors[i]);
-        m_simple_texturing_shader->setUniform("mvp", view_projection * m_objects_model_matrices[i]);
+        m_simple_texturing_shader->setUniform("mvp", packet.m_view_projection * m_objects_model_matrices[i]);
         m_objects[i].Render();
     }
 }
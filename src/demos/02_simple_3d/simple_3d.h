@@ -20,7 +20,19 @@ public:
     void render()                  override;
     void render_gui()               override;
 
+protected:
+    bool has_render_packets() const           override { return true; }
+    void extract_render_packet(uint32_t slot) override;
+
 private:
+    /* Everything render() reads, so it can run on the render thread (--render-thread). */
+    struct RenderPacket
+    {
+        glm::mat4 m_view_projection;
+        float     m_mix_factor;
+        bool      m_is_wireframe;
+    };
+
     std::shared_ptr<RGL::Camera> m_camera;
     std::shared_ptr<RGL::Shader> m_simple_texturing_shader;
 
@@ -29,4 +41,7 @@ private:
     std::vector<glm::vec3> m_objects_colors;
 
     float m_mix_factor;
+    bool  m_is_wireframe;
+
+    RenderPacket m_render_packets[RENDER_PACKETS_COUNT];
 };
\ No newline at end of file
@@ -0,0 +1,12 @@
+#version 460 core
+#define SINGLE_PASS_LIGHTING
+#include "lighting.glh"
+
+uniform float ambient_factor;
+
+void main()
+{
+    vec4 ambient = reinhard(texture(texture_diffuse1, texcoord) * vec4(vec3(ambient_factor), 1.0));
+
+    frag_color = ambient + calcLights(normalize(normal), world_pos);
+}
@@ -1,6 +1,7 @@
 #include "lighting.h"
 #include "filesystem.h"
 #include "input.h"
+#include "profiler.h"
 #include "util.h"
 #include "gui/gui.h"
 
@@ -12,12 +13,15 @@ Lighting::Lighting()
       m_ambient_factor    (0.18f),
       m_gamma             (0.8),
       m_dir_light_angles  (0.0f, 0.0f),
-      m_spot_light_angles (0.0f, 0.0f)
+      m_spot_light_angles (0.0f, 0.0f),
+      m_lights_ssbo_id    (0),
+      m_is_single_pass    (true)
 {
 }
 
 Lighting::~Lighting()
 {
+    glDeleteBuffers(1, &m_lights_ssbo_id);
 }
 
 void Lighting::init_app()
@@ -31,6 +35,7 @@ void Lighting::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(1.5, 0.0, 10.0);
 
     /* Initialize lights' properties */
@@ -110,6 +115,13 @@ void Lighting::init_app()
 
     m_spot_light_shader = std::make_shared<RGL::Shader>(dir + "lighting.vert", dir + "lighting-spot.frag");
     m_spot_light_shader->link();
+
+    m_single_pass_shader = std::make_shared<RGL::Shader>(dir + "lighting.vert", dir + "lighting-single-pass.frag");
+    m_single_pass_shader->link();
+
+    /* A directional, a point and a spot light. */
+    glCreateBuffers     (1, &m_lights_ssbo_id);
+    glNamedBufferStorage(m_lights_ssbo_id, 3 * sizeof(GpuLight), nullptr, GL_DYNAMIC_STORAGE_BIT);
 }
 
 void Lighting::input()
@@ -165,12 +177,20 @@ void Lighting::render()
     /* Put render specific code here. Don't update variables here! */
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    RGL::ProfilerScope scope("Lighting");
+
+    auto view_projection = m_camera->viewProjection();
+
+    if (m_is_single_pass)
+    {
+        render_single_pass(view_projection);
+        return;
+    }
+
     m_ambient_light_shader->bind();
     m_ambient_light_shader->setUniform("ambient_factor", m_ambient_factor);
     m_ambient_light_shader->setUniform("gamma",          m_gamma);
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
-
     /* First, render the ambient color only for the opaque objects. */
     for (unsigned i = 0; i < m_objects.size(); ++i)
     {
@@ -268,6 +288,57 @@ void Lighting::render()
     glDisable(GL_BLEND);
 }
 
+void Lighting::upload_lights()
+{
+    GpuLight lights[3];
+
+    lights[0].color_intensity  = glm::vec4(m_dir_light_properties.color, m_dir_light_properties.intensity);
+    lights[0].position_range   = glm::vec4(0.0f);
+    lights[0].direction_cutoff = glm::vec4(m_dir_light_properties.direction, 0.0f);
+    lights[0].attenuation_type = glm::vec4(1.0f, 0.0f, 0.0f, GpuLight::DIRECTIONAL);
+    lights[0].specular         = glm::vec4(m_specular_power.x, m_specular_intenstiy.x, 0.0f, 0.0f);
+
+    const PointLight& point = m_point_light_properties;
+
+    lights[1].color_intensity  = glm::vec4(point.color, point.intensity);
+    lights[1].position_range   = glm::vec4(point.position, point.range);
+    lights[1].direction_cutoff = glm::vec4(0.0f);
+    lights[1].attenuation_type = glm::vec4(point.attenuation.constant, point.attenuation.linear, point.attenuation.quadratic, GpuLight::POINT);
+    lights[1].specular         = glm::vec4(m_specular_power.y, m_specular_intenstiy.y, 0.0f, 0.0f);
+
+    const SpotLight& spot = m_spot_light_properties;
+
+    lights[2].color_intensity  = glm::vec4(spot.color, spot.intensity);
+    lights[2].position_range   = glm::vec4(spot.position, spot.range);
+    lights[2].direction_cutoff = glm::vec4(spot.direction, glm::radians(90.0f - spot.cutoff));
+    lights[2].attenuation_type = glm::vec4(spot.attenuation.constant, spot.attenuation.linear, spot.attenuation.quadratic, GpuLight::SPOT);
+    lights[2].specular         = glm::vec4(m_specular_power.z, m_specular_intenstiy.z, 0.0f, 0.0f);
+
+    glNamedBufferSubData(m_lights_ssbo_id, 0, sizeof(lights), lights);
+}
+
+void Lighting::render_single_pass(const glm::mat4& view_projection)
+{
+    upload_lights();
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_lights_ssbo_id);
+
+    m_single_pass_shader->bind();
+    m_single_pass_shader->setUniform("lights_count",   3u);
+    m_single_pass_shader->setUniform("ambient_factor", m_ambient_factor);
+    m_single_pass_shader->setUniform("cam_pos",        m_camera->position());
+    m_single_pass_shader->setUniform("gamma",          m_gamma);
+
+    for (unsigned i = 0; i < m_objects.size(); ++i)
+    {
+        m_single_pass_shader->setUniform("model", m_objects_model_matrices[i]);
+        m_single_pass_shader->setUniform("normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_objects_model_matrices[i]))));
+        m_single_pass_shader->setUniform("mvp", view_projection * m_objects_model_matrices[i]);
+
+        m_objects[i].Render();
+    }
+}
+
 void Lighting::render_gui()
 {
     /* This method is responsible for rendering GUI using ImGUI. */
@@ -303,6 +374,18 @@ void Lighting::render_gui()
         ImGui::SliderFloat("Ambient color", &m_ambient_factor, 0.0, 1.0,  "%.2f");
         ImGui::SliderFloat("Gamma",         &m_gamma,          0.0, 10.0, "%.1f");
 
+        ImGui::Checkbox("Single pass lighting", &m_is_single_pass);
+
+        for (uint32_t index : RGL::Profiler::GetResolvedScopes())
+        {
+            const auto& scope = RGL::Profiler::GetScope(index);
+
+            if (scope.m_name == "Lighting")
+            {
+                ImGui::Text("Lighting (%s): %.3f ms", m_is_single_pass ? "single pass" : "multipass", scope.m_gpu_ms);
+            }
+        }
+
         ImGui::Spacing();
 
         ImGuiTabBarFlags tab_bar_flags = ImGuiTabBarFlags_None;
@@ -63,6 +63,18 @@ struct SpotLight : PointLight
     }
 };
 
+/* A light of the single pass, std430, in sync with GpuLight in lighting.glh. */
+struct GpuLight
+{
+    enum Type { DIRECTIONAL = 0, POINT = 1, SPOT = 2 };
+
+    glm::vec4 color_intensity;
+    glm::vec4 position_range;
+    glm::vec4 direction_cutoff;
+    glm::vec4 attenuation_type;  /* xyz - constant, linear and quadratic attenuation, w - Type */
+    glm::vec4 specular;          /* x - power, y - intensity */
+};
+
 class Lighting : public RGL::CoreApp
 {
 public:
@@ -76,11 +88,16 @@ public:
     void render_gui()               override;
 
 private:
+    /* All the lights of the SSBO in one pass per object, instead of a pass per light type. */
+    void render_single_pass(const glm::mat4& view_projection);
+    void upload_lights();
+
     std::shared_ptr<RGL::Camera> m_camera;
     std::shared_ptr<RGL::Shader> m_ambient_light_shader;
     std::shared_ptr<RGL::Shader> m_directional_light_shader;
     std::shared_ptr<RGL::Shader> m_point_light_shader;
     std::shared_ptr<RGL::Shader> m_spot_light_shader;
+    std::shared_ptr<RGL::Shader> m_single_pass_shader;
 
     std::vector<RGL::StaticModel> m_objects;
     std::vector<glm::mat4> m_objects_model_matrices;
@@ -96,4 +113,7 @@ private:
 
     float m_ambient_factor;
     float m_gamma;
+
+    GLuint m_lights_ssbo_id;
+    bool   m_is_single_pass;
 };
\ No newline at end of file
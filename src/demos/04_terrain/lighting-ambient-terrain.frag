@@ -5,5 +5,5 @@ uniform float ambient_factor;
 
 void main()
 {
-    frag_color = reinhard(blendedTerrainColor(normalize(normal)) * vec4(vec3(ambient_factor), 1.0));
+    frag_color = reinhard(blendedTerrainColor() * vec4(vec3(ambient_factor), 1.0));
 } 
\ No newline at end of file
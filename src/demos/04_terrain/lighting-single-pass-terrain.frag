@@ -0,0 +1,12 @@
+#version 460 core
+#define SINGLE_PASS_LIGHTING
+#include "lighting-terrain.glh"
+
+uniform float ambient_factor;
+
+void main()
+{
+    vec4 ambient = reinhard(blendedTerrainColor() * vec4(vec3(ambient_factor), 1.0));
+
+    frag_color = ambient + calcLights(terrainNormal(), world_pos);
+}
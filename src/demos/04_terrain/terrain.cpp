@@ -1,6 +1,7 @@
 #include "terrain.hpp"
 #include "filesystem.h"
 #include "input.h"
+#include "profiler.h"
 #include "util.h"
 #include "gui/gui.h"
 
@@ -16,12 +17,19 @@ Terrain::Terrain()
       m_texcoord_tiling_factor(40.0f),
       m_grass_slope_threshold (0.2f),
       m_slope_rock_threshold  (0.7),
-      m_gamma                 (1.6)
+      m_terrain_shadows       (true),
+      m_shadow_rebake_angle   (2.0f),
+      m_gamma                 (1.6),
+      m_use_virtual_blend_map (false),
+      m_use_cdlod             (true),
+      m_lights_ssbo_id        (0),
+      m_is_single_pass        (true)
 {
 }
 
 Terrain::~Terrain()
 {
+    glDeleteBuffers(1, &m_lights_ssbo_id);
 }
 
 void Terrain::init_app()
@@ -35,12 +43,11 @@ void Terrain::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 1000.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(1.5, 0.0, 10.0);
 
     /* Create terrain */
-    m_terrain_model        = std::make_shared<TerrainModel>("textures/heightmap.png", m_terrain_size, m_terrain_max_height);
-    m_terrain_position     = glm::vec3(m_terrain_size / 2.0, 0.0, m_terrain_size / 2.0);
-    m_terrain_model_matrix = glm::translate(glm::mat4(1.0), m_terrain_position);
+    create_terrain("textures/heightmap.png");
 
     /* Initialize lights' properties */
     m_dir_light_properties.color     = glm::vec3(1.0f);
@@ -121,6 +128,21 @@ void Terrain::init_app()
         m_terrain_textures.push_back(texture);
     }
 
+    /* The big splat maps only need the visible pages in the memory, blendmap.vtex (texture_baker --virtual) is used if present. */
+    if (RGL::VirtualTexture::IsSupported())
+    {
+        m_virtual_blend_map = std::make_shared<RGL::VirtualTexture>();
+
+        if (m_virtual_blend_map->Load(RGL::FileSystem::getResourcesPath() / "textures/blendmap.png", false, 256 /* max resident pages */))
+        {
+            m_use_virtual_blend_map = true;
+        }
+        else
+        {
+            m_virtual_blend_map.reset();
+        }
+    }
+
     /* Create the shaders... */
     std::string dir = "src/demos/03_lighting/";
     m_ambient_light_shader = std::make_shared<RGL::Shader>(dir + "lighting.vert", dir + "lighting-ambient.frag");
@@ -135,19 +157,73 @@ void Terrain::init_app()
     m_spot_light_shader = std::make_shared<RGL::Shader>(dir + "lighting.vert", dir + "lighting-spot.frag");
     m_spot_light_shader->link();
 
+    m_single_pass_shader = std::make_shared<RGL::Shader>(dir + "lighting.vert", dir + "lighting-single-pass.frag");
+    m_single_pass_shader->link();
+
+    /* A directional, a point and a spot light. */
+    glCreateBuffers     (1, &m_lights_ssbo_id);
+    glNamedBufferStorage(m_lights_ssbo_id, 3 * sizeof(GpuLight), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
     /* ... and the terrain specific shaders */
+    create_terrain_shaders();
+}
+
+void Terrain::create_terrain(const std::string& heightmap_filename)
+{
+    m_terrain_model        = std::make_shared<TerrainModel>(heightmap_filename, m_terrain_size, m_terrain_max_height, !m_use_cdlod /* generate mesh */);
+    m_terrain_position     = glm::vec3(m_terrain_size / 2.0, 0.0, m_terrain_size / 2.0);
+    m_terrain_model_matrix = glm::translate(glm::mat4(1.0), m_terrain_position);
+    m_terrain_maps         = std::make_shared<TerrainMaps>(*m_terrain_model);
+
+    m_terrain_quadtree.reset();
+    m_terrain_tiles.reset();
+
+    if (m_use_cdlod)
+    {
+        auto tiles_filepath = (RGL::FileSystem::getResourcesPath() / heightmap_filename).replace_extension(".ttiles");
+        auto tiles          = std::make_shared<TerrainTiles>();
+
+        if (TerrainTiles::bake(*m_terrain_model, tiles_filepath) && tiles->load(tiles_filepath))
+        {
+            m_terrain_tiles    = tiles;
+            m_terrain_quadtree = std::make_shared<TerrainQuadtree>();
+        }
+    }
+}
+
+void Terrain::create_terrain_shaders()
+{
+    /* The same fragment shaders for both, terrain_cdlod.vert has lighting.vert's uniforms and outputs. */
+    std::string dir         = "src/demos/03_lighting/";
     std::string dir_terrain = "src/demos/04_terrain/";
-    m_terrain_ambient_light_shader = std::make_shared<RGL::Shader>(dir + "lighting.vert", dir_terrain + "lighting-ambient-terrain.frag");
+    std::string vert        = m_use_cdlod ? dir_terrain + "terrain_cdlod.vert" : dir + "lighting.vert";
+
+    m_terrain_ambient_light_shader = std::make_shared<RGL::Shader>(vert, dir_terrain + "lighting-ambient-terrain.frag");
     m_terrain_ambient_light_shader->link();
 
-    m_terrain_directional_light_shader = std::make_shared<RGL::Shader>(dir + "lighting.vert", dir_terrain + "lighting-directional-terrain.frag");
+    m_terrain_directional_light_shader = std::make_shared<RGL::Shader>(vert, dir_terrain + "lighting-directional-terrain.frag");
     m_terrain_directional_light_shader->link();
 
-    m_terrain_point_light_shader = std::make_shared<RGL::Shader>(dir + "lighting.vert", dir_terrain + "lighting-point-terrain.frag");
+    m_terrain_point_light_shader = std::make_shared<RGL::Shader>(vert, dir_terrain + "lighting-point-terrain.frag");
     m_terrain_point_light_shader->link();
 
-    m_terrain_spot_light_shader = std::make_shared<RGL::Shader>(dir + "lighting.vert", dir_terrain + "lighting-spot-terrain.frag");
+    m_terrain_spot_light_shader = std::make_shared<RGL::Shader>(vert, dir_terrain + "lighting-spot-terrain.frag");
     m_terrain_spot_light_shader->link();
+
+    m_terrain_single_pass_shader = std::make_shared<RGL::Shader>(vert, dir_terrain + "lighting-single-pass-terrain.frag");
+    m_terrain_single_pass_shader->link();
+}
+
+void Terrain::draw_terrain(RGL::Shader& shader)
+{
+    if (m_terrain_quadtree)
+    {
+        m_terrain_quadtree->render(shader, *m_terrain_tiles);
+    }
+    else
+    {
+        m_terrain_model->Render();
+    }
 }
 
 void Terrain::input()
@@ -215,13 +291,46 @@ void Terrain::render()
     /* Put render specific code here. Don't update variables here! */
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    /* Pages requested by the previous frames. */
+    if (m_virtual_blend_map)
+    {
+        m_virtual_blend_map->Update();
+        m_virtual_blend_map->Bind();
+    }
+
+    auto view_projection = m_camera->viewProjection();
+
+    /* The tiles around the camera and the nodes of all the terrain's passes, in its local space. */
+    if (m_terrain_quadtree)
+    {
+        auto local_camera_position = glm::vec3(glm::inverse(m_terrain_model_matrix) * glm::vec4(m_camera->position(), 1.0f));
+
+        m_terrain_tiles->update(local_camera_position);
+        m_terrain_quadtree->select(*m_terrain_tiles, local_camera_position, view_projection * m_terrain_model_matrix);
+    }
+
+    /* The maps are baked again if the thresholds changed. */
+    m_terrain_maps->update(m_grass_slope_threshold, m_slope_rock_threshold);
+
+    /* The horizon is baked again only if the light turned far enough. */
+    if (m_terrain_shadows)
+    {
+        m_terrain_maps->updateShadows(m_dir_light_properties.direction, m_shadow_rebake_angle);
+    }
+
+    RGL::ProfilerScope scope("Lighting");
+
+    if (m_is_single_pass)
+    {
+        render_single_pass(view_projection);
+        return;
+    }
+
     /* Render normal objects first */
     m_ambient_light_shader->bind();
     m_ambient_light_shader->setUniform("ambient_factor", m_ambient_factor);
     m_ambient_light_shader->setUniform("gamma",          m_gamma);
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
-
     /* First, render the ambient color only for the opaque objects. */
     for (unsigned i = 0; i < m_objects.size(); ++i)
     {
@@ -232,16 +341,17 @@ void Terrain::render()
     }
 
     /* Now render terrain - ambient only. */
+    m_terrain_maps->bind();
+
     m_terrain_ambient_light_shader->bind();
     m_terrain_ambient_light_shader->setUniform("ambient_factor", m_ambient_factor);
     m_terrain_ambient_light_shader->setUniform("gamma",          m_gamma);
-    m_terrain_ambient_light_shader->setUniform("grass_slope_threshold",  m_grass_slope_threshold);
-    m_terrain_ambient_light_shader->setUniform("slope_rock_threshold",   m_slope_rock_threshold);
     m_terrain_ambient_light_shader->setUniform("texcoord_tiling_factor", m_texcoord_tiling_factor);
+    m_terrain_ambient_light_shader->setUniform("use_virtual_blend_map",  int(m_use_virtual_blend_map));
 
     m_terrain_ambient_light_shader->setUniform("normal_matrix", glm::transpose(glm::inverse(glm::mat3(m_terrain_model_matrix))));
     m_terrain_ambient_light_shader->setUniform("mvp",           view_projection * m_terrain_model_matrix);
-    m_terrain_model->Render();
+    draw_terrain(*m_terrain_ambient_light_shader);
 
     /*
      * Disable writing to the depth buffer and additively
@@ -355,15 +465,15 @@ void Terrain::render_terrain(const glm::mat4& view_projection)
     m_terrain_directional_light_shader->setUniform("specular_power",     m_specular_power.x);
     m_terrain_directional_light_shader->setUniform("gamma",              m_gamma);
 
-    m_terrain_directional_light_shader->setUniform("grass_slope_threshold",  m_grass_slope_threshold);
-    m_terrain_directional_light_shader->setUniform("slope_rock_threshold",   m_slope_rock_threshold);
     m_terrain_directional_light_shader->setUniform("texcoord_tiling_factor", m_texcoord_tiling_factor);
+    m_terrain_directional_light_shader->setUniform("use_virtual_blend_map",  int(m_use_virtual_blend_map));
+    m_terrain_directional_light_shader->setUniform("terrain_shadows",        int(m_terrain_shadows));
 
     m_terrain_directional_light_shader->setUniform("model",         m_terrain_model_matrix);
     m_terrain_directional_light_shader->setUniform("normal_matrix", terrain_normal_matrix);
     m_terrain_directional_light_shader->setUniform("mvp",           mvp);
 
-    m_terrain_model->Render();
+    draw_terrain(*m_terrain_directional_light_shader);
 
     /* Render point lights */
     m_terrain_point_light_shader->bind();
@@ -381,15 +491,14 @@ void Terrain::render_terrain(const glm::mat4& view_projection)
     m_terrain_point_light_shader->setUniform("specular_power",     m_specular_power.y);
     m_terrain_point_light_shader->setUniform("gamma",              m_gamma);
 
-    m_terrain_point_light_shader->setUniform("grass_slope_threshold",  m_grass_slope_threshold);
-    m_terrain_point_light_shader->setUniform("slope_rock_threshold",   m_slope_rock_threshold);
     m_terrain_point_light_shader->setUniform("texcoord_tiling_factor", m_texcoord_tiling_factor);
+    m_terrain_point_light_shader->setUniform("use_virtual_blend_map",  int(m_use_virtual_blend_map));
 
     m_terrain_point_light_shader->setUniform("model",         m_terrain_model_matrix);
     m_terrain_point_light_shader->setUniform("normal_matrix", terrain_normal_matrix);
     m_terrain_point_light_shader->setUniform("mvp",           mvp);
 
-    m_terrain_model->Render();
+    draw_terrain(*m_terrain_point_light_shader);
 
     /* Render spot lights */
     m_terrain_spot_light_shader->bind();
@@ -409,15 +518,87 @@ void Terrain::render_terrain(const glm::mat4& view_projection)
     m_terrain_spot_light_shader->setUniform("specular_power",     m_specular_power.z);
     m_terrain_spot_light_shader->setUniform("gamma",              m_gamma);
 
-    m_terrain_spot_light_shader->setUniform("grass_slope_threshold",  m_grass_slope_threshold);
-    m_terrain_spot_light_shader->setUniform("slope_rock_threshold",   m_slope_rock_threshold);
     m_terrain_spot_light_shader->setUniform("texcoord_tiling_factor", m_texcoord_tiling_factor);
+    m_terrain_spot_light_shader->setUniform("use_virtual_blend_map",  int(m_use_virtual_blend_map));
 
     m_terrain_spot_light_shader->setUniform("model",         m_terrain_model_matrix);
     m_terrain_spot_light_shader->setUniform("normal_matrix", terrain_normal_matrix);
     m_terrain_spot_light_shader->setUniform("mvp",           mvp);
 
-    m_terrain_model->Render();
+    draw_terrain(*m_terrain_spot_light_shader);
+}
+
+void Terrain::upload_lights()
+{
+    GpuLight lights[3];
+
+    lights[0].color_intensity  = glm::vec4(m_dir_light_properties.color, m_dir_light_properties.intensity);
+    lights[0].position_range   = glm::vec4(0.0f);
+    lights[0].direction_cutoff = glm::vec4(m_dir_light_properties.direction, 0.0f);
+    lights[0].attenuation_type = glm::vec4(1.0f, 0.0f, 0.0f, GpuLight::DIRECTIONAL);
+    lights[0].specular         = glm::vec4(m_specular_power.x, m_specular_intenstiy.x, 0.0f, 0.0f);
+
+    const PointLight& point = m_point_light_properties;
+
+    lights[1].color_intensity  = glm::vec4(point.color, point.intensity);
+    lights[1].position_range   = glm::vec4(point.position, point.range);
+    lights[1].direction_cutoff = glm::vec4(0.0f);
+    lights[1].attenuation_type = glm::vec4(point.attenuation.constant, point.attenuation.linear, point.attenuation.quadratic, GpuLight::POINT);
+    lights[1].specular         = glm::vec4(m_specular_power.y, m_specular_intenstiy.y, 0.0f, 0.0f);
+
+    const SpotLight& spot = m_spot_light_properties;
+
+    lights[2].color_intensity  = glm::vec4(spot.color, spot.intensity);
+    lights[2].position_range   = glm::vec4(spot.position, spot.range);
+    lights[2].direction_cutoff = glm::vec4(spot.direction, glm::radians(90.0f - spot.cutoff));
+    lights[2].attenuation_type = glm::vec4(spot.attenuation.constant, spot.attenuation.linear, spot.attenuation.quadratic, GpuLight::SPOT);
+    lights[2].specular         = glm::vec4(m_specular_power.z, m_specular_intenstiy.z, 0.0f, 0.0f);
+
+    glNamedBufferSubData(m_lights_ssbo_id, 0, sizeof(lights), lights);
+}
+
+void Terrain::render_single_pass(const glm::mat4& view_projection)
+{
+    upload_lights();
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_lights_ssbo_id);
+
+    m_single_pass_shader->bind();
+    m_single_pass_shader->setUniform("lights_count",   3u);
+    m_single_pass_shader->setUniform("ambient_factor", m_ambient_factor);
+    m_single_pass_shader->setUniform("cam_pos",        m_camera->position());
+    m_single_pass_shader->setUniform("gamma",          m_gamma);
+
+    for (unsigned i = 0; i < m_objects.size(); ++i)
+    {
+        m_single_pass_shader->setUniform("model",         m_objects_model_matrices[i]);
+        m_single_pass_shader->setUniform("normal_matrix", glm::transpose(glm::inverse(glm::mat3(m_objects_model_matrices[i]))));
+        m_single_pass_shader->setUniform("mvp",           view_projection * m_objects_model_matrices[i]);
+
+        m_objects[i].Render();
+    }
+
+    m_terrain_maps->bind();
+
+    for (uint32_t i = 0; i < m_terrain_textures.size(); ++i)
+    {
+        m_terrain_textures[i]->Bind(i);
+    }
+
+    m_terrain_single_pass_shader->bind();
+    m_terrain_single_pass_shader->setUniform("lights_count",           3u);
+    m_terrain_single_pass_shader->setUniform("ambient_factor",         m_ambient_factor);
+    m_terrain_single_pass_shader->setUniform("cam_pos",                m_camera->position());
+    m_terrain_single_pass_shader->setUniform("gamma",                  m_gamma);
+    m_terrain_single_pass_shader->setUniform("texcoord_tiling_factor", m_texcoord_tiling_factor);
+    m_terrain_single_pass_shader->setUniform("use_virtual_blend_map",  int(m_use_virtual_blend_map));
+    m_terrain_single_pass_shader->setUniform("terrain_shadows",        int(m_terrain_shadows));
+
+    m_terrain_single_pass_shader->setUniform("model",         m_terrain_model_matrix);
+    m_terrain_single_pass_shader->setUniform("normal_matrix", glm::transpose(glm::inverse(glm::mat3(m_terrain_model_matrix))));
+    m_terrain_single_pass_shader->setUniform("mvp",           view_projection * m_terrain_model_matrix);
+
+    draw_terrain(*m_terrain_single_pass_shader);
 }
 
 void Terrain::render_gui()
@@ -460,6 +641,7 @@ void Terrain::render_gui()
                 {
                     static float terrain_size            = m_terrain_size;
                     static std::string current_heightmap = m_terrain_heightmaps_filenames[0];
+                    static bool        use_cdlod         = m_use_cdlod;
 
                     ImGui::TextWrapped("Textures' parameters:");
                     ImGui::Spacing();
@@ -468,6 +650,29 @@ void Terrain::render_gui()
                     ImGui::SliderFloat("Rock/Slope threshold",   &m_slope_rock_threshold,   0.51, 1.0,    "%.2f");
                     ImGui::SliderFloat("Texcoord tiling factor", &m_texcoord_tiling_factor, 1.0,  150.0,  "%.0f");
 
+                    if (m_virtual_blend_map)
+                    {
+                        ImGui::Checkbox("Virtual blend map", &m_use_virtual_blend_map);
+                        ImGui::Text("Resident pages: %u / %u (%u in total)", m_virtual_blend_map->GetResidentPagesCount(), m_virtual_blend_map->GetMaxResidentPages(), m_virtual_blend_map->GetPagesCount());
+                    }
+
+                    if (m_terrain_quadtree)
+                    {
+                        ImGui::Spacing();
+                        ImGui::TextWrapped("CDLOD parameters:");
+                        ImGui::Spacing();
+
+                        ImGui::SliderFloat("LOD distance", &m_terrain_quadtree->m_lod_distance, 5.0,  200.0, "%.0f");
+                        ImGui::SliderFloat("Morph ratio",  &m_terrain_quadtree->m_morph_ratio,  0.05, 0.5,   "%.2f");
+                        ImGui::Text("LODs: %u, selected nodes: %u", m_terrain_quadtree->getLodsCount(), m_terrain_quadtree->getSelectedNodesCount());
+                        ImGui::Text("Triangles: %llu", (unsigned long long)m_terrain_quadtree->getTrianglesCount());
+
+                        ImGui::SliderFloat("Streaming radius", &m_terrain_tiles->m_streaming_radius, 50.0, 2000.0, "%.0f");
+                        ImGui::Text("Tiles: %u / %u resident (%u x %u in total), %u loading", m_terrain_tiles->getResidentTilesCount(), m_terrain_tiles->getMaxResidentTiles(),
+                                    m_terrain_tiles->getTilesCount().x, m_terrain_tiles->getTilesCount().y, m_terrain_tiles->getLoadingTilesCount());
+                        ImGui::Text("Heights texture: %.1f MB", m_terrain_tiles->getTextureBytes() / (1024.0f * 1024.0f));
+                    }
+
                     ImGui::Spacing();
                     ImGui::Separator();
                     ImGui::Spacing();
@@ -495,13 +700,19 @@ void Terrain::render_gui()
 
                     ImGui::SliderFloat("Size",                   &terrain_size,             10.0, 3000.0, "%.0f");
                     ImGui::SliderFloat("Max height",             &m_terrain_max_height,     1.0,  100.0,  "%.0f");
+                    ImGui::Checkbox   ("CDLOD",                  &use_cdlod);
 
                     if (ImGui::Button("Reload terrain"))
                     {
-                        m_terrain_size         = terrain_size;
-                        m_terrain_model        = std::make_shared<TerrainModel>("textures/" + current_heightmap, m_terrain_size, m_terrain_max_height);
-                        m_terrain_position     = glm::vec3(m_terrain_size / 2.0, 0.0, m_terrain_size / 2.0);
-                        m_terrain_model_matrix = glm::translate(glm::mat4(1.0), m_terrain_position);
+                        m_terrain_size = terrain_size;
+
+                        if (use_cdlod != m_use_cdlod)
+                        {
+                            m_use_cdlod = use_cdlod;
+                            create_terrain_shaders();
+                        }
+
+                        create_terrain("textures/" + current_heightmap);
 
                         m_terrain_textures.clear();
 
@@ -544,6 +755,18 @@ void Terrain::render_gui()
                 ImGui::SliderFloat("Gamma",         &m_gamma,          0.0, 10.0, "%.1f");
                 ImGui::PopItemWidth();
 
+                ImGui::Checkbox("Single pass lighting", &m_is_single_pass);
+
+                for (uint32_t index : RGL::Profiler::GetResolvedScopes())
+                {
+                    const auto& scope = RGL::Profiler::GetScope(index);
+
+                    if (scope.m_name == "Lighting")
+                    {
+                        ImGui::Text("Lighting (%s): %.3f ms", m_is_single_pass ? "single pass" : "multipass", scope.m_gpu_ms);
+                    }
+                }
+
                 ImGui::Spacing();
 
                 if (ImGui::BeginTabBar("Lights' properties", ImGuiTabBarFlags_None))
@@ -561,6 +784,10 @@ void Terrain::render_gui()
                             {
                                 m_dir_light_properties.setDirection(m_dir_light_angles.x, m_dir_light_angles.y);
                             }
+
+                            ImGui::Checkbox   ("Terrain shadows",    &m_terrain_shadows);
+                            ImGui::SliderFloat("Shadow rebake angle", &m_shadow_rebake_angle, 0.1, 15.0, "%.1f");
+                            ImGui::Text("Horizon map bakes: %u", m_terrain_maps->getShadowBakesCount());
                         }
                         ImGui::PopItemWidth();
                         ImGui::EndTabItem();
@@ -4,11 +4,14 @@
 #include "camera.h"
 #include "static_model.h"
 #include "shader.h"
+#include "virtual_texture.h"
 
 #include <memory>
 #include <vector>
 
+#include "terrain_maps.hpp"
 #include "terrain_model.hpp"
+#include "terrain_quadtree.hpp"
 
 struct BaseLight
 {
@@ -65,6 +68,18 @@ struct SpotLight : PointLight
     }
 };
 
+/* A light of the single pass, std430, in sync with GpuLight in lighting-terrain.glh and 03_lighting/lighting.glh. */
+struct GpuLight
+{
+    enum Type { DIRECTIONAL = 0, POINT = 1, SPOT = 2 };
+
+    glm::vec4 color_intensity;
+    glm::vec4 position_range;
+    glm::vec4 direction_cutoff;
+    glm::vec4 attenuation_type;  /* xyz - constant, linear and quadratic attenuation, w - Type */
+    glm::vec4 specular;          /* x - power, y - intensity */
+};
+
 class Terrain : public RGL::CoreApp
 {
 public:
@@ -79,14 +94,31 @@ public:
 
 private:
     void render_terrain(const glm::mat4 & view_projection);
+    void create_terrain(const std::string & heightmap_filename);
+    void create_terrain_shaders();
+    void draw_terrain(RGL::Shader & shader);
+
+    /* All the lights of the SSBO in one pass per object and the terrain, instead of a pass per light type. */
+    void render_single_pass(const glm::mat4 & view_projection);
+    void upload_lights();
 
     std::shared_ptr<RGL::Camera> m_camera;
     std::shared_ptr<RGL::Shader> m_ambient_light_shader;
     std::shared_ptr<RGL::Shader> m_directional_light_shader;
     std::shared_ptr<RGL::Shader> m_point_light_shader;
     std::shared_ptr<RGL::Shader> m_spot_light_shader;
+    std::shared_ptr<RGL::Shader> m_single_pass_shader;
 
     std::shared_ptr<TerrainModel> m_terrain_model;
+    std::shared_ptr<TerrainMaps>  m_terrain_maps;
+
+    /*
+     * Stream and draw m_terrain_model's heights if m_use_cdlod, its full resolution mesh isn't generated then.
+     * The heightmap is baked to the tiles on every (re)load, a streamed world would ship its .ttiles file instead.
+     */
+    std::shared_ptr<TerrainTiles>    m_terrain_tiles;
+    std::shared_ptr<TerrainQuadtree> m_terrain_quadtree;
+    bool m_use_cdlod;
     glm::mat4 m_terrain_model_matrix;
     glm::vec3 m_terrain_position;
     float m_terrain_size;
@@ -94,15 +126,22 @@ private:
     float m_texcoord_tiling_factor;
     float m_grass_slope_threshold;
     float m_slope_rock_threshold;
+    bool  m_terrain_shadows;
+    float m_shadow_rebake_angle; /* The turn of the directional light's azimuth that bakes the horizon map again, in degrees. */
 
     std::vector<std::string>                     m_terrain_textures_filenames;
     std::vector<std::string>                     m_terrain_heightmaps_filenames;
     std::vector<std::shared_ptr<RGL::Texture2D>> m_terrain_textures;
 
+    /* The blend map paged on ARB_sparse_texture, null if not supported. */
+    std::shared_ptr<RGL::VirtualTexture>         m_virtual_blend_map;
+    bool                                         m_use_virtual_blend_map;
+
     std::shared_ptr<RGL::Shader> m_terrain_ambient_light_shader;
     std::shared_ptr<RGL::Shader> m_terrain_directional_light_shader;
     std::shared_ptr<RGL::Shader> m_terrain_point_light_shader;
     std::shared_ptr<RGL::Shader> m_terrain_spot_light_shader;
+    std::shared_ptr<RGL::Shader> m_terrain_single_pass_shader;
 
     std::vector<RGL::StaticModel> m_objects;
     std::vector<glm::mat4> m_objects_model_matrices;
@@ -119,5 +158,8 @@ private:
     float m_ambient_factor;
     float m_gamma;
 
+    GLuint m_lights_ssbo_id;
+    bool   m_is_single_pass;
+
     bool m_snap_camera_to_ground;
 };
\ No newline at end of file
@@ -0,0 +1,68 @@
+#version 460 core
+layout (location = 0) in vec2 in_grid_pos; /* In cells of the patch, [0, u_grid_size]. */
+
+#define MAX_LODS 12
+
+/* The heights of the resident tiles of TerrainTiles in local units, a layer per tile with an apron of a texel. */
+layout (binding = 8) uniform sampler2DArray heights_texture;
+
+/* Per instance: the first cell, the size in cells, and the level and the tile's layer (lod | layer << 8) of the node, see TerrainQuadtree. */
+layout (std430, binding = 0) readonly buffer TerrainNodesSSBO
+{
+    uvec4 nodes[];
+};
+
+uniform mat4 model;
+uniform mat4 mvp;
+
+uniform float u_grid_size;
+uniform vec2  u_cells;                    /* Of the world. */
+uniform vec2  u_cell_size;                /* In local units, the cells grow along -x and -z. */
+uniform float u_tile_cells;
+uniform float u_tile_texels;
+uniform vec3  u_camera_position;          /* In local space. */
+uniform vec2  u_morph_ranges[MAX_LODS];   /* Start and end of the levels' morph. */
+
+out vec2 texcoord;
+out vec3 world_pos;
+
+/* A node never crosses its tile. */
+vec2  tile_first_cell;
+float tile_layer;
+
+float heightAt(vec2 cell)
+{
+    vec2 uv = (cell - tile_first_cell + 1.5) / u_tile_texels;
+    return textureLod(heights_texture, vec3(uv, tile_layer), 0.0).r;
+}
+
+vec3 localPosition(vec2 cell)
+{
+    return vec3(-cell.x * u_cell_size.x, heightAt(cell), -cell.y * u_cell_size.y);
+}
+
+void main()
+{
+    uvec4 node      = nodes[gl_InstanceID];
+    uint  lod       = node.w & 0xFFu;
+    float cell_size = float(node.z) / u_grid_size;
+    vec2  cell      = min(vec2(node.xy) + in_grid_pos * cell_size, u_cells);
+
+    tile_first_cell = floor(vec2(node.xy) / u_tile_cells) * u_tile_cells;
+    tile_layer      = float(node.w >> 8);
+
+    /* The odd vertices slide onto their even neighbours, so at the end of the range the patch is the coarser level's. */
+    vec2  morph_range = u_morph_ranges[lod];
+    float morph       = clamp((distance(u_camera_position, localPosition(cell)) - morph_range.x) / (morph_range.y - morph_range.x), 0.0, 1.0);
+    vec2  odd         = fract(in_grid_pos * 0.5) * 2.0;
+
+    cell = min(cell - odd * cell_size * morph, u_cells);
+
+    /* The normals come from TerrainMaps' normal map. */
+    vec3 local_pos = localPosition(cell);
+
+    world_pos = vec3(model * vec4(local_pos, 1.0));
+    texcoord  = 1.0 - cell / u_cells;
+
+    gl_Position = mvp * vec4(local_pos, 1.0);
+}
@@ -0,0 +1,132 @@
+#include "terrain_maps.hpp"
+#include "terrain_model.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+TerrainMaps::TerrainMaps(const TerrainModel& terrain)
+    : m_resolution          (terrain.getResolution()),
+      m_cell_size           (terrain.getExtent() / glm::vec2(terrain.getResolution() - 1u)),
+      m_baked_thresholds    (-1.0f),
+      m_baked_light_azimuth (0.0f),
+      m_shadow_bakes_count  (0),
+      m_heights_texture_name(0),
+      m_normal_map_name     (0),
+      m_splat_weights_name  (0),
+      m_horizon_map_name    (0)
+{
+    m_bake_shader = std::make_shared<RGL::Shader>("src/demos/04_terrain/terrain_maps.comp");
+    m_bake_shader->link();
+
+    m_horizon_shader = std::make_shared<RGL::Shader>("src/demos/04_terrain/terrain_horizon.comp");
+    m_horizon_shader->link();
+
+    /* Only the bakes read the heights. The horizon's march samples them between the vertices. */
+    glCreateTextures   (GL_TEXTURE_2D, 1, &m_heights_texture_name);
+    glTextureStorage2D (m_heights_texture_name, 1, GL_R32F, m_resolution.x, m_resolution.y);
+    glTextureSubImage2D(m_heights_texture_name, 0, 0, 0, m_resolution.x, m_resolution.y, GL_RED, GL_FLOAT, terrain.getHeightsData());
+    glTextureParameteri(m_heights_texture_name, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(m_heights_texture_name, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(m_heights_texture_name, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+    glTextureParameteri(m_heights_texture_name, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+
+    const GLuint levels_count = 1 + GLuint(std::floor(std::log2(float(std::max(m_resolution.x, m_resolution.y)))));
+
+    glCreateTextures  (GL_TEXTURE_2D, 1, &m_normal_map_name);
+    glTextureStorage2D(m_normal_map_name, levels_count, GL_RGBA8_SNORM, m_resolution.x, m_resolution.y);
+
+    glCreateTextures  (GL_TEXTURE_2D, 1, &m_splat_weights_name);
+    glTextureStorage2D(m_splat_weights_name, levels_count, GL_RGBA8, m_resolution.x, m_resolution.y);
+
+    glCreateTextures  (GL_TEXTURE_2D, 1, &m_horizon_map_name);
+    glTextureStorage2D(m_horizon_map_name, levels_count, GL_R16F, m_resolution.x, m_resolution.y);
+
+    for (GLuint texture_name : { m_normal_map_name, m_splat_weights_name, m_horizon_map_name })
+    {
+        glTextureParameteri(texture_name, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTextureParameteri(texture_name, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(texture_name, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+        glTextureParameteri(texture_name, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+    }
+}
+
+TerrainMaps::~TerrainMaps()
+{
+    glDeleteTextures(1, &m_heights_texture_name);
+    glDeleteTextures(1, &m_normal_map_name);
+    glDeleteTextures(1, &m_splat_weights_name);
+    glDeleteTextures(1, &m_horizon_map_name);
+}
+
+void TerrainMaps::update(float grass_slope_threshold, float slope_rock_threshold)
+{
+    const glm::vec2 thresholds = glm::vec2(grass_slope_threshold, slope_rock_threshold);
+
+    if (thresholds == m_baked_thresholds)
+    {
+        return;
+    }
+
+    m_baked_thresholds = thresholds;
+
+    m_bake_shader->bind();
+    m_bake_shader->setUniform("u_cell_size",             m_cell_size);
+    m_bake_shader->setUniform("u_grass_slope_threshold", grass_slope_threshold);
+    m_bake_shader->setUniform("u_slope_rock_threshold",  slope_rock_threshold);
+
+    glBindTextureUnit (0, m_heights_texture_name);
+    glBindImageTexture(0, m_normal_map_name,    0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8_SNORM);
+    glBindImageTexture(1, m_splat_weights_name, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+    glDispatchCompute((m_resolution.x + 7) / 8, (m_resolution.y + 7) / 8, 1);
+    glMemoryBarrier  (GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    /* The terrain is seen from far away too. */
+    glGenerateTextureMipmap(m_normal_map_name);
+    glGenerateTextureMipmap(m_splat_weights_name);
+}
+
+void TerrainMaps::updateShadows(const glm::vec3& light_direction, float threshold_degrees)
+{
+    /* Toward the light. Straight above it the horizon is irrelevant, the last bake stays. */
+    const glm::vec2 to_light = -glm::vec2(light_direction.x, light_direction.z);
+
+    if (glm::length(to_light) < 1e-4f)
+    {
+        return;
+    }
+
+    const glm::vec2 azimuth = glm::normalize(to_light);
+
+    if (m_baked_light_azimuth != glm::vec2(0.0f) && glm::dot(azimuth, m_baked_light_azimuth) >= std::cos(glm::radians(threshold_degrees)))
+    {
+        return;
+    }
+
+    m_baked_light_azimuth = azimuth;
+    m_shadow_bakes_count++;
+
+    /* The vertices grow along -x and -z, a step of a vertex along the longer axis. */
+    glm::vec2 light_step = -azimuth / m_cell_size;
+    light_step /= std::max(std::abs(light_step.x), std::abs(light_step.y));
+
+    m_horizon_shader->bind();
+    m_horizon_shader->setUniform("u_cell_size",  m_cell_size);
+    m_horizon_shader->setUniform("u_light_step", light_step);
+    m_horizon_shader->setUniform("u_max_steps",  256u);
+
+    glBindTextureUnit (0, m_heights_texture_name);
+    glBindImageTexture(0, m_horizon_map_name, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16F);
+
+    glDispatchCompute((m_resolution.x + 7) / 8, (m_resolution.y + 7) / 8, 1);
+    glMemoryBarrier  (GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    glGenerateTextureMipmap(m_horizon_map_name);
+}
+
+void TerrainMaps::bind() const
+{
+    glBindTextureUnit(NORMAL_MAP_UNIT,    m_normal_map_name);
+    glBindTextureUnit(SPLAT_WEIGHTS_UNIT, m_splat_weights_name);
+    glBindTextureUnit(HORIZON_MAP_UNIT,   m_horizon_map_name);
+}
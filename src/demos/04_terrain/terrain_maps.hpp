@@ -0,0 +1,59 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <memory>
+
+#include "shader.h"
+
+class TerrainModel;
+
+/*
+ * The terrain's normal map and slope splat weights, a texel per heightmap vertex, baked by terrain_maps.comp
+ * from TerrainModel's heights. The terrain shaders sample them (lighting-terrain.glh) instead of interpolating
+ * the vertex normals and blending the slope textures by the thresholds per pixel. The weights are baked again
+ * only when the thresholds change.
+ *
+ * The self-shadowing of the directional light is a horizon map of the same size (terrain_horizon.comp) - the
+ * elevation of the horizon toward the light's azimuth, which the shaders compare with the light's elevation in
+ * one fetch. Raising or lowering the light needs no bake, turning it does once it's past the threshold angle.
+ */
+class TerrainMaps
+{
+public:
+    static constexpr GLuint NORMAL_MAP_UNIT    = 9;
+    static constexpr GLuint SPLAT_WEIGHTS_UNIT = 10;
+    static constexpr GLuint HORIZON_MAP_UNIT   = 11;
+
+    explicit TerrainMaps(const TerrainModel& terrain);
+    ~TerrainMaps();
+
+    TerrainMaps           (const TerrainMaps&) = delete;
+    TerrainMaps& operator=(const TerrainMaps&) = delete;
+
+    /* Bakes the maps if the thresholds are not the ones of the last bake. */
+    void update(float grass_slope_threshold, float slope_rock_threshold);
+
+    /* Bakes the horizon map if the light's azimuth turned by more than the threshold since the last bake. */
+    void updateShadows(const glm::vec3& light_direction, float threshold_degrees);
+
+    uint32_t getShadowBakesCount() const { return m_shadow_bakes_count; }
+
+    void bind() const;
+
+private:
+    std::shared_ptr<RGL::Shader> m_bake_shader;
+    std::shared_ptr<RGL::Shader> m_horizon_shader;
+
+    glm::uvec2 m_resolution;
+    glm::vec2  m_cell_size;
+    glm::vec2  m_baked_thresholds;
+    glm::vec2  m_baked_light_azimuth;   /* The light's normalized xz direction of the horizon map, 0 if not baked. */
+    uint32_t   m_shadow_bakes_count;
+
+    GLuint m_heights_texture_name;
+    GLuint m_normal_map_name;
+    GLuint m_splat_weights_name;
+    GLuint m_horizon_map_name;
+};
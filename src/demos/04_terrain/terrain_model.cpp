@@ -2,14 +2,22 @@
 #include <iostream>
 #include <cmath>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
+
 #include <glm/geometric.hpp>
 #include <filesystem.h>
+#include <job_system.h>
 
-TerrainModel::TerrainModel(const std::string& heightmap_filename, float size, float max_height)
+TerrainModel::TerrainModel(const std::string& heightmap_filename, float size, float max_height, bool generate_mesh)
     : M_SIZE(size),
       M_MAX_HEIGHT(max_height)
 {
-    genTerrainVertices(RGL::FileSystem::getResourcesPath() / heightmap_filename);
+    /* A triangle strip per row of the heightmap, a third of the indices of the list. */
+    SetStripGeneration(true);
+
+    genTerrainVertices(RGL::FileSystem::getResourcesPath() / heightmap_filename, generate_mesh);
 
     std::cout << "Created terrain with max height = " << M_MAX_HEIGHT << std::endl;
 }
@@ -19,46 +27,119 @@ TerrainModel::~TerrainModel()
     std::cout << "Deleted terrain with max height = " << M_MAX_HEIGHT << std::endl;
 }
 
-float TerrainModel::getHeightOfTerrain(float world_x, float world_z, float terrain_world_x, float terrain_world_z)
+float TerrainModel::getHeightOfTerrain(float world_x, float world_z, float terrain_world_x, float terrain_world_z) const
 {
-    float terrain_x    = terrain_world_x - world_x;
-    float terrain_z    = terrain_world_z - world_z;
-    float aspect_ratio = float(m_heights[0].size()) / float(m_heights.size());
-
-    float grid_square_size_x = aspect_ratio * M_SIZE / float(m_heights[0].size() - 1);
-    float grid_square_size_z = M_SIZE / float(m_heights.size()    - 1);
-
-    int grid_x = int(terrain_x / grid_square_size_x);
-    int grid_z = int(terrain_z / grid_square_size_z);
+    /* In cells of the grid, the vertices grow along -x and -z. */
+    float terrain_x = (terrain_world_x - world_x) / m_grid_square_size.x;
+    float terrain_z = (terrain_world_z - world_z) / m_grid_square_size.y;
 
-    if (grid_x >= m_heights[0].size() - 1 || grid_z >= m_heights.size() - 1 || grid_x < 0 || grid_z < 0)
+    if (!(terrain_x >= 0.0f && terrain_z >= 0.0f && terrain_x < float(m_resolution.x - 1) && terrain_z < float(m_resolution.y - 1)))
     {
         return 0;
     }
 
-    float x_coord = std::fmod(terrain_x, grid_square_size_x) / grid_square_size_x;
-    float z_coord = std::fmod(terrain_z, grid_square_size_z) / grid_square_size_z;
+    uint32_t grid_x = uint32_t(terrain_x);
+    uint32_t grid_z = uint32_t(terrain_z);
+
+    float x_coord = terrain_x - float(grid_x);
+    float z_coord = terrain_z - float(grid_z);
+
+    const float* row = m_heights.data() + grid_z * m_resolution.x + grid_x;
+
+    float h00 = row[0];
+    float h01 = row[1];
+    float h10 = row[m_resolution.x];
+    float h11 = row[m_resolution.x + 1];
 
-    float height;
-    if (x_coord <= 1.0 - z_coord)
+    /* The cell's triangles are split along the (x + 1, z) - (x, z + 1) diagonal, as the mesh's. */
+    if (x_coord <= 1.0f - z_coord)
     {
-        height = barycentricHeight(glm::vec3(0.0, m_heights[grid_z    ][grid_x    ], 0.0), 
-                                   glm::vec3(1.0, m_heights[grid_z + 1][grid_x    ], 0.0),
-                                   glm::vec3(0.0, m_heights[grid_z    ][grid_x + 1], 1.0),
-                                   glm::vec2(z_coord, x_coord));
+        return h00 + (h10 - h00) * z_coord + (h01 - h00) * x_coord;
     }
-    else
+
+    return h11 + (h01 - h11) * (1.0f - z_coord) + (h10 - h11) * (1.0f - x_coord);
+}
+
+void TerrainModel::getHeights(std::span<const glm::vec2> world_xz, float terrain_world_x, float terrain_world_z, std::span<float> heights) const
+{
+    size_t i = 0;
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    const __m128 terrain_world_x4   = _mm_set1_ps(terrain_world_x);
+    const __m128 terrain_world_z4   = _mm_set1_ps(terrain_world_z);
+    const __m128 inv_square_size_x4 = _mm_set1_ps(1.0f / m_grid_square_size.x);
+    const __m128 inv_square_size_z4 = _mm_set1_ps(1.0f / m_grid_square_size.y);
+    const __m128 max_cell_x4        = _mm_set1_ps(float(m_resolution.x - 1));
+    const __m128 max_cell_z4        = _mm_set1_ps(float(m_resolution.y - 1));
+    const __m128 zero4              = _mm_setzero_ps();
+    const __m128 one4               = _mm_set1_ps(1.0f);
+
+    for (; i + 4 <= world_xz.size(); i += 4)
     {
-        height = barycentricHeight(glm::vec3(1.0, m_heights[grid_z + 1][grid_x    ], 0.0), 
-                                   glm::vec3(1.0, m_heights[grid_z + 1][grid_x + 1], 1.0),
-                                   glm::vec3(0.0, m_heights[grid_z    ][grid_x + 1], 1.0),
-                                   glm::vec2(z_coord, x_coord));
+        /* x0 z0 x1 z1 and x2 z2 x3 z3 into x0..x3 and z0..z3 */
+        __m128 xz01 = _mm_loadu_ps(&world_xz[i    ].x);
+        __m128 xz23 = _mm_loadu_ps(&world_xz[i + 2].x);
+        __m128 x4   = _mm_shuffle_ps(xz01, xz23, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 z4   = _mm_shuffle_ps(xz01, xz23, _MM_SHUFFLE(3, 1, 3, 1));
+
+        __m128 terrain_x4 = _mm_mul_ps(_mm_sub_ps(terrain_world_x4, x4), inv_square_size_x4);
+        __m128 terrain_z4 = _mm_mul_ps(_mm_sub_ps(terrain_world_z4, z4), inv_square_size_z4);
+
+        /* The points off the terrain read the first cell and get 0 in the end, the truncation is the floor for the rest. */
+        __m128 inside4 = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(terrain_x4, zero4), _mm_cmpge_ps(terrain_z4, zero4)),
+                                    _mm_and_ps(_mm_cmplt_ps(terrain_x4, max_cell_x4), _mm_cmplt_ps(terrain_z4, max_cell_z4)));
+
+        terrain_x4 = _mm_and_ps(terrain_x4, inside4);
+        terrain_z4 = _mm_and_ps(terrain_z4, inside4);
+
+        __m128i grid_x4 = _mm_cvttps_epi32(terrain_x4);
+        __m128i grid_z4 = _mm_cvttps_epi32(terrain_z4);
+
+        __m128 x_coord4 = _mm_sub_ps(terrain_x4, _mm_cvtepi32_ps(grid_x4));
+        __m128 z_coord4 = _mm_sub_ps(terrain_z4, _mm_cvtepi32_ps(grid_z4));
+
+        /* No gathers in SSE2, the corners are loaded one by one. */
+        alignas(16) int32_t grid_x[4], grid_z[4];
+        alignas(16) float   h00[4], h01[4], h10[4], h11[4];
+
+        _mm_store_si128((__m128i*)grid_x, grid_x4);
+        _mm_store_si128((__m128i*)grid_z, grid_z4);
+
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            const float* row = m_heights.data() + size_t(grid_z[lane]) * m_resolution.x + grid_x[lane];
+
+            h00[lane] = row[0];
+            h01[lane] = row[1];
+            h10[lane] = row[m_resolution.x];
+            h11[lane] = row[m_resolution.x + 1];
+        }
+
+        __m128 h00_4 = _mm_load_ps(h00);
+        __m128 h01_4 = _mm_load_ps(h01);
+        __m128 h10_4 = _mm_load_ps(h10);
+        __m128 h11_4 = _mm_load_ps(h11);
+
+        /* Both triangles of the cell, see getHeightOfTerrain(). */
+        __m128 lower4 = _mm_add_ps(h00_4, _mm_add_ps(_mm_mul_ps(_mm_sub_ps(h10_4, h00_4), z_coord4),
+                                                     _mm_mul_ps(_mm_sub_ps(h01_4, h00_4), x_coord4)));
+        __m128 upper4 = _mm_add_ps(h11_4, _mm_add_ps(_mm_mul_ps(_mm_sub_ps(h01_4, h11_4), _mm_sub_ps(one4, z_coord4)),
+                                                     _mm_mul_ps(_mm_sub_ps(h10_4, h11_4), _mm_sub_ps(one4, x_coord4))));
+
+        __m128 is_lower4 = _mm_cmple_ps(x_coord4, _mm_sub_ps(one4, z_coord4));
+        __m128 height4   = _mm_or_ps(_mm_and_ps(is_lower4, lower4), _mm_andnot_ps(is_lower4, upper4));
+
+        _mm_storeu_ps(&heights[i], _mm_and_ps(height4, inside4));
     }
+#endif
 
-    return height;
+    for (; i < world_xz.size(); ++i)
+    {
+        heights[i] = getHeightOfTerrain(world_xz[i].x, world_xz[i].y, terrain_world_x, terrain_world_z);
+    }
 }
 
-void TerrainModel::genTerrainVertices(const std::filesystem::path & heightmap_filename)
+void TerrainModel::genTerrainVertices(const std::filesystem::path & heightmap_filename, bool generate_mesh)
 {
     RGL::VertexData vertex_data;
     RGL::ImageData heightmap_metadata;
@@ -76,24 +157,50 @@ void TerrainModel::genTerrainVertices(const std::filesystem::path & heightmap_fi
 
         float aspect_ratio = float(vertex_count_width) / float(vertex_count_height);
 
-        m_heights = std::vector<std::vector<float>>(vertex_count_height /* rows */, std::vector<float>(vertex_count_width /* cols */));
+        m_resolution       = glm::uvec2(vertex_count_width, vertex_count_height);
+        m_grid_square_size = glm::vec2(aspect_ratio * M_SIZE / float(vertex_count_width - 1), M_SIZE / float(vertex_count_height - 1));
+        m_heights.resize(size_t(vertex_count_width) * vertex_count_height);
 
-        for (unsigned int j = 0; j < vertex_count_height; ++j)
+        /* Every row writes only its own heights and vertices, so the rows are generated in parallel. */
+        RGL::JobSystem::ParallelFor(0, vertex_count_height, 16, [&](uint32_t row_begin, uint32_t row_end)
         {
-            for (unsigned int i = 0; i < vertex_count_width; ++i)
+            for (unsigned int j = row_begin; j < row_end; ++j)
             {
-                m_heights[j][i] = getHeight(i, j, heightmap_image, heightmap_metadata);
-
-                vertex_data.positions.push_back( glm::vec3(-float(i) / float(vertex_count_width - 1) * M_SIZE * aspect_ratio,
-                                                 m_heights[j][i], 
-                                                -float(j) / float(vertex_count_height - 1) * M_SIZE));
-                vertex_data.normals.push_back(calculateNormal(i, j, heightmap_image, heightmap_metadata));
-                vertex_data.texcoords.push_back(glm::vec3((1.0 - float(i) / float(vertex_count_width - 1)),
-                                                           1.0 - float(j) / float(vertex_count_height - 1),
-                                                           0.0f));
+                for (unsigned int i = 0; i < vertex_count_width; ++i)
+                {
+                    m_heights[j * vertex_count_width + i] = getHeight(i, j, heightmap_image, heightmap_metadata);
+                }
             }
+        });
+
+        if (!generate_mesh)
+        {
+            stbi_image_free(heightmap_image);
+            return;
         }
 
+        vertex_data.positions.resize(vertex_count_width * vertex_count_height);
+        vertex_data.normals  .resize(vertex_count_width * vertex_count_height);
+        vertex_data.texcoords.resize(vertex_count_width * vertex_count_height);
+
+        RGL::JobSystem::ParallelFor(0, vertex_count_height, 16, [&](uint32_t row_begin, uint32_t row_end)
+        {
+            for (unsigned int j = row_begin; j < row_end; ++j)
+            {
+                for (unsigned int i = 0; i < vertex_count_width; ++i)
+                {
+                    const unsigned int index = j * vertex_count_width + i;
+
+                    vertex_data.positions[index] = glm::vec3(-float(i) / float(vertex_count_width - 1) * M_SIZE * aspect_ratio,
+                                                             m_heights[index],
+                                                            -float(j) / float(vertex_count_height - 1) * M_SIZE);
+                    vertex_data.normals  [index] = glm::vec3(0.0f, 1.0f, 0.0f); /* The shaders use TerrainMaps' normal map. */
+                    vertex_data.texcoords[index] = glm::vec2((1.0 - float(i) / float(vertex_count_width - 1)),
+                                                              1.0 - float(j) / float(vertex_count_height - 1));
+                }
+            }
+        });
+
         for (unsigned int j = 0; j < vertex_count_height - 1; ++j)
         {
             for (unsigned int i = 0; i < vertex_count_width - 1; ++i)
@@ -113,7 +220,19 @@ void TerrainModel::genTerrainVertices(const std::filesystem::path & heightmap_fi
             }
         }
 
-        GenPrimitive(vertex_data);
+        if (IsStripGenerationEnabled())
+        {
+            /* The strips split the cells along the same diagonal, the tangents are computed from the triangles. */
+            CalcTangentSpace(vertex_data);
+
+            vertex_data.indices.clear();
+            GenGridTriangleStrips(vertex_count_width - 1, vertex_count_height - 1, vertex_data.indices);
+            GenStripPrimitive(vertex_data, RGL::DrawMode::TRIANGLE_STRIP);
+        }
+        else
+        {
+            GenPrimitive(vertex_data);
+        }
     }
     else
     {
@@ -136,27 +255,3 @@ float TerrainModel::getHeight(int x, int z, unsigned char* heightmap_data, RGL::
 
     return height;
 }
-
-glm::vec3 TerrainModel::calculateNormal(int x, int z, unsigned char* heightmap_data, RGL::ImageData& heightmap_metadata)
-{
-    float height_left  = getHeight(x - 1, z,     heightmap_data, heightmap_metadata);
-    float height_right = getHeight(x + 1, z,     heightmap_data, heightmap_metadata);
-    float height_down  = getHeight(x,     z - 1, heightmap_data, heightmap_metadata);
-    float height_up    = getHeight(x,     z + 1, heightmap_data, heightmap_metadata);
-
-    auto normal = glm::vec3(height_left - height_right, 2.0f, height_down - height_up);
-    normal      = glm::normalize(normal);
-    
-    return normal;
-}
-
-float TerrainModel::barycentricHeight(const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, const glm::vec2& p)
-{
-    float det = (p2.z - p3.z) * (p1.x - p3.x) + (p3.x - p2.x) * (p1.z - p3.z);
-
-    float l1 = ((p2.z - p3.z) * (p.x - p3.x) + (p3.x - p2.x) * (p.y - p3.z)) / det;
-    float l2 = ((p3.z - p1.z) * (p.x - p3.x) + (p1.x - p3.x) * (p.y - p3.z)) / det;
-    float l3 = 1.0 - l1 - l2;
-
-    return l1 * p1.y + l2 * p2.y + l3 * p3.y;
-}
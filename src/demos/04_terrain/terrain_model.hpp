@@ -3,22 +3,35 @@
 #include <static_model.h>
 #include "util.h"
 
+#include <span>
+
 class TerrainModel : public RGL::StaticModel
 {
 public:
-    TerrainModel(const std::string & heightmap_filename, float size = 200.0f, float max_height = 100.0f);
+    /* Without the mesh only the heights are kept, for TerrainQuadtree and the height queries. */
+    TerrainModel(const std::string & heightmap_filename, float size = 200.0f, float max_height = 100.0f, bool generate_mesh = true);
     ~TerrainModel();
 
-    float getHeightOfTerrain(float world_x, float world_z, float terrain_world_x, float terrain_world_z);
+    float getHeightOfTerrain(float world_x, float world_z, float terrain_world_x, float terrain_world_z) const;
+
+    /* getHeightOfTerrain() of every world_xz[i] into heights[i], four at a time with SSE2. heights must be as long as world_xz. */
+    void getHeights(std::span<const glm::vec2> world_xz, float terrain_world_x, float terrain_world_z, std::span<float> heights) const;
+
+    /* The heights of the vertices, row by row along z, getResolution().x per row. */
+    const float* getHeightsData() const { return m_heights.data(); }
+    glm::uvec2   getResolution()  const { return m_resolution; }
+
+    /* Of the terrain in local units, its vertices span [-extent, 0] along x and z. */
+    glm::vec2 getExtent() const { return glm::vec2(M_SIZE * float(m_resolution.x) / float(m_resolution.y), M_SIZE); }
 
 protected:
-    void genTerrainVertices(const std::filesystem::path & heightmap_filename);
+    void genTerrainVertices(const std::filesystem::path & heightmap_filename, bool generate_mesh);
     float getHeight(int x, int z, unsigned char* heightmap_data, RGL::ImageData & heightmap_metadata);
-    glm::vec3 calculateNormal(int x, int z, unsigned char* heightmap_data, RGL::ImageData& heightmap_metadata);
-
-    float barycentricHeight(const glm::vec3 & p1, const glm::vec3 & p2, const glm::vec3 & p3, const glm::vec2 & p);
 
-    std::vector<std::vector<float>> m_heights;
+    /* A single allocation for all the rows, the lookups of a query touch two neighbouring rows of it. */
+    std::vector<float> m_heights;
+    glm::uvec2         m_resolution;
+    glm::vec2          m_grid_square_size;
 
     const float M_SIZE;
     const float M_MAX_HEIGHT;
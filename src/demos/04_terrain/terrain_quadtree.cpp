@@ -0,0 +1,238 @@
+#include "terrain_quadtree.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <gpu_culling.h>
+
+TerrainQuadtree::TerrainQuadtree()
+    : m_cells            (0),
+      m_cell_size        (0.0f),
+      m_lods_count       (1),
+      m_vao_name         (0),
+      m_vbo_name         (0),
+      m_ibo_name         (0),
+      m_nodes_buffer_name(0),
+      m_indices_count    (0),
+      m_nodes_capacity   (0)
+{
+    /* A tile's root covers the whole tile. */
+    while ((GRID_SIZE << (m_lods_count - 1)) < TerrainTiles::TILE_CELLS && m_lods_count < MAX_LODS)
+    {
+        ++m_lods_count;
+    }
+
+    createPatch();
+
+    glCreateBuffers(1, &m_nodes_buffer_name);
+}
+
+TerrainQuadtree::~TerrainQuadtree()
+{
+    glDeleteVertexArrays(1, &m_vao_name);
+    glDeleteBuffers     (1, &m_vbo_name);
+    glDeleteBuffers     (1, &m_ibo_name);
+    glDeleteBuffers     (1, &m_nodes_buffer_name);
+}
+
+void TerrainQuadtree::createPatch()
+{
+    std::vector<glm::vec2> grid_positions;
+    std::vector<uint32_t>  indices;
+
+    for (uint32_t j = 0; j <= GRID_SIZE; ++j)
+    {
+        for (uint32_t i = 0; i <= GRID_SIZE; ++i)
+        {
+            grid_positions.emplace_back(float(i), float(j));
+        }
+    }
+
+    /* The winding of TerrainModel's triangles. */
+    for (uint32_t j = 0; j < GRID_SIZE; ++j)
+    {
+        for (uint32_t i = 0; i < GRID_SIZE; ++i)
+        {
+            uint32_t top_left     = j * (GRID_SIZE + 1) + i;
+            uint32_t top_right    = top_left + 1;
+            uint32_t bottom_left  = (j + 1) * (GRID_SIZE + 1) + i;
+            uint32_t bottom_right = bottom_left + 1;
+
+            indices.insert(indices.end(), { top_left, bottom_left, top_right, top_right, bottom_left, bottom_right });
+        }
+    }
+
+    m_indices_count = uint32_t(indices.size());
+
+    glCreateBuffers     (1, &m_vbo_name);
+    glNamedBufferStorage(m_vbo_name, grid_positions.size() * sizeof(glm::vec2), grid_positions.data(), 0);
+
+    glCreateBuffers     (1, &m_ibo_name);
+    glNamedBufferStorage(m_ibo_name, indices.size() * sizeof(uint32_t), indices.data(), 0);
+
+    glCreateVertexArrays      (1, &m_vao_name);
+    glVertexArrayElementBuffer(m_vao_name, m_ibo_name);
+    glVertexArrayVertexBuffer (m_vao_name, 0 /* bindingindex*/, m_vbo_name, 0 /* offset */, sizeof(glm::vec2) /*stride*/);
+    glEnableVertexArrayAttrib (m_vao_name, 0 /*attribindex*/);
+    glVertexArrayAttribFormat (m_vao_name, 0 /*attribindex */, 2 /* size */, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/);
+    glVertexArrayAttribBinding(m_vao_name, 0 /*attribindex*/, 0 /*bindingindex*/);
+}
+
+void TerrainQuadtree::select(const TerrainTiles& tiles, const glm::vec3& camera_position, const glm::mat4& local_view_projection)
+{
+    RGL::GpuCulling::ExtractFrustumPlanes(local_view_projection, m_frustum_planes);
+    m_camera_position = camera_position;
+    m_cells           = tiles.getCells();
+    m_cell_size       = tiles.getCellSize();
+
+    /* A level's vertices morph over the last m_morph_ratio of its range, fully onto the coarser level at its end. */
+    for (uint32_t lod = 0; lod < m_lods_count; ++lod)
+    {
+        m_lod_ranges  [lod] = m_lod_distance * float(1u << lod);
+        m_morph_ranges[lod] = glm::vec2(m_lod_ranges[lod] * (1.0f - m_morph_ratio), m_lod_ranges[lod]);
+    }
+
+    /* There's no coarser level to morph the coarsest one onto. */
+    m_morph_ranges[m_lods_count - 1] = glm::vec2(std::numeric_limits<float>::max() * 0.5f, std::numeric_limits<float>::max());
+
+    m_selected_nodes.clear();
+
+    /* The terrain farther than the coarsest range is drawn with the tiles' roots. */
+    const uint32_t top_lod = m_lods_count - 1;
+
+    for (const auto& tile : tiles.getResidentTiles())
+    {
+        if (!selectNode(tile, top_lod, 0, 0) && isInFrustum(getBounds(tile, top_lod, 0, 0)))
+        {
+            addNode(tile, top_lod, 0, 0);
+        }
+    }
+
+    if (m_selected_nodes.size() > m_nodes_capacity)
+    {
+        m_nodes_capacity = uint32_t(m_selected_nodes.size());
+        glNamedBufferData(m_nodes_buffer_name, sizeof(glm::uvec4) * m_nodes_capacity, nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    if (!m_selected_nodes.empty())
+    {
+        glNamedBufferSubData(m_nodes_buffer_name, 0, sizeof(glm::uvec4) * m_selected_nodes.size(), m_selected_nodes.data());
+    }
+}
+
+bool TerrainQuadtree::selectNode(const TerrainTiles::ResidentTile& tile, uint32_t lod, uint32_t x, uint32_t z)
+{
+    const Bounds bounds = getBounds(tile, lod, x, z);
+
+    if (!isInRange(bounds, m_lod_ranges[lod]))
+    {
+        return false;
+    }
+
+    /* Selected, but not visible. */
+    if (!isInFrustum(bounds))
+    {
+        return true;
+    }
+
+    if (lod == 0 || !isInRange(bounds, m_lod_ranges[lod - 1]))
+    {
+        addNode(tile, lod, x, z);
+        return true;
+    }
+
+    /*
+     * The children out of their range are still drawn with their own grid, the vertex shader morphs them
+     * fully onto this level there, so they have this level's density.
+     */
+    for (uint32_t cz = 2 * z; cz < 2 * z + 2; ++cz)
+    {
+        for (uint32_t cx = 2 * x; cx < 2 * x + 2; ++cx)
+        {
+            if (isInWorld(tile, lod - 1, cx, cz) && !selectNode(tile, lod - 1, cx, cz) && isInFrustum(getBounds(tile, lod - 1, cx, cz)))
+            {
+                addNode(tile, lod - 1, cx, cz);
+            }
+        }
+    }
+
+    return true;
+}
+
+void TerrainQuadtree::addNode(const TerrainTiles::ResidentTile& tile, uint32_t lod, uint32_t x, uint32_t z)
+{
+    const uint32_t node_size = GRID_SIZE << lod;
+    const glm::uvec2 first_cell = tile.m_tile * TerrainTiles::TILE_CELLS + glm::uvec2(x, z) * node_size;
+
+    m_selected_nodes.emplace_back(first_cell.x, first_cell.y, node_size, lod | (tile.m_layer << 8));
+}
+
+bool TerrainQuadtree::isInWorld(const TerrainTiles::ResidentTile& tile, uint32_t lod, uint32_t x, uint32_t z) const
+{
+    const glm::uvec2 first_cell = tile.m_tile * TerrainTiles::TILE_CELLS + glm::uvec2(x, z) * (GRID_SIZE << lod);
+    return first_cell.x < m_cells.x && first_cell.y < m_cells.y;
+}
+
+TerrainQuadtree::Bounds TerrainQuadtree::getBounds(const TerrainTiles::ResidentTile& tile, uint32_t lod, uint32_t x, uint32_t z) const
+{
+    const uint32_t   node_size   = GRID_SIZE << lod;
+    const uint32_t   nodes_count = TerrainTiles::TILE_CELLS / node_size;
+    const glm::vec2  min_max     = (*tile.m_min_max_heights)[lod][z * nodes_count + x];
+    const glm::vec2  cells_min   = glm::vec2(tile.m_tile * TerrainTiles::TILE_CELLS + glm::uvec2(x, z) * node_size);
+    const glm::vec2  cells_max   = glm::min(cells_min + float(node_size), glm::vec2(m_cells));
+
+    /* The cells grow along -x and -z. */
+    const glm::vec2 local_min = -cells_max * m_cell_size;
+    const glm::vec2 local_max = -cells_min * m_cell_size;
+
+    return { glm::vec3(local_min.x, min_max.x, local_min.y), glm::vec3(local_max.x, min_max.y, local_max.y) };
+}
+
+bool TerrainQuadtree::isInFrustum(const Bounds& bounds) const
+{
+    for (const auto& plane : m_frustum_planes)
+    {
+        /* The corner farthest along the plane's normal. */
+        glm::vec3 positive_vertex = glm::vec3(plane.x >= 0.0f ? bounds.max.x : bounds.min.x,
+                                              plane.y >= 0.0f ? bounds.max.y : bounds.min.y,
+                                              plane.z >= 0.0f ? bounds.max.z : bounds.min.z);
+
+        if (glm::dot(glm::vec3(plane), positive_vertex) + plane.w < 0.0f)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool TerrainQuadtree::isInRange(const Bounds& bounds, float range) const
+{
+    glm::vec3 closest_point = glm::clamp(m_camera_position, bounds.min, bounds.max);
+    glm::vec3 offset        = closest_point - m_camera_position;
+
+    return glm::dot(offset, offset) <= range * range;
+}
+
+void TerrainQuadtree::render(RGL::Shader& shader, const TerrainTiles& tiles)
+{
+    if (m_selected_nodes.empty())
+    {
+        return;
+    }
+
+    shader.setUniform("u_grid_size",       float(GRID_SIZE));
+    shader.setUniform("u_cells",           glm::vec2(m_cells));
+    shader.setUniform("u_cell_size",       m_cell_size);
+    shader.setUniform("u_tile_cells",      float(TerrainTiles::TILE_CELLS));
+    shader.setUniform("u_tile_texels",     float(TerrainTiles::TILE_TEXELS));
+    shader.setUniform("u_camera_position", m_camera_position);
+    shader.setUniform("u_morph_ranges",    m_morph_ranges, m_lods_count);
+
+    tiles.bind(8);
+    glBindBufferBase (GL_SHADER_STORAGE_BUFFER, 0, m_nodes_buffer_name);
+
+    glBindVertexArray      (m_vao_name);
+    glDrawElementsInstanced(GL_TRIANGLES, m_indices_count, GL_UNSIGNED_INT, nullptr, GLsizei(m_selected_nodes.size()));
+}
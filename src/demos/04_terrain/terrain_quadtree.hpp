@@ -0,0 +1,89 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+#include "shader.h"
+#include "terrain_tiles.hpp"
+
+/*
+ * Continuous distance-dependent LOD (CDLOD, Strugar 2010) rendering of the resident tiles of TerrainTiles.
+ * A single grid patch of GRID_SIZE x GRID_SIZE cells is drawn instanced once per selected quadtree node, its vertex shader
+ * (terrain_cdlod.vert) samples the heights from the tiles' texture array and morphs the odd vertices onto the coarser level
+ * as the node approaches the end of its LOD range, so the levels meet without cracks or pops.
+ * Every tile is a quadtree, its root covers the tile. The nodes are selected every frame by the distance to the camera
+ * and culled against the frustum with their min/max heights, so the triangle count depends on the LOD distance,
+ * not on the size of the world.
+ *
+ * All positions are in the terrain's local space, the one of TerrainModel's vertices. The nodes are in cells:
+ * a node of the level lod covers GRID_SIZE << lod cells per side.
+ */
+class TerrainQuadtree
+{
+public:
+    static constexpr uint32_t GRID_SIZE = 32;
+    static constexpr uint32_t MAX_LODS  = 12;   /* In sync with terrain_cdlod.vert. */
+
+    TerrainQuadtree();
+    ~TerrainQuadtree();
+
+    TerrainQuadtree           (const TerrainQuadtree&) = delete;
+    TerrainQuadtree& operator=(const TerrainQuadtree&) = delete;
+
+    /* Selects the nodes of the resident tiles for the camera in the terrain's local space, and uploads them. local_view_projection is view_projection * model. */
+    void select(const TerrainTiles& tiles, const glm::vec3& camera_position, const glm::mat4& local_view_projection);
+
+    /* Draws the selected nodes with a program of terrain_cdlod.vert, bound by the caller. */
+    void render(RGL::Shader& shader, const TerrainTiles& tiles);
+
+    uint32_t getLodsCount()          const { return m_lods_count; }
+    uint32_t getSelectedNodesCount() const { return uint32_t(m_selected_nodes.size()); }
+    uint64_t getTrianglesCount()     const { return uint64_t(m_selected_nodes.size()) * GRID_SIZE * GRID_SIZE * 2; }
+
+    /* The LOD range of the finest level in local units, every coarser level doubles it. */
+    float m_lod_distance = 40.0f;
+
+    /* The part of a level's range, from its end, in which its vertices morph onto the coarser level. */
+    float m_morph_ratio  = 0.33f;
+
+private:
+    struct Bounds
+    {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    void createPatch();
+
+    /* false if the node is out of its level's range, its parent draws the area then. x and z are within the tile. */
+    bool   selectNode  (const TerrainTiles::ResidentTile& tile, uint32_t lod, uint32_t x, uint32_t z);
+    void   addNode     (const TerrainTiles::ResidentTile& tile, uint32_t lod, uint32_t x, uint32_t z);
+    Bounds getBounds   (const TerrainTiles::ResidentTile& tile, uint32_t lod, uint32_t x, uint32_t z) const;
+    bool   isInFrustum (const Bounds& bounds) const;
+    bool   isInRange   (const Bounds& bounds, float range) const;
+
+    /* The node has cells of the world, the last tiles reach past it. */
+    bool   isInWorld   (const TerrainTiles::ResidentTile& tile, uint32_t lod, uint32_t x, uint32_t z) const;
+
+    glm::uvec2 m_cells;     /* Of the world. */
+    glm::vec2  m_cell_size;
+    uint32_t   m_lods_count;
+
+    float      m_lod_ranges[MAX_LODS];
+    glm::vec2  m_morph_ranges[MAX_LODS];
+    glm::vec4  m_frustum_planes[6];
+    glm::vec3  m_camera_position;
+
+    /* The first cell, the size in cells, and the level and the tile's layer (lod | layer << 8) of every selected node. */
+    std::vector<glm::uvec4> m_selected_nodes;
+
+    GLuint   m_vao_name;
+    GLuint   m_vbo_name;
+    GLuint   m_ibo_name;
+    GLuint   m_nodes_buffer_name;
+    uint32_t m_indices_count;
+    uint32_t m_nodes_capacity;
+};
@@ -0,0 +1,385 @@
+#include "terrain_tiles.hpp"
+#include "terrain_model.hpp"
+#include "terrain_quadtree.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+namespace
+{
+    /* .ttiles file: the header, then the tiles row by row, TILE_TEXELS^2 heights each, row by row along z. */
+    struct TtilesHeader
+    {
+        char     m_magic[4];
+        uint32_t m_version;
+        uint32_t m_tile_cells;
+        uint32_t m_tiles_x;
+        uint32_t m_tiles_z;
+        uint32_t m_cells_x;
+        uint32_t m_cells_z;
+        float    m_cell_size_x;
+        float    m_cell_size_z;
+        uint32_t m_padding;
+    };
+
+    constexpr char     TTILES_MAGIC[4] = { 'R', 'G', 'T', 'T' };
+    constexpr uint32_t TTILES_VERSION  = 1;
+    constexpr size_t   TILE_BYTES      = size_t(TerrainTiles::TILE_TEXELS) * TerrainTiles::TILE_TEXELS * sizeof(float);
+
+    /* The levels of a tile's quadtree, its root covers the whole tile. */
+    constexpr uint32_t GetTileLodsCount()
+    {
+        uint32_t lods_count = 1;
+        while ((TerrainQuadtree::GRID_SIZE << (lods_count - 1)) < TerrainTiles::TILE_CELLS)
+        {
+            ++lods_count;
+        }
+
+        return lods_count;
+    }
+
+    static_assert(TerrainTiles::TILE_CELLS % TerrainQuadtree::GRID_SIZE == 0 && (TerrainQuadtree::GRID_SIZE << (GetTileLodsCount() - 1)) == TerrainTiles::TILE_CELLS,
+                  "TILE_CELLS has to be a power of two multiple of the patch size.");
+}
+
+TerrainTiles::TerrainTiles()
+    : m_cells               (0),
+      m_cell_size           (0.0f),
+      m_tiles_count         (0),
+      m_max_resident_tiles  (0),
+      m_loading_tiles_count (0),
+      m_frame               (0),
+      m_heights_texture_name(0)
+{
+}
+
+TerrainTiles::~TerrainTiles()
+{
+    release();
+}
+
+bool TerrainTiles::bake(const TerrainModel& terrain, const std::filesystem::path& output_filepath)
+{
+    const glm::uvec2 resolution = terrain.getResolution();
+    const float*     heights    = terrain.getHeightsData();
+    const glm::uvec2 cells      = resolution - 1u;
+
+    TtilesHeader header = {};
+    std::memcpy(header.m_magic, TTILES_MAGIC, sizeof(TTILES_MAGIC));
+    header.m_version     = TTILES_VERSION;
+    header.m_tile_cells  = TILE_CELLS;
+    header.m_tiles_x     = (cells.x + TILE_CELLS - 1) / TILE_CELLS;
+    header.m_tiles_z     = (cells.y + TILE_CELLS - 1) / TILE_CELLS;
+    header.m_cells_x     = cells.x;
+    header.m_cells_z     = cells.y;
+    header.m_cell_size_x = terrain.getExtent().x / float(cells.x);
+    header.m_cell_size_z = terrain.getExtent().y / float(cells.y);
+
+    std::ofstream file(output_filepath, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    /* The apron and the cells past the heightmap repeat its edges. */
+    std::vector<float> tile(size_t(TILE_TEXELS) * TILE_TEXELS);
+
+    for (uint32_t tile_z = 0; tile_z < header.m_tiles_z; ++tile_z)
+    {
+        for (uint32_t tile_x = 0; tile_x < header.m_tiles_x; ++tile_x)
+        {
+            for (uint32_t j = 0; j < TILE_TEXELS; ++j)
+            {
+                const int32_t z = std::clamp(int32_t(tile_z * TILE_CELLS + j) - 1, 0, int32_t(cells.y));
+
+                for (uint32_t i = 0; i < TILE_TEXELS; ++i)
+                {
+                    const int32_t x = std::clamp(int32_t(tile_x * TILE_CELLS + i) - 1, 0, int32_t(cells.x));
+
+                    tile[j * TILE_TEXELS + i] = heights[size_t(z) * resolution.x + x];
+                }
+            }
+
+            file.write(reinterpret_cast<const char*>(tile.data()), std::streamsize(TILE_BYTES));
+        }
+    }
+
+    if (!file)
+    {
+        fprintf(stderr, "Could not write the file %s\n", output_filepath.string().c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool TerrainTiles::load(const std::filesystem::path& filepath, uint32_t max_resident_tiles)
+{
+    release();
+
+    if (!m_file.Open(filepath))
+    {
+        fprintf(stderr, "TerrainTiles: could not open %s\n", filepath.string().c_str());
+        return false;
+    }
+
+    TtilesHeader header = {};
+
+    if (m_file.GetSize() >= sizeof(header))
+    {
+        std::memcpy(&header, m_file.GetData(), sizeof(header));
+    }
+
+    if (std::memcmp(header.m_magic, TTILES_MAGIC, sizeof(TTILES_MAGIC)) != 0 || header.m_version != TTILES_VERSION || header.m_tile_cells != TILE_CELLS ||
+        m_file.GetSize() < sizeof(header) + size_t(header.m_tiles_x) * header.m_tiles_z * TILE_BYTES)
+    {
+        fprintf(stderr, "TerrainTiles: %s is not a tiles file of this version.\n", filepath.string().c_str());
+        m_file.Close();
+        return false;
+    }
+
+    m_cells              = glm::uvec2(header.m_cells_x, header.m_cells_z);
+    m_cell_size          = glm::vec2(header.m_cell_size_x, header.m_cell_size_z);
+    m_tiles_count        = glm::uvec2(header.m_tiles_x, header.m_tiles_z);
+    m_max_resident_tiles = std::max(max_resident_tiles, 1u);
+
+    glCreateTextures   (GL_TEXTURE_2D_ARRAY, 1, &m_heights_texture_name);
+    glTextureStorage3D (m_heights_texture_name, 1, GL_R32F, TILE_TEXELS, TILE_TEXELS, m_max_resident_tiles);
+    glTextureParameteri(m_heights_texture_name, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(m_heights_texture_name, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(m_heights_texture_name, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+    glTextureParameteri(m_heights_texture_name, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+
+    for (uint32_t layer = m_max_resident_tiles; layer > 0; --layer)
+    {
+        m_free_layers.push_back(layer - 1);
+    }
+
+    return true;
+}
+
+void TerrainTiles::release()
+{
+    /* The jobs read the mapping and write the tiles. */
+    RGL::JobSystem::Wait(m_jobs);
+
+    m_tiles.clear();
+    m_resident_tiles.clear();
+    m_free_layers.clear();
+    m_file.Close();
+
+    m_loading_tiles_count = 0;
+
+    if (m_heights_texture_name != 0)
+    {
+        glDeleteTextures(1, &m_heights_texture_name);
+        m_heights_texture_name = 0;
+    }
+}
+
+float TerrainTiles::getTileDistance(const glm::uvec2& tile, const glm::vec2& camera_position) const
+{
+    const glm::vec2 cells_min = glm::vec2(tile * TILE_CELLS);
+    const glm::vec2 cells_max = glm::min(cells_min + float(TILE_CELLS), glm::vec2(m_cells));
+
+    /* The cells grow along -x and -z. */
+    const glm::vec2 local_min = -cells_max * m_cell_size;
+    const glm::vec2 local_max = -cells_min * m_cell_size;
+
+    return glm::distance(glm::clamp(camera_position, local_min, local_max), camera_position);
+}
+
+void TerrainTiles::update(const glm::vec3& camera_position, uint32_t max_uploads)
+{
+    if (!m_file.IsOpen())
+    {
+        return;
+    }
+
+    ++m_frame;
+
+    /* The tiles within the radius, at most the resident ones' count of the nearest. */
+    const glm::vec2 camera_xz    = glm::vec2(camera_position.x, camera_position.z);
+    const glm::vec2 camera_cells = -camera_xz / m_cell_size;
+    const glm::vec2 radius_cells = m_streaming_radius / m_cell_size;
+
+    const glm::ivec2 first_tile = glm::max(glm::ivec2(glm::floor((camera_cells - radius_cells) / float(TILE_CELLS))), glm::ivec2(0));
+    const glm::ivec2 last_tile  = glm::min(glm::ivec2(glm::floor((camera_cells + radius_cells) / float(TILE_CELLS))), glm::ivec2(m_tiles_count) - 1);
+
+    std::vector<std::pair<float, glm::uvec2>> wanted_tiles;
+
+    for (int32_t z = first_tile.y; z <= last_tile.y; ++z)
+    {
+        for (int32_t x = first_tile.x; x <= last_tile.x; ++x)
+        {
+            const float distance = getTileDistance(glm::uvec2(x, z), camera_xz);
+
+            if (distance <= m_streaming_radius)
+            {
+                wanted_tiles.emplace_back(distance, glm::uvec2(x, z));
+            }
+        }
+    }
+
+    std::sort(wanted_tiles.begin(), wanted_tiles.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    wanted_tiles.resize(std::min<size_t>(wanted_tiles.size(), m_max_resident_tiles));
+
+    for (const auto& [distance, tile_index] : wanted_tiles)
+    {
+        auto& tile = m_tiles[getTileKey(tile_index)];
+
+        if (!tile)
+        {
+            if (m_loading_tiles_count >= MAX_LOADING_TILES)
+            {
+                m_tiles.erase(getTileKey(tile_index));
+                continue;
+            }
+
+            tile         = std::make_unique<Tile>();
+            tile->m_tile = tile_index;
+
+            ++m_loading_tiles_count;
+            RGL::JobSystem::Run([this, tile = tile.get()] { loadTile(*tile); }, &m_jobs);
+        }
+
+        tile->m_last_wanted = m_frame;
+    }
+
+    /* The loaded tiles, that are still wanted, to the layers. */
+    for (auto it = m_tiles.begin(); it != m_tiles.end();)
+    {
+        Tile& tile = *it->second;
+
+        if (tile.m_layer >= 0 || !tile.m_is_loaded.load(std::memory_order_acquire))
+        {
+            ++it;
+            continue;
+        }
+
+        if (tile.m_last_wanted != m_frame)
+        {
+            --m_loading_tiles_count;
+            it = m_tiles.erase(it);
+            continue;
+        }
+
+        if (max_uploads > 0 && (!m_free_layers.empty() || evictTile()))
+        {
+            uploadTile(tile);
+
+            --m_loading_tiles_count;
+            --max_uploads;
+        }
+
+        ++it;
+    }
+
+    m_resident_tiles.clear();
+
+    for (const auto& [key, tile] : m_tiles)
+    {
+        if (tile->m_layer >= 0)
+        {
+            m_resident_tiles.push_back({ tile->m_tile, uint32_t(tile->m_layer), &tile->m_min_max_heights });
+        }
+    }
+}
+
+void TerrainTiles::loadTile(Tile& tile) const
+{
+    const size_t offset = sizeof(TtilesHeader) + (size_t(tile.m_tile.y) * m_tiles_count.x + tile.m_tile.x) * TILE_BYTES;
+
+    tile.m_heights.resize(size_t(TILE_TEXELS) * TILE_TEXELS);
+    std::memcpy(tile.m_heights.data(), m_file.GetData() + offset, TILE_BYTES);
+
+    /* The leaves from the heights of their vertices, past the apron, the coarser levels from their children. */
+    constexpr uint32_t lods_count = GetTileLodsCount();
+    tile.m_min_max_heights.resize(lods_count);
+
+    for (uint32_t lod = 0; lod < lods_count; ++lod)
+    {
+        const uint32_t node_cells  = TerrainQuadtree::GRID_SIZE << lod;
+        const uint32_t nodes_count = TILE_CELLS / node_cells;
+
+        tile.m_min_max_heights[lod].resize(nodes_count * nodes_count);
+
+        for (uint32_t z = 0; z < nodes_count; ++z)
+        {
+            for (uint32_t x = 0; x < nodes_count; ++x)
+            {
+                glm::vec2 min_max = glm::vec2(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest());
+
+                if (lod == 0)
+                {
+                    for (uint32_t j = z * node_cells; j <= (z + 1) * node_cells; ++j)
+                    {
+                        for (uint32_t i = x * node_cells; i <= (x + 1) * node_cells; ++i)
+                        {
+                            const float h = tile.m_heights[(j + 1) * TILE_TEXELS + i + 1];
+
+                            min_max.x = std::min(min_max.x, h);
+                            min_max.y = std::max(min_max.y, h);
+                        }
+                    }
+                }
+                else
+                {
+                    for (uint32_t cz = 2 * z; cz < 2 * z + 2; ++cz)
+                    {
+                        for (uint32_t cx = 2 * x; cx < 2 * x + 2; ++cx)
+                        {
+                            const glm::vec2& child = tile.m_min_max_heights[lod - 1][cz * nodes_count * 2 + cx];
+
+                            min_max.x = std::min(min_max.x, child.x);
+                            min_max.y = std::max(min_max.y, child.y);
+                        }
+                    }
+                }
+
+                tile.m_min_max_heights[lod][z * nodes_count + x] = min_max;
+            }
+        }
+    }
+
+    tile.m_is_loaded.store(true, std::memory_order_release);
+}
+
+void TerrainTiles::uploadTile(Tile& tile)
+{
+    tile.m_layer = int32_t(m_free_layers.back());
+    m_free_layers.pop_back();
+
+    glTextureSubImage3D(m_heights_texture_name, 0, 0, 0, tile.m_layer, TILE_TEXELS, TILE_TEXELS, 1, GL_RED, GL_FLOAT, tile.m_heights.data());
+
+    /* The GPU copy is the only one needed from now on. */
+    tile.m_heights = {};
+}
+
+bool TerrainTiles::evictTile()
+{
+    auto lru = m_tiles.end();
+
+    for (auto it = m_tiles.begin(); it != m_tiles.end(); ++it)
+    {
+        if (it->second->m_layer >= 0 && it->second->m_last_wanted != m_frame && (lru == m_tiles.end() || it->second->m_last_wanted < lru->second->m_last_wanted))
+        {
+            lru = it;
+        }
+    }
+
+    if (lru == m_tiles.end())
+    {
+        return false;
+    }
+
+    m_free_layers.push_back(uint32_t(lru->second->m_layer));
+    m_tiles.erase(lru);
+
+    return true;
+}
+
+void TerrainTiles::bind(GLuint unit) const
+{
+    glBindTextureUnit(unit, m_heights_texture_name);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <job_system.h>
+#include <mapped_file.h>
+
+class TerrainModel;
+
+/*
+ * Streamed terrain heights, so the world doesn't have to fit the memory as a whole. The world is split into tiles of
+ * TILE_CELLS x TILE_CELLS cells, read from a .ttiles file (bake()) through a memory mapping:
+ *   - update() wants the tiles within m_streaming_radius of the camera, at most getMaxResidentTiles() nearest of them,
+ *     and loads the missing ones nearest first with jobs - a job reads the tile out of the mapping (the disk reads
+ *     happen there, not on the render thread) and builds its min/max heights for TerrainQuadtree,
+ *   - at most max_uploads loaded tiles per frame are copied to a free layer of the heights texture array,
+ *     evicting the least recently wanted tile if there's none.
+ * Every tile has an apron of a texel from its neighbours, so the heights filter across the tiles. The normals aren't
+ * streamed, TerrainMaps bakes them.
+ *
+ * Positions are in the terrain's local space, the one of TerrainModel's vertices: the cells grow along -x and -z.
+ */
+class TerrainTiles
+{
+public:
+    static constexpr uint32_t TILE_CELLS        = 256; /* A power of two multiple of TerrainQuadtree::GRID_SIZE. */
+    static constexpr uint32_t TILE_TEXELS       = TILE_CELLS + 3;
+    static constexpr uint32_t MAX_LOADING_TILES = 8;
+
+    struct ResidentTile
+    {
+        glm::uvec2 m_tile;
+        uint32_t   m_layer;
+
+        /* Per level of the tile's quadtree, the min and max height of every node, row by row. */
+        const std::vector<std::vector<glm::vec2>>* m_min_max_heights;
+    };
+
+    TerrainTiles();
+    ~TerrainTiles();
+
+    TerrainTiles           (const TerrainTiles&) = delete;
+    TerrainTiles& operator=(const TerrainTiles&) = delete;
+
+    /* Writes the heights of the terrain as a .ttiles file. */
+    static bool bake(const TerrainModel& terrain, const std::filesystem::path& output_filepath);
+
+    bool load(const std::filesystem::path& filepath, uint32_t max_resident_tiles = 64);
+
+    /* Once per frame, before TerrainQuadtree::select(). */
+    void update(const glm::vec3& camera_position, uint32_t max_uploads = 2);
+
+    /* The heights texture array, for terrain_cdlod.vert. */
+    void bind(GLuint unit) const;
+
+    const std::vector<ResidentTile>& getResidentTiles() const { return m_resident_tiles; }
+
+    glm::uvec2 getCells()             const { return m_cells; }
+    glm::vec2  getCellSize()          const { return m_cell_size; }
+    glm::uvec2 getTilesCount()        const { return m_tiles_count; }
+    uint32_t   getResidentTilesCount() const { return uint32_t(m_resident_tiles.size()); }
+    uint32_t   getMaxResidentTiles()  const { return m_max_resident_tiles; }
+    uint32_t   getLoadingTilesCount() const { return m_loading_tiles_count; }
+
+    /* Of the heights texture array. */
+    size_t getTextureBytes() const { return size_t(TILE_TEXELS) * TILE_TEXELS * sizeof(float) * m_max_resident_tiles; }
+
+    float m_streaming_radius = 400.0f;
+
+private:
+    struct Tile
+    {
+        glm::uvec2                          m_tile;
+        std::vector<float>                  m_heights;         /* Until the upload. */
+        std::vector<std::vector<glm::vec2>> m_min_max_heights;
+        std::atomic<bool>                   m_is_loaded   { false };
+        int32_t                             m_layer       = -1;
+        uint32_t                            m_last_wanted = 0;
+    };
+
+    void release();
+
+    void loadTile  (Tile& tile) const;
+    void uploadTile(Tile& tile);
+    bool evictTile ();
+
+    uint64_t getTileKey(const glm::uvec2& tile) const { return uint64_t(tile.y) * m_tiles_count.x + tile.x; }
+
+    /* The distance along xz from the camera to the tile. */
+    float getTileDistance(const glm::uvec2& tile, const glm::vec2& camera_position) const;
+
+    RGL::MappedFile m_file;
+
+    std::unordered_map<uint64_t, std::unique_ptr<Tile>> m_tiles;
+    std::vector<ResidentTile>                           m_resident_tiles;
+    std::vector<uint32_t>                               m_free_layers;
+    RGL::JobSystem::Counter                             m_jobs;
+
+    glm::uvec2 m_cells;
+    glm::vec2  m_cell_size;
+    glm::uvec2 m_tiles_count;
+    uint32_t   m_max_resident_tiles;
+    uint32_t   m_loading_tiles_count;
+    uint32_t   m_frame;
+
+    GLuint m_heights_texture_name;
+};
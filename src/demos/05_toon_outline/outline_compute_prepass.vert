@@ -0,0 +1,18 @@
+#version 460 core
+layout (location = 0) in vec3 in_pos;
+layout (location = 2) in vec3 in_normal;
+
+uniform mat4 mvp;
+uniform mat3 normal_matrix_view_space;
+
+out vec3 view_normal;
+
+/* The same position as toon.vert, the shading pass is depth tested against the pre-pass with GL_LEQUAL. */
+invariant gl_Position;
+
+void main()
+{
+    view_normal = normal_matrix_view_space * in_normal;
+
+    gl_Position = mvp * vec4(in_pos, 1.0);
+}
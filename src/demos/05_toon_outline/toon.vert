@@ -11,6 +11,8 @@ out vec3 world_pos;
 out vec3 normal;
 out vec2 texcoord;
 
+invariant gl_Position;
+
 void main()
 {
     world_pos = vec3(model * vec4(in_pos, 1.0));
@@ -33,7 +33,11 @@ ToonOutline::ToonOutline()
       m_depth_normal_threshold            (0.5),
       m_depth_normal_threshold_scale      (7.0),
       m_normal_threshold                  (0.4),
-      m_ps_outline_width                  (1.0)
+      m_ps_outline_width                  (1.0),
+      m_fbo_prepass                       (0),
+      m_fbo_compute_shading               (0),
+      m_prepass_normals_tex               (0),
+      m_prepass_depth_tex                 (0)
 {
     m_light_direction = calcDirection(m_dir_light_azimuth_elevation_angles);
 }
@@ -75,6 +79,30 @@ ToonOutline::~ToonOutline()
         glDeleteTextures(1, &m_shading_tex_buffer);
         m_shading_tex_buffer = 0;
     }
+
+    if (m_fbo_prepass != 0)
+    {
+        glDeleteFramebuffers(1, &m_fbo_prepass);
+        m_fbo_prepass = 0;
+    }
+
+    if (m_fbo_compute_shading != 0)
+    {
+        glDeleteFramebuffers(1, &m_fbo_compute_shading);
+        m_fbo_compute_shading = 0;
+    }
+
+    if (m_prepass_normals_tex != 0)
+    {
+        glDeleteTextures(1, &m_prepass_normals_tex);
+        m_prepass_normals_tex = 0;
+    }
+
+    if (m_prepass_depth_tex != 0)
+    {
+        glDeleteTextures(1, &m_prepass_depth_tex);
+        m_prepass_depth_tex = 0;
+    }
 }
 
 void ToonOutline::init_app()
@@ -90,6 +118,7 @@ void ToonOutline::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(1.5, 0.0, 10.0);
 
     /* Create models. */
@@ -208,8 +237,31 @@ void ToonOutline::init_app()
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glBindTexture(GL_TEXTURE_2D, 0);
 
+    /* Create the depth pre-pass framebuffer, the toon shading is drawn over its depth into the shading texture */
+    glCreateTextures  (GL_TEXTURE_2D, 1, &m_prepass_normals_tex);
+    glTextureStorage2D(m_prepass_normals_tex, 1, GL_RGBA8, RGL::Window::getWidth(), RGL::Window::getHeight());
+
+    glCreateTextures  (GL_TEXTURE_2D, 1, &m_prepass_depth_tex);
+    glTextureStorage2D(m_prepass_depth_tex, 1, GL_DEPTH_COMPONENT32F, RGL::Window::getWidth(), RGL::Window::getHeight());
+
+    for (GLuint texture : { m_prepass_normals_tex, m_prepass_depth_tex })
+    {
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+    }
+
+    glCreateFramebuffers     (1, &m_fbo_prepass);
+    glNamedFramebufferTexture(m_fbo_prepass, GL_COLOR_ATTACHMENT0, m_prepass_normals_tex, 0);
+    glNamedFramebufferTexture(m_fbo_prepass, GL_DEPTH_ATTACHMENT,  m_prepass_depth_tex,   0);
+
+    glCreateFramebuffers     (1, &m_fbo_compute_shading);
+    glNamedFramebufferTexture(m_fbo_compute_shading, GL_COLOR_ATTACHMENT0, m_shading_tex_buffer, 0);
+    glNamedFramebufferTexture(m_fbo_compute_shading, GL_DEPTH_ATTACHMENT,  m_prepass_depth_tex,  0);
+
     /* Create the outline shaders. */
-    m_outline_methods_names = { "Stencil", "Post-Process" };
+    m_outline_methods_names = { "Stencil", "Post-Process", "Compute" };
 
     m_stencil_outline_shader = std::make_shared<RGL::Shader>(dir + "outline_stencil.vert", dir + "outline_stencil.frag");
     m_stencil_outline_shader->link();
@@ -219,6 +271,12 @@ void ToonOutline::init_app()
 
     m_outline_ps_shader = std::make_shared<RGL::Shader>(dir + "outline_ps.vert", dir + "outline_ps.frag");
     m_outline_ps_shader->link();
+
+    m_prepass_outline_shader = std::make_shared<RGL::Shader>(dir + "outline_compute_prepass.vert", dir + "outline_ps_gen_data.frag");
+    m_prepass_outline_shader->link();
+
+    m_outline_compute_shader = std::make_shared<RGL::Shader>(dir + "outline_compute.comp");
+    m_outline_compute_shader->link();
 }
 
 void ToonOutline::input()
@@ -263,6 +321,11 @@ void ToonOutline::render()
     {
         ps_outline();
     }
+
+    if (m_outline_method == OutlineMethod::COMPUTE)
+    {
+        compute_outline();
+    }
 }
 
 void ToonOutline::stencil_outline()
@@ -285,7 +348,7 @@ void ToonOutline::stencil_outline()
     m_stencil_outline_shader->setUniform("outline_color", m_outline_color);
     m_stencil_outline_shader->setUniform("screen_resolution", RGL::Window::getSize());
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+    auto view_projection = m_camera->viewProjection();
 
     for (unsigned i = 0; i < m_objects.size(); ++i)
     {
@@ -355,6 +418,67 @@ void ToonOutline::ps_outline()
     glDrawArrays(GL_TRIANGLES, 0, 3);
 }
 
+void ToonOutline::compute_outline()
+{
+    /* Depth pre-pass with the view space normals */
+    const float clear_normal[4] = { 0.0, 0.0, 0.0, 0.0 };
+    const float clear_depth     = 1.0;
+
+    glBindFramebuffer        (GL_FRAMEBUFFER, m_fbo_prepass);
+    glClearNamedFramebufferfv(m_fbo_prepass, GL_COLOR, 0, clear_normal);
+    glClearNamedFramebufferfv(m_fbo_prepass, GL_DEPTH, 0, &clear_depth);
+
+    m_prepass_outline_shader->bind();
+
+    auto view            = m_camera->m_view;
+    auto view_projection = m_camera->m_projection * view;
+
+    for (unsigned i = 0; i < m_objects.size(); ++i)
+    {
+        auto normal_matrix = glm::transpose(glm::inverse(view * m_objects_model_matrices[i]));
+
+        m_prepass_outline_shader->setUniform("mvp",                      view_projection * m_objects_model_matrices[i]);
+        m_prepass_outline_shader->setUniform("normal_matrix_view_space", glm::mat3(normal_matrix));
+
+        m_objects[i].Render();
+    }
+
+    /* Shade the visible fragments only, the depth mask keeps the pre-pass depth from the clear too */
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_compute_shading);
+    glDepthFunc(GL_LEQUAL);
+    glDepthMask(GL_FALSE);
+
+    render_toon_shaded_objects();
+
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+
+    /* The outlines are blended into the shading in place, a single pass over the screen */
+    m_outline_compute_shader->bind();
+    m_outline_compute_shader->setUniform("u_clip_to_view",                 m_camera->inverseProjection());
+    m_outline_compute_shader->setUniform("u_outline_width",                int(m_ps_outline_width));
+    m_outline_compute_shader->setUniform("u_outline_color",                m_outline_color);
+    m_outline_compute_shader->setUniform("u_depth_threshold",              m_depth_threshold);
+    m_outline_compute_shader->setUniform("u_depth_normal_threshold",       m_depth_normal_threshold);
+    m_outline_compute_shader->setUniform("u_depth_normal_threshold_scale", m_depth_normal_threshold_scale);
+    m_outline_compute_shader->setUniform("u_normal_threshold",             m_normal_threshold);
+
+    glBindTextureUnit (0, m_prepass_depth_tex);
+    glBindTextureUnit (1, m_prepass_normals_tex);
+    glBindImageTexture(0, m_shading_tex_buffer, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA8);
+
+    glDispatchCompute((RGL::Window::getWidth()  + OUTLINE_TILE_SIZE - 1) / OUTLINE_TILE_SIZE,
+                      (RGL::Window::getHeight() + OUTLINE_TILE_SIZE - 1) / OUTLINE_TILE_SIZE,
+                      1);
+    glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+
+    glBindFramebuffer     (GL_FRAMEBUFFER, 0);
+    glBlitNamedFramebuffer(m_fbo_compute_shading, 0,
+                           0, 0, RGL::Window::getWidth(), RGL::Window::getHeight(),
+                           0, 0, RGL::Window::getWidth(), RGL::Window::getHeight(),
+                           GL_COLOR_BUFFER_BIT, GL_NEAREST);
+}
+
 void ToonOutline::render_toon_shaded_objects()
 {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -401,7 +525,7 @@ void ToonOutline::render_toon_shaded_objects()
         m_toon_shaders[toon_shader_id]->setUniform("dark_shade_cutoff", m_twin_shade_dark_shade_cutoff);
     }
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+    auto view_projection = m_camera->viewProjection();
 
     for (unsigned i = 0; i < m_objects.size(); ++i)
     {
@@ -478,6 +602,7 @@ void ToonOutline::render_gui()
                             glEnable(GL_STENCIL_TEST);
                             break;
                         case OutlineMethod::POSTPROCESS:
+                        case OutlineMethod::COMPUTE:
                             glDisable(GL_STENCIL_TEST);
                             break;
                     }
@@ -538,7 +663,7 @@ void ToonOutline::render_gui()
             ImGui::SliderFloat("Outline width", &m_stencil_outline_width, 0.0, 100.0, "%.1f");
         }
 
-        if (m_outline_method == OutlineMethod::POSTPROCESS)
+        if (m_outline_method == OutlineMethod::POSTPROCESS || m_outline_method == OutlineMethod::COMPUTE)
         {
             ImGui::SliderFloat("Outline width",                &m_ps_outline_width,             0.0, 10.0, "%.0f");
             ImGui::SliderFloat("Depth threshold",              &m_depth_threshold,              0.0, 10.0, "%.1f");
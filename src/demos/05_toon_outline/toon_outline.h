@@ -24,6 +24,7 @@ private:
     void render_toon_shaded_objects();
     void stencil_outline();
     void ps_outline();
+    void compute_outline();
 
     glm::vec3 calcDirection(const glm::vec2 & azimuth_elevation_angles)
     {
@@ -87,7 +88,7 @@ private:
     float m_twin_shade_dark_shade_cutoff;
 
     /* Stencil outline properties */
-    enum class OutlineMethod { STENCIL, POSTPROCESS} m_outline_method;
+    enum class OutlineMethod { STENCIL, POSTPROCESS, COMPUTE } m_outline_method;
     std::vector<std::string> m_outline_methods_names;
 
     glm::vec3 m_outline_color;
@@ -111,4 +112,15 @@ private:
     float m_depth_normal_threshold_scale;
     float m_normal_threshold;
     float m_ps_outline_width;
+
+    /* GL objects for outlines from the depth pre-pass in a compute pass, it shares the thresholds and the width above */
+    GLuint m_fbo_prepass;
+    GLuint m_fbo_compute_shading;
+    GLuint m_prepass_normals_tex;
+    GLuint m_prepass_depth_tex;
+
+    static constexpr uint32_t OUTLINE_TILE_SIZE = 16; // TILE_SIZE of outline_compute.comp.
+
+    std::shared_ptr<RGL::Shader> m_prepass_outline_shader;
+    std::shared_ptr<RGL::Shader> m_outline_compute_shader;
 };
\ No newline at end of file
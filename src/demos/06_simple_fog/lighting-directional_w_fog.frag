@@ -11,23 +11,17 @@ uniform float fog_max_distance;
 uniform float fog_density;
 uniform vec3  fog_color;
 
-subroutine float FogEquation(float distance_to_camera);           /* Subroutine Type     */
-layout(location = 0) subroutine uniform FogEquation fog_equation; /* Subroutine uniform  */
-
-layout(index = 0) subroutine(FogEquation) float fog_factor_linear(float distance_to_camera)
-{
-    return (fog_max_distance - distance_to_camera) / (fog_max_distance - fog_min_distance);
-}
-
-layout(index = 1) subroutine(FogEquation) float fog_factor_exp(float distance_to_camera)
+// The equation is a variant of the program, FOG_EXP or FOG_EXP2 defined by the demo - linear without them.
+float fogFactor(float distance_to_camera)
 {
+#if defined(FOG_EXP)
     return exp(-fog_density * distance_to_camera);
-}
-
-layout(index = 2) subroutine(FogEquation) float fog_factor_exp2(float distance_to_camera)
-{
+#elif defined(FOG_EXP2)
     float exponent = fog_density * distance_to_camera;
     return exp(-exponent * exponent);
+#else
+    return (fog_max_distance - distance_to_camera) / (fog_max_distance - fog_min_distance);
+#endif
 }
 
 void main()
@@ -36,7 +30,7 @@ void main()
     vec4 directional_light_contribution = calcDirectionalLight(directional_light, normalize(normal), world_pos);
 
     float distance_to_cam = distance(world_pos, cam_pos);
-    float fog_factor = fog_equation(distance_to_cam);
+    float fog_factor = fogFactor(distance_to_cam);
           fog_factor = clamp(fog_factor, 0.0, 1.0);
 
     vec4 light_color = reinhard((ambient + directional_light_contribution) * vec4(object_color, 1.0));
@@ -37,6 +37,7 @@ void SimpleFog::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(1.5, 0.0, 3.0);
 
     /* Initialize lights' properties */
@@ -69,8 +70,12 @@ void SimpleFog::init_app()
     std::string dir          = "src/demos/06_simple_fog/";
     std::string dir_lighting = "src/demos/03_lighting/";
 
-    m_directional_light_shader = std::make_shared<RGL::Shader>(dir_lighting + "lighting.vert", dir + "lighting-directional_w_fog.frag");
-    m_directional_light_shader->link();
+    /* A variant per fog equation, the linear one has no define. */
+    auto create_shader = [=] { return std::make_shared<RGL::Shader>(dir_lighting + "lighting.vert", dir + "lighting-directional_w_fog.frag"); };
+    m_directional_light_shaders = std::make_shared<RGL::ShaderPermutations>(create_shader, std::vector<std::string>{ "FOG_EXP", "FOG_EXP2" });
+
+    m_fog_equation_masks = { 0, m_directional_light_shaders->GetBit("FOG_EXP"), m_directional_light_shaders->GetBit("FOG_EXP2") };
+    m_directional_light_shaders->Prepare({ m_fog_equation_masks[0], m_fog_equation_masks[1], m_fog_equation_masks[2] });
 }
 
 void SimpleFog::input()
@@ -126,47 +131,46 @@ void SimpleFog::render()
     /* Put render specific code here. Don't update variables here! */
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+    auto view_projection = m_camera->viewProjection();
 
     /* Render directional light(s) */
-    m_directional_light_shader->bind();
+    RGL::Shader& shader = m_directional_light_shaders->Get(m_fog_equation_masks[int(m_fog_equation)]);
+    shader.bind();
 
-    m_directional_light_shader->setUniform("directional_light.base.color",     m_dir_light_properties.color);
-    m_directional_light_shader->setUniform("directional_light.base.intensity", m_dir_light_properties.intensity);
-    m_directional_light_shader->setUniform("directional_light.direction",      m_dir_light_properties.direction);
+    shader.setUniform("directional_light.base.color",     m_dir_light_properties.color);
+    shader.setUniform("directional_light.base.intensity", m_dir_light_properties.intensity);
+    shader.setUniform("directional_light.direction",      m_dir_light_properties.direction);
     
-    m_directional_light_shader->setUniform("cam_pos",            m_camera->position());
-    m_directional_light_shader->setUniform("specular_intensity", m_specular_intenstiy.x);
-    m_directional_light_shader->setUniform("specular_power",     m_specular_power.x);
-    m_directional_light_shader->setUniform("gamma",              m_gamma);
-    m_directional_light_shader->setUniform("ambient_factor",     m_ambient_factor);
-
-    m_directional_light_shader->setUniform("fog_color",        m_fog_color);
+    shader.setUniform("cam_pos",            m_camera->position());
+    shader.setUniform("specular_intensity", m_specular_intenstiy.x);
+    shader.setUniform("specular_power",     m_specular_power.x);
+    shader.setUniform("gamma",              m_gamma);
+    shader.setUniform("ambient_factor",     m_ambient_factor);
 
-    m_directional_light_shader->setSubroutine(RGL::Shader::ShaderType::FRAGMENT, m_fog_equation_names[int(m_fog_equation)]);
+    shader.setUniform("fog_color",        m_fog_color);
 
     if (m_fog_equation == FogEquation::LINEAR)
     {
-        m_directional_light_shader->setUniform("fog_min_distance", m_fog_distances.x);
-        m_directional_light_shader->setUniform("fog_max_distance", m_fog_distances.y);
+        shader.setUniform("fog_min_distance", m_fog_distances.x);
+        shader.setUniform("fog_max_distance", m_fog_distances.y);
     }
 
     if (m_fog_equation == FogEquation::EXP)
     {
-        m_directional_light_shader->setUniform("fog_density", m_fog_density_exp);
+        shader.setUniform("fog_density", m_fog_density_exp);
     }
 
     if (m_fog_equation == FogEquation::EXP2)
     {
-        m_directional_light_shader->setUniform("fog_density", m_fog_density_exp2);
+        shader.setUniform("fog_density", m_fog_density_exp2);
     }
 
     for (unsigned i = 0; i < m_objects_model_matrices.size(); ++i)
     {
-        m_directional_light_shader->setUniform("model",         m_objects_model_matrices[i]);
-        m_directional_light_shader->setUniform("normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_objects_model_matrices[i]))));
-        m_directional_light_shader->setUniform("mvp",           view_projection * m_objects_model_matrices[i]);
-        m_directional_light_shader->setUniform("object_color",  m_objects_colors[i]);
+        shader.setUniform("model",         m_objects_model_matrices[i]);
+        shader.setUniform("normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_objects_model_matrices[i]))));
+        shader.setUniform("mvp",           view_projection * m_objects_model_matrices[i]);
+        shader.setUniform("object_color",  m_objects_colors[i]);
 
         m_objects[0].Render();
     }
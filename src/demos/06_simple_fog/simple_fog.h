@@ -4,6 +4,7 @@
 #include "camera.h"
 #include "static_model.h"
 #include "shader.h"
+#include "shader_permutations.h"
 
 #include <memory>
 #include <vector>
@@ -45,7 +46,7 @@ public:
 
 private:
     std::shared_ptr<RGL::Camera> m_camera;
-    std::shared_ptr<RGL::Shader> m_directional_light_shader;
+    std::shared_ptr<RGL::ShaderPermutations> m_directional_light_shaders;
 
     std::vector<RGL::StaticModel> m_objects;
     std::vector<glm::mat4> m_objects_model_matrices;
@@ -69,4 +70,5 @@ private:
 
     enum class FogEquation { LINEAR, EXP, EXP2 } m_fog_equation;
     std::vector<std::string> m_fog_equation_names;
+    uint64_t m_fog_equation_masks[3];
 };
\ No newline at end of file
@@ -1,26 +1,59 @@
 #include "alpha_cutout.h"
 #include "filesystem.h"
+#include "gl_state.h"
 #include "input.h"
+#include "profiler.h"
 #include "util.h"
 #include "gui/gui.h"
 
 #include <glm/gtc/matrix_inverse.hpp>
-#include <random>
+#include <algorithm>
 
-#include "poisson_disk_sampling.h"
+#include "foliage_shared.h"
 
 AlphaCutout::AlphaCutout()
-    : m_specular_power         (120.0f),
-      m_specular_intenstiy     (0.0f),
-      m_ambient_factor         (0.18f),
-      m_gamma                  (2.2),
-      m_dir_light_angles       (0.0f, 50.0f),
-      m_alpha_cutout_threshold (0.15)
+    : m_hiz_view_projection          (1.0f),
+      m_pine_bounds                  (0.0f),
+      m_cells_buffer_name            (0),
+      m_instances_buffer_name        (0),
+      m_counter_buffer_name          (0),
+      m_commands_template_buffer_name(0),
+      m_commands_buffer_name         (0),
+      m_visible_instances_buffer_name(0),
+      m_impostor_command_buffer_name (0),
+      m_visible_impostors_buffer_name(0),
+      m_dummy_vao_name               (0),
+      m_commands_count               (0),
+      m_instances_count              (0),
+      m_foliage_seed                 (1),
+      m_poisson_radius               (1.5f),
+      m_max_distance                 (150.0f),
+      m_impostor_distance            (40.0f),
+      m_impostor_fade_range          (8.0f),
+      m_is_impostors_enabled         (true),
+      m_is_frustum_culling_enabled   (true),
+      m_is_occlusion_culling_enabled (true),
+      m_is_hiz_valid                 (false),
+      m_specular_power               (120.0f),
+      m_specular_intenstiy           (0.0f),
+      m_ambient_factor               (0.18f),
+      m_gamma                        (2.2),
+      m_dir_light_angles             (0.0f, 50.0f),
+      m_alpha_cutout_threshold       (0.15)
 {
 }
 
 AlphaCutout::~AlphaCutout()
 {
+    glDeleteBuffers(1, &m_cells_buffer_name);
+    glDeleteBuffers(1, &m_instances_buffer_name);
+    glDeleteBuffers(1, &m_counter_buffer_name);
+    glDeleteBuffers(1, &m_commands_template_buffer_name);
+    glDeleteBuffers(1, &m_commands_buffer_name);
+    glDeleteBuffers(1, &m_visible_instances_buffer_name);
+    glDeleteBuffers(1, &m_impostor_command_buffer_name);
+    glDeleteBuffers(1, &m_visible_impostors_buffer_name);
+    glDeleteVertexArrays(1, &m_dummy_vao_name);
 }
 
 void AlphaCutout::init_app()
@@ -32,7 +65,8 @@ void AlphaCutout::init_app()
     glEnable(GL_MULTISAMPLE);
 
     /* Create virtual camera. */
-    m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.1, 500.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(1.5, 0.0, 3.0);
 
     /* Initialize lights' properties */
@@ -43,29 +77,14 @@ void AlphaCutout::init_app()
     /* Create models. */
     m_pine_tree.Load(RGL::FileSystem::getResourcesPath() / "models/pine/snow_pine_tree.obj");
 
-    constexpr auto kRadius    = 2.5f;
-    constexpr float area_size = 15.0f;
-
-    m_ground_plane.GenPlane(area_size * 2.0 + kRadius, area_size * 2.0 + kRadius, area_size * 2.0, area_size * 2.0);
+    m_ground_plane.GenPlane(AREA_SIZE * 2.0, AREA_SIZE * 2.0, AREA_SIZE * 2.0, AREA_SIZE * 2.0);
 
     m_ground_plane_model = glm::translate(glm::mat4(1.0), glm::vec3(0.0, -0.5, 0.0));
 
-    /* Set model matrices for each model. */
-    constexpr auto kXMin = std::array<float, 2>{ {-area_size, -area_size}};
-    constexpr auto kXMax = std::array<float, 2>{ { area_size,  area_size}};
-
-    const auto samples = thinks::PoissonDiskSampling(kRadius, kXMin, kXMax);
-
-    for (unsigned i = 0; i < samples.size(); ++i)
-    {
-        m_objects_model_matrices.emplace_back(glm::translate(glm::mat4(1.0), glm::vec3(samples[i][0], -0.5, samples[i][1])) * glm::scale(glm::mat4(1.0), glm::vec3(0.02)));
-    }
-   
-
     /* Add textures to the objects. */
-    auto pine_texture = std::make_shared<RGL::Texture2D>();
-    pine_texture->Load(RGL::FileSystem::getResourcesPath() / "models/pine/diffuse_half.tga", true);
-    pine_texture->SetAnisotropy(16);
+    m_pine_texture = std::make_shared<RGL::Texture2D>();
+    m_pine_texture->Load(RGL::FileSystem::getResourcesPath() / "models/pine/diffuse_half.tga", true);
+    m_pine_texture->SetAnisotropy(16);
 
     auto ground_texture = std::make_shared<RGL::Texture2D>();
     ground_texture->Load(RGL::FileSystem::getResourcesPath() / "textures/grass_green_d.jpg", true);
@@ -73,7 +92,7 @@ void AlphaCutout::init_app()
     ground_texture->SetWraping(RGL::TextureWrapingCoordinate::T, RGL::TextureWrapingParam::REPEAT);
     ground_texture->SetAnisotropy(16);
 
-    m_pine_tree.AddTexture(pine_texture);
+    m_pine_tree.AddTexture(m_pine_texture);
     m_ground_plane.AddTexture(ground_texture);
 
     /* Create shader. */
@@ -82,6 +101,236 @@ void AlphaCutout::init_app()
 
     m_directional_light_shader = std::make_shared<RGL::Shader>(dir_lighting + "lighting.vert", dir + "lighting-directional_alpha_cutout.frag");
     m_directional_light_shader->link();
+
+    m_foliage_shader = std::make_shared<RGL::Shader>(dir + "foliage.vert", dir + "foliage.frag");
+    m_foliage_shader->link();
+
+    m_foliage_impostor_shader = std::make_shared<RGL::Shader>(dir + "foliage_impostor.vert", dir + "foliage_impostor.frag");
+    m_foliage_impostor_shader->link();
+
+    m_foliage_place_shader = std::make_shared<RGL::Shader>(dir + "foliage_place.comp");
+    m_foliage_place_shader->link();
+
+    m_foliage_cull_shader = std::make_shared<RGL::Shader>(dir + "foliage_cull.comp");
+    m_foliage_cull_shader->link();
+
+    m_hiz.Create();
+
+    /* Foliage buffers. The commands draw every mesh part of the tree, the culling sets their instance counts. */
+    std::vector<RGL::DrawElementsIndirectCommand> commands = m_pine_tree.GetIndirectCommands();
+
+    for (auto& command : commands)
+    {
+        command.m_instance_count = 0;
+        command.m_base_instance  = 0;
+    }
+
+    m_commands_count = uint32_t(commands.size());
+
+    /* The distant trees are octahedral impostors, the bounds of the whole tree cull both. */
+    m_pine_impostor.Bake(m_pine_tree);
+    m_pine_bounds = m_pine_impostor.GetBounds();
+
+    glCreateBuffers     (1, &m_commands_template_buffer_name);
+    glNamedBufferStorage(m_commands_template_buffer_name, sizeof(commands[0]) * commands.size(), commands.data(), 0);
+
+    glCreateBuffers     (1, &m_commands_buffer_name);
+    glNamedBufferStorage(m_commands_buffer_name, sizeof(commands[0]) * commands.size(), nullptr, 0);
+
+    glCreateBuffers     (1, &m_instances_buffer_name);
+    glNamedBufferStorage(m_instances_buffer_name, sizeof(FoliageInstance) * MAX_INSTANCES, nullptr, 0);
+
+    glCreateBuffers     (1, &m_visible_instances_buffer_name);
+    glNamedBufferStorage(m_visible_instances_buffer_name, sizeof(uint32_t) * MAX_INSTANCES, nullptr, 0);
+
+    /* A DrawArraysIndirectCommand of the impostor quads - count, instance count, first, base instance. */
+    const uint32_t impostor_command[4] = { 4, 0, 0, 0 };
+
+    glCreateBuffers     (1, &m_impostor_command_buffer_name);
+    glNamedBufferStorage(m_impostor_command_buffer_name, sizeof(impostor_command), &impostor_command, GL_DYNAMIC_STORAGE_BIT);
+
+    glCreateBuffers     (1, &m_visible_impostors_buffer_name);
+    glNamedBufferStorage(m_visible_impostors_buffer_name, sizeof(uint32_t) * MAX_INSTANCES, nullptr, 0);
+
+    glCreateVertexArrays(1, &m_dummy_vao_name);
+
+    glCreateBuffers     (1, &m_counter_buffer_name);
+    glNamedBufferStorage(m_counter_buffer_name, sizeof(uint32_t), nullptr, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+
+    glCreateBuffers(1, &m_cells_buffer_name);
+
+    place_foliage();
+}
+
+void AlphaCutout::place_foliage()
+{
+    /* A cell of r / sqrt(2) can hold a single sample only, its conflicts are at most two cells away. */
+    const float      cell_size = m_poisson_radius / glm::sqrt(2.0f);
+    const glm::uvec2 cells     = glm::uvec2(glm::ceil(glm::vec2(2.0f * AREA_SIZE) / cell_size));
+
+    glNamedBufferData     (m_cells_buffer_name, sizeof(glm::vec4) * cells.x * cells.y, nullptr, GL_DYNAMIC_DRAW);
+    glClearNamedBufferData(m_cells_buffer_name,   GL_R32F,  GL_RED,         GL_FLOAT,        nullptr);
+    glClearNamedBufferData(m_counter_buffer_name, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FOLIAGE_CELLS_SSBO_BINDING_INDEX,     m_cells_buffer_name);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FOLIAGE_INSTANCES_SSBO_BINDING_INDEX, m_instances_buffer_name);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FOLIAGE_COUNTER_SSBO_BINDING_INDEX,   m_counter_buffer_name);
+
+    m_foliage_place_shader->bind();
+    m_foliage_place_shader->setUniform("u_cells",           cells);
+    m_foliage_place_shader->setUniform("u_area_min",        glm::vec2(-AREA_SIZE));
+    m_foliage_place_shader->setUniform("u_cell_size",       cell_size);
+    m_foliage_place_shader->setUniform("u_radius",          m_poisson_radius);
+    m_foliage_place_shader->setUniform("u_attempts",        4);
+    m_foliage_place_shader->setUniform("u_max_instances",   MAX_INSTANCES);
+    m_foliage_place_shader->setUniform("u_height",          -0.5f);
+    m_foliage_place_shader->setUniform("u_scale_range",     glm::vec2(0.015f, 0.025f));
+    m_foliage_place_shader->setUniform("u_is_compact_pass", 0);
+
+    /*
+     * Parallel Poisson disk sampling (Wei 2008): the cells FOLIAGE_PHASE_STRIDE apart are too far to conflict,
+     * so each of the 3x3 phases throws darts into its cells at once. A few rounds fill the cells the darts missed.
+     */
+    const glm::uvec2 phase_cells = (cells + uint32_t(FOLIAGE_PHASE_STRIDE) - 1u) / uint32_t(FOLIAGE_PHASE_STRIDE);
+    const glm::uvec2 groups      = (phase_cells + uint32_t(FOLIAGE_PLACE_GROUP_SIZE) - 1u) / uint32_t(FOLIAGE_PLACE_GROUP_SIZE);
+
+    for (uint32_t round = 0; round < PLACEMENT_ROUNDS; ++round)
+    {
+        for (uint32_t phase = 0; phase < FOLIAGE_PHASE_STRIDE * FOLIAGE_PHASE_STRIDE; ++phase)
+        {
+            m_foliage_place_shader->setUniform("u_phase", glm::uvec2(phase % FOLIAGE_PHASE_STRIDE, phase / FOLIAGE_PHASE_STRIDE));
+            m_foliage_place_shader->setUniform("u_seed",  m_foliage_seed * 64u + round);
+
+            glDispatchCompute(groups.x, groups.y, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+    }
+
+    /* The samples to the instances. */
+    m_foliage_place_shader->setUniform("u_is_compact_pass", 1);
+    m_foliage_place_shader->setUniform("u_seed",            m_foliage_seed * 64u + PLACEMENT_ROUNDS);
+
+    glDispatchCompute((cells.x + FOLIAGE_PLACE_GROUP_SIZE - 1) / FOLIAGE_PLACE_GROUP_SIZE, (cells.y + FOLIAGE_PLACE_GROUP_SIZE - 1) / FOLIAGE_PLACE_GROUP_SIZE, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    glGetNamedBufferSubData(m_counter_buffer_name, 0, sizeof(uint32_t), &m_instances_count);
+    m_instances_count = std::min(m_instances_count, MAX_INSTANCES);
+
+    /* The grid is needed only for the placement. */
+    glNamedBufferData(m_cells_buffer_name, 0, nullptr, GL_DYNAMIC_DRAW);
+}
+
+void AlphaCutout::cull_foliage(const glm::mat4& view_projection)
+{
+    RGL::ProfilerScope scope("Foliage culling");
+
+    /* Reset the instance counts. */
+    glCopyNamedBufferSubData  (m_commands_template_buffer_name, m_commands_buffer_name, 0, 0, sizeof(RGL::DrawElementsIndirectCommand) * m_commands_count);
+    glClearNamedBufferSubData(m_impostor_command_buffer_name, GL_R32UI, sizeof(uint32_t) /* instance count */, sizeof(uint32_t), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+    if (m_instances_count == 0)
+    {
+        return;
+    }
+
+    glm::vec4 planes[6];
+    RGL::GpuCulling::ExtractFrustumPlanes(view_projection, planes);
+
+    const bool is_occlusion_culling_enabled = m_is_occlusion_culling_enabled && m_is_hiz_valid;
+
+    GLint hiz_width = 0, hiz_height = 0, hiz_levels_count = 0;
+
+    if (is_occlusion_culling_enabled)
+    {
+        glGetTextureLevelParameteriv(m_hiz.GetHiZTexture(), 0, GL_TEXTURE_WIDTH,  &hiz_width);
+        glGetTextureLevelParameteriv(m_hiz.GetHiZTexture(), 0, GL_TEXTURE_HEIGHT, &hiz_height);
+        glGetTextureParameteriv     (m_hiz.GetHiZTexture(), GL_TEXTURE_IMMUTABLE_LEVELS, &hiz_levels_count);
+    }
+
+    m_foliage_cull_shader->bind();
+    m_foliage_cull_shader->setUniform("u_instances_count",              m_instances_count);
+    m_foliage_cull_shader->setUniform("u_commands_count",               m_commands_count);
+    m_foliage_cull_shader->setUniform("u_bounds",                       m_pine_bounds);
+    m_foliage_cull_shader->setUniform("u_frustum_planes",               planes, 6);
+    m_foliage_cull_shader->setUniform("u_cam_pos",                      m_camera->position());
+    m_foliage_cull_shader->setUniform("u_max_distance",                 m_max_distance);
+    m_foliage_cull_shader->setUniform("u_impostor_distance",            get_impostor_distance());
+    m_foliage_cull_shader->setUniform("u_impostor_fade_range",          m_impostor_fade_range);
+    m_foliage_cull_shader->setUniform("u_hiz_view_projection",          m_hiz_view_projection);
+    m_foliage_cull_shader->setUniform("u_hiz_size",                     glm::vec2(hiz_width, hiz_height));
+    m_foliage_cull_shader->setUniform("u_hiz_levels_count",             hiz_levels_count);
+    m_foliage_cull_shader->setUniform("u_is_frustum_culling_enabled",   int(m_is_frustum_culling_enabled));
+    m_foliage_cull_shader->setUniform("u_is_occlusion_culling_enabled", int(is_occlusion_culling_enabled));
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FOLIAGE_INSTANCES_SSBO_BINDING_INDEX, m_instances_buffer_name);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FOLIAGE_COMMANDS_SSBO_BINDING_INDEX,  m_commands_buffer_name);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FOLIAGE_VISIBLE_SSBO_BINDING_INDEX,   m_visible_instances_buffer_name);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FOLIAGE_IMPOSTOR_COMMAND_SSBO_BINDING_INDEX,  m_impostor_command_buffer_name);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FOLIAGE_VISIBLE_IMPOSTORS_SSBO_BINDING_INDEX, m_visible_impostors_buffer_name);
+    RGL::GLState::BindTextureUnit(FOLIAGE_HIZ_TEXTURE_BINDING_INDEX, is_occlusion_culling_enabled ? m_hiz.GetHiZTexture() : 0);
+
+    glDispatchCompute((m_instances_count + FOLIAGE_CULL_GROUP_SIZE - 1) / FOLIAGE_CULL_GROUP_SIZE, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void AlphaCutout::render_foliage(const glm::mat4& view_projection)
+{
+    RGL::ProfilerScope scope("Foliage");
+
+    for (auto& shader : { m_foliage_shader, m_foliage_impostor_shader })
+    {
+        shader->bind();
+
+        shader->setUniform("directional_light.base.color",     m_dir_light_properties.color);
+        shader->setUniform("directional_light.base.intensity", m_dir_light_properties.intensity);
+        shader->setUniform("directional_light.direction",      m_dir_light_properties.direction);
+
+        shader->setUniform("view_projection",        view_projection);
+        shader->setUniform("cam_pos",                m_camera->position());
+        shader->setUniform("specular_intensity",     m_specular_intenstiy.x);
+        shader->setUniform("specular_power",         m_specular_power.x);
+        shader->setUniform("gamma",                  m_gamma);
+        shader->setUniform("ambient_factor",         m_ambient_factor);
+        shader->setUniform("alpha_cutout_threshold", m_alpha_cutout_threshold);
+        shader->setUniform("u_bounds",               m_pine_bounds);
+        shader->setUniform("u_impostor_distance",    get_impostor_distance());
+        shader->setUniform("u_impostor_fade_range",  m_impostor_fade_range);
+        shader->setUniform("u_is_impostor",          int(shader == m_foliage_impostor_shader));
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FOLIAGE_INSTANCES_SSBO_BINDING_INDEX,         m_instances_buffer_name);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FOLIAGE_VISIBLE_SSBO_BINDING_INDEX,           m_visible_instances_buffer_name);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FOLIAGE_VISIBLE_IMPOSTORS_SSBO_BINDING_INDEX, m_visible_impostors_buffer_name);
+
+    /*
+     * The leaves' edges are antialiased by the coverage, with the early depth test on - there's no discard.
+     * The cross-fade between the meshes and the impostors clears the coverage of the dithered pixels the same way.
+     */
+    glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+
+    m_foliage_shader->bind();
+    m_pine_texture->Bind(0);
+
+    RGL::GLState::BindVertexArray(m_pine_tree.GetVertexArray());
+
+    glBindBuffer               (GL_DRAW_INDIRECT_BUFFER, m_commands_buffer_name);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, m_pine_tree.GetIndexType(), nullptr, GLsizei(m_commands_count), 0 /* stride */);
+
+    if (m_is_impostors_enabled && m_pine_impostor.IsBaked())
+    {
+        m_foliage_impostor_shader->bind();
+        m_foliage_impostor_shader->setUniform("u_impostor_frames", int(m_pine_impostor.GetSettings().m_frames));
+        m_pine_impostor.Bind(FOLIAGE_IMPOSTOR_ALBEDO_TEXTURE_BINDING_INDEX, FOLIAGE_IMPOSTOR_NORMAL_TEXTURE_BINDING_INDEX);
+
+        RGL::GLState::BindVertexArray(m_dummy_vao_name);
+
+        glBindBuffer        (GL_DRAW_INDIRECT_BUFFER, m_impostor_command_buffer_name);
+        glDrawArraysIndirect(GL_TRIANGLE_STRIP, nullptr);
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE);
 }
 
 void AlphaCutout::input()
@@ -135,11 +384,25 @@ void AlphaCutout::update(double delta_time)
 void AlphaCutout::render()
 {
     /* Put render specific code here. Don't update variables here! */
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    const uint32_t width  = uint32_t(RGL::Window::getWidth());
+    const uint32_t height = uint32_t(RGL::Window::getHeight());
+
+    /*
+     * Multisampled for the alpha to coverage. The depth is resolved for the HiZ pyramid of the next frame's culling,
+     * the color goes through the resolve target too - the default framebuffer is multisampled with its own formats.
+     */
+    m_msaa_rt    = RGL::RenderTargetPool::Acquire({ width, height, GL_RGBA8, GL_DEPTH_COMPONENT32F, 1, 4 });
+    m_resolve_rt = RGL::RenderTargetPool::Acquire({ width, height, GL_RGBA8, GL_DEPTH_COMPONENT32F });
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+    auto view_projection = m_camera->viewProjection();
 
-    /* Render directional light(s) */
+    cull_foliage(view_projection);
+
+    m_msaa_rt->Bind();
+
+    render_foliage(view_projection);
+
+    /* Render ground plane */
     m_directional_light_shader->bind();
 
     m_directional_light_shader->setUniform("directional_light.base.color",     m_dir_light_properties.color);
@@ -153,21 +416,20 @@ void AlphaCutout::render()
     m_directional_light_shader->setUniform("ambient_factor",         m_ambient_factor);
     m_directional_light_shader->setUniform("alpha_cutout_threshold", m_alpha_cutout_threshold);
 
-    for (unsigned i = 0; i < m_objects_model_matrices.size(); ++i)
-    {
-        m_directional_light_shader->setUniform("model",         m_objects_model_matrices[i]);
-        m_directional_light_shader->setUniform("normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_objects_model_matrices[i]))));
-        m_directional_light_shader->setUniform("mvp",           view_projection * m_objects_model_matrices[i]);
-
-        m_pine_tree.Render();
-    }
-
-    /* Render ground plane */
-    m_directional_light_shader->setUniform("model", m_ground_plane_model);
+    m_directional_light_shader->setUniform("model",         m_ground_plane_model);
     m_directional_light_shader->setUniform("normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_ground_plane_model))));
-    m_directional_light_shader->setUniform("mvp", view_projection * m_ground_plane_model);
+    m_directional_light_shader->setUniform("mvp",           view_projection * m_ground_plane_model);
     
     m_ground_plane.Render();
+
+    /* Resolve */
+    glBlitNamedFramebuffer(m_msaa_rt->GetFramebuffer(),    m_resolve_rt->GetFramebuffer(), 0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBlitNamedFramebuffer(m_resolve_rt->GetFramebuffer(), 0,                              0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    RGL::GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    m_hiz.BuildHiZ(m_resolve_rt->GetDepthTexture(), view_projection);
+    m_hiz_view_projection = view_projection;
+    m_is_hiz_valid        = true;
 }
 
 void AlphaCutout::render_gui()
@@ -207,6 +469,35 @@ void AlphaCutout::render_gui()
 
         ImGui::SliderFloat("Alpha cutout threshold", &m_alpha_cutout_threshold, 0.0, 1.0, "%.2f");
 
+        ImGui::Spacing();
+
+        bool is_placement_changed = ImGui::SliderFloat("Trees' min distance", &m_poisson_radius, 0.75, 5.0, "%.2f");
+        is_placement_changed     |= ImGui::SliderInt  ("Seed",                (int*)&m_foliage_seed, 1, 100);
+
+        if (is_placement_changed)
+        {
+            place_foliage();
+        }
+
+        ImGui::SliderFloat("Max distance", &m_max_distance, 10.0, 500.0, "%.0f");
+        ImGui::Checkbox   ("Impostors",         &m_is_impostors_enabled);
+        ImGui::SliderFloat("Impostor distance", &m_impostor_distance,   5.0, 200.0, "%.0f");
+        ImGui::SliderFloat("Cross-fade range",  &m_impostor_fade_range, 0.0, 30.0,  "%.1f");
+        ImGui::Checkbox   ("Frustum culling",   &m_is_frustum_culling_enabled);
+        ImGui::Checkbox   ("Occlusion culling", &m_is_occlusion_culling_enabled);
+
+        ImGui::Text("Trees: %u", m_instances_count);
+
+        for (uint32_t index : RGL::Profiler::GetResolvedScopes())
+        {
+            const auto& scope = RGL::Profiler::GetScope(index);
+
+            if (scope.m_name == "Foliage culling" || scope.m_name == "Foliage")
+            {
+                ImGui::Text("%s: %.3f ms", scope.m_name.c_str(), scope.m_gpu_ms);
+            }
+        }
+
         ImGui::PopItemWidth();
         ImGui::Spacing();
 
@@ -2,8 +2,12 @@
 #include "core_app.h"
 
 #include "camera.h"
+#include "gpu_culling.h"
+#include "impostor.h"
+#include "render_target_pool.h"
 #include "static_model.h"
 #include "shader.h"
+#include "texture.h"
 
 #include <memory>
 #include <vector>
@@ -44,13 +48,63 @@ public:
     void render_gui()              override;
 
 private:
+    static constexpr float    AREA_SIZE        = 300.0f;  /* Half of the side of the forest. */
+    static constexpr uint32_t MAX_INSTANCES    = 1 << 18;
+    static constexpr uint32_t PLACEMENT_ROUNDS = 4;
+
+    /* Scatters the trees over the area on the GPU. Reads the instances count back, so only on init and when the parameters change. */
+    void place_foliage();
+
+    /* Writes the visible trees and the instance counts of the indirect commands. */
+    void cull_foliage(const glm::mat4& view_projection);
+
+    void render_foliage(const glm::mat4& view_projection);
+
+    /* Past it the trees are impostors. Out of reach when they're disabled. */
+    float get_impostor_distance() const { return m_is_impostors_enabled ? m_impostor_distance : 1e30f; }
+
     std::shared_ptr<RGL::Camera> m_camera;
     std::shared_ptr<RGL::Shader> m_directional_light_shader;
+    std::shared_ptr<RGL::Shader> m_foliage_shader;
+    std::shared_ptr<RGL::Shader> m_foliage_impostor_shader;
+    std::shared_ptr<RGL::Shader> m_foliage_place_shader;
+    std::shared_ptr<RGL::Shader> m_foliage_cull_shader;
+
+    std::shared_ptr<RGL::Texture2D>    m_pine_texture;
+    std::shared_ptr<RGL::RenderTarget> m_msaa_rt;
+    std::shared_ptr<RGL::RenderTarget> m_resolve_rt;
 
     RGL::StaticModel m_pine_tree, m_ground_plane;
-    std::vector<glm::mat4> m_objects_model_matrices;
-    
+    RGL::GpuCulling  m_hiz;     /* Only for its HiZ pyramid of the previous frame's depth. */
+    RGL::Impostor    m_pine_impostor;
+
     glm::mat4 m_ground_plane_model;
+    glm::mat4 m_hiz_view_projection;
+    glm::vec4 m_pine_bounds;    /* Object space sphere of the whole tree. */
+
+    /* Foliage */
+    GLuint m_cells_buffer_name;
+    GLuint m_instances_buffer_name;
+    GLuint m_counter_buffer_name;
+    GLuint m_commands_template_buffer_name;
+    GLuint m_commands_buffer_name;
+    GLuint m_visible_instances_buffer_name;
+    GLuint m_impostor_command_buffer_name;
+    GLuint m_visible_impostors_buffer_name;
+    GLuint m_dummy_vao_name;
+
+    uint32_t m_commands_count;
+    uint32_t m_instances_count;
+    uint32_t m_foliage_seed;
+
+    float m_poisson_radius;
+    float m_max_distance;
+    float m_impostor_distance;
+    float m_impostor_fade_range;
+    bool  m_is_impostors_enabled;
+    bool  m_is_frustum_culling_enabled;
+    bool  m_is_occlusion_culling_enabled;
+    bool  m_is_hiz_valid;
 
 
     /* Light properties */
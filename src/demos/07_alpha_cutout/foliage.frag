@@ -0,0 +1,7 @@
+#version 460 core
+#include "foliage_shading.glh"
+
+void main()
+{
+    frag_color = shadeFoliage(normalize(normal));
+}
@@ -0,0 +1,40 @@
+#version 460 core
+#include "foliage_shared.h"
+#include "foliage.glh"
+
+layout (location = 0) in vec3 in_pos;
+layout (location = 1) in vec2 in_texcoord;
+layout (location = 2) in vec3 in_normal;
+
+layout(std430, binding = FOLIAGE_INSTANCES_SSBO_BINDING_INDEX) readonly buffer FoliageInstancesSSBO
+{
+    FoliageInstance instances[];
+};
+
+layout(std430, binding = FOLIAGE_VISIBLE_SSBO_BINDING_INDEX) readonly buffer FoliageVisibleSSBO
+{
+    uint visible_instances[];
+};
+
+uniform mat4 view_projection;
+uniform vec3 cam_pos;
+
+out vec2 texcoord;
+out vec3 world_pos;
+out vec3 normal;
+out flat float lod_fade;
+
+void main()
+{
+    FoliageInstance instance = instances[visible_instances[gl_InstanceID]];
+
+    /* The rotation alone transforms the normals, the scale is uniform. */
+    mat3 rotation = foliageRotation(instance);
+
+    lod_fade  = foliageLodFade(foliageBounds(instance).xyz, cam_pos);
+    world_pos = instance.position_scale.xyz + rotation * (in_pos * instance.position_scale.w);
+    texcoord  = in_texcoord;
+    normal    = rotation * in_normal;
+
+    gl_Position = view_projection * vec4(world_pos, 1.0);
+}
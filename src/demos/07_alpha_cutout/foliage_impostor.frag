@@ -0,0 +1,20 @@
+#version 460 core
+#include "foliage_shared.h"
+#include "foliage_shading.glh"
+
+/* Object space normals of Impostor's atlas, the albedo is texture_diffuse1. */
+layout(binding = FOLIAGE_IMPOSTOR_NORMAL_TEXTURE_BINDING_INDEX) uniform sampler2D impostor_normal;
+
+in flat vec2 yaw_sin_cos;
+
+void main()
+{
+    vec3 object_normal = texture(impostor_normal, texcoord).xyz * 2.0 - 1.0;
+
+    float s = yaw_sin_cos.x;
+    float c = yaw_sin_cos.y;
+
+    vec3 world_normal = vec3(c * object_normal.x + s * object_normal.z, object_normal.y, -s * object_normal.x + c * object_normal.z);
+
+    frag_color = shadeFoliage(normalize(world_normal));
+}
@@ -0,0 +1,47 @@
+#version 460 core
+#include "foliage_shared.h"
+#include "foliage.glh"
+#include "../../core/shaders/impostor.glh"
+
+layout(std430, binding = FOLIAGE_INSTANCES_SSBO_BINDING_INDEX) readonly buffer FoliageInstancesSSBO
+{
+    FoliageInstance instances[];
+};
+
+layout(std430, binding = FOLIAGE_VISIBLE_IMPOSTORS_SSBO_BINDING_INDEX) readonly buffer FoliageVisibleImpostorsSSBO
+{
+    uint visible_impostors[];
+};
+
+uniform mat4 view_projection;
+uniform vec3 cam_pos;
+uniform int  u_impostor_frames;
+
+out vec2 texcoord;
+out vec3 world_pos;
+out vec3 normal;
+out flat float lod_fade;
+out flat vec2  yaw_sin_cos;
+
+/* A triangle strip quad. */
+const vec2 corners[4] = vec2[4](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(-1.0, 1.0), vec2(1.0, 1.0));
+
+void main()
+{
+    FoliageInstance instance = instances[visible_impostors[gl_InstanceID]];
+
+    mat3 rotation = foliageRotation(instance);
+    vec4 bounds   = foliageBounds(instance);
+
+    /* The frame is picked and its quad built in the tree's object space, the yaw takes them to the world. */
+    vec3  to_viewer     = transpose(rotation) * (cam_pos - bounds.xyz);
+    ivec2 frame         = impostorFrame(to_viewer, u_impostor_frames);
+    vec3  object_corner = impostorQuadCorner(frame, u_impostor_frames, vec3(0.0), bounds.w, corners[gl_VertexID], texcoord);
+
+    lod_fade    = foliageLodFade(bounds.xyz, cam_pos);
+    yaw_sin_cos = instance.rotation.xy;
+    world_pos   = bounds.xyz + rotation * object_corner;
+    normal      = rotation * impostorFrameDirection(frame, u_impostor_frames);
+
+    gl_Position = view_projection * vec4(world_pos, 1.0);
+}
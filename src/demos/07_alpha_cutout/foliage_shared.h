@@ -0,0 +1,37 @@
+// The GPU placed trees, shared by the C++ code and the shaders. foliage_place.comp scatters them over the area with
+// a parallel Poisson disk sampling, foliage_cull.comp writes the visible ones for the instanced indirect draws:
+// the near trees as meshes, the far ones as impostor quads, and both in the cross-fade range between.
+
+#ifdef __cplusplus
+#pragma once
+#define vec4  alignas(16) glm::vec4
+#endif
+
+#define FOLIAGE_CELLS_SSBO_BINDING_INDEX              0
+#define FOLIAGE_INSTANCES_SSBO_BINDING_INDEX          1
+#define FOLIAGE_COUNTER_SSBO_BINDING_INDEX            2
+#define FOLIAGE_COMMANDS_SSBO_BINDING_INDEX           3
+#define FOLIAGE_VISIBLE_SSBO_BINDING_INDEX            4
+#define FOLIAGE_IMPOSTOR_COMMAND_SSBO_BINDING_INDEX   5
+#define FOLIAGE_VISIBLE_IMPOSTORS_SSBO_BINDING_INDEX  6
+
+#define FOLIAGE_HIZ_TEXTURE_BINDING_INDEX             1
+#define FOLIAGE_IMPOSTOR_ALBEDO_TEXTURE_BINDING_INDEX 0  // texture_diffuse1 of lighting.glh.
+#define FOLIAGE_IMPOSTOR_NORMAL_TEXTURE_BINDING_INDEX 2
+
+#define FOLIAGE_PLACE_GROUP_SIZE 8
+#define FOLIAGE_CULL_GROUP_SIZE  64
+
+// A cell of the sampling grid is r / sqrt(2) wide, so it holds at most one sample. Cells this many apart
+// can't conflict and are sampled by the same dispatch.
+#define FOLIAGE_PHASE_STRIDE     3
+
+struct FoliageInstance
+{
+    vec4 position_scale;
+    vec4 rotation;          // xy - sine and cosine of the yaw.
+};
+
+#ifdef __cplusplus
+#undef vec4
+#endif
@@ -14,10 +14,14 @@ void main()
 
     vec4 light_color = (ambient + directional_light_contribution);
 
-    if(light_color.a <= alpha_cutout_threshold)
-        discard;
+    /*
+     * Alpha to coverage instead of discard, so the early depth test stays on. The alpha is sharpened around the threshold
+     * to about a pixel wide ramp - the edge is as crisp as a cutout, but antialiased by the samples' coverage.
+     */
+    float alpha = (light_color.a - alpha_cutout_threshold) / max(fwidth(light_color.a), 0.0001) + 0.5;
 
-    light_color = reinhard(light_color);
+    light_color   = reinhard(light_color);
+    light_color.a = clamp(alpha, 0.0, 1.0);
 
     frag_color = light_color;
-} 
\ No newline at end of file
+}
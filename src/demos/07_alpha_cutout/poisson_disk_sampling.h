@@ -14,6 +14,8 @@
 #include <type_traits>
 #include <vector>
 
+#include "job_system.h"
+
 #if __cplusplus >= 201402L  // C++14 or later.
 #define CONSTEXPR14 constexpr
 #else
@@ -625,6 +627,178 @@ auto PoissonDiskSampling(const FloatT radius,
   return samples;
 }
 
+// Parallel variant of PoissonDiskSampling with the same guarantees, for large
+// regions. Bridson's active list is inherently serial, so instead the grid
+// cells are sampled by dart throwing: a candidate is generated inside an
+// empty cell and accepted if no sample of the neighboring cells is closer
+// than radius. Cells that are at least (reach + 1) cells apart along some axis
+// cannot conflict, so the cells are colored into (reach + 1)^N phases and the
+// cells of a phase are processed concurrently with RGL::JobSystem::ParallelFor.
+// The phases run one after another, and a few rounds over all of them fill
+// the cells whose darts missed.
+//
+// Every cell draws its random numbers from a hash of the seed, the round and
+// the cell index, and no cell reads a cell written in the same phase, so the
+// result does not depend on the number of threads or their timing. The
+// samples are returned in the order of the grid cells.
+//
+// If the arguments are invalid an empty vector is returned, see
+// PoissonDiskSampling. rounds == 0 is invalid too.
+template <typename FloatT, std::size_t N, typename VecT = std::array<FloatT, N>,
+          typename VecTraitsT = VecTraits<VecT>>
+auto ParallelPoissonDiskSampling(const FloatT radius,
+                                 const std::array<FloatT, N>& x_min,
+                                 const std::array<FloatT, N>& x_max,
+                                 const std::uint32_t max_sample_attempts = 30,
+                                 const std::uint32_t seed = 0,
+                                 const std::uint32_t rounds = 4)
+    -> std::vector<VecT> {
+  namespace pds = poisson_disk_sampling_internal;
+
+  using IndexType = std::array<std::int32_t, N>;
+
+  constexpr auto kDims = N;
+  constexpr auto kGrainSize = std::uint32_t{1024};
+
+  // Validate input.
+  if (!(radius > FloatT{0}) || !(max_sample_attempts > 0) || !(rounds > 0) ||
+      !pds::ValidBounds(x_min, x_max)) {
+    return std::vector<VecT>{};
+  }
+
+  // Same cell size as the serial grid, a cell holds at most one sample.
+  constexpr auto kEps = static_cast<FloatT>(0.001);
+  const auto dx =
+      (FloatT{1} - kEps) * radius / std::sqrt(static_cast<FloatT>(N));
+  const auto dx_inv = FloatT{1} / dx;
+
+  // The samples closer than radius are at most reach cells away.
+  const auto reach = static_cast<std::int32_t>(std::ceil(radius * dx_inv));
+  const auto stride = reach + 1;
+
+  auto size = IndexType{};
+  auto cells_count = std::size_t{1};
+  for (std::size_t i = 0; i < kDims; ++i) {
+    size[i] = std::max(
+        static_cast<std::int32_t>(std::ceil((x_max[i] - x_min[i]) * dx_inv)),
+        std::int32_t{1});
+    cells_count *= static_cast<std::size_t>(size[i]);
+  }
+
+  const auto linear_index = [&size](const IndexType& index) -> std::size_t {
+    auto k = static_cast<std::size_t>(index[0]);
+    auto d = std::size_t{1};
+    for (std::size_t i = 1; i < kDims; ++i) {
+      d *= static_cast<std::size_t>(size[i - 1]);
+      k += static_cast<std::size_t>(index[i]) * d;
+    }
+    return k;
+  };
+
+  auto cell_samples = std::vector<VecT>(cells_count);
+  auto is_occupied = std::vector<std::uint8_t>(cells_count, 0);
+  const auto r_squared = pds::squared(radius);
+
+  const auto sample_cell = [&](const IndexType& cell,
+                               const std::uint32_t round) {
+    const auto cell_linear_index = linear_index(cell);
+    if (is_occupied[cell_linear_index] != 0) {
+      return;
+    }
+
+    auto min_index = IndexType{};
+    auto max_index = IndexType{};
+    for (std::size_t i = 0; i < kDims; ++i) {
+      min_index[i] = std::max(cell[i] - reach, std::int32_t{0});
+      max_index[i] = std::min(cell[i] + reach, size[i] - 1);
+    }
+
+    auto local_seed = pds::Hash(
+        seed ^ pds::Hash(static_cast<std::uint32_t>(cell_linear_index) ^
+                         pds::Hash(round)));
+
+    for (std::uint32_t attempt = 0; attempt < max_sample_attempts; ++attempt) {
+      VecT cand_sample = {};
+      for (std::size_t i = 0; i < kDims; ++i) {
+        const auto xi = x_min[i] + (static_cast<FloatT>(cell[i]) +
+                                    pds::NormRand<FloatT>(&local_seed)) * dx;
+        VecTraitsT::Set(&cand_sample, i,
+                        static_cast<typename VecTraitsT::ValueType>(xi));
+      }
+
+      // The last cells may reach past x_max.
+      if (!pds::InsideBounds<VecTraitsT>(cand_sample, x_min, x_max)) {
+        continue;
+      }
+
+      auto is_too_close = false;
+      auto index = min_index;
+      do {
+        const auto k = linear_index(index);
+        if (is_occupied[k] != 0 &&
+            static_cast<FloatT>(pds::SquaredDistance<VecTraitsT>(
+                cand_sample, cell_samples[k])) < r_squared) {
+          is_too_close = true;
+          break;
+        }
+      } while (pds::Iterate(min_index, max_index, &index));
+
+      if (!is_too_close) {
+        cell_samples[cell_linear_index] = cand_sample;
+        is_occupied[cell_linear_index] = 1;
+        return;
+      }
+    }
+  };
+
+  auto phases_count = std::uint32_t{1};
+  for (std::size_t i = 0; i < kDims; ++i) {
+    phases_count *= static_cast<std::uint32_t>(stride);
+  }
+
+  for (std::uint32_t round = 0; round < rounds; ++round) {
+    for (std::uint32_t phase = 0; phase < phases_count; ++phase) {
+      // The first cell of the phase and the number of its cells per axis.
+      auto first = IndexType{};
+      auto phase_size = IndexType{};
+      auto phase_cells_count = std::uint32_t{1};
+      auto p = static_cast<std::int32_t>(phase);
+      for (std::size_t i = 0; i < kDims; ++i) {
+        first[i] = p % stride;
+        phase_size[i] = (size[i] - first[i] + stride - 1) / stride;
+        phase_cells_count *= static_cast<std::uint32_t>(phase_size[i]);
+        p /= stride;
+      }
+
+      if (phase_cells_count == 0) {
+        continue;
+      }
+
+      RGL::JobSystem::ParallelFor(
+          0, phase_cells_count, kGrainSize,
+          [&](const std::uint32_t begin, const std::uint32_t end) {
+            for (auto j = begin; j < end; ++j) {
+              auto cell = IndexType{};
+              auto k = static_cast<std::int32_t>(j);
+              for (std::size_t i = 0; i < kDims; ++i) {
+                cell[i] = first[i] + stride * (k % phase_size[i]);
+                k /= phase_size[i];
+              }
+              sample_cell(cell, round);
+            }
+          });
+    }
+  }
+
+  auto samples = std::vector<VecT>{};
+  for (std::size_t k = 0; k < cells_count; ++k) {
+    if (is_occupied[k] != 0) {
+      samples.push_back(cell_samples[k]);
+    }
+  }
+  return samples;
+}
+
 }  // namespace thinks
 
 #undef CONSTEXPR14
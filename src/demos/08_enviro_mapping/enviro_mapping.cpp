@@ -14,20 +14,23 @@ EnvironmentMapping::EnvironmentMapping()
       m_gamma                        (2.2),
       m_dir_light_angles             (45.0f, 50.0f),
       m_ior                          (1.52f),
-      m_dynamic_enviro_mapping_toggle(false)
+      m_dynamic_enviro_mapping_toggle(false),
+      m_ssr_toggle                   (true),
+      m_scene_fbo                    (0),
+      m_scene_color_tex              (0),
+      m_scene_normals_tex            (0),
+      m_scene_depth_tex              (0),
+      m_scene_width                  (0),
+      m_scene_height                 (0)
 {
-    m_enviro_cubemap_size = glm::vec2(2048);
-
-    float half_size = m_enviro_cubemap_size.x * 0.5f;
-    m_enviro_projection = glm::perspective(2.0f * glm::atan(half_size / (half_size - 0.5f)), 1.0f, 0.01f, 200.0f);
 }
 
 EnvironmentMapping::~EnvironmentMapping()
 {
-    for(auto & rt : m_cubemap_rts)
-    {
-        rt.cleanup();
-    }
+    GLuint textures[] = { m_scene_color_tex, m_scene_normals_tex, m_scene_depth_tex };
+
+    glDeleteTextures    (3, textures);
+    glDeleteFramebuffers(1, &m_scene_fbo);
 }
 
 void EnvironmentMapping::init_app()
@@ -40,6 +43,7 @@ void EnvironmentMapping::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(0.0, 5.0, 9.0);
     m_camera->setOrientation(glm::vec3(0.0, 3.0, -9.0));
 
@@ -142,12 +146,20 @@ void EnvironmentMapping::init_app()
                                         m_current_skybox_name + "_ft.jpg",
                                         m_current_skybox_name + "_bk.jpg");
 
-    /* Generate cubemap render targets*/
-    m_cubemap_rts[0] = generate_cubemap_rt();
-    m_cubemap_rts[1] = generate_cubemap_rt();
+    /* Create reflection probes, the objects are 8 units apart - their probes don't overlap. */
+    RGL::ReflectionProbes::Settings probes_settings;
+    probes_settings.m_size      = 512;
+    probes_settings.m_max_count = 2;
+
+    m_reflection_probes.Create(probes_settings);
+    m_reflection_probes.Add(xyzrgb_dragon_position, 6.0f);
+    m_reflection_probes.Add(lucy_position,          6.0f);
 
-    m_cubemap_rts[0].set_position(xyzrgb_dragon_position);
-    m_cubemap_rts[1].set_position(lucy_position);
+    /* Create the screen space reflections' scene target. */
+    m_ssr.Create();
+
+    glCreateFramebuffers(1, &m_scene_fbo);
+    resize_scene_target(RGL::Window::getWidth(), RGL::Window::getHeight());
 }
 
 void EnvironmentMapping::input()
@@ -214,23 +226,86 @@ void EnvironmentMapping::update(double delta_time)
 
 void EnvironmentMapping::render()
 {
-    /* First pass: render scene to cubemap render targets */
+    /* First pass: update the reflection probes, a few faces per frame within the GPU budget */
     if (m_dynamic_enviro_mapping_toggle)
     {
         glEnable(GL_CULL_FACE);
-        render_to_cubemap_rt(m_cubemap_rts[0], 0);
-        render_to_cubemap_rt(m_cubemap_rts[1], 1);
+        m_reflection_probes.Update([&](const RGL::ReflectionProbes::CaptureView& view)
+        {
+            /* The probe's index is the index of the object it's placed at. */
+            render_objects(view.m_view, view.m_projection, view.m_position, int(view.m_probe_index));
+        });
         glDisable(GL_CULL_FACE);
     }
 
     /* Second pass: render scene normally */
     glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
+
+    if (!m_ssr_toggle)
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        render_objects(m_camera->m_view, m_camera->m_projection, m_camera->position());
+
+        return;
+    }
+
+    /* With the screen space reflections the scene goes to the target first, they need its color, normals and depth. */
+    if (m_scene_width != uint32_t(RGL::Window::getWidth()) || m_scene_height != uint32_t(RGL::Window::getHeight()))
+    {
+        resize_scene_target(RGL::Window::getWidth(), RGL::Window::getHeight());
+    }
+
+    const GLfloat no_normal[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_scene_fbo);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glClearNamedFramebufferfv(m_scene_fbo, GL_COLOR, 1, no_normal);
+
+    render_objects(m_camera->m_view, m_camera->m_projection, m_camera->position(), -1, true);
+
+    /* Third pass: trace the reflections and draw the target to the window with them over the dragon */
+    m_ssr.Render(*m_camera, m_scene_color_tex, m_scene_depth_tex, m_scene_normals_tex);
 
-    render_objects(m_camera->m_view, m_camera->m_projection, m_camera->position());
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    m_ssr.Composite(m_scene_color_tex, m_scene_normals_tex);
+}
+
+void EnvironmentMapping::resize_scene_target(uint32_t width, uint32_t height)
+{
+    m_scene_width  = width;
+    m_scene_height = height;
+
+    GLuint textures[] = { m_scene_color_tex, m_scene_normals_tex, m_scene_depth_tex };
+    glDeleteTextures(3, textures);
+
+    glCreateTextures  (GL_TEXTURE_2D, 1, &m_scene_color_tex);
+    glTextureStorage2D(m_scene_color_tex, 1, GL_RGBA8, width, height);
+
+    glCreateTextures  (GL_TEXTURE_2D, 1, &m_scene_normals_tex);
+    glTextureStorage2D(m_scene_normals_tex, 1, GL_RGBA16F, width, height);
+
+    glCreateTextures  (GL_TEXTURE_2D, 1, &m_scene_depth_tex);
+    glTextureStorage2D(m_scene_depth_tex, 1, GL_DEPTH_COMPONENT32F, width, height);
+
+    for (GLuint texture : { m_scene_color_tex, m_scene_normals_tex, m_scene_depth_tex })
+    {
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+    }
+
+    glNamedFramebufferTexture(m_scene_fbo, GL_COLOR_ATTACHMENT0, m_scene_color_tex,   0);
+    glNamedFramebufferTexture(m_scene_fbo, GL_COLOR_ATTACHMENT1, m_scene_normals_tex, 0);
+    glNamedFramebufferTexture(m_scene_fbo, GL_DEPTH_ATTACHMENT,  m_scene_depth_tex,   0);
+
+    /* Only the environment mapped models write the normals, see render_objects(). */
+    glNamedFramebufferDrawBuffer(m_scene_fbo, GL_COLOR_ATTACHMENT0);
+
+    m_ssr.Reset();
 }
 
-void EnvironmentMapping::render_objects(const glm::mat4& camera_view, const glm::mat4& camera_projection, const glm::vec3& camera_position, int ignore_obj_id)
+void EnvironmentMapping::render_objects(const glm::mat4& camera_view, const glm::mat4& camera_projection, const glm::vec3& camera_position, int ignore_obj_id, bool write_normals)
 {
     auto view_projection = camera_projection * camera_view;
 
@@ -260,15 +335,24 @@ void EnvironmentMapping::render_objects(const glm::mat4& camera_view, const glm:
     /* Render reflective / refractive models */
     m_enviro_mapping_shader->bind();
     m_enviro_mapping_shader->setUniform("cam_pos", camera_position);
+    m_enviro_mapping_shader->setUniform("use_reflection_probes", m_dynamic_enviro_mapping_toggle);
 
-    if(!m_dynamic_enviro_mapping_toggle) m_skybox->bindSkyboxTexture(1);
+    /* The skybox is where the probes don't reach. */
+    m_skybox->bindSkyboxTexture(1);
+    m_reflection_probes.Bind();
+
+    /* The lit objects and the skybox leave the cleared normals - no reflections there. */
+    if (write_normals)
+    {
+        const GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glNamedFramebufferDrawBuffers(m_scene_fbo, 2, draw_buffers);
+    }
 
     /* xyzrgb dragon */
     if (ignore_obj_id != 0)
     {
-        if (m_dynamic_enviro_mapping_toggle) m_cubemap_rts[0].bindTexture(1);
-
         m_enviro_mapping_shader->setSubroutine(RGL::Shader::ShaderType::FRAGMENT, "reflection");
+        m_enviro_mapping_shader->setUniform("reflectivity", 1.0f);
         m_enviro_mapping_shader->setUniform("model", m_objects_model_matrices[0]);
         m_enviro_mapping_shader->setUniform("normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_objects_model_matrices[0]))));
         m_enviro_mapping_shader->setUniform("mvp", view_projection * m_objects_model_matrices[0]);
@@ -278,16 +362,20 @@ void EnvironmentMapping::render_objects(const glm::mat4& camera_view, const glm:
     /* lucy */
     if (ignore_obj_id != 1)
     {
-        if (m_dynamic_enviro_mapping_toggle) m_cubemap_rts[1].bindTexture(1);
-
         m_enviro_mapping_shader->setSubroutine(RGL::Shader::ShaderType::FRAGMENT, "refraction");
         m_enviro_mapping_shader->setUniform("ior", m_ior);
+        m_enviro_mapping_shader->setUniform("reflectivity", 0.0f);
         m_enviro_mapping_shader->setUniform("model", m_objects_model_matrices[1]);
         m_enviro_mapping_shader->setUniform("normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_objects_model_matrices[1]))));
         m_enviro_mapping_shader->setUniform("mvp", view_projection * m_objects_model_matrices[1]);
         m_lucy->Render();
     }
 
+    if (write_normals)
+    {
+        glNamedFramebufferDrawBuffer(m_scene_fbo, GL_COLOR_ATTACHMENT0);
+    }
+
     /* Render skybox */
     m_skybox->render(camera_projection, camera_view);
 }
@@ -356,6 +444,28 @@ void EnvironmentMapping::render_gui()
         ImGui::SliderFloat("Index of Refraction", &m_ior, 1.0, 2.417, "%.3f");
         ImGui::Checkbox("Dynamic Environment Mapping", &m_dynamic_enviro_mapping_toggle);
 
+        if (m_dynamic_enviro_mapping_toggle)
+        {
+            float budget_ms = m_reflection_probes.GetGpuBudget();
+            if (ImGui::SliderFloat("Probes GPU budget", &budget_ms, 0.1, 8.0, "%.1f ms"))
+            {
+                m_reflection_probes.SetGpuBudget(budget_ms);
+            }
+
+            const auto& stats = m_reflection_probes.GetStats();
+            ImGui::Text("Steps per frame: %u (face %.2f ms, prefilter level %.2f ms)", stats.m_steps, stats.m_face_ms, stats.m_prefilter_level_ms);
+        }
+
+        if (ImGui::Checkbox("Screen Space Reflections", &m_ssr_toggle))
+        {
+            m_ssr.Reset();
+        }
+
+        if (m_ssr_toggle)
+        {
+            m_ssr.RenderGui();
+        }
+
         ImGui::PopItemWidth();
         ImGui::Spacing();
 
@@ -384,51 +494,3 @@ void EnvironmentMapping::render_gui()
     }
     ImGui::End();
 }
-
-EnvironmentMapping::CubeMapRenderTarget EnvironmentMapping::generate_cubemap_rt() const
-{
-    CubeMapRenderTarget rt;
-
-    glGenTextures(1, &rt.m_cubemap_texture_id);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, rt.m_cubemap_texture_id);
-
-    for (uint8_t i = 0; i < 6; ++i)
-    {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, m_enviro_cubemap_size.x, m_enviro_cubemap_size.y, 0, GL_RGB, GL_FLOAT, 0);
-    }
-
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    glGenFramebuffers(1, &rt.m_fbo_id);
-    glBindFramebuffer(GL_FRAMEBUFFER, rt.m_fbo_id);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, rt.m_cubemap_texture_id, 0);
-
-    glGenRenderbuffers(1, &rt.m_rbo_id);
-    glBindRenderbuffer(GL_RENDERBUFFER, rt.m_rbo_id);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_enviro_cubemap_size.x, m_enviro_cubemap_size.y);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rt.m_rbo_id);
-
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    return rt;
-}
-
-void EnvironmentMapping::render_to_cubemap_rt(CubeMapRenderTarget & rt, int ignore_obj_id)
-{
-    /* Update all faces per frame */
-    glViewport(0, 0, m_enviro_cubemap_size.x, m_enviro_cubemap_size.y);
-    glBindFramebuffer(GL_FRAMEBUFFER, rt.m_fbo_id);
-        for(uint8_t side = 0; side < 6; ++side)
-        {
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, rt.m_cubemap_texture_id, 0);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            render_objects(rt.m_view_transforms[side], m_enviro_projection, rt.m_position, ignore_obj_id);
-        }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-}
@@ -1,6 +1,9 @@
-#version 450
+#version 460 core
+#include "../../core/core_shared.h"
+#include "../../core/shaders/reflection_probes.glh"
 
-out vec4 frag_color;
+layout(location = 0) out vec4 frag_color;
+layout(location = 1) out vec4 frag_normal; /* For the screen space reflections, w - the reflectivity. */
 
 in vec3 world_pos;
 in vec3 world_normal;
@@ -8,6 +11,22 @@ in vec3 world_normal;
 layout(binding = 1) uniform samplerCube skybox;
 uniform vec3 cam_pos;
 uniform float ior;
+uniform bool use_reflection_probes;
+uniform float reflectivity;
+
+/* The reflection probes blended over the skybox. */
+vec4 environment(vec3 dir)
+{
+    vec4 color = texture(skybox, dir);
+
+    if (use_reflection_probes)
+    {
+        vec4 probes = sampleReflectionProbes(world_pos, dir, 0.0);
+        color.rgb   = mix(color.rgb, probes.rgb, probes.a);
+    }
+
+    return color;
+}
 
 subroutine vec4 enviroMapping();
 layout(location = 0) subroutine uniform enviroMapping enviro_func;
@@ -17,7 +36,7 @@ layout(index = 0) subroutine(enviroMapping) vec4 reflection()
     vec3 i = normalize(world_pos - cam_pos);
     vec3 r = reflect(i, normalize(world_normal));
 
-    return vec4(texture(skybox, r).rgb, 1.0);
+    return vec4(environment(r).rgb, 1.0);
 }
 
 layout(index = 1) subroutine(enviroMapping) vec4 refraction()
@@ -30,12 +49,12 @@ layout(index = 1) subroutine(enviroMapping) vec4 refraction()
     vec3 refract_dir_b = refract(i, normalize(world_normal), ratio.b);
     vec3 reflect_dir   = reflect(i, normalize(world_normal));
 
-    float refract_color_r = texture(skybox, refract_dir_r).r;
-    float refract_color_g = texture(skybox, refract_dir_g).g;
-    float refract_color_b = texture(skybox, refract_dir_b).b;
+    float refract_color_r = environment(refract_dir_r).r;
+    float refract_color_g = environment(refract_dir_g).g;
+    float refract_color_b = environment(refract_dir_b).b;
 
     vec4 refract_color = vec4(refract_color_r, refract_color_g, refract_color_b, 1.0);
-    vec4 reflect_color = texture(skybox, reflect_dir);
+    vec4 reflect_color = environment(reflect_dir);
 
     float alpha = max(0.0, dot(i, normalize(world_normal)));
 
@@ -44,5 +63,6 @@ layout(index = 1) subroutine(enviroMapping) vec4 refraction()
 
 void main()
 {
-    frag_color = enviro_func();
+    frag_color  = enviro_func();
+    frag_normal = vec4(normalize(world_normal), reflectivity);
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include "core_app.h"
 
 #include "camera.h"
+#include "reflection_probes.h"
+#include "screen_space_reflections.h"
 #include "static_model.h"
 #include "shader.h"
 #include "skybox.hpp"
@@ -45,54 +47,8 @@ public:
     void render_gui()              override;
 
 private:
-    struct CubeMapRenderTarget
-    {
-        glm::mat4 m_view_transforms[6];
-
-        GLuint    m_cubemap_texture_id = 0;
-        GLuint    m_fbo_id             = 0;
-        GLuint    m_rbo_id             = 0;
-        glm::vec3 m_position           = glm::vec3(0.0f);
-
-        void set_position(const glm::vec3 pos)
-        {
-            m_position = pos;
-            m_view_transforms[0] = glm::lookAt(pos, pos + glm::vec3( 1,  0,  0), glm::vec3(0, -1,  0));
-            m_view_transforms[1] = glm::lookAt(pos, pos + glm::vec3(-1,  0,  0), glm::vec3(0, -1,  0));
-            m_view_transforms[2] = glm::lookAt(pos, pos + glm::vec3( 0,  1,  0), glm::vec3(0,  0,  1));
-            m_view_transforms[3] = glm::lookAt(pos, pos + glm::vec3( 0, -1,  0), glm::vec3(0,  0, -1));
-            m_view_transforms[4] = glm::lookAt(pos, pos + glm::vec3( 0,  0,  1), glm::vec3(0, -1,  0));
-            m_view_transforms[5] = glm::lookAt(pos, pos + glm::vec3( 0,  0, -1), glm::vec3(0, -1,  0));
-        }
-
-        void bindTexture(GLuint unit = 0)
-        {
-            glBindTextureUnit(unit, m_cubemap_texture_id);
-        }
-
-        void cleanup()
-        {
-            if (m_cubemap_texture_id != 0)
-            {
-                glDeleteTextures(1, &m_cubemap_texture_id);
-            }
-
-            if (m_fbo_id != 0)
-            {
-                glDeleteFramebuffers(1, &m_fbo_id);
-            }
-
-            if (m_rbo_id != 0)
-            {
-                glDeleteRenderbuffers(1, &m_rbo_id);
-            }
-        }
-
-    } m_cubemap_rts[2];
-
-    void                render_objects(const glm::mat4& camera_view, const glm::mat4& camera_projection, const glm::vec3 & camera_position, int ignore_obj_id = -1);
-    CubeMapRenderTarget generate_cubemap_rt() const;
-    void                render_to_cubemap_rt(CubeMapRenderTarget & rt, int ignore_obj_id = -1);
+    void render_objects(const glm::mat4& camera_view, const glm::mat4& camera_projection, const glm::vec3 & camera_position, int ignore_obj_id = -1, bool write_normals = false);
+    void resize_scene_target(uint32_t width, uint32_t height);
 
     std::shared_ptr<RGL::Camera> m_camera;
     std::shared_ptr<RGL::Shader> m_directional_light_shader;
@@ -115,11 +71,25 @@ private:
     std::string m_current_skybox_name;
     std::string m_skybox_names_list[3] = { "calm_sea", "distant_sunset", "heaven" };
 
-    /* Dynamic Environment mapping */
-    glm::ivec2 m_enviro_cubemap_size;
-    glm::mat4 m_enviro_projection;
+    /* Dynamic Environment mapping - a reflection probe at the dragon and one at lucy, each hides its own object. */
+    RGL::ReflectionProbes m_reflection_probes;
     bool m_dynamic_enviro_mapping_toggle;
 
+    /*
+     * Screen space reflections - the scene goes to the color, normals and depth target, the reflections of what's
+     * on the screen are traced and the target is drawn to the window with them blended over the dragon.
+     * The missed rays show the dragon's own environment mapping - the skybox and the probes.
+     */
+    RGL::ScreenSpaceReflections m_ssr;
+    bool m_ssr_toggle;
+
+    GLuint m_scene_fbo;
+    GLuint m_scene_color_tex;
+    GLuint m_scene_normals_tex;
+    GLuint m_scene_depth_tex;
+    uint32_t m_scene_width;
+    uint32_t m_scene_height;
+
     /* Light properties */
     DirectionalLight m_dir_light_properties;
     
@@ -6,7 +6,7 @@
 #include <glad/glad.h>
 #include <glm/mat4x4.hpp>
 
-#include "shader.h"
+#include "skybox.h"
 #include <texture.h>
 
 class Skybox
@@ -31,16 +31,12 @@ public:
            const std::string& back_face);
     ~Skybox();
 
+    /* Draws where nothing was drawn before, call it after the scene. */
     void render(const glm::mat4& projection, const glm::mat4& view);
     void bindSkyboxTexture(GLuint unit = 0);
 
 private:
-    glm::mat4 m_world;
-
-    GLuint m_vao_id;
-    GLuint m_vbo_id;
     RGL::TextureCubeMap m_cubemap_texture;
-
-    std::shared_ptr<RGL::Shader> m_skybox_shader;
+    RGL::Skybox         m_skybox;
 };
 
@@ -0,0 +1,24 @@
+#version 460 core
+#define SINGLE_PASS_LIGHTING
+#include "lighting.glh"
+
+uniform float ambient_factor;
+
+in vec4 projector_texcoord;
+in vec4 projector_shadow_coord;
+
+layout(binding = 1) uniform sampler2D       projector_texture;
+layout(binding = 2) uniform sampler2DShadow projector_shadow_map;
+
+void main()
+{
+    vec3 projector_texture_color = vec3(0.0);
+    if(projector_texcoord.z > 0.0)
+    {
+        projector_texture_color = textureProj(projector_texture, projector_texcoord).rgb;
+    }
+
+    vec4 ambient = reinhard(texture(texture_diffuse1, texcoord) * vec4(vec3(ambient_factor), 1.0));
+
+    frag_color = ambient + calcLights(normalize(normal), world_pos, vec4(projector_texture_color, 1.0), projectorVisibility(projector_shadow_map, projector_shadow_coord));
+}
@@ -4,8 +4,10 @@
 uniform SpotLight spot_light;
 
 in vec4 projector_texcoord;
+in vec4 projector_shadow_coord;
 
-layout(binding = 1) uniform sampler2D projector_texture;
+layout(binding = 1) uniform sampler2D       projector_texture;
+layout(binding = 2) uniform sampler2DShadow projector_shadow_map;
 
 void main()
 {
@@ -17,5 +19,7 @@ void main()
         projector_texture_color = textureProj(projector_texture, projector_texcoord).rgb;
     }
 
-    frag_color = reinhard(light + vec4(projector_texture_color, 1.0));
+    float visibility = projectorVisibility(projector_shadow_map, projector_shadow_coord);
+
+    frag_color = reinhard((light + vec4(projector_texture_color, 1.0)) * visibility);
 } 
\ No newline at end of file
@@ -8,11 +8,13 @@ uniform mat4 mvp;
 uniform mat3 normal_matrix;
 
 uniform mat4 projector_matrix;
+uniform mat4 projector_shadow_matrix;
 
 out vec2 texcoord;
 out vec3 world_pos;
 out vec3 normal;
 out vec4 projector_texcoord;
+out vec4 projector_shadow_coord;
 
 void main()
 {
@@ -20,7 +22,8 @@ void main()
     texcoord  = in_texcoord;
     normal    = normal_matrix * in_normal;
 
-    projector_texcoord = projector_matrix * vec4(world_pos, 1.0);
+    projector_texcoord     = projector_matrix        * vec4(world_pos, 1.0);
+    projector_shadow_coord = projector_shadow_matrix * vec4(world_pos, 1.0);
 
     gl_Position = mvp * vec4(in_pos, 1.0);
 }
\ No newline at end of file
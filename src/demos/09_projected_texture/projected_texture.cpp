@@ -1,23 +1,71 @@
 #include "projected_texture.h"
 #include "filesystem.h"
 #include "input.h"
+#include "profiler.h"
 #include "util.h"
 #include "gui/gui.h"
 
+#include "gpu_culling.h"
+
 #include <glm/gtc/matrix_inverse.hpp>
 
+namespace
+{
+    /* The world space bounding sphere of an object, the transform may rotate and scale it. */
+    glm::vec4 world_bounds(const glm::vec4& bounds, const glm::mat4& transform)
+    {
+        float scale = glm::sqrt(glm::max(glm::max(glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+                                                  glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1]))),
+                                                  glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2]))));
+
+        return glm::vec4(glm::vec3(transform * glm::vec4(glm::vec3(bounds), 1.0f)), bounds.w * scale);
+    }
+
+    bool is_inside_frustum(const glm::vec4 planes[6], const glm::vec4& sphere)
+    {
+        for (int i = 0; i < 6; ++i)
+        {
+            if (glm::dot(glm::vec3(planes[i]), glm::vec3(sphere)) + planes[i].w < -sphere.w)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
 ProjectedTexture::ProjectedTexture()
     : m_specular_power    (120.0f),
       m_specular_intenstiy(0.2f),
       m_ambient_factor    (0.18f),
       m_gamma             (0.8),
       m_spot_light_angles (0.0f, 0.0f),
-      m_projector_move_speed   (0.75f)
+      m_projector_move_speed   (0.75f),
+      m_lights_ssbo_id    (0),
+      m_is_single_pass    (true),
+      m_projector_shadow_map_id       (0),
+      m_projector_static_shadow_map_id(0),
+      m_projector_shadow_fbo_id       (0),
+      m_projector_static_shadow_fbo_id(0),
+      m_static_shadow_view_projection (0.0f),
+      m_is_static_shadow_cached       (true),
+      m_animate_dynamic_objects       (true),
+      m_dynamic_objects_angle         (0.0f),
+      m_static_shadow_updates_count   (0),
+      m_shadow_casters_count          (0),
+      m_spot_receivers_count          (0)
 {
 }
 
 ProjectedTexture::~ProjectedTexture()
 {
+    glDeleteBuffers(1, &m_lights_ssbo_id);
+
+    glDeleteFramebuffers(1, &m_projector_shadow_fbo_id);
+    glDeleteFramebuffers(1, &m_projector_static_shadow_fbo_id);
+    glDeleteTextures    (1, &m_projector_shadow_map_id);
+    glDeleteTextures    (1, &m_projector_static_shadow_map_id);
 }
 
 void ProjectedTexture::init_app()
@@ -31,6 +79,7 @@ void ProjectedTexture::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(1.5, 0.0, 10.0);
 
     /* Initialize lights' properties */
@@ -70,6 +119,22 @@ void ProjectedTexture::init_app()
     m_objects_model_matrices.emplace_back(glm::translate(glm::mat4(1.0), glm::vec3(10.0,  0.0, -5)) * glm::rotate(glm::mat4(1.0), glm::radians(45.0f), glm::vec3(1, 0, 0)));  // quad
     m_objects_model_matrices.emplace_back(glm::translate(glm::mat4(1.0), glm::vec3( 0.0, -1.0, -5)));                                                                         // ground plane
 
+    /* The torus spins, the others stay in the projector's cached shadow map. */
+    m_objects_is_dynamic = { false, false, false, false, false, false, true, false, false };
+
+    for (auto& object : m_objects)
+    {
+        glm::vec4 bounds = object->GetMeshPartBounds(0);
+
+        for (uint32_t i = 1; i < object->GetMeshPartsCount(); ++i)
+        {
+            const glm::vec4 part_bounds = object->GetMeshPartBounds(i);
+            bounds.w = glm::max(bounds.w, glm::distance(glm::vec3(part_bounds), glm::vec3(bounds)) + part_bounds.w);
+        }
+
+        m_objects_bounds.push_back(bounds);
+    }
+
     /* Add textures to the objects. */
     auto texture = std::make_shared<RGL::Texture2D>();
     texture->Load(RGL::FileSystem::getResourcesPath() / "textures/bricks.png", true);
@@ -95,6 +160,42 @@ void ProjectedTexture::init_app()
     m_spot_light_shader = std::make_shared<RGL::Shader>(dir + "lighting-spot.vert", dir + "lighting-spot.frag");
     m_spot_light_shader->link();
 
+    m_single_pass_shader = std::make_shared<RGL::Shader>(dir + "lighting-spot.vert", dir + "lighting-single-pass.frag");
+    m_single_pass_shader->link();
+
+    m_projector_shadow_shader = std::make_shared<RGL::Shader>(dir + "projector_shadow.vert", dir + "projector_shadow.frag");
+    m_projector_shadow_shader->link();
+
+    /* The projector's shadow maps, outside of them everything is lit. */
+    GLfloat border[] = { 1.0, 0.0, 0.0, 0.0 };
+
+    for (GLuint* shadow_map : { &m_projector_shadow_map_id, &m_projector_static_shadow_map_id })
+    {
+        glCreateTextures    (GL_TEXTURE_2D, 1, shadow_map);
+        glTextureStorage2D  (*shadow_map, 1, GL_DEPTH_COMPONENT32F, PROJECTOR_SHADOW_MAP_SIZE, PROJECTOR_SHADOW_MAP_SIZE);
+        glTextureParameteri (*shadow_map, GL_TEXTURE_MIN_FILTER,   GL_LINEAR);
+        glTextureParameteri (*shadow_map, GL_TEXTURE_MAG_FILTER,   GL_LINEAR);
+        glTextureParameteri (*shadow_map, GL_TEXTURE_WRAP_S,       GL_CLAMP_TO_BORDER);
+        glTextureParameteri (*shadow_map, GL_TEXTURE_WRAP_T,       GL_CLAMP_TO_BORDER);
+        glTextureParameterfv(*shadow_map, GL_TEXTURE_BORDER_COLOR, border);
+        glTextureParameteri (*shadow_map, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTextureParameteri (*shadow_map, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    }
+
+    GLenum draw_buffers[] = { GL_NONE };
+
+    glCreateFramebuffers         (1, &m_projector_shadow_fbo_id);
+    glNamedFramebufferTexture    (m_projector_shadow_fbo_id, GL_DEPTH_ATTACHMENT, m_projector_shadow_map_id, 0);
+    glNamedFramebufferDrawBuffers(m_projector_shadow_fbo_id, 1, draw_buffers);
+
+    glCreateFramebuffers         (1, &m_projector_static_shadow_fbo_id);
+    glNamedFramebufferTexture    (m_projector_static_shadow_fbo_id, GL_DEPTH_ATTACHMENT, m_projector_static_shadow_map_id, 0);
+    glNamedFramebufferDrawBuffers(m_projector_static_shadow_fbo_id, 1, draw_buffers);
+
+    /* The spot light, it carries the projector. */
+    glCreateBuffers     (1, &m_lights_ssbo_id);
+    glNamedBufferStorage(m_lights_ssbo_id, sizeof(GpuLight), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
     /* Load texture to be projected and adjust its parameters */
     m_projector.m_texture.Load(RGL::FileSystem::getResourcesPath() / "textures/circles" / m_current_projector_texture_name, true);
     m_projector.m_texture.SetWraping(RGL::TextureWrapingCoordinate::S, RGL::TextureWrapingParam::CLAMP_TO_BORDER);
@@ -160,19 +261,42 @@ void ProjectedTexture::update(double delta_time)
     static constexpr float min = -7.5f;
     static constexpr float max = 10.0f;
     m_spot_light_properties.position.x = min + (max - min) * 0.5f * (1.0 + glm::sin(accum));
+
+    if (m_animate_dynamic_objects)
+    {
+        m_dynamic_objects_angle += delta_time;
+    }
+
+    m_objects_model_matrices[6] = glm::translate(glm::mat4(1.0), glm::vec3(7.5, 0.0, -5)) * glm::rotate(glm::mat4(1.0), m_dynamic_objects_angle, glm::vec3(1, 0, 0)); // torus
 }
 
 void ProjectedTexture::render()
 {
     /* Put render specific code here. Don't update variables here! */
+    m_projector.m_view_matrix = glm::lookAt(m_spot_light_properties.position, m_spot_light_properties.position + m_spot_light_properties.direction, glm::cross(m_spot_light_properties.direction, glm::vec3(1.0, 0.0, 0.0)));
+
+    render_projector_shadow();
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    RGL::ProfilerScope scope("Lighting");
+
+    auto view_projection = m_camera->viewProjection();
+
+    /* Projector texture and shadow map */
+    m_projector.m_texture.Bind(1);
+    glBindTextureUnit(2, m_projector_shadow_map_id);
+
+    if (m_is_single_pass)
+    {
+        render_single_pass(view_projection);
+        return;
+    }
+
     m_ambient_light_shader->bind();
     m_ambient_light_shader->setUniform("ambient_factor", m_ambient_factor);
     m_ambient_light_shader->setUniform("gamma",          m_gamma);
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
-
     /* First, render the ambient color only for the opaque objects. */
     for (unsigned i = 0; i < m_objects.size(); ++i)
     {
@@ -209,12 +333,24 @@ void ProjectedTexture::render()
     m_spot_light_shader->setUniform("gamma",              m_gamma);
 
     /* Projector texture uniforms */
-    m_projector.m_texture.Bind(1);
-    m_projector.m_view_matrix = glm::lookAt(m_spot_light_properties.position, m_spot_light_properties.position + m_spot_light_properties.direction, glm::cross(m_spot_light_properties.direction, glm::vec3(1.0, 0.0, 0.0)));
-    m_spot_light_shader->setUniform("projector_matrix", m_projector.transform());
+    m_spot_light_shader->setUniform("projector_matrix",        m_projector.transform());
+    m_spot_light_shader->setUniform("projector_shadow_matrix", m_projector.shadow_transform());
+
+    /* Only the objects in the spot light's cone or the projector's frustum get anything from the additive pass. */
+    glm::vec4 projector_planes[6];
+    RGL::GpuCulling::ExtractFrustumPlanes(m_projector.m_projection_matrix * m_projector.m_view_matrix, projector_planes);
+
+    m_spot_receivers_count = 0;
 
     for (unsigned i = 0; i < m_objects.size(); ++i)
     {
+        if (!is_lit_by_spot(i, projector_planes))
+        {
+            continue;
+        }
+
+        ++m_spot_receivers_count;
+
         m_spot_light_shader->setUniform("model", m_objects_model_matrices[i]);
         m_spot_light_shader->setUniform("normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_objects_model_matrices[i]))));
         m_spot_light_shader->setUniform("mvp", view_projection * m_objects_model_matrices[i]);
@@ -228,6 +364,124 @@ void ProjectedTexture::render()
     glDisable(GL_BLEND);
 }
 
+void ProjectedTexture::render_single_pass(const glm::mat4& view_projection)
+{
+    const SpotLight& spot = m_spot_light_properties;
+
+    GpuLight light;
+    light.color_intensity  = glm::vec4(spot.color, spot.intensity);
+    light.position_range   = glm::vec4(spot.position, spot.range);
+    light.direction_cutoff = glm::vec4(spot.direction, glm::radians(90.0f - spot.cutoff));
+    light.attenuation_type = glm::vec4(spot.attenuation.constant, spot.attenuation.linear, spot.attenuation.quadratic, GpuLight::SPOT);
+    light.specular         = glm::vec4(m_specular_power.z, m_specular_intenstiy.z, 0.0f, 0.0f);
+
+    glNamedBufferSubData(m_lights_ssbo_id, 0, sizeof(light), &light);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_lights_ssbo_id);
+
+    m_single_pass_shader->bind();
+    m_single_pass_shader->setUniform("lights_count",     1u);
+    m_single_pass_shader->setUniform("ambient_factor",   m_ambient_factor);
+    m_single_pass_shader->setUniform("cam_pos",          m_camera->position());
+    m_single_pass_shader->setUniform("gamma",            m_gamma);
+    m_single_pass_shader->setUniform("projector_matrix", m_projector.transform());
+    m_single_pass_shader->setUniform("projector_shadow_matrix", m_projector.shadow_transform());
+
+    for (unsigned i = 0; i < m_objects.size(); ++i)
+    {
+        m_single_pass_shader->setUniform("model", m_objects_model_matrices[i]);
+        m_single_pass_shader->setUniform("normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_objects_model_matrices[i]))));
+        m_single_pass_shader->setUniform("mvp", view_projection * m_objects_model_matrices[i]);
+
+        m_objects[i]->Render();
+    }
+}
+
+void ProjectedTexture::render_projector_shadow()
+{
+    RGL::ProfilerScope scope("Projector shadow");
+
+    const glm::mat4 view_projection = m_projector.m_projection_matrix * m_projector.m_view_matrix;
+
+    glm::vec4 planes[6];
+    RGL::GpuCulling::ExtractFrustumPlanes(view_projection, planes);
+
+    /* Two sided, the planes and the quad are open. The offset keeps the receivers from shadowing themselves. */
+    glViewport(0, 0, PROJECTOR_SHADOW_MAP_SIZE, PROJECTOR_SHADOW_MAP_SIZE);
+    glDisable(GL_CULL_FACE);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+
+    m_projector_shadow_shader->bind();
+
+    auto render_casters = [&](bool is_dynamic)
+    {
+        for (unsigned i = 0; i < m_objects.size(); ++i)
+        {
+            if (m_objects_is_dynamic[i] != is_dynamic || !is_inside_frustum(planes, world_bounds(m_objects_bounds[i], m_objects_model_matrices[i])))
+            {
+                continue;
+            }
+
+            ++m_shadow_casters_count;
+
+            m_projector_shadow_shader->setUniform("mvp", view_projection * m_objects_model_matrices[i]);
+            m_objects[i]->Render();
+        }
+    };
+
+    m_shadow_casters_count = 0;
+
+    if (!m_is_static_shadow_cached || view_projection != m_static_shadow_view_projection)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_projector_static_shadow_fbo_id);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        render_casters(false);
+
+        m_static_shadow_view_projection = view_projection;
+        ++m_static_shadow_updates_count;
+    }
+
+    glCopyImageSubData(m_projector_static_shadow_map_id, GL_TEXTURE_2D, 0, 0, 0, 0,
+                       m_projector_shadow_map_id,        GL_TEXTURE_2D, 0, 0, 0, 0,
+                       PROJECTOR_SHADOW_MAP_SIZE, PROJECTOR_SHADOW_MAP_SIZE, 1);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_projector_shadow_fbo_id);
+
+    render_casters(true);
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glEnable(GL_CULL_FACE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
+}
+
+bool ProjectedTexture::is_lit_by_spot(uint32_t object_index, const glm::vec4 projector_planes[6]) const
+{
+    const glm::vec4 sphere = world_bounds(m_objects_bounds[object_index], m_objects_model_matrices[object_index]);
+
+    if (is_inside_frustum(projector_planes, sphere))
+    {
+        return true;
+    }
+
+    /* The sphere against the cone of calcSpotLight(), its cosine is the cutoff uniform. */
+    const SpotLight& spot      = m_spot_light_properties;
+    const glm::vec3  to_center = glm::vec3(sphere) - spot.position;
+
+    if (glm::length(to_center) - sphere.w > spot.range)
+    {
+        return false;
+    }
+
+    const float cos_angle = glm::clamp(glm::radians(90.0f - spot.cutoff), 0.0f, 1.0f);
+    const float sin_angle = glm::sqrt(1.0f - cos_angle * cos_angle);
+    const float along     = glm::dot(to_center, spot.direction);
+    const float across    = glm::length(to_center - along * spot.direction);
+
+    return across * cos_angle - along * sin_angle <= sphere.w;
+}
+
 void ProjectedTexture::render_gui()
 {
     /* This method is responsible for rendering GUI using ImGUI. */
@@ -263,6 +517,32 @@ void ProjectedTexture::render_gui()
         ImGui::SliderFloat("Ambient color", &m_ambient_factor, 0.0, 1.0,  "%.2f");
         ImGui::SliderFloat("Gamma",         &m_gamma,          0.0, 10.0, "%.1f");
 
+        ImGui::Checkbox("Single pass lighting", &m_is_single_pass);
+        ImGui::Checkbox("Cache the static shadow", &m_is_static_shadow_cached);
+        ImGui::Checkbox("Animate dynamic objects", &m_animate_dynamic_objects);
+
+        ImGui::Text("Shadow casters drawn: %u, static shadow updates: %u", m_shadow_casters_count, m_static_shadow_updates_count);
+
+        if (!m_is_single_pass)
+        {
+            ImGui::Text("Spot light receivers drawn: %u / %u", m_spot_receivers_count, uint32_t(m_objects.size()));
+        }
+
+        for (uint32_t index : RGL::Profiler::GetResolvedScopes())
+        {
+            const auto& scope = RGL::Profiler::GetScope(index);
+
+            if (scope.m_name == "Lighting")
+            {
+                ImGui::Text("Lighting (%s): %.3f ms", m_is_single_pass ? "single pass" : "multipass", scope.m_gpu_ms);
+            }
+
+            if (scope.m_name == "Projector shadow")
+            {
+                ImGui::Text("Projector shadow: %.3f ms", scope.m_gpu_ms);
+            }
+        }
+
         ImGui::Spacing();
 
         ImGuiTabBarFlags tab_bar_flags = ImGuiTabBarFlags_None;
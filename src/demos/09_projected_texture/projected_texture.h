@@ -57,6 +57,24 @@ struct Projector
     {
         return m_bias_matrix * m_projection_matrix * m_view_matrix;
     }
+
+    /* To the texture space of the projector's shadow map, the whole frustum. */
+    glm::mat4 shadow_transform() const
+    {
+        return glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f)) * m_projection_matrix * m_view_matrix;
+    }
+};
+
+/* A light of the single pass, std430, in sync with GpuLight in lighting.glh. */
+struct GpuLight
+{
+    enum Type { DIRECTIONAL = 0, POINT = 1, SPOT = 2 };
+
+    glm::vec4 color_intensity;
+    glm::vec4 position_range;
+    glm::vec4 direction_cutoff;
+    glm::vec4 attenuation_type;  /* xyz - constant, linear and quadratic attenuation, w - Type */
+    glm::vec4 specular;          /* x - power, y - intensity */
 };
 
 class ProjectedTexture : public RGL::CoreApp
@@ -72,12 +90,28 @@ public:
     void render_gui()               override;
 
 private:
+    /* The ambient and the lights of the SSBO in one pass per object, instead of a pass for each. */
+    void render_single_pass(const glm::mat4& view_projection);
+
+    /*
+     * The projector's depth. The static objects are rendered into a cached map only when the projector moves,
+     * every frame copies it and draws the dynamic objects on top. Objects outside the projector's frustum are skipped.
+     */
+    void render_projector_shadow();
+
+    /* Whether the object can be lit or projected on by the spot light, its cone or the projector's frustum. */
+    bool is_lit_by_spot(uint32_t object_index, const glm::vec4 projector_planes[6]) const;
+
     std::shared_ptr<RGL::Camera> m_camera;
     std::shared_ptr<RGL::Shader> m_ambient_light_shader;
     std::shared_ptr<RGL::Shader> m_spot_light_shader;
+    std::shared_ptr<RGL::Shader> m_single_pass_shader;
+    std::shared_ptr<RGL::Shader> m_projector_shadow_shader;
 
     std::vector<std::shared_ptr<RGL::StaticModel>> m_objects;
     std::vector<glm::mat4> m_objects_model_matrices;
+    std::vector<glm::vec4> m_objects_bounds;     /* Object space bounding spheres - xyz center, w radius. */
+    std::vector<bool>      m_objects_is_dynamic;
 
     SpotLight m_spot_light_properties;
     Projector m_projector;
@@ -92,4 +126,23 @@ private:
 
     float m_ambient_factor;
     float m_gamma;
+
+    GLuint m_lights_ssbo_id;
+    bool   m_is_single_pass;
+
+    /* The projector's shadow map and its cache of the static objects. */
+    static constexpr GLsizei PROJECTOR_SHADOW_MAP_SIZE = 1024;
+
+    GLuint    m_projector_shadow_map_id;
+    GLuint    m_projector_static_shadow_map_id;
+    GLuint    m_projector_shadow_fbo_id;
+    GLuint    m_projector_static_shadow_fbo_id;
+    glm::mat4 m_static_shadow_view_projection;    /* The projector's matrix the cache was rendered with. */
+    bool      m_is_static_shadow_cached;
+    bool      m_animate_dynamic_objects;
+    float     m_dynamic_objects_angle;
+
+    uint32_t  m_static_shadow_updates_count;
+    uint32_t  m_shadow_casters_count;             /* Drawn in the last frame, the static ones only when the cache was updated. */
+    uint32_t  m_spot_receivers_count;
 };
\ No newline at end of file
@@ -0,0 +1,9 @@
+#version 460 core
+layout (location = 0) in vec3 in_pos;
+
+uniform mat4 mvp;
+
+void main()
+{
+    gl_Position = mvp * vec4(in_pos, 1.0);
+}
@@ -1,11 +1,259 @@
 #include "postprocessing_filters.h"
 #include "filesystem.h"
+#include "gl_state.h"
 #include "input.h"
+#include "profiler.h"
 #include "util.h"
 #include "gui/gui.h"
 
 #include <glm/gtc/matrix_inverse.hpp>
 
+PostprocessStack::PostprocessStack()
+{
+    for (int i = 0; i < int(Effect::COUNT); ++i)
+    {
+        m_chain.push_back({ Effect(i), false });
+    }
+
+    std::string dir = "src/demos/10_postprocessing_filters/";
+
+    /* The filters write the targets of the HDR color's format. */
+    const char* image_format = RGL::RenderTargetPool::GetImageFormatQualifier(RGL::RenderTargetPool::GetColorFormat(RGL::RenderTargetUsage::HDR_COLOR));
+
+    m_uber_shader = std::make_shared<RGL::Shader>(dir + "postprocess_uber.comp");
+    m_uber_shader->setDefine("HDR_IMAGE_FORMAT", image_format);
+    m_uber_shader->link();
+
+    m_gaussian_blur_shader = std::make_shared<RGL::Shader>(dir + "gaussian_blur.comp");
+    m_gaussian_blur_shader->setDefine("HDR_IMAGE_FORMAT", image_format);
+    m_gaussian_blur_shader->link();
+
+    m_gaussian_blur_shared_shader = std::make_shared<RGL::Shader>(dir + "gaussian_blur_shared.comp");
+    m_gaussian_blur_shared_shader->setDefine("HDR_IMAGE_FORMAT", image_format);
+    m_gaussian_blur_shared_shader->link();
+
+    m_edge_detection_shader = std::make_shared<RGL::Shader>(dir + "edge_detection.comp");
+    m_edge_detection_shader->setDefine("HDR_IMAGE_FORMAT", image_format);
+    m_edge_detection_shader->link();
+
+    m_edge_detection_shared_shader = std::make_shared<RGL::Shader>(dir + "edge_detection_shared.comp");
+    m_edge_detection_shared_shader->setDefine("HDR_IMAGE_FORMAT", image_format);
+    m_edge_detection_shared_shader->link();
+
+    m_present_shader = std::make_shared<RGL::Shader>(dir + "FSQ.vert", dir + "present.frag");
+    m_present_shader->link();
+
+    glCreateVertexArrays(1, &m_dummy_vao_id);
+}
+
+PostprocessStack::~PostprocessStack()
+{
+    if (m_dummy_vao_id != 0)
+    {
+        glDeleteVertexArrays(1, &m_dummy_vao_id);
+    }
+}
+
+void PostprocessStack::bindFilterFBO()
+{
+    m_rt = RGL::RenderTargetPool::Acquire({ uint32_t(RGL::Window::getWidth()), uint32_t(RGL::Window::getHeight()),
+                                            RGL::RenderTargetPool::GetColorFormat(RGL::RenderTargetUsage::HDR_COLOR), GL_DEPTH24_STENCIL8 });
+    m_rt->Bind();
+}
+
+void PostprocessStack::render()
+{
+    RGL::ProfilerScope scope("Postprocess");
+
+    RenderTargetPtr  input = std::move(m_rt);
+    std::vector<int> fused_effects;
+
+    m_passes_count = 0;
+
+    for (const auto& slot : m_chain)
+    {
+        if (!slot.m_enabled)
+        {
+            continue;
+        }
+
+        if (IsPerPixel(slot.m_effect))
+        {
+            fused_effects.push_back(int(slot.m_effect));
+
+            if (fused_effects.size() < MAX_FUSED_EFFECTS)
+            {
+                continue;
+            }
+        }
+
+        /* A filter reads the neighbours of a pixel, the per-pixel effects before it have to be done. */
+        if (!fused_effects.empty())
+        {
+            input = RunPerPixelEffects(input, fused_effects);
+            fused_effects.clear();
+        }
+
+        if (slot.m_effect == Effect::GAUSSIAN_BLUR)
+        {
+            input = RunGaussianBlur(input);
+        }
+        else if (slot.m_effect == Effect::EDGE_DETECTION)
+        {
+            input = RunEdgeDetection(input);
+        }
+    }
+
+    if (!fused_effects.empty())
+    {
+        input = RunPerPixelEffects(input, fused_effects);
+    }
+
+    RGL::GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+    RGL::GLState::Viewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    m_present_shader->bind();
+    input->BindColor(0);
+
+    glBindVertexArray(m_dummy_vao_id);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    ++m_frame;
+}
+
+PostprocessStack::RenderTargetPtr PostprocessStack::RunPerPixelEffects(const RenderTargetPtr& input, const std::vector<int>& effects)
+{
+    RGL::ProfilerScope scope("Fused effects");
+
+    m_uber_shader->bind();
+    m_uber_shader->setUniform("u_effects",            GLsizei(effects.size()), const_cast<int*>(effects.data()));
+    m_uber_shader->setUniform("u_effects_count",      int(effects.size()));
+    m_uber_shader->setUniform("u_exposure",           m_settings.m_exposure);
+    m_uber_shader->setUniform("u_gamma",              m_settings.m_gamma);
+    m_uber_shader->setUniform("u_contrast",           m_settings.m_contrast);
+    m_uber_shader->setUniform("u_saturation",         m_settings.m_saturation);
+    m_uber_shader->setUniform("u_tint",               m_settings.m_tint);
+    m_uber_shader->setUniform("u_vignette_intensity", m_settings.m_vignette_intensity);
+    m_uber_shader->setUniform("u_vignette_radius",    m_settings.m_vignette_radius);
+    m_uber_shader->setUniform("u_grain_intensity",    m_settings.m_grain_intensity);
+    m_uber_shader->setUniform("u_frame",              GLuint(m_frame));
+
+    return Dispatch(*m_uber_shader, input);
+}
+
+PostprocessStack::RenderTargetPtr PostprocessStack::RunGaussianBlur(const RenderTargetPtr& input)
+{
+    RGL::ProfilerScope scope("Gaussian blur");
+
+    UpdateGaussianTaps();
+
+    if (m_shared_memory_filters)
+    {
+        glm::uvec2 size(input->GetWidth(), input->GetHeight());
+
+        m_gaussian_blur_shared_shader->bind();
+        m_gaussian_blur_shared_shader->setUniform("u_weights", m_gaussian_kernel, m_gaussian_taps_radius + 1);
+        m_gaussian_blur_shared_shader->setUniform("u_radius",  m_gaussian_taps_radius);
+
+        m_gaussian_blur_shared_shader->setUniform("u_direction", glm::vec2(1.0f, 0.0f));
+        auto horizontal = Dispatch(*m_gaussian_blur_shared_shader, input, { (size.x + BLUR_TILE_SIZE - 1) / BLUR_TILE_SIZE, size.y });
+
+        m_gaussian_blur_shared_shader->setUniform("u_direction", glm::vec2(0.0f, 1.0f));
+        return Dispatch(*m_gaussian_blur_shared_shader, horizontal, { (size.y + BLUR_TILE_SIZE - 1) / BLUR_TILE_SIZE, size.x });
+    }
+
+    m_gaussian_blur_shader->bind();
+    m_gaussian_blur_shader->setUniform("u_weights",    m_gaussian_weights, MAX_GAUSSIAN_TAPS);
+    m_gaussian_blur_shader->setUniform("u_offsets",    m_gaussian_offsets, MAX_GAUSSIAN_TAPS);
+    m_gaussian_blur_shader->setUniform("u_taps_count", m_gaussian_taps_count);
+
+    m_gaussian_blur_shader->setUniform("u_direction", glm::vec2(1.0f, 0.0f));
+    auto horizontal = Dispatch(*m_gaussian_blur_shader, input);
+
+    m_gaussian_blur_shader->setUniform("u_direction", glm::vec2(0.0f, 1.0f));
+    return Dispatch(*m_gaussian_blur_shader, horizontal);
+}
+
+PostprocessStack::RenderTargetPtr PostprocessStack::RunEdgeDetection(const RenderTargetPtr& input)
+{
+    RGL::ProfilerScope scope("Edge detection");
+
+    if (m_shared_memory_filters)
+    {
+        m_edge_detection_shared_shader->bind();
+        return Dispatch(*m_edge_detection_shared_shader, input, { (input->GetWidth()  + EDGE_TILE_SIZE - 1) / EDGE_TILE_SIZE,
+                                                                  (input->GetHeight() + EDGE_TILE_SIZE - 1) / EDGE_TILE_SIZE });
+    }
+
+    m_edge_detection_shader->bind();
+    return Dispatch(*m_edge_detection_shader, input);
+}
+
+PostprocessStack::RenderTargetPtr PostprocessStack::Dispatch(RGL::Shader& shader, const RenderTargetPtr& input, glm::uvec2 workgroups)
+{
+    /* The input is still held, so the pool hands out another target of the same size. */
+    auto output = RGL::RenderTargetPool::Acquire({ input->GetWidth(), input->GetHeight(), input->GetDesc().m_color_format, 0 });
+
+    if (workgroups == glm::uvec2(0))
+    {
+        workgroups = (glm::uvec2(output->GetWidth(), output->GetHeight()) + 7u) / 8u;
+    }
+
+    input->BindColor(0);
+    output->BindColorImage(0, 0, GL_WRITE_ONLY);
+
+    glDispatchCompute(workgroups.x, workgroups.y, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    ++m_passes_count;
+    return output;
+}
+
+void PostprocessStack::UpdateGaussianTaps()
+{
+    int   radius = glm::clamp(m_settings.m_blur_radius, 1, MAX_GAUSSIAN_RADIUS);
+    float sigma  = glm::max(m_settings.m_blur_sigma, 0.1f);
+
+    if (radius == m_gaussian_taps_radius && sigma == m_gaussian_taps_sigma)
+    {
+        return;
+    }
+
+    m_gaussian_taps_radius = radius;
+    m_gaussian_taps_sigma  = sigma;
+
+    std::vector<float> weights(radius + 1);
+    float sum = 0.0f;
+
+    for (int i = 0; i <= radius; ++i)
+    {
+        weights[i] = glm::exp(-float(i * i) / (2.0f * sigma * sigma));
+        sum       += i == 0 ? weights[i] : 2.0f * weights[i];
+    }
+
+    for (int i = 0; i <= radius; ++i)
+    {
+        weights[i]          /= sum;
+        m_gaussian_kernel[i] = weights[i];
+    }
+
+    /* The texels i and i + 1 in one bilinear fetch, at the offset that weighs them as the kernel does. */
+    m_gaussian_weights[0] = weights[0];
+    m_gaussian_offsets[0] = 0.0f;
+    m_gaussian_taps_count = 1;
+
+    for (int i = 1; i <= radius; i += 2)
+    {
+        float w0 = weights[i];
+        float w1 = i + 1 <= radius ? weights[i + 1] : 0.0f;
+
+        m_gaussian_weights[m_gaussian_taps_count] = w0 + w1;
+        m_gaussian_offsets[m_gaussian_taps_count] = (i * w0 + (i + 1) * w1) / (w0 + w1);
+        ++m_gaussian_taps_count;
+    }
+}
+
 PostprocessingFilters::PostprocessingFilters()
     : m_specular_power    (120.0f),
       m_specular_intenstiy(0.0f),
@@ -29,6 +277,7 @@ void PostprocessingFilters::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(-6, 5.0, 10.0);
     m_camera->setOrientation(20.0f, 30.0f, 0.0f);
 
@@ -84,8 +333,7 @@ void PostprocessingFilters::init_app()
     m_directional_light_shader = std::make_shared<RGL::Shader>(dir + "lighting.vert", dir2 + "lighting-directional.frag");
     m_directional_light_shader->link();
 
-    m_postprocess_filter = std::make_shared<PostprocessFilter>(RGL::Window::getWidth(), RGL::Window::getHeight());
-    m_current_ps_filter_name = m_ps_filter_names_list[0];
+    m_postprocess_stack = std::make_shared<PostprocessStack>();
 }
 
 void PostprocessingFilters::input()
@@ -139,13 +387,12 @@ void PostprocessingFilters::update(double delta_time)
 void PostprocessingFilters::render()
 {
     /* First pass - render to offscreen FBO */
-    m_postprocess_filter->bindFilterFBO();
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    m_postprocess_stack->bindFilterFBO();
 
     m_ambient_light_shader->bind();
     m_ambient_light_shader->setUniform("ambient_factor", m_ambient_factor);
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+    auto view_projection = m_camera->viewProjection();
 
     /* First, render the ambient color only for the opaque objects. */
     for (unsigned i = 0; i < m_objects.size(); ++i)
@@ -189,8 +436,8 @@ void PostprocessingFilters::render()
     glDepthFunc(GL_LESS);
     glDisable(GL_BLEND);
 
-    /* Render FSQ with postprocess filter */
-    m_postprocess_filter->render(m_current_ps_filter_name);
+    /* Run the post-processing chain and present its result */
+    m_postprocess_stack->render();
 }
 
 void PostprocessingFilters::render_gui()
@@ -227,25 +474,76 @@ void PostprocessingFilters::render_gui()
         ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
         ImGui::SliderFloat("Ambient color", &m_ambient_factor, 0.0, 1.0,  "%.2f");
 
-        if (ImGui::BeginCombo("Postprocess filter", m_current_ps_filter_name.c_str()))
+        ImGui::PopItemWidth();
+        ImGui::Spacing();
+
+        if (ImGui::CollapsingHeader("Postprocess chain", ImGuiTreeNodeFlags_DefaultOpen))
         {
-            for (auto& sf : m_ps_filter_names_list)
+            auto& chain = m_postprocess_stack->m_chain;
+
+            for (int i = 0; i < int(chain.size()); ++i)
             {
-                bool is_selected = (m_current_ps_filter_name == sf);
-                if (ImGui::Selectable(sf.c_str(), is_selected))
+                ImGui::PushID(i);
                 {
-                    m_current_ps_filter_name = sf;
+                    if (ImGui::ArrowButton("##up", ImGuiDir_Up) && i > 0)
+                    {
+                        std::swap(chain[i], chain[i - 1]);
+                    }
+                    ImGui::SameLine();
+
+                    if (ImGui::ArrowButton("##down", ImGuiDir_Down) && i < int(chain.size()) - 1)
+                    {
+                        std::swap(chain[i], chain[i + 1]);
+                    }
+                    ImGui::SameLine();
+
+                    ImGui::Checkbox(PostprocessStack::EFFECT_NAMES[int(chain[i].m_effect)], &chain[i].m_enabled);
                 }
+                ImGui::PopID();
+            }
+
+            ImGui::Text("Compute passes: %u", m_postprocess_stack->m_passes_count);
+            if (ImGui::IsItemHovered())
+            {
+                ImGui::SetTooltip("Consecutive per-pixel effects run fused in a single pass, the Gaussian blur takes two.");
+            }
+
+            ImGui::Checkbox("Shared memory filters", &m_postprocess_stack->m_shared_memory_filters);
+            if (ImGui::IsItemHovered())
+            {
+                ImGui::SetTooltip("The blur and the edge detection fetch their tile and its apron to shared memory once,\n"
+                                  "instead of a texture fetch per tap.");
+            }
+
+            /* The GPU times of the passes, the children of the Postprocess scope. */
+            for (uint32_t index : RGL::Profiler::GetResolvedScopes())
+            {
+                const auto& scope = RGL::Profiler::GetScope(index);
 
-                if (is_selected)
+                if (scope.m_depth > 0 && RGL::Profiler::GetScope(scope.m_parent).m_name == "Postprocess")
                 {
-                    ImGui::SetItemDefaultFocus();
+                    ImGui::Text("%-16s %.3f ms", scope.m_name.c_str(), scope.m_gpu_ms);
                 }
             }
-            ImGui::EndCombo();
+
+            auto& settings = m_postprocess_stack->m_settings;
+
+            ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
+            {
+                ImGui::SliderFloat("Blur sigma",         &settings.m_blur_sigma,         0.5, 16.0, "%.1f");
+                ImGui::SliderInt  ("Blur radius",        &settings.m_blur_radius,        1,   PostprocessStack::MAX_GAUSSIAN_RADIUS);
+                ImGui::SliderFloat("Exposure",           &settings.m_exposure,           0.0, 10.0, "%.1f");
+                ImGui::SliderFloat("Gamma",              &settings.m_gamma,              0.0, 10.0, "%.1f");
+                ImGui::SliderFloat("Contrast",           &settings.m_contrast,           0.0, 2.0,  "%.2f");
+                ImGui::SliderFloat("Saturation",         &settings.m_saturation,         0.0, 2.0,  "%.2f");
+                ImGui::ColorEdit3 ("Tint",               &settings.m_tint[0]);
+                ImGui::SliderFloat("Vignette intensity", &settings.m_vignette_intensity, 0.0, 1.0,  "%.2f");
+                ImGui::SliderFloat("Vignette radius",    &settings.m_vignette_radius,    0.0, 1.0,  "%.2f");
+                ImGui::SliderFloat("Grain intensity",    &settings.m_grain_intensity,    0.0, 0.5,  "%.2f");
+            }
+            ImGui::PopItemWidth();
         }
 
-        ImGui::PopItemWidth();
         ImGui::Spacing();
 
         ImGuiTabBarFlags tab_bar_flags = ImGuiTabBarFlags_None;
@@ -2,6 +2,7 @@
 #include "core_app.h"
 
 #include "camera.h"
+#include "render_target_pool.h"
 #include "static_model.h"
 #include "shader.h"
 
@@ -31,88 +32,100 @@ struct DirectionalLight : BaseLight
     }
 };
 
-struct PostprocessFilter
+/*
+ * A chain of post-processing effects, in an order and with a set of enabled effects that can change every frame.
+ * The per-pixel effects that follow one another in the chain run fused in a single compute pass (postprocess_uber.comp),
+ * the Gaussian blur runs as two 1D passes and the edge detection as a pass of its own. The passes ping-pong
+ * between pooled render targets.
+ */
+struct PostprocessStack
 {
-    std::shared_ptr<RGL::Shader> m_shader;
+    /* Keep the per-pixel effects last and in sync with the defines in postprocess_uber.comp. */
+    enum class Effect { GAUSSIAN_BLUR, EDGE_DETECTION, NEGATIVE, TONE_MAPPING, COLOR_GRADING, VIGNETTE, GRAIN, COUNT };
 
-    GLuint m_fbo_id;
-    GLuint m_rbo_id;
-    GLuint m_tex_id;
-    GLuint m_dummy_vao_id;
+    static constexpr const char* EFFECT_NAMES[] = { "Gaussian blur", "Edge detection", "Negative", "Tone mapping", "Color grading", "Vignette", "Grain" };
 
-    PostprocessFilter(uint32_t width, uint32_t height)
+    /* Of the uber pass, and the kernel half-width a blur pass fetches with MAX_GAUSSIAN_TAPS linear taps. */
+    static constexpr uint32_t MAX_FUSED_EFFECTS   = 8;
+    static constexpr uint32_t MAX_GAUSSIAN_TAPS   = 17;
+    static constexpr int      MAX_GAUSSIAN_RADIUS = 2 * (MAX_GAUSSIAN_TAPS - 1);
+
+    /* The workgroup tiles of the shared memory filters, in sync with gaussian_blur_shared.comp and edge_detection_shared.comp. */
+    static constexpr uint32_t BLUR_TILE_SIZE = 128;
+    static constexpr uint32_t EDGE_TILE_SIZE = 16;
+
+    static bool IsPerPixel(Effect effect) { return effect >= Effect::NEGATIVE; }
+
+    struct Slot
     {
-        glGenFramebuffers(1, &m_fbo_id);
-        glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_id);
+        Effect m_effect;
+        bool   m_enabled;
+    };
 
-        glGenTextures(1, &m_tex_id);
-        glBindTexture(GL_TEXTURE_2D, m_tex_id);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glBindTexture(GL_TEXTURE_2D, 0);
+    struct Settings
+    {
+        float     m_exposure           = 1.0f;
+        float     m_gamma              = 2.2f;
+        float     m_contrast           = 1.0f;
+        float     m_saturation         = 1.0f;
+        glm::vec3 m_tint               = glm::vec3(1.0f);
+        float     m_vignette_intensity = 0.5f;
+        float     m_vignette_radius    = 0.5f;
+        float     m_grain_intensity    = 0.05f;
+        float     m_blur_sigma         = 7.0f;
+        int       m_blur_radius        = 16;   /* In texels, up to MAX_GAUSSIAN_RADIUS. */
+    };
 
-        glGenRenderbuffers(1, &m_rbo_id);
-        glBindRenderbuffer(GL_RENDERBUFFER, m_rbo_id);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    std::vector<Slot> m_chain;
+    Settings          m_settings;
 
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_tex_id, 0);
-        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_rbo_id);
+    /* The filters fetch their tile and its apron to shared memory once instead of a texture fetch per tap. */
+    bool m_shared_memory_filters = true;
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    /* The passes of the last render(), the presentation excluded. */
+    uint32_t m_passes_count = 0;
 
-        m_shader = std::make_shared<RGL::Shader>("src/demos/10_postprocessing_filters/FSQ.vert", "src/demos/10_postprocessing_filters/PS_filters.frag");
-        m_shader->link();
+    PostprocessStack();
+    ~PostprocessStack();
 
-        glGenVertexArrays(1, &m_dummy_vao_id);
-    }
+    /* Acquires the scene target of the frame and binds it. */
+    void bindFilterFBO();
 
-    ~PostprocessFilter()
-    {
-        if(m_fbo_id != 0)
-        {
-            glDeleteFramebuffers(1, &m_fbo_id);
-        }
-
-        if(m_rbo_id != 0)
-        {
-            glDeleteRenderbuffers(1, &m_rbo_id);
-        }
-
-        if(m_tex_id != 0)
-        {
-            glDeleteTextures(1, &m_tex_id);
-        }
-
-        if (m_dummy_vao_id != 0)
-        {
-            glDeleteVertexArrays(1, &m_dummy_vao_id);
-        }
-    }
+    /* Runs the chain on the scene target and presents the result to the default framebuffer. */
+    void render();
 
-    void bindTexture(GLuint unit = 0)
-    {
-        glBindTextureUnit(unit, m_tex_id);
-    }
+private:
+    using RenderTargetPtr = std::shared_ptr<RGL::RenderTarget>;
 
-    void bindFilterFBO()
-    {
-        glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_id);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    }
+    RenderTargetPtr RunPerPixelEffects(const RenderTargetPtr& input, const std::vector<int>& effects);
+    RenderTargetPtr RunGaussianBlur   (const RenderTargetPtr& input);
+    RenderTargetPtr RunEdgeDetection  (const RenderTargetPtr& input);
 
-    void render(const std::string filter_name)
-    {
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    /* A pass of the compute shader from input to a new pooled target, 8x8 pixels per workgroup by default. */
+    RenderTargetPtr Dispatch(RGL::Shader& shader, const RenderTargetPtr& input, glm::uvec2 workgroups = glm::uvec2(0));
 
-        m_shader->bind();
-        m_shader->setSubroutine(RGL::Shader::ShaderType::FRAGMENT, filter_name);
-        bindTexture();
+    /* The weights and the linear taps of the Gaussian kernel, recomputed when its sigma or radius changes. */
+    void UpdateGaussianTaps();
 
-        glBindVertexArray(m_dummy_vao_id);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-    }
+    std::shared_ptr<RGL::Shader> m_uber_shader;
+    std::shared_ptr<RGL::Shader> m_gaussian_blur_shader;
+    std::shared_ptr<RGL::Shader> m_gaussian_blur_shared_shader;
+    std::shared_ptr<RGL::Shader> m_edge_detection_shader;
+    std::shared_ptr<RGL::Shader> m_edge_detection_shared_shader;
+    std::shared_ptr<RGL::Shader> m_present_shader;
+
+    /* The HDR target of the frame, from bindFilterFBO() until render(). */
+    RenderTargetPtr m_rt;
+
+    float m_gaussian_kernel [MAX_GAUSSIAN_RADIUS + 1] = {};
+    float m_gaussian_weights[MAX_GAUSSIAN_TAPS] = {};
+    float m_gaussian_offsets[MAX_GAUSSIAN_TAPS] = {};
+    int   m_gaussian_taps_count  = 0;
+    float m_gaussian_taps_sigma  = 0.0f;
+    int   m_gaussian_taps_radius = 0;
+
+    uint32_t m_frame        = 0;
+    GLuint   m_dummy_vao_id = 0;
 };
 
 class PostprocessingFilters : public RGL::CoreApp
@@ -132,9 +145,7 @@ private:
     std::shared_ptr<RGL::Shader> m_ambient_light_shader;
     std::shared_ptr<RGL::Shader> m_directional_light_shader;
 
-    std::shared_ptr<PostprocessFilter> m_postprocess_filter;
-    std::string m_current_ps_filter_name;
-    std::string m_ps_filter_names_list[4] = { "no_filter", "negative", "edge_detection", "gaussian_blur" };
+    std::shared_ptr<PostprocessStack> m_postprocess_stack;
 
     std::vector<std::shared_ptr<RGL::StaticModel>> m_objects;
     std::vector<glm::mat4> m_objects_model_matrices;
@@ -0,0 +1,12 @@
+#version 450
+
+in vec2 texcoord;
+out vec4 fragColor;
+
+// The result of the post-processing chain.
+layout(binding = 0) uniform sampler2D filterTexture;
+
+void main()
+{
+	fragColor = vec4(clamp(texture(filterTexture, texcoord).rgb, 0.0, 1.0), 1.0);
+}
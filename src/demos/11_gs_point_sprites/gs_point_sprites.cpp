@@ -1,6 +1,7 @@
 #include "gs_point_sprites.h"
 #include "filesystem.h"
 #include "input.h"
+#include "profiler.h"
 #include "util.h"
 #include "gui/gui.h"
 
@@ -9,8 +10,11 @@
 GSPointSprites::GSPointSprites()
     : m_sprites_vao_id(0),
       m_sprites_vbo_id(0),
+      m_dummy_vao_id(0),
       m_no_sprites(1000),
-      m_half_quad_width(0.2f)
+      m_half_quad_width(0.2f),
+      m_sprites_path(SpritesPath::VERTEX_PULLING),
+      m_sprites_paths_gpu_ms{ 0.0f, 0.0f }
 {
 }
 
@@ -25,6 +29,11 @@ GSPointSprites::~GSPointSprites()
     {
         glDeleteBuffers(1, &m_sprites_vbo_id);
     }
+
+    if(m_dummy_vao_id != 0)
+    {
+        glDeleteVertexArrays(1, &m_dummy_vao_id);
+    }
 }
 
 void GSPointSprites::init_app()
@@ -41,6 +50,7 @@ void GSPointSprites::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(-6, 5.0, 10.0);
     m_camera->setOrientation(20.0f, 30.0f, 0.0f);
 
@@ -53,7 +63,28 @@ void GSPointSprites::init_app()
     m_point_sprites_shader = std::make_shared<RGL::Shader>(dir + "gs_point_sprites.vert", dir + "gs_point_sprites.frag", dir + "gs_point_sprites.geom");
     m_point_sprites_shader->link();
 
-    /* Create VAO and VBO for point sprites */
+    m_point_sprites_pulling_shader = std::make_shared<RGL::Shader>(dir + "point_sprites_pulling.vert", dir + "gs_point_sprites.frag");
+    m_point_sprites_pulling_shader->link();
+
+    /* Create VAO for point sprites, the vertex pulling draws without attributes */
+    glCreateVertexArrays(1, &m_sprites_vao_id);
+    glCreateVertexArrays(1, &m_dummy_vao_id);
+
+    /* Set up VAO */
+    glEnableVertexArrayAttrib(m_sprites_vao_id, 0 /*index*/);
+
+    /* Separate attribute format */
+    glVertexArrayAttribFormat (m_sprites_vao_id, 0 /*index*/, 3 /*size*/, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/);
+    glVertexArrayAttribBinding(m_sprites_vao_id, 0 /*index*/, 0 /*bindingindex*/);
+
+    create_sprites(m_no_sprites);
+}
+
+void GSPointSprites::create_sprites(uint32_t sprites_count)
+{
+    m_no_sprites = sprites_count;
+
+    /* Create VBO for point sprites */
     std::vector<glm::vec3> m_sprites_positions(m_no_sprites);
 
     for (uint32_t i = 0; i < m_no_sprites; ++i)
@@ -61,18 +92,15 @@ void GSPointSprites::init_app()
         m_sprites_positions[i] = glm::sphericalRand(10.0f);
     }
 
-    glCreateVertexArrays(1, &m_sprites_vao_id);
+    if (m_sprites_vbo_id != 0)
+    {
+        glDeleteBuffers(1, &m_sprites_vbo_id);
+    }
 
     glCreateBuffers(1, &m_sprites_vbo_id);
     glNamedBufferStorage(m_sprites_vbo_id, m_sprites_positions.size() * sizeof(m_sprites_positions[0]), m_sprites_positions.data(), 0 /*flags*/);
 
-    /* Set up VAO */
-    glEnableVertexArrayAttrib(m_sprites_vao_id, 0 /*index*/);
-
-    /* Separate attribute format */
-    glVertexArrayAttribFormat (m_sprites_vao_id, 0 /*index*/, 3 /*size*/, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/);
-    glVertexArrayAttribBinding(m_sprites_vao_id, 0 /*index*/, 0 /*bindingindex*/);
-    glVertexArrayVertexBuffer (m_sprites_vao_id, 0 /*bindingindex*/, m_sprites_vbo_id, 0 /*offset*/, sizeof(m_sprites_positions[0]) /*stride*/);
+    glVertexArrayVertexBuffer(m_sprites_vao_id, 0 /*bindingindex*/, m_sprites_vbo_id, 0 /*offset*/, sizeof(m_sprites_positions[0]) /*stride*/);
 }
 
 void GSPointSprites::input()
@@ -127,14 +155,29 @@ void GSPointSprites::render()
 {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    m_point_sprites_shader->bind();
-    m_point_sprites_shader->setUniform("model_view_matrix", m_camera->m_view);
-    m_point_sprites_shader->setUniform("half_quad_width", m_half_quad_width);
-    m_point_sprites_shader->setUniform("projection_matrix", m_camera->m_projection);
+    const bool is_vertex_pulling = m_sprites_path == SpritesPath::VERTEX_PULLING;
+    const auto& shader           = is_vertex_pulling ? m_point_sprites_pulling_shader : m_point_sprites_shader;
+
+    RGL::ProfilerScope scope(is_vertex_pulling ? "Sprites (vertex pulling)" : "Sprites (geometry shader)");
+
+    shader->bind();
+    shader->setUniform("model_view_matrix", m_camera->m_view);
+    shader->setUniform("half_quad_width", m_half_quad_width);
+    shader->setUniform("projection_matrix", m_camera->m_projection);
 
     m_sprite_tex->Bind(0);
-    glBindVertexArray(m_sprites_vao_id);
-    glDrawArrays(GL_POINTS, 0, m_no_sprites);
+
+    if (is_vertex_pulling)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_sprites_vbo_id);
+        glBindVertexArray(m_dummy_vao_id);
+        glDrawArrays(GL_TRIANGLES, 0, 6 * m_no_sprites);
+    }
+    else
+    {
+        glBindVertexArray(m_sprites_vao_id);
+        glDrawArrays(GL_POINTS, 0, m_no_sprites);
+    }
 }
 
 void GSPointSprites::render_gui()
@@ -170,7 +213,54 @@ void GSPointSprites::render_gui()
 
         ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
         ImGui::SliderFloat("Half quad width", &m_half_quad_width, 0.1f, 1.0f, "%.1f");
+
+        if (ImGui::BeginCombo("Sprites path", m_sprites_paths_names[int(m_sprites_path)].c_str()))
+        {
+            for (int i = 0; i < m_sprites_paths_names.size(); ++i)
+            {
+                bool is_selected = (m_sprites_path == SpritesPath(i));
+                if (ImGui::Selectable(m_sprites_paths_names[i].c_str(), is_selected))
+                {
+                    m_sprites_path = SpritesPath(i);
+                }
+
+                if (is_selected)
+                {
+                    ImGui::SetItemDefaultFocus();
+                }
+            }
+            ImGui::EndCombo();
+        }
+
+        /* The buffer is made again once the slider is released. */
+        static int sprites_count = m_no_sprites;
+        ImGui::SliderInt("Sprites count", &sprites_count, 1000, 4000000, "%d", ImGuiSliderFlags_Logarithmic);
+
+        if (ImGui::IsItemDeactivatedAfterEdit())
+        {
+            create_sprites(uint32_t(sprites_count));
+        }
+
         ImGui::PopItemWidth();
+
+        for (uint32_t index : RGL::Profiler::GetResolvedScopes())
+        {
+            const auto& scope = RGL::Profiler::GetScope(index);
+
+            if (scope.m_name == "Sprites (geometry shader)")
+            {
+                m_sprites_paths_gpu_ms[int(SpritesPath::GEOMETRY_SHADER)] = scope.m_gpu_ms;
+            }
+
+            if (scope.m_name == "Sprites (vertex pulling)")
+            {
+                m_sprites_paths_gpu_ms[int(SpritesPath::VERTEX_PULLING)] = scope.m_gpu_ms;
+            }
+        }
+
+        /* The path not drawn keeps its last timing, switch between them to compare. */
+        ImGui::Text("Geometry shader: %.3f ms", m_sprites_paths_gpu_ms[int(SpritesPath::GEOMETRY_SHADER)]);
+        ImGui::Text("Vertex pulling:  %.3f ms", m_sprites_paths_gpu_ms[int(SpritesPath::VERTEX_PULLING)]);
         ImGui::Spacing();
     }
     ImGui::End();
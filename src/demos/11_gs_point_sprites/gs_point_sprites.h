@@ -6,6 +6,8 @@
 #include "texture.h"
 
 #include <memory>
+#include <string>
+#include <vector>
 
 class GSPointSprites : public RGL::CoreApp
 {
@@ -20,12 +22,23 @@ public:
     void render_gui()               override;
 
 private:
+    /* The geometry shader expands the points, the vertex pulling draws 6 vertices per sprite from the same buffer. */
+    enum class SpritesPath { GEOMETRY_SHADER, VERTEX_PULLING };
+
+    void create_sprites(uint32_t sprites_count);
+
     std::shared_ptr<RGL::Camera> m_camera;
     std::shared_ptr<RGL::Shader> m_point_sprites_shader;
+    std::shared_ptr<RGL::Shader> m_point_sprites_pulling_shader;
     std::shared_ptr<RGL::Texture2D> m_sprite_tex;
 
     float m_half_quad_width;
     uint32_t m_no_sprites;
     GLuint m_sprites_vao_id;
     GLuint m_sprites_vbo_id;
+    GLuint m_dummy_vao_id;
+
+    SpritesPath m_sprites_path;
+    std::vector<std::string> m_sprites_paths_names = { "geometry shader", "vertex pulling" };
+    float m_sprites_paths_gpu_ms[2];  /* The last timings of both paths, side by side. */
 };
\ No newline at end of file
@@ -0,0 +1,28 @@
+#version 460 core
+
+// The quads of gs_point_sprites.geom without a geometry shader: every sprite is drawn as two triangles without
+// vertex attributes, and each of their six vertices fetches the sprite's position by gl_VertexID / 6.
+layout(std430, binding = 0) readonly buffer SpritesPositionsSSBO
+{
+	float positions[]; // Tightly packed vec3s, the vertex buffer of the geometry shader path.
+};
+
+uniform mat4  model_view_matrix;
+uniform mat4  projection_matrix;
+uniform float half_quad_width;
+
+out vec2 tex_coords;
+
+// The corners of the two counter-clockwise triangles.
+const vec2 corners[6] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(-1.0, 1.0),
+                               vec2(-1.0,  1.0), vec2(1.0, -1.0), vec2( 1.0, 1.0));
+
+void main()
+{
+	uint sprite = uint(gl_VertexID) / 6;
+	vec2 corner = corners[uint(gl_VertexID) % 6];
+	vec3 pos    = vec3(positions[3 * sprite], positions[3 * sprite + 1], positions[3 * sprite + 2]);
+
+	gl_Position = projection_matrix * (model_view_matrix * vec4(pos, 1.0) + vec4(corner * half_quad_width, 0.0, 0.0));
+	tex_coords  = vec2(corner.x, -corner.y) * 0.5 + 0.5;
+}
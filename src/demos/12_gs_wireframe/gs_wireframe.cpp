@@ -2,6 +2,7 @@
 
 #include "filesystem.h"
 #include "input.h"
+#include "profiler.h"
 #include "util.h"
 #include "gui/gui.h"
 
@@ -11,12 +12,20 @@ GSWireframe::GSWireframe()
       m_dir_light_angles  (40.0f, 18.0f),
       m_line_color        (glm::vec4(107, 205, 96, 255) / 255.0f),
       m_line_width        (0.5f),
-      m_ambient_color     (0.18f)
+      m_ambient_color     (0.18f),
+      m_dummy_vao_id      (0),
+      m_is_nv_barycentric_supported(false),
+      m_wireframe_method  (WireframeMethod::GEOMETRY_SHADER),
+      m_wireframe_methods_gpu_ms{ 0.0f, 0.0f, 0.0f }
 {
 }
 
 GSWireframe::~GSWireframe()
 {
+    if (m_dummy_vao_id != 0)
+    {
+        glDeleteVertexArrays(1, &m_dummy_vao_id);
+    }
 }
 
 void GSWireframe::init_app()
@@ -30,6 +39,7 @@ void GSWireframe::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(-1, 1.0, 2.0);
     m_camera->setOrientation(0.0f, 35.0f, 0.0f);
 
@@ -41,7 +51,8 @@ void GSWireframe::init_app()
     /* Create models. */
     m_objects.emplace_back(std::make_shared<RGL::StaticModel>());
 
-    /* You can load model from a file or generate a primitive on the fly. */
+    /* You can load model from a file or generate a primitive on the fly. The vertex pulling fetches the interleaved vertices. */
+    m_objects[0]->SetVertexFormat(RGL::StaticModel::VertexFormat::INTERLEAVED);
     m_objects[0]->Load(RGL::FileSystem::getResourcesPath() / "models/armadillo.obj");
 
     /* Set model matrices for each model. */
@@ -51,6 +62,19 @@ void GSWireframe::init_app()
     std::string dir = "src/demos/12_gs_wireframe/";
     m_directional_light_shader = std::make_shared<RGL::Shader>(dir + "gs_wireframe.vert", dir + "gs_wireframe.frag", dir + "gs_wireframe.geom");
     m_directional_light_shader->link();
+
+    m_wireframe_pulling_shader = std::make_shared<RGL::Shader>(dir + "wireframe_pulling.vert", dir + "wireframe_barycentric.frag");
+    m_wireframe_pulling_shader->link();
+
+    m_is_nv_barycentric_supported = GLAD_GL_NV_fragment_shader_barycentric;
+
+    if (m_is_nv_barycentric_supported)
+    {
+        m_wireframe_nv_shader = std::make_shared<RGL::Shader>(dir + "gs_wireframe.vert", dir + "wireframe_nv.frag");
+        m_wireframe_nv_shader->link();
+    }
+
+    glCreateVertexArrays(1, &m_dummy_vao_id);
 }
 
 void GSWireframe::input()
@@ -101,30 +125,82 @@ void GSWireframe::update(double delta_time)
     m_camera->update(delta_time);
 }
 
+void GSWireframe::set_uniforms(const std::shared_ptr<RGL::Shader>& shader)
+{
+    shader->bind();
+    shader->setUniform("directional_light.base.color",     m_dir_light_properties.color);
+    shader->setUniform("directional_light.base.intensity", m_dir_light_properties.intensity);
+    shader->setUniform("directional_light.direction",      m_dir_light_properties.direction);
+    shader->setUniform("cam_pos",                          m_camera->position());
+    shader->setUniform("ambient",                          m_ambient_color);
+    shader->setUniform("specular_intensity",               m_specular_intenstiy.x);
+    shader->setUniform("specular_power",                   m_specular_power.x);
+    shader->setUniform("line_info.width",                  m_line_width * 0.5f);
+    shader->setUniform("line_info.color",                  m_line_color);
+}
+
 void GSWireframe::render()
 {
     /* Put render specific code here. Don't update variables here! */
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    m_directional_light_shader->bind();
-    m_directional_light_shader->setUniform("directional_light.base.color",     m_dir_light_properties.color);
-    m_directional_light_shader->setUniform("directional_light.base.intensity", m_dir_light_properties.intensity);
-    m_directional_light_shader->setUniform("directional_light.direction",      m_dir_light_properties.direction);
-    m_directional_light_shader->setUniform("cam_pos",                          m_camera->position());
-    m_directional_light_shader->setUniform("ambient",                          m_ambient_color);
-    m_directional_light_shader->setUniform("specular_intensity",               m_specular_intenstiy.x);
-    m_directional_light_shader->setUniform("specular_power",                   m_specular_power.x);
-    m_directional_light_shader->setUniform("viewport_matrix",                  RGL::Window::getViewportMatrix());
-    m_directional_light_shader->setUniform("line_info.width",                  m_line_width * 0.5f);
-    m_directional_light_shader->setUniform("line_info.color",                  m_line_color);
-
-    const auto view_projection = m_camera->m_projection * m_camera->m_view;
-    
+    if (m_wireframe_method == WireframeMethod::NV_BARYCENTRIC && !m_is_nv_barycentric_supported)
+    {
+        m_wireframe_method = WireframeMethod::GEOMETRY_SHADER;
+    }
+
+    const auto view_projection = m_camera->viewProjection();
+
+    if (m_wireframe_method == WireframeMethod::VERTEX_PULLING)
+    {
+        RGL::ProfilerScope scope("Wireframe (vertex pulling)");
+
+        set_uniforms(m_wireframe_pulling_shader);
+        glBindVertexArray(m_dummy_vao_id);
+
+        for (unsigned i = 0; i < m_objects.size(); ++i)
+        {
+            GLint vertex_stride = 0;
+            glGetVertexArrayIndexediv(m_objects[i]->GetVertexArray(), 0, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &vertex_stride);
+
+            m_wireframe_pulling_shader->setUniform("model", m_objects_model_matrices[i]);
+            m_wireframe_pulling_shader->setUniform("normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_objects_model_matrices[i]))));
+            m_wireframe_pulling_shader->setUniform("mvp", view_projection * m_objects_model_matrices[i]);
+            m_wireframe_pulling_shader->setUniform("u_vertex_stride", GLuint(vertex_stride) / GLuint(sizeof(float)));
+
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_objects[i]->GetVertexBuffer());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_objects[i]->GetIndexBuffer());
+
+            /* Not indexed, every vertex of a triangle is its own and knows its corner. */
+            for (const auto& command : m_objects[i]->GetIndirectCommands())
+            {
+                m_wireframe_pulling_shader->setUniform("u_first_index", command.m_first_index);
+                m_wireframe_pulling_shader->setUniform("u_base_vertex", command.m_base_vertex);
+
+                glDrawArrays(GL_TRIANGLES, 0, command.m_count);
+            }
+        }
+
+        return;
+    }
+
+    const bool is_nv_barycentric = m_wireframe_method == WireframeMethod::NV_BARYCENTRIC;
+    const auto& shader           = is_nv_barycentric ? m_wireframe_nv_shader : m_directional_light_shader;
+
+    RGL::ProfilerScope scope(is_nv_barycentric ? "Wireframe (NV barycentric)" : "Wireframe (geometry shader)");
+
+    set_uniforms(shader);
+
+    if (!is_nv_barycentric)
+    {
+        shader->setUniform("viewport_matrix", RGL::Window::getViewportMatrix());
+    }
+
     for (unsigned i = 0; i < m_objects.size(); ++i)
     {
-        m_directional_light_shader->setUniform("model", m_objects_model_matrices[i]);
-        m_directional_light_shader->setUniform("normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_objects_model_matrices[i]))));
-        m_directional_light_shader->setUniform("mvp", view_projection * m_objects_model_matrices[i]);
+        shader->setUniform("model", m_objects_model_matrices[i]);
+        shader->setUniform("normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_objects_model_matrices[i]))));
+        shader->setUniform("mvp", view_projection * m_objects_model_matrices[i]);
 
         m_objects[i]->Render();
     }
@@ -173,7 +249,57 @@ void GSWireframe::render_gui()
         ImGui::SliderFloat("Line width", &m_line_width, 0.0, 10.0, "%.1f");
         ImGui::ColorEdit4("Line color", &m_line_color[0]);
 
+        if (ImGui::BeginCombo("Wireframe method", m_wireframe_methods_names[int(m_wireframe_method)].c_str()))
+        {
+            for (int i = 0; i < m_wireframe_methods_names.size(); ++i)
+            {
+                if (WireframeMethod(i) == WireframeMethod::NV_BARYCENTRIC && !m_is_nv_barycentric_supported)
+                {
+                    continue;
+                }
+
+                bool is_selected = (m_wireframe_method == WireframeMethod(i));
+                if (ImGui::Selectable(m_wireframe_methods_names[i].c_str(), is_selected))
+                {
+                    m_wireframe_method = WireframeMethod(i);
+                }
+
+                if (is_selected)
+                {
+                    ImGui::SetItemDefaultFocus();
+                }
+            }
+            ImGui::EndCombo();
+        }
+
         ImGui::PopItemWidth();
+
+        if (!m_is_nv_barycentric_supported)
+        {
+            ImGui::Text("NV_fragment_shader_barycentric is not supported.");
+        }
+
+        const char* scopes_names[] = { "Wireframe (geometry shader)", "Wireframe (vertex pulling)", "Wireframe (NV barycentric)" };
+
+        for (uint32_t index : RGL::Profiler::GetResolvedScopes())
+        {
+            const auto& scope = RGL::Profiler::GetScope(index);
+
+            for (int i = 0; i < 3; ++i)
+            {
+                if (scope.m_name == scopes_names[i])
+                {
+                    m_wireframe_methods_gpu_ms[i] = scope.m_gpu_ms;
+                }
+            }
+        }
+
+        /* The methods not drawn keep their last timings, switch between them to compare. */
+        for (int i = 0; i < 3; ++i)
+        {
+            ImGui::Text("%-16s %.3f ms", (m_wireframe_methods_names[i] + ":").c_str(), m_wireframe_methods_gpu_ms[i]);
+        }
+
         ImGui::Spacing();
 
         ImGuiTabBarFlags tab_bar_flags = ImGuiTabBarFlags_None;
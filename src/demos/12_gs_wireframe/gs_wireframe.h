@@ -6,6 +6,7 @@
 #include "shader.h"
 
 #include <memory>
+#include <string>
 #include <vector>
 
 struct BaseLight
@@ -44,8 +45,25 @@ public:
     void render_gui()              override;
 
 private:
+    /*
+     * The distances to the edges from the altitudes of the geometry shader, from the barycentric coordinates of
+     * the vertices fetched by a non-indexed draw, or from the barycentric coordinates of NV_fragment_shader_barycentric.
+     */
+    enum class WireframeMethod { GEOMETRY_SHADER, VERTEX_PULLING, NV_BARYCENTRIC };
+
+    void set_uniforms(const std::shared_ptr<RGL::Shader>& shader);
+
     std::shared_ptr<RGL::Camera> m_camera;
     std::shared_ptr<RGL::Shader> m_directional_light_shader;
+    std::shared_ptr<RGL::Shader> m_wireframe_pulling_shader;
+    std::shared_ptr<RGL::Shader> m_wireframe_nv_shader;
+
+    GLuint m_dummy_vao_id;
+    bool   m_is_nv_barycentric_supported;
+
+    WireframeMethod m_wireframe_method;
+    std::vector<std::string> m_wireframe_methods_names = { "geometry shader", "vertex pulling", "NV barycentric" };
+    float m_wireframe_methods_gpu_ms[3]; /* The last timings of each method, side by side. */
 
     std::vector<std::shared_ptr<RGL::StaticModel>> m_objects;
     std::vector<glm::mat4> m_objects_model_matrices;
@@ -0,0 +1,13 @@
+#version 460 core
+#include "wireframe.glh"
+
+out vec4 frag_color;
+
+in vec3 world_pos;
+in vec3 normal;
+noperspective in vec3 barycentric;
+
+void main()
+{
+    frag_color = wireframe(normal, world_pos, edgeDistanceFromBarycentric(barycentric));
+}
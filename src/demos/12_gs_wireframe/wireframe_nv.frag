@@ -0,0 +1,15 @@
+#version 460 core
+#extension GL_NV_fragment_shader_barycentric : require
+#include "wireframe.glh"
+
+// The barycentric coordinates come from the rasterizer, so the regular indexed draw of gs_wireframe.vert is enough.
+
+out vec4 frag_color;
+
+in vec3 world_pos;
+in vec3 normal;
+
+void main()
+{
+    frag_color = wireframe(normal, world_pos, edgeDistanceFromBarycentric(gl_BaryCoordNoPerspNV));
+}
@@ -0,0 +1,39 @@
+#version 460 core
+
+// The wireframe without a geometry shader: the draw is not indexed, so each vertex of a triangle fetches its index
+// and vertex itself and gets its own corner of the barycentric coordinates. See wireframe_barycentric.frag.
+layout(std430, binding = 0) readonly buffer VerticesSSBO
+{
+    float vertices[]; // u_vertex_stride per vertex - position, texcoord, normal.
+};
+
+layout(std430, binding = 1) readonly buffer IndicesSSBO
+{
+    uint indices[];
+};
+
+uniform mat4 model;
+uniform mat3 normal_matrix;
+uniform mat4 mvp;
+
+uniform uint u_first_index;
+uniform int  u_base_vertex;
+uniform uint u_vertex_stride;
+
+out vec3 world_pos;
+out vec3 normal;
+noperspective out vec3 barycentric;
+
+void main()
+{
+    uint i = uint(int(indices[u_first_index + gl_VertexID]) + u_base_vertex) * u_vertex_stride;
+
+    vec3 in_pos    = vec3(vertices[i],     vertices[i + 1], vertices[i + 2]);
+    vec3 in_normal = vec3(vertices[i + 5], vertices[i + 6], vertices[i + 7]);
+
+    world_pos   = vec3(model * vec4(in_pos, 1.0));
+    normal      = normalize(normal_matrix * in_normal);
+    barycentric = vec3(gl_VertexID % 3 == 0, gl_VertexID % 3 == 1, gl_VertexID % 3 == 2);
+
+    gl_Position = mvp * vec4(in_pos, 1.0);
+}
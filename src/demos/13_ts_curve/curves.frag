@@ -0,0 +1,32 @@
+#version 460 core
+
+// The batched strands of CurveBatch with Kajiya-Kay's hair lighting - of the tangent, the strand has no single normal.
+
+layout(location = 0) out vec4 frag_color;
+
+in vec3  tes_world_pos;
+in vec3  tes_tangent;
+in vec4  tes_color;
+in float tes_ribbon_coord;
+
+uniform vec3 u_camera_position;
+uniform vec3 u_light_direction;
+
+void main()
+{
+    vec3 t = normalize(tes_tangent);
+    vec3 l = -normalize(u_light_direction);
+    vec3 v = normalize(u_camera_position - tes_world_pos);
+    vec3 h = normalize(l + v);
+
+    float t_dot_l = dot(t, l);
+    float t_dot_h = dot(t, h);
+
+    float diffuse  = sqrt(max(1.0 - t_dot_l * t_dot_l, 0.0));
+    float specular = pow(sqrt(max(1.0 - t_dot_h * t_dot_h, 0.0)), 80.0);
+
+    /* A rounder look of the ribbons - darker towards their edges. */
+    float edge = 1.0 - 0.4 * tes_ribbon_coord * tes_ribbon_coord;
+
+    frag_color = vec4(tes_color.rgb * (0.2 + 0.8 * diffuse) * edge + vec3(0.3 * specular), tes_color.a);
+}
@@ -14,7 +14,12 @@ Tessellation1D::Tessellation1D()
       m_points_color(1.0, 0.0, 0.0),
       m_line_color(1.0, 1.0, 0.0),
       m_no_segments(50),
-      m_no_strips(1)
+      m_no_strips(1),
+      m_strands_light_direction(-0.5, -1.0, -0.5),
+      m_pixels_per_segment(8.0f),
+      m_no_strands(20000),
+      m_batched_curves_toggle(false),
+      m_ribbons_toggle(true)
 {
 }
 
@@ -48,6 +53,7 @@ void Tessellation1D::init_app()
     /* Create virtual camera. */
     const float c = 3.5f;
     m_camera = std::make_shared<RGL::Camera>(-0.5f * c, 0.5f * c, -0.3f * c, 0.45f * c, 0.1f, 100.0f);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(0.0, 0.0, 1.5);
 
     /* Create shader. */
@@ -58,6 +64,17 @@ void Tessellation1D::init_app()
     m_solid_points_color_shader = std::make_shared<RGL::Shader>(dir + "solid.vert", dir + "solid.frag");
     m_solid_points_color_shader->link();
 
+    /* The batched curves' stages are the core's, the shading is the demo's. */
+    std::string core_dir = "src/core/shaders/";
+    m_strands_lines_shader = std::make_shared<RGL::Shader>(core_dir + "curves.vert", dir + "curves.frag", core_dir + "curves.tcs", core_dir + "curves.tes");
+    m_strands_lines_shader->link();
+
+    m_strands_ribbons_shader = std::make_shared<RGL::Shader>(core_dir + "curves.vert", dir + "curves.frag", core_dir + "curves.tcs", core_dir + "curves.tes");
+    m_strands_ribbons_shader->setDefine("RIBBONS");
+    m_strands_ribbons_shader->link();
+
+    generate_strands();
+
     /* Create VAO and VBO for curve points in 2D - NDC */
     std::vector<glm::vec2> curve_points = { glm::vec2(-1.0, -1.0),
                                             glm::vec2(-0.5,  1.0),
@@ -78,6 +95,30 @@ void Tessellation1D::init_app()
     glVertexArrayVertexBuffer (m_curve_points_vao_id, 0 /*bindingindex*/, m_curve_points_vbo_id, 0 /*offset*/, sizeof(curve_points[0]) /*stride*/);
 }
 
+void Tessellation1D::generate_strands()
+{
+    m_strands.Clear();
+    m_strands.Reserve(m_no_strands);
+
+    /* Strands rooted along the bottom of the view, growing up and bending in a random direction. */
+    for (int i = 0; i < m_no_strands; ++i)
+    {
+        glm::vec3 root   = glm::vec3(glm::linearRand(-1.6f, 1.6f), -1.0f, glm::linearRand(-1.0f, 0.0f));
+        glm::vec3 bend   = glm::vec3(glm::linearRand(-0.3f, 0.3f), 0.0f, glm::linearRand(-0.3f, 0.3f));
+        float     height = glm::linearRand(0.6f, 1.4f);
+        float     width  = glm::linearRand(0.003f, 0.006f);
+
+        const glm::vec4 control_points[4] = { glm::vec4(root,                                                     width),
+                                              glm::vec4(root + glm::vec3(0.0f, height / 3.0f,        0.0f),        width * 0.8f),
+                                              glm::vec4(root + glm::vec3(0.0f, height * 2.0f / 3.0f, 0.0f) + bend, width * 0.5f),
+                                              glm::vec4(root + glm::vec3(0.0f, height,               0.0f) + bend * 2.5f, width * 0.1f) };
+
+        glm::vec3 color = glm::mix(glm::vec3(0.45f, 0.3f, 0.15f), glm::vec3(0.9f, 0.75f, 0.45f), glm::linearRand(0.0f, 1.0f));
+
+        m_strands.Add(control_points, glm::vec4(color, 1.0f));
+    }
+}
+
 void Tessellation1D::input()
 {
     /* Close the application when Esc is released. */
@@ -130,8 +171,23 @@ void Tessellation1D::render()
 {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    if (m_batched_curves_toggle)
+    {
+        auto& shader = m_ribbons_toggle ? m_strands_ribbons_shader : m_strands_lines_shader;
+
+        shader->bind();
+        shader->setUniform("u_view_projection",    m_camera->viewProjection());
+        shader->setUniform("u_camera_position",    m_camera->position());
+        shader->setUniform("u_viewport_size",      glm::vec2(RGL::Window::getWidth(), RGL::Window::getHeight()));
+        shader->setUniform("u_pixels_per_segment", m_pixels_per_segment);
+        shader->setUniform("u_light_direction",    m_strands_light_direction);
+
+        m_strands.Render();
+        return;
+    }
+
     glBindVertexArray(m_curve_points_vao_id);
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+    auto view_projection = m_camera->viewProjection();
 
     /* Draw curve */
     m_curve_tessellation_shader->bind();
@@ -184,6 +240,21 @@ void Tessellation1D::render_gui()
         ImGui::ColorEdit4("Points color", &m_points_color[0]);
         ImGui::ColorEdit4("Line color",   &m_line_color[0]);
         ImGui::SliderInt("No. segments",  &m_no_segments, 1, 50);
+
+        ImGui::Checkbox("Batched curves", &m_batched_curves_toggle);
+
+        if (m_batched_curves_toggle)
+        {
+            if (ImGui::SliderInt("No. strands", &m_no_strands, 1000, 100000))
+            {
+                generate_strands();
+            }
+
+            ImGui::Checkbox   ("Camera facing ribbons", &m_ribbons_toggle);
+            ImGui::SliderFloat("Pixels per segment",    &m_pixels_per_segment, 1.0f, 32.0f, "%.0f");
+            ImGui::SliderFloat3("Light direction",      &m_strands_light_direction[0], -1.0f, 1.0f, "%.2f");
+        }
+
         ImGui::PopItemWidth();
         ImGui::Spacing();
     }
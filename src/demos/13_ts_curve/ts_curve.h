@@ -2,6 +2,7 @@
 #include "core_app.h"
 
 #include "camera.h"
+#include "curve_batch.h"
 #include "shader.h"
 
 #include <memory>
@@ -19,6 +20,8 @@ public:
     void render_gui()               override;
 
 private:
+    void generate_strands();
+
     std::shared_ptr<RGL::Camera> m_camera;
     std::shared_ptr<RGL::Shader> m_solid_points_color_shader;
     std::shared_ptr<RGL::Shader> m_curve_tessellation_shader;
@@ -31,4 +34,15 @@ private:
     glm::vec3 m_line_color;
     int m_no_segments;
     int m_no_strips;
+
+    /* Batched curves - a field of strands drawn with a single instanced patch draw. */
+    RGL::CurveBatch m_strands;
+    std::shared_ptr<RGL::Shader> m_strands_lines_shader;
+    std::shared_ptr<RGL::Shader> m_strands_ribbons_shader;
+
+    glm::vec3 m_strands_light_direction;
+    float m_pixels_per_segment;
+    int m_no_strands;
+    bool m_batched_curves_toggle;
+    bool m_ribbons_toggle;
 };
\ No newline at end of file
@@ -15,7 +15,11 @@ Tessellation2D::Tessellation2D()
       m_line_color(0.0, 0.0, 0.0),
       m_line_width(0.5),
       m_outer(2),
-      m_inner(2)
+      m_inner(2),
+      m_adaptive(false),
+      m_patch_culling(true),
+      m_pixels_per_segment(32.0f),
+      m_max_tess_level(64)
 {
 }
 
@@ -49,6 +53,7 @@ void Tessellation2D::init_app()
     /* Create virtual camera. */
     const float c = 3.5f;
     m_camera = std::make_shared<RGL::Camera>(-0.4f * c, 0.7f * c, -0.35f * c, 0.4f * c, 0.1f, 100.0f);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(0.0, 0.0, 1.5);
 
     /* Create shader. */
@@ -129,12 +134,18 @@ void Tessellation2D::render()
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     glBindVertexArray(m_quad_points_vao_id);
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+    auto view_projection = m_camera->viewProjection();
 
     /* Draw curve */
     m_quad_tessellation_shader->bind();
     m_quad_tessellation_shader->setUniform("outer", m_outer);
     m_quad_tessellation_shader->setUniform("inner", m_inner);
+    m_quad_tessellation_shader->setUniform("adaptive", int(m_adaptive));
+    m_quad_tessellation_shader->setUniform("patch_culling", int(m_patch_culling));
+    m_quad_tessellation_shader->setUniform("pixels_per_segment", m_pixels_per_segment);
+    m_quad_tessellation_shader->setUniform("max_tess_level", m_max_tess_level);
+    m_quad_tessellation_shader->setUniform("viewport_height", float(RGL::Window::getHeight()));
+    m_quad_tessellation_shader->setUniform("projection_scale", m_camera->m_projection[1][1]);
     m_quad_tessellation_shader->setUniform("quad_color", m_quad_color);
     m_quad_tessellation_shader->setUniform("line_color", m_line_color);
     m_quad_tessellation_shader->setUniform("line_width", m_line_width * 0.5f);
@@ -179,8 +190,19 @@ void Tessellation2D::render_gui()
         ImGui::ColorEdit4("Quad color", &m_quad_color[0]);
         ImGui::ColorEdit4("Line color", &m_line_color[0]);
         ImGui::SliderFloat("Line width", &m_line_width, 0.0f, 10.0f, "%.1f");
-        ImGui::SliderInt("Outer", &m_outer, 1, 32);
-        ImGui::SliderInt("Inner", &m_inner, 2, 32);
+        ImGui::Checkbox("Adaptive", &m_adaptive);
+        ImGui::Checkbox("Frustum culling", &m_patch_culling);
+
+        if (m_adaptive)
+        {
+            ImGui::SliderFloat("Pixels per segment", &m_pixels_per_segment, 4.0f, 128.0f, "%.0f");
+            ImGui::SliderInt("Max tessellation level", &m_max_tess_level, 1, 64);
+        }
+        else
+        {
+            ImGui::SliderInt("Outer", &m_outer, 1, 32);
+            ImGui::SliderInt("Inner", &m_inner, 2, 32);
+        }
         ImGui::PopItemWidth();
         ImGui::Spacing();
     }
@@ -31,4 +31,10 @@ private:
     float m_line_width;
     int m_outer;
     int m_inner;
+
+    /* Per edge levels from the edges' length on screen instead of m_outer and m_inner. */
+    bool  m_adaptive;
+    bool  m_patch_culling;
+    float m_pixels_per_segment;
+    int   m_max_tess_level;
 };
\ No newline at end of file
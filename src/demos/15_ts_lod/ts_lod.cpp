@@ -8,22 +8,31 @@
 #include <glm/gtc/random.hpp>
 
 TessellationLoD::TessellationLoD()
-    : m_specular_power    (120.0f),
-      m_specular_intenstiy(0.0f),
-      m_dir_light_angles  (67.5f),
-      m_line_color        (glm::vec4(107, 205, 96, 255) / 255.0f),
-      m_line_width        (0.5f),
-      m_ambient_color     (0.18f),
-      m_min_tess_level    (1),
-      m_max_tess_level    (10),
-      m_min_depth         (2.0),
-      m_max_depth         (20.0)
-
+    : m_specular_power             (120.0f),
+      m_specular_intenstiy         (0.0f),
+      m_dir_light_angles           (67.5f),
+      m_line_color                 (glm::vec4(107, 205, 96, 255) / 255.0f),
+      m_line_width                 (0.5f),
+      m_ambient_color              (0.18f),
+      m_min_tess_level             (1),
+      m_max_tess_level             (10),
+      m_min_depth                  (2.0),
+      m_max_depth                  (20.0),
+      m_screen_space_levels        (true),
+      m_patch_culling              (true),
+      m_pixels_per_segment         (8.0f),
+      m_primitives_query           (0),
+      m_is_primitives_query_pending(false),
+      m_primitives_count           (0)
 {
 }
 
 TessellationLoD::~TessellationLoD()
 {
+    if (m_primitives_query != 0)
+    {
+        glDeleteQueries(1, &m_primitives_query);
+    }
 }
 
 void TessellationLoD::init_app()
@@ -41,6 +50,7 @@ void TessellationLoD::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(0.0, 0.0, 10.5);
     m_camera->setOrientation(-5.0f, 20.0f, 0.0f);
 
@@ -63,6 +73,8 @@ void TessellationLoD::init_app()
     std::string dir  = "src/demos/15_ts_lod/";
     m_pn_tessellation_shader = std::make_shared<RGL::Shader>(dir + "ts_lod.vert", dir + "ts_lod.frag", dir + "ts_lod.tcs", dir + "ts_lod.tes");
     m_pn_tessellation_shader->link();
+
+    glCreateQueries(GL_PRIMITIVES_GENERATED, 1, &m_primitives_query);
 }
 
 void TessellationLoD::input()
@@ -117,7 +129,7 @@ void TessellationLoD::render()
 {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+    auto view_projection = m_camera->viewProjection();
 
     /* Draw curve */
     m_pn_tessellation_shader->bind();
@@ -128,6 +140,11 @@ void TessellationLoD::render()
     m_pn_tessellation_shader->setUniform("min_depth",                        m_min_depth);
     m_pn_tessellation_shader->setUniform("max_depth",                        m_max_depth);
     m_pn_tessellation_shader->setUniform("view_matrix",                      m_camera->m_view);
+    m_pn_tessellation_shader->setUniform("screen_space_levels",              int(m_screen_space_levels));
+    m_pn_tessellation_shader->setUniform("patch_culling",                    int(m_patch_culling));
+    m_pn_tessellation_shader->setUniform("pixels_per_segment",               m_pixels_per_segment);
+    m_pn_tessellation_shader->setUniform("viewport_height",                  float(RGL::Window::getHeight()));
+    m_pn_tessellation_shader->setUniform("projection_scale",                 m_camera->m_projection[1][1]);
     m_pn_tessellation_shader->setUniform("directional_light.base.color",     m_dir_light_properties.color);
     m_pn_tessellation_shader->setUniform("directional_light.base.intensity", m_dir_light_properties.intensity);
     m_pn_tessellation_shader->setUniform("directional_light.direction",      m_dir_light_properties.direction);
@@ -135,12 +152,37 @@ void TessellationLoD::render()
     m_pn_tessellation_shader->setUniform("specular_intensity",               m_specular_intenstiy.x);
     m_pn_tessellation_shader->setUniform("specular_power",                   m_specular_power.x);
 
+    if (m_is_primitives_query_pending)
+    {
+        GLint is_available = 0;
+        glGetQueryObjectiv(m_primitives_query, GL_QUERY_RESULT_AVAILABLE, &is_available);
+
+        if (is_available)
+        {
+            glGetQueryObjectui64v(m_primitives_query, GL_QUERY_RESULT, &m_primitives_count);
+            m_is_primitives_query_pending = false;
+        }
+    }
+
+    const bool is_counting_primitives = !m_is_primitives_query_pending;
+
+    if (is_counting_primitives)
+    {
+        glBeginQuery(GL_PRIMITIVES_GENERATED, m_primitives_query);
+    }
+
     for (auto& world_matrix : m_world_matrices)
     {
         m_pn_tessellation_shader->setUniform("model", world_matrix);
         m_pn_tessellation_shader->setUniform("normal_matrix", glm::mat3(glm::transpose(glm::inverse(world_matrix))));
         m_model->Render();
     }
+
+    if (is_counting_primitives)
+    {
+        glEndQuery(GL_PRIMITIVES_GENERATED);
+        m_is_primitives_query_pending = true;
+    }
 }
 
 void TessellationLoD::render_gui()
@@ -175,11 +217,24 @@ void TessellationLoD::render_gui()
         ImGui::Spacing();
 
         ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
-        ImGui::SliderInt  ("Min tessellation level", &m_min_tess_level, 1,    20);
-        ImGui::SliderInt  ("Max tessellation level", &m_max_tess_level, 1,    20);
-        ImGui::SliderFloat("Min depth",              &m_min_depth,      0.0f, 20.0f, "%.1f");
-        ImGui::SliderFloat("Max depth",              &m_max_depth,      0.0f, 20.0f, "%.1f");
+        ImGui::Checkbox   ("Screen space levels",    &m_screen_space_levels);
+        ImGui::Checkbox   ("Frustum and backface culling", &m_patch_culling);
+
+        if (m_screen_space_levels)
+        {
+            ImGui::SliderFloat("Pixels per segment", &m_pixels_per_segment, 1.0f, 64.0f, "%.0f");
+            ImGui::SliderInt  ("Max tessellation level", &m_max_tess_level, 1, 64);
+        }
+        else
+        {
+            ImGui::SliderInt  ("Min tessellation level", &m_min_tess_level, 1,    20);
+            ImGui::SliderInt  ("Max tessellation level", &m_max_tess_level, 1,    20);
+            ImGui::SliderFloat("Min depth",              &m_min_depth,      0.0f, 20.0f, "%.1f");
+            ImGui::SliderFloat("Max depth",              &m_max_depth,      0.0f, 20.0f, "%.1f");
+        }
         ImGui::PopItemWidth();
+
+        ImGui::Text("Tessellated triangles: %llu", (unsigned long long)m_primitives_count);
         ImGui::Spacing();
 
         ImGuiTabBarFlags tab_bar_flags = ImGuiTabBarFlags_None;
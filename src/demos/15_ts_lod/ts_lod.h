@@ -61,4 +61,14 @@ private:
     int       m_max_tess_level;
     float     m_max_depth;
     float     m_min_depth;
+
+    /* Screen space levels: an edge gets a segment per m_pixels_per_segment pixels, the depth range is unused then. */
+    bool      m_screen_space_levels;
+    bool      m_patch_culling;
+    float     m_pixels_per_segment;
+
+    /* The tessellated triangles of a frame, read back a few frames late so the query never stalls. */
+    GLuint    m_primitives_query;
+    bool      m_is_primitives_query_pending;
+    GLuint64  m_primitives_count;
 };
\ No newline at end of file
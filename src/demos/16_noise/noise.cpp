@@ -1,9 +1,11 @@
 #include "noise.h"
 #include "filesystem.h"
 #include "input.h"
+#include "profiler.h"
 #include "util.h"
 #include "gui/gui.h"
-#include "glm/gtc/noise.hpp"
+
+#include <cmath>
 
 ProceduralNoise::ProceduralNoise()
     : m_sky_color       (glm::vec3(77, 140, 230) / 255.0f),
@@ -12,8 +14,15 @@ ProceduralNoise::ProceduralNoise()
       m_light_wood_color(1.0, 0.75, 0.25),
       m_slice_matrix    (glm::mat4(1.0f)),
       m_low_threshold   (0.45f),
-      m_high_threshold  (0.65f)
+      m_high_threshold  (0.65f),
+      m_noise_resolution    (512),
+      m_is_gpu_noise_enabled(true),
+      m_is_noise_dirty      (true)
 {
+    m_noise_settings[CLOUD]     .frequency = 3.0f;
+    m_noise_settings[WOOD_GRAIN].frequency = 4.0f;
+    m_noise_settings[DECAL]     .frequency = 12.0f;
+
     m_slice_matrix = glm::rotate(glm::mat4(1.0f), glm::radians(10.0f), glm::vec3(1.0, 0.0, 0.0));
     m_slice_matrix = glm::rotate(m_slice_matrix, glm::radians(-20.0f), glm::vec3(0.0, 0.0, 1.0));
     m_slice_matrix = glm::scale(m_slice_matrix, glm::vec3(50.0, 50.0, 1.0));
@@ -22,78 +31,65 @@ ProceduralNoise::ProceduralNoise()
 
 ProceduralNoise::~ProceduralNoise()
 {
-    glDeleteTextures(1, &m_decal_texture);
-    m_decal_texture = 0;
-
-    glDeleteTextures(1, &m_cloud_texture);
-    m_cloud_texture = 0;
-
-    glDeleteTextures(1, &m_wood_grain_texture);
-    m_wood_grain_texture = 0;
 }
 
-GLuint ProceduralNoise::gen_perlin_data(uint32_t width, uint32_t height, float base_frequency, float persistance, bool periodic)
+void ProceduralNoise::update_noise_textures()
 {
-    GLuint texture;
-
-    float* data = new float[width * height * 4];
+    bool is_outdated[NOISE_TEXTURES_COUNT];
+    bool is_any_outdated = false;
 
-    float x_factor = 1.0f / (width  - 1);
-    float y_factor = 1.0f / (height - 1);
-
-    for(uint32_t row = 0; row < height; ++row)
+    for (int i = 0; i < NOISE_TEXTURES_COUNT; ++i)
     {
-        for(uint32_t col = 0; col < width; ++col)
-        {
-            float x       = x_factor * col;
-            float y       = y_factor * row;
-            float sum     = 0.0f;
-            float freq    = base_frequency;
-            float persist = persistance;
-
-            // Compute the sum for each octave
-            for(uint32_t oct = 0; oct < 4; oct++)
-            {
-                glm::vec2 p(x * freq, y * freq);
+        is_outdated[i] = m_is_noise_dirty                                                 ||
+                         !m_noise_textures[i]                                             ||
+                         m_noise_textures[i]->getSize().x != uint32_t(m_noise_resolution) ||
+                         m_noise_settings[i]              != m_generated_noise_settings[i];
 
-                float val = 0.0f;
-                if (periodic)
-                {
-                    val = glm::perlin(p, glm::vec2(freq)) * persist;
-                }
-                else
-                {
-                    val = glm::perlin(p) * persist;
-                }
+        is_any_outdated |= is_outdated[i];
+    }
 
-                sum += val;
+    /* Only the frames that generate anything are timed. */
+    if (!is_any_outdated)
+    {
+        return;
+    }
 
-                float result = (sum + 1.0f) / 2.0f;
-                result = glm::clamp(result, 0.0f, 1.0f);
+    RGL::ProfilerScope scope("Noise generation");
 
-                data[((row * width + col) * 4) + oct] = result;
+    for (int i = 0; i < NOISE_TEXTURES_COUNT; ++i)
+    {
+        if (!m_noise_textures[i] || m_noise_textures[i]->getSize().x != uint32_t(m_noise_resolution))
+        {
+            m_noise_textures[i] = std::make_unique<NoiseTexture>(glm::uvec3(m_noise_resolution, m_noise_resolution, 1));
+        }
 
-                freq *= 2.0f;
-                persist *= persistance;
-            }
+        if (is_outdated[i])
+        {
+            m_noise_textures[i]->generate(m_noise_settings[i], m_is_gpu_noise_enabled);
+            m_generated_noise_settings[i] = m_noise_settings[i];
         }
     }
 
-    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+    m_is_noise_dirty = false;
+}
 
-    glTextureStorage2D(texture, 1, GL_RGBA32F, width, height);
-    glTextureSubImage2D(texture, 0, 0, 0, width, height, GL_RGBA, GL_FLOAT, data);
-    
-    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+void ProceduralNoise::noise_settings_gui(NoiseTexture::Settings& settings)
+{
+    const char* types[] = { "Perlin", "Simplex", "Worley" };
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    int type = int(settings.type);
+    int seed = int(settings.seed);
 
-    delete[] data;
+    ImGui::Combo      ("Noise",       &type, types, IM_ARRAYSIZE(types));
+    ImGui::SliderFloat("Frequency",   &settings.frequency,   1.0f, 32.0f, "%.1f");
+    ImGui::SliderInt  ("Octaves",     &settings.octaves,     1,    8);
+    ImGui::SliderFloat("Persistence", &settings.persistence, 0.1f, 1.0f,  "%.2f");
+    ImGui::SliderFloat("Lacunarity",  &settings.lacunarity,  1.0f, 4.0f,  "%.1f");
+    ImGui::InputInt   ("Seed",        &seed);
+    ImGui::Checkbox   ("Periodic",    &settings.periodic);
 
-    return texture;
+    settings.type = NoiseTexture::Type(type);
+    settings.seed = uint32_t(seed);
 }
 
 void ProceduralNoise::init_app()
@@ -105,6 +101,7 @@ void ProceduralNoise::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(0.0, 0.5, 3.0);
 
     /* Create models. */
@@ -123,13 +120,8 @@ void ProceduralNoise::init_app()
     m_objects_model_matrices.emplace_back(glm::translate(glm::mat4(1.0), glm::vec3( 0.0, 0.0, -5)) * glm::rotate(glm::mat4(1.0), glm::radians(90.0f),  glm::vec3(1, 0, 0)));                                                  // plane1
     m_objects_model_matrices.emplace_back(glm::translate(glm::mat4(1.0), glm::vec3( 4.0, 0.0, -5)) * glm::rotate(glm::mat4(1.0), glm::radians(90.0f),  glm::vec3(1, 0, 0)));                                                  // plane2
 
-    /* Add texture to the monkey and sphere models only. */
-    uint32_t perlin_tex_width  = 128;
-    uint32_t perlin_tex_height = 128;
-
-    m_cloud_texture      = gen_perlin_data(perlin_tex_width, perlin_tex_height, 3.0f);
-    m_wood_grain_texture = gen_perlin_data(perlin_tex_width, perlin_tex_height, 4.0f);
-    m_decal_texture      = gen_perlin_data(perlin_tex_width, perlin_tex_height, 12.0f);
+    /* The noise textures are generated in render(), whenever their settings change. */
+    update_noise_textures();
 
     /* Create shader. */
     std::string dir = "src/demos/16_noise/";
@@ -190,12 +182,14 @@ void ProceduralNoise::render()
     /* Put render specific code here. Don't update variables here! */
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    update_noise_textures();
+
     m_noise_texturing_shader->bind();
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+    auto view_projection = m_camera->viewProjection();
 
     // Decal
-    glBindTextureUnit(0, m_decal_texture);
+    m_noise_textures[DECAL]->bind(0);
     m_noise_texturing_shader->setSubroutine(RGL::Shader::ShaderType::FRAGMENT, "disintegration");
     m_noise_texturing_shader->setUniform("low_threshold", m_low_threshold);
     m_noise_texturing_shader->setUniform("high_threshold", m_high_threshold);
@@ -203,7 +197,7 @@ void ProceduralNoise::render()
     m_objects[0]->Render();
 
     // Cloud
-    glBindTextureUnit(0, m_cloud_texture);
+    m_noise_textures[CLOUD]->bind(0);
     m_noise_texturing_shader->setSubroutine(RGL::Shader::ShaderType::FRAGMENT, "cloud");
     m_noise_texturing_shader->setUniform("sky_color", m_sky_color);
     m_noise_texturing_shader->setUniform("cloud_color", m_cloud_color);
@@ -211,7 +205,7 @@ void ProceduralNoise::render()
     m_objects[1]->Render();
 
     // Wood grain
-    glBindTextureUnit(0, m_wood_grain_texture);
+    m_noise_textures[WOOD_GRAIN]->bind(0);
     m_noise_texturing_shader->setSubroutine(RGL::Shader::ShaderType::FRAGMENT, "wood_grain");
     m_noise_texturing_shader->setUniform("dark_wood_color", m_dark_wood_color);
     m_noise_texturing_shader->setUniform("light_wood_color", m_light_wood_color);
@@ -251,6 +245,32 @@ void ProceduralNoise::render_gui()
 
         ImGui::Spacing();
 
+        ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
+        {
+            const char* resolutions[] = { "128", "256", "512", "1024", "2048" };
+            int resolution_index = int(std::log2(m_noise_resolution)) - 7;
+
+            if (ImGui::Combo("Resolution", &resolution_index, resolutions, IM_ARRAYSIZE(resolutions)))
+            {
+                m_noise_resolution = 128 << resolution_index;
+            }
+
+            m_is_noise_dirty |= ImGui::Checkbox("Generate on the GPU", &m_is_gpu_noise_enabled);
+
+            for (uint32_t index : RGL::Profiler::GetResolvedScopes())
+            {
+                const auto& scope = RGL::Profiler::GetScope(index);
+
+                if (scope.m_name == "Noise generation")
+                {
+                    ImGui::Text("%s: %.3f ms CPU, %.3f ms GPU", scope.m_name.c_str(), scope.m_cpu_ms, scope.m_gpu_ms);
+                }
+            }
+        }
+        ImGui::PopItemWidth();
+
+        ImGui::Spacing();
+
         ImGuiTabBarFlags tab_bar_flags = ImGuiTabBarFlags_None;
         if (ImGui::BeginTabBar("Noise properties", tab_bar_flags))
         {
@@ -260,6 +280,7 @@ void ProceduralNoise::render_gui()
                 {
                     ImGui::SliderFloat("Low threshold",  &m_low_threshold,  0, 1, "%.2f");
                     ImGui::SliderFloat("High threshold", &m_high_threshold, 0, 1, "%.2f");
+                    noise_settings_gui(m_noise_settings[DECAL]);
                 }
                 ImGui::PopItemWidth();
                 ImGui::EndTabItem();
@@ -270,6 +291,7 @@ void ProceduralNoise::render_gui()
                 {
                     ImGui::ColorEdit3("Sky color",   &m_sky_color[0]);
                     ImGui::ColorEdit3("Cloud color", &m_cloud_color[0]);
+                    noise_settings_gui(m_noise_settings[CLOUD]);
                 }
                 ImGui::PopItemWidth();
                 ImGui::EndTabItem();
@@ -280,6 +302,7 @@ void ProceduralNoise::render_gui()
                 {
                     ImGui::ColorEdit3("Dark wood color",  &m_dark_wood_color[0]);
                     ImGui::ColorEdit3("Light wood color", &m_light_wood_color[0]);
+                    noise_settings_gui(m_noise_settings[WOOD_GRAIN]);
                 }
                 ImGui::PopItemWidth();
                 ImGui::EndTabItem();
@@ -2,6 +2,7 @@
 #include "core_app.h"
 
 #include "camera.h"
+#include "noise_texture.h"
 #include "static_model.h"
 #include "shader.h"
 
@@ -21,7 +22,12 @@ public:
     void render_gui()               override;
 
 private:
-    GLuint gen_perlin_data(uint32_t width, uint32_t height, float base_frequency = 4.0f, float persistance = 0.5f, bool periodic = true);
+    enum NoiseTextureIndex { CLOUD = 0, WOOD_GRAIN, DECAL, NOISE_TEXTURES_COUNT };
+
+    /* Recreates the textures when the resolution changes, regenerates the ones whose settings changed. */
+    void update_noise_textures();
+
+    void noise_settings_gui(NoiseTexture::Settings& settings);
 
     std::shared_ptr<RGL::Camera> m_camera;
     std::shared_ptr<RGL::Shader> m_noise_texturing_shader;
@@ -29,9 +35,14 @@ private:
     std::vector<std::shared_ptr<RGL::StaticModel>> m_objects;
     std::vector<glm::mat4> m_objects_model_matrices;
 
-    GLuint m_cloud_texture;
-    GLuint m_wood_grain_texture;
-    GLuint m_decal_texture;
+    std::unique_ptr<NoiseTexture> m_noise_textures          [NOISE_TEXTURES_COUNT];
+    NoiseTexture::Settings        m_noise_settings          [NOISE_TEXTURES_COUNT];
+    NoiseTexture::Settings        m_generated_noise_settings[NOISE_TEXTURES_COUNT];
+
+    // Noise generation
+    int  m_noise_resolution;
+    bool m_is_gpu_noise_enabled;
+    bool m_is_noise_dirty;       /* Regenerates all of them, e.g. after switching between the GPU and the CPU. */
 
     // Cloud
     glm::vec3 m_sky_color;
@@ -0,0 +1,14 @@
+// The noise generation, shared by the C++ code (noise_texture.cpp) and the compute shaders (noise_gen_2d.comp, noise_gen_3d.comp).
+
+#ifdef __cplusplus
+#pragma once
+#endif
+
+#define NOISE_TYPE_PERLIN  0
+#define NOISE_TYPE_SIMPLEX 1
+#define NOISE_TYPE_WORLEY  2
+
+#define NOISE_IMAGE_BINDING_INDEX 0
+
+#define NOISE_GROUP_SIZE_2D 8
+#define NOISE_GROUP_SIZE_3D 4
@@ -0,0 +1,229 @@
+#include "noise_texture.h"
+#include "gl_state.h"
+#include "job_system.h"
+
+#include "glm/gtc/noise.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "noise_shared.h"
+
+namespace
+{
+    /* The same as pcgHash() of noise.glh. */
+    uint32_t pcg_hash(uint32_t v)
+    {
+        const uint32_t state = v * 747796405u + 2891336453u;
+        const uint32_t word  = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+
+        return (word >> 22u) ^ word;
+    }
+
+    /* Whole lattice cells, so the periodic noise stays periodic. */
+    glm::vec3 seed_offset(uint32_t seed)
+    {
+        return glm::vec3(pcg_hash(seed) & 0xFF, pcg_hash(seed + 1) & 0xFF, pcg_hash(seed + 2) & 0xFF);
+    }
+
+    glm::vec3 worley_point(const glm::ivec3& cell, uint32_t seed)
+    {
+        const uint32_t h = pcg_hash(uint32_t(cell.x) ^ pcg_hash(uint32_t(cell.y) ^ pcg_hash(uint32_t(cell.z) ^ seed)));
+
+        return glm::vec3(h & 0x3FF, (h >> 10) & 0x3FF, (h >> 20) & 0x3FF) / 1024.0f;
+    }
+
+    /* worley() of noise.glh. */
+    float worley(const glm::vec3& p, const glm::ivec3& rep, uint32_t seed)
+    {
+        const glm::ivec3 base = glm::ivec3(glm::floor(p));
+        const glm::vec3  f    = glm::fract(p);
+
+        float min_distance = 1.0f;
+
+        for (int z = -1; z <= 1; ++z)
+        for (int y = -1; y <= 1; ++y)
+        for (int x = -1; x <= 1; ++x)
+        {
+            const glm::ivec3 offset = glm::ivec3(x, y, z);
+            const glm::ivec3 cell   = (((base + offset) % rep) + rep) % rep;
+
+            min_distance = std::min(min_distance, glm::distance(f, glm::vec3(offset) + worley_point(cell, seed)));
+        }
+
+        return 1.0f - 2.0f * min_distance;
+    }
+
+    /* noise() of noise.glh, glm::perlin() and glm::simplex() are the same webgl-noise functions. */
+    float noise(const glm::vec3& p, float frequency, bool is_3d, const NoiseTexture::Settings& settings, const glm::vec3& offset)
+    {
+        if (settings.type == NoiseTexture::Type::WORLEY)
+        {
+            glm::ivec3 cells_rep = settings.periodic ? glm::ivec3(std::max(std::round(frequency), 1.0f)) : glm::ivec3(1 << 20);
+
+            if (!is_3d)
+            {
+                cells_rep.z = 1 << 20;
+            }
+
+            return worley(p + offset, cells_rep, settings.seed);
+        }
+
+        if (settings.type == NoiseTexture::Type::SIMPLEX)
+        {
+            return is_3d ? glm::simplex(p + offset) : glm::simplex(glm::vec2(p + offset));
+        }
+
+        if (!settings.periodic)
+        {
+            return is_3d ? glm::perlin(p + offset) : glm::perlin(glm::vec2(p + offset));
+        }
+
+        return is_3d ? glm::perlin(p + offset, glm::vec3(frequency)) : glm::perlin(glm::vec2(p + offset), glm::vec2(frequency));
+    }
+
+    /* fbm() of noise.glh. */
+    glm::vec4 fbm(const glm::vec3& p, bool is_3d, const NoiseTexture::Settings& settings, const glm::vec3& offset)
+    {
+        glm::vec4 result    = glm::vec4(0.0f);
+        float     sum       = 0.0f;
+        float     frequency = settings.frequency;
+        float     amplitude = settings.persistence;
+        int       channel   = 0;
+
+        for (int octave = 0; octave < settings.octaves; ++octave)
+        {
+            sum += noise(p * frequency, frequency, is_3d, settings, offset) * amplitude;
+
+            while (channel < 4 && octave + 1 >= (settings.octaves * (channel + 1) + 3) / 4)
+            {
+                result[channel++] = glm::clamp((sum + 1.0f) * 0.5f, 0.0f, 1.0f);
+            }
+
+            frequency *= settings.lacunarity;
+            amplitude *= settings.persistence;
+        }
+
+        return result;
+    }
+}
+
+NoiseTexture::NoiseTexture(const glm::uvec3& size)
+    : m_size        (glm::max(size, glm::uvec3(1))),
+      m_texture_name(0)
+{
+    const GLsizei levels_count = 1 + GLsizei(std::floor(std::log2(float(std::max({ m_size.x, m_size.y, m_size.z })))));
+
+    if (is3D())
+    {
+        glCreateTextures  (GL_TEXTURE_3D, 1, &m_texture_name);
+        glTextureStorage3D(m_texture_name, levels_count, GL_RGBA16F, m_size.x, m_size.y, m_size.z);
+        glTextureParameteri(m_texture_name, GL_TEXTURE_WRAP_R, GL_REPEAT);
+
+        m_gen_shader = std::make_shared<RGL::Shader>("src/demos/16_noise/noise_gen_3d.comp");
+    }
+    else
+    {
+        glCreateTextures  (GL_TEXTURE_2D, 1, &m_texture_name);
+        glTextureStorage2D(m_texture_name, levels_count, GL_RGBA16F, m_size.x, m_size.y);
+
+        m_gen_shader = std::make_shared<RGL::Shader>("src/demos/16_noise/noise_gen_2d.comp");
+    }
+
+    m_gen_shader->link();
+
+    glTextureParameteri(m_texture_name, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(m_texture_name, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(m_texture_name, GL_TEXTURE_WRAP_S,     GL_REPEAT);
+    glTextureParameteri(m_texture_name, GL_TEXTURE_WRAP_T,     GL_REPEAT);
+}
+
+NoiseTexture::~NoiseTexture()
+{
+    glDeleteTextures(1, &m_texture_name);
+    RGL::GLState::OnTextureDeleted(m_texture_name);
+}
+
+void NoiseTexture::generate(const Settings& settings, bool use_gpu)
+{
+    if (use_gpu)
+    {
+        generateGpu(settings);
+    }
+    else
+    {
+        generateCpu(settings);
+    }
+
+    glGenerateTextureMipmap(m_texture_name);
+}
+
+void NoiseTexture::bind(GLuint unit) const
+{
+    RGL::GLState::BindTextureUnit(unit, m_texture_name);
+}
+
+void NoiseTexture::generateGpu(const Settings& settings)
+{
+    m_gen_shader->bind();
+    m_gen_shader->setUniform("u_noise_type",  int(settings.type));
+    m_gen_shader->setUniform("u_frequency",   settings.frequency);
+    m_gen_shader->setUniform("u_persistence", settings.persistence);
+    m_gen_shader->setUniform("u_lacunarity",  settings.lacunarity);
+    m_gen_shader->setUniform("u_octaves",     settings.octaves);
+    m_gen_shader->setUniform("u_is_periodic", int(settings.periodic));
+    m_gen_shader->setUniform("u_seed",        GLuint(settings.seed));
+    m_gen_shader->setUniform("u_seed_offset", seed_offset(settings.seed));
+
+    glBindImageTexture(NOISE_IMAGE_BINDING_INDEX, m_texture_name, 0, GL_TRUE /* layered */, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+    if (is3D())
+    {
+        glDispatchCompute((m_size.x + NOISE_GROUP_SIZE_3D - 1) / NOISE_GROUP_SIZE_3D,
+                          (m_size.y + NOISE_GROUP_SIZE_3D - 1) / NOISE_GROUP_SIZE_3D,
+                          (m_size.z + NOISE_GROUP_SIZE_3D - 1) / NOISE_GROUP_SIZE_3D);
+    }
+    else
+    {
+        glDispatchCompute((m_size.x + NOISE_GROUP_SIZE_2D - 1) / NOISE_GROUP_SIZE_2D,
+                          (m_size.y + NOISE_GROUP_SIZE_2D - 1) / NOISE_GROUP_SIZE_2D,
+                          1);
+    }
+
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+}
+
+void NoiseTexture::generateCpu(const Settings& settings)
+{
+    const bool      is_3d  = is3D();
+    const glm::vec3 offset = seed_offset(settings.seed);
+
+    std::vector<glm::vec4> data(size_t(m_size.x) * m_size.y * m_size.z);
+
+    /* A row per job at least, the slices of a 3D texture are just more rows. */
+    RGL::JobSystem::ParallelFor(0, m_size.y * m_size.z, 4, [&](uint32_t row_begin, uint32_t row_end)
+    {
+        for (uint32_t row = row_begin; row < row_end; ++row)
+        {
+            const uint32_t y = row % m_size.y;
+            const uint32_t z = row / m_size.y;
+
+            for (uint32_t x = 0; x < m_size.x; ++x)
+            {
+                const glm::vec3 p = (glm::vec3(x, y, z) + 0.5f) / glm::vec3(m_size);
+
+                data[size_t(row) * m_size.x + x] = fbm(is_3d ? p : glm::vec3(p.x, p.y, 0.0f), is_3d, settings, offset);
+            }
+        }
+    });
+
+    if (is_3d)
+    {
+        glTextureSubImage3D(m_texture_name, 0, 0, 0, 0, m_size.x, m_size.y, m_size.z, GL_RGBA, GL_FLOAT, data.data());
+    }
+    else
+    {
+        glTextureSubImage2D(m_texture_name, 0, 0, 0, m_size.x, m_size.y, GL_RGBA, GL_FLOAT, data.data());
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "shader.h"
+
+#include <glm/glm.hpp>
+#include <memory>
+
+/*
+ * An RGBA16F 2D or 3D texture of fBm noise - Perlin, simplex or Worley. The channels hold the running sum after each quarter
+ * of the octaves, see fbm() in noise.glh. Generated by noise_gen_2d.comp / noise_gen_3d.comp straight into the texture,
+ * or on the CPU over the rows in parallel and uploaded.
+ */
+class NoiseTexture
+{
+public:
+    enum class Type { PERLIN = 0, SIMPLEX, WORLEY };
+
+    struct Settings
+    {
+        Type     type        = Type::PERLIN;
+        float    frequency   = 4.0f;    /* Lattice cells over the texture in the first octave. */
+        float    persistence = 0.5f;    /* Amplitude of the first octave and the falloff of the next ones. */
+        float    lacunarity  = 2.0f;
+        int      octaves     = 4;
+        uint32_t seed        = 0;
+        bool     periodic    = true;    /* Tiles with whole frequencies and lacunarity. Simplex never tiles. */
+
+        bool operator==(const Settings& other) const
+        {
+            return type        == other.type        &&
+                   frequency   == other.frequency   &&
+                   persistence == other.persistence &&
+                   lacunarity  == other.lacunarity  &&
+                   octaves     == other.octaves     &&
+                   seed        == other.seed        &&
+                   periodic    == other.periodic;
+        }
+
+        bool operator!=(const Settings& other) const { return !(*this == other); }
+    };
+
+    /* A depth of 1 makes a 2D texture. */
+    explicit NoiseTexture(const glm::uvec3& size);
+    ~NoiseTexture();
+
+    NoiseTexture           (const NoiseTexture&) = delete;
+    NoiseTexture& operator=(const NoiseTexture&) = delete;
+
+    void generate(const Settings& settings, bool use_gpu = true);
+    void bind(GLuint unit) const;
+
+    GLuint            getTexture() const { return m_texture_name; }
+    const glm::uvec3& getSize()    const { return m_size; }
+    bool              is3D()       const { return m_size.z > 1; }
+
+private:
+    void generateGpu(const Settings& settings);
+    void generateCpu(const Settings& settings);
+
+    std::shared_ptr<RGL::Shader> m_gen_shader;
+
+    glm::uvec3 m_size;
+    GLuint     m_texture_name;
+};
@@ -0,0 +1,88 @@
+#include "displacement_maps.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+DisplacementMaps::DisplacementMaps(const glm::vec2& plane_size, const glm::uvec2& resolution)
+    : m_is_baked            (false),
+      m_plane_size          (plane_size),
+      m_resolution          (resolution),
+      m_heights_texture_name(0),
+      m_normal_map_name     (0)
+{
+    m_heights_shader = std::make_shared<RGL::Shader>("src/demos/17_vertex_displacement/displacement_heights.comp");
+    m_heights_shader->link();
+
+    m_normals_shader = std::make_shared<RGL::Shader>("src/demos/17_vertex_displacement/displacement_normals.comp");
+    m_normals_shader->link();
+
+    const GLuint levels_count = 1 + GLuint(std::floor(std::log2(float(std::max(m_resolution.x, m_resolution.y)))));
+
+    /* The TES reads the heights at the vertices, the mips would flatten the waves. */
+    glCreateTextures  (GL_TEXTURE_2D, 1, &m_heights_texture_name);
+    glTextureStorage2D(m_heights_texture_name, 1, GL_R32F, m_resolution.x, m_resolution.y);
+
+    glTextureParameteri(m_heights_texture_name, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(m_heights_texture_name, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    /* The TCS reads the curvature of a whole edge from the mip of its length. */
+    glCreateTextures  (GL_TEXTURE_2D, 1, &m_normal_map_name);
+    glTextureStorage2D(m_normal_map_name, levels_count, GL_RGBA16F, m_resolution.x, m_resolution.y);
+
+    glTextureParameteri(m_normal_map_name, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(m_normal_map_name, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    for (GLuint texture_name : { m_heights_texture_name, m_normal_map_name })
+    {
+        glTextureParameteri(texture_name, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(texture_name, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+}
+
+DisplacementMaps::~DisplacementMaps()
+{
+    glDeleteTextures(1, &m_heights_texture_name);
+    glDeleteTextures(1, &m_normal_map_name);
+}
+
+void DisplacementMaps::update(const DisplacementParams& params)
+{
+    if (m_is_baked && params == m_baked_params)
+    {
+        return;
+    }
+
+    m_baked_params = params;
+    m_is_baked     = true;
+
+    const glm::vec2 cell_size = m_plane_size / glm::vec2(m_resolution - 1u);
+
+    m_heights_shader->bind();
+    m_heights_shader->setUniform("u_plane_size",       m_plane_size);
+    m_heights_shader->setUniform("u_amplitude",        params.amplitude);
+    m_heights_shader->setUniform("u_frequency",        params.frequency);
+    m_heights_shader->setUniform("u_detail_amplitude", params.detail_amplitude);
+    m_heights_shader->setUniform("u_detail_frequency", params.detail_frequency);
+
+    glBindImageTexture(0, m_heights_texture_name, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+    glDispatchCompute((m_resolution.x + 7) / 8, (m_resolution.y + 7) / 8, 1);
+    glMemoryBarrier  (GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    m_normals_shader->bind();
+    m_normals_shader->setUniform("u_cell_size", cell_size);
+
+    glBindTextureUnit (0, m_heights_texture_name);
+    glBindImageTexture(0, m_normal_map_name, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+    glDispatchCompute((m_resolution.x + 7) / 8, (m_resolution.y + 7) / 8, 1);
+    glMemoryBarrier  (GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    glGenerateTextureMipmap(m_normal_map_name);
+}
+
+void DisplacementMaps::bind() const
+{
+    glBindTextureUnit(HEIGHTS_UNIT,    m_heights_texture_name);
+    glBindTextureUnit(NORMAL_MAP_UNIT, m_normal_map_name);
+}
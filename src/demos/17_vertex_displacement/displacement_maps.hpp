@@ -0,0 +1,59 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <memory>
+
+#include "shader.h"
+
+/* The displacement of the baked mode - the wave of the procedural one with a ripple across it. */
+struct DisplacementParams
+{
+    float amplitude        = 0.8f;
+    float frequency        = 1.6f;
+    float detail_amplitude = 0.05f;
+    float detail_frequency = 12.0f;
+
+    bool operator==(const DisplacementParams& other) const = default;
+};
+
+/*
+ * The heights of the plane and their normals, baked by displacement_heights.comp and displacement_normals.comp
+ * whenever the parameters change - the TES samples them instead of evaluating the displacement and its derivatives
+ * per vertex, so any displacement function costs the same to render. The normal map's w is the curvature of the
+ * heights (the larger second derivative), the TCS tessellates the edges by it, its mips average the curvature.
+ */
+class DisplacementMaps
+{
+public:
+    static constexpr GLuint HEIGHTS_UNIT    = 0;
+    static constexpr GLuint NORMAL_MAP_UNIT = 1;
+
+    /* The plane's size in local units, x along its width, y along its height (-z). */
+    DisplacementMaps(const glm::vec2& plane_size, const glm::uvec2& resolution);
+    ~DisplacementMaps();
+
+    DisplacementMaps           (const DisplacementMaps&) = delete;
+    DisplacementMaps& operator=(const DisplacementMaps&) = delete;
+
+    /* Bakes the maps if the parameters are not the ones of the last bake. */
+    void update(const DisplacementParams& params);
+
+    void bind() const;
+
+    const glm::vec2& getPlaneSize() const { return m_plane_size; }
+
+private:
+    std::shared_ptr<RGL::Shader> m_heights_shader;
+    std::shared_ptr<RGL::Shader> m_normals_shader;
+
+    DisplacementParams m_baked_params;
+    bool               m_is_baked;
+
+    glm::vec2  m_plane_size;
+    glm::uvec2 m_resolution;
+
+    GLuint m_heights_texture_name;
+    GLuint m_normal_map_name;
+};
@@ -8,15 +8,19 @@
 #include <glm/gtc/quaternion.hpp>
 
 VertexDisplacement::VertexDisplacement()
-    : m_specular_power    (120.0f),
-      m_specular_intenstiy(0.0f),
-      m_dir_light_angles  (67.5f),
-      m_ambient_color     (0.18f),
-      m_time              (0.0f),
-      m_amplitude         (0.8f),
-      m_velocity          (3.4f),
-      m_frequency         (1.6f)
-
+    : m_specular_power        (120.0f),
+      m_specular_intenstiy    (0.0f),
+      m_dir_light_angles      (67.5f),
+      m_ambient_color         (0.18f),
+      m_time                  (0.0f),
+      m_amplitude             (0.8f),
+      m_velocity              (3.4f),
+      m_frequency             (1.6f),
+      m_displacement_mode     (DisplacementMode::PROCEDURAL),
+      m_detail_amplitude      (0.05f),
+      m_detail_frequency      (12.0f),
+      m_tolerance             (0.5f),
+      m_min_pixels_per_segment(4.0f)
 {
 }
 
@@ -33,6 +37,7 @@ void VertexDisplacement::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(-3.0, 1.5, 10.0);
     m_camera->setOrientation(5.0f, 20.0f, 0.0f);
 
@@ -52,6 +57,16 @@ void VertexDisplacement::init_app()
     std::string dir  = "src/demos/17_vertex_displacement/";
     m_vs_disp_shader = std::make_shared<RGL::Shader>(dir + "vs_disp.vert", dir + "vs_disp.frag");
     m_vs_disp_shader->link();
+
+    /* The baked mode - a coarse plane of triangle patches, the tessellation adds the vertices where the waves are. */
+    m_baked_disp_shader = std::make_shared<RGL::Shader>(dir + "vs_disp_baked.vert", dir + "vs_disp.frag", dir + "vs_disp_baked.tcs", dir + "vs_disp_baked.tes");
+    m_baked_disp_shader->link();
+
+    m_patches_model = std::make_shared<RGL::StaticModel>();
+    m_patches_model->GenPlane(10, 5, 20, 10);
+    m_patches_model->SetDrawMode(RGL::DrawMode::PATCHES);
+
+    m_displacement_maps = std::make_unique<DisplacementMaps>(glm::vec2(10.0f, 5.0f), glm::uvec2(1024, 512));
 }
 
 void VertexDisplacement::input()
@@ -107,25 +122,53 @@ void VertexDisplacement::render()
 {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+    auto view_projection = m_camera->viewProjection();
+    auto& shader         = m_displacement_mode == DisplacementMode::BAKED ? m_baked_disp_shader : m_vs_disp_shader;
 
     /* Draw curve */
-    m_vs_disp_shader->bind();
-    m_vs_disp_shader->setUniform("cam_pos",                          m_camera->position());
-    m_vs_disp_shader->setUniform("directional_light.base.color",     m_dir_light_properties.color);
-    m_vs_disp_shader->setUniform("directional_light.base.intensity", m_dir_light_properties.intensity);
-    m_vs_disp_shader->setUniform("directional_light.direction",      m_dir_light_properties.direction);
-    m_vs_disp_shader->setUniform("ambient",                          m_ambient_color);
-    m_vs_disp_shader->setUniform("specular_intensity",               m_specular_intenstiy.x);
-    m_vs_disp_shader->setUniform("specular_power",                   m_specular_power.x);
-    m_vs_disp_shader->setUniform("mvp",                              view_projection * m_world_matrix);
-    m_vs_disp_shader->setUniform("model",                            m_world_matrix);
-    m_vs_disp_shader->setUniform("normal_matrix",                    glm::mat3(glm::transpose(glm::inverse(m_world_matrix))));
-    m_vs_disp_shader->setUniform("time",                             m_time);
-    m_vs_disp_shader->setUniform("amplitude",                        m_amplitude);
-    m_vs_disp_shader->setUniform("velocity",                         m_velocity);
-    m_vs_disp_shader->setUniform("frequency",                        m_frequency);
-    m_model->Render();
+    shader->bind();
+    shader->setUniform("cam_pos",                          m_camera->position());
+    shader->setUniform("directional_light.base.color",     m_dir_light_properties.color);
+    shader->setUniform("directional_light.base.intensity", m_dir_light_properties.intensity);
+    shader->setUniform("directional_light.direction",      m_dir_light_properties.direction);
+    shader->setUniform("ambient",                          m_ambient_color);
+    shader->setUniform("specular_intensity",               m_specular_intenstiy.x);
+    shader->setUniform("specular_power",                   m_specular_power.x);
+    shader->setUniform("mvp",                              view_projection * m_world_matrix);
+    shader->setUniform("model",                            m_world_matrix);
+    shader->setUniform("normal_matrix",                    glm::mat3(glm::transpose(glm::inverse(m_world_matrix))));
+
+    if (m_displacement_mode == DisplacementMode::PROCEDURAL)
+    {
+        shader->setUniform("time",      m_time);
+        shader->setUniform("amplitude", m_amplitude);
+        shader->setUniform("velocity",  m_velocity);
+        shader->setUniform("frequency", m_frequency);
+        m_model->Render();
+
+        return;
+    }
+
+    DisplacementParams params;
+    params.amplitude        = m_amplitude;
+    params.frequency        = m_frequency;
+    params.detail_amplitude = m_detail_amplitude;
+    params.detail_frequency = m_detail_frequency;
+
+    /* A no-op unless the parameters have changed. The bake binds its own shaders, the uniforms go after it. */
+    m_displacement_maps->update(params);
+    m_displacement_maps->bind();
+
+    shader->bind();
+    shader->setUniform("view_projection",        view_projection);
+    shader->setUniform("plane_size",             m_displacement_maps->getPlaneSize());
+    shader->setUniform("viewport_height",        float(RGL::Window::getHeight()));
+    shader->setUniform("projection_scale",       m_camera->m_projection[1][1]);
+    shader->setUniform("tolerance",              m_tolerance);
+    shader->setUniform("min_pixels_per_segment", m_min_pixels_per_segment);
+
+    glPatchParameteri(GL_PATCH_VERTICES, 3);
+    m_patches_model->Render();
 }
 
 void VertexDisplacement::render_gui()
@@ -160,9 +203,28 @@ void VertexDisplacement::render_gui()
         ImGui::Spacing();
 
         ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
+        const char* modes_names[] = { "Procedural", "Baked" };
+        int mode = int(m_displacement_mode);
+        if (ImGui::Combo("Displacement", &mode, modes_names, IM_ARRAYSIZE(modes_names)))
+        {
+            m_displacement_mode = DisplacementMode(mode);
+        }
+
         ImGui::SliderFloat("Amplitude", &m_amplitude, 0.0, 4.0,  "%.1f");
-        ImGui::SliderFloat("Velocity",  &m_velocity,  0.0, 20.0, "%.1f");
         ImGui::SliderFloat("Frequency", &m_frequency, 0.0, 20.0, "%.1f");
+
+        if (m_displacement_mode == DisplacementMode::PROCEDURAL)
+        {
+            ImGui::SliderFloat("Velocity", &m_velocity, 0.0, 20.0, "%.1f");
+        }
+        else
+        {
+            ImGui::SliderFloat("Detail amplitude",       &m_detail_amplitude,       0.0, 0.5,  "%.2f");
+            ImGui::SliderFloat("Detail frequency",       &m_detail_frequency,       0.0, 40.0, "%.1f");
+            ImGui::SliderFloat("Tolerance (px)",         &m_tolerance,              0.1, 4.0,  "%.1f");
+            ImGui::SliderFloat("Min pixels per segment", &m_min_pixels_per_segment, 1.0, 32.0, "%.0f");
+        }
+
         ImGui::PopItemWidth();
         ImGui::Spacing();
 
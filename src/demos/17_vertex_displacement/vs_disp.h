@@ -2,6 +2,7 @@
 #include "core_app.h"
 
 #include "camera.h"
+#include "displacement_maps.hpp"
 #include "static_model.h"
 #include "shader.h"
 
@@ -59,4 +60,20 @@ private:
     float m_amplitude;
     float m_velocity;
     float m_frequency;
+
+    /*
+     * Procedural - the vertex shader moves the dense plane's vertices with the wave every frame, animated.
+     * Baked - the displacement and its normals are baked to DisplacementMaps when the parameters change,
+     * a coarse plane is tessellated by the displacement's curvature on screen and samples them.
+     */
+    enum class DisplacementMode { PROCEDURAL, BAKED } m_displacement_mode;
+
+    std::shared_ptr<RGL::Shader>      m_baked_disp_shader;
+    std::shared_ptr<RGL::StaticModel> m_patches_model;
+    std::unique_ptr<DisplacementMaps> m_displacement_maps;
+
+    float m_detail_amplitude;
+    float m_detail_frequency;
+    float m_tolerance;
+    float m_min_pixels_per_segment;
 };
\ No newline at end of file
@@ -0,0 +1,9 @@
+#version 460 core
+layout (location = 0) in vec3 in_pos;
+
+out vec3 local_pos_TCS_in;
+
+void main()
+{
+	local_pos_TCS_in = in_pos;
+}
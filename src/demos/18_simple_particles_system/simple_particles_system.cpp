@@ -8,31 +8,40 @@
 #include <glm/gtc/random.hpp>
 
 SimpleParticlesSystem::SimpleParticlesSystem()
-    : m_draw_buffer_idx           (1),
-      m_emitter_pos               (0.0,  0.0, 0.0),
-      m_emitter_dir               (0.0,  1.0, 0.0),
-      m_acceleration              (0.0, -0.5, 0.0),
-      m_no_particles              (8000),
-      m_particle_lifetime         (10.0f),
-      m_particle_size_min_max     (0.05f),
-      m_particle_angle            (glm::half_pi<float>()),
-      m_delta_time                (0.0f),
-      m_should_fade_out_with_time (false),
-      m_start_position_min_max    (0.0f),
-      m_start_velocity_min_max    (1.25, 1.5),
-      m_direction_constraints     (1, 1, 1),
-      m_cone_angle                (glm::degrees(glm::pi<float>() / 8.0f))
+    : m_particles_buffer           (0),
+      m_dead_list_buffer           (0),
+      m_alive_list_buffers         { 0, 0 },
+      m_indirect_args_buffer       (0),
+      m_empty_vao_id               (0),
+      m_alive_list_idx             (0),
+      m_particles_capacity         (0),
+      m_alive_particles_count      (0),
+      m_emitter_pos                (0.0,  0.0, 0.0),
+      m_emitter_dir                (0.0,  1.0, 0.0),
+      m_acceleration               (0.0, -0.5, 0.0),
+      m_max_particles              (1 << 20),
+      m_particle_lifetime          (10.0f),
+      m_emission_rate              (800.0f),
+      m_emission_remainder         (0.0f),
+      m_frame                      (0),
+      m_particle_size_min_max      (0.05f),
+      m_particle_angle             (glm::half_pi<float>()),
+      m_delta_time                 (0.0f),
+      m_should_fade_out_with_time  (false),
+      m_start_position_min_max     (0.0f),
+      m_start_velocity_min_max     (1.25, 1.5),
+      m_direction_constraints      (1, 1, 1),
+      m_cone_angle                 (glm::degrees(glm::pi<float>() / 8.0f))
 {
 }
 
 SimpleParticlesSystem::~SimpleParticlesSystem()
 {
-    glDeleteBuffers           (2, m_pos_vbo_ids);
-    glDeleteBuffers           (2, m_velocity_vbo_ids);
-    glDeleteBuffers           (2, m_age_vbo_ids);
-    glDeleteVertexArrays      (2, m_vao_ids);
-    glDeleteTransformFeedbacks(2, m_tfo_ids);
-    glDeleteTextures          (1, &m_random_texture_1d);
+    glDeleteBuffers     (1, &m_particles_buffer);
+    glDeleteBuffers     (1, &m_dead_list_buffer);
+    glDeleteBuffers     (2, m_alive_list_buffers);
+    glDeleteBuffers     (1, &m_indirect_args_buffer);
+    glDeleteVertexArrays(1, &m_empty_vao_id);
 }
 
 void SimpleParticlesSystem::init_app()
@@ -45,17 +54,6 @@ void SimpleParticlesSystem::init_app()
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    GLint max_width;
-    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_width);
-    max_width = max_width / 3;
-
-    if(m_no_particles > max_width)
-    {
-        m_no_particles = max_width;
-    }
-
-    std::cout << "TF no. particles: " << m_no_particles << std::endl;
-
     /* Set file browser properties */
     m_file_dialog.SetTitle("Load texture");
     m_file_dialog.SetTypeFilters({ ".png" });
@@ -63,6 +61,7 @@ void SimpleParticlesSystem::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(4.0, 1.5, -4.0);
     m_camera->setOrientation(5.0f, 225.0f, 0.0f);
     m_camera->update(0.0);
@@ -80,111 +79,27 @@ void SimpleParticlesSystem::init_app()
     m_particles_shader = std::make_shared<RGL::Shader>(dir + "particles.vert", dir + "particles.frag");
     m_particles_shader->link();
 
-    /* Create and allocate all the buffers for the particle system */
-    glGenBuffers(2, m_pos_vbo_ids);
-    glGenBuffers(2, m_velocity_vbo_ids);
-    glGenBuffers(2, m_age_vbo_ids);
-
-    uint64_t size = m_no_particles * 3 * sizeof(GLfloat);
-    glBindBuffer(GL_ARRAY_BUFFER, m_pos_vbo_ids[0]);
-    glBufferData(GL_ARRAY_BUFFER, size, 0, GL_DYNAMIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, m_pos_vbo_ids[1]);
-    glBufferData(GL_ARRAY_BUFFER, size, 0, GL_DYNAMIC_DRAW);
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_velocity_vbo_ids[0]);
-    glBufferData(GL_ARRAY_BUFFER, size, 0, GL_DYNAMIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, m_velocity_vbo_ids[1]);
-    glBufferData(GL_ARRAY_BUFFER, size, 0, GL_DYNAMIC_DRAW);
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_age_vbo_ids[0]);
-    glBufferData(GL_ARRAY_BUFFER, m_no_particles * sizeof(GLfloat), 0, GL_DYNAMIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, m_age_vbo_ids[1]);
-    glBufferData(GL_ARRAY_BUFFER, m_no_particles * sizeof(GLfloat), 0, GL_DYNAMIC_DRAW);
-
-    /* Fill the first age buffer */
-    std::vector<GLfloat> initial_particle_ages(m_no_particles);
-    float rate = m_particle_lifetime / m_no_particles;
-
-    for (int i = 0; i < m_no_particles; ++i)
-    {
-        initial_particle_ages[i] = rate * (i - m_no_particles);
-    }
-
-    auto rng = std::default_random_engine{};
-    std::shuffle(initial_particle_ages.begin(), initial_particle_ages.end(), rng);
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_age_vbo_ids[0]);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, m_no_particles * sizeof(float), initial_particle_ages.data());
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    /* Create VAOs for each set of buffers */
-    glGenVertexArrays(2, m_vao_ids);
-
-    /* Array 0 */
-    glBindVertexArray(m_vao_ids[0]);
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_pos_vbo_ids[0]);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_velocity_vbo_ids[0]);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(1);
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_age_vbo_ids[0]);
-    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(2);
-
-    /* Array 1 */
-    glBindVertexArray(m_vao_ids[1]);
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_pos_vbo_ids[1]);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_velocity_vbo_ids[1]);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(1);
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_age_vbo_ids[1]);
-    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(2);
+    m_prepare_shader = std::make_shared<RGL::Shader>(dir + "particles_prepare.comp");
+    m_prepare_shader->link();
 
-    glBindVertexArray(0);
+    m_emit_shader = std::make_shared<RGL::Shader>(dir + "particles_emit.comp");
+    m_emit_shader->link();
 
-    /* Setup transform feedback objects */
-    glGenTransformFeedbacks(2, m_tfo_ids);
+    m_simulate_shader = std::make_shared<RGL::Shader>(dir + "particles_simulate.comp");
+    m_simulate_shader->link();
 
-    /* TF 0 */
-    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, m_tfo_ids[0]);
-    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_pos_vbo_ids[0]);
-    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 1, m_velocity_vbo_ids[0]);
-    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 2, m_age_vbo_ids[0]);
+    m_draw_args_shader = std::make_shared<RGL::Shader>(dir + "particles_draw_args.comp");
+    m_draw_args_shader->link();
 
-    /* TF 1 */
-    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, m_tfo_ids[1]);
-    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_pos_vbo_ids[1]);
-    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 1, m_velocity_vbo_ids[1]);
-    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 2, m_age_vbo_ids[1]);
+    /* The particles are fetched from the SSBOs in the vertex shader, the draw needs no attributes. */
+    glCreateVertexArrays(1, &m_empty_vao_id);
 
-    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+    glCreateBuffers(1, &m_indirect_args_buffer);
+    glNamedBufferStorage(m_indirect_args_buffer, sizeof(uint32_t) * 12, nullptr, GL_DYNAMIC_STORAGE_BIT);
 
-    /* Create 1D random texture of particles velocities */
-    size = m_no_particles * 3;
-    std::vector<GLfloat> rand_velocities(size);
+    m_alive_count_readback.Create(sizeof(uint32_t), 1);
 
-    for(int i = 0; i < rand_velocities.size(); ++i)
-    {
-        rand_velocities[i] = RGL::Util::RandomDouble(0.0, 1.0);
-    }
-
-    glCreateTextures(GL_TEXTURE_1D, 1, &m_random_texture_1d);
-
-    glTextureStorage1D(m_random_texture_1d, 1, GL_R32F, size);
-    glTextureSubImage1D(m_random_texture_1d, 0, 0, size, GL_RED, GL_FLOAT, rand_velocities.data());
-
-    glTextureParameteri(m_random_texture_1d, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTextureParameteri(m_random_texture_1d, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    reset_particles_buffers();
 
     /* Create particle texture */
     m_current_texture_filename = "bluewater.png";
@@ -242,43 +157,69 @@ void SimpleParticlesSystem::update(double delta_time)
 
 void SimpleParticlesSystem::render()
 {
-    m_particles_shader->bind();
-    m_particles_shader->setUniform("particle_lifetime",      m_particle_lifetime);
-    m_particles_shader->setUniform("emitter_world_pos",      m_emitter_pos);
-    m_particles_shader->setUniform("emitter_basis",          make_arbitrary_basis(m_emitter_dir));
-    m_particles_shader->setUniform("delta_t",                m_delta_time);
-    m_particles_shader->setUniform("acceleration",           m_acceleration);
-    m_particles_shader->setUniform("model_view",             m_camera->m_view);
-    m_particles_shader->setUniform("projection",             m_camera->m_projection);
-    m_particles_shader->setUniform("particle_size_min_max",  m_particle_size_min_max);
-    m_particles_shader->setUniform("should_keep_color",      !m_should_fade_out_with_time);
-    m_particles_shader->setUniform("start_position_min_max", m_start_position_min_max);
-    m_particles_shader->setUniform("start_velocity_min_max", m_start_velocity_min_max);
-    m_particles_shader->setUniform("direction_constraints",  m_direction_constraints);
-    m_particles_shader->setUniform("cone_angle",             glm::radians(m_cone_angle));
-
-    /* Update pass */
-    m_particles_shader->setSubroutine(RGL::Shader::ShaderType::VERTEX, "update");
-
-    glEnable(GL_RASTERIZER_DISCARD); // Turn off rasterization
-    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, m_tfo_ids[m_draw_buffer_idx]);
-    glBeginTransformFeedback(GL_POINTS);
-
-    glBindVertexArray(m_vao_ids[1 - m_draw_buffer_idx]);
-    glVertexAttribDivisor(0, 0);
-    glVertexAttribDivisor(1, 0);
-    glVertexAttribDivisor(2, 0);
-    glDrawArrays(GL_POINTS, 0, m_no_particles);
-
-    glEndTransformFeedback();
-    glDisable(GL_RASTERIZER_DISCARD); // Turn on rasterization
+    read_alive_particles_count();
+
+    /* The particles owed by the emission rate, the fraction carries over to the next frame. */
+    m_emission_remainder += m_emission_rate * m_delta_time;
+
+    const float emit_count = glm::floor(m_emission_remainder);
+    m_emission_remainder  -= emit_count;
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_particles_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_dead_list_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_alive_list_buffers[m_alive_list_idx]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_alive_list_buffers[1 - m_alive_list_idx]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_indirect_args_buffer);
+
+    /* Clamp the emission to the free particles and write the dispatches' arguments. */
+    m_prepare_shader->bind();
+    m_prepare_shader->setUniform("u_emit_count", GLuint(glm::min(emit_count, float(m_particles_capacity))));
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, m_indirect_args_buffer);
+
+    /* Emit */
+    m_emit_shader->bind();
+    m_emit_shader->setUniform("u_particle_lifetime",      m_particle_lifetime);
+    m_emit_shader->setUniform("u_emitter_world_pos",      m_emitter_pos);
+    m_emit_shader->setUniform("u_emitter_basis",          make_arbitrary_basis(m_emitter_dir));
+    m_emit_shader->setUniform("u_start_position_min_max", m_start_position_min_max);
+    m_emit_shader->setUniform("u_start_velocity_min_max", m_start_velocity_min_max);
+    m_emit_shader->setUniform("u_direction_constraints",  m_direction_constraints);
+    m_emit_shader->setUniform("u_cone_angle",             glm::radians(m_cone_angle));
+    m_emit_shader->setUniform("u_random_seed",            m_frame++);
+    glDispatchComputeIndirect(0 /* emit_groups */);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    /* Simulate and compact */
+    m_simulate_shader->bind();
+    m_simulate_shader->setUniform("u_delta_t",      m_delta_time);
+    m_simulate_shader->setUniform("u_acceleration", m_acceleration);
+    glDispatchComputeIndirect(sizeof(uint32_t) * 4 /* simulate_groups */);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    m_draw_args_shader->bind();
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+    /* A single copy in flight, the count shown in the GUI lags a few frames behind. */
+    if (m_alive_count_readback.GetPendingCount() == 0)
+    {
+        m_alive_count_readback.ReadBuffer(m_indirect_args_buffer, sizeof(uint32_t) * 9 /* draw_instance_count */, sizeof(uint32_t), [this](const void* data, GLsizeiptr)
+        {
+            m_alive_particles_count = *static_cast<const uint32_t*>(data);
+        });
+    }
 
     /* Render pass */
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     /* Draw grid */
     m_simple_shader->bind();
-    m_simple_shader->setUniform("mvp",        m_camera->m_projection * m_camera->m_view);
+    m_simple_shader->setUniform("mvp",        m_camera->viewProjection());
     m_simple_shader->setUniform("color",      glm::vec3(0.4));
     m_simple_shader->setUniform("mix_factor", 1.0f);
 
@@ -286,21 +227,22 @@ void SimpleParticlesSystem::render()
 
     /* Draw particles */
     m_particles_shader->bind();
-    m_particles_shader->setSubroutine(RGL::Shader::ShaderType::VERTEX, "render");
-    
+    m_particles_shader->setUniform("model_view",            m_camera->m_view);
+    m_particles_shader->setUniform("projection",            m_camera->m_projection);
+    m_particles_shader->setUniform("particle_size_min_max", m_particle_size_min_max);
+    m_particles_shader->setUniform("should_keep_color",     !m_should_fade_out_with_time);
+
     m_particle_texture.Bind(0);
-    glBindTextureUnit(1, m_random_texture_1d);
 
     glDepthMask(GL_FALSE);
-    glBindVertexArray(m_vao_ids[m_draw_buffer_idx]);
-    glVertexAttribDivisor(0, 1);
-    glVertexAttribDivisor(1, 1);
-    glVertexAttribDivisor(2, 1);
-    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, m_no_particles);
+    glBindVertexArray(m_empty_vao_id);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirect_args_buffer);
+    glDrawArraysIndirect(GL_TRIANGLES, (const void*)(sizeof(uint32_t) * 8) /* draw_vertex_count */);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
     glDepthMask(GL_TRUE);
 
-    /* Swap buffers */
-    m_draw_buffer_idx = 1 - m_draw_buffer_idx;
+    /* Swap the alive lists */
+    m_alive_list_idx = 1 - m_alive_list_idx;
 }
 
 void SimpleParticlesSystem::render_gui()
@@ -350,6 +292,7 @@ void SimpleParticlesSystem::render_gui()
             }
             ImGui::SliderFloat3("Particles acceleration", &m_acceleration[0],           -10.0f, 10.0f,  "%.1f");
             ImGui::SliderFloat ("Particle lifetime",      &m_particle_lifetime,          0.1f,  20.0f,  "%.1f");
+            ImGui::SliderFloat ("Emission rate [1/s]",    &m_emission_rate,              0.0f,  1000000.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
             ImGui::SliderFloat2("Particle size min max",  &m_particle_size_min_max[0],   0.01f, 5.0f,   "%.2f");
             ImGui::SliderFloat2("Start position min max", &m_start_position_min_max[0], -5.0f,  5.0f,   "%.1f");
             ImGui::SliderFloat2("Start velocity min max", &m_start_velocity_min_max[0], -5.0f,  5.0f,   "%.1f");
@@ -368,6 +311,9 @@ void SimpleParticlesSystem::render_gui()
 
             ImGui::Spacing();
 
+            ImGui::SliderInt("Max particles", &m_max_particles, 1 << 10, 1 << 23, "%d", ImGuiSliderFlags_Logarithmic);
+            ImGui::Text("Alive particles: %u / %u", m_alive_particles_count, m_particles_capacity);
+
             if(ImGui::Button("Reset particles buffers"))
             {
                 reset_particles_buffers();
@@ -379,6 +325,7 @@ void SimpleParticlesSystem::render_gui()
             {
                 m_acceleration              = glm::vec3(0, -0.5, 0.0);
                 m_particle_lifetime         = 10.0f;
+                m_emission_rate             = 800.0f;
                 m_particle_size_min_max     = glm::vec2(0.05f);
                 m_should_fade_out_with_time = false;
                 m_start_position_min_max    = glm::vec2(0);
@@ -397,6 +344,7 @@ void SimpleParticlesSystem::render_gui()
             {
                 m_acceleration              = glm::vec3(0, 0.1, 0.0);
                 m_particle_lifetime         = 3.0f;
+                m_emission_rate             = 2700.0f;
                 m_particle_size_min_max     = glm::vec2(0.5f);
                 m_should_fade_out_with_time = true;
                 m_start_position_min_max    = glm::vec2(-2, 2);
@@ -415,6 +363,7 @@ void SimpleParticlesSystem::render_gui()
             {
                 m_acceleration              = glm::vec3(0, 0.1, 0.0);
                 m_particle_lifetime         = 10.0f;
+                m_emission_rate             = 800.0f;
                 m_particle_size_min_max     = glm::vec2(0.1f, 2.5f);
                 m_should_fade_out_with_time = false;
                 m_start_position_min_max    = glm::vec2(0, 0);
@@ -467,19 +416,50 @@ void SimpleParticlesSystem::render_gui()
 
 void SimpleParticlesSystem::reset_particles_buffers()
 {
-    std::vector<GLfloat> particle_ages(m_no_particles);
-    float rate = m_particle_lifetime / m_no_particles;
+    glFinish();
 
-    for (int i = 0; i < m_no_particles; ++i)
+    if (m_particles_capacity != GLuint(m_max_particles))
     {
-        particle_ages[i] = rate * (i - m_no_particles);
+        m_particles_capacity = GLuint(m_max_particles);
+
+        glDeleteBuffers(1, &m_particles_buffer);
+        glDeleteBuffers(1, &m_dead_list_buffer);
+        glDeleteBuffers(2, m_alive_list_buffers);
+
+        /* A count followed by the indices for each list, see particles.glh. */
+        const GLsizeiptr list_size = sizeof(uint32_t) * (1 + m_particles_capacity);
+
+        glCreateBuffers(1, &m_particles_buffer);
+        glNamedBufferStorage(m_particles_buffer, sizeof(glm::vec4) * 2 * m_particles_capacity, nullptr, 0);
+
+        glCreateBuffers(1, &m_dead_list_buffer);
+        glNamedBufferStorage(m_dead_list_buffer, list_size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+        glCreateBuffers(2, m_alive_list_buffers);
+        glNamedBufferStorage(m_alive_list_buffers[0], list_size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+        glNamedBufferStorage(m_alive_list_buffers[1], list_size, nullptr, GL_DYNAMIC_STORAGE_BIT);
     }
 
-    auto rng = std::default_random_engine{};
-    std::shuffle(particle_ages.begin(), particle_ages.end(), rng);
+    /* All the particles are free, popped from the end of the dead list. */
+    std::vector<uint32_t> dead_list(1 + m_particles_capacity);
+    dead_list[0] = m_particles_capacity;
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_age_vbo_ids[0]);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, m_no_particles * sizeof(float), particle_ages.data());
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    m_draw_buffer_idx = 1;
+    for (uint32_t i = 0; i < m_particles_capacity; ++i)
+    {
+        dead_list[1 + i] = m_particles_capacity - 1 - i;
+    }
+
+    const uint32_t zero = 0;
+
+    glNamedBufferSubData(m_dead_list_buffer,      0, dead_list.size() * sizeof(uint32_t), dead_list.data());
+    glNamedBufferSubData(m_alive_list_buffers[0], 0, sizeof(uint32_t), &zero);
+    glNamedBufferSubData(m_alive_list_buffers[1], 0, sizeof(uint32_t), &zero);
+
+    m_alive_list_idx     = 0;
+    m_emission_remainder = 0.0f;
 }
+
+void SimpleParticlesSystem::read_alive_particles_count()
+{
+    m_alive_count_readback.Update();
+}
\ No newline at end of file
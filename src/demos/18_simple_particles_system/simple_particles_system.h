@@ -1,5 +1,6 @@
 #pragma once
 #include "core_app.h"
+#include "async_readback.h"
 
 #include "camera.h"
 #include "static_model.h"
@@ -44,22 +45,35 @@ private:
         return basis;
     }
 
+    /* Frees all the particles, recreating the buffers if the capacity changed. */
     void reset_particles_buffers();
 
+    /* The live particles' count of a past frame, read when its copy is done so the frame never waits. */
+    void read_alive_particles_count();
+
     std::shared_ptr<RGL::Camera> m_camera;
     std::shared_ptr<RGL::Shader> m_simple_shader, m_particles_shader;
+    std::shared_ptr<RGL::Shader> m_prepare_shader, m_emit_shader, m_simulate_shader, m_draw_args_shader;
     std::shared_ptr<RGL::StaticModel> m_grid_model;
 
     RGL::Texture2D m_particle_texture;
 
-    GLuint m_tfo_ids[2]; // Transform Feedback Objects
-    GLuint m_pos_vbo_ids[2];
-    GLuint m_velocity_vbo_ids[2];
-    GLuint m_age_vbo_ids[2];
-    GLuint m_vao_ids[2];
-    GLuint m_random_texture_1d;
-    GLuint m_draw_buffer_idx;
-    
+    /*
+     * The particles live on the GPU: the free ones in a dead list (a stack of indices), the live ones in an alive list.
+     * Every frame emits up to the free particles' count, simulates and compacts the live ones into the other alive list,
+     * and draws them with indirect arguments written by the kernels - the cost follows the live particles, not the capacity.
+     */
+    GLuint m_particles_buffer;
+    GLuint m_dead_list_buffer;
+    GLuint m_alive_list_buffers[2];
+    GLuint m_indirect_args_buffer;
+    GLuint m_empty_vao_id;
+    GLuint m_alive_list_idx;     /* The list simulated this frame, the other one gets the survivors. */
+    GLuint m_particles_capacity; /* Of the buffers, m_max_particles applies on reset. */
+
+    RGL::AsyncReadback m_alive_count_readback;
+    uint32_t           m_alive_particles_count;
+
     glm::vec3 m_acceleration;
     glm::vec3 m_direction_constraints;
     glm::vec3 m_emitter_pos, m_emitter_dir;
@@ -70,7 +84,10 @@ private:
     float m_delta_time;
     float m_particle_angle;
     float m_particle_lifetime;
-    int m_no_particles;
+    float m_emission_rate;       /* Particles per second. */
+    float m_emission_remainder;  /* The fraction of a particle left over from the past frames. */
+    uint32_t m_frame;
+    int m_max_particles;
     bool m_should_fade_out_with_time;
 
     ImGui::FileBrowser m_file_dialog;
@@ -1,12 +1,19 @@
 #include "instanced_particles_cs.h"
 
 #include "filesystem.h"
+#include "frustum.h"
 #include "input.h"
+#include "profiler.h"
 #include "util.h"
+#include "particles_sort.h"
 
+#include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/random.hpp>
 
+#include <cstring>
+#include <limits>
+
 InstancedParticlesCS::InstancedParticlesCS()
     : m_emitter_pos                       (0.0,  0.0, 0.0),
       m_emitter_dir                       (0.0,  1.0, 0.0),
@@ -18,7 +25,37 @@ InstancedParticlesCS::InstancedParticlesCS()
       m_start_rotational_velocity_min_max (-15, 15),
       m_direction_constraints             (1, 1, 1),
       m_cone_angle                        (glm::degrees(glm::pi<float>() / 8.0f)),
-      m_total_particles                   (64 * 1000),
+      m_total_particles                   (0),
+      m_requested_particles               (64 * 1000),
+      m_bitonic_keys_count                (0),
+      m_is_sorting_enabled                (true),
+      m_sort_method                       (SortMethod::AUTO),
+      m_particles_opacity                 (1.0f),
+      m_emitter_params_id                 (0),
+      m_simulate_groups_id                (0),
+      m_requested_emitters                (1),
+      m_emitters_spacing                  (6.0f),
+      m_is_emitter_culling_enabled        (true),
+      m_is_simulation_lod_enabled         (true),
+      m_lod_distance                      (15.0f),
+      m_visible_emitters_count            (0),
+      m_updated_emitters_count            (0),
+      m_simulate_groups_count             (0),
+      m_frame                             (0),
+      m_collision_params                  {},
+      m_sdf_texture_id                    (0),
+      m_sdf_min                           (0.0f),
+      m_sdf_size                          (1.0f),
+      m_scene_depth_fbo_id                (0),
+      m_scene_depth_texture_id            (0),
+      m_scene_depth_size                  (0),
+      m_prev_view_projection              (1.0f),
+      m_prev_cam_pos                      (0.0f),
+      m_is_depth_collision_enabled        (true),
+      m_is_sdf_collision_enabled          (true),
+      m_depth_thickness                   (0.5f),
+      m_particle_radius                   (0.07f),
+      m_restitution                       (0.4f),
       m_particles_color                   (1, 0.474, 0.058)
 {
 }
@@ -29,6 +66,14 @@ InstancedParticlesCS::~InstancedParticlesCS()
     glDeleteBuffers(1, &m_velocity_vbo_id);
     glDeleteBuffers(1, &m_age_vbo_id);
     glDeleteBuffers(1, &m_rotation_vbo_id);
+    glDeleteBuffers(2, m_sort_keys_ids);
+    glDeleteBuffers(2, m_sort_values_ids);
+    glDeleteBuffers(1, &m_sort_histogram_id);
+    glDeleteBuffers(1, &m_emitter_params_id);
+    glDeleteBuffers(1, &m_simulate_groups_id);
+    glDeleteTextures(1, &m_sdf_texture_id);
+    glDeleteTextures(1, &m_scene_depth_texture_id);
+    glDeleteFramebuffers(1, &m_scene_depth_fbo_id);
 }
 
 void InstancedParticlesCS::init_app()
@@ -38,10 +83,9 @@ void InstancedParticlesCS::init_app()
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_MULTISAMPLE);
 
-    std::cout << "Number of particles: " << m_total_particles << std::endl;
-
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(4.0, 1.5, -4.0);
     m_camera->setOrientation(5.0f, 225.0f, 0.0f);
     m_camera->update(0.0);
@@ -62,60 +106,66 @@ void InstancedParticlesCS::init_app()
     m_particles_compute_shader = std::make_shared<RGL::Shader>(dir + "particles.comp");
     m_particles_compute_shader->link();
 
-    /* Generate initial data for the particles */
-    std::vector<glm::vec4> initial_positions (m_total_particles, glm::vec4(0.0, 0.0, 0.0, 1.0));
-    std::vector<glm::vec4> initial_velocities(m_total_particles, glm::vec4(0.0f));
-    std::vector<float>     initial_ages      (m_total_particles);
-    std::vector<glm::vec2> initial_rotations (m_total_particles, glm::vec2(0.0));
+    m_collision_params_ubo.Create(COLLISION_PARAMS_UBO_BINDING_INDEX);
+    m_collision_params_ubo.AttachTo(*m_particles_compute_shader, "CollisionParamsUBO",
+                                    { RGL_UNIFORM_BLOCK_MEMBER(CollisionParams, "collision.", prev_view_projection),
+                                      RGL_UNIFORM_BLOCK_MEMBER(CollisionParams, "collision.", inv_prev_view_projection),
+                                      RGL_UNIFORM_BLOCK_MEMBER(CollisionParams, "collision.", prev_cam_pos_depth_thickness),
+                                      RGL_UNIFORM_BLOCK_MEMBER(CollisionParams, "collision.", sdf_min_particle_radius),
+                                      RGL_UNIFORM_BLOCK_MEMBER(CollisionParams, "collision.", sdf_size_restitution),
+                                      RGL_UNIFORM_BLOCK_MEMBER(CollisionParams, "collision.", is_depth_collision_enabled),
+                                      RGL_UNIFORM_BLOCK_MEMBER(CollisionParams, "collision.", is_sdf_collision_enabled) });
+    m_collision_params_ubo.Update(m_collision_params);
 
-    /* Fill the first age buffer */
-    double rate = m_particle_lifetime / m_total_particles;
+    m_sort_keys_shader = std::make_shared<RGL::Shader>(dir + "particles_sort_keys.comp");
+    m_sort_keys_shader->link();
 
-    for (uint64_t i = 0; i < m_total_particles; ++i)
-    {
-        initial_ages[i] = rate * int64_t(i - m_total_particles);
-    }
+    m_bitonic_sort_local_shader = std::make_shared<RGL::Shader>(dir + "particles_bitonic_sort_local.comp");
+    m_bitonic_sort_local_shader->link();
 
-    auto rng = std::default_random_engine{};
-    std::shuffle(initial_ages.begin(), initial_ages.end(), rng);
+    m_bitonic_sort_global_shader = std::make_shared<RGL::Shader>(dir + "particles_bitonic_sort_global.comp");
+    m_bitonic_sort_global_shader->link();
+
+    m_radix_sort_histogram_shader = std::make_shared<RGL::Shader>(dir + "particles_radix_sort_histogram.comp");
+    m_radix_sort_histogram_shader->link();
+
+    m_radix_sort_scan_shader = std::make_shared<RGL::Shader>(dir + "particles_radix_sort_scan.comp");
+    m_radix_sort_scan_shader->link();
+
+    m_radix_sort_scatter_shader = std::make_shared<RGL::Shader>(dir + "particles_radix_sort_scatter.comp");
+    m_radix_sort_scatter_shader->link();
+
+    m_sdf_bake_shader = std::make_shared<RGL::Shader>(dir + "particles_sdf_bake.comp");
+    m_sdf_bake_shader->link();
+
+    create_colliders();
+    bake_colliders_sdf();
 
-    /* Create and allocate all the buffers for the particle system */
-    glGenBuffers(1, &m_pos_vbo_id);
-    glGenBuffers(1, &m_velocity_vbo_id);
-    glGenBuffers(1, &m_age_vbo_id);
-    glGenBuffers(1, &m_rotation_vbo_id);
+    glCreateFramebuffers(1, &m_scene_depth_fbo_id);
+    glNamedFramebufferDrawBuffer(m_scene_depth_fbo_id, GL_NONE);
+    glNamedFramebufferReadBuffer(m_scene_depth_fbo_id, GL_NONE);
+
+    /* Create all the buffers for the particle system, the vertex shader fetches the particles from the SSBOs. */
+    glCreateBuffers(1, &m_pos_vbo_id);
+    glCreateBuffers(1, &m_velocity_vbo_id);
+    glCreateBuffers(1, &m_age_vbo_id);
+    glCreateBuffers(1, &m_rotation_vbo_id);
+    glCreateBuffers(2, m_sort_keys_ids);
+    glCreateBuffers(2, m_sort_values_ids);
+    glCreateBuffers(1, &m_sort_histogram_id);
+    glCreateBuffers(1, &m_emitter_params_id);
+    glCreateBuffers(1, &m_simulate_groups_id);
 
     /* Set up SSBOs */
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_pos_vbo_id);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, initial_positions.size() * sizeof(initial_positions[0]), initial_positions.data(), GL_DYNAMIC_DRAW);
-
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_velocity_vbo_id);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, initial_velocities.size() * sizeof(initial_velocities[0]), initial_velocities.data(), GL_DYNAMIC_COPY);
-
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_age_vbo_id);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, initial_ages.size() * sizeof(initial_ages[0]), initial_ages.data(), GL_DYNAMIC_COPY);
-
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_rotation_vbo_id);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, initial_rotations.size() * sizeof(initial_rotations[0]), initial_rotations.data(), GL_DYNAMIC_DRAW);
-
-    /* Add new VBOs to mesh's VAO */
-    m_instanced_model.AddAttributeBuffer(4 /* attrib index */, 
-                                         4 /* binding index */, 
-                                         4 /* format size */, 
-                                         GL_FLOAT /* data type */, 
-                                         m_pos_vbo_id /* buffer id */, 
-                                         sizeof(glm::vec4) /* stride */,
-                                         1 /* divisor */);
-
-    m_instanced_model.AddAttributeBuffer(5 /* attrib index */, 
-                                         5 /* binding index */, 
-                                         2 /* format size */, 
-                                         GL_FLOAT /* data type */, 
-                                         m_rotation_vbo_id /* buffer id */, 
-                                         sizeof(glm::vec2) /* stride */,
-                                         1 /* divisor */);
-
-    glBindVertexArray(0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0,                                 m_pos_vbo_id);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1,                                 m_velocity_vbo_id);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2,                                 m_age_vbo_id);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3,                                 m_rotation_vbo_id);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SORT_HISTOGRAM_SSBO_BINDING_INDEX, m_sort_histogram_id);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9,                                 m_emitter_params_id);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10,                                m_simulate_groups_id);
+
+    reset_particles_buffers();
 }
 
 void InstancedParticlesCS::input()
@@ -170,41 +220,435 @@ void InstancedParticlesCS::update(double delta_time)
 void InstancedParticlesCS::render()
 {
     /* Execute the compute shader */
-    m_particles_compute_shader->bind();
-    m_particles_compute_shader->setUniform("u_particle_lifetime",                 m_particle_lifetime);
-    m_particles_compute_shader->setUniform("u_emitter_world_pos",                 m_emitter_pos);
-    m_particles_compute_shader->setUniform("u_emitter_basis",                     make_arbitrary_basis(m_emitter_dir));
-    m_particles_compute_shader->setUniform("u_delta_t",                           m_delta_time);
-    m_particles_compute_shader->setUniform("u_acceleration",                      m_acceleration);
-    m_particles_compute_shader->setUniform("u_start_position_min_max",            m_start_position_min_max);
-    m_particles_compute_shader->setUniform("u_start_velocity_min_max",            m_start_velocity_min_max);
-    m_particles_compute_shader->setUniform("u_start_rotational_velocity_min_max", m_start_rotational_velocity_min_max); 
-    m_particles_compute_shader->setUniform("u_direction_constraints",             m_direction_constraints);
-    m_particles_compute_shader->setUniform("u_cone_angle",                        glm::radians(m_cone_angle));
-    m_particles_compute_shader->setUniform("u_random",                            RGL::Util::RandomVec3(0, 1));
-
-    glDispatchCompute(::ceilf((float)m_total_particles / 1024.0f), 1, 1);
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    {
+        RGL::ProfilerScope scope("Simulate");
+
+        /* All the emitters due this frame in a single dispatch. */
+        m_simulate_groups_count = schedule_emitters();
+
+        if (m_simulate_groups_count > 0)
+        {
+            /* The scene depth is the previous frame's, with the previous frame's camera. */
+            CollisionParams params {};
+            params.prev_view_projection         = m_prev_view_projection;
+            params.inv_prev_view_projection     = glm::inverse(m_prev_view_projection);
+            params.prev_cam_pos_depth_thickness = glm::vec4(m_prev_cam_pos, m_depth_thickness);
+            params.sdf_min_particle_radius      = glm::vec4(m_sdf_min,      m_particle_radius);
+            params.sdf_size_restitution         = glm::vec4(m_sdf_size,     m_restitution);
+            params.is_depth_collision_enabled   = m_is_depth_collision_enabled && m_scene_depth_texture_id != 0;
+            params.is_sdf_collision_enabled     = m_is_sdf_collision_enabled;
+
+            if (std::memcmp(&params, &m_collision_params, sizeof(CollisionParams)) != 0)
+            {
+                m_collision_params = params;
+                m_collision_params_ubo.Update(m_collision_params);
+            }
+
+            m_particles_compute_shader->bind();
+
+            glBindTextureUnit(SCENE_DEPTH_TEXTURE_BINDING_INDEX, m_scene_depth_texture_id);
+            glBindTextureUnit(SDF_TEXTURE_BINDING_INDEX,         m_sdf_texture_id);
+
+            glDispatchCompute(m_simulate_groups_count, 1, 1);
+        }
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    if (m_is_sorting_enabled)
+    {
+        RGL::ProfilerScope scope("Sort");
+        sort_particles();
+    }
 
     /* Draw the scene */
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     /* Draw the grid */
     m_simple_shader->bind();
-    m_simple_shader->setUniform("mvp", m_camera->m_projection * m_camera->m_view);
+    m_simple_shader->setUniform("mvp", m_camera->viewProjection());
     m_simple_shader->setUniform("color", glm::vec3(0.4));
     m_simple_shader->setUniform("mix_factor", 1.0f);
 
     m_grid_model.Render();
 
+    for (const auto& collider : m_colliders)
+    {
+        m_simple_shader->setUniform("mvp",   m_camera->viewProjection() * collider.transform);
+        m_simple_shader->setUniform("color", collider.color);
+        collider.model->Render();
+    }
+
     m_simple_shader->setUniform("color", m_particles_color);
 
-    /* Draw the particles */
-    m_particles_render_shader->bind();
-    m_particles_render_shader->setUniform("u_mvp",        m_camera->m_projection * m_camera->m_view);
-    m_particles_render_shader->setUniform("u_model_view", m_camera->m_view);
-    m_particles_render_shader->setUniform("u_diffuse",    m_particles_color);
-    m_instanced_model.Render(m_total_particles);
+    /* Draw the particles, the translucent ones over the scene without writing the depth. */
+    {
+        RGL::ProfilerScope scope("Draw particles");
+
+        const bool is_translucent = m_particles_opacity < 1.0f;
+
+        if (is_translucent)
+        {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glDepthMask(GL_FALSE);
+        }
+
+        m_particles_render_shader->bind();
+        m_particles_render_shader->setUniform("u_mvp",        m_camera->viewProjection());
+        m_particles_render_shader->setUniform("u_model_view", m_camera->m_view);
+        m_particles_render_shader->setUniform("u_diffuse",    m_particles_color);
+        m_particles_render_shader->setUniform("u_opacity",    m_particles_opacity);
+        m_particles_render_shader->setUniform("u_is_sorted",  int(m_is_sorting_enabled));
+        m_instanced_model.Render(m_total_particles);
+
+        if (is_translucent)
+        {
+            glDepthMask(GL_TRUE);
+            glDisable(GL_BLEND);
+        }
+    }
+
+    if (m_is_depth_collision_enabled)
+    {
+        render_scene_depth();
+    }
+}
+
+void InstancedParticlesCS::render_scene_depth()
+{
+    const glm::ivec2 size = glm::ivec2(RGL::Window::getWidth(), RGL::Window::getHeight());
+
+    if (size != m_scene_depth_size)
+    {
+        m_scene_depth_size = size;
+
+        glDeleteTextures(1, &m_scene_depth_texture_id);
+        glCreateTextures(GL_TEXTURE_2D, 1, &m_scene_depth_texture_id);
+        glTextureStorage2D(m_scene_depth_texture_id, 1, GL_DEPTH_COMPONENT32F, size.x, size.y);
+        glTextureParameteri(m_scene_depth_texture_id, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(m_scene_depth_texture_id, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTextureParameteri(m_scene_depth_texture_id, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+        glTextureParameteri(m_scene_depth_texture_id, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+
+        glNamedFramebufferTexture(m_scene_depth_fbo_id, GL_DEPTH_ATTACHMENT, m_scene_depth_texture_id, 0);
+    }
+
+    /* 
+     * A depth-only pass of the static scene - the particles mustn't collide with themselves, and the default framebuffer
+     * is multisampled, so its depth can't be sampled.
+     */
+    RGL::ProfilerScope scope("Scene depth");
+
+    const glm::mat4 view_projection = m_camera->viewProjection();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_scene_depth_fbo_id);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    m_simple_shader->bind();
+    m_simple_shader->setUniform("mvp", view_projection);
+    m_grid_model.Render();
+
+    for (const auto& collider : m_colliders)
+    {
+        m_simple_shader->setUniform("mvp", view_projection * collider.transform);
+        collider.model->Render();
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    m_prev_view_projection = view_projection;
+    m_prev_cam_pos         = m_camera->position();
+}
+
+void InstancedParticlesCS::create_colliders()
+{
+    /* The SDF bake fetches the positions, the interleaved formats start every vertex with them. */
+    m_collider_sphere_model.SetVertexFormat(RGL::StaticModel::VertexFormat::INTERLEAVED);
+    m_collider_sphere_model.GenSphere(0.75f, 32);
+
+    m_collider_cube_model.SetVertexFormat(RGL::StaticModel::VertexFormat::INTERLEAVED);
+    m_collider_cube_model.GenCube(0.5f);
+
+    m_colliders = {
+        { &m_collider_sphere_model, glm::translate(glm::mat4(1.0f), glm::vec3( 1.5f, 0.75f,  0.0f)),                                                   glm::vec3(0.55f, 0.6f, 0.7f) },
+        { &m_collider_cube_model,   glm::translate(glm::mat4(1.0f), glm::vec3(-1.5f, 0.5f,   1.0f)),                                                   glm::vec3(0.7f, 0.6f, 0.55f) },
+        { &m_collider_cube_model,   glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.35f, -1.75f)), glm::radians(30.0f), glm::vec3(1, 1, 0)), glm::vec3(0.6f, 0.7f, 0.55f) }
+    };
+}
+
+void InstancedParticlesCS::bake_colliders_sdf()
+{
+    /* The colliders' bounding spheres, with a margin for the particles and the gradient at the border. */
+    glm::vec3 bounds_min(std::numeric_limits<float>::max());
+    glm::vec3 bounds_max(std::numeric_limits<float>::lowest());
+
+    for (const auto& collider : m_colliders)
+    {
+        const glm::vec4 sphere = collider.model->GetMeshPartBounds(0);
+        const glm::vec3 center = glm::vec3(collider.transform * glm::vec4(glm::vec3(sphere), 1.0f));
+        const float     scale  = glm::max(glm::length(glm::vec3(collider.transform[0])), 
+                                 glm::max(glm::length(glm::vec3(collider.transform[1])), glm::length(glm::vec3(collider.transform[2]))));
+
+        bounds_min = glm::min(bounds_min, center - sphere.w * scale);
+        bounds_max = glm::max(bounds_max, center + sphere.w * scale);
+    }
+
+    const glm::vec3 margin = glm::vec3(0.25f) + (bounds_max - bounds_min) * (2.0f / SDF_RESOLUTION);
+
+    m_sdf_min  = bounds_min - margin;
+    m_sdf_size = bounds_max + margin - m_sdf_min;
+
+    glCreateTextures(GL_TEXTURE_3D, 1, &m_sdf_texture_id);
+    glTextureStorage3D(m_sdf_texture_id, 1, GL_R16F, SDF_RESOLUTION, SDF_RESOLUTION, SDF_RESOLUTION);
+    glTextureParameteri(m_sdf_texture_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(m_sdf_texture_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(m_sdf_texture_id, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+    glTextureParameteri(m_sdf_texture_id, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+    glTextureParameteri(m_sdf_texture_id, GL_TEXTURE_WRAP_R,     GL_CLAMP_TO_EDGE);
+
+    glBindImageTexture(SDF_IMAGE_UNIT, m_sdf_texture_id, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R16F);
+
+    m_sdf_bake_shader->bind();
+    m_sdf_bake_shader->setUniform("u_sdf_min",    m_sdf_min);
+    m_sdf_bake_shader->setUniform("u_voxel_size", m_sdf_size / float(SDF_RESOLUTION));
+
+    for (size_t i = 0; i < m_colliders.size(); ++i)
+    {
+        const auto& collider = m_colliders[i];
+
+        GLint vertex_stride = 0;
+        GLint indices_size  = 0;
+        glGetVertexArrayIndexediv(collider.model->GetVertexArray(), 0, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &vertex_stride);
+        glGetNamedBufferParameteriv(collider.model->GetIndexBuffer(), GL_BUFFER_SIZE, &indices_size);
+
+        m_sdf_bake_shader->setUniform("u_model",             collider.transform);
+        m_sdf_bake_shader->setUniform("u_vertex_stride",     GLuint(vertex_stride) / GLuint(sizeof(float)));
+        m_sdf_bake_shader->setUniform("u_triangles_count",   GLuint(indices_size) / GLuint(sizeof(uint32_t)) / 3);
+        m_sdf_bake_shader->setUniform("u_is_first_collider", int(i == 0));
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SDF_VERTICES_SSBO_BINDING_INDEX, collider.model->GetVertexBuffer());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SDF_INDICES_SSBO_BINDING_INDEX,  collider.model->GetIndexBuffer());
+
+        const GLuint groups_count = SDF_RESOLUTION / SDF_BAKE_GROUP_SIZE;
+        glDispatchCompute(groups_count, groups_count, groups_count);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+}
+
+float InstancedParticlesCS::get_emitter_radius() const
+{
+    const float max_speed  = glm::max(glm::abs(m_start_velocity_min_max.x), glm::abs(m_start_velocity_min_max.y));
+    const float max_offset = glm::max(glm::abs(m_start_position_min_max.x), glm::abs(m_start_position_min_max.y));
+
+    /* The distance a particle travels at most, plus the particle's mesh. */
+    return max_offset + max_speed * m_particle_lifetime + 0.5f * glm::length(m_acceleration) * m_particle_lifetime * m_particle_lifetime + 0.1f;
+}
+
+GLuint InstancedParticlesCS::schedule_emitters()
+{
+    const RGL::Frustum& frustum = m_camera->frustum();
+
+    const float     radius    = get_emitter_radius();
+    const glm::mat3 basis     = make_arbitrary_basis(m_emitter_dir);
+    const float     max_delta = glm::max(m_particle_lifetime, m_delta_time);
+
+    m_emitter_params.clear();
+    m_simulate_groups.clear();
+    m_visible_emitters_count = 0;
+
+    for (auto& emitter : m_emitters)
+    {
+        /* The skipped frames' time goes to the next update, at most a lifetime - the particles would recycle by then anyway. */
+        emitter.accumulated_time = glm::min(emitter.accumulated_time + m_delta_time, max_delta);
+
+        const bool is_visible = !m_is_emitter_culling_enabled || frustum.IsSphereVisible(emitter.position, radius);
+
+        m_visible_emitters_count += is_visible;
+
+        uint32_t update_interval = 1;
+
+        if (m_is_simulation_lod_enabled)
+        {
+            if (!is_visible)
+            {
+                update_interval = MAX_UPDATE_INTERVAL;
+            }
+            else
+            {
+                /* Every doubling of the distance past m_lod_distance doubles the interval. */
+                const float distance = glm::max(glm::distance(m_camera->position(), emitter.position) - radius, 0.0f);
+
+                while (update_interval < MAX_UPDATE_INTERVAL && distance > m_lod_distance * float(update_interval))
+                {
+                    update_interval <<= 1;
+                }
+            }
+        }
+        else if (!is_visible)
+        {
+            /* Culled without the LOD - only the time accumulates until the emitter is visible again. */
+            update_interval = 0;
+        }
+
+        if (update_interval == 0 || (emitter.frames_to_update > 0 && --emitter.frames_to_update > 0))
+        {
+            continue;
+        }
+
+        emitter.frames_to_update = update_interval;
+
+        EmitterParams params {};
+        params.basis[0]                          = glm::vec4(basis[0], 0.0f);
+        params.basis[1]                          = glm::vec4(basis[1], 0.0f);
+        params.basis[2]                          = glm::vec4(basis[2], 0.0f);
+        params.position_lifetime                 = glm::vec4(emitter.position, m_particle_lifetime);
+        params.acceleration_delta_t              = glm::vec4(m_acceleration, emitter.accumulated_time);
+        params.direction_constraints_cone_angle  = glm::vec4(m_direction_constraints, glm::radians(m_cone_angle));
+        params.start_position_min_max            = m_start_position_min_max;
+        params.start_velocity_min_max            = m_start_velocity_min_max;
+        params.start_rotational_velocity_min_max = m_start_rotational_velocity_min_max;
+        params.first_particle                    = emitter.first_particle;
+        params.particles_count                   = emitter.particles_count;
+        params.seed                              = m_frame;
+
+        const GLuint emitter_idx = GLuint(m_emitter_params.size());
+        m_emitter_params.push_back(params);
+
+        for (GLuint first = 0; first < emitter.particles_count; first += SIMULATE_GROUP_SIZE)
+        {
+            m_simulate_groups.emplace_back(emitter_idx, first);
+        }
+
+        emitter.accumulated_time = 0.0f;
+    }
+
+    m_updated_emitters_count = uint32_t(m_emitter_params.size());
+    ++m_frame;
+
+    if (m_simulate_groups.empty())
+    {
+        return 0;
+    }
+
+    glNamedBufferData(m_emitter_params_id,  m_emitter_params .size() * sizeof(EmitterParams), m_emitter_params .data(), GL_STREAM_DRAW);
+    glNamedBufferData(m_simulate_groups_id, m_simulate_groups.size() * sizeof(glm::uvec2),    m_simulate_groups.data(), GL_STREAM_DRAW);
+
+    return GLuint(m_simulate_groups.size());
+}
+
+void InstancedParticlesCS::create_emitters()
+{
+    const uint32_t emitters_count = uint32_t(glm::clamp(m_requested_emitters, 1, int(m_total_particles)));
+    const uint32_t side           = uint32_t(glm::ceil(glm::sqrt(float(emitters_count))));
+
+    m_emitters.resize(emitters_count);
+
+    /* A grid around m_emitter_pos, the particles split evenly. */
+    for (uint32_t i = 0; i < emitters_count; ++i)
+    {
+        const glm::vec2 cell = glm::vec2(i % side, i / side) - float(side - 1) * 0.5f;
+
+        auto& emitter = m_emitters[i];
+        emitter.position         = m_emitter_pos + glm::vec3(cell.x, 0.0f, cell.y) * m_emitters_spacing;
+        emitter.first_particle   = uint32_t(uint64_t(m_total_particles) * i / emitters_count);
+        emitter.particles_count  = uint32_t(uint64_t(m_total_particles) * (i + 1) / emitters_count) - emitter.first_particle;
+        emitter.accumulated_time = 0.0f;
+        emitter.frames_to_update = i % MAX_UPDATE_INTERVAL; /* Spreads the distant emitters' updates over the frames. */
+    }
+}
+
+void InstancedParticlesCS::sort_particles()
+{
+    const bool is_bitonic = m_sort_method == SortMethod::BITONIC ||
+                           (m_sort_method == SortMethod::AUTO && m_total_particles <= BITONIC_SORT_MAX_KEYS);
+
+    const GLuint keys_count = is_bitonic ? m_bitonic_keys_count : m_total_particles;
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SORT_KEYS_IN_SSBO_BINDING_INDEX,   m_sort_keys_ids  [0]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SORT_VALUES_IN_SSBO_BINDING_INDEX, m_sort_values_ids[0]);
+
+    {
+        RGL::ProfilerScope scope("Keys");
+
+        m_sort_keys_shader->bind();
+        m_sort_keys_shader->setUniform("u_view",            m_camera->m_view);
+        m_sort_keys_shader->setUniform("u_particles_count", m_total_particles);
+        m_sort_keys_shader->setUniform("u_keys_count",      keys_count);
+
+        glDispatchCompute((keys_count + 255) / 256, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    if (is_bitonic)
+    {
+        RGL::ProfilerScope scope("Bitonic");
+
+        const GLuint blocks_count = keys_count / BITONIC_SORT_BLOCK_SIZE;
+
+        /* Sort the blocks in the shared memory. */
+        m_bitonic_sort_local_shader->bind();
+        m_bitonic_sort_local_shader->setUniform("u_k", GLuint(0));
+        glDispatchCompute(blocks_count, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        /* Merge them, the steps between the blocks in the global memory, the rest of every merge in the shared one. */
+        for (GLuint k = 2 * BITONIC_SORT_BLOCK_SIZE; k <= keys_count; k <<= 1)
+        {
+            m_bitonic_sort_global_shader->bind();
+            m_bitonic_sort_global_shader->setUniform("u_k", k);
+
+            for (GLuint j = k / 2; j >= BITONIC_SORT_BLOCK_SIZE; j >>= 1)
+            {
+                m_bitonic_sort_global_shader->setUniform("u_j", j);
+                glDispatchCompute(keys_count / 2 / 256, 1, 1);
+                glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            }
+
+            m_bitonic_sort_local_shader->bind();
+            m_bitonic_sort_local_shader->setUniform("u_k", k);
+            glDispatchCompute(blocks_count, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+    }
+    else
+    {
+        RGL::ProfilerScope scope("Radix");
+
+        const GLuint blocks_count = (keys_count + RADIX_SORT_BLOCK_SIZE - 1) / RADIX_SORT_BLOCK_SIZE;
+
+        /* The LSD radix sort, a digit per pass, from and to the halves of the ping-pong - the even count of the passes ends in [0]. */
+        for (GLuint pass = 0; pass < RADIX_SORT_PASSES_COUNT; ++pass)
+        {
+            const GLuint src   = pass & 1;
+            const GLuint dst   = 1 - src;
+            const GLuint shift = pass * RADIX_SORT_DIGIT_BITS;
+
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SORT_KEYS_IN_SSBO_BINDING_INDEX,    m_sort_keys_ids  [src]);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SORT_VALUES_IN_SSBO_BINDING_INDEX,  m_sort_values_ids[src]);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SORT_KEYS_OUT_SSBO_BINDING_INDEX,   m_sort_keys_ids  [dst]);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SORT_VALUES_OUT_SSBO_BINDING_INDEX, m_sort_values_ids[dst]);
+
+            m_radix_sort_histogram_shader->bind();
+            m_radix_sort_histogram_shader->setUniform("u_keys_count", keys_count);
+            m_radix_sort_histogram_shader->setUniform("u_shift",      shift);
+            glDispatchCompute(blocks_count, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            m_radix_sort_scan_shader->bind();
+            m_radix_sort_scan_shader->setUniform("u_histogram_size", blocks_count * RADIX_SORT_BINS_COUNT);
+            glDispatchCompute(1, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            m_radix_sort_scatter_shader->bind();
+            m_radix_sort_scatter_shader->setUniform("u_keys_count", keys_count);
+            m_radix_sort_scatter_shader->setUniform("u_shift",      shift);
+            glDispatchCompute(blocks_count, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SORT_KEYS_IN_SSBO_BINDING_INDEX,   m_sort_keys_ids  [0]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SORT_VALUES_IN_SSBO_BINDING_INDEX, m_sort_values_ids[0]);
+    }
 }
 
 void InstancedParticlesCS::render_gui()
@@ -240,8 +684,51 @@ void InstancedParticlesCS::render_gui()
 
         ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
         {
-            static std::string label = "Number of particles: " + std::to_string(m_total_particles);
-            ImGui::TextUnformatted(label.c_str());
+            ImGui::Text("Number of particles: %u", m_total_particles);
+            ImGui::SliderInt("Particles (on reset)", &m_requested_particles, 1000, 4 * 1000 * 1000, "%d", ImGuiSliderFlags_Logarithmic);
+            ImGui::SliderInt  ("Emitters (on reset)", &m_requested_emitters, 1, 1024, "%d", ImGuiSliderFlags_Logarithmic);
+            if (ImGui::SliderFloat("Emitters spacing", &m_emitters_spacing, 1.0f, 20.0f, "%.1f"))
+            {
+                create_emitters();
+            }
+
+            ImGui::Checkbox   ("Emitter culling",     &m_is_emitter_culling_enabled);
+            ImGui::Checkbox   ("Simulation LOD",      &m_is_simulation_lod_enabled);
+            ImGui::SliderFloat("LOD distance",        &m_lod_distance,       1.0f, 100.0f, "%.1f");
+            ImGui::Text("Emitters: %zu, visible: %u, updated: %u", m_emitters.size(), m_visible_emitters_count, m_updated_emitters_count);
+            ImGui::Text("Simulated work groups: %u", m_simulate_groups_count);
+            ImGui::Spacing();
+
+            ImGui::Checkbox   ("Depth buffer collisions", &m_is_depth_collision_enabled);
+            ImGui::Checkbox   ("SDF collisions",          &m_is_sdf_collision_enabled);
+            ImGui::SliderFloat("Depth thickness",         &m_depth_thickness, 0.01f, 2.0f, "%.2f");
+            ImGui::SliderFloat("Particle radius",         &m_particle_radius, 0.0f,  0.5f, "%.2f");
+            ImGui::SliderFloat("Restitution",             &m_restitution,     0.0f,  1.0f, "%.2f");
+            ImGui::Spacing();
+
+            ImGui::Checkbox("Sort back to front", &m_is_sorting_enabled);
+
+            const char* sort_methods[] = { "Auto (bitonic up to 64k)", "Bitonic", "Radix" };
+            int sort_method = int(m_sort_method);
+
+            if (ImGui::Combo("Sort method", &sort_method, sort_methods, IM_ARRAYSIZE(sort_methods)))
+            {
+                m_sort_method = SortMethod(sort_method);
+            }
+
+            ImGui::SliderFloat("Particles opacity", &m_particles_opacity, 0.0f, 1.0f, "%.2f");
+
+            for (uint32_t index : RGL::Profiler::GetResolvedScopes())
+            {
+                const auto& scope = RGL::Profiler::GetScope(index);
+
+                if (scope.m_name == "Simulate" || scope.m_name == "Sort"  || scope.m_name == "Keys" ||
+                    scope.m_name == "Bitonic"  || scope.m_name == "Radix" || scope.m_name == "Draw particles" ||
+                    scope.m_name == "Scene depth")
+                {
+                    ImGui::Text("%*s%s: %.3f ms", int(scope.m_depth) * 2, "", scope.m_name.c_str(), scope.m_gpu_ms);
+                }
+            }
             ImGui::Spacing();
 
             static glm::vec2 emitter_dir_angles = { 0.0, 0.0 };
@@ -320,7 +807,15 @@ void InstancedParticlesCS::render_gui()
 
 void InstancedParticlesCS::reset_particles_buffers()
 {
-    std::vector<float> initial_ages(m_total_particles);
+    m_total_particles = GLuint(m_requested_particles);
+
+    /* Generate initial data for the particles */
+    std::vector<glm::vec4> initial_positions (m_total_particles, glm::vec4(0.0, 0.0, 0.0, 1.0));
+    std::vector<glm::vec4> initial_velocities(m_total_particles, glm::vec4(0.0f));
+    std::vector<float>     initial_ages      (m_total_particles);
+    std::vector<glm::vec2> initial_rotations (m_total_particles, glm::vec2(0.0));
+
+    /* Fill the first age buffer */
     double rate = m_particle_lifetime / m_total_particles;
 
     for (uint64_t i = 0; i < m_total_particles; ++i)
@@ -331,6 +826,28 @@ void InstancedParticlesCS::reset_particles_buffers()
     auto rng = std::default_random_engine{};
     std::shuffle(initial_ages.begin(), initial_ages.end(), rng);
 
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_age_vbo_id);
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, initial_ages.size() * sizeof(initial_ages[0]), initial_ages.data());
+    glNamedBufferData(m_pos_vbo_id,      initial_positions.size()  * sizeof(initial_positions[0]),  initial_positions.data(),  GL_DYNAMIC_DRAW);
+    glNamedBufferData(m_velocity_vbo_id, initial_velocities.size() * sizeof(initial_velocities[0]), initial_velocities.data(), GL_DYNAMIC_COPY);
+    glNamedBufferData(m_age_vbo_id,      initial_ages.size()       * sizeof(initial_ages[0]),       initial_ages.data(),       GL_DYNAMIC_COPY);
+    glNamedBufferData(m_rotation_vbo_id, initial_rotations.size()  * sizeof(initial_rotations[0]),  initial_rotations.data(),  GL_DYNAMIC_DRAW);
+
+    /* The sort buffers fit the padded bitonic keys too, the radix sort doesn't pad. */
+    m_bitonic_keys_count = BITONIC_SORT_BLOCK_SIZE;
+
+    while (m_bitonic_keys_count < m_total_particles)
+    {
+        m_bitonic_keys_count <<= 1;
+    }
+
+    const GLuint radix_blocks_count = (m_total_particles + RADIX_SORT_BLOCK_SIZE - 1) / RADIX_SORT_BLOCK_SIZE;
+
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        glNamedBufferData(m_sort_keys_ids  [i], sizeof(uint32_t) * m_bitonic_keys_count, nullptr, GL_DYNAMIC_DRAW);
+        glNamedBufferData(m_sort_values_ids[i], sizeof(uint32_t) * m_bitonic_keys_count, nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    glNamedBufferData(m_sort_histogram_id, sizeof(uint32_t) * radix_blocks_count * RADIX_SORT_BINS_COUNT, nullptr, GL_DYNAMIC_DRAW);
+
+    create_emitters();
 }
@@ -4,9 +4,13 @@
 #include "camera.h"
 #include "static_model.h"
 #include "shader.h"
+#include "uniform_block.h"
 #include "gui/gui.h"
 
+#include "particles_collision.h"
+
 #include <memory>
+#include <vector>
 
 class InstancedParticlesCS : public RGL::CoreApp
 {
@@ -43,17 +47,107 @@ private:
         return basis;
     }
 
+    enum class SortMethod { AUTO, BITONIC, RADIX };
+
+    static constexpr uint32_t SIMULATE_GROUP_SIZE = 1024;  /* In sync with particles.comp. */
+    static constexpr uint32_t MAX_UPDATE_INTERVAL = 8;     /* Frames, of the hidden emitters. */
+
+    /* An emitter's parameters for particles.comp, std430. The emitter owns a contiguous range of the particles. */
+    struct EmitterParams
+    {
+        glm::vec4  basis[3];                           /* Columns of the rotation of the y axis to the emitter's direction. */
+        glm::vec4  position_lifetime;
+        glm::vec4  acceleration_delta_t;               /* w - the time since the emitter's last update. */
+        glm::vec4  direction_constraints_cone_angle;
+        glm::vec2  start_position_min_max;
+        glm::vec2  start_velocity_min_max;
+        glm::vec2  start_rotational_velocity_min_max;
+        GLuint     first_particle;
+        GLuint     particles_count;
+        GLuint     seed;                               /* Of the update, the recycled particles hash it with their index. */
+        GLuint     padding[3];
+    };
+
+    /* A static StaticModel the particles collide with, drawn with the scene and baked into the SDF. */
+    struct Collider
+    {
+        RGL::StaticModel* model;
+        glm::mat4         transform;
+        glm::vec3         color;
+    };
+
+    struct Emitter
+    {
+        glm::vec3 position;
+        GLuint    first_particle;
+        GLuint    particles_count;
+        float     accumulated_time;   /* Since the last update. */
+        uint32_t  frames_to_update;
+    };
+
+    /*
+     * Picks the emitters to update this frame - every frame the near ones, every few frames the distant
+     * and the hidden ones, with the time they skipped - and uploads their parameters and work groups.
+     * Returns the count of the work groups.
+     */
+    GLuint schedule_emitters();
+
+    /* A sphere around everything the emitter's particles can reach within their lifetime. */
+    float get_emitter_radius() const;
+
+    void create_emitters();
+
+    /* Reallocates the buffers for m_requested_particles and m_requested_emitters, and restarts the emission. */
     void reset_particles_buffers();
 
+    /* Sorts the particles' indices back to front, into m_sort_values_ids[0]. */
+    void sort_particles();
+
+    void create_colliders();
+
+    /* Bakes the signed distance to m_colliders into m_sdf_texture_id, once - the colliders are static. */
+    void bake_colliders_sdf();
+
+    /* Draws the depth of the static scene for the next frame's collisions, and keeps the frame's camera for them. */
+    void render_scene_depth();
+
     std::shared_ptr<RGL::Camera> m_camera;
     std::shared_ptr<RGL::Shader> m_simple_shader, m_particles_render_shader, m_particles_compute_shader;
+    std::shared_ptr<RGL::Shader> m_sort_keys_shader;
+    std::shared_ptr<RGL::Shader> m_bitonic_sort_local_shader, m_bitonic_sort_global_shader;
+    std::shared_ptr<RGL::Shader> m_radix_sort_histogram_shader, m_radix_sort_scan_shader, m_radix_sort_scatter_shader;
+    std::shared_ptr<RGL::Shader> m_sdf_bake_shader;
     RGL::StaticModel m_instanced_model, m_grid_model;
+    RGL::StaticModel m_collider_sphere_model, m_collider_cube_model;
 
     GLuint m_pos_vbo_id;
     GLuint m_velocity_vbo_id;
     GLuint m_age_vbo_id;
     GLuint m_rotation_vbo_id;
 
+    /* Ping-pong for the radix sort, the bitonic sort uses the first ones only. */
+    GLuint m_sort_keys_ids[2];
+    GLuint m_sort_values_ids[2];
+    GLuint m_sort_histogram_id;
+
+    /* The parameters of the updated emitters, and per work group the emitter and the group's first particle in it. */
+    GLuint m_emitter_params_id;
+    GLuint m_simulate_groups_id;
+
+    std::vector<Emitter>       m_emitters;
+    std::vector<EmitterParams> m_emitter_params;
+    std::vector<glm::uvec2>    m_simulate_groups;
+
+    int   m_requested_emitters;
+    float m_emitters_spacing;
+    bool  m_is_emitter_culling_enabled;
+    bool  m_is_simulation_lod_enabled;
+    float m_lod_distance;          /* The emitters within it update every frame, every distance doubling halves their rate. */
+    uint32_t m_visible_emitters_count;
+    uint32_t m_updated_emitters_count;
+    GLuint   m_simulate_groups_count;
+    uint32_t m_frame;
+
     glm::vec3 m_emitter_pos, m_emitter_dir;
     glm::vec3 m_acceleration;
     float m_particle_lifetime;
@@ -65,4 +159,36 @@ private:
     glm::vec3 m_particles_color;
     float m_cone_angle;
     GLuint m_total_particles;
+    int m_requested_particles;
+
+    /* The bitonic sort needs a power of two keys, at least a block. */
+    GLuint m_bitonic_keys_count;
+
+    std::vector<Collider> m_colliders;
+
+    /* The last uploaded parameters, the block is updated only when they change. */
+    RGL::UniformBlock<CollisionParams> m_collision_params_ubo;
+    CollisionParams                    m_collision_params;
+
+    /* The SDF covers the colliders' bounds, the particles out of it don't collide with them. */
+    GLuint    m_sdf_texture_id;
+    glm::vec3 m_sdf_min;
+    glm::vec3 m_sdf_size;
+
+    GLuint     m_scene_depth_fbo_id;
+    GLuint     m_scene_depth_texture_id;
+    glm::ivec2 m_scene_depth_size;
+    glm::mat4  m_prev_view_projection;
+    glm::vec3  m_prev_cam_pos;
+
+    bool  m_is_depth_collision_enabled;
+    bool  m_is_sdf_collision_enabled;
+    float m_depth_thickness;
+    float m_particle_radius;
+    float m_restitution;
+
+    /* Sorted back to front, so the particles can be blended. */
+    bool m_is_sorting_enabled;
+    SortMethod m_sort_method;
+    float m_particles_opacity;
 };
\ No newline at end of file
@@ -6,12 +6,13 @@ layout(location = 0) in vec3 v_normal;
 
 const vec3 light_dir = vec3(1, 1, 1);
 
-uniform vec3 u_diffuse;
+uniform vec3  u_diffuse;
+uniform float u_opacity;
 
 void main()
 {
     float d      = dot(normalize(v_normal), normalize(light_dir));
     vec3 diffuse = d * u_diffuse;
 
-    frag_color = vec4(0.18 + diffuse, 1.0);
+    frag_color = vec4(0.18 + diffuse, u_opacity);
 }
\ No newline at end of file
@@ -1,20 +1,40 @@
 #version 460 core
+#include "particles_sort.h"
 
 /* Mesh data */
 layout (location = 0) in vec3 in_position;
 layout (location = 2) in vec3 in_normal;
 
 /* Particle data */
-layout (location = 4) in vec4 in_particle_position;
-layout (location = 5) in vec2 in_particle_rotation;
+layout(std430, binding = 0) readonly buffer Positions
+{
+    vec4 positions[];
+};
+
+layout(std430, binding = 3) readonly buffer Rotations
+{
+    vec2 rotations[];
+};
+
+/* The particles' indices back to front, if sorted. */
+layout(std430, binding = SORT_VALUES_IN_SSBO_BINDING_INDEX) readonly buffer SortedIndices
+{
+    uint sorted_indices[];
+};
 
 layout(location = 0) out vec3 v_normal;
 
 uniform mat4 u_mvp;
 uniform mat4 u_model_view;
+uniform bool u_is_sorted;
 
 void main()
 {
+	uint particle_idx = u_is_sorted ? sorted_indices[gl_InstanceID] : gl_InstanceID;
+
+	vec4 in_particle_position = positions[particle_idx];
+	vec2 in_particle_rotation = rotations[particle_idx];
+
 	float cosine = cos(in_particle_rotation.x);
 	float sine   = sin(in_particle_rotation.x);
 
@@ -0,0 +1,40 @@
+// The collisions of the particles, shared by the C++ code and the shaders. On screen the particles collide with the
+// previous frame's depth of the static scene, off screen and behind the visible surfaces with a signed distance field
+// of the static colliders, baked once by particles_sdf_bake.comp.
+
+#ifdef __cplusplus
+#pragma once
+#define vec4  alignas(16) glm::vec4
+#define mat4  alignas(16) glm::mat4
+#define uint  alignas(4)  uint32_t
+#endif
+
+#define COLLISION_PARAMS_UBO_BINDING_INDEX 0
+
+#define SCENE_DEPTH_TEXTURE_BINDING_INDEX 0
+#define SDF_TEXTURE_BINDING_INDEX         1
+#define SDF_IMAGE_UNIT                    0
+
+#define SDF_VERTICES_SSBO_BINDING_INDEX   11
+#define SDF_INDICES_SSBO_BINDING_INDEX    12
+
+#define SDF_RESOLUTION                    64  // Voxels per side.
+#define SDF_BAKE_GROUP_SIZE               4
+
+// The parameters of particles.comp shared by all the emitters, std140. Uploaded only when they change.
+struct CollisionParams
+{
+    mat4 prev_view_projection;          // Of the frame the scene depth was drawn in.
+    mat4 inv_prev_view_projection;
+    vec4 prev_cam_pos_depth_thickness;  // w - the particles farther behind the depth are hidden by the surface, not in it.
+    vec4 sdf_min_particle_radius;
+    vec4 sdf_size_restitution;
+    uint is_depth_collision_enabled;
+    uint is_sdf_collision_enabled;
+};
+
+#ifdef __cplusplus
+#undef vec4
+#undef mat4
+#undef uint
+#endif
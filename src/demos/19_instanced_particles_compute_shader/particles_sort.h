@@ -0,0 +1,23 @@
+// The depth sort of the particles, shared by the C++ code and the shaders: a key per particle, sorted together with
+// the particle's index.
+// The bitonic sort works in place on the input buffers, the radix sort passes go from the input to the output
+// buffers and the CPU swaps them between the passes. The sorted indices end up in the first values buffer,
+// the vertex shader draws the instances in their order.
+
+#ifdef __cplusplus
+#pragma once
+#endif
+
+#define SORT_KEYS_IN_SSBO_BINDING_INDEX    4
+#define SORT_VALUES_IN_SSBO_BINDING_INDEX  5
+#define SORT_KEYS_OUT_SSBO_BINDING_INDEX   6
+#define SORT_VALUES_OUT_SSBO_BINDING_INDEX 7
+#define SORT_HISTOGRAM_SSBO_BINDING_INDEX  8
+
+#define BITONIC_SORT_BLOCK_SIZE 2048 // Keys sorted by a work group in the shared memory, two per thread.
+#define BITONIC_SORT_MAX_KEYS   65536
+
+#define RADIX_SORT_BLOCK_SIZE   256
+#define RADIX_SORT_DIGIT_BITS   4
+#define RADIX_SORT_BINS_COUNT   16
+#define RADIX_SORT_PASSES_COUNT 8   // An even count, the sorted keys end in the first buffers.
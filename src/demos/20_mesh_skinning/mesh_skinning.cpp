@@ -29,6 +29,7 @@ void MeshSkinning::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(-1.0, 0.5, 1.0);
     m_camera->setOrientation(10.0, 45.0, 0.0);
 
@@ -38,11 +39,16 @@ void MeshSkinning::init_app()
     m_animated_model.Load(RGL::FileSystem::getResourcesPath() / "models/fox.glb");
     m_animations_names = m_animated_model.GetAnimationsNames();
     m_animated_model.SetAnimationSpeed(m_animation_speed);
+    m_animated_model.BakeAnimations(30.0f);
 
     /* Set model matrices for each model. */
     auto scale_factor = m_animated_model.GetUnitScaleFactor();
     m_object_model_matrix = glm::scale(glm::mat4(1.0f), glm::vec3(scale_factor));
 
+    /* A frame's palettes of the largest crowd. */
+    m_bone_palettes.Create(sizeof(glm::mat4) * m_animated_model.GetBonesCount() * MAX_CROWD_SIZE);
+    ResizeCrowd(m_crowd_size);
+
     /* Create shader. */
     std::string dir = "src/demos/20_mesh_skinning/";
 
@@ -50,6 +56,14 @@ void MeshSkinning::init_app()
     m_lbs_skinning_shader = std::make_shared<RGL::Shader>(dir + "skinning_lbs.vert", dir + "skinning.frag");
     m_lbs_skinning_shader->link();
 
+    /* Linear Blend Skinning with the bone matrices of the baked animations texture. */
+    m_baked_skinning_shader = std::make_shared<RGL::Shader>(dir + "skinning_baked.vert", dir + "skinning.frag");
+    m_baked_skinning_shader->link();
+
+    /* Draws the output of the compute pre-skinning. */
+    m_skinned_shader = std::make_shared<RGL::Shader>(dir + "skinned.vert", dir + "skinning.frag");
+    m_skinned_shader->link();
+
     /* Dual Quaternion Blend Skinning shader. */
     m_dqs_skinning_shader = std::make_shared<RGL::Shader>(dir + "skinning_dqs.vert", dir + "skinning.frag");
     m_dqs_skinning_shader->link();
@@ -59,6 +73,44 @@ void MeshSkinning::init_app()
     m_simple_shader->link();
 }
 
+void MeshSkinning::ResizeCrowd(uint32_t size)
+{
+    const uint32_t old_size = uint32_t(m_crowd.size());
+    const uint32_t columns  = uint32_t(glm::ceil(glm::sqrt(float(size))));
+    const float    spacing  = 1.25f;
+
+    m_crowd.resize(size);
+    m_crowd_transforms.clear();
+    m_crowd_batch.Clear();
+    m_crowd_batch.Reserve(size);
+
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        /* The new instances start at different times, so the crowd doesn't move in lockstep. */
+        if (i >= old_size)
+        {
+            m_crowd[i].m_clip  = m_current_animation_index;
+            m_crowd[i].m_speed = m_animation_speed;
+            m_crowd[i].m_time  = float(i) * 7.31f;
+
+            if (i > 0)
+            {
+                m_crowd[i].m_layers = m_crowd[0].m_layers;
+            }
+        }
+
+        glm::vec3 position = glm::vec3(float(i % columns) - 0.5f * float(columns - 1), 0.0f, float(i / columns) - 0.5f * float(columns - 1)) * spacing;
+
+        m_crowd_transforms.push_back(glm::translate(glm::mat4(1.0f), position) * m_object_model_matrix);
+        m_crowd_batch.Add(m_crowd_transforms.back());
+    }
+
+    if (m_compute_skinning)
+    {
+        m_animated_model.CreateSkinnedBuffers(size);
+    }
+}
+
 void MeshSkinning::input()
 {
     /* Close the application when Esc is released. */
@@ -109,13 +161,30 @@ void MeshSkinning::update(double delta_time)
     switch(m_skinning_method)
     {
         case SkinningMethod::LBS:
-            m_bone_transforms.clear();
-            m_animated_model.BoneTransform(delta_time, m_bone_transforms);
+            if (m_animation_lod)
+            {
+                const float projection_scale = 0.5f * float(RGL::Window::getHeight()) * m_camera->m_projection[1][1];
+
+                m_animated_model.SelectAnimationLods(m_crowd, m_crowd_transforms, m_camera->viewProjection(), m_camera->position(), projection_scale);
+            }
+
+            m_bone_palettes.BeginFrame();
+            m_bone_palettes_allocation = m_bone_palettes.Allocate(sizeof(glm::mat4) * m_animated_model.GetBonesCount() * m_crowd.size());
+
+            if (m_bone_palettes_allocation.m_data)
+            {
+                m_animated_model.EvaluateInstances(m_crowd, delta_time, static_cast<glm::mat4*>(m_bone_palettes_allocation.m_data));
+            }
             break;
         case SkinningMethod::DQS:
+            m_bone_palettes_allocation = {};
             m_bone_transforms_dq.clear();
             m_animated_model.BoneTransform(delta_time, m_bone_transforms_dq);
             break;
+        case SkinningMethod::BAKED:
+            m_bone_palettes_allocation = {};
+            m_baked_time += float(delta_time) * m_animation_speed;
+            break;
     }
 }
 
@@ -124,7 +193,7 @@ void MeshSkinning::render()
     /* Put render specific code here. Don't update variables here! */
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+    auto view_projection = m_camera->viewProjection();
 
     /* Draw the grid. */
     m_simple_shader->bind();
@@ -136,11 +205,35 @@ void MeshSkinning::render()
     /* Draw the animated model. */
     if (m_skinning_method == SkinningMethod::LBS)
     {
-        m_lbs_skinning_shader->bind();
-        m_lbs_skinning_shader->setUniform("mvp",   view_projection * m_object_model_matrix);
-        m_lbs_skinning_shader->setUniform("model", m_object_model_matrix);
-        m_lbs_skinning_shader->setUniform("bones", m_bone_transforms.data(), m_bone_transforms.size());
-        m_lbs_skinning_shader->setUniform("gamma", m_gamma);
+        if (m_bone_palettes_allocation.m_data)
+        {
+            m_bone_palettes.BindRange(GL_SHADER_STORAGE_BUFFER, BONE_PALETTES_SSBO_BINDING_INDEX, m_bone_palettes_allocation);
+
+            /* Skinned once, every pass drawing the crowd after this would reuse the vertices. */
+            if (m_compute_skinning)
+            {
+                m_crowd_batch.Update();
+                m_crowd_batch.Bind();
+                m_animated_model.Skin(m_crowd_size);
+
+                m_skinned_shader->bind();
+                m_skinned_shader->setUniform("view_projection", view_projection);
+                m_skinned_shader->setUniform("gamma",           m_gamma);
+
+                m_animated_model.RenderSkinned(m_crowd_size);
+            }
+            else
+            {
+                m_lbs_skinning_shader->bind();
+                m_lbs_skinning_shader->setUniform("view_projection", view_projection);
+                m_lbs_skinning_shader->setUniform("bones_count",     m_animated_model.GetBonesCount());
+                m_lbs_skinning_shader->setUniform("gamma",           m_gamma);
+
+                m_crowd_batch.Render(m_animated_model);
+            }
+        }
+
+        m_bone_palettes.EndFrame();
     }
 
     if (m_skinning_method == SkinningMethod::DQS)
@@ -150,9 +243,25 @@ void MeshSkinning::render()
         m_dqs_skinning_shader->setUniform("model", m_object_model_matrix);
         m_dqs_skinning_shader->setUniform("bones", m_bone_transforms_dq.data(), m_bone_transforms_dq.size());
         m_dqs_skinning_shader->setUniform("gamma", m_gamma);
+
+        m_animated_model.Render();
     }
 
-    m_animated_model.Render();
+    if (m_skinning_method == SkinningMethod::BAKED && m_current_animation_index < m_animated_model.GetBakedClips().size())
+    {
+        const auto& clip = m_animated_model.GetBakedClips()[m_current_animation_index];
+
+        m_animated_model.BindBakedAnimations();
+
+        m_baked_skinning_shader->bind();
+        m_baked_skinning_shader->setUniform("view_projection",   view_projection);
+        m_baked_skinning_shader->setUniform("clip",              glm::uvec2(clip.m_first_frame, clip.m_frames_count));
+        m_baked_skinning_shader->setUniform("frames_per_second", m_animated_model.GetBakedFramesPerSecond());
+        m_baked_skinning_shader->setUniform("time",              m_baked_time);
+        m_baked_skinning_shader->setUniform("gamma",             m_gamma);
+
+        m_crowd_batch.Render(m_animated_model);
+    }
 }
 
 void MeshSkinning::render_gui()
@@ -191,6 +300,30 @@ void MeshSkinning::render_gui()
         if (ImGui::SliderFloat("Animation speed", &m_animation_speed, 0.0, 500.0, "%.1f"))
         {
             m_animated_model.SetAnimationSpeed(m_animation_speed);
+
+            for (auto& state : m_crowd)
+            {
+                state.m_speed = m_animation_speed;
+            }
+        }
+
+        if (ImGui::SliderInt("Crowd size (LBS, baked)", (int*)&m_crowd_size, 1, MAX_CROWD_SIZE))
+        {
+            ResizeCrowd(m_crowd_size);
+        }
+
+        if (ImGui::Checkbox("Animation LOD (LBS)", &m_animation_lod) && !m_animation_lod)
+        {
+            for (auto& state : m_crowd)
+            {
+                state.m_update_interval     = 1;
+                state.m_skipped_leaf_levels = 0;
+            }
+        }
+
+        if (ImGui::Checkbox("Compute pre-skinning (LBS)", &m_compute_skinning))
+        {
+            m_compute_skinning = m_compute_skinning && m_animated_model.CreateSkinnedBuffers(m_crowd_size);
         }
 
         if (ImGui::BeginCombo("Animation", m_animations_names[m_current_animation_index].c_str()))
@@ -201,7 +334,12 @@ void MeshSkinning::render_gui()
                 if (ImGui::Selectable(m_animations_names[i].c_str(), is_selected))
                 {
                     m_current_animation_index = i;
-                    m_animated_model.SetAnimation(i);
+                    m_animated_model.CrossFadeAnimation(i, m_crossfade_duration);
+
+                    for (auto& state : m_crowd)
+                    {
+                        m_animated_model.CrossFade(state, i, m_crossfade_duration);
+                    }
                 }
 
                 if (is_selected)
@@ -212,6 +350,46 @@ void MeshSkinning::render_gui()
             ImGui::EndCombo();
         }
 
+        ImGui::SliderFloat("Crossfade duration", &m_crossfade_duration, 0.0f, 2.0f, "%.2f s");
+
+        const char* additive_name = m_additive_clip < m_animations_names.size() ? m_animations_names[m_additive_clip].c_str() : "None";
+        bool        is_changed    = false;
+
+        if (ImGui::BeginCombo("Additive layer (LBS)", additive_name))
+        {
+            if (ImGui::Selectable("None", m_additive_clip == RGL::AnimatedModel::NO_INDEX))
+            {
+                m_additive_clip = RGL::AnimatedModel::NO_INDEX;
+                is_changed      = true;
+            }
+
+            for (uint32_t i = 0; i < m_animations_names.size(); ++i)
+            {
+                if (ImGui::Selectable(m_animations_names[i].c_str(), m_additive_clip == i))
+                {
+                    m_additive_clip = i;
+                    is_changed      = true;
+                }
+            }
+            ImGui::EndCombo();
+        }
+
+        is_changed |= ImGui::SliderFloat("Additive weight", &m_additive_weight, 0.0f, 1.0f);
+
+        if (is_changed)
+        {
+            for (auto& state : m_crowd)
+            {
+                state.m_layers.resize(m_additive_clip != RGL::AnimatedModel::NO_INDEX ? 1 : 0);
+
+                for (auto& layer : state.m_layers)
+                {
+                    layer.m_clip   = m_additive_clip;
+                    layer.m_weight = m_additive_weight;
+                }
+            }
+        }
+
         if (ImGui::BeginCombo("Skinning method", m_skinning_methods_names[int(m_skinning_method)].c_str()))
         {
             for (int i = 0; i < std::size(m_skinning_methods_names); ++i)
@@ -3,6 +3,8 @@
 
 #include "camera.h"
 #include "animated_model.h"
+#include "instance_batch.h"
+#include "ring_buffer.h"
 #include "shader.h"
 
 #include <memory>
@@ -21,20 +23,41 @@ public:
     void render_gui()              override;
 
 private:
-    enum class SkinningMethod { LBS, DQS };
-    const std::string m_skinning_methods_names[2] = { "Linear Blend Skinning", "Dual Quaternion Blend Skinning" };
+    enum class SkinningMethod { LBS, DQS, BAKED };
+
+    static constexpr uint32_t MAX_CROWD_SIZE = 1024;
+
+    void ResizeCrowd(uint32_t size);
+
+    const std::string m_skinning_methods_names[3] = { "Linear Blend Skinning", "Dual Quaternion Blend Skinning", "Baked Animation Texture (LBS)" };
 
     std::shared_ptr<RGL::Camera> m_camera;
-    std::shared_ptr<RGL::Shader> m_lbs_skinning_shader, m_dqs_skinning_shader, m_simple_shader;
+    std::shared_ptr<RGL::Shader> m_lbs_skinning_shader, m_dqs_skinning_shader, m_baked_skinning_shader, m_skinned_shader, m_simple_shader;
 
     RGL::StaticModel m_grid_model;
     RGL::AnimatedModel m_animated_model;
     std::vector<std::string> m_animations_names;
     glm::mat4 m_object_model_matrix;;
 
-    std::vector<glm::mat4> m_bone_transforms;
     std::vector<glm::mat2x4> m_bone_transforms_dq;
 
+    /* LBS crowd: the instances share the model, each one plays its own state. */
+    std::vector<RGL::AnimatedModel::AnimationState> m_crowd;
+    std::vector<glm::mat4>                          m_crowd_transforms;
+    RGL::InstanceBatch                              m_crowd_batch;
+    RGL::RingBuffer                                 m_bone_palettes;
+    RGL::RingBuffer::Allocation                     m_bone_palettes_allocation = {};
+    uint32_t                                        m_crowd_size               = 1;
+    bool                                            m_compute_skinning         = false;
+    bool                                            m_animation_lod            = false;
+
+    float    m_crossfade_duration = 0.3f;
+    uint32_t m_additive_clip      = RGL::AnimatedModel::NO_INDEX;
+    float    m_additive_weight    = 0.5f;
+
+    /* Baked crowd: the same instances, the vertex shader samples the clip at the instance's own time. */
+    float m_baked_time = 0.0f;
+
     SkinningMethod m_skinning_method;
     uint32_t m_current_animation_index;
     float m_animation_speed;
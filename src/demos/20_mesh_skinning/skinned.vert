@@ -0,0 +1,18 @@
+#version 460 core
+
+/* The vertices of AnimatedModel::Skin(), already skinned and in the world space. */
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec2 in_texcoord;
+layout(location = 2) in vec3 in_normal;
+
+layout(location = 0) out vec2 v_texcoord;
+layout(location = 1) out vec3 v_normal;
+
+uniform mat4 view_projection;
+
+void main()
+{
+    v_texcoord  = in_texcoord;
+    v_normal    = in_normal;
+    gl_Position = view_projection * vec4(in_position, 1.0);
+}
@@ -0,0 +1,38 @@
+#version 460 core
+#include "../../core/core_shared.h"
+#include "../../core/shaders/baked_animation.glh"
+
+layout(location = 0) in vec3  in_position;
+layout(location = 1) in vec2  in_texcoord;
+layout(location = 2) in vec3  in_normal;
+layout(location = 4) in vec4  in_weights;
+layout(location = 5) in uvec4 in_bone_ids;
+
+layout(location = 0) out vec2 v_texcoord;
+layout(location = 1) out vec3 v_normal;
+
+uniform mat4  view_projection;
+uniform uvec2 clip;
+uniform float frames_per_second;
+uniform float time;
+
+void main()
+{
+    /* Every instance plays the clip from its own offset, the CPU doesn't touch the crowd at all. */
+    float instance_time = time + float(gl_InstanceID) * 0.731;
+
+    mat4 bone_transform  = bakedBoneMatrix(clip, frames_per_second, instance_time, in_bone_ids[0]) * in_weights[0];
+         bone_transform += bakedBoneMatrix(clip, frames_per_second, instance_time, in_bone_ids[1]) * in_weights[1];
+         bone_transform += bakedBoneMatrix(clip, frames_per_second, instance_time, in_bone_ids[2]) * in_weights[2];
+         bone_transform += bakedBoneMatrix(clip, frames_per_second, instance_time, in_bone_ids[3]) * in_weights[3];
+
+    mat4 model = INSTANCE_DATA.model_matrix;
+
+    v_texcoord = in_texcoord;
+
+    vec4 local_normal = bone_transform * vec4(in_normal, 0);
+    v_normal          = (model * local_normal).xyz;
+
+    vec4 local_position = bone_transform * vec4(in_position, 1.0);
+    gl_Position         = view_projection * model * local_position;
+}
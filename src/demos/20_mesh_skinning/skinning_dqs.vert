@@ -4,7 +4,7 @@ layout(location = 0) in vec3  in_position;
 layout(location = 1) in vec2  in_texcoord;
 layout(location = 2) in vec3  in_normal;
 layout(location = 4) in vec4  in_weights;
-layout(location = 5) in ivec4 in_bone_ids;
+layout(location = 5) in uvec4 in_bone_ids;
 
 layout(location = 0) out vec2 v_texcoord;
 layout(location = 1) out vec3 v_normal;
@@ -1,6 +1,7 @@
 #include "oit.h"
 #include "filesystem.h"
 #include "input.h"
+#include "profiler.h"
 #include "util.h"
 #include "gui/gui.h"
 
@@ -9,6 +10,12 @@ OIT::OIT()
       m_linked_lists_buffer  (0), 
       m_list_info_buffer     (0), 
       m_head_pointers_image2d(0), 
+      m_weighted_blended_fbo (0),
+      m_accumulation_texture (0),
+      m_revealage_texture    (0),
+      m_mlab_layers_buffer   (0),
+      m_list_info_readback_buffer(0),
+      m_list_info_readback_data  (nullptr),
       m_max_nodes            (0),
       m_grid_dimensions      (5, 5, 3), 
       m_transparency         (0.4f)
@@ -28,6 +35,30 @@ OIT::~OIT()
 
     glDeleteTextures(1, &m_head_pointers_image2d);
     m_head_pointers_image2d = 0;
+
+    glDeleteFramebuffers(1, &m_weighted_blended_fbo);
+    m_weighted_blended_fbo = 0;
+
+    glDeleteTextures(1, &m_accumulation_texture);
+    m_accumulation_texture = 0;
+
+    glDeleteTextures(1, &m_revealage_texture);
+    m_revealage_texture = 0;
+
+    glDeleteBuffers(1, &m_mlab_layers_buffer);
+    m_mlab_layers_buffer = 0;
+
+    for (auto& fence : m_list_info_fences)
+    {
+        if (fence)
+        {
+            glDeleteSync(fence);
+        }
+    }
+
+    glUnmapNamedBuffer(m_list_info_readback_buffer);
+    glDeleteBuffers(1, &m_list_info_readback_buffer);
+    m_list_info_readback_buffer = 0;
 }
 
 void OIT::init_app()
@@ -40,6 +71,7 @@ void OIT::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(-15.0, 0.0, 20.0);
     m_camera->setOrientation(0, 37.0, 0.0);
 
@@ -58,19 +90,19 @@ void OIT::init_app()
             for (uint32_t k = 0; k < m_grid_dimensions.x; ++k)
             {
                 glm::vec3 position = start_pos + glm::vec3(k, j, i) * (radius + offset);
-                m_objects_model_matrices.emplace_back(glm::translate(glm::mat4(1.0), position));
+                m_spheres_batch.Add(glm::translate(glm::mat4(1.0), position), i /* material index */);
             }
         }
     }
 
     m_dragon_model.Load(RGL::FileSystem::getResourcesPath() / "models/dragon.obj");
-    m_dragon_model_matrix = glm::scale(glm::mat4(1.0f), glm::vec3(m_dragon_model.GetUnitScaleFactor() * 25.0f));
-    m_dragon_color        = glm::vec3(0, 1, 0);
+    m_dragon_batch.Add(glm::scale(glm::mat4(1.0f), glm::vec3(m_dragon_model.GetUnitScaleFactor() * 25.0f)), 3 /* material index */);
 
-    /* Set colors for the consecutive layers of cubes. */
+    /* Set colors for the consecutive layers of cubes and the dragon. */
     m_objects_colors.emplace_back(glm::vec3(0.0, 0.0, 1.0));
     m_objects_colors.emplace_back(glm::vec3(0.0, 1.0, 0.0));
     m_objects_colors.emplace_back(glm::vec3(1.0, 0.0, 0.0));
+    m_objects_colors.emplace_back(glm::vec3(0.0, 1.0, 0.0));
 
     /* Create shader. */
     std::string dir = "src/demos/21_oit/";
@@ -81,19 +113,46 @@ void OIT::init_app()
     m_oit_render_shader = std::make_shared<RGL::Shader>(dir2 + "FSQ.vert", dir + "oit_render.frag");
     m_oit_render_shader->link();
 
-    /* Prepare GL objects */
-          m_max_nodes    = 20 * RGL::Window::getWidth() * RGL::Window::getHeight();
-    GLint list_node_size = sizeof(ListNode) + sizeof(uint32_t);
+    m_oit_weighted_blended_shader = std::make_shared<RGL::Shader>(dir + "oit.vert", dir + "oit_weighted_blended.frag");
+    m_oit_weighted_blended_shader->link();
 
-    glCreateBuffers(1, &m_linked_lists_buffer);
-    glNamedBufferStorage(m_linked_lists_buffer, m_max_nodes * list_node_size, nullptr, GL_DYNAMIC_STORAGE_BIT);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_linked_lists_buffer);
+    m_oit_weighted_composite_shader = std::make_shared<RGL::Shader>(dir2 + "FSQ.vert", dir + "oit_weighted_composite.frag");
+    m_oit_weighted_composite_shader->link();
+
+    m_is_mlab_supported = GLAD_GL_ARB_fragment_shader_interlock;
+
+    if (m_is_mlab_supported)
+    {
+        m_oit_mlab_shader = std::make_shared<RGL::Shader>(dir + "oit.vert", dir + "oit_mlab.frag");
+        m_oit_mlab_shader->link();
+
+        m_oit_mlab_resolve_shader = std::make_shared<RGL::Shader>(dir2 + "FSQ.vert", dir + "oit_mlab_resolve.frag");
+        m_oit_mlab_resolve_shader->link();
+    }
 
-    uint32_t list_info_data[] = { 0, m_max_nodes };
+    /* Prepare GL objects */
+    uint32_t list_info_data[] = { 0, 0 };
     glCreateBuffers(1, &m_list_info_buffer);
     glNamedBufferStorage(m_list_info_buffer, sizeof(uint32_t) * 2, list_info_data, GL_DYNAMIC_STORAGE_BIT);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_list_info_buffer);
 
+    /* A guess of the average depth complexity, the readback of the node counter corrects it in a few frames. */
+    CreateNodePool(4 * RGL::Window::getWidth() * RGL::Window::getHeight());
+
+    const GLbitfield readback_flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glCreateBuffers     (1, &m_list_info_readback_buffer);
+    glNamedBufferStorage(m_list_info_readback_buffer, sizeof(uint32_t) * REQUESTED_NODES_FRAMES, nullptr, readback_flags);
+
+    m_list_info_readback_data = static_cast<uint32_t*>(glMapNamedBufferRange(m_list_info_readback_buffer, 0, sizeof(uint32_t) * REQUESTED_NODES_FRAMES, readback_flags));
+
+    const glm::uvec2 empty_layer = glm::uvec2(0xFF000000, 0xFFFFFFFF);
+
+    glCreateBuffers(1, &m_mlab_layers_buffer);
+    glNamedBufferStorage(m_mlab_layers_buffer, sizeof(glm::uvec2) * MAX_LAYERS * RGL::Window::getWidth() * RGL::Window::getHeight(), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glClearNamedBufferData(m_mlab_layers_buffer, GL_RG32UI, GL_RG_INTEGER, GL_UNSIGNED_INT, &empty_layer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_mlab_layers_buffer);
+
     m_head_pointers_clear_data = std::vector<uint32_t>(RGL::Window::getWidth() * RGL::Window::getHeight(), 0xffffffff);
 
     glCreateTextures(GL_TEXTURE_2D, 1, &m_head_pointers_image2d);
@@ -107,6 +166,19 @@ void OIT::init_app()
     glClearTexImage(m_head_pointers_image2d, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, m_head_pointers_clear_data.data());
     glBindImageTexture(0, m_head_pointers_image2d, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
 
+    /* The weighted blended OIT targets, single sampled - the composite pass upsamples them to all the samples. */
+    glCreateTextures(GL_TEXTURE_2D, 1, &m_accumulation_texture);
+    glTextureStorage2D(m_accumulation_texture, 1, GL_RGBA16F, RGL::Window::getWidth(), RGL::Window::getHeight());
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &m_revealage_texture);
+    glTextureStorage2D(m_revealage_texture, 1, GL_R8, RGL::Window::getWidth(), RGL::Window::getHeight());
+
+    GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glCreateFramebuffers(1, &m_weighted_blended_fbo);
+    glNamedFramebufferTexture(m_weighted_blended_fbo, GL_COLOR_ATTACHMENT0, m_accumulation_texture, 0);
+    glNamedFramebufferTexture(m_weighted_blended_fbo, GL_COLOR_ATTACHMENT1, m_revealage_texture,    0);
+    glNamedFramebufferDrawBuffers(m_weighted_blended_fbo, 2, draw_buffers);
+
     glCreateVertexArrays(1, &m_fsq_vao);
 }
 
@@ -160,49 +232,108 @@ void OIT::update(double delta_time)
 
 void OIT::render()
 {
-    /* Clear list info SSBO and head_pointers_image2d before rendering. */
-    uint32_t zero = 0;
-    glNamedBufferSubData(m_list_info_buffer, 0 /*offset*/, sizeof(uint32_t), &zero); // clear next_node_counter only
-    glClearTexImage(m_head_pointers_image2d, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, m_head_pointers_clear_data.data());
-
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+    auto view_projection = m_camera->viewProjection();
 
-    /* Pass 1 - create the linked lists. */
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    m_oit_linked_list_shader->bind();
-    m_oit_linked_list_shader->setUniform("light.intensity", 1.0f);
-    m_oit_linked_list_shader->setUniform("light.direction", glm::vec3(1, -1, 0));
-    m_oit_linked_list_shader->setUniform("cam_pos",         m_camera->position());
-    m_oit_linked_list_shader->setUniform("transparency",    m_transparency);
+    if (m_mode == Mode::LINKED_LISTS)
+    {
+        RenderLinkedLists(view_projection);
+    }
+    else if (m_mode == Mode::WEIGHTED_BLENDED)
+    {
+        RenderWeightedBlended(view_projection);
+    }
+    else
+    {
+        RenderMultiLayer(view_projection);
+    }
+}
 
-    if (m_current_model == 0)
+void OIT::CreateNodePool(uint32_t max_nodes)
+{
+    if (m_linked_lists_buffer)
     {
-        for (int i = m_grid_dimensions.z - 1; i >= 0; --i)
+        glDeleteBuffers(1, &m_linked_lists_buffer);
+    }
+
+    m_max_nodes = max_nodes;
+
+    glCreateBuffers(1, &m_linked_lists_buffer);
+    glNamedBufferStorage(m_linked_lists_buffer, uint64_t(m_max_nodes) * sizeof(ListNode), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_linked_lists_buffer);
+
+    glNamedBufferSubData(m_list_info_buffer, sizeof(uint32_t) /*offset*/, sizeof(uint32_t), &m_max_nodes); // max_nodes only
+}
+
+void OIT::ReadRequestedNodes()
+{
+    bool is_read = false;
+
+    /* The oldest copy first, the newest one wins. */
+    for (uint32_t i = 0; i < REQUESTED_NODES_FRAMES; ++i)
+    {
+        const uint32_t slot  = (m_list_info_readback_slot + i) % REQUESTED_NODES_FRAMES;
+        GLsync&        fence = m_list_info_fences[slot];
+
+        if (!fence || glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
         {
-            for (uint32_t j = 0; j < m_grid_dimensions.y; ++j)
-            {
-                for (uint32_t k = 0; k < m_grid_dimensions.x; ++k)
-                {
-                    uint32_t index = k + j * m_grid_dimensions.x + i * m_grid_dimensions.x * m_grid_dimensions.y;
-                    m_oit_linked_list_shader->setUniform("light.color",     m_objects_colors[i]);
-                    m_oit_linked_list_shader->setUniform("mvp",             view_projection * m_objects_model_matrices[index]);
-                    m_oit_linked_list_shader->setUniform("model_matrix",    m_objects_model_matrices[index]);
-                    m_sphere_model.Render();
-                }
-            }
+            continue;
         }
+
+        glDeleteSync(fence);
+        fence = nullptr;
+
+        m_requested_nodes = m_list_info_readback_data[slot];
+        is_read           = true;
     }
-    else
+
+    if (!is_read)
+    {
+        return;
+    }
+
+    /* Grow with a margin for the camera moves, shrink only when most of the pool is unused. */
+    const uint32_t pixels_count = RGL::Window::getWidth() * RGL::Window::getHeight();
+    const uint32_t max_nodes    = glm::max(m_requested_nodes + m_requested_nodes / 4, pixels_count);
+
+    if (m_requested_nodes > m_max_nodes || max_nodes < m_max_nodes / 2)
     {
-        m_oit_linked_list_shader->setUniform("light.color",  m_dragon_color);
-        m_oit_linked_list_shader->setUniform("mvp",          view_projection * m_dragon_model_matrix);
-        m_oit_linked_list_shader->setUniform("model_matrix", m_dragon_model_matrix);
-        m_dragon_model.Render();
+        CreateNodePool(max_nodes);
+        ++m_node_pool_resizes;
     }
+}
+
+void OIT::RenderLinkedLists(const glm::mat4& view_projection)
+{
+    RGL::ProfilerScope scope("Linked lists");
+
+    ReadRequestedNodes();
+
+    /* Clear list info SSBO and head_pointers_image2d before rendering. */
+    uint32_t zero = 0;
+    glNamedBufferSubData(m_list_info_buffer, 0 /*offset*/, sizeof(uint32_t), &zero); // clear next_node_counter only
+    glClearTexImage(m_head_pointers_image2d, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, m_head_pointers_clear_data.data());
+
+    /* Pass 1 - create the linked lists. */
+    SetShadingUniforms(*m_oit_linked_list_shader, view_projection);
+    RenderModel();
 
     /* Make sure that GPU finished writing to SSBOs and the image. */
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    /* The counter went on past max_nodes, it's the size the pool needed. */
+    GLsync& fence = m_list_info_fences[m_list_info_readback_slot];
+
+    if (fence)
+    {
+        glDeleteSync(fence);
+    }
+
+    glCopyNamedBufferSubData(m_list_info_buffer, m_list_info_readback_buffer, 0, sizeof(uint32_t) * m_list_info_readback_slot, sizeof(uint32_t));
+
+    fence                     = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_list_info_readback_slot = (m_list_info_readback_slot + 1) % REQUESTED_NODES_FRAMES;
     
     /* Pass 2 - render OIT. */    
     m_oit_render_shader->bind();
@@ -210,6 +341,72 @@ void OIT::render()
     glDrawArrays(GL_TRIANGLES, 0, 3);
 }
 
+void OIT::RenderWeightedBlended(const glm::mat4& view_projection)
+{
+    RGL::ProfilerScope scope("Weighted blended");
+
+    const float accumulation_clear[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const float revealage_clear[]    = { 1.0f, 0.0f, 0.0f, 0.0f };
+
+    glClearNamedFramebufferfv(m_weighted_blended_fbo, GL_COLOR, 0, accumulation_clear);
+    glClearNamedFramebufferfv(m_weighted_blended_fbo, GL_COLOR, 1, revealage_clear);
+
+    /* Pass 1 - accumulate the weighted colors and the revealage. */
+    glBindFramebuffer(GL_FRAMEBUFFER, m_weighted_blended_fbo);
+    glEnable(GL_BLEND);
+    glBlendFunci(0, GL_ONE,  GL_ONE);
+    glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+
+    SetShadingUniforms(*m_oit_weighted_blended_shader, view_projection);
+    RenderModel();
+
+    /* Pass 2 - composite over the background. */
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+
+    m_oit_weighted_composite_shader->bind();
+    glBindTextureUnit(0, m_accumulation_texture);
+    glBindTextureUnit(1, m_revealage_texture);
+
+    glBindVertexArray(m_fsq_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    glDisable(GL_BLEND);
+}
+
+void OIT::RenderMultiLayer(const glm::mat4& view_projection)
+{
+    RGL::ProfilerScope scope("Multi-layer");
+
+    if (!m_is_mlab_supported)
+    {
+        return;
+    }
+
+    const glm::uvec2 empty_layer  = glm::uvec2(0xFF000000, 0xFFFFFFFF);
+    const GLuint     pixels_count = RGL::Window::getWidth() * RGL::Window::getHeight();
+
+    glClearNamedBufferSubData(m_mlab_layers_buffer, GL_RG32UI, 0, sizeof(glm::uvec2) * m_layers_count * pixels_count, GL_RG_INTEGER, GL_UNSIGNED_INT, &empty_layer);
+
+    /* Pass 1 - insert the fragments into the layers. */
+    SetShadingUniforms(*m_oit_mlab_shader, view_projection);
+    m_oit_mlab_shader->setUniform("layers_count", m_layers_count);
+    m_oit_mlab_shader->setUniform("screen_width", GLuint(RGL::Window::getWidth()));
+    m_oit_mlab_shader->setUniform("pixels_count", pixels_count);
+    RenderModel();
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    /* Pass 2 - blend the layers front to back. */
+    m_oit_mlab_resolve_shader->bind();
+    m_oit_mlab_resolve_shader->setUniform("layers_count", m_layers_count);
+    m_oit_mlab_resolve_shader->setUniform("screen_width", GLuint(RGL::Window::getWidth()));
+    m_oit_mlab_resolve_shader->setUniform("pixels_count", pixels_count);
+
+    glBindVertexArray(m_fsq_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
 void OIT::render_gui()
 {
     /* This method is responsible for rendering GUI using ImGUI. */
@@ -243,6 +440,60 @@ void OIT::render_gui()
 
         ImGui::SliderFloat("Transparency", &m_transparency, 0.0, 1.0, "%.2f");
 
+        if (ImGui::BeginCombo("Mode", m_modes_names_combo_box[int(m_mode)].c_str()))
+        {
+            for (int i = 0; i < std::size(m_modes_names_combo_box); ++i)
+            {
+                bool is_selected = (int(m_mode) == i);
+                if (ImGui::Selectable(m_modes_names_combo_box[i].c_str(), is_selected))
+                {
+                    m_mode = Mode(i);
+                }
+
+                if (is_selected)
+                {
+                    ImGui::SetItemDefaultFocus();
+                }
+            }
+            ImGui::EndCombo();
+        }
+
+        /* Of the selected mode, the timings of both are in the profiler. */
+        for (uint32_t index : RGL::Profiler::GetResolvedScopes())
+        {
+            const auto& scope = RGL::Profiler::GetScope(index);
+
+            if (scope.m_name == "Linked lists" || scope.m_name == "Weighted blended" || scope.m_name == "Multi-layer")
+            {
+                ImGui::Text("GPU time: %.3f ms", scope.m_gpu_ms);
+            }
+        }
+
+        uint64_t pixels_count = uint64_t(RGL::Window::getWidth()) * RGL::Window::getHeight();
+        if (m_mode == Mode::LINKED_LISTS)
+        {
+            uint64_t size = uint64_t(m_max_nodes) * sizeof(ListNode) + pixels_count * sizeof(uint32_t);
+            ImGui::Text("Memory: %.1f MB", size / (1024.0 * 1024.0));
+            ImGui::Text("Nodes: %u requested, %u in the pool", m_requested_nodes, m_max_nodes);
+            ImGui::Text("Pool resizes: %u", m_node_pool_resizes);
+        }
+        else if (m_mode == Mode::WEIGHTED_BLENDED)
+        {
+            uint64_t size = pixels_count * (4 * sizeof(uint16_t) + sizeof(uint8_t));
+            ImGui::Text("Memory: %.1f MB", size / (1024.0 * 1024.0));
+        }
+        else if (m_is_mlab_supported)
+        {
+            ImGui::SliderInt("Layers", &m_layers_count, 1, MAX_LAYERS);
+
+            uint64_t size = pixels_count * m_layers_count * sizeof(glm::uvec2);
+            ImGui::Text("Memory: %.1f MB", size / (1024.0 * 1024.0));
+        }
+        else
+        {
+            ImGui::Text("GL_ARB_fragment_shader_interlock is not supported.");
+        }
+
         if (ImGui::BeginCombo("Model", m_models_names_combo_box[m_current_model].c_str()))
         {
             for (int i = 0; i < std::size(m_models_names_combo_box); ++i)
@@ -2,6 +2,7 @@
 #include "core_app.h"
 
 #include "camera.h"
+#include "instance_batch.h"
 #include "static_model.h"
 #include "shader.h"
 
@@ -11,14 +12,19 @@
 class OIT : public RGL::CoreApp
 {
 public:
+    /* RGBA8 color, 24-bit depth above the 8-bit sample coverage, and the next node - 12 bytes. */
     struct ListNode
     {
-        glm::vec4 color;
-        float depth;
-        int coverage;
+        uint32_t color;
+        uint32_t depth_coverage;
         uint32_t next;
     };
 
+    enum class Mode { LINKED_LISTS, WEIGHTED_BLENDED, MULTI_LAYER };
+
+    /* Of the fixed layers a pixel keeps in the multi-layer mode, in sync with oit_mlab.glh. */
+    static constexpr int MAX_LAYERS = 8;
+
     OIT();
     ~OIT();
 
@@ -29,26 +35,69 @@ public:
     void render_gui()              override;
 
 private:
+    void SetShadingUniforms(RGL::Shader& shader, const glm::mat4& view_projection);
+    void RenderModel();
+
+    /* Per-pixel lists of the fragments, sorted and blended in the resolve pass - exact, but of unbounded memory. */
+    void RenderLinkedLists(const glm::mat4& view_projection);
+
+    /* Weighted sums of the fragments in two targets and a composite pass - of fixed memory and no sort, approximate. */
+    void RenderWeightedBlended(const glm::mat4& view_projection);
+
+    /* The nearest m_layers_count fragments per pixel and the rest merged into the last one - of fixed memory, exact up to the tail. */
+    void RenderMultiLayer(const glm::mat4& view_projection);
+
+    /* (Re)creates the node pool of the linked lists. */
+    void CreateNodePool(uint32_t max_nodes);
+
+    /* Resizes the node pool to the nodes the last read back frame needed. */
+    void ReadRequestedNodes();
+
     std::shared_ptr<RGL::Camera> m_camera;
     std::shared_ptr<RGL::Shader> m_oit_linked_list_shader, m_oit_render_shader;
+    std::shared_ptr<RGL::Shader> m_oit_weighted_blended_shader, m_oit_weighted_composite_shader;
+    std::shared_ptr<RGL::Shader> m_oit_mlab_shader, m_oit_mlab_resolve_shader;
 
     RGL::StaticModel m_sphere_model;
-    std::vector<glm::mat4> m_objects_model_matrices;
-    std::vector<glm::vec3> m_objects_colors;
+    RGL::InstanceBatch m_spheres_batch;
 
     RGL::StaticModel m_dragon_model;
-    glm::mat4 m_dragon_model_matrix;
-    glm::vec3 m_dragon_color;
+    RGL::InstanceBatch m_dragon_batch;
+
+    /* Indexed with the instances' material index - the layers of spheres and the dragon. */
+    std::vector<glm::vec3> m_objects_colors;
 
     std::vector<uint32_t> m_head_pointers_clear_data;
     GLuint m_fsq_vao;
     GLuint m_linked_lists_buffer, m_list_info_buffer;
     GLuint m_head_pointers_image2d;
 
+    /* RGBA16F sum of the weighted premultiplied colors and their weights, R8 product of the transmittances. */
+    GLuint m_weighted_blended_fbo;
+    GLuint m_accumulation_texture, m_revealage_texture;
+
+    /* MAX_LAYERS uvec2 per pixel, planar. */
+    GLuint m_mlab_layers_buffer;
+    int    m_layers_count      = 4;
+    bool   m_is_mlab_supported = false; /* GL_ARB_fragment_shader_interlock orders the updates of a pixel's layers. */
+
+    /* The node counter of the frames, read back without a stall. */
+    static constexpr uint32_t REQUESTED_NODES_FRAMES = 2;
+
+    GLuint    m_list_info_readback_buffer;
+    uint32_t* m_list_info_readback_data;
+    GLsync    m_list_info_fences[REQUESTED_NODES_FRAMES] = {};
+    uint32_t  m_list_info_readback_slot                  = 0;
+    uint32_t  m_requested_nodes                          = 0;
+    uint32_t  m_node_pool_resizes                        = 0;
+
     uint32_t m_max_nodes;
     glm::vec3 m_grid_dimensions;
     float m_transparency;
 
     uint32_t m_current_model = 0;
     std::vector<std::string> m_models_names_combo_box = { "spheres", "dragon"};
+
+    Mode m_mode = Mode::LINKED_LISTS;
+    std::vector<std::string> m_modes_names_combo_box = { "linked lists", "weighted blended", "multi-layer alpha blending" };
 };
\ No newline at end of file
@@ -1,18 +1,22 @@
 #version 460 core
+#include "../../core/core_shared.h"
+
 layout (location = 0) in vec3 in_pos;
 layout (location = 2) in vec3 in_normal;
 
-uniform mat4 mvp;
-uniform mat4 model_matrix;
+uniform mat4 view_projection;
 
 out vec3 world_pos;
 out vec3 normal;
+flat out uint material_index;
 
 void main()
 {
+    mat4 model_matrix = INSTANCE_DATA.model_matrix;
 
-    world_pos = vec3(model_matrix * vec4(in_pos,   1.0));
-    normal    = vec3(model_matrix * vec4(in_normal, 0.0));
+    world_pos      = vec3(model_matrix * vec4(in_pos,    1.0));
+    normal         = vec3(model_matrix * vec4(in_normal, 0.0));
+    material_index = INSTANCE_DATA.material_index;
 
-    gl_Position = mvp * vec4(in_pos, 1.0);
+    gl_Position = view_projection * vec4(world_pos, 1.0);
 }
\ No newline at end of file
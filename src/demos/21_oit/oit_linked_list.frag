@@ -1,12 +1,14 @@
 #version 460
+#include "oit_shading.glh"
 
 layout (early_fragment_tests) in;
 
+
+// 12 bytes: the RGBA8 color, the 24-bit depth above the 8-bit sample coverage, and the next node.
 struct ListNode
 {
-	vec4 color;
-	float depth;
-	int coverage;
+	uint color;
+	uint depth_coverage;
 	uint next;
 };
 
@@ -19,38 +21,10 @@ layout (binding = 0, std430) buffer linked_lists
 
 layout (binding = 1, std430) buffer list_info
 {
-	uint next_node_counter;
+	uint next_node_counter; // Counts the fragments past max_nodes too, the app grows the pool to fit them.
 	uint max_nodes;
 };
 
-struct DirectionalLight
-{
-    vec3 color;
-    float intensity;
-    vec3 direction;
-};
-
-uniform DirectionalLight light;
-uniform vec3 cam_pos;
-uniform float transparency;
-
-in vec3 world_pos;
-in vec3 normal;
-
-vec4 blinnPhong(DirectionalLight light, vec3 normal, vec3 world_pos)
-{
-    float diffuse = max(dot(normal, -normalize(light.direction)), 0.0);
-
-    vec3 dir_to_eye  = normalize(cam_pos - world_pos);
-    vec3 half_vector = normalize(dir_to_eye - light.direction);
-    float specular   = pow(max(dot(half_vector, normal), 0.0), 20.0);
-
-    vec4 diffuse_color  = vec4(light.color, 1.0) * light.intensity * diffuse;
-    vec4 specular_color = vec4(1.0) * specular * 0.5;
-
-    return diffuse_color + specular_color;
-}
-
 void main()
 {
 	// Get the index of the next empty slot in the buffer
@@ -70,12 +44,8 @@ void main()
 		// Here we set the color and depth of this new node to the color
 		// and depth of the fragment.  The next pointer, points to the
 		// previous head of the list.
-		vec4 color = blinnPhong(light, normalize(normal), world_pos) + vec4(vec3(0.18), 1.0);
-		color.a    = transparency;
-
-		nodes[node_index].color    = color;
-		nodes[node_index].depth    = gl_FragCoord.z;
-		nodes[node_index].coverage = gl_SampleMaskIn[0];
-		nodes[node_index].next     = previous_head;
+		nodes[node_index].color          = packUnorm4x8(shadeFragment());
+		nodes[node_index].depth_coverage = (uint(gl_FragCoord.z * 16777215.0) << 8) | (uint(gl_SampleMaskIn[0]) & 0xFF);
+		nodes[node_index].next           = previous_head;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,50 @@
+#version 460
+#extension GL_ARB_fragment_shader_interlock : require
+#include "oit_shading.glh"
+#include "oit_mlab.glh"
+
+// The fragments of a pixel update its layers one at a time, and in the primitive order, so the merges are deterministic.
+layout (pixel_interlock_ordered) in;
+
+void main()
+{
+	vec4  color    = shadeFragment();
+	uvec2 fragment = uvec2(packUnorm4x8(vec4(color.rgb * color.a, 1.0 - color.a)), floatBitsToUint(gl_FragCoord.z));
+
+	beginInvocationInterlockARB();
+	{
+		uvec2 pixel_layers[MAX_LAYERS];
+
+		// The bits of positive floats order like the floats themselves - the fragment bubbles to its place,
+		// the farthest of the layers and the fragment is left in it.
+		for (int i = 0; i < layers_count; ++i)
+		{
+			pixel_layers[i] = layers[layerIndex(i)];
+
+			if (fragment.y < pixel_layers[i].y)
+			{
+				uvec2 farther   = pixel_layers[i];
+				pixel_layers[i] = fragment;
+				fragment        = farther;
+			}
+		}
+
+		// No free layer, the tail is merged into the last one.
+		if (fragment != EMPTY_LAYER)
+		{
+			vec4 last = unpackUnorm4x8(pixel_layers[layers_count - 1].x);
+			vec4 tail = unpackUnorm4x8(fragment.x);
+
+			last.rgb += tail.rgb * last.a;
+			last.a   *= tail.a;
+
+			pixel_layers[layers_count - 1].x = packUnorm4x8(last);
+		}
+
+		for (int i = 0; i < layers_count; ++i)
+		{
+			layers[layerIndex(i)] = pixel_layers[i];
+		}
+	}
+	endInvocationInterlockARB();
+}
@@ -0,0 +1,28 @@
+#version 460
+#include "oit_mlab.glh"
+
+layout (location = 0) out vec4 frag_color;
+
+void main()
+{
+	vec3  color         = vec3(0.0);
+	float transmittance = 1.0;
+
+	// Front to back, the layers are already sorted.
+	for (int i = 0; i < layers_count; ++i)
+	{
+		uvec2 layer = layers[layerIndex(i)];
+
+		if (layer == EMPTY_LAYER)
+		{
+			break;
+		}
+
+		vec4 layer_color = unpackUnorm4x8(layer.x);
+
+		color         += layer_color.rgb * transmittance;
+		transmittance *= layer_color.a;
+	}
+
+	frag_color = vec4(color + vec3(0.5) * transmittance, 1.0); // Over the clear color.
+}
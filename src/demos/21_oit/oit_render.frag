@@ -5,9 +5,8 @@ layout (location = 0) out vec4 frag_color;
 
 struct ListNode
 {
-	vec4 color;
-	float depth;
-	int coverage;
+	uint color;
+	uint depth_coverage;
 	uint next;
 };
 
@@ -20,7 +19,8 @@ layout (binding = 0, std430) buffer linked_lists
 
 void main()
 {
-	ListNode fragments[MAX_FRAGMENTS];
+	// The color and the depth with the coverage of the nodes, the depth in the high bits sorts them.
+	uvec2 fragments[MAX_FRAGMENTS];
 	int count = 0;
 
 	// Get the index of the head of the list
@@ -29,18 +29,18 @@ void main()
 	// Copy the linked list for this fragment into an array
 	while (n != 0xffffffff && count < MAX_FRAGMENTS)
 	{
-		fragments[count] = nodes[n];
-		n = fragments[count].next;
+		fragments[count] = uvec2(nodes[n].color, nodes[n].depth_coverage);
+		n = nodes[n].next;
 		count++;
 	}
 
 	// Sort the array by depth using insertion sort (largest to smallest)
 	for (uint i = 1; i < count; ++i)
 	{
-		ListNode to_insert = fragments[i];
+		uvec2 to_insert = fragments[i];
 		uint j = i;
 
-		while (j > 0 && to_insert.depth > fragments[j - 1].depth)
+		while (j > 0 && to_insert.y > fragments[j - 1].y)
 		{
 			fragments[j] = fragments[j - 1];
 			--j;
@@ -53,9 +53,10 @@ void main()
 	for (uint i = 0; i < count; i++)
 	{
 		// MSAA support
-		if ((fragments[i].coverage & (1 << gl_SampleID)) != 0)
+		if ((fragments[i].y & (1u << gl_SampleID)) != 0)
 		{
-			color.rgb = mix(color.rgb, fragments[i].color.rgb, fragments[i].color.a);
+			vec4 fragment_color = unpackUnorm4x8(fragments[i].x);
+			color.rgb = mix(color.rgb, fragment_color.rgb, fragment_color.a);
 		}
 	}
 
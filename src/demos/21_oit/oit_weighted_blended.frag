@@ -0,0 +1,19 @@
+#version 460
+#include "oit_shading.glh"
+
+// Weighted blended OIT (McGuire and Bavoil 2013): the fragments are accumulated in any order, weighted by their
+// depth and alpha, and oit_weighted_composite.frag normalizes the sum. No lists, no sort, two targets of fixed size.
+layout (location = 0) out vec4 accumulation; // Blended with (ONE, ONE).
+layout (location = 1) out float revealage;   // Blended with (ZERO, ONE_MINUS_SRC_COLOR), the product of (1 - alpha).
+
+void main()
+{
+	vec4 color = shadeFragment();
+
+	// Equation (9) of the paper, the nearer fragments outweigh the farther ones.
+	float z      = distance(cam_pos, world_pos);
+	float weight = color.a * clamp(10.0 / (1e-5 + pow(z / 5.0, 2.0) + pow(z / 200.0, 6.0)), 1e-2, 3e3);
+
+	accumulation = vec4(color.rgb * color.a, color.a) * weight;
+	revealage    = color.a;
+}
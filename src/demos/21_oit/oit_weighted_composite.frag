@@ -0,0 +1,29 @@
+#version 460
+
+// Resolves the weighted blended OIT targets over the background, blended with (ONE_MINUS_SRC_ALPHA, SRC_ALPHA).
+layout (location = 0) out vec4 frag_color;
+
+layout (binding = 0) uniform sampler2D accumulation_texture;
+layout (binding = 1) uniform sampler2D revealage_texture;
+
+void main()
+{
+	ivec2 pixel     = ivec2(gl_FragCoord.xy);
+	float revealage = texelFetch(revealage_texture, pixel, 0).r;
+
+	// Nothing transparent covers the pixel.
+	if (revealage == 1.0)
+	{
+		discard;
+	}
+
+	vec4 accumulation = texelFetch(accumulation_texture, pixel, 0);
+
+	// The sum of the weighted colors can overflow half floats.
+	if (isinf(max(max(abs(accumulation.r), abs(accumulation.g)), abs(accumulation.b))))
+	{
+		accumulation.rgb = vec3(accumulation.a);
+	}
+
+	frag_color = vec4(accumulation.rgb / max(accumulation.a, 1e-5), revealage);
+}
@@ -0,0 +1,24 @@
+#version 460 core
+#include "pbr-lighting.glh"
+
+// The radiance the IrradianceVolume's probes see: the global ambient light and all the lights in one pass.
+// Alpha 1 tells the scene from the sky, the projection fills the rest with the environment.
+uniform DirectionalLight u_directional_light;
+uniform PointLight       u_point_lights[4];
+uniform SpotLight        u_spot_light;
+
+void main()
+{
+    vec3 normal = normalize(in_normal);
+    vec3 color  = indirectLightingDiffuse(normal, in_world_pos);
+
+    color += calcDirectionalLight(u_directional_light, normal, in_world_pos);
+    color += calcSpotLight(u_spot_light, normal, in_world_pos);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        color += calcPointLight(u_point_lights[i], normal, in_world_pos);
+    }
+
+    frag_color = vec4(color, 1.0);
+}
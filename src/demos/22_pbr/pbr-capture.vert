@@ -0,0 +1,31 @@
+#version 460 core
+#extension GL_ARB_shader_viewport_layer_array : enable
+
+layout (location = 0) in vec3 in_pos;
+layout (location = 1) in vec2 in_texcoord;
+layout (location = 2) in vec3 in_normal;
+
+// The faces of an IrradianceVolume's probe: u_face < 0 - an instance per face of the layered framebuffer.
+uniform mat4 u_view_projections[6];
+uniform int  u_face;
+uniform mat4 u_model;
+uniform mat3 u_normal_matrix;
+
+layout (location = 0) out vec2 out_texcoord;
+layout (location = 1) out vec3 out_world_pos;
+layout (location = 2) out vec3 out_normal;
+
+void main()
+{
+    int face = u_face < 0 ? gl_InstanceID : u_face;
+
+    out_world_pos = vec3(u_model * vec4(in_pos, 1.0));
+    out_texcoord  = in_texcoord;
+    out_normal    = u_normal_matrix * in_normal;
+
+    gl_Position = u_view_projections[face] * vec4(out_world_pos, 1.0);
+
+#ifdef GL_ARB_shader_viewport_layer_array
+    gl_Layer = face;
+#endif
+}
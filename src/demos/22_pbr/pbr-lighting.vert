@@ -1,21 +1,43 @@
 #version 460 core
+#include "../../core/core_shared.h"
+
 layout (location = 0) in vec3 in_pos;
 layout (location = 1) in vec2 in_texcoord;
 layout (location = 2) in vec3 in_normal;
 
+#ifdef INSTANCED
+// The transforms and the materials of an InstanceBatch, one instanced draw for all the objects.
+uniform mat4 u_view_projection;
+#else
 uniform mat4 u_model;
 uniform mat4 u_mvp;
 uniform mat3 u_normal_matrix;
+#endif
 
 layout (location = 0) out vec2 out_texcoord;
 layout (location = 1) out vec3 out_world_pos;
 layout (location = 2) out vec3 out_normal;
 
+#ifdef INSTANCED
+layout (location = 3) flat out uint out_material_index;
+#endif
+
 void main()
 {
+#ifdef INSTANCED
+    mat4 model = INSTANCE_DATA.model_matrix;
+
+    out_world_pos      = vec3(model * vec4(in_pos, 1.0));
+    out_texcoord       = in_texcoord;
+    out_normal         = transpose(inverse(mat3(model))) * in_normal;
+    out_material_index = INSTANCE_DATA.material_index;
+
+    gl_Position = u_view_projection * vec4(out_world_pos, 1.0);
+#else
     out_world_pos = vec3(u_model * vec4(in_pos, 1.0));
     out_texcoord  = in_texcoord;
     out_normal    = u_normal_matrix * in_normal;
 
     gl_Position = u_mvp * vec4(in_pos, 1.0);
+#endif
 }
\ No newline at end of file
@@ -11,25 +11,12 @@ PBR::PBR()
         m_spot_light_angles (90.0f, -25.0f),
         m_exposure (0.3f),
         m_gamma (3.6f),
-        m_background_lod_level(1.2),
-        m_skybox_vao(0),
-        m_skybox_vbo(0)
+        m_background_blur (0.1f)
 {
 }
 
 PBR::~PBR()
 {
-    if (m_skybox_vao != 0)
-    {
-        glDeleteVertexArrays(1, &m_skybox_vao);
-        m_skybox_vao = 0;
-    }
-
-    if (m_skybox_vbo != 0)
-    {
-        glDeleteBuffers(1, &m_skybox_vbo);
-        m_skybox_vbo = 0;
-    }
 }
 
 void PBR::init_app()
@@ -44,6 +31,7 @@ void PBR::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(-10.3, 7.6, -5.42);
     m_camera->setOrientation(glm::quat(-0.3, -0.052, -0.931, -0.165));
    
@@ -90,14 +78,11 @@ void PBR::init_app()
     m_textured_models[3].GenPQTorusKnot(256, 64, 2, 3, 0.75, 0.25);
     m_textured_models[4].GenSphere(1.0, 64);
 
-    m_textured_models_model_matrices[0] = glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 0.0,   0.0))             * glm::scale(glm::mat4(1.0), glm::vec3(6.0, 0.1, 6.0));
-    m_textured_models_model_matrices[1] = glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 2.0,   6.1)) * glm::scale(glm::mat4(1.0), glm::vec3(6.0, 2.0, 0.1));
-    m_textured_models_model_matrices[2] = glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 2.11, -3.5)) * glm::scale(glm::mat4(1.0), glm::vec3(1.0, 1.0, 1.0));
-    m_textured_models_model_matrices[3] = glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 1.21,  0.0)) * glm::scale(glm::mat4(1.0), glm::vec3(1.0, 1.0, 1.0));
-    m_textured_models_model_matrices[4] = glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 1.11,  3.5)) * glm::scale(glm::mat4(1.0), glm::vec3(1.0, 1.0, 1.0));
-
-    m_cerberus_model.Load(RGL::FileSystem::getResourcesPath() / "models/cerberus/Cerberus_LP.FBX");
-    m_cerberus_model_matrix = glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 6.0, -3.0)) * glm::rotate(glm::mat4(1.0), glm::radians(-90.0f), glm::vec3(1, 0, 0)) * glm::scale(glm::mat4(1.0), glm::vec3(10 * m_cerberus_model.GetUnitScaleFactor()));
+    m_textured_models_transforms.Add(glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 0.0,   0.0)) * glm::scale(glm::mat4(1.0), glm::vec3(6.0, 0.1, 6.0)));
+    m_textured_models_transforms.Add(glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 2.0,   6.1)) * glm::scale(glm::mat4(1.0), glm::vec3(6.0, 2.0, 0.1)));
+    m_textured_models_transforms.Add(glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 2.11, -3.5)) * glm::scale(glm::mat4(1.0), glm::vec3(1.0, 1.0, 1.0)));
+    m_textured_models_transforms.Add(glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 1.21,  0.0)) * glm::scale(glm::mat4(1.0), glm::vec3(1.0, 1.0, 1.0)));
+    m_textured_models_transforms.Add(glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 1.11,  3.5)) * glm::scale(glm::mat4(1.0), glm::vec3(1.0, 1.0, 1.0)));
 
     /* Set model matrices for each model. */
     uint8_t num_rows = 7;
@@ -109,126 +94,136 @@ void PBR::init_app()
         for (int col = 0; col < num_cols; ++col)
         {
             glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3((col - (num_cols / 2)) * spacing, (row - (num_rows/ 2)) * spacing, 0.0f));
-            m_objects_model_matrices.emplace_back(model);
+
+            auto material = std::make_unique<RGL::Material>();
+            material->SetAlbedo   (glm::vec3(0.5f, 0.0f, 0.0f));
+            material->SetMetallic (float(row) / 7.0f);
+            material->SetRoughness(glm::clamp(float(col) / 7.0f, 0.05f, 1.0f));
+
+            m_spheres_batch.Add(model, material->GetIndex());
+            m_sphere_materials.push_back(std::move(material));
         }
     }
 
-    /* Add textures to the objects. */
-    auto concrete_albedo_map    = std::make_shared<RGL::Texture2D>(); concrete_albedo_map   ->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/concrete034_1k/concrete034_1K_color.png", true);
-    auto concrete_normal_map    = std::make_shared<RGL::Texture2D>(); concrete_normal_map   ->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/concrete034_1k/concrete034_1K_normal.png");
-    auto concrete_metallic_map  = std::make_shared<RGL::Texture2D>(); concrete_metallic_map ->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/concrete034_1k/concrete034_1K_metallic.png");
-    auto concrete_roughness_map = std::make_shared<RGL::Texture2D>(); concrete_roughness_map->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/concrete034_1k/concrete034_1K_roughness.png");
-    auto concrete_ao_map        = std::make_shared<RGL::Texture2D>(); concrete_ao_map       ->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/concrete034_1k/concrete034_1K_ao.png");
-
-    auto plastic_albedo_map    = std::make_shared<RGL::Texture2D>(); plastic_albedo_map   ->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/plastic008_1k/plastic008_1K_color.png", true);
-    auto plastic_normal_map    = std::make_shared<RGL::Texture2D>(); plastic_normal_map   ->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/plastic008_1k/plastic008_1K_normal.png");
-    auto plastic_metallic_map  = std::make_shared<RGL::Texture2D>(); plastic_metallic_map ->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/plastic008_1k/plastic008_1K_metallic.png");
-    auto plastic_roughness_map = std::make_shared<RGL::Texture2D>(); plastic_roughness_map->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/plastic008_1k/plastic008_1K_roughness.png");
-    auto plastic_ao_map        = std::make_shared<RGL::Texture2D>(); plastic_ao_map       ->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/plastic008_1k/plastic008_1K_ao.png");
-
-    auto gold_albedo_map    = std::make_shared<RGL::Texture2D>(); gold_albedo_map   ->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/gold-scuffed-bl/gold-scuffed_albedo.png", true);
-    auto gold_normal_map    = std::make_shared<RGL::Texture2D>(); gold_normal_map   ->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/gold-scuffed-bl/gold-scuffed_normal-ogl.png");
-    auto gold_metallic_map  = std::make_shared<RGL::Texture2D>(); gold_metallic_map ->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/gold-scuffed-bl/gold-scuffed_metallic.png");
-    auto gold_roughness_map = std::make_shared<RGL::Texture2D>(); gold_roughness_map->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/gold-scuffed-bl/gold-scuffed_roughness.png");
-    auto gold_ao_map        = std::make_shared<RGL::Texture2D>(); gold_ao_map       ->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/gold-scuffed-bl/gold-scuffed_metallic.png");
-
-    auto granite_albedo_map    = std::make_shared<RGL::Texture2D>(); granite_albedo_map   ->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/fleshy-granite1-bl/fleshy_granite1_albedo.png", true);
-    auto granite_normal_map    = std::make_shared<RGL::Texture2D>(); granite_normal_map   ->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/fleshy-granite1-bl/fleshy_granite1_normal-ogl.png");
-    auto granite_metallic_map  = std::make_shared<RGL::Texture2D>(); granite_metallic_map ->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/fleshy-granite1-bl/fleshy_granite1_metallic.png");
-    auto granite_roughness_map = std::make_shared<RGL::Texture2D>(); granite_roughness_map->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/fleshy-granite1-bl/fleshy_granite1_roughness.png");
-    auto granite_ao_map        = std::make_shared<RGL::Texture2D>(); granite_ao_map       ->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/fleshy-granite1-bl/fleshy_granite1_ao.png");
-
-    m_textured_models[0].AddTexture(concrete_albedo_map,    RGL::Material::TextureType::ALBEDO);
-    m_textured_models[0].AddTexture(concrete_normal_map,    RGL::Material::TextureType::NORMAL);
-    m_textured_models[0].AddTexture(concrete_metallic_map,  RGL::Material::TextureType::METALLIC);
-    m_textured_models[0].AddTexture(concrete_roughness_map, RGL::Material::TextureType::ROUGHNESS);
-    m_textured_models[0].AddTexture(concrete_ao_map,        RGL::Material::TextureType::AO);
-
-    m_textured_models[1].AddTexture(concrete_albedo_map,    RGL::Material::TextureType::ALBEDO);
-    m_textured_models[1].AddTexture(concrete_normal_map,    RGL::Material::TextureType::NORMAL);
-    m_textured_models[1].AddTexture(concrete_metallic_map,  RGL::Material::TextureType::METALLIC);
-    m_textured_models[1].AddTexture(concrete_roughness_map, RGL::Material::TextureType::ROUGHNESS);
-    m_textured_models[1].AddTexture(concrete_ao_map,        RGL::Material::TextureType::AO);
-
-    m_textured_models[2].AddTexture(plastic_albedo_map,    RGL::Material::TextureType::ALBEDO);
-    m_textured_models[2].AddTexture(plastic_normal_map,    RGL::Material::TextureType::NORMAL);
-    m_textured_models[2].AddTexture(plastic_metallic_map,  RGL::Material::TextureType::METALLIC);
-    m_textured_models[2].AddTexture(plastic_roughness_map, RGL::Material::TextureType::ROUGHNESS);
-    m_textured_models[2].AddTexture(plastic_ao_map,        RGL::Material::TextureType::AO);
-    
-    m_textured_models[3].AddTexture(gold_albedo_map,    RGL::Material::TextureType::ALBEDO);
-    m_textured_models[3].AddTexture(gold_normal_map,    RGL::Material::TextureType::NORMAL);
-    m_textured_models[3].AddTexture(gold_metallic_map,  RGL::Material::TextureType::METALLIC);
-    m_textured_models[3].AddTexture(gold_roughness_map, RGL::Material::TextureType::ROUGHNESS);
-    m_textured_models[3].AddTexture(gold_ao_map,        RGL::Material::TextureType::AO);
-
-    m_textured_models[4].AddTexture(granite_albedo_map,    RGL::Material::TextureType::ALBEDO);
-    m_textured_models[4].AddTexture(granite_normal_map,    RGL::Material::TextureType::NORMAL);
-    m_textured_models[4].AddTexture(granite_metallic_map,  RGL::Material::TextureType::METALLIC);
-    m_textured_models[4].AddTexture(granite_roughness_map, RGL::Material::TextureType::ROUGHNESS);
-    m_textured_models[4].AddTexture(granite_ao_map,        RGL::Material::TextureType::AO);
-
-    auto cerberus_albedo_map    = std::make_shared<RGL::Texture2D>(); cerberus_albedo_map   ->Load(RGL::FileSystem::getResourcesPath() / "models/cerberus/Textures/Cerberus_A.tga");
-    auto cerberus_normal_map    = std::make_shared<RGL::Texture2D>(); cerberus_normal_map   ->Load(RGL::FileSystem::getResourcesPath() / "models/cerberus/Textures/Cerberus_N.tga");
-    auto cerberus_metallic_map  = std::make_shared<RGL::Texture2D>(); cerberus_metallic_map ->Load(RGL::FileSystem::getResourcesPath() / "models/cerberus/Textures/Cerberus_M.tga");
-    auto cerberus_roughness_map = std::make_shared<RGL::Texture2D>(); cerberus_roughness_map->Load(RGL::FileSystem::getResourcesPath() / "models/cerberus/Textures/Cerberus_R.tga");
-
-    m_cerberus_model.AddTexture(cerberus_albedo_map,    RGL::Material::TextureType::ALBEDO);
-    m_cerberus_model.AddTexture(cerberus_normal_map,    RGL::Material::TextureType::NORMAL);
-    m_cerberus_model.AddTexture(cerberus_metallic_map,  RGL::Material::TextureType::METALLIC);
-    m_cerberus_model.AddTexture(cerberus_roughness_map, RGL::Material::TextureType::ROUGHNESS);
-
-    /* Create shader. */
-    std::string dir = "src/demos/22_pbr/";
-    m_ambient_light_shader = std::make_shared<RGL::Shader>(dir + "pbr-lighting.vert", dir + "pbr-ambient.frag");
-    m_ambient_light_shader->link();
+    /*
+     * The maps are decoded by the workers while the first frames are drawn - a scene shows up once its maps are ready.
+     * The current scene is requested, the pistol is preloaded after it as the likely next one.
+     */
+    const RGL::Material::TextureType map_types[] = { RGL::Material::TextureType::ALBEDO,
+                                                     RGL::Material::TextureType::NORMAL,
+                                                     RGL::Material::TextureType::METALLIC,
+                                                     RGL::Material::TextureType::ROUGHNESS,
+                                                     RGL::Material::TextureType::AO };
+
+    /* In the order of map_types. */
+    auto load_maps = [](const std::filesystem::path& directory, std::initializer_list<std::string> filenames, bool is_albedo_srgb)
+    {
+        std::vector<std::shared_ptr<RGL::LazyTexture>> maps;
 
-    m_directional_light_shader = std::make_shared<RGL::Shader>(dir + "pbr-lighting.vert", dir + "pbr-directional.frag");
-    m_directional_light_shader->link();
+        for (auto& filename : filenames)
+        {
+            maps.push_back(std::make_shared<RGL::LazyTexture>(RGL::FileSystem::getResourcesPath() / directory / filename, maps.empty() && is_albedo_srgb));
+        }
 
-    m_point_light_shader = std::make_shared<RGL::Shader>(dir + "pbr-lighting.vert", dir + "pbr-point.frag");
-    m_point_light_shader->link();
+        return maps;
+    };
 
-    m_spot_light_shader = std::make_shared<RGL::Shader>(dir + "pbr-lighting.vert", dir + "pbr-spot.frag");
-    m_spot_light_shader->link();
+    auto concrete_maps = load_maps("textures/pbr/concrete034_1k",     { "concrete034_1K_color.png", "concrete034_1K_normal.png", "concrete034_1K_metallic.png", "concrete034_1K_roughness.png", "concrete034_1K_ao.png" }, true);
+    auto plastic_maps  = load_maps("textures/pbr/plastic008_1k",      { "plastic008_1K_color.png", "plastic008_1K_normal.png", "plastic008_1K_metallic.png", "plastic008_1K_roughness.png", "plastic008_1K_ao.png" }, true);
+    auto gold_maps     = load_maps("textures/pbr/gold-scuffed-bl",    { "gold-scuffed_albedo.png", "gold-scuffed_normal-ogl.png", "gold-scuffed_metallic.png", "gold-scuffed_roughness.png", "gold-scuffed_metallic.png" }, true);
+    auto granite_maps  = load_maps("textures/pbr/fleshy-granite1-bl", { "fleshy_granite1_albedo.png", "fleshy_granite1_normal-ogl.png", "fleshy_granite1_metallic.png", "fleshy_granite1_roughness.png", "fleshy_granite1_ao.png" }, true);
+    auto cerberus_maps = load_maps("models/cerberus/Textures",        { "Cerberus_A.tga", "Cerberus_N.tga", "Cerberus_M.tga", "Cerberus_R.tga" }, false);
 
-    m_equirectangular_to_cubemap_shader = std::make_shared<RGL::Shader>(dir + "cubemap.vert", dir + "equirectangular_to_cubemap.frag");
-    m_equirectangular_to_cubemap_shader->link();
+    m_textured_scene = std::make_shared<RGL::LazyResource>("textured scene");
 
-    m_irradiance_convolution_shader = std::make_shared<RGL::Shader>(dir + "cubemap.vert", dir + "irradiance_convolution.frag");
-    m_irradiance_convolution_shader->link();
+    for (auto& maps : { concrete_maps, plastic_maps, gold_maps, granite_maps })
+    {
+        for (auto& map : maps)
+        {
+            m_textured_scene->AddDependency(map);
+        }
+    }
 
-    m_prefilter_env_map_shader = std::make_shared<RGL::Shader>(dir + "cubemap.vert", dir + "prefilter_cubemap.frag");
-    m_prefilter_env_map_shader->link();
+    std::vector<std::shared_ptr<RGL::LazyTexture>> textured_models_maps[] = { concrete_maps, concrete_maps, plastic_maps, gold_maps, granite_maps };
 
-    m_precompute_brdf = std::make_shared<RGL::Shader>("src/demos/10_postprocessing_filters/FSQ.vert", dir + "precompute_brdf.frag");
-    m_precompute_brdf->link();
+    m_textured_scene->SetOnReady([this, textured_models_maps, map_types]
+    {
+        for (uint32_t i = 0; i < std::size(m_textured_models); ++i)
+        {
+            for (uint32_t m = 0; m < std::size(map_types); ++m)
+            {
+                m_textured_models[i].AddTexture(textured_models_maps[i][m]->Get(), map_types[m]);
+            }
+        }
+    });
 
-    m_background_shader = std::make_shared<RGL::Shader>(dir + "background.vert", dir + "background.frag");
-    m_background_shader->link();
+    m_cerberus_model = std::make_shared<RGL::LazyModel>(RGL::FileSystem::getResourcesPath() / "models/cerberus/Cerberus_LP.FBX");
 
-    m_tmo_ps = std::make_shared<PostprocessFilter>(RGL::Window::getWidth(), RGL::Window::getHeight());
+    for (auto& map : cerberus_maps)
+    {
+        m_cerberus_model->AddDependency(map);
+    }
 
-    // IBL precomputations
-    GenSkyboxGeometry();
+    m_cerberus_model->SetOnReady([this, cerberus_maps, map_types]
+    {
+        RGL::StaticModel& model = *m_cerberus_model->GetModel();
+
+        for (uint32_t m = 0; m < cerberus_maps.size(); ++m)
+        {
+            model.AddTexture(cerberus_maps[m]->Get(), map_types[m]);
+        }
+
+        m_cerberus_model_matrix = glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 6.0, -3.0)) * glm::rotate(glm::mat4(1.0), glm::radians(-90.0f), glm::vec3(1, 0, 0)) * glm::scale(glm::mat4(1.0), glm::vec3(10 * model.GetUnitScaleFactor()));
+    });
+
+    m_textured_scene->Request();
+    RGL::ResourcePreloader::Preload(m_cerberus_model);
+
+    /* Create shader. All the programs are compiled in parallel, if the driver supports it. */
+    std::string dir = "src/demos/22_pbr/";
+
+    /* The variants of the materials' maps, in the order of MaterialFeature's bits. */
+    const std::vector<std::string> material_features = { "HAS_ALBEDO_MAP", "HAS_NORMAL_MAP", "HAS_METALLIC_MAP", "HAS_ROUGHNESS_MAP", "HAS_AO_MAP", "HAS_EMISSIVE_MAP", "INSTANCED" };
+
+    auto create_shaders = [&](const std::string& fragment_filepath)
+    {
+        auto create_shader = [=] { return std::make_shared<RGL::Shader>(dir + "pbr-lighting.vert", dir + fragment_filepath); };
+
+        auto shaders = std::make_shared<RGL::ShaderPermutations>(create_shader, material_features);
+        shaders->SetDefine("MATERIAL_VARIANTS");
+
+        return shaders;
+    };
+
+    m_ambient_light_shaders     = create_shaders("pbr-ambient.frag");
+    m_directional_light_shaders = create_shaders("pbr-directional.frag");
+    m_point_light_shaders       = create_shaders("pbr-point.frag");
+    m_spot_light_shaders        = create_shaders("pbr-spot.frag");
+
+    /* The variants of the scenes, linked concurrently. */
+    constexpr uint64_t textured_mask = HAS_ALBEDO_MAP | HAS_NORMAL_MAP | HAS_METALLIC_MAP | HAS_ROUGHNESS_MAP;
 
-    m_env_cubemap_rt = std::make_shared<CubeMapRenderTarget>();
-    m_env_cubemap_rt->set_position(glm::vec3(0.0));
-    m_env_cubemap_rt->generate_rt(2048, 2048, true);
+    m_ambient_light_shaders->Prepare({ INSTANCED, textured_mask, textured_mask | HAS_AO_MAP });
 
-    m_irradiance_cubemap_rt = std::make_shared<CubeMapRenderTarget>();
-    m_irradiance_cubemap_rt->set_position(glm::vec3(0.0));
-    m_irradiance_cubemap_rt->generate_rt(32, 32);
+    for (auto& shaders : { m_directional_light_shaders, m_point_light_shaders, m_spot_light_shaders })
+    {
+        shaders->Prepare({ INSTANCED, textured_mask });
+    }
+
+    m_tmo_ps = std::make_shared<PostprocessFilter>();
+    m_skybox.Create();
+    m_msaa.Create();
 
-    m_prefiltered_env_map_rt = std::make_shared<CubeMapRenderTarget>();
-    m_prefiltered_env_map_rt->set_position(glm::vec3(0.0));
-    m_prefiltered_env_map_rt->generate_rt(512, 512, true);
+    // IBL precomputations
+    m_ibl.Create();
+    m_ibl.Load(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx]);
 
-    m_brdf_lut_rt = std::make_shared<Texture2DRenderTarget>();
-    m_brdf_lut_rt->generate_rt(512, 512);
+    /* A probe about every 2 units over the floor of the textured scene, in front of its wall and up to its top. */
+    m_capture_shader = std::make_shared<RGL::Shader>(dir + "pbr-capture.vert", dir + "pbr-capture.frag");
+    m_capture_shader->link();
 
-    PrecomputeIndirectLight(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx]);
-    PrecomputeBRDF(m_brdf_lut_rt);
+    m_irradiance_volume.Create(glm::vec3(-12.0f, 4.25f, -6.0f), glm::vec3(0.0f, 8.25f, 5.75f), glm::uvec3(7, 3, 7));
+    m_irradiance_volume.SetEnvironmentMap(m_ibl.GetEnvironmentMap());
 }
 
 void PBR::input()
@@ -287,221 +282,22 @@ void PBR::update(double delta_time)
     m_camera->update(delta_time);
 }
 
-void PBR::HdrEquirectangularToCubemap(const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt, const std::shared_ptr<RGL::Texture2D>& m_equirectangular_map)
-{
-    /* Update all faces per frame */
-    m_equirectangular_to_cubemap_shader->bind();
-    m_equirectangular_to_cubemap_shader->setUniform("u_projection", cubemap_rt->m_projection);
-
-    glViewport(0, 0, cubemap_rt->m_width, cubemap_rt->m_height);
-    glBindFramebuffer(GL_FRAMEBUFFER, cubemap_rt->m_fbo_id);
-    m_equirectangular_map->Bind(1);
-
-    for (uint8_t side = 0; side < 6; ++side)
-    {
-        m_equirectangular_to_cubemap_shader->setUniform("u_view", cubemap_rt->m_view_transforms[side]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, cubemap_rt->m_cubemap_texture_id, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        glBindVertexArray(m_skybox_vao);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-    }
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
-}
-
-void PBR::IrradianceConvolution(const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt)
-{
-    /* Update all faces per frame */
-    m_irradiance_convolution_shader->bind();
-    m_irradiance_convolution_shader->setUniform("u_projection", cubemap_rt->m_projection);
-
-    glViewport(0, 0, cubemap_rt->m_width, cubemap_rt->m_height);
-    glBindFramebuffer(GL_FRAMEBUFFER, cubemap_rt->m_fbo_id);
-    m_env_cubemap_rt->bindTexture(1);
-
-    for (uint8_t side = 0; side < 6; ++side)
-    {
-        m_irradiance_convolution_shader->setUniform("u_view", cubemap_rt->m_view_transforms[side]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, cubemap_rt->m_cubemap_texture_id, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        glBindVertexArray(m_skybox_vao);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-    }
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
-}
-
-void PBR::PrefilterCubemap(const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt)
-{
-    m_prefilter_env_map_shader->bind();
-    m_prefilter_env_map_shader->setUniform("u_projection", cubemap_rt->m_projection);
-    
-    m_env_cubemap_rt->bindTexture(1);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, cubemap_rt->m_fbo_id);
-
-    uint8_t max_mip_levels = glm::log2(float(cubemap_rt->m_width));
-    for (uint8_t mip = 0; mip < max_mip_levels; ++mip)
-    {
-        // resize the framebuffer according to mip-level size.
-        uint32_t mip_width  = cubemap_rt->m_width  * std::pow(0.5, mip);
-        uint32_t mip_height = cubemap_rt->m_height * std::pow(0.5, mip);
-
-        glBindRenderbuffer(GL_RENDERBUFFER, cubemap_rt->m_rbo_id);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mip_width, mip_height);
-        glViewport(0, 0, mip_width, mip_height);
-
-        float roughness = float(mip) / float(max_mip_levels - 1);
-        m_prefilter_env_map_shader->setUniform("u_roughness", roughness);
-
-        for (uint8_t side = 0; side < 6; ++side)
-        {
-            m_prefilter_env_map_shader->setUniform("u_view", cubemap_rt->m_view_transforms[side]);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, cubemap_rt->m_cubemap_texture_id, mip);
-
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            glBindVertexArray(m_skybox_vao);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-        }
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
-}
-
-void PBR::PrecomputeIndirectLight(const std::filesystem::path& hdri_map_filepath)
-{
-    auto envmap_hdr = std::make_shared<RGL::Texture2D>();
-    envmap_hdr->LoadHdr(hdri_map_filepath);
-    auto envmap_metadata = envmap_hdr->GetMetadata();
-
-    HdrEquirectangularToCubemap(m_env_cubemap_rt, envmap_hdr);
-
-    glBindTexture(GL_TEXTURE_CUBE_MAP, m_env_cubemap_rt->m_cubemap_texture_id);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-
-    IrradianceConvolution(m_irradiance_cubemap_rt);
-    PrefilterCubemap(m_prefiltered_env_map_rt);
-}
-
-void PBR::PrecomputeBRDF(const std::shared_ptr<Texture2DRenderTarget>& rt)
-{
-    GLuint m_dummy_vao_id;
-    glCreateVertexArrays(1, &m_dummy_vao_id);
-
-    rt->bindRenderTarget();
-    m_precompute_brdf->bind();
-
-    glBindVertexArray(m_dummy_vao_id);
-    glDrawArrays(GL_TRIANGLES, 0, 3);
-
-    glDeleteVertexArrays(1, &m_dummy_vao_id);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
-}
-
-void PBR::GenSkyboxGeometry()
-{
-    m_skybox_vao = 0;
-    m_skybox_vbo = 0;
-
-    glCreateVertexArrays(1, &m_skybox_vao);
-    glCreateBuffers(1, &m_skybox_vbo);
-
-    std::vector<float> skybox_positions = {
-        // positions          
-        -1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
-        // front face
-        -1.0f, -1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-        // left face
-        -1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-        // right face
-         1.0f,  1.0f,  1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-        // bottom face
-        -1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f, -1.0f,
-        // top face
-        -1.0f,  1.0f, -1.0f,
-         1.0f,  1.0f , 1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f,  1.0f,  1.0f,
-    };
-
-    /* Set up buffer objects */
-    glNamedBufferStorage(m_skybox_vbo, skybox_positions.size() * sizeof(skybox_positions[0]), skybox_positions.data(), 0 /*flags*/);
-
-    /* Set up VAO */
-    glEnableVertexArrayAttrib(m_skybox_vao, 0 /*index*/);
-
-    /* Separate attribute format */
-    glVertexArrayAttribFormat(m_skybox_vao, 0 /*index*/, 3 /*size*/, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/);
-    glVertexArrayAttribBinding(m_skybox_vao, 0 /*index*/, 0 /*bindingindex*/);
-    glVertexArrayVertexBuffer(m_skybox_vao, 0 /*bindingindex*/, m_skybox_vbo, 0 /*offset*/, sizeof(glm::vec3) /*stride*/);
-}
-
 void PBR::RenderSpheres()
 {
-    m_ambient_light_shader->bind();
-    m_ambient_light_shader->setUniform("u_cam_pos", m_camera->position());
-    m_ambient_light_shader->setUniform("u_albedo",  glm::vec3(0.5, 0.0, 0.0f));
-    m_ambient_light_shader->setUniform("u_ao",      1.0f);
-
-    m_ambient_light_shader->setUniform("u_has_albedo_map",    false);
-    m_ambient_light_shader->setUniform("u_has_normal_map",    false);
-    m_ambient_light_shader->setUniform("u_has_metallic_map",  false);
-    m_ambient_light_shader->setUniform("u_has_roughness_map", false);
-    m_ambient_light_shader->setUniform("u_has_ao_map",        false);
-    m_ambient_light_shader->setUniform("u_has_emissive_map",  false);
+    /* The materials of the spheres are fetched by the instances' material indices. */
+    RGL::Material::BindMaterials();
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+    RGL::Shader& ambient_shader = m_ambient_light_shaders->Get(INSTANCED);
+    ambient_shader.bind();
+    ambient_shader.setUniform("u_cam_pos",         m_camera->position());
+    ambient_shader.setUniform("u_view_projection", m_camera->viewProjection());
 
     /* First, render the ambient color only for the opaque objects. */
-    m_irradiance_cubemap_rt->bindTexture(6);
-    m_prefiltered_env_map_rt->bindTexture(7);
-    m_brdf_lut_rt->bindTexture(8);
-
-    for (unsigned row = 0; row < 7; ++row)
-    {
-        m_ambient_light_shader->setUniform("u_metallic", float(row)/7.0f);
-        for (unsigned col = 0; col < 7; ++col)
-        {
-            m_ambient_light_shader->setUniform("u_roughness", glm::clamp(float(col) / 7.0f, 0.05f, 1.0f));
-
-            uint32_t idx = col + row * 7;
-            m_ambient_light_shader->setUniform("u_model",         m_objects_model_matrices[idx]);
-            m_ambient_light_shader->setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_objects_model_matrices[idx]))));
-            m_ambient_light_shader->setUniform("u_mvp",           view_projection * m_objects_model_matrices[idx]);
+    m_ibl.BindIrradianceSH();
+    m_ibl.BindPrefilteredMap(7);
+    m_ibl.BindBrdfLut(8);
 
-            m_sphere_model.Render();
-        }
-    }
+    m_spheres_batch.Render(m_sphere_model);
 
     /*
      * Disable writing to the depth buffer and additively
@@ -513,98 +309,47 @@ void PBR::RenderSpheres()
     glDepthFunc(GL_EQUAL);
 
     /* Render directional light(s) */
-    m_directional_light_shader->bind();
-    m_directional_light_shader->setUniform("u_albedo",            glm::vec3(0.5, 0.0, 0.0f));
-    m_directional_light_shader->setUniform("u_cam_pos",           m_camera->position());
-    m_directional_light_shader->setUniform("u_has_albedo_map",    false);
-    m_directional_light_shader->setUniform("u_has_normal_map",    false);
-    m_directional_light_shader->setUniform("u_has_metallic_map",  false);
-    m_directional_light_shader->setUniform("u_has_roughness_map", false);
-
-    m_directional_light_shader->setUniform("u_directional_light.base.color",     m_dir_light_properties.color);
-    m_directional_light_shader->setUniform("u_directional_light.base.intensity", m_dir_light_properties.intensity);
-    m_directional_light_shader->setUniform("u_directional_light.direction",      m_dir_light_properties.direction);
-
-    for (unsigned row = 0; row < 7; ++row)
-    {
-        m_directional_light_shader->setUniform("u_metallic", float(row) / 7.0f);
-        for (unsigned col = 0; col < 7; ++col)
-        {
-            m_directional_light_shader->setUniform("u_roughness", glm::clamp(float(col) / 7.0f, 0.05f, 1.0f));
+    RGL::Shader& directional_shader = m_directional_light_shaders->Get(INSTANCED);
+    directional_shader.bind();
+    directional_shader.setUniform("u_cam_pos",         m_camera->position());
+    directional_shader.setUniform("u_view_projection", m_camera->viewProjection());
 
-            uint32_t idx = col + row * 7;
-            m_directional_light_shader->setUniform("u_model",         m_objects_model_matrices[idx]);
-            m_directional_light_shader->setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_objects_model_matrices[idx]))));
-            m_directional_light_shader->setUniform("u_mvp",           view_projection * m_objects_model_matrices[idx]);
+    directional_shader.setUniform("u_directional_light.base.color",     m_dir_light_properties.color);
+    directional_shader.setUniform("u_directional_light.base.intensity", m_dir_light_properties.intensity);
+    directional_shader.setUniform("u_directional_light.direction",      m_dir_light_properties.direction);
 
-            m_sphere_model.Render();
-        }
-    }
+    m_spheres_batch.Render(m_sphere_model);
 
     /* Render point lights */
-    m_point_light_shader->bind();
-    m_point_light_shader->setUniform("u_albedo",            glm::vec3(0.5, 0.0, 0.0f));
-    m_point_light_shader->setUniform("u_cam_pos",           m_camera->position());
-    m_point_light_shader->setUniform("u_has_albedo_map",    false);
-    m_point_light_shader->setUniform("u_has_normal_map",    false);
-    m_point_light_shader->setUniform("u_has_metallic_map",  false);
-    m_point_light_shader->setUniform("u_has_roughness_map", false);
+    RGL::Shader& point_shader = m_point_light_shaders->Get(INSTANCED);
+    point_shader.bind();
+    point_shader.setUniform("u_cam_pos",         m_camera->position());
+    point_shader.setUniform("u_view_projection", m_camera->viewProjection());
 
     for(uint8_t p = 0; p < std::size(m_point_light_properties); ++p)
     {
-        m_point_light_shader->setUniform("u_point_light.base.color",      m_point_light_properties[p].color);
-        m_point_light_shader->setUniform("u_point_light.base.intensity",  m_point_light_properties[p].intensity);
-        m_point_light_shader->setUniform("u_point_light.position",        m_point_light_properties[p].position);
-        m_point_light_shader->setUniform("u_point_light.radius",          m_point_light_properties[p].radius);
-
-        for (unsigned row = 0; row < 7; ++row)
-        {
-            m_point_light_shader->setUniform("u_metallic", float(row)/7.0f);
-            for (unsigned col = 0; col < 7; ++col)
-            {
-                m_point_light_shader->setUniform("u_roughness",     glm::clamp(float(col) / 7.0f, 0.05f, 1.0f));
+        point_shader.setUniform("u_point_light.base.color",      m_point_light_properties[p].color);
+        point_shader.setUniform("u_point_light.base.intensity",  m_point_light_properties[p].intensity);
+        point_shader.setUniform("u_point_light.position",        m_point_light_properties[p].position);
+        point_shader.setUniform("u_point_light.radius",          m_point_light_properties[p].radius);
 
-                uint32_t idx = col + row * 7;
-                m_point_light_shader->setUniform("u_model",         m_objects_model_matrices[idx]);
-                m_point_light_shader->setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_objects_model_matrices[idx]))));
-                m_point_light_shader->setUniform("u_mvp",           view_projection * m_objects_model_matrices[idx]);
-
-                m_sphere_model.Render();
-            }
-        }
+        m_spheres_batch.Render(m_sphere_model);
     }
     /* Render spot lights */
-    m_spot_light_shader->bind();
-    m_spot_light_shader->setUniform("u_albedo",            glm::vec3(0.5, 0.0, 0.0f));
-    m_spot_light_shader->setUniform("u_cam_pos",           m_camera->position());
-    m_spot_light_shader->setUniform("u_has_albedo_map",    false);
-    m_spot_light_shader->setUniform("u_has_normal_map",    false);
-    m_spot_light_shader->setUniform("u_has_metallic_map",  false);
-    m_spot_light_shader->setUniform("u_has_roughness_map", false);
-
-    m_spot_light_shader->setUniform("u_spot_light.point.base.color",      m_spot_light_properties.color);
-    m_spot_light_shader->setUniform("u_spot_light.point.base.intensity",  m_spot_light_properties.intensity);
-    m_spot_light_shader->setUniform("u_spot_light.point.position",        m_spot_light_properties.position);
-    m_spot_light_shader->setUniform("u_spot_light.point.radius",          m_spot_light_properties.radius);
-    m_spot_light_shader->setUniform("u_spot_light.direction",             m_spot_light_properties.direction);
-    m_spot_light_shader->setUniform("u_spot_light.inner_angle",           glm::radians(m_spot_light_properties.inner_angle));
-    m_spot_light_shader->setUniform("u_spot_light.outer_angle",           glm::radians(m_spot_light_properties.outer_angle));
-
-    for (unsigned row = 0; row < 7; ++row)
-    {
-        m_spot_light_shader->setUniform("u_metallic", float(row) / 7.0f);
-        for (unsigned col = 0; col < 7; ++col)
-        {
-            m_spot_light_shader->setUniform("u_roughness", glm::clamp(float(col) / 7.0f, 0.05f, 1.0f));
+    RGL::Shader& spot_shader = m_spot_light_shaders->Get(INSTANCED);
+    spot_shader.bind();
+    spot_shader.setUniform("u_cam_pos",         m_camera->position());
+    spot_shader.setUniform("u_view_projection", m_camera->viewProjection());
 
-            uint32_t idx = col + row * 7;
-            m_spot_light_shader->setUniform("u_model",         m_objects_model_matrices[idx]);
-            m_spot_light_shader->setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_objects_model_matrices[idx]))));
-            m_spot_light_shader->setUniform("u_mvp",           view_projection * m_objects_model_matrices[idx]);
+    spot_shader.setUniform("u_spot_light.point.base.color",      m_spot_light_properties.color);
+    spot_shader.setUniform("u_spot_light.point.base.intensity",  m_spot_light_properties.intensity);
+    spot_shader.setUniform("u_spot_light.point.position",        m_spot_light_properties.position);
+    spot_shader.setUniform("u_spot_light.point.radius",          m_spot_light_properties.radius);
+    spot_shader.setUniform("u_spot_light.direction",             m_spot_light_properties.direction);
+    spot_shader.setUniform("u_spot_light.inner_angle",           glm::radians(m_spot_light_properties.inner_angle));
+    spot_shader.setUniform("u_spot_light.outer_angle",           glm::radians(m_spot_light_properties.outer_angle));
 
-            m_sphere_model.Render();
-        }
-    }
+    m_spheres_batch.Render(m_sphere_model);
 
     /* Enable writing to the depth buffer. */
     glDepthMask(GL_TRUE);
@@ -614,27 +359,23 @@ void PBR::RenderSpheres()
 
 void PBR::RenderTexturedModels()
 {
-    m_ambient_light_shader->bind();
-    m_ambient_light_shader->setUniform("u_cam_pos",           m_camera->position());
-    m_ambient_light_shader->setUniform("u_has_albedo_map",    true);
-    m_ambient_light_shader->setUniform("u_has_normal_map",    true);
-    m_ambient_light_shader->setUniform("u_has_metallic_map",  true);
-    m_ambient_light_shader->setUniform("u_has_roughness_map", true);
-    m_ambient_light_shader->setUniform("u_has_ao_map",        true);
-    m_ambient_light_shader->setUniform("u_has_emissive_map",  false);
+    RGL::Shader& ambient_shader = m_ambient_light_shaders->Get(HAS_ALBEDO_MAP | HAS_NORMAL_MAP | HAS_METALLIC_MAP | HAS_ROUGHNESS_MAP | HAS_AO_MAP);
+    ambient_shader.bind();
+    ambient_shader.setUniform("u_cam_pos", m_camera->position());
+
+    ambient_shader.setUniform("u_use_irradiance_volume", m_use_irradiance_volume);
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+    m_textured_models_transforms.Update(m_camera->viewProjection());
 
     /* First, render the ambient color only for the opaque objects. */
-    m_irradiance_cubemap_rt->bindTexture(6);
-    m_prefiltered_env_map_rt->bindTexture(7);
-    m_brdf_lut_rt->bindTexture(8);
+    m_ibl.BindIrradianceSH();
+    m_ibl.BindPrefilteredMap(7);
+    m_ibl.BindBrdfLut(8);
+    m_irradiance_volume.Bind();
 
-    for (uint32_t i = 0; i < std::size(m_textured_models_model_matrices); ++i)
+    for (uint32_t i = 0; i < std::size(m_textured_models); ++i)
     {
-        m_ambient_light_shader->setUniform("u_model",         m_textured_models_model_matrices[i]);
-        m_ambient_light_shader->setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_textured_models_model_matrices[i]))));
-        m_ambient_light_shader->setUniform("u_mvp",           view_projection * m_textured_models_model_matrices[i]);
+        m_textured_models_transforms.SetUniforms(ambient_shader, i);
 
         m_textured_models[i].Render();
     }
@@ -649,72 +390,57 @@ void PBR::RenderTexturedModels()
     glDepthFunc(GL_EQUAL);
 
     /* Render directional light(s) */
-    m_directional_light_shader->bind();
-    m_directional_light_shader->setUniform("u_cam_pos",           m_camera->position());
-    m_directional_light_shader->setUniform("u_has_albedo_map",    true);
-    m_directional_light_shader->setUniform("u_has_normal_map",    true);
-    m_directional_light_shader->setUniform("u_has_metallic_map",  true);
-    m_directional_light_shader->setUniform("u_has_roughness_map", true);
-
-    m_directional_light_shader->setUniform("u_directional_light.base.color",     m_dir_light_properties.color);
-    m_directional_light_shader->setUniform("u_directional_light.base.intensity", m_dir_light_properties.intensity);
-    m_directional_light_shader->setUniform("u_directional_light.direction",      m_dir_light_properties.direction);
-
-    for (unsigned i = 0; i < std::size(m_textured_models_model_matrices); ++i)
+    RGL::Shader& directional_shader = m_directional_light_shaders->Get(HAS_ALBEDO_MAP | HAS_NORMAL_MAP | HAS_METALLIC_MAP | HAS_ROUGHNESS_MAP);
+    directional_shader.bind();
+    directional_shader.setUniform("u_cam_pos", m_camera->position());
+
+    directional_shader.setUniform("u_directional_light.base.color",     m_dir_light_properties.color);
+    directional_shader.setUniform("u_directional_light.base.intensity", m_dir_light_properties.intensity);
+    directional_shader.setUniform("u_directional_light.direction",      m_dir_light_properties.direction);
+
+    for (unsigned i = 0; i < std::size(m_textured_models); ++i)
     {
-        m_directional_light_shader->setUniform("u_model",         m_textured_models_model_matrices[i]);
-        m_directional_light_shader->setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_textured_models_model_matrices[i]))));
-        m_directional_light_shader->setUniform("u_mvp",           view_projection * m_textured_models_model_matrices[i]);
+        m_textured_models_transforms.SetUniforms(directional_shader, i);
 
         m_textured_models[i].Render();
     }
 
     /* Render point lights */
-    m_point_light_shader->bind();
-    m_point_light_shader->setUniform("u_cam_pos",           m_camera->position());
-    m_point_light_shader->setUniform("u_has_albedo_map",    true);
-    m_point_light_shader->setUniform("u_has_normal_map",    true);
-    m_point_light_shader->setUniform("u_has_metallic_map",  true);
-    m_point_light_shader->setUniform("u_has_roughness_map", true);
+    RGL::Shader& point_shader = m_point_light_shaders->Get(HAS_ALBEDO_MAP | HAS_NORMAL_MAP | HAS_METALLIC_MAP | HAS_ROUGHNESS_MAP);
+    point_shader.bind();
+    point_shader.setUniform("u_cam_pos", m_camera->position());
 
     for (uint8_t p = 0; p < std::size(m_point_light_properties); ++p)
     {
-        m_point_light_shader->setUniform("u_point_light.base.color",     m_point_light_properties[p].color);
-        m_point_light_shader->setUniform("u_point_light.base.intensity", m_point_light_properties[p].intensity);
-        m_point_light_shader->setUniform("u_point_light.position",       m_point_light_properties[p].position);
-        m_point_light_shader->setUniform("u_point_light.radius",         m_point_light_properties[p].radius);
+        point_shader.setUniform("u_point_light.base.color",     m_point_light_properties[p].color);
+        point_shader.setUniform("u_point_light.base.intensity", m_point_light_properties[p].intensity);
+        point_shader.setUniform("u_point_light.position",       m_point_light_properties[p].position);
+        point_shader.setUniform("u_point_light.radius",         m_point_light_properties[p].radius);
 
-        for (uint32_t i = 0; i < std::size(m_textured_models_model_matrices); ++i)
+        for (uint32_t i = 0; i < std::size(m_textured_models); ++i)
         {
-            m_point_light_shader->setUniform("u_model",         m_textured_models_model_matrices[i]);
-            m_point_light_shader->setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_textured_models_model_matrices[i]))));
-            m_point_light_shader->setUniform("u_mvp",           view_projection * m_textured_models_model_matrices[i]);
+            m_textured_models_transforms.SetUniforms(point_shader, i);
 
             m_textured_models[i].Render();
         }
     }
     /* Render spot lights */
-    m_spot_light_shader->bind();
-    m_spot_light_shader->setUniform("u_albedo",            glm::vec3(0.5, 0.0, 0.0f));
-    m_spot_light_shader->setUniform("u_cam_pos",           m_camera->position());
-    m_spot_light_shader->setUniform("u_has_albedo_map",    true);
-    m_spot_light_shader->setUniform("u_has_normal_map",    true);
-    m_spot_light_shader->setUniform("u_has_metallic_map",  true);
-    m_spot_light_shader->setUniform("u_has_roughness_map", true);
-
-    m_spot_light_shader->setUniform("u_spot_light.point.base.color",      m_spot_light_properties.color);
-    m_spot_light_shader->setUniform("u_spot_light.point.base.intensity",  m_spot_light_properties.intensity);
-    m_spot_light_shader->setUniform("u_spot_light.point.position",        m_spot_light_properties.position);
-    m_spot_light_shader->setUniform("u_spot_light.point.radius",          m_spot_light_properties.radius);
-    m_spot_light_shader->setUniform("u_spot_light.direction",             m_spot_light_properties.direction);
-    m_spot_light_shader->setUniform("u_spot_light.inner_angle",           glm::radians(m_spot_light_properties.inner_angle));
-    m_spot_light_shader->setUniform("u_spot_light.outer_angle",           glm::radians(m_spot_light_properties.outer_angle));
-
-    for (unsigned i = 0; i < std::size(m_textured_models_model_matrices); ++i)
+    RGL::Shader& spot_shader = m_spot_light_shaders->Get(HAS_ALBEDO_MAP | HAS_NORMAL_MAP | HAS_METALLIC_MAP | HAS_ROUGHNESS_MAP);
+    spot_shader.bind();
+    spot_shader.setUniform("u_albedo",            glm::vec3(0.5, 0.0, 0.0f));
+    spot_shader.setUniform("u_cam_pos", m_camera->position());
+
+    spot_shader.setUniform("u_spot_light.point.base.color",      m_spot_light_properties.color);
+    spot_shader.setUniform("u_spot_light.point.base.intensity",  m_spot_light_properties.intensity);
+    spot_shader.setUniform("u_spot_light.point.position",        m_spot_light_properties.position);
+    spot_shader.setUniform("u_spot_light.point.radius",          m_spot_light_properties.radius);
+    spot_shader.setUniform("u_spot_light.direction",             m_spot_light_properties.direction);
+    spot_shader.setUniform("u_spot_light.inner_angle",           glm::radians(m_spot_light_properties.inner_angle));
+    spot_shader.setUniform("u_spot_light.outer_angle",           glm::radians(m_spot_light_properties.outer_angle));
+
+    for (unsigned i = 0; i < std::size(m_textured_models); ++i)
     {
-        m_spot_light_shader->setUniform("u_model",         m_textured_models_model_matrices[i]);
-        m_spot_light_shader->setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_textured_models_model_matrices[i]))));
-        m_spot_light_shader->setUniform("u_mvp",           view_projection * m_textured_models_model_matrices[i]);
+        m_textured_models_transforms.SetUniforms(spot_shader, i);
 
         m_textured_models[i].Render();
     }
@@ -727,29 +453,31 @@ void PBR::RenderTexturedModels()
 
 void PBR::RenderCerberusPistol()
 {
-    m_ambient_light_shader->bind();
-    m_ambient_light_shader->setUniform("u_cam_pos", m_camera->position());
-    m_ambient_light_shader->setUniform("u_ao", 1.0f);
+    RGL::StaticModel& cerberus_model = *m_cerberus_model->GetModel();
 
-    m_ambient_light_shader->setUniform("u_has_albedo_map",    true);
-    m_ambient_light_shader->setUniform("u_has_normal_map",    true);
-    m_ambient_light_shader->setUniform("u_has_metallic_map",  true);
-    m_ambient_light_shader->setUniform("u_has_roughness_map", true);
-    m_ambient_light_shader->setUniform("u_has_ao_map",        false);
-    m_ambient_light_shader->setUniform("u_has_emissive_map",  false);
+    RGL::Shader& ambient_shader = m_ambient_light_shaders->Get(HAS_ALBEDO_MAP | HAS_NORMAL_MAP | HAS_METALLIC_MAP | HAS_ROUGHNESS_MAP);
+    ambient_shader.bind();
+    ambient_shader.setUniform("u_cam_pos", m_camera->position());
+    ambient_shader.setUniform("u_ao", 1.0f);
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+    auto view_projection = m_camera->viewProjection();
+
+    /*
+     * The box against the cleared depth, so only the pistol being off the screen skips all its passes - there's
+     * nothing in front of it. The scenes with a depth pre-pass issue the query after it.
+     */
+    cerberus_model.RenderOcclusionQuery(m_cerberus_model_matrix, view_projection, m_camera->position());
 
     /* First, render the ambient color only for the opaque objects. */
-    m_irradiance_cubemap_rt->bindTexture(6);
-    m_prefiltered_env_map_rt->bindTexture(7);
-    m_brdf_lut_rt->bindTexture(8);
+    m_ibl.BindIrradianceSH();
+    m_ibl.BindPrefilteredMap(7);
+    m_ibl.BindBrdfLut(8);
 
-    m_ambient_light_shader->setUniform("u_model",         m_cerberus_model_matrix);
-    m_ambient_light_shader->setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_cerberus_model_matrix))));
-    m_ambient_light_shader->setUniform("u_mvp",           view_projection * m_cerberus_model_matrix);
+    ambient_shader.setUniform("u_model",         m_cerberus_model_matrix);
+    ambient_shader.setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_cerberus_model_matrix))));
+    ambient_shader.setUniform("u_mvp",           view_projection * m_cerberus_model_matrix);
 
-    m_cerberus_model.Render();
+    cerberus_model.Render();
 
     /*
      * Disable writing to the depth buffer and additively
@@ -761,65 +489,56 @@ void PBR::RenderCerberusPistol()
     glDepthFunc(GL_EQUAL);
 
     /* Render directional light(s) */
-    m_directional_light_shader->bind();
-    m_directional_light_shader->setUniform("u_cam_pos",           m_camera->position());
-    m_directional_light_shader->setUniform("u_has_albedo_map",    true);
-    m_directional_light_shader->setUniform("u_has_normal_map",    true);
-    m_directional_light_shader->setUniform("u_has_metallic_map",  true);
-    m_directional_light_shader->setUniform("u_has_roughness_map", true);
+    RGL::Shader& directional_shader = m_directional_light_shaders->Get(HAS_ALBEDO_MAP | HAS_NORMAL_MAP | HAS_METALLIC_MAP | HAS_ROUGHNESS_MAP);
+    directional_shader.bind();
+    directional_shader.setUniform("u_cam_pos", m_camera->position());
 
-    m_directional_light_shader->setUniform("u_directional_light.base.color",     m_dir_light_properties.color);
-    m_directional_light_shader->setUniform("u_directional_light.base.intensity", m_dir_light_properties.intensity);
-    m_directional_light_shader->setUniform("u_directional_light.direction",      m_dir_light_properties.direction);
+    directional_shader.setUniform("u_directional_light.base.color",     m_dir_light_properties.color);
+    directional_shader.setUniform("u_directional_light.base.intensity", m_dir_light_properties.intensity);
+    directional_shader.setUniform("u_directional_light.direction",      m_dir_light_properties.direction);
 
-    m_directional_light_shader->setUniform("u_model",         m_cerberus_model_matrix);
-    m_directional_light_shader->setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_cerberus_model_matrix))));
-    m_directional_light_shader->setUniform("u_mvp",           view_projection * m_cerberus_model_matrix);
+    directional_shader.setUniform("u_model",         m_cerberus_model_matrix);
+    directional_shader.setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_cerberus_model_matrix))));
+    directional_shader.setUniform("u_mvp",           view_projection * m_cerberus_model_matrix);
 
-    m_cerberus_model.Render();
+    cerberus_model.Render();
 
     /* Render point lights */
-    m_point_light_shader->bind();
-    m_point_light_shader->setUniform("u_cam_pos",           m_camera->position());
-    m_point_light_shader->setUniform("u_has_albedo_map",    true);
-    m_point_light_shader->setUniform("u_has_normal_map",    true);
-    m_point_light_shader->setUniform("u_has_metallic_map",  true);
-    m_point_light_shader->setUniform("u_has_roughness_map", true);
+    RGL::Shader& point_shader = m_point_light_shaders->Get(HAS_ALBEDO_MAP | HAS_NORMAL_MAP | HAS_METALLIC_MAP | HAS_ROUGHNESS_MAP);
+    point_shader.bind();
+    point_shader.setUniform("u_cam_pos", m_camera->position());
 
     for (uint8_t p = 0; p < std::size(m_point_light_properties); ++p)
     {
-        m_point_light_shader->setUniform("u_point_light.base.color",     m_point_light_properties[p].color);
-        m_point_light_shader->setUniform("u_point_light.base.intensity", m_point_light_properties[p].intensity);
-        m_point_light_shader->setUniform("u_point_light.position",       m_point_light_properties[p].position);
-        m_point_light_shader->setUniform("u_point_light.radius",         m_point_light_properties[p].radius);
+        point_shader.setUniform("u_point_light.base.color",     m_point_light_properties[p].color);
+        point_shader.setUniform("u_point_light.base.intensity", m_point_light_properties[p].intensity);
+        point_shader.setUniform("u_point_light.position",       m_point_light_properties[p].position);
+        point_shader.setUniform("u_point_light.radius",         m_point_light_properties[p].radius);
 
-        m_point_light_shader->setUniform("u_model",         m_cerberus_model_matrix);
-        m_point_light_shader->setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_cerberus_model_matrix))));
-        m_point_light_shader->setUniform("u_mvp",           view_projection * m_cerberus_model_matrix);
+        point_shader.setUniform("u_model",         m_cerberus_model_matrix);
+        point_shader.setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_cerberus_model_matrix))));
+        point_shader.setUniform("u_mvp",           view_projection * m_cerberus_model_matrix);
 
-        m_cerberus_model.Render();
+        cerberus_model.Render();
     }
     /* Render spot lights */
-    m_spot_light_shader->bind();
-    m_spot_light_shader->setUniform("u_cam_pos",           m_camera->position());
-    m_spot_light_shader->setUniform("u_has_albedo_map",    true);
-    m_spot_light_shader->setUniform("u_has_normal_map",    true);
-    m_spot_light_shader->setUniform("u_has_metallic_map",  true);
-    m_spot_light_shader->setUniform("u_has_roughness_map", true);
-
-    m_spot_light_shader->setUniform("u_spot_light.point.base.color",      m_spot_light_properties.color);
-    m_spot_light_shader->setUniform("u_spot_light.point.base.intensity",  m_spot_light_properties.intensity);
-    m_spot_light_shader->setUniform("u_spot_light.point.position",        m_spot_light_properties.position);
-    m_spot_light_shader->setUniform("u_spot_light.point.radius",          m_spot_light_properties.radius);
-    m_spot_light_shader->setUniform("u_spot_light.direction",             m_spot_light_properties.direction);
-    m_spot_light_shader->setUniform("u_spot_light.inner_angle",           glm::radians(m_spot_light_properties.inner_angle));
-    m_spot_light_shader->setUniform("u_spot_light.outer_angle",           glm::radians(m_spot_light_properties.outer_angle));
-
-    m_spot_light_shader->setUniform("u_model",         m_cerberus_model_matrix);
-    m_spot_light_shader->setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_cerberus_model_matrix))));
-    m_spot_light_shader->setUniform("u_mvp",           view_projection * m_cerberus_model_matrix);
-
-    m_cerberus_model.Render();
+    RGL::Shader& spot_shader = m_spot_light_shaders->Get(HAS_ALBEDO_MAP | HAS_NORMAL_MAP | HAS_METALLIC_MAP | HAS_ROUGHNESS_MAP);
+    spot_shader.bind();
+    spot_shader.setUniform("u_cam_pos", m_camera->position());
+
+    spot_shader.setUniform("u_spot_light.point.base.color",      m_spot_light_properties.color);
+    spot_shader.setUniform("u_spot_light.point.base.intensity",  m_spot_light_properties.intensity);
+    spot_shader.setUniform("u_spot_light.point.position",        m_spot_light_properties.position);
+    spot_shader.setUniform("u_spot_light.point.radius",          m_spot_light_properties.radius);
+    spot_shader.setUniform("u_spot_light.direction",             m_spot_light_properties.direction);
+    spot_shader.setUniform("u_spot_light.inner_angle",           glm::radians(m_spot_light_properties.inner_angle));
+    spot_shader.setUniform("u_spot_light.outer_angle",           glm::radians(m_spot_light_properties.outer_angle));
+
+    spot_shader.setUniform("u_model",         m_cerberus_model_matrix);
+    spot_shader.setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_cerberus_model_matrix))));
+    spot_shader.setUniform("u_mvp",           view_projection * m_cerberus_model_matrix);
+
+    cerberus_model.Render();
 
     /* Enable writing to the depth buffer. */
     glDepthMask(GL_TRUE);
@@ -827,10 +546,71 @@ void PBR::RenderCerberusPistol()
     glDisable(GL_BLEND);
 }
 
+void PBR::CaptureTexturedModels(const RGL::IrradianceVolume::CaptureView& view)
+{
+    glm::mat4 view_projections[6];
+    std::copy(std::begin(view.m_view_projections), std::end(view.m_view_projections), view_projections);
+
+    m_capture_shader->bind();
+    m_capture_shader->setUniform("u_view_projections", view_projections, 6);
+    m_capture_shader->setUniform("u_face",             view.m_face);
+    m_capture_shader->setUniform("u_cam_pos",          view.m_position);
+
+    m_capture_shader->setUniform("u_has_albedo_map",    true);
+    m_capture_shader->setUniform("u_has_normal_map",    true);
+    m_capture_shader->setUniform("u_has_metallic_map",  true);
+    m_capture_shader->setUniform("u_has_roughness_map", true);
+    m_capture_shader->setUniform("u_has_ao_map",        true);
+
+    m_capture_shader->setUniform("u_directional_light.base.color",     m_dir_light_properties.color);
+    m_capture_shader->setUniform("u_directional_light.base.intensity", m_dir_light_properties.intensity);
+    m_capture_shader->setUniform("u_directional_light.direction",      m_dir_light_properties.direction);
+
+    for (uint8_t p = 0; p < std::size(m_point_light_properties); ++p)
+    {
+        const std::string light = "u_point_lights[" + std::to_string(p) + "]";
+
+        m_capture_shader->setUniform(light + ".base.color",     m_point_light_properties[p].color);
+        m_capture_shader->setUniform(light + ".base.intensity", m_point_light_properties[p].intensity);
+        m_capture_shader->setUniform(light + ".position",       m_point_light_properties[p].position);
+        m_capture_shader->setUniform(light + ".radius",         m_point_light_properties[p].radius);
+    }
+
+    m_capture_shader->setUniform("u_spot_light.point.base.color",     m_spot_light_properties.color);
+    m_capture_shader->setUniform("u_spot_light.point.base.intensity", m_spot_light_properties.intensity);
+    m_capture_shader->setUniform("u_spot_light.point.position",       m_spot_light_properties.position);
+    m_capture_shader->setUniform("u_spot_light.point.radius",         m_spot_light_properties.radius);
+    m_capture_shader->setUniform("u_spot_light.direction",            m_spot_light_properties.direction);
+    m_capture_shader->setUniform("u_spot_light.inner_angle",          glm::radians(m_spot_light_properties.inner_angle));
+    m_capture_shader->setUniform("u_spot_light.outer_angle",          glm::radians(m_spot_light_properties.outer_angle));
+
+    m_ibl.BindIrradianceSH();
+    m_ibl.BindPrefilteredMap(7);
+    m_ibl.BindBrdfLut(8);
+
+    for (uint32_t i = 0; i < std::size(m_textured_models); ++i)
+    {
+        const glm::mat4& model = m_textured_models_transforms.GetModel(i);
+
+        m_capture_shader->setUniform("u_model",         model);
+        m_capture_shader->setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(model))));
+
+        m_textured_models[i].Render(view.m_instances_count);
+    }
+}
+
 void PBR::render()
 {
     /* Put render specific code here. Don't update variables here! */
-    m_tmo_ps->bindFilterFBO();
+
+    /* A few probes per frame, before the frame's target is bound - the update leaves the default framebuffer bound. */
+    if (m_current_scene == Scene::TEXTURED && m_use_irradiance_volume && m_textured_scene->IsReady())
+    {
+        m_irradiance_volume.Update([this](const RGL::IrradianceVolume::CaptureView& view) { CaptureTexturedModels(view); });
+    }
+
+    m_tmo_ps->bindFilterFBO(m_msaa.GetSamples());
+    m_msaa.BeginShading();
 
     switch (m_current_scene)
     {
@@ -838,24 +618,25 @@ void PBR::render()
             RenderSpheres();
             break;
 
+        /* Only the skybox until the scene's resources are loaded. */
         case Scene::TEXTURED:
-            RenderTexturedModels();
+            if (m_textured_scene->Request())
+            {
+                RenderTexturedModels();
+            }
             break;
         case Scene::CERBERUS_PISTOL:
-            RenderCerberusPistol();
+            if (m_cerberus_model->Get())
+            {
+                RenderCerberusPistol();
+            }
             break;
     }
 
-    m_background_shader->bind();
-    m_background_shader->setUniform("u_projection", m_camera->m_projection);
-    m_background_shader->setUniform("u_view", glm::mat4(glm::mat3(m_camera->m_view)));
-    m_background_shader->setUniform("u_lod_level", m_background_lod_level);
-    m_env_cubemap_rt->bindTexture();
+    m_skybox.Render(m_ibl, m_camera->m_projection, m_camera->m_view, m_background_blur);
 
-    glBindVertexArray(m_skybox_vao);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-
-    m_tmo_ps->render(m_exposure, m_gamma);
+    m_msaa.EndShading();
+    m_tmo_ps->render(m_exposure, m_gamma, m_msaa);
 }
 
 void PBR::render_gui()
@@ -892,7 +673,9 @@ void PBR::render_gui()
         ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
         ImGui::SliderFloat("Exposure",             &m_exposure,             0.0, 10.0, "%.1f");
         ImGui::SliderFloat("Gamma",                &m_gamma,                0.0, 10.0, "%.1f");
-        ImGui::SliderFloat("Background LOD level", &m_background_lod_level, 0.0, glm::log2(float(m_env_cubemap_rt->m_width)), "%.1f");
+        ImGui::SliderFloat("Background blur",      &m_background_blur,      0.0, 1.0, "%.2f");
+
+        m_msaa.RenderGui();
 
         if (ImGui::BeginCombo("HDR map", m_hdr_maps_names[m_current_hdr_map_idx].c_str()))
         {
@@ -902,7 +685,7 @@ void PBR::render_gui()
                 if (ImGui::Selectable(m_hdr_maps_names[i].c_str(), is_selected))
                 {
                     m_current_hdr_map_idx = i;
-                    PrecomputeIndirectLight(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx]);
+                    m_ibl.Load(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx], RGL::ImageBasedLighting::PrefilterMode::FAST);
                 }
 
                 if (is_selected)
@@ -933,6 +716,37 @@ void PBR::render_gui()
 
         ImGui::PopItemWidth();
 
+        if (m_current_scene == Scene::TEXTURED)
+        {
+            ImGui::Checkbox("Irradiance volume", &m_use_irradiance_volume);
+
+            if (m_use_irradiance_volume)
+            {
+                int probes_per_frame = int(m_irradiance_volume.GetProbesPerFrame());
+
+                ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
+                if (ImGui::SliderInt("Probes per frame", &probes_per_frame, 1, 16))
+                {
+                    m_irradiance_volume.SetProbesPerFrame(uint32_t(probes_per_frame));
+                }
+                ImGui::PopItemWidth();
+
+                ImGui::Text("%u probes%s", m_irradiance_volume.GetProbesCount(), m_irradiance_volume.IsComplete() ? "" : ", capturing...");
+            }
+        }
+
+        if (m_current_scene == Scene::CERBERUS_PISTOL && m_cerberus_model->IsReady())
+        {
+            RGL::StaticModel& cerberus_model = *m_cerberus_model->GetModel();
+
+            bool is_conditional = cerberus_model.IsConditionalRenderingEnabled();
+
+            if (ImGui::Checkbox("Occlusion query conditional rendering", &is_conditional))
+            {
+                cerberus_model.SetConditionalRendering(is_conditional);
+            }
+        }
+
         ImGui::Spacing();
 
         ImGuiTabBarFlags tab_bar_flags = ImGuiTabBarFlags_None;
@@ -0,0 +1,56 @@
+#version 460 core
+#include "face_extrusion.glh"
+
+// face_extrusion.geom without a geometry shader: the draw is not indexed and every triangle of the mesh is drawn
+// as the 7 triangles of its extruded prism, the cap and two per side. Each of their 21 vertices fetches the three
+// vertices of its source triangle, gl_VertexID / 21, and places itself as the geometry shader would.
+
+layout(std430, binding = 0) readonly buffer VerticesSSBO
+{
+    float vertices[]; // u_vertex_stride per vertex - position, texcoord, normal.
+};
+
+layout(std430, binding = 1) readonly buffer IndicesSSBO
+{
+    uint indices[];
+};
+
+uniform mat4 u_model;
+uniform mat3 u_normal_matrix;
+uniform mat4 u_view_projection;
+
+uniform uint u_first_index;
+uniform int  u_base_vertex;
+uniform uint u_vertex_stride;
+
+layout (location = 0) out vec2 out_texcoord;
+layout (location = 1) out vec3 out_world_pos;
+layout (location = 2) out vec3 out_normal;
+
+void main()
+{
+    uint  triangle = uint(gl_VertexID) / 21;
+    ivec3 corner   = corners[uint(gl_VertexID) % 21];
+
+    vec3 wp[3];
+    vec3 wn[3];
+    vec2 uv[3];
+
+    for (uint v = 0; v < 3; ++v)
+    {
+        uint i = uint(int(indices[u_first_index + 3 * triangle + v]) + u_base_vertex) * u_vertex_stride;
+
+        wp[v] = vec3(u_model * vec4(vertices[i], vertices[i + 1], vertices[i + 2], 1.0));
+        uv[v] = vec2(vertices[i + 3], vertices[i + 4]);
+        wn[v] = u_normal_matrix * vec3(vertices[i + 5], vertices[i + 6], vertices[i + 7]);
+    }
+
+    // Extrusion points
+    float ext  = extrusion(triangle);
+    vec3  offs = constructNormal(wp[0], wp[1], wp[2]) * ext * u_extrusion_amount;
+
+    out_world_pos = wp[corner.x] + offs * float(corner.y);
+    out_normal    = prismNormal(corner, wp, wn, offs, ext);
+    out_texcoord  = uv[corner.x];
+    gl_Position   = u_view_projection * vec4(out_world_pos, 1.0);
+}
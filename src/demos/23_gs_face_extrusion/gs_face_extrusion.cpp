@@ -1,41 +1,58 @@
 #include "gs_face_extrusion.h"
 #include "filesystem.h"
 #include "input.h"
+#include "profiler.h"
 #include "util.h"
 #include "gui/gui.h"
 
 #include <glm/gtc/matrix_inverse.hpp>
 
+namespace
+{
+    /* In the order of GSFaceExtrusion::ExtrusionMethod. */
+    const char* EXTRUSION_SCOPES_NAMES[] = { "Face extrusion (geometry shader)", "Face extrusion (vertex pulling)", "Face extrusion (compute)" };
+}
+
 GSFaceExtrusion::GSFaceExtrusion()
       : m_dir_light_angles    (0.0f, 0.0f),
         m_spot_light_angles   (90.0f, -25.0f),
         m_exposure            (0.3f),
         m_gamma               (3.6f),
-        m_background_lod_level(1.2),
-        m_skybox_vao          (0),
-        m_skybox_vbo          (0),
+        m_background_blur     (0.1f),
         m_albedo              (1.0f),
         m_roughness           (1.0f),
         m_metallic            (0.0f),
         m_ao                  (1.0f),
         m_current_time        (0.0f),
         m_animation_speed     (0.1f),
-        m_extrusion_amount    (0.618f)
+        m_extrusion_amount    (0.618f),
+        m_extrusion_method    (ExtrusionMethod::COMPUTE),
+        m_extrusion_gpu_ms    { 0.0f, 0.0f, 0.0f },
+        m_dummy_vao_id        (0),
+        m_extruded_vao_id     (0),
+        m_extruded_vbo_id     (0),
+        m_extruded_vertices_count(0)
 {
 }
 
 GSFaceExtrusion::~GSFaceExtrusion()
 {
-    if (m_skybox_vao != 0)
+    if (m_dummy_vao_id != 0)
+    {
+        glDeleteVertexArrays(1, &m_dummy_vao_id);
+        m_dummy_vao_id = 0;
+    }
+
+    if (m_extruded_vao_id != 0)
     {
-        glDeleteVertexArrays(1, &m_skybox_vao);
-        m_skybox_vao = 0;
+        glDeleteVertexArrays(1, &m_extruded_vao_id);
+        m_extruded_vao_id = 0;
     }
 
-    if (m_skybox_vbo != 0)
+    if (m_extruded_vbo_id != 0)
     {
-        glDeleteBuffers(1, &m_skybox_vbo);
-        m_skybox_vbo = 0;
+        glDeleteBuffers(1, &m_extruded_vbo_id);
+        m_extruded_vbo_id = 0;
     }
 }
 
@@ -51,6 +68,7 @@ void GSFaceExtrusion::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(-10.3, 7.6, -5.42);
     m_camera->setOrientation(glm::quat(-0.39, -0.058, -0.9, -0.14));
 
@@ -61,6 +79,7 @@ void GSFaceExtrusion::init_app()
 
     /* Create models. */
     //m_static_model.GenSphere(0.5, 3);
+    m_static_model.SetVertexFormat(RGL::StaticModel::VertexFormat::INTERLEAVED); /* The vertex pulling and the compute fetch its vertices. */
     m_static_model.Load(RGL::FileSystem::getResourcesPath() / "models/icosphere.glb");
     m_static_model_transform = glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 6.0, -3.0)) * glm::rotate(glm::mat4(1.0), glm::radians(-90.0f), glm::vec3(1, 0, 0));
 
@@ -72,43 +91,57 @@ void GSFaceExtrusion::init_app()
     m_directional_light_shader = std::make_shared<RGL::Shader>(dir + "pbr-lighting.vert", dir + "pbr-directional.frag", "src/demos/23_gs_face_extrusion/face_extrusion.geom");
     m_directional_light_shader->link();
 
-    m_equirectangular_to_cubemap_shader = std::make_shared<RGL::Shader>(dir + "cubemap.vert", dir + "equirectangular_to_cubemap.frag");
-    m_equirectangular_to_cubemap_shader->link();
+    m_ambient_light_pulling_shader = std::make_shared<RGL::Shader>("src/demos/23_gs_face_extrusion/face_extrusion_pulling.vert", dir + "pbr-ambient.frag");
+    m_ambient_light_pulling_shader->link();
 
-    m_irradiance_convolution_shader = std::make_shared<RGL::Shader>(dir + "cubemap.vert", dir + "irradiance_convolution.frag");
-    m_irradiance_convolution_shader->link();
+    m_directional_light_pulling_shader = std::make_shared<RGL::Shader>("src/demos/23_gs_face_extrusion/face_extrusion_pulling.vert", dir + "pbr-directional.frag");
+    m_directional_light_pulling_shader->link();
 
-    m_prefilter_env_map_shader = std::make_shared<RGL::Shader>(dir + "cubemap.vert", dir + "prefilter_cubemap.frag");
-    m_prefilter_env_map_shader->link();
+    m_ambient_light_cached_shader = std::make_shared<RGL::Shader>(dir + "pbr-lighting.vert", dir + "pbr-ambient.frag");
+    m_ambient_light_cached_shader->link();
 
-    m_precompute_brdf = std::make_shared<RGL::Shader>("src/demos/10_postprocessing_filters/FSQ.vert", dir + "precompute_brdf.frag");
-    m_precompute_brdf->link();
+    m_directional_light_cached_shader = std::make_shared<RGL::Shader>(dir + "pbr-lighting.vert", dir + "pbr-directional.frag");
+    m_directional_light_cached_shader->link();
 
-    m_background_shader = std::make_shared<RGL::Shader>(dir + "background.vert", dir + "background.frag");
-    m_background_shader->link();
+    m_extrude_shader = std::make_shared<RGL::Shader>("src/demos/23_gs_face_extrusion/face_extrusion.comp");
+    m_extrude_shader->link();
 
-    m_tmo_ps = std::make_shared<PostprocessFilter>(RGL::Window::getWidth(), RGL::Window::getHeight());
+    glCreateVertexArrays(1, &m_dummy_vao_id);
 
-    // IBL precomputations
-    GenSkyboxGeometry();
+    /* The compute method's output, the prisms of every draw command one after another. */
+    for (const auto& command : m_static_model.GetIndirectCommands())
+    {
+        m_extruded_vertices_count += command.m_count / 3 * 21;
+    }
 
-    m_env_cubemap_rt = std::make_shared<CubeMapRenderTarget>();
-    m_env_cubemap_rt->set_position(glm::vec3(0.0));
-    m_env_cubemap_rt->generate_rt(2048, 2048, true);
+    /* Position, texcoord, normal - the interleaved layout of pbr-lighting.vert's attributes. */
+    const GLuint extruded_vertex_stride = 8 * sizeof(float);
 
-    m_irradiance_cubemap_rt = std::make_shared<CubeMapRenderTarget>();
-    m_irradiance_cubemap_rt->set_position(glm::vec3(0.0));
-    m_irradiance_cubemap_rt->generate_rt(64, 64);
+    glCreateBuffers    (1, &m_extruded_vbo_id);
+    glNamedBufferStorage(m_extruded_vbo_id, GLsizeiptr(m_extruded_vertices_count) * extruded_vertex_stride, nullptr, 0);
 
-    m_prefiltered_env_map_rt = std::make_shared<CubeMapRenderTarget>();
-    m_prefiltered_env_map_rt->set_position(glm::vec3(0.0));
-    m_prefiltered_env_map_rt->generate_rt(256, 256, true);
+    glCreateVertexArrays     (1, &m_extruded_vao_id);
+    glVertexArrayVertexBuffer(m_extruded_vao_id, 0, m_extruded_vbo_id, 0, extruded_vertex_stride);
 
-    m_brdf_lut_rt = std::make_shared<Texture2DRenderTarget>();
-    m_brdf_lut_rt->generate_rt(512, 512);
+    glEnableVertexArrayAttrib (m_extruded_vao_id, 0);
+    glVertexArrayAttribFormat (m_extruded_vao_id, 0, 3, GL_FLOAT, GL_FALSE, 0);
+    glVertexArrayAttribBinding(m_extruded_vao_id, 0, 0);
 
-    PrecomputeIndirectLight(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx]);
-    PrecomputeBRDF(m_brdf_lut_rt);
+    glEnableVertexArrayAttrib (m_extruded_vao_id, 1);
+    glVertexArrayAttribFormat (m_extruded_vao_id, 1, 2, GL_FLOAT, GL_FALSE, 3 * sizeof(float));
+    glVertexArrayAttribBinding(m_extruded_vao_id, 1, 0);
+
+    glEnableVertexArrayAttrib (m_extruded_vao_id, 2);
+    glVertexArrayAttribFormat (m_extruded_vao_id, 2, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float));
+    glVertexArrayAttribBinding(m_extruded_vao_id, 2, 0);
+
+    m_skybox.Create();
+
+    m_tmo_ps = std::make_shared<PostprocessFilter>();
+
+    // IBL precomputations
+    m_ibl.Create();
+    m_ibl.Load(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx]);
 }
 
 void GSFaceExtrusion::input()
@@ -169,183 +202,79 @@ void GSFaceExtrusion::update(double delta_time)
     m_current_time += delta_time * m_animation_speed;
 }
 
-void GSFaceExtrusion::HdrEquirectangularToCubemap(const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt, const std::shared_ptr<RGL::Texture2D>& m_equirectangular_map)
+void GSFaceExtrusion::extrude_model()
 {
-    /* Update all faces per frame */
-    m_equirectangular_to_cubemap_shader->bind();
-    m_equirectangular_to_cubemap_shader->setUniform("u_projection", cubemap_rt->m_projection);
+    GLint vertex_stride = 0;
+    glGetVertexArrayIndexediv(m_static_model.GetVertexArray(), 0, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &vertex_stride);
 
-    glViewport(0, 0, cubemap_rt->m_width, cubemap_rt->m_height);
-    glBindFramebuffer(GL_FRAMEBUFFER, cubemap_rt->m_fbo_id);
-    m_equirectangular_map->Bind(1);
+    m_extrude_shader->bind();
+    m_extrude_shader->setUniform("u_model",            m_static_model_transform);
+    m_extrude_shader->setUniform("u_normal_matrix",    glm::mat3(glm::transpose(glm::inverse(m_static_model_transform))));
+    m_extrude_shader->setUniform("u_vertex_stride",    GLuint(vertex_stride) / GLuint(sizeof(float)));
+    m_extrude_shader->setUniform("u_time",             m_current_time);
+    m_extrude_shader->setUniform("u_extrusion_amount", m_extrusion_amount);
 
-    for (uint8_t side = 0; side < 6; ++side)
-    {
-        m_equirectangular_to_cubemap_shader->setUniform("u_view", cubemap_rt->m_view_transforms[side]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, cubemap_rt->m_cubemap_texture_id, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        glBindVertexArray(m_skybox_vao);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-    }
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
-}
-
-void GSFaceExtrusion::IrradianceConvolution(const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt)
-{
-    /* Update all faces per frame */
-    m_irradiance_convolution_shader->bind();
-    m_irradiance_convolution_shader->setUniform("u_projection", cubemap_rt->m_projection);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_static_model.GetVertexBuffer());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_static_model.GetIndexBuffer());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_extruded_vbo_id);
 
-    glViewport(0, 0, cubemap_rt->m_width, cubemap_rt->m_height);
-    glBindFramebuffer(GL_FRAMEBUFFER, cubemap_rt->m_fbo_id);
-    m_env_cubemap_rt->bindTexture(1);
+    GLuint first_output_triangle = 0;
 
-    for (uint8_t side = 0; side < 6; ++side)
+    for (const auto& command : m_static_model.GetIndirectCommands())
     {
-        m_irradiance_convolution_shader->setUniform("u_view", cubemap_rt->m_view_transforms[side]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, cubemap_rt->m_cubemap_texture_id, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        glBindVertexArray(m_skybox_vao);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-    }
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
-}
-
-void GSFaceExtrusion::PrefilterCubemap(const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt)
-{
-    m_prefilter_env_map_shader->bind();
-    m_prefilter_env_map_shader->setUniform("u_projection", cubemap_rt->m_projection);
-    
-    m_env_cubemap_rt->bindTexture(1);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, cubemap_rt->m_fbo_id);
+        const GLuint triangles_count = command.m_count / 3;
 
-    uint8_t max_mip_levels = glm::log2(float(cubemap_rt->m_width));
-    for (uint8_t mip = 0; mip < max_mip_levels; ++mip)
-    {
-        // resize the framebuffer according to mip-level size.
-        uint32_t mip_width  = cubemap_rt->m_width  * std::pow(0.5, mip);
-        uint32_t mip_height = cubemap_rt->m_height * std::pow(0.5, mip);
-
-        glBindRenderbuffer(GL_RENDERBUFFER, cubemap_rt->m_rbo_id);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mip_width, mip_height);
-        glViewport(0, 0, mip_width, mip_height);
+        m_extrude_shader->setUniform("u_first_index",           command.m_first_index);
+        m_extrude_shader->setUniform("u_base_vertex",           command.m_base_vertex);
+        m_extrude_shader->setUniform("u_triangles_count",       triangles_count);
+        m_extrude_shader->setUniform("u_first_output_triangle", first_output_triangle);
 
-        float roughness = float(mip) / float(max_mip_levels - 1);
-        m_prefilter_env_map_shader->setUniform("u_roughness", roughness);
+        glDispatchCompute((triangles_count + 63) / 64, 1, 1);
 
-        for (uint8_t side = 0; side < 6; ++side)
-        {
-            m_prefilter_env_map_shader->setUniform("u_view", cubemap_rt->m_view_transforms[side]);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, cubemap_rt->m_cubemap_texture_id, mip);
-
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            glBindVertexArray(m_skybox_vao);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-        }
+        first_output_triangle += triangles_count;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
+
+    /* The passes read the prisms as vertex attributes. */
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
 }
 
-void GSFaceExtrusion::PrecomputeIndirectLight(const std::filesystem::path& hdri_map_filepath)
+void GSFaceExtrusion::render_extruded_model(const std::shared_ptr<RGL::Shader>& shader)
 {
-    auto envmap_hdr = std::make_shared<RGL::Texture2D>();
-    envmap_hdr->LoadHdr(hdri_map_filepath);
-    auto envmap_metadata = envmap_hdr->GetMetadata();
-
-    HdrEquirectangularToCubemap(m_env_cubemap_rt, envmap_hdr);
+    if (m_extrusion_method == ExtrusionMethod::GEOMETRY_SHADER)
+    {
+        m_static_model.Render();
+        return;
+    }
 
-    glBindTexture(GL_TEXTURE_CUBE_MAP, m_env_cubemap_rt->m_cubemap_texture_id);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    if (m_extrusion_method == ExtrusionMethod::COMPUTE)
+    {
+        /* Already in the world space. */
+        shader->setUniform("u_model",         glm::mat4(1.0f));
+        shader->setUniform("u_normal_matrix", glm::mat3(1.0f));
+        shader->setUniform("u_mvp",           m_camera->viewProjection());
+
+        glBindVertexArray(m_extruded_vao_id);
+        glDrawArrays(GL_TRIANGLES, 0, m_extruded_vertices_count);
+        return;
+    }
 
-    IrradianceConvolution(m_irradiance_cubemap_rt);
-    PrefilterCubemap(m_prefiltered_env_map_rt);
-}
+    GLint vertex_stride = 0;
+    glGetVertexArrayIndexediv(m_static_model.GetVertexArray(), 0, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &vertex_stride);
 
-void GSFaceExtrusion::PrecomputeBRDF(const std::shared_ptr<Texture2DRenderTarget>& rt)
-{
-    GLuint m_dummy_vao_id;
-    glCreateVertexArrays(1, &m_dummy_vao_id);
-
-    rt->bindRenderTarget();
-    m_precompute_brdf->bind();
+    shader->setUniform("u_vertex_stride", GLuint(vertex_stride) / GLuint(sizeof(float)));
 
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_static_model.GetVertexBuffer());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_static_model.GetIndexBuffer());
     glBindVertexArray(m_dummy_vao_id);
-    glDrawArrays(GL_TRIANGLES, 0, 3);
-
-    glDeleteVertexArrays(1, &m_dummy_vao_id);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
-}
+    /* The cap and the three sides of each triangle, 7 triangles. */
+    for (const auto& command : m_static_model.GetIndirectCommands())
+    {
+        shader->setUniform("u_first_index", command.m_first_index);
+        shader->setUniform("u_base_vertex", command.m_base_vertex);
 
-void GSFaceExtrusion::GenSkyboxGeometry()
-{
-    m_skybox_vao = 0;
-    m_skybox_vbo = 0;
-
-    glCreateVertexArrays(1, &m_skybox_vao);
-    glCreateBuffers(1, &m_skybox_vbo);
-
-    std::vector<float> skybox_positions = {
-        // positions          
-        -1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
-        // front face
-        -1.0f, -1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-        // left face
-        -1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-        // right face
-         1.0f,  1.0f,  1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-        // bottom face
-        -1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f, -1.0f,
-        // top face
-        -1.0f,  1.0f, -1.0f,
-         1.0f,  1.0f , 1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f,  1.0f,  1.0f,
-    };
-
-    /* Set up buffer objects */
-    glNamedBufferStorage(m_skybox_vbo, skybox_positions.size() * sizeof(skybox_positions[0]), skybox_positions.data(), 0 /*flags*/);
-
-    /* Set up VAO */
-    glEnableVertexArrayAttrib(m_skybox_vao, 0 /*index*/);
-
-    /* Separate attribute format */
-    glVertexArrayAttribFormat(m_skybox_vao, 0 /*index*/, 3 /*size*/, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/);
-    glVertexArrayAttribBinding(m_skybox_vao, 0 /*index*/, 0 /*bindingindex*/);
-    glVertexArrayVertexBuffer(m_skybox_vao, 0 /*bindingindex*/, m_skybox_vbo, 0 /*offset*/, sizeof(glm::vec3) /*stride*/);
+        glDrawArrays(GL_TRIANGLES, 0, command.m_count / 3 * 21);
+    }
 }
 
 void GSFaceExtrusion::render()
@@ -353,36 +282,50 @@ void GSFaceExtrusion::render()
     /* Put render specific code here. Don't update variables here! */
     m_tmo_ps->bindFilterFBO();
 
-    m_ambient_light_shader->bind();
-    m_ambient_light_shader->setUniform("u_cam_pos", m_camera->position());
+    const std::shared_ptr<RGL::Shader> ambient_light_shaders[]     = { m_ambient_light_shader,     m_ambient_light_pulling_shader,     m_ambient_light_cached_shader };
+    const std::shared_ptr<RGL::Shader> directional_light_shaders[] = { m_directional_light_shader, m_directional_light_pulling_shader, m_directional_light_cached_shader };
+
+    const auto& ambient_light_shader     = ambient_light_shaders    [int(m_extrusion_method)];
+    const auto& directional_light_shader = directional_light_shaders[int(m_extrusion_method)];
+
+    /* Ended before the skybox, it times the model's passes alone - and the compute method's dispatch. */
+    RGL::Profiler::BeginScope(EXTRUSION_SCOPES_NAMES[int(m_extrusion_method)]);
 
-    m_ambient_light_shader->setUniform("u_has_albedo_map",    false);
-    m_ambient_light_shader->setUniform("u_has_normal_map",    false);
-    m_ambient_light_shader->setUniform("u_has_metallic_map",  false);
-    m_ambient_light_shader->setUniform("u_has_roughness_map", false);
-    m_ambient_light_shader->setUniform("u_has_ao_map",        false);
-    m_ambient_light_shader->setUniform("u_has_emissive_map",  false);
+    if (m_extrusion_method == ExtrusionMethod::COMPUTE)
+    {
+        extrude_model();
+    }
 
-    m_ambient_light_shader->setUniform("u_albedo",    m_albedo);
-    m_ambient_light_shader->setUniform("u_roughness", m_roughness);
-    m_ambient_light_shader->setUniform("u_metallic",  m_metallic);
-    m_ambient_light_shader->setUniform("u_ao",        m_ao);
+    ambient_light_shader->bind();
+    ambient_light_shader->setUniform("u_cam_pos", m_camera->position());
 
-    m_ambient_light_shader->setUniform("u_time",             m_current_time);
-    m_ambient_light_shader->setUniform("u_extrusion_amount", m_extrusion_amount);
+    ambient_light_shader->setUniform("u_has_albedo_map",    false);
+    ambient_light_shader->setUniform("u_has_normal_map",    false);
+    ambient_light_shader->setUniform("u_has_metallic_map",  false);
+    ambient_light_shader->setUniform("u_has_roughness_map", false);
+    ambient_light_shader->setUniform("u_has_ao_map",        false);
+    ambient_light_shader->setUniform("u_has_emissive_map",  false);
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+    ambient_light_shader->setUniform("u_albedo",    m_albedo);
+    ambient_light_shader->setUniform("u_roughness", m_roughness);
+    ambient_light_shader->setUniform("u_metallic",  m_metallic);
+    ambient_light_shader->setUniform("u_ao",        m_ao);
+
+    ambient_light_shader->setUniform("u_time",             m_current_time);
+    ambient_light_shader->setUniform("u_extrusion_amount", m_extrusion_amount);
+
+    auto view_projection = m_camera->viewProjection();
 
     /* First, render the ambient color only for the opaque objects. */
-    m_irradiance_cubemap_rt->bindTexture(6);
-    m_prefiltered_env_map_rt->bindTexture(7);
-    m_brdf_lut_rt->bindTexture(8);
+    m_ibl.BindIrradianceSH();
+    m_ibl.BindPrefilteredMap(7);
+    m_ibl.BindBrdfLut(8);
 
-    m_ambient_light_shader->setUniform("u_model",           m_static_model_transform);
-    m_ambient_light_shader->setUniform("u_normal_matrix",   glm::mat3(glm::transpose(glm::inverse(m_static_model_transform))));
-    m_ambient_light_shader->setUniform("u_view_projection", view_projection);
+    ambient_light_shader->setUniform("u_model",           m_static_model_transform);
+    ambient_light_shader->setUniform("u_normal_matrix",   glm::mat3(glm::transpose(glm::inverse(m_static_model_transform))));
+    ambient_light_shader->setUniform("u_view_projection", view_projection);
 
-    m_static_model.Render();
+    render_extruded_model(ambient_light_shader);
 
     /*
      * Disable writing to the depth buffer and additively
@@ -394,29 +337,31 @@ void GSFaceExtrusion::render()
     glDepthFunc(GL_EQUAL);
 
     /* Render directional light(s) */
-    m_directional_light_shader->bind();
-    m_directional_light_shader->setUniform("u_cam_pos",           m_camera->position());
-    m_directional_light_shader->setUniform("u_has_albedo_map",    false);
-    m_directional_light_shader->setUniform("u_has_normal_map",    false);
-    m_directional_light_shader->setUniform("u_has_metallic_map",  false);
-    m_directional_light_shader->setUniform("u_has_roughness_map", false);
+    directional_light_shader->bind();
+    directional_light_shader->setUniform("u_cam_pos",           m_camera->position());
+    directional_light_shader->setUniform("u_has_albedo_map",    false);
+    directional_light_shader->setUniform("u_has_normal_map",    false);
+    directional_light_shader->setUniform("u_has_metallic_map",  false);
+    directional_light_shader->setUniform("u_has_roughness_map", false);
+
+    directional_light_shader->setUniform("u_albedo",    m_albedo);
+    directional_light_shader->setUniform("u_roughness", m_roughness);
+    directional_light_shader->setUniform("u_metallic",  m_metallic);
 
-    m_directional_light_shader->setUniform("u_albedo",    m_albedo);
-    m_directional_light_shader->setUniform("u_roughness", m_roughness);
-    m_directional_light_shader->setUniform("u_metallic",  m_metallic);
+    directional_light_shader->setUniform("u_time",             m_current_time);
+    directional_light_shader->setUniform("u_extrusion_amount", m_extrusion_amount);
 
-    m_directional_light_shader->setUniform("u_time",             m_current_time);
-    m_directional_light_shader->setUniform("u_extrusion_amount", m_extrusion_amount);
+    directional_light_shader->setUniform("u_directional_light.base.color",     m_dir_light_properties.color);
+    directional_light_shader->setUniform("u_directional_light.base.intensity", m_dir_light_properties.intensity);
+    directional_light_shader->setUniform("u_directional_light.direction",      m_dir_light_properties.direction);
 
-    m_directional_light_shader->setUniform("u_directional_light.base.color",     m_dir_light_properties.color);
-    m_directional_light_shader->setUniform("u_directional_light.base.intensity", m_dir_light_properties.intensity);
-    m_directional_light_shader->setUniform("u_directional_light.direction",      m_dir_light_properties.direction);
+    directional_light_shader->setUniform("u_model",           m_static_model_transform);
+    directional_light_shader->setUniform("u_normal_matrix",   glm::mat3(glm::transpose(glm::inverse(m_static_model_transform))));
+    directional_light_shader->setUniform("u_view_projection", view_projection);
 
-    m_directional_light_shader->setUniform("u_model",           m_static_model_transform);
-    m_directional_light_shader->setUniform("u_normal_matrix",   glm::mat3(glm::transpose(glm::inverse(m_static_model_transform))));
-    m_directional_light_shader->setUniform("u_view_projection", view_projection);
+    render_extruded_model(directional_light_shader);
 
-    m_static_model.Render();
+    RGL::Profiler::EndScope();
 
     /* Enable writing to the depth buffer. */
     glDepthMask(GL_TRUE);
@@ -424,14 +369,7 @@ void GSFaceExtrusion::render()
     glDisable(GL_BLEND);
     glDisable(GL_CULL_FACE);
 
-    m_background_shader->bind();
-    m_background_shader->setUniform("u_projection", m_camera->m_projection);
-    m_background_shader->setUniform("u_view", glm::mat4(glm::mat3(m_camera->m_view)));
-    m_background_shader->setUniform("u_lod_level", m_background_lod_level);
-    m_env_cubemap_rt->bindTexture();
-
-    glBindVertexArray(m_skybox_vao);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+    m_skybox.Render(m_ibl, m_camera->m_projection, m_camera->m_view, m_background_blur);
 
     m_tmo_ps->render(m_exposure, m_gamma);
 }
@@ -470,7 +408,7 @@ void GSFaceExtrusion::render_gui()
         ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
         ImGui::SliderFloat("Exposure",             &m_exposure,             0.0, 10.0, "%.1f");
         ImGui::SliderFloat("Gamma",                &m_gamma,                0.0, 10.0, "%.1f");
-        ImGui::SliderFloat("Background LOD level", &m_background_lod_level, 0.0, glm::log2(float(m_env_cubemap_rt->m_width)), "%.1f");
+        ImGui::SliderFloat("Background blur",      &m_background_blur,      0.0, 1.0, "%.2f");
 
         ImGui::Spacing();
 
@@ -487,7 +425,7 @@ void GSFaceExtrusion::render_gui()
                 if (ImGui::Selectable(m_hdr_maps_names[i].c_str(), is_selected))
                 {
                     m_current_hdr_map_idx = i;
-                    PrecomputeIndirectLight(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx]);
+                    m_ibl.Load(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx], RGL::ImageBasedLighting::PrefilterMode::FAST);
                 }
 
                 if (is_selected)
@@ -502,8 +440,45 @@ void GSFaceExtrusion::render_gui()
         ImGui::SliderFloat("Animation speed",  &m_animation_speed,  0.0, 1.0,  "%.2f");
         ImGui::SliderFloat("Extrusion amount", &m_extrusion_amount, 0.0, 20.0, "%.1f");
 
+        if (ImGui::BeginCombo("Extrusion method", m_extrusion_methods_names[int(m_extrusion_method)].c_str()))
+        {
+            for (int i = 0; i < m_extrusion_methods_names.size(); ++i)
+            {
+                bool is_selected = (m_extrusion_method == ExtrusionMethod(i));
+                if (ImGui::Selectable(m_extrusion_methods_names[i].c_str(), is_selected))
+                {
+                    m_extrusion_method = ExtrusionMethod(i);
+                }
+
+                if (is_selected)
+                {
+                    ImGui::SetItemDefaultFocus();
+                }
+            }
+            ImGui::EndCombo();
+        }
+
         ImGui::PopItemWidth();
 
+        for (uint32_t index : RGL::Profiler::GetResolvedScopes())
+        {
+            const auto& scope = RGL::Profiler::GetScope(index);
+
+            for (int i = 0; i < 3; ++i)
+            {
+                if (scope.m_name == EXTRUSION_SCOPES_NAMES[i])
+                {
+                    m_extrusion_gpu_ms[i] = scope.m_gpu_ms;
+                }
+            }
+        }
+
+        /* The methods not drawn keep their last timings, switch between them to compare. */
+        for (int i = 0; i < 3; ++i)
+        {
+            ImGui::Text("%-16s %.3f ms", (m_extrusion_methods_names[i] + ":").c_str(), m_extrusion_gpu_ms[i]);
+        }
+
         ImGui::Spacing();
 
         ImGuiTabBarFlags tab_bar_flags = ImGuiTabBarFlags_None;
@@ -9,6 +9,8 @@ uniform DirectionalLight u_directional_light;
 layout (binding = 9)   uniform sampler2D       s_shadow_map;
 layout (binding = 10)  uniform sampler2DShadow s_shadow_map_pcf;
 layout (binding = 11)  uniform sampler3D       s_random_angles;
+layout (binding = 12)  uniform sampler2DArray  s_shadow_min_max; // A single layer, see shadow_min_max.comp.
+layout (binding = 13)  uniform sampler2D       s_evsm;           // The prefiltered moments, see evsm_moments.comp.
 
 uniform vec3 u_offset_tex_size;
 uniform float u_radius;
@@ -18,6 +20,11 @@ uniform float u_light_radius_uv;
 uniform float u_light_near;
 uniform float u_light_far;
 uniform int   u_pcf_samples;
+uniform bool  u_adaptive_sampling;
+
+uniform bool  u_evsm;                // A single tap of the EVSM instead of PCSS.
+uniform vec2  u_evsm_exponents;      // c+ and c- of evsm_moments.comp.
+uniform float u_evsm_light_bleeding; // The part of the Chebyshev bound cut off, against the light bleeding.
 
 float correction_factor = 1.0;
 
@@ -380,6 +387,66 @@ const vec2 Poisson128[128] = vec2[](
     vec2(0.9608918, -0.03495717),
     vec2(0.972032, 0.2271516));
 
+vec2 poissonOffset(int samples, int i)
+{
+    switch (samples)
+    {
+        case 25:  return Poisson25[i];
+        case 32:  return Poisson32[i];
+        case 64:  return Poisson64[i];
+        case 100: return Poisson100[i];
+        default:  return Poisson128[i];
+    }
+}
+
+// ------------------------------------------------------------------
+
+// The smallest Poisson table that covers a kernel of the radius at a tap per pixel footprint (or texel), max_samples at most.
+int adaptiveSamplesCount(float radius_uv, vec2 footprint_uv, int max_samples)
+{
+    if (!u_adaptive_sampling)
+    {
+        return max_samples;
+    }
+
+    float texel_uv = 1.0 / float(textureSize(s_shadow_map, 0).x);
+    float taps     = radius_uv / max(max(footprint_uv.x, footprint_uv.y), texel_uv);
+    float wanted   = 3.14159265 * taps * taps;
+    int   samples  = wanted <= 25.0 ? 25 : wanted <= 32.0 ? 32 : wanted <= 64.0 ? 64 : wanted <= 100.0 ? 100 : 128;
+
+    return min(samples, max_samples);
+}
+
+// ------------------------------------------------------------------
+
+// The min and max depth of the search region, from the level of the hierarchy whose texels are at least its size.
+vec2 searchRegionMinMax(vec2 uv, float search_radius_uv)
+{
+    vec2  size       = vec2(textureSize(s_shadow_min_max, 0).xy);
+    int   last_level = textureQueryLevels(s_shadow_min_max) - 1;
+    int   level      = clamp(int(ceil(log2(2.0 * search_radius_uv * size.x))), 0, last_level);
+    ivec2 level_size = textureSize(s_shadow_min_max, level).xy;
+
+    // The region is a texel at most, so it overlaps 2x2 of them.
+    ivec2 first = clamp(ivec2(floor((uv - search_radius_uv) * vec2(level_size))), ivec2(0), level_size - 1);
+    ivec2 last  = clamp(ivec2(floor((uv + search_radius_uv) * vec2(level_size))), ivec2(0), level_size - 1);
+
+    vec2 min_max = vec2(1.0, 0.0);
+
+    for (int y = first.y; y <= last.y; ++y)
+    {
+        for (int x = first.x; x <= last.x; ++x)
+        {
+            vec2 value = texelFetch(s_shadow_min_max, ivec3(x, y, 0), level).rg;
+            min_max    = vec2(min(min_max.x, value.x), max(min_max.y, value.y));
+        }
+    }
+
+    return min_max;
+}
+
+// ------------------------------------------------------------------
+
 // Using similar triangles from the surface point to the area light
 float searchRegionRadiusUV(float z_world)
 {
@@ -418,7 +485,8 @@ void findBlocker(out float accum_blocker_depth,
                   vec2      uv,
                   float     z0,
                   float     bias,
-                  float     searchRegionRadiusUV)
+                  float     searchRegionRadiusUV,
+                  int       samples)
 {
     vec2 random_rotation = texture(s_random_angles, in_world_pos * correction_factor).rg;
     
@@ -426,20 +494,9 @@ void findBlocker(out float accum_blocker_depth,
     num_blockers        = 0.0;
     float biased_depth  = z0 - bias;
 
-    for (int i = 0; i < u_blocker_search_samples; ++i)
+    for (int i = 0; i < samples; ++i)
     {
-        vec2 offset;
-
-        if (u_blocker_search_samples == 25)
-            offset = Poisson25[i];
-        else if (u_blocker_search_samples == 32)
-            offset = Poisson32[i];
-        else if (u_blocker_search_samples == 64)
-            offset = Poisson64[i];
-        else if (u_blocker_search_samples == 100)
-            offset = Poisson100[i];
-        else if (u_blocker_search_samples == 128)
-            offset = Poisson128[i];
+        vec2 offset = poissonOffset(samples, i);
 
         // Add random rotation to the offset 
         offset = vec2(random_rotation.x * offset.x - random_rotation.y * offset.y,
@@ -460,26 +517,21 @@ void findBlocker(out float accum_blocker_depth,
 
 // ------------------------------------------------------------------
 
-float shadowPCF(vec2 uv, float z0, float bias, float filter_radius_uv)
+float shadowPCF(vec2 uv, float z0, float bias, float filter_radius_uv, int samples)
 {
+    // Within a texel the hardware PCF of a tap is the whole kernel.
+    if (u_adaptive_sampling && filter_radius_uv * float(textureSize(s_shadow_map, 0).x) < 0.5)
+    {
+        return texture(s_shadow_map_pcf, vec3(uv, z0 - bias));
+    }
+
     vec2 random_rotation = texture(s_random_angles, in_world_pos * correction_factor).rg;
 
     float sum = 0.0;
 
-    for (int i = 0; i < u_pcf_samples; ++i)
+    for (int i = 0; i < samples; ++i)
     {
-        vec2 offset;
-
-        if (u_pcf_samples == 25)
-            offset = Poisson25[i];
-        else if (u_pcf_samples == 32)
-            offset = Poisson32[i];
-        else if (u_pcf_samples == 64)
-            offset = Poisson64[i];
-        else if (u_pcf_samples == 100)
-            offset = Poisson100[i];
-        else if (u_pcf_samples == 128)
-            offset = Poisson128[i];
+        vec2 offset = poissonOffset(samples, i);
 
         // Add random rotation to the offset 
         offset = vec2(random_rotation.x * offset.x - random_rotation.y * offset.y,
@@ -489,19 +541,30 @@ float shadowPCF(vec2 uv, float z0, float bias, float filter_radius_uv)
         sum += texture(s_shadow_map_pcf, vec3(uv + offset, z0 - bias));
     }
 
-    return sum / float(u_pcf_samples);
+    return sum / float(samples);
 }
 
 // ------------------------------------------------------------------
 
-float shadowPCSS(vec2 uv, float z, float bias, float z_vs)
+float shadowPCSS(vec2 uv, vec2 footprint_uv, float z, float bias, float z_vs)
 {
     // ------------------------
     // STEP 1: blocker search
     // ------------------------
     float accum_blocker_depth, num_blockers;
     float searchRegionRadiusUV = searchRegionRadiusUV(z_vs);
-    findBlocker(accum_blocker_depth, num_blockers, uv, z, bias, searchRegionRadiusUV);
+
+    // Nothing in the region is closer than the receiver (lit), or everything is (in the umbra).
+    if (u_adaptive_sampling)
+    {
+        vec2 min_max = searchRegionMinMax(uv, searchRegionRadiusUV);
+
+        if (min_max.x >= z - bias) return 1.0;
+        if (min_max.y <  z - bias) return 0.0;
+    }
+
+    int blocker_samples = adaptiveSamplesCount(searchRegionRadiusUV, footprint_uv, u_blocker_search_samples);
+    findBlocker(accum_blocker_depth, num_blockers, uv, z, bias, searchRegionRadiusUV, blocker_samples);
 
     if (num_blockers == 0.0)
     {
@@ -519,7 +582,44 @@ float shadowPCSS(vec2 uv, float z, float bias, float z_vs)
     // ------------------------
     // STEP 3: filtering
     // ------------------------
-    return shadowPCF(uv, z, bias, filter_radius);
+    int pcf_samples = adaptiveSamplesCount(filter_radius, footprint_uv, u_pcf_samples);
+    return shadowPCF(uv, z, bias, filter_radius, pcf_samples);
+}
+
+// ------------------------------------------------------------------
+
+// The upper bound of the fraction of the filter region's depths not closer than the receiver, from their mean and variance.
+float chebyshevUpperBound(vec2 moments, float receiver, float min_variance)
+{
+    if (receiver <= moments.x)
+    {
+        return 1.0;
+    }
+
+    float variance = max(moments.y - moments.x * moments.x, min_variance);
+    float d        = receiver - moments.x;
+    float p_max    = variance / (variance + d * d);
+
+    return clamp((p_max - u_evsm_light_bleeding) / (1.0 - u_evsm_light_bleeding), 0.0, 1.0);
+}
+
+// ------------------------------------------------------------------
+
+// The filtered moments of the receiver's footprint in a single trilinear tap, the smaller bound of both warps.
+float shadowEVSM(vec2 uv, float z)
+{
+    vec4  moments  = texture(s_evsm, uv);
+    float depth    = z * 2.0 - 1.0;
+    vec2  receiver = vec2(exp(u_evsm_exponents.x * depth), -exp(-u_evsm_exponents.y * depth));
+
+    // The variance floor follows the slope of the warps, so the bias is about the same in the depth units of both.
+    vec2 depth_scale  = 0.0001 * u_evsm_exponents * receiver;
+    vec2 min_variance = depth_scale * depth_scale;
+
+    float positive = chebyshevUpperBound(moments.xy, receiver.x, min_variance.x);
+    float negative = chebyshevUpperBound(moments.zw, receiver.y, min_variance.y);
+
+    return min(positive, negative);
 }
 
 // ------------------------------------------------------------------
@@ -531,18 +631,26 @@ float shadowOcclusion()
     // transform to [0,1] range
     proj_coords = proj_coords * 0.5 + 0.5;
 
+    // The shadow map area of the pixel, before the returns leave the derivatives undefined.
+    vec2 footprint_uv = fwidth(proj_coords.xy);
+
     if (proj_coords.z > 1.0) return 1.0;
 
     // get depth of current fragment from light's perspective
     float current_depth = proj_coords.z;
 
+    if (u_evsm)
+    {
+        return shadowEVSM(proj_coords.xy, current_depth);
+    }
+
     // check whether current frag pos is in shadow
     float bias = max(0.0001 * (1.0 - dot(normalize(in_normal), -u_directional_light.direction)), 0.000001);
     
     vec4 pos_vs = in_pos_light_view_space;
     pos_vs.xyz /= pos_vs.w;
 
-    return shadowPCSS(proj_coords.xy, current_depth, bias, -(pos_vs.z));
+    return shadowPCSS(proj_coords.xy, footprint_uv, current_depth, bias, -(pos_vs.z));
 }
 
 void main()
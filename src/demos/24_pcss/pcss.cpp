@@ -1,20 +1,24 @@
 #include "pcss.h"
 #include "filesystem.h"
 #include "input.h"
+#include "profiler.h"
 #include "util.h"
 #include "gui/gui.h"
 
 #include <glm/gtc/matrix_inverse.hpp>
 
+#include <algorithm>
+
 PCSS::PCSS()
       : m_dir_light_angles         (-35.0f, 65.0f),
         m_spot_light_angles        (90.0f, -25.0f),
         m_exposure                 (0.3f),
         m_gamma                    (3.6f),
-        m_background_lod_level     (1.2),
-        m_skybox_vao               (0),
-        m_skybox_vbo               (0),
+        m_background_blur          (0.1f),
         m_dir_shadow_map           (0),
+        m_dir_shadow_map_view      (0),
+        m_dir_shadow_min_max       (0),
+        m_dir_evsm                 { 0, 0 },
         m_shadow_fbo               (0),
         m_dir_shadow_frustum_size  (20.0f),
         m_dir_shadow_frustum_planes(120, 250),
@@ -24,24 +28,26 @@ PCSS::PCSS()
 
 PCSS::~PCSS()
 {
-    if (m_skybox_vao != 0)
+    if (m_dir_shadow_map != 0)
     {
-        glDeleteVertexArrays(1, &m_skybox_vao);
-        m_skybox_vao = 0;
+        glDeleteTextures(1, &m_dir_shadow_map);
+        m_dir_shadow_map = 0;
     }
 
-    if (m_skybox_vbo != 0)
+    if (m_dir_shadow_map_view != 0)
     {
-        glDeleteBuffers(1, &m_skybox_vbo);
-        m_skybox_vbo = 0;
+        glDeleteTextures(1, &m_dir_shadow_map_view);
+        m_dir_shadow_map_view = 0;
     }
 
-    if (m_dir_shadow_map != 0)
+    if (m_dir_shadow_min_max != 0)
     {
-        glDeleteTextures(1, &m_dir_shadow_map);
-        m_dir_shadow_map = 0;
+        glDeleteTextures(1, &m_dir_shadow_min_max);
+        m_dir_shadow_min_max = 0;
     }
 
+    glDeleteTextures(2, m_dir_evsm);
+
     if (m_random_angles_tex3d_id != 0)
     {
         glDeleteTextures(1, &m_random_angles_tex3d_id);
@@ -67,6 +73,7 @@ void PCSS::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(-10.3, 7.6, -5.42);
     m_camera->setOrientation(glm::quat(-0.3, -0.052, -0.931, -0.165));
    
@@ -82,11 +89,16 @@ void PCSS::init_app()
     m_textured_models[3].GenPQTorusKnot(256, 64, 2, 3, 0.75, 0.25);
     m_textured_models[4].GenSphere(1.0, 64);
 
-    m_textured_models_model_matrices[0] = glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 0.0,   0.0)) * glm::scale(glm::mat4(1.0), glm::vec3(6.0, 0.1, 6.0));
-    m_textured_models_model_matrices[1] = glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 2.0,   6.1)) * glm::scale(glm::mat4(1.0), glm::vec3(6.0, 2.0, 0.1));
-    m_textured_models_model_matrices[2] = glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 2.11, -3.5)) * glm::scale(glm::mat4(1.0), glm::vec3(1.0, 1.0, 1.0));
-    m_textured_models_model_matrices[3] = glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 1.21,  0.0)) * glm::scale(glm::mat4(1.0), glm::vec3(1.0, 1.0, 1.0));
-    m_textured_models_model_matrices[4] = glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 1.11,  3.5)) * glm::scale(glm::mat4(1.0), glm::vec3(1.0, 1.0, 1.0));
+    m_textured_models_transforms.Add(glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 0.0,   0.0)) * glm::scale(glm::mat4(1.0), glm::vec3(6.0, 0.1, 6.0)));
+    m_textured_models_transforms.Add(glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 2.0,   6.1)) * glm::scale(glm::mat4(1.0), glm::vec3(6.0, 2.0, 0.1)));
+    m_textured_models_transforms.Add(glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 2.11, -3.5)) * glm::scale(glm::mat4(1.0), glm::vec3(1.0, 1.0, 1.0)));
+    m_textured_models_transforms.Add(glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 1.21,  0.0)) * glm::scale(glm::mat4(1.0), glm::vec3(1.0, 1.0, 1.0)));
+    m_textured_models_transforms.Add(glm::translate(glm::mat4(1.0), glm::vec3(-6.0, 4 + 1.11,  3.5)) * glm::scale(glm::mat4(1.0), glm::vec3(1.0, 1.0, 1.0)));
+
+    for (uint32_t i = 0; i < std::size(m_textured_models); ++i)
+    {
+        m_textured_models_previous_model_matrices[i] = m_textured_models_transforms.GetModel(i);
+    }
 
     m_scene_bbox = { glm::vec3(-15), glm::vec3(15) }; //Note: in a real-life app, the scene's bounding box should be computed!
     UpdateLightMatrix();
@@ -151,57 +163,32 @@ void PCSS::init_app()
     m_ambient_light_shader = std::make_shared<RGL::Shader>(dir + "pbr-lighting.vert", dir + "pbr-ambient.frag");
     m_ambient_light_shader->link();
 
-    m_equirectangular_to_cubemap_shader = std::make_shared<RGL::Shader>(dir + "cubemap.vert", dir + "equirectangular_to_cubemap.frag");
-    m_equirectangular_to_cubemap_shader->link();
-
-    m_irradiance_convolution_shader = std::make_shared<RGL::Shader>(dir + "cubemap.vert", dir + "irradiance_convolution.frag");
-    m_irradiance_convolution_shader->link();
-
-    m_prefilter_env_map_shader = std::make_shared<RGL::Shader>(dir + "cubemap.vert", dir + "prefilter_cubemap.frag");
-    m_prefilter_env_map_shader->link();
-
-    m_precompute_brdf = std::make_shared<RGL::Shader>("src/demos/10_postprocessing_filters/FSQ.vert", dir + "precompute_brdf.frag");
-    m_precompute_brdf->link();
-
-    m_background_shader = std::make_shared<RGL::Shader>(dir + "background.vert", dir + "background.frag");
-    m_background_shader->link();
+    m_skybox.Create();
 
-    m_tmo_ps = std::make_shared<PostprocessFilter>(RGL::Window::getWidth(), RGL::Window::getHeight());
+    m_tmo_ps = std::make_shared<PostprocessFilter>();
+    m_dynamic_resolution.Create();
+    m_temporal_aa.Create();
+    m_variable_rate_shading.Create();
 
     // IBL precomputations
-    GenSkyboxGeometry();
-
-    m_env_cubemap_rt = std::make_shared<CubeMapRenderTarget>();
-    m_env_cubemap_rt->set_position(glm::vec3(0.0));
-    m_env_cubemap_rt->generate_rt(2048, 2048, true);
-
-    m_irradiance_cubemap_rt = std::make_shared<CubeMapRenderTarget>();
-    m_irradiance_cubemap_rt->set_position(glm::vec3(0.0));
-    m_irradiance_cubemap_rt->generate_rt(32, 32);
-
-    m_prefiltered_env_map_rt = std::make_shared<CubeMapRenderTarget>();
-    m_prefiltered_env_map_rt->set_position(glm::vec3(0.0));
-    m_prefiltered_env_map_rt->generate_rt(512, 512, true);
-
-    m_brdf_lut_rt = std::make_shared<Texture2DRenderTarget>();
-    m_brdf_lut_rt->generate_rt(512, 512);
-
-    PrecomputeIndirectLight(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx]);
-    PrecomputeBRDF(m_brdf_lut_rt);
+    m_ibl.Create();
+    m_ibl.Load(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx]);
 
     // Shadows
     m_dir_light_shadow_map_res = glm::uvec2(1024);
     CreateDirectionalShadowMap(m_dir_light_shadow_map_res.x, m_dir_light_shadow_map_res.y);
     CreateShadowFBO(m_dir_shadow_map);
 
-    m_shadow_map_pcf_sampler.Create();
-    m_shadow_map_pcf_sampler.SetFiltering(RGL::TextureFiltering::MIN, RGL::TextureFilteringParam::LINEAR);
-    m_shadow_map_pcf_sampler.SetFiltering(RGL::TextureFiltering::MIN, RGL::TextureFilteringParam::LINEAR);
-    m_shadow_map_pcf_sampler.SetWraping(RGL::TextureWrapingCoordinate::S, RGL::TextureWrapingParam::CLAMP_TO_BORDER);
-    m_shadow_map_pcf_sampler.SetWraping(RGL::TextureWrapingCoordinate::T, RGL::TextureWrapingParam::CLAMP_TO_BORDER);
-    m_shadow_map_pcf_sampler.SetBorderColor(1, 0, 0, 0);
-    m_shadow_map_pcf_sampler.SetCompareMode(RGL::TextureCompareMode::REF);
-    m_shadow_map_pcf_sampler.SetCompareFunc(RGL::TextureCompareFunc::LEQUAL);
+    m_shadow_map_pcf_sampler.m_min_filter   = RGL::TextureFilteringParam::LINEAR;
+    m_shadow_map_pcf_sampler.m_mag_filter   = RGL::TextureFilteringParam::LINEAR;
+    m_shadow_map_pcf_sampler.m_wrap_s       = RGL::TextureWrapingParam::CLAMP_TO_BORDER;
+    m_shadow_map_pcf_sampler.m_wrap_t       = RGL::TextureWrapingParam::CLAMP_TO_BORDER;
+    m_shadow_map_pcf_sampler.m_border_color = RGL::SamplerBorderColor::OPAQUE_WHITE;
+    m_shadow_map_pcf_sampler.m_compare_mode = RGL::TextureCompareMode::REF;
+    m_shadow_map_pcf_sampler.m_compare_func = RGL::TextureCompareFunc::LEQUAL;
+
+    m_evsm_sampler.m_min_filter     = RGL::TextureFilteringParam::LINEAR_MIP_LINEAR;
+    m_evsm_sampler.m_max_anisotropy = 8.0f;
 
     uint32_t random_angles_size = 128;
     m_random_angles_tex3d_id = GenerateRandomAnglesTexture3D(random_angles_size);
@@ -210,10 +197,22 @@ void PCSS::init_app()
     m_generate_shadow_map_shader = std::make_shared<RGL::Shader>(dir + "generate_shadow_map.vert", dir + "generate_shadow_map.frag");
     m_generate_shadow_map_shader->link();
 
+    m_shadow_min_max_shader = std::make_shared<RGL::Shader>(dir + "shadow_min_max.comp");
+    m_shadow_min_max_shader->link();
+
+    m_evsm_moments_shader = std::make_shared<RGL::Shader>(dir + "evsm_moments.comp");
+    m_evsm_moments_shader->link();
+
+    m_evsm_blur_shader = std::make_shared<RGL::Shader>(dir + "evsm_blur.comp");
+    m_evsm_blur_shader->link();
+
     m_directional_light_shader = std::make_shared<RGL::Shader>(dir + "pbr-lighting-shadow.vert", dir + "pbr-directional-shadow.frag");
     m_directional_light_shader->link();
 
     glEnable(GL_CULL_FACE);  
+
+    /* The lighting passes test against the depth of the motion vector pass. */
+    glDepthFunc(GL_LEQUAL);
 }
 
 void PCSS::input()
@@ -272,185 +271,6 @@ void PCSS::update(double delta_time)
     m_camera->update(delta_time);
 }
 
-void PCSS::HdrEquirectangularToCubemap(const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt, const std::shared_ptr<RGL::Texture2D>& m_equirectangular_map)
-{
-    /* Update all faces per frame */
-    m_equirectangular_to_cubemap_shader->bind();
-    m_equirectangular_to_cubemap_shader->setUniform("u_projection", cubemap_rt->m_projection);
-
-    glViewport(0, 0, cubemap_rt->m_width, cubemap_rt->m_height);
-    glBindFramebuffer(GL_FRAMEBUFFER, cubemap_rt->m_fbo_id);
-    m_equirectangular_map->Bind(1);
-
-    for (uint8_t side = 0; side < 6; ++side)
-    {
-        m_equirectangular_to_cubemap_shader->setUniform("u_view", cubemap_rt->m_view_transforms[side]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, cubemap_rt->m_cubemap_texture_id, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        glBindVertexArray(m_skybox_vao);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-    }
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
-}
-
-void PCSS::IrradianceConvolution(const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt)
-{
-    /* Update all faces per frame */
-    m_irradiance_convolution_shader->bind();
-    m_irradiance_convolution_shader->setUniform("u_projection", cubemap_rt->m_projection);
-
-    glViewport(0, 0, cubemap_rt->m_width, cubemap_rt->m_height);
-    glBindFramebuffer(GL_FRAMEBUFFER, cubemap_rt->m_fbo_id);
-    m_env_cubemap_rt->bindTexture(1);
-
-    for (uint8_t side = 0; side < 6; ++side)
-    {
-        m_irradiance_convolution_shader->setUniform("u_view", cubemap_rt->m_view_transforms[side]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, cubemap_rt->m_cubemap_texture_id, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        glBindVertexArray(m_skybox_vao);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-    }
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
-}
-
-void PCSS::PrefilterCubemap(const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt)
-{
-    m_prefilter_env_map_shader->bind();
-    m_prefilter_env_map_shader->setUniform("u_projection", cubemap_rt->m_projection);
-    
-    m_env_cubemap_rt->bindTexture(1);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, cubemap_rt->m_fbo_id);
-
-    uint8_t max_mip_levels = glm::log2(float(cubemap_rt->m_width));
-    for (uint8_t mip = 0; mip < max_mip_levels; ++mip)
-    {
-        // resize the framebuffer according to mip-level size.
-        uint32_t mip_width  = cubemap_rt->m_width  * std::pow(0.5, mip);
-        uint32_t mip_height = cubemap_rt->m_height * std::pow(0.5, mip);
-
-        glBindRenderbuffer(GL_RENDERBUFFER, cubemap_rt->m_rbo_id);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mip_width, mip_height);
-        glViewport(0, 0, mip_width, mip_height);
-
-        float roughness = float(mip) / float(max_mip_levels - 1);
-        m_prefilter_env_map_shader->setUniform("u_roughness", roughness);
-
-        for (uint8_t side = 0; side < 6; ++side)
-        {
-            m_prefilter_env_map_shader->setUniform("u_view", cubemap_rt->m_view_transforms[side]);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, cubemap_rt->m_cubemap_texture_id, mip);
-
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            glBindVertexArray(m_skybox_vao);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-        }
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
-}
-
-void PCSS::PrecomputeIndirectLight(const std::filesystem::path& hdri_map_filepath)
-{
-    auto envmap_hdr = std::make_shared<RGL::Texture2D>();
-    envmap_hdr->LoadHdr(hdri_map_filepath);
-    auto envmap_metadata = envmap_hdr->GetMetadata();
-
-    HdrEquirectangularToCubemap(m_env_cubemap_rt, envmap_hdr);
-
-    glBindTexture(GL_TEXTURE_CUBE_MAP, m_env_cubemap_rt->m_cubemap_texture_id);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-
-    IrradianceConvolution(m_irradiance_cubemap_rt);
-    PrefilterCubemap(m_prefiltered_env_map_rt);
-}
-
-void PCSS::PrecomputeBRDF(const std::shared_ptr<Texture2DRenderTarget>& rt)
-{
-    GLuint m_dummy_vao_id;
-    glCreateVertexArrays(1, &m_dummy_vao_id);
-
-    rt->bindRenderTarget();
-    m_precompute_brdf->bind();
-
-    glBindVertexArray(m_dummy_vao_id);
-    glDrawArrays(GL_TRIANGLES, 0, 3);
-
-    glDeleteVertexArrays(1, &m_dummy_vao_id);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
-}
-
-void PCSS::GenSkyboxGeometry()
-{
-    m_skybox_vao = 0;
-    m_skybox_vbo = 0;
-
-    glCreateVertexArrays(1, &m_skybox_vao);
-    glCreateBuffers(1, &m_skybox_vbo);
-
-    std::vector<float> skybox_positions = {
-        // positions          
-        -1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
-        // front face
-        -1.0f, -1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-        // left face
-        -1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-        // right face
-         1.0f,  1.0f,  1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-        // bottom face
-        -1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f, -1.0f,
-        // top face
-        -1.0f,  1.0f, -1.0f,
-         1.0f,  1.0f , 1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f,  1.0f,  1.0f,
-    };
-
-    /* Set up buffer objects */
-    glNamedBufferStorage(m_skybox_vbo, skybox_positions.size() * sizeof(skybox_positions[0]), skybox_positions.data(), 0 /*flags*/);
-
-    /* Set up VAO */
-    glEnableVertexArrayAttrib(m_skybox_vao, 0 /*index*/);
-
-    /* Separate attribute format */
-    glVertexArrayAttribFormat(m_skybox_vao, 0 /*index*/, 3 /*size*/, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/);
-    glVertexArrayAttribBinding(m_skybox_vao, 0 /*index*/, 0 /*bindingindex*/);
-    glVertexArrayVertexBuffer(m_skybox_vao, 0 /*bindingindex*/, m_skybox_vbo, 0 /*offset*/, sizeof(glm::vec3) /*stride*/);
-}
-
 void PCSS::CreateDirectionalShadowMap(uint32_t width, uint32_t height)
 {
     GLfloat border[] = { 1.0, 0.0, 0.0, 0.0 };
@@ -463,6 +283,20 @@ void PCSS::CreateDirectionalShadowMap(uint32_t width, uint32_t height)
     glTextureParameteri(m_dir_shadow_map, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
     glTextureParameteri(m_dir_shadow_map, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
     glTextureParameterfv(m_dir_shadow_map, GL_TEXTURE_BORDER_COLOR, border);
+
+    glGenTextures(1, &m_dir_shadow_map_view);
+    glTextureView(m_dir_shadow_map_view, GL_TEXTURE_2D_ARRAY, m_dir_shadow_map, GL_DEPTH_COMPONENT32F, 0, 1, 0, 1);
+
+    const uint32_t min_max_size = glm::max(width / SHADOW_MIN_MAX_FOOTPRINT, 1u);
+
+    glCreateTextures   (GL_TEXTURE_2D_ARRAY, 1, &m_dir_shadow_min_max);
+    glTextureStorage3D (m_dir_shadow_min_max, RGL::Texture::GetMaxMipMapsLevels(min_max_size, min_max_size, 1), GL_RG32F, min_max_size, min_max_size, 1);
+    glTextureParameteri(m_dir_shadow_min_max, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(m_dir_shadow_min_max, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glCreateTextures  (GL_TEXTURE_2D, 2, m_dir_evsm);
+    glTextureStorage2D(m_dir_evsm[0], RGL::Texture::GetMaxMipMapsLevels(width, height, 1), GL_RGBA32F, width, height);
+    glTextureStorage2D(m_dir_evsm[1], 1,                                                  GL_RGBA32F, width, height);
 }
 
 void PCSS::CreateShadowFBO(GLuint shadow_texture)
@@ -485,12 +319,79 @@ void PCSS::GenerateShadowMap(uint32_t width, uint32_t height)
     m_generate_shadow_map_shader->bind();
     m_generate_shadow_map_shader->setUniform("u_light_view_projection", m_dir_light_view_projection);
 
-    for (uint32_t i = 0; i < std::size(m_textured_models_model_matrices); ++i)
+    for (uint32_t i = 0; i < std::size(m_textured_models); ++i)
     {
-        m_generate_shadow_map_shader->setUniform("u_model", m_textured_models_model_matrices[i]);
-        m_textured_models[i].Render();
+        m_generate_shadow_map_shader->setUniform("u_model", m_textured_models_transforms.GetModel(i));
+        m_textured_models[i].RenderDepth();
     }
     glCullFace(GL_BACK);
+
+    if (m_dir_light_properties.shadow_filter == ShadowFilter::EVSM)
+    {
+        BuildEvsm();
+    }
+    else if (m_adaptive_sampling)
+    {
+        BuildShadowMinMax();
+    }
+}
+
+void PCSS::BuildShadowMinMax()
+{
+    const uint32_t levels = RGL::Texture::GetMaxMipMapsLevels(m_dir_light_shadow_map_res.x / SHADOW_MIN_MAX_FOOTPRINT, m_dir_light_shadow_map_res.y / SHADOW_MIN_MAX_FOOTPRINT, 1);
+
+    m_shadow_min_max_shader->bind();
+
+    for (uint32_t level = 0; level < levels; ++level)
+    {
+        const uint32_t size = glm::max((m_dir_light_shadow_map_res.x / SHADOW_MIN_MAX_FOOTPRINT) >> level, 1u);
+
+        /* The first level reduces the depths, the next ones the previous level. */
+        m_shadow_min_max_shader->setUniform("u_from_depth",   level == 0);
+        m_shadow_min_max_shader->setUniform("u_source_level", int(level == 0 ? 0 : level - 1));
+        m_shadow_min_max_shader->setUniform("u_footprint",    int(level == 0 ? SHADOW_MIN_MAX_FOOTPRINT : 2));
+
+        glBindTextureUnit(0, level == 0 ? m_dir_shadow_map_view : m_dir_shadow_min_max);
+        glBindImageTexture(0, m_dir_shadow_min_max, level, GL_TRUE, 0, GL_WRITE_ONLY, GL_RG32F);
+
+        glDispatchCompute((size + 7) / 8, (size + 7) / 8, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+}
+
+void PCSS::BuildEvsm()
+{
+    const uint32_t groups_x = (m_dir_light_shadow_map_res.x + 7) / 8;
+    const uint32_t groups_y = (m_dir_light_shadow_map_res.y + 7) / 8;
+
+    m_evsm_moments_shader->bind();
+    m_evsm_moments_shader->setUniform("u_exponents", glm::vec2(EVSM_POSITIVE_EXPONENT, EVSM_NEGATIVE_EXPONENT));
+
+    glBindTextureUnit (0, m_dir_shadow_map);
+    glBindImageTexture(0, m_dir_evsm[0], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+    glDispatchCompute(groups_x, groups_y, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    if (m_evsm_blur_radius > 0)
+    {
+        m_evsm_blur_shader->bind();
+        m_evsm_blur_shader->setUniform("u_radius", m_evsm_blur_radius);
+
+        /* Horizontally to the intermediate, vertically back to the level 0. */
+        for (uint32_t pass = 0; pass < 2; ++pass)
+        {
+            m_evsm_blur_shader->setUniform("u_direction", glm::uvec2(pass == 0, pass == 1));
+
+            glBindTextureUnit (0, m_dir_evsm[pass]);
+            glBindImageTexture(0, m_dir_evsm[1 - pass], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+            glDispatchCompute(groups_x, groups_y, 1);
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        }
+    }
+
+    glGenerateTextureMipmap(m_dir_evsm[0]);
 }
 
 GLuint PCSS::GenerateRandomAnglesTexture3D(uint32_t size)
@@ -544,6 +445,19 @@ void PCSS::UpdateLightMatrix()
     m_dir_shadow_frustum_planes = glm::vec2(min_extents.z, max_extents.z);
 }
 
+void PCSS::RenderMotionVectors()
+{
+    m_temporal_aa.BeginMotionVectors(*m_tmo_ps->m_rt);
+
+    for (uint32_t i = 0; i < std::size(m_textured_models); ++i)
+    {
+        m_temporal_aa.SetObjectTransforms(m_textured_models_transforms.GetModel(i), m_textured_models_previous_model_matrices[i]);
+        m_textured_models[i].Render();
+    }
+
+    m_temporal_aa.EndMotionVectors(*m_tmo_ps->m_rt);
+}
+
 void PCSS::RenderTexturedModels()
 {
     m_ambient_light_shader->bind();
@@ -555,18 +469,16 @@ void PCSS::RenderTexturedModels()
     m_ambient_light_shader->setUniform("u_has_ao_map",        true);
     m_ambient_light_shader->setUniform("u_has_emissive_map",  false);
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+    m_textured_models_transforms.Update(m_camera->viewProjection());
 
     /* First, render the ambient color only for the opaque objects. */
-    m_irradiance_cubemap_rt->bindTexture(6);
-    m_prefiltered_env_map_rt->bindTexture(7);
-    m_brdf_lut_rt->bindTexture(8);
+    m_ibl.BindIrradianceSH();
+    m_ibl.BindPrefilteredMap(7);
+    m_ibl.BindBrdfLut(8);
 
-    for (uint32_t i = 0; i < std::size(m_textured_models_model_matrices); ++i)
+    for (uint32_t i = 0; i < std::size(m_textured_models); ++i)
     {
-        m_ambient_light_shader->setUniform("u_model",         m_textured_models_model_matrices[i]);
-        m_ambient_light_shader->setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_textured_models_model_matrices[i]))));
-        m_ambient_light_shader->setUniform("u_mvp",           view_projection * m_textured_models_model_matrices[i]);
+        m_textured_models_transforms.SetUniforms(*m_ambient_light_shader, i);
 
         m_textured_models[i].Render();
     }
@@ -599,18 +511,24 @@ void PCSS::RenderTexturedModels()
     m_directional_light_shader->setUniform("u_light_radius_uv",        m_light_radius_uv / (m_dir_shadow_frustum_size * 2.0f));
     m_directional_light_shader->setUniform("u_light_near",             m_dir_shadow_frustum_planes.x);
     m_directional_light_shader->setUniform("u_light_far",              m_dir_shadow_frustum_planes.y);
+    m_directional_light_shader->setUniform("u_adaptive_sampling",      m_adaptive_sampling);
+    m_directional_light_shader->setUniform("u_evsm",                   m_dir_light_properties.shadow_filter == ShadowFilter::EVSM);
+    m_directional_light_shader->setUniform("u_evsm_exponents",         glm::vec2(EVSM_POSITIVE_EXPONENT, EVSM_NEGATIVE_EXPONENT));
+    m_directional_light_shader->setUniform("u_evsm_light_bleeding",    m_evsm_light_bleeding);
 
-    m_shadow_map_pcf_sampler.Bind(10);
+    RGL::SamplerCache::Bind(10, m_shadow_map_pcf_sampler);
 
     glBindTextureUnit(9, m_dir_shadow_map);
     glBindTextureUnit(10, m_dir_shadow_map); 
     glBindTextureUnit(11, m_random_angles_tex3d_id);
+    glBindTextureUnit(12, m_dir_shadow_min_max);
+
+    RGL::SamplerCache::Bind(13, m_evsm_sampler);
+    glBindTextureUnit(13, m_dir_evsm[0]);
    
-    for (unsigned i = 0; i < std::size(m_textured_models_model_matrices); ++i)
+    for (unsigned i = 0; i < std::size(m_textured_models); ++i)
     {
-        m_directional_light_shader->setUniform("u_model",         m_textured_models_model_matrices[i]);
-        m_directional_light_shader->setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_textured_models_model_matrices[i]))));
-        m_directional_light_shader->setUniform("u_mvp",           view_projection * m_textured_models_model_matrices[i]);
+        m_textured_models_transforms.SetUniforms(*m_directional_light_shader, i);
 
         m_textured_models[i].Render();
     }
@@ -624,26 +542,53 @@ void PCSS::RenderTexturedModels()
 void PCSS::render()
 {
     // Generate shadow map
-    GenerateShadowMap(m_dir_light_shadow_map_res.x, m_dir_light_shadow_map_res.y);
+    {
+        RGL::ProfilerScope scope("Shadow map");
+        GenerateShadowMap(m_dir_light_shadow_map_res.x, m_dir_light_shadow_map_res.y);
+    }
 
     /* Put render specific code here. Don't update variables here! */
-    m_tmo_ps->bindFilterFBO();
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
+    m_dynamic_resolution.Update(RGL::Window::getWidth(), RGL::Window::getHeight());
+    m_temporal_aa.Update(*m_camera, m_dynamic_resolution.GetRenderWidth(), m_dynamic_resolution.GetRenderHeight(), RGL::Window::getWidth(), RGL::Window::getHeight());
 
-    RenderTexturedModels();
+    /* The shading rates come from the last frame's scene, before the target is bound and cleared. */
+    if (m_tmo_ps->m_rt)
+    {
+        m_variable_rate_shading.Update(*m_tmo_ps->m_rt, m_dynamic_resolution.GetRenderWidth(), m_dynamic_resolution.GetRenderHeight(), m_temporal_aa.GetMotionVectors());
+    }
 
-    m_background_shader->bind();
-    m_background_shader->setUniform("u_projection", m_camera->m_projection);
-    m_background_shader->setUniform("u_view", glm::mat4(glm::mat3(m_camera->m_view)));
-    m_background_shader->setUniform("u_lod_level", m_background_lod_level);
-    m_env_cubemap_rt->bindTexture();
-    
-    glCullFace(GL_FRONT);
-    glBindVertexArray(m_skybox_vao);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glCullFace(GL_BACK);
+    m_tmo_ps->bindFilterFBO(m_dynamic_resolution.GetRenderWidth(), m_dynamic_resolution.GetRenderHeight());
+    glViewport(0, 0, m_dynamic_resolution.GetRenderWidth(), m_dynamic_resolution.GetRenderHeight());
+
+    if (m_temporal_aa.IsEnabled())
+    {
+        RGL::ProfilerScope scope("Motion vectors");
+        RenderMotionVectors();
+    }
+
+    {
+        RGL::ProfilerScope scope("Lighting");
+
+        m_variable_rate_shading.BeginShading();
+        RenderTexturedModels();
+        m_variable_rate_shading.EndShading();
+    }
+
+    {
+        RGL::ProfilerScope scope("Skybox");
 
-    m_tmo_ps->render(m_exposure, m_gamma);
+        m_skybox.Render(m_ibl, m_camera->jitteredProjection(), m_camera->m_view, m_background_blur);
+    }
+
+    {
+        RGL::ProfilerScope scope("Tone mapping");
+        m_tmo_ps->render(m_exposure, m_gamma, m_dynamic_resolution, m_temporal_aa);
+    }
+
+    for (uint32_t i = 0; i < std::size(m_textured_models); ++i)
+    {
+        m_textured_models_previous_model_matrices[i] = m_textured_models_transforms.GetModel(i);
+    }
 }
 
 void PCSS::render_gui()
@@ -681,7 +626,11 @@ void PCSS::render_gui()
         ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
         ImGui::SliderFloat("Exposure",             &m_exposure,             0.0, 10.0, "%.1f");
         ImGui::SliderFloat("Gamma",                &m_gamma,                0.0, 10.0, "%.1f");
-        ImGui::SliderFloat("Background LOD level", &m_background_lod_level, 0.0, glm::log2(float(m_env_cubemap_rt->m_width)), "%.1f");
+        ImGui::SliderFloat("Background blur",      &m_background_blur,      0.0, 1.0, "%.2f");
+
+        m_dynamic_resolution.RenderGui();
+        m_temporal_aa.RenderGui();
+        m_variable_rate_shading.RenderGui();
 
         if (ImGui::BeginCombo("HDR map", m_hdr_maps_names[m_current_hdr_map_idx].c_str()))
         {
@@ -692,7 +641,8 @@ void PCSS::render_gui()
                 {
                     glDisable(GL_CULL_FACE);
                     m_current_hdr_map_idx = i;
-                    PrecomputeIndirectLight(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL/" / m_hdr_maps_names[m_current_hdr_map_idx]);
+                    m_ibl.Load(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL/" / m_hdr_maps_names[m_current_hdr_map_idx], RGL::ImageBasedLighting::PrefilterMode::FAST);
+                    m_temporal_aa.Reset();
                     glEnable(GL_CULL_FACE);
                 }
 
@@ -723,8 +673,20 @@ void PCSS::render_gui()
             }
 
             ImGui::SliderFloat("Light radius", &m_light_radius_uv, 0.0, 1.0, "%.2f");
+            ImGui::Checkbox   ("Adaptive sampling", &m_adaptive_sampling);
+
+            if (ImGui::IsItemHovered())
+            {
+                ImGui::SetTooltip("Skips the lit and the umbra pixels with a min/max depth hierarchy,\nscales the sample counts with the kernel's size in pixels.");
+            }
         }
 
+        ImGui::Spacing();
+        ImGui::Text("# EVSM settings");
+
+        ImGui::SliderInt  ("Blur radius",    &m_evsm_blur_radius,    0,    8);
+        ImGui::SliderFloat("Light bleeding", &m_evsm_light_bleeding, 0.0f, 0.9f, "%.2f");
+
         ImGui::PopItemWidth();
 
         ImGui::Spacing();
@@ -738,6 +700,14 @@ void PCSS::render_gui()
                 {
                     ImGui::ColorEdit3 ("Color",                 &m_dir_light_properties.color[0]);
                     ImGui::SliderFloat("Light intensity",       &m_dir_light_properties.intensity, 0.0, 10.0,  "%.1f");
+
+                    const char* shadow_filters[] = { "PCSS", "EVSM" };
+                    int         shadow_filter    = int(m_dir_light_properties.shadow_filter);
+
+                    if (ImGui::Combo("Shadow filter", &shadow_filter, shadow_filters, std::size(shadow_filters)))
+                    {
+                        m_dir_light_properties.shadow_filter = ShadowFilter(shadow_filter);
+                    }
                     
                     if (ImGui::SliderFloat2("Azimuth and Elevation", &m_dir_light_angles[0], -180.0, 180.0, "%.1f"))
                     {
@@ -2,8 +2,18 @@
 #include "core_app.h"
 
 #include "camera.h"
+#include "dynamic_resolution.h"
+#include "gl_state.h"
+#include "image_based_lighting.h"
+#include "render_target_pool.h"
+#include "sampler_cache.h"
 #include "static_model.h"
 #include "shader.h"
+#include "skybox.h"
+#include "temporal_aa.h"
+#include "transform_store.h"
+#include "variable_rate_shading.h"
+#include "window.h"
 
 #include <memory>
 #include <vector>
@@ -14,9 +24,13 @@ struct BaseLight
     float intensity;
 };
 
+/* PCSS - the blocker search and the PCF of the depths, EVSM - a single filtered tap of the prefiltered moments. */
+enum class ShadowFilter { PCSS, EVSM };
+
 struct DirectionalLight : BaseLight
 {
-    glm::vec3 direction;
+    glm::vec3    direction;
+    ShadowFilter shadow_filter = ShadowFilter::PCSS;
 
     void setDirection(float azimuth, float elevation)
     {
@@ -35,26 +49,13 @@ struct PostprocessFilter
 {
     std::shared_ptr<RGL::Shader> m_shader;
 
-    GLuint m_fbo_id;
-    GLuint m_rbo_id;
-    GLuint m_tex_id;
-    GLuint m_dummy_vao_id;
-
-    PostprocessFilter(uint32_t width, uint32_t height)
-    {
-        glCreateFramebuffers(1, &m_fbo_id);
-
-        glCreateTextures(GL_TEXTURE_2D, 1, &m_tex_id);
-        glTextureStorage2D(m_tex_id, 1, GL_RGB32F, width, height);
-        glTextureParameteri(m_tex_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTextureParameteri(m_tex_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        glCreateRenderbuffers(1, &m_rbo_id);
-        glNamedRenderbufferStorage(m_rbo_id, GL_DEPTH24_STENCIL8, width, height);
+    /* The HDR target of the frame, from bindFilterFBO() until render(). */
+    std::shared_ptr<RGL::RenderTarget> m_rt;
 
-        glNamedFramebufferTexture(m_fbo_id, GL_COLOR_ATTACHMENT0, m_tex_id, 0);
-        glNamedFramebufferRenderbuffer(m_fbo_id, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_rbo_id);
+    GLuint m_dummy_vao_id{};
 
+    PostprocessFilter()
+    {
         m_shader = std::make_shared<RGL::Shader>("src/demos/10_postprocessing_filters/FSQ.vert", "src/demos/22_pbr/tmo.frag");
         m_shader->link();
 
@@ -63,50 +64,64 @@ struct PostprocessFilter
 
     ~PostprocessFilter()
     {
-        if(m_fbo_id != 0)
-        {
-            glDeleteFramebuffers(1, &m_fbo_id);
-        }
-
-        if(m_rbo_id != 0)
-        {
-            glDeleteRenderbuffers(1, &m_rbo_id);
-        }
-
-        if(m_tex_id != 0)
-        {
-            glDeleteTextures(1, &m_tex_id);
-        }
-
         if (m_dummy_vao_id != 0)
         {
             glDeleteVertexArrays(1, &m_dummy_vao_id);
         }
     }
 
-    void bindTexture(GLuint unit = 0)
+    void bindTexture(GLuint unit = 0) const
     {
-        glBindTextureUnit(unit, m_tex_id);
+        m_rt->BindColor(unit);
     }
 
-    void bindFilterFBO()
+    void bindFilterFBO(uint32_t width, uint32_t height)
     {
-        glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_id);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        /* The same target every frame, a resize or a new render scale makes the pool create one of the new size. */
+        m_rt = RGL::RenderTargetPool::Acquire({ width, height, RGL::RenderTargetPool::GetColorFormat(RGL::RenderTargetUsage::HDR_COLOR), GL_DEPTH24_STENCIL8 });
+        m_rt->Bind();
     }
 
-    void render(float exposure, float gamma)
+    void render(float exposure, float gamma, RGL::DynamicResolution& dynamic_resolution, RGL::TemporalAA& temporal_aa)
     {
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        /* The temporal resolve is of the output size, it's the upscaler when it's enabled. */
+        const RGL::RenderTarget* source_rt = m_rt.get();
+
+        if (temporal_aa.IsEnabled())
+        {
+            source_rt = &temporal_aa.Resolve(*m_rt);
+        }
+
+        /* A scaled frame is otherwise tone mapped at its size, the upscaling works on the tone mapped colors. */
+        std::shared_ptr<RGL::RenderTarget> ldr_rt;
+
+        if (!temporal_aa.IsEnabled() && dynamic_resolution.IsScaled())
+        {
+            ldr_rt = RGL::RenderTargetPool::Acquire({ m_rt->GetWidth(), m_rt->GetHeight(), GL_RGBA8, 0 });
+            ldr_rt->Bind(GL_COLOR_BUFFER_BIT);
+        }
+        else
+        {
+            RGL::GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+            RGL::GLState::Viewport       (0, 0, source_rt->GetWidth(), source_rt->GetHeight());
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
 
         m_shader->bind();
         m_shader->setUniform("u_exposure", exposure);
         m_shader->setUniform("u_gamma",    gamma);
-        bindTexture();
+        source_rt->BindColor(0);
 
         glBindVertexArray(m_dummy_vao_id);
         glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        if (ldr_rt)
+        {
+            dynamic_resolution.Upscale(*ldr_rt);
+        }
+
+        /* Back to the pool, free for the other passes until the next frame. */
+        m_rt.reset();
     }
 };
 
@@ -129,189 +144,20 @@ public:
     void render_gui()              override;
 
 private:
-    struct Texture2DRenderTarget
-    {
-        GLuint m_texture_id = 0;
-        GLuint m_fbo_id = 0;
-        GLuint m_rbo_id = 0;
-        GLuint m_width = 0, m_height = 0;
-
-        ~Texture2DRenderTarget() { cleanup(); }
-
-        void bindTexture(GLuint unit = 0)
-        {
-            glBindTextureUnit(unit, m_texture_id);
-        }
-
-        void bindRenderTarget()
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_id);
-            glViewport(0, 0, m_width, m_height);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        }
-
-        void cleanup()
-        {
-            if (m_texture_id != 0)
-            {
-                glDeleteTextures(1, &m_texture_id);
-            }
-
-            if (m_fbo_id != 0)
-            {
-                glDeleteFramebuffers(1, &m_fbo_id);
-            }
-
-            if (m_rbo_id != 0)
-            {
-                glDeleteRenderbuffers(1, &m_rbo_id);
-            }
-        }
-
-        void generate_rt(uint32_t width, uint32_t height)
-        {
-            m_width = width;
-            m_height = height;
-
-            glGenTextures(1, &m_texture_id);
-            glBindTexture(GL_TEXTURE_2D, m_texture_id);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, m_width, m_height, 0, GL_RG, GL_FLOAT, 0);
-
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-            glGenFramebuffers(1, &m_fbo_id);
-            glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_id);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_texture_id, 0);
-
-            glGenRenderbuffers(1, &m_rbo_id);
-            glBindRenderbuffer(GL_RENDERBUFFER, m_rbo_id);
-            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_width, m_height);
-            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_rbo_id);
-
-            glBindTexture(GL_TEXTURE_2D, 0);
-            glBindRenderbuffer(GL_RENDERBUFFER, 0);
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        }
-    };
-
-    struct CubeMapRenderTarget
-    {
-        glm::mat4 m_view_transforms[6];
-        glm::mat4 m_projection;
-
-        GLuint    m_cubemap_texture_id = 0;
-        GLuint    m_fbo_id             = 0;
-        GLuint    m_rbo_id             = 0;
-        glm::vec3 m_position           = glm::vec3(0.0f);
-        GLuint m_width, m_height;
-
-        ~CubeMapRenderTarget() { cleanup(); }
-
-        void set_position(const glm::vec3 pos)
-        {
-            m_position = pos;
-            m_view_transforms[0] = glm::lookAt(pos, pos + glm::vec3( 1,  0,  0), glm::vec3(0, -1,  0));
-            m_view_transforms[1] = glm::lookAt(pos, pos + glm::vec3(-1,  0,  0), glm::vec3(0, -1,  0));
-            m_view_transforms[2] = glm::lookAt(pos, pos + glm::vec3( 0,  1,  0), glm::vec3(0,  0,  1));
-            m_view_transforms[3] = glm::lookAt(pos, pos + glm::vec3( 0, -1,  0), glm::vec3(0,  0, -1));
-            m_view_transforms[4] = glm::lookAt(pos, pos + glm::vec3( 0,  0,  1), glm::vec3(0, -1,  0));
-            m_view_transforms[5] = glm::lookAt(pos, pos + glm::vec3( 0,  0, -1), glm::vec3(0, -1,  0));
-
-            m_projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
-        }
-
-        void bindTexture(GLuint unit = 0)
-        {
-            glBindTextureUnit(unit, m_cubemap_texture_id);
-        }
-
-        void cleanup()
-        {
-            if (m_cubemap_texture_id != 0)
-            {
-                glDeleteTextures(1, &m_cubemap_texture_id);
-            }
-
-            if (m_fbo_id != 0)
-            {
-                glDeleteFramebuffers(1, &m_fbo_id);
-            }
-
-            if (m_rbo_id != 0)
-            {
-                glDeleteRenderbuffers(1, &m_rbo_id);
-            }
-        }
-
-        void generate_rt(uint32_t width, uint32_t height, bool gen_mip_levels = false)
-        {
-            m_width  = width;
-            m_height = height;
-
-            glGenTextures(1, &m_cubemap_texture_id);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubemap_texture_id);
-
-            for (uint8_t i = 0; i < 6; ++i)
-            {
-                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, m_width, m_height, 0, GL_RGB, GL_FLOAT, 0);
-            }
-
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, gen_mip_levels ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
-
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-            if (gen_mip_levels) glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-
-            glGenFramebuffers(1, &m_fbo_id);
-            glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_id);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, m_cubemap_texture_id, 0);
-
-            glGenRenderbuffers(1, &m_rbo_id);
-            glBindRenderbuffer(GL_RENDERBUFFER, m_rbo_id);
-            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_width, m_height);
-            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_rbo_id);
-
-            glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-            glBindRenderbuffer(GL_RENDERBUFFER, 0);
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        }
-    }; 
-
-    void HdrEquirectangularToCubemap(const std::shared_ptr<CubeMapRenderTarget> & cubemap_rt, const std::shared_ptr<RGL::Texture2D> & m_equirectangular_map);
-    void IrradianceConvolution      (const std::shared_ptr<CubeMapRenderTarget> & cubemap_rt);
-    void PrefilterCubemap           (const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt);
-    void PrecomputeIndirectLight    (const std::filesystem::path & hdri_map_filepath);
-    void PrecomputeBRDF             (const std::shared_ptr<Texture2DRenderTarget>& rt);
-    void GenSkyboxGeometry();
-
+    void RenderMotionVectors();
     void RenderTexturedModels();
 
-    std::shared_ptr<CubeMapRenderTarget> m_env_cubemap_rt;
-    std::shared_ptr<CubeMapRenderTarget> m_irradiance_cubemap_rt;
-    std::shared_ptr<CubeMapRenderTarget> m_prefiltered_env_map_rt;
-    std::shared_ptr<Texture2DRenderTarget> m_brdf_lut_rt;
+    RGL::ImageBasedLighting m_ibl;
 
-    std::shared_ptr<RGL::Shader> m_equirectangular_to_cubemap_shader;
-    std::shared_ptr<RGL::Shader> m_irradiance_convolution_shader;
-    std::shared_ptr<RGL::Shader> m_prefilter_env_map_shader;
-    std::shared_ptr<RGL::Shader> m_precompute_brdf;
-    std::shared_ptr<RGL::Shader> m_background_shader;
+    RGL::Skybox m_skybox;
 
     std::shared_ptr<RGL::Camera> m_camera;
     std::shared_ptr<RGL::Shader> m_ambient_light_shader;
     std::shared_ptr<RGL::Shader> m_directional_light_shader;
 
     RGL::StaticModel m_textured_models[5];
-    glm::mat4 m_textured_models_model_matrices[5];
-
-    GLuint m_skybox_vao, m_skybox_vbo;
+    RGL::TransformStore m_textured_models_transforms;
+    glm::mat4 m_textured_models_previous_model_matrices[5]; /* Of the previous frame, for the motion vectors. */
 
     BoundingBox m_scene_bbox;
 
@@ -320,10 +166,13 @@ private:
     glm::vec2        m_spot_light_angles;  /* azimuth and elevation angles */
 
     std::shared_ptr<PostprocessFilter> m_tmo_ps;
+    RGL::DynamicResolution             m_dynamic_resolution;
+    RGL::TemporalAA                    m_temporal_aa;
+    RGL::VariableRateShading           m_variable_rate_shading;
     float m_exposure; 
     float m_gamma;
 
-    float m_background_lod_level;
+    float m_background_blur; /* The roughness of the prefiltered level of the background, 0 - the environment map. */
     std::string m_hdr_maps_names[2] = { "phalzer_forest_01_4k.hdr", "sunset_fairway_4k.hdr" };
     uint8_t m_current_hdr_map_idx   = 0;
 
@@ -331,14 +180,30 @@ private:
     void CreateDirectionalShadowMap(uint32_t width, uint32_t height);
     void CreateShadowFBO(GLuint shadow_texture);
     void GenerateShadowMap(uint32_t width, uint32_t height);
+
+    /* The min and max depth hierarchy of the shadow map, the blocker search skips the lit and the umbra pixels with it. */
+    void BuildShadowMinMax();
+    /* The EVSM moments of the shadow map, blurred and mipmapped, for the lights with ShadowFilter::EVSM. */
+    void BuildEvsm();
     GLuint GenerateRandomAnglesTexture3D(uint32_t size);
     void UpdateLightMatrix();
 
-    RGL::TextureSampler m_shadow_map_pcf_sampler;
+    RGL::SamplerDesc m_shadow_map_pcf_sampler;
     GLuint m_dir_shadow_map;
+    GLuint m_dir_shadow_map_view; /* A single layer array view of the shadow map for shadow_min_max.comp. */
+    GLuint m_dir_shadow_min_max;  /* RG32F, its first level is a texel per SHADOW_MIN_MAX_FOOTPRINT^2 depths. */
     GLuint m_random_angles_tex3d_id;
     GLuint m_shadow_fbo;
 
+    RGL::SamplerDesc m_evsm_sampler;
+    GLuint m_dir_evsm[2]; /* RGBA32F, [0] - the moments with their mips, [1] - the blur's intermediate. */
+
+    static constexpr uint32_t SHADOW_MIN_MAX_FOOTPRINT = 8;
+
+    /* The warps' exponents, e^(2 * 40) still fits a float. The negative warp only catches the positive one's bleeding. */
+    static constexpr float EVSM_POSITIVE_EXPONENT = 40.0f;
+    static constexpr float EVSM_NEGATIVE_EXPONENT = 5.0f;
+
     glm::mat4  m_dir_light_view_projection;
     glm::mat4  m_dir_light_view; 
     glm::uvec2 m_dir_light_shadow_map_res;
@@ -346,11 +211,17 @@ private:
     float      m_dir_shadow_frustum_size;
 
     std::shared_ptr<RGL::Shader> m_generate_shadow_map_shader;
+    std::shared_ptr<RGL::Shader> m_shadow_min_max_shader;
+    std::shared_ptr<RGL::Shader> m_evsm_moments_shader;
+    std::shared_ptr<RGL::Shader> m_evsm_blur_shader;
 
     // GUI
     int m_blocker_search_samples = 128;
     int m_pcf_filter_samples     = 128;
     float m_light_radius_uv;
+    bool  m_adaptive_sampling = true;
+    int   m_evsm_blur_radius    = 3;
+    float m_evsm_light_bleeding = 0.2f;
 
     int m_blocker_search_samples_idx = 4;
     int m_pcf_filter_samples_idx     = 4;
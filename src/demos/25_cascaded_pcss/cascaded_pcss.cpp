@@ -1,49 +1,58 @@
 #include "cascaded_pcss.h"
 #include "filesystem.h"
 #include "input.h"
+#include "profiler.h"
 #include "util.h"
 #include "gui/gui.h"
 
 #include <glm/gtc/matrix_inverse.hpp>
 #include <glm/gtc/epsilon.hpp>
 
+#include <algorithm>
+#include <cfloat>
+
 CascadedPCSS::CascadedPCSS()
       : m_dir_light_angles         (-35.0f, 65.0f),
         m_spot_light_angles        (90.0f, -25.0f),
         m_exposure                 (0.3f),
         m_gamma                    (3.6f),
-        m_background_lod_level     (1.2),
-        m_skybox_vao               (0),
-        m_skybox_vbo               (0),
+        m_background_blur          (0.1f),
         m_shadow_fbo               (0),
         m_dir_shadow_maps          (0),
+        m_dir_shadow_scroll_map    (0),
+        m_dir_shadow_min_max       (0),
         m_light_radius_uv          (0.5f),
         m_csm_frusta_vao           (0),
         m_csm_frusta_vbo           (0),
         m_dir_shadow_frustum_planes{},
         m_cascade_splits           {},
-        m_random_angles_tex3d_id   (0)
+        m_cascades_rects_masks     {},
+        m_random_angles_tex3d_id   (0),
+        m_cascade_instances_ssbo   (0),
+        m_cascade_instances_capacity(0),
+        m_depth_bounds_ssbo        (0),
+        m_depth_bounds             (0.0f)
 {
 }
 
 CascadedPCSS::~CascadedPCSS()
 {
-    if (m_skybox_vao != 0)
+    if (m_dir_shadow_maps != 0)
     {
-        glDeleteVertexArrays(1, &m_skybox_vao);
-        m_skybox_vao = 0;
+        glDeleteTextures(1, &m_dir_shadow_maps);
+        m_dir_shadow_maps = 0;
     }
 
-    if (m_skybox_vbo != 0)
+    if (m_dir_shadow_scroll_map != 0)
     {
-        glDeleteBuffers(1, &m_skybox_vbo);
-        m_skybox_vbo = 0;
+        glDeleteTextures(1, &m_dir_shadow_scroll_map);
+        m_dir_shadow_scroll_map = 0;
     }
 
-    if (m_dir_shadow_maps != 0)
+    if (m_dir_shadow_min_max != 0)
     {
-        glDeleteTextures(1, &m_dir_shadow_maps);
-        m_dir_shadow_maps = 0;
+        glDeleteTextures(1, &m_dir_shadow_min_max);
+        m_dir_shadow_min_max = 0;
     }
 
     if (m_random_angles_tex3d_id != 0)
@@ -57,6 +66,14 @@ CascadedPCSS::~CascadedPCSS()
         glDeleteFramebuffers(1, &m_shadow_fbo);
         m_shadow_fbo = 0;
     }
+
+    if (m_cascade_instances_ssbo != 0)
+    {
+        glDeleteBuffers(1, &m_cascade_instances_ssbo);
+        m_cascade_instances_ssbo = 0;
+    }
+
+    glDeleteBuffers(1, &m_depth_bounds_ssbo);
 }
 
 void CascadedPCSS::init_app()
@@ -71,6 +88,7 @@ void CascadedPCSS::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.1, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(-10.3, 7.6, -5.42);
     m_camera->setOrientation(glm::quat(-0.3, -0.052, -0.931, -0.165));
 
@@ -102,6 +120,23 @@ void CascadedPCSS::init_app()
         }
     }
 
+    /* The spheres of the objects, of all their mesh parts, for the cascades' culling. */
+    for (auto& [model, model_matrix] : m_models_with_model_matrices)
+    {
+        glm::vec3 bounds_min = glm::vec3( FLT_MAX);
+        glm::vec3 bounds_max = glm::vec3(-FLT_MAX);
+
+        for (uint32_t i = 0; i < model->GetMeshPartsCount(); ++i)
+        {
+            glm::vec4 part_bounds = model->GetMeshPartBounds(i);
+
+            bounds_min = glm::min(bounds_min, glm::vec3(part_bounds) - part_bounds.w);
+            bounds_max = glm::max(bounds_max, glm::vec3(part_bounds) + part_bounds.w);
+        }
+
+        m_models_bounds.push_back(glm::vec4(0.5f * (bounds_max + bounds_min), 0.5f * glm::length(bounds_max - bounds_min)));
+    }
+
     /* Add textures to the objects. */
     auto concrete_albedo_map    = std::make_shared<RGL::Texture2D>(); concrete_albedo_map   ->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/concrete034_1k/concrete034_1K_color.png", true);
     auto concrete_normal_map    = std::make_shared<RGL::Texture2D>(); concrete_normal_map   ->Load(RGL::FileSystem::getResourcesPath() / "textures/pbr/concrete034_1k/concrete034_1K_normal.png");
@@ -126,48 +161,41 @@ void CascadedPCSS::init_app()
     m_ambient_light_shader = std::make_shared<RGL::Shader>(dir + "pbr-lighting.vert", dir + "pbr-ambient.frag");
     m_ambient_light_shader->link();
 
-    m_equirectangular_to_cubemap_shader = std::make_shared<RGL::Shader>(dir + "cubemap.vert", dir + "equirectangular_to_cubemap.frag");
-    m_equirectangular_to_cubemap_shader->link();
+    m_skybox.Create();
 
-    m_irradiance_convolution_shader = std::make_shared<RGL::Shader>(dir + "cubemap.vert", dir + "irradiance_convolution.frag");
-    m_irradiance_convolution_shader->link();
+    m_tmo_ps = std::make_shared<PostprocessFilter>();
+    m_dynamic_resolution.Create();
+    m_variable_rate_shading.Create();
 
-    m_prefilter_env_map_shader = std::make_shared<RGL::Shader>(dir + "cubemap.vert", dir + "prefilter_cubemap.frag");
-    m_prefilter_env_map_shader->link();
-
-    m_precompute_brdf = std::make_shared<RGL::Shader>("src/demos/10_postprocessing_filters/FSQ.vert", dir + "precompute_brdf.frag");
-    m_precompute_brdf->link();
+    // IBL precomputations
+    m_ibl.Create();
+    m_ibl.Load(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx]);
 
-    m_background_shader = std::make_shared<RGL::Shader>(dir + "background.vert", dir + "background.frag");
-    m_background_shader->link();
+    // Shadows
+    dir = "src/demos/25_cascaded_pcss/";
+    m_generate_shadow_map_shader = std::make_shared<RGL::Shader>(dir + "generate_csm.vert", dir + "generate_csm.frag", dir + "generate_csm.geom");
+    m_generate_shadow_map_shader->link();
 
-    m_tmo_ps = std::make_shared<PostprocessFilter>(RGL::Window::getWidth(), RGL::Window::getHeight());
+    m_is_layered_csm_supported = GLAD_GL_ARB_shader_viewport_layer_array;
 
-    // IBL precomputations
-    GenSkyboxGeometry();
+    if (m_is_layered_csm_supported)
+    {
+        m_generate_layered_shadow_map_shader = std::make_shared<RGL::Shader>(dir + "generate_csm_layered.vert", dir + "generate_csm.frag");
+        m_generate_layered_shadow_map_shader->link();
 
-    m_env_cubemap_rt = std::make_shared<CubeMapRenderTarget>();
-    m_env_cubemap_rt->set_position(glm::vec3(0.0));
-    m_env_cubemap_rt->generate_rt(2048, 2048, true);
+        m_cascades_path = CascadesPath::LAYERED_INSTANCING;
+    }
 
-    m_irradiance_cubemap_rt = std::make_shared<CubeMapRenderTarget>();
-    m_irradiance_cubemap_rt->set_position(glm::vec3(0.0));
-    m_irradiance_cubemap_rt->generate_rt(32, 32);
+    glCreateBuffers(1, &m_cascade_instances_ssbo);
 
-    m_prefiltered_env_map_rt = std::make_shared<CubeMapRenderTarget>();
-    m_prefiltered_env_map_rt->set_position(glm::vec3(0.0));
-    m_prefiltered_env_map_rt->generate_rt(512, 512, true);
+    m_depth_reduction_shader = std::make_shared<RGL::Shader>(dir + "depth_reduction.comp");
+    m_depth_reduction_shader->link();
 
-    m_brdf_lut_rt = std::make_shared<Texture2DRenderTarget>();
-    m_brdf_lut_rt->generate_rt(512, 512);
+    glCreateBuffers     (1, &m_depth_bounds_ssbo);
+    glNamedBufferStorage(m_depth_bounds_ssbo, sizeof(glm::uvec2), nullptr, GL_DYNAMIC_STORAGE_BIT);
 
-    PrecomputeIndirectLight(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx]);
-    PrecomputeBRDF(m_brdf_lut_rt);
-
-    // Shadows
-    dir = "src/demos/25_cascaded_pcss/";
-    m_generate_shadow_map_shader = std::make_shared<RGL::Shader>(dir + "generate_csm.vert", dir + "generate_csm.frag", dir + "generate_csm.geom");
-    m_generate_shadow_map_shader->link();
+    m_depth_bounds_readback.Create(sizeof(glm::uvec2), DEPTH_BOUNDS_FRAMES);
+    m_depth_bounds = glm::vec2(m_camera->NearPlane(), m_camera->FarPlane());
 
     m_directional_light_shader = std::make_shared<RGL::Shader>(dir + "pbr-lighting-shadow.vert", dir + "pbr-directional-shadow.frag");
     m_directional_light_shader->link();
@@ -175,20 +203,28 @@ void CascadedPCSS::init_app()
     m_visualize_shadow_map_shader = std::make_shared<RGL::Shader>("src/demos/10_postprocessing_filters/FSQ.vert", dir + "visualize_csm_depth.frag");
     m_visualize_shadow_map_shader->link();
 
-    m_dir_light_view_projection_matrices.resize(NUM_CASCADES);
-    m_dir_light_view_matrices.resize(NUM_CASCADES);
+    m_shadow_min_max_shader = std::make_shared<RGL::Shader>("src/demos/24_pcss/shadow_min_max.comp");
+    m_shadow_min_max_shader->link();
+
+    m_shadow_mask_shader = std::make_shared<RGL::Shader>(dir + "shadow_mask.comp");
+    m_shadow_mask_shader->link();
+
+    m_shadow_upsample_shader = std::make_shared<RGL::Shader>(dir + "shadow_upsample.comp");
+    m_shadow_upsample_shader->link();
+
+    m_dir_light_view_projection_matrices.resize(MAX_CASCADES);
+    m_dir_light_view_matrices.resize(MAX_CASCADES);
 
     m_dir_light_shadow_map_res = glm::uvec2(1024 * 4);
     CreateShadowFBO(m_dir_light_shadow_map_res.x, m_dir_light_shadow_map_res.y);
 
-    m_shadow_map_pcf_sampler.Create();
-    m_shadow_map_pcf_sampler.SetFiltering(RGL::TextureFiltering::MIN, RGL::TextureFilteringParam::LINEAR);
-    m_shadow_map_pcf_sampler.SetFiltering(RGL::TextureFiltering::MIN, RGL::TextureFilteringParam::LINEAR);
-    m_shadow_map_pcf_sampler.SetWraping(RGL::TextureWrapingCoordinate::S, RGL::TextureWrapingParam::CLAMP_TO_BORDER);
-    m_shadow_map_pcf_sampler.SetWraping(RGL::TextureWrapingCoordinate::T, RGL::TextureWrapingParam::CLAMP_TO_BORDER);
-    m_shadow_map_pcf_sampler.SetBorderColor(1, 0, 0, 0);
-    m_shadow_map_pcf_sampler.SetCompareMode(RGL::TextureCompareMode::REF);
-    m_shadow_map_pcf_sampler.SetCompareFunc(RGL::TextureCompareFunc::LEQUAL);
+    m_shadow_map_pcf_sampler.m_min_filter   = RGL::TextureFilteringParam::LINEAR;
+    m_shadow_map_pcf_sampler.m_mag_filter   = RGL::TextureFilteringParam::LINEAR;
+    m_shadow_map_pcf_sampler.m_wrap_s       = RGL::TextureWrapingParam::CLAMP_TO_BORDER;
+    m_shadow_map_pcf_sampler.m_wrap_t       = RGL::TextureWrapingParam::CLAMP_TO_BORDER;
+    m_shadow_map_pcf_sampler.m_border_color = RGL::SamplerBorderColor::OPAQUE_WHITE;
+    m_shadow_map_pcf_sampler.m_compare_mode = RGL::TextureCompareMode::REF;
+    m_shadow_map_pcf_sampler.m_compare_func = RGL::TextureCompareFunc::LEQUAL;
 
     uint32_t random_angles_size = 128;
     m_random_angles_tex3d_id = GenerateRandomAnglesTexture3D(random_angles_size);
@@ -196,7 +232,7 @@ void CascadedPCSS::init_app()
     glEnable(GL_CULL_FACE);  
 
     glCreateBuffers(1, &m_csm_frusta_vbo);
-    glNamedBufferStorage(m_csm_frusta_vbo, NUM_CASCADES * 12 * 2 * sizeof(glm::vec3), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glNamedBufferStorage(m_csm_frusta_vbo, MAX_CASCADES * 12 * 2 * sizeof(glm::vec3), nullptr, GL_DYNAMIC_STORAGE_BIT);
     
     glCreateVertexArrays(1, &m_csm_frusta_vao);
     glVertexArrayVertexBuffer(m_csm_frusta_vao, 0, m_csm_frusta_vbo, 0, sizeof(glm::vec3));
@@ -262,232 +298,370 @@ void CascadedPCSS::update(double delta_time)
     m_camera->update(delta_time);
 }
 
-void CascadedPCSS::HdrEquirectangularToCubemap(const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt, const std::shared_ptr<RGL::Texture2D>& m_equirectangular_map)
+void CascadedPCSS::CreateShadowFBO(uint32_t width, uint32_t height)
 {
-    /* Update all faces per frame */
-    m_equirectangular_to_cubemap_shader->bind();
-    m_equirectangular_to_cubemap_shader->setUniform("u_projection", cubemap_rt->m_projection);
+    /* Also called when the cascades count changes, a layer per cascade. */
+    if (m_dir_shadow_maps != 0)
+    {
+        glDeleteTextures(1, &m_dir_shadow_maps);
+        glDeleteTextures(1, &m_dir_shadow_scroll_map);
+        glDeleteTextures(1, &m_dir_shadow_min_max);
+        glDeleteFramebuffers(1, &m_shadow_fbo);
+    }
+
+    InvalidateCascades();
+
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &m_dir_shadow_maps);
+    glTextureStorage3D(m_dir_shadow_maps, 1, GL_DEPTH_COMPONENT32F, width, height, m_cascades_count);
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &m_dir_shadow_scroll_map);
+    glTextureStorage2D(m_dir_shadow_scroll_map, 1, GL_DEPTH_COMPONENT32F, width, height);
+
+    const uint32_t min_max_size = glm::max(width / SHADOW_MIN_MAX_FOOTPRINT, 1u);
+
+    glCreateTextures   (GL_TEXTURE_2D_ARRAY, 1, &m_dir_shadow_min_max);
+    glTextureStorage3D (m_dir_shadow_min_max, RGL::Texture::GetMaxMipMapsLevels(min_max_size, min_max_size, 1), GL_RG32F, min_max_size, min_max_size, m_cascades_count);
+    glTextureParameteri(m_dir_shadow_min_max, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(m_dir_shadow_min_max, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glTextureParameteri(m_dir_shadow_maps, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(m_dir_shadow_maps, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(m_dir_shadow_maps, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER); 
+    glTextureParameteri(m_dir_shadow_maps, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+
+    constexpr float bordercolor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glTextureParameterfv(m_dir_shadow_maps, GL_TEXTURE_BORDER_COLOR, bordercolor);
+
+    glCreateFramebuffers(1, &m_shadow_fbo);
+    glNamedFramebufferTexture(m_shadow_fbo, GL_DEPTH_ATTACHMENT, m_dir_shadow_maps, 0);
 
-    glViewport(0, 0, cubemap_rt->m_width, cubemap_rt->m_height);
-    glBindFramebuffer(GL_FRAMEBUFFER, cubemap_rt->m_fbo_id);
-    m_equirectangular_map->Bind(1);
+    GLenum draw_buffers[] = { GL_NONE };
+    glNamedFramebufferDrawBuffers(m_shadow_fbo, 1, draw_buffers);
+    glNamedFramebufferReadBuffer(m_shadow_fbo, GL_NONE);
 
-    for (uint8_t side = 0; side < 6; ++side)
+    int status = glCheckNamedFramebufferStatus(m_shadow_fbo, GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
     {
-        m_equirectangular_to_cubemap_shader->setUniform("u_view", cubemap_rt->m_view_transforms[side]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, cubemap_rt->m_cubemap_texture_id, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        glBindVertexArray(m_skybox_vao);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        std::cerr << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!\n";
     }
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
 }
 
-void CascadedPCSS::IrradianceConvolution(const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt)
+void CascadedPCSS::GenerateShadowMap(uint32_t width, uint32_t height)
 {
-    /* Update all faces per frame */
-    m_irradiance_convolution_shader->bind();
-    m_irradiance_convolution_shader->setUniform("u_projection", cubemap_rt->m_projection);
+    update_csm_splits();
+    update_csm_frusta();
 
-    glViewport(0, 0, cubemap_rt->m_width, cubemap_rt->m_height);
-    glBindFramebuffer(GL_FRAMEBUFFER, cubemap_rt->m_fbo_id);
-    m_env_cubemap_rt->bindTexture(1);
+    const uint32_t cascades_mask = ScheduleCascades();
 
-    for (uint8_t side = 0; side < 6; ++side)
+    if (cascades_mask == 0)
     {
-        m_irradiance_convolution_shader->setUniform("u_view", cubemap_rt->m_view_transforms[side]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, cubemap_rt->m_cubemap_texture_id, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        glBindVertexArray(m_skybox_vao);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        return;
     }
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
-}
 
-void CascadedPCSS::PrefilterCubemap(const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt)
-{
-    m_prefilter_env_map_shader->bind();
-    m_prefilter_env_map_shader->setUniform("u_projection", cubemap_rt->m_projection);
-    
-    m_env_cubemap_rt->bindTexture(1);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_shadow_fbo);
+    glViewport(0, 0, width, height);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, cubemap_rt->m_fbo_id);
+    /* A cascade writes through its own viewport's scissor, see gl_ViewportIndex of the shaders. */
+    glEnable(GL_SCISSOR_TEST);
+    glCullFace(GL_FRONT);
 
-    uint8_t max_mip_levels = glm::log2(float(cubemap_rt->m_width));
-    for (uint8_t mip = 0; mip < max_mip_levels; ++mip)
+    /* The strips along x first, then the ones along y. A fully rendered cascade is a single rect of the first pass. */
+    for (uint32_t pass = 0; pass < std::size(m_cascades_rects_masks); ++pass)
     {
-        // resize the framebuffer according to mip-level size.
-        uint32_t mip_width  = cubemap_rt->m_width  * std::pow(0.5, mip);
-        uint32_t mip_height = cubemap_rt->m_height * std::pow(0.5, mip);
+        const uint32_t pass_mask = m_cascades_rects_masks[pass];
 
-        glBindRenderbuffer(GL_RENDERBUFFER, cubemap_rt->m_rbo_id);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mip_width, mip_height);
-        glViewport(0, 0, mip_width, mip_height);
+        if (pass_mask == 0)
+        {
+            continue;
+        }
 
-        float roughness = float(mip) / float(max_mip_levels - 1);
-        m_prefilter_env_map_shader->setUniform("u_roughness", roughness);
+        for (uint32_t i = 0; i < uint32_t(m_cascades_count); ++i)
+        {
+            if (pass_mask & (1u << i))
+            {
+                const glm::uvec4& rect = m_cascades_render_rects[pass][i];
+                glScissorIndexed(i, rect.x, rect.y, rect.z, rect.w);
+            }
+        }
 
-        for (uint8_t side = 0; side < 6; ++side)
+        if (m_cascades_path == CascadesPath::LAYERED_INSTANCING)
         {
-            m_prefilter_env_map_shader->setUniform("u_view", cubemap_rt->m_view_transforms[side]);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, cubemap_rt->m_cubemap_texture_id, mip);
+            CullShadowCasters(pass_mask);
+
+            m_generate_layered_shadow_map_shader->bind();
+            m_generate_layered_shadow_map_shader->setUniform("u_light_view_projections", m_dir_light_view_projection_matrices.data(), m_cascades_count);
 
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            glBindVertexArray(m_skybox_vao);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_cascade_instances_ssbo);
+
+            for (auto& batch : m_shadow_casters_batches)
+            {
+                m_generate_layered_shadow_map_shader->setUniform("u_first_instance", batch.m_first_instance);
+                batch.m_model->RenderDepth(batch.m_instances_count);
+            }
         }
+        else
+        {
+            m_generate_shadow_map_shader->bind();
+            m_generate_shadow_map_shader->setUniform("u_light_view_projections", m_dir_light_view_projection_matrices.data(), m_cascades_count);
+            m_generate_shadow_map_shader->setUniform("u_cascades_mask",          pass_mask);
+
+            for (uint32_t i = 0; i < m_models_with_model_matrices.size(); ++i)
+            {
+                m_generate_shadow_map_shader->setUniform("u_model", m_models_with_model_matrices[i].second);
+                m_models_with_model_matrices[i].first->RenderDepth();
+            }
+        }
+    }
+
+    glDisable(GL_SCISSOR_TEST);
+    glCullFace(GL_BACK);
+
+    if (m_adaptive_sampling)
+    {
+        BuildShadowMinMax();
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
 }
 
-void CascadedPCSS::PrecomputeIndirectLight(const std::filesystem::path& hdri_map_filepath)
+void CascadedPCSS::BuildShadowMinMax()
 {
-    auto envmap_hdr = std::make_shared<RGL::Texture2D>();
-    envmap_hdr->LoadHdr(hdri_map_filepath);
-    auto envmap_metadata = envmap_hdr->GetMetadata();
+    const uint32_t levels = RGL::Texture::GetMaxMipMapsLevels(m_dir_light_shadow_map_res.x / SHADOW_MIN_MAX_FOOTPRINT, m_dir_light_shadow_map_res.y / SHADOW_MIN_MAX_FOOTPRINT, 1);
 
-    HdrEquirectangularToCubemap(m_env_cubemap_rt, envmap_hdr);
+    m_shadow_min_max_shader->bind();
 
-    glBindTexture(GL_TEXTURE_CUBE_MAP, m_env_cubemap_rt->m_cubemap_texture_id);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    for (uint32_t level = 0; level < levels; ++level)
+    {
+        const uint32_t size = glm::max((m_dir_light_shadow_map_res.x / SHADOW_MIN_MAX_FOOTPRINT) >> level, 1u);
+
+        /* The first level reduces the depths, the next ones the previous level. */
+        m_shadow_min_max_shader->setUniform("u_from_depth",   level == 0);
+        m_shadow_min_max_shader->setUniform("u_source_level", int(level == 0 ? 0 : level - 1));
+        m_shadow_min_max_shader->setUniform("u_footprint",    int(level == 0 ? SHADOW_MIN_MAX_FOOTPRINT : 2));
+
+        glBindTextureUnit(0, level == 0 ? m_dir_shadow_maps : m_dir_shadow_min_max);
+        glBindImageTexture(0, m_dir_shadow_min_max, level, GL_TRUE, 0, GL_WRITE_ONLY, GL_RG32F);
 
-    IrradianceConvolution(m_irradiance_cubemap_rt);
-    PrefilterCubemap(m_prefiltered_env_map_rt);
+        glDispatchCompute((size + 7) / 8, (size + 7) / 8, m_cascades_count);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
 }
 
-void CascadedPCSS::PrecomputeBRDF(const std::shared_ptr<Texture2DRenderTarget>& rt)
+uint32_t CascadedPCSS::ScheduleCascades()
 {
-    GLuint m_dummy_vao_id;
-    glCreateVertexArrays(1, &m_dummy_vao_id);
+    const int32_t res         = int32_t(m_dir_light_shadow_map_res.x);
+    const float   clear_depth = 1.0f;
+
+    m_cascades_rects_masks[0] = 0;
+    m_cascades_rects_masks[1] = 0;
+    m_cascades_rendered       = 0;
+    m_cascades_scrolled       = 0;
 
-    rt->bindRenderTarget();
-    m_precompute_brdf->bind();
+    auto add_rect = [&](uint32_t pass, uint32_t cascade, const glm::uvec4& rect)
+    {
+        m_cascades_render_rects[pass][cascade] = rect;
+        m_cascades_rects_masks[pass]          |= 1u << cascade;
+
+        glClearTexSubImage(m_dir_shadow_maps, 0, rect.x, rect.y, cascade, rect.z, rect.w, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &clear_depth);
+    };
 
-    glBindVertexArray(m_dummy_vao_id);
-    glDrawArrays(GL_TRIANGLES, 0, 3);
+    /* The far cascades take turns, one of them per frame. */
+    const uint32_t cascades_count      = uint32_t(m_cascades_count);
+    const uint32_t full_rate_cascades  = glm::min(uint32_t(m_full_rate_cascades), cascades_count);
+    uint32_t       round_robin_cascade = cascades_count;
 
-    glDeleteVertexArrays(1, &m_dummy_vao_id);
+    if (full_rate_cascades < cascades_count)
+    {
+        round_robin_cascade = full_rate_cascades + m_round_robin_cascade % (cascades_count - full_rate_cascades);
+        ++m_round_robin_cascade;
+    }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
+    for (uint32_t i = 0; i < cascades_count; ++i)
+    {
+        CascadeView&       cached = m_cascades[i];
+        const CascadeView& target = m_cascade_targets[i];
+
+        /* A cascade of another light direction can't wait for its turn. */
+        if (m_is_cascade_valid[i] && cached.m_light_dir == target.m_light_dir && i >= full_rate_cascades && i != round_robin_cascade)
+        {
+            continue;
+        }
+
+        /* The same box moved by whole texels, the overlap is still valid for the static geometry. */
+        bool       can_scroll = m_is_cascade_valid[i] && target.m_is_scrolled && cached.m_is_scrolled &&
+                                target.m_light_dir    == cached.m_light_dir   &&
+                                target.m_radius       == cached.m_radius      &&
+                                target.m_depth_center == cached.m_depth_center;
+        glm::ivec2 shift      = glm::ivec2(0);
+
+        if (can_scroll)
+        {
+            const float texel_size = 2.0f * target.m_radius / float(res);
+
+            shift      = glm::ivec2(glm::round((target.m_center_ls - cached.m_center_ls) / texel_size));
+            can_scroll = glm::abs(shift.x) < res && glm::abs(shift.y) < res;
+        }
+
+        if (can_scroll)
+        {
+            if (shift != glm::ivec2(0))
+            {
+                /* The texel (x, y) of the moved box was the cached (x, y) + shift. */
+                const glm::ivec2 size = glm::ivec2(res) - glm::abs(shift);
+                const glm::ivec2 src  = glm::max( shift, glm::ivec2(0));
+                const glm::ivec2 dst  = glm::max(-shift, glm::ivec2(0));
+
+                glCopyImageSubData(m_dir_shadow_maps,       GL_TEXTURE_2D_ARRAY, 0, src.x, src.y, i, m_dir_shadow_scroll_map, GL_TEXTURE_2D,       0, 0,     0,     0, size.x, size.y, 1);
+                glCopyImageSubData(m_dir_shadow_scroll_map, GL_TEXTURE_2D,       0, 0,     0,     0, m_dir_shadow_maps,       GL_TEXTURE_2D_ARRAY, 0, dst.x, dst.y, i, size.x, size.y, 1);
+
+                /* The newly exposed slivers. */
+                if (shift.x != 0)
+                {
+                    add_rect(0, i, glm::uvec4(shift.x > 0 ? res - shift.x : 0, 0, glm::abs(shift.x), res));
+                }
+
+                if (shift.y != 0)
+                {
+                    add_rect(1, i, glm::uvec4(0, shift.y > 0 ? res - shift.y : 0, res, glm::abs(shift.y)));
+                }
+
+                ++m_cascades_scrolled;
+            }
+        }
+        else
+        {
+            add_rect(0, i, glm::uvec4(0, 0, res, res));
+            ++m_cascades_rendered;
+        }
+
+        cached                = target;
+        m_is_cascade_valid[i] = true;
+    }
+
+    /* The lighting reads the maps as they were rendered. */
+    for (uint32_t i = 0; i < cascades_count; ++i)
+    {
+        m_dir_light_view_matrices[i]            = m_cascades[i].m_view;
+        m_dir_light_view_projection_matrices[i] = m_cascades[i].m_view_projection;
+        m_dir_shadow_frustum_planes[i]          = m_cascades[i].m_frustum_planes;
+    }
+
+    return m_cascades_rects_masks[0] | m_cascades_rects_masks[1];
 }
 
-void CascadedPCSS::GenSkyboxGeometry()
+void CascadedPCSS::InvalidateCascades()
 {
-    m_skybox_vao = 0;
-    m_skybox_vbo = 0;
-
-    glCreateVertexArrays(1, &m_skybox_vao);
-    glCreateBuffers(1, &m_skybox_vbo);
-
-    std::vector<float> skybox_positions = {
-        // positions          
-        -1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
-        // front face
-        -1.0f, -1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-        // left face
-        -1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-        // right face
-         1.0f,  1.0f,  1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-        // bottom face
-        -1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f, -1.0f,
-        // top face
-        -1.0f,  1.0f, -1.0f,
-         1.0f,  1.0f , 1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f,  1.0f,  1.0f,
+    std::fill(std::begin(m_is_cascade_valid), std::end(m_is_cascade_valid), false);
+}
+
+void CascadedPCSS::CullShadowCasters(uint32_t cascades_mask)
+{
+    m_cascade_instances.clear();
+    m_shadow_casters_batches.clear();
+
+    /* Within |ndc| <= 1 of a cascade's light space box, grown by the sphere's radius in the NDC. */
+    auto is_sphere_in_cascade = [](const glm::mat4& view_projection, const glm::vec3& center, float radius)
+    {
+        glm::vec4 ndc = view_projection * glm::vec4(center, 1.0f);
+
+        for (uint32_t axis = 0; axis < 3; ++axis)
+        {
+            float scale = glm::length(glm::vec3(view_projection[0][axis], view_projection[1][axis], view_projection[2][axis]));
+
+            if (glm::abs(ndc[axis]) > 1.0f + radius * scale)
+            {
+                return false;
+            }
+        }
+
+        return true;
     };
 
-    /* Set up buffer objects */
-    glNamedBufferStorage(m_skybox_vbo, skybox_positions.size() * sizeof(skybox_positions[0]), skybox_positions.data(), 0 /*flags*/);
+    /* The objects of a model are consecutive, so its instances of all the cascades are a single draw. */
+    for (uint32_t first = 0; first < m_models_with_model_matrices.size(); )
+    {
+        RGL::StaticModel* model = m_models_with_model_matrices[first].first;
+        uint32_t          last  = first;
 
-    /* Set up VAO */
-    glEnableVertexArrayAttrib(m_skybox_vao, 0 /*index*/);
+        while (last < m_models_with_model_matrices.size() && m_models_with_model_matrices[last].first == model)
+        {
+            ++last;
+        }
 
-    /* Separate attribute format */
-    glVertexArrayAttribFormat(m_skybox_vao, 0 /*index*/, 3 /*size*/, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/);
-    glVertexArrayAttribBinding(m_skybox_vao, 0 /*index*/, 0 /*bindingindex*/);
-    glVertexArrayVertexBuffer(m_skybox_vao, 0 /*bindingindex*/, m_skybox_vbo, 0 /*offset*/, sizeof(glm::vec3) /*stride*/);
-}
+        ShadowCastersBatch batch = { model, uint32_t(m_cascade_instances.size()), 0 };
 
-void CascadedPCSS::CreateShadowFBO(uint32_t width, uint32_t height)
-{
-    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &m_dir_shadow_maps);
-    glTextureStorage3D(m_dir_shadow_maps, 1, GL_DEPTH_COMPONENT32F, width, height, NUM_CASCADES);
+        for (uint32_t cascade = 0; cascade < uint32_t(m_cascades_count); ++cascade)
+        {
+            if ((cascades_mask & (1u << cascade)) == 0)
+            {
+                continue;
+            }
 
-    glTextureParameteri(m_dir_shadow_maps, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTextureParameteri(m_dir_shadow_maps, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTextureParameteri(m_dir_shadow_maps, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER); 
-    glTextureParameteri(m_dir_shadow_maps, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+            for (uint32_t i = first; i < last; ++i)
+            {
+                const glm::mat4& model_matrix = m_models_with_model_matrices[i].second;
+                const float      scale        = glm::max(glm::length(glm::vec3(model_matrix[0])), glm::max(glm::length(glm::vec3(model_matrix[1])), glm::length(glm::vec3(model_matrix[2]))));
+                const glm::vec3  center       = glm::vec3(model_matrix * glm::vec4(glm::vec3(m_models_bounds[i]), 1.0f));
 
-    constexpr float bordercolor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-    glTextureParameterfv(m_dir_shadow_maps, GL_TEXTURE_BORDER_COLOR, bordercolor);
+                if (is_sphere_in_cascade(m_dir_light_view_projection_matrices[cascade], center, m_models_bounds[i].w * scale))
+                {
+                    m_cascade_instances.push_back({ model_matrix, cascade });
+                }
+            }
+        }
 
-    glCreateFramebuffers(1, &m_shadow_fbo);
-    glNamedFramebufferTexture(m_shadow_fbo, GL_DEPTH_ATTACHMENT, m_dir_shadow_maps, 0);
+        batch.m_instances_count = uint32_t(m_cascade_instances.size()) - batch.m_first_instance;
 
-    GLenum draw_buffers[] = { GL_NONE };
-    glNamedFramebufferDrawBuffers(m_shadow_fbo, 1, draw_buffers);
-    glNamedFramebufferReadBuffer(m_shadow_fbo, GL_NONE);
+        if (batch.m_instances_count > 0)
+        {
+            m_shadow_casters_batches.push_back(batch);
+        }
 
-    int status = glCheckNamedFramebufferStatus(m_shadow_fbo, GL_FRAMEBUFFER);
-    if (status != GL_FRAMEBUFFER_COMPLETE)
+        first = last;
+    }
+
+    /* The buffer only grows. */
+    if (m_cascade_instances.size() > m_cascade_instances_capacity)
     {
-        std::cerr << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!\n";
+        m_cascade_instances_capacity = uint32_t(m_cascade_instances.size());
+        glNamedBufferData(m_cascade_instances_ssbo, sizeof(CascadeInstance) * m_cascade_instances_capacity, nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    if (!m_cascade_instances.empty())
+    {
+        glNamedBufferSubData(m_cascade_instances_ssbo, 0, sizeof(CascadeInstance) * m_cascade_instances.size(), m_cascade_instances.data());
     }
 }
 
-void CascadedPCSS::GenerateShadowMap(uint32_t width, uint32_t height)
+void CascadedPCSS::ReduceDepth()
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, m_shadow_fbo);
-    glViewport(0, 0, width, height);
-    glClear(GL_DEPTH_BUFFER_BIT);
+    const glm::uvec2 clear_bounds = glm::uvec2(0xFFFFFFFF, 0);
+    glNamedBufferSubData(m_depth_bounds_ssbo, 0, sizeof(clear_bounds), &clear_bounds);
 
-    glCullFace(GL_FRONT);
-    m_generate_shadow_map_shader->bind();
+    m_depth_reduction_shader->bind();
+    m_depth_reduction_shader->setUniform("u_near_far", glm::vec2(m_camera->NearPlane(), m_camera->FarPlane()));
 
-    update_csm_splits();
-    update_csm_frusta();
+    m_tmo_ps->m_rt->BindDepth(0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_depth_bounds_ssbo);
 
-    m_generate_shadow_map_shader->setUniform("u_light_view_projections", m_dir_light_view_projection_matrices.data(), m_dir_light_view_projection_matrices.size());
+    glDispatchCompute((m_tmo_ps->m_rt->GetWidth() + 15) / 16, (m_tmo_ps->m_rt->GetHeight() + 15) / 16, 1);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
 
-    for (uint32_t i = 0; i < m_models_with_model_matrices.size(); ++i)
+    /* Dropped if both the previous reads are still in flight, the splits just keep the older range. */
+    m_depth_bounds_readback.ReadBuffer(m_depth_bounds_ssbo, 0, sizeof(glm::uvec2), [this](const void* data, GLsizeiptr)
     {
-        m_generate_shadow_map_shader->setUniform("u_model", m_models_with_model_matrices[i].second);
-        m_models_with_model_matrices[i].first->Render();
-    }
-    glCullFace(GL_BACK);
+        const glm::uvec2 bounds = *static_cast<const glm::uvec2*>(data);
+
+        /* Nothing but the background was drawn. */
+        if (bounds.y != 0)
+        {
+            m_depth_bounds = glm::vec2(glm::uintBitsToFloat(bounds.x), glm::uintBitsToFloat(bounds.y));
+        }
+    });
+}
+
+void CascadedPCSS::ReadDepthBounds()
+{
+    /* The oldest copy first, the newest one wins. */
+    m_depth_bounds_readback.Update();
 }
 
 GLuint CascadedPCSS::GenerateRandomAnglesTexture3D(uint32_t size)
@@ -525,30 +699,43 @@ GLuint CascadedPCSS::GenerateRandomAnglesTexture3D(uint32_t size)
 
 void CascadedPCSS::update_csm_splits()
 {
-    float near_clip  = m_camera->NearPlane();
-    float far_clip   = m_camera->FarPlane();
+    float camera_near  = m_camera->NearPlane();
+    float camera_range = m_camera->FarPlane() - camera_near;
+    float near_clip    = camera_near;
+    float far_clip     = m_camera->FarPlane();
+
+    /* Only the depth range with geometry, a bit wider as it is a frame or two old. */
+    if (m_reduce_depth && m_depth_bounds.y > m_depth_bounds.x)
+    {
+        near_clip = glm::max(camera_near,          m_depth_bounds.x * 0.95f);
+        far_clip  = glm::min(m_camera->FarPlane(), m_depth_bounds.y * 1.05f);
+        far_clip  = glm::max(far_clip,             near_clip + 1e-3f);
+    }
+
     float clip_range = far_clip - near_clip;
     float ratio      = far_clip / near_clip;
 
+    m_cascades_near_split = (near_clip - camera_near) / camera_range;
+
     if (m_split_scheme == SplitScheme::UNIFORM)
     {
-        for (uint32_t i = 0; i < NUM_CASCADES; ++i)
+        for (uint32_t i = 0; i < uint32_t(m_cascades_count); ++i)
         {
-            float p = (i + 1) / float(NUM_CASCADES);
+            float p = (i + 1) / float(m_cascades_count);
             float d = near_clip + clip_range * p;
 
-            m_cascade_splits[i] = (d - near_clip) / clip_range; // to [0, 1] range
+            m_cascade_splits[i] = (d - camera_near) / camera_range; // to [0, 1] range of the camera's planes
         }
     }
 
     if (m_split_scheme == SplitScheme::LOG)
     {
-        for (uint32_t i = 0; i < NUM_CASCADES; ++i)
+        for (uint32_t i = 0; i < uint32_t(m_cascades_count); ++i)
         {
-            float p = (i + 1) / float(NUM_CASCADES);
+            float p = (i + 1) / float(m_cascades_count);
             float d = near_clip * std::pow(ratio, p);
 
-            m_cascade_splits[i] = (d - near_clip) / clip_range; // to [0, 1] range
+            m_cascade_splits[i] = (d - camera_near) / camera_range; // to [0, 1] range of the camera's planes
         }
     }
 
@@ -556,14 +743,14 @@ void CascadedPCSS::update_csm_splits()
     // Practical splits: https://developer.nvidia.com/gpugems/GPUGems3/gpugems3_ch10.html
     if (m_split_scheme == SplitScheme::PRACTICAL)
     {
-        for (uint32_t i = 0; i < NUM_CASCADES; ++i)
+        for (uint32_t i = 0; i < uint32_t(m_cascades_count); ++i)
         {
-            float p   = (i + 1) / float(NUM_CASCADES);
+            float p   = (i + 1) / float(m_cascades_count);
             float log = near_clip * std::pow(ratio, p);
             float uni = near_clip + clip_range * p;
             float d   = m_cascade_split_lambda * (log - uni) + uni;
 
-            m_cascade_splits[i] = (d - near_clip) / clip_range; // to [0, 1] range
+            m_cascade_splits[i] = (d - camera_near) / camera_range; // to [0, 1] range of the camera's planes
         }
     }
 }
@@ -576,10 +763,13 @@ void CascadedPCSS::update_csm_frusta()
     glm::vec3 light_dir = m_dir_light_properties.direction;
 
     // Calculate orthographic projection matrix for each cascade
-    float last_split_dist  = 0.0;
+    float last_split_dist  = m_cascades_near_split;
     float avg_frustum_size = 0.0;
 
-    for (uint32_t i = 0; i < NUM_CASCADES; ++i)
+    /* A scrolled cascade keeps its depth range while the box stays within this part of its radius. */
+    const float depth_margin = 0.5f;
+
+    for (uint32_t i = 0; i < uint32_t(m_cascades_count); ++i)
     {
         float split_dist = m_cascade_splits[i];
 
@@ -595,7 +785,7 @@ void CascadedPCSS::update_csm_frusta()
         };
 
         // Project frustum corners into world space
-        glm::mat4 inv_cam = glm::inverse(m_camera->m_projection * m_camera->m_view);
+        glm::mat4 inv_cam = m_camera->inverseViewProjection();
         for (uint32_t i = 0; i < 8; ++i)
         {
             glm::vec4 corner_world_space = inv_cam * glm::vec4(frustum_corners[i], 1.0f);
@@ -632,18 +822,53 @@ void CascadedPCSS::update_csm_frusta()
         glm::mat4 light_ortho_matrix = glm::ortho(min_extents.x, max_extents.x, min_extents.y, max_extents.y, 0.0f, max_extents.z - min_extents.z);
 
         float split_depth = (m_camera->NearPlane() + split_dist * clip_range) * -1.0f;
-        m_directional_light_shader->setUniform("u_cascade_splits[" + std::to_string(i) + "]", split_depth);
+        m_cascade_split_depths[i] = split_depth;
 
         avg_frustum_size = glm::max(avg_frustum_size, max_extents.x - min_extents.x);
 
-        m_dir_light_view_matrices[i]            = light_view_matrix;
-        m_dir_light_view_projection_matrices[i] = light_ortho_matrix * light_view_matrix;
-        m_dir_shadow_frustum_planes[i]          = glm::vec2(min_extents.z, max_extents.z);
+        CascadeView& target = m_cascade_targets[i];
 
-        if (m_stable_csm)
+        target.m_view            = light_view_matrix;
+        target.m_view_projection = light_ortho_matrix * light_view_matrix;
+        target.m_frustum_planes  = glm::vec2(min_extents.z, max_extents.z);
+        target.m_light_dir       = light_dir;
+        target.m_radius          = radius;
+        target.m_is_scrolled     = false;
+
+        if (m_stable_csm && m_scroll_cascades)
+        {
+            /*
+             * The box snapped to the texels in the light's rotation, a moved box is the cached map shifted by whole texels.
+             * Its depth range is wider than the sphere, so it can stay while the camera moves.
+             */
+            glm::mat4 light_rotation = glm::lookAt(glm::vec3(0.0f), light_dir, glm::vec3(0.0f, 1.0f, 0.0f));
+            glm::vec3 center_ls      = glm::vec3(light_rotation * glm::vec4(frustum_center, 1.0f));
+            float     texel_size     = 2.0f * radius / float(m_dir_light_shadow_map_res.x);
+            float     half_depth     = (1.0f + depth_margin) * radius;
+
+            const CascadeView& cached = m_cascades[i];
+            float depth_center        = center_ls.z;
+
+            if (m_is_cascade_valid[i] && cached.m_is_scrolled && cached.m_light_dir == light_dir && cached.m_radius == radius &&
+                glm::abs(center_ls.z - cached.m_depth_center) <= depth_margin * radius)
+            {
+                depth_center = cached.m_depth_center;
+            }
+
+            target.m_center_ls    = glm::floor(glm::vec2(center_ls) / texel_size) * texel_size;
+            target.m_depth_center = depth_center;
+            target.m_is_scrolled  = true;
+
+            glm::vec3 eye_ls = glm::vec3(target.m_center_ls, depth_center + half_depth);
+
+            target.m_view            = glm::translate(glm::mat4(1.0f), -eye_ls) * light_rotation;
+            target.m_view_projection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * half_depth) * target.m_view;
+            target.m_frustum_planes  = glm::vec2(-half_depth, half_depth);
+        }
+        else if (m_stable_csm)
         {
             glm::vec4 shadow_origin = glm::vec4(0.0, 0.0, 0.0, 1.0);
-            shadow_origin = m_dir_light_view_projection_matrices[i] * shadow_origin;
+            shadow_origin = target.m_view_projection * shadow_origin;
             shadow_origin = shadow_origin * (m_dir_light_shadow_map_res.x / 2.0f);
             
             glm::vec4 rounded_origin = glm::round(shadow_origin);
@@ -655,13 +880,13 @@ void CascadedPCSS::update_csm_frusta()
             glm::mat4& shadow_proj = light_ortho_matrix;
             shadow_proj[3] += round_offset;
 
-            m_dir_light_view_projection_matrices[i] = shadow_proj * light_view_matrix;
+            target.m_view_projection = shadow_proj * light_view_matrix;
         }
 
         last_split_dist = split_dist;
     }
 
-    m_directional_light_shader->setUniform("u_light_radius_uv", m_light_radius_uv / avg_frustum_size);
+    m_cascades_light_radius_uv = m_light_radius_uv / avg_frustum_size;
 }
 
 void CascadedPCSS::RenderTexturedModels()
@@ -675,12 +900,12 @@ void CascadedPCSS::RenderTexturedModels()
     m_ambient_light_shader->setUniform("u_has_ao_map",        true);
     m_ambient_light_shader->setUniform("u_has_emissive_map",  false);
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+    auto view_projection = m_camera->viewProjection();
 
     /* First, render the ambient color only for the opaque objects. */
-    m_irradiance_cubemap_rt->bindTexture(6);
-    m_prefiltered_env_map_rt->bindTexture(7);
-    m_brdf_lut_rt->bindTexture(8);
+    m_ibl.BindIrradianceSH();
+    m_ibl.BindPrefilteredMap(7);
+    m_ibl.BindBrdfLut(8);
 
     for (uint32_t i = 0; i < m_models_with_model_matrices.size(); ++i)
     {
@@ -699,6 +924,13 @@ void CascadedPCSS::RenderTexturedModels()
     m_ambient_light_shader->setUniform("u_roughness",         1.0f);
     m_ambient_light_shader->setUniform("u_ao",                1.0f);
 
+    /* The ambient step laid down the depth, the shadows of the directional light are resolved from it. */
+    if (m_shadow_mask)
+    {
+        RGL::ProfilerScope scope("Shadow mask");
+        RenderShadowMask();
+    }
+
     /*
      * Disable writing to the depth buffer and additively
      * shade only those pixels, that were shaded in the ambient step.
@@ -719,20 +951,16 @@ void CascadedPCSS::RenderTexturedModels()
     m_directional_light_shader->setUniform("u_directional_light.base.color",     m_dir_light_properties.color);
     m_directional_light_shader->setUniform("u_directional_light.base.intensity", m_dir_light_properties.intensity);
     m_directional_light_shader->setUniform("u_directional_light.direction",      m_dir_light_properties.direction);
-    m_directional_light_shader->setUniform("u_light_view_projections",           m_dir_light_view_projection_matrices.data(), m_dir_light_view_projection_matrices.size());
-    m_directional_light_shader->setUniform("u_light_views",                      m_dir_light_view_matrices.data(), m_dir_light_view_matrices.size());
-    
-    m_directional_light_shader->setUniform("u_blocker_search_samples", m_blocker_search_samples);
-    m_directional_light_shader->setUniform("u_pcf_samples",            m_pcf_filter_samples);
-    m_directional_light_shader->setUniform("u_light_frustum_planes",   &m_dir_shadow_frustum_planes[0], std::size(m_dir_shadow_frustum_planes));
-    m_directional_light_shader->setUniform("u_show_cascades",          m_show_cascades);
-    m_directional_light_shader->setUniform("u_hard_shadows",           m_hard_shadows);
+    m_directional_light_shader->setUniform("u_show_cascades",                    m_show_cascades);
+    m_directional_light_shader->setUniform("u_hard_shadows",                     m_hard_shadows);
+    m_directional_light_shader->setUniform("u_shadow_mask",                      m_shadow_mask);
 
-    glBindTextureUnit(9, m_dir_shadow_maps);
-    glBindTextureUnit(10, m_dir_shadow_maps);
-    m_shadow_map_pcf_sampler.Bind(10); // Bind PCF shadow sampler
+    SetShadowUniforms(m_directional_light_shader);
 
-    glBindTextureUnit(11, m_random_angles_tex3d_id);
+    if (m_shadow_mask)
+    {
+        m_shadow_mask_rt->BindColor(13);
+    }
 
     for (uint32_t i = 0; i < m_models_with_model_matrices.size(); ++i)
     {
@@ -753,42 +981,130 @@ void CascadedPCSS::RenderTexturedModels()
     glDepthMask(GL_TRUE);
     glDepthFunc(GL_LEQUAL);
     glDisable(GL_BLEND);
+
+    m_shadow_mask_rt.reset();
+}
+
+void CascadedPCSS::SetShadowUniforms(const std::shared_ptr<RGL::Shader>& shader)
+{
+    shader->setUniform("u_light_view_projections", m_dir_light_view_projection_matrices.data(), m_cascades_count);
+    shader->setUniform("u_light_views",            m_dir_light_view_matrices.data(), m_cascades_count);
+    shader->setUniform("u_light_frustum_planes",   &m_dir_shadow_frustum_planes[0], m_cascades_count);
+    shader->setUniform("u_cascade_splits",         &m_cascade_split_depths[0], m_cascades_count);
+    shader->setUniform("u_cascades_count",         m_cascades_count);
+    shader->setUniform("u_blocker_search_samples", m_blocker_search_samples);
+    shader->setUniform("u_pcf_samples",            m_pcf_filter_samples);
+    shader->setUniform("u_light_radius_uv",        m_cascades_light_radius_uv);
+    shader->setUniform("u_adaptive_sampling",      m_adaptive_sampling);
+
+    glBindTextureUnit(9, m_dir_shadow_maps);
+    glBindTextureUnit(10, m_dir_shadow_maps);
+    RGL::SamplerCache::Bind(10, m_shadow_map_pcf_sampler); // Bind PCF shadow sampler
+
+    glBindTextureUnit(11, m_random_angles_tex3d_id);
+    glBindTextureUnit(12, m_dir_shadow_min_max);
+}
+
+void CascadedPCSS::RenderShadowMask()
+{
+    const uint32_t width       = m_tmo_ps->m_rt->GetWidth();
+    const uint32_t height      = m_tmo_ps->m_rt->GetHeight();
+    const uint32_t half_width  = (width  + 1) / 2;
+    const uint32_t half_height = (height + 1) / 2;
+
+    const glm::mat4 inv_projection = m_camera->inverseProjection();
+
+    /* PCSS at a texel per 2x2 pixels. */
+    auto half_mask_rt = RGL::RenderTargetPool::Acquire({ half_width, half_height, GL_RG16F, 0 });
+
+    m_shadow_mask_shader->bind();
+    m_shadow_mask_shader->setUniform("u_inv_projection",  inv_projection);
+    m_shadow_mask_shader->setUniform("u_inv_view",        m_camera->inverseView());
+    m_shadow_mask_shader->setUniform("u_light_direction", m_dir_light_properties.direction);
+    m_shadow_mask_shader->setUniform("u_hard_shadows",    m_hard_shadows);
+    SetShadowUniforms(m_shadow_mask_shader);
+
+    m_tmo_ps->m_rt->BindDepth(0);
+    half_mask_rt->BindColorImage(0, 0, GL_WRITE_ONLY);
+
+    glDispatchCompute((half_width + 7) / 8, (half_height + 7) / 8, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    /* Depth-aware upsample to the pixels, the lighting reads them. */
+    m_shadow_mask_rt = RGL::RenderTargetPool::Acquire({ width, height, GL_R8, 0 });
+
+    m_shadow_upsample_shader->bind();
+    m_shadow_upsample_shader->setUniform("u_inv_projection", inv_projection);
+
+    m_tmo_ps->m_rt->BindDepth(0);
+    half_mask_rt->BindColor(1);
+    m_shadow_mask_rt->BindColorImage(0, 0, GL_WRITE_ONLY);
+
+    glDispatchCompute((width + 15) / 16, (height + 15) / 16, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
 }
 
 void CascadedPCSS::render()
 {
+    ReadDepthBounds();
+
     // Generate shadow map
-    GenerateShadowMap(m_dir_light_shadow_map_res.x, m_dir_light_shadow_map_res.y);
+    {
+        RGL::ProfilerScope scope("Shadow cascades");
+        GenerateShadowMap(m_dir_light_shadow_map_res.x, m_dir_light_shadow_map_res.y);
+    }
 
     /* Put render specific code here. Don't update variables here! */
-    m_tmo_ps->bindFilterFBO();
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
+    m_dynamic_resolution.Update(RGL::Window::getWidth(), RGL::Window::getHeight());
 
-    RenderTexturedModels();
+    /* The shading rates come from the last frame's scene, before the target is bound and cleared. */
+    if (m_tmo_ps->m_rt)
+    {
+        m_variable_rate_shading.Update(*m_tmo_ps->m_rt, m_dynamic_resolution.GetRenderWidth(), m_dynamic_resolution.GetRenderHeight());
+    }
 
-    m_background_shader->bind();
-    m_background_shader->setUniform("u_projection", m_camera->m_projection);
-    m_background_shader->setUniform("u_view", glm::mat4(glm::mat3(m_camera->m_view)));
-    m_background_shader->setUniform("u_lod_level", m_background_lod_level);
-    m_env_cubemap_rt->bindTexture();
-    
-    glCullFace(GL_FRONT);
-    glBindVertexArray(m_skybox_vao);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glCullFace(GL_BACK);
+    m_tmo_ps->bindFilterFBO(m_dynamic_resolution.GetRenderWidth(), m_dynamic_resolution.GetRenderHeight());
+    glViewport(0, 0, m_dynamic_resolution.GetRenderWidth(), m_dynamic_resolution.GetRenderHeight());
 
-    m_tmo_ps->render(m_exposure, m_gamma);
+    {
+        RGL::ProfilerScope scope("Lighting");
+
+        m_variable_rate_shading.BeginShading();
+        RenderTexturedModels();
+        m_variable_rate_shading.EndShading();
+    }
+
+    if (m_reduce_depth)
+    {
+        RGL::ProfilerScope scope("Depth reduction");
+        ReduceDepth();
+    }
+
+    {
+        RGL::ProfilerScope scope("Skybox");
+
+        m_skybox.Render(m_ibl, m_camera->m_projection, m_camera->m_view, m_background_blur);
+    }
+
+    {
+        RGL::ProfilerScope scope("Tone mapping");
+        m_tmo_ps->render(m_exposure, m_gamma, m_dynamic_resolution);
+    }
 
     // visualize shadow maps
     if (m_draw_debug_visualize_shadow_maps)
     {
+        RGL::ProfilerScope scope("Debug shadow maps");
+
         glBindVertexArray(m_tmo_ps->m_dummy_vao_id);
         glBindTextureUnit(0, m_dir_shadow_maps);
         m_visualize_shadow_map_shader->bind();
 
-        for(uint32_t i = 0; i < NUM_CASCADES; ++i)
+        /* Side by side, as many as fit the window. */
+        uint32_t width = glm::min(uint32_t(RGL::Window::getWidth() * 0.4), uint32_t(RGL::Window::getWidth()) / uint32_t(m_cascades_count));
+
+        for(uint32_t i = 0; i < uint32_t(m_cascades_count); ++i)
         {
-            static uint32_t width = RGL::Window::getWidth() * 0.4;
             glViewport(width * i, 0, width, width);
             m_visualize_shadow_map_shader->setUniform("u_layer", int(i));
             glDrawArrays(GL_TRIANGLES, 0, 3);
@@ -825,7 +1141,10 @@ void CascadedPCSS::render_gui()
         ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
         ImGui::SliderFloat("Exposure",             &m_exposure,             0.0, 10.0, "%.1f");
         ImGui::SliderFloat("Gamma",                &m_gamma,                0.0, 10.0, "%.1f");
-        ImGui::SliderFloat("Background LOD level", &m_background_lod_level, 0.0, glm::log2(float(m_env_cubemap_rt->m_width)), "%.1f");
+        ImGui::SliderFloat("Background blur",      &m_background_blur,      0.0, 1.0, "%.2f");
+
+        m_dynamic_resolution.RenderGui();
+        m_variable_rate_shading.RenderGui();
 
         if (ImGui::BeginCombo("HDR map", m_hdr_maps_names[m_current_hdr_map_idx].c_str()))
         {
@@ -836,7 +1155,7 @@ void CascadedPCSS::render_gui()
                 {
                     glDisable(GL_CULL_FACE);
                     m_current_hdr_map_idx = i;
-                    PrecomputeIndirectLight(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx]);
+                    m_ibl.Load(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx], RGL::ImageBasedLighting::PrefilterMode::FAST);
                     glEnable(GL_CULL_FACE);
                 }
 
@@ -865,9 +1184,50 @@ void CascadedPCSS::render_gui()
             ImGui::SliderFloat("Split lambda", &m_cascade_split_lambda, 0.1, 1.0);
         }
 
+        if (m_is_layered_csm_supported)
+        {
+            static const char* items[] = { "geometry shader", "layered instancing" };
+
+            int idx = int(m_cascades_path);
+            if (ImGui::Combo("Cascades path", &idx, items, std::size(items)))
+            {
+                m_cascades_path = CascadesPath(idx);
+            }
+
+            if (m_cascades_path == CascadesPath::LAYERED_INSTANCING)
+            {
+                ImGui::Text("Shadow casters: %u of %u", uint32_t(m_cascade_instances.size()), uint32_t(m_models_with_model_matrices.size() * m_cascades_count));
+            }
+        }
+        else
+        {
+            ImGui::TextDisabled("GL_ARB_shader_viewport_layer_array is not supported.");
+        }
+
+        ImGui::Checkbox("Depth reduction (SDSM)", &m_reduce_depth);
+
+        if (m_reduce_depth)
+        {
+            ImGui::Text("Depth bounds: %.2f - %.2f", m_depth_bounds.x, m_depth_bounds.y);
+        }
+
+        if (ImGui::SliderInt("Cascades", &m_cascades_count, 1, MAX_CASCADES))
+        {
+            CreateShadowFBO(m_dir_light_shadow_map_res.x, m_dir_light_shadow_map_res.y);
+        }
+
+        ImGui::SliderInt("Full rate cascades", &m_full_rate_cascades, 1, MAX_CASCADES);
+
         ImGui::Checkbox("Show shadow maps", &m_draw_debug_visualize_shadow_maps);
         ImGui::Checkbox("Show cascades",    &m_show_cascades);
         ImGui::Checkbox("Stable CSM",       &m_stable_csm);
+
+        if (m_stable_csm)
+        {
+            ImGui::Checkbox("Scroll cascades", &m_scroll_cascades);
+        }
+
+        ImGui::Text("Cascades rendered: %u, scrolled: %u", m_cascades_rendered, m_cascades_scrolled);
         ImGui::Checkbox("Hard shadows",     &m_hard_shadows);
 
         ImGui::Spacing();
@@ -888,6 +1248,19 @@ void CascadedPCSS::render_gui()
             }
 
             ImGui::SliderFloat("Light radius", &m_light_radius_uv, 0.0, 1.0, "%.2f");
+            ImGui::Checkbox   ("Adaptive sampling", &m_adaptive_sampling);
+
+            if (ImGui::IsItemHovered())
+            {
+                ImGui::SetTooltip("Skips the lit and the umbra pixels with a min/max depth hierarchy,\nscales the sample counts with the kernel's size in pixels.");
+            }
+
+            ImGui::Checkbox   ("Half resolution shadow mask", &m_shadow_mask);
+
+            if (ImGui::IsItemHovered())
+            {
+                ImGui::SetTooltip("Resolves the shadows in a compute pass at half resolution after the ambient pass,\nthen upsamples them with the depth for the lighting.");
+            }
         }
 
         ImGui::PopItemWidth();
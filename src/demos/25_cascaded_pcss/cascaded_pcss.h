@@ -1,14 +1,23 @@
 #pragma once
 #include "core_app.h"
+#include "async_readback.h"
 
 #include "camera.h"
+#include "dynamic_resolution.h"
+#include "gl_state.h"
+#include "image_based_lighting.h"
+#include "render_target_pool.h"
+#include "sampler_cache.h"
 #include "static_model.h"
 #include "shader.h"
+#include "skybox.h"
+#include "variable_rate_shading.h"
+#include "window.h"
 
 #include <memory>
 #include <vector>
 
-#define NUM_CASCADES 3
+#define MAX_CASCADES 8
 #define NUM_FRUSTUM_CORNERS 8
 
 struct BaseLight
@@ -38,26 +47,13 @@ struct PostprocessFilter
 {
     std::shared_ptr<RGL::Shader> m_shader;
 
-    GLuint m_fbo_id{};
-    GLuint m_rbo_id{};
-    GLuint m_tex_id{};
+    /* The HDR target of the frame, from bindFilterFBO() until render(). */
+    std::shared_ptr<RGL::RenderTarget> m_rt;
+
     GLuint m_dummy_vao_id{};
 
-    PostprocessFilter(const uint32_t width, const uint32_t height)
+    PostprocessFilter()
     {
-        glCreateFramebuffers(1, &m_fbo_id);
-
-        glCreateTextures(GL_TEXTURE_2D, 1, &m_tex_id);
-        glTextureStorage2D(m_tex_id, 1, GL_RGB32F, width, height);
-        glTextureParameteri(m_tex_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTextureParameteri(m_tex_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        glCreateRenderbuffers(1, &m_rbo_id);
-        glNamedRenderbufferStorage(m_rbo_id, GL_DEPTH24_STENCIL8, width, height);
-
-        glNamedFramebufferTexture(m_fbo_id, GL_COLOR_ATTACHMENT0, m_tex_id, 0);
-        glNamedFramebufferRenderbuffer(m_fbo_id, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_rbo_id);
-
         m_shader = std::make_shared<RGL::Shader>("src/demos/10_postprocessing_filters/FSQ.vert", "src/demos/22_pbr/tmo.frag");
         m_shader->link();
 
@@ -66,21 +62,6 @@ struct PostprocessFilter
 
     ~PostprocessFilter()
     {
-        if(m_fbo_id != 0)
-        {
-            glDeleteFramebuffers(1, &m_fbo_id);
-        }
-
-        if(m_rbo_id != 0)
-        {
-            glDeleteRenderbuffers(1, &m_rbo_id);
-        }
-
-        if(m_tex_id != 0)
-        {
-            glDeleteTextures(1, &m_tex_id);
-        }
-
         if (m_dummy_vao_id != 0)
         {
             glDeleteVertexArrays(1, &m_dummy_vao_id);
@@ -89,19 +70,31 @@ struct PostprocessFilter
 
     void bindTexture(GLuint unit = 0) const
     {
-        glBindTextureUnit(unit, m_tex_id);
+        m_rt->BindColor(unit);
     }
 
-    void bindFilterFBO() const
+    void bindFilterFBO(uint32_t width, uint32_t height)
     {
-        glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_id);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        /* The same target every frame, a resize or a new render scale makes the pool create one of the new size. */
+        m_rt = RGL::RenderTargetPool::Acquire({ width, height, RGL::RenderTargetPool::GetColorFormat(RGL::RenderTargetUsage::HDR_COLOR), GL_DEPTH24_STENCIL8 });
+        m_rt->Bind();
     }
 
-    void render(float exposure, float gamma) const
+    void render(float exposure, float gamma, RGL::DynamicResolution& dynamic_resolution)
     {
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        /* A scaled frame is tone mapped at its size, the upscaling works on the tone mapped colors. */
+        std::shared_ptr<RGL::RenderTarget> ldr_rt;
+
+        if (dynamic_resolution.IsScaled())
+        {
+            ldr_rt = RGL::RenderTargetPool::Acquire({ m_rt->GetWidth(), m_rt->GetHeight(), GL_RGBA8, 0 });
+            ldr_rt->Bind(GL_COLOR_BUFFER_BIT);
+        }
+        else
+        {
+            RGL::GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
 
         m_shader->bind();
         m_shader->setUniform("u_exposure", exposure);
@@ -110,9 +103,27 @@ struct PostprocessFilter
 
         glBindVertexArray(m_dummy_vao_id);
         glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        if (ldr_rt)
+        {
+            dynamic_resolution.Upscale(*ldr_rt);
+        }
+
+        /* Back to the pool, free for the other passes until the next frame. */
+        m_rt.reset();
     }
 };
 
+/* An object of the cascade it overlaps, see generate_csm_layered.vert. */
+struct CascadeInstance
+{
+    glm::mat4 model;
+    uint32_t  cascade;
+    uint32_t  padding0;
+    uint32_t  padding1;
+    uint32_t  padding2;
+};
+
 class CascadedPCSS : public RGL::CoreApp
 {
 public:
@@ -126,180 +137,11 @@ public:
     void render_gui()              override;
 
 private:
-    struct Texture2DRenderTarget
-    {
-        GLuint m_texture_id = 0;
-        GLuint m_fbo_id = 0;
-        GLuint m_rbo_id = 0;
-        GLuint m_width = 0, m_height = 0;
-
-        ~Texture2DRenderTarget() { cleanup(); }
-
-        void bindTexture(GLuint unit = 0) const
-        {
-            glBindTextureUnit(unit, m_texture_id);
-        }
-
-        void bindRenderTarget() const
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_id);
-            glViewport(0, 0, m_width, m_height);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        }
-
-        void cleanup() const
-        {
-            if (m_texture_id != 0)
-            {
-                glDeleteTextures(1, &m_texture_id);
-            }
-
-            if (m_fbo_id != 0)
-            {
-                glDeleteFramebuffers(1, &m_fbo_id);
-            }
-
-            if (m_rbo_id != 0)
-            {
-                glDeleteRenderbuffers(1, &m_rbo_id);
-            }
-        }
-
-        void generate_rt(uint32_t width, uint32_t height)
-        {
-            m_width = width;
-            m_height = height;
-
-            glGenTextures(1, &m_texture_id);
-            glBindTexture(GL_TEXTURE_2D, m_texture_id);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, m_width, m_height, 0, GL_RG, GL_FLOAT, 0);
-
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-            glGenFramebuffers(1, &m_fbo_id);
-            glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_id);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_texture_id, 0);
-
-            glGenRenderbuffers(1, &m_rbo_id);
-            glBindRenderbuffer(GL_RENDERBUFFER, m_rbo_id);
-            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_width, m_height);
-            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_rbo_id);
-
-            glBindTexture(GL_TEXTURE_2D, 0);
-            glBindRenderbuffer(GL_RENDERBUFFER, 0);
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        }
-    };
-
-    struct CubeMapRenderTarget
-    {
-        glm::mat4 m_view_transforms[6]{};
-        glm::mat4 m_projection{};
-
-        GLuint    m_cubemap_texture_id = 0;
-        GLuint    m_fbo_id             = 0;
-        GLuint    m_rbo_id             = 0;
-        glm::vec3 m_position           = glm::vec3(0.0f);
-        GLuint m_width{}, m_height{};
-
-        ~CubeMapRenderTarget() { cleanup(); }
-
-        void set_position(const glm::vec3 pos)
-        {
-            m_position = pos;
-            m_view_transforms[0] = glm::lookAt(pos, pos + glm::vec3( 1,  0,  0), glm::vec3(0, -1,  0));
-            m_view_transforms[1] = glm::lookAt(pos, pos + glm::vec3(-1,  0,  0), glm::vec3(0, -1,  0));
-            m_view_transforms[2] = glm::lookAt(pos, pos + glm::vec3( 0,  1,  0), glm::vec3(0,  0,  1));
-            m_view_transforms[3] = glm::lookAt(pos, pos + glm::vec3( 0, -1,  0), glm::vec3(0,  0, -1));
-            m_view_transforms[4] = glm::lookAt(pos, pos + glm::vec3( 0,  0,  1), glm::vec3(0, -1,  0));
-            m_view_transforms[5] = glm::lookAt(pos, pos + glm::vec3( 0,  0, -1), glm::vec3(0, -1,  0));
-
-            m_projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
-        }
-
-        void bindTexture(GLuint unit = 0) const
-        {
-            glBindTextureUnit(unit, m_cubemap_texture_id);
-        }
-
-        void cleanup() const
-        {
-            if (m_cubemap_texture_id != 0)
-            {
-                glDeleteTextures(1, &m_cubemap_texture_id);
-            }
-
-            if (m_fbo_id != 0)
-            {
-                glDeleteFramebuffers(1, &m_fbo_id);
-            }
-
-            if (m_rbo_id != 0)
-            {
-                glDeleteRenderbuffers(1, &m_rbo_id);
-            }
-        }
-
-        void generate_rt(uint32_t width, uint32_t height, bool gen_mip_levels = false)
-        {
-            m_width  = width;
-            m_height = height;
-
-            glGenTextures(1, &m_cubemap_texture_id);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubemap_texture_id);
-
-            for (uint8_t i = 0; i < 6; ++i)
-            {
-                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, m_width, m_height, 0, GL_RGB, GL_FLOAT, 0);
-            }
-
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, gen_mip_levels ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
-
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-            if (gen_mip_levels) glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-
-            glGenFramebuffers(1, &m_fbo_id);
-            glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_id);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, m_cubemap_texture_id, 0);
-
-            glGenRenderbuffers(1, &m_rbo_id);
-            glBindRenderbuffer(GL_RENDERBUFFER, m_rbo_id);
-            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_width, m_height);
-            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_rbo_id);
-
-            glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-            glBindRenderbuffer(GL_RENDERBUFFER, 0);
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        }
-    }; 
-
-    void HdrEquirectangularToCubemap(const std::shared_ptr<CubeMapRenderTarget> & cubemap_rt, const std::shared_ptr<RGL::Texture2D> & m_equirectangular_map);
-    void IrradianceConvolution      (const std::shared_ptr<CubeMapRenderTarget> & cubemap_rt);
-    void PrefilterCubemap           (const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt);
-    void PrecomputeIndirectLight    (const std::filesystem::path & hdri_map_filepath);
-    void PrecomputeBRDF             (const std::shared_ptr<Texture2DRenderTarget>& rt);
-    void GenSkyboxGeometry();
-
     void RenderTexturedModels();
 
-    std::shared_ptr<CubeMapRenderTarget> m_env_cubemap_rt;
-    std::shared_ptr<CubeMapRenderTarget> m_irradiance_cubemap_rt;
-    std::shared_ptr<CubeMapRenderTarget> m_prefiltered_env_map_rt;
-    std::shared_ptr<Texture2DRenderTarget> m_brdf_lut_rt;
+    RGL::ImageBasedLighting m_ibl;
 
-    std::shared_ptr<RGL::Shader> m_equirectangular_to_cubemap_shader;
-    std::shared_ptr<RGL::Shader> m_irradiance_convolution_shader;
-    std::shared_ptr<RGL::Shader> m_prefilter_env_map_shader;
-    std::shared_ptr<RGL::Shader> m_precompute_brdf;
-    std::shared_ptr<RGL::Shader> m_background_shader;
+    RGL::Skybox m_skybox;
 
     std::shared_ptr<RGL::Camera> m_camera;
     std::shared_ptr<RGL::Shader> m_ambient_light_shader;
@@ -309,17 +151,17 @@ private:
     RGL::StaticModel m_plane_model;
     RGL::StaticModel m_hk_model;
 
-    GLuint m_skybox_vao{}, m_skybox_vbo{};
-
     DirectionalLight m_dir_light_properties;
     glm::vec2        m_dir_light_angles;   /* azimuth and elevation angles */
     glm::vec2        m_spot_light_angles;  /* azimuth and elevation angles */
 
     std::shared_ptr<PostprocessFilter> m_tmo_ps;
+    RGL::DynamicResolution             m_dynamic_resolution;
+    RGL::VariableRateShading           m_variable_rate_shading;
     float m_exposure; 
     float m_gamma;
 
-    float m_background_lod_level;
+    float m_background_blur; /* The roughness of the prefiltered level of the background, 0 - the environment map. */
     std::string m_hdr_maps_names[2] = { "phalzer_forest_01_4k.hdr", "sunset_fairway_4k.hdr" };
     uint8_t m_current_hdr_map_idx   = 0;
 
@@ -331,24 +173,125 @@ private:
     void update_csm_splits();
     void update_csm_frusta();
 
+    /*
+     * Picks the cascades rendered this frame and scrolls the contents of the scrolled ones, returns the mask
+     * of the cascades to render. Their scissors are the rects of m_cascades_render_rects.
+     */
+    uint32_t ScheduleCascades();
+    void     InvalidateCascades();
+
+    /*
+     * The min and max view depth of the opaque pixels, reduced after the lighting and read back DEPTH_BOUNDS_FRAMES
+     * frames late at most, as soon as its fence is signaled. The splits cover only this range (SDSM).
+     */
+    void ReduceDepth();
+    void ReadDepthBounds();
+
+    /* The min and max depth hierarchy of the cascades, the blocker search skips the lit and the umbra pixels with it. */
+    void BuildShadowMinMax();
+
+    /* The cascades, their PCSS settings and textures, of the lighting and of the shadow mask (csm_pcss.glh). */
+    void SetShadowUniforms(const std::shared_ptr<RGL::Shader>& shader);
+
+    /*
+     * Resolves the visibility of the directional light from the depth of the ambient pass: PCSS at half resolution,
+     * then a depth-aware upsample to m_shadow_mask_rt, which the lighting reads instead of the shadow maps.
+     */
+    void RenderShadowMask();
+
+    /* The objects whose bounds overlap the boxes of the cascades of the mask, a batch of instances per model. */
+    void CullShadowCasters(uint32_t cascades_mask);
+
+    /*
+     * How the objects get into the cascades: a geometry shader invocation per cascade for every triangle,
+     * or the vertex shader's gl_Layer (ARB_shader_viewport_layer_array) and an instance per culled object and cascade.
+     */
+    enum class CascadesPath { GEOMETRY_SHADER, LAYERED_INSTANCING };
+
+    struct ShadowCastersBatch
+    {
+        RGL::StaticModel* m_model;
+        uint32_t          m_first_instance;
+        uint32_t          m_instances_count;
+    };
+
+    CascadesPath m_cascades_path            = CascadesPath::GEOMETRY_SHADER;
+    bool         m_is_layered_csm_supported = false;
+
+    std::vector<glm::vec4>          m_models_bounds; /* Object space spheres of m_models_with_model_matrices. */
+    std::vector<CascadeInstance>    m_cascade_instances;
+    std::vector<ShadowCastersBatch> m_shadow_casters_batches;
+    GLuint                          m_cascade_instances_ssbo;
+    uint32_t                        m_cascade_instances_capacity;
+
+    /*
+     * The light space box of a cascade. The scrolled ones share the rotation of the light and are snapped to the texels,
+     * so a moved box is the cached map shifted by whole texels.
+     */
+    struct CascadeView
+    {
+        glm::mat4 m_view;
+        glm::mat4 m_view_projection;
+        glm::vec2 m_frustum_planes;
+        glm::vec3 m_light_dir;
+        glm::vec2 m_center_ls;    /* The snapped center of the box in the light space, scrolled only. */
+        float     m_depth_center; /* Fixed while the cascade's depth stays within the margin, scrolled only. */
+        float     m_radius;
+        bool      m_is_scrolled;
+    };
+
     GLuint m_csm_frusta_vao;
     GLuint m_csm_frusta_vbo;
 
-    RGL::TextureSampler m_shadow_map_pcf_sampler;
+    RGL::SamplerDesc m_shadow_map_pcf_sampler;
     GLuint m_shadow_fbo;
     GLuint m_dir_shadow_maps;
+    GLuint m_dir_shadow_scroll_map; /* The overlap of a scrolled cascade is copied through it. */
+    GLuint m_dir_shadow_min_max;    /* RG32F, its first level is a texel per SHADOW_MIN_MAX_FOOTPRINT^2 depths. */
+
+    static constexpr uint32_t SHADOW_MIN_MAX_FOOTPRINT = 8;
     
     glm::uvec2 m_dir_light_shadow_map_res;
-    glm::vec2  m_dir_shadow_frustum_planes[NUM_CASCADES];
+    glm::vec2  m_dir_shadow_frustum_planes[MAX_CASCADES];
+    float      m_cascade_split_depths[MAX_CASCADES]{}; /* The far view depth of every cascade but the last one. */
+    float      m_cascades_light_radius_uv = 0.0f;     /* The light radius in the UV of the largest cascade. */
 
-    float m_cascade_splits[NUM_CASCADES];
+    float m_cascade_splits[MAX_CASCADES];
 
+    /* What the maps contain, the lighting uses them. m_cascade_targets are the boxes of the current frame. */
     std::vector<glm::mat4> m_dir_light_view_projection_matrices;
     std::vector<glm::mat4> m_dir_light_view_matrices;
+    CascadeView            m_cascade_targets[MAX_CASCADES];
+    CascadeView            m_cascades[MAX_CASCADES];
+    bool                   m_is_cascade_valid[MAX_CASCADES] = {};
+    glm::uvec4             m_cascades_render_rects[2][MAX_CASCADES]; /* x, y, width, height. A strip along x, then one along y. */
+    uint32_t               m_cascades_rects_masks[2];
+
+    int      m_cascades_count        = 3;
+    int      m_full_rate_cascades    = 2;    /* The nearest ones are updated every frame, one of the others per frame. */
+    uint32_t m_round_robin_cascade   = 0;
+    bool     m_scroll_cascades       = true; /* Stable CSM only, the geometry is static. */
+    uint32_t m_cascades_rendered     = 0;
+    uint32_t m_cascades_scrolled     = 0;
+
+    static constexpr uint32_t DEPTH_BOUNDS_FRAMES = 2;
+
+    std::shared_ptr<RGL::Shader> m_depth_reduction_shader;
+    GLuint                       m_depth_bounds_ssbo;
+    RGL::AsyncReadback           m_depth_bounds_readback;
+    glm::vec2                    m_depth_bounds;                            /* The view depth range of the last read back frame. */
+    float                        m_cascades_near_split                      = 0.0f; /* Where the first cascade begins, in the splits' [0, 1] range. */
 
     GLuint m_random_angles_tex3d_id;
     std::shared_ptr<RGL::Shader> m_generate_shadow_map_shader;
+    std::shared_ptr<RGL::Shader> m_generate_layered_shadow_map_shader;
     std::shared_ptr<RGL::Shader> m_visualize_shadow_map_shader;
+    std::shared_ptr<RGL::Shader> m_shadow_min_max_shader;
+    std::shared_ptr<RGL::Shader> m_shadow_mask_shader;
+    std::shared_ptr<RGL::Shader> m_shadow_upsample_shader;
+
+    /* R8, the full resolution visibility, from RenderShadowMask() until the lighting is done. */
+    std::shared_ptr<RGL::RenderTarget> m_shadow_mask_rt;
 
     // GUI
     int m_blocker_search_samples = 128;
@@ -362,6 +305,9 @@ private:
     bool m_show_cascades                    = false;
     bool m_hard_shadows                     = false;
     bool m_stable_csm                       = true;
+    bool m_reduce_depth                     = true;
+    bool m_adaptive_sampling                = true;
+    bool m_shadow_mask                      = true;
 
     enum class SplitScheme { UNIFORM, LOG, PRACTICAL } m_split_scheme = SplitScheme::PRACTICAL;
 };
\ No newline at end of file
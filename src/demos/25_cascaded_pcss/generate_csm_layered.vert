@@ -0,0 +1,33 @@
+#version 460 core
+#extension GL_ARB_shader_viewport_layer_array : require
+
+const int MAX_CASCADES = 8;
+
+layout (location = 0) in vec3 in_pos;
+
+// An object of the cascade it overlaps, the instances of a draw are consecutive.
+struct CascadeInstance
+{
+	mat4 model;
+	uint cascade;
+	uint padding0;
+	uint padding1;
+	uint padding2;
+};
+
+layout(std430, binding = 0) readonly buffer CascadeInstancesSSBO
+{
+	CascadeInstance cascade_instances[];
+};
+
+uniform mat4 u_light_view_projections[MAX_CASCADES];
+uniform uint u_first_instance;
+
+void main()
+{
+	CascadeInstance instance = cascade_instances[u_first_instance + gl_InstanceID];
+
+	gl_Position = u_light_view_projections[instance.cascade] * instance.model * vec4(in_pos, 1.0);
+	gl_Layer         = int(instance.cascade);
+	gl_ViewportIndex = int(instance.cascade);
+}
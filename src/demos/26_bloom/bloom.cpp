@@ -1,6 +1,7 @@
 #include "bloom.h"
 #include "filesystem.h"
 #include "input.h"
+#include "profiler.h"
 #include "util.h"
 #include "gui/gui.h"
 
@@ -11,29 +12,23 @@
 Bloom::Bloom()
       : m_exposure            (1.0f),
         m_gamma               (3.6f),
-        m_background_lod_level(1.2),
-        m_skybox_vao          (0),
-        m_skybox_vbo          (0),
+        m_background_blur     (0.1f),
         m_threshold           (1.5),
         m_knee                (0.1),
         m_bloom_intensity     (1.0),
         m_bloom_dirt_intensity(1.0),
-        m_bloom_enabled       (true)
+        m_bloom_enabled       (true),
+        m_bloom_single_pass   (true),
+        m_bloom_counter_buffer(0)
 {
 }
 
 Bloom::~Bloom()
 {
-    if (m_skybox_vao != 0)
+    if (m_bloom_counter_buffer != 0)
     {
-        glDeleteVertexArrays(1, &m_skybox_vao);
-        m_skybox_vao = 0;
-    }
-
-    if (m_skybox_vbo != 0)
-    {
-        glDeleteBuffers(1, &m_skybox_vbo);
-        m_skybox_vbo = 0;
+        glDeleteBuffers(1, &m_bloom_counter_buffer);
+        m_bloom_counter_buffer = 0;
     }
 }
 
@@ -49,6 +44,7 @@ void Bloom::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<RGL::Camera>(60.0, RGL::Window::getAspectRatio(), 0.01, 100.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(-8.32222, 1.9269, -0.768721);
     m_camera->setOrientation(glm::quat(0.634325, 0.0407623, 0.772209, 0.0543523));
    
@@ -194,54 +190,37 @@ void Bloom::init_app()
     m_point_light_shader = std::make_shared<RGL::Shader>(dir + "pbr-lighting.vert", dir + "pbr-point.frag");
     m_point_light_shader->link();
 
-    m_equirectangular_to_cubemap_shader = std::make_shared<RGL::Shader>(dir + "cubemap.vert", dir + "equirectangular_to_cubemap.frag");
-    m_equirectangular_to_cubemap_shader->link();
-
-    m_irradiance_convolution_shader = std::make_shared<RGL::Shader>(dir + "cubemap.vert", dir + "irradiance_convolution.frag");
-    m_irradiance_convolution_shader->link();
-
-    m_prefilter_env_map_shader = std::make_shared<RGL::Shader>(dir + "cubemap.vert", dir + "prefilter_cubemap.frag");
-    m_prefilter_env_map_shader->link();
+    m_skybox.Create();
 
-    m_precompute_brdf = std::make_shared<RGL::Shader>("src/demos/10_postprocessing_filters/FSQ.vert", dir + "precompute_brdf.frag");
-    m_precompute_brdf->link();
+    m_tmo_ps = std::make_shared<PostprocessFilter>();
 
-    m_background_shader = std::make_shared<RGL::Shader>(dir + "background.vert", dir + "background.frag");
-    m_background_shader->link();
-
-    m_tmo_ps = std::make_shared<PostprocessFilter>(RGL::Window::getWidth(), RGL::Window::getHeight());
-
-    /* Bloom shaders. */
+    /* Bloom shaders, their images have the format of the mip chain. */
     dir = "src/demos/26_bloom/";
+    const char* image_format = RGL::RenderTargetPool::GetImageFormatQualifier(RGL::RenderTargetPool::GetColorFormat(RGL::RenderTargetUsage::BLOOM));
+
     m_downscale_shader = std::make_shared<RGL::Shader>(dir + "downscale.comp");
+    m_downscale_shader->setDefine("HDR_IMAGE_FORMAT", image_format);
     m_downscale_shader->link();
 
     m_upscale_shader = std::make_shared<RGL::Shader>(dir + "upscale.comp");
+    m_upscale_shader->setDefine("HDR_IMAGE_FORMAT", image_format);
     m_upscale_shader->link();
 
+    m_downscale_single_pass_shader = std::make_shared<RGL::Shader>(dir + "downscale_single_pass.comp");
+    m_downscale_single_pass_shader->setDefine("HDR_IMAGE_FORMAT", image_format);
+    m_downscale_single_pass_shader->link();
+
+    const uint32_t zero = 0;
+    glCreateBuffers     (1, &m_bloom_counter_buffer);
+    glNamedBufferStorage(m_bloom_counter_buffer, sizeof(uint32_t), &zero, 0);
+
     m_bloom_dirt_texture = std::make_shared<RGL::Texture2D>(); 
     m_bloom_dirt_texture->Load(RGL::FileSystem::getResourcesPath() / "textures/bloom_dirt_mask.png");
 
     /* IBL precomputations. */
-    GenSkyboxGeometry();
 
-    m_env_cubemap_rt = std::make_shared<CubeMapRenderTarget>();
-    m_env_cubemap_rt->set_position(glm::vec3(0.0));
-    m_env_cubemap_rt->generate_rt(2048, 2048, true);
-
-    m_irradiance_cubemap_rt = std::make_shared<CubeMapRenderTarget>();
-    m_irradiance_cubemap_rt->set_position(glm::vec3(0.0));
-    m_irradiance_cubemap_rt->generate_rt(32, 32);
-
-    m_prefiltered_env_map_rt = std::make_shared<CubeMapRenderTarget>();
-    m_prefiltered_env_map_rt->set_position(glm::vec3(0.0));
-    m_prefiltered_env_map_rt->generate_rt(512, 512, true);
-
-    m_brdf_lut_rt = std::make_shared<Texture2DRenderTarget>();
-    m_brdf_lut_rt->create(512, 512, GL_RG16F);
-
-    PrecomputeIndirectLight(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx]);
-    PrecomputeBRDF(m_brdf_lut_rt);
+    m_ibl.Create();
+    m_ibl.Load(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx]);
 }
 
 void Bloom::input()
@@ -300,196 +279,17 @@ void Bloom::update(double delta_time)
     m_camera->update(delta_time);
 }
 
-void Bloom::HdrEquirectangularToCubemap(const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt, const std::shared_ptr<RGL::Texture2D>& m_equirectangular_map)
-{
-    /* Update all faces per frame */
-    m_equirectangular_to_cubemap_shader->bind();
-    m_equirectangular_to_cubemap_shader->setUniform("u_projection", cubemap_rt->m_projection);
-
-    glViewport(0, 0, cubemap_rt->m_width, cubemap_rt->m_height);
-    glBindFramebuffer(GL_FRAMEBUFFER, cubemap_rt->m_fbo_id);
-    m_equirectangular_map->Bind(1);
-
-    for (uint8_t side = 0; side < 6; ++side)
-    {
-        m_equirectangular_to_cubemap_shader->setUniform("u_view", cubemap_rt->m_view_transforms[side]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, cubemap_rt->m_cubemap_texture_id, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        glBindVertexArray(m_skybox_vao);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-    }
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
-}
-
-void Bloom::IrradianceConvolution(const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt)
-{
-    /* Update all faces per frame */
-    m_irradiance_convolution_shader->bind();
-    m_irradiance_convolution_shader->setUniform("u_projection", cubemap_rt->m_projection);
-
-    glViewport(0, 0, cubemap_rt->m_width, cubemap_rt->m_height);
-    glBindFramebuffer(GL_FRAMEBUFFER, cubemap_rt->m_fbo_id);
-    m_env_cubemap_rt->bindTexture(1);
-
-    for (uint8_t side = 0; side < 6; ++side)
-    {
-        m_irradiance_convolution_shader->setUniform("u_view", cubemap_rt->m_view_transforms[side]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, cubemap_rt->m_cubemap_texture_id, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        glBindVertexArray(m_skybox_vao);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-    }
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
-}
-
-void Bloom::PrefilterCubemap(const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt)
-{
-    m_prefilter_env_map_shader->bind();
-    m_prefilter_env_map_shader->setUniform("u_projection", cubemap_rt->m_projection);
-    
-    m_env_cubemap_rt->bindTexture(1);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, cubemap_rt->m_fbo_id);
-
-    uint8_t max_mip_levels = glm::log2(float(cubemap_rt->m_width));
-    for (uint8_t mip = 0; mip < max_mip_levels; ++mip)
-    {
-        // resize the framebuffer according to mip-level size.
-        uint32_t mip_width  = cubemap_rt->m_width  * std::pow(0.5, mip);
-        uint32_t mip_height = cubemap_rt->m_height * std::pow(0.5, mip);
-
-        glBindRenderbuffer(GL_RENDERBUFFER, cubemap_rt->m_rbo_id);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mip_width, mip_height);
-        glViewport(0, 0, mip_width, mip_height);
-
-        float roughness = float(mip) / float(max_mip_levels - 1);
-        m_prefilter_env_map_shader->setUniform("u_roughness", roughness);
-
-        for (uint8_t side = 0; side < 6; ++side)
-        {
-            m_prefilter_env_map_shader->setUniform("u_view", cubemap_rt->m_view_transforms[side]);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, cubemap_rt->m_cubemap_texture_id, mip);
-
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            glBindVertexArray(m_skybox_vao);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-        }
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
-}
-
-void Bloom::PrecomputeIndirectLight(const std::filesystem::path& hdri_map_filepath)
-{
-    auto envmap_hdr = std::make_shared<RGL::Texture2D>();
-    envmap_hdr->LoadHdr(hdri_map_filepath);
-    auto envmap_metadata = envmap_hdr->GetMetadata();
-
-    HdrEquirectangularToCubemap(m_env_cubemap_rt, envmap_hdr);
-
-    glBindTexture(GL_TEXTURE_CUBE_MAP, m_env_cubemap_rt->m_cubemap_texture_id);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-
-    IrradianceConvolution(m_irradiance_cubemap_rt);
-    PrefilterCubemap(m_prefiltered_env_map_rt);
-}
-
-void Bloom::PrecomputeBRDF(const std::shared_ptr<Texture2DRenderTarget>& rt)
-{
-    GLuint m_dummy_vao_id;
-    glCreateVertexArrays(1, &m_dummy_vao_id);
-
-    rt->bindRenderTarget();
-    m_precompute_brdf->bind();
-
-    glBindVertexArray(m_dummy_vao_id);
-    glDrawArrays(GL_TRIANGLES, 0, 3);
-
-    glDeleteVertexArrays(1, &m_dummy_vao_id);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, RGL::Window::getWidth(), RGL::Window::getHeight());
-}
-
-void Bloom::GenSkyboxGeometry()
-{
-    m_skybox_vao = 0;
-    m_skybox_vbo = 0;
-
-    glCreateVertexArrays(1, &m_skybox_vao);
-    glCreateBuffers(1, &m_skybox_vbo);
-
-    std::vector<float> skybox_positions = {
-        // positions          
-        -1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
-        // front face
-        -1.0f, -1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-        // left face
-        -1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-        // right face
-         1.0f,  1.0f,  1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-        // bottom face
-        -1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f, -1.0f,
-        // top face
-        -1.0f,  1.0f, -1.0f,
-         1.0f,  1.0f , 1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f,  1.0f,  1.0f,
-    };
-
-    /* Set up buffer objects */
-    glNamedBufferStorage(m_skybox_vbo, skybox_positions.size() * sizeof(skybox_positions[0]), skybox_positions.data(), 0 /*flags*/);
-
-    /* Set up VAO */
-    glEnableVertexArrayAttrib(m_skybox_vao, 0 /*index*/);
-
-    /* Separate attribute format */
-    glVertexArrayAttribFormat(m_skybox_vao, 0 /*index*/, 3 /*size*/, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/);
-    glVertexArrayAttribBinding(m_skybox_vao, 0 /*index*/, 0 /*bindingindex*/);
-    glVertexArrayVertexBuffer(m_skybox_vao, 0 /*bindingindex*/, m_skybox_vbo, 0 /*offset*/, sizeof(glm::vec3) /*stride*/);
-}
-
 void Bloom::RenderScene()
 {
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+    auto view_projection = m_camera->viewProjection();
 
     m_ambient_light_shader->bind();
     m_ambient_light_shader->setUniform("u_cam_pos", m_camera->position());
 
     /* First, render the ambient color only for the opaque objects. */
-    m_irradiance_cubemap_rt->bindTexture(6);
-    m_prefiltered_env_map_rt->bindTexture(7);
-    m_brdf_lut_rt->bindTexture(8);
+    m_ibl.BindIrradianceSH();
+    m_ibl.BindPrefilteredMap(7);
+    m_ibl.BindBrdfLut(8);
 
     for (uint32_t i = 0; i < m_static_objects.size(); ++i)
     {
@@ -564,33 +364,63 @@ void Bloom::render()
     /* Put render specific code here. Don't update variables here! */
     m_tmo_ps->bindFilterFBO();
 
-    RenderScene();
-
-    m_background_shader->bind();
-    m_background_shader->setUniform("u_projection", m_camera->m_projection);
-    m_background_shader->setUniform("u_view", glm::mat4(glm::mat3(m_camera->m_view)));
-    m_background_shader->setUniform("u_lod_level", m_background_lod_level);
-    m_env_cubemap_rt->bindTexture();
+    {
+        RGL::ProfilerScope scope("Scene");
+        RenderScene();
+    }
 
-    glBindVertexArray(m_skybox_vao);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+    RGL::Profiler::BeginScope("Skybox");
+    m_skybox.Render(m_ibl, m_camera->m_projection, m_camera->m_view, m_background_blur);
+    RGL::Profiler::EndScope();
 
     /* Bloom: downscale */
     if(m_bloom_enabled)
     {
+        RGL::ProfilerScope scope("Bloom");
+
+        RGL::Profiler::BeginScope("Downscale");
+        glm::uvec2 mip_size    = glm::uvec2(m_tmo_ps->m_rt->GetWidth() / 2, m_tmo_ps->m_rt->GetHeight() / 2);
+        uint8_t    first_level = 0;
+
+        /* Up to SINGLE_PASS_MIPS mips in one dispatch, the chains of the larger targets finish with a pass per mip. */
+        if (m_bloom_single_pass)
+        {
+            first_level = uint8_t(glm::min(m_tmo_ps->m_rt->GetLevelsCount() - 1, PostprocessFilter::SINGLE_PASS_MIPS));
+
+            const glm::uvec2 workgroups = (mip_size + PostprocessFilter::SINGLE_PASS_TILE_SIZE - 1u) / PostprocessFilter::SINGLE_PASS_TILE_SIZE;
+
+            m_downscale_single_pass_shader->bind();
+            m_downscale_single_pass_shader->setUniform("u_threshold",        glm::vec4(m_threshold, m_threshold - m_knee, 2.0f * m_knee, 0.25f * m_knee));
+            m_downscale_single_pass_shader->setUniform("u_texel_size",       1.0f / glm::vec2(mip_size));
+            m_downscale_single_pass_shader->setUniform("u_mips_count",       int(first_level));
+            m_downscale_single_pass_shader->setUniform("u_workgroups_count", workgroups.x * workgroups.y);
+            m_tmo_ps->bindTexture();
+
+            for (uint8_t i = 0; i < first_level; ++i)
+            {
+                m_tmo_ps->m_rt->BindColorImage(IMAGE_UNIT_WRITE + i, i + 1, GL_READ_WRITE);
+            }
+
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_bloom_counter_buffer);
+
+            glDispatchCompute(workgroups.x, workgroups.y, 1);
+
+            mip_size = glm::max(mip_size >> uint32_t(first_level), 1u);
+
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+
         m_downscale_shader->bind();
         m_downscale_shader->setUniform("u_threshold", glm::vec4(m_threshold, m_threshold - m_knee, 2.0f * m_knee, 0.25f * m_knee));
-        m_tmo_ps->rt->bindTexture();
-
-        glm::uvec2 mip_size = glm::uvec2(m_tmo_ps->rt->m_width / 2, m_tmo_ps->rt->m_height / 2);
+        m_tmo_ps->bindTexture();
 
-        for (uint8_t i = 0; i < m_tmo_ps->rt->m_mip_levels - 1; ++i)
+        for (uint8_t i = first_level; i < m_tmo_ps->m_rt->GetLevelsCount() - 1; ++i)
         {
             m_downscale_shader->setUniform("u_texel_size",    1.0f / glm::vec2(mip_size));
             m_downscale_shader->setUniform("u_mip_level",     i);
             m_downscale_shader->setUniform("u_use_threshold", i == 0);
 
-            m_tmo_ps->rt->bindImageForWrite(IMAGE_UNIT_WRITE, i + 1);
+            m_tmo_ps->m_rt->BindColorImage(IMAGE_UNIT_WRITE, i + 1, GL_WRITE_ONLY);
 
             glDispatchCompute(glm::ceil(float(mip_size.x) / 8), glm::ceil(float(mip_size.y) / 8), 1);
 
@@ -598,30 +428,37 @@ void Bloom::render()
 
             glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
         }
+        RGL::Profiler::EndScope();
 
         /* Bloom: upscale */
+        RGL::Profiler::BeginScope("Upscale");
         m_upscale_shader->bind();
         m_upscale_shader->setUniform("u_bloom_intensity", m_bloom_intensity);
         m_upscale_shader->setUniform("u_dirt_intensity",  m_bloom_dirt_intensity);
-        m_tmo_ps->rt->bindTexture();
+        m_tmo_ps->bindTexture();
         m_bloom_dirt_texture->Bind(1);
 
-        for (uint8_t i = m_tmo_ps->rt->m_mip_levels - 1; i >= 1; --i)
+        for (uint8_t i = m_tmo_ps->m_rt->GetLevelsCount() - 1; i >= 1; --i)
         {
-            mip_size.x = glm::max(1.0, glm::floor(float(m_tmo_ps->rt->m_width)  / glm::pow(2.0, i - 1)));
-            mip_size.y = glm::max(1.0, glm::floor(float(m_tmo_ps->rt->m_height) / glm::pow(2.0, i - 1)));
+            mip_size.x = glm::max(1.0, glm::floor(float(m_tmo_ps->m_rt->GetWidth())  / glm::pow(2.0, i - 1)));
+            mip_size.y = glm::max(1.0, glm::floor(float(m_tmo_ps->m_rt->GetHeight()) / glm::pow(2.0, i - 1)));
 
             m_upscale_shader->setUniform("u_texel_size", 1.0f / glm::vec2(mip_size));
             m_upscale_shader->setUniform("u_mip_level",  i);
 
-            m_tmo_ps->rt->bindImageForReadWrite(IMAGE_UNIT_WRITE, i - 1);
+            m_tmo_ps->m_rt->BindColorImage(IMAGE_UNIT_WRITE, i - 1, GL_READ_WRITE);
 
             glDispatchCompute(glm::ceil(float(mip_size.x) / 8), glm::ceil(float(mip_size.y) / 8), 1);
 
             glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
         }
+        RGL::Profiler::EndScope();
+    }
+
+    {
+        RGL::ProfilerScope scope("Tone mapping");
+        m_tmo_ps->render(m_exposure, m_gamma);
     }
-    m_tmo_ps->render(m_exposure, m_gamma);
 }
 
 void Bloom::render_gui()
@@ -658,7 +495,7 @@ void Bloom::render_gui()
         ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
         ImGui::SliderFloat("Exposure",             &m_exposure,             0.0, 10.0, "%.1f");
         ImGui::SliderFloat("Gamma",                &m_gamma,                0.0, 10.0, "%.1f");
-        ImGui::SliderFloat("Background LOD level", &m_background_lod_level, 0.0, glm::log2(float(m_env_cubemap_rt->m_width)), "%.1f");
+        ImGui::SliderFloat("Background blur",      &m_background_blur,      0.0, 1.0, "%.2f");
 
         if (ImGui::BeginCombo("HDR map", m_hdr_maps_names[m_current_hdr_map_idx].c_str()))
         {
@@ -668,7 +505,7 @@ void Bloom::render_gui()
                 if (ImGui::Selectable(m_hdr_maps_names[i].c_str(), is_selected))
                 {
                     m_current_hdr_map_idx = i;
-                    PrecomputeIndirectLight(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx]);
+                    m_ibl.Load(RGL::FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx], RGL::ImageBasedLighting::PrefilterMode::FAST);
                 }
 
                 if (is_selected)
@@ -682,6 +519,7 @@ void Bloom::render_gui()
         ImGui::Spacing();
 
         ImGui::Checkbox   ("Bloom enabled",        &m_bloom_enabled);
+        ImGui::Checkbox   ("Single pass downscale", &m_bloom_single_pass);
         ImGui::SliderFloat("Bloom threshold",      &m_threshold,            0.0f, 15.0f, "%.1f");
         ImGui::SliderFloat("Bloom knee",           &m_knee,                 0.0f, 1.0f,  "%.1f");
         ImGui::SliderFloat("Bloom intensity",      &m_bloom_intensity,      0.0f, 5.0f,  "%.1f");
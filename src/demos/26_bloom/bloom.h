@@ -2,8 +2,13 @@
 #include "core_app.h"
 
 #include "camera.h"
+#include "gl_state.h"
+#include "image_based_lighting.h"
+#include "render_target_pool.h"
 #include "static_model.h"
 #include "shader.h"
+#include "skybox.h"
+#include "window.h"
 
 #include <memory>
 #include <vector>
@@ -67,133 +72,27 @@ public:
     void render_gui()              override;
 
 private:
-    struct Texture2DRenderTarget
+    struct PostprocessFilter
     {
-        GLuint m_texture_id = 0;
-        GLuint m_fbo_id = 0;
-        GLuint m_rbo_id = 0;
-        GLuint m_width = 0, m_height = 0;
-        GLenum m_internalformat;
-
-        const uint8_t m_downscale_limit = 10;
-        const uint8_t m_max_iterations = 16; // max mipmap levels
-        uint8_t m_mip_levels = 1;
-
-        ~Texture2DRenderTarget() { cleanup(); }
-
-        void bindTexture(GLuint unit = 0)
-        {
-            glBindTextureUnit(unit, m_texture_id);
-        }
-
-        void bindRenderTarget()
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_id);
-            glViewport(0, 0, m_width, m_height);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        }
-
-        void bindImageForRead(GLuint image_unit, GLuint mip_level)
-        {
-            glBindImageTexture(image_unit, m_texture_id, mip_level, GL_FALSE, 0, GL_READ_ONLY, m_internalformat);
-        }
-
-        void bindImageForWrite(GLuint image_unit, GLuint mip_level)
-        {
-            glBindImageTexture(image_unit, m_texture_id, mip_level, GL_FALSE, 0, GL_WRITE_ONLY, m_internalformat);
-        }
-
-        void bindImageForReadWrite(GLuint image_unit, GLuint mip_level)
-        {
-            glBindImageTexture(image_unit, m_texture_id, mip_level, GL_FALSE, 0, GL_READ_WRITE, m_internalformat);
-        }
-
-        void cleanup()
-        {
-            if (m_texture_id != 0)
-            {
-                glDeleteTextures(1, &m_texture_id);
-            }
-
-            if (m_fbo_id != 0)
-            {
-                glDeleteFramebuffers(1, &m_fbo_id);
-            }
-
-            if (m_rbo_id != 0)
-            {
-                glDeleteRenderbuffers(1, &m_rbo_id);
-            }
-        }
-
-        void create(uint32_t width, uint32_t height, GLint internalformat)
-        {
-            m_width          = width;
-            m_height         = height;
-            m_internalformat = internalformat;
-
-            m_mip_levels = calculateMipmapLevels();
-
-            glCreateFramebuffers(1, &m_fbo_id);
-
-            glCreateTextures(GL_TEXTURE_2D, 1, &m_texture_id);
-            glTextureStorage2D(m_texture_id, m_mip_levels, internalformat, width, height); // internalformat = GL_RGB32F
-
-            glTextureParameteri(m_texture_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTextureParameteri(m_texture_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTextureParameteri(m_texture_id, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
-            glTextureParameteri(m_texture_id, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
-
-            glCreateRenderbuffers(1, &m_rbo_id);
-            glNamedRenderbufferStorage(m_rbo_id, GL_DEPTH24_STENCIL8, width, height);
-
-            glNamedFramebufferTexture(m_fbo_id, GL_COLOR_ATTACHMENT0, m_texture_id, 0);
-            glNamedFramebufferRenderbuffer(m_fbo_id, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_rbo_id);
-        }
-
-        uint8_t calculateMipmapLevels()
-        {
-            uint32_t width      = m_width  / 2;
-            uint32_t height     = m_height / 2;
-            uint8_t  mip_levels = 1;
-
-            printf("Mip level %d: %d x %d\n", 0, m_width, m_height);
-            printf("Mip level %d: %d x %d\n", mip_levels, width, height);
-
-            for (uint8_t i = 0; i < m_max_iterations; ++i)
-            {
-                width  = width  / 2;
-                height = height / 2;
-
-                if (width < m_downscale_limit || height < m_downscale_limit) break;
-
-                ++mip_levels;
+        static constexpr uint32_t DOWNSCALE_LIMIT = 10;
+        static constexpr uint32_t MAX_ITERATIONS  = 16; // max mipmap levels
 
-                printf("Mip level %d: %d x %d\n", mip_levels, width, height);
-            }
+        /* See downscale_single_pass.comp, a workgroup per tile of mip 1 and an image unit per mip. */
+        static constexpr uint32_t SINGLE_PASS_MIPS      = 8;
+        static constexpr uint32_t SINGLE_PASS_TILE_SIZE = 64;
 
-            return mip_levels + 1;
-        }
-    };
-
-    struct PostprocessFilter
-    {
         std::shared_ptr<RGL::Shader> m_shader;
-        std::shared_ptr<Texture2DRenderTarget> rt;
+
+        /* The HDR target of the frame with the bloom mip chain, from acquire() until render(). */
+        std::shared_ptr<RGL::RenderTarget> m_rt;
 
         GLuint m_dummy_vao_id;
 
-        PostprocessFilter(uint32_t width, uint32_t height)
+        PostprocessFilter()
         {
             m_shader = std::make_shared<RGL::Shader>("src/demos/10_postprocessing_filters/FSQ.vert", "src/demos/22_pbr/tmo.frag");
             m_shader->link();
 
-            rt = std::make_shared<Texture2DRenderTarget>();
-            rt->create(width, height, GL_RGBA32F);
-            glTextureParameteri(rt->m_texture_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
-            glTextureParameteri(rt->m_texture_id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTextureParameteri(rt->m_texture_id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
             glCreateVertexArrays(1, &m_dummy_vao_id);
         }
 
@@ -205,19 +104,34 @@ private:
             }
         }
 
+        /* The same target every frame, a resize makes the pool create one of the new size. The HDR color in mip 0, the bloom's chain below. */
+        void acquire()
+        {
+            const uint32_t width  = RGL::Window::getWidth();
+            const uint32_t height = RGL::Window::getHeight();
+            const GLenum   format = RGL::RenderTargetPool::GetColorFormat(RGL::RenderTargetUsage::BLOOM);
+
+            m_rt = RGL::RenderTargetPool::Acquire({ width, height, format, GL_DEPTH24_STENCIL8, calculateMipmapLevels(width, height) });
+        }
+
         void bindTexture(GLuint unit = 0)
         {
-            rt->bindTexture(unit);
+            m_rt->BindColor(unit);
         }
 
         void bindFilterFBO()
         {
-            rt->bindRenderTarget();
+            if (!m_rt)
+            {
+                acquire();
+            }
+
+            m_rt->Bind();
         }
 
         void render(float exposure, float gamma)
         {
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            RGL::GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
             m_shader->bind();
@@ -227,114 +141,39 @@ private:
 
             glBindVertexArray(m_dummy_vao_id);
             glDrawArrays(GL_TRIANGLES, 0, 3);
-        }
-    };
 
-    struct CubeMapRenderTarget
-    {
-        glm::mat4 m_view_transforms[6];
-        glm::mat4 m_projection;
-
-        GLuint    m_cubemap_texture_id = 0;
-        GLuint    m_fbo_id             = 0;
-        GLuint    m_rbo_id             = 0;
-        glm::vec3 m_position           = glm::vec3(0.0f);
-        GLuint m_width, m_height;
-
-        ~CubeMapRenderTarget() { cleanup(); }
-
-        void set_position(const glm::vec3 pos)
-        {
-            m_position = pos;
-            m_view_transforms[0] = glm::lookAt(pos, pos + glm::vec3( 1,  0,  0), glm::vec3(0, -1,  0));
-            m_view_transforms[1] = glm::lookAt(pos, pos + glm::vec3(-1,  0,  0), glm::vec3(0, -1,  0));
-            m_view_transforms[2] = glm::lookAt(pos, pos + glm::vec3( 0,  1,  0), glm::vec3(0,  0,  1));
-            m_view_transforms[3] = glm::lookAt(pos, pos + glm::vec3( 0, -1,  0), glm::vec3(0,  0, -1));
-            m_view_transforms[4] = glm::lookAt(pos, pos + glm::vec3( 0,  0,  1), glm::vec3(0, -1,  0));
-            m_view_transforms[5] = glm::lookAt(pos, pos + glm::vec3( 0,  0, -1), glm::vec3(0, -1,  0));
-
-            m_projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+            /* Back to the pool, free for the other passes until the next frame. */
+            m_rt.reset();
         }
 
-        void bindTexture(GLuint unit = 0)
+        /* The bloom stops at the mip smaller than DOWNSCALE_LIMIT. */
+        static uint32_t calculateMipmapLevels(uint32_t width, uint32_t height)
         {
-            glBindTextureUnit(unit, m_cubemap_texture_id);
-        }
-
-        void cleanup()
-        {
-            if (m_cubemap_texture_id != 0)
-            {
-                glDeleteTextures(1, &m_cubemap_texture_id);
-            }
+            uint32_t mip_levels = 1;
 
-            if (m_fbo_id != 0)
-            {
-                glDeleteFramebuffers(1, &m_fbo_id);
-            }
+            width  = width  / 2;
+            height = height / 2;
 
-            if (m_rbo_id != 0)
+            for (uint32_t i = 0; i < MAX_ITERATIONS; ++i)
             {
-                glDeleteRenderbuffers(1, &m_rbo_id);
-            }
-        }
-
-        void generate_rt(uint32_t width, uint32_t height, bool gen_mip_levels = false)
-        {
-            m_width  = width;
-            m_height = height;
+                width  = width  / 2;
+                height = height / 2;
 
-            glGenTextures(1, &m_cubemap_texture_id);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubemap_texture_id);
+                if (width < DOWNSCALE_LIMIT || height < DOWNSCALE_LIMIT) break;
 
-            for (uint8_t i = 0; i < 6; ++i)
-            {
-                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, m_width, m_height, 0, GL_RGB, GL_FLOAT, 0);
+                ++mip_levels;
             }
 
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, gen_mip_levels ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
-
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-            if (gen_mip_levels) glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-
-            glGenFramebuffers(1, &m_fbo_id);
-            glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_id);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, m_cubemap_texture_id, 0);
-
-            glGenRenderbuffers(1, &m_rbo_id);
-            glBindRenderbuffer(GL_RENDERBUFFER, m_rbo_id);
-            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_width, m_height);
-            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_rbo_id);
-
-            glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-            glBindRenderbuffer(GL_RENDERBUFFER, 0);
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            return mip_levels + 1;
         }
-    }; 
+    };
 
-    void HdrEquirectangularToCubemap(const std::shared_ptr<CubeMapRenderTarget> & cubemap_rt, const std::shared_ptr<RGL::Texture2D> & m_equirectangular_map);
-    void IrradianceConvolution      (const std::shared_ptr<CubeMapRenderTarget> & cubemap_rt);
-    void PrefilterCubemap           (const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt);
-    void PrecomputeIndirectLight    (const std::filesystem::path & hdri_map_filepath);
-    void PrecomputeBRDF             (const std::shared_ptr<Texture2DRenderTarget>& rt);
-    void GenSkyboxGeometry();
 
     void RenderScene();
 
-    std::shared_ptr<CubeMapRenderTarget> m_env_cubemap_rt;
-    std::shared_ptr<CubeMapRenderTarget> m_irradiance_cubemap_rt;
-    std::shared_ptr<CubeMapRenderTarget> m_prefiltered_env_map_rt;
-    std::shared_ptr<Texture2DRenderTarget> m_brdf_lut_rt;
+    RGL::ImageBasedLighting m_ibl;
 
-    std::shared_ptr<RGL::Shader> m_equirectangular_to_cubemap_shader;
-    std::shared_ptr<RGL::Shader> m_irradiance_convolution_shader;
-    std::shared_ptr<RGL::Shader> m_prefilter_env_map_shader;
-    std::shared_ptr<RGL::Shader> m_precompute_brdf;
-    std::shared_ptr<RGL::Shader> m_background_shader;
+    RGL::Skybox m_skybox;
 
     std::shared_ptr<RGL::Camera> m_camera;
     std::shared_ptr<RGL::Shader> m_ambient_light_shader;
@@ -343,6 +182,7 @@ private:
     /* Bloom members */
     std::shared_ptr<RGL::Shader> m_downscale_shader;
     std::shared_ptr<RGL::Shader> m_upscale_shader;
+    std::shared_ptr<RGL::Shader> m_downscale_single_pass_shader;
     std::shared_ptr<RGL::Texture2D> m_bloom_dirt_texture;
 
     float m_threshold;
@@ -350,6 +190,9 @@ private:
     float m_bloom_intensity;
     float m_bloom_dirt_intensity;
     bool  m_bloom_enabled;
+    bool  m_bloom_single_pass;
+
+    GLuint m_bloom_counter_buffer; /* The workgroups of the single pass downscale that are done. */
     /* End bloom members */
 
     std::vector<StaticObject> m_static_objects;
@@ -361,9 +204,7 @@ private:
     float m_exposure; 
     float m_gamma;
 
-    float m_background_lod_level;
+    float m_background_blur; /* The roughness of the prefiltered level of the background, 0 - the environment map. */
     std::string m_hdr_maps_names[3] = { "colorful_studio_4k.hdr", "phalzer_forest_01_4k.hdr", "sunset_fairway_4k.hdr" };
     uint8_t m_current_hdr_map_idx   = 2;
-
-    GLuint m_skybox_vao, m_skybox_vbo;
 };
\ No newline at end of file
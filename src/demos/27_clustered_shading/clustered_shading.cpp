@@ -7,6 +7,12 @@
 #include <glm/gtc/matrix_inverse.hpp>
 #include <glm/gtc/random.hpp>
 
+#include <bit>
+#include <cfloat>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+
 #define IMAGE_UNIT_WRITE 0
 
 using namespace RGL;
@@ -14,38 +20,38 @@ using namespace RGL;
 ClusteredShading::ClusteredShading()
       : m_exposure            (0.4f),
         m_gamma               (2.2f),
-        m_background_lod_level(1.2),
-        m_skybox_vao          (0),
-        m_skybox_vbo          (0),
+        m_background_blur     (0.1f),
         m_threshold           (1.5),
         m_knee                (0.1),
         m_bloom_intensity     (1.0),
         m_bloom_dirt_intensity(1.0),
-        m_bloom_enabled       (true)
+        m_bloom_enabled       (true),
+        m_bloom_single_pass   (true),
+        m_bloom_counter_buffer(0)
 {
 }
 
 ClusteredShading::~ClusteredShading()
 {
-    if (m_skybox_vao != 0)
-    {
-        glDeleteVertexArrays(1, &m_skybox_vao);
-        m_skybox_vao = 0;
-    }
+    /* The worker may still write to the mapped slot. */
+    FinishDynamicLights();
+
+    glDeleteBuffers(1, &m_dynamic_lights_buffer);
 
-    if (m_skybox_vbo != 0)
+    for (GLsync fence : m_dynamic_lights_fences)
     {
-        glDeleteBuffers(1, &m_skybox_vbo);
-        m_skybox_vbo = 0;
+        if (fence)
+        {
+            glDeleteSync(fence);
+        }
     }
 
-    glDeleteBuffers(1, &m_clusters_ssbo);
+
     glDeleteBuffers(1, &m_cull_lights_dispatch_args_ssbo);
     glDeleteBuffers(1, &m_directional_lights_ssbo);
     glDeleteBuffers(1, &m_point_lights_ssbo);
     glDeleteBuffers(1, &m_spot_lights_ssbo);
-    glDeleteBuffers(1, &m_point_lights_ellipses_radii_ssbo);
-    glDeleteBuffers(1, &m_spot_lights_ellipses_radii_ssbo);
+    glDeleteBuffers(1, &m_bloom_counter_buffer);
     glDeleteBuffers(1, &m_clusters_flags_ssbo);
     glDeleteBuffers(1, &m_point_light_index_list_ssbo);
     glDeleteBuffers(1, &m_point_light_grid_ssbo);
@@ -54,9 +60,38 @@ ClusteredShading::~ClusteredShading()
     glDeleteBuffers(1, &m_area_light_index_list_ssbo);
     glDeleteBuffers(1, &m_area_light_grid_ssbo);
     glDeleteBuffers(1, &m_unique_active_clusters_ssbo);
+    glDeleteBuffers(1, &m_light_spheres_ssbo);
+    glDeleteBuffers(2, m_light_keys_ssbos);
+    glDeleteBuffers(2, m_light_indices_ssbos);
+    glDeleteBuffers(1, &m_radix_sort_histogram_ssbo);
+    glDeleteBuffers(1, &m_light_bvh_nodes_ssbo);
+    glDeleteBuffers(1, &m_sorted_light_spheres_ssbo);
+    glDeleteBuffers(1, &m_light_lists_feedback_ssbo);
+    glDeleteBuffers(1, &m_light_lists_readback_buffer);
+
+    for (GLsync fence : m_light_lists_fences)
+    {
+        if (fence)
+        {
+            glDeleteSync(fence);
+        }
+    }
+
+    glDeleteBuffers(1, &m_transparent_bounds_ssbo);
+    glDeleteBuffers(1, &m_point_light_shadows_ssbo);
+    glDeleteBuffers(1, &m_spot_light_shadows_ssbo);
+    glDeleteBuffers(1, &m_light_shadows_ssbo);
+    glDeleteBuffers(1, &m_zbins_ssbo);
+    glDeleteBuffers(1, &m_tile_light_masks_ssbo);
+
+    glDeleteTextures(1, &m_fog_noise_tex3D_id);
+    glDeleteTextures(1, &m_fog_froxels_tex3D_id);
+    glDeleteTextures(1, &m_fog_integrated_tex3D_id);
 
     glDeleteTextures(1, &m_depth_tex2D_id);
     glDeleteFramebuffers(1, &m_depth_pass_fbo_id);
+    glDeleteTextures(1, &m_visibility_tex2D_id);
+    glDeleteFramebuffers(1, &m_visibility_fbo_id);
 }
 
 void ClusteredShading::init_app()
@@ -71,28 +106,18 @@ void ClusteredShading::init_app()
 
     /* Create virtual camera. */
     m_camera = std::make_shared<Camera>(60.0, Window::getAspectRatio(), 0.01, 300.0);
+    set_benchmark_camera(m_camera);
     m_camera->setPosition(-8.32222, 1.9269, -0.768721);
     m_camera->setOrientation(glm::quat(0.634325, 0.0407623, 0.772209, 0.0543523));
    
-    /// Init clustered shading variables.
-    float z_near       = m_camera->NearPlane();
-    float z_far        = m_camera->FarPlane();
-    float half_fov     = glm::radians(m_camera->FOV() * 0.5f);
-
-    m_cluster_grid_dim.x = uint32_t(glm::ceil(RGL::Window::getWidth()  / float(m_cluster_grid_block_size)));
-    m_cluster_grid_dim.y = uint32_t(glm::ceil(RGL::Window::getHeight() / float(m_cluster_grid_block_size)));
-
-    // The depth of the cluster grid during clustered rendering is dependent on the 
-    // number of clusters subdivisions in the screen Y direction.
-    // Source: Clustered Deferred and Forward Shading (2012) (Ola Olsson, Markus Billeter, Ulf Assarsson).
-    float sD         = 2.0f * glm::tan(half_fov) / float(m_cluster_grid_dim.y);
-          m_near_k   = 1.0f + sD;
-    m_log_grid_dim_y = 1.0f / glm::log(m_near_k);
-
-    float log_depth      = glm::log(z_far / z_near);
-    m_cluster_grid_dim.z = uint32_t(glm::floor(log_depth * m_log_grid_dim_y));
+    /// Init clustered shading variables, the clusters are generated at the end, when the shaders are ready.
+    ClusterGrid& main_grid = GetClusterGrid(0);
+    main_grid.resize(*m_camera, glm::uvec2(Window::getWidth(), Window::getHeight()), m_cluster_grid_block_size);
 
-    m_clusters_count = m_cluster_grid_dim.x * m_cluster_grid_dim.y * m_cluster_grid_dim.z;
+    m_cluster_grid_dim = main_grid.m_dim;
+    m_near_k           = main_grid.m_near_k;
+    m_log_grid_dim_y   = main_grid.m_log_grid_dim_y;
+    m_clusters_count   = main_grid.m_clusters_count;
 
     /// Randomly initialize lights
     srand(3281991);
@@ -102,6 +127,7 @@ void ClusteredShading::init_app()
 
     /// Create Sponza static object
     auto sponza_model = std::make_shared<StaticModel>();
+    sponza_model->SetVertexFormat(StaticModel::VertexFormat::INTERLEAVED); // The visibility buffer resolve fetches its vertices.
     sponza_model->Load(RGL::FileSystem::getResourcesPath() / "models/sponza/Sponza.gltf");
 
     glm::mat4 world_trans  = glm::mat4(1.0f);
@@ -121,79 +147,121 @@ void ClusteredShading::init_app()
     glNamedBufferData(m_spot_lights_ssbo, sizeof(SpotLight) * m_spot_lights.size(), m_spot_lights.data(), GL_DYNAMIC_DRAW);
     glBindBufferBase (GL_SHADER_STORAGE_BUFFER, SPOT_LIGHTS_SSBO_BINDING_INDEX, m_spot_lights_ssbo);
 
-    glCreateBuffers  (1, &m_point_lights_ellipses_radii_ssbo);
-    glNamedBufferData(m_point_lights_ellipses_radii_ssbo, sizeof(m_point_lights_ellipses_radii[0]) * m_point_lights_ellipses_radii.size(), m_point_lights_ellipses_radii.data(), GL_DYNAMIC_DRAW);
-    glBindBufferBase (GL_SHADER_STORAGE_BUFFER, POINT_LIGHTS_ELLIPSES_RADII_SSBO_BINDING_INDEX, m_point_lights_ellipses_radii_ssbo);
-
-    glCreateBuffers  (1, &m_spot_lights_ellipses_radii_ssbo);
-    glNamedBufferData(m_spot_lights_ellipses_radii_ssbo, sizeof(m_spot_lights_ellipses_radii[0]) * m_spot_lights_ellipses_radii.size(), m_spot_lights_ellipses_radii.data(), GL_DYNAMIC_DRAW);
-    glBindBufferBase (GL_SHADER_STORAGE_BUFFER, SPOT_LIGHTS_ELLIPSES_RADII_SSBO_BINDING_INDEX, m_spot_lights_ellipses_radii_ssbo);
-
     glCreateBuffers  (1, &m_area_lights_ssbo);
     glNamedBufferData(m_area_lights_ssbo, sizeof(AreaLight) * m_area_lights.size(), m_area_lights.data(), GL_DYNAMIC_DRAW);
     glBindBufferBase (GL_SHADER_STORAGE_BUFFER, AREA_LIGHTS_SSBO_BINDING_INDEX, m_area_lights_ssbo);
 
-    /// Prepare SSBOs related to the clustering (light-culling) algorithm.
-    // Stores the screen-space clusters 
-    glCreateBuffers  (1, &m_clusters_ssbo);
-    glNamedBufferData(m_clusters_ssbo, sizeof(ClusterAABB) * m_clusters_count, nullptr, GL_STATIC_READ);
-    glBindBufferBase (GL_SHADER_STORAGE_BUFFER, CLUSTERS_SSBO_BINDING_INDEX, m_clusters_ssbo);
+    // The animated lights' slots, the static ones stay as uploaded above
+    ResizeDynamicLightsBuffer();
+
+    // The shadowed lights: the shadows of the slots, a slot per point and spot light and the atlas of their maps
+    m_shadow_atlas = std::make_unique<ShadowAtlas>();
+
+    glCreateBuffers  (1, &m_light_shadows_ssbo);
+    glNamedBufferData(m_light_shadows_ssbo, sizeof(LightShadow) * MAX_SHADOWED_LIGHTS, nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase (GL_SHADER_STORAGE_BUFFER, LIGHT_SHADOWS_SSBO_BINDING_INDEX, m_light_shadows_ssbo);
+
+    glCreateBuffers (1, &m_point_light_shadows_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POINT_LIGHT_SHADOWS_SSBO_BINDING_INDEX, m_point_light_shadows_ssbo);
+
+    glCreateBuffers (1, &m_spot_light_shadows_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SPOT_LIGHT_SHADOWS_SSBO_BINDING_INDEX, m_spot_light_shadows_ssbo);
+
+    ResetLightShadows();
+
+    /// Prepare SSBOs related to the clustering (light-culling) algorithm, the ones sized for the clusters by ResizeClusterBuffers().
+    // The screen-space clusters are the main view's grid
+    main_grid.bind();
 
     // Create a buffer to hold (boolean) flags in the cluster grid that contain samples.
-    glCreateBuffers  (1, &m_clusters_flags_ssbo);
-    glNamedBufferData(m_clusters_flags_ssbo, sizeof(uint32_t) * m_clusters_count, nullptr, GL_STATIC_READ);
-    glBindBufferBase (GL_SHADER_STORAGE_BUFFER, CLUSTERS_FLAGS_SSBO_BINDING_INDEX, m_clusters_flags_ssbo);
+    glCreateBuffers (1, &m_clusters_flags_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTERS_FLAGS_SSBO_BINDING_INDEX, m_clusters_flags_ssbo);
 
     // A buffer (and internal counter) that holds a list of the unique clusters (the clusters that are visible and actually contain a sample).
-    glCreateBuffers  (1, &m_unique_active_clusters_ssbo);
-    glNamedBufferData(m_unique_active_clusters_ssbo, sizeof(uint32_t) * m_clusters_count + sizeof(uint32_t), nullptr, GL_STATIC_READ);
-    glBindBufferBase (GL_SHADER_STORAGE_BUFFER, UNIQUE_ACTIVE_CLUSTERS_SSBO_BINDING_INDEX, m_unique_active_clusters_ssbo);
+    glCreateBuffers (1, &m_unique_active_clusters_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, UNIQUE_ACTIVE_CLUSTERS_SSBO_BINDING_INDEX, m_unique_active_clusters_ssbo);
+
+    // The boxes of the geometry that is not in the depth pre-pass, uploaded every frame
+    glCreateBuffers (1, &m_transparent_bounds_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TRANSPARENT_BOUNDS_SSBO_BINDING_INDEX, m_transparent_bounds_ssbo);
 
     // A buffer that stores number of work groups to be dispatched by cull lights shader
     glCreateBuffers  (1, &m_cull_lights_dispatch_args_ssbo);
     glNamedBufferData(m_cull_lights_dispatch_args_ssbo, sizeof(uint32_t) * 3, nullptr, GL_STATIC_DRAW);
     glBindBufferBase (GL_SHADER_STORAGE_BUFFER, CULL_LIGHTS_DISPATCH_ARGS_SSBO_BINDING_INDEX, m_cull_lights_dispatch_args_ssbo);
 
-    // A list of indices to the lights that are active and intersect with a cluster
-    glCreateBuffers  (1, &m_point_light_index_list_ssbo);
-    glNamedBufferData(m_point_light_index_list_ssbo, sizeof(uint32_t) * m_clusters_count * AVERAGE_OVERLAPPING_LIGHTS_PER_CLUSTER, nullptr, GL_DYNAMIC_DRAW);
-    glBindBufferBase (GL_SHADER_STORAGE_BUFFER, POINT_LIGHT_INDEX_LIST_SSBO_BINDING_INDEX, m_point_light_index_list_ssbo);
+    // A list of indices to the lights that are active and intersect with a cluster, ResizeLightIndexLists() sizes them
+    glCreateBuffers (1, &m_point_light_index_list_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POINT_LIGHT_INDEX_LIST_SSBO_BINDING_INDEX, m_point_light_index_list_ssbo);
+
+    glCreateBuffers (1, &m_spot_light_index_list_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SPOT_LIGHT_INDEX_LIST_SSBO_BINDING_INDEX, m_spot_light_index_list_ssbo);
+
+    glCreateBuffers (1, &m_area_light_index_list_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, AREA_LIGHT_INDEX_LIST_SSBO_BINDING_INDEX, m_area_light_index_list_ssbo);
+
+    const uint32_t initial_counts[3] = { uint32_t(m_clusters_count * AVERAGE_OVERLAPPING_LIGHTS_PER_CLUSTER),
+                                         uint32_t(m_clusters_count * AVERAGE_OVERLAPPING_LIGHTS_PER_CLUSTER),
+                                         uint32_t(m_clusters_count * AVERAGE_OVERLAPPING_AREA_LIGHTS_PER_CLUSTER) };
+    ResizeLightIndexLists(initial_counts);
+    m_light_index_lists_resizes = 0;
 
-    glCreateBuffers  (1, &m_spot_light_index_list_ssbo);
-    glNamedBufferData(m_spot_light_index_list_ssbo, sizeof(uint32_t) * m_clusters_count * AVERAGE_OVERLAPPING_LIGHTS_PER_CLUSTER, nullptr, GL_DYNAMIC_DRAW);
-    glBindBufferBase (GL_SHADER_STORAGE_BUFFER, SPOT_LIGHT_INDEX_LIST_SSBO_BINDING_INDEX, m_spot_light_index_list_ssbo);
+    // What the culling needed, and its copies for the CPU, one per frame in flight
+    glCreateBuffers  (1, &m_light_lists_feedback_ssbo);
+    glNamedBufferData(m_light_lists_feedback_ssbo, sizeof(LightListsFeedback), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase (GL_SHADER_STORAGE_BUFFER, LIGHT_LISTS_FEEDBACK_SSBO_BINDING_INDEX, m_light_lists_feedback_ssbo);
 
-    glCreateBuffers  (1, &m_area_light_index_list_ssbo);
-    glNamedBufferData(m_area_light_index_list_ssbo, sizeof(uint32_t) * m_clusters_count * AVERAGE_OVERLAPPING_LIGHTS_PER_CLUSTER, nullptr, GL_DYNAMIC_DRAW);
-    glBindBufferBase (GL_SHADER_STORAGE_BUFFER, AREA_LIGHT_INDEX_LIST_SSBO_BINDING_INDEX, m_area_light_index_list_ssbo);
+    const GLbitfield readback_flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glCreateBuffers     (1, &m_light_lists_readback_buffer);
+    glNamedBufferStorage(m_light_lists_readback_buffer, sizeof(LightListsFeedback) * FEEDBACK_FRAMES, nullptr, readback_flags);
+
+    m_light_lists_readback_data = static_cast<LightListsFeedback*>(glMapNamedBufferRange(m_light_lists_readback_buffer, 0, sizeof(LightListsFeedback) * FEEDBACK_FRAMES, readback_flags));
 
     // Every tile takes LightGrid struct that has two unsigned ints one to represent the number of lights in that grid
     // Another to represent the offset to the light index list from where to begin reading light indexes from
     // In this SSBO, atomic counter is also being stored (uint global_index_count)
     // This implementation is straight up from Olsson paper
-    glCreateBuffers  (1, &m_point_light_grid_ssbo);
-    glNamedBufferData(m_point_light_grid_ssbo, sizeof(uint32_t) + sizeof(LightGrid) * m_clusters_count, nullptr, GL_DYNAMIC_DRAW);
-    glBindBufferBase (GL_SHADER_STORAGE_BUFFER, POINT_LIGHT_GRID_SSBO_BINDING_INDEX, m_point_light_grid_ssbo);
+    glCreateBuffers (1, &m_point_light_grid_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POINT_LIGHT_GRID_SSBO_BINDING_INDEX, m_point_light_grid_ssbo);
 
-    glCreateBuffers  (1, &m_spot_light_grid_ssbo);
-    glNamedBufferData(m_spot_light_grid_ssbo, sizeof(uint32_t) + sizeof(LightGrid) * m_clusters_count, nullptr, GL_DYNAMIC_DRAW);
-    glBindBufferBase (GL_SHADER_STORAGE_BUFFER, SPOT_LIGHT_GRID_SSBO_BINDING_INDEX, m_spot_light_grid_ssbo);
+    glCreateBuffers (1, &m_spot_light_grid_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SPOT_LIGHT_GRID_SSBO_BINDING_INDEX, m_spot_light_grid_ssbo);
 
-    glCreateBuffers(1, &m_area_light_grid_ssbo);
-    glNamedBufferData(m_area_light_grid_ssbo, sizeof(uint32_t) + sizeof(LightGrid) * m_clusters_count, nullptr, GL_DYNAMIC_DRAW);
+    glCreateBuffers (1, &m_area_light_grid_ssbo);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, AREA_LIGHT_GRID_SSBO_BINDING_INDEX, m_area_light_grid_ssbo);
 
-    // Create depth pre-pass texture and FBO
-    glCreateTextures  (GL_TEXTURE_2D, 1, &m_depth_tex2D_id);
-    glTextureStorage2D(m_depth_tex2D_id, 1, GL_DEPTH_COMPONENT32F, RGL::Window::getWidth(), RGL::Window::getHeight());
-
-    glTextureParameteri(m_depth_tex2D_id, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTextureParameteri(m_depth_tex2D_id, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTextureParameteri(m_depth_tex2D_id, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
-    glTextureParameteri(m_depth_tex2D_id, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
-
-    glCreateFramebuffers     (1, &m_depth_pass_fbo_id);
-    glNamedFramebufferTexture(m_depth_pass_fbo_id, GL_DEPTH_ATTACHMENT, m_depth_tex2D_id, 0);
+    // The light BVH buffers, sized for the lights by ResizeLightBvhBuffers()
+    glCreateBuffers(1, &m_light_spheres_ssbo);
+    glCreateBuffers(2, m_light_keys_ssbos);
+    glCreateBuffers(2, m_light_indices_ssbos);
+    glCreateBuffers(1, &m_radix_sort_histogram_ssbo);
+    glCreateBuffers(1, &m_light_bvh_nodes_ssbo);
+    glCreateBuffers(1, &m_sorted_light_spheres_ssbo);
+    ResizeLightBvhBuffers();
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_SPHERES_SSBO_BINDING_INDEX,        m_light_spheres_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_KEYS_SSBO_BINDING_INDEX,           m_light_keys_ssbos[0]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_INDICES_SSBO_BINDING_INDEX,        m_light_indices_ssbos[0]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RADIX_SORT_HISTOGRAM_SSBO_BINDING_INDEX, m_radix_sort_histogram_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BVH_NODES_SSBO_BINDING_INDEX,      m_light_bvh_nodes_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SORTED_LIGHT_SPHERES_SSBO_BINDING_INDEX, m_sorted_light_spheres_ssbo);
+
+    // The Z-bins and the tiles' light bitmasks: the tiles are the clusters' screen cells, a bit per light in them
+    glCreateBuffers  (1, &m_zbins_ssbo);
+    glNamedBufferData(m_zbins_ssbo, sizeof(glm::uvec2) * ZBINS_COUNT, nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase (GL_SHADER_STORAGE_BUFFER, ZBINS_SSBO_BINDING_INDEX, m_zbins_ssbo);
+
+    glCreateBuffers (1, &m_tile_light_masks_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TILE_LIGHT_MASKS_SSBO_BINDING_INDEX, m_tile_light_masks_ssbo);
+
+    ResizeClusterBuffers();
+
+    // Create depth pre-pass and visibility buffer textures and FBOs, ResizeDepthPass() makes the textures of the window's size
+    glCreateFramebuffers(1, &m_depth_pass_fbo_id);
+    glCreateFramebuffers(1, &m_visibility_fbo_id);
+    m_object_picking.Create();
+    ResizeDepthPass();
 
     GLenum draw_buffers[] = { GL_NONE };
     glNamedFramebufferDrawBuffers(m_depth_pass_fbo_id, 1, draw_buffers);
@@ -234,6 +302,17 @@ void ClusteredShading::init_app()
     m_depth_prepass_shader = std::make_shared<Shader>(dir + "depth_pass.vert", dir + "depth_pass.frag");
     m_depth_prepass_shader->link();
 
+    m_depth_only_shader = std::make_shared<Shader>(dir + "depth_only.vert", dir + "depth_only.frag");
+    m_depth_only_shader->link();
+
+    m_depth_prepass_picking_shader = std::make_shared<Shader>(dir + "depth_pass.vert", dir + "depth_pass.frag");
+    m_depth_prepass_picking_shader->setDefine("OBJECT_PICKING");
+    m_depth_prepass_picking_shader->link();
+
+    m_depth_only_picking_shader = std::make_shared<Shader>(dir + "depth_only.vert", dir + "depth_only.frag");
+    m_depth_only_picking_shader->setDefine("OBJECT_PICKING");
+    m_depth_only_picking_shader->link();
+
     m_generate_clusters_shader = std::make_shared<Shader>(dir + "generate_clusters.comp");
     m_generate_clusters_shader->link();
 
@@ -243,6 +322,9 @@ void ClusteredShading::init_app()
     m_find_unique_clusters_shader = std::make_shared<Shader>(dir + "find_unique_clusters.comp");
     m_find_unique_clusters_shader->link();
 
+    m_mark_cluster_bounds_shader = std::make_shared<Shader>(dir + "mark_cluster_bounds.comp");
+    m_mark_cluster_bounds_shader->link();
+
     m_update_cull_lights_indirect_args_shader = std::make_shared<Shader>(dir + "update_cull_lights_indirect_args.comp");
     m_update_cull_lights_indirect_args_shader->link();
 
@@ -252,76 +334,114 @@ void ClusteredShading::init_app()
     m_clustered_pbr_shader = std::make_shared<Shader>(dir + "pbr_lighting.vert", dir + "pbr_clustered.frag");
     m_clustered_pbr_shader->link();
 
-    m_update_lights_shader = std::make_shared<Shader>(dir + "update_lights.comp");
-    m_update_lights_shader->link();
+    m_is_subgroups_supported = IsSubgroupsSupported();
+    m_use_subgroups          = m_is_subgroups_supported;
+
+    m_light_sort_keys_shader = std::make_shared<Shader>(dir + "light_sort_keys.comp");
+    m_light_sort_keys_shader->link();
+
+    m_assign_lights_zbins_shader = std::make_shared<Shader>(dir + "assign_lights_zbins.comp");
+    m_assign_lights_zbins_shader->link();
+
+    m_radix_sort_histogram_shader = std::make_shared<Shader>(dir + "radix_sort_histogram.comp");
+    m_radix_sort_histogram_shader->link();
+
+    m_radix_sort_scan_shader = std::make_shared<Shader>(dir + "radix_sort_scan.comp");
+    m_radix_sort_scan_shader->link();
+
+    m_radix_sort_scatter_shader = std::make_shared<Shader>(dir + "radix_sort_scatter.comp");
+    m_radix_sort_scatter_shader->link();
+
+    m_build_light_bvh_shader = std::make_shared<Shader>(dir + "build_light_bvh.comp");
+    m_build_light_bvh_shader->link();
+
+    /* The resolve fetches the model's interleaved float vertices and 32-bit indices, and its materials from the bindless handles. */
+    GLint vertex_stride = 0;
+    glGetVertexArrayIndexediv(m_sponza_static_object.m_model->GetVertexArray(), 0, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &vertex_stride);
+
+    m_visibility_vertex_stride       = uint32_t(vertex_stride) / sizeof(float);
+    m_is_visibility_buffer_supported = Texture::IsBindlessSupported()                                                              &&
+                                       m_sponza_static_object.m_model->GetVertexFormat() == StaticModel::VertexFormat::INTERLEAVED &&
+                                       m_sponza_static_object.m_model->GetIndexType()    == GL_UNSIGNED_INT;
+
+    /* The passes that write the HDR target as an image declare its format. */
+    const char* hdr_image_format = RenderTargetPool::GetImageFormatQualifier(RenderTargetPool::GetColorFormat(RenderTargetUsage::BLOOM));
+
+    if (m_is_visibility_buffer_supported)
+    {
+        m_visibility_shader = std::make_shared<Shader>(dir + "visibility.vert", dir + "visibility.frag");
+        m_visibility_shader->link();
+
+        m_visibility_resolve_shader = std::make_shared<Shader>(dir + "visibility_resolve.comp");
+        m_visibility_resolve_shader->setDefine("HDR_IMAGE_FORMAT", hdr_image_format);
+        m_visibility_resolve_shader->link();
+    }
 
     m_draw_area_lights_geometry_shader = std::make_shared<Shader>(dir + "area_light_geom.vert", dir + "area_light_geom.frag");
     m_draw_area_lights_geometry_shader->link();
 
-    dir = "src/demos/22_pbr/";
-    m_equirectangular_to_cubemap_shader = std::make_shared<Shader>(dir + "cubemap.vert", dir + "equirectangular_to_cubemap.frag");
-    m_equirectangular_to_cubemap_shader->link();
+    m_fog_inject_shader = std::make_shared<Shader>(dir + "fog_inject.comp");
+    m_fog_inject_shader->link();
 
-    m_irradiance_convolution_shader = std::make_shared<Shader>(dir + "cubemap.vert", dir + "irradiance_convolution.frag");
-    m_irradiance_convolution_shader->link();
-    
-    m_prefilter_env_map_shader = std::make_shared<Shader>(dir + "cubemap.vert", dir + "prefilter_cubemap.frag");
-    m_prefilter_env_map_shader->link();
+    m_fog_integrate_shader = std::make_shared<Shader>(dir + "fog_integrate.comp");
+    m_fog_integrate_shader->link();
 
-    m_precompute_brdf = std::make_shared<Shader>("src/demos/10_postprocessing_filters/FSQ.vert", dir + "precompute_brdf.frag");
-    m_precompute_brdf->link();
+    m_fog_apply_shader = std::make_shared<Shader>(dir + "fog_apply.comp");
+    m_fog_apply_shader->setDefine("HDR_IMAGE_FORMAT", hdr_image_format);
+    m_fog_apply_shader->link();
 
-    m_background_shader = std::make_shared<Shader>(dir + "background.vert", dir + "background.frag");
-    m_background_shader->link();
+    m_fog_noise_shader = std::make_shared<Shader>("src/demos/16_noise/noise_gen_3d.comp");
+    m_fog_noise_shader->link();
 
-    m_tmo_ps = std::make_shared<PostprocessFilter>(Window::getWidth(), Window::getHeight());
+    /* The froxels are only fetched, the integrated ones are sampled between the slices. */
+    for (GLuint* texture : { &m_fog_froxels_tex3D_id, &m_fog_integrated_tex3D_id })
+    {
+        glCreateTextures  (GL_TEXTURE_3D, 1, texture);
+        glTextureStorage3D(*texture, 1, GL_RGBA16F, FOG_FROXELS_X, FOG_FROXELS_Y, FOG_FROXELS_Z);
+
+        glTextureParameteri(*texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(*texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(*texture, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+        glTextureParameteri(*texture, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+        glTextureParameteri(*texture, GL_TEXTURE_WRAP_R,     GL_CLAMP_TO_EDGE);
+    }
+
+    GenerateFogNoise();
+
+    m_skybox.Create();
+    m_depth_pyramid.Create();
+    m_variable_rate_shading.Create();
+
+    m_tmo_ps = std::make_shared<PostprocessFilter>();
 
     // Bloom shaders.
     dir = "src/demos/26_bloom/";
     m_downscale_shader = std::make_shared<Shader>(dir + "downscale.comp");
+    m_downscale_shader->setDefine("HDR_IMAGE_FORMAT", hdr_image_format);
     m_downscale_shader->link();
 
     m_upscale_shader = std::make_shared<Shader>(dir + "upscale.comp");
+    m_upscale_shader->setDefine("HDR_IMAGE_FORMAT", hdr_image_format);
     m_upscale_shader->link();
 
+    m_downscale_single_pass_shader = std::make_shared<Shader>(dir + "downscale_single_pass.comp");
+    m_downscale_single_pass_shader->setDefine("HDR_IMAGE_FORMAT", hdr_image_format);
+    m_downscale_single_pass_shader->link();
+
+    const uint32_t zero = 0;
+    glCreateBuffers     (1, &m_bloom_counter_buffer);
+    glNamedBufferStorage(m_bloom_counter_buffer, sizeof(uint32_t), &zero, 0);
+
     m_bloom_dirt_texture = std::make_shared<Texture2D>(); 
     m_bloom_dirt_texture->Load(FileSystem::getResourcesPath() / "textures/bloom_dirt_mask.png");
 
     // IBL precomputations.
-    GenSkyboxGeometry();
-
-    m_env_cubemap_rt = std::make_shared<CubeMapRenderTarget>();
-    m_env_cubemap_rt->set_position(glm::vec3(0.0));
-    m_env_cubemap_rt->generate_rt(2048, 2048, true);
-
-    m_irradiance_cubemap_rt = std::make_shared<CubeMapRenderTarget>();
-    m_irradiance_cubemap_rt->set_position(glm::vec3(0.0));
-    m_irradiance_cubemap_rt->generate_rt(32, 32);
-
-    m_prefiltered_env_map_rt = std::make_shared<CubeMapRenderTarget>();
-    m_prefiltered_env_map_rt->set_position(glm::vec3(0.0));
-    m_prefiltered_env_map_rt->generate_rt(512, 512, true);
-
-    m_brdf_lut_rt = std::make_shared<Texture2DRenderTarget>();
-    m_brdf_lut_rt->create(512, 512, GL_RG16F);
-
-    PrecomputeIndirectLight(FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx]);
-    PrecomputeBRDF(m_brdf_lut_rt);
-
-    auto proj = m_camera->m_projection;
-    auto inv_proj = glm::inverse(proj);
+    m_ibl.Create();
+    m_ibl.Load(FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx]);
 
     /// Generate clusters' AABBs
-    // This can be done once as long as the camera parameters doesn't change (projection matrix related variables)
-    m_generate_clusters_shader->bind();
-    m_generate_clusters_shader->setUniform("u_grid_dim",           m_cluster_grid_dim);
-    m_generate_clusters_shader->setUniform("u_cluster_size_ss",    glm::uvec2(m_cluster_grid_block_size));
-    m_generate_clusters_shader->setUniform("u_near_k",             m_near_k);
-    m_generate_clusters_shader->setUniform("u_near_z",             m_camera->NearPlane());
-    m_generate_clusters_shader->setUniform("u_inverse_projection", glm::inverse(m_camera->m_projection));
-    m_generate_clusters_shader->setUniform("u_pixel_size",         1.0f / glm::vec2(RGL::Window::getWidth(), RGL::Window::getHeight()));
-    glDispatchCompute(glm::ceil(float(m_clusters_count) / 1024.0f), 1, 1);
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    // This is done again only when the camera's projection or the resolution change, UpdateMainClusterGrid() checks them every frame
+    main_grid.generate(m_generate_clusters_shader);
 }
 
 void ClusteredShading::input()
@@ -377,6 +497,12 @@ void ClusteredShading::input()
     {
         m_animate_lights = !m_animate_lights;
     }
+
+    /* The clicks on the GUI don't pick. */
+    if (m_is_picking_enabled && Input::getMouseUp(KeyCode::MouseLeft) && !ImGui::GetIO().WantCaptureMouse)
+    {
+        m_object_picking.RequestPick(Input::getMousePosition());
+    }
 }
 
 void ClusteredShading::update(double delta_time)
@@ -384,24 +510,172 @@ void ClusteredShading::update(double delta_time)
     /* Update variables here. */
     m_camera->update(delta_time);
 
-    static float     rotation_speed = 1.0f;
-    static float     time_accum     = 0.0f;
-    static glm::mat4 rotation_mat   = glm::mat4(1.0f);
-
     if (m_animate_lights)
     {
-        time_accum  += delta_time * m_animation_speed;
-        rotation_mat = glm::rotate(glm::mat4(1.0f), glm::radians(60.0f * float(delta_time)) * 2.0f * m_animation_speed, glm::vec3(0.0f, 1.0f, 0.0f));
+        m_lights_time += delta_time * m_animation_speed;
+    }
+
+    /* The noise volume tiles, the fog streams through it forever. */
+    m_fog_noise_offset = glm::fract(m_fog_noise_offset - m_fog_wind * m_fog_noise_scale * float(delta_time));
+
+    UpdateDynamicLights();
+}
+
+void ClusteredShading::UpdateDynamicLights()
+{
+    /* The slot the worker wrote during the last frame goes to the light SSBOs, so the lights are a frame late. */
+    if (m_is_dynamic_lights_job_pending)
+    {
+        RGL::JobSystem::Wait(m_dynamic_lights_job);
+        m_is_dynamic_lights_job_pending = false;
+
+        const glm::uvec3 dynamic_counts = GetDynamicLightsCounts();
+        const GLintptr   slot_offset    = GLintptr(m_dynamic_lights_slot_size * m_dynamic_lights_slot);
+        const GLsizeiptr points_size    = sizeof(PointLight) * dynamic_counts.x;
+        const GLsizeiptr spots_size     = sizeof(SpotLight)  * dynamic_counts.y;
+        const GLsizeiptr areas_size     = sizeof(AreaLight)  * dynamic_counts.z;
+
+        if (points_size > 0) glCopyNamedBufferSubData(m_dynamic_lights_buffer, m_point_lights_ssbo, slot_offset,                            sizeof(PointLight) * m_static_lights_counts.x, points_size);
+        if (spots_size  > 0) glCopyNamedBufferSubData(m_dynamic_lights_buffer, m_spot_lights_ssbo,  slot_offset + points_size,              sizeof(SpotLight)  * m_static_lights_counts.y, spots_size);
+        if (areas_size  > 0) glCopyNamedBufferSubData(m_dynamic_lights_buffer, m_area_lights_ssbo,  slot_offset + points_size + spots_size, sizeof(AreaLight)  * m_static_lights_counts.z, areas_size);
+
+        m_dynamic_lights_fences[m_dynamic_lights_slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        m_uploaded_lights_time         = m_dynamic_lights_job_time;
+        m_are_uploaded_lights_animated = true;
+    }
+
+    if (!m_animate_lights || m_dynamic_lights_slot_size == 0)
+    {
+        return;
+    }
+
+    /* The next slot was copied LIGHTS_UPDATE_FRAMES frames ago, its fence is normally signaled already. */
+    m_dynamic_lights_slot = (m_dynamic_lights_slot + 1) % LIGHTS_UPDATE_FRAMES;
+
+    GLsync& fence = m_dynamic_lights_fences[m_dynamic_lights_slot];
+    if (fence)
+    {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    uint8_t*    slot = m_dynamic_lights_data + m_dynamic_lights_slot_size * m_dynamic_lights_slot;
+    const float time = m_lights_time;
+
+    RGL::JobSystem::Run([this, slot, time] { AnimateDynamicLights(slot, time); }, &m_dynamic_lights_job);
+    m_is_dynamic_lights_job_pending = true;
+    m_dynamic_lights_job_time       = time;
+}
+
+void ClusteredShading::AnimateDynamicLights(uint8_t* slot, float time) const
+{
+    const glm::uvec3 dynamic_counts = GetDynamicLightsCounts();
+
+    /* The slot is write only memory, every light is written whole, in order. */
+    PointLight* points = reinterpret_cast<PointLight*>(slot);
+    SpotLight*  spots  = reinterpret_cast<SpotLight*> (slot + sizeof(PointLight) * dynamic_counts.x);
+    AreaLight*  areas  = reinterpret_cast<AreaLight*> (slot + sizeof(PointLight) * dynamic_counts.x + sizeof(SpotLight) * dynamic_counts.y);
+
+    RGL::JobSystem::ParallelFor(0, dynamic_counts.x, 4096, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            const uint32_t   light = m_static_lights_counts.x + i;
+            const glm::vec4& e     = m_point_lights_ellipses_radii[light]; // [x, y, z] => [ellipse a radius, ellipse b radius, light move speed]
+
+            PointLight p = m_point_lights[light];
+            p.position.x = e.x * glm::cos(time * e.z);
+            p.position.z = e.y * glm::sin(time * e.z);
+            points[i]    = p;
+        }
+    });
+
+    RGL::JobSystem::ParallelFor(0, dynamic_counts.y, 4096, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            const uint32_t   light = m_static_lights_counts.y + i;
+            const glm::vec4& e     = m_spot_lights_ellipses_radii[light];
+
+            SpotLight p        = m_spot_lights[light];
+            p.point.position.x = e.x * glm::cos(time * e.z);
+            p.point.position.z = e.y * glm::sin(time * e.z);
+            spots[i]           = p;
+        }
+    });
+
+    /* Rotate each area light around its center point, 120 degrees a second at the speed 1. */
+    const glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), glm::radians(120.0f) * time, glm::vec3(0.0f, 1.0f, 0.0f));
+
+    RGL::JobSystem::ParallelFor(0, dynamic_counts.z, 1024, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            AreaLight       a         = m_area_lights[m_static_lights_counts.z + i];
+            const glm::vec3 center    = glm::vec3(a.points[1] + a.points[2]) * 0.5f;
+            const glm::mat4 transform = glm::translate(glm::mat4(1.0f), center) * rotation * glm::translate(glm::mat4(1.0f), -center);
+
+            for (uint32_t j = 0; j < 4; ++j)
+            {
+                a.points[j] = transform * a.points[j];
+            }
+            areas[i] = a;
+        }
+    });
+}
+
+void ClusteredShading::FinishDynamicLights()
+{
+    if (m_is_dynamic_lights_job_pending)
+    {
+        RGL::JobSystem::Wait(m_dynamic_lights_job);
+        m_is_dynamic_lights_job_pending = false;
+    }
+}
+
+void ClusteredShading::ResizeDynamicLightsBuffer()
+{
+    FinishDynamicLights();
+
+    m_static_lights_counts = glm::uvec3(m_point_lights.size(), m_spot_lights.size(), m_area_lights.size());
+    m_static_lights_counts = m_static_lights_counts - glm::uvec3(glm::vec3(m_static_lights_counts) * m_dynamic_lights_ratio);
+
+    const glm::uvec3 dynamic_counts = GetDynamicLightsCounts();
+    const size_t     slot_size      = sizeof(PointLight) * dynamic_counts.x + sizeof(SpotLight) * dynamic_counts.y + sizeof(AreaLight) * dynamic_counts.z;
+
+    m_dynamic_lights_slot_size = slot_size;
+
+    /* The storage is immutable, it's made again only to grow. */
+    if (slot_size <= m_dynamic_lights_slot_capacity)
+    {
+        return;
+    }
 
-        m_update_lights_shader->bind();
-        m_update_lights_shader->setUniform("u_time",            time_accum);
-        m_update_lights_shader->setUniform("u_two_sided",       m_area_lights_two_sided);
-        m_update_lights_shader->setUniform("u_rotation_matrix", rotation_mat);
+    if (m_dynamic_lights_buffer != 0)
+    {
+        for (GLsync& fence : m_dynamic_lights_fences)
+        {
+            if (fence)
+            {
+                glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
 
-        uint32_t max_lights_count = glm::max(m_point_lights.size(), glm::max(m_spot_lights.size(), glm::max(m_directional_lights.size(), m_area_lights.size())));
-        glDispatchCompute(::ceilf(max_lights_count / 1024.0f), 1, 1);
-        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        glDeleteBuffers(1, &m_dynamic_lights_buffer);
     }
+
+    m_dynamic_lights_slot_capacity = slot_size;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glCreateBuffers     (1, &m_dynamic_lights_buffer);
+    glNamedBufferStorage(m_dynamic_lights_buffer, m_dynamic_lights_slot_capacity * LIGHTS_UPDATE_FRAMES, nullptr, flags);
+
+    m_dynamic_lights_data = static_cast<uint8_t*>(glMapNamedBufferRange(m_dynamic_lights_buffer, 0, m_dynamic_lights_slot_capacity * LIGHTS_UPDATE_FRAMES, flags));
 }
 
 void ClusteredShading::GenerateAreaLights()
@@ -522,370 +796,1420 @@ void ClusteredShading::GenerateSpotLights()
 
 void ClusteredShading::UpdateLightsSSBOs()
 {
+    /* The worker reads the lights. */
+    FinishDynamicLights();
+
     glNamedBufferData(m_directional_lights_ssbo,          sizeof(DirectionalLight)                 * m_directional_lights.size(),          m_directional_lights.data(),          GL_DYNAMIC_DRAW);
     glNamedBufferData(m_point_lights_ssbo,                sizeof(PointLight)                       * m_point_lights.size(),                m_point_lights.data(),                GL_DYNAMIC_DRAW);
     glNamedBufferData(m_spot_lights_ssbo,                 sizeof(SpotLight)                        * m_spot_lights.size(),                 m_spot_lights.data(),                 GL_DYNAMIC_DRAW);
     glNamedBufferData(m_area_lights_ssbo,                 sizeof(AreaLight)                        * m_area_lights.size(),                 m_area_lights.data(),                 GL_DYNAMIC_DRAW);
-    glNamedBufferData(m_point_lights_ellipses_radii_ssbo, sizeof(m_point_lights_ellipses_radii[0]) * m_point_lights_ellipses_radii.size(), m_point_lights_ellipses_radii.data(), GL_DYNAMIC_DRAW);
-    glNamedBufferData(m_spot_lights_ellipses_radii_ssbo,  sizeof(m_spot_lights_ellipses_radii[0])  * m_spot_lights_ellipses_radii.size(),  m_spot_lights_ellipses_radii.data(),  GL_DYNAMIC_DRAW);
+
+    m_are_uploaded_lights_animated = false;
+
+    ResizeDynamicLightsBuffer();
+    ResizeLightBvhBuffers();
+    ResetLightShadows();
 }
 
-void ClusteredShading::HdrEquirectangularToCubemap(const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt, const std::shared_ptr<Texture2D>& m_equirectangular_map)
+void ClusteredShading::ReadLightListsFeedback()
 {
-    /* Update all faces per frame */
-    m_equirectangular_to_cubemap_shader->bind();
-    m_equirectangular_to_cubemap_shader->setUniform("u_projection", cubemap_rt->m_projection);
+    bool has_feedback = false;
+
+    /* The oldest copy first, the slot is written again this frame. */
+    for (uint32_t i = 0; i < FEEDBACK_FRAMES; ++i)
+    {
+        const uint32_t slot  = (m_light_lists_readback_slot + i) % FEEDBACK_FRAMES;
+        GLsync&        fence = m_light_lists_fences[slot];
 
-    glViewport(0, 0, cubemap_rt->m_width, cubemap_rt->m_height);
-    glBindFramebuffer(GL_FRAMEBUFFER, cubemap_rt->m_fbo_id);
-    m_equirectangular_map->Bind(1);
+        if (!fence || glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            continue;
+        }
+
+        glDeleteSync(fence);
+        fence        = nullptr;
+        has_feedback = true;
+
+        m_light_lists_feedback  = m_light_lists_readback_data[slot];
+        m_max_peak_light_counts = glm::max(m_max_peak_light_counts, glm::uvec3(m_light_lists_feedback.peak_counts[0],
+                                                                                m_light_lists_feedback.peak_counts[1],
+                                                                                m_light_lists_feedback.peak_counts[2]));
+    }
 
-    glBindVertexArray(m_skybox_vao);
-    for (uint8_t side = 0; side < 6; ++side)
+    if (!has_feedback)
     {
-        m_equirectangular_to_cubemap_shader->setUniform("u_view", cubemap_rt->m_view_transforms[side]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, cubemap_rt->m_cubemap_texture_id, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        return;
     }
-    glViewport(0, 0, Window::getWidth(), Window::getHeight());
-}
 
-void ClusteredShading::IrradianceConvolution(const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt)
-{
-    /* Update all faces per frame */
-    m_irradiance_convolution_shader->bind();
-    m_irradiance_convolution_shader->setUniform("u_projection", cubemap_rt->m_projection);
+    /* Grows the lists that overflowed, shrinks the ones mostly unused. */
+    bool is_resize_needed = false;
+
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        const uint32_t required = m_light_lists_feedback.required_counts[i];
+        const uint32_t capacity = m_light_index_lists_capacities[i];
 
-    glViewport(0, 0, cubemap_rt->m_width, cubemap_rt->m_height);
-    glBindFramebuffer(GL_FRAMEBUFFER, cubemap_rt->m_fbo_id);
-    m_env_cubemap_rt->bindTexture(1);
+        is_resize_needed = is_resize_needed || required > capacity || required * INDEX_LISTS_HEADROOM < capacity * INDEX_LISTS_SHRINK_RATIO;
+    }
 
-    for (uint8_t side = 0; side < 6; ++side)
+    if (is_resize_needed)
     {
-        m_irradiance_convolution_shader->setUniform("u_view", cubemap_rt->m_view_transforms[side]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, cubemap_rt->m_cubemap_texture_id, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        glBindVertexArray(m_skybox_vao);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        ResizeLightIndexLists(m_light_lists_feedback.required_counts);
     }
-    glViewport(0, 0, Window::getWidth(), Window::getHeight());
 }
 
-void ClusteredShading::PrefilterCubemap(const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt)
+void ClusteredShading::ResizeLightIndexLists(const uint32_t required_counts[3])
 {
-    m_prefilter_env_map_shader->bind();
-    m_prefilter_env_map_shader->setUniform("u_projection", cubemap_rt->m_projection);
-    
-    m_env_cubemap_rt->bindTexture(1);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, cubemap_rt->m_fbo_id);
+    const GLuint ssbos[3] = { m_point_light_index_list_ssbo, m_spot_light_index_list_ssbo, m_area_light_index_list_ssbo };
+    bool is_resized       = false;
 
-    uint8_t max_mip_levels = glm::log2(float(cubemap_rt->m_width));
-    for (uint8_t mip = 0; mip < max_mip_levels; ++mip)
+    for (uint32_t i = 0; i < 3; ++i)
     {
-        // resize the framebuffer according to mip-level size.
-        uint32_t mip_width  = cubemap_rt->m_width  * std::pow(0.5, mip);
-        uint32_t mip_height = cubemap_rt->m_height * std::pow(0.5, mip);
+        /* A cluster can't keep more than 1024 lights of a type. */
+        const uint64_t max_count = m_clusters_count * 1024u;
+        const uint32_t capacity  = uint32_t(glm::clamp<uint64_t>(uint64_t(required_counts[i] * INDEX_LISTS_HEADROOM), 1024u, max_count));
 
-        glBindRenderbuffer(GL_RENDERBUFFER, cubemap_rt->m_rbo_id);
-        //glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mip_width, mip_height);
-        glViewport(0, 0, mip_width, mip_height);
-
-        float roughness = float(mip) / float(max_mip_levels - 1);
-        m_prefilter_env_map_shader->setUniform("u_roughness", roughness);
-
-        for (uint8_t side = 0; side < 6; ++side)
+        if (capacity == m_light_index_lists_capacities[i])
         {
-            m_prefilter_env_map_shader->setUniform("u_view", cubemap_rt->m_view_transforms[side]);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, cubemap_rt->m_cubemap_texture_id, mip);
-
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            glBindVertexArray(m_skybox_vao);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            continue;
         }
+
+        glNamedBufferData(ssbos[i], sizeof(uint32_t) * capacity, nullptr, GL_DYNAMIC_DRAW);
+        m_light_index_lists_capacities[i] = capacity;
+        is_resized                        = true;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, Window::getWidth(), Window::getHeight());
+
+    m_light_index_lists_resizes += is_resized ? 1 : 0;
 }
 
-void ClusteredShading::PrecomputeIndirectLight(const std::filesystem::path& hdri_map_filepath)
+void ClusteredShading::ResizeLightBvhBuffers()
 {
-    auto envmap_hdr = std::make_shared<Texture2D>();
-    envmap_hdr->LoadHdr(hdri_map_filepath);
+    /* At least a light, the buffers are bound even when there are none. */
+    const uint32_t lights_count = glm::max(GetLightsCount(), 1u);
+    const uint32_t blocks_count = (lights_count + RADIX_SORT_BLOCK_SIZE - 1) / RADIX_SORT_BLOCK_SIZE;
+
+    /* The same levels cull_lights.comp walks. */
+    m_light_bvh_levels.clear();
+
+    for (uint32_t count = lights_count, offset = 0; m_light_bvh_levels.empty() || count > 1;)
+    {
+        count = (count + LIGHT_BVH_BRANCHING - 1) / LIGHT_BVH_BRANCHING;
 
-    HdrEquirectangularToCubemap(m_env_cubemap_rt, envmap_hdr);
+        m_light_bvh_levels.push_back({ offset, count });
+        offset += count;
+    }
+
+    const uint32_t nodes_count = m_light_bvh_levels.back().x + 1;
 
-    glBindTexture(GL_TEXTURE_CUBE_MAP, m_env_cubemap_rt->m_cubemap_texture_id);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    glNamedBufferData(m_light_spheres_ssbo,        sizeof(glm::vec4)    * lights_count,                         nullptr, GL_DYNAMIC_DRAW);
+    glNamedBufferData(m_sorted_light_spheres_ssbo, sizeof(glm::vec4)    * lights_count,                         nullptr, GL_DYNAMIC_DRAW);
+    glNamedBufferData(m_radix_sort_histogram_ssbo, sizeof(uint32_t)     * blocks_count * RADIX_SORT_BINS_COUNT, nullptr, GL_DYNAMIC_DRAW);
+    glNamedBufferData(m_light_bvh_nodes_ssbo,      sizeof(LightBvhNode) * nodes_count,                          nullptr, GL_DYNAMIC_DRAW);
 
-    IrradianceConvolution(m_irradiance_cubemap_rt);
-    PrefilterCubemap(m_prefiltered_env_map_rt);
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        glNamedBufferData(m_light_keys_ssbos[i],    sizeof(uint32_t) * lights_count, nullptr, GL_DYNAMIC_DRAW);
+        glNamedBufferData(m_light_indices_ssbos[i], sizeof(uint32_t) * lights_count, nullptr, GL_DYNAMIC_DRAW);
+    }
 }
 
-void ClusteredShading::PrecomputeBRDF(const std::shared_ptr<Texture2DRenderTarget>& rt)
+bool ClusteredShading::IsSubgroupsSupported()
 {
-    GLuint m_dummy_vao_id;
-    glCreateVertexArrays(1, &m_dummy_vao_id);
+    /* The shaders need the basic, ballot and arithmetic subgroup operations, glad doesn't load GL_KHR_shader_subgroup. */
+    GLint extensions_count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions_count);
 
-    rt->bindRenderTarget();
-    m_precompute_brdf->bind();
+    for (GLint i = 0; i < extensions_count; ++i)
+    {
+        if (std::strcmp(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)), "GL_KHR_shader_subgroup") == 0)
+        {
+            return true;
+        }
+    }
 
-    glBindVertexArray(m_dummy_vao_id);
-    glDrawArrays(GL_TRIANGLES, 0, 3);
+    return false;
+}
+
+ClusteredShading::ClusterGrid& ClusteredShading::GetClusterGrid(uint32_t view_index)
+{
+    if (view_index >= m_cluster_grids.size())
+    {
+        m_cluster_grids.resize(view_index + 1);
+    }
 
-    glDeleteVertexArrays(1, &m_dummy_vao_id);
+    if (!m_cluster_grids[view_index])
+    {
+        m_cluster_grids[view_index] = std::make_unique<ClusterGrid>();
+    }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, Window::getWidth(), Window::getHeight());
+    return *m_cluster_grids[view_index];
 }
 
-void ClusteredShading::GenSkyboxGeometry()
+bool ClusteredShading::UpdateClusterGrid(uint32_t view_index, const RGL::Camera& camera, const glm::uvec2& resolution)
 {
-    m_skybox_vao = 0;
-    m_skybox_vbo = 0;
-
-    glCreateVertexArrays(1, &m_skybox_vao);
-    glCreateBuffers(1, &m_skybox_vbo);
-
-    std::vector<float> skybox_positions = {
-        // positions          
-        -1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
-        // front face
-        -1.0f, -1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-        // left face
-        -1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-        // right face
-         1.0f,  1.0f,  1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-        // bottom face
-        -1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f, -1.0f,
-        // top face
-        -1.0f,  1.0f, -1.0f,
-         1.0f,  1.0f , 1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f,  1.0f,  1.0f,
-    };
+    ClusterGrid& grid = GetClusterGrid(view_index);
 
-    /* Set up buffer objects */
-    glNamedBufferStorage(m_skybox_vbo, skybox_positions.size() * sizeof(skybox_positions[0]), skybox_positions.data(), 0 /*flags*/);
+    if (!grid.isOutdated(camera, resolution, m_cluster_grid_block_size))
+    {
+        return false;
+    }
 
-    /* Set up VAO */
-    glEnableVertexArrayAttrib(m_skybox_vao, 0 /*index*/);
+    grid.resize  (camera, resolution, m_cluster_grid_block_size);
+    grid.generate(m_generate_clusters_shader);
 
-    /* Separate attribute format */
-    glVertexArrayAttribFormat(m_skybox_vao, 0 /*index*/, 3 /*size*/, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/);
-    glVertexArrayAttribBinding(m_skybox_vao, 0 /*index*/, 0 /*bindingindex*/);
-    glVertexArrayVertexBuffer(m_skybox_vao, 0 /*bindingindex*/, m_skybox_vbo, 0 /*offset*/, sizeof(glm::vec3) /*stride*/);
+    return true;
 }
 
-void ClusteredShading::render()
+void ClusteredShading::UpdateMainClusterGrid()
 {
-    // 1. Depth(Z) pre-pass
-    renderDepthPass();
+    const glm::uvec2 resolution = glm::uvec2(Window::getWidth(), Window::getHeight());
 
-    // 2. Blit depth info to tmo_ps framebuffer
-    glBlitNamedFramebuffer(m_depth_pass_fbo_id, m_tmo_ps->rt->m_fbo_id, 
-                           0, 0, Window::getWidth(), Window::getHeight(),
-                           0, 0, Window::getWidth(), Window::getHeight(), GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-    
-    static const uint32_t clear_val = 0;
-    
-    // 3. Find visible clusters
-    glClearNamedBufferData(m_clusters_flags_ssbo, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &clear_val);
-
-    m_find_visible_clusters_shader->bind();
-    m_find_visible_clusters_shader->setUniform("u_near_z",          m_camera->NearPlane());
-    m_find_visible_clusters_shader->setUniform("u_far_z",           m_camera->FarPlane());
-    m_find_visible_clusters_shader->setUniform("u_log_grid_dim_y",  m_log_grid_dim_y);
-    m_find_visible_clusters_shader->setUniform("u_cluster_size_ss", glm::uvec2(m_cluster_grid_block_size));
-    m_find_visible_clusters_shader->setUniform("u_grid_dim",        m_cluster_grid_dim);
-    
-    glBindTextureUnit(0, m_depth_tex2D_id);
-    glDispatchCompute(glm::ceil(RGL::Window::getWidth() / 32.0f), glm::ceil(RGL::Window::getHeight() / 32.0f), 1);
-    glMemoryBarrier  (GL_SHADER_STORAGE_BARRIER_BIT);
-
-    // 4. Find unique clusters and update the indirect dispatch arguments buffer
-    glClearNamedBufferData(m_unique_active_clusters_ssbo, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &clear_val);
-
-    m_find_unique_clusters_shader->bind();
-    glDispatchCompute(glm::ceil(m_clusters_count / 1024.0f), 1, 1);
-    glMemoryBarrier  (GL_SHADER_STORAGE_BARRIER_BIT);
-
-    m_update_cull_lights_indirect_args_shader->bind();
-    glDispatchCompute(1, 1, 1);
-    glMemoryBarrier  (GL_SHADER_STORAGE_BARRIER_BIT);
-
-    // 5. Assign lights to clusters (cull lights)
-    glClearNamedBufferData(m_point_light_grid_ssbo,       GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &clear_val);
-    glClearNamedBufferData(m_point_light_index_list_ssbo, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &clear_val);
-    glClearNamedBufferData(m_spot_light_grid_ssbo,        GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &clear_val);
-    glClearNamedBufferData(m_spot_light_index_list_ssbo,  GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &clear_val);
-    glClearNamedBufferData(m_area_light_grid_ssbo,        GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &clear_val);
-    glClearNamedBufferData(m_area_light_index_list_ssbo,  GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &clear_val);
-
-    m_cull_lights_shader->bind();
-    m_cull_lights_shader->setUniform("u_view_matrix", m_camera->m_view);
-
-    glBindBuffer             (GL_DISPATCH_INDIRECT_BUFFER, m_cull_lights_dispatch_args_ssbo);
-    glDispatchComputeIndirect(0);
-    glMemoryBarrier          (GL_SHADER_STORAGE_BARRIER_BIT);
-
-    // 6. Render lighting
-    renderLighting();
-
-    // 7. Render area lights geometry
-    m_draw_area_lights_geometry_shader->bind();
-    m_draw_area_lights_geometry_shader->setUniform("u_view_projection", m_camera->m_projection * m_camera->m_view);
-    glDrawArrays(GL_TRIANGLES, 0, 6 * m_area_lights.size());
-
-    // 8. Render skybox
-    m_background_shader->bind();
-    m_background_shader->setUniform("u_projection", m_camera->m_projection);
-    m_background_shader->setUniform("u_view",       glm::mat4(glm::mat3(m_camera->m_view)));
-    m_background_shader->setUniform("u_lod_level",  m_background_lod_level);
-    m_env_cubemap_rt->bindTexture();
-
-    glBindVertexArray(m_skybox_vao);
-    glDrawArrays     (GL_TRIANGLES, 0, 36);
-
-    // 9. Bloom: downscale
-    if (m_bloom_enabled)
+    if (UpdateClusterGrid(0, *m_camera, resolution))
     {
-        m_downscale_shader->bind();
-        m_downscale_shader->setUniform("u_threshold", glm::vec4(m_threshold, m_threshold - m_knee, 2.0f * m_knee, 0.25f * m_knee));
-        m_tmo_ps->rt->bindTexture();
+        const ClusterGrid& main_grid = GetClusterGrid(0);
 
-        glm::uvec2 mip_size = glm::uvec2(m_tmo_ps->rt->m_width / 2, m_tmo_ps->rt->m_height / 2);
+        m_cluster_grid_dim = main_grid.m_dim;
+        m_near_k           = main_grid.m_near_k;
+        m_log_grid_dim_y   = main_grid.m_log_grid_dim_y;
+        m_clusters_count   = main_grid.m_clusters_count;
 
-        for (uint8_t i = 0; i < m_tmo_ps->rt->m_mip_levels - 1; ++i)
+        ResizeClusterBuffers();
+
+        if (resolution != m_depth_resolution)
         {
-            m_downscale_shader->setUniform("u_texel_size",    1.0f / glm::vec2(mip_size));
-            m_downscale_shader->setUniform("u_mip_level",     i);
-            m_downscale_shader->setUniform("u_use_threshold", i == 0);
+            ResizeDepthPass();
+        }
+    }
+
+    /* The other views bind their grids when they cull. */
+    GetClusterGrid(0).bind();
+}
+
+void ClusteredShading::ResizeClusterBuffers()
+{
+    /* They only grow, a smaller grid uses the start of them. */
+    const uint64_t tiles_count = m_cluster_grid_dim.x * m_cluster_grid_dim.y;
 
-            m_tmo_ps->rt->bindImageForWrite(IMAGE_UNIT_WRITE, i + 1);
+    if (m_clusters_count > m_cluster_buffers_capacity)
+    {
+        m_cluster_buffers_capacity = m_clusters_count;
 
-            glDispatchCompute(glm::ceil(float(mip_size.x) / 8), glm::ceil(float(mip_size.y) / 8), 1);
+        glNamedBufferData(m_clusters_flags_ssbo,         sizeof(uint32_t) * m_cluster_buffers_capacity,                     nullptr, GL_STATIC_READ);
+        glNamedBufferData(m_unique_active_clusters_ssbo, sizeof(uint32_t) * m_cluster_buffers_capacity + sizeof(uint32_t),  nullptr, GL_STATIC_READ);
+        glNamedBufferData(m_point_light_grid_ssbo,       sizeof(uint32_t) + sizeof(LightGrid) * m_cluster_buffers_capacity, nullptr, GL_DYNAMIC_DRAW);
+        glNamedBufferData(m_spot_light_grid_ssbo,        sizeof(uint32_t) + sizeof(LightGrid) * m_cluster_buffers_capacity, nullptr, GL_DYNAMIC_DRAW);
+        glNamedBufferData(m_area_light_grid_ssbo,        sizeof(uint32_t) + sizeof(LightGrid) * m_cluster_buffers_capacity, nullptr, GL_DYNAMIC_DRAW);
+    }
 
-            mip_size = mip_size / 2u;
+    if (tiles_count > m_tiles_capacity)
+    {
+        m_tiles_capacity = tiles_count;
 
-            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
-        }
+        glNamedBufferData(m_tile_light_masks_ssbo, sizeof(uint32_t) * ZBIN_WORDS_PER_TILE * m_tiles_capacity, nullptr, GL_DYNAMIC_DRAW);
+    }
+}
 
-        /* Bloom: upscale */
-        m_upscale_shader->bind();
-        m_upscale_shader->setUniform("u_bloom_intensity", m_bloom_intensity);
-        m_upscale_shader->setUniform("u_dirt_intensity",  m_bloom_dirt_intensity);
-        m_tmo_ps->rt->bindTexture();
-        m_bloom_dirt_texture->Bind(1);
+void ClusteredShading::ResizeDepthPass()
+{
+    m_depth_resolution = glm::uvec2(Window::getWidth(), Window::getHeight());
 
-        for (uint8_t i = m_tmo_ps->rt->m_mip_levels - 1; i >= 1; --i)
-        {
-            mip_size.x = glm::max(1.0, glm::floor(float(m_tmo_ps->rt->m_width)  / glm::pow(2.0, i - 1)));
-            mip_size.y = glm::max(1.0, glm::floor(float(m_tmo_ps->rt->m_height) / glm::pow(2.0, i - 1)));
+    if (m_depth_tex2D_id != 0)
+    {
+        glDeleteTextures(1, &m_depth_tex2D_id);
+    }
 
-            m_upscale_shader->setUniform("u_texel_size", 1.0f / glm::vec2(mip_size));
-            m_upscale_shader->setUniform("u_mip_level",  i);
+    glCreateTextures  (GL_TEXTURE_2D, 1, &m_depth_tex2D_id);
+    glTextureStorage2D(m_depth_tex2D_id, 1, GL_DEPTH_COMPONENT32F, m_depth_resolution.x, m_depth_resolution.y);
 
-            m_tmo_ps->rt->bindImageForReadWrite(IMAGE_UNIT_WRITE, i - 1);
+    glTextureParameteri(m_depth_tex2D_id, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(m_depth_tex2D_id, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureParameteri(m_depth_tex2D_id, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+    glTextureParameteri(m_depth_tex2D_id, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
 
-            glDispatchCompute(glm::ceil(float(mip_size.x) / 8), glm::ceil(float(mip_size.y) / 8), 1);
+    glNamedFramebufferTexture(m_depth_pass_fbo_id, GL_DEPTH_ATTACHMENT, m_depth_tex2D_id, 0);
 
-            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
-        }
+    if (m_visibility_tex2D_id != 0)
+    {
+        glDeleteTextures(1, &m_visibility_tex2D_id);
     }
 
-    // 10. Apply tone mapping
-    m_tmo_ps->render(m_exposure, m_gamma);
+    glCreateTextures  (GL_TEXTURE_2D, 1, &m_visibility_tex2D_id);
+    glTextureStorage2D(m_visibility_tex2D_id, 1, GL_RG32UI, m_depth_resolution.x, m_depth_resolution.y);
+
+    glTextureParameteri(m_visibility_tex2D_id, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(m_visibility_tex2D_id, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glNamedFramebufferTexture(m_visibility_fbo_id, GL_COLOR_ATTACHMENT0, m_visibility_tex2D_id, 0);
+    glNamedFramebufferTexture(m_visibility_fbo_id, GL_DEPTH_ATTACHMENT,  m_depth_tex2D_id,      0);
+
+    m_object_picking.Resize(m_depth_resolution.x, m_depth_resolution.y);
+    SetPickingEnabled(m_is_picking_enabled);
 }
 
-void ClusteredShading::renderDepthPass()
+void ClusteredShading::SetShadingMode(ShadingMode mode)
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, m_depth_pass_fbo_id);
-    glClear          (GL_DEPTH_BUFFER_BIT);
-
-    glDepthMask(1);
-    glColorMask(0, 0, 0, 0);
-    glDepthFunc(GL_LESS);
+    if (mode == ShadingMode::VISIBILITY_BUFFER && !m_is_visibility_buffer_supported)
+    {
+        return;
+    }
 
-    m_depth_prepass_shader->bind();
-    m_depth_prepass_shader->setUniform("mvp", m_camera->m_projection * m_camera->m_view * m_sponza_static_object.m_transform);
-    m_sponza_static_object.m_model->Render();
+    m_sponza_static_object.m_model->EnableBindlessTextures(mode == ShadingMode::VISIBILITY_BUFFER);
+    m_shading_mode = mode;
 }
 
-void ClusteredShading::renderLighting()
+void ClusteredShading::SetPickingEnabled(bool is_enabled)
 {
-    glDepthMask(0);
-    glColorMask(1, 1, 1, 1);
-    glDepthFunc(GL_EQUAL);
+    if (is_enabled)
+    {
+        m_object_picking.Attach(m_depth_pass_fbo_id);
+    }
+    else
+    {
+        m_object_picking.Detach(m_depth_pass_fbo_id);
+    }
 
-    m_tmo_ps->bindFilterFBO(GL_COLOR_BUFFER_BIT);
+    m_is_picking_enabled = is_enabled;
+}
 
-    auto view_projection = m_camera->m_projection * m_camera->m_view;
+void ClusteredShading::UpdateLightShadows()
+{
+    m_shadows_to_render.clear();
+    m_shadow_faces_rendered = 0;
 
-    m_clustered_pbr_shader->bind();
-    m_clustered_pbr_shader->setUniform("u_cam_pos",                               m_camera->position());
-    m_clustered_pbr_shader->setUniform("u_near_z",                                m_camera->NearPlane());
-    m_clustered_pbr_shader->setUniform("u_grid_dim",                              m_cluster_grid_dim);
-    m_clustered_pbr_shader->setUniform("u_cluster_size_ss",                       glm::uvec2(m_cluster_grid_block_size));
-    m_clustered_pbr_shader->setUniform("u_log_grid_dim_y",                        m_log_grid_dim_y);
-    m_clustered_pbr_shader->setUniform("u_debug_slices",                          m_debug_slices);
-    m_clustered_pbr_shader->setUniform("u_debug_clusters_occupancy",              m_debug_clusters_occupancy);
-    m_clustered_pbr_shader->setUniform("u_debug_clusters_occupancy_blend_factor", m_debug_clusters_occupancy_blend_factor);
+    if (!m_shadows_enabled)
+    {
+        return;
+    }
 
-    m_clustered_pbr_shader->setUniform("u_model",         m_sponza_static_object.m_transform);
-    m_clustered_pbr_shader->setUniform("u_view",          m_camera->m_view);
-    m_clustered_pbr_shader->setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_sponza_static_object.m_transform))));
-    m_clustered_pbr_shader->setUniform("u_mvp",           view_projection * m_sponza_static_object.m_transform);
+    const uint32_t points_count = uint32_t(m_point_lights.size());
+    const uint32_t lights_count = uint32_t(m_point_lights.size() + m_spot_lights.size());
 
-    m_irradiance_cubemap_rt->bindTexture(6);
-    m_prefiltered_env_map_rt->bindTexture(7);
-    m_brdf_lut_rt->bindTexture(8);
-    m_ltc_mat_lut->Bind(9);
-    m_ltc_amp_lut->Bind(10);
+    /* The coverage is the radius projected at the distance of the light's center, the ones behind the camera have none. */
+    const float projection_scale = 0.5f * Window::getHeight() * m_camera->m_projection[1][1];
+    const float near_z           = m_camera->NearPlane();
 
-    m_sponza_static_object.m_model->Render(m_clustered_pbr_shader);
+    using Candidate = std::pair<float, uint32_t>;
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates; // The top ones by the coverage, the smallest on top.
 
-    /* Enable writing to the depth buffer. */
-    glDepthMask(1);
-    glDepthFunc(GL_LEQUAL);
-}
+    for (uint32_t light = 0; light < lights_count; ++light)
+    {
+        glm::vec4 sphere, cone;
+        GetShadowedLightPose(light, sphere, cone);
 
-void ClusteredShading::render_gui()
-{
-    /* This method is responsible for rendering GUI using ImGUI. */
+        const glm::vec3 view_pos = glm::vec3(m_camera->m_view * glm::vec4(glm::vec3(sphere), 1.0f));
 
-    /* 
+        if (view_pos.z - sphere.w > -near_z)
+        {
+            continue;
+        }
+
+        const float coverage = sphere.w * projection_scale / glm::max(glm::length(view_pos), sphere.w);
+
+        if (candidates.size() < m_max_shadowed_lights)
+        {
+            candidates.emplace(coverage, light);
+        }
+        else if (coverage > candidates.top().first)
+        {
+            candidates.pop();
+            candidates.emplace(coverage, light);
+        }
+    }
+
+    std::unordered_map<uint32_t, float> selected;
+    while (!candidates.empty())
+    {
+        selected.emplace(candidates.top().second, candidates.top().first);
+        candidates.pop();
+    }
+
+    /* A tile's texel covers about a pixel of the light's radius on the screen, the point lights' cubes take six. */
+    auto getTileSize = [points_count](uint32_t light, float coverage)
+    {
+        const uint32_t max_tile_size = light < points_count ? 512u : 1024u;
+        return glm::clamp(std::bit_ceil(uint32_t(glm::min(2.0f * coverage, float(ShadowAtlas::SIZE)))), ShadowAtlas::MIN_TILE_SIZE, max_tile_size);
+    };
+
+    /* The lights that left the selection free their tiles, the ones whose tiles got too small or more than twice too big are allocated again. */
+    for (uint32_t slot = 0; slot < MAX_SHADOWED_LIGHTS; ++slot)
+    {
+        ShadowedLight& shadowed_light = m_shadowed_lights[slot];
+
+        if (shadowed_light.m_light == NO_LIGHT_SHADOW)
+        {
+            continue;
+        }
+
+        auto it = selected.find(shadowed_light.m_light);
+        if (it == selected.end())
+        {
+            FreeShadowedLight(slot);
+            continue;
+        }
+
+        const uint32_t tile_size = getTileSize(it->first, it->second);
+        if (tile_size > shadowed_light.m_tile_size || tile_size * 2 < shadowed_light.m_tile_size)
+        {
+            FreeShadowedLight(slot);
+            continue;
+        }
+
+        shadowed_light.m_coverage = it->second;
+        selected.erase(it);
+    }
+
+    /* The new lights, the biggest ones first, get smaller tiles when the atlas is full. */
+    std::vector<Candidate> new_lights;
+    for (const auto& [light, coverage] : selected)
+    {
+        new_lights.emplace_back(coverage, light);
+    }
+    std::sort(new_lights.begin(), new_lights.end(), std::greater<Candidate>());
+
+    uint32_t free_slot = 0;
+    for (const auto& [coverage, light] : new_lights)
+    {
+        while (free_slot < MAX_SHADOWED_LIGHTS && m_shadowed_lights[free_slot].m_light != NO_LIGHT_SHADOW)
+        {
+            ++free_slot;
+        }
+
+        if (free_slot == MAX_SHADOWED_LIGHTS)
+        {
+            break;
+        }
+
+        ShadowedLight& shadowed_light = m_shadowed_lights[free_slot];
+        shadowed_light.m_faces_count  = light < points_count ? 6 : 1;
+        shadowed_light.m_coverage     = coverage;
+
+        for (uint32_t tile_size = getTileSize(light, coverage); tile_size >= ShadowAtlas::MIN_TILE_SIZE; tile_size /= 2)
+        {
+            uint32_t allocated_count = 0;
+            while (allocated_count < shadowed_light.m_faces_count && m_shadow_atlas->Allocate(tile_size, shadowed_light.m_tiles[allocated_count]))
+            {
+                ++allocated_count;
+            }
+
+            if (allocated_count == shadowed_light.m_faces_count)
+            {
+                shadowed_light.m_light     = light;
+                shadowed_light.m_tile_size = tile_size;
+                break;
+            }
+
+            for (uint32_t i = 0; i < allocated_count; ++i)
+            {
+                m_shadow_atlas->Free(tile_size, shadowed_light.m_tiles[i]);
+            }
+        }
+
+        /* No room even for the smallest tiles, the smaller lights won't fit either. */
+        if (shadowed_light.m_light == NO_LIGHT_SHADOW)
+        {
+            break;
+        }
+    }
+
+    /* The new tiles and the moved lights, the biggest ones first, as long as the budget of faces lasts. */
+    std::vector<Candidate> outdated;
+    for (uint32_t slot = 0; slot < MAX_SHADOWED_LIGHTS; ++slot)
+    {
+        const ShadowedLight& shadowed_light = m_shadowed_lights[slot];
+
+        if (shadowed_light.m_light == NO_LIGHT_SHADOW)
+        {
+            continue;
+        }
+
+        glm::vec4 sphere, cone;
+        GetShadowedLightPose(shadowed_light.m_light, sphere, cone);
+
+        if (!shadowed_light.m_is_rendered || sphere != shadowed_light.m_rendered_sphere || cone != shadowed_light.m_rendered_cone)
+        {
+            outdated.emplace_back(shadowed_light.m_coverage, slot);
+        }
+    }
+    std::sort(outdated.begin(), outdated.end(), std::greater<Candidate>());
+
+    static const glm::vec3 directions[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1,  0 }, { 0, 0, 1 }, { 0,  0, -1 } };
+    static const glm::vec3 ups       [6] = { { 0, -1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0,  0, -1 }, { 0, -1, 0 }, { 0, -1,  0 } };
+
+    for (const auto& [coverage, slot] : outdated)
+    {
+        ShadowedLight& shadowed_light = m_shadowed_lights[slot];
+
+        if (m_shadow_faces_rendered + shadowed_light.m_faces_count > m_shadow_faces_budget)
+        {
+            continue;
+        }
+
+        glm::vec4 sphere, cone;
+        GetShadowedLightPose(shadowed_light.m_light, sphere, cone);
+
+        const glm::vec3 position = glm::vec3(sphere);
+        const float     near_z   = glm::max(0.01f * sphere.w, 0.01f);
+
+        LightShadow& light_shadow = m_light_shadows[slot];
+
+        for (uint32_t face = 0; face < shadowed_light.m_faces_count; ++face)
+        {
+            if (shadowed_light.m_faces_count == 6)
+            {
+                light_shadow.view_projections[face] = glm::perspective(glm::radians(90.0f), 1.0f, near_z, sphere.w) * glm::lookAt(position, position + directions[face], ups[face]);
+            }
+            else
+            {
+                const glm::vec3 direction = glm::vec3(cone);
+                const glm::vec3 up        = glm::abs(direction.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+                light_shadow.view_projections[face] = glm::perspective(2.0f * cone.w, 1.0f, near_z, sphere.w) * glm::lookAt(position, position + direction, up);
+            }
+
+            light_shadow.atlas_rects[face] = glm::vec4(glm::vec2(shadowed_light.m_tiles[face]), glm::vec2(shadowed_light.m_tile_size)) / float(ShadowAtlas::SIZE);
+        }
+
+        glNamedBufferSubData(m_light_shadows_ssbo, sizeof(LightShadow) * slot, sizeof(LightShadow), &light_shadow);
+
+        /* The shader sees a new tile only once it has been rendered. */
+        if (!shadowed_light.m_is_rendered)
+        {
+            shadowed_light.m_is_rendered = true;
+            SetLightShadowPointer(shadowed_light.m_light, slot);
+        }
+
+        shadowed_light.m_rendered_sphere = sphere;
+        shadowed_light.m_rendered_cone   = cone;
+
+        m_shadows_to_render.push_back(slot);
+        m_shadow_faces_rendered += shadowed_light.m_faces_count;
+    }
+}
+
+void ClusteredShading::ResetLightShadows()
+{
+    for (auto& shadowed_light : m_shadowed_lights)
+    {
+        shadowed_light = ShadowedLight();
+    }
+    m_shadow_atlas->Reset();
+    m_shadows_to_render.clear();
+
+    /* The lights are new, none of them has a shadow. */
+    const std::vector<uint32_t> point_light_shadows(glm::max(m_point_lights.size(), size_t(1)), NO_LIGHT_SHADOW);
+    const std::vector<uint32_t> spot_light_shadows (glm::max(m_spot_lights.size(),  size_t(1)), NO_LIGHT_SHADOW);
+
+    glNamedBufferData(m_point_light_shadows_ssbo, sizeof(uint32_t) * point_light_shadows.size(), point_light_shadows.data(), GL_DYNAMIC_DRAW);
+    glNamedBufferData(m_spot_light_shadows_ssbo,  sizeof(uint32_t) * spot_light_shadows.size(),  spot_light_shadows.data(),  GL_DYNAMIC_DRAW);
+}
+
+void ClusteredShading::FreeShadowedLight(uint32_t slot)
+{
+    ShadowedLight& shadowed_light = m_shadowed_lights[slot];
+
+    if (shadowed_light.m_is_rendered)
+    {
+        SetLightShadowPointer(shadowed_light.m_light, NO_LIGHT_SHADOW);
+    }
+
+    for (uint32_t i = 0; i < shadowed_light.m_faces_count; ++i)
+    {
+        m_shadow_atlas->Free(shadowed_light.m_tile_size, shadowed_light.m_tiles[i]);
+    }
+
+    shadowed_light = ShadowedLight();
+}
+
+void ClusteredShading::SetLightShadowPointer(uint32_t light, uint32_t slot)
+{
+    const uint32_t points_count = uint32_t(m_point_lights.size());
+
+    if (light < points_count)
+    {
+        glNamedBufferSubData(m_point_light_shadows_ssbo, sizeof(uint32_t) * light, sizeof(uint32_t), &slot);
+    }
+    else
+    {
+        glNamedBufferSubData(m_spot_light_shadows_ssbo, sizeof(uint32_t) * (light - points_count), sizeof(uint32_t), &slot);
+    }
+}
+
+void ClusteredShading::GetShadowedLightPose(uint32_t light, glm::vec4& sphere, glm::vec4& cone) const
+{
+    const uint32_t points_count = uint32_t(m_point_lights.size());
+
+    /* The dynamic lights as AnimateDynamicLights() wrote them for the slot copied last. */
+    auto animate = [this](glm::vec3& position, const glm::vec4& e)
+    {
+        position.x = e.x * glm::cos(m_uploaded_lights_time * e.z);
+        position.z = e.y * glm::sin(m_uploaded_lights_time * e.z);
+    };
+
+    if (light < points_count)
+    {
+        glm::vec3 position = m_point_lights[light].position;
+
+        if (m_are_uploaded_lights_animated && light >= m_static_lights_counts.x)
+        {
+            animate(position, m_point_lights_ellipses_radii[light]);
+        }
+
+        sphere = glm::vec4(position, m_point_lights[light].radius);
+        cone   = glm::vec4(0.0f);
+    }
+    else
+    {
+        const uint32_t   spot_light = light - points_count;
+        const SpotLight& spot       = m_spot_lights[spot_light];
+        glm::vec3        position   = spot.point.position;
+
+        if (m_are_uploaded_lights_animated && spot_light >= m_static_lights_counts.y)
+        {
+            animate(position, m_spot_lights_ellipses_radii[spot_light]);
+        }
+
+        sphere = glm::vec4(position,       spot.point.radius);
+        cone   = glm::vec4(spot.direction, spot.outer_angle);
+    }
+}
+
+void ClusteredShading::render()
+{
+    using Access = RGL::RenderGraph::Access;
+
+    static const uint32_t clear_val = 0;
+
+    /* The clusters generated again if the projection or the resolution changed. */
+    UpdateMainClusterGrid();
+
+    /* The index lists sized for what the culling needed a frame or two ago. */
+    ReadLightListsFeedback();
+
+    /* The id under the cursor of the frame the last click was in. */
+    m_object_picking.Update();
+
+    /* The shadowed lights and the shadows rendered this frame. */
+    UpdateLightShadows();
+
+    /* The barriers between the passes come from the accesses they declare. */
+    m_tmo_ps->acquire();
+
+    /* The pool hands back the last frame's target, its color is still there until the lighting clears it. */
+    m_variable_rate_shading.Update(*m_tmo_ps->m_rt, m_tmo_ps->m_rt->GetWidth(), m_tmo_ps->m_rt->GetHeight());
+
+    auto depth           = m_render_graph.ImportTexture(m_depth_tex2D_id);
+    auto hdr             = m_render_graph.ImportTexture(m_tmo_ps->m_rt->GetColorTexture());
+    auto clusters_flags  = m_render_graph.ImportBuffer (m_clusters_flags_ssbo);
+    auto unique_clusters = m_render_graph.ImportBuffer (m_unique_active_clusters_ssbo);
+    auto dispatch_args   = m_render_graph.ImportBuffer (m_cull_lights_dispatch_args_ssbo);
+    auto shadow_atlas    = m_render_graph.ImportTexture(m_shadow_atlas->GetTexture());
+    auto visibility      = m_render_graph.ImportTexture(m_visibility_tex2D_id);
+
+    const bool is_visibility_buffer = m_shading_mode == ShadingMode::VISIBILITY_BUFFER;
+
+    if (is_visibility_buffer)
+    {
+        m_visibility_shader->bind();
+    }
+
+    const GLuint light_lists_ssbos[] = { m_point_light_grid_ssbo, m_point_light_index_list_ssbo,
+                                         m_spot_light_grid_ssbo,  m_spot_light_index_list_ssbo,
+                                         m_area_light_grid_ssbo,  m_area_light_index_list_ssbo };
+
+    // 1. Depth(Z) pre-pass, or the visibility buffer and its depth, and blit depth info to tmo_ps framebuffer
+    if (is_visibility_buffer)
+    {
+        m_render_graph.AddPass("Visibility buffer", [this](RGL::RenderGraph&)
+        {
+            renderVisibilityPass();
+
+            /* The draw index + 1 of the visibility buffer is the same id as the depth pre-pass writes. */
+            m_object_picking.ReadPick(m_visibility_tex2D_id);
+
+            glBlitNamedFramebuffer(m_visibility_fbo_id, m_tmo_ps->m_rt->GetFramebuffer(),
+                                   0, 0, Window::getWidth(), Window::getHeight(),
+                                   0, 0, Window::getWidth(), Window::getHeight(), GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        })
+        .Write(depth,      Access::FRAMEBUFFER)
+        .Write(visibility, Access::FRAMEBUFFER)
+        .Write(hdr,        Access::FRAMEBUFFER);
+    }
+    else
+    {
+        m_render_graph.AddPass("Depth pre-pass", [this](RGL::RenderGraph&)
+        {
+            renderDepthPass();
+
+            if (m_is_picking_enabled)
+            {
+                m_object_picking.ReadPick();
+            }
+
+            glBlitNamedFramebuffer(m_depth_pass_fbo_id, m_tmo_ps->m_rt->GetFramebuffer(), 
+                                   0, 0, Window::getWidth(), Window::getHeight(),
+                                   0, 0, Window::getWidth(), Window::getHeight(), GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        })
+        .Write(depth, Access::FRAMEBUFFER)
+        .Write(hdr,   Access::FRAMEBUFFER);
+    }
+
+    // 1a. The min and max depth pyramid, once for all the passes that read it - they import m_depth_pyramid.GetTexture()
+    m_depth_pyramid.AddPass(m_render_graph, depth, m_depth_tex2D_id);
+
+    // 1b. The shadows of the new tiles and of the lights that moved, the others stay in the atlas
+    if (!m_shadows_to_render.empty())
+    {
+        m_render_graph.AddPass("Shadow atlas", [this](RGL::RenderGraph&)
+        {
+            renderLightShadows();
+        })
+        .Write(shadow_atlas, Access::FRAMEBUFFER);
+    }
+
+    const bool is_zbinning = m_light_assignment == LightAssignment::ZBINS;
+
+    // 2.-4. The clusters that have samples, the Z-bins don't need them
+    if (!is_zbinning)
+    {
+        /* The fog is lit in front of the geometry too, where no cluster has samples. */
+        const bool is_all_clusters = m_cluster_selection == ClusterSelection::ALL || m_fog_enabled;
+
+        // 2. Find visible clusters, all of them are used otherwise
+        if (!is_all_clusters)
+        {
+            m_render_graph.AddPass("Find visible clusters", [this](RGL::RenderGraph&)
+            {
+                glClearNamedBufferData(m_clusters_flags_ssbo, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &clear_val);
+
+                m_find_visible_clusters_shader->bind();
+                m_find_visible_clusters_shader->setUniform("u_near_z",          m_camera->NearPlane());
+                m_find_visible_clusters_shader->setUniform("u_far_z",           m_camera->FarPlane());
+                m_find_visible_clusters_shader->setUniform("u_log_grid_dim_y",  m_log_grid_dim_y);
+                m_find_visible_clusters_shader->setUniform("u_cluster_size_ss", glm::uvec2(m_cluster_grid_block_size));
+                m_find_visible_clusters_shader->setUniform("u_grid_dim",        m_cluster_grid_dim);
+    
+                glBindTextureUnit(0, m_depth_tex2D_id);
+                glDispatchCompute(glm::ceil(RGL::Window::getWidth() / 32.0f), glm::ceil(RGL::Window::getHeight() / 32.0f), 1);
+            })
+            .Read (depth,          Access::TEXTURE)
+            .Write(clusters_flags, Access::TRANSFER)
+            .Write(clusters_flags, Access::STORAGE);
+        }
+
+        // 2b. The clusters of the transparent bounds
+        if (m_cluster_selection == ClusterSelection::VISIBLE_AND_TRANSPARENT)
+        {
+            /* The box the lights move in stands for the transparent geometry of the demo. */
+            m_transparent_bounds = { ClusterAABB{ glm::vec4(min_lights_bounds, 1.0f), glm::vec4(max_lights_bounds, 1.0f) } };
+
+            m_render_graph.AddPass("Mark transparent bounds", [this](RGL::RenderGraph&)
+            {
+                glNamedBufferData(m_transparent_bounds_ssbo, sizeof(ClusterAABB) * m_transparent_bounds.size(), m_transparent_bounds.data(), GL_DYNAMIC_DRAW);
+
+                m_mark_cluster_bounds_shader->bind();
+                m_mark_cluster_bounds_shader->setUniform("u_view",            m_camera->m_view);
+                m_mark_cluster_bounds_shader->setUniform("u_projection",      m_camera->m_projection);
+                m_mark_cluster_bounds_shader->setUniform("u_near_z",          m_camera->NearPlane());
+                m_mark_cluster_bounds_shader->setUniform("u_far_z",           m_camera->FarPlane());
+                m_mark_cluster_bounds_shader->setUniform("u_log_grid_dim_y",  m_log_grid_dim_y);
+                m_mark_cluster_bounds_shader->setUniform("u_cluster_size_ss", glm::uvec2(m_cluster_grid_block_size));
+                m_mark_cluster_bounds_shader->setUniform("u_grid_dim",        m_cluster_grid_dim);
+                m_mark_cluster_bounds_shader->setUniform("u_screen_size",     glm::vec2(Window::getWidth(), Window::getHeight()));
+                glDispatchCompute(GLuint(m_transparent_bounds.size()), 1, 1);
+            })
+            .Read (clusters_flags, Access::STORAGE)
+            .Write(clusters_flags, Access::STORAGE);
+        }
+
+        // 3. Find unique clusters
+        m_render_graph.AddPass("Find unique clusters", [this, is_all_clusters](RGL::RenderGraph&)
+        {
+            glClearNamedBufferData(m_unique_active_clusters_ssbo, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &clear_val);
+
+            m_find_unique_clusters_shader->bind();
+            m_find_unique_clusters_shader->setUniform("u_all_clusters",    is_all_clusters);
+            m_find_unique_clusters_shader->setUniform("u_clusters_count",  uint32_t(m_clusters_count));
+            glDispatchCompute(glm::ceil(m_clusters_count / 1024.0f), 1, 1);
+        })
+        .Read (clusters_flags,  Access::STORAGE)
+        .Write(unique_clusters, Access::TRANSFER)
+        .Write(unique_clusters, Access::STORAGE);
+
+        // 4. Update the indirect dispatch arguments buffer
+        m_render_graph.AddPass("Update cull lights args", [this](RGL::RenderGraph&)
+        {
+            m_update_cull_lights_indirect_args_shader->bind();
+            glDispatchCompute(1, 1, 1);
+        })
+        .Read (unique_clusters, Access::STORAGE)
+        .Write(dispatch_args,   Access::STORAGE);
+    }
+
+    // 5. Sort the lights by the Morton codes of their view space centers and build the BVH over them,
+    //    or by their view depth for the Z-bins
+    const uint32_t lights_count = GetLightsCount();
+
+    auto light_spheres        = m_render_graph.ImportBuffer(m_light_spheres_ssbo);
+    auto sorted_light_spheres = m_render_graph.ImportBuffer(m_sorted_light_spheres_ssbo);
+    auto histogram            = m_render_graph.ImportBuffer(m_radix_sort_histogram_ssbo);
+    auto light_bvh_nodes      = m_render_graph.ImportBuffer(m_light_bvh_nodes_ssbo);
+
+    RGL::RenderGraph::Resource light_keys   [2] = { m_render_graph.ImportBuffer(m_light_keys_ssbos[0]),    m_render_graph.ImportBuffer(m_light_keys_ssbos[1])    };
+    RGL::RenderGraph::Resource light_indices[2] = { m_render_graph.ImportBuffer(m_light_indices_ssbos[0]), m_render_graph.ImportBuffer(m_light_indices_ssbos[1]) };
+
+    if (lights_count > 0)
+    {
+        const uint32_t blocks_count = (lights_count + RADIX_SORT_BLOCK_SIZE - 1) / RADIX_SORT_BLOCK_SIZE;
+
+        m_render_graph.AddPass("Light sort keys", [this, lights_count, is_zbinning](RGL::RenderGraph&)
+        {
+            /* The box the lights move in, the ellipses are centered at the origin. */
+            const glm::vec3 extent = glm::max(glm::abs(min_lights_bounds), glm::abs(max_lights_bounds));
+            const glm::vec3 min    = glm::vec3(-extent.x, min_lights_bounds.y, -extent.z);
+            const glm::vec3 max    = glm::vec3( extent.x, max_lights_bounds.y,  extent.z);
+
+            glm::vec3 view_min = glm::vec3( FLT_MAX);
+            glm::vec3 view_max = glm::vec3(-FLT_MAX);
+
+            for (uint32_t i = 0; i < 8; ++i)
+            {
+                const glm::vec3 corner = glm::vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+                const glm::vec3 view   = glm::vec3(m_camera->m_view * glm::vec4(corner, 1.0f));
+
+                view_min = glm::min(view_min, view);
+                view_max = glm::max(view_max, view);
+            }
+
+            m_light_sort_keys_shader->bind();
+            m_light_sort_keys_shader->setUniform("u_view_matrix",       m_camera->m_view);
+            m_light_sort_keys_shader->setUniform("u_lights_count",      lights_count);
+            m_light_sort_keys_shader->setUniform("u_depth_keys",        is_zbinning);
+            m_light_sort_keys_shader->setUniform("u_bounds_min",        view_min);
+            m_light_sort_keys_shader->setUniform("u_bounds_inv_extent", 1.0f / glm::max(view_max - view_min, glm::vec3(1e-4f)));
+            m_light_sort_keys_shader->setUniform("u_area_light_cutoff", m_area_light_cutoff);
+            glDispatchCompute(glm::ceil(lights_count / 1024.0f), 1, 1);
+        })
+        .Write(light_spheres,    Access::STORAGE)
+        .Write(light_keys[0],    Access::STORAGE)
+        .Write(light_indices[0], Access::STORAGE);
+
+        // The LSD radix sort, a digit per pass, from and to the halves of the ping-pong - the even count of the passes ends in [0]
+        for (uint32_t pass = 0; pass < RADIX_SORT_PASSES_COUNT; ++pass)
+        {
+            const uint32_t src   = pass & 1;
+            const uint32_t dst   = src ^ 1;
+            const uint32_t shift = pass * RADIX_SORT_DIGIT_BITS;
+
+            m_render_graph.AddPass("Radix sort histogram", [this, src, shift, lights_count, blocks_count](RGL::RenderGraph&)
+            {
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RADIX_SORT_KEYS_IN_SSBO_BINDING_INDEX, m_light_keys_ssbos[src]);
+
+                m_radix_sort_histogram_shader->bind();
+                m_radix_sort_histogram_shader->setUniform("u_keys_count", lights_count);
+                m_radix_sort_histogram_shader->setUniform("u_shift",      shift);
+                glDispatchCompute(blocks_count, 1, 1);
+            })
+            .Read (light_keys[src], Access::STORAGE)
+            .Write(histogram,       Access::STORAGE);
+
+            m_render_graph.AddPass("Radix sort scan", [this, blocks_count](RGL::RenderGraph&)
+            {
+                m_radix_sort_scan_shader->bind();
+                m_radix_sort_scan_shader->setUniform("u_histogram_size", blocks_count * RADIX_SORT_BINS_COUNT);
+                glDispatchCompute(1, 1, 1);
+            })
+            .Read (histogram, Access::STORAGE)
+            .Write(histogram, Access::STORAGE);
+
+            m_render_graph.AddPass("Radix sort scatter", [this, src, dst, shift, lights_count, blocks_count](RGL::RenderGraph&)
+            {
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RADIX_SORT_KEYS_IN_SSBO_BINDING_INDEX,    m_light_keys_ssbos   [src]);
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RADIX_SORT_VALUES_IN_SSBO_BINDING_INDEX,  m_light_indices_ssbos[src]);
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RADIX_SORT_KEYS_OUT_SSBO_BINDING_INDEX,   m_light_keys_ssbos   [dst]);
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RADIX_SORT_VALUES_OUT_SSBO_BINDING_INDEX, m_light_indices_ssbos[dst]);
+
+                m_radix_sort_scatter_shader->bind();
+                m_radix_sort_scatter_shader->setUniform("u_keys_count", lights_count);
+                m_radix_sort_scatter_shader->setUniform("u_shift",      shift);
+                glDispatchCompute(blocks_count, 1, 1);
+            })
+            .Read (light_keys   [src], Access::STORAGE)
+            .Read (light_indices[src], Access::STORAGE)
+            .Read (histogram,          Access::STORAGE)
+            .Write(light_keys   [dst], Access::STORAGE)
+            .Write(light_indices[dst], Access::STORAGE);
+        }
+
+        // A level per pass, bottom up, each one reads the nodes of the previous one
+        if (!is_zbinning)
+        {
+            for (uint32_t level = 0; level < m_light_bvh_levels.size(); ++level)
+            {
+                const glm::uvec2 nodes    = m_light_bvh_levels[level];
+                const glm::uvec2 children = level > 0 ? m_light_bvh_levels[level - 1] : glm::uvec2(0, lights_count);
+
+                auto build_pass = m_render_graph.AddPass("Build light BVH", [this, level, nodes, children](RGL::RenderGraph&)
+                {
+                    m_build_light_bvh_shader->bind();
+                    m_build_light_bvh_shader->setUniform("u_is_leaf_level",    level == 0);
+                    m_build_light_bvh_shader->setUniform("u_children_offset",  children.x);
+                    m_build_light_bvh_shader->setUniform("u_children_count",   children.y);
+                    m_build_light_bvh_shader->setUniform("u_nodes_offset",     nodes.x);
+                    m_build_light_bvh_shader->setUniform("u_nodes_count",      nodes.y);
+                    glDispatchCompute(glm::ceil(nodes.y / 256.0f), 1, 1);
+                });
+
+                if (level == 0)
+                {
+                    build_pass.Read (light_spheres,        Access::STORAGE)
+                              .Read (light_indices[0],     Access::STORAGE)
+                              .Write(sorted_light_spheres, Access::STORAGE);
+                }
+                else
+                {
+                    build_pass.Read(light_bvh_nodes, Access::STORAGE);
+                }
+
+                build_pass.Write(light_bvh_nodes, Access::STORAGE);
+            }
+        }
+    }
+
+    // 6. Assign lights to clusters (cull lights), the clusters traverse the light BVH,
+    //    or to the Z-bins and the tiles
+    std::vector<RGL::RenderGraph::Resource> light_assignment;
+
+    if (is_zbinning)
+    {
+        auto zbins            = m_render_graph.ImportBuffer(m_zbins_ssbo);
+        auto tile_light_masks = m_render_graph.ImportBuffer(m_tile_light_masks_ssbo);
+
+        m_render_graph.AddPass("Assign lights to Z-bins", [this, lights_count](RGL::RenderGraph&)
+        {
+            static const glm::uvec2 empty_zbin = glm::uvec2(0xFFFFFFFF, 0);
+
+            glClearNamedBufferData(m_zbins_ssbo,            GL_RG32UI, GL_RG_INTEGER,  GL_UNSIGNED_INT,  &empty_zbin);
+            glClearNamedBufferData(m_tile_light_masks_ssbo, GL_R32UI,  GL_RED_INTEGER, GL_UNSIGNED_BYTE, &clear_val);
+
+            const uint32_t zbin_lights_count = glm::min(lights_count, uint32_t(ZBIN_MAX_LIGHTS));
+
+            m_assign_lights_zbins_shader->bind();
+            m_assign_lights_zbins_shader->setUniform("u_lights_count", zbin_lights_count);
+            m_assign_lights_zbins_shader->setUniform("u_projection",   m_camera->m_projection);
+            m_assign_lights_zbins_shader->setUniform("u_near_z",       m_camera->NearPlane());
+            m_assign_lights_zbins_shader->setUniform("u_far_z",        m_camera->FarPlane());
+            m_assign_lights_zbins_shader->setUniform("u_tiles_dim",    glm::uvec2(m_cluster_grid_dim));
+            m_assign_lights_zbins_shader->setUniform("u_tile_size_ss", glm::uvec2(m_cluster_grid_block_size));
+            m_assign_lights_zbins_shader->setUniform("u_screen_size",  glm::vec2(Window::getWidth(), Window::getHeight()));
+            glDispatchCompute(glm::ceil(zbin_lights_count / 256.0f), 1, 1);
+        })
+        .Read (light_spheres,    Access::STORAGE)
+        .Read (light_indices[0], Access::STORAGE)
+        .Write(zbins,            Access::TRANSFER)
+        .Write(zbins,            Access::STORAGE)
+        .Write(tile_light_masks, Access::TRANSFER)
+        .Write(tile_light_masks, Access::STORAGE);
+
+        light_assignment = { light_indices[0], zbins, tile_light_masks };
+    }
+    else
+    {
+        auto feedback = m_render_graph.ImportBuffer(m_light_lists_feedback_ssbo);
+
+        auto cull_lights_pass = m_render_graph.AddPass("Cull lights", [this, light_lists_ssbos, lights_count](RGL::RenderGraph&)
+        {
+            for (GLuint ssbo : light_lists_ssbos)
+            {
+                glClearNamedBufferData(ssbo, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &clear_val);
+            }
+            glClearNamedBufferData(m_light_lists_feedback_ssbo, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &clear_val);
+
+            m_cull_lights_shader->bind();
+            m_cull_lights_shader->setUniform("u_lights_count",      lights_count);
+            m_cull_lights_shader->setUniform("u_use_subgroups",     m_use_subgroups);
+            m_cull_lights_shader->setUniform("u_view_matrix",       m_camera->m_view);
+            m_cull_lights_shader->setUniform("u_area_light_cutoff", m_area_light_cutoff);
+
+            glBindBuffer             (GL_DISPATCH_INDIRECT_BUFFER, m_cull_lights_dispatch_args_ssbo);
+            glDispatchComputeIndirect(0);
+        });
+        cull_lights_pass.Read(dispatch_args,        Access::INDIRECT)
+                        .Read(unique_clusters,      Access::STORAGE)
+                        .Read(light_indices[0],     Access::STORAGE)
+                        .Read(sorted_light_spheres, Access::STORAGE)
+                        .Read(light_bvh_nodes,      Access::STORAGE)
+                        .Write(feedback,            Access::TRANSFER)
+                        .Write(feedback,            Access::STORAGE);
+
+        // The copy is read by ReadLightListsFeedback() once its fence is signaled, the frame doesn't wait for it
+        m_render_graph.AddPass("Light lists feedback", [this](RGL::RenderGraph&)
+        {
+            GLsync& fence = m_light_lists_fences[m_light_lists_readback_slot];
+
+            /* Not read yet, it's too late now. */
+            if (fence)
+            {
+                glDeleteSync(fence);
+            }
+
+            glCopyNamedBufferSubData(m_light_lists_feedback_ssbo, m_light_lists_readback_buffer, 0, sizeof(LightListsFeedback) * m_light_lists_readback_slot, sizeof(LightListsFeedback));
+
+            fence                       = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            m_light_lists_readback_slot = (m_light_lists_readback_slot + 1) % FEEDBACK_FRAMES;
+        })
+        .Read(feedback, Access::TRANSFER)
+        .SetSideEffects();
+
+        for (GLuint ssbo : light_lists_ssbos)
+        {
+            auto light_list = m_render_graph.ImportBuffer(ssbo);
+
+            cull_lights_pass.Write(light_list, Access::TRANSFER)
+                            .Write(light_list, Access::STORAGE);
+
+            light_assignment.push_back(light_list);
+        }
+    }
+
+    // 6b. Light the fog's froxels from the same light lists and integrate them along the view rays
+    auto fog_froxels            = m_render_graph.ImportTexture(m_fog_froxels_tex3D_id);
+    auto fog_integrated_froxels = m_render_graph.ImportTexture(m_fog_integrated_tex3D_id);
+
+    if (m_fog_enabled)
+    {
+        auto fog_inject_pass = m_render_graph.AddPass("Fog injection", [this](RGL::RenderGraph&)
+        {
+            m_fog_inject_shader->bind();
+            bindClusteredLighting(m_fog_inject_shader);
+
+            m_fog_inject_shader->setUniform("u_inverse_view",       m_camera->inverseView());
+            m_fog_inject_shader->setUniform("u_inverse_projection", m_camera->inverseProjection());
+            m_fog_inject_shader->setUniform("u_screen_size",        glm::vec2(Window::getWidth(), Window::getHeight()));
+            m_fog_inject_shader->setUniform("u_fog_start_z",        m_fog_start_z);
+            m_fog_inject_shader->setUniform("u_fog_end_z",          m_fog_end_z);
+            m_fog_inject_shader->setUniform("u_fog_density",        m_fog_density);
+            m_fog_inject_shader->setUniform("u_fog_height_falloff", m_fog_height_falloff);
+            m_fog_inject_shader->setUniform("u_fog_base_height",    m_fog_base_height);
+            m_fog_inject_shader->setUniform("u_fog_noise_scale",    m_fog_noise_scale);
+            m_fog_inject_shader->setUniform("u_fog_noise_amount",   m_fog_noise_amount);
+            m_fog_inject_shader->setUniform("u_fog_noise_offset",   m_fog_noise_offset);
+            m_fog_inject_shader->setUniform("u_fog_albedo",         m_fog_albedo);
+            m_fog_inject_shader->setUniform("u_fog_anisotropy",     m_fog_anisotropy);
+            m_fog_inject_shader->setUniform("u_fog_ambient",        m_fog_ambient);
+
+            glBindTextureUnit (FOG_NOISE_TEXTURE_BINDING_INDEX, m_fog_noise_tex3D_id);
+            glBindImageTexture(0, m_fog_froxels_tex3D_id, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+            glDispatchCompute((FOG_FROXELS_X + FOG_INJECT_GROUP_SIZE - 1) / FOG_INJECT_GROUP_SIZE,
+                              (FOG_FROXELS_Y + FOG_INJECT_GROUP_SIZE - 1) / FOG_INJECT_GROUP_SIZE,
+                              (FOG_FROXELS_Z + FOG_INJECT_GROUP_SIZE - 1) / FOG_INJECT_GROUP_SIZE);
+        });
+        fog_inject_pass.Read (shadow_atlas, Access::TEXTURE)
+                       .Write(fog_froxels,  Access::IMAGE);
+
+        for (auto resource : light_assignment)
+        {
+            fog_inject_pass.Read(resource, Access::STORAGE);
+        }
+
+        m_render_graph.AddPass("Fog integration", [this](RGL::RenderGraph&)
+        {
+            m_fog_integrate_shader->bind();
+            m_fog_integrate_shader->setUniform("u_inverse_projection", m_camera->inverseProjection());
+            m_fog_integrate_shader->setUniform("u_fog_start_z",        m_fog_start_z);
+            m_fog_integrate_shader->setUniform("u_fog_end_z",          m_fog_end_z);
+
+            glBindTextureUnit (FOG_FROXELS_TEXTURE_BINDING_INDEX, m_fog_froxels_tex3D_id);
+            glBindImageTexture(0, m_fog_integrated_tex3D_id, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+            glDispatchCompute((FOG_FROXELS_X + FOG_INTEGRATE_GROUP_SIZE - 1) / FOG_INTEGRATE_GROUP_SIZE,
+                              (FOG_FROXELS_Y + FOG_INTEGRATE_GROUP_SIZE - 1) / FOG_INTEGRATE_GROUP_SIZE,
+                              1);
+        })
+        .Read (fog_froxels,            Access::TEXTURE)
+        .Write(fog_integrated_froxels, Access::IMAGE);
+    }
+
+    // 7. Render lighting, or shade every pixel of the visibility buffer once
+    auto lighting_pass = m_render_graph.AddPass("Lighting", [this, is_visibility_buffer](RGL::RenderGraph&)
+    {
+        if (is_visibility_buffer)
+        {
+            renderVisibilityResolve();
+        }
+        else
+        {
+            renderLighting();
+        }
+    });
+    lighting_pass.Read(shadow_atlas, Access::TEXTURE);
+
+    if (is_visibility_buffer)
+    {
+        lighting_pass.Read (visibility, Access::TEXTURE)
+                     .Write(hdr,        Access::IMAGE);
+    }
+    else
+    {
+        lighting_pass.Write(hdr, Access::FRAMEBUFFER);
+    }
+
+    for (auto resource : light_assignment)
+    {
+        lighting_pass.Read(resource, Access::STORAGE);
+    }
+
+    // 8. Render area lights geometry and skybox
+    m_render_graph.AddPass("Area lights and skybox", [this](RGL::RenderGraph&)
+    {
+        m_draw_area_lights_geometry_shader->bind();
+        m_draw_area_lights_geometry_shader->setUniform("u_view_projection", m_camera->viewProjection());
+        glDrawArrays(GL_TRIANGLES, 0, 6 * m_area_lights.size());
+
+        m_skybox.Render(m_ibl, m_camera->m_projection, m_camera->m_view, m_background_blur);
+    })
+    .Write(hdr, Access::FRAMEBUFFER);
+
+    // 8b. The fog in front of the geometry and the sky
+    if (m_fog_enabled)
+    {
+        m_render_graph.AddPass("Fog", [this](RGL::RenderGraph&)
+        {
+            m_fog_apply_shader->bind();
+            m_fog_apply_shader->setUniform("u_inverse_projection", m_camera->inverseProjection());
+            m_fog_apply_shader->setUniform("u_screen_size",        glm::uvec2(Window::getWidth(), Window::getHeight()));
+            m_fog_apply_shader->setUniform("u_fog_start_z",        m_fog_start_z);
+            m_fog_apply_shader->setUniform("u_fog_end_z",          m_fog_end_z);
+
+            glBindTextureUnit(FOG_FROXELS_TEXTURE_BINDING_INDEX, m_fog_integrated_tex3D_id);
+            glBindTextureUnit(FOG_DEPTH_TEXTURE_BINDING_INDEX,   m_depth_tex2D_id);
+            m_tmo_ps->m_rt->BindColorImage(IMAGE_UNIT_WRITE, 0, GL_READ_WRITE);
+
+            glDispatchCompute(glm::ceil(Window::getWidth() / float(FOG_APPLY_GROUP_SIZE)), glm::ceil(Window::getHeight() / float(FOG_APPLY_GROUP_SIZE)), 1);
+        })
+        .Read (fog_integrated_froxels, Access::TEXTURE)
+        .Read (depth,                  Access::TEXTURE)
+        .Read (hdr,                    Access::IMAGE)
+        .Write(hdr,                    Access::IMAGE);
+    }
+
+    // 9. Bloom: the downscale in a single pass, up to SINGLE_PASS_MIPS mips, then a pass per mip, each one reads what the previous one wrote
+    if (m_bloom_enabled)
+    {
+        const uint32_t levels_count = m_tmo_ps->m_rt->GetLevelsCount();
+        const uint32_t width        = m_tmo_ps->m_rt->GetWidth();
+        const uint32_t height       = m_tmo_ps->m_rt->GetHeight();
+        const uint32_t first_level  = m_bloom_single_pass ? glm::min(levels_count - 1, PostprocessFilter::SINGLE_PASS_MIPS) : 0;
+
+        if (first_level > 0)
+        {
+            auto bloom_counter = m_render_graph.ImportBuffer(m_bloom_counter_buffer);
+
+            m_render_graph.AddPass("Bloom single pass downscale", [this, width, height, first_level](RGL::RenderGraph&)
+            {
+                const glm::uvec2 mip_size   = glm::max(glm::uvec2(width >> 1, height >> 1), glm::uvec2(1));
+                const glm::uvec2 workgroups = (mip_size + PostprocessFilter::SINGLE_PASS_TILE_SIZE - 1u) / PostprocessFilter::SINGLE_PASS_TILE_SIZE;
+
+                m_downscale_single_pass_shader->bind();
+                m_downscale_single_pass_shader->setUniform("u_threshold",        glm::vec4(m_threshold, m_threshold - m_knee, 2.0f * m_knee, 0.25f * m_knee));
+                m_downscale_single_pass_shader->setUniform("u_texel_size",       1.0f / glm::vec2(mip_size));
+                m_downscale_single_pass_shader->setUniform("u_mips_count",       int(first_level));
+                m_downscale_single_pass_shader->setUniform("u_workgroups_count", workgroups.x * workgroups.y);
+                m_tmo_ps->bindTexture();
+
+                for (uint32_t i = 0; i < first_level; ++i)
+                {
+                    m_tmo_ps->m_rt->BindColorImage(IMAGE_UNIT_WRITE + i, i + 1, GL_READ_WRITE);
+                }
+
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_bloom_counter_buffer);
+
+                glDispatchCompute(workgroups.x, workgroups.y, 1);
+            })
+            .Read (hdr,           Access::TEXTURE)
+            .Read (bloom_counter, Access::STORAGE)
+            .Write(bloom_counter, Access::STORAGE)
+            .Write(hdr,           Access::IMAGE);
+        }
+
+        for (uint32_t i = first_level; i < levels_count - 1; ++i)
+        {
+            const glm::uvec2 mip_size = glm::max(glm::uvec2(width >> (i + 1), height >> (i + 1)), glm::uvec2(1));
+
+            m_render_graph.AddPass("Bloom downscale", [this, i, mip_size](RGL::RenderGraph&)
+            {
+                m_downscale_shader->bind();
+                m_downscale_shader->setUniform("u_threshold",     glm::vec4(m_threshold, m_threshold - m_knee, 2.0f * m_knee, 0.25f * m_knee));
+                m_downscale_shader->setUniform("u_texel_size",    1.0f / glm::vec2(mip_size));
+                m_downscale_shader->setUniform("u_mip_level",     i);
+                m_downscale_shader->setUniform("u_use_threshold", i == 0);
+                m_tmo_ps->bindTexture();
+
+                m_tmo_ps->m_rt->BindColorImage(IMAGE_UNIT_WRITE, i + 1, GL_WRITE_ONLY);
+
+                glDispatchCompute(glm::ceil(float(mip_size.x) / 8), glm::ceil(float(mip_size.y) / 8), 1);
+            })
+            .Read (hdr, Access::TEXTURE)
+            .Write(hdr, Access::IMAGE);
+        }
+
+        for (uint32_t i = levels_count - 1; i >= 1; --i)
+        {
+            const glm::uvec2 mip_size = glm::max(glm::uvec2(width >> (i - 1), height >> (i - 1)), glm::uvec2(1));
+
+            m_render_graph.AddPass("Bloom upscale", [this, i, mip_size](RGL::RenderGraph&)
+            {
+                m_upscale_shader->bind();
+                m_upscale_shader->setUniform("u_bloom_intensity", m_bloom_intensity);
+                m_upscale_shader->setUniform("u_dirt_intensity",  m_bloom_dirt_intensity);
+                m_upscale_shader->setUniform("u_texel_size",      1.0f / glm::vec2(mip_size));
+                m_upscale_shader->setUniform("u_mip_level",       i);
+                m_tmo_ps->bindTexture();
+                m_bloom_dirt_texture->Bind(1);
+
+                m_tmo_ps->m_rt->BindColorImage(IMAGE_UNIT_WRITE, i - 1, GL_READ_WRITE);
+
+                glDispatchCompute(glm::ceil(float(mip_size.x) / 8), glm::ceil(float(mip_size.y) / 8), 1);
+            })
+            .Read (hdr, Access::TEXTURE)
+            .Read (hdr, Access::IMAGE)
+            .Write(hdr, Access::IMAGE);
+        }
+    }
+
+    // 10. Apply tone mapping
+    m_render_graph.AddPass("Tone mapping", [this](RGL::RenderGraph&)
+    {
+        m_tmo_ps->render(m_exposure, m_gamma);
+    })
+    .Read(hdr, Access::TEXTURE)
+    .SetSideEffects();
+
+    m_render_graph.Execute();
+}
+
+void ClusteredShading::renderDepthPass()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, m_depth_pass_fbo_id);
+    glClear          (GL_DEPTH_BUFFER_BIT);
+
+    glDepthMask(1);
+    glDepthFunc(GL_LESS);
+
+    /* The ids of the mesh draws go to the R32UI target, the pass stays depth only otherwise. */
+    auto& depth_only_shader = m_is_picking_enabled ? m_depth_only_picking_shader    : m_depth_only_shader;
+    auto& prepass_shader    = m_is_picking_enabled ? m_depth_prepass_picking_shader : m_depth_prepass_shader;
+
+    if (m_is_picking_enabled)
+    {
+        m_object_picking.Clear();
+        glColorMask(1, 1, 1, 1);
+    }
+    else
+    {
+        glColorMask(0, 0, 0, 0);
+    }
+
+    const glm::mat4 mvp = m_camera->viewProjection() * m_sponza_static_object.m_transform;
+
+    depth_only_shader->setUniform("mvp", mvp);
+    prepass_shader   ->setUniform("mvp", mvp);
+
+    m_sponza_static_object.m_model->RenderDepthIndirect(depth_only_shader, prepass_shader);
+}
+
+void ClusteredShading::renderLighting()
+{
+    glDepthMask(0);
+    glColorMask(1, 1, 1, 1);
+    glDepthFunc(GL_EQUAL);
+
+    m_tmo_ps->bindFilterFBO(GL_COLOR_BUFFER_BIT);
+
+    auto view_projection = m_camera->viewProjection();
+
+    m_clustered_pbr_shader->bind();
+    bindClusteredLighting(m_clustered_pbr_shader);
+
+    m_clustered_pbr_shader->setUniform("u_model",         m_sponza_static_object.m_transform);
+    m_clustered_pbr_shader->setUniform("u_view",          m_camera->m_view);
+    m_clustered_pbr_shader->setUniform("u_normal_matrix", glm::mat3(glm::transpose(glm::inverse(m_sponza_static_object.m_transform))));
+    m_clustered_pbr_shader->setUniform("u_mvp",           view_projection * m_sponza_static_object.m_transform);
+
+    m_variable_rate_shading.BeginShading();
+    m_sponza_static_object.m_model->RenderIndirect(m_clustered_pbr_shader);
+    m_variable_rate_shading.EndShading();
+
+    /* Enable writing to the depth buffer. */
+    glDepthMask(1);
+    glDepthFunc(GL_LEQUAL);
+}
+
+void ClusteredShading::renderVisibilityPass()
+{
+    static const GLuint clear_visibility[4] = { 0, 0, 0, 0 };
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_visibility_fbo_id);
+
+    glDepthMask(1);
+    glColorMask(1, 1, 1, 1);
+    glDepthFunc(GL_LESS);
+
+    glClearNamedFramebufferuiv(m_visibility_fbo_id, GL_COLOR, 0, clear_visibility);
+    glClear                   (GL_DEPTH_BUFFER_BIT);
+
+    m_visibility_shader->bind();
+    m_visibility_shader->setUniform("mvp", m_camera->viewProjection() * m_sponza_static_object.m_transform);
+    m_sponza_static_object.m_model->RenderIndirect(m_visibility_shader);
+}
+
+void ClusteredShading::renderVisibilityResolve()
+{
+    const auto& model = m_sponza_static_object.m_model;
+
+    m_visibility_resolve_shader->bind();
+    bindClusteredLighting(m_visibility_resolve_shader);
+
+    m_visibility_resolve_shader->setUniform("u_model",           m_sponza_static_object.m_transform);
+    m_visibility_resolve_shader->setUniform("u_view",            m_camera->m_view);
+    m_visibility_resolve_shader->setUniform("u_view_projection", m_camera->viewProjection());
+    m_visibility_resolve_shader->setUniform("u_normal_matrix",   glm::mat3(glm::transpose(glm::inverse(m_sponza_static_object.m_transform))));
+    m_visibility_resolve_shader->setUniform("u_screen_size",     glm::uvec2(Window::getWidth(), Window::getHeight()));
+    m_visibility_resolve_shader->setUniform("u_vertex_stride",   m_visibility_vertex_stride);
+
+    /* The buffers the geometry pass has drawn from, the commands are the LODs it drew. */
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBILITY_VERTICES_SSBO_BINDING_INDEX, model->GetVertexBuffer());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBILITY_INDICES_SSBO_BINDING_INDEX,  model->GetIndexBuffer());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBILITY_COMMANDS_SSBO_BINDING_INDEX, model->GetIndirectBuffer());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_DRAW_DATA_SSBO_BINDING_INDEX,      model->GetDrawDataBuffer());
+    RGL::Material::BindMaterials();
+
+    glBindTextureUnit(VISIBILITY_TEXTURE_BINDING_INDEX, m_visibility_tex2D_id);
+    m_tmo_ps->m_rt->BindColorImage(IMAGE_UNIT_WRITE, 0, GL_WRITE_ONLY);
+
+    glDispatchCompute(glm::ceil(Window::getWidth() / float(VISIBILITY_GROUP_SIZE)), glm::ceil(Window::getHeight() / float(VISIBILITY_GROUP_SIZE)), 1);
+}
+
+void ClusteredShading::bindClusteredLighting(const std::shared_ptr<Shader>& shader)
+{
+    shader->setUniform("u_cam_pos",                               m_camera->position());
+    shader->setUniform("u_near_z",                                m_camera->NearPlane());
+    shader->setUniform("u_grid_dim",                              m_cluster_grid_dim);
+    shader->setUniform("u_cluster_size_ss",                       glm::uvec2(m_cluster_grid_block_size));
+    shader->setUniform("u_log_grid_dim_y",                        m_log_grid_dim_y);
+    shader->setUniform("u_far_z",                                 m_camera->FarPlane());
+    shader->setUniform("u_zbinning",                              m_light_assignment == LightAssignment::ZBINS);
+    shader->setUniform("u_zbin_lights_count",                     glm::min(GetLightsCount(), uint32_t(ZBIN_MAX_LIGHTS)));
+    shader->setUniform("u_use_subgroups",                         m_use_subgroups);
+    shader->setUniform("u_shadows",                               m_shadows_enabled);
+    shader->setUniform("u_shadow_bias",                           m_shadow_bias);
+    shader->setUniform("u_area_light_cutoff",                     m_area_light_cutoff);
+    shader->setUniform("u_area_light_lod_distance",               m_area_light_lod_distance);
+    shader->setUniform("u_debug_slices",                          m_debug_slices);
+    shader->setUniform("u_debug_clusters_occupancy",              m_debug_clusters_occupancy);
+    shader->setUniform("u_debug_clusters_occupancy_blend_factor", m_debug_clusters_occupancy_blend_factor);
+
+    m_ibl.BindIrradianceSH();
+    m_ibl.BindPrefilteredMap(7);
+    m_ibl.BindBrdfLut(8);
+    m_ltc_mat_lut->Bind(9);
+    m_ltc_amp_lut->Bind(10);
+    glBindTextureUnit(SHADOW_ATLAS_TEXTURE_BINDING_INDEX, m_shadow_atlas->GetTexture());
+}
+
+void ClusteredShading::GenerateFogNoise()
+{
+    if (m_fog_noise_tex3D_id == 0)
+    {
+        glCreateTextures  (GL_TEXTURE_3D, 1, &m_fog_noise_tex3D_id);
+        glTextureStorage3D(m_fog_noise_tex3D_id, 1, GL_RGBA16F, FOG_NOISE_SIZE, FOG_NOISE_SIZE, FOG_NOISE_SIZE);
+
+        glTextureParameteri(m_fog_noise_tex3D_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(m_fog_noise_tex3D_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(m_fog_noise_tex3D_id, GL_TEXTURE_WRAP_S,     GL_REPEAT);
+        glTextureParameteri(m_fog_noise_tex3D_id, GL_TEXTURE_WRAP_T,     GL_REPEAT);
+        glTextureParameteri(m_fog_noise_tex3D_id, GL_TEXTURE_WRAP_R,     GL_REPEAT);
+    }
+
+    /* Periodic Perlin fBm, so the volume tiles. See NoiseTexture::generateGpu(). */
+    m_fog_noise_shader->bind();
+    m_fog_noise_shader->setUniform("u_noise_type",  0 /* NOISE_TYPE_PERLIN */);
+    m_fog_noise_shader->setUniform("u_frequency",   4.0f);
+    m_fog_noise_shader->setUniform("u_persistence", 0.5f);
+    m_fog_noise_shader->setUniform("u_lacunarity",  2.0f);
+    m_fog_noise_shader->setUniform("u_octaves",     4);
+    m_fog_noise_shader->setUniform("u_is_periodic", 1);
+    m_fog_noise_shader->setUniform("u_seed",        GLuint(0));
+    m_fog_noise_shader->setUniform("u_seed_offset", glm::vec3(0.0f));
+
+    glBindImageTexture(0, m_fog_noise_tex3D_id, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glDispatchCompute (FOG_NOISE_SIZE / 4, FOG_NOISE_SIZE / 4, FOG_NOISE_SIZE / 4);
+    glMemoryBarrier   (GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void ClusteredShading::renderLightShadows()
+{
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, m_shadow_atlas->GetFramebuffer());
+
+    glDepthMask(1);
+    glColorMask(0, 0, 0, 0);
+    glDepthFunc(GL_LESS);
+
+    /* Each face clears and draws its tile only. */
+    glEnable       (GL_SCISSOR_TEST);
+    glEnable       (GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+
+    /*
+     * The bindless materials of the visibility buffer mode aren't bound per batch, its shader alpha tests with their handles.
+     * The other modes alpha test the masked materials only, the rest is drawn with the positions alone.
+     */
+    const bool is_visibility_buffer = m_shading_mode == ShadingMode::VISIBILITY_BUFFER;
+
+    if (is_visibility_buffer)
+    {
+        m_visibility_shader->bind();
+    }
+
+    for (uint32_t slot : m_shadows_to_render)
+    {
+        const ShadowedLight& shadowed_light = m_shadowed_lights[slot];
+
+        for (uint32_t face = 0; face < shadowed_light.m_faces_count; ++face)
+        {
+            const glm::uvec2& tile = shadowed_light.m_tiles[face];
+
+            GLState::Viewport(tile.x, tile.y, shadowed_light.m_tile_size, shadowed_light.m_tile_size);
+            glScissor        (tile.x, tile.y, shadowed_light.m_tile_size, shadowed_light.m_tile_size);
+            glClear          (GL_DEPTH_BUFFER_BIT);
+
+            const glm::mat4 mvp = m_light_shadows[slot].view_projections[face] * m_sponza_static_object.m_transform;
+
+            if (is_visibility_buffer)
+            {
+                m_visibility_shader->setUniform("mvp", mvp);
+                m_sponza_static_object.m_model->RenderIndirect(m_visibility_shader);
+            }
+            else
+            {
+                m_depth_only_shader   ->setUniform("mvp", mvp);
+                m_depth_prepass_shader->setUniform("mvp", mvp);
+                m_sponza_static_object.m_model->RenderDepthIndirect(m_depth_only_shader, m_depth_prepass_shader);
+            }
+        }
+    }
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glDisable(GL_SCISSOR_TEST);
+
+    GLState::Viewport(0, 0, Window::getWidth(), Window::getHeight());
+}
+
+void ClusteredShading::render_gui()
+{
+    /* This method is responsible for rendering GUI using ImGUI. */
+
+    /* 
      * It's possible to call render_gui() from the base class.
      * It renders performance info overlay.
      */
@@ -924,8 +2248,172 @@ void ClusteredShading::render_gui()
                          cam_fov);
         }
 
+        if (ImGui::CollapsingHeader("Shading", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
+
+            if (ImGui::BeginCombo("Shading Mode", m_shading_mode_names[int(m_shading_mode)].c_str()))
+            {
+                for (int i = 0; i < std::size(m_shading_mode_names); ++i)
+                {
+                    bool is_selected = (int(m_shading_mode) == i);
+                    if (ImGui::Selectable(m_shading_mode_names[i].c_str(), is_selected))
+                    {
+                        SetShadingMode(ShadingMode(i));
+                    }
+
+                    if (is_selected)
+                    {
+                        ImGui::SetItemDefaultFocus();
+                    }
+                }
+                ImGui::EndCombo();
+            }
+            ImGui::PopItemWidth();
+
+            if (!m_is_visibility_buffer_supported)
+            {
+                ImGui::TextDisabled("The visibility buffer needs GL_ARB_bindless_texture.");
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Light Assignment", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
+
+            if (ImGui::BeginCombo("Mode", m_light_assignment_names[int(m_light_assignment)].c_str()))
+            {
+                for (int i = 0; i < std::size(m_light_assignment_names); ++i)
+                {
+                    bool is_selected = (int(m_light_assignment) == i);
+                    if (ImGui::Selectable(m_light_assignment_names[i].c_str(), is_selected))
+                    {
+                        m_light_assignment = LightAssignment(i);
+                    }
+
+                    if (is_selected)
+                    {
+                        ImGui::SetItemDefaultFocus();
+                    }
+                }
+                ImGui::EndCombo();
+            }
+            ImGui::PopItemWidth();
+
+            if (m_light_assignment == LightAssignment::CLUSTERS)
+            {
+                ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
+
+                if (ImGui::BeginCombo("Culled Clusters", m_cluster_selection_names[int(m_cluster_selection)].c_str()))
+                {
+                    for (int i = 0; i < std::size(m_cluster_selection_names); ++i)
+                    {
+                        bool is_selected = (int(m_cluster_selection) == i);
+                        if (ImGui::Selectable(m_cluster_selection_names[i].c_str(), is_selected))
+                        {
+                            m_cluster_selection = ClusterSelection(i);
+                        }
+
+                        if (is_selected)
+                        {
+                            ImGui::SetItemDefaultFocus();
+                        }
+                    }
+                    ImGui::EndCombo();
+                }
+                ImGui::PopItemWidth();
+            }
+
+            if (m_is_subgroups_supported)
+            {
+                ImGui::Checkbox("Subgroup Culling and Shading", &m_use_subgroups);
+            }
+            else
+            {
+                ImGui::TextDisabled("GL_KHR_shader_subgroup is not supported.");
+            }
+
+            /* What each mode keeps of the assignment, the lights and their sort are shared. */
+            const size_t clusters_size = m_clusters_count * (sizeof(ClusterAABB) + 3 * sizeof(uint32_t) + 3 * sizeof(LightGrid)) + 4 * sizeof(uint32_t)
+                                       + sizeof(uint32_t) * (m_light_index_lists_capacities[0] + m_light_index_lists_capacities[1] + m_light_index_lists_capacities[2])
+                                       + sizeof(LightBvhNode) * (m_light_bvh_levels.back().x + 1) + sizeof(glm::vec4) * glm::max(GetLightsCount(), 1u);
+            const size_t zbins_size    = sizeof(glm::uvec2) * ZBINS_COUNT + sizeof(uint32_t) * ZBIN_WORDS_PER_TILE * m_cluster_grid_dim.x * m_cluster_grid_dim.y;
+
+            ImGui::Text("Clusters memory : %.2f MB", clusters_size / (1024.0f * 1024.0f));
+            ImGui::Text("Z-bins memory   : %.2f MB", zbins_size    / (1024.0f * 1024.0f));
+            ImGui::Text("Cluster grid    : %u x %u x %u, generated %u times", m_cluster_grid_dim.x, m_cluster_grid_dim.y, m_cluster_grid_dim.z, GetClusterGrid(0).m_generations_count);
+            ImGui::TextDisabled("The cull and shade timings are in the Passes of the profiler.");
+
+            if (m_light_assignment == LightAssignment::CLUSTERS && ImGui::BeginTable("##LightLists", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchSame))
+            {
+                static const char* types[3] = { "Point", "Spot", "Area" };
+
+                ImGui::TableSetupColumn("Lights");
+                ImGui::TableSetupColumn("Peak / cluster");
+                ImGui::TableSetupColumn("Max peak");
+                ImGui::TableSetupColumn("Used / size");
+                ImGui::TableHeadersRow();
+
+                for (uint32_t i = 0; i < 3; ++i)
+                {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn(); ImGui::Text("%s", types[i]);
+                    ImGui::TableNextColumn(); ImGui::Text("%u", m_light_lists_feedback.peak_counts[i]);
+                    ImGui::TableNextColumn(); ImGui::Text("%u", m_max_peak_light_counts[i]);
+                    ImGui::TableNextColumn(); ImGui::Text("%u / %u", m_light_lists_feedback.required_counts[i], m_light_index_lists_capacities[i]);
+                }
+
+                ImGui::EndTable();
+
+                ImGui::Text("Overflowed clusters: %u, lists resized %u times", m_light_lists_feedback.overflows_count, m_light_index_lists_resizes);
+
+                if (ImGui::Button("Reset Max Peaks"))
+                {
+                    m_max_peak_light_counts = glm::uvec3(0);
+                }
+            }
+
+            if (m_light_assignment == LightAssignment::ZBINS && GetLightsCount() > uint32_t(ZBIN_MAX_LIGHTS))
+            {
+                ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.0f, 1.0f), "Only the %u nearest lights are Z-binned.", uint32_t(ZBIN_MAX_LIGHTS));
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Shadows"))
+        {
+            static const uint32_t min_shadowed_lights = 1;
+            static const uint32_t max_shadowed_lights = MAX_SHADOWED_LIGHTS;
+            static const uint32_t min_faces_budget    = 6;
+            static const uint32_t max_faces_budget    = 6 * MAX_SHADOWED_LIGHTS;
+
+            ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
+
+            ImGui::Checkbox    ("Shadowed Lights",        &m_shadows_enabled);
+            ImGui::SliderScalar("Max Shadowed Lights",    ImGuiDataType_U32, &m_max_shadowed_lights, &min_shadowed_lights, &max_shadowed_lights, "%u");
+            ImGui::SliderScalar("Faces Rendered / Frame", ImGuiDataType_U32, &m_shadow_faces_budget, &min_faces_budget,    &max_faces_budget,    "%u");
+            ImGui::DragFloat   ("Shadow Bias",            &m_shadow_bias, 0.00001f, 0.0f, 0.01f, "%.5f");
+
+            uint32_t shadowed_count = 0;
+            uint32_t rendered_count = 0;
+            for (const auto& shadowed_light : m_shadowed_lights)
+            {
+                shadowed_count += shadowed_light.m_light != NO_LIGHT_SHADOW;
+                rendered_count += shadowed_light.m_is_rendered;
+            }
+
+            const float atlas_used = 1.0f - float(m_shadow_atlas->GetFreeTexelsCount()) / float(uint64_t(ShadowAtlas::SIZE) * ShadowAtlas::SIZE);
+
+            ImGui::Text("Shadowed lights : %u, %u of them rendered", shadowed_count, rendered_count);
+            ImGui::Text("Faces rendered  : %u this frame", m_shadow_faces_rendered);
+            ImGui::Text("Atlas used      : %.1f%% of %u x %u", atlas_used * 100.0f, ShadowAtlas::SIZE, ShadowAtlas::SIZE);
+
+            ImGui::PopItemWidth();
+        }
+
         if (ImGui::CollapsingHeader("Lights Generator", ImGuiTreeNodeFlags_DefaultOpen))
         {
+            static const uint32_t min_lights_count = 0;
+
             ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
 
             if (ImGui::Checkbox("Show Debug Z Tiles", &m_debug_slices))
@@ -944,6 +2432,16 @@ void ClusteredShading::render_gui()
             ImGui::Checkbox   ("Animate Lights",                             &m_animate_lights);
             ImGui::SliderFloat("Animation Speed",                            &m_animation_speed, 0.0f, 15.0f, "%.1f");
 
+            float dynamic_lights_percent = m_dynamic_lights_ratio * 100.0f;
+            if (ImGui::SliderFloat("Dynamic Lights", &dynamic_lights_percent, 0.0f, 100.0f, "%.0f%%"))
+            {
+                m_dynamic_lights_ratio = dynamic_lights_percent / 100.0f;
+                ResizeDynamicLightsBuffer();
+            }
+
+            const glm::uvec3 dynamic_counts = GetDynamicLightsCounts();
+            ImGui::Text("Animated on a worker: %u of %u lights", dynamic_counts.x + dynamic_counts.y + dynamic_counts.z, GetLightsCount());
+
             if (ImGui::DragFloat3("Min Bounds", &min_lights_bounds.x, 0.01f))
             {
                 max_lights_bounds = glm::max(min_lights_bounds, max_lights_bounds);
@@ -963,7 +2461,7 @@ void ClusteredShading::render_gui()
             }
 
             ImGui::Separator();
-            ImGui::DragScalar("Point Lights Count", ImGuiDataType_U32, &m_point_lights_count);
+            ImGui::SliderScalar("Point Lights Count", ImGuiDataType_U32, &m_point_lights_count, &min_lights_count, &MAX_LIGHTS_COUNT, "%u", ImGuiSliderFlags_Logarithmic);
 
             if (ImGui::DragFloat("Min Point Lights Radius", &min_max_point_light_radius.x, 0.01f, 0.0f))
             {
@@ -982,7 +2480,7 @@ void ClusteredShading::render_gui()
             }
 
             ImGui::Separator();
-            ImGui::DragScalar("Spot Lights Count", ImGuiDataType_U32, &m_spot_lights_count);
+            ImGui::SliderScalar("Spot Lights Count", ImGuiDataType_U32, &m_spot_lights_count, &min_lights_count, &MAX_LIGHTS_COUNT, "%u", ImGuiSliderFlags_Logarithmic);
 
             if (ImGui::DragFloat("Min Spot Lights Radius", &min_max_spot_light_radius.x, 0.01f, 0.0f))
             {
@@ -1014,8 +2512,18 @@ void ClusteredShading::render_gui()
             }
 
             ImGui::Separator();
-            ImGui::Checkbox  ("Two Sided Area Lights", &m_area_lights_two_sided);
-            ImGui::DragScalar("Area Lights Count", ImGuiDataType_U32, &m_area_lights_count);
+            if (ImGui::Checkbox("Two Sided Area Lights", &m_area_lights_two_sided))
+            {
+                /* The static area lights too, they are uploaded again. */
+                FinishDynamicLights();
+
+                for (auto& area_light : m_area_lights)
+                {
+                    area_light.two_sided = m_area_lights_two_sided;
+                }
+                UpdateLightsSSBOs();
+            }
+            ImGui::SliderScalar("Area Lights Count", ImGuiDataType_U32, &m_area_lights_count, &min_lights_count, &MAX_LIGHTS_COUNT, "%u", ImGuiSliderFlags_Logarithmic);
 
             if (ImGui::DragFloat("Area Lights Intensity", &m_area_lights_intensity, 0.1f, 0.0f))
             {
@@ -1027,6 +2535,9 @@ void ClusteredShading::render_gui()
                 m_area_lights_size = glm::max(glm::vec2(0.1f), m_area_lights_size);
             }
 
+            ImGui::SliderFloat("Area Lights Cutoff",       &m_area_light_cutoff,       0.0005f, 0.1f, "%.4f", ImGuiSliderFlags_Logarithmic);
+            ImGui::SliderFloat("Area Lights LOD Distance", &m_area_light_lod_distance, 1.0f,    64.0f, "%.1f half diagonals");
+
             ImGui::Spacing();
 
             if (ImGui::Button("Normalize Lights Radii"))
@@ -1053,6 +2564,8 @@ void ClusteredShading::render_gui()
                 UpdateLightsSSBOs();
             }
 
+            ImGui::Text("Light BVH: %u lights, %zu levels, %u nodes", GetLightsCount(), m_light_bvh_levels.size(), m_light_bvh_levels.back().x + m_light_bvh_levels.back().y);
+
             ImGui::PopItemWidth();
         }
 
@@ -1061,7 +2574,7 @@ void ClusteredShading::render_gui()
             ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
             ImGui::SliderFloat("Exposure",             &m_exposure,             0.0, 10.0, "%.1f");
             ImGui::SliderFloat("Gamma",                &m_gamma,                0.0, 10.0, "%.1f");
-            ImGui::SliderFloat("Background LOD level", &m_background_lod_level, 0.0, glm::log2(float(m_env_cubemap_rt->m_width)), "%.1f");
+            ImGui::SliderFloat("Background blur",      &m_background_blur,      0.0, 1.0, "%.2f");
 
             if (ImGui::BeginCombo("HDR map", m_hdr_maps_names[m_current_hdr_map_idx].c_str()))
             {
@@ -1071,7 +2584,7 @@ void ClusteredShading::render_gui()
                     if (ImGui::Selectable(m_hdr_maps_names[i].c_str(), is_selected))
                     {
                         m_current_hdr_map_idx = i;
-                        PrecomputeIndirectLight(FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx]);
+                        m_ibl.Load(FileSystem::getResourcesPath() / "textures/skyboxes/IBL" / m_hdr_maps_names[m_current_hdr_map_idx], ImageBasedLighting::PrefilterMode::FAST);
                     }
 
                     if (is_selected)
@@ -1084,15 +2597,66 @@ void ClusteredShading::render_gui()
             ImGui::PopItemWidth();
         }
 
+        if (ImGui::CollapsingHeader("Volumetric fog"))
+        {
+            ImGui::Checkbox   ("Fog enabled",    &m_fog_enabled);
+            ImGui::SliderFloat("Density",        &m_fog_density,        0.0f,  0.2f,   "%.3f");
+            ImGui::SliderFloat("Height falloff", &m_fog_height_falloff, 0.0f,  1.0f,   "%.2f");
+            ImGui::SliderFloat("Base height",    &m_fog_base_height,    -5.0f, 15.0f,  "%.1f");
+            ImGui::SliderFloat("Noise scale",    &m_fog_noise_scale,    0.01f, 0.5f,   "%.2f");
+            ImGui::SliderFloat("Noise amount",   &m_fog_noise_amount,   0.0f,  1.0f,   "%.2f");
+            ImGui::SliderFloat3("Wind",          &m_fog_wind[0],        -5.0f, 5.0f,   "%.1f");
+            ImGui::ColorEdit3 ("Albedo",         &m_fog_albedo[0]);
+            ImGui::SliderFloat("Anisotropy",     &m_fog_anisotropy,     -0.9f, 0.9f,   "%.2f");
+            ImGui::SliderFloat("Ambient",        &m_fog_ambient,        0.0f,  1.0f,   "%.2f");
+            ImGui::SliderFloat("Fog distance",   &m_fog_end_z,          5.0f,  200.0f, "%.0f");
+
+            ImGui::Text("Froxels: %d x %d x %d, the clusters' light lists of all the clusters", FOG_FROXELS_X, FOG_FROXELS_Y, FOG_FROXELS_Z);
+        }
+
         if (ImGui::CollapsingHeader("Bloom"))
         {
             ImGui::Checkbox   ("Bloom enabled",        &m_bloom_enabled);
+            ImGui::Checkbox   ("Single pass downscale", &m_bloom_single_pass);
             ImGui::SliderFloat("Bloom threshold",      &m_threshold,            0.0f, 15.0f, "%.1f");
             ImGui::SliderFloat("Bloom knee",           &m_knee,                 0.0f, 1.0f,  "%.1f");
             ImGui::SliderFloat("Bloom intensity",      &m_bloom_intensity,      0.0f, 5.0f,  "%.1f");
             ImGui::SliderFloat("Bloom dirt intensity", &m_bloom_dirt_intensity, 0.0f, 10.0f, "%.1f");
         }
 
+        if (ImGui::CollapsingHeader("Object picking"))
+        {
+            bool is_picking_enabled = m_is_picking_enabled;
+
+            if (ImGui::Checkbox("Pick with LMB", &is_picking_enabled))
+            {
+                SetPickingEnabled(is_picking_enabled);
+            }
+
+            const uint32_t picked_id = m_object_picking.GetPickedId();
+
+            if (picked_id == RGL::ObjectPicking::NO_OBJECT)
+            {
+                ImGui::Text("Picked draw: none");
+            }
+            else
+            {
+                ImGui::Text("Picked draw: %u", picked_id - 1);
+            }
+
+            ImGui::TextDisabled("Read back a frame or two after the click, without a stall.");
+        }
+
+        if (ImGui::CollapsingHeader("Variable rate shading"))
+        {
+            m_variable_rate_shading.RenderGui();
+        }
+
+        if (ImGui::CollapsingHeader("Render Graph"))
+        {
+            m_render_graph.RenderGui();
+        }
+
     }
     ImGui::End();
 }
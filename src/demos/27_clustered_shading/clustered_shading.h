@@ -2,9 +2,20 @@
 #include "core_app.h"
 
 #include "camera.h"
+#include "depth_pyramid.h"
+#include "gl_state.h"
+#include "image_based_lighting.h"
+#include "job_system.h"
+#include "object_picking.h"
+#include "render_graph.h"
+#include "render_target_pool.h"
 #include "static_model.h"
 #include "shader.h"
+#include "skybox.h"
+#include "shadow_atlas.h"
 #include "shared.h"
+#include "variable_rate_shading.h"
+#include "window.h"
 
 #include <memory>
 #include <vector>
@@ -89,133 +100,149 @@ public:
     void render_gui()              override;
 
 private:
-    struct Texture2DRenderTarget
-    {
-        GLuint m_texture_id = 0;
-        GLuint m_fbo_id = 0;
-        GLuint m_rbo_id = 0;
-        GLuint m_width = 0, m_height = 0;
-        GLenum m_internalformat;
+    /* How the lights are assigned to the screen: the lists of every cluster, or the Z-bins' ranges and the tiles' bitmasks. */
+    enum class LightAssignment { CLUSTERS, ZBINS };
 
-        const uint8_t m_downscale_limit = 10;
-        const uint8_t m_max_iterations = 16; // max mipmap levels
-        uint8_t m_mip_levels = 1;
+    /* The clusters the lights are culled for: the ones with opaque samples, those and the ones of the transparent bounds, or all of them. */
+    enum class ClusterSelection { VISIBLE, VISIBLE_AND_TRANSPARENT, ALL };
 
-        ~Texture2DRenderTarget() { cleanup(); }
+    /* How the geometry is shaded: forward after the depth pre-pass, or once per pixel from the visibility buffer of a single geometry pass. */
+    enum class ShadingMode { FORWARD, VISIBILITY_BUFFER };
 
-        void bindTexture(GLuint unit = 0)
+    /* A view's cluster grid. Its AABBs are generated again only when the projection or the resolution change, and its buffer only grows,
+       so every view (split screen, VR eyes, reflection probes) keeps its own grid and runs the same pipeline without reallocating. */
+    struct ClusterGrid
+    {
+        glm::uvec3 m_dim            = glm::uvec3(0);
+        float      m_near_k         = 1.0f;
+        float      m_log_grid_dim_y = 1.0f;
+        uint64_t   m_clusters_count = 0;
+
+        GLuint   m_clusters_ssbo     = 0;
+        uint64_t m_clusters_capacity = 0;
+        uint32_t m_generations_count = 0;
+
+        /* What the grid was made for. */
+        glm::mat4  m_projection = glm::mat4(0.0f);
+        float      m_near_z     = 0.0f;
+        glm::uvec2 m_resolution = glm::uvec2(0);
+        uint32_t   m_block_size = 0;
+
+        ClusterGrid() = default;
+        ClusterGrid(const ClusterGrid&)            = delete;
+        ClusterGrid& operator=(const ClusterGrid&) = delete;
+
+        ~ClusterGrid()
         {
-            glBindTextureUnit(unit, m_texture_id);
+            if (m_clusters_ssbo != 0)
+            {
+                glDeleteBuffers(1, &m_clusters_ssbo);
+            }
         }
 
-        void bindRenderTarget(GLbitfield clear_mask = GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT)
+        bool isOutdated(const RGL::Camera& camera, const glm::uvec2& resolution, uint32_t block_size) const
         {
-            glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_id);
-            glViewport(0, 0, m_width, m_height);
-            glClear(clear_mask);
+            return camera.m_projection != m_projection || resolution != m_resolution || block_size != m_block_size;
         }
 
-        void bindImageForRead(GLuint image_unit, GLuint mip_level)
+        /* The dimensions for the camera and the resolution, the clusters buffer grows to fit them. */
+        void resize(const RGL::Camera& camera, const glm::uvec2& resolution, uint32_t block_size)
         {
-            glBindImageTexture(image_unit, m_texture_id, mip_level, GL_FALSE, 0, GL_READ_ONLY, m_internalformat);
-        }
+            float half_fov = glm::radians(camera.FOV() * 0.5f);
 
-        void bindImageForWrite(GLuint image_unit, GLuint mip_level)
-        {
-            glBindImageTexture(image_unit, m_texture_id, mip_level, GL_FALSE, 0, GL_WRITE_ONLY, m_internalformat);
-        }
+            m_dim.x = uint32_t(glm::ceil(resolution.x / float(block_size)));
+            m_dim.y = uint32_t(glm::ceil(resolution.y / float(block_size)));
 
-        void bindImageForReadWrite(GLuint image_unit, GLuint mip_level)
-        {
-            glBindImageTexture(image_unit, m_texture_id, mip_level, GL_FALSE, 0, GL_READ_WRITE, m_internalformat);
-        }
+            // The depth of the cluster grid during clustered rendering is dependent on the 
+            // number of clusters subdivisions in the screen Y direction.
+            // Source: Clustered Deferred and Forward Shading (2012) (Ola Olsson, Markus Billeter, Ulf Assarsson).
+            float sD         = 2.0f * glm::tan(half_fov) / float(m_dim.y);
+                  m_near_k   = 1.0f + sD;
+            m_log_grid_dim_y = 1.0f / glm::log(m_near_k);
 
-        void cleanup()
-        {
-            if (m_texture_id != 0)
-            {
-                glDeleteTextures(1, &m_texture_id);
-            }
+            float log_depth = glm::log(camera.FarPlane() / camera.NearPlane());
+            m_dim.z         = uint32_t(glm::floor(log_depth * m_log_grid_dim_y));
+
+            m_clusters_count = m_dim.x * m_dim.y * m_dim.z;
 
-            if (m_fbo_id != 0)
+            if (m_clusters_ssbo == 0)
             {
-                glDeleteFramebuffers(1, &m_fbo_id);
+                glCreateBuffers(1, &m_clusters_ssbo);
             }
 
-            if (m_rbo_id != 0)
+            if (m_clusters_count > m_clusters_capacity)
             {
-                glDeleteRenderbuffers(1, &m_rbo_id);
+                m_clusters_capacity = m_clusters_count;
+                glNamedBufferData(m_clusters_ssbo, sizeof(ClusterAABB) * m_clusters_capacity, nullptr, GL_STATIC_READ);
             }
+
+            m_projection = camera.m_projection;
+            m_near_z     = camera.NearPlane();
+            m_resolution = resolution;
+            m_block_size = block_size;
         }
 
-        void create(uint32_t width, uint32_t height, GLint internalformat)
+        /* The clusters' AABBs for the last resize(). */
+        void generate(const std::shared_ptr<RGL::Shader>& generate_clusters_shader)
         {
-            m_width          = width;
-            m_height         = height;
-            m_internalformat = internalformat;
-
-            m_mip_levels = calculateMipmapLevels();
-
-            glCreateFramebuffers(1, &m_fbo_id);
-
-            glCreateTextures(GL_TEXTURE_2D, 1, &m_texture_id);
-            glTextureStorage2D(m_texture_id, m_mip_levels, internalformat, width, height); // internalformat = GL_RGB32F
-
-            glTextureParameteri(m_texture_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTextureParameteri(m_texture_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTextureParameteri(m_texture_id, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
-            glTextureParameteri(m_texture_id, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
-
-            glCreateRenderbuffers(1, &m_rbo_id);
-            glNamedRenderbufferStorage(m_rbo_id, GL_DEPTH_COMPONENT32F, width, height);
-
-            glNamedFramebufferTexture(m_fbo_id, GL_COLOR_ATTACHMENT0, m_texture_id, 0);
-            glNamedFramebufferRenderbuffer(m_fbo_id, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_rbo_id);
+            bind();
+
+            generate_clusters_shader->bind();
+            generate_clusters_shader->setUniform("u_grid_dim",           m_dim);
+            generate_clusters_shader->setUniform("u_cluster_size_ss",    glm::uvec2(m_block_size));
+            generate_clusters_shader->setUniform("u_near_k",             m_near_k);
+            generate_clusters_shader->setUniform("u_near_z",             m_near_z);
+            generate_clusters_shader->setUniform("u_inverse_projection", glm::inverse(m_projection));
+            generate_clusters_shader->setUniform("u_pixel_size",         1.0f / glm::vec2(m_resolution));
+            glDispatchCompute(glm::ceil(float(m_clusters_count) / 1024.0f), 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            ++m_generations_count;
         }
 
-        uint8_t calculateMipmapLevels()
+        void bind() const
         {
-            uint32_t width      = m_width  / 2;
-            uint32_t height     = m_height / 2;
-            uint8_t  mip_levels = 1;
-
-            printf("Mip level %d: %d x %d\n", 0, m_width, m_height);
-            printf("Mip level %d: %d x %d\n", mip_levels, width, height);
-
-            for (uint8_t i = 0; i < m_max_iterations; ++i)
-            {
-                width  = width  / 2;
-                height = height / 2;
-
-                if (width < m_downscale_limit || height < m_downscale_limit) break;
-
-                ++mip_levels;
-
-                printf("Mip level %d: %d x %d\n", mip_levels, width, height);
-            }
-
-            return mip_levels + 1;
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTERS_SSBO_BINDING_INDEX, m_clusters_ssbo);
         }
     };
 
+    /* A shadowed point or spot light and its atlas tiles, a slot of the LightShadow buffer. The shadow stays cached
+       until the light moves, then the old one is used until the light is rendered again. */
+    struct ShadowedLight
+    {
+        uint32_t   m_light       = NO_LIGHT_SHADOW; // The point lights, then the spot lights.
+        uint32_t   m_tile_size   = 0;
+        uint32_t   m_faces_count = 0;
+        glm::uvec2 m_tiles[6]    = {};
+        float      m_coverage    = 0.0f;           // The projected radius in pixels.
+        bool       m_is_rendered = false;
+
+        /* The light the shadow was rendered for. */
+        glm::vec4 m_rendered_sphere = glm::vec4(0.0f); // Position and radius.
+        glm::vec4 m_rendered_cone   = glm::vec4(0.0f); // Direction and outer angle.
+    };
+
     struct PostprocessFilter
     {
+        static constexpr uint32_t DOWNSCALE_LIMIT = 10;
+        static constexpr uint32_t MAX_ITERATIONS  = 16; // max mipmap levels
+
+        /* See downscale_single_pass.comp, a workgroup per tile of mip 1 and an image unit per mip. */
+        static constexpr uint32_t SINGLE_PASS_MIPS      = 8;
+        static constexpr uint32_t SINGLE_PASS_TILE_SIZE = 64;
+
         std::shared_ptr<RGL::Shader> m_shader;
-        std::shared_ptr<Texture2DRenderTarget> rt;
+
+        /* The HDR target of the frame with the bloom mip chain, from acquire() until render(). */
+        std::shared_ptr<RGL::RenderTarget> m_rt;
 
         GLuint m_dummy_vao_id;
 
-        PostprocessFilter(uint32_t width, uint32_t height)
+        PostprocessFilter()
         {
             m_shader = std::make_shared<RGL::Shader>("src/demos/10_postprocessing_filters/FSQ.vert", "src/demos/27_clustered_shading/tmo.frag");
             m_shader->link();
 
-            rt = std::make_shared<Texture2DRenderTarget>();
-            rt->create(width, height, GL_RGBA32F);
-            glTextureParameteri(rt->m_texture_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
-            glTextureParameteri(rt->m_texture_id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTextureParameteri(rt->m_texture_id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
             glCreateVertexArrays(1, &m_dummy_vao_id);
         }
 
@@ -227,19 +254,34 @@ private:
             }
         }
 
+        /* The same target every frame, a resize makes the pool create one of the new size. The HDR color in mip 0, the bloom's chain below. */
+        void acquire()
+        {
+            const uint32_t width  = RGL::Window::getWidth();
+            const uint32_t height = RGL::Window::getHeight();
+            const GLenum   format = RGL::RenderTargetPool::GetColorFormat(RGL::RenderTargetUsage::BLOOM);
+
+            m_rt = RGL::RenderTargetPool::Acquire({ width, height, format, GL_DEPTH_COMPONENT32F, calculateMipmapLevels(width, height) });
+        }
+
         void bindTexture(GLuint unit = 0)
         {
-            rt->bindTexture(unit);
+            m_rt->BindColor(unit);
         }
 
         void bindFilterFBO(GLbitfield clear_mask = GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT)
         {
-            rt->bindRenderTarget(clear_mask);
+            if (!m_rt)
+            {
+                acquire();
+            }
+
+            m_rt->Bind(clear_mask);
         }
 
         void render(float exposure, float gamma)
         {
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            RGL::GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
             m_shader->bind();
@@ -249,139 +291,148 @@ private:
 
             glBindVertexArray(m_dummy_vao_id);
             glDrawArrays(GL_TRIANGLES, 0, 3);
-        }
-    };
 
-    struct CubeMapRenderTarget
-    {
-        glm::mat4 m_view_transforms[6];
-        glm::mat4 m_projection;
-
-        GLuint    m_cubemap_texture_id = 0;
-        GLuint    m_fbo_id             = 0;
-        GLuint    m_rbo_id             = 0;
-        glm::vec3 m_position           = glm::vec3(0.0f);
-        GLuint m_width, m_height;
-
-        ~CubeMapRenderTarget() { cleanup(); }
-
-        void set_position(const glm::vec3 pos)
-        {
-            m_position = pos;
-            m_view_transforms[0] = glm::lookAt(pos, pos + glm::vec3( 1,  0,  0), glm::vec3(0, -1,  0));
-            m_view_transforms[1] = glm::lookAt(pos, pos + glm::vec3(-1,  0,  0), glm::vec3(0, -1,  0));
-            m_view_transforms[2] = glm::lookAt(pos, pos + glm::vec3( 0,  1,  0), glm::vec3(0,  0,  1));
-            m_view_transforms[3] = glm::lookAt(pos, pos + glm::vec3( 0, -1,  0), glm::vec3(0,  0, -1));
-            m_view_transforms[4] = glm::lookAt(pos, pos + glm::vec3( 0,  0,  1), glm::vec3(0, -1,  0));
-            m_view_transforms[5] = glm::lookAt(pos, pos + glm::vec3( 0,  0, -1), glm::vec3(0, -1,  0));
-
-            m_projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+            /* Back to the pool, free for the other passes until the next frame. */
+            m_rt.reset();
         }
 
-        void bindTexture(GLuint unit = 0)
+        /* The bloom stops at the mip smaller than DOWNSCALE_LIMIT. */
+        static uint32_t calculateMipmapLevels(uint32_t width, uint32_t height)
         {
-            glBindTextureUnit(unit, m_cubemap_texture_id);
-        }
+            uint32_t mip_levels = 1;
 
-        void cleanup()
-        {
-            if (m_cubemap_texture_id != 0)
-            {
-                glDeleteTextures(1, &m_cubemap_texture_id);
-            }
+            width  = width  / 2;
+            height = height / 2;
 
-            if (m_fbo_id != 0)
+            for (uint32_t i = 0; i < MAX_ITERATIONS; ++i)
             {
-                glDeleteFramebuffers(1, &m_fbo_id);
-            }
+                width  = width  / 2;
+                height = height / 2;
 
-            if (m_rbo_id != 0)
-            {
-                glDeleteRenderbuffers(1, &m_rbo_id);
+                if (width < DOWNSCALE_LIMIT || height < DOWNSCALE_LIMIT) break;
+
+                ++mip_levels;
             }
+
+            return mip_levels + 1;
         }
+    };
 
-        void generate_rt(uint32_t width, uint32_t height, bool gen_mip_levels = false)
-        {
-            m_width  = width;
-            m_height = height;
 
-            glGenTextures(1, &m_cubemap_texture_id);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubemap_texture_id);
+    void GenerateAreaLights();
+    void GeneratePointLights();
+    void GenerateSpotLights();
+    void UpdateLightsSSBOs();
+    void ResizeLightBvhBuffers();
 
-            for (uint8_t i = 0; i < 6; ++i)
-            {
-                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, m_width, m_height, 0, GL_RGB, GL_FLOAT, 0);
-            }
+    /* The dynamic lights, the last ones of every type, are animated on a worker into a slot of the mapped buffer
+       and copied to the light SSBOs the next frame. The static ones are uploaded once, by UpdateLightsSSBOs(). */
+    void UpdateDynamicLights();
+    void AnimateDynamicLights(uint8_t* slot, float time) const;
+    void FinishDynamicLights();
+    void ResizeDynamicLightsBuffer();
 
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, gen_mip_levels ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glm::uvec3 GetDynamicLightsCounts() const { return glm::uvec3(m_point_lights.size(), m_spot_lights.size(), m_area_lights.size()) - m_static_lights_counts; }
+    void ReadLightListsFeedback();
+    void ResizeLightIndexLists(const uint32_t required_counts[3]);
 
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    uint32_t GetLightsCount() const { return uint32_t(m_point_lights.size() + m_spot_lights.size() + m_area_lights.size()); }
 
-            if (gen_mip_levels) glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    static bool IsSubgroupsSupported();
 
-            glGenFramebuffers(1, &m_fbo_id);
-            glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_id);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, m_cubemap_texture_id, 0);
+    /* The grid of the view, created on the first use. Generates its clusters again if they are outdated and returns whether it did. */
+    ClusterGrid& GetClusterGrid(uint32_t view_index);
+    bool UpdateClusterGrid(uint32_t view_index, const RGL::Camera& camera, const glm::uvec2& resolution);
 
-            glGenRenderbuffers(1, &m_rbo_id);
-            glBindRenderbuffer(GL_RENDERBUFFER, m_rbo_id);
-            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_width, m_height);
-            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_rbo_id);
+    /* The main view's grid, the per cluster buffers and the depth pre-pass follow its size. */
+    void UpdateMainClusterGrid();
+    void ResizeClusterBuffers();
+    void ResizeDepthPass();
 
-            glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-            glBindRenderbuffer(GL_RENDERBUFFER, 0);
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        }
-    }; 
+    /* The visibility buffer needs the bindless materials, the forward shading binds them per batch. */
+    void SetShadingMode(ShadingMode mode);
 
-    void GenerateAreaLights();
-    void GeneratePointLights();
-    void GenerateSpotLights();
-    void UpdateLightsSSBOs();
+    /* The depth pre-pass writes the object ids only when the picking is on. */
+    void SetPickingEnabled(bool is_enabled);
 
-    void HdrEquirectangularToCubemap(const std::shared_ptr<CubeMapRenderTarget> & cubemap_rt, const std::shared_ptr<RGL::Texture2D> & m_equirectangular_map);
-    void IrradianceConvolution      (const std::shared_ptr<CubeMapRenderTarget> & cubemap_rt);
-    void PrefilterCubemap           (const std::shared_ptr<CubeMapRenderTarget>& cubemap_rt);
-    void PrecomputeIndirectLight    (const std::filesystem::path & hdri_map_filepath);
-    void PrecomputeBRDF             (const std::shared_ptr<Texture2DRenderTarget>& rt);
-    void GenSkyboxGeometry();
+    /* Picks the lights covering the most of the screen for the atlas and the shadows to render this frame. */
+    void UpdateLightShadows();
+    void ResetLightShadows();
+    void FreeShadowedLight(uint32_t slot);
+    void SetLightShadowPointer(uint32_t light, uint32_t slot);
+
+    /* The position and radius, the direction and outer angle of a point or spot light as it is in the light SSBOs. */
+    void GetShadowedLightPose(uint32_t light, glm::vec4& sphere, glm::vec4& cone) const;
 
     void renderDepthPass();
     void renderLighting();
+    void renderVisibilityPass();
+    void renderVisibilityResolve();
+    void bindClusteredLighting(const std::shared_ptr<RGL::Shader>& shader); /* The uniforms and textures of clustered_lighting.glh. */
+    void renderLightShadows();
+
+    /* The tiling density noise of the volumetric fog, by 16_noise's generator. */
+    void GenerateFogNoise();
 
     std::shared_ptr<RGL::Camera> m_camera;
 
-    std::shared_ptr<CubeMapRenderTarget>   m_env_cubemap_rt;
-    std::shared_ptr<CubeMapRenderTarget>   m_irradiance_cubemap_rt;
-    std::shared_ptr<CubeMapRenderTarget>   m_prefiltered_env_map_rt;
-    std::shared_ptr<Texture2DRenderTarget> m_brdf_lut_rt;
+    /* The passes of render(), built every frame. */
+    RGL::RenderGraph m_render_graph;
+
+    /* The min and max depth pyramid of the depth pre-pass, built once a frame for the passes that read it. */
+    RGL::DepthPyramid m_depth_pyramid;
 
-    std::shared_ptr<RGL::Shader> m_equirectangular_to_cubemap_shader;
-    std::shared_ptr<RGL::Shader> m_irradiance_convolution_shader;
-    std::shared_ptr<RGL::Shader> m_prefilter_env_map_shader;
-    std::shared_ptr<RGL::Shader> m_precompute_brdf;
-    std::shared_ptr<RGL::Shader> m_background_shader;
+    /* Coarser shading of the forward lighting's flat tiles, from the last frame's HDR target. */
+    RGL::VariableRateShading m_variable_rate_shading;
+
+    RGL::ImageBasedLighting m_ibl;
+
+    RGL::Skybox m_skybox;
 
     /// Clustered shading variables.
-    std::shared_ptr<RGL::Shader> m_depth_prepass_shader;
+    std::shared_ptr<RGL::Shader> m_depth_prepass_shader; // The alpha masked materials, the others use m_depth_only_shader.
+    std::shared_ptr<RGL::Shader> m_depth_only_shader;
+    std::shared_ptr<RGL::Shader> m_depth_prepass_picking_shader; // The depth pre-pass shaders that also write the object ids.
+    std::shared_ptr<RGL::Shader> m_depth_only_picking_shader;
     std::shared_ptr<RGL::Shader> m_generate_clusters_shader;
     std::shared_ptr<RGL::Shader> m_find_visible_clusters_shader;
     std::shared_ptr<RGL::Shader> m_find_unique_clusters_shader;
+    std::shared_ptr<RGL::Shader> m_mark_cluster_bounds_shader;
     std::shared_ptr<RGL::Shader> m_update_cull_lights_indirect_args_shader;
     std::shared_ptr<RGL::Shader> m_cull_lights_shader;
     std::shared_ptr<RGL::Shader> m_clustered_pbr_shader;
-    std::shared_ptr<RGL::Shader> m_update_lights_shader;
+    std::shared_ptr<RGL::Shader> m_light_sort_keys_shader;
+    std::shared_ptr<RGL::Shader> m_assign_lights_zbins_shader;
+    std::shared_ptr<RGL::Shader> m_radix_sort_histogram_shader;
+    std::shared_ptr<RGL::Shader> m_radix_sort_scan_shader;
+    std::shared_ptr<RGL::Shader> m_radix_sort_scatter_shader;
+    std::shared_ptr<RGL::Shader> m_build_light_bvh_shader;
+    std::shared_ptr<RGL::Shader> m_visibility_shader;
+    std::shared_ptr<RGL::Shader> m_visibility_resolve_shader;
 
     std::shared_ptr<RGL::Shader> m_draw_area_lights_geometry_shader;
 
-    GLuint m_depth_tex2D_id;
-    GLuint m_depth_pass_fbo_id;
+    GLuint m_depth_tex2D_id    = 0;
+    GLuint m_depth_pass_fbo_id = 0;
+
+    /// The mesh draw under the cursor - the ids of the depth pre-pass, or the draw indices of the visibility buffer.
+    RGL::ObjectPicking m_object_picking;
+    bool               m_is_picking_enabled = false;
+
+    /// Visibility buffer, the depth is the depth pre-pass' texture.
+    GLuint m_visibility_tex2D_id = 0;
+    GLuint m_visibility_fbo_id   = 0;
 
-    GLuint m_clusters_ssbo;
+    ShadingMode m_shading_mode                   = ShadingMode::FORWARD;
+    std::string m_shading_mode_names[2]          = { "Forward (depth pre-pass)", "Visibility buffer" };
+    bool        m_is_visibility_buffer_supported = false;
+    uint32_t    m_visibility_vertex_stride       = 0; // Floats per vertex of the model's interleaved buffer.
+
+    std::vector<std::unique_ptr<ClusterGrid>> m_cluster_grids; // [0] is the main view's.
+
+    uint64_t   m_cluster_buffers_capacity = 0;              // Clusters of the flags, unique clusters and light grids.
+    uint64_t   m_tiles_capacity           = 0;              // Screen tiles of the tile light masks.
+    glm::uvec2 m_depth_resolution         = glm::uvec2(0);
     GLuint m_cull_lights_dispatch_args_ssbo;
     GLuint m_clusters_flags_ssbo;
     GLuint m_point_light_index_list_ssbo;
@@ -392,13 +443,58 @@ private:
     GLuint m_area_light_grid_ssbo;
     GLuint m_unique_active_clusters_ssbo;
 
-    // Average number of overlapping lights per cluster AABB.
-    // This variable matters when the lights are big and cover more than one cluster.
+    /// Light BVH, rebuilt every frame: the lights sorted by the Morton codes of their view space positions
+    /// are the leaves of an implicit tree of LIGHT_BVH_BRANCHING children per node.
+    GLuint m_light_spheres_ssbo;
+    GLuint m_light_keys_ssbos[2];       // [0] - the sorted Morton codes (or depths), [1] - the other half of the radix sort ping-pong.
+    GLuint m_light_indices_ssbos[2];    // The same for the light indices.
+    GLuint m_radix_sort_histogram_ssbo;
+    GLuint m_light_bvh_nodes_ssbo;
+    GLuint m_sorted_light_spheres_ssbo;
+
+    std::vector<glm::uvec2> m_light_bvh_levels; // [offset, count] of the nodes, from the lowest level to the root.
+
+    /// Z-binning, the memory is fixed: ZBINS_COUNT ranges and ZBIN_WORDS_PER_TILE words per screen tile.
+    GLuint m_zbins_ssbo;
+    GLuint m_tile_light_masks_ssbo;
+
+    LightAssignment m_light_assignment = LightAssignment::CLUSTERS;
+
+    ClusterSelection m_cluster_selection          = ClusterSelection::VISIBLE;
+    std::string      m_cluster_selection_names[3] = { "Visible (depth pre-pass)", "Visible and transparent bounds", "All" };
+
+    /* World space boxes of the transparent and forward only geometry, this demo marks the box the lights move in. */
+    std::vector<ClusterAABB> m_transparent_bounds;
+    GLuint                   m_transparent_bounds_ssbo = 0;
+    std::string     m_light_assignment_names[2] = { "Clusters (BVH culling, index lists)", "Z-bins and tile bitmasks" };
+
+    /* Subgroup (wave) aggregated appends in the culling and the lights scalarized over the subgroup in the shading. */
+    bool m_is_subgroups_supported = false;
+    bool m_use_subgroups          = false;
+
+    // Average number of overlapping lights per cluster AABB, the initial sizes of the index lists.
+    // The culling's feedback resizes them then, when the lights are big and cover more than one cluster.
     const uint32_t AVERAGE_OVERLAPPING_LIGHTS_PER_CLUSTER      = 50u;
     const uint32_t AVERAGE_OVERLAPPING_AREA_LIGHTS_PER_CLUSTER = 100u;
 
+    /// Light index lists feedback, read back FEEDBACK_FRAMES frames late at most, as soon as its fence is signaled.
+    static constexpr uint32_t FEEDBACK_FRAMES          = 2;
+    static constexpr float    INDEX_LISTS_HEADROOM     = 1.5f; // Of the required entries, when the lists are resized.
+    static constexpr float    INDEX_LISTS_SHRINK_RATIO = 0.25f; // The lists shrink when they use less than that.
+
+    GLuint              m_light_lists_feedback_ssbo;
+    GLuint              m_light_lists_readback_buffer;
+    LightListsFeedback* m_light_lists_readback_data;
+    GLsync              m_light_lists_fences[FEEDBACK_FRAMES] = {};
+    uint32_t            m_light_lists_readback_slot           = 0;
+
+    uint32_t           m_light_index_lists_capacities[3] = {};  // Entries of the point, spot and area light index lists.
+    LightListsFeedback m_light_lists_feedback          = {};    // The last one read back.
+    glm::uvec3         m_max_peak_light_counts         = glm::uvec3(0); // Since the last reset.
+    uint32_t           m_light_index_lists_resizes     = 0;
+
     uint32_t   m_cluster_grid_block_size = 64; // The size of a cluster in the screen space.
-    glm::uvec3 m_cluster_grid_dim;             // 3D dimensions of the cluster grid.
+    glm::uvec3 m_cluster_grid_dim;             // 3D dimensions of the cluster grid, the main view's grid ones from here.
     float      m_near_k;                       // ( 1 + ( 2 * tan( fov * 0.5 ) / ClusterGridDim.y ) ) // Used to compute the near plane for clusters at depth k.    
     float      m_log_grid_dim_y;               // 1.0f / log( NearK )  // Used to compute the k index of the cluster from the view depth of a pixel sample.
     uint64_t   m_clusters_count;
@@ -408,6 +504,8 @@ private:
     float m_debug_clusters_occupancy_blend_factor = 0.9f;
 
     /// Lights
+    static constexpr uint32_t MAX_LIGHTS_COUNT = 1u << 20; // Of a type.
+
     uint32_t  m_point_lights_count       = 500;
     uint32_t  m_spot_lights_count        = 500;
     uint32_t  m_directional_lights_count = 0;
@@ -421,6 +519,8 @@ private:
 
     float     m_area_lights_intensity    = 30.0f;
     glm::vec2 m_area_lights_size         = glm::vec2(0.5f);
+    float     m_area_light_cutoff        = 0.005f; // The radiance the area lights' range ends at.
+    float     m_area_light_lod_distance  = 10.0f;  // In half diagonals, the farther area lights are shaded as point lights.
     float     m_point_lights_intensity   = 6.0f;
     float     m_spot_lights_intensity    = 100.0f;
     float     m_animation_speed          = 0.618f;
@@ -434,13 +534,50 @@ private:
     std::vector<glm::vec4>        m_point_lights_ellipses_radii; // [x, y, z] => [ellipse a radius, ellipse b radius, light move speed]
     std::vector<glm::vec4>        m_spot_lights_ellipses_radii;  // [x, y, z] => [ellipse a radius, ellipse b radius, light move speed]
 
+    /// Static and dynamic light partitions, LIGHTS_UPDATE_FRAMES slots of the dynamic lights in a persistently mapped buffer.
+    static constexpr uint32_t LIGHTS_UPDATE_FRAMES = 3;
+
+    float      m_dynamic_lights_ratio            = 1.0f; // Of every type, the last lights are the dynamic ones.
+    glm::uvec3 m_static_lights_counts            = glm::uvec3(0);
+    float      m_lights_time                     = 0.0f;
+
+    GLuint     m_dynamic_lights_buffer           = 0;
+    uint8_t*   m_dynamic_lights_data             = nullptr;
+    size_t     m_dynamic_lights_slot_size        = 0;
+    size_t     m_dynamic_lights_slot_capacity    = 0;
+    uint32_t   m_dynamic_lights_slot             = 0;
+    GLsync     m_dynamic_lights_fences[LIGHTS_UPDATE_FRAMES] = {};
+
+    RGL::JobSystem::Counter m_dynamic_lights_job;
+    bool                    m_is_dynamic_lights_job_pending = false;
+
+    /* The time of the dynamic lights in the light SSBOs, they are as generated until the first copy. */
+    float m_dynamic_lights_job_time      = 0.0f;
+    float m_uploaded_lights_time         = 0.0f;
+    bool  m_are_uploaded_lights_animated = false;
+
+    /// Shadowed lights, their shadow maps are tiles of the atlas.
+    std::unique_ptr<ShadowAtlas> m_shadow_atlas;
+
+    bool     m_shadows_enabled       = true;
+    uint32_t m_max_shadowed_lights   = 32;      // At most MAX_SHADOWED_LIGHTS.
+    uint32_t m_shadow_faces_budget   = 24;      // Of the rendered faces per frame, a point light has 6 and a spot light 1.
+    float    m_shadow_bias           = 0.0002f;
+
+    ShadowedLight         m_shadowed_lights[MAX_SHADOWED_LIGHTS];
+    LightShadow           m_light_shadows  [MAX_SHADOWED_LIGHTS];
+    std::vector<uint32_t> m_shadows_to_render;  // The slots rendered this frame.
+    uint32_t              m_shadow_faces_rendered = 0;
+
+    GLuint m_point_light_shadows_ssbo = 0;
+    GLuint m_spot_light_shadows_ssbo  = 0;
+    GLuint m_light_shadows_ssbo       = 0;
+
     StaticObject m_sponza_static_object;
 
     GLuint m_directional_lights_ssbo;
     GLuint m_point_lights_ssbo;
     GLuint m_spot_lights_ssbo;
-    GLuint m_point_lights_ellipses_radii_ssbo;
-    GLuint m_spot_lights_ellipses_radii_ssbo;
     GLuint m_area_lights_ssbo;
 
     /// Area lights variables
@@ -452,15 +589,14 @@ private:
     float m_exposure; 
     float m_gamma;
 
-    float m_background_lod_level;
+    float m_background_blur; /* The roughness of the prefiltered level of the background, 0 - the environment map. */
     std::string m_hdr_maps_names[4] = { "../black.hdr", "colorful_studio_4k.hdr", "phalzer_forest_01_4k.hdr", "sunset_fairway_4k.hdr" };
     uint8_t m_current_hdr_map_idx   = 3;
 
-    GLuint m_skybox_vao, m_skybox_vbo;
-
     /* Bloom members */
     std::shared_ptr<RGL::Shader>    m_downscale_shader;
     std::shared_ptr<RGL::Shader>    m_upscale_shader;
+    std::shared_ptr<RGL::Shader>    m_downscale_single_pass_shader;
     std::shared_ptr<RGL::Texture2D> m_bloom_dirt_texture;
 
     float m_threshold;
@@ -468,4 +604,31 @@ private:
     float m_bloom_intensity;
     float m_bloom_dirt_intensity;
     bool  m_bloom_enabled;
+    bool  m_bloom_single_pass;
+
+    GLuint m_bloom_counter_buffer; /* The workgroups of the single pass downscale that are done. */
+
+    /// Volumetric fog, FOG_FROXELS_X x FOG_FROXELS_Y x FOG_FROXELS_Z froxels whatever the resolution.
+    std::shared_ptr<RGL::Shader> m_fog_noise_shader;
+    std::shared_ptr<RGL::Shader> m_fog_inject_shader;
+    std::shared_ptr<RGL::Shader> m_fog_integrate_shader;
+    std::shared_ptr<RGL::Shader> m_fog_apply_shader;
+
+    GLuint m_fog_noise_tex3D_id            = 0;
+    GLuint m_fog_froxels_tex3D_id          = 0;  // The scattering and the extinction of every froxel.
+    GLuint m_fog_integrated_tex3D_id       = 0;  // The scattered light and the transmittance up to every froxel.
+
+    bool      m_fog_enabled         = true;
+    float     m_fog_density         = 0.03f;
+    float     m_fog_height_falloff  = 0.15f;
+    float     m_fog_base_height     = 0.0f;
+    float     m_fog_noise_scale     = 0.08f;  // Noise tiles per world unit.
+    float     m_fog_noise_amount    = 0.8f;
+    glm::vec3 m_fog_wind            = glm::vec3(0.6f, 0.0f, 0.2f);
+    glm::vec3 m_fog_noise_offset    = glm::vec3(0.0f); // The wind's scroll, in the noise tiles.
+    glm::vec3 m_fog_albedo          = glm::vec3(0.9f);
+    float     m_fog_anisotropy      = 0.4f;
+    float     m_fog_ambient         = 0.05f;
+    float     m_fog_start_z         = 0.5f;
+    float     m_fog_end_z           = 40.0f;
 };
\ No newline at end of file
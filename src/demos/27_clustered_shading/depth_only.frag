@@ -0,0 +1,14 @@
+#version 460
+
+#ifdef OBJECT_PICKING
+layout(location = 1) flat in uint object_id;
+
+layout(location = 0) out uint out_object_id;
+#endif
+
+void main()
+{
+#ifdef OBJECT_PICKING
+	out_object_id = object_id;
+#endif
+}
@@ -0,0 +1,18 @@
+#version 460
+#include "../../core/core_shared.h"
+
+layout (location = 0) in vec3 in_pos;
+
+#ifdef OBJECT_PICKING
+layout(location = 1) flat out uint object_id;
+#endif
+
+uniform mat4 mvp;
+
+void main()
+{
+#ifdef OBJECT_PICKING
+	object_id   = gl_DrawID + u_draw_id_offset + 1;
+#endif
+	gl_Position = mvp * vec4(in_pos, 1.0);
+}
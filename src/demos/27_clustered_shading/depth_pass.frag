@@ -3,9 +3,19 @@
 layout(location = 0) in vec2 texcoord;
 layout(binding = 0) uniform sampler2D u_albedo_texture;
 
+#ifdef OBJECT_PICKING
+layout(location = 1) flat in uint object_id;
+
+layout(location = 0) out uint out_object_id;
+#endif
+
 void main()
 {
 	float alpha = texture(u_albedo_texture, texcoord).a;
 
 	if (alpha < 0.5) discard;
-}
\ No newline at end of file
+
+#ifdef OBJECT_PICKING
+	out_object_id = object_id;
+#endif
+}
@@ -1,13 +1,22 @@
 #version 460
+#include "../../core/core_shared.h"
+
 layout (location = 0) in vec3 in_pos;
 layout (location = 1) in vec2 in_texcoord;
 
 layout(location = 0) out vec2 texcoord;
 
+#ifdef OBJECT_PICKING
+layout(location = 1) flat out uint object_id;
+#endif
+
 uniform mat4 mvp;
 
 void main()
 {
 	texcoord    = in_texcoord;
+#ifdef OBJECT_PICKING
+	object_id   = gl_DrawID + u_draw_id_offset + 1;
+#endif
 	gl_Position = mvp * vec4(in_pos, 1.0);
-}
\ No newline at end of file
+}
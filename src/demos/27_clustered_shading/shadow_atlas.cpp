@@ -0,0 +1,131 @@
+#include "shadow_atlas.h"
+
+#include <algorithm>
+#include <bit>
+
+ShadowAtlas::ShadowAtlas()
+{
+    glCreateTextures  (GL_TEXTURE_2D, 1, &m_texture);
+    glTextureStorage2D(m_texture, 1, GL_DEPTH_COMPONENT32F, SIZE, SIZE);
+
+    /* Hardware PCF, the lookups clamp their coordinates to their tile. */
+    glTextureParameteri(m_texture, GL_TEXTURE_MIN_FILTER,   GL_LINEAR);
+    glTextureParameteri(m_texture, GL_TEXTURE_MAG_FILTER,   GL_LINEAR);
+    glTextureParameteri(m_texture, GL_TEXTURE_WRAP_S,       GL_CLAMP_TO_EDGE);
+    glTextureParameteri(m_texture, GL_TEXTURE_WRAP_T,       GL_CLAMP_TO_EDGE);
+    glTextureParameteri(m_texture, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTextureParameteri(m_texture, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    glCreateFramebuffers     (1, &m_fbo);
+    glNamedFramebufferTexture(m_fbo, GL_DEPTH_ATTACHMENT, m_texture, 0);
+
+    GLenum draw_buffers[] = { GL_NONE };
+    glNamedFramebufferDrawBuffers(m_fbo, 1, draw_buffers);
+
+    Reset();
+}
+
+ShadowAtlas::~ShadowAtlas()
+{
+    glDeleteFramebuffers(1, &m_fbo);
+    glDeleteTextures    (1, &m_texture);
+}
+
+bool ShadowAtlas::Allocate(uint32_t size, glm::uvec2& position)
+{
+    return AllocateLevel(GetLevel(size), position);
+}
+
+void ShadowAtlas::Free(uint32_t size, const glm::uvec2& position)
+{
+    FreeLevel(GetLevel(size), position);
+}
+
+void ShadowAtlas::Reset()
+{
+    for (auto& free_tiles : m_free_tiles)
+    {
+        free_tiles.clear();
+    }
+
+    m_free_tiles[0].push_back(glm::uvec2(0));
+}
+
+uint64_t ShadowAtlas::GetFreeTexelsCount() const
+{
+    uint64_t count = 0;
+
+    for (uint32_t level = 0; level < LEVELS_COUNT; ++level)
+    {
+        const uint64_t tile_size = SIZE >> level;
+        count += m_free_tiles[level].size() * tile_size * tile_size;
+    }
+
+    return count;
+}
+
+uint32_t ShadowAtlas::GetLevel(uint32_t size)
+{
+    size = std::clamp(std::bit_ceil(size), MIN_TILE_SIZE, SIZE);
+
+    return std::countr_zero(SIZE) - std::countr_zero(size);
+}
+
+bool ShadowAtlas::AllocateLevel(uint32_t level, glm::uvec2& position)
+{
+    auto& free_tiles = m_free_tiles[level];
+
+    if (!free_tiles.empty())
+    {
+        position = free_tiles.back();
+        free_tiles.pop_back();
+
+        return true;
+    }
+
+    /* Split a tile of the level above, the three other quarters are free. */
+    glm::uvec2 parent;
+
+    if (level == 0 || !AllocateLevel(level - 1, parent))
+    {
+        return false;
+    }
+
+    const uint32_t size = SIZE >> level;
+
+    free_tiles.push_back(parent + glm::uvec2(size, 0));
+    free_tiles.push_back(parent + glm::uvec2(0,    size));
+    free_tiles.push_back(parent + glm::uvec2(size, size));
+    position = parent;
+
+    return true;
+}
+
+void ShadowAtlas::FreeLevel(uint32_t level, const glm::uvec2& position)
+{
+    auto& free_tiles = m_free_tiles[level];
+
+    if (level > 0)
+    {
+        /* Merge with the three buddies if they're all free. */
+        const uint32_t   size   = SIZE >> level;
+        const glm::uvec2 parent = position & glm::uvec2(~(2 * size - 1));
+
+        const glm::uvec2 quarters[4] = { parent, parent + glm::uvec2(size, 0), parent + glm::uvec2(0, size), parent + glm::uvec2(size, size) };
+
+        auto is_free = [&](const glm::uvec2& tile)
+        {
+            return tile == position || std::find(free_tiles.begin(), free_tiles.end(), tile) != free_tiles.end();
+        };
+
+        if (std::all_of(std::begin(quarters), std::end(quarters), is_free))
+        {
+            std::erase_if(free_tiles, [&](const glm::uvec2& tile) { return (tile & glm::uvec2(~(2 * size - 1))) == parent; });
+
+            FreeLevel(level - 1, parent);
+            return;
+        }
+    }
+
+    free_tiles.push_back(position);
+}
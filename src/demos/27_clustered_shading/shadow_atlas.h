@@ -0,0 +1,48 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/*
+ * A depth atlas of the light shadow maps, split into square power of two tiles by a quadtree buddy allocator:
+ * a tile is taken from the free ones of its size, or splits a bigger one in four, and a freed tile merges back
+ * with its three buddies. The tiles keep their place while they're used, so their shadows can stay cached.
+ */
+class ShadowAtlas
+{
+public:
+    static constexpr uint32_t SIZE          = 4096;
+    static constexpr uint32_t MIN_TILE_SIZE = 128;
+    static constexpr uint32_t LEVELS_COUNT  = 6; // SIZE down to MIN_TILE_SIZE.
+
+    ShadowAtlas();
+    ~ShadowAtlas();
+
+    ShadowAtlas           (const ShadowAtlas&) = delete;
+    ShadowAtlas& operator=(const ShadowAtlas&) = delete;
+
+    /* A tile of the power of two size, between MIN_TILE_SIZE and SIZE. Returns false if there's no room left. */
+    bool Allocate(uint32_t size, glm::uvec2& position);
+    void Free    (uint32_t size, const glm::uvec2& position);
+
+    /* All the tiles free. */
+    void Reset();
+
+    /* The texels of the free tiles. */
+    uint64_t GetFreeTexelsCount() const;
+
+    GLuint GetTexture()     const { return m_texture; }
+    GLuint GetFramebuffer() const { return m_fbo; }
+
+private:
+    static uint32_t GetLevel(uint32_t size);
+
+    bool AllocateLevel(uint32_t level, glm::uvec2& position);
+    void FreeLevel    (uint32_t level, const glm::uvec2& position);
+
+    std::vector<glm::uvec2> m_free_tiles[LEVELS_COUNT]; // Level 0 is the whole atlas.
+
+    GLuint m_texture;
+    GLuint m_fbo;
+};
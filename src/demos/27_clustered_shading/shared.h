@@ -2,6 +2,7 @@
 #pragma once
 #define vec3 alignas(16) glm::vec3
 #define vec4 alignas(16) glm::vec4
+#define mat4 alignas(16) glm::mat4
 #define uint alignas(4)  uint32_t
 #define bool alignas(4)  bool
 #endif
@@ -10,8 +11,6 @@
 #define DIRECTIONAL_LIGHTS_SSBO_BINDING_INDEX          1
 #define POINT_LIGHTS_SSBO_BINDING_INDEX                2
 #define SPOT_LIGHTS_SSBO_BINDING_INDEX                 3
-#define POINT_LIGHTS_ELLIPSES_RADII_SSBO_BINDING_INDEX 4
-#define SPOT_LIGHTS_ELLIPSES_RADII_SSBO_BINDING_INDEX  5
 #define CLUSTERS_FLAGS_SSBO_BINDING_INDEX              6
 #define POINT_LIGHT_INDEX_LIST_SSBO_BINDING_INDEX      7
 #define SPOT_LIGHT_INDEX_LIST_SSBO_BINDING_INDEX       8
@@ -23,6 +22,67 @@
 #define AREA_LIGHT_INDEX_LIST_SSBO_BINDING_INDEX       14
 #define AREA_LIGHT_GRID_SSBO_BINDING_INDEX             15
 
+// The light BVH, after the bindings of core_shared.h.
+#define LIGHT_SPHERES_SSBO_BINDING_INDEX               40
+#define LIGHT_KEYS_SSBO_BINDING_INDEX                  41
+#define LIGHT_INDICES_SSBO_BINDING_INDEX               42
+#define RADIX_SORT_KEYS_IN_SSBO_BINDING_INDEX          43
+#define RADIX_SORT_VALUES_IN_SSBO_BINDING_INDEX        44
+#define RADIX_SORT_KEYS_OUT_SSBO_BINDING_INDEX         45
+#define RADIX_SORT_VALUES_OUT_SSBO_BINDING_INDEX       46
+#define RADIX_SORT_HISTOGRAM_SSBO_BINDING_INDEX        47
+#define LIGHT_BVH_NODES_SSBO_BINDING_INDEX             48
+#define SORTED_LIGHT_SPHERES_SSBO_BINDING_INDEX        49
+#define ZBINS_SSBO_BINDING_INDEX                       50
+#define TILE_LIGHT_MASKS_SSBO_BINDING_INDEX            51
+#define LIGHT_LISTS_FEEDBACK_SSBO_BINDING_INDEX        52
+#define TRANSPARENT_BOUNDS_SSBO_BINDING_INDEX          53
+#define POINT_LIGHT_SHADOWS_SSBO_BINDING_INDEX         54
+#define SPOT_LIGHT_SHADOWS_SSBO_BINDING_INDEX          55
+#define LIGHT_SHADOWS_SSBO_BINDING_INDEX               56
+#define VISIBILITY_VERTICES_SSBO_BINDING_INDEX         57
+#define VISIBILITY_INDICES_SSBO_BINDING_INDEX          58
+#define VISIBILITY_COMMANDS_SSBO_BINDING_INDEX         59
+#define SHADOW_ATLAS_TEXTURE_BINDING_INDEX             6
+#define VISIBILITY_TEXTURE_BINDING_INDEX               11
+
+#define RADIX_SORT_BLOCK_SIZE   256 // Keys sorted by a work group.
+#define RADIX_SORT_DIGIT_BITS   4
+#define RADIX_SORT_BINS_COUNT   16
+#define RADIX_SORT_PASSES_COUNT 8   // 32 bits of the keys, the 30 bit Morton codes need all of them.
+
+#define LIGHT_BVH_BRANCHING     32  // Children per node, the leaves are the sorted lights.
+#define LIGHT_BVH_MAX_LEVELS    8
+
+// The Z-binning light assignment: the lights sorted by their view depth, a [first, last] range of them per depth bin
+// and a bit per light per screen tile. Its memory only depends on the tiles count.
+#define ZBINS_COUNT             4096 // Linear from the near to the far plane.
+#define ZBIN_MAX_LIGHTS         65536
+#define ZBIN_WORDS_PER_TILE     (ZBIN_MAX_LIGHTS / 32)
+
+// The shadowed point and spot lights, their maps are tiles of a shared atlas. The lights point to their shadows,
+// NO_LIGHT_SHADOW if they have none.
+#define MAX_SHADOWED_LIGHTS     64
+#define NO_LIGHT_SHADOW         0xFFFFFFFF
+
+// The visibility buffer: (draw + 1, primitive) per pixel, 0 where nothing was drawn. The resolve fetches
+// the interleaved float vertices of the drawn triangle itself.
+#define VISIBILITY_GROUP_SIZE   8
+
+// The volumetric fog: a fixed froxel grid over the view whatever the resolution, exponential in the depth like the
+// clusters' slices. Its froxels are lit from the light lists of the clusters they fall in, then integrated front to back
+// per column. The density is scaled by a tiling noise volume scrolled with the wind.
+#define FOG_FROXELS_X                     160
+#define FOG_FROXELS_Y                     90
+#define FOG_FROXELS_Z                     64
+#define FOG_INJECT_GROUP_SIZE             4   // 4x4x4 froxels.
+#define FOG_INTEGRATE_GROUP_SIZE          8   // 8x8 columns.
+#define FOG_APPLY_GROUP_SIZE              8
+#define FOG_NOISE_SIZE                    64
+#define FOG_NOISE_TEXTURE_BINDING_INDEX   12
+#define FOG_FROXELS_TEXTURE_BINDING_INDEX 13
+#define FOG_DEPTH_TEXTURE_BINDING_INDEX   14
+
 struct BaseLight
 {
     vec3 color;
@@ -63,15 +123,38 @@ struct ClusterAABB
     vec4 max;
 };
 
+// The bounds of 32 children (lights or nodes) in the view space.
+struct LightBvhNode
+{
+    vec4 min;
+    vec4 max;
+};
+
+// The faces of a point light's cube (+X, -X, +Y, -Y, +Z, -Z), a single one for a spot light.
+struct LightShadow
+{
+    mat4 view_projections[6];
+    vec4 atlas_rects[6]; // xy = offset, zw = size, in the atlas' uv.
+};
+
 struct LightGrid
 {
     uint offset;
     uint count;
 };
 
+// What the light culling of a frame needed, read back to size the index lists.
+struct LightListsFeedback
+{
+    uint required_counts[3]; // Entries of the point, spot and area light index lists.
+    uint peak_counts[3];     // The most lights of a type in a cluster.
+    uint overflows_count;    // Clusters whose lists were cut.
+};
+
 #ifdef __cplusplus
 #undef vec3
 #undef vec4
+#undef mat4
 #undef uint
 #undef bool
 #endif
\ No newline at end of file
@@ -0,0 +1,21 @@
+#version 460
+#extension GL_ARB_bindless_texture : require
+#include "../../core/core_shared.h"
+
+layout(location = 0) in vec2 texcoord;
+layout(location = 1) flat in uint draw_index;
+
+layout(location = 0) out uvec2 visibility;
+
+void main()
+{
+	// The same alpha test as the depth pre-pass, the materials come from the bindless handles.
+	if ((MESH_DRAW_MATERIAL(draw_index).flags & MATERIAL_HAS_ALBEDO_MAP) != 0)
+	{
+		float alpha = texture(MESH_DRAW_TEXTURE(draw_index, MATERIAL_TEXTURE_ALBEDO), texcoord).a;
+
+		if (alpha < 0.5) discard;
+	}
+
+	visibility = uvec2(draw_index + 1, gl_PrimitiveID);
+}
@@ -0,0 +1,17 @@
+#version 460
+#include "../../core/core_shared.h"
+
+layout (location = 0) in vec3 in_pos;
+layout (location = 1) in vec2 in_texcoord;
+
+layout(location = 0) out vec2 texcoord;
+layout(location = 1) flat out uint draw_index;
+
+uniform mat4 mvp;
+
+void main()
+{
+	texcoord    = in_texcoord;
+	draw_index  = gl_DrawID + u_draw_id_offset;
+	gl_Position = mvp * vec4(in_pos, 1.0);
+}
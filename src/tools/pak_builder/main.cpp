@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <zstd.h>
+
+#include "filesystem.h"
+#include "mapped_file.h"
+#include "pak_file.h"
+
+/*
+ * Packs the files of the given directories (or single files), relative to the root directory, into a pak file for
+ * FileSystem::mountPak(), so an install opens one file instead of thousands - the demos take it with --pak <file>.
+ *
+ *     pak_builder <output pak> <directory or file> [...] [--level <zstd level>] [--no-compression]
+ *     pak_builder RapidGL.pak resources src/core/shaders src/demos
+ *
+ * The resources, the shaders and the model caches (.rglcache) go in as they are on the disk, the C++ sources and the
+ * build files are skipped. The entries are compressed with zstd when it saves at least 10%, except the files that are
+ * compressed already or read in pages (images, KTX2, .vtex) - those stay uncompressed, to be read in place.
+ * The pak has to be rebuilt after the files change, the mounted paks take precedence over the loose files.
+ */
+using namespace RGL;
+
+namespace
+{
+    constexpr std::array SKIPPED_EXTENSIONS      = { ".cpp", ".c", ".cmake", ".pak", ".tmp" };
+    constexpr std::array UNCOMPRESSED_EXTENSIONS = { ".png", ".jpg", ".jpeg", ".ktx2", ".basis", ".vtex", ".dds" };
+
+    constexpr double MIN_COMPRESSION_GAIN = 0.1;
+
+    struct Options
+    {
+        std::filesystem::path              m_output_filepath;
+        std::vector<std::filesystem::path> m_inputs;
+        int                                m_level       = 12;
+        bool                               m_compression = true;
+    };
+
+    struct InputFile
+    {
+        std::filesystem::path m_filepath;
+        std::string           m_name;
+    };
+
+    bool IsOneOf(const std::string& extension, const auto& extensions)
+    {
+        return std::find(extensions.begin(), extensions.end(), extension) != extensions.end();
+    }
+
+    void AddFile(const std::filesystem::path& filepath, const std::filesystem::path& root_path, std::vector<InputFile>& files)
+    {
+        const auto extension = filepath.extension().string();
+
+        if (IsOneOf(extension, SKIPPED_EXTENSIONS) || filepath.filename() == "CMakeLists.txt")
+        {
+            return;
+        }
+
+        files.push_back({ filepath, filepath.lexically_normal().lexically_relative(root_path).generic_string() });
+    }
+
+    void Pad(std::ofstream& out, uint64_t& offset, uint64_t alignment)
+    {
+        static const char zeros[PakFile::PAK_DATA_ALIGNMENT] = {};
+
+        const uint64_t padding = (alignment - offset % alignment) % alignment;
+        out.write(zeros, std::streamsize(padding));
+        offset += padding;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--level") == 0 && i + 1 < argc)
+        {
+            options.m_level = std::clamp(std::atoi(argv[++i]), 1, ZSTD_maxCLevel());
+        }
+        else if (std::strcmp(argv[i], "--no-compression") == 0)
+        {
+            options.m_compression = false;
+        }
+        else if (options.m_output_filepath.empty())
+        {
+            options.m_output_filepath = argv[i];
+        }
+        else
+        {
+            options.m_inputs.push_back(argv[i]);
+        }
+    }
+
+    if (options.m_output_filepath.empty() || options.m_inputs.empty())
+    {
+        fprintf(stderr, "Usage: pak_builder <output pak> <directory or file> [...] [--level <zstd level>] [--no-compression]\n");
+        return 1;
+    }
+
+    const auto root_path = FileSystem::getRootPath().lexically_normal();
+
+    std::vector<InputFile> files;
+    std::error_code        ec;
+
+    for (const auto& input : options.m_inputs)
+    {
+        const auto input_path = input.is_absolute() ? input : root_path / input;
+
+        if (input_path.lexically_normal().lexically_relative(root_path).string().starts_with(".."))
+        {
+            fprintf(stderr, "%s is outside of the root directory %s, skipped.\n", input.string().c_str(), root_path.string().c_str());
+            continue;
+        }
+
+        if (std::filesystem::is_regular_file(input_path, ec))
+        {
+            AddFile(input_path, root_path, files);
+            continue;
+        }
+
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(input_path, ec))
+        {
+            if (entry.is_regular_file())
+            {
+                AddFile(entry.path(), root_path, files);
+            }
+        }
+    }
+
+    /* Sorted by the names, the data's order doesn't depend on the file system. */
+    std::sort(files.begin(), files.end(), [](const InputFile& a, const InputFile& b) { return a.m_name < b.m_name; });
+    files.erase(std::unique(files.begin(), files.end(), [](const InputFile& a, const InputFile& b) { return a.m_name == b.m_name; }), files.end());
+
+    std::ofstream out(options.m_output_filepath, std::ios::binary);
+
+    if (!out)
+    {
+        fprintf(stderr, "Could not open the output file %s\n", options.m_output_filepath.string().c_str());
+        return 1;
+    }
+
+    PakHeader header = {};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<PakEntry> entries;
+    std::string           names;
+    std::vector<uint8_t>  compressed;
+    uint64_t              offset     = sizeof(header);
+    uint64_t              total_size = 0;
+
+    for (const auto& file : files)
+    {
+        MappedFile mapped_file;
+
+        if (!mapped_file.OpenFromDisk(file.m_filepath) || file.m_name.size() > UINT16_MAX)
+        {
+            fprintf(stderr, "Skipped %s\n", file.m_name.c_str());
+            continue;
+        }
+
+        PakEntry entry      = {};
+        entry.m_hash        = PakFile::HashName(file.m_name);
+        entry.m_size        = mapped_file.GetSize();
+        entry.m_stored_size = entry.m_size;
+        entry.m_write_time  = std::filesystem::last_write_time(file.m_filepath, ec).time_since_epoch().count();
+        entry.m_name_offset = uint32_t(names.size());
+        entry.m_name_size   = uint16_t(file.m_name.size());
+        entry.m_compression = PakCompression::NONE;
+
+        const uint8_t* data = mapped_file.GetData();
+
+        if (options.m_compression && entry.m_size > 0 && !IsOneOf(file.m_filepath.extension().string(), UNCOMPRESSED_EXTENSIONS))
+        {
+            compressed.resize(ZSTD_compressBound(mapped_file.GetSize()));
+
+            const size_t compressed_size = ZSTD_compress(compressed.data(), compressed.size(), data, mapped_file.GetSize(), options.m_level);
+
+            if (!ZSTD_isError(compressed_size) && compressed_size <= size_t(double(entry.m_size) * (1.0 - MIN_COMPRESSION_GAIN)))
+            {
+                entry.m_stored_size = compressed_size;
+                entry.m_compression = PakCompression::ZSTD;
+                data                = compressed.data();
+            }
+        }
+
+        Pad(out, offset, PakFile::PAK_DATA_ALIGNMENT);
+
+        entry.m_offset = offset;
+        out.write(reinterpret_cast<const char*>(data), std::streamsize(entry.m_stored_size));
+        offset += entry.m_stored_size;
+
+        names      += file.m_name;
+        total_size += entry.m_size;
+        entries.push_back(entry);
+    }
+
+    /* Sorted by the hashes for PakFile::Find(), the names of the colliding ones are compared. */
+    std::stable_sort(entries.begin(), entries.end(), [](const PakEntry& a, const PakEntry& b) { return a.m_hash < b.m_hash; });
+
+    Pad(out, offset, alignof(PakEntry));
+
+    header.m_magic         = PakFile::MAGIC;
+    header.m_version       = PakFile::VERSION;
+    header.m_entries_count = uint32_t(entries.size());
+    header.m_names_size    = uint32_t(names.size());
+    header.m_toc_offset    = offset;
+    header.m_names_offset  = offset + entries.size() * sizeof(PakEntry);
+
+    out.write(reinterpret_cast<const char*>(entries.data()), std::streamsize(entries.size() * sizeof(PakEntry)));
+    out.write(names.data(), std::streamsize(names.size()));
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    if (!out)
+    {
+        fprintf(stderr, "Could not write the output file %s\n", options.m_output_filepath.string().c_str());
+        return 1;
+    }
+
+    printf("Packed %zu files, %.1f MB into %.1f MB: %s\n", entries.size(), double(total_size) / (1 << 20), double(header.m_names_offset + names.size()) / (1 << 20),
+           options.m_output_filepath.string().c_str());
+
+    return 0;
+}
@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Compares the benchmark CSV files of the demos (CoreApp --benchmark) with their baselines and reports the regressions,
+ * run by the rgl_perf_suite target (see run_perf_suite.cmake).
+ *
+ *     perf_compare <results directory> <baselines directory> [--tolerance <percent>] [--min-ms <ms>] [--report <file>] [--update]
+ *
+ * A time is a regression when it's slower than the baseline by more than the tolerance (5% by default) and by more
+ * than the noise floor (--min-ms, 0.05 ms by default) - the frame's p50 and p95, the CPU and GPU medians, and the
+ * medians of every profiler scope. The results without a baseline are only listed, --update copies all the results
+ * over the baselines. Exits with 1 if anything regressed or a baselined demo has no results.
+ */
+namespace
+{
+    struct Options
+    {
+        std::filesystem::path m_results_directory;
+        std::filesystem::path m_baselines_directory;
+        std::filesystem::path m_report_filepath;
+        double                m_tolerance = 5.0;
+        double                m_min_ms    = 0.05;
+        bool                  m_update    = false;
+    };
+
+    /* "frame p50", "gpu Frame/Shadows"... - the name of a time and its milliseconds. */
+    using Times = std::map<std::string, double>;
+
+    bool LoadTimes(const std::filesystem::path& filepath, Times& times)
+    {
+        std::ifstream file(filepath);
+
+        if (!file)
+        {
+            return false;
+        }
+
+        std::string line, section;
+
+        while (std::getline(file, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+
+            if (line.empty())
+            {
+                section.clear();
+                continue;
+            }
+
+            std::vector<std::string> columns;
+            std::stringstream        stream(line);
+
+            for (std::string column; std::getline(stream, column, ',');)
+            {
+                columns.push_back(column);
+            }
+
+            if (section.empty())
+            {
+                section = columns[0];
+                continue;
+            }
+
+            if (columns.size() < 3)
+            {
+                continue;
+            }
+
+            if (section == "percentile" && columns.size() >= 4)
+            {
+                times["frame " + columns[0]] = std::atof(columns[1].c_str());
+
+                /* The CPU and GPU medians, the tails are the frame's. */
+                if (columns[0] == "p50")
+                {
+                    times["cpu p50"] = std::atof(columns[2].c_str());
+                    times["gpu p50"] = std::atof(columns[3].c_str());
+                }
+            }
+            else if (section == "pass")
+            {
+                times["cpu " + columns[0]] = std::atof(columns[1].c_str());
+                times["gpu " + columns[0]] = std::atof(columns[2].c_str());
+            }
+        }
+
+        return true;
+    }
+
+    struct Summary
+    {
+        uint32_t m_demos_count        = 0;
+        uint32_t m_regressions_count  = 0;
+        uint32_t m_improvements_count = 0;
+        uint32_t m_missing_count      = 0;
+    };
+
+    void CompareDemo(const std::string& name, const Times& results, const Times& baselines, const Options& options, Summary& summary, std::string& report)
+    {
+        std::string lines;
+        char        line[512];
+
+        for (const auto& [time_name, baseline_ms] : baselines)
+        {
+            auto it = results.find(time_name);
+
+            if (it == results.end())
+            {
+                snprintf(line, sizeof(line), "  missing      %-48s %8.3f ms\n", time_name.c_str(), baseline_ms);
+                lines += line;
+                continue;
+            }
+
+            const double result_ms = it->second;
+            const double change    = baseline_ms > 0.0 ? (result_ms - baseline_ms) / baseline_ms * 100.0 : 0.0;
+
+            if (std::abs(result_ms - baseline_ms) <= options.m_min_ms || std::abs(change) <= options.m_tolerance)
+            {
+                continue;
+            }
+
+            const bool is_regression = result_ms > baseline_ms;
+            summary.m_regressions_count  += is_regression ? 1 : 0;
+            summary.m_improvements_count += is_regression ? 0 : 1;
+
+            snprintf(line, sizeof(line), "  %-12s %-48s %8.3f ms -> %8.3f ms (%+.1f%%)\n", is_regression ? "REGRESSION" : "improvement",
+                     time_name.c_str(), baseline_ms, result_ms, change);
+            lines += line;
+        }
+
+        for (const auto& [time_name, result_ms] : results)
+        {
+            if (baselines.find(time_name) == baselines.end())
+            {
+                snprintf(line, sizeof(line), "  new          %-48s %8.3f ms\n", time_name.c_str(), result_ms);
+                lines += line;
+            }
+        }
+
+        if (!lines.empty())
+        {
+            report += name + "\n" + lines + "\n";
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    int     positional_count = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+        {
+            options.m_tolerance = std::max(0.0, std::atof(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--min-ms") == 0 && i + 1 < argc)
+        {
+            options.m_min_ms = std::max(0.0, std::atof(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--report") == 0 && i + 1 < argc)
+        {
+            options.m_report_filepath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--update") == 0)
+        {
+            options.m_update = true;
+        }
+        else if (positional_count == 0)
+        {
+            options.m_results_directory = argv[i];
+            positional_count++;
+        }
+        else if (positional_count == 1)
+        {
+            options.m_baselines_directory = argv[i];
+            positional_count++;
+        }
+    }
+
+    if (positional_count < 2)
+    {
+        fprintf(stderr, "Usage: perf_compare <results directory> <baselines directory> [--tolerance <percent>] [--min-ms <ms>] [--report <file>] [--update]\n");
+        return 1;
+    }
+
+    std::error_code error;
+
+    if (options.m_update)
+    {
+        std::filesystem::create_directories(options.m_baselines_directory, error);
+
+        for (const auto& entry : std::filesystem::directory_iterator(options.m_results_directory, error))
+        {
+            if (entry.path().extension() == ".csv")
+            {
+                std::filesystem::copy_file(entry.path(), options.m_baselines_directory / entry.path().filename(), std::filesystem::copy_options::overwrite_existing, error);
+                printf("Baseline updated: %s\n", entry.path().filename().string().c_str());
+            }
+        }
+
+        return 0;
+    }
+
+    /* Sorted, the report's order doesn't depend on the file system. */
+    std::vector<std::filesystem::path> filepaths;
+
+    for (const auto& directory : { options.m_results_directory, options.m_baselines_directory })
+    {
+        for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+        {
+            if (entry.path().extension() == ".csv")
+            {
+                filepaths.push_back(entry.path().filename());
+            }
+        }
+    }
+
+    std::sort(filepaths.begin(), filepaths.end());
+    filepaths.erase(std::unique(filepaths.begin(), filepaths.end()), filepaths.end());
+
+    Summary     summary;
+    std::string report;
+
+    for (const auto& filename : filepaths)
+    {
+        const std::string name = filename.stem().string();
+        Times             results, baselines;
+
+        const bool has_results   = LoadTimes(options.m_results_directory   / filename, results);
+        const bool has_baselines = LoadTimes(options.m_baselines_directory / filename, baselines);
+
+        summary.m_demos_count++;
+
+        if (!has_results)
+        {
+            summary.m_missing_count++;
+            report += name + "\n  no results, the benchmark failed or didn't run\n\n";
+        }
+        else if (!has_baselines)
+        {
+            report += name + "\n  no baseline\n\n";
+        }
+        else
+        {
+            CompareDemo(name, results, baselines, options, summary, report);
+        }
+    }
+
+    char header[256];
+    snprintf(header, sizeof(header), "Perf suite: %u demos, %u regressions, %u improvements, %u without results (tolerance %.1f%%, noise floor %.3f ms)\n\n",
+             summary.m_demos_count, summary.m_regressions_count, summary.m_improvements_count, summary.m_missing_count, options.m_tolerance, options.m_min_ms);
+
+    report = header + report;
+    printf("%s", report.c_str());
+
+    if (!options.m_report_filepath.empty())
+    {
+        std::ofstream file(options.m_report_filepath);
+
+        if (!file)
+        {
+            fprintf(stderr, "Could not open the report file %s\n", options.m_report_filepath.string().c_str());
+        }
+
+        file << report;
+    }
+
+    return summary.m_regressions_count > 0 || summary.m_missing_count > 0 ? 1 : 0;
+}
@@ -0,0 +1,48 @@
+# Copyright (C) 2022 Tomasz Gałaj
+
+# Runs the demos of DEMOS ("name=executable|...") in the benchmark mode and compares their results with the baselines,
+# see src/tools/perf_suite/CMakeLists.txt for the variables. Fails if anything regressed.
+
+string(REPLACE "|" ";" DEMOS "${DEMOS}")
+
+file(REMOVE_RECURSE ${RESULTS_DIR})
+file(MAKE_DIRECTORY ${RESULTS_DIR})
+
+foreach(DEMO ${DEMOS})
+	string(REGEX REPLACE "=.*$" "" DEMO_NAME       "${DEMO}")
+	string(REGEX REPLACE "^[^=]*=" "" DEMO_EXECUTABLE "${DEMO}")
+
+	set(BENCHMARK_ARGS --benchmark)
+
+	if(EXISTS ${PATHS_DIR}/${DEMO_NAME}.txt)
+		list(APPEND BENCHMARK_ARGS ${PATHS_DIR}/${DEMO_NAME}.txt)
+	endif()
+
+	message(STATUS "Benchmarking ${DEMO_NAME}")
+
+	get_filename_component(DEMO_DIRECTORY ${DEMO_EXECUTABLE} DIRECTORY)
+
+	execute_process(COMMAND ${DEMO_EXECUTABLE} ${BENCHMARK_ARGS}
+	                        --resolution ${RESOLUTION}
+	                        --warmup     ${WARMUP}
+	                        --frames     ${FRAMES}
+	                        --output     ${RESULTS_DIR}/${DEMO_NAME}.csv
+	                WORKING_DIRECTORY ${DEMO_DIRECTORY}
+	                RESULT_VARIABLE   DEMO_RESULT)
+
+	if(NOT DEMO_RESULT EQUAL 0)
+		message(WARNING "${DEMO_NAME} exited with ${DEMO_RESULT}")
+	endif()
+endforeach()
+
+set(COMPARE_ARGS ${RESULTS_DIR} ${BASELINES_DIR} --tolerance ${TOLERANCE} --min-ms ${MIN_MS} --report ${RESULTS_DIR}/report.txt)
+
+if(UPDATE_BASELINES)
+	list(APPEND COMPARE_ARGS --update)
+endif()
+
+execute_process(COMMAND ${COMPARE_TOOL} ${COMPARE_ARGS} RESULT_VARIABLE COMPARE_RESULT)
+
+if(NOT COMPARE_RESULT EQUAL 0)
+	message(FATAL_ERROR "Perf suite failed, see ${RESULTS_DIR}/report.txt")
+endif()
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "filesystem.h"
+#include "shader.h"
+#include "util.h"
+
+/*
+ * Compiles the shaders of the given directories (or single files), relative to the root directory, to the SPIR-V
+ * modules that Shader loads with --spirv, run by the rgl_spirv target.
+ *
+ *     spirv_builder <glslangValidator> <directory or file> [...]
+ *     spirv_builder glslangValidator src/core/shaders src/demos
+ *
+ * The includes are resolved the way Shader does it and the module is named by Shader::getSpirvFilepath() of the
+ * resulting code, so a source changed since the build simply has no module and is compiled from GLSL. The uniforms
+ * without a location and the resources without a binding get them assigned, ARB_gl_spirv requires both.
+ * The shaders that only compile with the defines of their demo (the permutations, the image formats) can't
+ * be built up front and are listed as skipped.
+ */
+using namespace RGL;
+
+namespace
+{
+    struct Stage
+    {
+        const char* m_extension;
+        const char* m_glslang_stage;
+        GLenum      m_type;
+    };
+
+    constexpr std::array STAGES =
+    {
+        Stage{ ".vert", "vert", GL_VERTEX_SHADER          },
+        Stage{ ".frag", "frag", GL_FRAGMENT_SHADER        },
+        Stage{ ".comp", "comp", GL_COMPUTE_SHADER         },
+        Stage{ ".geom", "geom", GL_GEOMETRY_SHADER        },
+        Stage{ ".tcs",  "tesc", GL_TESS_CONTROL_SHADER    },
+        Stage{ ".tes",  "tese", GL_TESS_EVALUATION_SHADER }
+    };
+
+    const Stage* FindStage(const std::filesystem::path& filepath)
+    {
+        auto it = std::find_if(STAGES.begin(), STAGES.end(), [&](const Stage& stage) { return filepath.extension() == stage.m_extension; });
+
+        return it != STAGES.end() ? &*it : nullptr;
+    }
+
+    std::string Quote(const std::filesystem::path& path)
+    {
+        return "\"" + path.string() + "\"";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: spirv_builder <glslangValidator> <directory or file> [...]\n");
+        return 1;
+    }
+
+    const std::string validator = argv[1];
+    const auto        root_path = FileSystem::getRootPath().lexically_normal();
+
+    std::vector<std::filesystem::path> filepaths;
+    std::error_code                    ec;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::filesystem::path input = argv[i];
+
+        if (std::filesystem::is_regular_file(root_path / input, ec))
+        {
+            filepaths.push_back(input);
+            continue;
+        }
+
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(root_path / input, ec))
+        {
+            if (entry.is_regular_file() && FindStage(entry.path()))
+            {
+                filepaths.push_back(entry.path().lexically_normal().lexically_relative(root_path));
+            }
+        }
+    }
+
+    std::sort(filepaths.begin(), filepaths.end());
+
+    const auto temp_directory = std::filesystem::temp_directory_path(ec) / "rgl_spirv";
+    std::filesystem::create_directories(temp_directory, ec);
+    std::filesystem::create_directories(root_path / "shader_cache" / "spirv", ec);
+
+    uint32_t compiled_count = 0;
+    std::vector<std::string> skipped;
+
+    for (const auto& filepath : filepaths)
+    {
+        const Stage* stage = FindStage(filepath);
+
+        /* The same code Shader compiles, without the defines and the instrumentation. */
+        const std::string code = Util::LoadShaderIncludes(Util::LoadFile(filepath), root_path / filepath.parent_path());
+
+        if (!stage || code.empty())
+        {
+            continue;
+        }
+
+        const auto spirv_filepath = Shader::getSpirvFilepath(stage->m_type, code);
+
+        if (std::filesystem::exists(spirv_filepath, ec))
+        {
+            compiled_count++;
+            continue;
+        }
+
+        const auto source_filepath = temp_directory / ("source" + filepath.extension().string());
+        std::ofstream(source_filepath, std::ios::binary) << code;
+
+        const std::string command = Quote(validator) + " -G -S " + stage->m_glslang_stage + " --auto-map-locations --auto-map-bindings" +
+                                    " -o " + Quote(spirv_filepath) + " " + Quote(source_filepath) + " > " + Quote(temp_directory / "log.txt");
+
+        if (std::system(command.c_str()) != 0)
+        {
+            std::filesystem::remove(spirv_filepath, ec);
+            skipped.push_back(filepath.generic_string());
+            continue;
+        }
+
+        compiled_count++;
+    }
+
+    for (const auto& name : skipped)
+    {
+        printf("Skipped %s\n", name.c_str());
+    }
+
+    printf("%u of %zu shaders compiled to SPIR-V: %s\n", compiled_count, filepaths.size(), (root_path / "shader_cache" / "spirv").string().c_str());
+
+    std::filesystem::remove_all(temp_directory, ec);
+
+    return 0;
+}
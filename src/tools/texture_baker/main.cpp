@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <basisu_comp.h>
+
+#include "filesystem.h"
+#include "util.h"
+#include "virtual_texture.h"
+
+/*
+ * Offline converter of the source images (png, jpg, tga, bmp) into KTX2 files with mipmaps, written next to
+ * the sources. Texture2D::Load() picks the .ktx2 up instead of the source when it is not older than the source.
+ *
+ *     texture_baker [directory] [--force] [--uastc]
+ *     texture_baker --virtual image [image...]
+ *     texture_baker --array output.ktx2 image [image...]
+ *
+ * Color textures are encoded as ETC1S (small, transcoded to BC1/BC7), the data textures (normals, roughness...)
+ * as linear UASTC, because ETC1S blocks smear the normals. --uastc encodes everything as UASTC.
+ *
+ * --virtual writes .vtex page files for VirtualTexture instead, e.g. for the 32k terrain splat maps.
+ * --array packs same-size images into a single KTX2 texture array for Texture2DArray::LoadKtx2(), one layer per image.
+ * The kind (color, data, normals) of the array comes from the first image's name, all the images have to be of it.
+ */
+using namespace RGL;
+
+namespace
+{
+    constexpr std::array SOURCE_EXTENSIONS = { ".png", ".jpg", ".jpeg", ".tga", ".bmp" };
+
+    /* Parts of the file name that mark a texture with non-color data. */
+    constexpr std::array LINEAR_NAME_HINTS = { "normal", "nrm", "rough", "metal", "_ao", "occlusion", "height", "displacement", "mask", "blend", "splat" };
+
+    constexpr std::array NORMAL_NAME_HINTS = { "normal", "nrm" };
+
+    struct Options
+    {
+        std::filesystem::path              m_directory = FileSystem::getResourcesPath();
+        std::vector<std::filesystem::path> m_images;
+        std::filesystem::path              m_array_filepath;
+        bool                               m_force     = false;
+        bool                               m_uastc     = false;
+        bool                               m_virtual   = false;
+        bool                               m_array     = false;
+    };
+
+    template<typename Hints>
+    bool NameContains(const std::string& name, const Hints& hints)
+    {
+        for (const char* hint : hints)
+        {
+            if (name.find(hint) != std::string::npos)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    std::string GetLowerCaseName(const std::filesystem::path& filepath)
+    {
+        std::string name = filepath.stem().string();
+
+        for (auto& c : name)
+        {
+            c = char(std::tolower(c));
+        }
+
+        return name;
+    }
+
+    bool IsLinear(const std::filesystem::path& filepath)
+    {
+        return NameContains(GetLowerCaseName(filepath), LINEAR_NAME_HINTS);
+    }
+
+    bool IsNormalMap(const std::filesystem::path& filepath)
+    {
+        return NameContains(GetLowerCaseName(filepath), NORMAL_NAME_HINTS);
+    }
+
+    bool IsSourceImage(const std::filesystem::path& filepath)
+    {
+        std::string extension = filepath.extension().string();
+
+        for (auto& c : extension)
+        {
+            c = char(std::tolower(c));
+        }
+
+        for (const char* source_extension : SOURCE_EXTENSIONS)
+        {
+            if (extension == source_extension)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool IsUpToDate(const std::filesystem::path& source, const std::filesystem::path& baked)
+    {
+        std::error_code source_error, baked_error;
+
+        const auto source_time = std::filesystem::last_write_time(source, source_error);
+        const auto baked_time  = std::filesystem::last_write_time(baked,  baked_error);
+
+        return !source_error && !baked_error && baked_time >= source_time;
+    }
+
+    /* More than one source makes a texture array, a layer per source. */
+    bool Bake(const std::vector<std::filesystem::path>& sources, const std::filesystem::path& baked, bool force_uastc, basisu::job_pool& job_pool)
+    {
+        const bool is_linear = IsLinear(sources[0]);
+        const bool is_uastc  = force_uastc || IsNormalMap(sources[0]);
+
+        basisu::basis_compressor_params params;
+
+        for (const auto& source : sources)
+        {
+            if (IsLinear(source) != is_linear || IsNormalMap(source) != IsNormalMap(sources[0]))
+            {
+                fprintf(stderr, "%s is not the same kind of texture as %s\n", source.string().c_str(), sources[0].string().c_str());
+                return false;
+            }
+
+            ImageData image_data;
+            unsigned char* data = Util::LoadTextureData(source, image_data, 4);
+
+            if (!data)
+            {
+                fprintf(stderr, "Could not load the image %s\n", source.string().c_str());
+                return false;
+            }
+
+            if (!params.m_source_images.empty() && (image_data.width != params.m_source_images[0].get_width() || image_data.height != params.m_source_images[0].get_height()))
+            {
+                fprintf(stderr, "%s is not of the same size as %s\n", source.string().c_str(), sources[0].string().c_str());
+                Util::ReleaseTextureData(data);
+                return false;
+            }
+
+            basisu::image image(image_data.width, image_data.height);
+            std::memcpy(image.get_ptr(), data, size_t(image_data.width) * image_data.height * 4);
+
+            Util::ReleaseTextureData(data);
+
+            params.m_source_images.push_back(image);
+        }
+
+        params.m_tex_type                     = sources.size() > 1 ? basist::cBASISTexType2DArray : basist::cBASISTexType2D;
+        params.m_uastc                        = is_uastc;
+        params.m_quality_level                = 128;
+        params.m_perceptual                   = !is_linear;
+        params.m_mip_gen                      = true;
+        params.m_mip_srgb                     = !is_linear;
+        params.m_create_ktx2_file             = true;
+        params.m_ktx2_srgb_transfer_func      = !is_linear;
+        params.m_ktx2_uastc_supercompression  = basist::KTX2_SS_ZSTANDARD;
+        params.m_multithreading               = true;
+        params.m_pJob_pool                    = &job_pool;
+        params.m_status_output                = false;
+
+        basisu::basis_compressor compressor;
+
+        if (!compressor.init(params) || compressor.process() != basisu::basis_compressor::cECSuccess)
+        {
+            fprintf(stderr, "Could not encode %s\n", baked.string().c_str());
+            return false;
+        }
+
+        const auto& ktx2_file = compressor.get_output_ktx2_file();
+
+        std::ofstream file(baked, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(ktx2_file.data()), std::streamsize(ktx2_file.size()));
+
+        if (!file)
+        {
+            fprintf(stderr, "Could not write the file %s\n", baked.string().c_str());
+            return false;
+        }
+
+        for (const auto& source : sources)
+        {
+            printf("%s -> %s (%s, %s)\n", source.string().c_str(), baked.filename().string().c_str(), is_uastc ? "UASTC" : "ETC1S", is_linear ? "linear" : "sRGB");
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--force") == 0)
+        {
+            options.m_force = true;
+        }
+        else if (std::strcmp(argv[i], "--uastc") == 0)
+        {
+            options.m_uastc = true;
+        }
+        else if (std::strcmp(argv[i], "--virtual") == 0)
+        {
+            options.m_virtual = true;
+        }
+        else if (std::strcmp(argv[i], "--array") == 0 && i + 1 < argc)
+        {
+            options.m_array          = true;
+            options.m_array_filepath = argv[++i];
+        }
+        else if (options.m_virtual || options.m_array)
+        {
+            options.m_images.push_back(argv[i]);
+        }
+        else
+        {
+            options.m_directory = argv[i];
+        }
+    }
+
+    if (options.m_virtual)
+    {
+        uint32_t failed_count = 0;
+
+        for (const auto& image : options.m_images)
+        {
+            auto baked = image;
+            baked.replace_extension(".vtex");
+
+            if (!options.m_force && IsUpToDate(image, baked))
+            {
+                continue;
+            }
+
+            if (VirtualTexture::Bake(image, baked, !IsLinear(image)))
+            {
+                printf("%s -> %s\n", image.string().c_str(), baked.filename().string().c_str());
+            }
+            else
+            {
+                ++failed_count;
+            }
+        }
+
+        return failed_count == 0 ? 0 : 1;
+    }
+
+    if (options.m_array)
+    {
+        if (options.m_images.empty())
+        {
+            fprintf(stderr, "--array needs the images to pack\n");
+            return 1;
+        }
+
+        basisu::basisu_encoder_init();
+        basisu::job_pool job_pool(std::max(std::thread::hardware_concurrency(), 1u));
+
+        return Bake(options.m_images, options.m_array_filepath, options.m_uastc, job_pool) ? 0 : 1;
+    }
+
+    if (!std::filesystem::is_directory(options.m_directory))
+    {
+        fprintf(stderr, "%s is not a directory\n", options.m_directory.string().c_str());
+        return 1;
+    }
+
+    basisu::basisu_encoder_init();
+    basisu::job_pool job_pool(std::max(std::thread::hardware_concurrency(), 1u));
+
+    uint32_t baked_count  = 0;
+    uint32_t failed_count = 0;
+
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(options.m_directory))
+    {
+        if (!entry.is_regular_file() || !IsSourceImage(entry.path()))
+        {
+            continue;
+        }
+
+        auto baked = entry.path();
+        baked.replace_extension(".ktx2");
+
+        if (!options.m_force && IsUpToDate(entry.path(), baked))
+        {
+            continue;
+        }
+
+        if (Bake({ entry.path() }, baked, options.m_uastc, job_pool))
+        {
+            ++baked_count;
+        }
+        else
+        {
+            ++failed_count;
+        }
+    }
+
+    printf("Baked %u textures, %u failed.\n", baked_count, failed_count);
+
+    return failed_count == 0 ? 0 : 1;
+}